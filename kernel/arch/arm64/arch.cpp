@@ -16,6 +16,7 @@
 #include <debug.h>
 #include <inttypes.h>
 #include <kernel/cmdline.h>
+#include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <lk/init.h>
 #include <lk/main.h>
@@ -243,8 +244,11 @@ void arch_init() TA_NO_THREAD_SAFETY_ANALYSIS {
 }
 
 __NO_RETURN int arch_idle_thread_routine(void*) {
-    for (;;)
+    for (;;) {
+        // look for work queued up on busy neighbors before going back to sleep
+        sched_idle_balance();
         __asm__ volatile("wfi");
+    }
 }
 
 // Switch to user mode, set the user stack pointer to user_stack_top, put the svc stack pointer to
@@ -72,15 +72,16 @@ Guest::~Guest() {
 }
 
 zx_status_t Guest::SetTrap(uint32_t kind, zx_gpaddr_t addr, size_t len,
-                           fbl::RefPtr<PortDispatcher> port, uint64_t key) {
+                           fbl::RefPtr<PortDispatcher> port, fbl::RefPtr<EventDispatcher> event,
+                           uint64_t key) {
     switch (kind) {
     case ZX_GUEST_TRAP_MEM:
-        if (port) {
+        if (port || event) {
             return ZX_ERR_INVALID_ARGS;
         }
         break;
     case ZX_GUEST_TRAP_BELL:
-        if (!port) {
+        if (!port == !event) {
             return ZX_ERR_INVALID_ARGS;
         }
         break;
@@ -99,7 +100,7 @@ zx_status_t Guest::SetTrap(uint32_t kind, zx_gpaddr_t addr, size_t len,
     if (status != ZX_OK) {
         return status;
     }
-    return traps_.InsertTrap(kind, addr, len, fbl::move(port), key);
+    return traps_.InsertTrap(kind, addr, len, fbl::move(port), fbl::move(event), key);
 }
 
 zx_status_t Guest::AllocVpid(uint8_t* vpid) {
@@ -279,6 +279,8 @@ static zx_status_t handle_data_abort(uint32_t iss, GuestState* guest_state,
     case ZX_GUEST_TRAP_BELL:
         if (data_abort.read)
             return ZX_ERR_NOT_SUPPORTED;
+        if (trap->HasEvent())
+            return trap->Signal(nullptr);
         *packet = {};
         packet->key = trap->key();
         packet->type = ZX_PKT_TYPE_GUEST_BELL;
@@ -8,8 +8,10 @@
 #pragma once
 
 #include <arch/arm64/mmu.h>
+#include <fbl/atomic.h>
 #include <fbl/canary.h>
 #include <fbl/mutex.h>
+#include <list.h>
 #include <vm/arch_vm_aspace.h>
 #include <zircon/compiler.h>
 #include <zircon/types.h>
@@ -58,6 +60,9 @@ private:
 
     void FreePageTable(void* vaddr, paddr_t paddr, uint page_size_shift) TA_REQ(lock_);
 
+    zx_status_t SplitLargePage(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                               uint page_size_shift, volatile pte_t* page_table) TA_REQ(lock_);
+
     ssize_t MapPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
                          paddr_t paddr_in, size_t size_in, pte_t attrs,
                          uint index_shift, uint page_size_shift,
@@ -89,13 +94,25 @@ private:
     zx_status_t QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) TA_REQ(lock_);
 
     void FlushTLBEntry(vaddr_t vaddr, bool terminal) TA_REQ(lock_);
+    uint16_t UserAsid() const;
+
+    // Start or finish a batch of page table updates whose TLB maintenance is
+    // replaced by a single flush of the whole ASID when the batch ends.
+    bool BeginTLBBatch(size_t size, uint page_size_shift) TA_REQ(lock_);
+    void EndTLBBatch() TA_REQ(lock_);
 
     fbl::Canary<fbl::magic("VAAS")> canary_;
 
     fbl::Mutex lock_;
 
+    // The ASID of the kernel address space, or the VMID of a guest one.
     uint16_t asid_ = MMU_ARM64_UNUSED_ASID;
 
+    // For a user address space, the ASID it last ran with and the generation
+    // of the ASID allocator that it belongs to, or 0 if it has never run.
+    // Updated at context switch, see AsidAllocator in mmu.cpp.
+    fbl::atomic<uint64_t> context_id_{0};
+
     // Pointer to the translation table.
     paddr_t tt_phys_ = 0;
     volatile pte_t* tt_virt_ = nullptr;
@@ -104,6 +121,11 @@ private:
     // table.
     size_t pt_pages_ = 0;
 
+    // Set while a TLB batch is open. Page tables unlinked during the batch are
+    // parked on |batch_free_list_| until the batch's flush has completed.
+    bool tlb_batch_ = false;
+    list_node batch_free_list_ = LIST_INITIAL_VALUE(batch_free_list_);
+
     uint flags_ = 0;
 
     // Range of address space.
@@ -35,7 +35,8 @@ public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Guest);
 
     zx_status_t SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
-                        fbl::RefPtr<PortDispatcher> port, uint64_t key);
+                        fbl::RefPtr<PortDispatcher> port, fbl::RefPtr<EventDispatcher> event,
+                        uint64_t key);
 
     hypervisor::GuestPhysicalAddressSpace* AddressSpace() const { return gpas_.get(); }
     hypervisor::TrapMap* Traps() { return &traps_; }
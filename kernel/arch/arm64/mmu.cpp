@@ -9,6 +9,7 @@
 #include <arch/arm64/mmu.h>
 #include <arch/aspace.h>
 #include <arch/mmu.h>
+#include <arch/ops.h>
 #include <assert.h>
 #include <bitmap/raw-bitmap.h>
 #include <bitmap/storage.h>
@@ -19,9 +20,15 @@
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/cpu.h>
+#include <kernel/lockdep.h>
 #include <kernel/mutex.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
 #include <lib/heap.h>
 #include <lib/ktrace.h>
+#include <lk/init.h>
 #include <rand.h>
 #include <stdlib.h>
 #include <string.h>
@@ -74,71 +81,185 @@ pte_t* arm64_get_kernel_ptable() {
     return arm64_kernel_translation_table;
 }
 
+// Unmaps and protects covering more pages than this flush the whole ASID once
+// instead of issuing a broadcast TLBI per entry.
+#define ARM64_TLB_FLUSH_DEFAULT_THRESHOLD 32
+
+KCOUNTER(tlb_batch_flushes, "kernel.mmu.tlb.batch_flushes");
+
+static uint32_t tlb_flush_threshold = ARM64_TLB_FLUSH_DEFAULT_THRESHOLD;
+
+static void arm64_tlb_flush_threshold_init(uint level) {
+    tlb_flush_threshold = cmdline_get_uint32("kernel.mmu.tlb-flush-threshold",
+                                             ARM64_TLB_FLUSH_DEFAULT_THRESHOLD);
+}
+LK_INIT_HOOK(arm64_tlb_flush_threshold, &arm64_tlb_flush_threshold_init, LK_INIT_LEVEL_VM);
+
+KCOUNTER(asid_rollovers, "kernel.mmu.asid.rollovers");
+
 namespace {
 
+// Hands out the ASIDs of user address spaces at context switch. An address
+// space's context id holds its ASID in the low MMU_ARM64_ASID_BITS bits and
+// the generation the ASID belongs to above them, and 0 until it first runs.
+//
+// When a generation runs out of ASIDs a new one starts: the bitmap is
+// cleared apart from the ASIDs that are active on some cpu, which carry over
+// into the new generation, and each cpu flushes its whole TLB once before it
+// next switches address space. Address spaces from an older generation pick
+// up a new ASID the next time they are switched to. So ASIDs are never freed
+// or flushed one at a time, and there can be more address spaces than ASIDs.
 class AsidAllocator {
 public:
-    // set bitmap 的大小
-    AsidAllocator() { bitmap_.Reset(MMU_ARM64_MAX_USER_ASID + 1); }
+    AsidAllocator() { bitmap_.Reset(kNumAsids); }
     ~AsidAllocator() = default;
 
-    zx_status_t Alloc(uint16_t* asid);
-    zx_status_t Free(uint16_t asid);
+    // Makes |context_id| current for the calling cpu, assigning it a new
+    // ASID if it is from an older generation, and returns it. Must be called
+    // with interrupts disabled.
+    uint64_t SwitchTo(fbl::atomic<uint64_t>* context_id);
+
+    static uint16_t Asid(uint64_t context_id) {
+        return static_cast<uint16_t>(context_id & kAsidMask);
+    }
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(AsidAllocator);
 
-    fbl::Mutex lock_;
+    static constexpr uint64_t kGenerationStep = 1ul << MMU_ARM64_ASID_BITS;
+    static constexpr uint64_t kAsidMask = kGenerationStep - 1;
+    static constexpr size_t kNumAsids = MMU_ARM64_MAX_USER_ASID + 1;
+
+    static bool IsCurrent(uint64_t context_id, uint64_t generation) {
+        return (context_id & ~kAsidMask) == generation;
+    }
+
+    uint64_t NewContext(uint64_t context_id) TA_REQ(lock_);
+    void Rollover() TA_REQ(lock_);
+    bool UpdateReserved(uint64_t context_id, uint64_t new_context_id) TA_REQ(lock_);
+
+    DECLARE_SPINLOCK(AsidAllocator) lock_;
+
+    // The current generation, in the bits above the ASID. Only written with
+    // |lock_| held, but read without it on the context switch fast path.
+    fbl::atomic<uint64_t> generation_{kGenerationStep};
+
+    // The context id each cpu is running with. A rollover moves these to
+    // |reserved_| and sets them to 0, which forces the cpu's next context
+    // switch onto the slow path to do its flush.
+    fbl::atomic<uint64_t> active_[SMP_MAX_CPUS] = {};
+    uint64_t reserved_[SMP_MAX_CPUS] TA_GUARDED(lock_) = {};
+    cpu_mask_t flush_pending_ TA_GUARDED(lock_) = 0;
+
     uint16_t last_ TA_GUARDED(lock_) = MMU_ARM64_FIRST_USER_ASID - 1;
-    
-    bitmap::RawBitmapGeneric<bitmap::FixedStorage<MMU_ARM64_MAX_USER_ASID + 1>> bitmap_ TA_GUARDED(lock_);
+
+    bitmap::RawBitmapGeneric<bitmap::FixedStorage<kNumAsids>> bitmap_ TA_GUARDED(lock_);
 
     static_assert(MMU_ARM64_ASID_BITS <= 16, "");
 };
 
-zx_status_t AsidAllocator::Alloc(uint16_t* asid) {
-    uint16_t new_asid;
-
-    // use the bitmap allocator to allocate ids in the range of
-    // [MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID]
-    // start the search from the last found id + 1 and wrap when hitting the end of the range
-    {
-        fbl::AutoLock al(&lock_);
-
-        size_t val;
-        bool notfound = bitmap_.Get(last_ + 1, MMU_ARM64_MAX_USER_ASID + 1, &val);
-        if (unlikely(notfound)) {
-            // search again from the start
-            notfound = bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, MMU_ARM64_MAX_USER_ASID + 1, &val);
-            if (unlikely(notfound)) {
-                // ASID 溢出未做处理？
-                TRACEF("ARM64: out of ASIDs\n");
-                return ZX_ERR_NO_MEMORY;
-            }
-        }
-        bitmap_.SetOne(val);
+uint64_t AsidAllocator::SwitchTo(fbl::atomic<uint64_t>* context_id) {
+    const cpu_num_t cpu = arch_curr_cpu_num();
+    uint64_t id = context_id->load(fbl::memory_order_relaxed);
+
+    // Fast path: the ASID is from the current generation, so the cpu only
+    // needs to record it as active. The exchange fails if a rollover on
+    // another cpu has cleared this cpu's active id in the meantime, in which
+    // case the slow path takes care of the pending flush.
+    uint64_t old_active = active_[cpu].load(fbl::memory_order_relaxed);
+    if (old_active != 0 && IsCurrent(id, generation_.load(fbl::memory_order_relaxed)) &&
+        active_[cpu].compare_exchange_strong(&old_active, id, fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed)) {
+        return id;
+    }
 
-        DEBUG_ASSERT(val <= UINT16_MAX);
+    Guard<SpinLock, NoIrqSave> guard{&lock_};
+    id = context_id->load(fbl::memory_order_relaxed);
+    if (!IsCurrent(id, generation_.load(fbl::memory_order_relaxed))) {
+        id = NewContext(id);
+        context_id->store(id, fbl::memory_order_relaxed);
+    }
+    if (flush_pending_ & cpu_num_to_mask(cpu)) {
+        flush_pending_ &= ~cpu_num_to_mask(cpu);
+        // Only this cpu's TLB needs flushing; the others do their own.
+        __asm__ volatile("dsb nshst" ::: "memory");
+        ARM64_TLBI_NOADDR(vmalle1);
+        __asm__ volatile("dsb nsh" ::: "memory");
+        ISB;
+    }
+    active_[cpu].store(id, fbl::memory_order_relaxed);
+    return id;
+}
 
-        new_asid = (uint16_t)val;
-        last_ = new_asid;
+// Returns a context id from the current generation for an address space
+// whose context id is |context_id|.
+uint64_t AsidAllocator::NewContext(uint64_t context_id) {
+    uint64_t generation = generation_.load(fbl::memory_order_relaxed);
+
+    if (context_id != 0) {
+        // Keep the same ASID if it is still free in this generation, or if it
+        // carried over because the address space was active at the rollover.
+        uint64_t new_id = generation | Asid(context_id);
+        if (UpdateReserved(context_id, new_id)) {
+            return new_id;
+        }
+        if (!bitmap_.GetOne(Asid(context_id))) {
+            bitmap_.SetOne(Asid(context_id));
+            return new_id;
+        }
     }
 
-    LTRACEF("new asid %#x\n", new_asid);
+    // Search from the last ASID handed out, and start a new generation if
+    // none are left.
+    size_t asid;
+    if (bitmap_.Get(last_ + 1, kNumAsids, &asid) &&
+        bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, kNumAsids, &asid)) {
+        Rollover();
+        generation = generation_.load(fbl::memory_order_relaxed);
+        __UNUSED bool full = bitmap_.Get(MMU_ARM64_FIRST_USER_ASID, kNumAsids, &asid);
+        DEBUG_ASSERT(!full);
+    }
+    bitmap_.SetOne(asid);
+    last_ = static_cast<uint16_t>(asid);
 
-    *asid = new_asid;
+    LTRACEF("new asid %#zx generation %#" PRIx64 "\n", asid, generation >> MMU_ARM64_ASID_BITS);
 
-    return ZX_OK;
+    return generation | asid;
 }
 
-zx_status_t AsidAllocator::Free(uint16_t asid) {
-    LTRACEF("free asid %#x\n", asid);
-
-    fbl::AutoLock al(&lock_);
-
-    bitmap_.ClearOne(asid);
+void AsidAllocator::Rollover() {
+    generation_.fetch_add(kGenerationStep, fbl::memory_order_relaxed);
+    kcounter_add(asid_rollovers, 1);
+
+    bitmap_.ClearAll();
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        uint64_t id = active_[i].exchange(0, fbl::memory_order_relaxed);
+        // A cpu that has not switched address space since the last rollover
+        // has an active id of 0, and is still running its reserved one.
+        if (id == 0) {
+            id = reserved_[i];
+        }
+        if (id != 0) {
+            bitmap_.SetOne(Asid(id));
+        }
+        reserved_[i] = id;
+    }
+    flush_pending_ = CPU_MASK_ALL;
+}
 
-    return ZX_OK;
+// If |context_id| was active on some cpu at the last rollover, moves its
+// reservation to |new_context_id| and returns true.
+bool AsidAllocator::UpdateReserved(uint64_t context_id, uint64_t new_context_id) {
+    bool hit = false;
+    // A context id may be reserved on more than one cpu, and all of them
+    // have to be updated.
+    for (cpu_num_t i = 0; i < SMP_MAX_CPUS; i++) {
+        if (reserved_[i] == context_id) {
+            hit = true;
+            reserved_[i] = new_context_id;
+        }
+    }
+    return hit;
 }
 
 AsidAllocator asid;
@@ -448,7 +569,12 @@ void ArmArchVmAspace::FreePageTable(void* vaddr, paddr_t paddr, uint page_size_s
     if (!page) {
         panic("bad page table paddr 0x%lx\n", paddr);
     }
-    pmm_free_page(page);
+    if (tlb_batch_) {
+        // hardware walkers may still hold this table until the batch is flushed
+        list_add_tail(&batch_free_list_, &page->queue_node);
+    } else {
+        pmm_free_page(page);
+    }
 
     pt_pages_--;
 }
@@ -514,10 +640,62 @@ static bool page_table_is_clear(volatile pte_t* page_table, uint page_size_shift
     return true;
 }
 
+// Replace the block descriptor at page_table[index] with a table of next level
+// entries that map the same range with the same attributes, so that part of the
+// block can be unmapped or reprotected.
+// NOTE: caller must DSB afterwards to ensure TLB entries are flushed
+zx_status_t ArmArchVmAspace::SplitLargePage(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                                            uint page_size_shift, volatile pte_t* page_table) {
+    pte_t pte = page_table[index];
+    DEBUG_ASSERT(index_shift > page_size_shift);
+    DEBUG_ASSERT((pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK);
+
+    paddr_t paddr;
+    zx_status_t ret = AllocPageTable(&paddr, page_size_shift);
+    if (ret) {
+        TRACEF("failed to allocate page table\n");
+        return ret;
+    }
+    volatile pte_t* next_page_table = static_cast<volatile pte_t*>(paddr_to_physmap(paddr));
+
+    const uint next_index_shift = index_shift - (page_size_shift - 3);
+    const pte_t attrs = pte & ~(MMU_PTE_OUTPUT_ADDR_MASK | MMU_PTE_DESCRIPTOR_MASK);
+    const pte_t desc = (next_index_shift > page_size_shift) ? MMU_PTE_L012_DESCRIPTOR_BLOCK
+                                                            : MMU_PTE_L3_DESCRIPTOR_PAGE;
+    const paddr_t block_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
+    const size_t count = 1UL << (page_size_shift - 3);
+    for (size_t i = 0; i < count; i++) {
+        next_page_table[i] = (block_paddr + (i << next_index_shift)) | attrs | desc;
+    }
+
+    // ensure that the new table is observable from hardware page table walkers
+    DMB_ISHST;
+
+    // break before make: the block entry has to be invalidated and flushed before
+    // the table entry covering the same range can be installed, even in a batch
+    page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
+    DMB_ISHST;
+    const bool batch = tlb_batch_;
+    tlb_batch_ = false;
+    FlushTLBEntry(vaddr, true);
+    tlb_batch_ = batch;
+
+    pte = paddr | MMU_PTE_L012_DESCRIPTOR_TABLE;
+    LTRACEF("pte %p[%#" PRIxPTR "] = %#" PRIx64 " (was block)\n", page_table, index, pte);
+    page_table[index] = pte;
+    DMB_ISHST;
+
+    return ZX_OK;
+}
+
 // 从缓存中 FLush TBL
 // use the appropriate TLB flush instruction to globally flush the modified entry
 // terminal is set when flushing at the final level of the page table.
 void ArmArchVmAspace::FlushTLBEntry(vaddr_t vaddr, bool terminal) {
+    if (tlb_batch_) {
+        // covered by the flush at the end of the batch
+        return;
+    }
     if (flags_ & ARCH_ASPACE_FLAG_GUEST) {
         paddr_t vttbr = arm64_vttbr(asid_, tt_phys_);
         __UNUSED zx_status_t status = arm64_el2_tlbi_ipa(vttbr, vaddr, terminal);
@@ -533,14 +711,56 @@ void ArmArchVmAspace::FlushTLBEntry(vaddr_t vaddr, bool terminal) {
     } else {
         // flush this address for the specific asid
         // 某个用户进程
+        vaddr_t user_asid = UserAsid();
         if (terminal) {
-            ARM64_TLBI(vale1is, vaddr >> 12 | (vaddr_t)asid_ << 48);
+            ARM64_TLBI(vale1is, vaddr >> 12 | user_asid << 48);
         } else {
-            ARM64_TLBI(vae1is, vaddr >> 12 | (vaddr_t)asid_ << 48);
+            ARM64_TLBI(vae1is, vaddr >> 12 | user_asid << 48);
         }
     }
 }
 
+// The ASID that the TLB entries of a user address space are tagged with. If
+// the address space's ASID is from an older generation it may have been handed
+// to another address space since, in which case flushing it is redundant but
+// harmless.
+uint16_t ArmArchVmAspace::UserAsid() const {
+    return AsidAllocator::Asid(context_id_.load(fbl::memory_order_relaxed));
+}
+
+// Opens a TLB batch if |size| bytes covers more pages than the threshold, in
+// which case one flush of the whole ASID is cheaper than broadcasting a TLBI per
+// entry. Guest aspaces always flush per entry. Returns true if a batch was opened.
+bool ArmArchVmAspace::BeginTLBBatch(size_t size, uint page_size_shift) {
+    DEBUG_ASSERT(!tlb_batch_);
+    if (flags_ & ARCH_ASPACE_FLAG_GUEST) {
+        return false;
+    }
+    if ((size >> page_size_shift) <= tlb_flush_threshold) {
+        return false;
+    }
+    tlb_batch_ = true;
+    return true;
+}
+
+void ArmArchVmAspace::EndTLBBatch() {
+    DEBUG_ASSERT(tlb_batch_);
+    tlb_batch_ = false;
+
+    // make the page table updates visible before invalidating
+    DSB;
+    if (asid_ == MMU_ARM64_GLOBAL_ASID) {
+        ARM64_TLBI_NOADDR(vmalle1is);
+    } else {
+        ARM64_TLBI(aside1is, (vaddr_t)UserAsid() << 48);
+    }
+    DSB;
+    kcounter_add(tlb_batch_flushes, 1);
+
+    // nothing can walk the unlinked tables anymore
+    pmm_free(&batch_free_list_);
+}
+
 // 取消映射某段地址
 // NOTE: caller must DSB afterwards to ensure TLB entries are flushed
 ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
@@ -570,6 +790,17 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
 
         pte = page_table[index];
 
+        // a partial unmap of a block demotes it to a table first. If the split
+        // fails, the whole block is unmapped below and a subsequent page fault
+        // cleans it up.
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            if (SplitLargePage(vaddr, index, index_shift, page_size_shift,
+                               page_table) == ZX_OK) {
+                pte = page_table[index];
+            }
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -755,6 +986,15 @@ int ArmArchVmAspace::ProtectPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
         index = vaddr_rel >> index_shift;
         pte = page_table[index];
 
+        // a partial protect of a block demotes it to a table first
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            if (SplitLargePage(vaddr, index, index_shift, page_size_shift, page_table) != ZX_OK) {
+                goto err;
+            }
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -839,8 +1079,12 @@ ssize_t ArmArchVmAspace::UnmapPages(vaddr_t vaddr, size_t size,
 
     LOCAL_KTRACE64("mmu unmap", (vaddr & ~PAGE_MASK) | ((size >> PAGE_SIZE_SHIFT) & PAGE_MASK));
 
+    bool batch = BeginTLBBatch(size, page_size_shift);
     ssize_t ret = UnmapPageTable(vaddr, vaddr_rel, size, top_index_shift,
                                  page_size_shift, tt_virt_);
+    if (batch) {
+        EndTLBBatch();
+    }
     DSB;
     return ret;
 }
@@ -863,9 +1107,13 @@ zx_status_t ArmArchVmAspace::ProtectPages(vaddr_t vaddr, size_t size, pte_t attr
 
     LOCAL_KTRACE64("mmu protect", (vaddr & ~PAGE_MASK) | ((size >> PAGE_SIZE_SHIFT) & PAGE_MASK));
 
+    bool batch = BeginTLBBatch(size, page_size_shift);
     zx_status_t ret = ProtectPageTable(vaddr, vaddr_rel, size, attrs,
                                        top_index_shift, page_size_shift,
                                        tt_virt_);
+    if (batch) {
+        EndTLBBatch();
+    }
     DSB;
     return ret;
 }
@@ -1136,11 +1384,8 @@ zx_status_t ArmArchVmAspace::Init(vaddr_t base, size_t size, uint flags) {
             DEBUG_ASSERT(base + size <= 1UL << MMU_GUEST_SIZE_SHIFT);
         } else {
             // 用户空间
+            // The ASID is assigned when the address space is first switched to.
             DEBUG_ASSERT(base + size <= 1UL << MMU_USER_SIZE_SHIFT);
-            // 分配该进程的 ASID
-            // 分配失败则返回
-            if (asid.Alloc(&asid_) != ZX_OK)
-                return ZX_ERR_NO_MEMORY;
         }
 
         base_ = base;
@@ -1191,11 +1436,9 @@ zx_status_t ArmArchVmAspace::Destroy() {
         paddr_t vttbr = arm64_vttbr(asid_, tt_phys_);
         __UNUSED zx_status_t status = arm64_el2_tlbi_vmid(vttbr);
         DEBUG_ASSERT(status == ZX_OK);
-    } else {
-        ARM64_TLBI(ASIDE1IS, asid_);
-        asid.Free(asid_);
-        asid_ = MMU_ARM64_UNUSED_ASID;
     }
+    // A user address space's ASID is not flushed or freed here: it is only
+    // handed out again after a rollover, which flushes every cpu's TLB.
 
     return ZX_OK;
 }
@@ -1212,7 +1455,8 @@ void ArmArchVmAspace::ContextSwitch(ArmArchVmAspace* old_aspace, ArmArchVmAspace
         DEBUG_ASSERT((aspace->flags_ & (ARCH_ASPACE_FLAG_KERNEL | ARCH_ASPACE_FLAG_GUEST)) == 0);
 
         tcr = MMU_TCR_FLAGS_USER;
-        ttbr = ((uint64_t)aspace->asid_ << 48) | aspace->tt_phys_;
+        uint64_t context_id = asid.SwitchTo(&aspace->context_id_);
+        ttbr = ((uint64_t)AsidAllocator::Asid(context_id) << 48) | aspace->tt_phys_;
         ARM64_WRITE_SYSREG(ttbr0_el1, ttbr);
 
         if (TRACE_CONTEXT_SWITCH)
@@ -76,7 +76,8 @@ void arch_prepare_current_cpu_idle_state(bool idle) {
 }
 
 zx_status_t arch_mp_reschedule(cpu_mask_t mask) {
-    return arch_mp_send_ipi(MP_IPI_TARGET_MASK, mask, MP_IPI_RESCHEDULE);
+    mp_ipi_post(mask, MP_IPI_RESCHEDULE);
+    return ZX_OK;
 }
 
 zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t ipi) {
@@ -108,6 +109,17 @@ void arch_mp_init_percpu(void) {
     interrupt_init_percpu();
 }
 
+uint arch_cpu_distance(cpu_num_t a, cpu_num_t b) {
+    if (a == b) {
+        return CPU_DISTANCE_SELF;
+    }
+    // cpus within a cluster share the cluster's last level cache
+    if (arch_cpu_num_to_cluster_id(a) == arch_cpu_num_to_cluster_id(b)) {
+        return CPU_DISTANCE_CACHE;
+    }
+    return CPU_DISTANCE_REMOTE;
+}
+
 void arch_flush_state_and_halt(event_t* flush_done) {
     DEBUG_ASSERT(arch_ints_disabled());
     event_signal(flush_done, false);
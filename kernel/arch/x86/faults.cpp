@@ -419,6 +419,12 @@ static void handle_exception_types(x86_iframe_t* frame) {
         /* no return */
         break;
     }
+    case X86_INT_POSTED_INTERRUPT: {
+        // Arrived while the VCPU was not running, its interrupts are picked
+        // up on the next VM entry.
+        apic_issue_eoi();
+        break;
+    }
     case X86_INT_APIC_PMI: {
         apic_pmi_interrupt_handler(frame);
         // Note: apic_pmi_interrupt_handler calls apic_issue_eoi().
@@ -475,6 +481,10 @@ void x86_exception_handler(x86_iframe_t* frame) {
 
     /* if we came from user space, check to see if we have any signals to handle */
     if (unlikely(from_user)) {
+        /* a sample may have asked for the user stack, which can only be read here */
+        if (frame->vector == X86_INT_APIC_PMI)
+            apic_pmi_collect_user_callstack();
+
         /* in the case of receiving a kill signal, this function may not return,
          * but the scheduler would have been invoked so it's fine.
          */
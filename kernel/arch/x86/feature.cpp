@@ -264,6 +264,7 @@ void x86_feature_debug(void) {
         {X86_FEATURE_SMEP, "smep"},
         {X86_FEATURE_SMAP, "smap"},
         {X86_FEATURE_ERMS, "erms"},
+        {X86_FEATURE_FSRM, "fsrm"},
         {X86_FEATURE_RDRAND, "rdrand"},
         {X86_FEATURE_RDSEED, "rdseed"},
         {X86_FEATURE_UMIP, "umip"},
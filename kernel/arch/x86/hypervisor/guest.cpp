@@ -4,13 +4,17 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <arch/hypervisor.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/feature.h>
 #include <zircon/syscalls/hypervisor.h>
 
+#include "vcpu_priv.h"
+#include "vmexit_priv.h"
 #include "vmx_cpu_state_priv.h"
 
-static void ignore_msr(VmxPage* msr_bitmaps_page, bool ignore_writes, uint32_t msr) {
+static void ignore_msr_access(VmxPage* msr_bitmaps_page, bool ignore_reads, bool ignore_writes,
+                              uint32_t msr) {
     // From Volume 3, Section 24.6.9.
     uint8_t* msr_bitmaps = msr_bitmaps_page->VirtualAddress<uint8_t>();
     if (msr >= 0xc0000000) {
@@ -21,8 +25,10 @@ static void ignore_msr(VmxPage* msr_bitmaps_page, bool ignore_writes, uint32_t m
     uint16_t msr_byte = msr_low / 8;
     uint8_t msr_bit = msr_low % 8;
 
-    // Ignore reads to the MSR.
-    msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
+    if (ignore_reads) {
+        // Ignore reads to the MSR.
+        msr_bitmaps[msr_byte] &= (uint8_t) ~(1 << msr_bit);
+    }
 
     if (ignore_writes) {
         // Ignore writes to the MSR.
@@ -31,6 +37,15 @@ static void ignore_msr(VmxPage* msr_bitmaps_page, bool ignore_writes, uint32_t m
     }
 }
 
+static void ignore_msr(VmxPage* msr_bitmaps_page, bool ignore_writes, uint32_t msr) {
+    ignore_msr_access(msr_bitmaps_page, true, ignore_writes, msr);
+}
+
+static void ignore_x2apic_msr(VmxPage* msr_bitmaps_page, bool ignore_reads, bool ignore_writes,
+                              X2ApicMsr msr) {
+    ignore_msr_access(msr_bitmaps_page, ignore_reads, ignore_writes, static_cast<uint32_t>(msr));
+}
+
 // static
 zx_status_t Guest::Create(fbl::unique_ptr<Guest>* out) {
     // Check that the CPU supports VMX.
@@ -75,6 +90,25 @@ zx_status_t Guest::Create(fbl::unique_ptr<Guest>* out) {
     ignore_msr(&guest->msr_bitmaps_page_, true, X86_MSR_IA32_SYSENTER_ESP);
     ignore_msr(&guest->msr_bitmaps_page_, true, X86_MSR_IA32_SYSENTER_EIP);
 
+    // With virtual-interrupt delivery, the processor completes TPR, EOI and
+    // self-IPI writes against the virtual-APIC page, so they need not exit.
+    // Every other x2APIC write must still exit, as it would otherwise reach
+    // the physical local APIC. See Volume 3, Section 29.5.
+    guest->virtual_interrupt_delivery_ = virtual_interrupt_delivery_supported();
+    if (guest->virtual_interrupt_delivery_) {
+        ignore_x2apic_msr(&guest->msr_bitmaps_page_, true, true, X2ApicMsr::TPR);
+        ignore_x2apic_msr(&guest->msr_bitmaps_page_, false, true, X2ApicMsr::EOI);
+        ignore_x2apic_msr(&guest->msr_bitmaps_page_, false, true, X2ApicMsr::SELF_IPI);
+
+        if (apic_register_virtualization_supported()) {
+            // The ISR, TMR and IRR are then kept in the virtual-APIC page.
+            for (uint32_t msr = static_cast<uint32_t>(X2ApicMsr::ISR_31_0);
+                 msr <= static_cast<uint32_t>(X2ApicMsr::IRR_255_224); msr++) {
+                ignore_msr_access(&guest->msr_bitmaps_page_, true, false, msr);
+            }
+        }
+    }
+
     // Setup VPID allocator
     fbl::AutoLock lock(&guest->vcpu_mutex_);
     status = guest->vpid_allocator_.Init();
@@ -91,7 +125,8 @@ Guest::~Guest() {
 }
 
 zx_status_t Guest::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
-                           fbl::RefPtr<PortDispatcher> port, uint64_t key) {
+                           fbl::RefPtr<PortDispatcher> port, fbl::RefPtr<EventDispatcher> event,
+                           uint64_t key) {
     if (len == 0) {
         return ZX_ERR_INVALID_ARGS;
     } else if (SIZE_MAX - len < addr) {
@@ -100,22 +135,22 @@ zx_status_t Guest::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
 
     switch (kind) {
     case ZX_GUEST_TRAP_MEM:
-        if (port) {
+        if (port || event) {
             return ZX_ERR_INVALID_ARGS;
         }
         break;
     case ZX_GUEST_TRAP_BELL:
-        if (!port) {
+        if (!port == !event) {
             return ZX_ERR_INVALID_ARGS;
         }
         break;
     case ZX_GUEST_TRAP_IO:
-        if (port) {
+        if (port || event) {
             return ZX_ERR_INVALID_ARGS;
         } else if (addr + len > UINT16_MAX) {
             return ZX_ERR_OUT_OF_RANGE;
         }
-        return traps_.InsertTrap(kind, addr, len, fbl::move(port), key);
+        return traps_.InsertTrap(kind, addr, len, fbl::move(port), fbl::move(event), key);
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -128,7 +163,7 @@ zx_status_t Guest::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
     if (status != ZX_OK) {
         return status;
     }
-    return traps_.InsertTrap(kind, addr, len, fbl::move(port), key);
+    return traps_.InsertTrap(kind, addr, len, fbl::move(port), fbl::move(event), key);
 }
 
 zx_status_t Guest::AllocVpid(uint16_t* vpid) {
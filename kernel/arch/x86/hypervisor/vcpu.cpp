@@ -7,8 +7,11 @@
 #include <bits.h>
 
 #include <arch/x86/descriptor.h>
+#include <arch/x86/apic.h>
 #include <arch/x86/feature.h>
+#include <arch/x86/mp.h>
 #include <arch/x86/pvclock.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <hypervisor/cpu.h>
 #include <hypervisor/ktrace.h>
@@ -270,9 +273,33 @@ static void edit_msr_list(VmxPage* msr_list_page, size_t index, uint32_t msr, ui
     entry->value = value;
 }
 
+static bool vmx_control_supported(uint32_t msr, uint32_t control) {
+    // From Volume 3, Appendix A.3.3: Bits 63:32 of the capability MSR
+    // indicate the allowed 1-settings of the controls.
+    return (BITS_SHIFT(read_msr(msr), 63, 32) & control) == control;
+}
+
+bool virtual_interrupt_delivery_supported() {
+    return vmx_control_supported(X86_MSR_IA32_VMX_PROCBASED_CTLS2,
+                                 kProcbasedCtls2VirtIntDelivery);
+}
+
+bool apic_register_virtualization_supported() {
+    return vmx_control_supported(X86_MSR_IA32_VMX_PROCBASED_CTLS2, kProcbasedCtls2ApicRegVirt);
+}
+
+bool posted_interrupts_supported() {
+    // From Volume 3, Section 26.2.1.1: Process posted interrupts requires
+    // virtual-interrupt delivery.
+    return virtual_interrupt_delivery_supported() &&
+           vmx_control_supported(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS,
+                                 kPinbasedCtlsPostedInterrupts);
+}
+
 static zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entry,
                              paddr_t msr_bitmaps_address, paddr_t pml4_address, VmxState* vmx_state,
-                             VmxPage* host_msr_page, VmxPage* guest_msr_page) {
+                             VmxPage* host_msr_page, VmxPage* guest_msr_page,
+                             LocalApicState* local_apic_state) {
     zx_status_t status = vmclear(vmcs_address);
     if (status != ZX_OK)
         return status;
@@ -304,6 +331,30 @@ static zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entr
                     kProcbasedCtls2Invpcid,
                     0);
 
+    if (local_apic_state->virtual_interrupt_delivery) {
+        // Enable virtual-interrupt delivery, so that interrupts are delivered
+        // and EOIs are completed through the virtual-APIC page.
+        status = vmcs.SetControl(VmcsField32::PROCBASED_CTLS2,
+                                 read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2),
+                                 vmcs.Read(VmcsField32::PROCBASED_CTLS2),
+                                 kProcbasedCtls2VirtIntDelivery,
+                                 0);
+        if (status != ZX_OK)
+            return status;
+
+        // The guest's MSR bitmaps let APIC register reads through if it is
+        // available, so APIC-register virtualization must then be enabled.
+        if (apic_register_virtualization_supported()) {
+            status = vmcs.SetControl(VmcsField32::PROCBASED_CTLS2,
+                                     read_msr(X86_MSR_IA32_VMX_PROCBASED_CTLS2),
+                                     vmcs.Read(VmcsField32::PROCBASED_CTLS2),
+                                     kProcbasedCtls2ApicRegVirt,
+                                     0);
+            if (status != ZX_OK)
+                return status;
+        }
+    }
+
     // Setup pin-based VMCS controls.
     status = vmcs.SetControl(VmcsField32::PINBASED_CTLS,
                              read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS),
@@ -316,6 +367,18 @@ static zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entr
     if (status != ZX_OK)
         return status;
 
+    if (local_apic_state->posted_interrupt_page.IsAllocated()) {
+        // Process posted interrupts, so that they are delivered to a running
+        // guest without a VM exit.
+        status = vmcs.SetControl(VmcsField32::PINBASED_CTLS,
+                                 read_msr(X86_MSR_IA32_VMX_TRUE_PINBASED_CTLS),
+                                 vmcs.Read(VmcsField32::PINBASED_CTLS),
+                                 kPinbasedCtlsPostedInterrupts,
+                                 0);
+        if (status != ZX_OK)
+            return status;
+    }
+
     // Setup primary processor-based VMCS controls.
     status = vmcs.SetControl(VmcsField32::PROCBASED_CTLS,
                              read_msr(X86_MSR_IA32_VMX_TRUE_PROCBASED_CTLS),
@@ -464,6 +527,32 @@ static zx_status_t vmcs_init(paddr_t vmcs_address, uint16_t vpid, uintptr_t entr
     vmcs.Write(VmcsField64::ENTRY_MSR_LOAD_ADDRESS, guest_msr_page->PhysicalAddress());
     vmcs.Write(VmcsField32::ENTRY_MSR_LOAD_COUNT, 6);
 
+    // Setup local APIC virtualization.
+    //
+    // From Volume 3, Section 29.1: The virtual-APIC page is used by TPR
+    // shadowing, and by virtual-interrupt delivery to hold the virtual IRR
+    // and ISR.
+    vmcs.Write(VmcsField64::VIRTUAL_APIC_ADDRESS,
+               local_apic_state->virtual_apic_page.PhysicalAddress());
+    if (local_apic_state->virtual_interrupt_delivery) {
+        // From Volume 3, Section 29.1.3: Only EOIs of vectors set in the EOI
+        // exit bitmap cause a VM exit. We have no use for them.
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_0, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_1, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_2, 0);
+        vmcs.Write(VmcsField64::EOI_EXIT_BITMAP_3, 0);
+        vmcs.Write(VmcsField16::GUEST_INTERRUPT_STATUS, 0);
+    }
+    if (local_apic_state->posted_interrupt_page.IsAllocated()) {
+        // From Volume 3, Section 29.6: An external interrupt with the
+        // notification vector that arrives while the guest is running moves
+        // the posted interrupts into the virtual IRR, without a VM exit. It
+        // must differ from the vector used to force a VM exit.
+        vmcs.Write(VmcsField16::POSTED_INTERRUPT_NOTIFICATION_VECTOR, X86_INT_POSTED_INTERRUPT);
+        vmcs.Write(VmcsField64::POSTED_INTERRUPT_DESC_ADDRESS,
+                   local_apic_state->posted_interrupt_page.PhysicalAddress());
+    }
+
     // Setup VMCS host state.
     //
     // NOTE: We are pinned to a thread when executing this function, therefore
@@ -669,13 +758,25 @@ zx_status_t Vcpu::Create(Guest* guest, zx_vaddr_t entry, fbl::unique_ptr<Vcpu>*
     status = vcpu->vmcs_page_.Alloc(vmx_info, 0);
     if (status != ZX_OK)
         return status;
+
+    status = vcpu->local_apic_state_.virtual_apic_page.Alloc(vmx_info, 0);
+    if (status != ZX_OK)
+        return status;
+
+    vcpu->local_apic_state_.virtual_interrupt_delivery = guest->VirtualInterruptDelivery();
+    if (vcpu->local_apic_state_.virtual_interrupt_delivery && posted_interrupts_supported()) {
+        status = vcpu->local_apic_state_.posted_interrupt_page.Alloc(vmx_info, 0);
+        if (status != ZX_OK)
+            return status;
+    }
     auto_call.cancel();
 
     VmxRegion* region = vcpu->vmcs_page_.VirtualAddress<VmxRegion>();
     region->revision_id = vmx_info.revision_id;
     zx_paddr_t table = gpas->arch_aspace()->arch_table_phys();
     status = vmcs_init(vcpu->vmcs_page_.PhysicalAddress(), vpid, entry, guest->MsrBitmapsAddress(),
-                       table, &vcpu->vmx_state_, &vcpu->host_msr_page_, &vcpu->guest_msr_page_);
+                       table, &vcpu->vmx_state_, &vcpu->host_msr_page_, &vcpu->guest_msr_page_,
+                       &vcpu->local_apic_state_);
     if (status != ZX_OK)
         return status;
 
@@ -699,8 +800,74 @@ Vcpu::~Vcpu() {
     DEBUG_ASSERT(status == ZX_OK);
 }
 
+uint32_t* virtual_apic_register(LocalApicState* local_apic_state, size_t offset) {
+    DEBUG_ASSERT(offset < PAGE_SIZE && offset % sizeof(uint32_t) == 0);
+    return reinterpret_cast<uint32_t*>(
+        local_apic_state->virtual_apic_page.VirtualAddress<uint8_t>() + offset);
+}
+
+static PostedInterruptDescriptor* posted_interrupt_descriptor(LocalApicState* local_apic_state) {
+    return local_apic_state->posted_interrupt_page.VirtualAddress<PostedInterruptDescriptor>();
+}
+
+bool local_apic_take_posted(LocalApicState* local_apic_state) {
+    if (!local_apic_state->posted_interrupt_page.IsAllocated()) {
+        return false;
+    }
+    PostedInterruptDescriptor* pid = posted_interrupt_descriptor(local_apic_state);
+    // Clear the outstanding notification first, so that an interrupt posted
+    // after we have looked at its word sends a new notification.
+    pid->control.fetch_and(~kPostedInterruptOutstanding);
+    bool taken = false;
+    for (uint32_t i = 0; i < fbl::count_of(pid->pir); i++) {
+        uint64_t requests = pid->pir[i].exchange(0);
+        while (requests != 0) {
+            uint32_t bit = __builtin_ctzl(requests);
+            requests &= requests - 1;
+            local_apic_state->interrupt_tracker.Interrupt(i * 64 + bit, nullptr);
+            taken = true;
+        }
+    }
+    return taken;
+}
+
+// Moves pending interrupts into the virtual IRR, from where the processor
+// delivers them once the guest is able to take them. Exceptions are still
+// injected, one per VM entry.
+static zx_status_t local_apic_deliver_virtual(AutoVmcs* vmcs, LocalApicState* local_apic_state) {
+    local_apic_take_posted(local_apic_state);
+
+    uint32_t vector;
+    zx_status_t status;
+    uint16_t interrupt_status = vmcs->Read(VmcsField16::GUEST_INTERRUPT_STATUS);
+    uint16_t requesting_vector = interrupt_status & UINT8_MAX;
+    while ((status = local_apic_state->interrupt_tracker.Pop(&vector)) == ZX_OK) {
+        if (vector < X86_INT_PLATFORM_BASE) {
+            // Vectors pop in descending order, so this is the last one.
+            vmcs->IssueInterrupt(vector);
+            break;
+        }
+        uint32_t* irr = virtual_apic_register(local_apic_state, kVirtualApicIrr + vector / 32 * 16);
+        *irr |= 1u << (vector % 32);
+        requesting_vector = fbl::max<uint16_t>(requesting_vector, static_cast<uint16_t>(vector));
+    }
+
+    // From Volume 3, Section 29.2.1: RVI is the highest vector in the virtual
+    // IRR, and is evaluated for delivery on VM entry.
+    uint16_t new_interrupt_status =
+        static_cast<uint16_t>((interrupt_status & ~UINT8_MAX) | requesting_vector);
+    if (new_interrupt_status != interrupt_status) {
+        vmcs->Write(VmcsField16::GUEST_INTERRUPT_STATUS, new_interrupt_status);
+    }
+    return status == ZX_ERR_NOT_FOUND ? ZX_OK : status;
+}
+
 // Injects an interrupt into the guest, if there is one pending.
 static zx_status_t local_apic_maybe_interrupt(AutoVmcs* vmcs, LocalApicState* local_apic_state) {
+    if (local_apic_state->virtual_interrupt_delivery) {
+        return local_apic_deliver_virtual(vmcs, local_apic_state);
+    }
+
     uint32_t vector;
     zx_status_t status = local_apic_state->interrupt_tracker.Pop(&vector);
     if (status != ZX_OK) {
@@ -737,6 +904,10 @@ zx_status_t Vcpu::Resume(zx_port_packet_t* packet) {
         // Updates guest system time if the guest subscribed to updates.
         pvclock_update_system_time(&pvclock_state_, guest_->AddressSpace());
 
+        // The PCID this thread's aspace runs under can change whenever it is
+        // switched out, so refresh the CR3 a VM exit restores.
+        vmcs.Write(VmcsFieldXX::HOST_CR3, x86_get_cr3());
+
         ktrace(TAG_VCPU_ENTER, 0, 0, 0, 0);
         running_.store(true);
         status = vmx_enter(&vmx_state_);
@@ -772,6 +943,29 @@ void vmx_exit(VmxState* vmx_state) {
 }
 
 zx_status_t Vcpu::Interrupt(uint32_t vector) {
+    if (local_apic_state_.posted_interrupt_page.IsAllocated() &&
+        vector >= X86_INT_PLATFORM_BASE && vector < X86_INT_COUNT && running_.load()) {
+        // Post the interrupt, and notify the VCPU unless a notification is
+        // already outstanding. The processor then delivers it without a VM exit.
+        PostedInterruptDescriptor* pid = posted_interrupt_descriptor(&local_apic_state_);
+        pid->pir[vector / 64].fetch_or(1ul << (vector % 64));
+        uint64_t control = pid->control.fetch_or(kPostedInterruptOutstanding);
+        if (!(control & kPostedInterruptOutstanding)) {
+            apic_send_ipi(X86_INT_POSTED_INTERRUPT,
+                          x86_cpu_num_to_apic_id(hypervisor::cpu_of(vpid_)), DELIVERY_MODE_FIXED);
+        }
+        if (running_.load()) {
+            return ZX_OK;
+        }
+        // The VCPU exited before the interrupt was delivered, and may be about
+        // to wait for one. Move it to the interrupt tracker, where it looks,
+        // and force a VM exit if the VCPU has since been resumed.
+        if (local_apic_take_posted(&local_apic_state_) && running_.load()) {
+            mp_interrupt(MP_IPI_TARGET_MASK, cpu_num_to_mask(hypervisor::cpu_of(vpid_)));
+        }
+        return ZX_OK;
+    }
+
     bool signaled = false;
     zx_status_t status = local_apic_state_.interrupt_tracker.Interrupt(vector, &signaled);
     if (status != ZX_OK) {
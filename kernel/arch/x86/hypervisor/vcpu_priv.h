@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <fbl/atomic.h>
 #include <hypervisor/state_invalidator.h>
 
 // clang-format off
@@ -26,6 +27,8 @@ static const uint32_t kProcbasedCtls2Rdtscp             = 1u << 3;
 static const uint32_t kProcbasedCtls2x2Apic             = 1u << 4;
 static const uint32_t kProcbasedCtls2Vpid               = 1u << 5;
 static const uint32_t kProcbasedCtls2UnrestrictedGuest  = 1u << 7;
+static const uint32_t kProcbasedCtls2ApicRegVirt        = 1u << 8;
+static const uint32_t kProcbasedCtls2VirtIntDelivery    = 1u << 9;
 static const uint32_t kProcbasedCtls2Invpcid            = 1u << 12;
 
 // PROCBASED_CTLS flags.
@@ -44,6 +47,7 @@ static const uint32_t kProcbasedCtlsProcbasedCtls2      = 1u << 31;
 // PINBASED_CTLS flags.
 static const uint32_t kPinbasedCtlsExtIntExiting        = 1u << 0;
 static const uint32_t kPinbasedCtlsNmiExiting           = 1u << 3;
+static const uint32_t kPinbasedCtlsPostedInterrupts     = 1u << 7;
 
 // EXIT_CTLS flags.
 static const uint32_t kExitCtls64bitMode                = 1u << 9;
@@ -86,11 +90,20 @@ static const uint32_t kGuestXxAccessRightsDefault       = kGuestXxAccessRightsTy
 static const uint32_t kInterruptibilityStiBlocking      = 1u << 0;
 static const uint32_t kInterruptibilityMovSsBlocking    = 1u << 1;
 
+// Virtual-APIC page register offsets. See Volume 3, Section 29.1.
+static const size_t kVirtualApicPpr                     = 0x0a0;
+static const size_t kVirtualApicIrr                     = 0x200;
+
+// Posted-interrupt descriptor control flags.
+static const uint64_t kPostedInterruptOutstanding       = 1u << 0;
+
 // VMCS fields.
 enum class VmcsField16 : uint64_t {
     VPID                                                = 0x0000,
+    POSTED_INTERRUPT_NOTIFICATION_VECTOR                = 0x0002,
     GUEST_CS_SELECTOR                                   = 0x0802,
     GUEST_TR_SELECTOR                                   = 0x080e,
+    GUEST_INTERRUPT_STATUS                              = 0x0810,
     HOST_ES_SELECTOR                                    = 0x0c00,
     HOST_CS_SELECTOR                                    = 0x0c02,
     HOST_SS_SELECTOR                                    = 0x0c04,
@@ -105,7 +118,13 @@ enum class VmcsField64 : uint64_t {
     EXIT_MSR_STORE_ADDRESS                              = 0x2006,
     EXIT_MSR_LOAD_ADDRESS                               = 0x2008,
     ENTRY_MSR_LOAD_ADDRESS                              = 0x200a,
+    VIRTUAL_APIC_ADDRESS                                = 0x2012,
+    POSTED_INTERRUPT_DESC_ADDRESS                       = 0x2016,
     EPT_POINTER                                         = 0x201a,
+    EOI_EXIT_BITMAP_0                                   = 0x201c,
+    EOI_EXIT_BITMAP_1                                   = 0x201e,
+    EOI_EXIT_BITMAP_2                                   = 0x2020,
+    EOI_EXIT_BITMAP_3                                   = 0x2022,
     GUEST_PHYSICAL_ADDRESS                              = 0x2400,
     LINK_POINTER                                        = 0x2800,
     GUEST_IA32_PAT                                      = 0x2804,
@@ -209,6 +228,17 @@ enum class InvEpt : uint64_t {
 
 // clang-format on
 
+// Posted-interrupt descriptor. See Volume 3, Section 29.6.
+struct PostedInterruptDescriptor {
+    // Posted-interrupt requests, one bit for each vector.
+    fbl::atomic<uint64_t> pir[4];
+    fbl::atomic<uint64_t> control;
+    uint64_t reserved[3];
+};
+static_assert(sizeof(PostedInterruptDescriptor) == 64, "");
+
+struct LocalApicState;
+
 // Loads a VMCS within a given scope.
 class AutoVmcs : public hypervisor::StateInvalidator {
 public:
@@ -247,3 +277,19 @@ private:
 };
 
 bool cr0_is_invalid(AutoVmcs* vmcs, uint64_t cr0_value);
+
+// Whether the processor can deliver interrupts through the virtual-APIC page,
+// and complete EOIs there, without VM exits.
+bool virtual_interrupt_delivery_supported();
+// Whether guest reads of the local APIC can be served from the virtual-APIC
+// page.
+bool apic_register_virtualization_supported();
+// Whether the processor can deliver interrupts to a running guest without a
+// VM exit.
+bool posted_interrupts_supported();
+
+// Returns the 32-bit register at |offset| within the virtual-APIC page.
+uint32_t* virtual_apic_register(LocalApicState* local_apic_state, size_t offset);
+// Moves interrupts that were posted to the VCPU into its interrupt tracker, and
+// returns whether there were any.
+bool local_apic_take_posted(LocalApicState* local_apic_state);
@@ -340,6 +340,18 @@ static zx_status_t handle_cpuid(const ExitInfo& exit_info, AutoVmcs* vmcs,
 static zx_status_t handle_hlt(const ExitInfo& exit_info, AutoVmcs* vmcs,
                               LocalApicState* local_apic_state) {
     next_rip(exit_info, vmcs);
+    if (local_apic_state->virtual_interrupt_delivery) {
+        // From Volume 3, Section 29.2.2: A virtual interrupt is delivered if
+        // the priority class of RVI is above that of VPPR. One may already be
+        // pending, held off until after the HLT by a preceding STI.
+        uint8_t rvi = vmcs->Read(VmcsField16::GUEST_INTERRUPT_STATUS) & UINT8_MAX;
+        uint32_t vppr = *virtual_apic_register(local_apic_state, kVirtualApicPpr);
+        if ((rvi >> 4) > ((vppr >> 4) & 0xf)) {
+            return ZX_OK;
+        }
+        // Interrupts posted while the guest was running are not yet tracked.
+        local_apic_take_posted(local_apic_state);
+    }
     return local_apic_state->interrupt_tracker.Wait(vmcs);
 }
 
@@ -508,11 +520,20 @@ static zx_status_t handle_apic_rdmsr(const ExitInfo& exit_info, AutoVmcs* vmcs,
         next_rip(exit_info, vmcs);
         guest_state->rax = 0xff;
         return ZX_OK;
-    case X2ApicMsr::TPR:
-    case X2ApicMsr::LDR:
     case X2ApicMsr::ISR_31_0... X2ApicMsr::ISR_255_224:
     case X2ApicMsr::TMR_31_0... X2ApicMsr::TMR_255_224:
     case X2ApicMsr::IRR_31_0... X2ApicMsr::IRR_255_224:
+        if (local_apic_state->virtual_interrupt_delivery) {
+            // Each x2APIC MSR corresponds to a 16-byte aligned register of
+            // the virtual-APIC page. See Volume 3, Section 10.12.1.2.
+            next_rip(exit_info, vmcs);
+            size_t offset = (guest_state->rcx - kX2ApicMsrBase) << 4;
+            guest_state->rax = *virtual_apic_register(local_apic_state, offset);
+            return ZX_OK;
+        }
+        __FALLTHROUGH;
+    case X2ApicMsr::TPR:
+    case X2ApicMsr::LDR:
     case X2ApicMsr::ESR:
     case X2ApicMsr::LVT_MONITOR:
         // These registers reset to 0. See Volume 3 Section 10.12.5.1.
@@ -905,6 +926,8 @@ static zx_status_t handle_trap(const ExitInfo& exit_info, AutoVmcs* vmcs, bool r
     case ZX_GUEST_TRAP_BELL:
         if (read)
             return ZX_ERR_NOT_SUPPORTED;
+        if (trap->HasEvent())
+            return trap->Signal(vmcs);
         *packet = {};
         packet->key = trap->key();
         packet->type = ZX_PKT_TYPE_GUEST_BELL;
@@ -54,6 +54,10 @@ struct arch_thread {
      * As normally the CPU only changes DR6, the |debug_state| will be up to date anyway. */
     bool track_debug_state;
     x86_debug_state_t debug_state;
+
+    /* Intel PT state to load while this thread runs, if it is being traced in
+     * IPT_TRACE_THREADS mode. Guarded by thread_lock; see proc_trace.cpp. */
+    void *ipt_trace_state;
 };
 
 static inline void x86_set_suspended_general_regs(struct arch_thread *thread,
@@ -96,6 +96,12 @@ public:
 
     int active_cpus() { return active_cpus_.load(); }
 
+    // Records that some of this aspace's translations have been invalidated.
+    // Must be called before the set of active cpus is sampled to decide who
+    // to shoot down, so that a cpu holding the aspace's entries under an
+    // inactive PCID notices the change when it next switches in.
+    void BumpTlbGeneration() { tlb_generation_.fetch_add(1); }
+
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
     static void ContextSwitch(X86ArchVmAspace* from, X86ArchVmAspace* to);
@@ -129,6 +135,14 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // Identifies this aspace to the per-cpu PCID caches.  Never reused, so a
+    // cache entry cannot outlive its aspace and match a new one.  Zero for
+    // the kernel and guest aspaces, which do not get a PCID.
+    uint64_t pcid_id_ = 0;
+
+    // Incremented by BumpTlbGeneration().
+    fbl::atomic<uint64_t> tlb_generation_{0};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
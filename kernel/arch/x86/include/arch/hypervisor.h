@@ -39,11 +39,13 @@ public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Guest);
 
     zx_status_t SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
-                        fbl::RefPtr<PortDispatcher> port, uint64_t key);
+                        fbl::RefPtr<PortDispatcher> port, fbl::RefPtr<EventDispatcher> event,
+                        uint64_t key);
 
     hypervisor::GuestPhysicalAddressSpace* AddressSpace() const { return gpas_.get(); }
     hypervisor::TrapMap* Traps() { return &traps_; }
     zx_paddr_t MsrBitmapsAddress() const { return msr_bitmaps_page_.PhysicalAddress(); }
+    bool VirtualInterruptDelivery() const { return virtual_interrupt_delivery_; }
 
     zx_status_t AllocVpid(uint16_t* vpid);
     zx_status_t FreeVpid(uint16_t vpid);
@@ -52,6 +54,9 @@ private:
     fbl::unique_ptr<hypervisor::GuestPhysicalAddressSpace> gpas_;
     hypervisor::TrapMap traps_;
     VmxPage msr_bitmaps_page_;
+    // Whether the MSR bitmaps let the guest's TPR, EOI and self-IPI writes
+    // through to the virtual-APIC page.
+    bool virtual_interrupt_delivery_ = false;
 
     fbl::Mutex vcpu_mutex_;
     // TODO(alexlegg): Find a good place for this constant to live (max VCPUs).
@@ -70,6 +75,15 @@ struct LocalApicState {
     uint32_t lvt_timer = LVT_MASKED; // Initial state is masked (Vol 3 Section 10.12.5.1).
     uint32_t lvt_initial_count;
     uint32_t lvt_divide_config;
+    // Virtual-APIC page, backing the TPR shadow and, with virtual-interrupt
+    // delivery, the IRR and ISR seen by the guest.
+    VmxPage virtual_apic_page;
+    // Whether interrupts are delivered through the virtual-APIC page, rather
+    // than injected on VM entry.
+    bool virtual_interrupt_delivery = false;
+    // Posted-interrupt descriptor, if interrupts can be delivered to the VCPU
+    // while it is running.
+    VmxPage posted_interrupt_page;
 };
 
 // System time is time since boot time and boot time is some fixed point in the past. This
@@ -57,6 +57,13 @@ void apic_send_ipi(
     uint8_t vector,
     uint32_t dst_apic_id,
     enum apic_interrupt_delivery_mode dm);
+// Send the same IPI to |count| APICs.  With x2APIC this takes one ICR write
+// per cluster of 16 APICs rather than one per destination.
+void apic_send_multicast_ipi(
+    uint8_t vector,
+    const uint32_t* dst_apic_ids,
+    size_t count,
+    enum apic_interrupt_delivery_mode dm);
 void apic_send_self_ipi(uint8_t vector, enum apic_interrupt_delivery_mode dm);
 void apic_send_broadcast_ipi(
     uint8_t vector,
@@ -138,6 +145,13 @@ void apic_io_configure_irq_vector(
     uint32_t global_irq,
     uint8_t vector);
 uint8_t apic_io_fetch_irq_vector(uint32_t global_irq);
+// Deliver the IRQ to the Local APIC |dst| in physical destination mode.
+void apic_io_configure_irq_dst(
+    uint32_t global_irq,
+    uint8_t dst);
+// Deliver every IRQ that is physically targeted at the Local APIC |from_dst|
+// to |to_dst| instead.
+void apic_io_move_irqs_dst(uint8_t from_dst, uint8_t to_dst);
 
 void apic_io_mask_isa_irq(uint8_t isa_irq, bool mask);
 // For ISA configuration, we don't need to specify the trigger mode
@@ -161,6 +161,7 @@ void x86_feature_debug(void);
 #define X86_FEATURE_PT                  X86_CPUID_BIT(0x7, 1, 25)
 #define X86_FEATURE_UMIP                X86_CPUID_BIT(0x7, 2, 2)
 #define X86_FEATURE_PKU                 X86_CPUID_BIT(0x7, 2, 3)
+#define X86_FEATURE_FSRM                X86_CPUID_BIT(0x7, 3, 4)
 #define X86_FEATURE_IBRS_IBPB           X86_CPUID_BIT(0x7, 3, 26)
 #define X86_FEATURE_STIBP               X86_CPUID_BIT(0x7, 3, 27)
 #define X86_FEATURE_SSBD                X86_CPUID_BIT(0x7, 3, 31)
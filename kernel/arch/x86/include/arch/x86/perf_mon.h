@@ -42,4 +42,9 @@ zx_status_t x86_ipm_fini();
 
 void apic_pmi_interrupt_handler(x86_iframe_t *frame);
 
+// Collects the userspace call stack requested by the last PMI on this cpu,
+// if any. Called after the PMI, on the way back to userspace, with interrupts
+// disabled but blocking allowed.
+void apic_pmi_collect_user_callstack();
+
 #endif // __cplusplus
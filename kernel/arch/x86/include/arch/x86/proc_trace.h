@@ -21,6 +21,8 @@ __END_CDECLS
 
 #ifdef __cplusplus
 
+struct thread;
+
 typedef enum {
     IPT_TRACE_CPUS,
     IPT_TRACE_THREADS
@@ -40,4 +42,20 @@ zx_status_t x86_ipt_stage_trace_data(zx_itrace_buffer_descriptor_t descriptor,
 zx_status_t x86_ipt_get_trace_data(zx_itrace_buffer_descriptor_t descriptor,
                                    zx_x86_pt_regs_t* regs);
 
+// Trace |thread| into the buffer staged for |descriptor|, IPT_TRACE_THREADS
+// mode only. Tracing of the thread follows it from cpu to cpu while the trace
+// is started. The caller must keep |thread| alive until the buffer has been
+// released.
+zx_status_t x86_ipt_assign_thread_buffer(zx_itrace_buffer_descriptor_t descriptor,
+                                         struct thread* thread);
+
+// Stop tracing |thread| into |descriptor|'s buffer. Once this returns the
+// buffer is no longer being written to, and x86_ipt_get_trace_data() returns
+// where the thread's tracing stopped.
+zx_status_t x86_ipt_release_thread_buffer(zx_itrace_buffer_descriptor_t descriptor,
+                                          struct thread* thread);
+
+// Called from arch_context_switch() with interrupts disabled.
+void x86_ipt_context_switch(struct thread* oldthread, struct thread* newthread);
+
 #endif // __cplusplus
@@ -363,6 +363,39 @@ void apic_io_configure_irq_vector(
     apic_io_write_redirection_entry(io_apic, global_irq, reg);
 }
 
+void apic_io_configure_irq_dst(
+    uint32_t global_irq,
+    uint8_t dst) {
+    struct io_apic* io_apic = apic_io_resolve_global_irq(global_irq);
+
+    AutoSpinLock guard(&lock);
+
+    uint64_t reg = apic_io_read_redirection_entry(io_apic, global_irq);
+    reg &= ~(IO_APIC_RTE_DST(0xff) | IO_APIC_RTE_EXTENDED_DST_ID(0xf) |
+             IO_APIC_RTE_DST_MODE(DST_MODE_LOGICAL));
+    reg |= IO_APIC_RTE_DST_MODE(DST_MODE_PHYSICAL);
+    reg |= IO_APIC_RTE_DST(dst);
+    apic_io_write_redirection_entry(io_apic, global_irq, reg);
+}
+
+void apic_io_move_irqs_dst(uint8_t from_dst, uint8_t to_dst) {
+    AutoSpinLock guard(&lock);
+    for (uint32_t i = 0; i < num_io_apics; ++i) {
+        struct io_apic* apic = &io_apics[i];
+        for (uint8_t j = 0; j <= apic->max_redirection_entry; ++j) {
+            uint32_t global_irq = apic->desc.global_irq_base + j;
+            uint64_t reg = apic_io_read_redirection_entry(apic, global_irq);
+            if ((reg & IO_APIC_RTE_DST_MODE(DST_MODE_LOGICAL)) ||
+                (reg & IO_APIC_RTE_DST(0xff)) != IO_APIC_RTE_DST(from_dst)) {
+                continue;
+            }
+            reg &= ~IO_APIC_RTE_DST(0xff);
+            reg |= IO_APIC_RTE_DST(to_dst);
+            apic_io_write_redirection_entry(apic, global_irq, reg);
+        }
+    }
+}
+
 uint8_t apic_io_fetch_irq_vector(uint32_t global_irq) {
     struct io_apic* io_apic = apic_io_resolve_global_irq(global_irq);
 
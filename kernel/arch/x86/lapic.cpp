@@ -74,6 +74,7 @@ static bool bsp_apic_id_valid;
 #define ICR_DST(x) (((uint32_t)(x)) << 24)
 #define ICR_DST_BROADCAST ICR_DST(0xff)
 #define ICR_DELIVERY_MODE(x) (((uint32_t)(x)) << 8)
+#define ICR_DST_LOGICAL (1 << 11)
 #define ICR_DST_SHORTHAND(x) (((uint32_t)(x)) << 18)
 #define ICR_DST_SELF ICR_DST_SHORTHAND(1)
 #define ICR_DST_ALL ICR_DST_SHORTHAND(2)
@@ -82,6 +83,15 @@ static bool bsp_apic_id_valid;
 #define X2_ICR_DST(x) ((uint64_t)(x) << 32)
 #define X2_ICR_BROADCAST ((uint64_t)(0xffffffff) << 32)
 
+// In x2APIC mode the logical destination of each APIC is fixed by its ID: bits
+// 19:4 pick a cluster and the low 4 bits a member of it (Intel SDM
+// 10.12.10.2).  One logical IPI can target any subset of a cluster.  APICs
+// with larger IDs can only be reached by physical destination.
+#define X2_CLUSTER(apic_id) ((apic_id) >> 4)
+#define X2_CLUSTER_MEMBER(apic_id) (1u << ((apic_id) & 0xf))
+#define X2_LOGICAL_DST(cluster, members) (((uint32_t)(cluster) << 16) | (members))
+#define X2_MAX_LOGICAL_ID ((1u << 20) - 1)
+
 // Common LVT bitmasks
 #define LVT_VECTOR(x) (x)
 #define LVT_DELIVERY_MODE(x) (((uint32_t)(x)) << 8)
@@ -223,6 +233,52 @@ void apic_send_ipi(
     arch_interrupt_restore(state, 0);
 }
 
+void apic_send_multicast_ipi(
+    uint8_t vector,
+    const uint32_t* dst_apic_ids,
+    size_t count,
+    enum apic_interrupt_delivery_mode dm) {
+    if (!x2apic_enabled) {
+        for (size_t i = 0; i < count; ++i) {
+            apic_send_ipi(vector, dst_apic_ids[i], dm);
+        }
+        return;
+    }
+
+    uint32_t request = ICR_VECTOR(vector) | ICR_LEVEL_ASSERT;
+    request |= ICR_DELIVERY_MODE(dm);
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, 0);
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t id = dst_apic_ids[i];
+        if (id > X2_MAX_LOGICAL_ID) {
+            write_msr(LAPIC_X2APIC_MSR_ICR, X2_ICR_DST(id) | request);
+            continue;
+        }
+        // Each cluster is sent to once, from the first of its members in the
+        // list.  The list is at most one entry per CPU, so the rescans are cheap.
+        bool sent = false;
+        for (size_t j = 0; j < i && !sent; ++j) {
+            sent = dst_apic_ids[j] <= X2_MAX_LOGICAL_ID &&
+                   X2_CLUSTER(dst_apic_ids[j]) == X2_CLUSTER(id);
+        }
+        if (sent) {
+            continue;
+        }
+        uint32_t members = 0;
+        for (size_t j = i; j < count; ++j) {
+            if (X2_CLUSTER(dst_apic_ids[j]) == X2_CLUSTER(id)) {
+                members |= X2_CLUSTER_MEMBER(dst_apic_ids[j]);
+            }
+        }
+        write_msr(LAPIC_X2APIC_MSR_ICR,
+                  X2_ICR_DST(X2_LOGICAL_DST(X2_CLUSTER(id), members)) |
+                      request | ICR_DST_LOGICAL);
+    }
+    arch_interrupt_restore(state, 0);
+}
+
 void apic_send_self_ipi(uint8_t vector, enum apic_interrupt_delivery_mode dm) {
     uint32_t request = ICR_VECTOR(vector) | ICR_LEVEL_ASSERT;
     request |= ICR_DELIVERY_MODE(dm) | ICR_DST_SELF;
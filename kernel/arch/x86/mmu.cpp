@@ -16,7 +16,12 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <kernel/align.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
@@ -69,6 +74,30 @@ paddr_t x86_kernel_cr3(void) {
     return kernel_pt_phys;
 }
 
+/* Whether user aspaces are given PCIDs (see x86_pcid_cr3).  Set once in
+ * x86_mmu_init, before any user aspace is switched to. */
+static bool use_pcid = false;
+
+/* Number of PCIDs each cpu hands out to user aspaces.  PCID 0 is used for the
+ * kernel aspace and, when PCIDs are disabled, for everything. */
+static constexpr uint kNumUserPcids = 6;
+
+/* The user aspaces a cpu currently has PCIDs assigned to.  Slot i holds
+ * PCID i + 1.  Only touched by its own cpu, with interrupts disabled. */
+struct PcidCache {
+    struct Slot {
+        uint64_t aspace_id;
+        /* The aspace's TLB generation when this cpu last flushed the PCID. */
+        uint64_t tlb_generation;
+        uint64_t last_used;
+    } slot[kNumUserPcids];
+    uint64_t clock;
+} __CPU_ALIGN;
+static PcidCache pcid_cache[SMP_MAX_CPUS];
+
+/* Source of X86ArchVmAspace::pcid_id_. */
+static fbl::atomic<uint64_t> next_pcid_aspace_id(1);
+
 /**
  * @brief  check if the virtual address is canonical
  */
@@ -120,7 +149,18 @@ bool x86_mmu_check_paddr(paddr_t paddr) {
  * @brief  invalidate all TLB entries, including global entries
  */
 static void x86_tlb_global_invalidate() {
-    /* See Intel 3A section 4.10.4.1 */
+    if (x86_feature_test(X86_FEATURE_INVPCID)) {
+        /* Type 2: all PCIDs, including global translations. */
+        struct {
+            uint64_t pcid;
+            uint64_t addr;
+        } desc = {0, 0};
+        __asm__ volatile("invpcid %0, %1" ::"m"(desc), "r"(2ul)
+                         : "memory");
+        return;
+    }
+
+    /* See Intel 3A section 4.10.4.1.  Toggling PGE also flushes every PCID. */
     ulong cr4 = x86_get_cr4();
     if (likely(cr4 & X86_CR4_PGE)) {
         x86_set_cr4(cr4 & ~X86_CR4_PGE);
@@ -137,6 +177,13 @@ static void x86_tlb_nonglobal_invalidate() {
     x86_set_cr3(x86_get_cr3());
 }
 
+KCOUNTER(tlb_shootdowns, "kernel.mmu.tlb.shootdowns");
+KCOUNTER(tlb_full_shootdowns, "kernel.mmu.tlb.full_shootdowns");
+KCOUNTER(tlb_shootdowns_skipped, "kernel.mmu.tlb.shootdowns_skipped");
+KCOUNTER(pcid_reuses, "kernel.mmu.pcid.reuses");
+KCOUNTER(pcid_stale_flushes, "kernel.mmu.pcid.stale_flushes");
+KCOUNTER(pcid_evictions, "kernel.mmu.pcid.evictions");
+
 /* Task used for invalidating a TLB entry on each CPU */
 struct TlbInvalidatePage_context {
     ulong target_cr3;
@@ -146,7 +193,7 @@ static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
+    ulong cr3 = x86_get_cr3() & ~X86_CR3_PCID_MASK;
     if (context->target_cr3 != cr3 && !context->pending->contains_global) {
         /* This invalidation doesn't apply to this CPU, ignore it */
         return;
@@ -163,6 +210,13 @@ static void TlbInvalidatePage_task(void* raw_context) {
 
     for (uint i = 0; i < context->pending->count; ++i) {
         const auto& item = context->pending->item[i];
+        if (use_pcid && context->pending->contains_global && !item.is_terminal()) {
+            /* invlpg only drops the paging-structure caches of the current
+             * PCID, but the kernel's upper-level tables are shared by every
+             * PCID, so flush them all. */
+            x86_tlb_global_invalidate();
+            return;
+        }
         switch (item.page_level()) {
             case PML4_L:
                 panic("PML4_L invld found; should not be here\n");
@@ -186,11 +240,18 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
         return;
     }
 
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+    ulong cr3 = pt ? pt->phys() : (x86_get_cr3() & ~X86_CR3_PCID_MASK);
     struct TlbInvalidatePage_context task_context = {
         .target_cr3 = cr3, .pending = pending,
     };
 
+    /* Bump the generation before sampling the active CPUs; a CPU that
+     * switches in after the sample is guaranteed to see the new generation
+     * and flush the aspace's PCID (see X86ArchVmAspace::ContextSwitch). */
+    if (pt != nullptr) {
+        static_cast<X86ArchVmAspace*>(pt->ctx())->BumpTlbGeneration();
+    }
+
     /* Target only CPUs this aspace is active on.  It may be the case that some
      * other CPU will become active in it after this load, or will have left it
      * just before this load.  In the former case, it is becoming active after
@@ -205,6 +266,20 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
         target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
     }
 
+    /* A CPU that is not running in the aspace either dropped its entries for
+     * it when it switched away, or keeps them under a PCID that the bumped
+     * generation will flush on its next switch in.  Either way, if no CPU has
+     * it loaded there is nothing to shoot down. */
+    if (target == MP_IPI_TARGET_MASK && target_mask == 0) {
+        kcounter_add(tlb_shootdowns_skipped, 1);
+        pending->clear();
+        return;
+    }
+
+    kcounter_add(tlb_shootdowns, 1);
+    if (pending->full_shootdown) {
+        kcounter_add(tlb_full_shootdowns, 1);
+    }
     mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
     pending->clear();
 }
@@ -494,7 +569,15 @@ void x86_mmu_early_init() {
     LTRACEF("paddr_width %u vaddr_width %u\n", g_paddr_width, g_vaddr_width);
 }
 
-void x86_mmu_init(void) {}
+void x86_mmu_init(void) {
+    uint32_t threshold = cmdline_get_uint32("kernel.mmu.tlb-flush-threshold",
+                                            PendingTlbInvalidation::kMaxItems);
+    PendingTlbInvalidation::full_shootdown_threshold =
+        fbl::min<uint32_t>(threshold, PendingTlbInvalidation::kMaxItems);
+
+    use_pcid = x86_feature_test(X86_FEATURE_PCID) && cmdline_get_bool("kernel.mmu.pcid", true);
+    dprintf(INFO, "MMU: %s PCIDs for user address spaces\n", use_pcid ? "using" : "not using");
+}
 
 X86PageTableBase::X86PageTableBase() {
 }
@@ -592,6 +675,8 @@ zx_status_t X86ArchVmAspace::Init(vaddr_t base, size_t size, uint mmu_flags) {
             return status;
         }
 
+        pcid_id_ = next_pcid_aspace_id.fetch_add(1);
+
         LTRACEF("user aspace: pt phys %#" PRIxPTR ", virt %p\n", pt_->phys(), pt_->virt());
     }
     fbl::atomic_init(&active_cpus_, 0);
@@ -641,9 +726,60 @@ zx_status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags
     return pt_->ProtectPages(vaddr, count, mmu_flags);
 }
 
+/**
+ * @brief Pick the CR3 value that loads |phys| under a PCID on |cpu|
+ *
+ * Reuses the PCID the cpu last gave the aspace, keeping its TLB entries, if no
+ * invalidation of the aspace has happened since they were last flushed.
+ * Otherwise the PCID's entries are flushed by the load, and on a miss the
+ * least recently used PCID is taken over.
+ */
+static ulong x86_pcid_cr3(cpu_num_t cpu, uint64_t aspace_id, uint64_t tlb_generation,
+                          paddr_t phys) {
+    PcidCache& cache = pcid_cache[cpu];
+    uint64_t now = ++cache.clock;
+    uint victim = 0;
+    for (uint i = 0; i < kNumUserPcids; ++i) {
+        PcidCache::Slot& slot = cache.slot[i];
+        if (slot.aspace_id == aspace_id) {
+            slot.last_used = now;
+            if (slot.tlb_generation == tlb_generation) {
+                kcounter_add(pcid_reuses, 1);
+                return phys | (i + 1) | X86_CR3_NOFLUSH;
+            }
+            slot.tlb_generation = tlb_generation;
+            kcounter_add(pcid_stale_flushes, 1);
+            return phys | (i + 1);
+        }
+        if (slot.last_used < cache.slot[victim].last_used) {
+            victim = i;
+        }
+    }
+
+    kcounter_add(pcid_evictions, 1);
+    cache.slot[victim] = {aspace_id, tlb_generation, now};
+    return phys | (victim + 1);
+}
+
 void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace* aspace) {
-    cpu_mask_t cpu_bit = cpu_num_to_mask(arch_curr_cpu_num());
-    if (aspace != nullptr) {
+    cpu_num_t cpu = arch_curr_cpu_num();
+    cpu_mask_t cpu_bit = cpu_num_to_mask(cpu);
+    if (aspace != nullptr && use_pcid) {
+        aspace->canary_.Assert();
+        paddr_t phys = aspace->pt_phys();
+        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
+
+        /* Become visible to shootdowns before sampling the generation, so
+         * that any invalidation this cpu's cached entries miss either
+         * targets it or is reflected in the generation. */
+        aspace->active_cpus_.fetch_or(cpu_bit);
+        uint64_t generation = aspace->tlb_generation_.load();
+        x86_set_cr3(x86_pcid_cr3(cpu, aspace->pcid_id_, generation, phys));
+
+        if (old_aspace != nullptr && old_aspace != aspace) {
+            old_aspace->active_cpus_.fetch_and(~cpu_bit);
+        }
+    } else if (aspace != nullptr) {
         aspace->canary_.Assert();
         paddr_t phys = aspace->pt_phys();
         LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
@@ -691,6 +827,11 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    /* PCIDs are only handed out once x86_mmu_init has checked the command
+     * line; until then everything runs under PCID 0, as without PCIDE.
+     * Enabling it requires CR3's PCID to be 0, which it is here. */
+    if (x86_feature_test(X86_FEATURE_PCID))
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
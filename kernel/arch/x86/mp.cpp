@@ -27,6 +27,7 @@
 #include <dev/hw_rng.h>
 #include <dev/interrupt.h>
 #include <kernel/event.h>
+#include <kernel/sched.h>
 #include <kernel/timer.h>
 #include <platform.h>
 #include <zircon/types.h>
@@ -130,6 +131,36 @@ zx_status_t x86_allocate_ap_structures(uint32_t* apic_ids, uint8_t cpu_count) {
     return ZX_OK;
 }
 
+uint32_t x86_cpu_num_to_apic_id(cpu_num_t cpu_num) {
+    return cpu_num == 0 ? bp_percpu.apic_id : ap_percpus[cpu_num - 1].apic_id;
+}
+
+uint arch_cpu_distance(cpu_num_t a, cpu_num_t b) {
+    if (a == b) {
+        return CPU_DISTANCE_SELF;
+    }
+    if (a >= x86_num_cpus || b >= x86_num_cpus) {
+        return CPU_DISTANCE_REMOTE;
+    }
+
+    x86_cpu_topology_t topo_a, topo_b;
+    x86_cpu_topology_decode(x86_cpu_num_to_apic_id(a), &topo_a);
+    x86_cpu_topology_decode(x86_cpu_num_to_apic_id(b), &topo_b);
+
+    if (topo_a.package_id != topo_b.package_id) {
+        return CPU_DISTANCE_REMOTE;
+    }
+    // the last level cache is shared by every core of a die (node), which
+    // spans the whole package on parts that do not report nodes.
+    if (topo_a.node_id != topo_b.node_id) {
+        return CPU_DISTANCE_PACKAGE;
+    }
+    if (topo_a.core_id != topo_b.core_id) {
+        return CPU_DISTANCE_CACHE;
+    }
+    return CPU_DISTANCE_SMT;
+}
+
 void x86_init_percpu(cpu_num_t cpu_num) {
     struct x86_percpu* const percpu =
         cpu_num == 0 ? &bp_percpu : &ap_percpus[cpu_num - 1];
@@ -285,7 +316,10 @@ zx_status_t arch_mp_reschedule(cpu_mask_t mask) {
         needs_ipi = mask;
     }
 
-    return needs_ipi ? arch_mp_send_ipi(MP_IPI_TARGET_MASK, needs_ipi, MP_IPI_RESCHEDULE) : ZX_OK;
+    if (needs_ipi) {
+        mp_ipi_post(needs_ipi, MP_IPI_RESCHEDULE);
+    }
+    return ZX_OK;
 }
 
 void arch_prepare_current_cpu_idle_state(bool idle) {
@@ -301,6 +335,11 @@ __NO_RETURN int arch_idle_thread_routine(void*) {
         struct x86_percpu* percpu = x86_get_percpu();
         for (;;) {
             while (*percpu->monitor) {
+                // look for work queued up on busy neighbors before going back to sleep
+                sched_idle_balance();
+                if (!*percpu->monitor) {
+                    break;
+                }
                 x86_monitor(percpu->monitor);
                 // Check percpu->monitor in case it was cleared between the first check and
                 // the monitor being armed. Any writes after arming the monitor will trigger
@@ -313,6 +352,7 @@ __NO_RETURN int arch_idle_thread_routine(void*) {
         }
     } else {
         for (;;) {
+            sched_idle_balance();
             x86_idle();
         }
     }
@@ -347,6 +387,8 @@ zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t i
 
     ASSERT(x86_num_cpus <= sizeof(mask) * CHAR_BIT);
 
+    uint32_t apic_ids[SMP_MAX_CPUS];
+    size_t num_apic_ids = 0;
     cpu_mask_t remaining = mask;
     uint cpu_id = 0;
     while (remaining && cpu_id < x86_num_cpus) {
@@ -364,13 +406,17 @@ zx_status_t arch_mp_send_ipi(mp_ipi_target_t target, cpu_mask_t mask, mp_ipi_t i
             }
             /* Make sure the CPU is actually up before sending the IPI */
             if (percpu->apic_id != INVALID_APIC_ID) {
-                apic_send_ipi(vector, (uint8_t)percpu->apic_id, DELIVERY_MODE_FIXED);
+                apic_ids[num_apic_ids++] = percpu->apic_id;
             }
         }
         remaining >>= 1;
         cpu_id++;
     }
 
+    if (num_apic_ids > 0) {
+        apic_send_multicast_ipi(vector, apic_ids, num_apic_ids, DELIVERY_MODE_FIXED);
+    }
+
     return ZX_OK;
 }
 
@@ -41,10 +41,16 @@ struct PendingTlbInvalidation {
     bool full_shootdown = false;
     // If true, at least one enqueued entry was for a global page.
     bool contains_global = false;
+    // Maximum number of addresses that can be queued individually
+    static constexpr uint kMaxItems = 32;
+    // Number of queued addresses past which the invalidation becomes a full
+    // shootdown. Never more than |kMaxItems|.
+    static uint full_shootdown_threshold;
+
     // Number of valid elements in |item|
     uint count = 0;
     // List of addresses queued for invalidation
-    Item item[32];
+    Item item[kMaxItems];
 
     // Add address |v|, translated at depth |level|, to the set of addresses to be invalidated.
     // |is_terminal| should be true iff this invalidation is targeting the final step of the translation
@@ -86,6 +86,8 @@ PageTableLevel lower_level(PageTableLevel level) {
 
 } // namespace
 
+uint PendingTlbInvalidation::full_shootdown_threshold = PendingTlbInvalidation::kMaxItems;
+
 void PendingTlbInvalidation::enqueue(vaddr_t v, PageTableLevel level, bool is_global_page,
                                      bool is_terminal) {
     if (is_global_page) {
@@ -94,7 +96,7 @@ void PendingTlbInvalidation::enqueue(vaddr_t v, PageTableLevel level, bool is_gl
 
     // We mark PML4_L entries as full shootdowns, since it's going to be
     // expensive one way or another.
-    if (count >= fbl::count_of(item) || level == PML4_L) {
+    if (count >= full_shootdown_threshold || level == PML4_L) {
         full_shootdown = true;
         return;
     }
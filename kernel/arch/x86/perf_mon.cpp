@@ -39,8 +39,10 @@
 
 #include <arch/arch_ops.h>
 #include <arch/mmu.h>
+#include <arch/user_copy.h>
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
+#include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/perf_mon.h>
@@ -258,6 +260,16 @@ struct PerfmonCpuData {
 
     // The next record to fill.
     cpuperf_record_header_t* buffer_next = nullptr;
+
+    // A userspace call stack requested by the PMI handler. The user stack
+    // can't be read from the handler itself, a page fault there is fatal, so
+    // it is collected on the way back to userspace by
+    // apic_pmi_collect_user_callstack(). |callstack_id| is
+    // CPUPERF_EVENT_ID_NONE when there is nothing to collect.
+    cpuperf_event_id_t callstack_id = CPUPERF_EVENT_ID_NONE;
+    uint64_t callstack_aspace = 0;
+    uint64_t callstack_pc = 0;
+    uint64_t callstack_fp = 0;
 } __CPU_ALIGN;
 
 struct MemoryControllerHubData {
@@ -802,6 +814,11 @@ static zx_status_t x86_ipm_verify_fixed_config(
                        " but not supported\n", i);
                 return ZX_ERR_NOT_SUPPORTED;
             }
+            if ((config->fixed_flags[i] & IPM_CONFIG_FLAG_CALLSTACK) &&
+                    !(config->fixed_flags[i] & IPM_CONFIG_FLAG_PC)) {
+                TRACEF("Call stack requested for |fixed_flags[%u]| without pc\n", i);
+                return ZX_ERR_INVALID_ARGS;
+            }
             if ((config->fixed_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) &&
                     config->timebase_id == CPUPERF_EVENT_ID_NONE) {
                 TRACEF("Timebase requested for |fixed_flags[%u]|, but not provided\n", i);
@@ -866,6 +883,11 @@ static zx_status_t x86_ipm_verify_programmable_config(
                        " but not supported\n", i);
                 return ZX_ERR_NOT_SUPPORTED;
             }
+            if ((config->programmable_flags[i] & IPM_CONFIG_FLAG_CALLSTACK) &&
+                    !(config->programmable_flags[i] & IPM_CONFIG_FLAG_PC)) {
+                TRACEF("Call stack requested for |programmable_flags[%u]| without pc\n", i);
+                return ZX_ERR_INVALID_ARGS;
+            }
             if ((config->programmable_flags[i] & IPM_CONFIG_FLAG_TIMEBASE) &&
                     config->timebase_id == CPUPERF_EVENT_ID_NONE) {
                 TRACEF("Timebase requested for |programmable_flags[%u]|, but not provided\n", i);
@@ -907,7 +929,8 @@ static zx_status_t x86_ipm_verify_misc_config(
             }
             // Currently we only support the MCHBAR events.
             // They cannot provide pc. We ignore the OS/USER bits.
-            if (config->misc_flags[i] & (IPM_CONFIG_FLAG_PC | IPM_CONFIG_FLAG_LBR)) {
+            if (config->misc_flags[i] & (IPM_CONFIG_FLAG_PC | IPM_CONFIG_FLAG_LBR |
+                                         IPM_CONFIG_FLAG_CALLSTACK)) {
                 TRACEF("Invalid bits (0x%x) in |misc_flags[%zu]|\n",
                        config->misc_flags[i], i);
                 return ZX_ERR_INVALID_ARGS;
@@ -1857,6 +1880,47 @@ static cpuperf_record_header_t* x86_perfmon_write_last_branches(
     return next;
 }
 
+// Write out a |cpuperf_callstack_record_t| record.
+static cpuperf_record_header_t* x86_perfmon_write_callstack(
+        cpuperf_record_header_t* hdr, cpuperf_event_id_t id, uint64_t aspace,
+        const uint64_t* frames, uint32_t num_frames) {
+    auto rec = reinterpret_cast<cpuperf_callstack_record_t*>(hdr);
+    DEBUG_ASSERT(num_frames > 0 && num_frames <= CPUPERF_MAX_NUM_CALLSTACK_FRAMES);
+    x86_perfmon_write_header(&rec->header, CPUPERF_RECORD_CALLSTACK, id);
+    rec->num_frames = num_frames;
+    rec->aspace = aspace;
+    memcpy(rec->frames, frames, num_frames * sizeof(frames[0]));
+
+    // Like the last branch record, this one is variable length.
+    return reinterpret_cast<cpuperf_record_header_t*>(
+        reinterpret_cast<char*>(rec) + CPUPERF_CALLSTACK_RECORD_SIZE(rec));
+}
+
+// Unwind the user stack whose innermost frame pointer is |fp| by following
+// the saved frame pointers, appending return addresses to |frames|.
+// Returns the new number of entries in |frames|.
+// Must be called with interrupts enabled: reading the stack may fault.
+static uint32_t x86_perfmon_unwind_user_stack(uint64_t fp, uint64_t* frames,
+                                              uint32_t num_frames) {
+    while (num_frames < CPUPERF_MAX_NUM_CALLSTACK_FRAMES) {
+        // The saved frame pointer and the return address.
+        uint64_t frame[2];
+        if (fp == 0 || (fp % alignof(uint64_t)) != 0)
+            break;
+        if (arch_copy_from_user(frame, reinterpret_cast<void*>(fp), sizeof(frame)) != ZX_OK)
+            break;
+        if (frame[1] == 0)
+            break;
+        frames[num_frames++] = frame[1];
+        // The stack grows down, so a caller's frame is always above; this
+        // also ends the walk on garbage without looping.
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    return num_frames;
+}
+
 // Helper function so that there is only one place where we enable/disable
 // interrupts (our caller).
 // Returns true if success, false if buffer is full.
@@ -1884,7 +1948,8 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
 
     const uint64_t status = read_msr(IA32_PERF_GLOBAL_STATUS);
     uint64_t bits_to_clear = 0;
-    uint64_t cr3 = x86_get_cr3();
+    // Strip the PCID, which varies by cpu and over time for the same aspace.
+    uint64_t cr3 = x86_get_cr3() & ~X86_CR3_PCID_MASK;
 
     LTRACEF("cpu %u: status 0x%" PRIx64 "\n", cpu, status);
 
@@ -1903,6 +1968,8 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
         // We can't record every event that requested LBR data.
         // It is unspecified which one we pick.
         cpuperf_event_id_t lbr_id = CPUPERF_EVENT_ID_NONE;
+        // Likewise for call stacks.
+        cpuperf_event_id_t callstack_id = CPUPERF_EVENT_ID_NONE;
 
         next = x86_perfmon_write_time_record(next, CPUPERF_EVENT_ID_NONE, now);
 
@@ -1933,6 +2000,9 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
                 request_lbr = true;
                 lbr_id = id;
             }
+            if (state->programmable_flags[i] & IPM_CONFIG_FLAG_CALLSTACK) {
+                callstack_id = id;
+            }
             LTRACEF("cpu %u: resetting PMC %u to 0x%" PRIx64 "\n",
                     cpu, i, state->programmable_initial_value[i]);
             write_msr(IA32_PMC_FIRST + i, state->programmable_initial_value[i]);
@@ -1961,6 +2031,9 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
                 request_lbr = true;
                 lbr_id = id;
             }
+            if (state->fixed_flags[i] & IPM_CONFIG_FLAG_CALLSTACK) {
+                callstack_id = id;
+            }
             LTRACEF("cpu %u: resetting FIXED %u to 0x%" PRIx64 "\n",
                     cpu, hw_num, state->fixed_initial_value[i]);
             write_msr(IA32_FIXED_CTR0 + hw_num, state->fixed_initial_value[i]);
@@ -2031,6 +2104,14 @@ static bool pmi_interrupt_handler(x86_iframe_t *frame, PerfmonState* state) {
             next = x86_perfmon_write_last_branches(state, cr3, next, lbr_id);
         }
 
+        // Kernel samples have no user stack to speak of.
+        if (callstack_id != CPUPERF_EVENT_ID_NONE && SELECTOR_PL(frame->cs) != 0) {
+            data->callstack_id = callstack_id;
+            data->callstack_aspace = cr3;
+            data->callstack_pc = frame->ip;
+            data->callstack_fp = frame->rbp;
+        }
+
         data->buffer_next = next;
     }
 
@@ -2128,3 +2209,49 @@ void apic_pmi_interrupt_handler(x86_iframe_t *frame) TA_NO_THREAD_SAFETY_ANALYSI
 #endif
     }
 }
+
+void apic_pmi_collect_user_callstack() TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(!arch_blocking_disallowed());
+
+    if (!atomic_load(&perfmon_active))
+        return;
+
+    auto state = perfmon_state.get();
+    auto data = &state->cpu_data[arch_curr_cpu_num()];
+    cpuperf_event_id_t id = data->callstack_id;
+    if (id == CPUPERF_EVENT_ID_NONE)
+        return;
+    data->callstack_id = CPUPERF_EVENT_ID_NONE;
+
+    uint64_t aspace = data->callstack_aspace;
+    uint64_t frames[CPUPERF_MAX_NUM_CALLSTACK_FRAMES];
+    frames[0] = data->callstack_pc;
+    uint64_t fp = data->callstack_fp;
+
+    arch_enable_ints();
+    uint32_t num_frames = x86_perfmon_unwind_user_stack(fp, frames, 1);
+    arch_disable_ints();
+
+    // With interrupts on, the trace may have been stopped, and we may now be
+    // running on a different cpu. If tracing is still active then stopping
+    // it has to wait for us, it needs to interrupt this cpu.
+    if (!atomic_load(&perfmon_active))
+        return;
+    state = perfmon_state.get();
+    uint cpu = arch_curr_cpu_num();
+    data = &state->cpu_data[cpu];
+
+    size_t space_needed = (sizeof(cpuperf_time_record_t) +
+                           sizeof(cpuperf_callstack_record_t));
+    if (reinterpret_cast<char*>(data->buffer_next) + space_needed > data->buffer_end) {
+        LTRACEF("cpu %u: no space for call stack\n", cpu);
+        data->buffer_start->flags |= CPUPERF_BUFFER_FLAG_FULL;
+        return;
+    }
+
+    auto next = x86_perfmon_write_time_record(data->buffer_next,
+                                              CPUPERF_EVENT_ID_NONE, rdtsc());
+    next = x86_perfmon_write_callstack(next, id, aspace, frames, num_frames);
+    data->buffer_next = next;
+}
@@ -18,13 +18,16 @@
 // IPT tracing has two "modes":
 // - per-cpu tracing
 // - thread-specific tracing
-// Tracing can only be done in one mode at a time. This is because saving/
-// restoring thread PT state via the xsaves/xrstors instructions is a global
-// flag in the XSS msr.
-// Plus once a trace has been done with IPT_TRACE_THREADS one cannot go back
-// to IPT_TRACE_CPUS: supporting this requires flushing trace state from all
-// threads which is a bit of work. For now it's easy enough to just require
-// the user to reboot. ZX-892
+// Tracing can only be done in one mode at a time.
+//
+// In thread mode each traced thread is assigned one of the trace buffers.
+// While the trace is started the thread's PT MSRs are loaded when it is
+// switched in and saved back to its buffer's state when it is switched out,
+// so its trace follows it from cpu to cpu. This is done by hand rather than
+// with the PT bit in the XSS msr and xsaves/xrstors: that way PT state never
+// ends up in the save area of threads that aren't traced, which only pay for
+// a compare on context switch, and the mode can be changed again once the
+// trace has been freed.
 
 #include <arch/arch_ops.h>
 #include <arch/mmu.h>
@@ -39,6 +42,7 @@
 #include <fbl/unique_ptr.h>
 #include <kernel/mp.h>
 #include <kernel/thread.h>
+#include <kernel/thread_lock.h>
 #include <lib/ktrace.h>
 #include <pow2.h>
 #include <string.h>
@@ -88,6 +92,9 @@ static bool supports_output_single = false;
 static bool supports_output_transport = false;
 
 struct ipt_trace_state_t {
+    // The thread this buffer is assigned to, IPT_TRACE_THREADS mode only.
+    thread_t* thread;
+
     uint64_t ctl;
     uint64_t status;
     uint64_t output_base;
@@ -110,6 +117,10 @@ static ipt_trace_mode_t trace_mode TA_GUARDED(ipt_lock) = IPT_TRACE_CPUS;
 // In thread mode this is provided by the user.
 static uint32_t ipt_num_traces TA_GUARDED(ipt_lock);
 
+// In thread mode, the trace whose MSRs are loaded on each cpu, if any.
+// Only accessed by the cpu itself, with interrupts disabled.
+static ipt_trace_state_t* ipt_cpu_trace_state[SMP_MAX_CPUS];
+
 void x86_processor_trace_init(void) {
     if (!x86_feature_test(X86_FEATURE_PT)) {
         return;
@@ -152,10 +163,6 @@ static void x86_ipt_set_mode_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSI
     DEBUG_ASSERT(!active);
 
     // When changing modes make sure all PT MSRs are in the init state.
-    // We don't want a value to appear in the xsave buffer and have xrstors
-    // #gp because XCOMP_BV has the PT bit set that's not set in XSS.
-    // We still need to do this, even with ZX-892, when transitioning
-    // from IPT_TRACE_CPUS to IPT_TRACE_THREADS.
     write_msr(IA32_RTIT_CTL, 0);
     write_msr(IA32_RTIT_STATUS, 0);
     write_msr(IA32_RTIT_OUTPUT_BASE, 0);
@@ -164,11 +171,7 @@ static void x86_ipt_set_mode_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSI
         write_msr(IA32_RTIT_CR3_MATCH, 0);
     // TODO(dje): addr range msrs
 
-    ipt_trace_mode_t new_mode = static_cast<ipt_trace_mode_t>(reinterpret_cast<uintptr_t>(raw_context));
-
-    // PT state saving, if supported, was enabled during boot so there's no
-    // need to recalculate the xsave space needed.
-    x86_set_extended_register_pt_state(new_mode == IPT_TRACE_THREADS);
+    ipt_cpu_trace_state[arch_curr_cpu_num()] = nullptr;
 }
 
 zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode, uint32_t num_traces) {
@@ -179,7 +182,8 @@ zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode, uint32_t num_traces) {
         if (num_traces != arch_max_num_cpus())
             return ZX_ERR_INVALID_ARGS;
     } else {
-        return ZX_ERR_NOT_SUPPORTED;
+        if (num_traces == 0 || num_traces > IPT_MAX_NUM_TRACES)
+            return ZX_ERR_INVALID_ARGS;
     }
 
     if (!supports_pt)
@@ -189,21 +193,13 @@ zx_status_t x86_ipt_alloc_trace(ipt_trace_mode_t mode, uint32_t num_traces) {
     if (ipt_trace_state)
         return ZX_ERR_BAD_STATE;
 
-    // ZX-892: We don't support changing the mode from IPT_TRACE_THREADS to
-    // IPT_TRACE_CPUS: We can't turn off XSS.PT until we're sure all threads
-    // have no PT state, and that's too tricky to do right now. Instead,
-    // require the developer to reboot.
-    if (trace_mode == IPT_TRACE_THREADS && mode == IPT_TRACE_CPUS)
-        return ZX_ERR_NOT_SUPPORTED;
-
     ipt_trace_state =
         reinterpret_cast<ipt_trace_state_t*>(calloc(num_traces,
                                                     sizeof(*ipt_trace_state)));
     if (!ipt_trace_state)
         return ZX_ERR_NO_MEMORY;
 
-    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_set_mode_task,
-                 reinterpret_cast<void*>(static_cast<uintptr_t>(mode)));
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_set_mode_task, nullptr);
 
     trace_mode = mode;
     ipt_num_traces = num_traces;
@@ -219,25 +215,23 @@ zx_status_t x86_ipt_free_trace() {
 
     if (!supports_pt)
         return ZX_ERR_NOT_SUPPORTED;
-    if (trace_mode == IPT_TRACE_THREADS)
-        return ZX_ERR_BAD_STATE;
     if (active)
         return ZX_ERR_BAD_STATE;
+    if (ipt_trace_state && trace_mode == IPT_TRACE_THREADS) {
+        for (uint32_t i = 0; i < ipt_num_traces; ++i) {
+            if (ipt_trace_state[i].thread)
+                return ZX_ERR_BAD_STATE;
+        }
+    }
 
     free(ipt_trace_state);
     ipt_trace_state = nullptr;
     return ZX_OK;
 }
 
-// This is invoked via mp_sync_exec which thread safety analysis cannot follow.
-static void x86_ipt_start_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
+// Load |state| into this cpu's MSRs and enable tracing.
+static void x86_ipt_load_msrs(const ipt_trace_state_t* state) {
     DEBUG_ASSERT(arch_ints_disabled());
-    DEBUG_ASSERT(active && raw_context);
-
-    ipt_trace_state_t* context = reinterpret_cast<ipt_trace_state_t*>(raw_context);
-    uint32_t cpu = arch_curr_cpu_num();
-    ipt_trace_state_t* state = &context[cpu];
-
     DEBUG_ASSERT(!(read_msr(IA32_RTIT_CTL) & IPT_CTL_TRACE_EN_MASK));
 
     // Load the ToPA configuration
@@ -253,6 +247,79 @@ static void x86_ipt_start_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYS
     write_msr(IA32_RTIT_CTL, state->ctl);
 }
 
+// Disable tracing on this cpu and save the MSRs to |state|.
+// |state->ctl| is left alone so that the trace can be resumed.
+static void x86_ipt_save_msrs(ipt_trace_state_t* state) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    // Disable the trace
+    write_msr(IA32_RTIT_CTL, 0);
+
+    // Retrieve msr values for later providing to userspace
+    state->status = read_msr(IA32_RTIT_STATUS);
+    state->output_base = read_msr(IA32_RTIT_OUTPUT_BASE);
+    state->output_mask_ptrs = read_msr(IA32_RTIT_OUTPUT_MASK_PTRS);
+
+    // Zero all MSRs so that we are in the XSAVE initial configuration.
+    // This allows h/w to do some optimizations regarding the state.
+    write_msr(IA32_RTIT_STATUS, 0);
+    write_msr(IA32_RTIT_OUTPUT_BASE, 0);
+    write_msr(IA32_RTIT_OUTPUT_MASK_PTRS, 0);
+    if (supports_cr3_filtering)
+        write_msr(IA32_RTIT_CR3_MATCH, 0);
+
+    // TODO(dje): Make it explicit that packets have been completely written.
+    // See Intel Vol 3 chapter 36.2.4.
+
+    // TODO(teisenbe): Clear ADDR* MSRs depending on leaf 1
+}
+
+// This is invoked via mp_sync_exec which thread safety analysis cannot follow.
+static void x86_ipt_start_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(active && raw_context);
+
+    ipt_trace_state_t* context = reinterpret_cast<ipt_trace_state_t*>(raw_context);
+    uint32_t cpu = arch_curr_cpu_num();
+    x86_ipt_load_msrs(&context[cpu]);
+}
+
+// In thread mode, make this cpu's MSRs hold the trace of |thread|, which is
+// about to run here, or no trace at all if it isn't being traced.
+static void x86_ipt_switch_thread_trace(thread_t* thread) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    uint32_t cpu = arch_curr_cpu_num();
+    ipt_trace_state_t* state = static_cast<ipt_trace_state_t*>(thread->arch.ipt_trace_state);
+    ipt_trace_state_t* loaded = ipt_cpu_trace_state[cpu];
+    if (likely(state == loaded))
+        return;
+
+    if (loaded)
+        x86_ipt_save_msrs(loaded);
+    if (state)
+        x86_ipt_load_msrs(state);
+    ipt_cpu_trace_state[cpu] = state;
+}
+
+void x86_ipt_context_switch(thread_t* oldthread, thread_t* newthread) {
+    x86_ipt_switch_thread_trace(newthread);
+}
+
+// Worker to bring every cpu up to date after the set of threads being traced
+// has changed.
+static void x86_ipt_sync_threads_task(void* raw_context) {
+    x86_ipt_switch_thread_trace(get_current_thread());
+}
+
+// Set which trace |thread| is to be traced with from its next context switch,
+// nullptr for none. Callers follow up with x86_ipt_sync_threads_task to
+// apply the change to threads that are running.
+static void x86_ipt_set_thread_trace(thread_t* thread, ipt_trace_state_t* state) {
+    Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+    thread->arch.ipt_trace_state = state;
+}
+
 // Begin the trace.
 
 zx_status_t x86_ipt_start() {
@@ -260,8 +327,6 @@ zx_status_t x86_ipt_start() {
 
     if (!supports_pt)
         return ZX_ERR_NOT_SUPPORTED;
-    if (trace_mode == IPT_TRACE_THREADS)
-        return ZX_ERR_BAD_STATE;
     if (active)
         return ZX_ERR_BAD_STATE;
     if (!ipt_trace_state)
@@ -295,6 +360,12 @@ zx_status_t x86_ipt_start() {
 
     if (trace_mode == IPT_TRACE_CPUS) {
         mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_start_cpu_task, ipt_trace_state);
+    } else {
+        for (uint32_t i = 0; i < ipt_num_traces; ++i) {
+            if (ipt_trace_state[i].thread)
+                x86_ipt_set_thread_trace(ipt_trace_state[i].thread, &ipt_trace_state[i]);
+        }
+        mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_sync_threads_task, nullptr);
     }
 
     return ZX_OK;
@@ -309,27 +380,8 @@ static void x86_ipt_stop_cpu_task(void* raw_context) TA_NO_THREAD_SAFETY_ANALYSI
     uint32_t cpu = arch_curr_cpu_num();
     ipt_trace_state_t* state = &context[cpu];
 
-    // Disable the trace
-    write_msr(IA32_RTIT_CTL, 0);
-
-    // Retrieve msr values for later providing to userspace
+    x86_ipt_save_msrs(state);
     state->ctl = 0;
-    state->status = read_msr(IA32_RTIT_STATUS);
-    state->output_base = read_msr(IA32_RTIT_OUTPUT_BASE);
-    state->output_mask_ptrs = read_msr(IA32_RTIT_OUTPUT_MASK_PTRS);
-
-    // Zero all MSRs so that we are in the XSAVE initial configuration.
-    // This allows h/w to do some optimizations regarding the state.
-    write_msr(IA32_RTIT_STATUS, 0);
-    write_msr(IA32_RTIT_OUTPUT_BASE, 0);
-    write_msr(IA32_RTIT_OUTPUT_MASK_PTRS, 0);
-    if (supports_cr3_filtering)
-        write_msr(IA32_RTIT_CR3_MATCH, 0);
-
-    // TODO(dje): Make it explicit that packets have been completely written.
-    // See Intel Vol 3 chapter 36.2.4.
-
-    // TODO(teisenbe): Clear ADDR* MSRs depending on leaf 1
 }
 
 // This can be called while not active, so the caller doesn't have to care
@@ -340,8 +392,6 @@ zx_status_t x86_ipt_stop() {
 
     if (!supports_pt)
         return ZX_ERR_NOT_SUPPORTED;
-    if (trace_mode == IPT_TRACE_THREADS)
-        return ZX_ERR_BAD_STATE;
     if (!ipt_trace_state)
         return ZX_ERR_BAD_STATE;
 
@@ -349,6 +399,13 @@ zx_status_t x86_ipt_stop() {
 
     if (trace_mode == IPT_TRACE_CPUS) {
         mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_stop_cpu_task, ipt_trace_state);
+    } else if (active) {
+        // The buffers stay assigned, tracing picks up again on the next start.
+        for (uint32_t i = 0; i < ipt_num_traces; ++i) {
+            if (ipt_trace_state[i].thread)
+                x86_ipt_set_thread_trace(ipt_trace_state[i].thread, nullptr);
+        }
+        mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_sync_threads_task, nullptr);
     }
 
     ktrace(TAG_IPT_STOP, 0, 0, 0, 0);
@@ -379,6 +436,9 @@ zx_status_t x86_ipt_stage_trace_data(zx_itrace_buffer_descriptor_t descriptor,
         return ZX_ERR_BAD_STATE;
     if (descriptor >= ipt_num_traces)
         return ZX_ERR_INVALID_ARGS;
+    // The MSRs of an assigned buffer may be loaded on some cpu.
+    if (ipt_trace_state[descriptor].thread)
+        return ZX_ERR_BAD_STATE;
 
     ipt_trace_state[descriptor].ctl = regs->ctl;
     ipt_trace_state[descriptor].status = regs->status;
@@ -403,6 +463,9 @@ zx_status_t x86_ipt_get_trace_data(zx_itrace_buffer_descriptor_t descriptor,
         return ZX_ERR_BAD_STATE;
     if (descriptor >= ipt_num_traces)
         return ZX_ERR_INVALID_ARGS;
+    // The MSRs are still being updated while the assigned thread runs.
+    if (active && ipt_trace_state[descriptor].thread)
+        return ZX_ERR_BAD_STATE;
 
     regs->ctl = ipt_trace_state[descriptor].ctl;
     regs->status = ipt_trace_state[descriptor].status;
@@ -414,3 +477,55 @@ zx_status_t x86_ipt_get_trace_data(zx_itrace_buffer_descriptor_t descriptor,
 
     return ZX_OK;
 }
+
+zx_status_t x86_ipt_assign_thread_buffer(zx_itrace_buffer_descriptor_t descriptor,
+                                         thread_t* thread) {
+    AutoLock al(&ipt_lock);
+
+    if (!supports_pt)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (!ipt_trace_state || trace_mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (descriptor >= ipt_num_traces)
+        return ZX_ERR_INVALID_ARGS;
+    for (uint32_t i = 0; i < ipt_num_traces; ++i) {
+        if (ipt_trace_state[i].thread == thread)
+            return ZX_ERR_ALREADY_BOUND;
+    }
+    ipt_trace_state_t* state = &ipt_trace_state[descriptor];
+    if (state->thread)
+        return ZX_ERR_BAD_STATE;
+
+    state->thread = thread;
+    if (active) {
+        x86_ipt_set_thread_trace(thread, state);
+        mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_sync_threads_task, nullptr);
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t x86_ipt_release_thread_buffer(zx_itrace_buffer_descriptor_t descriptor,
+                                          thread_t* thread) {
+    AutoLock al(&ipt_lock);
+
+    if (!supports_pt)
+        return ZX_ERR_NOT_SUPPORTED;
+    if (!ipt_trace_state || trace_mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (descriptor >= ipt_num_traces)
+        return ZX_ERR_INVALID_ARGS;
+    ipt_trace_state_t* state = &ipt_trace_state[descriptor];
+    if (state->thread != thread)
+        return ZX_ERR_INVALID_ARGS;
+
+    if (active) {
+        // Once every cpu has synced, the thread's MSRs have been saved
+        // wherever it was running and no cpu writes to the buffer anymore.
+        x86_ipt_set_thread_trace(thread, nullptr);
+        mp_sync_exec(MP_IPI_TARGET_ALL, 0, x86_ipt_sync_threads_task, nullptr);
+    }
+    state->thread = nullptr;
+
+    return ZX_OK;
+}
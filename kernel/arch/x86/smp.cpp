@@ -37,7 +37,7 @@ void x86_init_smp(uint32_t* apic_ids, uint32_t num_cpus) {
 static void free_stack_and_thread(thread_t* t) {
     if (t) {
         vm_free_kstack(&t->stack);
-        free(t);
+        thread_free_struct(t);
     }
 }
 
@@ -80,7 +80,7 @@ zx_status_t x86_bringup_aps(uint32_t* apic_ids, uint32_t count) {
     memset(&bootstrap_data->per_cpu, 0, sizeof(bootstrap_data->per_cpu));
     // Allocate kstacks and threads for all processors
     for (unsigned int i = 0; i < count; ++i) {
-        thread_t* thread = static_cast<thread_t*>(calloc(1, sizeof(thread_t)));
+        thread_t* thread = thread_alloc_struct();
         if (!thread) {
             status = ZX_ERR_NO_MEMORY;
             goto cleanup_all;
@@ -129,12 +129,14 @@ zx_status_t x86_bringup_aps(uint32_t* apic_ids, uint32_t count) {
     }
 
     // The docs recommend waiting 200us for cores to boot.  We do a bit more
-    // work before the cores report in, so wait longer (up to 1 second).
-    for (int tries_left = 200;
+    // work before the cores report in, so wait longer (up to 1 second), but
+    // poll at the recommended interval so that boot isn't held up for long
+    // after the last core checks in.
+    for (int tries_left = 5000;
          aps_still_booting != 0 && tries_left > 0;
          --tries_left) {
 
-        thread_sleep_relative(ZX_MSEC(5));
+        thread_sleep_relative(ZX_USEC(200));
     }
 
     uint failed_aps;
@@ -11,6 +11,7 @@
 #include <arch/x86/descriptor.h>
 #include <arch/x86/feature.h>
 #include <arch/x86/mp.h>
+#include <arch/x86/proc_trace.h>
 #include <arch/x86/registers.h>
 #include <arch/x86/x86intrin.h>
 #include <assert.h>
@@ -72,6 +73,9 @@ void arch_thread_initialize(thread_t* t, vaddr_t entry_point) {
     }
     t->arch.debug_state.dr6 = ~X86_DR6_USER_MASK;
     t->arch.debug_state.dr7 = ~X86_DR7_USER_MASK;
+
+    // Not traced until a PT buffer is assigned to it.
+    t->arch.ipt_trace_state = nullptr;
 }
 
 void arch_thread_construct_first(thread_t* t) {
@@ -99,6 +103,8 @@ void arch_context_switch(thread_t* oldthread, thread_t* newthread) {
 
     x86_debug_state_context_switch(oldthread, newthread);
 
+    x86_ipt_context_switch(oldthread, newthread);
+
     //printf("cs 0x%llx\n", kstack_top);
 
     /* set the tss SP0 value to point at the top of our stack */
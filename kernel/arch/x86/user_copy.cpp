@@ -23,6 +23,35 @@ CODE_TEMPLATE(kStacInstruction, "stac");
 CODE_TEMPLATE(kClacInstruction, "clac");
 static const uint8_t kNopInstruction = 0x90;
 
+// Copies below this size are never worth streaming.
+static const uint64_t kMinNonTemporalCopy = PAGE_SIZE;
+
+// Returns the size of the largest data cache, or 0 if the CPU doesn't
+// describe its caches.
+static uint64_t largest_data_cache_size(void) {
+    uint64_t largest = 0;
+    struct cpuid_leaf leaf;
+    for (uint32_t i = 0; x86_get_cpuid_subleaf(X86_CPUID_CACHE_V2, i, &leaf); ++i) {
+        uint32_t type = leaf.a & 0x1f;
+        if (type == 0) {
+            break;
+        }
+        // Instruction caches don't matter here.
+        if (type == 2) {
+            continue;
+        }
+        uint64_t ways = ((leaf.b >> 22) & 0x3ff) + 1;
+        uint64_t partitions = ((leaf.b >> 12) & 0x3ff) + 1;
+        uint64_t line_size = (leaf.b & 0xfff) + 1;
+        uint64_t sets = static_cast<uint64_t>(leaf.c) + 1;
+        uint64_t size = ways * partitions * line_size * sets;
+        if (size > largest) {
+            largest = size;
+        }
+    }
+    return largest;
+}
+
 extern "C" {
 
 void fill_out_stac_instruction(const CodePatchInfo* patch) {
@@ -46,6 +75,38 @@ void fill_out_clac_instruction(const CodePatchInfo* patch) {
         memset(patch->dest_addr, kNopInstruction, kSize);
     }
 }
+
+// Patches the "jmp .Lcopy_quad" in _x86_copy_to_or_from_user() into a nop
+// when "rep movsb" is at least as fast as copying a quadword at a time.
+void x86_user_copy_select(const CodePatchInfo* patch) {
+    const size_t kSize = 2;
+    DEBUG_ASSERT(patch->dest_size == kSize);
+    DEBUG_ASSERT(patch->dest_addr[0] == 0xeb); /* jmp rel8 */
+    if (x86_feature_test(X86_FEATURE_ERMS) || x86_feature_test(X86_FEATURE_FSRM)) {
+        patch->dest_addr[0] = 0x66; /* 2-byte nop */
+        patch->dest_addr[1] = kNopInstruction;
+    }
+}
+
+// Fills in the immediate of the "cmpq $imm32, %rdx" that sends large copies
+// down the non-temporal path.  Without cache information the placeholder
+// stays, so only copies of 2GB and up are streamed.
+void x86_user_copy_nt_select(const CodePatchInfo* patch) {
+    const size_t kSize = 7;
+    DEBUG_ASSERT(patch->dest_size == kSize);
+    DEBUG_ASSERT(patch->dest_addr[0] == 0x48 && patch->dest_addr[1] == 0x81 &&
+                 patch->dest_addr[2] == 0xfa); /* cmpq $imm32, %rdx */
+
+    uint64_t threshold = largest_data_cache_size();
+    if (threshold == 0 || threshold > INT32_MAX) {
+        return;
+    }
+    if (threshold < kMinNonTemporalCopy) {
+        threshold = kMinNonTemporalCopy;
+    }
+    uint32_t imm = static_cast<uint32_t>(threshold);
+    memcpy(&patch->dest_addr[3], &imm, sizeof(imm));
+}
 }
 
 static inline bool ac_flag(void) {
@@ -18,12 +18,14 @@
 #include <dev/interrupt/arm_gicv2m_msi.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/mp.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
 #include <pdev/driver.h>
 #include <pdev/interrupt.h>
+#include <platform.h>
 #include <reg.h>
 #include <sys/types.h>
 #include <trace.h>
@@ -237,6 +239,38 @@ static zx_status_t gic_configure_interrupt(unsigned int vector,
     return ZX_OK;
 }
 
+// GICD_ITARGETSR holds one bit per CPU interface for each SPI.  CPU interface n
+// is CPU n, see is_spi_enabled().
+static zx_status_t gic_set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    if ((vector >= max_irqs) || (vector < GIC_BASE_SPI) || (cpu >= 8)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // ITARGETSR is read-only on a uniprocessor GIC.
+    if (arm_gic_max_cpu() == 0) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    spin_lock_saved_state_t state;
+    spin_lock_save(&gicd_lock, &state, GICD_LOCK_FLAGS);
+
+    // A CPU going offline moves its SPIs away under gicd_lock once it is no
+    // longer active, so checking here keeps anything from landing on it after.
+    if (!mp_is_cpu_active(cpu)) {
+        spin_unlock_restore(&gicd_lock, state, GICD_LOCK_FLAGS);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    uint32_t shift = (vector % 4) * 8;
+    uint32_t reg = GICREG(0, GICD_ITARGETSR(vector / 4));
+    reg &= ~(0xffu << shift);
+    reg |= (1u << cpu) << shift;
+    GICREG(0, GICD_ITARGETSR(vector / 4)) = reg;
+
+    spin_unlock_restore(&gicd_lock, state, GICD_LOCK_FLAGS);
+    return ZX_OK;
+}
+
 static zx_status_t gic_get_interrupt_config(unsigned int vector,
                                             enum interrupt_trigger_mode* tm,
                                             enum interrupt_polarity* pol) {
@@ -361,9 +395,32 @@ static bool is_spi_enabled() {
     return false;
 }
 
+// Moves every SPI targeted at the calling CPU over to the boot CPU.
+static void move_spis_off_curr_cpu() {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    uint cpu_num = arch_curr_cpu_num();
+    DEBUG_ASSERT(cpu_num != BOOT_CPU_ID && cpu_num < 8);
+    uint32_t mask = 0x01010101U << cpu_num;
+
+    spin_lock_saved_state_t state;
+    spin_lock_save(&gicd_lock, &state, GICD_LOCK_FLAGS);
+    for (unsigned int vector = GIC_BASE_SPI; vector < max_irqs; vector += 4) {
+        uint32_t reg = GICREG(0, GICD_ITARGETSR(vector / 4));
+        if (reg & mask) {
+            // Swap this CPU's bit for the boot CPU's in each byte that has it.
+            GICREG(0, GICD_ITARGETSR(vector / 4)) = (reg & ~mask) | ((reg & mask) >> cpu_num);
+        }
+    }
+    spin_unlock_restore(&gicd_lock, state, GICD_LOCK_FLAGS);
+}
+
 static void gic_shutdown_cpu() {
     DEBUG_ASSERT(arch_ints_disabled());
 
+    // This CPU is no longer active, so nothing new can be steered at it.
+    move_spis_off_curr_cpu();
+
     // Before we shutdown the GIC, make sure we've migrated/disabled any and all peripheral
     // interrupts targeted at this CPU (PPIs and SPIs).
     DEBUG_ASSERT(!is_ppi_enabled());
@@ -378,6 +435,7 @@ static const struct pdev_interrupt_ops gic_ops = {
     .unmask = gic_unmask_interrupt,
     .configure = gic_configure_interrupt,
     .get_config = gic_get_interrupt_config,
+    .set_affinity = gic_set_interrupt_affinity,
     .is_valid = gic_is_valid_interrupt,
     .get_base_vector = gic_get_base_vector,
     .get_max_vector = gic_get_max_vector,
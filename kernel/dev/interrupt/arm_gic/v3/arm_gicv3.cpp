@@ -14,12 +14,15 @@
 #include <dev/interrupt/arm_gic_common.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/mp.h>
+#include <kernel/spinlock.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
 #include <pdev/driver.h>
 #include <pdev/interrupt.h>
+#include <platform.h>
 #include <string.h>
 #include <trace.h>
 #include <vm/vm.h>
@@ -60,6 +63,17 @@ static uint32_t ipi_base = 0;
 
 static uint gic_max_int;
 
+// Guards changes to SPI routing (GICD_IROUTER).
+static spin_lock_t gicd_lock;
+
+// The GICD_IROUTER value that routes an SPI to |cpu|.
+// TODO(maniscalco): If/when we support AFF2/AFF3, add them here.
+static uint64_t gic_cpu_route(cpu_num_t cpu) {
+    uint64_t aff0 = arch_cpu_num_to_cpu_id(cpu);
+    uint64_t aff1 = arch_cpu_num_to_cluster_id(cpu);
+    return (aff1 << 8) | aff0;
+}
+
 static bool gic_is_valid_interrupt(unsigned int vector, uint32_t flags) {
     return (vector < gic_max_int);
 }
@@ -299,6 +313,27 @@ static zx_status_t gic_configure_interrupt(unsigned int vector,
     return ZX_OK;
 }
 
+static zx_status_t gic_set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    if ((vector >= gic_max_int) || (vector < 32) || (cpu >= arch_max_num_cpus())) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&gicd_lock, state);
+
+    // A CPU going offline moves its SPIs away under gicd_lock once it is no
+    // longer active, so checking here keeps anything from landing on it after.
+    if (!mp_is_cpu_active(cpu)) {
+        spin_unlock_irqrestore(&gicd_lock, state);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    GICREG64(0, GICD_IROUTER(vector)) = gic_cpu_route(cpu);
+
+    spin_unlock_irqrestore(&gicd_lock, state);
+    return ZX_OK;
+}
+
 static zx_status_t gic_get_interrupt_config(unsigned int vector,
                                             enum interrupt_trigger_mode* tm,
                                             enum interrupt_polarity* pol) {
@@ -420,16 +455,11 @@ static bool is_ppi_enabled() {
 static bool is_spi_enabled() {
     DEBUG_ASSERT(arch_ints_disabled());
 
-    uint cpu_num = arch_curr_cpu_num();
-
-    // TODO(maniscalco): If/when we support AFF2/AFF3, update the mask below.
-    uint aff0 = arch_cpu_num_to_cpu_id(cpu_num);
-    uint aff1 = arch_cpu_num_to_cluster_id(cpu_num);
-    uint64_t aff_mask = (aff1 << 8) + aff0;
+    uint64_t route = gic_cpu_route(arch_curr_cpu_num());
 
     // Check each SPI to see if it's routed to this CPU.
     for (uint i = 32u; i < gic_max_int; ++i) {
-        if ((GICREG64(0, GICD_IROUTER(i)) & aff_mask) != 0) {
+        if ((GICREG64(0, GICD_IROUTER(i)) & 0xffff) == route) {
             return true;
         }
     }
@@ -437,9 +467,31 @@ static bool is_spi_enabled() {
     return false;
 }
 
+// Moves every SPI routed to the calling CPU over to the boot CPU.
+static void move_spis_off_curr_cpu() {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    cpu_num_t cpu_num = arch_curr_cpu_num();
+    DEBUG_ASSERT(cpu_num != BOOT_CPU_ID);
+    uint64_t route = gic_cpu_route(cpu_num);
+
+    spin_lock_saved_state_t state;
+    spin_lock_irqsave(&gicd_lock, state);
+    for (uint i = 32u; i < gic_max_int; ++i) {
+        if ((GICREG64(0, GICD_IROUTER(i)) & 0xffff) == route) {
+            // The boot CPU is affinity 0.0.0.0; see arm_gic_init().
+            GICREG64(0, GICD_IROUTER(i)) = 0;
+        }
+    }
+    spin_unlock_irqrestore(&gicd_lock, state);
+}
+
 static void gic_shutdown_cpu() {
     DEBUG_ASSERT(arch_ints_disabled());
 
+    // This CPU is no longer active, so nothing new can be steered at it.
+    move_spis_off_curr_cpu();
+
     // Before we shutdown the GIC, make sure we've migrated/disabled any and all peripheral
     // interrupts targeted at this CPU (PPIs and SPIs).
     DEBUG_ASSERT(!is_ppi_enabled());
@@ -485,6 +537,7 @@ static const struct pdev_interrupt_ops gic_ops = {
     .unmask = gic_unmask_interrupt,
     .configure = gic_configure_interrupt,
     .get_config = gic_get_interrupt_config,
+    .set_affinity = gic_set_interrupt_affinity,
     .is_valid = gic_is_valid_interrupt,
     .get_base_vector = gic_get_base_vector,
     .get_max_vector = gic_get_max_vector,
@@ -46,6 +46,11 @@ zx_status_t get_interrupt_config(unsigned int vector,
                                  enum interrupt_trigger_mode* tm,
                                  enum interrupt_polarity* pol);
 
+// Deliver the specified interrupt vector to |cpu| from now on.  Returns
+// ZX_ERR_NOT_SUPPORTED if the interrupt controller can't steer the vector.
+// Interrupts steered at a CPU that goes offline are moved to the boot CPU.
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu);
+
 typedef void (*int_handler)(void* arg);
 
 zx_status_t register_int_handler(unsigned int vector, int_handler handler, void* arg);
@@ -121,4 +126,10 @@ void msi_free_block(msi_block_t* block);
 // NULL handler will effectively unregister a handler for a given msi_id within the
 // block.
 void msi_register_handler(const msi_block_t* block, uint msi_id, int_handler handler, void *ctx);
+
+// Retarget every IRQ in a block at |cpu|.  This only updates the block's
+// tgt_addr and tgt_data; the caller must write them to the device.
+//
+// @return ZX_ERR_NOT_SUPPORTED if the platform can't steer MSIs.
+zx_status_t msi_set_affinity(msi_block_t* block, cpu_num_t cpu);
 __END_CDECLS
@@ -44,3 +44,7 @@ __WEAK void msi_register_handler(const msi_block_t* block,
                                  void *ctx) {
     PANIC_UNIMPLEMENTED;
 }
+
+__WEAK zx_status_t msi_set_affinity(msi_block_t* block, cpu_num_t cpu) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
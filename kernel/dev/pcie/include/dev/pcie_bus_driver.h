@@ -150,6 +150,11 @@ public:
     }
 
     void DisableBus();
+
+    // Move every device IRQ steered at |cpu| to the boot CPU.  Called while
+    // |cpu| is being taken offline.
+    void MigrateIrqsOffCpu(cpu_num_t cpu);
+
     static zx_status_t InitializeDriver(PciePlatformInterface& platform);
     static void        ShutdownDriver();
 
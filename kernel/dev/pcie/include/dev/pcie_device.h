@@ -23,6 +23,7 @@
 #include <fbl/mutex.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <platform.h>
 #include <sys/types.h>
 
 /* Fwd decls */
@@ -280,6 +281,35 @@ public:
      */
     zx_status_t MaskUnmaskIrq(uint irq_id, bool mask);
 
+    /**
+     * Deliver the specified IRQ to the given CPU from now on.
+     *
+     * @param irq_id The ID of the IRQ to steer.
+     * @param cpu The CPU to deliver it to.
+     *
+     * In MSI mode, every IRQ of the device shares one target address, so
+     * moving one moves all of them.
+     *
+     * @return A zx_status_t indicating the success or failure of the operation.
+     * Status codes may include (but are not limited to)...
+     *
+     * ++ ZX_ERR_BAD_STATE
+     *    The device is in DISABLED IRQ mode, or has been unplugged.
+     * ++ ZX_ERR_INVALID_ARGS
+     *    The irq_id parameter is out of range for the currently configured mode,
+     *    or cpu is not an active CPU.
+     * ++ ZX_ERR_NOT_SUPPORTED
+     *    The device is using a legacy IRQ, which may be shared with other
+     *    devices, or the platform can't steer MSIs.
+     */
+    zx_status_t SetIrqAffinity(uint irq_id, cpu_num_t cpu);
+
+    /**
+     * Move any of the device's IRQs that are steered at |cpu| to the boot CPU.
+     * Called while |cpu| is being taken offline.
+     */
+    void MigrateIrqsOffCpu(cpu_num_t cpu);
+
     void SetQuirksDone() { quirks_done_ = true; }
 
     /**
@@ -396,6 +426,7 @@ private:
     zx_status_t SetIrqModeLocked(pcie_irq_mode_t mode, uint requested_irqs);
     zx_status_t RegisterIrqHandlerLocked(uint irq_id, pcie_irq_handler_fn_t handler, void* ctx);
     zx_status_t MaskUnmaskIrqLocked(uint irq_id, bool mask);
+    zx_status_t SetIrqAffinityLocked(uint irq_id, cpu_num_t cpu);
 
     // Internal Legacy IRQ support.
     zx_status_t MaskUnmaskLegacyIrq(bool mask);
@@ -414,6 +445,7 @@ private:
     zx_status_t MaskUnmaskMsiIrq(uint irq_id, bool mask);
     void        MaskAllMsiVectors();
     void        SetMsiTarget(uint64_t tgt_addr, uint32_t tgt_data);
+    zx_status_t SetMsiAffinity(cpu_num_t cpu);
     void        FreeMsiBlock();
     void        SetMsiMultiMessageEnb(uint requested_irqs);
     void        LeaveMsiIrqMode();
@@ -444,6 +476,7 @@ private:
         pcie_irq_handler_state_t* handlers = nullptr;
         uint                      handler_count = 0;
         uint                      registered_handler_count = 0;
+        cpu_num_t                 affinity = BOOT_CPU_ID;
 
         /* Legacy IRQ state */
         struct {
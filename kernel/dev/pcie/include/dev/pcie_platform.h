@@ -123,6 +123,19 @@ public:
         DEBUG_ASSERT(false);
     }
 
+    /**
+     * Method used to retarget a block of MSIs at a different CPU.  On success
+     * the block's tgt_addr and tgt_data have been updated, and the bus driver
+     * must write them to the device.
+     *
+     * @param block A pointer to a block of MSIs allocated using a platform supplied
+     *        platform_msi_alloc_block_t callback.
+     * @param cpu The CPU every IRQ in the block should be delivered to.
+     */
+    virtual zx_status_t SetMsiAffinity(msi_block_t* block, cpu_num_t cpu) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     DISALLOW_COPY_ASSIGN_AND_MOVE(PciePlatformInterface);
 protected:
     enum class MsiSupportLevel { NONE, MSI, MSI_WITH_MASKING };
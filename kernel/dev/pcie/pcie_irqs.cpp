@@ -46,6 +46,7 @@ void PcieDevice::ResetCommonIrqBookkeeping() {
     irq_.mode          = PCIE_IRQ_MODE_DISABLED;
     irq_.handlers      = nullptr;
     irq_.handler_count = 0;
+    irq_.affinity      = BOOT_CPU_ID;
 }
 
 zx_status_t PcieDevice::AllocIrqHandlers(uint requested_irqs, bool is_masked) {
@@ -359,6 +360,40 @@ void PcieDevice::SetMsiTarget(uint64_t tgt_addr, uint32_t tgt_data) {
     cfg_->Write(irq_.msi->data_reg(), static_cast<uint16_t>(tgt_data & 0xFFFF));
 }
 
+zx_status_t PcieDevice::SetMsiAffinity(cpu_num_t cpu) {
+    DEBUG_ASSERT(irq_.msi);
+    DEBUG_ASSERT(irq_.msi->is_valid());
+    DEBUG_ASSERT(irq_.msi->irq_block_.allocated);
+
+    zx_status_t res = bus_drv_.platform().SetMsiAffinity(&irq_.msi->irq_block_, cpu);
+    if (res != ZX_OK)
+        return res;
+
+    /* Unlike SetMsiTarget, leave MSI enabled.  If the device can mask its
+     * vectors, hold its messages off while the address is being rewritten;
+     * they stay pending and are sent once the vectors are unmasked again. */
+    uint32_t mask_bits = 0;
+    if (irq_.msi->has_pvm()) {
+        mask_bits = cfg_->Read(irq_.msi->mask_bits_reg());
+        cfg_->Write(irq_.msi->mask_bits_reg(), 0xFFFFFFFF);
+    }
+
+    uint64_t tgt_addr = irq_.msi->irq_block_.tgt_addr;
+    DEBUG_ASSERT(irq_.msi->is64Bit() || !(tgt_addr >> 32));
+    cfg_->Write(irq_.msi->addr_reg(), static_cast<uint32_t>(tgt_addr & 0xFFFFFFFF));
+    if (irq_.msi->is64Bit()) {
+        cfg_->Write(irq_.msi->addr_upper_reg(), static_cast<uint32_t>(tgt_addr >> 32));
+    }
+    cfg_->Write(irq_.msi->data_reg(), static_cast<uint16_t>(irq_.msi->irq_block_.tgt_data & 0xFFFF));
+
+    if (irq_.msi->has_pvm()) {
+        cfg_->Write(irq_.msi->mask_bits_reg(), mask_bits);
+    }
+
+    irq_.affinity = cpu;
+    return ZX_OK;
+}
+
 void PcieDevice::FreeMsiBlock() {
     /* If no block has been allocated, there is nothing to do */
     if (!irq_.msi->irq_block_.allocated)
@@ -723,6 +758,32 @@ zx_status_t PcieDevice::MaskUnmaskIrqLocked(uint irq_id, bool mask) {
     return ZX_OK;
 }
 
+zx_status_t PcieDevice::SetIrqAffinityLocked(uint irq_id, cpu_num_t cpu) {
+    DEBUG_ASSERT(plugged_in_);
+    DEBUG_ASSERT(dev_lock_.IsHeld());
+
+    if (irq_.mode == PCIE_IRQ_MODE_DISABLED)
+        return ZX_ERR_BAD_STATE;
+
+    DEBUG_ASSERT(irq_.handlers);
+    DEBUG_ASSERT(irq_.handler_count);
+
+    /* Make sure that the IRQ ID is within range */
+    if (irq_id >= irq_.handler_count)
+        return ZX_ERR_INVALID_ARGS;
+
+    switch (irq_.mode) {
+    /* The legacy IRQ line may be shared with other devices, so it isn't ours
+     * to move. */
+    case PCIE_IRQ_MODE_LEGACY: return ZX_ERR_NOT_SUPPORTED;
+    case PCIE_IRQ_MODE_MSI:    return SetMsiAffinity(cpu);
+    case PCIE_IRQ_MODE_MSI_X:  return ZX_ERR_NOT_SUPPORTED;
+    default:
+        DEBUG_ASSERT(false); /* This should be un-possible! */
+        return ZX_ERR_INTERNAL;
+    }
+}
+
 /******************************************************************************
  *
  * Kernel API; prototypes in dev/pcie_irqs.h
@@ -775,6 +836,30 @@ zx_status_t PcieDevice::MaskUnmaskIrq(uint irq_id, bool mask) {
         : ZX_ERR_BAD_STATE;
 }
 
+zx_status_t PcieDevice::SetIrqAffinity(uint irq_id, cpu_num_t cpu) {
+    AutoLock dev_lock(&dev_lock_);
+
+    return (plugged_in_ && !disabled_)
+        ? SetIrqAffinityLocked(irq_id, cpu)
+        : ZX_ERR_BAD_STATE;
+}
+
+void PcieDevice::MigrateIrqsOffCpu(cpu_num_t cpu) {
+    AutoLock dev_lock(&dev_lock_);
+
+    /* Only MSI blocks are ever steered away from the boot CPU.  The platform
+     * refuses to target |cpu| once it has started to go offline, so a block
+     * steered at it can only have been moved there before we took the lock. */
+    if (!plugged_in_ || (irq_.mode != PCIE_IRQ_MODE_MSI) || (irq_.affinity != cpu))
+        return;
+
+    zx_status_t res = SetMsiAffinity(BOOT_CPU_ID);
+    if (res != ZX_OK) {
+        TRACEF("Failed to move MSIs of %02x:%02x.%01x off CPU %u (res %d)\n",
+               bus_id_, dev_id_, func_id_, cpu, res);
+    }
+}
+
 
 // Map from a device's interrupt pin ID to the proper system IRQ ID.  Follow the
 // PCIe graph up to the root, swizzling as we traverse PCIe switches,
@@ -914,6 +999,14 @@ zx_status_t PcieDevice::InitLegacyIrqStateLocked(PcieUpstreamNode& upstream) {
     return ZX_OK;
 }
 
+void PcieBusDriver::MigrateIrqsOffCpu(cpu_num_t cpu) {
+    ForeachDevice([](const fbl::RefPtr<PcieDevice>& dev, void* ctx, uint level) -> bool {
+                      DEBUG_ASSERT(dev && ctx);
+                      dev->MigrateIrqsOffCpu(*static_cast<cpu_num_t*>(ctx));
+                      return true;
+                  }, &cpu);
+}
+
 void PcieBusDriver::ShutdownIrqs() {
     /* Shut off all of our legacy IRQs and free all of our bookkeeping */
     AutoLock lock(&legacy_irq_list_lock_);
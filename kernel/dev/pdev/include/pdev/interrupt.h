@@ -29,6 +29,7 @@ struct pdev_interrupt_ops {
     zx_status_t (*get_config)(unsigned int vector,
                               enum interrupt_trigger_mode* tm,
                               enum interrupt_polarity* pol);
+    zx_status_t (*set_affinity)(unsigned int vector, cpu_num_t cpu);
     bool (*is_valid)(unsigned int vector, uint32_t flags);
     uint32_t (*get_base_vector)(void);
     uint32_t (*get_max_vector)(void);
@@ -82,6 +82,10 @@ static void default_handle_irq(iframe* frame) {
 static void default_handle_fiq(iframe* frame) {
 }
 
+static zx_status_t default_set_affinity(unsigned int vector, cpu_num_t cpu) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+
 static void default_shutdown() {
 }
 
@@ -126,6 +130,7 @@ static const struct pdev_interrupt_ops default_ops = {
     .unmask = default_unmask,
     .configure = default_configure,
     .get_config = default_get_config,
+    .set_affinity = default_set_affinity,
     .is_valid = default_is_valid,
     .get_base_vector = default_get_base_vector,
     .get_max_vector = default_get_max_vector,
@@ -165,6 +170,10 @@ zx_status_t get_interrupt_config(unsigned int vector, enum interrupt_trigger_mod
     return intr_ops->get_config(vector, tm, pol);
 }
 
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    return intr_ops->set_affinity(vector, cpu);
+}
+
 uint32_t interrupt_get_base_vector() {
     return intr_ops->get_base_vector();
 }
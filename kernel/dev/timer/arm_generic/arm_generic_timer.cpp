@@ -230,6 +230,20 @@ zx_ticks_t ticks_per_second(void) {
     return u64_mul_u32_fp32_64(1000 * 1000 * 1000, cntpct_per_ns);
 }
 
+bool platform_get_ns_per_tick(struct fp_32_64* ns_per_tick) {
+    // User mode can only read the virtual count. If we keep time with the
+    // physical count, make sure nothing offsets one from the other.
+    if (reg_procs->read_ct != read_cntvct) {
+        uint64_t before = read_cntpct();
+        uint64_t cntvct = read_cntvct();
+        uint64_t after = read_cntpct();
+        if (cntvct < before || cntvct > after)
+            return false;
+    }
+    *ns_per_tick = ns_per_cntpct;
+    return true;
+}
+
 static uint64_t abs_int64(int64_t a) {
     return (a > 0) ? a : -a;
 }
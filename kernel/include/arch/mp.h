@@ -50,4 +50,15 @@ zx_status_t arch_mp_cpu_unplug(cpu_num_t cpu_id);
 
 void arch_mp_init_percpu(void);
 
+/* Relative distance between two cpus in the cache and package hierarchy,
+ * used by the scheduler to prefer nearby cpus. Smaller is closer. */
+#define CPU_DISTANCE_SELF    0u  /* the same logical cpu */
+#define CPU_DISTANCE_SMT     1u  /* hardware threads of the same core */
+#define CPU_DISTANCE_CACHE   2u  /* distinct cores sharing a last level cache */
+#define CPU_DISTANCE_PACKAGE 3u  /* distinct caches within the same package */
+#define CPU_DISTANCE_REMOTE  4u  /* different packages */
+#define CPU_DISTANCE_MAX     CPU_DISTANCE_REMOTE
+
+uint arch_cpu_distance(cpu_num_t a, cpu_num_t b);
+
 __END_CDECLS
@@ -95,10 +95,18 @@ static inline uint32_t atomic_load_u32(volatile uint32_t* ptr) {
     return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
 }
 
+static inline void atomic_store_u32(volatile uint32_t* ptr, uint32_t newval) {
+    __atomic_store_n(ptr, newval, __ATOMIC_SEQ_CST);
+}
+
 static inline void atomic_store_relaxed_u32(volatile uint32_t* ptr, uint32_t newval) {
     __atomic_store_n(ptr, newval, __ATOMIC_RELAXED);
 }
 
+static inline uint32_t atomic_load_relaxed_u32(volatile uint32_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
 // 64-bit versions. Assumes the compiler/platform is LLP so int is 32 bits.
 static inline int64_t atomic_swap_64(volatile int64_t* ptr, int64_t val) {
     return __atomic_exchange_n(ptr, val, __ATOMIC_SEQ_CST);
@@ -15,6 +15,16 @@ __BEGIN_CDECLS
 
 #define DPC_THREAD_PRIORITY HIGH_PRIORITY
 
+// each cpu's dpc thread drains everything queued at DPC_PRIORITY_HIGH before it
+// runs anything at DPC_PRIORITY_NORMAL. bottom halves that something is waiting on,
+// like timer expirations, go high; bulk work like freeing thread stacks stays normal.
+typedef enum dpc_priority {
+    DPC_PRIORITY_NORMAL = 0,
+    DPC_PRIORITY_HIGH,
+
+    DPC_PRIORITY_COUNT,
+} dpc_priority_t;
+
 struct dpc;
 typedef void (*dpc_func_t)(struct dpc*);
 
@@ -23,6 +33,10 @@ typedef struct dpc {
 
     dpc_func_t func;
     void* arg;
+    dpc_priority_t priority;
+
+    // when the dpc was last queued, for the latency counters
+    zx_time_t queued;
 } dpc_t;
 
 #define DPC_INITIAL_VALUE                   \
@@ -30,13 +44,19 @@ typedef struct dpc {
         .node = LIST_INITIAL_CLEARED_VALUE, \
         .func = 0,                          \
         .arg = 0,                           \
+        .priority = DPC_PRIORITY_NORMAL,    \
+        .queued = 0,                        \
     }
 
 // initializes dpc for the current cpu
 void dpc_init_for_cpu(void);
 
 // queue an already filled out dpc, optionally reschedule immediately to run the dpc thread.
-// the deferred procedure runs in a dedicated thread that runs at DPC_THREAD_PRIORITY
+// the deferred procedure runs in a dedicated thread that runs at DPC_THREAD_PRIORITY, after
+// the dpcs queued ahead of it at the same or a higher dpc priority.
+//
+// dpcs with the same func that are queued together on a cpu are run as a batch, back to
+// back, so it pays to queue related work with one function.
 zx_status_t dpc_queue(dpc_t* dpc, bool reschedule);
 
 // queue a dpc, but must be holding the thread lock
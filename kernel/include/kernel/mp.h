@@ -57,6 +57,12 @@ void mp_interrupt(mp_ipi_target_t, cpu_mask_t mask);
 // to complete before returning.
 void mp_sync_exec(mp_ipi_target_t, cpu_mask_t mask, mp_sync_task_t task, void* context);
 
+// Post an MP_IPI_GENERIC or MP_IPI_RESCHEDULE request to the mailbox of every
+// cpu in |mask|. A cpu is only interrupted if its mailbox was empty; requests
+// posted while an interrupt is already on its way are served by that one.
+// Used by mp_sync_exec and arch_mp_reschedule.
+void mp_ipi_post(cpu_mask_t mask, mp_ipi_t ipi);
+
 zx_status_t mp_hotplug_cpu_mask(cpu_mask_t mask);
 zx_status_t mp_unplug_cpu_mask(cpu_mask_t mask);
 static inline zx_status_t mp_hotplug_cpu(cpu_num_t cpu) {
@@ -97,6 +103,11 @@ struct mp_state {
     // accessed with the ipi_task_lock held
     struct list_node ipi_task_list[SMP_MAX_CPUS];
 
+    // per cpu bitmask of (1 << mp_ipi_t) requests posted by mp_ipi_post()
+    // and not yet picked up by the cpu's generic ipi handler.  Only accessed
+    // atomically.
+    volatile int ipi_mailbox[SMP_MAX_CPUS];
+
     // lock for serializing CPU hotplug/unplug operations
     mutex_t hotplug_lock;
 };
@@ -140,6 +151,9 @@ static inline cpu_mask_t mp_get_realtime_mask(void) TA_REQ(thread_lock) {
 // tracks if a cpu is online and initialized
 static inline void mp_set_curr_cpu_online(bool online) {
     if (online) {
+        // Forget anything posted while we were offline; no interrupt was
+        // sent for it and none would be sent for new requests.
+        atomic_store(&mp.ipi_mailbox[arch_curr_cpu_num()], 0);
         atomic_or((volatile int*)&mp.online_cpus, cpu_num_to_mask(arch_curr_cpu_num()));
     } else {
         atomic_and((volatile int*)&mp.online_cpus, ~cpu_num_to_mask(arch_curr_cpu_num()));
@@ -24,8 +24,11 @@ __BEGIN_CDECLS
 // The val field holds either 0 or a pointer to the thread_t holding the mutex.
 // If one or more threads are blocking and queued up, MUTEX_FLAG_QUEUED is ORed in as well.
 // NOTE: MUTEX_FLAG_QUEUED is only manipulated under the THREAD_LOCK.
+// holder_cpu is the cpu the holder took the mutex on, a hint for contending
+// threads deciding whether to spin; it fills what would otherwise be padding.
 typedef struct TA_CAP("mutex") mutex {
     uint32_t magic;
+    uint32_t holder_cpu;
     uintptr_t val;
     wait_queue_t wait;
 } mutex_t;
@@ -46,6 +49,7 @@ static inline thread_t* mutex_holder(const mutex_t* m) {
 #define MUTEX_INITIAL_VALUE(m)                      \
     {                                               \
         .magic = MUTEX_MAGIC,                       \
+        .holder_cpu = 0,                            \
         .val = 0,                                   \
         .wait = WAIT_QUEUE_INITIAL_VALUE((m).wait), \
     }
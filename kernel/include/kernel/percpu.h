@@ -7,6 +7,7 @@
 
 #include <arch/ops.h>
 #include <kernel/align.h>
+#include <kernel/dpc.h>
 #include <kernel/event.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
@@ -27,15 +28,27 @@ struct percpu {
     // deadline of this cpu's platform timer or ZX_TIME_INFINITE if not set
     zx_time_t next_timer_deadline;
 
+    // true while the running thread is the only runnable one on this cpu and runs
+    // without a preemption timer; guarded by thread_lock
+    bool preempt_tickless;
+
     // per cpu run queue and bitmap to indicate which queues are non empty
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    // deadline class threads with budget left, sorted by absolute deadline.
+    // always serviced ahead of the priority run queues.
+    struct list_node deadline_run_queue;
+
 #if WITH_LOCK_DEP
     // state for runtime lock validation when in irq context
     lockdep_state_t lock_state;
 #endif
 
+    // the thread running on this cpu, updated at every context switch; may be
+    // read without the lock as a hint
+    thread_t* volatile curr_thread;
+
     // thread/cpu level statistics
     struct cpu_stats stats;
 
@@ -45,8 +58,10 @@ struct percpu {
     // kernel counters arena
     int64_t* counters;
 
-    // dpc context
-    list_node_t dpc_list;
+    // dpc context, one queue per dpc priority
+    list_node_t dpc_list[DPC_PRIORITY_COUNT];
+    // the number of dpcs on dpc_list; guarded by dpc_lock
+    size_t dpc_count;
     event_t dpc_event;
     // request the dpc thread to stop by setting to true; guarded by dpc_lock
     bool dpc_stop;
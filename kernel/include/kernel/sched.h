@@ -30,10 +30,23 @@ void sched_migrate(thread_t* t) TA_REQ(thread_lock);
 // pri should be <= MAX_PRIORITY, negative values disable priority inheritance.
 void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) TA_REQ(thread_lock);
 
+// as above, for priority inherited through user mode futexes.
+void sched_inherit_futex_priority(thread_t* t, int pri, bool* local_resched) TA_REQ(thread_lock);
+
 // set the priority of a thread and reset the boost value. This function might reschedule.
 // pri should be 0 <= to <= MAX_PRIORITY.
 void sched_change_priority(thread_t* t, int pri) TA_REQ(thread_lock);
 
+// move the thread into or out of (period == 0) the deadline scheduling class, applying
+// admission control. returns ZX_ERR_NO_RESOURCES if the total reserved bandwidth of all
+// deadline threads would exceed what the active cpus can provide.
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity,
+                               zx_duration_t relative_deadline,
+                               zx_duration_t period) TA_REQ(thread_lock);
+
+// give back the deadline bandwidth of the current thread as it exits
+void sched_release_deadline(thread_t* t) TA_REQ(thread_lock);
+
 // return true if the thread was placed on the current cpu's run queue
 // this usually means the caller should locally reschedule soon
 bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT TA_REQ(thread_lock);
@@ -41,6 +54,14 @@ bool sched_unblock_list(struct list_node* list) __WARN_UNUSED_RESULT TA_REQ(thre
 
 void sched_transition_off_cpu(cpu_num_t old_cpu) TA_REQ(thread_lock);
 
+// let the thread handed this cpu by a direct handoff run ahead of the current thread, which
+// keeps its time slice and priority. see thread_handoff_arm().
+void sched_handoff_yield(void) TA_REQ(thread_lock);
+
+// called by the idle thread of the current cpu to pull runnable threads off of busy peers,
+// walking the cpu topology nearest-first. reschedules if any work was stolen.
+void sched_idle_balance(void) TA_EXCL(thread_lock);
+
 // sched_preempt_timer_tick is called when the preemption timer for a CPU has fired.
 //
 // This function is logically private and should only be called by timer.cpp.
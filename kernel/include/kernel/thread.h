@@ -78,6 +78,27 @@ typedef struct lockdep_state {
     uint8_t last_result;
 } lockdep_state_t;
 
+// parameters and bookkeeping for threads in the deadline scheduling class.
+// a period of 0 means the thread is only scheduled in the priority bands.
+// all fields are guarded by thread_lock.
+typedef struct thread_deadline {
+    zx_duration_t capacity;
+    zx_duration_t relative_deadline;
+    zx_duration_t period;
+
+    // end of the current period and the absolute deadline within it
+    zx_time_t period_end;
+    zx_time_t absolute_deadline;
+
+    // cpu time left in the current period. once exhausted the thread falls back
+    // to the priority bands until its next period starts.
+    zx_duration_t remaining_budget;
+    zx_time_t last_charged;
+
+    // number of periods in which the thread wanted more than its capacity
+    uint64_t overruns;
+} thread_deadline_t;
+
 typedef struct thread {
     int magic;
     struct list_node thread_list_node;
@@ -86,6 +107,8 @@ typedef struct thread {
     struct list_node queue_node;
     enum thread_state state;
     zx_time_t last_started_running;
+    // time the thread was last placed in a run queue, for scheduler latency stats
+    zx_time_t last_ready_time;
     zx_duration_t remaining_time_slice;
     unsigned int flags;
     unsigned int signals;
@@ -106,6 +129,14 @@ typedef struct thread {
     int base_priority;
     int priority_boost;
     int inherited_priority;
+    // the same for user mode priority inheritance futexes, which are tracked apart from
+    // kernel mutexes so that releasing one kind never drops a boost owed to the other.
+    // futex_pi_owned counts the futexes this thread is recorded as owning.
+    int futex_inherited_priority;
+    int futex_pi_owned;
+
+    // deadline scheduling class, see thread_set_deadline()
+    thread_deadline_t deadline;
 
     // current cpu the thread is either running on or in the ready queue, undefined otherwise
     cpu_num_t curr_cpu;
@@ -124,6 +155,10 @@ typedef struct thread {
     // are we allowed to be interrupted on the current thing we're blocked/sleeping on
     bool interruptable;
 
+    // direct handoff state, see thread_handoff_arm()
+    bool handoff_armed;   // the next thread we wake should run here in our place
+    bool handoff_pending; // a thread was handed this cpu but we haven't given it up yet
+
     // number of mutexes we currently hold
     int mutexes_held;
 
@@ -236,6 +271,11 @@ void thread_set_user_callback(thread_t* t, thread_user_callback_t cb);
 thread_t* thread_create(const char* name, thread_start_routine entry, void* arg, int priority);
 thread_t* thread_create_etc(thread_t* t, const char* name, thread_start_routine entry, void* arg,
                             int priority, thread_trampoline_routine alt_trampoline);
+// Allocate and free zeroed thread structures from the cache that
+// thread_create() uses; a structure from here may be flagged
+// THREAD_FLAG_FREE_STRUCT to have the thread free it when it dies.
+thread_t* thread_alloc_struct(void);
+void thread_free_struct(thread_t* t);
 void thread_resume(thread_t*);
 zx_status_t thread_suspend(thread_t*);
 void thread_signal_policy_exception(void);
@@ -254,11 +294,41 @@ zx_status_t thread_join(thread_t* t, int* retcode, zx_time_t deadline);
 zx_status_t thread_detach_and_resume(thread_t* t);
 zx_status_t thread_set_real_time(thread_t* t);
 
+// move the thread into the deadline scheduling class. the thread is guaranteed
+// |capacity| of cpu time within |relative_deadline| of the start of each |period|.
+// returns ZX_ERR_NO_RESOURCES if admitting the thread would overcommit the
+// system. passing a zero period moves the thread back to the priority bands.
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity,
+                                zx_duration_t relative_deadline, zx_duration_t period);
+
+// move the thread back to the priority bands, if it was in the deadline class,
+// and set its priority, without letting it be scheduled in between.
+void thread_clear_deadline_and_set_priority(thread_t* t, int priority);
+
 // scheduler routines to be used by regular kernel code
 void thread_yield(void);      // give up the cpu and time slice voluntarily
 void thread_preempt(void);    // get preempted at irq time
 void thread_reschedule(void); // re-evaluate the run queue on the current cpu
 
+// Priority inheritance for user mode futexes, see FutexContext. The thread lock must be
+// held. thread_futex_pi_acquire() records that |t| owns one more futex and has it inherit
+// |pri|; thread_futex_pi_boost() raises what it inherits from a futex it already owns; and
+// thread_futex_pi_release() drops the boost once |t| owns none.
+void thread_futex_pi_acquire(thread_t* t, int pri) TA_REQ(thread_lock);
+void thread_futex_pi_boost(thread_t* t, int pri) TA_REQ(thread_lock);
+void thread_futex_pi_release(thread_t* t) TA_REQ(thread_lock);
+
+// Direct handoff for synchronous IPC. After thread_handoff_arm(), the next
+// thread the current thread wakes is queued at the head of this cpu's run
+// queue with the rest of our time slice rather than sent to another cpu, on
+// the expectation that we will block or yield to it shortly.
+// thread_handoff_disarm() cancels an arm that woke nobody, and
+// thread_handoff_complete() gives the cpu to the handed-off thread if we
+// haven't blocked since.
+void thread_handoff_arm(void);
+void thread_handoff_disarm(void);
+void thread_handoff_complete(void);
+
 void thread_owner_name(thread_t* t, char out_name[THREAD_NAME_LENGTH]);
 
 // print the backtrace on the current thread
@@ -330,6 +400,10 @@ static inline bool thread_is_real_time_or_idle(thread_t* t) {
     return !!(t->flags & (THREAD_FLAG_REAL_TIME | THREAD_FLAG_IDLE));
 }
 
+static inline bool thread_is_deadline(const thread_t* t) {
+    return t->deadline.period != 0;
+}
+
 // the current thread
 #include <arch/current_thread.h>
 thread_t* get_current_thread(void);
@@ -35,6 +35,8 @@ typedef struct timer {
     zx_time_t scheduled_time;
     zx_duration_t slack; // Stores the applied slack adjustment from
     //                      the ideal scheduled_time.
+    zx_time_t earliest_deadline; // Window the timer is allowed to fire in,
+    zx_time_t latest_deadline;   // as derived from its slack mode.
     timer_callback callback;
     void* arg;
 
@@ -48,6 +50,8 @@ typedef struct timer {
         .node = LIST_INITIAL_CLEARED_VALUE, \
         .scheduled_time = 0,                \
         .slack = 0,                         \
+        .earliest_deadline = 0,             \
+        .latest_deadline = 0,               \
         .callback = NULL,                   \
         .arg = NULL,                        \
         .active_cpu = -1,                   \
@@ -128,6 +132,14 @@ void timer_preempt_reset(zx_time_t deadline);
 // Cancel the current CPU's preemption timer.
 void timer_preempt_cancel(void);
 
+//
+// Cancel the current CPU's preemption timer and pull the platform timer back out to the
+// nearest timer queue deadline, or stop it if the queue is empty, so that no spurious
+// interrupt is taken for the canceled preemption. Takes the timer lock if the platform timer
+// is armed for the preemption timer, so prefer timer_preempt_cancel() unless the cpu is
+// expected to stay in its current thread for a while.
+void timer_preempt_cancel_precise(void);
+
 // Internal routines used when bringing cpus online/offline
 
 // Moves |old_cpu|'s timers (except its preemption timer) to the current cpu
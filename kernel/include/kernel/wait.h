@@ -70,6 +70,10 @@ int wait_queue_wake_one(wait_queue_t*, bool reschedule,
                         zx_status_t wait_queue_error) TA_REQ(thread_lock);
 int wait_queue_wake_all(wait_queue_t*, bool reschedule,
                         zx_status_t wait_queue_error) TA_REQ(thread_lock);
+// like wait_queue_wake_one(), but wakes the thread that blocked last among
+// those of the highest priority
+int wait_queue_wake_newest(wait_queue_t*, bool reschedule,
+                           zx_status_t wait_queue_error) TA_REQ(thread_lock);
 struct thread* wait_queue_dequeue_one(wait_queue_t* wait,
                                       zx_status_t wait_queue_error) TA_REQ(thread_lock);
 
@@ -117,6 +121,10 @@ public:
         return wait_queue_wake_one(&wq_, reschedule, wait_queue_error);
     }
 
+    int WakeNewest(bool reschedule, zx_status_t wait_queue_error) TA_REQ(thread_lock) {
+        return wait_queue_wake_newest(&wq_, reschedule, wait_queue_error);
+    }
+
     int WakeAll(bool reschedule, zx_status_t wait_queue_error) TA_REQ(thread_lock) {
         return wait_queue_wake_one(&wq_, reschedule, wait_queue_error);
     }
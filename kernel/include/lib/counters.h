@@ -20,8 +20,10 @@ __BEGIN_CDECLS
 //   - after N seconds how many outstanding <x> things are allocated?
 //   - up to this point has <Y> ever happened?
 //
-// Currently the only query interface to the counters is the console
-// k counters command. Issue 'k counters help' to learn what it can do.
+// The counters can be queried with the console k counters command. Issue
+// 'k counters help' to learn what it can do. They are also published to
+// userspace as read-only VMOs at /boot/kernel/counters; the layout is in
+// <lib/zircon-internal/kcounter-vmo.h> and system/ulib/kcounter reads them.
 //
 // Kernel counters public API:
 // 1- define a new counter.
@@ -21,13 +21,14 @@ struct ktrace_probe_info {
     uint32_t num;
 } __ALIGNED(16); // align on multiple of 16 to match linker packing of the ktrace_probe section
 
-void* ktrace_open(uint32_t tag);
+// Writes a record of |tag|'s size: a header, then |len| bytes of |payload|.
+// Returns ZX_ERR_UNAVAILABLE if |tag|'s group isn't being traced or there
+// is no room left.
+zx_status_t ktrace_write(uint32_t tag, const void* payload, size_t len);
 void ktrace_tiny(uint32_t tag, uint32_t arg);
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
-    uint32_t* data = (uint32_t*) ktrace_open(tag);
-    if (data) {
-        data[0] = a; data[1] = b; data[2] = c; data[3] = d;
-    }
+    uint32_t args[4] = { a, b, c, d };
+    ktrace_write(tag, args, sizeof(args));
 }
 
 static inline void ktrace_ptr(uint32_t tag, const void* ptr, uint32_t c, uint32_t d) {
@@ -41,24 +42,19 @@ static inline void ktrace_ptr(uint32_t tag, const void* ptr, uint32_t c, uint32_
 
 #define ktrace_probe0(_name) do {                               \
     _ktrace_probe_prologue(_name);                              \
-    ktrace_open(TAG_PROBE_16(info.num));                        \
+    ktrace_write(TAG_PROBE_16(info.num), NULL, 0);              \
 } while (0)
 
 #define ktrace_probe2(_name,arg0,arg1) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint32_t* args = (uint32_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      args[0] = arg0;                                        \
-      args[1] = arg1;                                        \
-    }                                                        \
+    uint32_t args[2] = { (arg0), (arg1) };                   \
+    ktrace_write(TAG_PROBE_24(info.num), args, sizeof(args)); \
 } while (0)
 
 #define ktrace_probe64(_name,arg) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint64_t* args = (uint64_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      *args = arg;                                           \
-    }                                                        \
+    uint64_t args = (arg);                                   \
+    ktrace_write(TAG_PROBE_24(info.num), &args, sizeof(args)); \
 } while (0)
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always);
@@ -43,10 +43,21 @@ enum lk_init_flags {
     LK_INIT_FLAG_ALL_CPUS        = LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_SECONDARY_CPUS,
     LK_INIT_FLAG_CPU_SUSPEND     = 0x4,
     LK_INIT_FLAG_CPU_RESUME      = 0x8,
+
+    /*
+     * The hook doesn't depend on the other hooks of its level and may run in
+     * its own kernel thread, on whichever cpu is free, while init carries on.
+     * Only primary cpu hooks at LK_INIT_LEVEL_THREADING or above can be async;
+     * all of them have finished by the time LK_INIT_LEVEL_USER is reached.
+     */
+    LK_INIT_FLAG_ASYNC           = 0x10,
 };
 
 void lk_init_level(enum lk_init_flags flags, uint start_level, uint stop_level);
 
+/* Waits for every async hook started so far to return. */
+void lk_init_wait_async(void);
+
 static inline void lk_primary_cpu_init_level(uint start_level, uint stop_level)
 {
     lk_init_level(LK_INIT_FLAG_PRIMARY_CPU, start_level, stop_level);
@@ -76,4 +87,7 @@ struct lk_init_struct {
 #define LK_INIT_HOOK(_name, _hook, _level) \
     LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU)
 
+#define LK_INIT_HOOK_ASYNC(_name, _hook, _level) \
+    LK_INIT_HOOK_FLAGS(_name, _hook, _level, LK_INIT_FLAG_PRIMARY_CPU | LK_INIT_FLAG_ASYNC)
+
 __END_CDECLS
@@ -38,6 +38,13 @@ zx_ticks_t ticks_per_second(void);
 /* high-precision timer current_ticks */
 zx_ticks_t current_ticks(void);
 
+struct fp_32_64;
+
+/* If current_time() is the counter that user mode reads for zx_ticks_get()
+ * times a constant factor, store the factor in |ns_per_tick| and return true.
+ * The vDSO uses this to tell the time without entering the kernel. */
+bool platform_get_ns_per_tick(struct fp_32_64* ns_per_tick);
+
 /* super early platform initialization, before almost everything */
 void platform_early_init(void);
 
@@ -13,10 +13,42 @@
 #include <kernel/event.h>
 #include <kernel/percpu.h>
 #include <kernel/spinlock.h>
+#include <lib/counters.h>
 #include <lk/init.h>
+#include <platform.h>
+
+// the most dpcs the dpc thread takes off its queues at once
+#define DPC_BATCH_MAX 8
 
 static spin_lock_t dpc_lock = SPIN_LOCK_INITIAL_VALUE;
 
+KCOUNTER(dpc_queued, "kernel.dpc.queued");
+KCOUNTER(dpc_queued_high, "kernel.dpc.queued.high");
+// the sum of the queue depths each dpc found when it was queued; divided by
+// kernel.dpc.queued, the average depth
+KCOUNTER(dpc_depth, "kernel.dpc.depth");
+KCOUNTER(dpc_run, "kernel.dpc.run");
+// dpcs that ran in the same batch as one before them
+KCOUNTER(dpc_batched, "kernel.dpc.batched");
+// the sum of the times dpcs spent queued; divided by kernel.dpc.run, the average latency
+KCOUNTER(dpc_latency_ns, "kernel.dpc.latency_ns");
+
+// put the dpc at the tail of its priority's list. the caller signals the worker.
+static void dpc_enqueue_locked(struct percpu* cpu, dpc_t* dpc) {
+    DEBUG_ASSERT(dpc->priority < DPC_PRIORITY_COUNT);
+
+    list_node_t* list = &cpu->dpc_list[dpc->priority];
+
+    kcounter_add(dpc_queued, 1);
+    if (dpc->priority == DPC_PRIORITY_HIGH)
+        kcounter_add(dpc_queued_high, 1);
+    kcounter_add(dpc_depth, cpu->dpc_count);
+
+    dpc->queued = current_time();
+    list_add_tail(list, &dpc->node);
+    cpu->dpc_count++;
+}
+
 zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
     DEBUG_ASSERT(dpc);
     DEBUG_ASSERT(dpc->func);
@@ -32,8 +64,7 @@ zx_status_t dpc_queue(dpc_t* dpc, bool reschedule) {
 
     struct percpu* cpu = get_local_percpu();
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
+    dpc_enqueue_locked(cpu, dpc);
 
     spin_unlock_irqrestore(&dpc_lock, state);
 
@@ -56,8 +87,7 @@ zx_status_t dpc_queue_thread_locked(dpc_t* dpc) {
 
     struct percpu* cpu = get_local_percpu();
 
-    // put the dpc at the tail of the list and signal the worker
-    list_add_tail(&cpu->dpc_list, &dpc->node);
+    dpc_enqueue_locked(cpu, dpc);
     event_signal_thread_locked(&cpu->dpc_event);
 
     spin_unlock(&dpc_lock);
@@ -105,31 +135,63 @@ void dpc_shutdown_transition_off_cpu(uint cpu_id) {
     DEBUG_ASSERT(percpu[cpu_id].dpc_stop);
     DEBUG_ASSERT(percpu[cpu_id].dpc_thread == nullptr);
 
-    list_node_t* src_list = &percpu[cpu_id].dpc_list;
-    list_node_t* dst_list = &percpu[cur_cpu].dpc_list;
+    for (int i = 0; i < DPC_PRIORITY_COUNT; ++i) {
+        list_node_t* src_list = &percpu[cpu_id].dpc_list[i];
+        list_node_t* dst_list = &percpu[cur_cpu].dpc_list[i];
 
-    dpc_t* dpc;
-    while ((dpc = list_remove_head_type(src_list, dpc_t, node))) {
-        list_add_tail(dst_list, &dpc->node);
-    }
+        dpc_t* dpc;
+        while ((dpc = list_remove_head_type(src_list, dpc_t, node))) {
+            list_add_tail(dst_list, &dpc->node);
+        }
 
-    // Reset the state so we can restart DPC processing if the CPU comes back online.
-    DEBUG_ASSERT(list_is_empty(&percpu[cpu_id].dpc_list));
+        // Reset the state so we can restart DPC processing if the CPU comes back online.
+        DEBUG_ASSERT(list_is_empty(&percpu[cpu_id].dpc_list[i]));
+    }
+    percpu[cur_cpu].dpc_count += percpu[cpu_id].dpc_count;
+    percpu[cpu_id].dpc_count = 0;
     percpu[cpu_id].dpc_stop = false;
     event_destroy(&percpu[cpu_id].dpc_event);
 
     spin_unlock_irqrestore(&dpc_lock, state);
 }
 
+// take the next batch off |cpu|'s queues: the dpc at the head of the highest priority
+// queue with any, and up to DPC_BATCH_MAX - 1 more at that priority with the same func.
+// they are copied to |batch| because a dpc may be reused or freed as soon as it is off
+// the queue. returns how many were taken.
+static size_t dpc_take_batch_locked(struct percpu* cpu, dpc_t* batch, zx_time_t now) {
+    for (int i = DPC_PRIORITY_COUNT - 1; i >= 0; --i) {
+        list_node_t* list = &cpu->dpc_list[i];
+        dpc_t* dpc = list_peek_head_type(list, dpc_t, node);
+        if (!dpc)
+            continue;
+
+        dpc_func_t func = dpc->func;
+        size_t count = 0;
+        dpc_t* next;
+        list_for_every_entry_safe (list, dpc, next, dpc_t, node) {
+            if (dpc->func != func)
+                continue;
+            list_delete(&dpc->node);
+            kcounter_add(dpc_latency_ns, now - dpc->queued);
+            batch[count++] = *dpc;
+            if (count == DPC_BATCH_MAX)
+                break;
+        }
+        cpu->dpc_count -= count;
+        return count;
+    }
+    return 0;
+}
+
 static int dpc_thread(void* arg) {
-    dpc_t dpc_local;
+    dpc_t batch[DPC_BATCH_MAX];
 
     spin_lock_saved_state_t state;
     arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     struct percpu* cpu = get_local_percpu();
     event_t* event = &cpu->dpc_event;
-    list_node_t* list = &cpu->dpc_list;
 
     arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
@@ -145,22 +207,21 @@ static int dpc_thread(void* arg) {
             return 0;
         }
 
-        // pop a dpc off the list, make a local copy.
-        dpc_t* dpc = list_remove_head_type(list, dpc_t, node);
+        size_t count = dpc_take_batch_locked(cpu, batch, current_time());
 
-        // if the list is now empty, unsignal the event so we block until it is
-        if (!dpc) {
+        // if the lists are now empty, unsignal the event so we block until they aren't
+        if (count == 0)
             event_unsignal(event);
-            dpc_local.func = NULL;
-        } else {
-            dpc_local = *dpc;
-        }
 
         spin_unlock_irqrestore(&dpc_lock, state);
 
-        // call the dpc
-        if (dpc_local.func) {
-            dpc_local.func(&dpc_local);
+        // call the dpcs
+        if (count > 0) {
+            kcounter_add(dpc_run, count);
+            kcounter_add(dpc_batched, count - 1);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            batch[i].func(&batch[i]);
         }
     }
 
@@ -176,7 +237,10 @@ void dpc_init_for_cpu(void) {
         return;
     }
 
-    list_initialize(&cpu->dpc_list);
+    for (auto& list : cpu->dpc_list) {
+        list_initialize(&list);
+    }
+    cpu->dpc_count = 0;
     event_init(&cpu->dpc_event, false, 0);
     cpu->dpc_stop = false;
 
@@ -87,6 +87,43 @@ void mp_interrupt(mp_ipi_target_t target, cpu_mask_t mask) {
     arch_mp_send_ipi(target, mask, MP_IPI_INTERRUPT);
 }
 
+void mp_ipi_post(cpu_mask_t mask, mp_ipi_t ipi) {
+    DEBUG_ASSERT(ipi == MP_IPI_GENERIC || ipi == MP_IPI_RESCHEDULE);
+    const int bit = 1 << ipi;
+
+    // The handler empties the mailbox before serving it, so whoever finds it
+    // empty is the one who has to send the interrupt.
+    cpu_mask_t needs_ipi = 0;
+    while (mask) {
+        cpu_num_t cpu = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(cpu);
+        if (atomic_or(&mp.ipi_mailbox[cpu], bit) == 0) {
+            needs_ipi |= cpu_num_to_mask(cpu);
+        }
+    }
+
+    if (needs_ipi) {
+        __UNUSED zx_status_t status =
+            arch_mp_send_ipi(MP_IPI_TARGET_MASK, needs_ipi, MP_IPI_GENERIC);
+        DEBUG_ASSERT(status == ZX_OK);
+    }
+}
+
+// Run the tasks queued for the local cpu by mp_sync_exec.
+static void mp_run_ipi_tasks(cpu_num_t local_cpu) {
+    while (1) {
+        struct mp_ipi_task* task;
+        spin_lock(&mp.ipi_task_lock);
+        task = list_remove_head_type(&mp.ipi_task_list[local_cpu], struct mp_ipi_task, node);
+        spin_unlock(&mp.ipi_task_lock);
+        if (task == NULL) {
+            break;
+        }
+
+        task->func(task->context);
+    }
+}
+
 struct mp_sync_context {
     mp_sync_task_t task;
     void* task_context;
@@ -167,8 +204,7 @@ void mp_sync_exec(mp_ipi_target_t target, cpu_mask_t mask, mp_sync_task_t task,
     spin_unlock(&mp.ipi_task_lock);
 
     // let CPUs know to begin executing
-    __UNUSED zx_status_t status = arch_mp_send_ipi(MP_IPI_TARGET_MASK, mask, MP_IPI_GENERIC);
-    DEBUG_ASSERT(status == ZX_OK);
+    mp_ipi_post(mask, MP_IPI_GENERIC);
 
     if (targetting_self) {
         bool previous_blocking_disallowed = arch_blocking_disallowed();
@@ -197,11 +233,12 @@ void mp_sync_exec(mp_ipi_target_t target, cpu_mask_t mask, mp_sync_task_t task,
         // tasks queued for us in order to prevent deadlock.
         if (ints_disabled) {
             // Optimistically check if our task list has work without the lock.
-            // mp_mbx_generic_irq will take the lock and check again.
+            // mp_run_ipi_tasks will take the lock and check again.  The
+            // mailbox is left for the interrupt that is on its way.
             if (!list_is_empty(&mp.ipi_task_list[local_cpu])) {
                 bool previous_blocking_disallowed = arch_blocking_disallowed();
                 arch_set_blocking_disallowed(true);
-                mp_mbx_generic_irq(nullptr);
+                mp_run_ipi_tasks(local_cpu);
                 arch_set_blocking_disallowed(previous_blocking_disallowed);
                 continue;
             }
@@ -400,17 +437,14 @@ void mp_mbx_generic_irq(void*) {
 
     CPU_STATS_INC(generic_ipis);
 
-    while (1) {
-        struct mp_ipi_task* task;
-        spin_lock(&mp.ipi_task_lock);
-        task = list_remove_head_type(&mp.ipi_task_list[local_cpu], struct mp_ipi_task, node);
-        spin_unlock(&mp.ipi_task_lock);
-        if (task == NULL) {
-            break;
-        }
-
-        task->func(task->context);
+    // Take everything posted so far; anything posted after this will send a
+    // new interrupt.
+    const int pending = atomic_swap(&mp.ipi_mailbox[local_cpu], 0);
+    if (pending & (1 << MP_IPI_RESCHEDULE)) {
+        mp_mbx_reschedule_irq(nullptr);
     }
+
+    mp_run_ipi_tasks(local_cpu);
 }
 
 void mp_mbx_reschedule_irq(void*) {
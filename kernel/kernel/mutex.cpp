@@ -16,19 +16,86 @@
 
 #include <kernel/mutex.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/percpu.h>
 #include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <kernel/thread_lock.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
+#include <lk/init.h>
+#include <platform.h>
 #include <trace.h>
+#include <zircon/time.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(mutex_spin_acquires, "kernel.mutex.spin.acquires");
+KCOUNTER(mutex_spin_failures, "kernel.mutex.spin.failures");
+
+// set once at boot from kernel.mutex.spin-max-ns. how long a contending thread
+// spins waiting for a running holder before it blocks; 0 disables spinning.
+static zx_duration_t mutex_spin_max = ZX_USEC(10);
+
+static void mutex_cmdline_init(uint level) {
+    mutex_spin_max = cmdline_get_uint64("kernel.mutex.spin-max-ns", mutex_spin_max);
+}
+
+LK_INIT_HOOK(mutex_cmdline, mutex_cmdline_init, LK_INIT_LEVEL_PLATFORM);
+
+// note which cpu the current thread holds the mutex on
+static inline void mutex_set_holder_cpu(mutex_t* m) {
+    atomic_store_relaxed_u32(&m->holder_cpu, arch_curr_cpu_num());
+}
+
+// A holder running on another cpu is likely to release the mutex soon, sooner
+// than it would take us to block and be woken, so while it is running give it
+// a bounded amount of time to do so. Returns true if we got the mutex.
+static bool mutex_spin(mutex_t* m, thread_t* ct) {
+    if (mutex_spin_max == 0) {
+        return false;
+    }
+
+    zx_time_t deadline = zx_time_add_duration(current_time(), mutex_spin_max);
+    for (;;) {
+        uintptr_t oldval = mutex_val(m);
+        if (oldval == 0) {
+            if (atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct)) {
+                kcounter_add(mutex_spin_acquires, 1);
+                return true;
+            }
+            continue;
+        }
+
+        // once someone has queued up, release hands the mutex straight to a
+        // waiter, so spinning can't win
+        if (oldval & MUTEX_FLAG_QUEUED) {
+            break;
+        }
+
+        // only compare the holder against what the cpu is running; it may be
+        // gone by now, so it must not be dereferenced
+        cpu_num_t cpu = atomic_load_relaxed_u32(&m->holder_cpu);
+        if (cpu >= SMP_MAX_CPUS || percpu[cpu].curr_thread != (thread_t*)oldval) {
+            break;
+        }
+
+        if (current_time() >= deadline) {
+            break;
+        }
+        arch_spinloop_pause();
+    }
+
+    kcounter_add(mutex_spin_failures, 1);
+    return false;
+}
+
 /**
  * @brief  Initialize a mutex_t
  */
@@ -75,6 +142,7 @@ retry:
     oldval = 0;
     if (likely(atomic_cmpxchg_u64(&m->val, &oldval, (uintptr_t)ct))) {
         // acquired it cleanly
+        mutex_set_holder_cpu(m);
         ct->mutexes_held++;
         return;
     }
@@ -85,6 +153,12 @@ retry:
               ct, ct->name, m);
 #endif
 
+    if (mutex_spin(m, ct)) {
+        mutex_set_holder_cpu(m);
+        ct->mutexes_held++;
+        return;
+    }
+
     {
         // we contended with someone else, will probably need to block
         Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
@@ -119,6 +193,7 @@ retry:
         DEBUG_ASSERT(ct == mutex_holder(m));
 
         // record that we hold it
+        mutex_set_holder_cpu(m);
         ct->mutexes_held++;
     }
 }
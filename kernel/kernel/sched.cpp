@@ -6,15 +6,23 @@
 // https://opensource.org/licenses/MIT
 #include <kernel/sched.h>
 
+#include <arch/mp.h>
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/cmdline.h>
+#include <kernel/lockdep.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
+#include <kernel/thread_lock.h>
+#include <lib/console.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <list.h>
+#include <lk/init.h>
 #include <platform.h>
 #include <printf.h>
 #include <string.h>
@@ -53,14 +61,97 @@
 // threads get 10ms to run before they use up their time slice and the scheduler is invoked
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+// an idle cpu steals at most this many threads from a busy peer per balancing pass
+#define IDLE_BALANCE_MAX_STEAL 4
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
 
+KCOUNTER(sched_idle_balance_passes, "kernel.sched.idle_balance.passes");
+KCOUNTER(sched_idle_balance_steals, "kernel.sched.idle_balance.steals");
+
+// set once at boot from kernel.sched.idle-balance
+static bool idle_balance_enabled = true;
+
+// set once at boot from kernel.sched.tickless. when enabled a cpu with a single runnable
+// thread does not arm its preemption timer until more work shows up in its run queue.
+static bool tickless_enabled = false;
+
+KCOUNTER(sched_tickless_entries, "kernel.sched.tickless.entries");
+
+// scheduler latency histograms
+//
+// each histogram is a run of kcounters whose names sort next to each other, so the buckets
+// occupy consecutive kcounter slots and are kept per cpu for free. bucket 0 counts durations
+// under 1us, bucket i counts [2^(i+9), 2^(i+10)) ns and the last bucket everything longer.
+#define SCHED_HISTOGRAM_BUCKETS 16
+#define SCHED_HISTOGRAM_SHIFT 9
+
+#define KCOUNTER_SCHED_HISTOGRAM(var, name)    \
+    KCOUNTER(var##_b00, name ".b00");          \
+    KCOUNTER(var##_b01, name ".b01");          \
+    KCOUNTER(var##_b02, name ".b02");          \
+    KCOUNTER(var##_b03, name ".b03");          \
+    KCOUNTER(var##_b04, name ".b04");          \
+    KCOUNTER(var##_b05, name ".b05");          \
+    KCOUNTER(var##_b06, name ".b06");          \
+    KCOUNTER(var##_b07, name ".b07");          \
+    KCOUNTER(var##_b08, name ".b08");          \
+    KCOUNTER(var##_b09, name ".b09");          \
+    KCOUNTER(var##_b10, name ".b10");          \
+    KCOUNTER(var##_b11, name ".b11");          \
+    KCOUNTER(var##_b12, name ".b12");          \
+    KCOUNTER(var##_b13, name ".b13");          \
+    KCOUNTER(var##_b14, name ".b14");          \
+    KCOUNTER(var##_b15, name ".b15")
+
+// time spent READY in a run queue before getting to run
+KCOUNTER_SCHED_HISTOGRAM(sched_wait_hist, "kernel.sched.latency.wait");
+// cpu time actually used by a thread each time it is switched away from
+KCOUNTER_SCHED_HISTOGRAM(sched_quantum_hist, "kernel.sched.latency.quantum");
+// threads that started running on a different cpu than they last ran on
+KCOUNTER(sched_migrations, "kernel.sched.migrations");
+
+static uint sched_histogram_bucket(zx_duration_t duration) {
+    if (duration < (1 << (SCHED_HISTOGRAM_SHIFT + 1))) {
+        return 0;
+    }
+    uint log2 = 63 - __builtin_clzll((uint64_t)duration);
+    return MIN(log2 - SCHED_HISTOGRAM_SHIFT, SCHED_HISTOGRAM_BUCKETS - 1u);
+}
+
+static inline void sched_histogram_add(const struct k_counter_desc* first_bucket,
+                                       zx_duration_t duration) {
+    kcounter_add(kcountdesc_begin + kcounter_index(first_bucket) +
+                     sched_histogram_bucket(duration),
+                 1);
+}
+
+static inline uint32_t saturate_u32(zx_duration_t duration) {
+    return duration > UINT32_MAX ? UINT32_MAX : (duration < 0 ? 0 : (uint32_t)duration);
+}
+
+// deadline class bandwidth is accounted in parts per million of one cpu. admission control
+// keeps the total reserved by all deadline threads under this percentage of the active cpus,
+// leaving headroom for the priority bands.
+#define DEADLINE_UTILIZATION_SCALE 1000000u
+#define DEADLINE_UTILIZATION_LIMIT_PERCENT 80u
+
+static uint64_t deadline_utilization TA_GUARDED(thread_lock) = 0;
+
+KCOUNTER(sched_deadline_admitted, "kernel.sched.deadline.admitted");
+KCOUNTER(sched_deadline_rejected, "kernel.sched.deadline.rejected");
+KCOUNTER(sched_deadline_overruns, "kernel.sched.deadline.overruns");
+KCOUNTER(sched_handoffs, "kernel.sched.handoffs");
+
 // compute the effective priority of a thread
 static void compute_effec_priority(thread_t* t) {
     int ep = t->base_priority + t->priority_boost;
     if (t->inherited_priority > ep) {
         ep = t->inherited_priority;
     }
+    if (t->futex_inherited_priority > ep) {
+        ep = t->futex_inherited_priority;
+    }
 
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
 
@@ -152,6 +243,29 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     }
 }
 
+// out of |mask|, find the cpus that are closest to |origin| in the cache topology and
+// return one of them. returns the closest distance found in |distance_out|.
+static cpu_mask_t nearest_cpu_mask(cpu_num_t origin, cpu_mask_t mask, uint* distance_out) {
+    cpu_mask_t nearest = 0;
+    uint nearest_distance = CPU_DISTANCE_MAX + 1;
+
+    while (mask) {
+        cpu_num_t cpu = lowest_cpu_set(mask);
+        mask &= ~cpu_num_to_mask(cpu);
+
+        uint distance = arch_cpu_distance(origin, cpu);
+        if (distance < nearest_distance) {
+            nearest_distance = distance;
+            nearest = cpu_num_to_mask(cpu);
+        } else if (distance == nearest_distance) {
+            nearest |= cpu_num_to_mask(cpu);
+        }
+    }
+
+    *distance_out = nearest_distance;
+    return rand_cpu(nearest);
+}
+
 // find a cpu to wake up
 static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
     // get the last cpu the thread ran on
@@ -169,21 +283,34 @@ static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
     // get a list of idle cpus and mask off the ones that aren't in our affinity mask
     cpu_mask_t idle_cpu_mask = mp_get_idle_mask();
     cpu_mask_t active_cpu_mask = mp_get_active_mask();
-    idle_cpu_mask &= cpu_affinity;
+    idle_cpu_mask &= cpu_affinity & active_cpu_mask;
     if (idle_cpu_mask != 0) {
+        if (last_ran_cpu_mask & idle_cpu_mask) {
+            // the last core it ran on is idle, its caches are the warmest
+            return last_ran_cpu_mask;
+        }
+
+        // prefer an idle smt sibling or a core sharing the last level cache with the
+        // cpu the thread last ran on
+        cpu_mask_t nearest = 0;
+        if (is_valid_cpu_num(t->last_cpu)) {
+            uint distance;
+            nearest = nearest_cpu_mask(t->last_cpu, idle_cpu_mask, &distance);
+            if (nearest != 0 && distance <= CPU_DISTANCE_CACHE) {
+                return nearest;
+            }
+        }
+
         if (idle_cpu_mask & curr_cpu_mask) {
             // the current cpu is idle and within our affinity mask, so run it here
             return curr_cpu_mask;
         }
 
-        if (last_ran_cpu_mask & idle_cpu_mask) {
-            DEBUG_ASSERT(last_ran_cpu_mask & mp_get_active_mask());
-            // the last core it ran on is idle and isn't the current cpu
-            return last_ran_cpu_mask;
-        }
-
-        // pick an idle_cpu
+        // pick an idle_cpu, still preferring the one closest to where the thread last ran
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
+        if (nearest != 0) {
+            return nearest;
+        }
         return rand_cpu(idle_cpu_mask);
     }
 
@@ -212,25 +339,150 @@ static cpu_mask_t find_cpu_mask(thread_t* t) TA_REQ(thread_lock) {
     return mask;
 }
 
+// deadline class bookkeeping
+//
+// a deadline thread only sits in the deadline run queue while it has budget left in its
+// current period. the budget is only ever changed while the thread is not in a run queue,
+// so whether it has budget tells which queue it is in.
+static inline bool thread_in_deadline_queue(const thread_t* t) {
+    return thread_is_deadline(t) && t->deadline.remaining_budget > 0;
+}
+
+static uint64_t deadline_utilization_of(zx_duration_t capacity, zx_duration_t period) {
+    return period ? (uint64_t)capacity * DEADLINE_UTILIZATION_SCALE / (uint64_t)period : 0;
+}
+
+// start a new period if the current one is over. called just before a deadline thread is
+// placed in a run queue.
+static void deadline_replenish(thread_t* t) TA_REQ(thread_lock) {
+    zx_time_t now = current_time();
+    if (now < t->deadline.period_end) {
+        return;
+    }
+    t->deadline.period_end = zx_time_add_duration(now, t->deadline.period);
+    t->deadline.absolute_deadline = zx_time_add_duration(now, t->deadline.relative_deadline);
+    t->deadline.remaining_budget = t->deadline.capacity;
+}
+
+// charge the current thread's budget for the time it has run since it was last charged.
+// |still_runnable| is true if the thread is being preempted rather than blocking, so that
+// running out of budget counts as an overrun of its reservation.
+static void deadline_charge_current(thread_t* t, bool still_runnable) TA_REQ(thread_lock) {
+    if (!thread_in_deadline_queue(t)) {
+        return;
+    }
+
+    zx_time_t now = current_time();
+    zx_time_t since = MAX(t->last_started_running, t->deadline.last_charged);
+    zx_duration_t used = zx_time_sub_time(now, since);
+    t->deadline.last_charged = now;
+
+    if (used < t->deadline.remaining_budget) {
+        t->deadline.remaining_budget = zx_duration_sub_duration(t->deadline.remaining_budget, used);
+        return;
+    }
+
+    t->deadline.remaining_budget = 0;
+    if (still_runnable) {
+        t->deadline.overruns++;
+        kcounter_add(sched_deadline_overruns, 1);
+        LOCAL_KTRACE2("sched_deadline_overrun", (uint32_t)t->user_tid,
+                      (uint32_t)t->deadline.overruns);
+    }
+}
+
 // run queue manipulation
+
+// true if any thread is queued on |c|
+static bool run_queue_has_ready(const struct percpu* c) TA_REQ(thread_lock) {
+    return c->run_queue_bitmap != 0 || !list_is_empty(&c->deadline_run_queue);
+}
+
+// a thread was just queued on |cpu|. if that cpu is running a thread without a preemption
+// timer because it was the only runnable thread there, make sure it gets one now.
+static void tickless_queue_changed(cpu_num_t cpu) TA_REQ(thread_lock) {
+    if (likely(!percpu[cpu].preempt_tickless)) {
+        return;
+    }
+
+    if (cpu == arch_curr_cpu_num()) {
+        thread_t* current_thread = get_current_thread();
+        if (current_thread->state == THREAD_RUNNING) {
+            percpu[cpu].preempt_tickless = false;
+            timer_preempt_reset(zx_time_add_duration(current_thread->last_started_running,
+                                                     current_thread->remaining_time_slice));
+        }
+    } else {
+        // the remote cpu re-evaluates and arms its timer from sched_resched_internal()
+        mp_reschedule(cpu_num_to_mask(cpu), 0);
+    }
+}
+
+// insert into the cpu's deadline run queue, earliest absolute deadline first
+static void insert_in_deadline_queue(struct percpu* c, thread_t* t) TA_REQ(thread_lock) {
+    thread_t* entry;
+    list_for_every_entry (&c->deadline_run_queue, entry, thread_t, queue_node) {
+        if (t->deadline.absolute_deadline < entry->deadline.absolute_deadline) {
+            // adding to the tail of an entry's node puts us right in front of it
+            list_add_tail(&entry->queue_node, &t->queue_node);
+            return;
+        }
+    }
+    list_add_tail(&c->deadline_run_queue, &t->queue_node);
+}
+
+// returns true if the thread was queued in the deadline run queue of |cpu|
+static bool insert_in_run_queue_deadline(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
+    if (likely(!thread_is_deadline(t))) {
+        return false;
+    }
+
+    deadline_replenish(t);
+    if (!thread_in_deadline_queue(t)) {
+        // out of budget for this period, compete in the priority bands until it's replenished
+        return false;
+    }
+
+    struct percpu* c = &percpu[cpu];
+    insert_in_deadline_queue(c, t);
+
+    mp_set_cpu_busy(cpu);
+    tickless_queue_changed(cpu);
+    return true;
+}
+
 static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
-    list_add_head(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    t->last_ready_time = current_time();
+    if (insert_in_run_queue_deadline(cpu, t)) {
+        return;
+    }
+
+    struct percpu* c = &percpu[cpu];
+    list_add_head(&c->run_queue[t->effec_priority], &t->queue_node);
+    c->run_queue_bitmap |= (1u << t->effec_priority);
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
+    tickless_queue_changed(cpu);
 }
 
 static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
-    list_add_tail(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    t->last_ready_time = current_time();
+    if (insert_in_run_queue_deadline(cpu, t)) {
+        return;
+    }
+
+    struct percpu* c = &percpu[cpu];
+    list_add_tail(&c->run_queue[t->effec_priority], &t->queue_node);
+    c->run_queue_bitmap |= (1u << t->effec_priority);
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
+    tickless_queue_changed(cpu);
 }
 
 // remove the thread from the run queue it's in
@@ -238,11 +490,11 @@ static void remove_from_run_queue(thread_t* t, int prio_queue) TA_REQ(thread_loc
     DEBUG_ASSERT(t->state == THREAD_READY);
     DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
 
+    struct percpu* c = &percpu[t->curr_cpu];
     list_delete(&t->queue_node);
 
     // clear the old cpu's queue bitmap if that was the last entry
-    struct percpu* c = &percpu[t->curr_cpu];
-    if (list_is_empty(&c->run_queue[prio_queue])) {
+    if (!thread_in_deadline_queue(t) && list_is_empty(&c->run_queue[prio_queue])) {
         c->run_queue_bitmap &= ~(1u << prio_queue);
     }
 }
@@ -258,10 +510,21 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
     // queued up on the passed in cpu.
 
     struct percpu* c = &percpu[cpu];
+
+    // deadline threads with budget left always go first
+    thread_t* newthread = list_remove_head_type(&c->deadline_run_queue, thread_t, queue_node);
+    if (unlikely(newthread)) {
+        DEBUG_ASSERT(newthread->curr_cpu == cpu);
+
+        LOCAL_KTRACE2("sched_get_top deadline", (uint32_t)newthread->user_tid,
+                      (uint32_t)newthread->deadline.remaining_budget);
+        return newthread;
+    }
+
     if (likely(c->run_queue_bitmap)) {
         uint highest_queue = highest_run_queue(c);
 
-        thread_t* newthread = list_remove_head_type(&c->run_queue[highest_queue], thread_t, queue_node);
+        newthread = list_remove_head_type(&c->run_queue[highest_queue], thread_t, queue_node);
 
         DEBUG_ASSERT(newthread);
         DEBUG_ASSERT_MSG(newthread->cpu_affinity & cpu_num_to_mask(cpu),
@@ -286,19 +549,148 @@ void sched_init_thread(thread_t* t, int priority) {
     t->base_priority = priority;
     t->priority_boost = 0;
     t->inherited_priority = -1;
+    t->futex_inherited_priority = -1;
     compute_effec_priority(t);
 }
 
+// try to pull up to |max_steal| ready threads off of |victim|'s run queues onto |thief|'s.
+// the lowest priority eligible threads are taken first, leaving the victim the work it
+// would run next while its cache is warm. returns the number of threads moved.
+static uint steal_from_cpu(cpu_num_t victim, cpu_num_t thief, uint max_steal) TA_REQ(thread_lock) {
+    struct percpu* v = &percpu[victim];
+    const cpu_mask_t thief_mask = cpu_num_to_mask(thief);
+
+    list_node_t stolen = LIST_INITIAL_VALUE(stolen);
+    uint count = 0;
+
+    // take half of the victim's queued threads, or its only one: a queued thread on a busy
+    // cpu is by definition waiting behind whatever the victim is running right now. only
+    // count as far as it takes to know the budget.
+    uint32_t queued = 0;
+    for (uint32_t bitmap = v->run_queue_bitmap; bitmap && queued < 2 * max_steal;) {
+        uint prio = __builtin_ctz(bitmap);
+        bitmap &= ~(1u << prio);
+        list_node_t* node;
+        list_for_every (&v->run_queue[prio], node) {
+            if (++queued >= 2 * max_steal) {
+                break;
+            }
+        }
+    }
+    uint32_t budget = MIN(MAX(queued / 2, 1u), max_steal);
+
+    uint32_t bitmap = v->run_queue_bitmap;
+    while (bitmap && count < budget) {
+        uint prio = __builtin_ctz(bitmap);
+        bitmap &= ~(1u << prio);
+
+        thread_t* t;
+        thread_t* temp;
+        list_for_every_entry_safe (&v->run_queue[prio], t, temp, thread_t, queue_node) {
+            if (count >= budget) {
+                break;
+            }
+            if (thread_is_real_time_or_idle(t) || !(t->cpu_affinity & thief_mask)) {
+                continue;
+            }
+            DEBUG_ASSERT(t->state == THREAD_READY);
+            DEBUG_ASSERT(t->curr_cpu == victim);
+
+            list_delete(&t->queue_node);
+            if (list_is_empty(&v->run_queue[prio])) {
+                v->run_queue_bitmap &= ~(1u << prio);
+            }
+            list_add_tail(&stolen, &t->queue_node);
+            count++;
+        }
+    }
+
+    // requeue once the walk over the victim's queues is done
+    thread_t* t;
+    while ((t = list_remove_head_type(&stolen, thread_t, queue_node)) != NULL) {
+        t->curr_cpu = thief;
+        insert_in_run_queue_tail(thief, t);
+    }
+
+    return count;
+}
+
+// called from the idle loop of the current cpu. walks the other active cpus nearest-first
+// by cache topology and steals runnable work from the first busy peer that has any.
+void sched_idle_balance() {
+    if (!idle_balance_enabled) {
+        return;
+    }
+
+    const cpu_num_t curr_cpu = arch_curr_cpu_num();
+
+    // cheap unlocked scan of the peers' queue bitmaps to avoid bouncing thread_lock when
+    // nobody has queued work
+    cpu_mask_t candidates = 0;
+    cpu_mask_t active = mp_get_active_mask() & ~cpu_num_to_mask(curr_cpu);
+    while (active) {
+        cpu_num_t cpu = lowest_cpu_set(active);
+        active &= ~cpu_num_to_mask(cpu);
+        if (atomic_load_u32(&percpu[cpu].run_queue_bitmap) != 0) {
+            candidates |= cpu_num_to_mask(cpu);
+        }
+    }
+    if (candidates == 0) {
+        return;
+    }
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    thread_t* current_thread = get_current_thread();
+    if (!thread_is_idle(current_thread) || run_queue_has_ready(&percpu[curr_cpu])) {
+        // something already showed up locally
+        return;
+    }
+
+    kcounter_add(sched_idle_balance_passes, 1);
+
+    uint stolen = 0;
+    for (uint distance = CPU_DISTANCE_SMT; distance <= CPU_DISTANCE_MAX && !stolen; distance++) {
+        cpu_mask_t mask = candidates;
+        while (mask && !stolen) {
+            cpu_num_t cpu = lowest_cpu_set(mask);
+            mask &= ~cpu_num_to_mask(cpu);
+            if (arch_cpu_distance(curr_cpu, cpu) != distance) {
+                continue;
+            }
+            if (percpu[cpu].run_queue_bitmap == 0) {
+                continue;
+            }
+            stolen = steal_from_cpu(cpu, curr_cpu, IDLE_BALANCE_MAX_STEAL);
+        }
+    }
+
+    if (stolen) {
+        kcounter_add(sched_idle_balance_steals, stolen);
+        LOCAL_KTRACE2("sched_idle_balance", curr_cpu, stolen);
+        sched_reschedule();
+    }
+}
+
+static void sched_cmdline_init(uint level) {
+    idle_balance_enabled = cmdline_get_bool("kernel.sched.idle-balance", true);
+    tickless_enabled = cmdline_get_bool("kernel.sched.tickless", false);
+}
+
+LK_INIT_HOOK(sched_cmdline, sched_cmdline_init, LK_INIT_LEVEL_PLATFORM);
+
 void sched_block() {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
-    __UNUSED thread_t* current_thread = get_current_thread();
+    thread_t* current_thread = get_current_thread();
 
     DEBUG_ASSERT(current_thread->magic == THREAD_MAGIC);
     DEBUG_ASSERT(current_thread->state != THREAD_RUNNING);
 
     LOCAL_KTRACE0("sched_block");
 
+    deadline_charge_current(current_thread, false);
+
     // we are blocking on something. the blocking code should have already stuck us on a queue
     sched_resched_internal();
 }
@@ -328,6 +720,38 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched,
     }
 }
 
+// if the current thread armed a direct handoff, queue |t| at the head of the local run queue to
+// run as soon as the current thread blocks, handing it what is left of the current time slice.
+// returns false if |t| should be placed as usual.
+static bool sched_try_handoff(thread_t* t) TA_REQ(thread_lock) {
+    thread_t* current_thread = get_current_thread();
+    if (likely(!current_thread->handoff_armed) || arch_blocking_disallowed()) {
+        return false;
+    }
+    // an arm covers a single wakeup
+    current_thread->handoff_armed = false;
+
+    const cpu_num_t curr_cpu = arch_curr_cpu_num();
+    if (!(t->cpu_affinity & cpu_num_to_mask(curr_cpu)) || thread_is_deadline(t) ||
+        thread_is_idle(current_thread)) {
+        return false;
+    }
+
+    zx_duration_t used = zx_time_sub_time(current_time(), current_thread->last_started_running);
+    zx_duration_t left = zx_duration_sub_duration(
+        current_thread->remaining_time_slice, MIN(used, current_thread->remaining_time_slice));
+    if (left > t->remaining_time_slice) {
+        t->remaining_time_slice = left;
+    }
+
+    // no reschedule here: the waker blocks soon, or calls thread_handoff_complete()
+    t->curr_cpu = curr_cpu;
+    insert_in_run_queue_head(curr_cpu, t);
+    current_thread->handoff_pending = true;
+    kcounter_add(sched_handoffs, 1);
+    return true;
+}
+
 bool sched_unblock(thread_t* t) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -341,6 +765,10 @@ bool sched_unblock(thread_t* t) {
     // stuff the new thread in the run queue
     t->state = THREAD_READY;
 
+    if (sched_try_handoff(t)) {
+        return false;
+    }
+
     bool local_resched = false;
     cpu_mask_t mask = 0;
     find_cpu_and_insert(t, &local_resched, &mask);
@@ -370,6 +798,9 @@ bool sched_unblock_list(struct list_node* list) {
 
         // stuff the new thread in the run queue
         t->state = THREAD_READY;
+        if (sched_try_handoff(t)) {
+            continue;
+        }
         find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
     }
 
@@ -404,6 +835,9 @@ void sched_yield() {
 
     LOCAL_KTRACE0("sched_yield");
 
+    // giving up the rest of the reservation voluntarily is not an overrun
+    deadline_charge_current(current_thread, false);
+
     // consume the rest of the time slice, deboost ourself, and go to the end of a queue
     current_thread->remaining_time_slice = 0;
     deboost_thread(current_thread, false);
@@ -418,6 +852,35 @@ void sched_yield() {
     sched_resched_internal();
 }
 
+void sched_handoff_yield() {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    thread_t* current_thread = get_current_thread();
+    uint curr_cpu = arch_curr_cpu_num();
+
+    if (!current_thread->handoff_pending) {
+        return;
+    }
+    if (current_thread->disable_counts != 0) {
+        current_thread->preempt_pending = true;
+        return;
+    }
+
+    LOCAL_KTRACE0("sched_handoff_yield");
+
+    deadline_charge_current(current_thread, true);
+
+    current_thread->state = THREAD_READY;
+
+    if (local_migrate_if_needed(current_thread)) {
+        return;
+    }
+
+    // unlike a yield, keep the time slice and boost; just step behind the handed-off thread
+    insert_in_run_queue_tail(curr_cpu, current_thread);
+    sched_resched_internal();
+}
+
 // the current thread is being preempted from interrupt context
 void sched_preempt() {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
@@ -429,6 +892,8 @@ void sched_preempt() {
     DEBUG_ASSERT(current_thread->last_cpu == current_thread->curr_cpu);
     LOCAL_KTRACE0("sched_preempt");
 
+    deadline_charge_current(current_thread, true);
+
     current_thread->state = THREAD_READY;
 
     // idle thread doesn't go in the run queue
@@ -468,6 +933,8 @@ void sched_reschedule() {
     DEBUG_ASSERT(current_thread->last_cpu == current_thread->curr_cpu);
     LOCAL_KTRACE0("sched_reschedule");
 
+    deadline_charge_current(current_thread, true);
+
     current_thread->state = THREAD_READY;
 
     // idle thread doesn't go in the run queue
@@ -496,6 +963,7 @@ static void migrate_current_thread(thread_t* current_thread) TA_REQ(thread_lock)
     cpu_mask_t accum_cpu_mask = 0;
 
     // current thread, so just shove ourself into another cpu's queue and reschedule locally
+    deadline_charge_current(current_thread, true);
     current_thread->state = THREAD_READY;
     find_cpu_and_insert(current_thread, &local_resched, &accum_cpu_mask);
     if (accum_cpu_mask) {
@@ -659,22 +1127,20 @@ static void sched_priority_changed(thread_t* t, int old_prio,
     }
 }
 
-// set the priority to the higher value of what it was before and the newly inherited value
-// pri < 0 disables priority inheritance and goes back to the naturally computed values
-void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
-    DEBUG_ASSERT(spin_lock_held(&thread_lock));
-
+// shared by the two kinds of inheritance, |inherited| being the one to adjust
+static void set_inherited_priority(thread_t* t, int* inherited, int pri, bool* local_resched)
+    TA_REQ(thread_lock) {
     if (pri > HIGHEST_PRIORITY) {
         pri = HIGHEST_PRIORITY;
     }
 
     // if we're setting it to something real and it's less than the current, skip
-    if (pri >= 0 && pri <= t->inherited_priority) {
+    if (pri >= 0 && pri <= *inherited) {
         return;
     }
 
     // adjust the priority and remember the old value
-    t->inherited_priority = pri;
+    *inherited = pri;
     int old_ep = t->effec_priority;
     compute_effec_priority(t);
     if (old_ep == t->effec_priority) {
@@ -692,6 +1158,20 @@ void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
     }
 }
 
+// set the priority to the higher value of what it was before and the newly inherited value
+// pri < 0 disables priority inheritance and goes back to the naturally computed values
+void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    set_inherited_priority(t, &t->inherited_priority, pri, local_resched);
+}
+
+void sched_inherit_futex_priority(thread_t* t, int pri, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    set_inherited_priority(t, &t->futex_inherited_priority, pri, local_resched);
+}
+
 // changes the thread's base priority and if the re-computed effective priority changed
 //  then the thread is moved to the proper queue on the same processor and a re-schedule
 //  might be issued.
@@ -731,6 +1211,85 @@ void sched_change_priority(thread_t* t, int pri) {
     }
 }
 
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity,
+                               zx_duration_t relative_deadline, zx_duration_t period) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(period == 0 || (capacity > 0 && capacity <= relative_deadline &&
+                                 relative_deadline <= period));
+
+    if (unlikely(t->state == THREAD_DEATH)) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // admission control
+    const uint64_t old_util = deadline_utilization_of(t->deadline.capacity, t->deadline.period);
+    const uint64_t new_util = deadline_utilization_of(capacity, period);
+    if (new_util > old_util) {
+        const uint64_t limit = (uint64_t)__builtin_popcount(mp_get_active_mask()) *
+                               DEADLINE_UTILIZATION_SCALE * DEADLINE_UTILIZATION_LIMIT_PERCENT / 100;
+        if (deadline_utilization - old_util + new_util > limit) {
+            kcounter_add(sched_deadline_rejected, 1);
+            return ZX_ERR_NO_RESOURCES;
+        }
+    }
+    deadline_utilization = deadline_utilization - old_util + new_util;
+    if (period) {
+        kcounter_add(sched_deadline_admitted, 1);
+    }
+
+    // pull a ready thread out of its queue, since the change may move it between the deadline
+    // and priority run queues
+    const bool queued = (t->state == THREAD_READY) && list_in_list(&t->queue_node);
+    if (queued) {
+        remove_from_run_queue(t, t->effec_priority);
+    }
+
+    t->deadline.capacity = capacity;
+    t->deadline.relative_deadline = relative_deadline;
+    t->deadline.period = period;
+    // start a fresh period the next time the thread is queued
+    t->deadline.period_end = 0;
+    t->deadline.absolute_deadline = 0;
+    t->deadline.remaining_budget = 0;
+
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+    if (queued) {
+        insert_in_run_queue_tail(t->curr_cpu, t);
+        if (t->curr_cpu == arch_curr_cpu_num()) {
+            local_resched = true;
+        } else {
+            accum_cpu_mask = cpu_num_to_mask(t->curr_cpu);
+        }
+    } else if (t->state == THREAD_RUNNING) {
+        // have the thread requeued so it lands in the right class
+        if (t == get_current_thread()) {
+            local_resched = true;
+        } else {
+            accum_cpu_mask = cpu_num_to_mask(t->curr_cpu);
+        }
+    }
+
+    if (accum_cpu_mask) {
+        mp_reschedule(accum_cpu_mask, 0);
+    }
+    if (local_resched) {
+        sched_reschedule();
+    }
+    return ZX_OK;
+}
+
+void sched_release_deadline(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(t == get_current_thread());
+
+    deadline_utilization -= deadline_utilization_of(t->deadline.capacity, t->deadline.period);
+    t->deadline.capacity = 0;
+    t->deadline.relative_deadline = 0;
+    t->deadline.period = 0;
+    t->deadline.remaining_budget = 0;
+}
+
 // preemption timer that is set whenever a thread is scheduled
 void sched_preempt_timer_tick(zx_time_t now) {
     // if the preemption timer went off on the idle or a real time thread, ignore it
@@ -796,6 +1355,8 @@ void sched_resched_internal() {
 
     thread_t* oldthread = current_thread;
     oldthread->preempt_pending = false;
+    // whatever was handed this cpu has had its chance to run now
+    oldthread->handoff_pending = false;
 
     LOCAL_KTRACE2("resched old pri", (uint32_t)oldthread->user_tid, effec_priority(oldthread));
     LOCAL_KTRACE2("resched new pri", (uint32_t)newthread->user_tid, effec_priority(newthread));
@@ -806,6 +1367,13 @@ void sched_resched_internal() {
 
     // if it's the same thread as we're already running, exit
     if (newthread == oldthread) {
+        // a thread that was running tickless needs its preemption timer back once it has
+        // company in the run queue
+        if (unlikely(percpu[cpu].preempt_tickless) && run_queue_has_ready(&percpu[cpu])) {
+            percpu[cpu].preempt_tickless = false;
+            timer_preempt_reset(zx_time_add_duration(newthread->last_started_running,
+                                                     newthread->remaining_time_slice));
+        }
         return;
     }
 
@@ -823,14 +1391,37 @@ void sched_resched_internal() {
         newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
     }
 
+    // a deadline thread may not run past its remaining budget in the deadline class
+    if (thread_in_deadline_queue(newthread)) {
+        newthread->remaining_time_slice = MIN(newthread->remaining_time_slice,
+                                              newthread->deadline.remaining_budget);
+        newthread->deadline.last_charged = now;
+    }
+
     newthread->last_started_running = now;
 
+    // latency bookkeeping; the idle thread is never really waiting for anything
+    zx_duration_t wait_time = 0;
+    if (likely(!thread_is_idle(newthread))) {
+        wait_time = zx_time_sub_time(now, MIN(newthread->last_ready_time, now));
+        sched_histogram_add(sched_wait_hist_b00, wait_time);
+        if (is_valid_cpu_num(newthread->last_cpu) && newthread->last_cpu != cpu) {
+            kcounter_add(sched_migrations, 1);
+        }
+    }
+    if (likely(!thread_is_idle(oldthread))) {
+        sched_histogram_add(sched_quantum_hist_b00, old_runtime);
+    }
+    ktrace(TAG_SCHED_LATENCY, (uint32_t)newthread->user_tid, saturate_u32(wait_time),
+           saturate_u32(old_runtime), cpu);
+
     // mark the cpu ownership of the threads
     if (oldthread->state != THREAD_READY) {
         oldthread->curr_cpu = INVALID_CPU;
     }
     newthread->last_cpu = cpu;
     newthread->curr_cpu = cpu;
+    percpu[cpu].curr_thread = newthread;
 
     // if we selected the idle thread the cpu's run queue must be empty, so mark the
     // cpu as idle
@@ -859,14 +1450,29 @@ void sched_resched_internal() {
             (oldthread->effec_priority << 16) | (newthread->effec_priority << 24)),
            (uint32_t)(uintptr_t)oldthread, (uint32_t)(uintptr_t)newthread);
 
+    percpu[cpu].preempt_tickless = false;
     if (thread_is_real_time_or_idle(newthread)) {
-        if (!thread_is_real_time_or_idle(oldthread)) {
+        if (tickless_enabled && thread_is_idle(newthread)) {
+            // going idle, make sure a stale preemption deadline doesn't wake the cpu back up
+            TRACE_CONTEXT_SWITCH("stop preempt (idle), cpu %u, old %p (%s), new %p (%s)\n",
+                                 cpu, oldthread, oldthread->name, newthread, newthread->name);
+            timer_preempt_cancel_precise();
+        } else if (!thread_is_real_time_or_idle(oldthread)) {
             // if we're switching from a non real time to a real time, cancel
             // the preemption timer.
             TRACE_CONTEXT_SWITCH("stop preempt, cpu %u, old %p (%s), new %p (%s)\n",
                                  cpu, oldthread, oldthread->name, newthread, newthread->name);
             timer_preempt_cancel();
         }
+    } else if (tickless_enabled && !run_queue_has_ready(&percpu[cpu]) &&
+               !thread_in_deadline_queue(newthread)) {
+        // nothing else wants this cpu, so there is nothing to preempt in favor of. the timer
+        // is armed again by tickless_queue_changed() as soon as another thread is queued here.
+        TRACE_CONTEXT_SWITCH("tickless, cpu %u, old %p (%s), new %p (%s)\n",
+                             cpu, oldthread, oldthread->name, newthread, newthread->name);
+        kcounter_add(sched_tickless_entries, 1);
+        percpu[cpu].preempt_tickless = true;
+        timer_preempt_cancel_precise();
     } else {
         // set up a one shot timer to handle the remaining time slice on this thread
         TRACE_CONTEXT_SWITCH("start preempt, cpu %u, old %p (%s), new %p (%s)\n",
@@ -901,9 +1507,55 @@ void sched_resched_internal() {
 void sched_init_early() {
     // initialize the run queues
     // 每个 CPU 一个表
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        list_initialize(&percpu[cpu].deadline_run_queue);
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++) {
             // 每个优先级一个链表
             list_initialize(&percpu[cpu].run_queue[i]);
         }
+    }
+}
+
+static void dump_sched_histogram(const char* name, const struct k_counter_desc* first_bucket) {
+    const size_t first = kcounter_index(first_bucket);
+
+    printf("%s (bucket lower bounds: 0, 1us, 2us, 4us ... 16ms)\n", name);
+    cpu_mask_t online = mp_get_online_mask();
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!(online & cpu_num_to_mask(cpu))) {
+            continue;
+        }
+        printf("  cpu %2u:", cpu);
+        for (uint i = 0; i < SCHED_HISTOGRAM_BUCKETS; i++) {
+            // not atomically consistent, but close enough for a histogram
+            printf(" %" PRIi64, percpu[cpu].counters[first + i]);
+        }
+        printf("\n");
+    }
 }
+
+static int cmd_sched(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2 || strcmp(argv[1].str, "stats") != 0) {
+        printf("usage:\n");
+        printf("%s stats : dump per cpu scheduler latency histograms\n", argv[0].str);
+        return -1;
+    }
+
+    dump_sched_histogram("run queue wait time", sched_wait_hist_b00);
+    dump_sched_histogram("quantum used", sched_quantum_hist_b00);
+
+    printf("migrations:");
+    const size_t index = kcounter_index(sched_migrations);
+    cpu_mask_t online = mp_get_online_mask();
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (online & cpu_num_to_mask(cpu)) {
+            printf(" [%u:%" PRIi64 "]", cpu, percpu[cpu].counters[index]);
+        }
+    }
+    printf("\n");
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("sched", "scheduler statistics", &cmd_sched)
+STATIC_COMMAND_END(sched);
@@ -36,6 +36,7 @@
 #include <lib/counters.h>
 #include <lib/heap.h>
 #include <lib/ktrace.h>
+#include <lib/object_cache.h>
 
 #include <list.h>
 #include <malloc.h>
@@ -58,6 +59,9 @@
 //
 // counts the number of thread_t successfully created.
 KCOUNTER(thread_create_count, "kernel.thread.create");
+
+// thread structures allocated by thread_create_etc() itself
+OBJECT_CACHE(thread_struct_cache, "thread", thread_t, 0u);
 // counts the number of thread_t joined. Never decreases.
 KCOUNTER(thread_join_count, "kernel.thread.join");
 // counts the number of calls to suspend() that succeeded.
@@ -155,7 +159,7 @@ thread_t* thread_create_etc(
     unsigned int flags = 0;
 
     if (!t) {
-        t = static_cast<thread_t*>(malloc(sizeof(thread_t)));
+        t = thread_alloc_struct();
         if (!t) {
             return NULL;
         }
@@ -183,7 +187,7 @@ thread_t* thread_create_etc(
     zx_status_t status = vm_allocate_kstack(&t->stack);
     if (status != ZX_OK) {
         if (flags & THREAD_FLAG_FREE_STRUCT) {
-            free(t);
+            thread_free_struct(t);
         }
         return nullptr;
     }
@@ -208,6 +212,18 @@ thread_t* thread_create_etc(
     return t;
 }
 
+thread_t* thread_alloc_struct(void) {
+    void* mem = thread_struct_cache.Alloc();
+    if (mem) {
+        memset(mem, 0, sizeof(thread_t));
+    }
+    return static_cast<thread_t*>(mem);
+}
+
+void thread_free_struct(thread_t* t) {
+    thread_struct_cache.Free(t);
+}
+
 thread_t* thread_create(const char* name, thread_start_routine entry, void* arg, int priority) {
     return thread_create_etc(NULL, name, entry, arg, priority, NULL);
 }
@@ -231,7 +247,7 @@ static void free_thread_resources(thread_t* t) {
     // free the thread structure itself
     t->magic = 0;
     if (t->flags & THREAD_FLAG_FREE_STRUCT) {
-        free(t);
+        thread_free_struct(t);
     }
 }
 
@@ -478,6 +494,11 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread,
     // reusing the stack before the function exits
     dpc_t free_dpc = DPC_INITIAL_VALUE;
 
+    // give back any deadline bandwidth the thread was admitted with
+    if (thread_is_deadline(current_thread)) {
+        sched_release_deadline(current_thread);
+    }
+
     // enter the dead state
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
@@ -796,6 +817,60 @@ void thread_reschedule(void) {
     sched_reschedule();
 }
 
+void thread_futex_pi_acquire(thread_t* t, int pri) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    t->futex_pi_owned++;
+    thread_futex_pi_boost(t, pri);
+}
+
+void thread_futex_pi_boost(thread_t* t, int pri) {
+    DEBUG_ASSERT(t->futex_pi_owned > 0);
+
+    bool local_resched = false;
+    sched_inherit_futex_priority(t, pri, &local_resched);
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+void thread_futex_pi_release(thread_t* t) {
+    DEBUG_ASSERT(t->futex_pi_owned > 0);
+
+    // like kernel mutexes, keep the highest inherited priority until nothing is owned
+    if (--t->futex_pi_owned > 0) {
+        return;
+    }
+
+    bool local_resched = false;
+    sched_inherit_futex_priority(t, -1, &local_resched);
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+void thread_handoff_arm(void) {
+    get_current_thread()->handoff_armed = true;
+}
+
+void thread_handoff_disarm(void) {
+    get_current_thread()->handoff_armed = false;
+}
+
+void thread_handoff_complete(void) {
+    thread_t* current_thread = get_current_thread();
+
+    DEBUG_ASSERT(!current_thread->handoff_armed);
+    // only this thread sets the flag, and the scheduler clears it once we switch away
+    if (!current_thread->handoff_pending) {
+        return;
+    }
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    sched_handoff_yield();
+}
+
 void thread_check_preempt_pending(void) {
     thread_t* current_thread = get_current_thread();
 
@@ -1006,6 +1081,17 @@ void thread_set_user_callback(thread_t* t, thread_user_callback_t cb) {
     t->user_callback = cb;
 }
 
+static void thread_set_priority_locked(thread_t* t, int priority) TA_REQ(thread_lock) {
+    if (priority <= IDLE_PRIORITY) {
+        priority = IDLE_PRIORITY + 1;
+    }
+    if (priority > HIGHEST_PRIORITY) {
+        priority = HIGHEST_PRIORITY;
+    }
+
+    sched_change_priority(t, priority);
+}
+
 /**
  * @brief Change priority of current thread
  *
@@ -1016,14 +1102,27 @@ void thread_set_priority(thread_t* t, int priority) {
 
     Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
 
-    if (priority <= IDLE_PRIORITY) {
-        priority = IDLE_PRIORITY + 1;
-    }
-    if (priority > HIGHEST_PRIORITY) {
-        priority = HIGHEST_PRIORITY;
-    }
+    thread_set_priority_locked(t, priority);
+}
 
-    sched_change_priority(t, priority);
+void thread_clear_deadline_and_set_priority(thread_t* t, int priority) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(!thread_is_idle(t));
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    sched_set_deadline(t, 0, 0, 0);
+    thread_set_priority_locked(t, priority);
+}
+
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity,
+                                zx_duration_t relative_deadline, zx_duration_t period) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(!thread_is_idle(t));
+
+    Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
+
+    return sched_set_deadline(t, capacity, relative_deadline, period);
 }
 
 /**
@@ -1193,6 +1292,12 @@ void dump_thread(thread_t* t, bool full_dump) {
                 t->priority_boost, t->inherited_priority, t->remaining_time_slice);
         dprintf(INFO, "\truntime_ns %" PRIi64 ", runtime_s %" PRIi64 "\n",
                 runtime, runtime / 1000000000);
+        if (thread_is_deadline(t)) {
+            dprintf(INFO, "\tdeadline capacity %" PRIi64 " deadline %" PRIi64 " period %" PRIi64
+                          ", remaining budget %" PRIi64 ", overruns %" PRIu64 "\n",
+                    t->deadline.capacity, t->deadline.relative_deadline, t->deadline.period,
+                    t->deadline.remaining_budget, t->deadline.overruns);
+        }
         dprintf(INFO, "\tstack.base 0x%lx, stack.vmar %p, stack.size %zu\n",
                 t->stack.base, t->stack.vmar, t->stack.size);
 #if __has_feature(safe_stack)
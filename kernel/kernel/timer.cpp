@@ -235,6 +235,8 @@ void timer_set(timer_t* timer, zx_time_t deadline,
 
     // Set up the structure.
     timer->scheduled_time = deadline;
+    timer->earliest_deadline = earliest_deadline;
+    timer->latest_deadline = latest_deadline;
     timer->callback = callback;
     timer->arg = arg;
     timer->cancel = false;
@@ -275,6 +277,42 @@ void timer_preempt_cancel() {
     // timer as is and expect the recipient to handle spurious wakeups.
 }
 
+void timer_preempt_cancel_precise() {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    uint cpu = arch_curr_cpu_num();
+
+    zx_time_t preempt_deadline = percpu[cpu].preempt_timer_deadline;
+    percpu[cpu].preempt_timer_deadline = ZX_TIME_INFINITE;
+
+    // next_timer_deadline is only written by its own cpu with interrupts disabled, so it can
+    // be read without the timer lock. unless the platform timer is armed for the preemption
+    // timer being canceled there is nothing to pull back.
+    if (preempt_deadline == ZX_TIME_INFINITE ||
+        preempt_deadline != percpu[cpu].next_timer_deadline) {
+        return;
+    }
+
+    Guard<spin_lock_t, NoIrqSave> guard{TimerLock::Get()};
+
+    timer_t* head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+    zx_time_t deadline = head ? head->scheduled_time : ZX_TIME_INFINITE;
+    if (deadline == percpu[cpu].next_timer_deadline) {
+        return;
+    }
+
+    // the platform timer is only ever moved earlier by update_platform_timer(), so a later
+    // deadline means it was programmed for the preemption timer we are canceling
+    LTRACEF("reprogramming hw timer from %" PRIi64 " to %" PRIi64 "\n",
+            percpu[cpu].next_timer_deadline, deadline);
+    if (deadline == ZX_TIME_INFINITE) {
+        platform_stop_timer();
+    } else {
+        platform_set_oneshot_timer(deadline);
+    }
+    percpu[cpu].next_timer_deadline = deadline;
+}
+
 bool timer_cancel(timer_t* timer) {
     DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
 
@@ -373,7 +411,10 @@ void timer_tick(zx_time_t now) {
         }
         LTRACEF("next item on timer queue %p at %" PRIi64 " now %" PRIi64 " (%p, arg %p)\n",
                 timer, timer->scheduled_time, now, timer->callback, timer->arg);
-        if (likely(now < timer->scheduled_time)) {
+        // The head is the timer due soonest, but whatever woke us up (the
+        // preemption timer, or a timer without slack ahead of this one) may
+        // already be inside its window. Firing it now saves an interrupt.
+        if (likely(now < timer->earliest_deadline)) {
             break;
         }
 
@@ -453,10 +494,10 @@ void timer_transition_off_cpu(uint old_cpu) {
     // Move all timers from old_cpu to this cpu
     list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
         list_delete(&entry->node);
-        // We lost the original asymmetric slack information so when we combine them
-        // with the other timer queue they are not coalesced again.
-        // TODO(cpu): figure how important this case is.
-        insert_timer_in_queue(cpu, entry, entry->scheduled_time, entry->scheduled_time);
+        // Undo the adjustment made for the old queue so the timer can be
+        // coalesced again within its original window.
+        entry->scheduled_time = zx_time_sub_duration(entry->scheduled_time, entry->slack);
+        insert_timer_in_queue(cpu, entry, entry->earliest_deadline, entry->latest_deadline);
     }
 
     timer_t* new_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
@@ -166,6 +166,25 @@ static void wait_queue_remove_thread(thread_t* t) {
     }
 }
 
+// remove the thread of the highest priority that blocked last
+static thread_t* wait_queue_pop_newest(wait_queue_t* wait) {
+    thread_t* head = list_peek_head_type(&wait->heads, thread_t, wait_queue_heads_node);
+    if (!head) {
+        return NULL;
+    }
+
+    // the rest of the threads at this priority follow the head in the order
+    // they blocked
+    thread_t* t = list_peek_tail_type(&head->queue_node, thread_t, queue_node);
+    if (!t) {
+        t = head;
+    }
+
+    wait_queue_remove_thread(t);
+
+    return t;
+}
+
 // return the numeric priority of the highest priority thread queued
 int wait_queue_blocked_priority(wait_queue_t* wait) {
     thread_t* t = list_peek_head_type(&wait->heads, thread_t, wait_queue_heads_node);
@@ -295,6 +314,32 @@ zx_status_t wait_queue_block_with_mask(wait_queue_t* wait, zx_time_t deadline,
     return wait_queue_block_worker(wait, deadline, signal_mask);
 }
 
+// make a thread just taken off the queue runnable
+static int wait_queue_wake_popped(wait_queue_t* wait, thread_t* t, bool reschedule,
+                                  zx_status_t wait_queue_error) {
+    int ret = 0;
+
+    if (t) {
+        wait->count--;
+        DEBUG_ASSERT(t->state == THREAD_BLOCKED);
+        t->blocked_status = wait_queue_error;
+        t->blocking_wait_queue = NULL;
+
+        ktrace_ptr(TAG_KWAIT_WAKE, wait, 0, 0);
+
+        // wake up the new thread, putting it in a run queue on a cpu. reschedule if the local
+        // cpu run queue was modified
+        bool local_resched = sched_unblock(t);
+        if (reschedule && local_resched) {
+            sched_reschedule();
+        }
+
+        ret = 1;
+    }
+
+    return ret;
+}
+
 /**
  * @brief  Wake up one thread sleeping on a wait queue
  *
@@ -310,9 +355,6 @@ zx_status_t wait_queue_block_with_mask(wait_queue_t* wait, zx_time_t deadline,
  * @return  The number of threads woken (zero or one)
  */
 int wait_queue_wake_one(wait_queue_t* wait, bool reschedule, zx_status_t wait_queue_error) {
-    thread_t* t;
-    int ret = 0;
-
     DEBUG_ASSERT(wait->magic == WAIT_QUEUE_MAGIC);
     DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
@@ -321,26 +363,31 @@ int wait_queue_wake_one(wait_queue_t* wait, bool reschedule, zx_status_t wait_qu
         wait_queue_validate_queue(wait);
     }
 
-    t = wait_queue_pop_head(wait);
-    if (t) {
-        wait->count--;
-        DEBUG_ASSERT(t->state == THREAD_BLOCKED);
-        t->blocked_status = wait_queue_error;
-        t->blocking_wait_queue = NULL;
-
-        ktrace_ptr(TAG_KWAIT_WAKE, wait, 0, 0);
+    return wait_queue_wake_popped(wait, wait_queue_pop_head(wait), reschedule, wait_queue_error);
+}
 
-        // wake up the new thread, putting it in a run queue on a cpu. reschedule if the local
-        // cpu run queue was modified
-        bool local_resched = sched_unblock(t);
-        if (reschedule && local_resched) {
-            sched_reschedule();
-        }
+/**
+ * @brief  Wake the thread that blocked most recently
+ *
+ * Like wait_queue_wake_one(), except that among the threads of the highest
+ * priority the one that blocked last is woken, rather than the one that
+ * blocked first.  A pool of interchangeable threads woken this way keeps
+ * reusing the threads whose caches are warmest, and the ones that have been
+ * idle longest stay asleep.
+ *
+ * @return  The number of threads woken (zero or one)
+ */
+int wait_queue_wake_newest(wait_queue_t* wait, bool reschedule, zx_status_t wait_queue_error) {
+    DEBUG_ASSERT(wait->magic == WAIT_QUEUE_MAGIC);
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
-        ret = 1;
+    if (WAIT_QUEUE_VALIDATION) {
+        wait_queue_validate_queue(wait);
     }
 
-    return ret;
+    return wait_queue_wake_popped(wait, wait_queue_pop_newest(wait), reschedule,
+                                  wait_queue_error);
 }
 
 thread_t* wait_queue_dequeue_one(wait_queue_t* wait, zx_status_t wait_queue_error) {
@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <lib/counters.h>
+#include <lib/counters-vmo.h>
 
 #include <string.h>
 
@@ -23,9 +24,18 @@
 #include <lk/init.h>
 
 #include <lib/console.h>
+#include <lib/zircon-internal/kcounter-vmo.h>
 
-// The arena is allocated in kernel.ld linker script.
+#include <vm/arch_vm_aspace.h>
+#include <vm/pmm.h>
+#include <vm/vm.h>
+#include <vm/vm_object_paged.h>
+#include <vm/vm_object_physical.h>
+
+// The arena is allocated in kernel.ld linker script, and is padded out to
+// whole pages so that it can be published to userspace.
 extern int64_t kcounters_arena[];
+extern int64_t kcounters_arena_end[];
 
 struct watched_counter_t {
     list_node node;
@@ -77,6 +87,54 @@ static void counters_init(unsigned level) {
     }
 }
 
+zx_status_t counters_create_vmos(fbl::RefPtr<VmObject>* desc_vmo,
+                                 fbl::RefPtr<VmObject>* arena_vmo) {
+    const size_t num_counters = get_num_counters();
+    const size_t desc_size = sizeof(kcounter_vmo_header_t) +
+                             num_counters * sizeof(kcounter_vmo_desc_t);
+
+    fbl::RefPtr<VmObject> desc;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u,
+                                               ROUNDUP_PAGE_SIZE(desc_size), &desc);
+    if (status != ZX_OK)
+        return status;
+
+    kcounter_vmo_header_t header = {};
+    header.magic = KCOUNTER_VMO_MAGIC;
+    header.max_cpus = SMP_MAX_CPUS;
+    header.num_counters = static_cast<uint32_t>(num_counters);
+    status = desc->Write(&header, 0, sizeof(header));
+    if (status != ZX_OK)
+        return status;
+
+    for (size_t ix = 0; ix != num_counters; ++ix) {
+        kcounter_vmo_desc_t entry = {};
+        strlcpy(entry.name, kcountdesc_begin[ix].name, sizeof(entry.name));
+        entry.type = KCOUNTER_TYPE_SUM;
+        status = desc->Write(&entry, sizeof(header) + ix * sizeof(entry), sizeof(entry));
+        if (status != ZX_OK)
+            return status;
+    }
+    desc->set_name(KCOUNTER_DESC_VMO_NAME, sizeof(KCOUNTER_DESC_VMO_NAME) - 1);
+
+    // The arena is part of the kernel image, which is physically contiguous.
+    // The kernel maps it cached, so userspace mappings have to match.
+    const size_t arena_size = reinterpret_cast<uintptr_t>(kcounters_arena_end) -
+                              reinterpret_cast<uintptr_t>(kcounters_arena);
+    fbl::RefPtr<VmObject> arena;
+    status = VmObjectPhysical::Create(vaddr_to_paddr(kcounters_arena), arena_size, &arena);
+    if (status != ZX_OK)
+        return status;
+    status = arena->SetMappingCachePolicy(ARCH_MMU_FLAG_CACHED);
+    if (status != ZX_OK)
+        return status;
+    arena->set_name(KCOUNTER_ARENA_VMO_NAME, sizeof(KCOUNTER_ARENA_VMO_NAME) - 1);
+
+    *desc_vmo = fbl::move(desc);
+    *arena_vmo = fbl::move(arena);
+    return ZX_OK;
+}
+
 static void dump_counter(const k_counter_desc* desc) {
     size_t counter_index = kcounter_index(desc);
 
@@ -0,0 +1,18 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/ref_ptr.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+// Create the VMOs that publish the kernel counters to userspace, as
+// described in <lib/zircon-internal/kcounter-vmo.h>.  |desc_vmo| receives
+// a snapshot of the descriptor table and |arena_vmo| maps the live arena
+// that the counters are updated in.  This is called only once, at boot time.
+zx_status_t counters_create_vmos(fbl::RefPtr<VmObject>* desc_vmo,
+                                 fbl::RefPtr<VmObject>* arena_vmo);
@@ -6,11 +6,14 @@
 
 #include <lib/crypto/global_prng.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <ctype.h>
 #include <err.h>
 #include <explicit-memory/bytes.h>
 #include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <kernel/align.h>
 #include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
 #include <kernel/mutex.h>
@@ -33,11 +36,63 @@ namespace GlobalPRNG {
 
 static PRNG* kGlobalPrng = nullptr;
 
+// Number of bytes a per-cpu PRNG may produce before it is reseeded.
+static constexpr uint64_t kCpuReseedBytes = 1u << 20;
+
+// A PRNG serving DrawPerCpu on one cpu.  Its storage is statically allocated
+// for the same reason as the global PRNG's.
+struct CpuPrng {
+    alignas(alignof(PRNG)) uint8_t space[sizeof(PRNG)];
+    PRNG* prng;
+    // Value of |reseed_generation| when this PRNG was last reseeded.
+    fbl::atomic<uint64_t> seed_generation;
+    // Bytes drawn since this PRNG was last reseeded.
+    fbl::atomic<uint64_t> drawn;
+} __CPU_ALIGN;
+
+static CpuPrng cpu_prngs[SMP_MAX_CPUS];
+static bool cpu_prngs_ready = false;
+
+// Incremented whenever entropy is added to the global PRNG after boot.
+static fbl::atomic<uint64_t> reseed_generation(0);
+
 PRNG* GetInstance() {
     ASSERT(kGlobalPrng);
     return kGlobalPrng;
 }
 
+void AddEntropy(const void* data, size_t size) {
+    GetInstance()->AddEntropy(data, size);
+    reseed_generation.fetch_add(1);
+}
+
+// Mixes a fresh draw from the global PRNG into |cpu_prng|.
+static void Reseed(PRNG* cpu_prng) {
+    uint8_t seed[PRNG::kMinEntropy];
+    kGlobalPrng->Draw(seed, sizeof(seed));
+    cpu_prng->AddEntropy(seed, sizeof(seed));
+    mandatory_memset(seed, 0, sizeof(seed));
+}
+
+void DrawPerCpu(void* out, size_t size) {
+    if (!cpu_prngs_ready) {
+        GetInstance()->Draw(out, size);
+        return;
+    }
+
+    // The per-cpu PRNGs are thread-safe, so migrating to another cpu after
+    // picking one only costs some contention.
+    CpuPrng& cpu = cpu_prngs[arch_curr_cpu_num()];
+    uint64_t generation = reseed_generation.load();
+    if (cpu.seed_generation.load() != generation || cpu.drawn.load() >= kCpuReseedBytes) {
+        Reseed(cpu.prng);
+        cpu.drawn.store(0);
+        cpu.seed_generation.store(generation);
+    }
+    cpu.prng->Draw(out, size);
+    cpu.drawn.fetch_add(size);
+}
+
 // Returns true if the kernel cmdline provided at least PRNG::kMinEntropy bytes
 // of entropy, and false otherwise.
 //
@@ -162,9 +217,20 @@ static void EarlyBootSeed(uint level) {
     }
 }
 
-// Migrate the global PRNG to enter thread-safe mode.
+// Migrate the global PRNG to enter thread-safe mode, and seed the per-cpu
+// PRNGs from it.
 static void BecomeThreadSafe(uint level) {
     GetInstance()->BecomeThreadSafe();
+
+    for (CpuPrng& cpu : cpu_prngs) {
+        uint8_t seed[PRNG::kMinEntropy];
+        kGlobalPrng->Draw(seed, sizeof(seed));
+        cpu.prng = new (&cpu.space) PRNG(seed, sizeof(seed));
+        mandatory_memset(seed, 0, sizeof(seed));
+        cpu.seed_generation.store(reseed_generation.load());
+        cpu.drawn.store(0);
+    }
+    cpu_prngs_ready = true;
 }
 
 } //namespace GlobalPRNG
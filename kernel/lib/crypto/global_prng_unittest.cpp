@@ -8,6 +8,7 @@
 
 #include <lib/unittest/unittest.h>
 #include <stdint.h>
+#include <string.h>
 
 namespace crypto {
 
@@ -24,10 +25,29 @@ bool identical() {
     END_TEST;
 }
 
+bool per_cpu_draws() {
+    BEGIN_TEST;
+
+    uint8_t first[32] = {};
+    uint8_t second[32] = {};
+    GlobalPRNG::DrawPerCpu(first, sizeof(first));
+    GlobalPRNG::DrawPerCpu(second, sizeof(second));
+    EXPECT_NE(0, memcmp(first, second, sizeof(first)), "draws repeated");
+
+    // Adding entropy reseeds the per-cpu PRNG on its next draw.
+    uint8_t entropy[PRNG::kMinEntropy] = {};
+    GlobalPRNG::AddEntropy(entropy, sizeof(entropy));
+    GlobalPRNG::DrawPerCpu(first, sizeof(first));
+    EXPECT_NE(0, memcmp(first, second, sizeof(first)), "draws repeated after reseed");
+
+    END_TEST;
+}
+
 } // namespace
 
 UNITTEST_START_TESTCASE(global_prng_tests)
 UNITTEST("Identical", identical)
+UNITTEST("PerCpuDraws", per_cpu_draws)
 UNITTEST_END_TESTCASE(global_prng_tests, "global_prng",
                       "Validate global PRNG singleton");
 
@@ -16,6 +16,17 @@ namespace GlobalPRNG {
 // guaranteed to be non-null.
 PRNG* GetInstance();
 
+// Mixes |size| bytes of entropy at |data| into the global PRNG, and marks
+// the per-cpu PRNGs to reseed from it before their next draw.
+void AddEntropy(const void* data, size_t size);
+
+// Fills |out| with |size| bytes drawn from the current cpu's PRNG, which is
+// periodically reseeded from the global PRNG.  Concurrent draws on different
+// cpus do not contend, which makes this the better choice for frequent draws
+// such as zx_cprng_draw.  Must be called from thread context.  |size| MUST NOT
+// be greater than PRNG::kMaxDrawLen.
+void DrawPerCpu(void* out, size_t size);
+
 } //namespace GlobalPRNG
 
 } // namespace crypto
@@ -29,6 +29,12 @@ static_assert((DLOG_SIZE & DLOG_MASK) == 0u, "must be power of two");
 static_assert(DLOG_MAX_RECORD <= DLOG_SIZE, "wat");
 static_assert((DLOG_MAX_RECORD & 3) == 0, "E_DONT_DO_THAT");
 
+// Readers are notified at most once per DLOG_NOTIFY_DELAY, unless at least
+// DLOG_NOTIFY_BATCH bytes of records are already waiting for them, so that a
+// burst of writes wakes each reader once rather than once per record.
+#define DLOG_NOTIFY_DELAY ZX_USEC(500)
+#define DLOG_NOTIFY_BATCH (DLOG_SIZE / 8u)
+
 static uint8_t DLOG_DATA[DLOG_SIZE];
 
 static dlog_t DLOG = {
@@ -50,6 +56,10 @@ static thread_t* dumper_thread;
 static fbl::atomic_bool notifier_shutdown_requested;
 static fbl::atomic_bool dumper_shutdown_requested;
 
+// Set by the first write after the notifier last ran, so that later writes
+// needn't signal the notifier event (and take the thread lock) again.
+static fbl::atomic_bool notify_pending;
+
 // dlog_bypass_ will directly write to console. It also has the side effect of
 // disabling uart Tx interrupts. So all serial console writes are polling.
 static bool dlog_bypass_ = false;
@@ -183,6 +193,10 @@ zx_status_t dlog_write(uint32_t flags, const void* data_ptr, size_t len) {
 
     spin_unlock_irqrestore(&log->lock, state);
 
+    if (notify_pending.exchange(true)) {
+        return ZX_OK;
+    }
+
     [log, holding_thread_lock]() TA_NO_THREAD_SAFETY_ANALYSIS {
         // if we happen to be called from within the global thread lock, use a
         // special version of event signal
@@ -193,11 +207,9 @@ zx_status_t dlog_write(uint32_t flags, const void* data_ptr, size_t len) {
         }
     }();
 
-
     return ZX_OK;
 }
 
-// TODO: support reading multiple messages at a time
 // TODO: filter with flags
 zx_status_t dlog_read(dlog_reader_t* rdr, uint32_t flags, void* data_ptr,
                       size_t len, size_t* _actual) {
@@ -290,6 +302,7 @@ void dlog_reader_destroy(dlog_reader_t* rdr) {
 // have one so they can process new log messages.
 static int debuglog_notifier(void* arg) {
     dlog_t* log = &DLOG;
+    size_t notified_head = 0;
 
     for (;;) {
         if (notifier_shutdown_requested.load()) {
@@ -297,6 +310,22 @@ static int debuglog_notifier(void* arg) {
         }
         event_wait(&log->event);
 
+        // Let a burst of writes accumulate before waking the readers.
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&log->lock, state);
+        size_t waiting = log->head - notified_head;
+        spin_unlock_irqrestore(&log->lock, state);
+        if (waiting < DLOG_NOTIFY_BATCH && !notifier_shutdown_requested.load()) {
+            thread_sleep_relative(DLOG_NOTIFY_DELAY);
+        }
+
+        // Writes from here on signal the event again, so none are missed
+        // by the readers notified below.
+        notify_pending.store(false);
+        spin_lock_irqsave(&log->lock, state);
+        notified_head = log->head;
+        spin_unlock_irqrestore(&log->lock, state);
+
         // notify readers that new log items were posted
         mutex_acquire(&log->readers_lock);
         dlog_reader_t* rdr;
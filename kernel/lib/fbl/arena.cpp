@@ -192,7 +192,8 @@ void* Arena::Pool::Pop() {
         }
     }
     char* slot = top_;
-    top_ += slot_size_;
+    // Pairs with InRangeUnlocked: the slot is committed before it is in range.
+    __atomic_store_n(&top_, top_ + slot_size_, __ATOMIC_RELEASE);
     return slot;
 }
 
@@ -41,6 +41,13 @@ public:
         return in_range(reinterpret_cast<uintptr_t>(addr));
     }
 
+    // Like in_range(), but may be called without whatever serializes Alloc()
+    // and Free(). Object slots are never decommitted once handed out, so an
+    // address that passes stays readable, though its contents may be stale.
+    bool in_range_unlocked(uintptr_t addr) const {
+        return data_.InRangeUnlocked(addr);
+    }
+
     void* start() const { return data_.start(); }
     void* end() const { return data_.end(); }
 
@@ -94,6 +101,14 @@ private:
             return InRange(reinterpret_cast<uintptr_t>(addr));
         }
 
+        // InRange() for callers racing with Pop. Only valid for a pool that
+        // is never Pushed to, whose |top| only grows.
+        bool InRangeUnlocked(uintptr_t addr) const {
+            char* top = __atomic_load_n(&top_, __ATOMIC_ACQUIRE);
+            return (addr >= reinterpret_cast<uintptr_t>(start_) &&
+                    addr < reinterpret_cast<uintptr_t>(top));
+        }
+
         // The lowest address of the memory managed by this Pool.
         // Pop will only return values > |start| (besides nullptr).
         char* start() const { return start_; }
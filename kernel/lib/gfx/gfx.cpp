@@ -168,38 +168,37 @@ static void putpixel(gfx_surface* surface, uint x, uint y, uint color) {
     }
 }
 
+// Wide stores used to fill rows; aliases the pixel types it overwrites.
+typedef uint64_t __attribute__((__may_alias__)) gfx_word_t;
+
 template <typename T>
 static void copyrect(gfx_surface* surface, uint x, uint y, uint width, uint height, uint x2, uint y2) {
-    // copy
-    const T* src = static_cast<const T*>(surface->ptr) + (x + y * surface->stride);
-    T* dest = static_cast<T*>(surface->ptr) + (x2 + y2 * surface->stride);
-    uint stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        uint i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+    const size_t pitch = surface->stride * sizeof(T);
+    const size_t rowlen = width * sizeof(T);
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(
+        static_cast<const T*>(surface->ptr) + (x + y * surface->stride));
+    uint8_t* dest = reinterpret_cast<uint8_t*>(
+        static_cast<T*>(surface->ptr) + (x2 + y2 * surface->stride));
+
+    if (rowlen == pitch) {
+        // full width rows are contiguous, so the rect is one block
+        memmove(dest, src, rowlen * height);
+    } else if (dest < src) {
+        // memmove copes with overlap within a row, the row order copes
+        // with overlap between rows
+        for (uint i = 0; i < height; i++) {
+            memmove(dest, src, rowlen);
+            dest += pitch;
+            src += pitch;
         }
     } else {
         // copy backwards
-        src += height * surface->stride + width;
-        dest += height * surface->stride + width;
-
-        uint i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+        src += (height - 1) * pitch;
+        dest += (height - 1) * pitch;
+        for (uint i = 0; i < height; i++) {
+            memmove(dest, src, rowlen);
+            dest -= pitch;
+            src -= pitch;
         }
     }
 }
@@ -207,7 +206,6 @@ static void copyrect(gfx_surface* surface, uint x, uint y, uint width, uint heig
 template <typename T>
 static void fillrect(gfx_surface* surface, uint x, uint y, uint width, uint height, uint _color) {
     T* dest = static_cast<T*>(surface->ptr) + (x + y * surface->stride);
-    uint stride_diff = surface->stride - width;
 
     T color;
     if (sizeof(_color) == sizeof(color)) {
@@ -216,13 +214,31 @@ static void fillrect(gfx_surface* surface, uint x, uint y, uint width, uint heig
         color = static_cast<T>(surface->translate_color(_color));
     }
 
-    uint i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color;
-            dest++;
+    // Each row is filled a pixel at a time up to 8 byte alignment, then with
+    // 64 bit stores of the color replicated across the word.
+    constexpr uint kPerWord = sizeof(gfx_word_t) / sizeof(T);
+    gfx_word_t pattern = color;
+    for (uint shift = sizeof(T) * 8; shift < 64; shift *= 2) {
+        pattern |= pattern << shift;
+    }
+
+    for (uint i = 0; i < height; i++) {
+        T* p = dest;
+        uint n = width;
+        while (n > 0 && (reinterpret_cast<uintptr_t>(p) & (sizeof(gfx_word_t) - 1))) {
+            *p++ = color;
+            n--;
+        }
+        gfx_word_t* w = reinterpret_cast<gfx_word_t*>(p);
+        for (; n >= kPerWord; n -= kPerWord) {
+            *w++ = pattern;
+        }
+        p = reinterpret_cast<T*>(w);
+        while (n > 0) {
+            *p++ = color;
+            n--;
         }
-        dest += stride_diff;
+        dest += surface->stride;
     }
 }
 
@@ -313,6 +329,28 @@ static uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src) {
     return (srca << 24) | (cres[0] << 16) | (cres[1] << 8) | (cres[2]);
 }
 
+// Copies the top left |width| x |height| of |source| to |target| a row at a
+// time, or in one go when both surfaces' rows are contiguous.
+static void copyrows(gfx_surface* target, gfx_surface* source, uint width, uint height, uint destx, uint desty) {
+    const size_t src_pitch = source->stride * source->pixelsize;
+    const size_t dest_pitch = target->stride * target->pixelsize;
+    const size_t rowlen = width * source->pixelsize;
+    const uint8_t* src = static_cast<const uint8_t*>(source->ptr);
+    uint8_t* dest = static_cast<uint8_t*>(target->ptr) + desty * dest_pitch + destx * target->pixelsize;
+
+    LTRACEF("w %u h %u dpitch %zu spitch %zu\n", width, height, dest_pitch, src_pitch);
+
+    if (rowlen == src_pitch && rowlen == dest_pitch) {
+        memcpy(dest, src, rowlen * height);
+        return;
+    }
+    for (uint i = 0; i < height; i++) {
+        memcpy(dest, src, rowlen);
+        dest += dest_pitch;
+        src += src_pitch;
+    }
+}
+
 /**
  * @brief  Copy pixels from source to dest.
  *
@@ -339,23 +377,7 @@ void gfx_surface_blend(struct gfx_surface* target, struct gfx_surface* source, u
     // XXX total hack to deal with various blends
     if (source->format == ZX_PIXEL_FORMAT_RGB_565 && target->format == ZX_PIXEL_FORMAT_RGB_565) {
         // 16 bit to 16 bit
-        const uint16_t* src = static_cast<const uint16_t*>(source->ptr);
-        uint16_t* dest = static_cast<uint16_t*>(target->ptr) + (destx + desty * target->stride);
-        uint dest_stride_diff = target->stride - width;
-        uint source_stride_diff = source->stride - width;
-
-        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        uint i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
+        copyrows(target, source, width, height, destx, desty);
     } else if (source->format == ZX_PIXEL_FORMAT_ARGB_8888 && target->format == ZX_PIXEL_FORMAT_ARGB_8888) {
         // both are 32 bit modes, both alpha
         const uint32_t* src = static_cast<const uint32_t*>(source->ptr);
@@ -378,42 +400,10 @@ void gfx_surface_blend(struct gfx_surface* target, struct gfx_surface* source, u
         }
     } else if (source->format == ZX_PIXEL_FORMAT_RGB_x888 && target->format == ZX_PIXEL_FORMAT_RGB_x888) {
         // both are 32 bit modes, no alpha
-        const uint32_t* src = static_cast<const uint32_t*>(source->ptr);
-        uint32_t* dest = static_cast<uint32_t*>(target->ptr) + (destx + desty * target->stride);
-        uint dest_stride_diff = target->stride - width;
-        uint source_stride_diff = source->stride - width;
-
-        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        uint i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
+        copyrows(target, source, width, height, destx, desty);
     } else if (source->format == ZX_PIXEL_FORMAT_MONO_8 && target->format == ZX_PIXEL_FORMAT_MONO_8) {
         // both are 8 bit modes, no alpha
-        const uint8_t* src = static_cast<const uint8_t*>(source->ptr);
-        uint8_t* dest = static_cast<uint8_t*>(target->ptr) + (destx + desty * target->stride);
-        uint dest_stride_diff = target->stride - width;
-        uint source_stride_diff = source->stride - width;
-
-        LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        uint i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
+        copyrows(target, source, width, height, destx, desty);
     } else {
         panic("gfx_surface_blend: unimplemented colorspace combination (source %u target %u)\n", source->format, target->format);
     }
@@ -44,9 +44,12 @@ static struct {
     // underlying hw surface, if different from above
     gfx_surface* hw_surface;
 
-    // surface to do single line sub-region flushing with
+    // surface to do sub-region flushing with
     gfx_surface line;
-    uint linestride;
+
+    // pixel rows [dirty_top, dirty_bottom) have been drawn to since the
+    // last flush; empty when dirty_top >= dirty_bottom
+    uint dirty_top, dirty_bottom;
 
     uint rows, columns;
     uint extray; // extra pixels left over if the rows doesn't fit precisely
@@ -57,7 +60,18 @@ static struct {
     uint32_t back_color;
 } gfxconsole;
 
+static void mark_dirty(uint top, uint bottom) {
+    if (gfxconsole.dirty_top >= gfxconsole.dirty_bottom) {
+        gfxconsole.dirty_top = top;
+        gfxconsole.dirty_bottom = bottom;
+    } else {
+        gfxconsole.dirty_top = MIN(gfxconsole.dirty_top, top);
+        gfxconsole.dirty_bottom = MAX(gfxconsole.dirty_bottom, bottom);
+    }
+}
+
 static void draw_char(char c, const struct gfx_font* font) {
+    mark_dirty(gfxconsole.y * font->height, (gfxconsole.y + 1) * font->height);
     gfx_putchar(gfxconsole.surface, font, c,
                 gfxconsole.x * font->width, gfxconsole.y * font->height,
                 gfxconsole.front_color, gfxconsole.back_color);
@@ -69,11 +83,10 @@ void gfxconsole_putpixel(unsigned x, unsigned y, unsigned color) {
 
 static const struct gfx_font* font = &font_9x16;
 
-static bool gfxconsole_putc(char c) {
+static void gfxconsole_putc(char c) {
     static enum { NORMAL,
                   ESCAPE } state = NORMAL;
     static uint32_t p_num = 0;
-    bool inval = 0;
 
     if (state == NORMAL) {
         switch (c) {
@@ -82,7 +95,6 @@ static bool gfxconsole_putc(char c) {
             break;
         case '\n':
             gfxconsole.y++;
-            inval = 1;
             break;
         case '\b':
             // back up one character unless we're at the left side
@@ -121,7 +133,6 @@ static bool gfxconsole_putc(char c) {
     if (gfxconsole.x >= gfxconsole.columns) {
         gfxconsole.x = 0;
         gfxconsole.y++;
-        inval = 1;
     }
     if (gfxconsole.y >= gfxconsole.rows) {
         // scroll up
@@ -132,36 +143,35 @@ static bool gfxconsole_putc(char c) {
         // clear the bottom line
         gfx_fillrect(gfxconsole.surface, 0, gfxconsole.surface->height - font->height - gfxconsole.extray,
                      gfxconsole.surface->width, font->height, gfxconsole.back_color);
-        gfx_flush(gfxconsole.surface);
-        inval = 1;
+        mark_dirty(0, gfxconsole.surface->height - gfxconsole.extray);
     }
-    return inval;
 }
 
 static void gfxconsole_print_callback(print_callback_t* cb, const char* str, size_t len) {
-    int refresh_full_screen = 0;
     for (size_t i = 0; i < len; i++) {
         if (str[i] == '\n')
             gfxconsole_putc('\r');
-        refresh_full_screen |= gfxconsole_putc(str[i]);
+        gfxconsole_putc(str[i]);
     }
 
-    // blit from the software surface to the hardware
+    if (gfxconsole.dirty_top >= gfxconsole.dirty_bottom)
+        return;
+
+    uint top = gfxconsole.dirty_top;
+    uint bottom = gfxconsole.dirty_bottom;
+    gfxconsole.dirty_top = gfxconsole.dirty_bottom = 0;
+
+    // blit only the changed rows from the software surface to the hardware
     if (gfxconsole.surface != gfxconsole.hw_surface) {
-        if (refresh_full_screen) {
-            gfx_surface_blend(gfxconsole.hw_surface, gfxconsole.surface, 0, 0);
-        } else {
-            // Only re-blit the active console line.
-            // Since blend only works in whole surfaces, configure a sub-surface
-            // to use as the blend source.
-            gfxconsole.line.ptr = ((uint8_t*)gfxconsole.surface->ptr) +
-                                  (gfxconsole.y * gfxconsole.linestride);
-            gfx_surface_blend(gfxconsole.hw_surface, &gfxconsole.line,
-                              0, gfxconsole.y * font->height);
-        }
-        gfx_flush(gfxconsole.hw_surface);
+        // Since blend only works in whole surfaces, configure a sub-surface
+        // to use as the blend source.
+        gfxconsole.line.ptr = ((uint8_t*)gfxconsole.surface->ptr) +
+                              (top * gfxconsole.surface->stride * gfxconsole.surface->pixelsize);
+        gfxconsole.line.height = bottom - top;
+        gfx_surface_blend(gfxconsole.hw_surface, &gfxconsole.line, 0, top);
+        gfx_flush_rows(gfxconsole.hw_surface, top, bottom - 1);
     } else {
-        gfx_flush(gfxconsole.surface);
+        gfx_flush_rows(gfxconsole.surface, top, bottom - 1);
     }
 }
 
@@ -183,10 +193,10 @@ static void gfxconsole_setup(gfx_surface* surface, gfx_surface* hw_surface) {
     gfxconsole.surface = surface;
     gfxconsole.hw_surface = hw_surface;
 
-    // set up line-height sub-surface, for line-only invalidation
+    // set up the sub-surface for partial invalidation
     memcpy(&gfxconsole.line, surface, sizeof(*surface));
-    gfxconsole.line.height = font->height;
-    gfxconsole.linestride = surface->stride * surface->pixelsize * font->height;
+    gfxconsole.dirty_top = 0;
+    gfxconsole.dirty_bottom = surface->height;
 
     // calculate how many rows/columns we have
     gfxconsole.rows = surface->height / font->height;
@@ -214,6 +224,7 @@ static void gfxconsole_clear(bool crash_console) {
     gfx_fillrect(gfxconsole.surface, 0, 0, gfxconsole.surface->width, gfxconsole.surface->height,
                  gfxconsole.back_color);
     gfx_flush(gfxconsole.surface);
+    mark_dirty(0, gfxconsole.surface->height);
 }
 
 /**
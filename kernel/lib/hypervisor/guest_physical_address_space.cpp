@@ -9,6 +9,7 @@
 #include <fbl/alloc_checker.h>
 #include <kernel/range_check.h>
 #include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/vm_object_physical.h>
 
 static constexpr uint kPfFlags = VMM_PF_FLAG_WRITE | VMM_PF_FLAG_SW_FAULT;
@@ -131,8 +132,23 @@ zx_status_t GuestPhysicalAddressSpace::PageFault(zx_gpaddr_t guest_paddr) {
     if (mapping->arch_mmu_flags() & ARCH_MMU_FLAG_PERM_EXECUTE) {
         pf_flags |= VMM_PF_FLAG_INSTRUCTION;
     }
-    Guard<fbl::Mutex> guard{guest_aspace_->lock()};
-    return mapping->PageFault(guest_paddr, pf_flags);
+
+    // a page that has to come from a page source is waited for without the
+    // aspace lock, then the fault is retried
+    for (;;) {
+        zx_status_t status;
+        {
+            Guard<fbl::Mutex> guard{guest_aspace_->lock()};
+            status = mapping->PageFault(guest_paddr, pf_flags);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
+        status = PageSource::WaitForRequest();
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
 }
 
 zx_status_t GuestPhysicalAddressSpace::CreateGuestPtr(zx_gpaddr_t guest_paddr, size_t len,
@@ -415,6 +415,39 @@ static bool guest_physical_address_space_page_fault() {
     END_TEST;
 }
 
+static bool guest_physical_address_space_page_fault_around() {
+    BEGIN_TEST;
+
+    if (!hypervisor_supported()) {
+        return true;
+    }
+
+    // Setup.
+    fbl::unique_ptr<hypervisor::GuestPhysicalAddressSpace> gpas;
+    zx_status_t status = create_gpas(&gpas);
+    EXPECT_EQ(ZX_OK, status, "Failed to create GuestPhysicalAddressSpace\n");
+    fbl::RefPtr<VmObject> vmo;
+    status = create_vmo(PAGE_SIZE * 16, &vmo);
+    EXPECT_EQ(ZX_OK, status, "Failed to create VMO\n");
+    uint64_t committed = 0;
+    status = vmo->CommitRange(0, PAGE_SIZE * 8, &committed);
+    EXPECT_EQ(ZX_OK, status, "Failed to commit VMO\n");
+    status = create_mapping(gpas->RootVmar(), vmo, 0);
+    EXPECT_EQ(ZX_OK, status, "Failed to create mapping\n");
+
+    // Faulting one page maps its resident neighbours, and leaves the rest.
+    status = gpas->PageFault(PAGE_SIZE * 4);
+    EXPECT_EQ(ZX_OK, status, "Failed to fault page\n");
+    for (zx_gpaddr_t addr = 0; addr < PAGE_SIZE * 16; addr += PAGE_SIZE) {
+        paddr_t pa;
+        status = gpas->arch_aspace()->Query(addr, &pa, nullptr);
+        EXPECT_EQ(addr < PAGE_SIZE * 8 ? ZX_OK : ZX_ERR_NOT_FOUND, status,
+                  "Unexpected mapping state\n");
+    }
+
+    END_TEST;
+}
+
 static bool guest_physical_address_space_map_interrupt_controller() {
     BEGIN_TEST;
 
@@ -529,6 +562,7 @@ HYPERVISOR_UNITTEST(guest_physical_address_space_get_page)
 HYPERVISOR_UNITTEST(guest_physical_address_space_get_page_complex)
 HYPERVISOR_UNITTEST(guest_physical_address_space_get_page_not_present)
 HYPERVISOR_UNITTEST(guest_physical_address_space_page_fault)
+HYPERVISOR_UNITTEST(guest_physical_address_space_page_fault_around)
 HYPERVISOR_UNITTEST(guest_physical_address_space_map_interrupt_controller)
 HYPERVISOR_UNITTEST(guest_physical_address_space_uncached)
 HYPERVISOR_UNITTEST(guest_physical_address_space_uncached_device)
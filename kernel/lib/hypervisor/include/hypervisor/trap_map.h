@@ -10,6 +10,7 @@
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/ref_ptr.h>
 #include <hypervisor/state_invalidator.h>
+#include <object/event_dispatcher.h>
 #include <object/port_dispatcher.h>
 #include <object/semaphore.h>
 
@@ -35,15 +36,19 @@ private:
 class Trap : public fbl::WAVLTreeContainable<fbl::unique_ptr<Trap>> {
 public:
     Trap(uint32_t kind, zx_gpaddr_t addr, size_t len, fbl::RefPtr<PortDispatcher> port,
-         uint64_t key);
+         fbl::RefPtr<EventDispatcher> event, uint64_t key);
     ~Trap();
 
     zx_status_t Init();
     zx_status_t Queue(const zx_port_packet_t& packet, StateInvalidator* invalidator);
+    // Signals the trap's event. Unlike queueing a packet, this never blocks,
+    // and bells that ring while the event is still signaled are coalesced.
+    zx_status_t Signal(StateInvalidator* invalidator);
 
     zx_gpaddr_t GetKey() const { return addr_; }
     bool Contains(zx_gpaddr_t val) const { return val >= addr_ && val < addr_ + len_; }
     bool HasPort() const { return !!port_; }
+    bool HasEvent() const { return !!event_; }
 
     uint32_t kind() const { return kind_; }
     zx_gpaddr_t addr() const { return addr_; }
@@ -55,6 +60,7 @@ private:
     const zx_gpaddr_t addr_;
     const size_t len_;
     const fbl::RefPtr<PortDispatcher> port_;
+    const fbl::RefPtr<EventDispatcher> event_;
     const uint64_t key_; // Key for packets in this port range.
     BlockingPortAllocator port_allocator_;
 };
@@ -63,7 +69,8 @@ private:
 class TrapMap {
 public:
     zx_status_t InsertTrap(uint32_t kind, zx_gpaddr_t addr, size_t len,
-                           fbl::RefPtr<PortDispatcher> port, uint64_t key);
+                           fbl::RefPtr<PortDispatcher> port, fbl::RefPtr<EventDispatcher> event,
+                           uint64_t key);
     zx_status_t FindTrap(uint32_t kind, zx_gpaddr_t addr, Trap** trap);
 
 private:
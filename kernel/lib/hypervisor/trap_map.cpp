@@ -43,8 +43,9 @@ void BlockingPortAllocator::Free(PortPacket* port_packet) {
 }
 
 Trap::Trap(uint32_t kind, zx_gpaddr_t addr, size_t len, fbl::RefPtr<PortDispatcher> port,
-                     uint64_t key)
-    : kind_(kind), addr_(addr), len_(len), port_(fbl::move(port)), key_(key) {
+           fbl::RefPtr<EventDispatcher> event, uint64_t key)
+    : kind_(kind), addr_(addr), len_(len), port_(fbl::move(port)), event_(fbl::move(event)),
+      key_(key) {
     (void) key_;
 }
 
@@ -78,8 +79,20 @@ zx_status_t Trap::Queue(const zx_port_packet_t& packet, StateInvalidator* invali
     return status;
 }
 
+zx_status_t Trap::Signal(StateInvalidator* invalidator) {
+    if (invalidator != nullptr) {
+        invalidator->Invalidate();
+    }
+    if (event_ == nullptr) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    event_->UpdateState(0u, ZX_EVENT_SIGNALED);
+    return ZX_OK;
+}
+
 zx_status_t TrapMap::InsertTrap(uint32_t kind, zx_gpaddr_t addr, size_t len,
-                                fbl::RefPtr<PortDispatcher> port, uint64_t key) {
+                                fbl::RefPtr<PortDispatcher> port,
+                                fbl::RefPtr<EventDispatcher> event, uint64_t key) {
     TrapTree* traps = TreeOf(kind);
     if (traps == nullptr) {
         return ZX_ERR_INVALID_ARGS;
@@ -92,7 +105,8 @@ zx_status_t TrapMap::InsertTrap(uint32_t kind, zx_gpaddr_t addr, size_t len,
         return ZX_ERR_ALREADY_EXISTS;
     }
     fbl::AllocChecker ac;
-    fbl::unique_ptr<Trap> range(new (&ac) Trap(kind, addr, len, fbl::move(port), key));
+    fbl::unique_ptr<Trap> range(new (&ac) Trap(kind, addr, len, fbl::move(port),
+                                               fbl::move(event), key));
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -7,19 +7,27 @@
 #include <debug.h>
 #include <err.h>
 #include <platform.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <hypervisor/ktrace.h>
+#include <kernel/align.h>
+#include <kernel/atomic.h>
 #include <kernel/cmdline.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
 #include <object/thread_dispatcher.h>
 #include <vm/vm_aspace.h>
 #include <zircon/thread_annotations.h>
 
-#define ktrace_timestamp() current_ticks();
+#define ktrace_timestamp() current_ticks()
 #define ktrace_ticks_per_ms() (ticks_per_second() / 1000)
 
 // Generated struct that has the syscall index and name.
@@ -75,87 +83,335 @@ static void ktrace_report_probes(void) {
     }
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// Each cpu writes its records into a buffer of its own, with interrupts off
+// for the length of a record, so a buffer never has more than one writer and
+// tracing doesn't bounce cache lines between cpus. Readers merge the buffers
+// by timestamp.
+//
+// Normally a buffer fills up once and tracing stops when any of them is full.
+// In streaming mode each buffer is a ring instead: reads drain it, and a
+// record that doesn't fit in the space not yet drained is dropped.
+typedef struct __CPU_ALIGN ktrace_cpu_buffer {
+    uint8_t* data;
+    uint32_t size;
+
+    // bytes written since the last rewind, advanced once a record is complete
+    volatile uint64_t head;
+
+    // bytes drained since the last rewind, streaming mode only
+    volatile uint64_t tail;
+} ktrace_cpu_buffer_t;
 
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // whether the buffers are rings drained by reads
+    bool streaming;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // bumped on every rewind, so readers know to start over
+    uint32_t generation;
 
-    // raw trace buffer
-    uint8_t* buffer;
+    uint32_t num_cpus;
+    ktrace_cpu_buffer_t cpus[SMP_MAX_CPUS];
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
+KCOUNTER(ktrace_dropped, "kernel.ktrace.dropped");
+
+// A record of zero length only appears in rings, to fill the space left
+// at the end of the buffer by a record that didn't fit.
+static constexpr uint32_t kPadTag = 0u;
+
+// Reserves |len| bytes in the current cpu's buffer and returns where to
+// write them, or nullptr if there is no room. Must be called with interrupts
+// disabled; the record becomes visible once ktrace_commit() is called.
+static void* ktrace_reserve(ktrace_state_t* ks, uint32_t len,
+                            ktrace_cpu_buffer_t** out_cb, uint64_t* out_head) {
+    if (ks->num_cpus == 0) {
+        return nullptr;
+    }
+    ktrace_cpu_buffer_t* cb = &ks->cpus[arch_curr_cpu_num()];
+    uint64_t head = cb->head;
+    uint32_t pos = static_cast<uint32_t>(head % cb->size);
+
+    if (ks->streaming) {
+        uint32_t pad = (cb->size - pos < len) ? cb->size - pos : 0u;
+        if (head + pad + len - atomic_load_u64(&cb->tail) > cb->size) {
+            kcounter_add(ktrace_dropped, 1);
+            return nullptr;
+        }
+        if (pad) {
+            // records are multiples of 8 bytes, so there is room for the tag
+            *reinterpret_cast<uint32_t*>(cb->data + pos) = kPadTag;
+            head += pad;
+            pos = 0u;
+        }
+    } else if (head + len > cb->size) {
+        // if we arrive at the end, stop
+        atomic_store(&ks->grpmask, 0);
+        return nullptr;
+    }
+
+    *out_cb = cb;
+    *out_head = head + len;
+    return cb->data + pos;
+}
+
+static void ktrace_commit(ktrace_cpu_buffer_t* cb, uint64_t head) {
+    atomic_store_u64(&cb->head, head);
+}
+
+// Writes a record made of a header and |len| bytes of |payload|.
+static zx_status_t ktrace_write_record(ktrace_state_t* ks, uint32_t tag, uint32_t tid,
+                                       uint64_t ts, const void* payload, size_t len) {
+    DEBUG_ASSERT(KTRACE_HDRSIZE + len <= KTRACE_LEN(tag));
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+    zx_status_t status = ZX_ERR_UNAVAILABLE;
+    ktrace_cpu_buffer_t* cb;
+    uint64_t head;
+    auto hdr = static_cast<ktrace_header_t*>(ktrace_reserve(ks, KTRACE_LEN(tag), &cb, &head));
+    if (hdr != nullptr) {
+        hdr->ts = ts;
+        hdr->tag = tag;
+        hdr->tid = tid;
+        if (len > 0u) {
+            memcpy(hdr + 1, payload, len);
+        }
+        ktrace_commit(cb, head);
+        status = ZX_OK;
+    }
+
+    arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+    return status;
+}
+
+// Name records carry no timestamp.
+static bool ktrace_is_name(uint32_t tag) {
+#define KTRACE_DEF(num, type, name, group) KTRACE_NAME_CASE_##type(name)
+#define KTRACE_NAME_CASE_16B(name)
+#define KTRACE_NAME_CASE_32B(name)
+#define KTRACE_NAME_CASE_NAME(name) case TAG_##name & ~0xFu:
+    switch (tag & ~0xFu) {
+#include <lib/zircon-internal/ktrace-def.h>
+        return true;
+    default:
+        return false;
+    }
+#undef KTRACE_NAME_CASE_NAME
+#undef KTRACE_NAME_CASE_32B
+#undef KTRACE_NAME_CASE_16B
+}
+
+// Walks the cpu buffers in timestamp order.
+class KTraceMerger {
+public:
+    // Starts at the oldest record not yet drained.
+    void Reset(ktrace_state_t* ks) {
+        ks_ = ks;
+        generation_ = ks->generation;
+        offset_ = 0u;
+        for (uint32_t i = 0; i < ks->num_cpus; ++i) {
+            pos_[i] = atomic_load_u64(&ks->cpus[i].tail);
+        }
+    }
+
+    bool stale(const ktrace_state_t* ks) const {
+        return ks_ != ks || generation_ != ks->generation;
+    }
+
+    // Returns the next record and its cpu, or nullptr if there is none yet.
+    const void* Peek(uint32_t* out_cpu) {
+        const void* next = nullptr;
+        uint64_t next_ts = 0u;
+        for (uint32_t i = 0; i < ks_->num_cpus; ++i) {
+            const uint32_t* rec = Head(i);
+            if (rec == nullptr) {
+                continue;
+            }
+            // a name goes as soon as it comes up, it must precede its uses
+            if (ktrace_is_name(*rec)) {
+                *out_cpu = i;
+                return rec;
+            }
+            uint64_t ts = reinterpret_cast<const ktrace_header_t*>(rec)->ts;
+            if (next == nullptr || ts < next_ts) {
+                next = rec;
+                next_ts = ts;
+                *out_cpu = i;
+            }
+        }
+        return next;
+    }
+
+    // Moves past the record Peek() returned for |cpu|.
+    void Advance(uint32_t cpu, uint32_t len) {
+        pos_[cpu] += len;
+        offset_ += len;
+    }
+
+    // Lets writers reuse the space of everything passed so far.
+    void Release() {
+        for (uint32_t i = 0; i < ks_->num_cpus; ++i) {
+            atomic_store_u64(&ks_->cpus[i].tail, pos_[i]);
+        }
+    }
+
+    // Bytes passed since Reset().
+    uint64_t offset() const { return offset_; }
+
+private:
+    const uint32_t* Head(uint32_t cpu) {
+        ktrace_cpu_buffer_t* cb = &ks_->cpus[cpu];
+        const uint64_t head = atomic_load_u64(&cb->head);
+        while (pos_[cpu] < head) {
+            const uint32_t pos = static_cast<uint32_t>(pos_[cpu] % cb->size);
+            const uint32_t* rec = reinterpret_cast<const uint32_t*>(cb->data + pos);
+            if (*rec != kPadTag) {
+                return rec;
+            }
+            pos_[cpu] += cb->size - pos;
+        }
+        return nullptr;
+    }
+
+    ktrace_state_t* ks_ = nullptr;
+    uint32_t generation_ = 0u;
+    uint64_t offset_ = 0u;
+    uint64_t pos_[SMP_MAX_CPUS] = {};
+};
+
+static fbl::Mutex read_lock;
+static KTraceMerger read_merger TA_GUARDED(read_lock);
+
+// Copies up to |len| bytes of whole records to |ptr| and drains them.
+static ssize_t ktrace_drain_user(ktrace_state_t* ks, void* ptr, size_t len) TA_REQ(read_lock) {
+    KTraceMerger* m = &read_merger;
+    m->Reset(ks);
+
+    size_t actual = 0u;
+    uint32_t cpu;
+    const void* rec;
+    while ((rec = m->Peek(&cpu)) != nullptr) {
+        const uint32_t rec_len = KTRACE_LEN(*static_cast<const uint32_t*>(rec));
+        if (rec_len > len - actual) {
+            break;
+        }
+        if (arch_copy_to_user(static_cast<uint8_t*>(ptr) + actual, rec, rec_len) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        actual += rec_len;
+        m->Advance(cpu, rec_len);
+    }
+
+    m->Release();
+    return actual;
+}
+
 ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
+    // null read is a query for the amount of data there is to read
+    if (ptr == nullptr) {
+        uint64_t size = 0u;
+        for (uint32_t i = 0; i < ks->num_cpus; ++i) {
+            size += atomic_load_u64(&ks->cpus[i].head) - atomic_load_u64(&ks->cpus[i].tail);
         }
+        return static_cast<ssize_t>(size);
     }
 
-    // null read is a query for trace buffer size
-    if (ptr == nullptr) {
-        return max;
+    fbl::AutoLock lock(&read_lock);
+
+    if (ks->streaming) {
+        // |off| means nothing for a ring, every read takes what's there
+        return ktrace_drain_user(ks, ptr, len);
     }
 
-    // constrain read to available buffer
-    if (off >= max) {
-        return 0;
+    // Merging from the start for every read would be quadratic, so pick up
+    // where the last read left off when it can.
+    KTraceMerger* m = &read_merger;
+    if (m->stale(ks) || off < m->offset()) {
+        m->Reset(ks);
     }
-    if (len > (max - off)) {
-        len = max - off;
+
+    size_t actual = 0u;
+    uint32_t cpu;
+    const void* rec;
+    while (actual < len && (rec = m->Peek(&cpu)) != nullptr) {
+        const uint32_t rec_len = KTRACE_LEN(*static_cast<const uint32_t*>(rec));
+        const uint64_t start = m->offset();
+        if (start + rec_len <= off) {
+            m->Advance(cpu, rec_len);
+            continue;
+        }
+
+        // |off| and |off + len| may both fall in the middle of a record
+        const uint32_t skip = static_cast<uint32_t>(off + actual - start);
+        const size_t n = fbl::min(static_cast<size_t>(rec_len - skip), len - actual);
+        if (arch_copy_to_user(static_cast<uint8_t*>(ptr) + actual,
+                              static_cast<const uint8_t*>(rec) + skip, n) != ZX_OK) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        actual += n;
+        if (skip + n < rec_len) {
+            break;
+        }
+        m->Advance(cpu, rec_len);
     }
+    return actual;
+}
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
-        return ZX_ERR_INVALID_ARGS;
+// Empties the buffers and writes the metadata every trace starts with. The
+// caller stops tracing first.
+static void ktrace_rewind(ktrace_state_t* ks) {
+    {
+        fbl::AutoLock lock(&read_lock);
+        for (uint32_t i = 0; i < ks->num_cpus; ++i) {
+            atomic_store_u64(&ks->cpus[i].head, 0u);
+            atomic_store_u64(&ks->cpus[i].tail, 0u);
+        }
+        ks->generation++;
     }
-    return len;
+
+    // a zero timestamp sorts these ahead of everything else
+    uint64_t n = ktrace_ticks_per_ms();
+    uint32_t version[4] = {KTRACE_VERSION, 0u, 0u, 0u};
+    uint32_t ticks[4] = {static_cast<uint32_t>(n), static_cast<uint32_t>(n >> 32), 0u, 0u};
+    ktrace_write_record(ks, TAG_VERSION, 0u, 0u, version, sizeof(version));
+    ktrace_write_record(ks, TAG_TICKS_PER_MS, 0u, 0u, ticks, sizeof(ticks));
+
+    ktrace_report_syscalls(kt_syscall_info);
+    ktrace_report_probes();
+    ktrace_report_vcpu_meta();
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     ktrace_state_t* ks = &KTRACE_STATE;
     switch (action) {
     case KTRACE_ACTION_START:
+    case KTRACE_ACTION_START_STREAMING: {
+        bool streaming = (action == KTRACE_ACTION_START_STREAMING);
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
+        if (streaming || ks->streaming) {
+            // what is in the buffers can't be read the other way
+            atomic_store(&ks->grpmask, 0);
+            ks->streaming = streaming;
+            ktrace_rewind(ks);
+        }
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_processes();
         ktrace_report_live_threads();
         break;
-    case KTRACE_ACTION_STOP: {
+    }
+    case KTRACE_ACTION_STOP:
         atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
-        }
         break;
-    }
     case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
-        ktrace_report_syscalls(kt_syscall_info);
-        ktrace_report_probes();
-        ktrace_report_vcpu_meta();
+        ktrace_rewind(ks);
         break;
     case KTRACE_ACTION_NEW_PROBE: {
         fbl::AutoLock lock(&probe_list_lock);
@@ -193,21 +449,26 @@ void ktrace_init(unsigned level) {
 
     mb *= (1024*1024);
 
+    uint32_t num_cpus = arch_max_num_cpus();
+    uint32_t size = ROUNDDOWN(mb / num_cpus, 8);
+
     zx_status_t status;
+    uint8_t* buffer;
     VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
+    if ((status = aspace->Alloc("ktrace", mb, (void**)&buffer, 0, VmAspace::VMM_FLAG_COMMIT,
                                 ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
         return;
     }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    for (uint32_t i = 0; i < num_cpus; ++i) {
+        ks->cpus[i].data = buffer + i * size;
+        ks->cpus[i].size = size;
+    }
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    dprintf(INFO, "ktrace: buffer at %p (%u bytes, %u per cpu)\n", buffer, mb, size);
 
-    // register all static probes
+    // register all static probes, their names are written below
     {
         fbl::AutoLock lock(&probe_list_lock);
         for (auto probe = __start_ktrace_probe;
@@ -217,27 +478,14 @@ void ktrace_init(unsigned level) {
         }
     }
 
-    // write metadata to the first two event slots
-    uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
-    rec[0].tag = TAG_VERSION;
-    rec[0].a = KTRACE_VERSION;
-    rec[1].tag = TAG_TICKS_PER_MS;
-    rec[1].a = (uint32_t)n;
-    rec[1].b = (uint32_t)(n >> 32);
-
-    // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
-    ktrace_report_syscalls(kt_syscall_info);
-    ktrace_report_probes();
+    // write metadata, then enable tracing
+    ks->num_cpus = num_cpus;
+    ktrace_rewind(ks);
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
 
     // report names of existing threads
     ktrace_report_live_threads();
 
-    // report metadata for VCPUs
-    ktrace_report_vcpu_meta();
-
     // Report an event for "tracing is all set up now".  This also
     // serves to ensure that there will be at least one static probe
     // entry so that the __{start,stop}_ktrace_probe symbols above
@@ -249,37 +497,18 @@ void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
         tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-            hdr->ts = ktrace_timestamp();
-            hdr->tag = tag;
-            hdr->tid = arg;
-        }
+        ktrace_write_record(ks, tag, arg, ktrace_timestamp(), nullptr, 0u);
     }
 }
 
-void* ktrace_open(uint32_t tag) {
+zx_status_t ktrace_write(uint32_t tag, const void* payload, size_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (!(tag & atomic_load(&ks->grpmask))) {
-        return nullptr;
-    }
-
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return nullptr;
+        return ZX_ERR_UNAVAILABLE;
     }
 
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-    hdr->ts = ktrace_timestamp();
-    hdr->tag = tag;
-    hdr->tid = (uint32_t)get_current_thread()->user_tid;
-    return hdr + 1;
+    return ktrace_write_record(ks, tag, (uint32_t)get_current_thread()->user_tid,
+                               ktrace_timestamp(), payload, len);
 }
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
@@ -290,18 +519,23 @@ void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name,
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+        ktrace_cpu_buffer_t* cb;
+        uint64_t head;
+        auto rec = static_cast<ktrace_rec_name_t*>(
+            ktrace_reserve(ks, KTRACE_LEN(tag), &cb, &head));
+        if (rec != nullptr) {
             rec->tag = tag;
             rec->id = id;
             rec->arg = arg;
             memcpy(rec->name, name, len);
             rec->name[len] = 0;
+            ktrace_commit(cb, head);
         }
+
+        arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
     }
 }
 
@@ -19,48 +19,54 @@ extern void* memset(void*, int, size_t);
 extern void* memset_erms(void*, int, size_t);
 extern void* memset_quad(void*, int, size_t);
 
-void x86_memcpy_select(const CodePatchInfo* patch) {
+extern void arch_zero_page(void*);
+extern void arch_zero_page_erms(void*);
+extern void arch_zero_page_quad(void*);
+
+}
+
+namespace {
+
+// Whether "rep movsb" and "rep stosb" beat moving a quadword at a time.
+bool fast_rep_string_ops() {
+    return x86_feature_test(X86_FEATURE_ERMS) || x86_feature_test(X86_FEATURE_FSRM);
+}
+
+// Patches the jmp at |entry| to go to |fast| or |fallback|, per
+// fast_rep_string_ops().
+template <typename Func>
+void select_implementation(const CodePatchInfo* patch, Func* entry, Func* fast, Func* fallback) {
     // We are patching a jmp rel8 instruction, which is two bytes.  The rel8
     // value is a signed 8-bit value specifying an offset relative to the
     // address of the next instruction in memory after the jmp instruction.
     const size_t kSize = 2;
-    const intptr_t jmp_from_address = reinterpret_cast<intptr_t>(memcpy) + kSize;
+    const intptr_t jmp_from_address = reinterpret_cast<intptr_t>(entry) + kSize;
 
     DEBUG_ASSERT(patch->dest_size == kSize);
     DEBUG_ASSERT(reinterpret_cast<uintptr_t>(patch->dest_addr) ==
-                 reinterpret_cast<uintptr_t>(memcpy));
-
-    intptr_t offset;
-    if (x86_feature_test(X86_FEATURE_ERMS)) {
-        offset = reinterpret_cast<intptr_t>(memcpy_erms) - jmp_from_address;
-    } else {
-        offset = reinterpret_cast<intptr_t>(memcpy_quad) - jmp_from_address;
-    }
+                 reinterpret_cast<uintptr_t>(entry));
+
+    Func* target = fast_rep_string_ops() ? fast : fallback;
+    intptr_t offset = reinterpret_cast<intptr_t>(target) - jmp_from_address;
     DEBUG_ASSERT(offset >= -128 && offset <= 127);
     patch->dest_addr[0] = 0xeb; /* jmp rel8 */
     patch->dest_addr[1] = static_cast<uint8_t>(offset);
 }
 
+} // namespace
+
+extern "C" {
+
+void x86_memcpy_select(const CodePatchInfo* patch) {
+    select_implementation(patch, memcpy, memcpy_erms, memcpy_quad);
+}
+
 void x86_memset_select(const CodePatchInfo* patch) {
-    // We are patching a jmp rel8 instruction, which is two bytes.  The rel8
-    // value is a signed 8-bit value specifying an offset relative to the
-    // address of the next instruction in memory after the jmp instruction.
-    const size_t kSize = 2;
-    const intptr_t jmp_from_address = reinterpret_cast<intptr_t>(memset) + kSize;
+    select_implementation(patch, memset, memset_erms, memset_quad);
+}
 
-    DEBUG_ASSERT(patch->dest_size == kSize);
-    DEBUG_ASSERT(reinterpret_cast<uintptr_t>(patch->dest_addr) ==
-                 reinterpret_cast<uintptr_t>(memset));
-
-    intptr_t offset;
-    if (x86_feature_test(X86_FEATURE_ERMS)) {
-        offset = reinterpret_cast<intptr_t>(memset_erms) - jmp_from_address;
-    } else {
-        offset = reinterpret_cast<intptr_t>(memset_quad) - jmp_from_address;
-    }
-    DEBUG_ASSERT(offset >= -128 && offset <= 127);
-    patch->dest_addr[0] = 0xeb; /* jmp rel8 */
-    patch->dest_addr[1] = static_cast<uint8_t>(offset);
+void x86_zero_page_select(const CodePatchInfo* patch) {
+    select_implementation(patch, arch_zero_page, arch_zero_page_erms, arch_zero_page_quad);
 }
 
 }
@@ -4,10 +4,12 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <arch/defines.h>
 #include <arch/x86/feature.h>
 #include <assert.h>
 #include <lib/unittest/unittest.h>
 #include <stddef.h>
+#include <string.h>
 
 extern "C" {
 
@@ -19,10 +21,15 @@ extern void* memset(void*, int, size_t);
 extern void* memset_erms(void*, int, size_t);
 extern void* memset_quad(void*, int, size_t);
 
+extern void arch_zero_page(void*);
+extern void arch_zero_page_erms(void*);
+extern void arch_zero_page_quad(void*);
+
 }
 
 typedef void* (*memcpy_func_t)(void*, const void*, size_t);
 typedef void* (*memset_func_t)(void*, int, size_t);
+typedef void (*zero_page_func_t)(void*);
 
 // Initializes buf with |fill_len| bytes of |fill|, and pads the remaining
 // |len - fill_len| bytes with 0xff.
@@ -138,6 +145,24 @@ static bool memset_func_test(memset_func_t set) {
     END_TEST;
 }
 
+static bool zero_page_func_test(zero_page_func_t zero) {
+    BEGIN_TEST;
+
+    // Zero the middle of three pages, so we can check we stay inside it.
+    alignas(PAGE_SIZE) static uint8_t buf[3 * PAGE_SIZE];
+    uint8_t* page = buf + PAGE_SIZE;
+    memset(buf, 0xff, sizeof(buf));
+
+    zero(page);
+    for (size_t i = 0; i < PAGE_SIZE; ++i) {
+        ASSERT_EQ(0, page[i], "buffer mismatch");
+    }
+    ASSERT_EQ(0xff, page[-1], "overwrote before page");
+    ASSERT_EQ(0xff, page[PAGE_SIZE], "overwrote after page");
+
+    END_TEST;
+}
+
 static bool memcpy_test() {
     return memcpy_func_test(memcpy);
 }
@@ -170,6 +195,22 @@ static bool memset_erms_test() {
     return memset_func_test(memset_erms);
 }
 
+static bool zero_page_test() {
+    return zero_page_func_test(arch_zero_page);
+}
+
+static bool zero_page_quad_test() {
+    return zero_page_func_test(arch_zero_page_quad);
+}
+
+static bool zero_page_erms_test() {
+    if (!x86_feature_test(X86_FEATURE_ERMS)) {
+        return true;
+    }
+
+    return zero_page_func_test(arch_zero_page_erms);
+}
+
 UNITTEST_START_TESTCASE(memops_tests)
 UNITTEST("memcpy tests", memcpy_test)
 UNITTEST("memcpy_quad tests", memcpy_quad_test)
@@ -177,4 +218,7 @@ UNITTEST("memcpy_erms tests", memcpy_erms_test)
 UNITTEST("memset tests", memset_test)
 UNITTEST("memset_quad tests", memset_quad_test)
 UNITTEST("memset_erms tests", memset_erms_test)
+UNITTEST("arch_zero_page tests", zero_page_test)
+UNITTEST("arch_zero_page_quad tests", zero_page_quad_test)
+UNITTEST("arch_zero_page_erms tests", zero_page_erms_test)
 UNITTEST_END_TESTCASE(memops_tests, "memops_tests", "memcpy/memset tests");
@@ -10,9 +10,11 @@
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
 #include <lk/init.h>
+#include <platform.h>
 #include <vm/vm.h>
 
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lib/version.h>
 
 #include <inttypes.h>
@@ -30,6 +32,11 @@ static_assert(sizeof(lockdep_state_t) == sizeof(lockdep::ThreadLockState),
 
 namespace {
 
+// Totals over all lock classes of the acquisitions that lock profiling found
+// contended and of the time they waited.
+KCOUNTER(lockstat_contended, "kernel.lockstat.contended");
+KCOUNTER(lockstat_contended_wait_ns, "kernel.lockstat.contended_wait_ns");
+
 // Event to wake up the loop detector thread when a new edge is added to the
 // lock dependency graph.
 event_t graph_edge_event =
@@ -104,6 +111,87 @@ int CommandLockDep(int argc, const cmd_args* argv, uint32_t flags) {
     return 0;
 }
 
+// Dumps the contention statistics of every lock class that has been acquired,
+// or of the |limit| classes that waited longest for their locks if |limit| is
+// not zero.
+void DumpLockStats(size_t limit) {
+    if (!lockdep::kLockProfilingEnabled) {
+        printf("Lock profiling is not enabled, set ENABLE_LOCK_PROFILING.\n");
+        return;
+    }
+
+    printf("%12s %12s %14s %12s %14s %12s  %s\n", "acquired", "contended",
+           "total wait ns", "max wait ns", "total hold ns", "max hold ns", "name");
+
+    // Select by repeatedly finding the largest total wait below the last
+    // one printed; this runs from the console, so simplicity wins.
+    size_t printed = 0;
+    const lockdep::LockClassState* last = nullptr;
+    uint64_t last_wait = UINT64_MAX;
+    while (limit == 0 || printed < limit) {
+        const lockdep::LockClassState* next = nullptr;
+        uint64_t next_wait = 0;
+        bool past_last = (last == nullptr);
+        for (auto& state : lockdep::LockClassState::Iter()) {
+            if (&state == last) {
+                past_last = true;
+                continue;
+            }
+            const auto& profile = state.profile();
+            if (profile.acquisitions.load(fbl::memory_order_relaxed) == 0)
+                continue;
+            const uint64_t wait = profile.total_wait.load(fbl::memory_order_relaxed);
+            // Ties with the last class printed are broken by list order.
+            const bool eligible = wait < last_wait || (wait == last_wait && past_last);
+            if (eligible && (next == nullptr || wait > next_wait)) {
+                next = &state;
+                next_wait = wait;
+            }
+        }
+        if (next == nullptr)
+            break;
+
+        const auto& profile = next->profile();
+        printf("%12" PRIu64 " %12" PRIu64 " %14" PRIu64 " %12" PRIu64 " %14" PRIu64
+               " %12" PRIu64 "  %s\n",
+               profile.acquisitions.load(fbl::memory_order_relaxed),
+               profile.contended.load(fbl::memory_order_relaxed),
+               next_wait,
+               profile.max_wait.load(fbl::memory_order_relaxed),
+               profile.total_hold.load(fbl::memory_order_relaxed),
+               profile.max_hold.load(fbl::memory_order_relaxed),
+               next->name());
+        last = next;
+        last_wait = next_wait;
+        printed++;
+    }
+}
+
+// Top-level lock profiling command.
+int CommandLockStat(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+        printf("Not enough arguments:\n");
+    usage:
+        printf("%s dump [<count>]    : dump lock class statistics, by total wait\n",
+               argv[0].str);
+        printf("%s reset             : clear lock class statistics\n", argv[0].str);
+        return -1;
+    }
+
+    if (strcmp(argv[1].str, "dump") == 0) {
+        DumpLockStats(argc > 2 ? static_cast<size_t>(argv[2].u) : 0);
+    } else if (strcmp(argv[1].str, "reset") == 0) {
+        for (auto& state : lockdep::LockClassState::Iter()) {
+            state.ResetProfile();
+        }
+    } else {
+        printf("Unrecognized subcommand: '%s'\n", argv[1].str);
+        goto usage;
+    }
+
+    return 0;
+}
+
 // Utility to cast from lockdep_state_t* to ThreadLockState*.
 inline lockdep::ThreadLockState* ToThreadLockState(lockdep_state_t* state) {
     return reinterpret_cast<lockdep::ThreadLockState*>(state);
@@ -113,6 +201,7 @@ inline lockdep::ThreadLockState* ToThreadLockState(lockdep_state_t* state) {
 
 STATIC_COMMAND_START
 STATIC_COMMAND("lockdep", "kernel lock diagnostics", &CommandLockDep)
+STATIC_COMMAND("lockstat", "kernel lock contention statistics", &CommandLockStat)
 STATIC_COMMAND_END(lockdep);
 
 LK_INIT_HOOK(lockdep, LockDepInit, LK_INIT_LEVEL_THREADING);
@@ -204,6 +293,17 @@ void SystemTriggerLoopDetection() {
     event_signal(&graph_edge_event, /*reschedule=*/false);
 }
 
+// Returns the current monotonic time for lock profiling.
+uint64_t SystemGetTimestamp() {
+    return current_time();
+}
+
+// Accounts a contended acquisition in the system-wide counters.
+void SystemLockContended(LockClassState* state, uint64_t wait_ns) {
+    kcounter_add(lockstat_contended, 1);
+    kcounter_add(lockstat_contended_wait_ns, static_cast<int64_t>(wait_ns));
+}
+
 } // namespace lockdep
 
 #endif
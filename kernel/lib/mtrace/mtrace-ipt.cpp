@@ -12,7 +12,10 @@
 #include "lib/mtrace.h"
 #include "trace.h"
 
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <lib/zircon-internal/mtrace.h>
 #include <lib/zircon-internal/device/cpu-trace/intel-pt.h>
 
@@ -22,6 +25,25 @@
 
 static_assert(IPT_MAX_NUM_TRACES >= SMP_MAX_CPUS, "");
 
+static fbl::Mutex ipt_threads_lock;
+
+// The threads buffers are assigned to in IPT_MODE_THREADS, indexed by buffer
+// descriptor. The references keep the threads' |thread_t| around while the
+// arch code may be looking at them.
+static fbl::RefPtr<ThreadDispatcher> ipt_threads[IPT_MAX_NUM_TRACES] TA_GUARDED(ipt_threads_lock);
+
+static zx_status_t get_thread(user_inout_ptr<void> arg, size_t size,
+                              fbl::RefPtr<ThreadDispatcher>* thread) {
+    zx_handle_t handle;
+    if (size != sizeof(handle))
+        return ZX_ERR_INVALID_ARGS;
+    zx_status_t status = arg.reinterpret<zx_handle_t>().copy_from_user(&handle);
+    if (status != ZX_OK)
+        return status;
+    auto up = ProcessDispatcher::GetCurrent();
+    return up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, thread);
+}
+
 zx_status_t mtrace_insntrace_control(uint32_t action, uint32_t options,
                                      user_inout_ptr<void> arg, size_t size) {
     TRACEF("action %u, options 0x%x, arg %p, size 0x%zx\n",
@@ -86,6 +108,46 @@ zx_status_t mtrace_insntrace_control(uint32_t action, uint32_t options,
         return ZX_OK;
     }
 
+    case MTRACE_INSNTRACE_ASSIGN_THREAD_BUFFER: {
+        zx_itrace_buffer_descriptor_t descriptor = options;
+        if (descriptor >= IPT_MAX_NUM_TRACES)
+            return ZX_ERR_INVALID_ARGS;
+        fbl::RefPtr<ThreadDispatcher> thread;
+        zx_status_t status = get_thread(arg, size, &thread);
+        if (status != ZX_OK)
+            return status;
+        TRACEF("action %u, descriptor %u, thread %" PRIu64 "\n",
+               action, descriptor, thread->get_koid());
+        fbl::AutoLock al(&ipt_threads_lock);
+        if (ipt_threads[descriptor])
+            return ZX_ERR_BAD_STATE;
+        status = x86_ipt_assign_thread_buffer(descriptor, thread->thread());
+        if (status != ZX_OK)
+            return status;
+        ipt_threads[descriptor] = fbl::move(thread);
+        return ZX_OK;
+    }
+
+    case MTRACE_INSNTRACE_RELEASE_THREAD_BUFFER: {
+        zx_itrace_buffer_descriptor_t descriptor = options;
+        if (descriptor >= IPT_MAX_NUM_TRACES)
+            return ZX_ERR_INVALID_ARGS;
+        fbl::RefPtr<ThreadDispatcher> thread;
+        zx_status_t status = get_thread(arg, size, &thread);
+        if (status != ZX_OK)
+            return status;
+        TRACEF("action %u, descriptor %u, thread %" PRIu64 "\n",
+               action, descriptor, thread->get_koid());
+        fbl::AutoLock al(&ipt_threads_lock);
+        if (ipt_threads[descriptor] != thread)
+            return ZX_ERR_INVALID_ARGS;
+        status = x86_ipt_release_thread_buffer(descriptor, thread->thread());
+        if (status != ZX_OK)
+            return status;
+        ipt_threads[descriptor].reset();
+        return ZX_OK;
+    }
+
     case MTRACE_INSNTRACE_START:
         if (options != 0 || size != 0)
             return ZX_ERR_INVALID_ARGS;
@@ -0,0 +1,112 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stddef.h>
+
+#include <fbl/atomic.h>
+#include <fbl/intrusive_single_list.h>
+#include <kernel/align.h>
+#include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
+
+// A cache of fixed-size objects in front of the kernel heap.
+//
+// Freed objects are kept in per-cpu magazines, small stacks of object
+// pointers, so that allocating on a cpu that has recently freed an object
+// only takes that cpu's lock. Each cpu holds a loaded and a previous
+// magazine; when both are spent it trades one with the depot, a shared list
+// of full and empty magazines, and goes to the heap only when the depot has
+// nothing to offer either.
+//
+// The cache hands out raw memory: callers construct and destroy the objects
+// themselves. Alloc() and Free() may take the heap lock, so they must not be
+// called in interrupt context.
+class ObjectCache {
+public:
+    // Creates a cache of objects of |object_size| bytes. If |max_objects| is
+    // not zero, at most that many objects are taken from the heap at once,
+    // cached ones included. Allocations served from the magazines are counted
+    // in |hits| and those that had to go to the heap in |misses|; see
+    // OBJECT_CACHE() below.
+    ObjectCache(const char* name, size_t object_size, size_t max_objects,
+                const k_counter_desc* hits, const k_counter_desc* misses);
+    ~ObjectCache();
+
+    ObjectCache(const ObjectCache&) = delete;
+    ObjectCache& operator=(const ObjectCache&) = delete;
+
+    // Returns an object, or nullptr if the heap is out of memory or the cache
+    // is at |max_objects|.
+    void* Alloc();
+
+    // Returns |object|, which must have come from Alloc(), to the cache.
+    void Free(void* object);
+
+    // Returns every cached object to the heap.
+    void Drain();
+
+    const char* name() const { return name_; }
+
+    // The number of objects currently taken from the heap.
+    size_t heap_objects() const { return heap_objects_.load(); }
+
+private:
+    // How many objects one magazine holds.
+    static constexpr size_t kMagazineSize = 16u;
+
+    // How many full magazines the depot keeps before it frees the surplus
+    // back to the heap.
+    static constexpr size_t kMaxDepotMagazines = 16u;
+
+    struct Magazine : fbl::SinglyLinkedListable<Magazine*> {
+        size_t rounds = 0u;
+        void* objects[kMagazineSize];
+    };
+
+    struct __CPU_ALIGN CpuCache {
+        DECLARE_SPINLOCK(CpuCache) lock;
+        Magazine* loaded TA_GUARDED(lock) = nullptr;
+        Magazine* previous TA_GUARDED(lock) = nullptr;
+    };
+
+    // Pops an object from |cpu|'s magazines, refilling them from the depot
+    // if needed.
+    void* AllocCached(CpuCache* cpu);
+
+    // Pushes |object| onto |cpu|'s magazines, trading a full one for an empty
+    // one with the depot if needed. If the depot has no empty magazine,
+    // |*spare| is used instead if set, and false is returned if not. A full
+    // magazine the depot has no room for is handed back in |*surplus|.
+    bool FreeCached(CpuCache* cpu, void* object, Magazine** spare, Magazine** surplus);
+
+    void FreeToHeap(void* object);
+    void FreeMagazine(Magazine* magazine);
+
+    const char* const name_;
+    const size_t object_size_;
+    const size_t max_objects_;
+    const k_counter_desc* const hits_;
+    const k_counter_desc* const misses_;
+
+    fbl::atomic<size_t> heap_objects_;
+
+    DECLARE_SPINLOCK(ObjectCache) depot_lock_;
+    fbl::SinglyLinkedList<Magazine*> full_ TA_GUARDED(depot_lock_);
+    size_t full_count_ TA_GUARDED(depot_lock_) = 0u;
+    fbl::SinglyLinkedList<Magazine*> empty_ TA_GUARDED(depot_lock_);
+
+    CpuCache cpus_[SMP_MAX_CPUS];
+};
+
+// Defines |var|, an ObjectCache for objects of |type|, along with its hit and
+// miss counters "kernel.object_cache.<name>.hits" and ".misses".
+#define OBJECT_CACHE(var, name, type, max_objects)                    \
+    KCOUNTER(var##_hits, "kernel.object_cache." name ".hits");       \
+    KCOUNTER(var##_misses, "kernel.object_cache." name ".misses");   \
+    ObjectCache var(name, sizeof(type), max_objects, var##_hits, var##_misses)
@@ -0,0 +1,192 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/object_cache.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <malloc.h>
+
+#include <fbl/alloc_checker.h>
+
+namespace {
+
+template <typename T>
+void swap_magazines(T* a, T* b) {
+    T tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+} // namespace
+
+ObjectCache::ObjectCache(const char* name, size_t object_size, size_t max_objects,
+                         const k_counter_desc* hits, const k_counter_desc* misses)
+    : name_(name), object_size_(object_size), max_objects_(max_objects), hits_(hits),
+      misses_(misses), heap_objects_(0u) {
+    DEBUG_ASSERT(object_size > 0u);
+}
+
+ObjectCache::~ObjectCache() {
+    Drain();
+    while (!empty_.is_empty()) {
+        delete empty_.pop_front();
+    }
+    DEBUG_ASSERT(heap_objects_.load() == 0u);
+}
+
+void* ObjectCache::Alloc() {
+    // Migrating after sampling the cpu number is harmless, the cpu's lock
+    // keeps its magazines consistent.
+    void* object = AllocCached(&cpus_[arch_curr_cpu_num()]);
+    if (object != nullptr) {
+        kcounter_add(hits_, 1);
+        return object;
+    }
+    kcounter_add(misses_, 1);
+
+    const size_t count = heap_objects_.fetch_add(1u);
+    if (max_objects_ == 0u || count < max_objects_) {
+        object = malloc(object_size_);
+        if (object != nullptr)
+            return object;
+    }
+    heap_objects_.fetch_sub(1u);
+
+    // Other cpus may still be holding on to free objects.
+    for (auto& cpu : cpus_) {
+        object = AllocCached(&cpu);
+        if (object != nullptr)
+            return object;
+    }
+    return nullptr;
+}
+
+void ObjectCache::Free(void* object) {
+    DEBUG_ASSERT(object != nullptr);
+
+    CpuCache* cpu = &cpus_[arch_curr_cpu_num()];
+    Magazine* spare = nullptr;
+    Magazine* surplus = nullptr;
+    bool cached = FreeCached(cpu, object, &spare, &surplus);
+    if (!cached) {
+        // Nobody has room, so bring an empty magazine and try again.
+        fbl::AllocChecker ac;
+        spare = new (&ac) Magazine();
+        if (ac.check()) {
+            cached = FreeCached(cpu, object, &spare, &surplus);
+        }
+    }
+
+    // The heap can't be called into with the locks held.
+    if (spare != nullptr) {
+        delete spare;
+    }
+    if (surplus != nullptr) {
+        FreeMagazine(surplus);
+    }
+    if (!cached) {
+        FreeToHeap(object);
+    }
+}
+
+void ObjectCache::Drain() {
+    fbl::SinglyLinkedList<Magazine*> magazines;
+
+    for (auto& cpu : cpus_) {
+        Guard<SpinLock, IrqSave> guard{&cpu.lock};
+        if (cpu.loaded != nullptr) {
+            magazines.push_front(cpu.loaded);
+            cpu.loaded = nullptr;
+        }
+        if (cpu.previous != nullptr) {
+            magazines.push_front(cpu.previous);
+            cpu.previous = nullptr;
+        }
+    }
+    {
+        Guard<SpinLock, IrqSave> guard{&depot_lock_};
+        while (!full_.is_empty()) {
+            magazines.push_front(full_.pop_front());
+        }
+        full_count_ = 0u;
+    }
+
+    while (!magazines.is_empty()) {
+        FreeMagazine(magazines.pop_front());
+    }
+}
+
+void* ObjectCache::AllocCached(CpuCache* cpu) {
+    Guard<SpinLock, IrqSave> guard{&cpu->lock};
+
+    Magazine* magazine = cpu->loaded;
+    if (magazine == nullptr || magazine->rounds == 0u) {
+        if (cpu->previous != nullptr && cpu->previous->rounds > 0u) {
+            swap_magazines(&cpu->loaded, &cpu->previous);
+        } else {
+            Guard<SpinLock, NoIrqSave> depot_guard{&depot_lock_};
+            Magazine* full = full_.pop_front();
+            if (full == nullptr)
+                return nullptr;
+            --full_count_;
+            if (cpu->previous != nullptr) {
+                empty_.push_front(cpu->previous);
+            }
+            cpu->previous = cpu->loaded;
+            cpu->loaded = full;
+        }
+        magazine = cpu->loaded;
+    }
+
+    return magazine->objects[--magazine->rounds];
+}
+
+bool ObjectCache::FreeCached(CpuCache* cpu, void* object, Magazine** spare, Magazine** surplus) {
+    Guard<SpinLock, IrqSave> guard{&cpu->lock};
+
+    Magazine* magazine = cpu->loaded;
+    if (magazine == nullptr || magazine->rounds == kMagazineSize) {
+        if (cpu->previous != nullptr && cpu->previous->rounds < kMagazineSize) {
+            swap_magazines(&cpu->loaded, &cpu->previous);
+        } else {
+            Guard<SpinLock, NoIrqSave> depot_guard{&depot_lock_};
+            Magazine* empty = empty_.pop_front();
+            if (empty == nullptr) {
+                empty = *spare;
+                *spare = nullptr;
+                if (empty == nullptr)
+                    return false;
+            }
+            if (cpu->previous != nullptr) {
+                if (full_count_ < kMaxDepotMagazines) {
+                    full_.push_front(cpu->previous);
+                    ++full_count_;
+                } else {
+                    *surplus = cpu->previous;
+                }
+            }
+            cpu->previous = cpu->loaded;
+            cpu->loaded = empty;
+        }
+        magazine = cpu->loaded;
+    }
+
+    magazine->objects[magazine->rounds++] = object;
+    return true;
+}
+
+void ObjectCache::FreeToHeap(void* object) {
+    free(object);
+    heap_objects_.fetch_sub(1u);
+}
+
+void ObjectCache::FreeMagazine(Magazine* magazine) {
+    for (size_t i = 0; i < magazine->rounds; ++i) {
+        FreeToHeap(magazine->objects[i]);
+    }
+    delete magazine;
+}
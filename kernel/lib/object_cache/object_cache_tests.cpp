@@ -0,0 +1,104 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/object_cache.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <lib/unittest/unittest.h>
+
+KCOUNTER(test_cache_hits, "kernel.object_cache.test.hits");
+KCOUNTER(test_cache_misses, "kernel.object_cache.test.misses");
+
+struct TestObj {
+    int xx, yy, zz;
+};
+
+// ObjectCache is too large for the stack.
+static fbl::unique_ptr<ObjectCache> make_cache(size_t max_objects) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<ObjectCache> cache(new (&ac) ObjectCache(
+        "test", sizeof(TestObj), max_objects, test_cache_hits, test_cache_misses));
+    if (!ac.check())
+        return nullptr;
+    return cache;
+}
+
+static bool alloc_honors_max_objects() {
+    BEGIN_TEST;
+    static constexpr size_t kMax = 4u;
+    auto cache = make_cache(kMax);
+    ASSERT_NONNULL(cache.get(), "");
+
+    void* objects[kMax];
+    for (auto& object : objects) {
+        object = cache->Alloc();
+        ASSERT_NONNULL(object, "");
+    }
+    EXPECT_NULL(cache->Alloc(), "");
+    EXPECT_EQ(kMax, cache->heap_objects(), "");
+
+    // A freed object is found again, whichever cpu it was cached on.
+    cache->Free(objects[0]);
+    objects[0] = cache->Alloc();
+    EXPECT_NONNULL(objects[0], "");
+
+    for (auto object : objects) {
+        if (object != nullptr) {
+            cache->Free(object);
+        }
+    }
+    END_TEST;
+}
+
+static bool freed_objects_are_reused() {
+    BEGIN_TEST;
+    // Several magazines' worth, so the depot gets involved.
+    static constexpr size_t kCount = 64u;
+    auto cache = make_cache(kCount);
+    ASSERT_NONNULL(cache.get(), "");
+
+    void* objects[kCount];
+    for (int round = 0; round < 2; ++round) {
+        for (auto& object : objects) {
+            object = cache->Alloc();
+            ASSERT_NONNULL(object, "");
+        }
+        for (auto object : objects) {
+            cache->Free(object);
+        }
+        // Freed objects stay cached rather than going back to the heap.
+        EXPECT_EQ(kCount, cache->heap_objects(), "");
+    }
+    END_TEST;
+}
+
+static bool drain_returns_everything() {
+    BEGIN_TEST;
+    static constexpr size_t kCount = 40u;
+    auto cache = make_cache(0u);
+    ASSERT_NONNULL(cache.get(), "");
+
+    void* objects[kCount];
+    for (auto& object : objects) {
+        object = cache->Alloc();
+        ASSERT_NONNULL(object, "");
+    }
+    for (auto object : objects) {
+        cache->Free(object);
+    }
+    EXPECT_EQ(kCount, cache->heap_objects(), "");
+
+    cache->Drain();
+    EXPECT_EQ(0u, cache->heap_objects(), "");
+    END_TEST;
+}
+
+UNITTEST_START_TESTCASE(object_cache_tests)
+UNITTEST("alloc_honors_max_objects", alloc_honors_max_objects)
+UNITTEST("freed_objects_are_reused", freed_objects_are_reused)
+UNITTEST("drain_returns_everything", drain_returns_everything)
+UNITTEST_END_TESTCASE(object_cache_tests, "objcache", "Object cache tests");
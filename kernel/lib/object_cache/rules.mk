@@ -0,0 +1,19 @@
+# Copyright 2018 The Fuchsia Authors
+#
+# Use of this source code is governed by a MIT-style
+# license that can be found in the LICENSE file or at
+# https://opensource.org/licenses/MIT
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_DEPS := \
+    kernel/lib/fbl \
+    kernel/lib/unittest \
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/object_cache.cpp \
+    $(LOCAL_DIR)/object_cache_tests.cpp \
+
+include make/module.mk
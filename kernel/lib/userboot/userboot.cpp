@@ -17,6 +17,7 @@
 #include <kernel/cmdline.h>
 #include <vm/vm_object_paged.h>
 #include <lib/console.h>
+#include <lib/counters-vmo.h>
 #include <lib/vdso.h>
 #include <lk/init.h>
 #include <mexec.h>
@@ -182,6 +183,8 @@ enum bootstrap_handle_index {
     BOOTSTRAP_JOB,
     BOOTSTRAP_VMAR_ROOT,
     BOOTSTRAP_CRASHLOG,
+    BOOTSTRAP_COUNTERS_DESC,
+    BOOTSTRAP_COUNTERS_ARENA,
 #if ENABLE_ENTROPY_COLLECTOR_TEST
     BOOTSTRAP_ENTROPY_FILE,
 #endif
@@ -241,9 +244,15 @@ static fbl::unique_ptr<MessagePacket> prepare_bootstrap_message() {
         case BOOTSTRAP_CRASHLOG:
             info = PA_HND(PA_VMO_KERNEL_FILE, 0);
             break;
+        case BOOTSTRAP_COUNTERS_DESC:
+            info = PA_HND(PA_VMO_KERNEL_FILE, 1);
+            break;
+        case BOOTSTRAP_COUNTERS_ARENA:
+            info = PA_HND(PA_VMO_KERNEL_FILE, 2);
+            break;
 #if ENABLE_ENTROPY_COLLECTOR_TEST
         case BOOTSTRAP_ENTROPY_FILE:
-            info = PA_HND(PA_VMO_KERNEL_FILE, 1);
+            info = PA_HND(PA_VMO_KERNEL_FILE, 3);
             break;
 #endif
         case BOOTSTRAP_HANDLES:
@@ -307,6 +316,11 @@ static zx_status_t attempt_userboot() {
     if (status != ZX_OK)
         return status;
 
+    fbl::RefPtr<VmObject> counters_desc_vmo, counters_arena_vmo;
+    status = counters_create_vmos(&counters_desc_vmo, &counters_arena_vmo);
+    if (status != ZX_OK)
+        return status;
+
     // Prepare the bootstrap message packet.  This puts its data (the
     // kernel command line) in place, and allocates space for its handles.
     // We'll fill in the handles as we create things.
@@ -325,6 +339,12 @@ static zx_status_t attempt_userboot() {
     if (status == ZX_OK)
         status = get_vmo_handle(crashlog_vmo, true, nullptr,
                                 &handles[BOOTSTRAP_CRASHLOG]);
+    if (status == ZX_OK)
+        status = get_vmo_handle(counters_desc_vmo, true, nullptr,
+                                &handles[BOOTSTRAP_COUNTERS_DESC]);
+    if (status == ZX_OK)
+        status = get_vmo_handle(counters_arena_vmo, true, nullptr,
+                                &handles[BOOTSTRAP_COUNTERS_ARENA]);
     if (status == ZX_OK)
         status = get_resource_handle(&handles[BOOTSTRAP_RESOURCE_ROOT]);
 
@@ -16,7 +16,10 @@
 // hash. There is also a 4 byte 'git-' prefix, and possibly a 6 byte
 // '-dirty' suffix. Let's be generous and use 64 bytes.
 #define MAX_BUILDID_SIZE 64
-#define VDSO_CONSTANTS_SIZE (4 * 4 + 2 * 8 + MAX_BUILDID_SIZE)
+#define VDSO_CONSTANTS_SIZE (4 * 4 + 2 * 8 + 4 * 4 + MAX_BUILDID_SIZE)
+
+#define VDSO_CLOCK_DATA_ALIGN 8
+#define VDSO_CLOCK_DATA_SIZE 8
 
 #ifndef __ASSEMBLER__
 
@@ -53,6 +56,18 @@ struct vdso_constants {
     // Total amount of physical memory in the system, in bytes.
     uint64_t physmem;
 
+    // ZX_CLOCK_MONOTONIC in nanoseconds per zx_ticks_get() tick, as a 32.64
+    // fixed point number (see struct fp_32_64 in kernel/lib/fixed_point).
+    // Only valid if |clock_from_ticks| is nonzero; otherwise the tick
+    // counter doesn't drive the kernel's clock and the vDSO has to ask the
+    // kernel for the time.
+    struct {
+        uint32_t l0;
+        uint32_t l32;
+        uint32_t l64;
+    } ns_per_tick;
+    uint32_t clock_from_ticks;
+
     // A build id of the system. Currently a non-null terminated ascii
     // representation of a git SHA.
     char buildid[MAX_BUILDID_SIZE];
@@ -63,4 +78,17 @@ static_assert(VDSO_CONSTANTS_SIZE == sizeof(vdso_constants),
 static_assert(VDSO_CONSTANTS_ALIGN == alignof(vdso_constants),
               "Need to adjust VDSO_CONSTANTS_ALIGN");
 
+// Unlike vdso_constants, this struct is updated by the kernel while the
+// system runs, so the vDSO must read each member with a single atomic load.
+struct vdso_clock_data {
+    // ZX_CLOCK_UTC minus ZX_CLOCK_MONOTONIC, as last set by
+    // zx_clock_adjust().
+    int64_t utc_offset;
+};
+
+static_assert(VDSO_CLOCK_DATA_SIZE == sizeof(vdso_clock_data),
+              "Need to adjust VDSO_CLOCK_DATA_SIZE");
+static_assert(VDSO_CLOCK_DATA_ALIGN == alignof(vdso_clock_data),
+              "Need to adjust VDSO_CLOCK_DATA_ALIGN");
+
 #endif // __ASSEMBLER__
@@ -10,6 +10,7 @@
 #include <vm/vm_object.h>
 
 class VmMapping;
+struct vdso_clock_data;
 
 class VDso : public RoDso {
 public:
@@ -50,6 +51,10 @@ public:
     // Return a handle to the VMO for the given variant.
     HandleOwner vmo_handle(Variant) const;
 
+    // Publish the offset of ZX_CLOCK_UTC from ZX_CLOCK_MONOTONIC to user
+    // mode. Callers serialize updates.
+    static void SetUtcOffset(int64_t offset);
+
 private:
     VDso();
     void CreateVariant(Variant);
@@ -72,5 +77,8 @@ private:
     fbl::RefPtr<VmObjectDispatcher> variant_vmo_[
         static_cast<size_t>(Variant::COUNT) - 1];
 
+    // Each variant's vdso_clock_data, mapped into the kernel for good.
+    vdso_clock_data* clock_data_[variants()];
+
     static const VDso* instance_;
 };
@@ -10,6 +10,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/type_support.h>
 #include <kernel/cmdline.h>
+#include <lib/fixed_point.h>
 #include <object/handle.h>
 #include <platform.h>
 #include <vm/pmm.h>
@@ -117,6 +118,18 @@ private:
     KernelVmoWindow<VDsoDynSym> window_;
 };
 
+// The clock data changes for as long as the system runs, so unlike the other
+// windows this one is never unmapped.
+vdso_clock_data* MapClockData(fbl::RefPtr<VmObject> vmo) {
+    static_assert(sizeof(vdso_clock_data) == VDSO_DATA_CLOCK_SIZE,
+                  "gen-rodso-code.sh is suspect");
+    fbl::AllocChecker ac;
+    auto window = new(&ac) KernelVmoWindow<vdso_clock_data>(
+        "vDSO clock data", fbl::move(vmo), VDSO_DATA_CLOCK);
+    ASSERT(ac.check());
+    return window->data();
+}
+
 class VDsoCodeWindow {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(VDsoCodeWindow);
@@ -222,6 +235,12 @@ const VDso* VDso::Create() {
     KernelVmoWindow<vdso_constants> constants_window(
         "vDSO constants", vdso->vmo()->vmo(), VDSO_DATA_CONSTANTS);
     zx_ticks_t per_second = ticks_per_second();
+    bool soft_ticks = per_second == 0 || cmdline_get_bool("vdso.soft_ticks", false);
+
+    // Without soft ticks, the vDSO can compute the clocks from the same
+    // counter zx_ticks_get reads if that's how the kernel keeps time too.
+    struct fp_32_64 ns_per_tick = {};
+    bool clock_from_ticks = !soft_ticks && platform_get_ns_per_tick(&ns_per_tick);
 
     // Initialize the constants that should be visible to the vDSO.
     // Rather than assigning each member individually, do this with
@@ -234,12 +253,17 @@ const VDso* VDso::Create() {
         arch_icache_line_size(),
         per_second,
         pmm_count_total_bytes(),
+        {ns_per_tick.l0, ns_per_tick.l32, ns_per_tick.l64},
+        clock_from_ticks,
         BUILDID,
     };
 
+    vdso->clock_data_[static_cast<size_t>(Variant::FULL)] =
+        MapClockData(vdso->vmo()->vmo());
+
     // If ticks_per_second has not been calibrated, it will return 0. In this
     // case, use soft_ticks instead.
-    if (per_second == 0 || cmdline_get_bool("vdso.soft_ticks", false)) {
+    if (soft_ticks) {
         // Make zx_ticks_per_second return nanoseconds per second.
         constants_window.data()->ticks_per_second = ZX_SEC(1);
 
@@ -257,6 +281,14 @@ const VDso* VDso::Create() {
     return instance_;
 }
 
+void VDso::SetUtcOffset(int64_t offset) {
+    // The vDSO reads this without synchronizing with us, a single atomic store
+    // is all it needs.
+    for (vdso_clock_data* data : instance_->clock_data_) {
+        __atomic_store_n(&data->utc_offset, offset, __ATOMIC_RELAXED);
+    }
+}
+
 uintptr_t VDso::base_address(const fbl::RefPtr<VmMapping>& code_mapping) {
     return code_mapping ? code_mapping->base() - VDSO_CODE_START : 0;
 }
@@ -292,6 +324,8 @@ void VDso::CreateVariant(Variant variant) {
                                       false, &new_vmo);
     ASSERT(status == ZX_OK);
 
+    clock_data_[static_cast<size_t>(variant)] = MapClockData(new_vmo);
+
     VDsoDynSymWindow dynsym_window(new_vmo);
     VDsoCodeWindow code_window(new_vmo);
 
@@ -0,0 +1,203 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/aspace_template_dispatcher.h>
+
+#include <err.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
+#include <lib/counters.h>
+#include <vm/vm.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_object.h>
+
+KCOUNTER(dispatcher_aspace_template_create_count, "dispatcher.aspace_template.create");
+KCOUNTER(dispatcher_aspace_template_destroy_count, "dispatcher.aspace_template.destroy");
+
+namespace {
+
+constexpr uint32_t kPermOptions = ZX_VM_PERM_READ | ZX_VM_PERM_WRITE | ZX_VM_PERM_EXECUTE;
+constexpr uint32_t kCanMapOptions =
+    ZX_VM_CAN_MAP_READ | ZX_VM_CAN_MAP_WRITE | ZX_VM_CAN_MAP_EXECUTE;
+
+// The ZX_VM_CAN_MAP_* flags a handle with |rights| allows.
+uint32_t rights_to_can_map(zx_rights_t rights) {
+    uint32_t can_map = 0u;
+    if (rights & ZX_RIGHT_READ)
+        can_map |= ZX_VM_CAN_MAP_READ;
+    if (rights & ZX_RIGHT_WRITE)
+        can_map |= ZX_VM_CAN_MAP_WRITE;
+    if (rights & ZX_RIGHT_EXECUTE)
+        can_map |= ZX_VM_CAN_MAP_EXECUTE;
+    return can_map;
+}
+
+// The ZX_VM_CAN_MAP_* flags a mapping with |perms| needs.
+uint32_t perms_to_can_map(uint32_t perms) {
+    uint32_t can_map = 0u;
+    if (perms & ZX_VM_PERM_READ)
+        can_map |= ZX_VM_CAN_MAP_READ;
+    if (perms & ZX_VM_PERM_WRITE)
+        can_map |= ZX_VM_CAN_MAP_WRITE;
+    if (perms & ZX_VM_PERM_EXECUTE)
+        can_map |= ZX_VM_CAN_MAP_EXECUTE;
+    return can_map;
+}
+
+} // namespace
+
+zx_status_t AspaceTemplateDispatcher::Create(uint32_t options,
+                                             fbl::RefPtr<Dispatcher>* dispatcher,
+                                             zx_rights_t* rights) {
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) AspaceTemplateDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    kcounter_add(dispatcher_aspace_template_create_count, 1);
+
+    *rights = default_rights();
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+AspaceTemplateDispatcher::~AspaceTemplateDispatcher() {
+    kcounter_add(dispatcher_aspace_template_destroy_count, 1);
+}
+
+zx_status_t AspaceTemplateDispatcher::AddEntry(fbl::RefPtr<VmObject> vmo, zx_rights_t vmo_rights,
+                                               uint32_t options, uint64_t offset,
+                                               uint64_t vmo_offset, uint64_t len) {
+    canary_.Assert();
+
+    if (options & ~(kPermOptions | ZX_VM_MAP_RANGE | ZX_ASPACE_TEMPLATE_COW))
+        return ZX_ERR_INVALID_ARGS;
+    if (!VmAddressRegionDispatcher::is_valid_mapping_protection(options & kPermOptions))
+        return ZX_ERR_INVALID_ARGS;
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(vmo_offset) || len == 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    uint64_t end;
+    len = ROUNDUP(len, PAGE_SIZE);
+    if (len == 0 || add_overflow(offset, len, &end))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    if (!(vmo_rights & ZX_RIGHT_MAP))
+        return ZX_ERR_ACCESS_DENIED;
+
+    // A copy-on-write entry maps a fresh clone each time, as if by
+    // zx_vmo_clone(), which may always be written.
+    const bool cow = options & ZX_ASPACE_TEMPLATE_COW;
+    uint32_t can_map = rights_to_can_map(vmo_rights);
+    if (cow) {
+        if ((vmo_rights & (ZX_RIGHT_READ | ZX_RIGHT_DUPLICATE)) !=
+            (ZX_RIGHT_READ | ZX_RIGHT_DUPLICATE))
+            return ZX_ERR_ACCESS_DENIED;
+        can_map |= ZX_VM_CAN_MAP_WRITE;
+    }
+
+    const uint32_t perms = options & kPermOptions;
+    if (perms_to_can_map(perms) & ~can_map)
+        return ZX_ERR_ACCESS_DENIED;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+
+    if (entries_.size() >= kMaxEntries)
+        return ZX_ERR_NO_RESOURCES;
+    for (const auto& entry : entries_) {
+        if (offset < entry.offset + entry.len && entry.offset < end)
+            return ZX_ERR_ALREADY_EXISTS;
+    }
+
+    fbl::AllocChecker ac;
+    entries_.push_back(Entry{fbl::move(vmo), vmo_offset, len, offset,
+                             options & (kPermOptions | ZX_VM_MAP_RANGE), can_map, cow},
+                       &ac);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    if (end > size_)
+        size_ = end;
+    can_map_ |= can_map;
+    return ZX_OK;
+}
+
+zx_status_t AspaceTemplateDispatcher::Apply(VmAddressRegionDispatcher* vmar,
+                                            zx_rights_t vmar_rights, uint32_t options,
+                                            uint64_t offset,
+                                            fbl::RefPtr<VmAddressRegionDispatcher>* child,
+                                            zx_rights_t* child_rights) {
+    canary_.Assert();
+
+    if (options & ~(ZX_VM_SPECIFIC | ZX_VM_COMPACT | kCanMapOptions))
+        return ZX_ERR_INVALID_ARGS;
+
+    // What the caller asks of the child VMAR, and what the entries' own
+    // protections need, must be allowed by the VMAR handle.
+    const uint32_t grantable = rights_to_can_map(vmar_rights);
+    if (options & kCanMapOptions & ~grantable)
+        return ZX_ERR_ACCESS_DENIED;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+
+    if (entries_.is_empty())
+        return ZX_ERR_BAD_STATE;
+    for (const auto& entry : entries_) {
+        if (perms_to_can_map(entry.map_options & kPermOptions) & ~grantable)
+            return ZX_ERR_ACCESS_DENIED;
+    }
+
+    // The child may carry whatever an entry could be mapped with, so that
+    // the mappings keep the room to change protections zx_vmar_map() would
+    // have given them.
+    const uint32_t child_can_map = (options | can_map_) & grantable;
+    fbl::RefPtr<VmAddressRegionDispatcher> region;
+    zx_status_t status = vmar->Allocate(offset, size_,
+                                        (options & ~kCanMapOptions) | child_can_map |
+                                            ZX_VM_CAN_MAP_SPECIFIC,
+                                        &region, child_rights);
+    if (status != ZX_OK)
+        return status;
+
+    auto cleanup = fbl::MakeAutoCall([&region]() {
+        region->Destroy();
+    });
+
+    for (const auto& entry : entries_) {
+        fbl::RefPtr<VmObject> vmo = entry.vmo;
+        uint64_t vmo_offset = entry.vmo_offset;
+        if (entry.cow) {
+            fbl::RefPtr<VmObject> clone;
+            status = vmo->CloneCOW(false, vmo_offset, entry.len, true, &clone);
+            if (status != ZX_OK)
+                return status;
+            vmo = fbl::move(clone);
+            vmo_offset = 0u;
+        }
+
+        const uint32_t map_options = entry.map_options & ~ZX_VM_MAP_RANGE;
+        fbl::RefPtr<VmMapping> mapping;
+        status = region->Map(entry.offset, fbl::move(vmo), vmo_offset, entry.len,
+                             map_options | ZX_VM_SPECIFIC | (entry.can_map & child_can_map),
+                             &mapping);
+        if (status != ZX_OK)
+            return status;
+
+        if (entry.map_options & ZX_VM_MAP_RANGE) {
+            status = mapping->MapRange(0, entry.len, false);
+            if (status != ZX_OK)
+                return status;
+        }
+    }
+
+    cleanup.cancel();
+    *child = fbl::move(region);
+    return ZX_OK;
+}
@@ -8,11 +8,15 @@
 
 #include <dev/iommu.h>
 #include <err.h>
+#include <lib/counters.h>
 #include <vm/pinned_vm_object.h>
 #include <vm/vm_object.h>
 #include <zircon/rights.h>
 #include <zxcpp/new.h>
 
+KCOUNTER(dispatcher_bti_pin_cache_hit, "dispatcher.bti.pin_cache.hit");
+KCOUNTER(dispatcher_bti_pin_cache_evict, "dispatcher.bti.pin_cache.evict");
+
 zx_status_t BusTransactionInitiatorDispatcher::Create(fbl::RefPtr<Iommu> iommu, uint64_t bti_id,
                                                       fbl::RefPtr<Dispatcher>* dispatcher,
                                                       zx_rights_t* rights) {
@@ -41,7 +45,7 @@ BusTransactionInitiatorDispatcher::~BusTransactionInitiatorDispatcher() {
 }
 
 zx_status_t BusTransactionInitiatorDispatcher::Pin(fbl::RefPtr<VmObject> vmo, uint64_t offset,
-                                                   uint64_t size, uint32_t perms,
+                                                   uint64_t size, uint32_t perms, bool cache,
                                                    fbl::RefPtr<Dispatcher>* pmt,
                                                    zx_rights_t* pmt_rights) {
 
@@ -52,6 +56,30 @@ zx_status_t BusTransactionInitiatorDispatcher::Pin(fbl::RefPtr<VmObject> vmo, ui
         return ZX_ERR_INVALID_ARGS;
     }
 
+    if (cache) {
+        // Declared before the guard so that it is released after the lock is
+        // dropped; its destructor calls RemovePmo().
+        fbl::RefPtr<PinnedMemoryTokenDispatcher> cached;
+
+        Guard<fbl::Mutex> guard{get_lock()};
+        if (zero_handles_) {
+            return ZX_ERR_BAD_STATE;
+        }
+
+        for (auto& c : cache_) {
+            if (c.MatchesCached(vmo.get(), offset, size, perms)) {
+                cached = cache_.erase(c);
+                cache_count_--;
+                break;
+            }
+        }
+        if (cached) {
+            kcounter_add(dispatcher_bti_pin_cache_hit, 1);
+            return PinnedMemoryTokenDispatcher::CreateFromCached(fbl::WrapRefPtr(this),
+                                                                 cached.get(), pmt, pmt_rights);
+        }
+    }
+
     PinnedVmObject pinned_vmo;
     zx_status_t status = PinnedVmObject::Create(vmo, offset, size, &pinned_vmo);
     if (status != ZX_OK) {
@@ -64,26 +92,36 @@ zx_status_t BusTransactionInitiatorDispatcher::Pin(fbl::RefPtr<VmObject> vmo, ui
     }
 
     return PinnedMemoryTokenDispatcher::Create(fbl::WrapRefPtr(this), fbl::move(pinned_vmo),
-                                               perms, pmt, pmt_rights);
+                                               perms, cache, pmt, pmt_rights);
 }
 
 void BusTransactionInitiatorDispatcher::ReleaseQuarantine() {
     QuarantineList tmp;
+    QuarantineList cached;
 
     // The PMT dtor will call RemovePmo, which will reacquire this BTI's lock.
     // To avoid deadlock, drop the lock before letting the quarantined PMTs go.
     {
         Guard<fbl::Mutex> guard{get_lock()};
         quarantine_.swap(tmp);
+        cache_.swap(cached);
+        cache_count_ = 0;
     }
 }
 
 void BusTransactionInitiatorDispatcher::on_zero_handles() {
+    // Cached PMTs hold a reference to the BTI, so they have to go now.  As in
+    // ReleaseQuarantine(), they are released after the lock is dropped.
+    QuarantineList cached;
+
     Guard<fbl::Mutex> guard{get_lock()};
     // Prevent new pinning from happening.  The Dispatcher will stick around
     // until all of the PMTs are closed.
     zero_handles_ = true;
 
+    cache_.swap(cached);
+    cache_count_ = 0;
+
     // Do not clear out the quarantine list.  PMTs hold a reference to the BTI
     // and the BTI holds a reference to each quarantined PMT.  We intentionally
     // leak the BTI, all quarantined PMTs, and their underlying VMOs.  We could
@@ -119,6 +157,26 @@ void BusTransactionInitiatorDispatcher::Quarantine(fbl::RefPtr<PinnedMemoryToken
     }
 }
 
+bool BusTransactionInitiatorDispatcher::CacheUnpinned(fbl::RefPtr<PinnedMemoryTokenDispatcher> pmt) {
+    // Released after the lock is dropped, see Pin().
+    fbl::RefPtr<PinnedMemoryTokenDispatcher> evicted;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (zero_handles_) {
+        return false;
+    }
+
+    DEBUG_ASSERT(pmt->dll_pmt_.InContainer());
+    if (cache_count_ == kMaxCachedPmts) {
+        evicted = cache_.pop_front();
+        kcounter_add(dispatcher_bti_pin_cache_evict, 1);
+    } else {
+        cache_count_++;
+    }
+    cache_.push_back(fbl::move(pmt));
+    return true;
+}
+
 void BusTransactionInitiatorDispatcher::PrintQuarantineWarningLocked() {
     uint64_t leaked_pages = 0;
     size_t num_entries = 0;
@@ -13,7 +13,9 @@
 #include <trace.h>
 
 #include <lib/counters.h>
+#include <lib/object_cache.h>
 #include <kernel/event.h>
+#include <kernel/thread.h>
 #include <platform.h>
 #include <object/handle.h>
 #include <object/message_packet.h>
@@ -35,6 +37,23 @@ KCOUNTER(channel_packet_depth_64, "kernel.channel.depth.64");
 KCOUNTER(channel_packet_depth_256, "kernel.channel.depth.256");
 KCOUNTER(channel_packet_depth_unbounded, "kernel.channel.depth.unbounded");
 
+OBJECT_CACHE(channel_cache, "channel", ChannelDispatcher, 0u);
+
+// static
+void* ChannelDispatcher::operator new(size_t size, fbl::AllocChecker* ac) noexcept {
+    DEBUG_ASSERT(size == sizeof(ChannelDispatcher));
+    void* mem = channel_cache.Alloc();
+    ac->arm(size, mem != nullptr);
+    return mem;
+}
+
+// static
+void ChannelDispatcher::operator delete(void* ptr) {
+    if (ptr != nullptr) {
+        channel_cache.Free(ptr);
+    }
+}
+
 // static
 //创建 Channel
 zx_status_t ChannelDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher0,
@@ -206,20 +225,26 @@ zx_status_t ChannelDispatcher::Read(zx_koid_t owner,
 zx_status_t ChannelDispatcher::Write(zx_koid_t owner, fbl::unique_ptr<MessagePacket> msg) {
     canary_.Assert();
 
-    AutoReschedDisable resched_disable; // Must come before the lock guard.
-    resched_disable.Disable();
-    Guard<fbl::Mutex> guard{get_lock()};
+    {
+        AutoReschedDisable resched_disable; // Must come before the lock guard.
+        resched_disable.Disable();
+        Guard<fbl::Mutex> guard{get_lock()};
 
-    // Faling this test is only possible if this process has two threads racing:
-    // one thread is issuing channel_write() and one thread is moving the handle
-    // to another process.
-    if (owner != owner_)
-        return ZX_ERR_BAD_HANDLE;
+        // Faling this test is only possible if this process has two threads racing:
+        // one thread is issuing channel_write() and one thread is moving the handle
+        // to another process.
+        if (owner != owner_)
+            return ZX_ERR_BAD_HANDLE;
+
+        if (!peer_)
+            return ZX_ERR_PEER_CLOSED;
 
-    if (!peer_)
-        return ZX_ERR_PEER_CLOSED;
+        peer_->WriteSelf(fbl::move(msg));
+    }
 
-    peer_->WriteSelf(fbl::move(msg));
+    // If that was the reply to a call, let the caller run on this cpu now
+    // rather than waiting for another one to pick it up.
+    thread_handoff_complete();
 
     return ZX_OK;
 }
@@ -274,8 +299,11 @@ alloc_txid:
         // waiter to the list.
         waiters_.push_back(waiter);
 
-        // (1) Write outbound message to opposing endpoint.
+        // (1) Write outbound message to opposing endpoint. We are about to
+        // block for the reply, so whoever the message wakes can have this cpu.
+        thread_handoff_arm();
         peer_->WriteSelf(fbl::move(msg));
+        thread_handoff_disarm();
     }
 
     // Reuse the code from the half-call used for retrying a Call after thread
@@ -294,6 +322,9 @@ zx_status_t ChannelDispatcher::ResumeInterruptedCall(MessageWaiter* waiter,
         ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::CHANNEL);
 
         zx_status_t status = waiter->Wait(deadline);
+        // the reply can beat us to the wait, leaving the thread we handed
+        // this cpu to queued behind us
+        thread_handoff_complete();
         if (status == ZX_ERR_INTERNAL_INTR_RETRY) {
             // If we got interrupted, return out to usermode, but
             // do not clear the waiter.
@@ -339,7 +370,11 @@ void ChannelDispatcher::WriteSelf(fbl::unique_ptr<MessagePacket> msg) {
             // Remove waiter from list.
             if (waiter.get_txid() == txid) {
                 waiters_.erase(waiter);
+                // the caller is blocked on exactly this message, so run it
+                // here next; see Write()
+                thread_handoff_arm();
                 waiter.Deliver(fbl::move(msg));
+                thread_handoff_disarm();
                 return;
             }
         }
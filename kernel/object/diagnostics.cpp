@@ -86,6 +86,9 @@ static const char* ObjectTypeToString(zx_obj_type_t type) {
         case ZX_OBJ_TYPE_PROFILE: return "profile";
         case ZX_OBJ_TYPE_PMT: return "pmt";
         case ZX_OBJ_TYPE_SUSPEND_TOKEN: return "suspend-token";
+        case ZX_OBJ_TYPE_PAGER: return "pager";
+        case ZX_OBJ_TYPE_WAITSET: return "waitset";
+        case ZX_OBJ_TYPE_ASPACE_TEMPLATE: return "aspace-template";
         default: return "???";
     }
 }
@@ -137,7 +140,8 @@ static void FormatHandleTypeCount(const ProcessDispatcher& pd,
              types[ZX_OBJ_TYPE_GUEST] + types[ZX_OBJ_TYPE_VCPU] +
              types[ZX_OBJ_TYPE_IOMMU] + types[ZX_OBJ_TYPE_BTI] +
              types[ZX_OBJ_TYPE_PROFILE] + types[ZX_OBJ_TYPE_PMT] +
-             types[ZX_OBJ_TYPE_SUSPEND_TOKEN]
+             types[ZX_OBJ_TYPE_SUSPEND_TOKEN] + types[ZX_OBJ_TYPE_PAGER] +
+             types[ZX_OBJ_TYPE_WAITSET] + types[ZX_OBJ_TYPE_ASPACE_TEMPLATE]
              );
 }
 
@@ -9,6 +9,7 @@
 #include <inttypes.h>
 
 #include <arch/ops.h>
+#include <kernel/thread.h>
 #include <lib/ktrace.h>
 #include <lib/counters.h>
 #include <fbl/atomic.h>
@@ -26,6 +27,8 @@ KCOUNTER(dispatcher_observe_count, "kernel.dispatcher.observer.add");
 // counts the number of times observers have been canceled.
 KCOUNTER(dispatcher_cancel_bh_count, "kernel.dispatcher.observer.cancel.byhandle");
 KCOUNTER(dispatcher_cancel_bk_count, "kernel.dispatcher.observer.cancel.bykey");
+// counts the number of signal changes no observer was interested in.
+KCOUNTER(dispatcher_update_skip_count, "kernel.dispatcher.observer.update.skipped");
 // counts the number of cookies set or changed (reset).
 KCOUNTER(dispatcher_cookie_set_count, "kernel.dispatcher.cookie.set");
 KCOUNTER(dispatcher_cookie_reset_count, "kernel.dispatcher.cookie.reset");
@@ -151,8 +154,10 @@ void Dispatcher::AddObserverHelper(StateObserver* observer,
         Guard<LockType> guard{lock};
 
         flags = observer->OnInitialize(signals_, cinfo);
-        if (!(flags & StateObserver::kNeedRemoval))
+        if (!(flags & StateObserver::kNeedRemoval)) {
             observers_.push_front(observer);
+            observer_interest_ |= observer->interest();
+        }
     }
     if (flags & StateObserver::kNeedRemoval)
         observer->OnRemoved();
@@ -172,12 +177,13 @@ void Dispatcher::AddObserverLocked(StateObserver* observer, const StateObserver:
     AddObserverHelper(observer, cinfo, &lock);
 }
 
-void Dispatcher::RemoveObserver(StateObserver* observer) {
+zx_signals_t Dispatcher::RemoveObserver(StateObserver* observer) {
     ZX_DEBUG_ASSERT(is_waitable());
 
     Guard<fbl::Mutex> guard{get_lock()};
     DEBUG_ASSERT(observer != nullptr);
     observers_.erase(*observer);
+    return signals_;
 }
 
 void Dispatcher::Cancel(const Handle* handle) {
@@ -222,7 +228,7 @@ void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
         if (previous_signals == signals_)
             return;
 
-        UpdateInternalLocked(&obs_to_remove, signals_);
+        UpdateInternalLocked(&obs_to_remove, previous_signals, signals_);
     }
 
     while (!obs_to_remove.is_empty()) {
@@ -232,6 +238,11 @@ void Dispatcher::UpdateStateHelper(zx_signals_t clear_mask,
 
 void Dispatcher::UpdateState(zx_signals_t clear_mask,
                              zx_signals_t set_mask) {
+    // Observers wake their waiters while we hold the lock, and the waiters
+    // usually want the lock right back (to remove their observer, say).
+    // Defer the reschedule until the lock is dropped so they don't preempt
+    // us only to block on it.
+    AutoReschedDisable resched_disable; // Must come before the lock guard.
     UpdateStateHelper(clear_mask, set_mask, get_lock());
 }
 
@@ -243,19 +254,34 @@ void Dispatcher::UpdateStateLocked(zx_signals_t clear_mask,
     UpdateStateHelper(clear_mask, set_mask, &lock);
 }
 
-void Dispatcher::UpdateInternalLocked(ObserverList* obs_to_remove, zx_signals_t signals) {
+void Dispatcher::UpdateInternalLocked(ObserverList* obs_to_remove,
+                                      zx_signals_t previous_signals, zx_signals_t signals) {
     ZX_DEBUG_ASSERT(is_waitable());
 
+    const zx_signals_t changed = previous_signals ^ signals;
+    if (!(changed & observer_interest_)) {
+        kcounter_add(dispatcher_update_skip_count, 1);
+        return;
+    }
+
+    zx_signals_t interest = 0u;
     for (auto it = observers_.begin(); it != observers_.end();) {
+        if (!(it->interest() & changed)) {
+            interest |= it->interest();
+            ++it;
+            continue;
+        }
         StateObserver::Flags it_flags = it->OnStateChange(signals);
         if (it_flags & StateObserver::kNeedRemoval) {
             auto to_remove = it;
             ++it;
             obs_to_remove->push_back(observers_.erase(to_remove));
         } else {
+            interest |= it->interest();
             ++it;
         }
     }
+    observer_interest_ = interest;
 }
 
 zx_status_t Dispatcher::SetCookie(CookieJar* cookiejar, zx_koid_t scope, uint64_t cookie) {
@@ -5,13 +5,19 @@
 // https://opensource.org/licenses/MIT
 
 #include <arch.h>
+#include <arch/debugger.h>
 #include <arch/exception.h>
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <trace.h>
 
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lib/user_copy/user_ptr.h>
+
 #include <object/excp_port.h>
 #include <object/job_dispatcher.h>
 #include <object/process_dispatcher.h>
@@ -20,6 +26,8 @@
 #define LOCAL_TRACE 0
 #define TRACE_EXCEPTIONS 1
 
+KCOUNTER(exceptions_in_process, "kernel.exceptions.in_process");
+
 static const char* excp_type_to_string(uint type) {
     switch (type) {
     case ZX_EXCP_FATAL_PAGE_FAULT:
@@ -201,6 +209,75 @@ static handler_status_t exception_handler_worker(uint exception_type,
     return HS_NOT_HANDLED;
 }
 
+#if ARCH_X86
+// The SysV x86-64 ABI lets leaf code use this much below %rsp.
+static constexpr uintptr_t kRedZoneSize = 128;
+static constexpr uint64_t kFlagsDirection = 1u << 10;
+#endif
+
+// Redirects the current thread to its process's in-process exception
+// handler, as described for zx_exception_handler_t. Returns false if the
+// exception should go to the exception ports instead.
+static bool try_in_process_handler(uint exception_type,
+                                   const arch_exception_context_t* context,
+                                   ThreadDispatcher* thread) {
+    if (!ZX_EXCP_IS_ARCH(exception_type))
+        return false;
+
+    auto process = thread->process();
+    zx_exception_handler_t handler = process->get_exception_handler();
+    if (handler.entry == 0u || !(handler.type_mask & ZX_EXCP_HANDLER_TYPE(exception_type)))
+        return false;
+
+    // A debugger sees every exception first, so it keeps using the ports.
+    if (process->debugger_exception_port())
+        return false;
+
+    zx_exception_frame_t frame;
+    thread_t* current = get_current_thread();
+    if (arch_get_general_regs(current, &frame.regs) != ZX_OK)
+        return false;
+    ExceptionPort::BuildArchReport(&frame.report, exception_type, context);
+
+    zx_thread_state_general_regs_t regs = frame.regs;
+#if ARCH_X86
+    uintptr_t frame_addr = ROUNDDOWN(regs.rsp - kRedZoneSize - sizeof(frame), 16);
+    // Enter as if called: %rsp + 8 is 16-byte aligned at function entry.
+    uintptr_t sp = frame_addr - sizeof(uint64_t);
+    regs.rsp = sp;
+    regs.rdi = frame_addr;
+    regs.rip = handler.entry;
+    regs.rflags &= ~kFlagsDirection;
+#elif ARCH_ARM64
+    uintptr_t frame_addr = ROUNDDOWN(regs.sp - sizeof(frame), 16);
+    uintptr_t sp = frame_addr;
+    regs.sp = sp;
+    regs.r[0] = frame_addr;
+    regs.lr = 0;
+    regs.pc = handler.entry;
+#else
+    return false;
+#endif
+
+    if (!is_user_address_range(sp, frame_addr + sizeof(frame) - sp))
+        return false;
+    if (make_user_out_ptr(reinterpret_cast<zx_exception_frame_t*>(frame_addr))
+            .copy_to_user(frame) != ZX_OK)
+        return false;
+#if ARCH_X86
+    // The zero return address.
+    const uint64_t return_address = 0u;
+    if (make_user_out_ptr(reinterpret_cast<uint64_t*>(sp)).copy_to_user(return_address) != ZX_OK)
+        return false;
+#endif
+
+    if (arch_set_general_regs(current, &regs) != ZX_OK)
+        return false;
+
+    kcounter_add(exceptions_in_process, 1);
+    return true;
+}
+
 // Dispatches an exception to the appropriate handler. Called by arch code
 // when it cannot handle an exception.
 //
@@ -225,6 +302,11 @@ zx_status_t dispatch_user_exception(uint exception_type,
         return ZX_ERR_BAD_STATE;
     }
 
+    // The in-process handler runs on this thread, so there is nothing to
+    // block on; just resume at the handler.
+    if (try_in_process_handler(exception_type, context, thread))
+        return ZX_OK;
+
     // From now until the exception is resolved the thread is in an exception.
     ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::EXCEPTION);
 
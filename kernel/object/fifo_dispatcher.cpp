@@ -12,6 +12,51 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <object/handle.h>
+#include <vm/physmap.h>
+#include <vm/vm_object_paged.h>
+
+static_assert(ZX_FIFO_RING_DATA_OFFSET == PAGE_SIZE, "");
+
+constexpr uint64_t FifoDispatcher::kRingSize;
+
+// static
+zx_status_t FifoDispatcher::CreateRing(uint32_t count, uint32_t elemsize,
+                                       fbl::RefPtr<VmObject>* vmo,
+                                       volatile zx_fifo_ring_header_t** header,
+                                       uint8_t** entries) {
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, kRingSize, vmo);
+    if (status != ZX_OK)
+        return status;
+
+    uint64_t committed;
+    status = (*vmo)->CommitRange(0, kRingSize, &committed);
+    if (status != ZX_OK)
+        return status;
+    if (committed != kRingSize)
+        return ZX_ERR_NO_MEMORY;
+
+    // the kernel keeps using these pages directly, so they must stay put
+    status = (*vmo)->Pin(0, kRingSize);
+    if (status != ZX_OK)
+        return status;
+
+    paddr_t pages[kRingSize / PAGE_SIZE];
+    auto lookup_fn = [](void* ctx, size_t offset, size_t index, paddr_t pa) {
+        static_cast<paddr_t*>(ctx)[index] = pa;
+        return ZX_OK;
+    };
+    status = (*vmo)->Lookup(0, kRingSize, 0, lookup_fn, pages);
+    if (status != ZX_OK) {
+        (*vmo)->Unpin(0, kRingSize);
+        return status;
+    }
+
+    *header = static_cast<volatile zx_fifo_ring_header_t*>(paddr_to_physmap(pages[0]));
+    *entries = static_cast<uint8_t*>(paddr_to_physmap(pages[1]));
+    (*header)->elem_count = count;
+    (*header)->elem_size = elemsize;
+    return ZX_OK;
+}
 
 // static
 zx_status_t FifoDispatcher::Create(size_t count, size_t elemsize, uint32_t options,
@@ -27,29 +72,48 @@ zx_status_t FifoDispatcher::Create(size_t count, size_t elemsize, uint32_t optio
         return ZX_ERR_OUT_OF_RANGE;
     }
 
+    if (options & ~ZX_FIFO_SHARED)
+        return ZX_ERR_INVALID_ARGS;
+
     fbl::AllocChecker ac;
     auto holder0 = fbl::AdoptRef(new (&ac) PeerHolder<FifoDispatcher>());
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
     auto holder1 = holder0;
 
-    auto data0 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
-
-    auto fifo0 = fbl::AdoptRef(new (&ac) FifoDispatcher(fbl::move(holder0), options, static_cast<uint32_t>(count),
-                                                        static_cast<uint32_t>(elemsize), fbl::move(data0)));
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
-
-    auto data1 = fbl::unique_ptr<uint8_t[]>(new (&ac) uint8_t[count * elemsize]);
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
+    fbl::RefPtr<FifoDispatcher> fifo[2];
+    fbl::RefPtr<PeerHolder<FifoDispatcher>> holders[2] = {fbl::move(holder0), fbl::move(holder1)};
+    for (auto i = 0; i < 2; ++i) {
+        fbl::unique_ptr<uint8_t[]> data;
+        fbl::RefPtr<VmObject> ring;
+        volatile zx_fifo_ring_header_t* ring_header = nullptr;
+        uint8_t* ring_entries = nullptr;
+
+        if (options & ZX_FIFO_SHARED) {
+            zx_status_t status = CreateRing(static_cast<uint32_t>(count),
+                                            static_cast<uint32_t>(elemsize), &ring,
+                                            &ring_header, &ring_entries);
+            if (status != ZX_OK)
+                return status;
+        } else {
+            data.reset(new (&ac) uint8_t[count * elemsize]);
+            if (!ac.check())
+                return ZX_ERR_NO_MEMORY;
+        }
 
-    auto fifo1 = fbl::AdoptRef(new (&ac) FifoDispatcher(fbl::move(holder1), options, static_cast<uint32_t>(count),
-                                                        static_cast<uint32_t>(elemsize), fbl::move(data1)));
-    if (!ac.check())
-        return ZX_ERR_NO_MEMORY;
+        fifo[i] = fbl::AdoptRef(new (&ac) FifoDispatcher(fbl::move(holders[i]), options,
+                                                         static_cast<uint32_t>(count),
+                                                         static_cast<uint32_t>(elemsize),
+                                                         fbl::move(data), ring, ring_header,
+                                                         ring_entries));
+        if (!ac.check()) {
+            if (ring)
+                ring->Unpin(0, kRingSize);
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+    auto& fifo0 = fifo[0];
+    auto& fifo1 = fifo[1];
 
     fifo0->Init(fifo1);
     fifo1->Init(fifo0);
@@ -62,13 +126,18 @@ zx_status_t FifoDispatcher::Create(size_t count, size_t elemsize, uint32_t optio
 
 FifoDispatcher::FifoDispatcher(fbl::RefPtr<PeerHolder<FifoDispatcher>> holder,
                                uint32_t /*options*/, uint32_t count, uint32_t elem_size,
-                               fbl::unique_ptr<uint8_t[]> data)
+                               fbl::unique_ptr<uint8_t[]> data, fbl::RefPtr<VmObject> ring,
+                               volatile zx_fifo_ring_header_t* ring_header,
+                               uint8_t* ring_entries)
     : PeeredDispatcher(fbl::move(holder), ZX_FIFO_WRITABLE),
       elem_count_(count), elem_size_(elem_size), mask_(count - 1),
-      head_(0u), tail_(0u), data_(fbl::move(data)) {
+      head_(0u), tail_(0u), data_(fbl::move(data)), ring_(fbl::move(ring)),
+      ring_header_(ring_header), entries_(ring_ ? ring_entries : data_.get()) {
 }
 
 FifoDispatcher::~FifoDispatcher() {
+    if (ring_)
+        ring_->Unpin(0, kRingSize);
 }
 
 // Thread safety analysis disabled as this happens during creation only,
@@ -112,13 +181,20 @@ zx_status_t FifoDispatcher::WriteSelfLocked(size_t elem_size, user_in_ptr<const
 
     if (elem_size != elem_size_)
         return ZX_ERR_OUT_OF_RANGE;
-    if (count == 0)
-        return ZX_ERR_OUT_OF_RANGE;
+    if (count == 0) {
+        if (!ring_)
+            return ZX_ERR_OUT_OF_RANGE;
+        // the writer moved the head itself and wants the reader woken
+        SyncRingLocked();
+        *actual = 0;
+        return ZX_OK;
+    }
 
-    uint32_t old_head = head_;
+    const uint32_t old_head = head();
+    uint32_t head = old_head;
 
     // total number of available empty slots in the fifo
-    size_t avail = elem_count_ - (head_ - tail_);
+    size_t avail = elem_count_ - used();
 
     if (avail == 0)
         return ZX_ERR_SHOULD_WAIT;
@@ -129,7 +205,7 @@ zx_status_t FifoDispatcher::WriteSelfLocked(size_t elem_size, user_in_ptr<const
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (head_ & mask_);
+        uint32_t offset = (head & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -137,30 +213,35 @@ zx_status_t FifoDispatcher::WriteSelfLocked(size_t elem_size, user_in_ptr<const
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
-        zx_status_t status = ptr.copy_array_from_user(&data_[offset * elem_size_],
+        // nothing is published until every copy has succeeded, so there is
+        // nothing to roll back
+        zx_status_t status = ptr.copy_array_from_user(&entries_[offset * elem_size_],
                                                       to_copy * elem_size_);
-        if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            head_ = old_head;
+        if (status != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
-        }
 
         // adjust head and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        head_ += static_cast<uint32_t>(to_copy);
+        head += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
+    set_head(head);
+
+    if (ring_) {
+        // the reader may have moved the tail meanwhile
+        SyncRingLocked();
+    } else {
+        // if was empty, we've become readable
+        if (was_empty)
+            UpdateStateLocked(0u, ZX_FIFO_READABLE);
+
+        // if now full, we're no longer writable
+        if (elem_count_ == (head_ - tail_))
+            peer_->UpdateStateLocked(ZX_FIFO_WRITABLE, 0u);
+    }
 
-    // if was empty, we've become readable
-    if (was_empty)
-        UpdateStateLocked(0u, ZX_FIFO_READABLE);
-
-    // if now full, we're no longer writable
-    if (elem_count_ == (head_ - tail_))
-        peer_->UpdateStateLocked(ZX_FIFO_WRITABLE, 0u);
-
-    *actual = (head_ - old_head);
+    *actual = (head - old_head);
     return ZX_OK;
 }
 
@@ -171,15 +252,23 @@ zx_status_t FifoDispatcher::ReadToUser(size_t elem_size, user_out_ptr<uint8_t> p
 
     if (elem_size != elem_size_)
         return ZX_ERR_OUT_OF_RANGE;
-    if (count == 0)
+    if (count == 0 && !ring_)
         return ZX_ERR_OUT_OF_RANGE;
 
     Guard<fbl::Mutex> guard{get_lock()};
 
-    uint32_t old_tail = tail_;
+    if (count == 0) {
+        // the reader moved the tail itself and wants the writer woken
+        SyncRingLocked();
+        *actual = 0;
+        return ZX_OK;
+    }
+
+    const uint32_t old_tail = tail();
+    uint32_t tail = old_tail;
 
     // total number of available entries to read from the fifo
-    size_t avail = (head_ - tail_);
+    size_t avail = used();
 
     if (avail == 0)
         return peer_ ? ZX_ERR_SHOULD_WAIT : ZX_ERR_PEER_CLOSED;
@@ -190,7 +279,7 @@ zx_status_t FifoDispatcher::ReadToUser(size_t elem_size, user_out_ptr<uint8_t> p
         count = avail;
 
     while (count > 0) {
-        uint32_t offset = (tail_ & mask_);
+        uint32_t offset = (tail & mask_);
 
         // number of slots from target to end, inclusive
         uint32_t n = elem_count_ - offset;
@@ -198,29 +287,74 @@ zx_status_t FifoDispatcher::ReadToUser(size_t elem_size, user_out_ptr<uint8_t> p
         // number of slots we can actually copy
         size_t to_copy = (count > n) ? n : count;
 
-        zx_status_t status = ptr.copy_array_to_user(&data_[offset * elem_size_],
+        // as in WriteSelfLocked(), the tail only moves once all copies are done
+        zx_status_t status = ptr.copy_array_to_user(&entries_[offset * elem_size_],
                                                     to_copy * elem_size_);
-        if (status != ZX_OK) {
-            // roll back, in case this is the second copy
-            tail_ = old_tail;
+        if (status != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
-        }
 
         // adjust tail and count
         // due to size limitations on fifo, to_copy will always fit in a u32
-        tail_ += static_cast<uint32_t>(to_copy);
+        tail += static_cast<uint32_t>(to_copy);
         count -= to_copy;
         ptr = ptr.byte_offset(to_copy * elem_size_);
     }
+    set_tail(tail);
+
+    if (ring_) {
+        SyncRingLocked();
+    } else {
+        // if we were full, we have become writable
+        if (was_full && peer_)
+            peer_->UpdateStateLocked(0u, ZX_FIFO_WRITABLE);
+
+        // if we've become empty, we're no longer readable
+        if ((head_ - tail_) == 0)
+            UpdateStateLocked(ZX_FIFO_READABLE, 0u);
+    }
 
-    // if we were full, we have become writable
-    if (was_full && peer_)
-        peer_->UpdateStateLocked(0u, ZX_FIFO_WRITABLE);
+    *actual = (tail - old_tail);
+    return ZX_OK;
+}
+
+void FifoDispatcher::SyncRingLocked() TA_NO_THREAD_SAFETY_ANALYSIS {
+    canary_.Assert();
 
-    // if we've become empty, we're no longer readable
-    if ((head_ - tail_) == 0)
+    // Both sides call in after their own transitions, and each call looks at
+    // the indexes as they are now, so whichever comes last leaves the signals
+    // matching the ring.
+    const uint32_t n = used();
+
+    if (n > 0) {
+        UpdateStateLocked(0u, ZX_FIFO_READABLE);
+    } else {
         UpdateStateLocked(ZX_FIFO_READABLE, 0u);
+    }
 
-    *actual = (tail_ - old_tail);
+    if (peer_) {
+        if (n < elem_count_) {
+            peer_->UpdateStateLocked(0u, ZX_FIFO_WRITABLE);
+        } else {
+            peer_->UpdateStateLocked(ZX_FIFO_WRITABLE, 0u);
+        }
+    }
+}
+
+zx_status_t FifoDispatcher::GetRing(bool tx, fbl::RefPtr<VmObject>* vmo)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    canary_.Assert();
+
+    if (!ring_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!tx) {
+        *vmo = ring_;
+        return ZX_OK;
+    }
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (!peer_)
+        return ZX_ERR_PEER_CLOSED;
+    *vmo = peer_->ring_;
     return ZX_OK;
 }
@@ -23,23 +23,47 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (const auto& shard : shards_) {
+        DEBUG_ASSERT(shard.futex_table.is_empty());
+    }
+}
+
+FutexContext::Shard* FutexContext::ShardFor(uintptr_t futex_key) {
+    // The hash tables bucket on the low bits of the key, so pick the shard
+    // from the high bits of a multiplicative hash to keep the two apart.
+    uint64_t hash = static_cast<uint64_t>(futex_key) * 0x9E3779B97F4A7C15ull;
+    return &shards_[hash >> (64 - kShardBits)];
 }
 
 zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
     LTRACE_ENTRY;
 
+    return Wait(value_ptr, current_value, nullptr, deadline);
+}
+
+zx_status_t FutexContext::FutexWaitPi(user_in_ptr<const int> value_ptr, int current_value,
+                                      fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline) {
+    LTRACE_ENTRY;
+
+    DEBUG_ASSERT(owner);
+    return Wait(value_ptr, current_value, fbl::move(owner), deadline);
+}
+
+zx_status_t FutexContext::Wait(user_in_ptr<const int> value_ptr, int current_value,
+                               fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline) {
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    Shard* shard = ShardFor(futex_key);
+
     // FutexWait() checks that the address value_ptr still contains
     // current_value, and if so it sleeps awaiting a FutexWake() on value_ptr.
     // Those two steps must together be atomic with respect to FutexWake().
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    Guard<fbl::Mutex> guard{&lock_};
+    Guard<fbl::Mutex> guard{&shard->lock};
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
@@ -52,11 +76,32 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
 
     FutexNode node;
     node.set_hash_key(futex_key);
+    node.set_waiter(ThreadDispatcher::GetCurrent());
     node.SetAsSingletonList();
 
-    QueueNodesLocked(&node);
+    QueueNodesLocked(shard, &node);
+
+    if (owner) {
+        FutexNode* head = &*shard->futex_table.find(futex_key);
+
+        Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+        int priority = get_current_thread()->effec_priority;
+        node.set_waiter_priority(priority);
+
+        // The newest waiter's idea of the owner wins; a stale one left by a
+        // waiter that blocked before the futex changed hands stops inheriting.
+        if (head->pi_owner() == owner) {
+            owner->FutexPiBoost(priority);
+        } else {
+            if (head->pi_owner()) {
+                head->pi_owner()->FutexPiRelease();
+            }
+            owner->FutexPiAcquire(head->MaxWaiterPriority());
+            head->pi_owner().swap(owner);
+        }
+    }
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
+    // Block current thread.  This releases the shard lock and does not reacquire it.
     result = node.BlockThread(guard.take(), deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node.IsInQueue());
@@ -70,8 +115,7 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    Guard<fbl::Mutex> guard2{&lock_};
-    if (UnqueueNodeLocked(&node)) {
+    if (UnqueueNode(&node)) {
         return result;
     }
     // The current thread was not found on the wait queue.  This means
@@ -106,23 +150,72 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    Shard* shard = ShardFor(futex_key);
+
     AutoReschedDisable resched_disable; // Must come before the Guard.
     resched_disable.Disable();
-    Guard<fbl::Mutex> guard{&lock_};
+    Guard<fbl::Mutex> guard{&shard->lock};
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = shard->futex_table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
     }
     DEBUG_ASSERT(node->GetKey() == futex_key);
 
+    // Take the owner off the head before waking it, since a woken node may
+    // be gone as soon as its thread runs.
+    fbl::RefPtr<ThreadDispatcher> owner = fbl::move(node->pi_owner());
+
     FutexNode* remaining_waiters =
         FutexNode::WakeThreads(node, count, futex_key);
 
+    DEBUG_ASSERT(!remaining_waiters || remaining_waiters->GetKey() == futex_key);
+    SetHeadLocked(shard, remaining_waiters, fbl::move(owner));
+
+    return ZX_OK;
+}
+
+zx_status_t FutexContext::FutexWakePi(user_in_ptr<const int> value_ptr) {
+    LTRACE_ENTRY;
+
+    uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
+    if (futex_key % sizeof(int))
+        return ZX_ERR_INVALID_ARGS;
+
+    Shard* shard = ShardFor(futex_key);
+
+    AutoReschedDisable resched_disable; // Must come before the Guard.
+    resched_disable.Disable();
+    Guard<fbl::Mutex> guard{&shard->lock};
+
+    FutexNode* node = shard->futex_table.erase(futex_key);
+    if (!node) {
+        // nothing blocked on this futex if we can't find it
+        return ZX_OK;
+    }
+    DEBUG_ASSERT(node->GetKey() == futex_key);
+
+    fbl::RefPtr<ThreadDispatcher> owner = fbl::move(node->pi_owner());
+    // The waiter is still blocked, so its dispatcher can't go away yet.
+    fbl::RefPtr<ThreadDispatcher> next_owner = fbl::WrapRefPtr(node->waiter());
+
+    FutexNode* remaining_waiters = FutexNode::WakeThreads(node, 1, futex_key);
+
+    {
+        Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+        if (owner) {
+            owner->FutexPiRelease();
+        }
+        if (remaining_waiters) {
+            next_owner->FutexPiAcquire(remaining_waiters->MaxWaiterPriority());
+        }
+    }
+
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        remaining_waiters->pi_owner() = fbl::move(next_owner);
+        shard->futex_table.insert(remaining_waiters);
     }
 
     return ZX_OK;
@@ -135,9 +228,25 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
     if ((requeue_ptr.get() == nullptr) && requeue_count)
         return ZX_ERR_INVALID_ARGS;
 
+    Shard* wake_shard = ShardFor(reinterpret_cast<uintptr_t>(wake_ptr.get()));
+    Shard* requeue_shard = ShardFor(reinterpret_cast<uintptr_t>(requeue_ptr.get()));
+
     AutoReschedDisable resched_disable; // Must come before the Guard.
-    Guard<fbl::Mutex> guard{&lock_};
+    if (wake_shard == requeue_shard) {
+        Guard<fbl::Mutex> guard{&wake_shard->lock};
+        return RequeueLocked(&resched_disable, wake_shard, wake_ptr, wake_count, current_value,
+                             requeue_shard, requeue_ptr, requeue_count);
+    }
+    GuardMultiple<2, fbl::Mutex> guard{&wake_shard->lock, &requeue_shard->lock};
+    return RequeueLocked(&resched_disable, wake_shard, wake_ptr, wake_count, current_value,
+                         requeue_shard, requeue_ptr, requeue_count);
+}
 
+zx_status_t FutexContext::RequeueLocked(AutoReschedDisable* resched_disable,
+                                        Shard* wake_shard, user_in_ptr<const int> wake_ptr,
+                                        uint32_t wake_count, int current_value,
+                                        Shard* requeue_shard, user_in_ptr<const int> requeue_ptr,
+                                        uint32_t requeue_count) {
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
     if (result != ZX_OK) return result;
@@ -150,17 +259,21 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
         return ZX_ERR_INVALID_ARGS;
 
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
+    // nodes below, because operations on futex_table look at the GetKey
     // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = wake_shard->futex_table.erase(wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
     }
 
+    // An owner stays with the futex it owns; the requeued nodes don't
+    // carry it along.
+    fbl::RefPtr<ThreadDispatcher> owner = fbl::move(node->pi_owner());
+
     // This must come before WakeThreads() to be useful, but we want to
     // avoid doing it before copy_from_user() in case that faults.
-    resched_disable.Disable();
+    resched_disable->Disable();
 
     if (wake_count > 0) {
         node = FutexNode::WakeThreads(node, wake_count, wake_key);
@@ -176,21 +289,19 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
 
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_shard, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
-    if (node != nullptr) {
-        DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
-    }
+    DEBUG_ASSERT(!node || node->GetKey() == wake_key);
+    SetHeadLocked(wake_shard, node, fbl::move(owner));
 
     return ZX_OK;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.lock().IsHeld());
+void FutexContext::QueueNodesLocked(Shard* shard, FutexNode* head) {
+    DEBUG_ASSERT(shard->lock.lock().IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -198,29 +309,50 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!shard->futex_table.insert_or_find(head, &iter))
         iter->AppendList(head);
 }
 
+void FutexContext::SetHeadLocked(Shard* shard, FutexNode* new_head,
+                                 fbl::RefPtr<ThreadDispatcher> owner) {
+    DEBUG_ASSERT(shard->lock.lock().IsHeld());
+
+    if (new_head) {
+        new_head->pi_owner() = fbl::move(owner);
+        shard->futex_table.insert(new_head);
+    } else if (owner) {
+        // nobody is left to inherit from
+        Guard<spin_lock_t, IrqSave> thread_lock_guard{ThreadLock::Get()};
+        owner->FutexPiRelease();
+    }
+}
+
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.lock().IsHeld());
-
-    if (!node->IsInQueue())
-        return false;
-
-    // Note: When UnqueueNode() is called from FutexWait(), it might be
-    // tempting to reuse the futex key that was passed to FutexWait().
-    // However, that could be out of date if the thread was requeued by
-    // FutexRequeue(), so we need to re-get the hash table key here.
-    uintptr_t futex_key = node->GetKey();
-
-    FutexNode* old_head = futex_table_.erase(futex_key);
-    DEBUG_ASSERT(old_head);
-    FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
-    if (new_head)
-        futex_table_.insert(new_head);
-    return true;
+bool FutexContext::UnqueueNode(FutexNode* node) {
+    for (;;) {
+        // Note: When UnqueueNode() is called from FutexWait(), it might be
+        // tempting to reuse the futex key that was passed to FutexWait().
+        // However, that could be out of date if the thread was requeued by
+        // FutexRequeue(), so we need to re-get the hash table key here. The
+        // key only changes with its shard's lock held, so check it again once
+        // we have that lock, in case a requeue moved the node to another shard.
+        uintptr_t futex_key = node->GetKey();
+        Shard* shard = ShardFor(futex_key);
+
+        Guard<fbl::Mutex> guard{&shard->lock};
+        if (node->GetKey() != futex_key)
+            continue;
+
+        if (!node->IsInQueue())
+            return false;
+
+        FutexNode* old_head = shard->futex_table.erase(futex_key);
+        DEBUG_ASSERT(old_head);
+        fbl::RefPtr<ThreadDispatcher> owner = fbl::move(old_head->pi_owner());
+        FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
+        SetHeadLocked(shard, new_head, fbl::move(owner));
+        return true;
+    }
 }
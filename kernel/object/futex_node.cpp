@@ -25,6 +25,17 @@ FutexNode::~FutexNode() {
     LTRACE_ENTRY;
 
     DEBUG_ASSERT(!IsInQueue());
+    DEBUG_ASSERT(!pi_owner_);
+}
+
+int FutexNode::MaxWaiterPriority() const {
+    int priority = waiter_priority_;
+    for (const FutexNode* node = queue_next_; node != this; node = node->queue_next_) {
+        if (node->waiter_priority_ > priority) {
+            priority = node->waiter_priority_;
+        }
+    }
+    return priority;
 }
 
 bool FutexNode::IsInQueue() const {
@@ -77,7 +77,6 @@ static void object_glue_init(uint level) TA_NO_THREAD_SAFETY_ANALYSIS {
     Handle::Init();
     root_job = JobDispatcher::CreateRootJob();
     policy_manager = PolicyManager::Create();
-    PortDispatcher::Init();
     // Be sure to update kernel_cmdline.md if any of these defaults change.
     oom_init(cmdline_get_bool("kernel.oom.enable", true),
              ZX_SEC(cmdline_get_uint64("kernel.oom.sleep-sec", 1)),
@@ -45,7 +45,8 @@ GuestDispatcher::GuestDispatcher(fbl::unique_ptr<Guest> guest)
 GuestDispatcher::~GuestDispatcher() {}
 
 zx_status_t GuestDispatcher::SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
-                                     fbl::RefPtr<PortDispatcher> port, uint64_t key) {
+                                     fbl::RefPtr<PortDispatcher> port,
+                                     fbl::RefPtr<EventDispatcher> event, uint64_t key) {
     canary_.Assert();
-    return guest_->SetTrap(kind, addr, len, fbl::move(port), key);
+    return guest_->SetTrap(kind, addr, len, fbl::move(port), fbl::move(event), key);
 }
@@ -88,24 +88,27 @@ uint32_t Handle::GetNewBaseValue(void* addr) TA_REQ(ArenaLock::Get()) {
 void* Handle::Alloc(const fbl::RefPtr<Dispatcher>& dispatcher,
                     const char* what, uint32_t* base_value) {
     size_t outstanding_handles;
+    void* addr;
     {
         Guard<fbl::Mutex> guard{ArenaLock::Get()};
-        void* addr = arena_.Alloc();
+        addr = arena_.Alloc();
         outstanding_handles = arena_.DiagnosticCount();
         if (likely(addr)) {
-            if (outstanding_handles > kHighHandleCount) {
-                // TODO: Avoid calling this for every handle after
-                // kHighHandleCount; printfs are slow and we're
-                // holding the mutex.
-                printf("WARNING: High handle count: %zu handles\n",
-                       outstanding_handles);
-            }
-            dispatcher->increment_handle_count();
             *base_value = GetNewBaseValue(addr);
-            return addr;
         }
     }
 
+    if (likely(addr)) {
+        if (outstanding_handles > kHighHandleCount) {
+            // TODO: Avoid calling this for every handle after
+            // kHighHandleCount; printfs are slow.
+            printf("WARNING: High handle count: %zu handles\n",
+                   outstanding_handles);
+        }
+        dispatcher->increment_handle_count();
+        return addr;
+    }
+
     printf("WARNING: Could not allocate %s handle (%zu outstanding)\n",
            what, outstanding_handles);
     return nullptr;
@@ -182,14 +185,12 @@ void Handle::Delete() {
 
     TearDown();
 
-    bool zero_handles = false;
     {
         Guard<fbl::Mutex> guard{ArenaLock::Get()};
-        zero_handles = disp->decrement_handle_count();
         arena_.Free(this);
     }
 
-    if (zero_handles)
+    if (disp->decrement_handle_count())
         disp->on_zero_handles();
 
     // If |disp| is the last reference then the dispatcher object
@@ -199,18 +200,14 @@ void Handle::Delete() {
 
 Handle* Handle::FromU32(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
     uintptr_t handle_addr = IndexToHandle(value & kHandleIndexMask);
-    {
-        Guard<fbl::Mutex> guard{ArenaLock::Get()};
-        if (unlikely(!arena_.in_range(handle_addr)))
-            return nullptr;
-    }
+    // Slots are never decommitted once handed out, so this needs no lock.
+    if (unlikely(!arena_.in_range_unlocked(handle_addr)))
+        return nullptr;
     auto handle = reinterpret_cast<Handle*>(handle_addr);
     return likely(handle->base_value() == value) ? handle : nullptr;
 }
 
 uint32_t Handle::Count(const fbl::RefPtr<const Dispatcher>& dispatcher) {
-    // Handle::ArenaLock also guards Dispatcher::handle_count_.
-    Guard<fbl::Mutex> guard{ArenaLock::Get()};
     return dispatcher->current_handle_count();
 }
 
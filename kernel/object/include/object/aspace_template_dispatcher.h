@@ -0,0 +1,76 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <zircon/rights.h>
+#include <zircon/types.h>
+
+#include <fbl/canary.h>
+#include <fbl/ref_ptr.h>
+#include <fbl/vector.h>
+#include <object/dispatcher.h>
+#include <object/vm_address_region_dispatcher.h>
+
+class VmObject;
+
+// A set of mappings recorded once and laid out again in any number of address
+// spaces. Each entry is a range of a VMO placed at an offset in the template;
+// applying the template allocates one VMAR big enough for all of them and
+// maps every entry into it, cloning the copy-on-write ones on the way.
+//
+// This lets a process launcher set up the parts every process shares, like
+// the vDSO, ld.so and libc, with one syscall instead of a clone and a map
+// call per segment.
+class AspaceTemplateDispatcher final :
+    public SoloDispatcher<AspaceTemplateDispatcher, ZX_DEFAULT_ASPACE_TEMPLATE_RIGHTS> {
+public:
+    // The most entries one template may hold.
+    static constexpr size_t kMaxEntries = 64u;
+
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~AspaceTemplateDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_ASPACE_TEMPLATE; }
+
+    // Records a mapping of |len| bytes of |vmo| from |vmo_offset|, placed at
+    // |offset| in the template. |options| takes the ZX_VM_PERM_* flags,
+    // ZX_VM_MAP_RANGE and ZX_ASPACE_TEMPLATE_COW; |vmo_rights| are the rights
+    // of the handle the VMO came from, and bound what the mapping may do.
+    zx_status_t AddEntry(fbl::RefPtr<VmObject> vmo, zx_rights_t vmo_rights, uint32_t options,
+                         uint64_t offset, uint64_t vmo_offset, uint64_t len);
+
+    // Allocates a child of |vmar| the size of the template, as
+    // zx_vmar_allocate() would with |options| and |offset|, and maps every
+    // entry into it. On failure nothing is left behind in |vmar|.
+    zx_status_t Apply(VmAddressRegionDispatcher* vmar, zx_rights_t vmar_rights, uint32_t options,
+                      uint64_t offset, fbl::RefPtr<VmAddressRegionDispatcher>* child,
+                      zx_rights_t* child_rights);
+
+private:
+    struct Entry {
+        fbl::RefPtr<VmObject> vmo;
+        uint64_t vmo_offset;
+        uint64_t len;
+        uint64_t offset;
+        // ZX_VM_PERM_* and ZX_VM_MAP_RANGE
+        uint32_t map_options;
+        // the ZX_VM_CAN_MAP_* flags the mapping is created with
+        uint32_t can_map;
+        bool cow;
+    };
+
+    AspaceTemplateDispatcher() = default;
+
+    fbl::Canary<fbl::magic("ASTP")> canary_;
+
+    fbl::Vector<Entry> entries_ TA_GUARDED(get_lock());
+    // the end of the last entry
+    uint64_t size_ TA_GUARDED(get_lock()) = 0u;
+    // the ZX_VM_CAN_MAP_* flags the entries need from the VMAR
+    uint32_t can_map_ TA_GUARDED(get_lock()) = 0u;
+};
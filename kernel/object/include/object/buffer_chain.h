@@ -61,13 +61,17 @@ public:
 
     // Copies |size| bytes from this chain starting at offset |src_offset| to |dst|.
     //
-    // |src_offset| must be in the range [0, kContig).
+    // |src_offset| is usually in the range [0, kContig), but may lie further in,
+    // in which case the buffers before it are skipped.
     zx_status_t CopyOut(user_out_ptr<void> dst, size_t src_offset, size_t size) {
-        DEBUG_ASSERT(src_offset < buffers_.front().size());
         size_t copy_offset = src_offset;
         size_t rem = size;
         const auto end = buffers_.end();
         for (auto iter = buffers_.begin(); rem > 0 && iter != end; ++iter) {
+            if (copy_offset >= iter->size()) {
+                copy_offset -= iter->size();
+                continue;
+            }
             const size_t copy_len = fbl::min(rem, iter->size() - copy_offset);
             const char* src = iter->data() + copy_offset;
             const zx_status_t status = dst.copy_array_to_user(src, copy_len);
@@ -133,7 +137,7 @@ public:
 
     // Copies |size| bytes from |src| to this chain starting at offset |dst_offset|.
     //
-    // |dst_offset| must be in the range [0, kContig).
+    // Like CopyOut, |dst_offset| may lie past the first buffer.
     zx_status_t CopyIn(user_in_ptr<const void> src, size_t dst_offset, size_t size) {
         return CopyInCommon(src, dst_offset, size);
     }
@@ -183,11 +187,14 @@ private:
     // |PTR_IN| is a user_in_ptr-like type.
     template <typename PTR_IN>
     zx_status_t CopyInCommon(PTR_IN src, size_t dst_offset, size_t size) {
-        DEBUG_ASSERT(dst_offset < buffers_.front().size());
         size_t copy_offset = dst_offset;
         size_t rem = size;
         const auto end = buffers_.end();
         for (auto iter = buffers_.begin(); rem > 0 && iter != end; ++iter) {
+            if (copy_offset >= iter->size()) {
+                copy_offset -= iter->size();
+                continue;
+            }
             const size_t copy_len = fbl::min(rem, iter->size() - copy_offset);
             char* dst = iter->data() + copy_offset;
             const zx_status_t status = src.copy_array_from_user(dst, copy_len);
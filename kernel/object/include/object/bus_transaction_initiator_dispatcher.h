@@ -40,10 +40,14 @@ public:
     // Returns ZX_ERR_INVALID_ARGS if |perms| is not suitable to pass to the Iommu::Map() interface.
     // Returns ZX_ERR_INVALID_ARGS if |mapped_addrs_count| is not exactly the
     //   value described above.
+    //
+    // If |cache|, an explicit unpin of the returned PMT keeps the range pinned
+    // and mapped in the IOMMU, and a later cached Pin() of the same range with
+    // the same |perms| reuses it without walking the VMO or the IOMMU.
     zx_status_t Pin(fbl::RefPtr<VmObject> vmo, uint64_t offset, uint64_t size, uint32_t perms,
-                    fbl::RefPtr<Dispatcher>* pmt, zx_rights_t* rights);
+                    bool cache, fbl::RefPtr<Dispatcher>* pmt, zx_rights_t* rights);
 
-    // Releases all quarantined PMTs.  The memory pins are released and the VMO
+    // Releases all quarantined and cached PMTs.  The memory pins are released and the VMO
     // references are dropped, so the underlying VMOs may be immediately destroyed, and the
     // underlying physical memory may be reallocated.
     void ReleaseQuarantine();
@@ -75,6 +79,11 @@ protected:
     // quarantine is cleared.
     void Quarantine(fbl::RefPtr<PinnedMemoryTokenDispatcher> pmt) TA_EXCL(get_lock());
 
+    // Keep the explicitly unpinned |pmt| so its pin and mapping can be reused,
+    // evicting the oldest cached PMT if the cache is full.  Returns false if
+    // the BTI is going away, in which case |pmt| must clean up as usual.
+    bool CacheUnpinned(fbl::RefPtr<PinnedMemoryTokenDispatcher> pmt) TA_EXCL(get_lock());
+
 private:
     BusTransactionInitiatorDispatcher(fbl::RefPtr<Iommu> iommu, uint64_t bti_id);
     void PrintQuarantineWarningLocked() TA_REQ(get_lock());
@@ -92,5 +101,10 @@ private:
           PinnedMemoryTokenDispatcher::QuarantineListTraits>;
     QuarantineList quarantine_ TA_GUARDED(get_lock());
 
+    // Unpinned PMTs that still hold their pin and IOMMU mapping, oldest first.
+    static constexpr size_t kMaxCachedPmts = 16;
+    QuarantineList cache_ TA_GUARDED(get_lock());
+    size_t cache_count_ TA_GUARDED(get_lock()) = 0;
+
     bool zero_handles_ TA_GUARDED(get_lock());
 };
@@ -15,6 +15,7 @@
 #include <zircon/rights.h>
 #include <zircon/types.h>
 
+#include <fbl/alloc_checker.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
@@ -31,6 +32,11 @@ public:
 
     ~ChannelDispatcher() final;
     zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_CHANNEL; }
+
+    // Endpoints come from an object cache rather than straight from the heap.
+    static void* operator new(size_t size, fbl::AllocChecker* ac) noexcept;
+    static void operator delete(void* ptr);
+
     zx_status_t add_observer(StateObserver* observer) final;
 
     // Read from this endpoint's message queue.
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
@@ -66,6 +67,9 @@ DECLARE_DISPTAG(BusTransactionInitiatorDispatcher, ZX_OBJ_TYPE_BTI)
 DECLARE_DISPTAG(ProfileDispatcher, ZX_OBJ_TYPE_PROFILE)
 DECLARE_DISPTAG(PinnedMemoryTokenDispatcher, ZX_OBJ_TYPE_PMT)
 DECLARE_DISPTAG(SuspendTokenDispatcher, ZX_OBJ_TYPE_SUSPEND_TOKEN)
+DECLARE_DISPTAG(PagerDispatcher, ZX_OBJ_TYPE_PAGER)
+DECLARE_DISPTAG(WaitSetDispatcher, ZX_OBJ_TYPE_WAITSET)
+DECLARE_DISPTAG(AspaceTemplateDispatcher, ZX_OBJ_TYPE_ASPACE_TEMPLATE)
 
 #undef DECLARE_DISPTAG
 
@@ -102,21 +106,19 @@ public:
 
     zx_koid_t get_koid() const { return koid_; }
 
-    // Must be called under the handle table lock.
-    void increment_handle_count() TA_REQ(Handle::ArenaLock::Get()) {
-        ++handle_count_;
+    // Called by Handle when a handle to this object is created.
+    void increment_handle_count() {
+        handle_count_.fetch_add(1u, fbl::memory_order_relaxed);
     }
 
-    // Must be called under the handle table lock.
+    // Called by Handle when a handle to this object is destroyed.
     // Returns true exactly when the handle count goes to zero.
-    bool decrement_handle_count() TA_REQ(Handle::ArenaLock::Get()) {
-        --handle_count_;
-        return handle_count_ == 0u;
+    bool decrement_handle_count() {
+        return handle_count_.fetch_sub(1u, fbl::memory_order_acq_rel) == 1u;
     }
 
-    // Must be called under the handle table lock.
-    uint32_t current_handle_count() const TA_REQ(Handle::ArenaLock::Get()) {
-        return handle_count_;
+    uint32_t current_handle_count() const {
+        return handle_count_.load(fbl::memory_order_acquire);
     }
 
     // The following are only to be called when |is_waitable| reports true.
@@ -128,8 +130,9 @@ public:
     void AddObserverLocked(StateObserver* observer,
                            const StateObserver::CountInfo* cinfo) TA_REQ(get_lock());
 
-    // Remove an observer (which must have been added).
-    void RemoveObserver(StateObserver* observer);
+    // Remove an observer (which must have been added). Returns the object's
+    // signals at the time of removal.
+    zx_signals_t RemoveObserver(StateObserver* observer);
 
     // Called when observers of the handle's state (e.g., waits on the handle) should be
     // "cancelled", i.e., when a handle (for the object that owns this StateTracker) is being
@@ -215,16 +218,23 @@ private:
                            Lock<LockType>* lock);
 
     void UpdateInternalLocked(ObserverList* obs_to_remove,
+                              zx_signals_t previous_signals,
                               zx_signals_t signals) TA_REQ(get_lock());
 
     const zx_koid_t koid_;
-    uint32_t handle_count_ TA_GUARDED(Handle::ArenaLock::Get());
+    fbl::atomic<uint32_t> handle_count_;
 
     zx_signals_t signals_ TA_GUARDED(get_lock());
 
     // Active observers are elements in |observers_|.
     ObserverList observers_ TA_GUARDED(get_lock());
 
+    // A superset of the union of the interest sets of |observers_|.  It is
+    // widened as observers are added and made exact again whenever the
+    // observers are walked, so a signal change that no observer cares about
+    // can skip the walk entirely.
+    zx_signals_t observer_interest_ TA_GUARDED(get_lock()) = 0u;
+
     // Used to store this dispatcher on the dispatcher deleter list.
     fbl::SinglyLinkedListNodeState<Dispatcher*> deleter_ll_;
 };
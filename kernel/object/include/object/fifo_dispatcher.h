@@ -8,7 +8,9 @@
 
 #include <stdint.h>
 
+#include <kernel/atomic.h>
 #include <object/dispatcher.h>
+#include <vm/vm_object.h>
 
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -34,6 +36,14 @@ public:
     zx_status_t ReadToUser(size_t elem_size, user_out_ptr<uint8_t> dst, size_t count,
                            size_t* actual);
 
+    // For a ZX_FIFO_SHARED fifo, a write or read of zero elements re-derives
+    // the signals of the ring written to or read from after the caller moved
+    // its index through the mapping.
+
+    // Returns the ring this endpoint reads from, or with |tx| the one it
+    // writes to. ZX_ERR_NOT_SUPPORTED unless created with ZX_FIFO_SHARED.
+    zx_status_t GetRing(bool tx, fbl::RefPtr<VmObject>* vmo);
+
     // PeeredDispatcher implementation.
     void on_zero_handles_locked() TA_REQ(get_lock());
     void OnPeerZeroHandlesLocked() TA_REQ(get_lock());
@@ -41,11 +51,46 @@ public:
 private:
     FifoDispatcher(fbl::RefPtr<PeerHolder<FifoDispatcher>> holder,
                    uint32_t options, uint32_t elem_count, uint32_t elem_size,
-                   fbl::unique_ptr<uint8_t[]> data);
+                   fbl::unique_ptr<uint8_t[]> data, fbl::RefPtr<VmObject> ring,
+                   volatile zx_fifo_ring_header_t* ring_header, uint8_t* ring_entries);
+    static zx_status_t CreateRing(uint32_t elem_count, uint32_t elem_size,
+                                  fbl::RefPtr<VmObject>* vmo,
+                                  volatile zx_fifo_ring_header_t** header, uint8_t** entries);
     void Init(fbl::RefPtr<FifoDispatcher> other);
     zx_status_t WriteSelfLocked(size_t elem_size, user_in_ptr<const uint8_t> ptr, size_t count,
                                 size_t* actual) TA_REQ(get_lock());
     zx_status_t UserSignalSelfLocked(uint32_t clear_mask, uint32_t set_mask) TA_REQ(get_lock());
+    // Sets our readable and the peer's writable signal from the shared indexes.
+    void SyncRingLocked() TA_REQ(get_lock());
+
+    // In shared mode the indexes live in the ring, where the other side may
+    // move them at any time, so every access is atomic.
+    uint32_t head() const TA_REQ(get_lock()) {
+        return ring_header_ ? atomic_load_u32(&ring_header_->head) : head_;
+    }
+    uint32_t tail() const TA_REQ(get_lock()) {
+        return ring_header_ ? atomic_load_u32(&ring_header_->tail) : tail_;
+    }
+    void set_head(uint32_t head) TA_REQ(get_lock()) {
+        if (ring_header_) {
+            atomic_store_u32(&ring_header_->head, head);
+        } else {
+            head_ = head;
+        }
+    }
+    void set_tail(uint32_t tail) TA_REQ(get_lock()) {
+        if (ring_header_) {
+            atomic_store_u32(&ring_header_->tail, tail);
+        } else {
+            tail_ = tail;
+        }
+    }
+    // Entries queued, as far as either side can tell. The shared indexes are
+    // written by user code, so clamp what they claim.
+    uint32_t used() const TA_REQ(get_lock()) {
+        uint32_t n = head() - tail();
+        return n > elem_count_ ? elem_count_ : n;
+    }
 
     fbl::Canary<fbl::magic("FIFO")> canary_;
     const uint32_t elem_count_;
@@ -56,5 +101,14 @@ private:
     uint32_t tail_ TA_GUARDED(get_lock());
     fbl::unique_ptr<uint8_t[]> data_ TA_GUARDED(get_lock());
 
+    // ZX_FIFO_SHARED only: a committed, pinned VMO whose first page is a
+    // zx_fifo_ring_header_t and whose second holds the entries, reached
+    // through the physmap.
+    const fbl::RefPtr<VmObject> ring_;
+    volatile zx_fifo_ring_header_t* const ring_header_;
+    // the entries, in |data_| or in |ring_|
+    uint8_t* const entries_;
+
     static constexpr uint32_t kMaxSizeBytes = PAGE_SIZE;
+    static constexpr uint64_t kRingSize = ZX_FIFO_RING_DATA_OFFSET + kMaxSizeBytes;
 };
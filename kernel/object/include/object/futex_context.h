@@ -10,11 +10,15 @@
 #include <zircon/types.h>
 #include <fbl/mutex.h>
 #include <kernel/lockdep.h>
+#include <fbl/ref_ptr.h>
 #include <object/futex_node.h>
 
+class ThreadDispatcher;
+
 // FutexContext is a class that encapsulates support for futex operations.
-// FutexContext uses a hash table keyed on the futex address (a pointer to integer in userspace)
-// to contain all active futexes.
+// FutexContext uses hash tables keyed on the futex address (a pointer to integer in userspace)
+// to contain all active futexes. The futexes are spread over kNumShards tables by a hash of
+// the address, each with its own lock, so that threads using unrelated futexes do not contend.
 // A futex is considered active if there is one or more threads blocked on the futex.
 // After no threads are left blocked on a futex it is removed from the hash table.
 // The value in the futex hash table is the FutexNode object associated with the head
@@ -36,9 +40,22 @@ public:
     // on the same |value_ptr| futex.
     zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline);
 
+    // FutexWaitPi is FutexWait for a futex that |owner| holds, such as a
+    // mutex. Until the futex is released with FutexWakePi, or another waiter
+    // names a different owner, |owner| runs at no less than the priority of
+    // the highest priority thread blocked on it.
+    zx_status_t FutexWaitPi(user_in_ptr<const int> value_ptr, int current_value,
+                            fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline);
+
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
     zx_status_t FutexWake(user_in_ptr<const int> value_ptr, uint32_t count);
 
+    // FutexWakePi wakes one thread blocked on the |value_ptr| futex and ends
+    // the current owner's inheritance through it. If more threads remain
+    // blocked, the woken thread, which is about to take the futex, becomes
+    // the owner and inherits from them.
+    zx_status_t FutexWakePi(user_in_ptr<const int> value_ptr);
+
     // FutexWait first verifies that the integer pointed to by |wake_ptr|
     // still equals |current_value|. If the test fails, FutexWait returns FAILED_PRECONDITION.
     // Otherwise it will wake up to |wake_count| number of threads blocked on the |wake_ptr| futex.
@@ -52,14 +69,38 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    static constexpr size_t kShardBits = 4;
+    static constexpr size_t kNumShards = 1u << kShardBits;
+
+    struct Shard {
+        // protects futex_table
+        DECLARE_MUTEX(Shard) lock;
+
+        // Key is futex address, value is the FutexNode for the head of futex's
+        // blocked thread list.
+        FutexNode::HashTable futex_table TA_GUARDED(lock);
+    };
+
+    Shard* ShardFor(uintptr_t futex_key);
+
+    zx_status_t Wait(user_in_ptr<const int> value_ptr, int current_value,
+                     fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline);
+
+    // The body of FutexRequeue, called with the locks of both shards held.
+    zx_status_t RequeueLocked(AutoReschedDisable* resched_disable,
+                              Shard* wake_shard, user_in_ptr<const int> wake_ptr,
+                              uint32_t wake_count, int current_value,
+                              Shard* requeue_shard, user_in_ptr<const int> requeue_ptr,
+                              uint32_t requeue_count) TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    void QueueNodesLocked(Shard* shard, FutexNode* head) TA_REQ(shard->lock);
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    // Installs |new_head| as the head of a futex's wait list, handing it
+    // |owner|, or releases |owner| if the list is now empty.
+    void SetHeadLocked(Shard* shard, FutexNode* new_head, fbl::RefPtr<ThreadDispatcher> owner)
+        TA_REQ(shard->lock);
 
-    // protects futex_table_
-    DECLARE_MUTEX(FutexContext) lock_;
+    bool UnqueueNode(FutexNode* node);
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    Shard shards_[kNumShards];
 };
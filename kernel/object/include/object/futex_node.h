@@ -13,12 +13,17 @@
 #include <zircon/types.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+
+class ThreadDispatcher;
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
 class FutexNode : public fbl::SinglyLinkedListable<FutexNode*> {
 public:
-    using HashTable = fbl::HashTable<uintptr_t, FutexNode*>;
+    // FutexContext spreads futexes over several of these, so each can be small.
+    using HashTable = fbl::HashTable<uintptr_t, FutexNode*, fbl::SinglyLinkedList<FutexNode*>,
+                                     size_t, 8>;
 
     FutexNode();
     ~FutexNode();
@@ -50,6 +55,20 @@ public:
         hash_key_ = key;
     }
 
+    // The owner of a priority inheritance futex is recorded on the head node
+    // of its wait list; FutexContext moves it along whenever the head changes.
+    fbl::RefPtr<ThreadDispatcher>& pi_owner() { return pi_owner_; }
+
+    // The thread waiting on this node, which FutexWakePi makes the next owner.
+    ThreadDispatcher* waiter() const { return waiter_; }
+    void set_waiter(ThreadDispatcher* waiter) { waiter_ = waiter; }
+
+    // The priority the waiting thread had when it blocked.
+    void set_waiter_priority(int priority) { waiter_priority_ = priority; }
+
+    // The highest waiter priority on the list headed by this node.
+    int MaxWaiterPriority() const;
+
     // Trait implementation for fbl::HashTable
     uintptr_t GetKey() const { return hash_key_; }
     static size_t GetHash(uintptr_t key) { return (key >> 3); }
@@ -80,4 +99,8 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    fbl::RefPtr<ThreadDispatcher> pi_owner_;
+    ThreadDispatcher* waiter_ = nullptr;
+    int waiter_priority_ = -1;
 };
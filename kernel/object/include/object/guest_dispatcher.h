@@ -8,6 +8,7 @@
 
 #include <zircon/syscalls/hypervisor.h>
 #include <zircon/types.h>
+#include <object/event_dispatcher.h>
 #include <object/port_dispatcher.h>
 
 class Guest;
@@ -25,7 +26,8 @@ public:
     Guest* guest() const { return guest_.get(); }
 
     zx_status_t SetTrap(uint32_t kind, zx_vaddr_t addr, size_t len,
-                        fbl::RefPtr<PortDispatcher> port, uint64_t key);
+                        fbl::RefPtr<PortDispatcher> port, fbl::RefPtr<EventDispatcher> event,
+                        uint64_t key);
 
 private:
     fbl::Canary<fbl::magic("GSTD")> canary_;
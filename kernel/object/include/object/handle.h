@@ -79,8 +79,8 @@ private:
 // A Handle is how a specific process refers to a specific Dispatcher.
 class Handle final : public fbl::DoublyLinkedListable<Handle*> {
 public:
-    // The handle arena's mutex. This is public since it protects
-    // other things like |Dispatcher::handle_count_|.
+    // The handle arena's mutex. It only covers allocating and freeing
+    // handle slots; FromU32() doesn't need it.
     DECLARE_SINGLETON_MUTEX(ArenaLock);
 
     // Returns the Dispatcher to which this instance points.
@@ -117,6 +117,9 @@ public:
     static void Init();
 
     // Maps an integer obtained by Handle::base_value() back to a Handle.
+    // The result may belong to any process, or be in the middle of being
+    // freed; the caller must check process_id() under its own handle table
+    // lock before trusting it.
     static Handle* FromU32(uint32_t value);
 
     // Get the number of outstanding handles for a given dispatcher.
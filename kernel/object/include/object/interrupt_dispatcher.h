@@ -6,8 +6,10 @@
 
 #pragma once
 
+#include <kernel/cpu.h>
 #include <kernel/event.h>
 #include <kernel/spinlock.h>
+#include <kernel/timer.h>
 
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -40,6 +42,13 @@ public:
     void InterruptHandler();
     zx_status_t Bind(fbl::RefPtr<PortDispatcher> port_dispatcher,
                      fbl::RefPtr<InterruptDispatcher> interrupt, uint64_t key);
+    // Delivers the interrupt to |cpu| from now on.
+    virtual zx_status_t SetAffinity(cpu_num_t cpu) { return ZX_ERR_NOT_SUPPORTED; }
+    // Coalesces interrupts into one port packet: once an interrupt is
+    // pending, its packet is held back for up to |interval|, or until |count|
+    // interrupts are pending if |count| is not zero. An |interval| of zero
+    // turns moderation off.
+    zx_status_t SetModeration(zx_duration_t interval, uint32_t count);
 
 protected:
     virtual void MaskInterrupt() = 0;
@@ -52,6 +61,15 @@ protected:
     }
     void set_flags(uint32_t flags) { flags_ = flags; }
     bool SendPacketLocked(zx_time_t timestamp) TA_REQ(spinlock_);
+    // Queues the pending interrupts as one packet if moderation allows it
+    // now, or arms |moderation_timer_| to do it later. Returns false if the
+    // packet was still queued.
+    bool FlushPendingLocked(zx_time_t now) TA_REQ(spinlock_);
+    // Whether the pending interrupts are to be queued at |now|; |*due| is
+    // when they will be at the latest.
+    bool ModerationDueLocked(zx_time_t now, zx_time_t* due) TA_REQ(spinlock_);
+    zx_status_t DestroyLocked() TA_REQ(spinlock_);
+    static void ModerationTimerCallback(timer_t* timer, zx_time_t now, void* arg);
     // Bits for Interrupt.flags
     static constexpr uint32_t INTERRUPT_VIRTUAL         = (1u << 0);
     static constexpr uint32_t INTERRUPT_UNMASK_PREWAIT  = (1u << 1);
@@ -69,6 +87,15 @@ private:
     PortInterruptPacket port_packet_ TA_GUARDED(spinlock_) = {};
     fbl::RefPtr<PortDispatcher> port_dispatcher_ TA_GUARDED(spinlock_);
 
+    // Interrupts seen since the last packet, and when the first of them came.
+    uint64_t pending_count_ TA_GUARDED(spinlock_) = 0;
+    zx_time_t pending_since_ TA_GUARDED(spinlock_) = 0;
+    zx_duration_t moderation_interval_ TA_GUARDED(spinlock_) = 0;
+    uint32_t moderation_count_ TA_GUARDED(spinlock_) = 0;
+    // Only armed while not destroyed; see Destroy().
+    timer_t moderation_timer_;
+    bool moderation_timer_armed_ TA_GUARDED(spinlock_) = false;
+
     // Controls the access to Interrupt properties
     DECLARE_SPINLOCK(InterruptDispatcher) spinlock_;
 
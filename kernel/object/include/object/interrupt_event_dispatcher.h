@@ -21,6 +21,8 @@ public:
     InterruptEventDispatcher(const InterruptDispatcher &) = delete;
     InterruptEventDispatcher& operator=(const InterruptDispatcher &) = delete;
 
+    zx_status_t SetAffinity(cpu_num_t cpu) final;
+
 protected:
     void MaskInterrupt() final;
     void UnmaskInterrupt() final;
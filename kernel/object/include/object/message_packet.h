@@ -18,10 +18,12 @@
 
 constexpr uint32_t kMaxMessageSize = 65536u;
 constexpr uint32_t kMaxMessageHandles = 64u;
+constexpr uint32_t kMaxMessageIovecs = 16u;
 
 // ensure public constants are aligned
 static_assert(ZX_CHANNEL_MAX_MSG_BYTES == kMaxMessageSize, "");
 static_assert(ZX_CHANNEL_MAX_MSG_HANDLES == kMaxMessageHandles, "");
+static_assert(ZX_CHANNEL_MAX_MSG_IOVECS == kMaxMessageIovecs, "");
 
 class Handle;
 
@@ -38,14 +40,32 @@ public:
                               uint32_t num_handles,
                               fbl::unique_ptr<MessagePacket>* msg);
 
+    // Creates a message packet whose data is the concatenation of the user
+    // buffers described by |iovecs|, gathered straight into the packet.
+    static zx_status_t Create(const zx_channel_iovec_t* iovecs, uint32_t num_iovecs,
+                              uint32_t num_handles,
+                              fbl::unique_ptr<MessagePacket>* msg);
+
+    // Like the user_in_ptr version of Create(), but the whole pages in the
+    // middle of a large |data| are moved out of the VMO mapped there instead of
+    // being copied, leaving that part of the caller's buffer decommitted.
+    // Falls back to copying when the pages can't be moved.
+    static zx_status_t CreateMovingPages(user_in_ptr<const void> data, uint32_t data_size,
+                                         uint32_t num_handles,
+                                         fbl::unique_ptr<MessagePacket>* msg);
+
     uint32_t data_size() const { return data_size_; }
 
     // Copies the packet's |data_size()| bytes to |buf|.
     // Returns an error if |buf| points to a bad user address.
     zx_status_t CopyDataTo(user_out_ptr<void> buf) const {
-        return buffer_chain_->CopyOut(buf, payload_offset_, data_size_);
+        return CopyDataRangeTo(buf, 0u, data_size_);
     }
 
+    // Scatters the packet's bytes across the user buffers described by
+    // |iovecs|, which must have room for |data_size()| bytes in total.
+    zx_status_t CopyDataTo(const zx_channel_iovec_t* iovecs, uint32_t num_iovecs) const;
+
     uint32_t num_handles() const { return num_handles_; }
     Handle* const* handles() const { return handles_; }
     Handle** mutable_handles() { return handles_; }
@@ -90,8 +110,11 @@ private:
     friend class fbl::Recyclable<MessagePacket>;
     void fbl_recycle();
 
-    static zx_status_t CreateCommon(uint32_t data_size, uint32_t num_handles,
-                                    fbl::unique_ptr<MessagePacket>* msg);
+    static zx_status_t CreateCommon(uint32_t data_size, uint32_t chain_size,
+                                    uint32_t num_handles, fbl::unique_ptr<MessagePacket>* msg);
+
+    // Copies |len| bytes of the payload starting at |offset| to |buf|.
+    zx_status_t CopyDataRangeTo(user_out_ptr<void> buf, uint32_t offset, uint32_t len) const;
 
     BufferChain* buffer_chain_;
     Handle** const handles_;
@@ -99,4 +122,10 @@ private:
     const uint32_t payload_offset_;
     const uint16_t num_handles_;
     bool owns_handles_;
+
+    // Pages moved in by CreateMovingPages(). They hold the payload bytes
+    // starting at |moved_offset_|; the chain holds the bytes before and after.
+    uint32_t moved_offset_ = 0u;
+    uint32_t moved_size_ = 0u;
+    list_node moved_pages_ = LIST_INITIAL_VALUE(moved_pages_);
 };
@@ -0,0 +1,54 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <zircon/rights.h>
+#include <zircon/types.h>
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/ref_ptr.h>
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <vm/page_source.h>
+#include <vm/vm_object.h>
+
+// A user mode pager. Each VMO it creates forwards faults on missing pages to a
+// port as ZX_PKT_TYPE_PAGE_REQUEST packets, and the pager answers them by
+// moving pages in with SupplyPages().
+class PagerDispatcher final :
+    public SoloDispatcher<PagerDispatcher, ZX_DEFAULT_PAGER_RIGHTS> {
+public:
+    static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    void on_zero_handles() final;
+
+    // Creates a VMO of |size| bytes whose page requests are queued on |port|
+    // with |key|.
+    zx_status_t CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key, uint64_t size,
+                          fbl::RefPtr<VmObject>* vmo);
+
+    // Moves the pages of |aux| at [aux_offset, aux_offset + len) into |vmo| at
+    // |offset|, waking any thread waiting on them.
+    zx_status_t SupplyPages(fbl::RefPtr<VmObject> vmo, uint64_t offset, uint64_t len,
+                            fbl::RefPtr<VmObject> aux, uint64_t aux_offset);
+
+private:
+    class PagerSource;
+
+    PagerDispatcher();
+
+    void RemoveSource(PagerSource* src);
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+
+    // every source still handing out requests, detached once the last handle
+    // to the pager goes away
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources_ TA_GUARDED(get_lock());
+};
@@ -24,6 +24,8 @@ public:
 
     ~PciInterruptDispatcher() final;
 
+    zx_status_t SetAffinity(cpu_num_t cpu) final;
+
 protected:
     void MaskInterrupt() final;
     void UnmaskInterrupt() final;
@@ -38,6 +38,8 @@ public:
         }
     };
 
+    // Also used for the BTI's cache of unpinned mappings; a PMT is never in
+    // both lists.
     using QuarantineListNodeState = fbl::DoublyLinkedListNodeState<
             fbl::RefPtr<PinnedMemoryTokenDispatcher>>;
     struct QuarantineListTraits {
@@ -71,15 +73,34 @@ protected:
     // Set the the permissions of |pinned_vmo|'s pinned range to |perms| on
     // behalf of |bti|. |perms| should be flags suitable for the Iommu::Map()
     // interface.  Must be created under the BTI dispatcher's lock.
+    //
+    // If |cache_on_unpin|, an explicit unpin hands the pin and its IOMMU
+    // mapping back to the BTI instead of tearing them down.
     static zx_status_t Create(fbl::RefPtr<BusTransactionInitiatorDispatcher> bti,
                               PinnedVmObject pinned_vmo,
-                              uint32_t perms,
+                              uint32_t perms, bool cache_on_unpin,
                               fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
+
+    // Creates a PMT that takes over the pin and mapping of |cached|, a PMT
+    // that was unpinned into the BTI's cache.  Must be created under the BTI
+    // dispatcher's lock, after |cached| has been removed from the cache.
+    static zx_status_t CreateFromCached(fbl::RefPtr<BusTransactionInitiatorDispatcher> bti,
+                                        PinnedMemoryTokenDispatcher* cached,
+                                        fbl::RefPtr<Dispatcher>* dispatcher,
+                                        zx_rights_t* rights);
+
+    // Returns true if this PMT pins exactly [offset, offset + size) of |vmo|
+    // with |perms|.  Only valid for PMTs in the BTI's cache.
+    bool MatchesCached(const VmObject* vmo, uint64_t offset, uint64_t size, uint32_t perms) const {
+        return pinned_vmo_.vmo().get() == vmo && pinned_vmo_.offset() == offset &&
+               pinned_vmo_.size() == size && perms_ == perms;
+    }
 private:
     PinnedMemoryTokenDispatcher(fbl::RefPtr<BusTransactionInitiatorDispatcher> bti,
                                 PinnedVmObject pinned_vmo,
-                                fbl::Array<dev_vaddr_t> mapped_addrs);
+                                fbl::Array<dev_vaddr_t> mapped_addrs,
+                                uint32_t perms, bool cache_on_unpin);
     DISALLOW_COPY_ASSIGN_AND_MOVE(PinnedMemoryTokenDispatcher);
 
     zx_status_t MapIntoIommu(uint32_t perms);
@@ -100,5 +121,9 @@ private:
     bool explicitly_unpinned_ TA_GUARDED(get_lock()) = false;
 
     const fbl::RefPtr<BusTransactionInitiatorDispatcher> bti_;
-    const fbl::Array<dev_vaddr_t> mapped_addrs_ TA_GUARDED(get_lock());
+    // Empty once the mapping has been handed to a PMT made by CreateFromCached().
+    fbl::Array<dev_vaddr_t> mapped_addrs_ TA_GUARDED(get_lock());
+
+    const uint32_t perms_;
+    const bool cache_on_unpin_;
 };
@@ -106,6 +106,7 @@ struct PortPacket final : public fbl::DoublyLinkedListable<PortPacket*> {
 
 struct PortInterruptPacket final : public fbl::DoublyLinkedListable<PortInterruptPacket*> {
     zx_time_t timestamp;
+    uint64_t count;
     uint64_t key;
 };
 
@@ -159,11 +160,11 @@ private:
 //
 // When a packet from any of the sources arrives to the port, one waiting
 // thread unblocks and gets the packet. In all cases |sema_| is used to signal
-// and manage the waiting threads.
+// and manage the waiting threads; with ZX_PORT_WAKE_NEWEST it wakes the thread
+// that started waiting last.
 
 class PortDispatcher final : public SoloDispatcher<PortDispatcher, ZX_DEFAULT_PORT_RIGHTS> {
 public:
-    static void Init();
     static PortAllocator* DefaultPortAllocator();
     static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
@@ -176,8 +177,13 @@ public:
 
     zx_status_t Queue(PortPacket* port_packet, zx_signals_t observed, uint64_t count);
     zx_status_t QueueUser(const zx_port_packet_t& packet);
-    bool QueueInterruptPacket(PortInterruptPacket* port_packet, zx_time_t timestamp);
+    bool QueueInterruptPacket(PortInterruptPacket* port_packet, zx_time_t timestamp,
+                              uint64_t count);
     zx_status_t Dequeue(zx_time_t deadline, zx_port_packet_t* packet);
+    // Like Dequeue() but returns up to |count| packets at once, blocking only
+    // while none are queued. |*actual| is set to the number returned.
+    zx_status_t DequeueMany(zx_time_t deadline, zx_port_packet_t* packets, size_t count,
+                            size_t* actual);
     bool RemoveInterruptPacket(PortInterruptPacket* port_packet);
 
     // Decides who is going to destroy the observer. If it returns the
@@ -15,6 +15,7 @@
 #include <object/policy_manager.h>
 #include <object/thread_dispatcher.h>
 
+#include <zircon/syscalls/exception.h>
 #include <zircon/syscalls/object.h>
 #include <zircon/types.h>
 #include <fbl/array.h>
@@ -53,6 +54,11 @@ public:
         }
     };
 
+    // Starts the kernel threads that finish tearing down processes killed
+    // without any threads left to do it themselves. Until they are running
+    // that work is done synchronously by whoever killed the process.
+    static void StartReapers();
+
     static ProcessDispatcher* GetCurrent() {
         ThreadDispatcher* current = ThreadDispatcher::GetCurrent();
         DEBUG_ASSERT(current);
@@ -198,6 +204,10 @@ public:
     // Syscall helpers
     zx_status_t GetInfo(zx_info_process_t* info);
     zx_status_t GetStats(zx_info_task_stats_t* stats);
+    // Fills in the koids, thread count, cpu runtime and memory usage of the
+    // process. Unlike GetStats(), succeeds with zeroed memory usage for a
+    // process that has exited.
+    void GetProcessStats(zx_info_process_stats_t* stats);
     // NOTE: Code outside of the syscall layer should not typically know about
     // user_ptrs; do not use this pattern as an example.
     zx_status_t GetAspaceMaps(user_out_ptr<zx_info_maps_t> maps, size_t max,
@@ -232,6 +242,11 @@ public:
     uintptr_t get_debug_addr() const;
     zx_status_t set_debug_addr(uintptr_t addr);
 
+    // The in-process exception handler (ZX_PROP_PROCESS_EXCEPTION_HANDLER).
+    // An |entry| of zero means there is none.
+    zx_exception_handler_t get_exception_handler() const;
+    zx_status_t set_exception_handler(const zx_exception_handler_t& handler);
+
     // Checks the |condition| against the parent job's policy.
     //
     // Must be called by syscalls before performing an action represented by an
@@ -291,6 +306,12 @@ private:
     void SetStateLocked(State) TA_REQ(get_lock());
     void FinishDeadTransition();
 
+    // Queues FinishDeadTransition() for the reaper threads, or runs it
+    // directly if they haven't been started.
+    void QueueFinishDeadTransition();
+
+    static int ReaperThread(void* arg);
+
     // Kill all threads
     void KillAllThreadsLocked() TA_REQ(get_lock());
 
@@ -307,12 +328,30 @@ private:
     fbl::DoublyLinkedListNodeState<ProcessDispatcher*> dll_job_raw_;
     fbl::SinglyLinkedListNodeState<fbl::RefPtr<ProcessDispatcher>> dll_job_;
 
+    // Linkage for the queue of processes waiting on a reaper thread.
+    struct ReaperListTraits {
+        static fbl::DoublyLinkedListNodeState<fbl::RefPtr<ProcessDispatcher>>& node_state(
+            ProcessDispatcher& obj) {
+            return obj.dll_reaper_;
+        }
+    };
+    using ReaperList =
+        fbl::DoublyLinkedList<fbl::RefPtr<ProcessDispatcher>, ReaperListTraits>;
+    fbl::DoublyLinkedListNodeState<fbl::RefPtr<ProcessDispatcher>> dll_reaper_;
+
+    DECLARE_SINGLETON_MUTEX(ReaperLock);
+    static ReaperList reaper_list_ TA_GUARDED(ReaperLock::Get());
+    static bool reapers_running_ TA_GUARDED(ReaperLock::Get());
+
     uint32_t handle_rand_ = 0;
 
     // list of threads in this process
     using ThreadList = fbl::DoublyLinkedList<ThreadDispatcher*, ThreadDispatcher::ThreadListTraits>;
     ThreadList thread_list_ TA_GUARDED(get_lock());
 
+    // accumulated runtime of the threads that have left |thread_list_|
+    zx_duration_t exited_thread_runtime_ TA_GUARDED(get_lock()) = 0;
+
     // our address space
     fbl::RefPtr<VmAspace> aspace_;
 
@@ -340,6 +379,8 @@ private:
     // See third_party/ulib/musl/ldso/dynlink.c.
     uintptr_t debug_addr_ TA_GUARDED(get_lock()) = 0;
 
+    zx_exception_handler_t exception_handler_ TA_GUARDED(get_lock()) = {};
+
     // This is a cache of aspace()->vdso_code_address().
     uintptr_t vdso_code_address_ = 0;
 
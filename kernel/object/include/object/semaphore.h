@@ -13,7 +13,15 @@
 // You probably don't want to use this class.
 class Semaphore {
 public:
-    explicit Semaphore(int64_t initial_count = 0);
+    // Which of several waiting threads Post() wakes.
+    enum class WakeOrder {
+        // the one that has waited longest
+        kFifo,
+        // the one that started waiting last, whose cache is likely warmest
+        kNewest,
+    };
+
+    explicit Semaphore(int64_t initial_count = 0, WakeOrder order = WakeOrder::kFifo);
     ~Semaphore();
 
     Semaphore(const Semaphore&) = delete;
@@ -25,5 +33,6 @@ public:
 
 private:
     int64_t count_;
+    const WakeOrder order_;
     WaitQueue waitq_;
 };
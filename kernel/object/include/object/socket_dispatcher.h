@@ -12,6 +12,7 @@
 #include <object/dispatcher.h>
 #include <object/handle.h>
 #include <object/mbuf.h>
+#include <vm/vm_object.h>
 
 #include <zircon/rights.h>
 #include <zircon/types.h>
@@ -32,7 +33,14 @@ public:
     // Dispatcher implementation.
     zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_SOCKET; }
 
+    // Size of the data area of each ZX_SOCKET_RING ring.
+    static constexpr size_t kRingSize = 256 * 1024;
+
     // Socket methods.
+    //
+    // For a ZX_SOCKET_RING socket, a null |src| to Write() or |dst| to Read()
+    // moves the head or tail by |len| bytes that the caller has already
+    // stored in or taken from its mapping of the ring.
     zx_status_t Write(user_in_ptr<const void> src, size_t len, size_t* written);
 
     zx_status_t WriteControl(user_in_ptr<const void> src, size_t len);
@@ -53,6 +61,10 @@ public:
     // On success, a HandleOwner is returned via h
     zx_status_t Accept(HandleOwner* h);
 
+    // Returns the ring this endpoint reads from, or with |tx| the one it
+    // writes to. ZX_ERR_NOT_SUPPORTED unless created with ZX_SOCKET_RING.
+    zx_status_t GetRing(bool tx, fbl::RefPtr<VmObject>* vmo);
+
     // Property methods.
     size_t ReceiveBufferMax() const;
     size_t ReceiveBufferSize() const;
@@ -80,7 +92,7 @@ private:
     // |control_msg| may be null.
     SocketDispatcher(fbl::RefPtr<PeerHolder<SocketDispatcher>> holder,
                      zx_signals_t starting_signals, uint32_t flags,
-                     fbl::unique_ptr<ControlMsg> control_msg);
+                     fbl::unique_ptr<ControlMsg> control_msg, fbl::RefPtr<VmObject> ring);
     void Init(fbl::RefPtr<SocketDispatcher> other);
     zx_status_t WriteSelfLocked(user_in_ptr<const void> src, size_t len, size_t* nwritten) TA_REQ(get_lock());
     zx_status_t WriteControlSelfLocked(user_in_ptr<const void> src, size_t len) TA_REQ(get_lock());
@@ -88,8 +100,22 @@ private:
     zx_status_t ShutdownOtherLocked(uint32_t how) TA_REQ(get_lock());
     zx_status_t ShareSelfLocked(HandleOwner h) TA_REQ(get_lock());
 
-    bool is_full() const TA_REQ(get_lock()) { return data_.is_full(); }
-    bool is_empty() const TA_REQ(get_lock()) { return data_.is_empty(); }
+    zx_status_t RingWriteSelfLocked(user_in_ptr<const void> src, size_t len, size_t* nwritten)
+        TA_REQ(get_lock());
+    zx_status_t RingReadLocked(user_out_ptr<void> dst, size_t len, size_t* nread)
+        TA_REQ(get_lock());
+    // Writes |head| and |tail| to the header page of |ring_|. The counters
+    // are only advanced once this succeeds.
+    zx_status_t PublishRingLocked(uint64_t head, uint64_t tail) TA_REQ(get_lock());
+
+    // The receive side, whichever of |data_| or |ring_| holds it.
+    size_t rx_size() const TA_REQ(get_lock()) {
+        return ring_ ? static_cast<size_t>(ring_head_ - ring_tail_) : data_.size();
+    }
+    size_t rx_max() const TA_REQ(get_lock()) { return ring_ ? kRingSize : data_.max_size(); }
+
+    bool is_full() const TA_REQ(get_lock()) { return ring_ ? rx_size() == kRingSize : data_.is_full(); }
+    bool is_empty() const TA_REQ(get_lock()) { return ring_ ? rx_size() == 0 : data_.is_empty(); }
 
     fbl::Canary<fbl::magic("SOCK")> canary_;
 
@@ -97,6 +123,10 @@ private:
 
     // The shared |get_lock()| protects all members below.
     MBufChain data_ TA_GUARDED(get_lock());
+    // ZX_SOCKET_RING only: the receive stream, header page first
+    const fbl::RefPtr<VmObject> ring_;
+    uint64_t ring_head_ TA_GUARDED(get_lock());
+    uint64_t ring_tail_ TA_GUARDED(get_lock());
     fbl::unique_ptr<ControlMsg> control_msg_ TA_GUARDED(get_lock());
     size_t control_msg_len_ TA_GUARDED(get_lock());
     HandleOwner accept_queue_ TA_GUARDED(get_lock());
@@ -28,8 +28,16 @@ public:
         } entry[2];
     };
 
+    // Signals value meaning "every signal".
+    static constexpr zx_signals_t kAllSignals = ~0u;
+
     StateObserver() { }
 
+    // |interest| is the set of signals whose changes this observer needs to
+    // see.  OnStateChange() is not called for changes that only affect other
+    // signals, which saves visiting observers that would ignore the change.
+    explicit StateObserver(zx_signals_t interest) : interest_(interest) { }
+
     typedef unsigned Flags;
 
     // Bitmask of return values for On...() methods
@@ -68,12 +76,19 @@ public:
     // is safe to delete the observer.
     virtual void OnRemoved() {}
 
+    zx_signals_t interest() const { return interest_; }
+
 protected:
     ~StateObserver() {}
 
+    // Changes the interest set.  Only valid while not added to a dispatcher.
+    void set_interest(zx_signals_t interest) { interest_ = interest; }
+
 private:
     fbl::Canary<fbl::magic("SOBS")> canary_;
 
+    zx_signals_t interest_ = kAllSignals;
+
     friend struct StateObserverListTraits;
     fbl::DoublyLinkedListNodeState<StateObserver*> state_observer_list_node_state_;
 };
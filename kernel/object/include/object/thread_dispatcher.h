@@ -73,6 +73,10 @@ public:
                               zx_rights_t* out_rights);
     ~ThreadDispatcher();
 
+    // Threads come from an object cache rather than straight from the heap.
+    static void* operator new(size_t size, fbl::AllocChecker* ac) noexcept;
+    static void operator delete(void* ptr);
+
     static ThreadDispatcher* GetCurrent() {
         return reinterpret_cast<ThreadDispatcher*>(get_current_thread()->user_thread);
     }
@@ -98,6 +102,19 @@ public:
     zx_status_t set_name(const char* name, size_t len) final __NONNULL((2));
     void get_name(char out_name[ZX_MAX_NAME_LEN]) const final __NONNULL((2));
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
+    // The underlying kernel thread, for arch code that keeps per-thread
+    // hardware state such as Intel PT. Lives as long as this dispatcher.
+    thread_t* thread() { return &thread_; }
+
+    // Priority inheritance through user mode futexes; see FutexContext and
+    // thread_futex_pi_acquire().
+    void FutexPiAcquire(int priority) TA_REQ(thread_lock) {
+        thread_futex_pi_acquire(&thread_, priority);
+    }
+    void FutexPiBoost(int priority) TA_REQ(thread_lock) {
+        thread_futex_pi_boost(&thread_, priority);
+    }
+    void FutexPiRelease() TA_REQ(thread_lock) { thread_futex_pi_release(&thread_); }
 
     zx_status_t SetExceptionPort(fbl::RefPtr<ExceptionPort> eport);
     // Returns true if a port had been set.
@@ -154,6 +171,9 @@ public:
                            size_t buffer_len);
     // Profile support
     zx_status_t SetPriority(int32_t priority);
+    zx_status_t SetDeadline(zx_duration_t capacity, zx_duration_t relative_deadline,
+                            zx_duration_t period);
+    zx_status_t SetCpuAffinity(cpu_mask_t mask);
 
     // For ChannelDispatcher use.
     ChannelDispatcher::MessageWaiter* GetMessageWaiter() { return &channel_waiter_; }
@@ -242,7 +262,7 @@ private:
         EVENT_INITIAL_VALUE(exception_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
 
     // cleanup dpc structure
-    dpc_t cleanup_dpc_ = {LIST_INITIAL_CLEARED_VALUE, nullptr, nullptr};
+    dpc_t cleanup_dpc_ = {LIST_INITIAL_CLEARED_VALUE, nullptr, nullptr, DPC_PRIORITY_NORMAL, 0};
 
     // Tracks the number of times Suspend() has been called. Resume() will resume this thread
     // only when this reference count reaches 0.
@@ -27,6 +27,8 @@ public:
     // VmObjectChildObserver implementation.
     void OnZeroChild() final;
     void OnOneChild() final;
+    void OnPagesDiscarded() final;
+    void OnDiscardAcknowledged() final;
 
     // SoloDispatcher implementation.
     zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_VMO; }
@@ -43,6 +45,9 @@ public:
     zx_status_t GetSize(uint64_t* size);
     zx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size, user_inout_ptr<void> buffer,
                         size_t buffer_size, zx_rights_t rights);
+    // Runs every entry of |ops| in order and writes back its status.
+    zx_status_t RangeOpBatch(user_inout_ptr<zx_vmo_op_range_entry_t> ops, size_t count,
+                             zx_rights_t rights);
     zx_status_t Clone(
         uint32_t options, uint64_t offset, uint64_t size, bool copy_name,
         fbl::RefPtr<VmObject>* clone_vmo);
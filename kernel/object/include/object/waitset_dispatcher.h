@@ -0,0 +1,83 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <zircon/rights.h>
+#include <zircon/types.h>
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <object/dispatcher.h>
+#include <object/handle.h>
+#include <object/state_observer.h>
+
+// A persistent set of handles to wait on. Unlike zx_object_wait_many(), each
+// handle is registered once and stays observed across waits: its entry
+// follows the object's signals through the StateObserver callbacks and sits
+// on a ready list while it has something to report, so a wait only looks at
+// the entries that are ready.
+//
+// Lock order: registration_lock_, then the observed object's lock, then
+// get_lock(). The observer callbacks run under the object's lock, which is
+// why adding and removing entries is serialized by a lock of its own.
+class WaitSetDispatcher final :
+    public SoloDispatcher<WaitSetDispatcher, ZX_DEFAULT_WAITSET_RIGHTS> {
+public:
+    // The most entries one wait set may hold.
+    static constexpr size_t kMaxEntries = 4096u;
+
+    static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                              zx_rights_t* rights);
+
+    ~WaitSetDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_WAITSET; }
+    void on_zero_handles() final;
+
+    // Starts observing |signals| on the object |handle| refers to,
+    // identified by |key| in the results. Must be called with the handle
+    // table lock held.
+    zx_status_t AddEntry(Handle* handle, uint64_t key, zx_signals_t signals, uint32_t options);
+
+    // Stops observing the entry for |key|.
+    zx_status_t RemoveEntry(uint64_t key);
+
+    // Blocks until at least one entry is ready or |deadline| passes, then
+    // fills in up to |count| results. An entry whose handle was closed is
+    // reported once with ZX_ERR_CANCELED and then dropped from the set.
+    zx_status_t Wait(zx_time_t deadline, zx_waitset_result_t* results, size_t count,
+                     size_t* actual);
+
+private:
+    class Entry;
+    struct ReadyListTraits;
+
+    WaitSetDispatcher();
+
+    // Called by the entries, with the observed object's lock held.
+    void OnEntryReady(Entry* entry) TA_REQ(get_lock());
+    void OnEntryNotReady(Entry* entry) TA_REQ(get_lock());
+
+    // Takes |entry| out of the set. If it is still observing its object,
+    // returns the object; the caller must then cancel the entry on it, and
+    // the entry frees itself once it is off the object's observer list.
+    // Otherwise the caller frees the entry.
+    fbl::RefPtr<Dispatcher> TakeEntryLocked(Entry* entry) TA_REQ(get_lock());
+
+    fbl::Canary<fbl::magic("WSET")> canary_;
+
+    DECLARE_MUTEX(WaitSetDispatcher) registration_lock_;
+
+    fbl::WAVLTree<uint64_t, Entry*> entries_ TA_GUARDED(get_lock());
+    fbl::DoublyLinkedList<Entry*, ReadyListTraits> ready_ TA_GUARDED(get_lock());
+
+    // signaled while |ready_| is not empty
+    event_t event_;
+};
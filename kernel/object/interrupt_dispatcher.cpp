@@ -10,10 +10,12 @@
 #include <object/process_dispatcher.h>
 #include <platform.h>
 #include <zircon/syscalls/port.h>
+#include <zircon/time.h>
 
 InterruptDispatcher::InterruptDispatcher()
     : timestamp_(0), state_(InterruptState::IDLE) {
     event_init(&event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+    timer_init(&moderation_timer_);
 }
 
 zx_status_t InterruptDispatcher::WaitForInterrupt(zx_time_t* out_timestamp) {
@@ -62,14 +64,67 @@ zx_status_t InterruptDispatcher::WaitForInterrupt(zx_time_t* out_timestamp) {
 }
 
 bool InterruptDispatcher::SendPacketLocked(zx_time_t timestamp) {
-    bool status = port_dispatcher_->QueueInterruptPacket(&port_packet_, timestamp);
+    bool status = port_dispatcher_->QueueInterruptPacket(&port_packet_, timestamp,
+                                                         pending_count_);
     if (flags_ & INTERRUPT_MASK_POSTWAIT) {
         MaskInterrupt();
     }
     timestamp_ = 0;
+    pending_count_ = 0;
     return status;
 }
 
+bool InterruptDispatcher::ModerationDueLocked(zx_time_t now, zx_time_t* due) {
+    DEBUG_ASSERT(pending_count_ > 0);
+    *due = zx_time_add_duration(pending_since_, moderation_interval_);
+    return now >= *due ||
+           (moderation_count_ != 0 && pending_count_ >= moderation_count_);
+}
+
+bool InterruptDispatcher::FlushPendingLocked(zx_time_t now) {
+    zx_time_t due;
+    if (!ModerationDueLocked(now, &due)) {
+        // An armed timer fires no later than |due|, which is measured from
+        // the first pending interrupt, and re-arms itself if it is early.
+        if (!moderation_timer_armed_) {
+            moderation_timer_armed_ = true;
+            // The callback may still be on its way out on another cpu, past
+            // the lock, and the timer can't be set until it is done.
+            timer_cancel(&moderation_timer_);
+            timer_set_oneshot(&moderation_timer_, due, ModerationTimerCallback, this);
+        }
+        state_ = InterruptState::IDLE;
+        return true;
+    }
+
+    if (!SendPacketLocked(timestamp_)) {
+        return false;
+    }
+    state_ = InterruptState::NEEDACK;
+    return true;
+}
+
+void InterruptDispatcher::ModerationTimerCallback(timer_t* timer, zx_time_t now, void* arg) {
+    auto thiz = static_cast<InterruptDispatcher*>(arg);
+    Guard<SpinLock, IrqSave> guard{&thiz->spinlock_};
+
+    thiz->moderation_timer_armed_ = false;
+    if (thiz->state_ != InterruptState::IDLE || !thiz->port_dispatcher_ ||
+        thiz->pending_count_ == 0) {
+        return;
+    }
+
+    zx_time_t due;
+    if (!thiz->ModerationDueLocked(now, &due)) {
+        // Armed for an earlier batch that went out on its count. If Destroy()
+        // canceled the timer meanwhile, this does nothing.
+        thiz->moderation_timer_armed_ = true;
+        timer_set_oneshot(timer, due, ModerationTimerCallback, thiz);
+        return;
+    }
+    thiz->FlushPendingLocked(now);
+}
+
 zx_status_t InterruptDispatcher::Trigger(zx_time_t timestamp) {
 
     if (!(flags_ & INTERRUPT_VIRTUAL))
@@ -88,15 +143,17 @@ zx_status_t InterruptDispatcher::Trigger(zx_time_t timestamp) {
     if (state_ == InterruptState::DESTROYED) {
         return ZX_ERR_CANCELED;
     }
-    if (state_ == InterruptState::NEEDACK && port_dispatcher_) {
-        // Cannot trigger a interrupt without ACK
-        // only record timestamp if this is the first signal since we started waiting
-        return ZX_OK;
-    }
 
     if (port_dispatcher_) {
-        SendPacketLocked(timestamp);
-        state_ = InterruptState::NEEDACK;
+        const zx_time_t now = current_time();
+        if (pending_count_++ == 0) {
+            pending_since_ = now;
+        }
+        // Cannot trigger a interrupt without ACK; it is counted towards the
+        // next packet.
+        if (state_ != InterruptState::NEEDACK) {
+            FlushPendingLocked(now);
+        }
     } else {
         Signal();
         state_ = InterruptState::TRIGGERED;
@@ -107,16 +164,23 @@ zx_status_t InterruptDispatcher::Trigger(zx_time_t timestamp) {
 void InterruptDispatcher::InterruptHandler() {
     Guard<SpinLock, IrqSave> guard{&spinlock_};
 
+    // a handler racing with Destroy() on another cpu
+    if (state_ == InterruptState::DESTROYED) {
+        return;
+    }
+
+    const zx_time_t now = current_time();
     // only record timestamp if this is the first IRQ since we started waiting
     if (!timestamp_) {
-        timestamp_ = current_time();
-    }
-    if (state_ == InterruptState::NEEDACK && port_dispatcher_) {
-        return;
+        timestamp_ = now;
     }
     if (port_dispatcher_) {
-        SendPacketLocked(timestamp_);
-        state_ = InterruptState::NEEDACK;
+        if (pending_count_++ == 0) {
+            pending_since_ = now;
+        }
+        if (state_ != InterruptState::NEEDACK) {
+            FlushPendingLocked(now);
+        }
     } else {
         if (flags_ & INTERRUPT_MASK_POSTWAIT) {
             MaskInterrupt();
@@ -127,12 +191,24 @@ void InterruptDispatcher::InterruptHandler() {
 }
 
 zx_status_t InterruptDispatcher::Destroy() {
-    // Using AutoReschedDisable is necessary for correctness to prevent
-    // context-switching to the woken thread while holding spinlock_.
-    AutoReschedDisable resched_disable;
-    resched_disable.Disable();
-    Guard<SpinLock, IrqSave> guard{&spinlock_};
+    zx_status_t status;
+    {
+        // Using AutoReschedDisable is necessary for correctness to prevent
+        // context-switching to the woken thread while holding spinlock_.
+        AutoReschedDisable resched_disable;
+        resched_disable.Disable();
+        Guard<SpinLock, IrqSave> guard{&spinlock_};
+        status = DestroyLocked();
+    }
 
+    // Nothing arms the timer once destroyed. It is canceled without the lock
+    // held because its callback takes the lock, and canceling waits for a
+    // callback running on another cpu.
+    timer_cancel(&moderation_timer_);
+    return status;
+}
+
+zx_status_t InterruptDispatcher::DestroyLocked() {
     MaskInterrupt();
     UnregisterInterruptHandler();
 
@@ -190,8 +266,8 @@ zx_status_t InterruptDispatcher::Ack() {
         if (flags_ & INTERRUPT_UNMASK_PREWAIT) {
             UnmaskInterrupt();
         }
-        if (timestamp_) {
-            if (!SendPacketLocked(timestamp_)) {
+        if (pending_count_ > 0) {
+            if (!FlushPendingLocked(current_time())) {
                 // We cannot queue another packet here.
                 // If we reach here it means that the
                 // interrupt packet has not been processed,
@@ -206,6 +282,32 @@ zx_status_t InterruptDispatcher::Ack() {
     return ZX_OK;
 }
 
+zx_status_t InterruptDispatcher::SetModeration(zx_duration_t interval, uint32_t count) {
+    // Level triggered interrupts stay masked until acked, so there is
+    // nothing to coalesce.
+    if (flags_ & INTERRUPT_MASK_POSTWAIT) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (interval < 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    AutoReschedDisable resched_disable;
+    resched_disable.Disable();
+    Guard<SpinLock, IrqSave> guard{&spinlock_};
+    if (state_ == InterruptState::DESTROYED) {
+        return ZX_ERR_CANCELED;
+    }
+
+    moderation_interval_ = interval;
+    moderation_count_ = count;
+    // Interrupts held back under the old settings may be due under the new.
+    if (state_ == InterruptState::IDLE && port_dispatcher_ && pending_count_ > 0) {
+        FlushPendingLocked(current_time());
+    }
+    return ZX_OK;
+}
+
 void InterruptDispatcher::on_zero_handles() {
     Destroy();
 }
@@ -107,6 +107,10 @@ void InterruptEventDispatcher::IrqHandler(void* ctx) {
     thiz->InterruptHandler();
 }
 
+zx_status_t InterruptEventDispatcher::SetAffinity(cpu_num_t cpu) {
+    return set_interrupt_affinity(vector_, cpu);
+}
+
 void InterruptEventDispatcher::MaskInterrupt() {
     mask_interrupt(vector_);
 }
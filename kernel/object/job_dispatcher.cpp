@@ -310,34 +310,46 @@ bool JobDispatcher::Kill() {
     JobList jobs_to_kill;
     ProcessList procs_to_kill;
 
-    LiveRefsArray jobs_refs;
-    LiveRefsArray proc_refs;
-
-    {
-        Guard<fbl::Mutex> guard{get_lock()};
-        if (state_ != State::READY)
+    // Moves |job| to KILLING and gathers its children. Child jobs land on
+    // |jobs_to_kill| so that the whole subtree stops accepting new children
+    // before any process is torn down, without recursing per level.
+    auto mark_killing = [&](JobDispatcher* job) -> bool {
+        // Declared before |guard| so they are released after the lock.
+        LiveRefsArray jobs_refs;
+        LiveRefsArray proc_refs;
+
+        Guard<fbl::Mutex> guard{job->get_lock()};
+        if (job->state_ != State::READY)
             return false;
 
-        state_ = State::KILLING;
+        job->state_ = State::KILLING;
         zx_status_t result;
 
         // Safely gather refs to the children.
-        jobs_refs = ForEachChildInLocked(jobs_, &result, [&](fbl::RefPtr<JobDispatcher> job) {
-            jobs_to_kill.push_front(fbl::move(job));
-            return ZX_OK;
-        });
-        proc_refs = ForEachChildInLocked(procs_, &result, [&](fbl::RefPtr<ProcessDispatcher> proc) {
-            procs_to_kill.push_front(fbl::move(proc));
-            return ZX_OK;
-        });
-    }
+        jobs_refs = job->ForEachChildInLocked(
+            job->jobs_, &result, [&](fbl::RefPtr<JobDispatcher> child) {
+                jobs_to_kill.push_front(fbl::move(child));
+                return ZX_OK;
+            });
+        proc_refs = job->ForEachChildInLocked(
+            job->procs_, &result, [&](fbl::RefPtr<ProcessDispatcher> proc) {
+                procs_to_kill.push_front(fbl::move(proc));
+                return ZX_OK;
+            });
+        return true;
+    };
+
+    if (!mark_killing(this))
+        return false;
 
-    // Since we kill the child jobs first we have a depth-first massacre.
     while (!jobs_to_kill.is_empty()) {
-        // TODO(cpu): This recursive call can overflow the stack.
-        jobs_to_kill.pop_front()->Kill();
+        // A job only reaches this list through its parent's READY ->
+        // KILLING transition, so it is gathered at most once.
+        mark_killing(jobs_to_kill.pop_front().get());
     }
 
+    // Process teardown that doesn't need a dying thread is handed off to
+    // the process reaper, so this loop only flips states.
     while (!procs_to_kill.is_empty()) {
         procs_to_kill.pop_front()->Kill();
     }
@@ -8,8 +8,13 @@
 
 #include <err.h>
 #include <fbl/algorithm.h>
+#include <kernel/thread.h>
 #include <stdint.h>
 #include <string.h>
+#include <vm/vm.h>
+#include <vm/vm_address_region.h>
+#include <vm/vm_aspace.h>
+#include <vm/vm_object.h>
 #include <zxcpp/new.h>
 
 // MessagePackets have special allocation requirements because they can contain a variable number of
@@ -36,24 +41,31 @@ static inline uint32_t PayloadOffset(uint32_t num_handles) {
     return kHandlesOffset + num_handles * static_cast<uint32_t>(sizeof(Handle*));
 }
 
-// Creates a MessagePacket in |msg| sufficient to hold |data_size| bytes and |num_handles|.
+// Messages with fewer whole pages than this are always copied; below it,
+// unmapping the sender's pages costs more than copying them.
+static constexpr size_t kMinMovedPages = 4;
+
+// Creates a MessagePacket in |msg| for |data_size| bytes and |num_handles|, with room in its
+// chain for |chain_size| bytes of payload.
 //
 // Note: This method does not write the payload into the MessagePacket.
 //
 // Returns ZX_OK on success.
 //
 // static
-inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_handles,
+inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t chain_size,
+                                               uint32_t num_handles,
                                                fbl::unique_ptr<MessagePacket>* msg) {
     if (unlikely(data_size > kMaxMessageSize || num_handles > kMaxMessageHandles)) {
         return ZX_ERR_OUT_OF_RANGE;
     }
+    DEBUG_ASSERT(chain_size <= data_size);
 
     const uint32_t payload_offset = PayloadOffset(num_handles);
 
     // MessagePackets lives *inside* a list of buffers.  The first buffer holds the MessagePacket
     // object, followed by its handles (if any), and finally the payload data.
-    BufferChain* chain = BufferChain::Alloc(payload_offset + data_size);
+    BufferChain* chain = BufferChain::Alloc(payload_offset + chain_size);
     if (unlikely(!chain)) {
         return ZX_ERR_NO_MEMORY;
     }
@@ -76,7 +88,7 @@ inline zx_status_t MessagePacket::CreateCommon(uint32_t data_size, uint32_t num_
 zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_size,
                                   uint32_t num_handles, fbl::unique_ptr<MessagePacket>* msg) {
     fbl::unique_ptr<MessagePacket> new_msg;
-    zx_status_t status = CreateCommon(data_size, num_handles, &new_msg);
+    zx_status_t status = CreateCommon(data_size, data_size, num_handles, &new_msg);
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -92,7 +104,7 @@ zx_status_t MessagePacket::Create(user_in_ptr<const void> data, uint32_t data_si
 zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t num_handles,
                                   fbl::unique_ptr<MessagePacket>* msg) {
     fbl::unique_ptr<MessagePacket> new_msg;
-    zx_status_t status = CreateCommon(data_size, num_handles, &new_msg);
+    zx_status_t status = CreateCommon(data_size, data_size, num_handles, &new_msg);
     if (unlikely(status != ZX_OK)) {
         return status;
     }
@@ -104,9 +116,190 @@ zx_status_t MessagePacket::Create(const void* data, uint32_t data_size, uint32_t
     return ZX_OK;
 }
 
+// Moves the pages backing [va, va + len) in the current address space out of the VMO mapped
+// there and appends them to |pages|. The range must lie within one writable mapping.
+static zx_status_t TakeUserPages(vaddr_t va, size_t len, list_node* pages) {
+    VmAspace* aspace = vmm_aspace_to_obj(get_current_thread()->aspace);
+    if (!aspace || !aspace->is_user()) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    fbl::RefPtr<VmAddressRegionOrMapping> region = aspace->FindRegion(va);
+    if (!region || !region->is_mapping()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    fbl::RefPtr<VmMapping> mapping = region->as_vm_mapping();
+
+    fbl::RefPtr<VmObject> vmo;
+    uint64_t offset;
+    {
+        Guard<fbl::Mutex> guard{aspace->lock()};
+        // the mapping may have changed since the lookup; a destroyed one has no size
+        if (va < mapping->base() || va - mapping->base() > mapping->size() ||
+            mapping->size() - (va - mapping->base()) < len) {
+            return ZX_ERR_NOT_FOUND;
+        }
+        // the sender's bytes read as zero afterwards, which it must be allowed to do itself
+        if (!(mapping->arch_mmu_flags() & ARCH_MMU_FLAG_PERM_WRITE)) {
+            return ZX_ERR_ACCESS_DENIED;
+        }
+        vmo = mapping->vmo();
+        offset = mapping->object_offset() + (va - mapping->base());
+    }
+
+    list_node taken = LIST_INITIAL_VALUE(taken);
+    zx_status_t status = vmo->TakePages(offset, len, &taken);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    vm_page_t* page;
+    list_for_every_entry (&taken, page, vm_page_t, queue_node) {
+        page->state = VM_PAGE_STATE_IPC;
+    }
+    list_splice_after(&taken, pages->prev);
+    return ZX_OK;
+}
+
+// static
+zx_status_t MessagePacket::CreateMovingPages(user_in_ptr<const void> data, uint32_t data_size,
+                                             uint32_t num_handles,
+                                             fbl::unique_ptr<MessagePacket>* msg) {
+    // The leading bytes of the payload are always copied so the txid stays in the first buffer.
+    const vaddr_t start = reinterpret_cast<vaddr_t>(data.get());
+    if (data_size > kMaxMessageSize || !is_user_address_range(start, data_size)) {
+        return Create(data, data_size, num_handles, msg);
+    }
+    const vaddr_t move_start = ROUNDUP(start + sizeof(zx_txid_t), PAGE_SIZE);
+    const vaddr_t move_end = ROUNDDOWN(start + data_size, PAGE_SIZE);
+    if (move_end < move_start || move_end - move_start < kMinMovedPages * PAGE_SIZE) {
+        return Create(data, data_size, num_handles, msg);
+    }
+
+    const uint32_t head_size = static_cast<uint32_t>(move_start - start);
+    const uint32_t moved_size = static_cast<uint32_t>(move_end - move_start);
+    const uint32_t tail_size = data_size - head_size - moved_size;
+
+    // Copy everything that can fail before taking the pages, which can't be given back.
+    fbl::unique_ptr<MessagePacket> new_msg;
+    zx_status_t status = CreateCommon(data_size, head_size + tail_size, num_handles, &new_msg);
+    if (unlikely(status != ZX_OK)) {
+        return status;
+    }
+    const uint32_t payload_offset = PayloadOffset(num_handles);
+    BufferChain* chain = new_msg->buffer_chain_;
+    status = chain->CopyIn(data, payload_offset, head_size);
+    if (unlikely(status != ZX_OK)) {
+        return status;
+    }
+    status = chain->CopyIn(data.byte_offset(head_size + moved_size), payload_offset + head_size,
+                           tail_size);
+    if (unlikely(status != ZX_OK)) {
+        return status;
+    }
+
+    if (TakeUserPages(move_start, moved_size, &new_msg->moved_pages_) != ZX_OK) {
+        return Create(data, data_size, num_handles, msg);
+    }
+    new_msg->moved_offset_ = head_size;
+    new_msg->moved_size_ = moved_size;
+
+    *msg = fbl::move(new_msg);
+    return ZX_OK;
+}
+
+// static
+zx_status_t MessagePacket::Create(const zx_channel_iovec_t* iovecs, uint32_t num_iovecs,
+                                  uint32_t num_handles, fbl::unique_ptr<MessagePacket>* msg) {
+    if (unlikely(num_iovecs > kMaxMessageIovecs)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    uint32_t data_size = 0u;
+    for (uint32_t i = 0; i < num_iovecs; ++i) {
+        if (unlikely(iovecs[i].reserved != 0u)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (unlikely(add_overflow(data_size, iovecs[i].capacity, &data_size))) {
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+    }
+
+    fbl::unique_ptr<MessagePacket> new_msg;
+    zx_status_t status = CreateCommon(data_size, data_size, num_handles, &new_msg);
+    if (unlikely(status != ZX_OK)) {
+        return status;
+    }
+    uint32_t offset = PayloadOffset(num_handles);
+    for (uint32_t i = 0; i < num_iovecs; ++i) {
+        status = new_msg->buffer_chain_->CopyIn(make_user_in_ptr<const void>(iovecs[i].buffer),
+                                                offset, iovecs[i].capacity);
+        if (unlikely(status != ZX_OK)) {
+            return status;
+        }
+        offset += iovecs[i].capacity;
+    }
+    *msg = fbl::move(new_msg);
+    return ZX_OK;
+}
+
+zx_status_t MessagePacket::CopyDataRangeTo(user_out_ptr<void> buf, uint32_t offset,
+                                           uint32_t len) const {
+    DEBUG_ASSERT(offset <= data_size_ && len <= data_size_ - offset);
+
+    // The chain holds everything but the moved pages, back to back.
+    const uint32_t moved_end = moved_offset_ + moved_size_;
+    while (len > 0u) {
+        uint32_t n;
+        zx_status_t status;
+        if (offset < moved_offset_ || offset >= moved_end) {
+            const bool before = offset < moved_offset_;
+            n = fbl::min(len, (before ? moved_offset_ : data_size_) - offset);
+            const uint32_t chain_offset = before ? offset : offset - moved_size_;
+            status = buffer_chain_->CopyOut(buf, payload_offset_ + chain_offset, n);
+        } else {
+            const uint32_t page_offset = offset - moved_offset_;
+            const list_node* node = moved_pages_.next;
+            for (uint32_t i = page_offset / PAGE_SIZE; i > 0u; --i) {
+                node = node->next;
+            }
+            DEBUG_ASSERT(node != &moved_pages_);
+            const vm_page_t* page = containerof(node, vm_page_t, queue_node);
+            const uint32_t in_page = page_offset % PAGE_SIZE;
+            n = fbl::min(len, static_cast<uint32_t>(PAGE_SIZE) - in_page);
+            const char* src = static_cast<const char*>(paddr_to_physmap(page->paddr()));
+            status = buf.copy_array_to_user(src + in_page, n);
+        }
+        if (unlikely(status != ZX_OK)) {
+            return status;
+        }
+        buf = buf.byte_offset(n);
+        offset += n;
+        len -= n;
+    }
+    return ZX_OK;
+}
+
+zx_status_t MessagePacket::CopyDataTo(const zx_channel_iovec_t* iovecs,
+                                      uint32_t num_iovecs) const {
+    uint32_t offset = 0u;
+    for (uint32_t i = 0; i < num_iovecs && offset < data_size_; ++i) {
+        const uint32_t n = fbl::min(iovecs[i].capacity, data_size_ - offset);
+        zx_status_t status = CopyDataRangeTo(make_user_out_ptr(iovecs[i].buffer), offset, n);
+        if (unlikely(status != ZX_OK)) {
+            return status;
+        }
+        offset += n;
+    }
+    DEBUG_ASSERT(offset == data_size_);
+    return ZX_OK;
+}
+
 void MessagePacket::fbl_recycle() {
     // This function invokes the destructor so be careful about taking any references to |this|.
     BufferChain* chain = buffer_chain_;
+    if (!list_is_empty(&moved_pages_)) {
+        pmm_free(&moved_pages_);
+    }
     this->~MessagePacket();
     // |this| has been destroyed.
     BufferChain::Free(chain);
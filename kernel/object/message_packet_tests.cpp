@@ -6,6 +6,7 @@
 
 #include <object/message_packet.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
 #include <lib/unittest/unittest.h>
 #include <lib/unittest/user_memory.h>
@@ -141,6 +142,98 @@ static bool copy_bad_mem() {
     END_TEST;
 }
 
+// Create a MessagePacket that moves pages out of the sender and call CopyDataTo.
+static bool create_moving_pages() {
+    BEGIN_TEST;
+    constexpr size_t kOffset = 24;
+    constexpr size_t kSize = 10 * PAGE_SIZE + 100;
+    fbl::unique_ptr<UserMemory> mem = UserMemory::Create(kOffset + kSize);
+    fbl::unique_ptr<UserMemory> mem_result = UserMemory::Create(kSize);
+    auto mem_in = make_user_in_ptr(mem->in());
+    auto mem_out = make_user_out_ptr(mem->out());
+    auto result_out = make_user_out_ptr(mem_result->out());
+    auto result_in = make_user_in_ptr(mem_result->in());
+
+    fbl::AllocChecker ac;
+    auto buf = fbl::unique_ptr<char[]>(new (&ac) char[kSize]);
+    ASSERT_TRUE(ac.check(), "");
+    for (size_t i = 0; i < kSize; ++i) {
+        buf[i] = static_cast<char>(i % 251 + 1);
+    }
+    ASSERT_EQ(ZX_OK, mem_out.byte_offset(kOffset).copy_array_to_user(buf.get(), kSize), "");
+
+    fbl::unique_ptr<MessagePacket> mp;
+    EXPECT_EQ(ZX_OK, MessagePacket::CreateMovingPages(mem_in.byte_offset(kOffset), kSize, 0, &mp),
+              "");
+    ASSERT_EQ(kSize, mp->data_size(), "");
+    EXPECT_NE(0U, mp->get_txid(), "");
+
+    // The first whole page of the buffer was moved, so it's zero now.
+    auto page = fbl::unique_ptr<char[]>(new (&ac) char[PAGE_SIZE]);
+    ASSERT_TRUE(ac.check(), "");
+    ASSERT_EQ(ZX_OK, mem_in.byte_offset(PAGE_SIZE).copy_array_from_user(page.get(), PAGE_SIZE),
+              "");
+    for (size_t i = 0; i < PAGE_SIZE; ++i) {
+        ASSERT_EQ(0, page[i], "");
+    }
+
+    auto result_buf = fbl::unique_ptr<char[]>(new (&ac) char[kSize]);
+    ASSERT_TRUE(ac.check(), "");
+    ASSERT_EQ(ZX_OK, mp->CopyDataTo(result_out), "");
+    ASSERT_EQ(ZX_OK, result_in.copy_array_from_user(result_buf.get(), kSize), "");
+    EXPECT_EQ(0, memcmp(buf.get(), result_buf.get(), kSize), "");
+    END_TEST;
+}
+
+// Create a MessagePacket from several buffers and scatter it back out.
+static bool create_iovecs() {
+    BEGIN_TEST;
+    constexpr size_t kSize = 3 * PAGE_SIZE;
+    fbl::unique_ptr<UserMemory> mem = UserMemory::Create(kSize);
+    fbl::unique_ptr<UserMemory> mem_result = UserMemory::Create(kSize);
+    auto mem_out = make_user_out_ptr(mem->out());
+    auto result_in = make_user_in_ptr(mem_result->in());
+
+    fbl::AllocChecker ac;
+    auto buf = fbl::unique_ptr<char[]>(new (&ac) char[kSize]);
+    ASSERT_TRUE(ac.check(), "");
+    for (size_t i = 0; i < kSize; ++i) {
+        buf[i] = static_cast<char>(i % 251 + 1);
+    }
+    ASSERT_EQ(ZX_OK, mem_out.copy_array_to_user(buf.get(), kSize), "");
+
+    // Gather out of order so the result shows the iovecs were followed.
+    char* base = static_cast<char*>(mem->out());
+    const zx_channel_iovec_t in_iovecs[] = {
+        {base + 2 * PAGE_SIZE, 100, 0},
+        {base, 5000, 0},
+        {base + 6000, 0, 0},
+        {base + 7000, 300, 0},
+    };
+    constexpr uint32_t kTotal = 100 + 5000 + 300;
+    fbl::unique_ptr<MessagePacket> mp;
+    ASSERT_EQ(ZX_OK, MessagePacket::Create(in_iovecs, fbl::count_of(in_iovecs), 0, &mp), "");
+    ASSERT_EQ(kTotal, mp->data_size(), "");
+
+    char* result_base = static_cast<char*>(mem_result->out());
+    const zx_channel_iovec_t out_iovecs[] = {
+        {result_base, 4000, 0},
+        {result_base + 4000, 4000, 0},
+    };
+    ASSERT_EQ(ZX_OK, mp->CopyDataTo(out_iovecs, fbl::count_of(out_iovecs)), "");
+
+    auto result_buf = fbl::unique_ptr<char[]>(new (&ac) char[kTotal]);
+    ASSERT_TRUE(ac.check(), "");
+    ASSERT_EQ(ZX_OK, result_in.copy_array_from_user(result_buf.get(), kTotal), "");
+    EXPECT_EQ(0, memcmp(buf.get() + 2 * PAGE_SIZE, result_buf.get(), 100), "");
+    EXPECT_EQ(0, memcmp(buf.get(), result_buf.get() + 100, 5000), "");
+    EXPECT_EQ(0, memcmp(buf.get() + 7000, result_buf.get() + 5100, 300), "");
+
+    const zx_channel_iovec_t bad_iovecs[] = {{base, 10, 1}};
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, MessagePacket::Create(bad_iovecs, 1, 0, &mp), "");
+    END_TEST;
+}
+
 }  // namespace
 
 UNITTEST_START_TESTCASE(message_packet_tests)
@@ -150,4 +243,6 @@ UNITTEST("create_zero", create_zero)
 UNITTEST("create_too_many_handles", create_too_many_handles)
 UNITTEST("create_bad_mem", create_bad_mem)
 UNITTEST("copy_bad_mem", copy_bad_mem)
+UNITTEST("create_moving_pages", create_moving_pages)
+UNITTEST("create_iovecs", create_iovecs)
 UNITTEST_END_TESTCASE(message_packet_tests, "message_packet", "MessagePacket tests");
@@ -0,0 +1,155 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <err.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_call.h>
+#include <lib/counters.h>
+#include <vm/pmm.h>
+#include <vm/vm_object_paged.h>
+
+#include <zircon/syscalls/port.h>
+
+KCOUNTER(dispatcher_pager_create_count, "dispatcher.pager.create");
+KCOUNTER(dispatcher_pager_destroy_count, "dispatcher.pager.destroy");
+
+// Turns page requests for one VMO into packets on the pager's port.
+class PagerDispatcher::PagerSource final :
+    public PageSource, public fbl::DoublyLinkedListable<fbl::RefPtr<PagerSource>> {
+public:
+    PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                uint64_t key)
+        : PageSource(pager->get_koid()), pager_(fbl::move(pager)), port_(fbl::move(port)),
+          key_(key) {}
+
+    void Close() final {
+        pager_->RemoveSource(this);
+    }
+
+protected:
+    zx_status_t SendRequest(uint64_t offset, uint64_t len) final {
+        auto port_packet = PortDispatcher::DefaultPortAllocator()->Alloc();
+        if (!port_packet) {
+            return ZX_ERR_NO_MEMORY;
+        }
+
+        port_packet->packet.key = key_;
+        port_packet->packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+        port_packet->packet.status = ZX_OK;
+        port_packet->packet.page_request.command = ZX_PAGER_VMO_READ;
+        port_packet->packet.page_request.flags = 0;
+        port_packet->packet.page_request.reserved0 = 0;
+        port_packet->packet.page_request.offset = offset;
+        port_packet->packet.page_request.length = len;
+        port_packet->packet.page_request.reserved1 = 0;
+
+        zx_status_t status = port_->Queue(port_packet, 0, 0);
+        if (status != ZX_OK) {
+            port_packet->Free();
+            // a full port isn't something the faulting thread can wait out
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                status = ZX_ERR_NO_RESOURCES;
+            }
+        }
+        return status;
+    }
+
+private:
+    const fbl::RefPtr<PagerDispatcher> pager_;
+    const fbl::RefPtr<PortDispatcher> port_;
+    const uint64_t key_;
+};
+
+zx_status_t PagerDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights) {
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = default_rights();
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() {
+    kcounter_add(dispatcher_pager_create_count, 1);
+}
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+    kcounter_add(dispatcher_pager_destroy_count, 1);
+}
+
+void PagerDispatcher::on_zero_handles() {
+    fbl::DoublyLinkedList<fbl::RefPtr<PagerSource>> sources;
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        sources.swap(sources_);
+    }
+
+    // nobody is left to answer, so fail everything that is waiting
+    while (!sources.is_empty()) {
+        sources.pop_front()->Detach();
+    }
+}
+
+zx_status_t PagerDispatcher::CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                       uint64_t size, fbl::RefPtr<VmObject>* vmo) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto src = fbl::AdoptRef(new (&ac) PagerSource(fbl::WrapRefPtr(this), fbl::move(port), key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    zx_status_t status = VmObjectPaged::CreateWithSource(PMM_ALLOC_FLAG_ANY, size, src, vmo);
+    if (status != ZX_OK)
+        return status;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    sources_.push_back(fbl::move(src));
+    return ZX_OK;
+}
+
+void PagerDispatcher::RemoveSource(PagerSource* src) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (src->InContainer()) {
+        sources_.erase(*src);
+    }
+}
+
+zx_status_t PagerDispatcher::SupplyPages(fbl::RefPtr<VmObject> vmo, uint64_t offset, uint64_t len,
+                                         fbl::RefPtr<VmObject> aux, uint64_t aux_offset) {
+    canary_.Assert();
+
+    if (!vmo->is_pager_backed())
+        return ZX_ERR_INVALID_ARGS;
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len))
+        return ZX_ERR_INVALID_ARGS;
+
+    // catch what we can before the pages leave |aux|
+    uint64_t end;
+    if (add_overflow(offset, len, &end) || end > vmo->size())
+        return ZX_ERR_OUT_OF_RANGE;
+    if (len == 0)
+        return ZX_OK;
+
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    auto free_pages = fbl::MakeAutoCall([&pages]() {
+        if (!list_is_empty(&pages)) {
+            pmm_free(&pages);
+        }
+    });
+
+    zx_status_t status = aux->TakePages(aux_offset, len, &pages);
+    if (status != ZX_OK)
+        return status;
+
+    return vmo->SupplyPages(get_koid(), offset, len, &pages);
+}
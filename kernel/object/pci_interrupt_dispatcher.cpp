@@ -68,6 +68,10 @@ zx_status_t PciInterruptDispatcher::Create(
     return ZX_OK;
 }
 
+zx_status_t PciInterruptDispatcher::SetAffinity(cpu_num_t cpu) {
+    return device_->SetIrqAffinity(vector_, cpu);
+}
+
 void PciInterruptDispatcher::MaskInterrupt() {
     if (maskable_)
         device_->MaskIrq(vector_);
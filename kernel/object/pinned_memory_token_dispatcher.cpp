@@ -23,6 +23,7 @@
 
 zx_status_t PinnedMemoryTokenDispatcher::Create(fbl::RefPtr<BusTransactionInitiatorDispatcher> bti,
                                                 PinnedVmObject pinned_vmo, uint32_t perms,
+                                                bool cache_on_unpin,
                                                 fbl::RefPtr<Dispatcher>* dispatcher,
                                                 zx_rights_t* rights) {
     LTRACE_ENTRY;
@@ -40,11 +41,18 @@ zx_status_t PinnedMemoryTokenDispatcher::Create(fbl::RefPtr<BusTransactionInitia
 
     auto pmo = fbl::AdoptRef(new (&ac) PinnedMemoryTokenDispatcher(fbl::move(bti),
                                                                    fbl::move(pinned_vmo),
-                                                                   fbl::move(addr_array)));
+                                                                   fbl::move(addr_array),
+                                                                   perms, cache_on_unpin));
     if (!ac.check()) {
         return ZX_ERR_NO_MEMORY;
     }
 
+    // Nothing is mapped yet; a PMT made by CreateFromCached() instead
+    // inherits a live mapping, so the constructor leaves the array alone.
+    [&]() TA_NO_THREAD_SAFETY_ANALYSIS {
+        pmo->InvalidateMappedAddrsLocked();
+    }();
+
     zx_status_t status = pmo->MapIntoIommu(perms);
     if (status != ZX_OK) {
         LTRACEF("MapIntoIommu failed: %d\n", status);
@@ -62,6 +70,31 @@ zx_status_t PinnedMemoryTokenDispatcher::Create(fbl::RefPtr<BusTransactionInitia
     return ZX_OK;
 }
 
+// |cached| is at zero handles and is only reachable through the BTI's cache,
+// which the caller has already removed it from under the BTI's lock.  Nobody
+// else can touch its state, so it is moved without taking its lock.
+zx_status_t PinnedMemoryTokenDispatcher::CreateFromCached(
+    fbl::RefPtr<BusTransactionInitiatorDispatcher> bti, PinnedMemoryTokenDispatcher* cached,
+    fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights) TA_NO_THREAD_SAFETY_ANALYSIS {
+    LTRACE_ENTRY;
+    DEBUG_ASSERT(cached->bti_ == bti);
+
+    fbl::AllocChecker ac;
+    auto pmo = fbl::AdoptRef(new (&ac) PinnedMemoryTokenDispatcher(fbl::move(bti),
+                                                                   fbl::move(cached->pinned_vmo_),
+                                                                   fbl::move(cached->mapped_addrs_),
+                                                                   cached->perms_, true));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    pmo->bti_->AddPmoLocked(pmo.get());
+
+    *dispatcher = fbl::move(pmo);
+    *rights = default_rights();
+    return ZX_OK;
+}
+
 // Used during initialization to set up the IOMMU state for this PMT.
 //
 // We disable thread-safety analysis here, because this is part of the
@@ -131,8 +164,8 @@ zx_status_t PinnedMemoryTokenDispatcher::UnmapFromIommuLocked() {
     auto iommu = bti_->iommu();
     const uint64_t bus_txn_id = bti_->bti_id();
 
-    if (mapped_addrs_[0] == UINT64_MAX) {
-        // No work to do, nothing is mapped.
+    if (mapped_addrs_.size() == 0 || mapped_addrs_[0] == UINT64_MAX) {
+        // No work to do, nothing is mapped or the mapping was handed off.
         return ZX_OK;
     }
 
@@ -181,6 +214,19 @@ void PinnedMemoryTokenDispatcher::InvalidateMappedAddrsLocked() {
 }
 
 void PinnedMemoryTokenDispatcher::on_zero_handles() {
+    bool cache;
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        cache = explicitly_unpinned_ && cache_on_unpin_;
+    }
+
+    // Keep the pin and the IOMMU mapping around so the next pin of the same
+    // range can reuse them.  This is done without our lock held since the BTI
+    // takes its own lock, and reuses our state under it.
+    if (cache && bti_->CacheUnpinned(fbl::WrapRefPtr(this))) {
+        return;
+    }
+
     Guard<fbl::Mutex> guard{get_lock()};
 
     // Once usermode has dropped the handle, either through zx_handle_close(),
@@ -221,11 +267,12 @@ PinnedMemoryTokenDispatcher::~PinnedMemoryTokenDispatcher() {
 PinnedMemoryTokenDispatcher::PinnedMemoryTokenDispatcher(
     fbl::RefPtr<BusTransactionInitiatorDispatcher> bti,
     PinnedVmObject pinned_vmo,
-    fbl::Array<dev_vaddr_t> mapped_addrs)
+    fbl::Array<dev_vaddr_t> mapped_addrs,
+    uint32_t perms, bool cache_on_unpin)
     : pinned_vmo_(fbl::move(pinned_vmo)),
-      bti_(fbl::move(bti)), mapped_addrs_(fbl::move(mapped_addrs)) {
+      bti_(fbl::move(bti)), mapped_addrs_(fbl::move(mapped_addrs)),
+      perms_(perms), cache_on_unpin_(cache_on_unpin) {
     DEBUG_ASSERT(pinned_vmo_.vmo() != nullptr);
-    InvalidateMappedAddrsLocked();
 }
 
 zx_status_t PinnedMemoryTokenDispatcher::EncodeAddrs(bool compress_results,
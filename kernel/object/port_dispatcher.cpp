@@ -6,15 +6,16 @@
 
 #include <object/port_dispatcher.h>
 
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <platform.h>
 #include <pow2.h>
 
 #include <fbl/alloc_checker.h>
-#include <fbl/arena.h>
 #include <fbl/auto_lock.h>
 #include <lib/counters.h>
+#include <lib/object_cache.h>
 #include <object/excp_port.h>
 #include <object/handle.h>
 #include <object/thread_dispatcher.h>
@@ -22,6 +23,7 @@
 #include <zircon/rights.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
+#include <zxcpp/new.h>
 
 static_assert(sizeof(zx_packet_signal_t) == sizeof(zx_packet_user_t),
               "size of zx_packet_signal_t must match zx_packet_user_t");
@@ -37,16 +39,12 @@ static_assert(sizeof(zx_packet_guest_vcpu_t) == sizeof(zx_packet_user_t),
 KCOUNTER(port_arena_count, "kernel.port.arena.count");
 KCOUNTER(port_full_count, "kernel.port.full.count");
 
-class ArenaPortAllocator final : public PortAllocator {
+class CachedPortAllocator final : public PortAllocator {
 public:
-    zx_status_t Init();
-    virtual ~ArenaPortAllocator() = default;
+    virtual ~CachedPortAllocator() = default;
 
     virtual PortPacket* Alloc();
     virtual void Free(PortPacket* port_packet);
-
-private:
-    fbl::TypedArena<PortPacket, fbl::Mutex> arena_;
 };
 
 namespace {
@@ -54,26 +52,29 @@ constexpr size_t kMaxPendingPacketCount = 16 * 1024u;
 
 // TODO(maniscalco): Enforce this limit per process via the job policy.
 constexpr size_t kMaxPendingPacketCountPerPort = kMaxPendingPacketCount / 8;
-ArenaPortAllocator port_allocator;
+CachedPortAllocator port_allocator;
 } // namespace.
 
-zx_status_t ArenaPortAllocator::Init() {
-    return arena_.Init("packets", kMaxPendingPacketCount);
-}
+// Packets sit in per-cpu magazines between uses, so producers on different
+// cpus mostly stay off the heap lock. Cached packets count against the cap.
+OBJECT_CACHE(port_packet_cache, "port_packet", PortPacket, kMaxPendingPacketCount);
 
-PortPacket* ArenaPortAllocator::Alloc() {
-    PortPacket* packet = arena_.New(nullptr, this);
-    if (packet == nullptr) {
+PortPacket* CachedPortAllocator::Alloc() {
+    void* mem = port_packet_cache.Alloc();
+    if (mem == nullptr) {
         printf("WARNING: Could not allocate new port packet\n");
         return nullptr;
     }
     kcounter_add(port_arena_count, 1);
-    return packet;
+    return new (mem) PortPacket(nullptr, this);
 }
 
-void ArenaPortAllocator::Free(PortPacket* port_packet) {
-    arena_.Delete(port_packet);
+void CachedPortAllocator::Free(PortPacket* port_packet) {
+    DEBUG_ASSERT(!port_packet->InContainer());
+    DEBUG_ASSERT(port_packet->observer == nullptr);
     kcounter_add(port_arena_count, -1);
+    port_packet->~PortPacket();
+    port_packet_cache.Free(port_packet);
 }
 
 PortPacket::PortPacket(const void* handle, PortAllocator* allocator)
@@ -88,7 +89,11 @@ PortPacket::PortPacket(const void* handle, PortAllocator* allocator)
 
 PortObserver::PortObserver(uint32_t type, const Handle* handle, fbl::RefPtr<PortDispatcher> port,
                            uint64_t key, zx_signals_t signals)
-    : type_(type),
+    // A one-shot observer only acts on its trigger signals.  A repeating one
+    // requeues on every state change while a trigger signal is asserted, so
+    // it has to see them all.
+    : StateObserver(type == ZX_PKT_TYPE_SIGNAL_ONE ? signals : kAllSignals),
+      type_(type),
       trigger_(signals),
       packet_(handle, nullptr),
       port_(fbl::move(port)) {
@@ -160,17 +165,13 @@ StateObserver::Flags PortObserver::MaybeQueue(zx_signals_t new_state, uint64_t c
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-void PortDispatcher::Init() {
-    port_allocator.Init();
-}
-
 PortAllocator* PortDispatcher::DefaultPortAllocator() {
     return &port_allocator;
 }
 
 zx_status_t PortDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                                    zx_rights_t* rights) {
-    if (options && options != ZX_PORT_BIND_TO_INTERRUPT) {
+    if (options & ~(ZX_PORT_BIND_TO_INTERRUPT | ZX_PORT_WAKE_NEWEST)) {
         return ZX_ERR_INVALID_ARGS;
     }
     fbl::AllocChecker ac;
@@ -184,7 +185,10 @@ zx_status_t PortDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* di
 }
 
 PortDispatcher::PortDispatcher(uint32_t options)
-    : options_(options), zero_handles_(false), num_packets_(0u) {
+    : options_(options),
+      sema_(0, (options & ZX_PORT_WAKE_NEWEST) ? Semaphore::WakeOrder::kNewest
+                                               : Semaphore::WakeOrder::kFifo),
+      zero_handles_(false), num_packets_(0u) {
 }
 
 PortDispatcher::~PortDispatcher() {
@@ -239,12 +243,14 @@ bool PortDispatcher::RemoveInterruptPacket(PortInterruptPacket* port_packet) {
     return false;
 }
 
-bool PortDispatcher::QueueInterruptPacket(PortInterruptPacket* port_packet, zx_time_t timestamp) {
+bool PortDispatcher::QueueInterruptPacket(PortInterruptPacket* port_packet, zx_time_t timestamp,
+                                          uint64_t count) {
     Guard<SpinLock, IrqSave> guard{&spinlock_};
     if (port_packet->InContainer()) {
         return false;
     } else {
         port_packet->timestamp = timestamp;
+        port_packet->count = count;
         interrupt_packets_.push_back(port_packet);
         sema_.Post();
         return true;
@@ -284,31 +290,48 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
 }
 
 zx_status_t PortDispatcher::Dequeue(zx_time_t deadline, zx_port_packet_t* out_packet) {
+    size_t actual;
+    return DequeueMany(deadline, out_packet, 1, &actual);
+}
+
+zx_status_t PortDispatcher::DequeueMany(zx_time_t deadline, zx_port_packet_t* out_packets,
+                                        size_t count, size_t* actual) {
     canary_.Assert();
+    DEBUG_ASSERT(count > 0);
 
     while (true) {
-        if (options_ == ZX_PORT_BIND_TO_INTERRUPT) {
+        size_t n = 0;
+        if (can_bind_to_interrupt()) {
             Guard<SpinLock, IrqSave> guard{&spinlock_};
-            PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
-            if (port_interrupt_packet != nullptr) {
+            while (n < count) {
+                PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
+                if (port_interrupt_packet == nullptr)
+                    break;
+                zx_port_packet_t* out_packet = &out_packets[n++];
                 *out_packet = {};
                 out_packet->key = port_interrupt_packet->key;
                 out_packet->type = ZX_PKT_TYPE_INTERRUPT;
                 out_packet->status = ZX_OK;
                 out_packet->interrupt.timestamp = port_interrupt_packet->timestamp;
-                return ZX_OK;
+                out_packet->interrupt.count = port_interrupt_packet->count;
             }
         }
-        {
+        if (n < count) {
+            // Take everything we can fit under one acquisition of the lock.
             Guard<fbl::Mutex> guard{get_lock()};
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet != nullptr) {
+            while (n < count) {
+                PortPacket* port_packet = packets_.pop_front();
+                if (port_packet == nullptr)
+                    break;
                 --num_packets_;
-                *out_packet = port_packet->packet;
+                out_packets[n++] = port_packet->packet;
                 FreePacket(port_packet);
-                return ZX_OK;
             }
         }
+        if (n > 0) {
+            *actual = n;
+            return ZX_OK;
+        }
 
         {
             ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::PORT);
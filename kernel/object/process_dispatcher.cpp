@@ -15,7 +15,10 @@
 
 #include <arch/defines.h>
 
+#include <kernel/event.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
@@ -24,6 +27,7 @@
 #include <lib/ktrace.h>
 
 #include <zircon/rights.h>
+#include <zircon/time.h>
 
 #include <object/diagnostics.h>
 #include <object/futex_context.h>
@@ -33,11 +37,24 @@
 #include <object/vm_address_region_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(process_reaped_async, "kernel.process.reaper.reaped");
+KCOUNTER(process_reaped_sync, "kernel.process.reaper.inline");
+
+// Most reaper threads to start; more than this just contend on the
+// job and aspace locks.
+static constexpr uint kMaxReapers = 4;
+
+static event_t reaper_event = EVENT_INITIAL_VALUE(reaper_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+ProcessDispatcher::ReaperList ProcessDispatcher::reaper_list_;
+bool ProcessDispatcher::reapers_running_;
+
 static zx_handle_t map_handle_to_value(const Handle* handle, uint32_t mixer) {
     // Ensure that the last bit of the result is not zero, and make sure
     // we don't lose any base_value bits or make the result negative
@@ -138,7 +155,7 @@ void ProcessDispatcher::on_zero_handles() {
         SetStateLocked(State::DEAD);
     }
 
-    FinishDeadTransition();
+    QueueFinishDeadTransition();
 }
 
 void ProcessDispatcher::get_name(char out_name[ZX_MAX_NAME_LEN]) const {
@@ -227,8 +244,10 @@ void ProcessDispatcher::Kill() {
         }
     }
 
+    // Nobody is left to run the teardown, so hand it to a reaper rather than
+    // making the killer (e.g. a job kill walking many processes) do it.
     if (became_dead)
-        FinishDeadTransition();
+        QueueFinishDeadTransition();
 }
 
 void ProcessDispatcher::KillAllThreadsLocked() {
@@ -282,6 +301,8 @@ void ProcessDispatcher::RemoveThread(ThreadDispatcher* t) {
         // remove the thread from our list
         DEBUG_ASSERT(t != nullptr);
         thread_list_.erase(*t);
+        exited_thread_runtime_ = zx_duration_add_duration(exited_thread_runtime_,
+                                                          t->runtime_ns());
 
         // if this was the last thread, transition directly to DEAD state
         if (thread_list_.is_empty()) {
@@ -385,6 +406,72 @@ void ProcessDispatcher::FinishDeadTransition() {
     job_->RemoveChildProcess(this);
 }
 
+void ProcessDispatcher::QueueFinishDeadTransition() {
+    {
+        Guard<fbl::Mutex> guard{ReaperLock::Get()};
+        if (reapers_running_) {
+            reaper_list_.push_back(fbl::WrapRefPtr(this));
+            event_signal(&reaper_event, true);
+            return;
+        }
+    }
+
+    kcounter_add(process_reaped_sync, 1);
+    FinishDeadTransition();
+}
+
+int ProcessDispatcher::ReaperThread(void* arg) {
+    for (;;) {
+        event_wait(&reaper_event);
+
+        for (;;) {
+            fbl::RefPtr<ProcessDispatcher> process;
+            {
+                Guard<fbl::Mutex> guard{ReaperLock::Get()};
+                process = reaper_list_.pop_front();
+                if (!process)
+                    break;
+                // Pass the wakeup on so idle reapers help drain a burst,
+                // such as a large job being killed.
+                if (!reaper_list_.is_empty())
+                    event_signal(&reaper_event, false);
+            }
+
+            process->FinishDeadTransition();
+            kcounter_add(process_reaped_async, 1);
+        }
+    }
+
+    return 0;
+}
+
+void ProcessDispatcher::StartReapers() {
+    uint count = fbl::min(arch_max_num_cpus(), kMaxReapers);
+    uint started = 0;
+    for (uint i = 0; i < count; i++) {
+        char name[ZX_MAX_NAME_LEN];
+        snprintf(name, sizeof(name), "process reaper %u", i);
+        thread_t* t = thread_create(name, ReaperThread, nullptr, DEFAULT_PRIORITY);
+        if (!t) {
+            printf("failed to create process reaper thread\n");
+            break;
+        }
+        thread_detach_and_resume(t);
+        started++;
+    }
+
+    if (started > 0) {
+        Guard<fbl::Mutex> guard{ReaperLock::Get()};
+        reapers_running_ = true;
+    }
+}
+
+static void process_reaper_init(uint level) {
+    ProcessDispatcher::StartReapers();
+}
+
+LK_INIT_HOOK(process_reaper, process_reaper_init, LK_INIT_LEVEL_USER - 1);
+
 // process handle manipulation routines
 zx_handle_t ProcessDispatcher::MapHandleToValue(const Handle* handle) const {
     return map_handle_to_value(handle, handle_rand_);
@@ -396,6 +483,8 @@ zx_handle_t ProcessDispatcher::MapHandleToValue(const HandleOwner& handle) const
 
 Handle* ProcessDispatcher::GetHandleLocked(zx_handle_t handle_value,
                                            bool skip_policy) {
+    // Only our own handles carry our koid, and those can't change while
+    // handle_table_lock_ is held.
     auto handle = map_value_to_handle(handle_value, handle_rand_);
     if (handle && handle->process_id() == get_koid())
         return handle;
@@ -557,6 +646,32 @@ zx_status_t ProcessDispatcher::GetStats(zx_info_task_stats_t* stats) {
     return ZX_OK;
 }
 
+void ProcessDispatcher::GetProcessStats(zx_info_process_stats_t* stats) {
+    DEBUG_ASSERT(stats != nullptr);
+    *stats = {};
+    stats->koid = get_koid();
+    stats->job_koid = job_->get_koid();
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    zx_duration_t runtime = exited_thread_runtime_;
+    for (auto& thread : thread_list_) {
+        runtime = zx_duration_add_duration(runtime, thread.runtime_ns());
+        stats->thread_count++;
+    }
+    stats->cpu_runtime = runtime;
+
+    if (state_ == State::DEAD) {
+        return;
+    }
+    VmAspace::vm_usage_t usage;
+    if (aspace_->GetMemoryUsage(&usage) == ZX_OK) {
+        stats->task_stats.mem_mapped_bytes = usage.mapped_pages * PAGE_SIZE;
+        stats->task_stats.mem_private_bytes = usage.private_pages * PAGE_SIZE;
+        stats->task_stats.mem_shared_bytes = usage.shared_pages * PAGE_SIZE;
+        stats->task_stats.mem_scaled_shared_bytes = usage.scaled_shared_bytes;
+    }
+}
+
 zx_status_t ProcessDispatcher::GetAspaceMaps(
     user_out_ptr<zx_info_maps_t> maps, size_t max,
     size_t* actual, size_t* available) {
@@ -779,6 +894,31 @@ zx_status_t ProcessDispatcher::set_debug_addr(uintptr_t addr) {
     return ZX_OK;
 }
 
+zx_exception_handler_t ProcessDispatcher::get_exception_handler() const {
+    Guard<fbl::Mutex> guard{get_lock()};
+    return exception_handler_;
+}
+
+zx_status_t ProcessDispatcher::set_exception_handler(const zx_exception_handler_t& handler) {
+    // Only architectural exceptions can be redirected; the synthetic ones
+    // are raised where there is no user context to redirect.
+    constexpr uint32_t kArchTypes =
+        ZX_EXCP_HANDLER_TYPE(ZX_EXCP_GENERAL) |
+        ZX_EXCP_HANDLER_TYPE(ZX_EXCP_FATAL_PAGE_FAULT) |
+        ZX_EXCP_HANDLER_TYPE(ZX_EXCP_UNDEFINED_INSTRUCTION) |
+        ZX_EXCP_HANDLER_TYPE(ZX_EXCP_SW_BREAKPOINT) |
+        ZX_EXCP_HANDLER_TYPE(ZX_EXCP_HW_BREAKPOINT) |
+        ZX_EXCP_HANDLER_TYPE(ZX_EXCP_UNALIGNED_ACCESS);
+    if (handler.reserved != 0u || (handler.type_mask & ~kArchTypes) != 0u)
+        return ZX_ERR_INVALID_ARGS;
+    if (handler.entry != 0u && !is_user_address(handler.entry))
+        return ZX_ERR_INVALID_ARGS;
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    exception_handler_ = handler;
+    return ZX_OK;
+}
+
 zx_status_t ProcessDispatcher::QueryPolicy(uint32_t condition) const {
     auto action = GetSystemPolicyManager()->QueryBasicPolicy(policy_, condition);
     if (action & ZX_POL_ACTION_EXCEPTION) {
@@ -16,12 +16,25 @@
 #include <zircon/rights.h>
 
 zx_status_t validate_profile(const zx_profile_info_t& info) {
-    if (info.type != ZX_PROFILE_INFO_SCHEDULER)
+    switch (info.type) {
+    case ZX_PROFILE_INFO_SCHEDULER:
+        if ((info.scheduler.priority < LOWEST_PRIORITY) ||
+            (info.scheduler.priority  > HIGHEST_PRIORITY))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_DEADLINE:
+        if ((info.deadline.capacity <= 0) ||
+            (info.deadline.capacity > info.deadline.relative_deadline) ||
+            (info.deadline.relative_deadline > info.deadline.period))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_CPU_AFFINITY:
+        if (info.cpu_affinity.cpu_mask == 0)
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    default:
         return ZX_ERR_NOT_SUPPORTED;
-    if ((info.scheduler.priority < LOWEST_PRIORITY) ||
-        (info.scheduler.priority  > HIGHEST_PRIORITY))
-        return ZX_ERR_INVALID_ARGS;
-    return ZX_OK;
+    }
 }
 
 zx_status_t ProfileDispatcher::Create(const zx_profile_info_t& info,
@@ -48,6 +61,13 @@ ProfileDispatcher::~ProfileDispatcher() {
 }
 
 zx_status_t ProfileDispatcher::ApplyProfile(fbl::RefPtr<ThreadDispatcher> thread) {
-    // At the moment, the only thing we support is the priority.
+    if (info_.type == ZX_PROFILE_INFO_DEADLINE) {
+        return thread->SetDeadline(info_.deadline.capacity,
+                                   info_.deadline.relative_deadline,
+                                   info_.deadline.period);
+    }
+    if (info_.type == ZX_PROFILE_INFO_CPU_AFFINITY) {
+        return thread->SetCpuAffinity(info_.cpu_affinity.cpu_mask);
+    }
     return thread->SetPriority(info_.scheduler.priority);
 }
@@ -10,6 +10,7 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULE := $(LOCAL_DIR)
 
 MODULE_SRCS := \
+    $(LOCAL_DIR)/aspace_template_dispatcher.cpp \
     $(LOCAL_DIR)/buffer_chain.cpp \
     $(LOCAL_DIR)/bus_transaction_initiator_dispatcher.cpp \
     $(LOCAL_DIR)/channel_dispatcher.cpp \
@@ -32,6 +33,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/log_dispatcher.cpp \
     $(LOCAL_DIR)/mbuf.cpp \
     $(LOCAL_DIR)/message_packet.cpp \
+    $(LOCAL_DIR)/pager_dispatcher.cpp \
     $(LOCAL_DIR)/pci_device_dispatcher.cpp \
     $(LOCAL_DIR)/pci_interrupt_dispatcher.cpp \
     $(LOCAL_DIR)/pinned_memory_token_dispatcher.cpp \
@@ -51,6 +53,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/vm_address_region_dispatcher.cpp \
     $(LOCAL_DIR)/vm_object_dispatcher.cpp \
     $(LOCAL_DIR)/wait_state_observer.cpp \
+    $(LOCAL_DIR)/waitset_dispatcher.cpp \
 
 # Tests
 MODULE_SRCS += \
@@ -64,6 +67,7 @@ MODULE_DEPS := \
     kernel/dev/udisplay \
     kernel/lib/fbl \
     kernel/lib/hypervisor \
+    kernel/lib/object_cache \
     kernel/lib/oom \
     kernel/lib/pretty \
     kernel/lib/region-alloc \
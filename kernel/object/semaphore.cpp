@@ -11,7 +11,8 @@
 #include <zircon/compiler.h>
 #include <zircon/types.h>
 
-Semaphore::Semaphore(int64_t initial_count) : count_(initial_count) {
+Semaphore::Semaphore(int64_t initial_count, WakeOrder order)
+    : count_(initial_count), order_(order) {
 }
 
 Semaphore::~Semaphore() {
@@ -21,8 +22,13 @@ void Semaphore::Post() {
     // If the count is or was negative then a thread is waiting for a resource,
     // otherwise it's safe to just increase the count available with no downsides.
     Guard<spin_lock_t, IrqSave> guard{ThreadLock::Get()};
-    if (unlikely(++count_ <= 0))
-        waitq_.WakeOne(true, ZX_OK);
+    if (unlikely(++count_ <= 0)) {
+        if (order_ == WakeOrder::kNewest) {
+            waitq_.WakeNewest(true, ZX_OK);
+        } else {
+            waitq_.WakeOne(true, ZX_OK);
+        }
+    }
 }
 
 zx_status_t Semaphore::Wait(zx_time_t deadline) {
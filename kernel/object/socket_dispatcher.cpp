@@ -20,12 +20,55 @@
 #include <vm/vm_object_paged.h>
 #include <object/handle.h>
 
+#include <zircon/types.h>
+
 #include <zircon/rights.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 
 #define LOCAL_TRACE 0
 
+static_assert(ZX_SOCKET_RING_DATA_OFFSET % PAGE_SIZE == 0, "");
+static_assert(sizeof(zx_socket_ring_header_t) <= ZX_SOCKET_RING_DATA_OFFSET, "");
+
+constexpr size_t SocketDispatcher::kRingSize;
+
+static constexpr uint64_t kRingVmoSize = ZX_SOCKET_RING_DATA_OFFSET + SocketDispatcher::kRingSize;
+
+// On success |vmo| holds the ring, committed and pinned; on failure it is
+// left alone.
+static zx_status_t CreateRing(fbl::RefPtr<VmObject>* vmo) {
+    fbl::RefPtr<VmObject> ring;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, kRingVmoSize, &ring);
+    if (status != ZX_OK)
+        return status;
+
+    uint64_t committed;
+    status = ring->CommitRange(0, kRingVmoSize, &committed);
+    if (status != ZX_OK)
+        return status;
+    if (committed != kRingVmoSize)
+        return ZX_ERR_NO_MEMORY;
+
+    // Pinned pages can't be decommitted, and a vmo with pages can't have its
+    // cache policy changed, so nothing done through the handed out vmo can
+    // make the kernel's header updates fail.
+    status = ring->Pin(0, kRingVmoSize);
+    if (status != ZX_OK)
+        return status;
+
+    zx_socket_ring_header_t header = {};
+    header.size = SocketDispatcher::kRingSize;
+    status = ring->Write(&header, 0, sizeof(header));
+    if (status != ZX_OK) {
+        ring->Unpin(0, kRingVmoSize);
+        return status;
+    }
+
+    *vmo = fbl::move(ring);
+    return ZX_OK;
+}
+
 // static
 zx_status_t SocketDispatcher::Create(uint32_t flags,
                                      fbl::RefPtr<Dispatcher>* dispatcher0,
@@ -35,6 +78,9 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
 
     if (flags & ~ZX_SOCKET_CREATE_MASK)
         return ZX_ERR_INVALID_ARGS;
+    // a ring holds a byte stream; it has nowhere to keep datagram boundaries
+    if ((flags & ZX_SOCKET_RING) && (flags & ZX_SOCKET_DATAGRAM))
+        return ZX_ERR_INVALID_ARGS;
 
     fbl::AllocChecker ac;
 
@@ -59,20 +105,51 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
             return ZX_ERR_NO_MEMORY;
     }
 
+    fbl::RefPtr<VmObject> ring0;
+    fbl::RefPtr<VmObject> ring1;
+
+    // a ring is unpinned by its dispatcher, so until then that is up to us
+    auto unpin_rings = [&ring0, &ring1]() {
+        if (ring0)
+            ring0->Unpin(0, kRingVmoSize);
+        if (ring1)
+            ring1->Unpin(0, kRingVmoSize);
+    };
+
+    if (flags & ZX_SOCKET_RING) {
+        zx_status_t status = CreateRing(&ring0);
+        if (status != ZX_OK)
+            return status;
+
+        status = CreateRing(&ring1);
+        if (status != ZX_OK) {
+            unpin_rings();
+            return status;
+        }
+    }
+
     auto holder0 = fbl::AdoptRef(new (&ac) PeerHolder<SocketDispatcher>());
-    if (!ac.check())
+    if (!ac.check()) {
+        unpin_rings();
         return ZX_ERR_NO_MEMORY;
+    }
     auto holder1 = holder0;
 
     auto socket0 = fbl::AdoptRef(new (&ac) SocketDispatcher(fbl::move(holder0), starting_signals,
-                                                            flags, fbl::move(control0)));
-    if (!ac.check())
+                                                            flags, fbl::move(control0),
+                                                            fbl::move(ring0)));
+    if (!ac.check()) {
+        unpin_rings();
         return ZX_ERR_NO_MEMORY;
+    }
 
     auto socket1 = fbl::AdoptRef(new (&ac) SocketDispatcher(fbl::move(holder1), starting_signals,
-                                                            flags, fbl::move(control1)));
-    if (!ac.check())
+                                                            flags, fbl::move(control1),
+                                                            fbl::move(ring1)));
+    if (!ac.check()) {
+        unpin_rings();
         return ZX_ERR_NO_MEMORY;
+    }
 
     socket0->Init(socket1);
     socket1->Init(socket0);
@@ -85,9 +162,13 @@ zx_status_t SocketDispatcher::Create(uint32_t flags,
 
 SocketDispatcher::SocketDispatcher(fbl::RefPtr<PeerHolder<SocketDispatcher>> holder,
                                    zx_signals_t starting_signals, uint32_t flags,
-                                   fbl::unique_ptr<ControlMsg> control_msg)
+                                   fbl::unique_ptr<ControlMsg> control_msg,
+                                   fbl::RefPtr<VmObject> ring)
     : PeeredDispatcher(fbl::move(holder), starting_signals),
       flags_(flags),
+      ring_(fbl::move(ring)),
+      ring_head_(0),
+      ring_tail_(0),
       control_msg_(fbl::move(control_msg)),
       control_msg_len_(0),
       read_threshold_(0),
@@ -96,6 +177,8 @@ SocketDispatcher::SocketDispatcher(fbl::RefPtr<PeerHolder<SocketDispatcher>> hol
 }
 
 SocketDispatcher::~SocketDispatcher() {
+    if (ring_)
+        ring_->Unpin(0, kRingVmoSize);
 }
 
 // This is called before either SocketDispatcher is accessible from threads other than the one
@@ -202,6 +285,8 @@ zx_status_t SocketDispatcher::Write(user_in_ptr<const void> src, size_t len,
     }
     if (len != static_cast<size_t>(static_cast<uint32_t>(len)))
         return ZX_ERR_INVALID_ARGS;
+    if (!src && !ring_)
+        return ZX_ERR_INVALID_ARGS;
 
     return peer_->WriteSelfLocked(src, len, nwritten);
 }
@@ -256,7 +341,9 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
 
     size_t st = 0u;
     zx_status_t status;
-    if (flags_ & ZX_SOCKET_DATAGRAM) {
+    if (ring_) {
+        status = RingWriteSelfLocked(src, len, &st);
+    } else if (flags_ & ZX_SOCKET_DATAGRAM) {
         status = data_.WriteDatagram(src, len, &st);
     } else {
         status = data_.WriteStream(src, len, &st);
@@ -271,7 +358,7 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
         if (was_empty)
             set |= ZX_SOCKET_READABLE;
         // Assert signal if we go above the read threshold
-        if ((read_threshold_ > 0) && (data_.size() >= read_threshold_))
+        if ((read_threshold_ > 0) && (rx_size() >= read_threshold_))
             set |= ZX_SOCKET_READ_THRESHOLD;
         if (set) {
             UpdateStateLocked(0u, set);
@@ -280,7 +367,7 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
             size_t peer_write_threshold = peer_->write_threshold_;
             // If free space falls below threshold, de-signal
             if ((peer_write_threshold > 0) &&
-                ((data_.max_size() - data_.size()) < peer_write_threshold))
+                ((rx_max() - rx_size()) < peer_write_threshold))
                 clear |= ZX_SOCKET_WRITE_THRESHOLD;
         }
     }
@@ -295,6 +382,75 @@ zx_status_t SocketDispatcher::WriteSelfLocked(user_in_ptr<const void> src, size_
     return status;
 }
 
+zx_status_t SocketDispatcher::RingWriteSelfLocked(user_in_ptr<const void> src, size_t len,
+                                                  size_t* nwritten) {
+    const size_t space = kRingSize - rx_size();
+
+    if (!src) {
+        // the writer filled its mapping already and is telling us how much
+        if (len > space)
+            return ZX_ERR_OUT_OF_RANGE;
+    } else {
+        len = MIN(len, space);
+        // at most two pieces: up to the end of the ring, then from its start
+        size_t done = 0;
+        while (done < len) {
+            const size_t pos = static_cast<size_t>((ring_head_ + done) % kRingSize);
+            const size_t chunk = MIN(len - done, kRingSize - pos);
+            zx_status_t status = ring_->WriteUser(src.byte_offset(done),
+                                                  ZX_SOCKET_RING_DATA_OFFSET + pos, chunk);
+            if (status != ZX_OK)
+                return ZX_ERR_INVALID_ARGS; // Bad user buffer.
+            done += chunk;
+        }
+    }
+
+    zx_status_t status = PublishRingLocked(ring_head_ + len, ring_tail_);
+    if (status != ZX_OK)
+        return status;
+    ring_head_ += len;
+    *nwritten = len;
+    return ZX_OK;
+}
+
+zx_status_t SocketDispatcher::RingReadLocked(user_out_ptr<void> dst, size_t len, size_t* nread) {
+    const size_t avail = rx_size();
+
+    if (!dst) {
+        if (len > avail)
+            return ZX_ERR_OUT_OF_RANGE;
+    } else {
+        len = MIN(len, avail);
+        size_t done = 0;
+        while (done < len) {
+            const size_t pos = static_cast<size_t>((ring_tail_ + done) % kRingSize);
+            const size_t chunk = MIN(len - done, kRingSize - pos);
+            zx_status_t status = ring_->ReadUser(dst.byte_offset(done),
+                                                 ZX_SOCKET_RING_DATA_OFFSET + pos, chunk);
+            if (status != ZX_OK)
+                return ZX_ERR_INVALID_ARGS; // Invalid user buffer.
+            done += chunk;
+        }
+    }
+
+    zx_status_t status = PublishRingLocked(ring_head_, ring_tail_ + len);
+    if (status != ZX_OK)
+        return status;
+    ring_tail_ += len;
+    *nread = len;
+    return ZX_OK;
+}
+
+zx_status_t SocketDispatcher::PublishRingLocked(uint64_t head, uint64_t tail) {
+    // Both ends may have scribbled on the header through their mappings; the
+    // counters here are the real ones, so overwrite whatever is there.
+    zx_socket_ring_header_t header = {};
+    header.head = head;
+    header.tail = tail;
+    header.size = kRingSize;
+    return ring_->Write(&header, 0, sizeof(header));
+}
+
 zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
                                    size_t* nread) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
@@ -305,12 +461,14 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
 
     // Just query for bytes outstanding.
     if (!dst && len == 0) {
-        *nread = data_.size(flags_ & ZX_SOCKET_DATAGRAM);
+        *nread = ring_ ? rx_size() : data_.size(flags_ & ZX_SOCKET_DATAGRAM);
         return ZX_OK;
     }
 
     if (len != (size_t)((uint32_t)len))
         return ZX_ERR_INVALID_ARGS;
+    if (!dst && !ring_)
+        return ZX_ERR_INVALID_ARGS;
 
     if (is_empty()) {
         if (!peer_)
@@ -324,13 +482,20 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
 
     bool was_full = is_full();
 
-    auto st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+    size_t st;
+    if (ring_) {
+        zx_status_t status = RingReadLocked(dst, len, &st);
+        if (status != ZX_OK)
+            return status;
+    } else {
+        st = data_.Read(dst, len, flags_ & ZX_SOCKET_DATAGRAM);
+    }
 
     zx_signals_t clear = 0u;
     zx_signals_t set = 0u;
 
     // Deassert signal if we fell below the read threshold
-    if ((read_threshold_ > 0) && (data_.size() < read_threshold_))
+    if ((read_threshold_ > 0) && (rx_size() < read_threshold_))
         clear |= ZX_SOCKET_READ_THRESHOLD;
 
     if (is_empty()) {
@@ -345,7 +510,7 @@ zx_status_t SocketDispatcher::Read(user_out_ptr<void> dst, size_t len,
         // threshold.
         size_t peer_write_threshold = peer_->write_threshold_;
         if (peer_write_threshold > 0 &&
-            ((data_.max_size() - data_.size()) >= peer_write_threshold))
+            ((rx_max() - rx_size()) >= peer_write_threshold))
             set |= ZX_SOCKET_WRITE_THRESHOLD;
         if (was_full && (st > 0))
             set |= ZX_SOCKET_WRITABLE;
@@ -444,16 +609,35 @@ zx_status_t SocketDispatcher::Accept(HandleOwner* h) TA_NO_THREAD_SAFETY_ANALYSI
     return ZX_OK;
 }
 
+zx_status_t SocketDispatcher::GetRing(bool tx, fbl::RefPtr<VmObject>* vmo)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    canary_.Assert();
+
+    if (!(flags_ & ZX_SOCKET_RING))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!tx) {
+        *vmo = ring_;
+        return ZX_OK;
+    }
+
+    Guard<fbl::Mutex> guard{get_lock()};
+    if (!peer_)
+        return ZX_ERR_PEER_CLOSED;
+    *vmo = peer_->ring_;
+    return ZX_OK;
+}
+
 size_t SocketDispatcher::ReceiveBufferMax() const {
     canary_.Assert();
     Guard<fbl::Mutex> guard{get_lock()};
-    return data_.max_size();
+    return rx_max();
 }
 
 size_t SocketDispatcher::ReceiveBufferSize() const {
     canary_.Assert();
     Guard<fbl::Mutex> guard{get_lock()};
-    return data_.size();
+    return rx_size();
 }
 
 // NOTE(abdulla): peer_ is protected by get_lock() while peer_->data_
@@ -464,13 +648,13 @@ size_t SocketDispatcher::ReceiveBufferSize() const {
 size_t SocketDispatcher::TransmitBufferMax() const TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
     Guard<fbl::Mutex> guard{get_lock()};
-    return peer_ ? peer_->data_.max_size() : 0;
+    return peer_ ? peer_->rx_max() : 0;
 }
 
 size_t SocketDispatcher::TransmitBufferSize() const TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
     Guard<fbl::Mutex> guard{get_lock()};
-    return peer_ ? peer_->data_.size() : 0;
+    return peer_ ? peer_->rx_size() : 0;
 }
 
 void SocketDispatcher::GetInfo(zx_info_socket_t* info) const TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -478,10 +662,10 @@ void SocketDispatcher::GetInfo(zx_info_socket_t* info) const TA_NO_THREAD_SAFETY
     Guard<fbl::Mutex> guard{get_lock()};
     *info = zx_info_socket_t{
         .options = flags_,
-        .rx_buf_max = data_.max_size(),
-        .rx_buf_size = data_.size(),
-        .tx_buf_max = peer_ ? peer_->data_.max_size() : 0,
-        .tx_buf_size = peer_ ? peer_->data_.size() : 0,
+        .rx_buf_max = rx_max(),
+        .rx_buf_size = rx_size(),
+        .tx_buf_max = peer_ ? peer_->rx_max() : 0,
+        .tx_buf_size = peer_ ? peer_->rx_size() : 0,
     };
 }
 
@@ -500,14 +684,14 @@ size_t SocketDispatcher::GetWriteThreshold() const TA_NO_THREAD_SAFETY_ANALYSIS
 zx_status_t SocketDispatcher::SetReadThreshold(size_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
     canary_.Assert();
     Guard<fbl::Mutex> guard{get_lock()};
-    if (value > data_.max_size())
+    if (value > rx_max())
         return ZX_ERR_INVALID_ARGS;
     read_threshold_ = value;
     // Setting 0 disables thresholding. Deassert signal unconditionally.
     if (value == 0) {
         UpdateStateLocked(ZX_SOCKET_READ_THRESHOLD, 0u);
     } else {
-        if (data_.size() >= read_threshold_) {
+        if (rx_size() >= read_threshold_) {
             // Assert signal if we have queued data above the read threshold
             UpdateStateLocked(0u, ZX_SOCKET_READ_THRESHOLD);
         } else {
@@ -523,7 +707,7 @@ zx_status_t SocketDispatcher::SetWriteThreshold(size_t value) TA_NO_THREAD_SAFET
     Guard<fbl::Mutex> guard{get_lock()};
     if (peer_ == NULL)
         return ZX_ERR_PEER_CLOSED;
-    if (value > peer_->data_.max_size())
+    if (value > peer_->rx_max())
         return ZX_ERR_INVALID_ARGS;
     write_threshold_ = value;
     // Setting 0 disables thresholding. Deassert signal unconditionally.
@@ -531,7 +715,7 @@ zx_status_t SocketDispatcher::SetWriteThreshold(size_t value) TA_NO_THREAD_SAFET
         UpdateStateLocked(ZX_SOCKET_WRITE_THRESHOLD, 0u);
     } else {
         // Assert signal if we have available space above the write threshold
-        if ((peer_->data_.max_size() - peer_->data_.size()) >= write_threshold_) {
+        if ((peer_->rx_max() - peer_->rx_size()) >= write_threshold_) {
             // Assert signal if we have available space above the write threshold
             UpdateStateLocked(0u, ZX_SOCKET_WRITE_THRESHOLD);
         } else {
@@ -22,6 +22,10 @@ public:
         UpdateState(0, 1);
     }
 
+    void CallUpdateState(zx_signals_t clear_mask, zx_signals_t set_mask) {
+        UpdateState(clear_mask, set_mask);
+    }
+
     // Helper: Causes most On*() hooks (except for OnInitialized) to
     // be called on all of |st|'s observers.
     void CallAllOnHooks() {
@@ -180,6 +184,72 @@ bool on_cancel_by_key() {
 
 } // namespace removal
 
+// Tests for filtering state changes by observer interest
+namespace interest {
+
+class CountingObserver : public StateObserver {
+public:
+    explicit CountingObserver(zx_signals_t interest) : StateObserver(interest) {}
+
+    // The number of times OnStateChange() has been called.
+    int changes() const { return changes_; }
+    zx_signals_t last_state() const { return last_state_; }
+
+private:
+    Flags OnInitialize(zx_signals_t initial_state,
+                       const StateObserver::CountInfo* cinfo) override {
+        return 0;
+    }
+    Flags OnStateChange(zx_signals_t new_state) override {
+        changes_++;
+        last_state_ = new_state;
+        return 0;
+    }
+    Flags OnCancel(const Handle* handle) override { return 0; }
+
+    int changes_ = 0;
+    zx_signals_t last_state_ = 0u;
+};
+
+bool skips_uninteresting_changes() {
+    BEGIN_TEST;
+
+    CountingObserver narrow(2u);
+    CountingObserver all(StateObserver::kAllSignals);
+
+    TestDispatcher st;
+    st.AddObserver(&narrow, nullptr);
+    st.AddObserver(&all, nullptr);
+
+    // Only |all| cares about signal 1.
+    st.CallUpdateState(0u, 1u);
+    EXPECT_EQ(0, narrow.changes(), "");
+    EXPECT_EQ(1, all.changes(), "");
+
+    // Both care about signal 2, and see the whole state.
+    st.CallUpdateState(0u, 2u);
+    EXPECT_EQ(1, narrow.changes(), "");
+    EXPECT_EQ(3u, narrow.last_state(), "");
+    EXPECT_EQ(2, all.changes(), "");
+
+    // Clearing a signal is a change too.
+    st.CallUpdateState(2u, 0u);
+    EXPECT_EQ(2, narrow.changes(), "");
+    EXPECT_EQ(1u, narrow.last_state(), "");
+
+    // Once |all| is gone, nobody is told about signal 1.
+    EXPECT_EQ(1u, st.RemoveObserver(&all), "");
+    st.CallUpdateState(1u, 0u);
+    EXPECT_EQ(2, narrow.changes(), "");
+    EXPECT_EQ(3, all.changes(), "");
+
+    st.RemoveObserver(&narrow);
+
+    END_TEST;
+}
+
+} // namespace interest
+
 #define ST_UNITTEST(fname) UNITTEST(#fname, fname)
 
 UNITTEST_START_TESTCASE(state_tracker_tests)
@@ -188,6 +258,7 @@ ST_UNITTEST(removal::on_initialize)
 ST_UNITTEST(removal::on_state_change_via_update_state)
 ST_UNITTEST(removal::on_cancel)
 ST_UNITTEST(removal::on_cancel_by_key)
+ST_UNITTEST(interest::skips_uninteresting_changes)
 
 UNITTEST_END_TESTCASE(
     state_tracker_tests, "statetracker", "StateTracker test");
@@ -16,8 +16,11 @@
 #include <arch/debugger.h>
 #include <arch/exception.h>
 
+#include <kernel/mp.h>
 #include <kernel/thread.h>
+#include <lib/object_cache.h>
 #include <vm/kstack.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
@@ -40,6 +43,23 @@
 
 #define LOCAL_TRACE 0
 
+OBJECT_CACHE(thread_dispatcher_cache, "thread_dispatcher", ThreadDispatcher, 0u);
+
+// static
+void* ThreadDispatcher::operator new(size_t size, fbl::AllocChecker* ac) noexcept {
+    DEBUG_ASSERT(size == sizeof(ThreadDispatcher));
+    void* mem = thread_dispatcher_cache.Alloc();
+    ac->arm(size, mem != nullptr);
+    return mem;
+}
+
+// static
+void ThreadDispatcher::operator delete(void* ptr) {
+    if (ptr != nullptr) {
+        thread_dispatcher_cache.Free(ptr);
+    }
+}
+
 // static
 zx_status_t ThreadDispatcher::Create(fbl::RefPtr<ProcessDispatcher> process, uint32_t flags,
                                      fbl::StringPiece name,
@@ -306,6 +326,9 @@ void ThreadDispatcher::Exiting() {
 
     LTRACE_ENTRY_OBJ;
 
+    // A user copy that failed under a lock may have left a page request behind.
+    PageSource::CancelRequest();
+
     // Notify a debugger if attached. Do this before marking the thread as
     // dead: the debugger expects to see the thread in the DYING state, it may
     // try to read thread registers. The debugger still has to handle the case
@@ -971,7 +994,36 @@ zx_status_t ThreadDispatcher::SetPriority(int32_t priority) {
         return ZX_ERR_BAD_STATE;
     }
     // The priority was already validated by the Profile dispatcher.
-    thread_set_priority(&thread_, priority);
+    // A priority profile replaces any deadline profile previously applied.
+    thread_clear_deadline_and_set_priority(&thread_, priority);
+    return ZX_OK;
+}
+
+zx_status_t ThreadDispatcher::SetDeadline(zx_duration_t capacity,
+                                          zx_duration_t relative_deadline,
+                                          zx_duration_t period) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if ((state_.lifecycle() == ThreadState::Lifecycle::INITIAL) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DYING) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    // The parameters were already validated by the Profile dispatcher, but
+    // admission control may still refuse them.
+    return thread_set_deadline(&thread_, capacity, relative_deadline, period);
+}
+
+zx_status_t ThreadDispatcher::SetCpuAffinity(cpu_mask_t mask) {
+    Guard<fbl::Mutex> guard{get_lock()};
+    if ((state_.lifecycle() == ThreadState::Lifecycle::INITIAL) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DYING) ||
+        (state_.lifecycle() == ThreadState::Lifecycle::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    // A thread bound only to offline cpus would never run.
+    if ((mask & mp_get_active_mask()) == 0)
+        return ZX_ERR_INVALID_ARGS;
+    thread_set_cpu_affinity(&thread_, mask);
     return ZX_OK;
 }
 
@@ -11,6 +11,7 @@
 
 #include <zircon/rights.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 
 #include <assert.h>
@@ -55,6 +56,14 @@ void VmObjectDispatcher::OnOneChild() {
     UpdateState(ZX_VMO_ZERO_CHILDREN, 0);
 }
 
+void VmObjectDispatcher::OnPagesDiscarded() {
+    UpdateState(0, ZX_VMO_DISCARDED);
+}
+
+void VmObjectDispatcher::OnDiscardAcknowledged() {
+    UpdateState(ZX_VMO_DISCARDED, 0);
+}
+
 void VmObjectDispatcher::get_name(char out_name[ZX_MAX_NAME_LEN]) const {
     canary_.Assert();
     vmo_->get_name(out_name, ZX_MAX_NAME_LEN);
@@ -151,10 +160,38 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             auto status = vmo_->DecommitRange(offset, size, nullptr);
             return status;
         }
-        case ZX_VMO_OP_LOCK:
+        case ZX_VMO_OP_LOCK: {
+            if ((rights & ZX_RIGHT_WRITE) == 0) {
+                return ZX_ERR_ACCESS_DENIED;
+            }
+            // locking is per object, so the range has to cover all of it
+            if (offset != 0 || size != vmo_->size()) {
+                return ZX_ERR_INVALID_ARGS;
+            }
+            bool was_discarded;
+            auto status = vmo_->LockDiscardable(&was_discarded);
+            if (status != ZX_OK) {
+                return status;
+            }
+            // optionally tell the caller whether the contents survived
+            if (buffer_size >= sizeof(uint32_t)) {
+                uint32_t discarded = was_discarded ? 1u : 0u;
+                status = buffer.reinterpret<uint32_t>().copy_to_user(discarded);
+                if (status != ZX_OK) {
+                    vmo_->UnlockDiscardable();
+                    return status;
+                }
+            }
+            return ZX_OK;
+        }
         case ZX_VMO_OP_UNLOCK:
-            // TODO: handle or remove
-            return ZX_ERR_NOT_SUPPORTED;
+            if ((rights & ZX_RIGHT_WRITE) == 0) {
+                return ZX_ERR_ACCESS_DENIED;
+            }
+            if (offset != 0 || size != vmo_->size()) {
+                return ZX_ERR_INVALID_ARGS;
+            }
+            return vmo_->UnlockDiscardable();
 
         case ZX_VMO_OP_CACHE_SYNC:
             if ((rights & ZX_RIGHT_READ) == 0) {
@@ -184,6 +221,103 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
     }
 }
 
+namespace {
+
+// Maps the ops the VM layer can run as a batch to their VmRangeOp type and the
+// right they need, matching RangeOp().
+bool ToVmRangeOp(uint32_t op, VmRangeOp::Type* type, zx_rights_t* needed) {
+    switch (op) {
+        case ZX_VMO_OP_COMMIT:
+            *type = VmRangeOp::Type::Commit;
+            *needed = ZX_RIGHT_WRITE;
+            return true;
+        case ZX_VMO_OP_DECOMMIT:
+            *type = VmRangeOp::Type::Decommit;
+            *needed = ZX_RIGHT_WRITE;
+            return true;
+        case ZX_VMO_OP_CACHE_SYNC:
+            *type = VmRangeOp::Type::CacheSync;
+            *needed = ZX_RIGHT_READ;
+            return true;
+        case ZX_VMO_OP_CACHE_INVALIDATE:
+            *type = VmRangeOp::Type::CacheInvalidate;
+            *needed = ZX_RIGHT_WRITE;
+            return true;
+        case ZX_VMO_OP_CACHE_CLEAN:
+            *type = VmRangeOp::Type::CacheClean;
+            *needed = ZX_RIGHT_READ;
+            return true;
+        case ZX_VMO_OP_CACHE_CLEAN_INVALIDATE:
+            *type = VmRangeOp::Type::CacheCleanInvalidate;
+            *needed = ZX_RIGHT_READ;
+            return true;
+        default:
+            return false;
+    }
+}
+
+// entries copied in and run per trip through the VMO lock, bounded by stack use
+constexpr size_t kRangeOpBatchChunk = 16;
+
+} // namespace
+
+zx_status_t VmObjectDispatcher::RangeOpBatch(user_inout_ptr<zx_vmo_op_range_entry_t> user_ops,
+                                             size_t count, zx_rights_t rights) {
+    canary_.Assert();
+
+    LTRACEF("count %zu rights %#x\n", count, rights);
+
+    for (size_t done = 0; done < count;) {
+        const size_t n = fbl::min(count - done, kRangeOpBatchChunk);
+
+        zx_vmo_op_range_entry_t entries[kRangeOpBatchChunk];
+        zx_status_t status = user_ops.copy_array_from_user(entries, n, done);
+        if (status != ZX_OK)
+            return status;
+
+        // consecutive batchable entries go down together; anything else, like
+        // LOCK and UNLOCK, runs on its own so the order is kept
+        VmRangeOp ops[kRangeOpBatchChunk];
+        size_t slots[kRangeOpBatchChunk];
+        size_t pending = 0;
+        auto flush = [&]() {
+            if (pending == 0)
+                return;
+            vmo_->RangeOpBatch(ops, pending);
+            for (size_t j = 0; j < pending; j++) {
+                entries[slots[j]].status = ops[j].status;
+            }
+            pending = 0;
+        };
+
+        for (size_t i = 0; i < n; i++) {
+            zx_vmo_op_range_entry_t& entry = entries[i];
+            VmRangeOp::Type type;
+            zx_rights_t needed;
+            if (!ToVmRangeOp(entry.op, &type, &needed)) {
+                flush();
+                entry.status = RangeOp(entry.op, entry.offset, entry.size,
+                                       user_inout_ptr<void>(nullptr), 0, rights);
+            } else if ((rights & needed) == 0) {
+                entry.status = ZX_ERR_ACCESS_DENIED;
+            } else {
+                ops[pending] = {type, entry.offset, entry.size, ZX_OK};
+                slots[pending] = i;
+                pending++;
+            }
+        }
+        flush();
+
+        status = user_ops.copy_array_to_user(entries, n, done);
+        if (status != ZX_OK)
+            return status;
+
+        done += n;
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectDispatcher::SetMappingCachePolicy(uint32_t cache_policy) {
     return vmo_->SetMappingCachePolicy(cache_policy);
 }
@@ -207,8 +341,17 @@ zx_status_t VmObjectDispatcher::Clone(uint32_t options, uint64_t offset, uint64_
         options &= ~ZX_VMO_CLONE_NON_RESIZEABLE;
     }
 
+    // snapshots are never resizable
+    bool snapshot = false;
+    if (options & ZX_VMO_CLONE_SNAPSHOT) {
+        snapshot = true;
+        options &= ~ZX_VMO_CLONE_SNAPSHOT;
+    }
+
     if (options)
         return ZX_ERR_INVALID_ARGS;
 
+    if (snapshot)
+        return vmo_->CloneSnapshot(offset, size, copy_name, clone_vmo);
     return vmo_->CloneCOW(resizable, offset, size, copy_name, clone_vmo);
 }
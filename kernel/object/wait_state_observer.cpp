@@ -30,6 +30,7 @@ zx_status_t WaitStateObserver::Begin(Event* event,
     watched_signals_ = watched_signals;
     dispatcher_ = handle->dispatcher();
     wakeup_reasons_ = 0u;
+    set_interest(watched_signals);
 
     auto status = dispatcher_->add_observer(this);
     if (status != ZX_OK) {
@@ -43,11 +44,14 @@ zx_signals_t WaitStateObserver::End() {
     canary_.Assert();
     DEBUG_ASSERT(dispatcher_);
 
-    dispatcher_->RemoveObserver(this);
+    // We are only told about changes to the watched signals, so pick up
+    // whatever else is asserted now.
+    wakeup_reasons_ |= dispatcher_->RemoveObserver(this);
     dispatcher_.reset();
 
     // Return the set of reasons that we may have been woken.  Basically, this
-    // is set of satisfied bits which were ever set while we were waiting on the list.
+    // is set of satisfied bits which were ever set while we were waiting on the
+    // list, as far as changes to the watched signals let us see them.
     return wakeup_reasons_;
 }
 
@@ -0,0 +1,329 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/waitset_dispatcher.h>
+
+#include <assert.h>
+#include <err.h>
+
+#include <fbl/alloc_checker.h>
+#include <lib/counters.h>
+#include <object/thread_dispatcher.h>
+
+KCOUNTER(dispatcher_waitset_create_count, "dispatcher.waitset.create");
+KCOUNTER(dispatcher_waitset_destroy_count, "dispatcher.waitset.destroy");
+
+// One handle in the set. It lives on the observer list of the handle's object
+// and follows its signals; everything but the constants is guarded by the
+// wait set's lock.
+//
+// An entry is freed by whichever of these comes last: the wait set taking it
+// out of the set, or OnRemoved() taking it off the object's observer list.
+// OnRemoved() runs after the object's lock is dropped, by which time the wait
+// set's last handle may have closed, so the entry keeps the wait set alive.
+class WaitSetDispatcher::Entry final :
+    public StateObserver, public fbl::WAVLTreeContainable<Entry*> {
+public:
+    Entry(fbl::RefPtr<WaitSetDispatcher> waitset, Handle* handle, uint64_t key,
+          zx_signals_t signals, uint32_t options)
+        : waitset_(fbl::move(waitset)), handle_(handle), object_(handle->dispatcher()), key_(key),
+          watched_(signals), edge_(options & ZX_WAITSET_EDGE) {}
+
+    uint64_t GetKey() const { return key_; }
+
+private:
+    friend class WaitSetDispatcher;
+    friend struct WaitSetDispatcher::ReadyListTraits;
+
+    // StateObserver overrides.
+    Flags OnInitialize(zx_signals_t initial_state, const StateObserver::CountInfo* cinfo) final {
+        Guard<fbl::Mutex> guard{waitset_->get_lock()};
+        attached_ = true;
+        observed_ = initial_state;
+        if (initial_state & watched_) {
+            waitset_->OnEntryReady(this);
+        }
+        return 0;
+    }
+
+    Flags OnStateChange(zx_signals_t new_state) final {
+        Guard<fbl::Mutex> guard{waitset_->get_lock()};
+        zx_signals_t raised = new_state & ~observed_;
+        observed_ = new_state;
+        if (!in_set_) {
+            return 0;
+        }
+
+        if (edge_) {
+            // stays ready until reported, even if the signal drops again
+            if (raised & watched_) {
+                waitset_->OnEntryReady(this);
+            }
+        } else if (new_state & watched_) {
+            waitset_->OnEntryReady(this);
+        } else {
+            waitset_->OnEntryNotReady(this);
+        }
+        return 0;
+    }
+
+    Flags OnCancel(const Handle* handle) final {
+        if (handle != handle_) {
+            return 0;
+        }
+
+        Guard<fbl::Mutex> guard{waitset_->get_lock()};
+        observed_ |= ZX_SIGNAL_HANDLE_CLOSED;
+        status_ = ZX_ERR_CANCELED;
+        if (in_set_) {
+            waitset_->OnEntryReady(this);
+        }
+        return kHandled | kNeedRemoval;
+    }
+
+    // The wait set cancels an entry using the entry itself as the port
+    // cookie, which no other observer can match.
+    Flags OnCancelByKey(const Handle* handle, const void* port, uint64_t key) final {
+        if (port != this) {
+            return 0;
+        }
+        return kHandled | kNeedRemoval;
+    }
+
+    void OnRemoved() final {
+        bool free;
+        {
+            Guard<fbl::Mutex> guard{waitset_->get_lock()};
+            attached_ = false;
+            free = !in_set_;
+        }
+        if (free) {
+            delete this;
+        }
+    }
+
+    const fbl::RefPtr<WaitSetDispatcher> waitset_;
+    // only compared against, never dereferenced
+    const Handle* const handle_;
+    const fbl::RefPtr<Dispatcher> object_;
+    const uint64_t key_;
+    const zx_signals_t watched_;
+    const bool edge_;
+
+    zx_signals_t observed_ = 0u;
+    zx_status_t status_ = ZX_OK;
+    // on |entries_|
+    bool in_set_ = true;
+    // on the object's observer list
+    bool attached_ = false;
+
+    fbl::DoublyLinkedListNodeState<Entry*> ready_node_;
+};
+
+struct WaitSetDispatcher::ReadyListTraits {
+    static fbl::DoublyLinkedListNodeState<Entry*>& node_state(Entry& entry) {
+        return entry.ready_node_;
+    }
+};
+
+zx_status_t WaitSetDispatcher::Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
+                                      zx_rights_t* rights) {
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) WaitSetDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    *rights = default_rights();
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+WaitSetDispatcher::WaitSetDispatcher() {
+    event_init(&event_, false, 0);
+    kcounter_add(dispatcher_waitset_create_count, 1);
+}
+
+WaitSetDispatcher::~WaitSetDispatcher() {
+    DEBUG_ASSERT(entries_.is_empty());
+    DEBUG_ASSERT(ready_.is_empty());
+    event_destroy(&event_);
+    kcounter_add(dispatcher_waitset_destroy_count, 1);
+}
+
+void WaitSetDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> registration_guard{&registration_lock_};
+    for (;;) {
+        Entry* entry;
+        fbl::RefPtr<Dispatcher> object;
+        {
+            Guard<fbl::Mutex> guard{get_lock()};
+            if (entries_.is_empty())
+                break;
+            entry = &*entries_.begin();
+            object = TakeEntryLocked(entry);
+        }
+        if (object) {
+            object->CancelByKey(nullptr, entry, 0u);
+        } else {
+            delete entry;
+        }
+    }
+}
+
+zx_status_t WaitSetDispatcher::AddEntry(Handle* handle, uint64_t key, zx_signals_t signals,
+                                        uint32_t options) {
+    canary_.Assert();
+
+    if (options & ~ZX_WAITSET_EDGE)
+        return ZX_ERR_INVALID_ARGS;
+
+    Guard<fbl::Mutex> registration_guard{&registration_lock_};
+
+    fbl::AllocChecker ac;
+    auto entry = new (&ac) Entry(fbl::WrapRefPtr(this), handle, key, signals, options);
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        zx_status_t status = ZX_OK;
+        if (entries_.size() >= kMaxEntries) {
+            status = ZX_ERR_NO_RESOURCES;
+        } else if (entries_.find(key).IsValid()) {
+            status = ZX_ERR_ALREADY_EXISTS;
+        }
+        if (status != ZX_OK) {
+            delete entry;
+            return status;
+        }
+        entries_.insert(entry);
+    }
+
+    // Removal is held off by the registration lock, so the entry is still
+    // ours until it is on the object's list.
+    zx_status_t status = handle->dispatcher()->add_observer(entry);
+    if (status != ZX_OK) {
+        {
+            Guard<fbl::Mutex> guard{get_lock()};
+            entries_.erase(*entry);
+        }
+        delete entry;
+    }
+    return status;
+}
+
+zx_status_t WaitSetDispatcher::RemoveEntry(uint64_t key) {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> registration_guard{&registration_lock_};
+
+    Entry* entry;
+    fbl::RefPtr<Dispatcher> object;
+    {
+        Guard<fbl::Mutex> guard{get_lock()};
+        auto it = entries_.find(key);
+        if (!it.IsValid())
+            return ZX_ERR_NOT_FOUND;
+        entry = &*it;
+        object = TakeEntryLocked(entry);
+    }
+
+    if (object) {
+        object->CancelByKey(nullptr, entry, 0u);
+    } else {
+        delete entry;
+    }
+    return ZX_OK;
+}
+
+fbl::RefPtr<Dispatcher> WaitSetDispatcher::TakeEntryLocked(Entry* entry) {
+    entries_.erase(*entry);
+    if (entry->ready_node_.InContainer()) {
+        OnEntryNotReady(entry);
+    }
+    entry->in_set_ = false;
+    return entry->attached_ ? entry->object_ : nullptr;
+}
+
+void WaitSetDispatcher::OnEntryReady(Entry* entry) {
+    if (entry->ready_node_.InContainer())
+        return;
+    ready_.push_back(entry);
+    event_signal(&event_, true);
+}
+
+void WaitSetDispatcher::OnEntryNotReady(Entry* entry) {
+    if (!entry->ready_node_.InContainer())
+        return;
+    ready_.erase(*entry);
+    if (ready_.is_empty()) {
+        event_unsignal(&event_);
+    }
+}
+
+zx_status_t WaitSetDispatcher::Wait(zx_time_t deadline, zx_waitset_result_t* results,
+                                    size_t count, size_t* actual) {
+    canary_.Assert();
+    DEBUG_ASSERT(count > 0);
+
+    for (;;) {
+        size_t n = 0;
+        // entries whose handle was closed, off every list and ours to free
+        fbl::DoublyLinkedList<Entry*, ReadyListTraits> done;
+        {
+            Guard<fbl::Mutex> guard{get_lock()};
+
+            // level-triggered entries stay ready; they go back behind the
+            // others so that every ready entry gets its turn
+            fbl::DoublyLinkedList<Entry*, ReadyListTraits> still_ready;
+
+            while (n < count && !ready_.is_empty()) {
+                Entry* entry = ready_.pop_front();
+                results[n].key = entry->key_;
+                results[n].status = entry->status_;
+                results[n].observed = entry->observed_;
+                ++n;
+
+                if (entry->status_ != ZX_OK) {
+                    entries_.erase(*entry);
+                    entry->in_set_ = false;
+                    if (!entry->attached_) {
+                        done.push_back(entry);
+                    }
+                } else if (!entry->edge_) {
+                    still_ready.push_back(entry);
+                }
+            }
+
+            ready_.splice(ready_.end(), still_ready);
+            if (ready_.is_empty()) {
+                event_unsignal(&event_);
+            }
+        }
+
+        while (!done.is_empty()) {
+            delete done.pop_front();
+        }
+
+        if (n > 0) {
+            *actual = n;
+            return ZX_OK;
+        }
+
+        zx_status_t status;
+        {
+            ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::WAIT_MANY);
+            status = event_wait_deadline(&event_, deadline, true);
+        }
+        if (status != ZX_OK)
+            return status;
+    }
+}
@@ -9,13 +9,17 @@
 #include <acpica/acpi.h>
 
 #include <assert.h>
+#include <debug.h>
 #include <err.h>
+#include <inttypes.h>
 #include <trace.h>
 
 #include <lk/init.h>
 
 #include <arch/x86/apic.h>
+#include <arch/x86/mp.h>
 #include <platform/pc/acpi.h>
+#include <vm/pmm.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
@@ -307,3 +311,108 @@ zx_status_t platform_find_hpet(struct acpi_hpet_descriptor* hpet) {
 
     return ZX_OK;
 }
+
+// Proximity domains are arbitrary 32-bit values; hand out dense pmm node
+// numbers in the order they first show up in the SRAT. Any domains past what
+// the pmm can track share its last node.
+static uint acpi_proximity_domain_to_node(uint32_t domain, uint32_t* domains, uint* count) {
+    for (uint i = 0; i < *count; i++) {
+        if (domains[i] == domain) {
+            return i;
+        }
+    }
+    if (*count == PMM_MAX_NUMA_NODES) {
+        return PMM_MAX_NUMA_NODES - 1;
+    }
+    domains[*count] = domain;
+    return (*count)++;
+}
+
+/* @brief Report the NUMA topology described by the SRAT to the pmm
+ *
+ * Must be called after the cpus have been enumerated, so that processor
+ * affinity entries can be matched up with cpu numbers.
+ */
+void platform_init_numa(void) {
+    ACPI_TABLE_HEADER* table = NULL;
+    ACPI_STATUS acpi_status = AcpiGetTable((char*)ACPI_SIG_SRAT, 1, &table);
+    if (acpi_status != AE_OK) {
+        LTRACEF("no SRAT, assuming a single NUMA node\n");
+        return;
+    }
+
+    uintptr_t records_start = ((uintptr_t)table) + sizeof(ACPI_TABLE_SRAT);
+    uintptr_t records_end = ((uintptr_t)table) + table->Length;
+    if (records_start >= records_end) {
+        TRACEF("malformed SRAT\n");
+        return;
+    }
+
+    uint32_t domains[PMM_MAX_NUMA_NODES];
+    uint domain_count = 0;
+
+    uintptr_t addr;
+    ACPI_SUBTABLE_HEADER* record_hdr;
+    for (addr = records_start; addr < records_end; addr += record_hdr->Length) {
+        record_hdr = (ACPI_SUBTABLE_HEADER*)addr;
+        if (record_hdr->Length == 0) {
+            break;
+        }
+
+        uint32_t apic_id;
+        uint32_t domain;
+        switch (record_hdr->Type) {
+        case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+            ACPI_SRAT_CPU_AFFINITY* cpu = (ACPI_SRAT_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_USE_AFFINITY)) {
+                continue;
+            }
+            apic_id = cpu->ApicId;
+            domain = cpu->ProximityDomainLo |
+                     ((uint32_t)cpu->ProximityDomainHi[0] << 8) |
+                     ((uint32_t)cpu->ProximityDomainHi[1] << 16) |
+                     ((uint32_t)cpu->ProximityDomainHi[2] << 24);
+            break;
+        }
+        case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+            ACPI_SRAT_X2APIC_CPU_AFFINITY* cpu = (ACPI_SRAT_X2APIC_CPU_AFFINITY*)record_hdr;
+            if (!(cpu->Flags & ACPI_SRAT_CPU_ENABLED)) {
+                continue;
+            }
+            apic_id = cpu->ApicId;
+            domain = cpu->ProximityDomain;
+            break;
+        }
+        case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+            ACPI_SRAT_MEM_AFFINITY* mem = (ACPI_SRAT_MEM_AFFINITY*)record_hdr;
+            if (!(mem->Flags & ACPI_SRAT_MEM_ENABLED) || mem->Length == 0) {
+                continue;
+            }
+            uint node = acpi_proximity_domain_to_node(mem->ProximityDomain, domains, &domain_count);
+            LTRACEF("memory %#" PRIx64 " size %#" PRIx64 " node %u\n",
+                    mem->BaseAddress, mem->Length, node);
+            zx_status_t status = pmm_set_numa_range(mem->BaseAddress, mem->Length, node);
+            if (status != ZX_OK) {
+                TRACEF("failed to record memory affinity at %#" PRIx64 ": %d\n",
+                       mem->BaseAddress, status);
+            }
+            continue;
+        }
+        default:
+            continue;
+        }
+
+        // cpus that were filtered out or not brought up have no number
+        int cpu_num = x86_apic_id_to_cpu_num(apic_id);
+        if (cpu_num < 0) {
+            continue;
+        }
+        uint node = acpi_proximity_domain_to_node(domain, domains, &domain_count);
+        LTRACEF("cpu %d apic id %#x node %u\n", cpu_num, apic_id, node);
+        pmm_set_cpu_numa_node(cpu_num, node);
+    }
+
+    if (domain_count > 1) {
+        dprintf(INFO, "ACPI: %u NUMA nodes\n", domain_count);
+    }
+}
@@ -10,6 +10,7 @@
 #include <arch/x86.h>
 #include <arch/x86/apic.h>
 #include <arch/x86/interrupts.h>
+#include <arch/x86/mp.h>
 #include <assert.h>
 #include <debug.h>
 #include <dev/interrupt.h>
@@ -20,6 +21,7 @@
 #include <kernel/thread.h>
 #include <lib/pow2_range_allocator.h>
 #include <lk/init.h>
+#include <platform.h>
 #include <platform/pc.h>
 #include <platform/pc/acpi.h>
 #include <platform/pic.h>
@@ -41,6 +43,9 @@ struct int_handler_struct {
 };
 
 static SpinLock lock;
+// CPUs being taken offline.  No interrupt is steered at these; see
+// pc_interrupts_prep_cpu_unplug().
+static cpu_mask_t unplugging_cpus TA_GUARDED(lock);
 static struct int_handler_struct int_handler_table[X86_INT_COUNT];
 static p2ra_state_t x86_irq_vector_allocator;
 
@@ -152,6 +157,51 @@ zx_status_t configure_interrupt(unsigned int vector,
     return ZX_OK;
 }
 
+// The xAPIC destination of |cpu|, for IOAPIC RTEs and MSI addresses. Without
+// interrupt remapping only 8-bit APIC IDs can be targeted.
+static zx_status_t cpu_to_interrupt_dst(cpu_num_t cpu, uint8_t* dst) TA_REQ(lock) {
+    if (cpu >= arch_max_num_cpus() || !mp_is_cpu_active(cpu) ||
+        (unplugging_cpus & cpu_num_to_mask(cpu)))
+        return ZX_ERR_INVALID_ARGS;
+    uint32_t apic_id = x86_cpu_num_to_apic_id(cpu);
+    if (apic_id > 0xff)
+        return ZX_ERR_NOT_SUPPORTED;
+    *dst = static_cast<uint8_t>(apic_id);
+    return ZX_OK;
+}
+
+zx_status_t set_interrupt_affinity(unsigned int vector, cpu_num_t cpu) {
+    if (!apic_io_is_valid_irq(vector))
+        return ZX_ERR_INVALID_ARGS;
+
+    AutoSpinLock guard(&lock);
+
+    uint8_t dst;
+    zx_status_t status = cpu_to_interrupt_dst(cpu, &dst);
+    if (status != ZX_OK)
+        return status;
+
+    apic_io_configure_irq_dst(vector, dst);
+    return ZX_OK;
+}
+
+void pc_interrupts_prep_cpu_unplug(cpu_num_t cpu) {
+    DEBUG_ASSERT(cpu != BOOT_CPU_ID);
+
+    AutoSpinLock guard(&lock);
+    unplugging_cpus |= cpu_num_to_mask(cpu);
+
+    // Lines are only ever steered at CPUs with 8-bit APIC IDs.
+    uint32_t apic_id = x86_cpu_num_to_apic_id(cpu);
+    if (apic_id <= 0xff)
+        apic_io_move_irqs_dst(static_cast<uint8_t>(apic_id), apic_bsp_id());
+}
+
+void pc_interrupts_cpu_hotplug(cpu_num_t cpu) {
+    AutoSpinLock guard(&lock);
+    unplugging_cpus &= ~cpu_num_to_mask(cpu);
+}
+
 zx_status_t get_interrupt_config(unsigned int vector,
                                  enum interrupt_trigger_mode* tm,
                                  enum interrupt_polarity* pol) {
@@ -269,7 +319,8 @@ void shutdown_interrupts(void) {
 }
 
 void shutdown_interrupts_curr_cpu(void) {
-    // TODO(maniscalco): Walk interrupt redirection entries and make sure nothing targets this CPU.
+    // Interrupts steered at this CPU were moved to the boot CPU by
+    // pc_interrupts_prep_cpu_unplug() before it was taken offline.
 }
 
 // Intel 64 socs support the IOAPIC and Local APIC which support MSI by default.
@@ -345,6 +396,22 @@ void msi_free_block(msi_block_t* block) {
     memset(block, 0, sizeof(*block));
 }
 
+zx_status_t msi_set_affinity(msi_block_t* block, cpu_num_t cpu) {
+    DEBUG_ASSERT(block && block->allocated);
+
+    AutoSpinLock guard(&lock);
+
+    uint8_t dst;
+    zx_status_t status = cpu_to_interrupt_dst(cpu, &dst);
+    if (status != ZX_OK)
+        return status;
+
+    // Only the Dest ID changes; see msi_alloc_block for the rest of the
+    // address.
+    block->tgt_addr = (block->tgt_addr & ~0xFF000ull) | (static_cast<uint64_t>(dst) << 12);
+    return ZX_OK;
+}
+
 void msi_register_handler(const msi_block_t* block, uint msi_id, int_handler handler, void* ctx) {
     DEBUG_ASSERT(block && block->allocated);
     DEBUG_ASSERT(msi_id < block->num_irq);
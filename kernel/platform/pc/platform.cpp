@@ -894,8 +894,29 @@ static void platform_init_smp(void) {
 }
 
 zx_status_t platform_mp_prep_cpu_unplug(uint cpu_id) {
-    // TODO: Make sure the IOAPIC and PCI have nothing for this CPU
-    return arch_mp_prep_cpu_unplug(cpu_id);
+    zx_status_t status = arch_mp_prep_cpu_unplug(cpu_id);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Nothing may be steered at the CPU from here on; move the IOAPIC lines
+    // and MSIs that already are over to the boot CPU.
+    pc_interrupts_prep_cpu_unplug(cpu_id);
+#ifdef WITH_KERNEL_PCIE
+    fbl::RefPtr<PcieBusDriver> pcie = PcieBusDriver::GetDriver();
+    if (pcie != nullptr) {
+        pcie->MigrateIrqsOffCpu(cpu_id);
+    }
+#endif
+    return ZX_OK;
+}
+
+zx_status_t platform_mp_cpu_hotplug(uint cpu_id) {
+    zx_status_t status = arch_mp_cpu_hotplug(cpu_id);
+    if (status == ZX_OK) {
+        pc_interrupts_cpu_hotplug(cpu_id);
+    }
+    return status;
 }
 
 const char* manufacturer = "unknown";
@@ -912,6 +933,8 @@ void platform_init(void) {
 
     platform_init_smp();
 
+    platform_init_numa();
+
     pc_init_smbios();
 
     SmbiosWalkStructs([](smbios::SpecVersion version, const smbios::Header* h,
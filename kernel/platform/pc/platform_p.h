@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <kernel/cpu.h>
 #include <lib/cbuf.h>
 #include <sys/types.h>
 #include <zircon/compiler.h>
@@ -37,6 +38,12 @@ void pc_resume_timer(void);
 void pc_resume_debug(void);
 void pc_suspend_debug(void);
 
+// Stop steering interrupts at |cpu|, and move the IOAPIC lines already
+// steered at it to the boot CPU.  Called before |cpu| is taken offline.
+void pc_interrupts_prep_cpu_unplug(cpu_num_t cpu);
+// Allow interrupts to be steered at |cpu| again once it is back online.
+void pc_interrupts_cpu_hotplug(cpu_num_t cpu);
+
 typedef void (*enumerate_e820_callback)(uint64_t base, uint64_t size, bool is_mem, void* ctx);
 zx_status_t enumerate_e820(enumerate_e820_callback callback, void* ctx);
 
@@ -44,6 +44,10 @@ public:
                             void* ctx) override {
         msi_register_handler(block, msi_id, handler, ctx);
     }
+
+    zx_status_t SetMsiAffinity(msi_block_t* block, cpu_num_t cpu) override {
+        return msi_set_affinity(block, cpu);
+    }
 };
 
 X86PciePlatformSupport platform_pcie_support;
@@ -138,6 +142,8 @@ static void x86_pcie_init_hook(uint level) {
     }
 }
 
-LK_INIT_HOOK(x86_pcie_init, x86_pcie_init_hook, LK_INIT_LEVEL_PLATFORM);
+// Nothing else at this level needs the bus driver; it only has to be ready
+// for userspace.
+LK_INIT_HOOK_ASYNC(x86_pcie_init, x86_pcie_init_hook, LK_INIT_LEVEL_PLATFORM);
 
 #endif // WITH_KERNEL_PCIE
@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <lib/counters.h>
+#include <lib/user_copy/user_ptr.h>
+
+#include <object/aspace_template_dispatcher.h>
+#include <object/handle.h>
+#include <object/process_dispatcher.h>
+#include <object/vm_address_region_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+
+#include <fbl/auto_call.h>
+#include <fbl/ref_ptr.h>
+#include <zircon/types.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+KCOUNTER(aspace_template_apply, "kernel.aspace_template.apply");
+
+// zx_status_t zx_aspace_template_create
+zx_status_t sys_aspace_template_create(uint32_t options, user_out_handle* out) {
+    LTRACEF("options %u\n", options);
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    zx_status_t status = AspaceTemplateDispatcher::Create(options, &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+// zx_status_t zx_aspace_template_add
+zx_status_t sys_aspace_template_add(zx_handle_t handle, zx_vm_option_t options, uint64_t offset,
+                                    zx_handle_t vmo_handle, uint64_t vmo_offset, uint64_t len) {
+    LTRACEF("template %x options %#x offset %#" PRIx64 " vmo %x vmo_offset %#" PRIx64
+            " len %#" PRIx64 "\n", handle, options, offset, vmo_handle, vmo_offset, len);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<AspaceTemplateDispatcher> aspace_template;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &aspace_template);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    zx_rights_t vmo_rights;
+    status = up->GetDispatcherAndRights(vmo_handle, &vmo, &vmo_rights);
+    if (status != ZX_OK)
+        return status;
+
+    return aspace_template->AddEntry(vmo->vmo(), vmo_rights, options, offset, vmo_offset, len);
+}
+
+// zx_status_t zx_aspace_template_apply
+zx_status_t sys_aspace_template_apply(zx_handle_t handle, zx_handle_t vmar_handle,
+                                      zx_vm_option_t options, uint64_t offset,
+                                      user_out_handle* child_vmar,
+                                      user_out_ptr<zx_vaddr_t> child_addr) {
+    LTRACEF("template %x vmar %x options %#x offset %#" PRIx64 "\n",
+            handle, vmar_handle, options, offset);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<AspaceTemplateDispatcher> aspace_template;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &aspace_template);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmAddressRegionDispatcher> vmar;
+    zx_rights_t vmar_rights;
+    status = up->GetDispatcherAndRights(vmar_handle, &vmar, &vmar_rights);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmAddressRegionDispatcher> new_vmar;
+    zx_rights_t new_rights;
+    status = aspace_template->Apply(vmar.get(), vmar_rights, options, offset,
+                                    &new_vmar, &new_rights);
+    if (status != ZX_OK)
+        return status;
+
+    kcounter_add(aspace_template_apply, 1);
+
+    // As in zx_vmar_allocate(), the VMAR and everything in it goes away if
+    // the results can't be handed back.
+    auto cleanup_handler = fbl::MakeAutoCall([new_vmar]() {
+        new_vmar->Destroy();
+    });
+
+    uintptr_t base = new_vmar->vmar()->base();
+
+    status = child_vmar->make(fbl::move(new_vmar), new_rights);
+
+    if (status == ZX_OK)
+        status = child_addr.copy_to_user(base);
+
+    if (status == ZX_OK)
+        cleanup_handler.cancel();
+    return status;
+}
@@ -114,14 +114,28 @@ static void msg_get_handles(ProcessDispatcher* up, MessagePacket* msg,
     }
 }
 
-template <typename HandleInfoT>
+// The destination of zx_channel_readv(): the caller's iovecs, copied in.
+struct IovecsOut {
+    const zx_channel_iovec_t* iovecs;
+    uint32_t num_iovecs;
+};
+
+static zx_status_t copy_data_to(const MessagePacket* msg, user_out_ptr<void> bytes) {
+    return msg->CopyDataTo(bytes);
+}
+
+static zx_status_t copy_data_to(const MessagePacket* msg, const IovecsOut& out) {
+    return msg->CopyDataTo(out.iovecs, out.num_iovecs);
+}
+
+template <typename HandleInfoT, typename BytesT>
 static zx_status_t channel_read(zx_handle_t handle_value, uint32_t options,
-                             user_out_ptr<void> bytes, user_out_ptr<HandleInfoT> handles,
+                             const BytesT& bytes, user_out_ptr<HandleInfoT> handles,
                              uint32_t num_bytes, uint32_t num_handles,
                              user_out_ptr<uint32_t> actual_bytes,
                              user_out_ptr<uint32_t> actual_handles) {
-    LTRACEF("handle %x bytes %p num_bytes %p handles %p num_handles %p",
-            handle_value, bytes.get(), actual_bytes.get(), handles.get(), actual_handles.get());
+    LTRACEF("handle %x num_bytes %p handles %p num_handles %p",
+            handle_value, actual_bytes.get(), handles.get(), actual_handles.get());
 
     auto up = ProcessDispatcher::GetCurrent();
 
@@ -157,7 +171,7 @@ static zx_status_t channel_read(zx_handle_t handle_value, uint32_t options,
         return result;
 
     if (num_bytes > 0u) {
-        if (msg->CopyDataTo(bytes) != ZX_OK)
+        if (copy_data_to(msg.get(), bytes) != ZX_OK)
             return ZX_ERR_INVALID_ARGS;
     }
 
@@ -194,6 +208,33 @@ zx_status_t sys_channel_read_etc(zx_handle_t handle_value, uint32_t options,
         bytes, handle_info, num_bytes, num_handles, actual_bytes, actual_handles);
 }
 
+// zx_status_t zx_channel_readv
+zx_status_t sys_channel_readv(zx_handle_t handle_value, uint32_t options,
+                              user_in_ptr<const zx_channel_iovec_t> user_iovecs,
+                              uint32_t num_iovecs,
+                              user_out_ptr<zx_handle_t> handle_info, uint32_t num_handles,
+                              user_out_ptr<uint32_t> actual_bytes,
+                              user_out_ptr<uint32_t> actual_handles) {
+    if (num_iovecs > kMaxMessageIovecs)
+        return ZX_ERR_OUT_OF_RANGE;
+
+    zx_channel_iovec_t iovecs[kMaxMessageIovecs];
+    zx_status_t status = user_iovecs.copy_array_from_user(iovecs, num_iovecs);
+    if (status != ZX_OK)
+        return status;
+
+    // No message is larger than kMaxMessageSize, so capping the total is harmless.
+    uint32_t num_bytes = 0u;
+    for (uint32_t i = 0; i < num_iovecs; ++i) {
+        if (iovecs[i].reserved != 0u)
+            return ZX_ERR_INVALID_ARGS;
+        num_bytes += fbl::min(iovecs[i].capacity, kMaxMessageSize - num_bytes);
+    }
+
+    return channel_read(handle_value, options, IovecsOut{iovecs, num_iovecs},
+        handle_info, num_bytes, num_handles, actual_bytes, actual_handles);
+}
+
 static zx_status_t channel_read_out(ProcessDispatcher* up,
                                     fbl::unique_ptr<MessagePacket> reply,
                                     zx_channel_call_args_t* args,
@@ -277,20 +318,14 @@ static zx_status_t msg_put_handles(ProcessDispatcher* up, MessagePacket* msg,
     return status;
 }
 
-// zx_status_t zx_channel_write
-zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
-                              user_in_ptr<const void> user_bytes, uint32_t num_bytes,
-                              user_in_ptr<const zx_handle_t> user_handles, uint32_t num_handles) {
-    LTRACEF("handle %x bytes %p num_bytes %u handles %p num_handles %u options 0x%x\n",
-            handle_value, user_bytes.get(), num_bytes, user_handles.get(), num_handles, options);
-
+// Writes a message built by |create| from the caller's bytes, along with
+// |user_handles|, which are discarded if anything fails.
+template <typename CreateFn>
+static zx_status_t channel_write(zx_handle_t handle_value,
+                                 user_in_ptr<const zx_handle_t> user_handles,
+                                 uint32_t num_handles, CreateFn create) {
     auto up = ProcessDispatcher::GetCurrent();
 
-    if (options != 0u) {
-        up->RemoveHandles(user_handles, num_handles);
-        return ZX_ERR_INVALID_ARGS;
-    }
-
     fbl::RefPtr<ChannelDispatcher> channel;
     zx_status_t status = up->GetDispatcherWithRights(handle_value, ZX_RIGHT_WRITE, &channel);
     if (status != ZX_OK) {
@@ -299,11 +334,12 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     }
 
     fbl::unique_ptr<MessagePacket> msg;
-    status = MessagePacket::Create(user_bytes, num_bytes, num_handles, &msg);
+    status = create(&msg);
     if (status != ZX_OK) {
         up->RemoveHandles(user_handles, num_handles);
         return status;
     }
+    const uint32_t num_bytes = msg->data_size();
 
     if (num_handles > 0u) {
         status = msg_put_handles(up, msg.get(), user_handles, num_handles,
@@ -320,6 +356,58 @@ zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
     return ZX_OK;
 }
 
+// zx_status_t zx_channel_write
+zx_status_t sys_channel_write(zx_handle_t handle_value, uint32_t options,
+                              user_in_ptr<const void> user_bytes, uint32_t num_bytes,
+                              user_in_ptr<const zx_handle_t> user_handles, uint32_t num_handles) {
+    LTRACEF("handle %x bytes %p num_bytes %u handles %p num_handles %u options 0x%x\n",
+            handle_value, user_bytes.get(), num_bytes, user_handles.get(), num_handles, options);
+
+    if (options & ~ZX_CHANNEL_WRITE_MOVE_PAGES) {
+        ProcessDispatcher::GetCurrent()->RemoveHandles(user_handles, num_handles);
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    return channel_write(handle_value, user_handles, num_handles,
+                         [&](fbl::unique_ptr<MessagePacket>* msg) {
+        if (options & ZX_CHANNEL_WRITE_MOVE_PAGES)
+            return MessagePacket::CreateMovingPages(user_bytes, num_bytes, num_handles, msg);
+        return MessagePacket::Create(user_bytes, num_bytes, num_handles, msg);
+    });
+}
+
+// zx_status_t zx_channel_writev
+zx_status_t sys_channel_writev(zx_handle_t handle_value, uint32_t options,
+                               user_in_ptr<const zx_channel_iovec_t> user_iovecs,
+                               uint32_t num_iovecs,
+                               user_in_ptr<const zx_handle_t> user_handles, uint32_t num_handles) {
+    LTRACEF("handle %x iovecs %p num_iovecs %u handles %p num_handles %u options 0x%x\n",
+            handle_value, user_iovecs.get(), num_iovecs, user_handles.get(), num_handles, options);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    if (options != 0u) {
+        up->RemoveHandles(user_handles, num_handles);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (num_iovecs > kMaxMessageIovecs) {
+        up->RemoveHandles(user_handles, num_handles);
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    zx_channel_iovec_t iovecs[kMaxMessageIovecs];
+    zx_status_t status = user_iovecs.copy_array_from_user(iovecs, num_iovecs);
+    if (status != ZX_OK) {
+        up->RemoveHandles(user_handles, num_handles);
+        return status;
+    }
+
+    return channel_write(handle_value, user_handles, num_handles,
+                         [&](fbl::unique_ptr<MessagePacket>* msg) {
+        return MessagePacket::Create(iovecs, num_iovecs, num_handles, msg);
+    });
+}
+
 // zx_status_t zx_channel_call_noretry
 zx_status_t sys_channel_call_noretry(zx_handle_t handle_value, uint32_t options,
                                      zx_time_t deadline,
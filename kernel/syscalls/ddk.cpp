@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <err.h>
+#include <inttypes.h>
 #include <platform.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -15,6 +16,7 @@
 #include <dev/interrupt.h>
 #include <dev/iommu.h>
 #include <dev/udisplay.h>
+#include <fbl/algorithm.h>
 #include <fbl/auto_call.h>
 #include <fbl/inline_array.h>
 #include <lib/user_copy/user_ptr.h>
@@ -298,6 +300,36 @@ zx_status_t sys_bti_create(zx_handle_t iommu, uint32_t options, uint64_t bti_id,
     return out->make(fbl::move(dispatcher), rights);
 }
 
+// Converts the ZX_BTI_PERM_* bits of |options| to Iommu::Map() flags,
+// checking them against |vmo_rights|.
+static zx_status_t bti_perms_to_iommu(uint32_t options, zx_rights_t vmo_rights,
+                                      uint32_t* iommu_perms) {
+    *iommu_perms = 0;
+    if (options & ZX_BTI_PERM_READ) {
+        if (!(vmo_rights & ZX_RIGHT_READ)) {
+            return ZX_ERR_ACCESS_DENIED;
+        }
+        *iommu_perms |= IOMMU_FLAG_PERM_READ;
+    }
+    if (options & ZX_BTI_PERM_WRITE) {
+        if (!(vmo_rights & ZX_RIGHT_WRITE)) {
+            return ZX_ERR_ACCESS_DENIED;
+        }
+        *iommu_perms |= IOMMU_FLAG_PERM_WRITE;
+    }
+    if (options & ZX_BTI_PERM_EXECUTE) {
+        // Note: We check ZX_RIGHT_READ instead of ZX_RIGHT_EXECUTE
+        // here because the latter applies to execute permission of
+        // the host CPU, whereas ZX_BTI_PERM_EXECUTE applies to
+        // transactions initiated by the bus device.
+        if (!(vmo_rights & ZX_RIGHT_READ)) {
+            return ZX_ERR_ACCESS_DENIED;
+        }
+        *iommu_perms |= IOMMU_FLAG_PERM_EXECUTE;
+    }
+    return ZX_OK;
+}
+
 // zx_status_t zx_bti_pin
 zx_status_t sys_bti_pin(zx_handle_t bti, uint32_t options, zx_handle_t vmo, uint64_t offset,
                         uint64_t size, user_out_ptr<zx_paddr_t> addrs, size_t addrs_count,
@@ -324,33 +356,19 @@ zx_status_t sys_bti_pin(zx_handle_t bti, uint32_t options, zx_handle_t vmo, uint
     }
 
     // Convert requested permissions and check against VMO rights
-    uint32_t iommu_perms = 0;
+    uint32_t iommu_perms;
+    status = bti_perms_to_iommu(options, vmo_rights, &iommu_perms);
+    if (status != ZX_OK) {
+        return status;
+    }
+    options &= ~(ZX_BTI_PERM_READ | ZX_BTI_PERM_WRITE | ZX_BTI_PERM_EXECUTE);
+
     bool compress_results = false;
     bool contiguous = false;
-    if (options & ZX_BTI_PERM_READ) {
-        if (!(vmo_rights & ZX_RIGHT_READ)) {
-            return ZX_ERR_ACCESS_DENIED;
-        }
-        iommu_perms |= IOMMU_FLAG_PERM_READ;
-        options &= ~ZX_BTI_PERM_READ;
-    }
-    if (options & ZX_BTI_PERM_WRITE) {
-        if (!(vmo_rights & ZX_RIGHT_WRITE)) {
-            return ZX_ERR_ACCESS_DENIED;
-        }
-        iommu_perms |= IOMMU_FLAG_PERM_WRITE;
-        options &= ~ZX_BTI_PERM_WRITE;
-    }
-    if (options & ZX_BTI_PERM_EXECUTE) {
-        // Note: We check ZX_RIGHT_READ instead of ZX_RIGHT_EXECUTE
-        // here because the latter applies to execute permission of
-        // the host CPU, whereas ZX_BTI_PERM_EXECUTE applies to
-        // transactions initiated by the bus device.
-        if (!(vmo_rights & ZX_RIGHT_READ)) {
-            return ZX_ERR_ACCESS_DENIED;
-        }
-        iommu_perms |= IOMMU_FLAG_PERM_EXECUTE;
-        options &= ~ZX_BTI_PERM_EXECUTE;
+    bool cache = false;
+    if (options & ZX_BTI_CACHED) {
+        cache = true;
+        options &= ~ZX_BTI_CACHED;
     }
     if (!((options & ZX_BTI_COMPRESS) && (options & ZX_BTI_CONTIGUOUS))) {
         if (options & ZX_BTI_COMPRESS) {
@@ -375,8 +393,8 @@ zx_status_t sys_bti_pin(zx_handle_t bti, uint32_t options, zx_handle_t vmo, uint
 
     fbl::RefPtr<Dispatcher> new_pmt;
     zx_rights_t new_pmt_rights;
-    status = bti_dispatcher->Pin(vmo_dispatcher->vmo(), offset, size, iommu_perms, &new_pmt,
-                                 &new_pmt_rights);
+    status = bti_dispatcher->Pin(vmo_dispatcher->vmo(), offset, size, iommu_perms, cache,
+                                 &new_pmt, &new_pmt_rights);
     if (status != ZX_OK) {
         return status;
     }
@@ -395,6 +413,131 @@ zx_status_t sys_bti_pin(zx_handle_t bti, uint32_t options, zx_handle_t vmo, uint
     return pmt->make(fbl::move(new_pmt), new_pmt_rights);
 }
 
+// zx_status_t zx_bti_pin_batch
+zx_status_t sys_bti_pin_batch(zx_handle_t bti, uint32_t options,
+                              user_in_ptr<const zx_bti_pin_range_t> _ranges, size_t count,
+                              user_out_ptr<zx_paddr_t> addrs, size_t addrs_count,
+                              user_out_ptr<zx_handle_t> _pmts) {
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<BusTransactionInitiatorDispatcher> bti_dispatcher;
+    zx_status_t status = up->GetDispatcherWithRights(bti, ZX_RIGHT_MAP, &bti_dispatcher);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    constexpr uint32_t kPermOptions = ZX_BTI_PERM_READ | ZX_BTI_PERM_WRITE | ZX_BTI_PERM_EXECUTE;
+    if (options & ~(kPermOptions | ZX_BTI_COMPRESS | ZX_BTI_CACHED)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const bool compress_results = options & ZX_BTI_COMPRESS;
+    const bool cache = options & ZX_BTI_CACHED;
+
+    constexpr size_t kMaxPinBatch = 16;
+    if (count == 0 || count > kMaxPinBatch) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_bti_pin_range_t ranges[kMaxPinBatch];
+    status = _ranges.copy_array_from_user(ranges, count);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Validate every range and size the address list before pinning anything.
+    const uint64_t min_contig = bti_dispatcher->minimum_contiguity();
+    fbl::RefPtr<VmObjectDispatcher> vmos[kMaxPinBatch];
+    uint32_t iommu_perms[kMaxPinBatch];
+    size_t range_addrs[kMaxPinBatch];
+    size_t total_addrs = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const zx_bti_pin_range_t& range = ranges[i];
+        if (range.reserved != 0 || !IS_PAGE_ALIGNED(range.offset) ||
+            !IS_PAGE_ALIGNED(range.size)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+
+        zx_rights_t vmo_rights;
+        status = up->GetDispatcherAndRights(range.vmo, &vmos[i], &vmo_rights);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (!(vmo_rights & ZX_RIGHT_MAP)) {
+            return ZX_ERR_ACCESS_DENIED;
+        }
+        status = bti_perms_to_iommu(options, vmo_rights, &iommu_perms[i]);
+        if (status != ZX_OK) {
+            return status;
+        }
+
+        range_addrs[i] = compress_results
+            ? range.size / min_contig + (range.size % min_contig != 0)
+            : range.size / PAGE_SIZE;
+        total_addrs += range_addrs[i];
+    }
+    if (total_addrs != addrs_count) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    constexpr size_t kAddrsLenLimitForStack = 4;
+    fbl::AllocChecker ac;
+    fbl::InlineArray<dev_vaddr_t, kAddrsLenLimitForStack> mapped_addrs(&ac, addrs_count);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // If we fail part way, mark what we pinned as unpinned before the handles
+    // go away, so memory the caller never saw is not quarantined.
+    fbl::RefPtr<PinnedMemoryTokenDispatcher> pmts[kMaxPinBatch];
+    HandleOwner handles[kMaxPinBatch];
+    zx_handle_t handle_values[kMaxPinBatch];
+    size_t pinned = 0;
+    auto unpin = fbl::MakeAutoCall([&]() {
+        for (size_t i = 0; i < pinned; ++i) {
+            pmts[i]->MarkUnpinned();
+        }
+    });
+
+    size_t next_addr = 0;
+    for (size_t i = 0; i < count; ++i) {
+        fbl::RefPtr<Dispatcher> new_pmt;
+        zx_rights_t new_pmt_rights;
+        status = bti_dispatcher->Pin(vmos[i]->vmo(), ranges[i].offset, ranges[i].size,
+                                     iommu_perms[i], cache, &new_pmt, &new_pmt_rights);
+        if (status != ZX_OK) {
+            return status;
+        }
+        pmts[i] = fbl::WrapRefPtr(static_cast<PinnedMemoryTokenDispatcher*>(new_pmt.get()));
+        pinned++;
+
+        status = pmts[i]->EncodeAddrs(compress_results, false, &mapped_addrs.get()[next_addr],
+                                      range_addrs[i]);
+        if (status != ZX_OK) {
+            return status;
+        }
+        next_addr += range_addrs[i];
+
+        handles[i] = Handle::Make(fbl::move(new_pmt), new_pmt_rights);
+        if (!handles[i]) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        handle_values[i] = up->MapHandleToValue(handles[i]);
+    }
+
+    static_assert(sizeof(dev_vaddr_t) == sizeof(zx_paddr_t), "mismatched types");
+    if ((status = addrs.copy_array_to_user(mapped_addrs.get(), addrs_count)) != ZX_OK) {
+        return status;
+    }
+    if ((status = _pmts.copy_array_to_user(handle_values, count)) != ZX_OK) {
+        return status;
+    }
+
+    unpin.cancel();
+    for (size_t i = 0; i < count; ++i) {
+        up->AddHandle(fbl::move(handles[i]));
+    }
+    return ZX_OK;
+}
+
 // zx_status_t zx_bti_release_quarantine
 zx_status_t sys_bti_release_quarantine(zx_handle_t bti) {
     auto up = ProcessDispatcher::GetCurrent();
@@ -499,6 +642,52 @@ zx_status_t sys_interrupt_ack(zx_handle_t inth) {
     return interrupt->Ack();
 }
 
+// zx_status_t zx_interrupt_ack_many
+zx_status_t sys_interrupt_ack_many(user_in_ptr<const zx_handle_t> handles, size_t num_handles) {
+    LTRACEF("handles %p, num_handles %zu\n", handles.get(), num_handles);
+
+    // Every interrupt is acked even if an earlier one fails, so that one bad
+    // handle doesn't leave the rest of a driver's interrupts masked.
+    constexpr size_t kChunkSize = 16u;
+    zx_status_t result = ZX_OK;
+    auto up = ProcessDispatcher::GetCurrent();
+    for (size_t offset = 0; offset < num_handles; offset += kChunkSize) {
+        auto chunk_size = fbl::min(num_handles - offset, kChunkSize);
+        zx_handle_t chunk[kChunkSize];
+        if (handles.copy_array_from_user(chunk, chunk_size, offset) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+
+        for (size_t i = 0; i < chunk_size; ++i) {
+            fbl::RefPtr<InterruptDispatcher> interrupt;
+            zx_status_t status = up->GetDispatcherWithRights(chunk[i], ZX_RIGHT_WRITE, &interrupt);
+            if (status == ZX_OK)
+                status = interrupt->Ack();
+            if (status != ZX_OK && result == ZX_OK)
+                result = status;
+        }
+    }
+    return result;
+}
+
+// zx_status_t zx_interrupt_set_moderation
+zx_status_t sys_interrupt_set_moderation(zx_handle_t handle, uint32_t options,
+                                         zx_duration_t interval, uint32_t count) {
+    LTRACEF("handle %x interval %" PRId64 " count %u\n", handle, interval, count);
+
+    if (options) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->SetModeration(interval, count);
+}
+
 // zx_status_t zx_interrupt_wait
 zx_status_t sys_interrupt_wait(zx_handle_t handle, user_out_ptr<zx_time_t> out_timestamp) {
     LTRACEF("handle %x\n", handle);
@@ -550,6 +739,24 @@ zx_status_t sys_interrupt_trigger(zx_handle_t handle,
     return interrupt->Trigger(timestamp);
 }
 
+// zx_status_t zx_interrupt_set_affinity
+zx_status_t sys_interrupt_set_affinity(zx_handle_t handle, uint32_t options, uint32_t cpu) {
+    LTRACEF("handle %x cpu %u\n", handle, cpu);
+
+    if (options) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    auto up = ProcessDispatcher::GetCurrent();
+    fbl::RefPtr<InterruptDispatcher> interrupt;
+    status = up->GetDispatcherWithRights(handle, ZX_RIGHT_WRITE, &interrupt);
+    if (status != ZX_OK)
+        return status;
+
+    return interrupt->SetAffinity(cpu);
+}
+
 // zx_status_t zx_smc_call
 zx_status_t sys_smc_call(zx_handle_t handle,
                          user_in_ptr<const zx_smc_parameters_t> parameters,
@@ -15,6 +15,7 @@
 #include <object/fifo_dispatcher.h>
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/ref_ptr.h>
@@ -89,3 +90,34 @@ zx_status_t sys_fifo_read(zx_handle_t handle, size_t elem_size, user_out_ptr<voi
     }
     return ZX_OK;
 }
+
+// zx_status_t zx_fifo_get_ring
+zx_status_t sys_fifo_get_ring(zx_handle_t handle, uint32_t options, user_out_handle* out) {
+    if (options & ~ZX_FIFO_RING_TX)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // a mapping can be used to both read and write, so hand it out only to
+    // a handle that could do both
+    fbl::RefPtr<FifoDispatcher> fifo;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ | ZX_RIGHT_WRITE,
+                                                     &fifo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = fifo->GetRing(options & ZX_FIFO_RING_TX, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    // the ring holds entries, never code
+    rights &= ~ZX_RIGHT_EXECUTE;
+    return out->make(fbl::move(dispatcher), rights);
+}
@@ -8,7 +8,9 @@
 
 #include <trace.h>
 
+#include <object/handle.h>
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <zircon/types.h>
 
 #include "priv.h"
@@ -23,6 +25,26 @@ zx_status_t sys_futex_wait(user_in_ptr<const zx_futex_t> value_ptr, int32_t curr
         value_ptr, current_value, deadline);
 }
 
+// zx_status_t zx_futex_wait_pi
+zx_status_t sys_futex_wait_pi(user_in_ptr<const zx_futex_t> value_ptr, int32_t current_value,
+                              zx_handle_t owner, zx_time_t deadline) {
+    LTRACEF("futex %p current %d owner %x\n", value_ptr.get(), current_value, owner);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> thread;
+    zx_status_t status = up->GetDispatcher(owner, &thread);
+    if (status != ZX_OK)
+        return status;
+
+    // only threads sharing the futex's address space can own it, and a
+    // thread can't block on a futex it owns
+    if (thread->process() != up || thread.get() == ThreadDispatcher::GetCurrent())
+        return ZX_ERR_INVALID_ARGS;
+
+    return up->futex_context()->FutexWaitPi(value_ptr, current_value, fbl::move(thread), deadline);
+}
+
 // zx_status_t zx_futex_wake
 zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t count) {
     LTRACEF("futex %p count %" PRIu32 "\n", value_ptr.get(), count);
@@ -42,3 +64,10 @@ zx_status_t sys_futex_requeue(user_in_ptr<const zx_futex_t> wake_ptr, uint32_t w
         wake_ptr, wake_count, current_value,
         requeue_ptr, requeue_count);
 }
+
+// zx_status_t zx_futex_wake_pi
+zx_status_t sys_futex_wake_pi(user_in_ptr<const zx_futex_t> value_ptr) {
+    LTRACEF("futex %p\n", value_ptr.get());
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWakePi(value_ptr);
+}
@@ -6,6 +6,7 @@
 
 #include <zircon/syscalls/hypervisor.h>
 
+#include <object/event_dispatcher.h>
 #include <object/guest_dispatcher.h>
 #include <object/handle.h>
 #include <object/port_dispatcher.h>
@@ -51,14 +52,18 @@ zx_status_t sys_guest_set_trap(zx_handle_t guest_handle, uint32_t kind, zx_vaddr
     if (status != ZX_OK)
         return status;
 
+    // A bell trap may signal an event instead of queueing packets on a port.
     fbl::RefPtr<PortDispatcher> port;
+    fbl::RefPtr<EventDispatcher> event;
     if (port_handle != ZX_HANDLE_INVALID) {
         status = up->GetDispatcherWithRights(port_handle, ZX_RIGHT_WRITE, &port);
+        if (status == ZX_ERR_WRONG_TYPE && kind == ZX_GUEST_TRAP_BELL)
+            status = up->GetDispatcherWithRights(port_handle, ZX_RIGHT_SIGNAL, &event);
         if (status != ZX_OK)
             return status;
     }
 
-    return guest->SetTrap(kind, addr, len, fbl::move(port), key);
+    return guest->SetTrap(kind, addr, len, fbl::move(port), fbl::move(event), key);
 }
 
 // zx_status_t zx_vcpu_create
@@ -84,6 +84,36 @@ private:
     size_t avail_ = 0;
 };
 
+// Gathers per-process statistics for every process in a job tree.
+class ProcessStatsEnumerator final : public JobEnumerator {
+public:
+    ProcessStatsEnumerator(user_out_ptr<zx_info_process_stats_t> ptr, size_t max)
+        : ptr_(ptr), max_(max) {}
+
+    size_t get_avail() const { return avail_; }
+    size_t get_count() const { return count_; }
+
+private:
+    bool OnProcess(ProcessDispatcher* proc) override {
+        avail_++;
+        if (count_ < max_) {
+            zx_info_process_stats_t stats;
+            proc->GetProcessStats(&stats);
+            if (ptr_.copy_array_to_user(&stats, 1, count_) != ZX_OK) {
+                return false;
+            }
+            count_++;
+        }
+        return true;
+    }
+
+    const user_out_ptr<zx_info_process_stats_t> ptr_;
+    const size_t max_;
+
+    size_t count_ = 0;
+    size_t avail_ = 0;
+};
+
 zx_status_t single_record_result(user_out_ptr<void> _buffer, size_t buffer_size,
                                  user_out_ptr<size_t> _actual,
                                  user_out_ptr<size_t> _avail,
@@ -244,6 +274,36 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
         }
         return ZX_OK;
     }
+    case ZX_INFO_JOB_PROCESS_STATS: {
+        // Lets monitors sample every process under a job with one call,
+        // rather than a ZX_INFO_TASK_STATS call per process.
+        fbl::RefPtr<JobDispatcher> job;
+        auto error = up->GetDispatcherWithRights(
+            handle, ZX_RIGHT_ENUMERATE | ZX_RIGHT_INSPECT, &job);
+        if (error < 0)
+            return error;
+
+        size_t max = buffer_size / sizeof(zx_info_process_stats_t);
+        auto stats = _buffer.reinterpret<zx_info_process_stats_t>();
+        ProcessStatsEnumerator pse(stats, max);
+
+        if (!job->EnumerateChildren(&pse, /* recurse */ true)) {
+            // ProcessStatsEnumerator only returns false when it can't
+            // write to the user pointer.
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (_actual) {
+            zx_status_t status = _actual.copy_to_user(pse.get_count());
+            if (status != ZX_OK)
+                return status;
+        }
+        if (_avail) {
+            zx_status_t status = _avail.copy_to_user(pse.get_avail());
+            if (status != ZX_OK)
+                return status;
+        }
+        return ZX_OK;
+    }
     case ZX_INFO_THREAD: {
         // TODO(ZX-458): Handle forward/backward compatibility issues
         // with changes to the struct.
@@ -528,7 +588,8 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
         stats.total_bytes = total * PAGE_SIZE;
         size_t other_bytes = stats.total_bytes;
 
-        stats.free_bytes = state_count[VM_PAGE_STATE_FREE] * PAGE_SIZE;
+        stats.free_bytes = (state_count[VM_PAGE_STATE_FREE] +
+                            state_count[VM_PAGE_STATE_CACHED]) * PAGE_SIZE;
         other_bytes -= stats.free_bytes;
 
         stats.wired_bytes = state_count[VM_PAGE_STATE_WIRED] * PAGE_SIZE;
@@ -666,6 +727,15 @@ zx_status_t sys_object_get_property(zx_handle_t handle_value, uint32_t property,
         uintptr_t value = process->get_debug_addr();
         return _value.reinterpret<uintptr_t>().copy_to_user(value);
     }
+    case ZX_PROP_PROCESS_EXCEPTION_HANDLER: {
+        if (size < sizeof(zx_exception_handler_t))
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        auto process = DownCastDispatcher<ProcessDispatcher>(&dispatcher);
+        if (!process)
+            return ZX_ERR_WRONG_TYPE;
+        zx_exception_handler_t value = process->get_exception_handler();
+        return _value.reinterpret<zx_exception_handler_t>().copy_to_user(value);
+    }
     case ZX_PROP_PROCESS_VDSO_BASE_ADDRESS: {
         if (size < sizeof(uintptr_t))
             return ZX_ERR_BUFFER_TOO_SMALL;
@@ -826,6 +896,19 @@ zx_status_t sys_object_set_property(zx_handle_t handle_value, uint32_t property,
             return status;
         return process->set_debug_addr(value);
     }
+    case ZX_PROP_PROCESS_EXCEPTION_HANDLER: {
+        if (size < sizeof(zx_exception_handler_t))
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        auto process = DownCastDispatcher<ProcessDispatcher>(&dispatcher);
+        if (!process)
+            return ZX_ERR_WRONG_TYPE;
+        zx_exception_handler_t value;
+        zx_status_t status =
+            _value.reinterpret<const zx_exception_handler_t>().copy_from_user(&value);
+        if (status != ZX_OK)
+            return status;
+        return process->set_exception_handler(value);
+    }
     case ZX_PROP_SOCKET_RX_THRESHOLD: {
         if (size < sizeof(size_t))
             return ZX_ERR_BUFFER_TOO_SMALL;
@@ -0,0 +1,109 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <lib/counters.h>
+
+#include <object/handle.h>
+#include <object/pager_dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+
+#include <fbl/ref_ptr.h>
+#include <zircon/types.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+KCOUNTER(pager_create, "kernel.pager.create");
+KCOUNTER(pager_supply, "kernel.pager.supply");
+
+// zx_status_t zx_pager_create
+zx_status_t sys_pager_create(uint32_t options, user_out_handle* out) {
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    zx_status_t status = PagerDispatcher::Create(&dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    kcounter_add(pager_create, 1);
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+// zx_status_t zx_pager_create_vmo
+zx_status_t sys_pager_create_vmo(zx_handle_t pager, zx_handle_t port, uint64_t key,
+                                 uint64_t size, uint32_t options, user_out_handle* out) {
+    LTRACEF("pager %x port %x key %#" PRIx64 " size %#" PRIx64 "\n", pager, port, key, size);
+
+    if (options != 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    zx_status_t status = up->QueryPolicy(ZX_POL_NEW_VMO);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    status = up->GetDispatcherWithRights(pager, ZX_RIGHT_WRITE, &pager_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PortDispatcher> port_dispatcher;
+    status = up->GetDispatcherWithRights(port, ZX_RIGHT_WRITE, &port_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = pager_dispatcher->CreateVmo(fbl::move(port_dispatcher), key, size, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+// zx_status_t zx_pager_supply_pages
+zx_status_t sys_pager_supply_pages(zx_handle_t pager, zx_handle_t pager_vmo,
+                                   uint64_t offset, uint64_t length,
+                                   zx_handle_t aux_vmo, uint64_t aux_offset) {
+    LTRACEF("pager %x vmo %x offset %#" PRIx64 " length %#" PRIx64 "\n",
+            pager, pager_vmo, offset, length);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    zx_status_t status = up->GetDispatcherWithRights(pager, ZX_RIGHT_WRITE, &pager_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObjectDispatcher> pager_vmo_dispatcher;
+    status = up->GetDispatcherWithRights(pager_vmo, ZX_RIGHT_WRITE, &pager_vmo_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObjectDispatcher> aux_vmo_dispatcher;
+    status = up->GetDispatcherWithRights(aux_vmo, ZX_RIGHT_READ | ZX_RIGHT_WRITE,
+                                         &aux_vmo_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    kcounter_add(pager_supply, 1);
+    return pager_dispatcher->SupplyPages(pager_vmo_dispatcher->vmo(), offset, length,
+                                         aux_vmo_dispatcher->vmo(), aux_offset);
+}
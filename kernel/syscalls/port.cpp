@@ -13,6 +13,7 @@
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/ref_ptr.h>
 
@@ -94,6 +95,50 @@ zx_status_t sys_port_wait(zx_handle_t handle, zx_time_t deadline,
     return ZX_OK;
 }
 
+// zx_status_t zx_port_wait_many
+zx_status_t sys_port_wait_many(zx_handle_t handle, zx_time_t deadline,
+                               user_out_ptr<zx_port_packet_t> packets_out, size_t count,
+                               user_out_ptr<size_t> actual_out) {
+    LTRACEF("handle %x count %zu\n", handle, count);
+
+    if (count == 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<PortDispatcher> port;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ, &port);
+    if (status != ZX_OK)
+        return status;
+
+    ktrace(TAG_PORT_WAIT, (uint32_t)port->get_koid(), 0, 0, 0);
+
+    // Packets are staged on the stack a chunk at a time. Only the first chunk
+    // waits; the rest just drain whatever is already queued.
+    constexpr size_t kChunk = 8;
+    zx_port_packet_t pp[kChunk];
+    size_t done = 0;
+    size_t n;
+    zx_status_t st = port->DequeueMany(deadline, pp, fbl::min(count, kChunk), &n);
+
+    ktrace(TAG_PORT_WAIT_DONE, (uint32_t)port->get_koid(), st, 0, 0);
+
+    while (st == ZX_OK) {
+        status = packets_out.copy_array_to_user(pp, n, done);
+        if (status != ZX_OK)
+            return status;
+        done += n;
+        if (n < kChunk || done == count)
+            break;
+        st = port->DequeueMany(0, pp, fbl::min(count - done, kChunk), &n);
+    }
+
+    if (done == 0)
+        return st;
+
+    return actual_out.copy_to_user(done);
+}
+
 // zx_status_t zx_port_cancel
 zx_status_t sys_port_cancel(zx_handle_t handle, zx_handle_t source, uint64_t key) {
     auto up = ProcessDispatcher::GetCurrent();
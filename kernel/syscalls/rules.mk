@@ -20,6 +20,7 @@ MODULE_DEPS := \
 
 MODULE_SRCS := \
     $(LOCAL_DIR)/syscalls.cpp \
+    $(LOCAL_DIR)/aspace_template.cpp \
     $(LOCAL_DIR)/channel.cpp \
     $(LOCAL_DIR)/ddk.cpp \
     $(LOCAL_DIR)/ddk_pci.cpp \
@@ -32,6 +33,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/zircon.cpp \
     $(LOCAL_DIR)/object.cpp \
     $(LOCAL_DIR)/object_wait.cpp \
+    $(LOCAL_DIR)/pager.cpp \
     $(LOCAL_DIR)/port.cpp \
     $(LOCAL_DIR)/profile.cpp \
     $(LOCAL_DIR)/resource.cpp \
@@ -42,6 +44,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/timer.cpp \
     $(LOCAL_DIR)/vmar.cpp \
     $(LOCAL_DIR)/vmo.cpp \
+    $(LOCAL_DIR)/waitset.cpp \
 
 ifeq ($(ARCH),x86)
 MODULE_SRCS += $(LOCAL_DIR)/system_x86.cpp \
@@ -17,6 +17,7 @@
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/socket_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <zircon/syscalls/policy.h>
 #include <fbl/ref_ptr.h>
@@ -51,7 +52,7 @@ zx_status_t sys_socket_write(zx_handle_t handle, uint32_t options,
                              user_out_ptr<size_t> actual) {
     LTRACEF("handle %x\n", handle);
 
-    if ((size > 0u) && !buffer)
+    if ((size > 0u) && !buffer && options != ZX_SOCKET_RING_ADVANCE)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -71,6 +72,11 @@ zx_status_t sys_socket_write(zx_handle_t handle, uint32_t options,
         if (status == ZX_OK)
             nwritten = size;
         break;
+    case ZX_SOCKET_RING_ADVANCE:
+        if (buffer)
+            return ZX_ERR_INVALID_ARGS;
+        status = socket->Write(buffer, size, &nwritten);
+        break;
     case ZX_SOCKET_SHUTDOWN_WRITE:
     case ZX_SOCKET_SHUTDOWN_READ:
     case ZX_SOCKET_SHUTDOWN_READ | ZX_SOCKET_SHUTDOWN_WRITE:
@@ -94,7 +100,7 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
                             user_out_ptr<size_t> actual) {
     LTRACEF("handle %x\n", handle);
 
-    if (!buffer && size > 0)
+    if (!buffer && size > 0 && options != ZX_SOCKET_RING_ADVANCE)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -113,6 +119,12 @@ zx_status_t sys_socket_read(zx_handle_t handle, uint32_t options,
     case ZX_SOCKET_CONTROL:
         status = socket->ReadControl(buffer, size, &nread);
         break;
+    case ZX_SOCKET_RING_ADVANCE:
+        // a null buffer with zero size would be a query, not an advance
+        if (buffer || size == 0)
+            return ZX_ERR_INVALID_ARGS;
+        status = socket->Read(buffer, size, &nread);
+        break;
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -173,3 +185,33 @@ zx_status_t sys_socket_accept(zx_handle_t handle, user_out_handle* out) {
 
     return out->transfer(fbl::move(outhandle));
 }
+
+// zx_status_t zx_socket_get_ring
+zx_status_t sys_socket_get_ring(zx_handle_t handle, uint32_t options, user_out_handle* out) {
+    if (options & ~ZX_SOCKET_RING_TX)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // the ring can be written through, so map either one only with both rights
+    fbl::RefPtr<SocketDispatcher> socket;
+    zx_status_t status = up->GetDispatcherWithRights(handle, ZX_RIGHT_READ | ZX_RIGHT_WRITE,
+                                                     &socket);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = socket->GetRing(options & ZX_SOCKET_RING_TX, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    // the stream is data, never code
+    rights &= ~ZX_RIGHT_EXECUTE;
+    return out->make(fbl::move(dispatcher), rights);
+}
@@ -42,10 +42,12 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
                            user_out_handle* out) {
     LTRACEF("size %#" PRIx64 "\n", size);
 
-    switch (options) {
-    case 0: options = VmObjectPaged::kResizable; break;
-    case ZX_VMO_NON_RESIZABLE: options = 0u; break;
-    default: return ZX_ERR_INVALID_ARGS;
+    if (options & ~(ZX_VMO_NON_RESIZABLE | ZX_VMO_DISCARDABLE)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint32_t vmo_options = (options & ZX_VMO_NON_RESIZABLE) ? 0u : VmObjectPaged::kResizable;
+    if (options & ZX_VMO_DISCARDABLE) {
+        vmo_options |= VmObjectPaged::kDiscardable;
     }
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -55,7 +57,7 @@ zx_status_t sys_vmo_create(uint64_t size, uint32_t options,
 
     // create a vm object
     fbl::RefPtr<VmObject> vmo;
-    res = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, options, size, &vmo);
+    res = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, vmo_options, size, &vmo);
     if (res != ZX_OK)
         return res;
 
@@ -207,6 +209,23 @@ zx_status_t sys_vmo_op_range(zx_handle_t handle, uint32_t op, uint64_t offset, u
     return vmo->RangeOp(op, offset, size, _buffer, buffer_size, rights);
 }
 
+// zx_status_t zx_vmo_op_range_batch
+zx_status_t sys_vmo_op_range_batch(zx_handle_t handle,
+                                   user_inout_ptr<zx_vmo_op_range_entry_t> _ops, size_t count) {
+    LTRACEF("handle %x ops %p count %zu\n", handle, _ops.get(), count);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<VmObjectDispatcher> vmo;
+    zx_rights_t rights;
+    zx_status_t status = up->GetDispatcherAndRights(handle, &vmo, &rights);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    return vmo->RangeOpBatch(_ops, count, rights);
+}
+
 // zx_status_t zx_vmo_set_cache_policy
 zx_status_t sys_vmo_set_cache_policy(zx_handle_t handle, uint32_t cache_policy) {
     fbl::RefPtr<VmObjectDispatcher> vmo;
@@ -0,0 +1,111 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <lib/counters.h>
+#include <lib/user_copy/user_ptr.h>
+
+#include <object/handle.h>
+#include <object/process_dispatcher.h>
+#include <object/waitset_dispatcher.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/ref_ptr.h>
+#include <zircon/types.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+KCOUNTER(waitset_create, "kernel.waitset.create");
+KCOUNTER(waitset_wait, "kernel.waitset.wait");
+
+// zx_status_t zx_waitset_create
+zx_status_t sys_waitset_create(uint32_t options, user_out_handle* out) {
+    LTRACEF("options %u\n", options);
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    zx_status_t status = WaitSetDispatcher::Create(options, &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    kcounter_add(waitset_create, 1);
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+// zx_status_t zx_waitset_add
+zx_status_t sys_waitset_add(zx_handle_t waitset_handle, uint64_t key, zx_handle_t handle_value,
+                            zx_signals_t signals, uint32_t options) {
+    LTRACEF("waitset %x key %#" PRIx64 " handle %x\n", waitset_handle, key, handle_value);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<WaitSetDispatcher> waitset;
+    zx_status_t status = up->GetDispatcherWithRights(waitset_handle, ZX_RIGHT_WRITE, &waitset);
+    if (status != ZX_OK)
+        return status;
+
+    Guard<fbl::Mutex> guard{up->handle_table_lock()};
+    Handle* handle = up->GetHandleLocked(handle_value);
+    if (!handle)
+        return ZX_ERR_BAD_HANDLE;
+    if (!handle->HasRights(ZX_RIGHT_WAIT))
+        return ZX_ERR_ACCESS_DENIED;
+
+    return waitset->AddEntry(handle, key, signals, options);
+}
+
+// zx_status_t zx_waitset_remove
+zx_status_t sys_waitset_remove(zx_handle_t waitset_handle, uint64_t key) {
+    LTRACEF("waitset %x key %#" PRIx64 "\n", waitset_handle, key);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<WaitSetDispatcher> waitset;
+    zx_status_t status = up->GetDispatcherWithRights(waitset_handle, ZX_RIGHT_WRITE, &waitset);
+    if (status != ZX_OK)
+        return status;
+
+    return waitset->RemoveEntry(key);
+}
+
+// zx_status_t zx_waitset_wait
+zx_status_t sys_waitset_wait(zx_handle_t waitset_handle, zx_time_t deadline,
+                             user_out_ptr<zx_waitset_result_t> results_out, size_t count,
+                             user_out_ptr<size_t> actual_out) {
+    LTRACEF("waitset %x count %zu\n", waitset_handle, count);
+
+    if (count == 0)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<WaitSetDispatcher> waitset;
+    zx_status_t status = up->GetDispatcherWithRights(waitset_handle, ZX_RIGHT_READ, &waitset);
+    if (status != ZX_OK)
+        return status;
+
+    kcounter_add(waitset_wait, 1);
+
+    // results are staged on the stack; a bigger buffer just gets the first
+    // chunk's worth per call
+    constexpr size_t kChunk = 16;
+    zx_waitset_result_t results[kChunk];
+    size_t actual;
+    status = waitset->Wait(deadline, results, fbl::min(count, kChunk), &actual);
+    if (status != ZX_OK)
+        return status;
+
+    status = results_out.copy_array_to_user(results, actual);
+    if (status != ZX_OK)
+        return status;
+
+    return actual_out.copy_to_user(actual);
+}
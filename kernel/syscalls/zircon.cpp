@@ -17,6 +17,7 @@
 #include <kernel/auto_lock.h>
 #include <kernel/thread.h>
 #include <lib/crypto/global_prng.h>
+#include <lib/vdso.h>
 #include <lib/user_copy/user_ptr.h>
 #include <object/event_dispatcher.h>
 #include <object/event_pair_dispatcher.h>
@@ -26,8 +27,11 @@
 #include <object/resource.h>
 #include <object/thread_dispatcher.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/atomic.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_ptr.h>
 
 #include <zircon/syscalls/log.h>
@@ -63,7 +67,14 @@ zx_status_t sys_nanosleep(zx_time_t deadline) {
 // update pvclock too.
 fbl::atomic<int64_t> utc_offset;
 
-zx_time_t sys_clock_get(zx_clock_t clock_id) {
+// Serializes updates of |utc_offset| and its copy in the vDSO, so that the
+// two can't end up disagreeing.
+static fbl::Mutex utc_offset_lock;
+
+// The vDSO computes the monotonic and UTC clocks itself when it can, see
+// system/ulib/zircon/zx_clock_get.cpp, and calls these otherwise.
+
+zx_time_t sys_clock_get_via_kernel(zx_clock_t clock_id) {
     switch (clock_id) {
     case ZX_CLOCK_MONOTONIC:
         return current_time();
@@ -77,27 +88,7 @@ zx_time_t sys_clock_get(zx_clock_t clock_id) {
     }
 }
 
-// zx_status_t zx_clock_get_new
-zx_status_t sys_clock_get_new(zx_clock_t clock_id, user_out_ptr<zx_time_t> out_time) {
-    zx_time_t time;
-    switch (clock_id) {
-    case ZX_CLOCK_MONOTONIC:
-        time = current_time();
-        break;
-    case ZX_CLOCK_UTC:
-        time = current_time() + utc_offset.load();
-        break;
-    case ZX_CLOCK_THREAD:
-        time = ThreadDispatcher::GetCurrent()->runtime_ns();
-        break;
-    default:
-        return ZX_ERR_INVALID_ARGS;
-    }
-
-    return out_time.copy_to_user(time);
-}
-
-zx_time_t sys_clock_get_monotonic() {
+zx_time_t sys_clock_get_monotonic_via_kernel() {
     return current_time();
 }
 
@@ -112,9 +103,12 @@ zx_status_t sys_clock_adjust(zx_handle_t hrsrc, zx_clock_t clock_id, int64_t off
     switch (clock_id) {
     case ZX_CLOCK_MONOTONIC:
         return ZX_ERR_ACCESS_DENIED;
-    case ZX_CLOCK_UTC:
+    case ZX_CLOCK_UTC: {
+        fbl::AutoLock lock(&utc_offset_lock);
         utc_offset.store(offset);
+        VDso::SetUtcOffset(offset);
         return ZX_OK;
+    }
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -225,7 +219,7 @@ zx_status_t sys_debuglog_read(zx_handle_t log_handle, uint32_t options,
                               user_out_ptr<void> ptr, size_t len) {
     LTRACEF("log handle %x, opt %x, ptr 0x%p, len %zu\n", log_handle, options, ptr.get(), len);
 
-    if (options != 0)
+    if (options & ~ZX_LOG_READ_BATCH)
         return ZX_ERR_INVALID_ARGS;
 
     auto up = ProcessDispatcher::GetCurrent();
@@ -237,13 +231,39 @@ zx_status_t sys_debuglog_read(zx_handle_t log_handle, uint32_t options,
 
     char buf[DLOG_MAX_RECORD];
     size_t actual;
-    if ((status = log->Read(options, buf, DLOG_MAX_RECORD, &actual)) < 0)
-        return status;
+    if (!(options & ZX_LOG_READ_BATCH)) {
+        if ((status = log->Read(0, buf, DLOG_MAX_RECORD, &actual)) < 0)
+            return status;
 
-    if (ptr.copy_array_to_user(buf, actual) != ZX_OK)
-        return ZX_ERR_INVALID_ARGS;
+        if (ptr.copy_array_to_user(buf, actual) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+
+        return static_cast<zx_status_t>(actual);
+    }
+
+    // Batched reads pack as many whole records as fit into the buffer, each
+    // starting at ZX_LOG_RECORD_STRIDE() from the one before.
+    static_assert(ZX_LOG_RECORD_STRIDE(DLOG_MAX_DATA) <= ZX_LOG_RECORD_MAX, "");
+    if (len < ZX_LOG_RECORD_MAX)
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    len = fbl::min(len, static_cast<size_t>(INT32_MAX));
+
+    auto out = ptr.reinterpret<char>();
+    size_t offset = 0;
+    while (len - offset >= ZX_LOG_RECORD_MAX) {
+        if ((status = log->Read(0, buf, DLOG_MAX_RECORD, &actual)) < 0)
+            break;
+
+        if (out.byte_offset(offset).copy_array_to_user(buf, actual) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+
+        const dlog_header_t* hdr = reinterpret_cast<const dlog_header_t*>(buf);
+        offset += ZX_LOG_RECORD_STRIDE(hdr->datalen);
+    }
+    if (offset == 0)
+        return status;
 
-    return static_cast<zx_status_t>(actual);
+    return static_cast<zx_status_t>(offset);
 }
 
 // zx_status_t zx_log_write
@@ -265,9 +285,8 @@ zx_status_t sys_cprng_draw_once(user_out_ptr<void> buffer, size_t len) {
     // Ensure we get rid of the stack copy of the random data as this function returns.
     explicit_memory::ZeroDtor<uint8_t> zero_guard(kernel_buf, sizeof(kernel_buf));
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->Draw(kernel_buf, len);
+    ASSERT(crypto::GlobalPRNG::GetInstance()->is_thread_safe());
+    crypto::GlobalPRNG::DrawPerCpu(kernel_buf, len);
 
     if (buffer.copy_array_to_user(kernel_buf, len) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
@@ -287,9 +306,8 @@ zx_status_t sys_cprng_add_entropy(user_in_ptr<const void> buffer, size_t len) {
     if (buffer.copy_array_from_user(kernel_buf, len) != ZX_OK)
         return ZX_ERR_INVALID_ARGS;
 
-    auto prng = crypto::GlobalPRNG::GetInstance();
-    ASSERT(prng->is_thread_safe());
-    prng->AddEntropy(kernel_buf, len);
+    ASSERT(crypto::GlobalPRNG::GetInstance()->is_thread_safe());
+    crypto::GlobalPRNG::AddEntropy(kernel_buf, len);
 
     return ZX_OK;
 }
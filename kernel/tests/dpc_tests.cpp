@@ -0,0 +1,138 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/ops.h>
+#include <fbl/atomic.h>
+#include <kernel/dpc.h>
+#include <kernel/event.h>
+#include <lib/unittest/unittest.h>
+
+namespace {
+
+constexpr int kMaxDpcs = 4;
+
+struct RunOrder {
+    RunOrder() { event_init(&done, false, 0); }
+    ~RunOrder() { event_destroy(&done); }
+
+    fbl::atomic<int> count{0};
+    int ids[kMaxDpcs] = {};
+    int expected = 0;
+    event_t done;
+};
+
+struct TestDpc {
+    dpc_t dpc;
+    RunOrder* order;
+    int id;
+};
+
+__NO_INLINE void record(dpc_t* d) {
+    auto test_dpc = static_cast<TestDpc*>(d->arg);
+    RunOrder* order = test_dpc->order;
+    int n = order->count.fetch_add(1);
+    if (n < kMaxDpcs)
+        order->ids[n] = test_dpc->id;
+    if (n + 1 == order->expected)
+        event_signal(&order->done, true);
+}
+
+// A second callback for |record|, so the two don't share a batch.
+void record_other(dpc_t* d) {
+    record(d);
+    __asm__ volatile("");
+}
+
+void init_dpc(TestDpc* test_dpc, RunOrder* order, int id, dpc_func_t func,
+              dpc_priority_t priority) {
+    test_dpc->dpc = DPC_INITIAL_VALUE;
+    test_dpc->dpc.func = func;
+    test_dpc->dpc.arg = test_dpc;
+    test_dpc->dpc.priority = priority;
+    test_dpc->order = order;
+    test_dpc->id = id;
+}
+
+// Queues |count| dpcs with interrupts off, so that the cpu's dpc thread
+// sees all of them at once, and waits for them to run.
+bool queue_and_wait(TestDpc* dpcs, int count, RunOrder* order) {
+    order->expected = count;
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    for (int i = 0; i < count; ++i) {
+        if (dpc_queue(&dpcs[i].dpc, false) != ZX_OK) {
+            arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+            return false;
+        }
+    }
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    return event_wait(&order->done) == ZX_OK;
+}
+
+bool high_priority_runs_first() {
+    BEGIN_TEST;
+
+    RunOrder order;
+    TestDpc dpcs[3];
+    init_dpc(&dpcs[0], &order, 0, &record, DPC_PRIORITY_NORMAL);
+    init_dpc(&dpcs[1], &order, 1, &record, DPC_PRIORITY_NORMAL);
+    init_dpc(&dpcs[2], &order, 2, &record, DPC_PRIORITY_HIGH);
+
+    ASSERT_TRUE(queue_and_wait(dpcs, 3, &order), "");
+    EXPECT_EQ(3, order.count.load(), "");
+    EXPECT_EQ(2, order.ids[0], "");
+    EXPECT_EQ(0, order.ids[1], "");
+    EXPECT_EQ(1, order.ids[2], "");
+    END_TEST;
+}
+
+bool same_func_is_batched() {
+    BEGIN_TEST;
+
+    RunOrder order;
+    TestDpc dpcs[3];
+    init_dpc(&dpcs[0], &order, 0, &record, DPC_PRIORITY_NORMAL);
+    init_dpc(&dpcs[1], &order, 1, &record_other, DPC_PRIORITY_NORMAL);
+    init_dpc(&dpcs[2], &order, 2, &record, DPC_PRIORITY_NORMAL);
+
+    ASSERT_TRUE(queue_and_wait(dpcs, 3, &order), "");
+    EXPECT_EQ(3, order.count.load(), "");
+    EXPECT_EQ(0, order.ids[0], "");
+    EXPECT_EQ(2, order.ids[1], "");
+    EXPECT_EQ(1, order.ids[2], "");
+    END_TEST;
+}
+
+bool queue_twice_fails() {
+    BEGIN_TEST;
+
+    RunOrder order;
+    order.expected = 1;
+    TestDpc test_dpc;
+    init_dpc(&test_dpc, &order, 0, &record, DPC_PRIORITY_HIGH);
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    zx_status_t first = dpc_queue(&test_dpc.dpc, false);
+    zx_status_t second = dpc_queue(&test_dpc.dpc, false);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    EXPECT_EQ(ZX_OK, first, "");
+    EXPECT_EQ(ZX_ERR_ALREADY_EXISTS, second, "");
+    ASSERT_EQ(ZX_OK, event_wait(&order.done), "");
+    EXPECT_EQ(1, order.count.load(), "");
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(dpc_tests)
+UNITTEST("high_priority_runs_first", high_priority_runs_first)
+UNITTEST("same_func_is_batched", same_func_is_batched)
+UNITTEST("queue_twice_fails", queue_twice_fails)
+UNITTEST_END_TESTCASE(dpc_tests, "dpc", "DPC tests");
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <fbl/mutex.h>
+#include <kernel/thread.h>
 #include <lib/unittest/unittest.h>
 #include <lockdep/guard_multiple.h>
 #include <lockdep/lockdep.h>
@@ -714,9 +715,51 @@ static bool lock_dep_static_analysis_tests() {
     END_TEST;
 }
 
+// Tests of the per-lock class statistics kept when profiling is enabled.
+static bool lock_dep_profiling_tests() {
+    BEGIN_TEST;
+
+#if LOCK_DEP_ENABLE_PROFILING
+    using lockdep::Guard;
+    using lockdep::LockClassState;
+    using test::Foo;
+    using test::Mutex;
+
+    test::ResetTrackingState();
+
+    Foo a{};
+    LockClassState* state = decltype(Foo::lock)::LockClass<>::GetLockClassState();
+    const LockClassState::Profile& profile = state->profile();
+
+    static constexpr uint64_t kAcquisitions = 4;
+    for (uint64_t i = 0; i < kAcquisitions; i++) {
+        Guard<Mutex> guard_a{&a.lock};
+    }
+    EXPECT_EQ(kAcquisitions, profile.acquisitions.load(), "");
+    EXPECT_EQ(0u, profile.contended.load(), "");
+
+    // Time spent asleep with the lock held counts as hold time.
+    {
+        Guard<Mutex> guard_a{&a.lock};
+        guard_a.CallUnlocked([]() {});
+        thread_sleep_relative(ZX_MSEC(1));
+    }
+    EXPECT_EQ(kAcquisitions + 2, profile.acquisitions.load(), "");
+    EXPECT_GE(profile.max_hold.load(), static_cast<uint64_t>(ZX_MSEC(1)), "");
+    EXPECT_GE(profile.total_hold.load(), profile.max_hold.load(), "");
+
+    state->ResetProfile();
+    EXPECT_EQ(0u, profile.acquisitions.load(), "");
+    EXPECT_EQ(0u, profile.max_hold.load(), "");
+#endif
+
+    END_TEST;
+}
+
 UNITTEST_START_TESTCASE(lock_dep_tests)
 UNITTEST("lock_dep_dynamic_analysis_tests", lock_dep_dynamic_analysis_tests)
 UNITTEST("lock_dep_static_analysis_tests", lock_dep_static_analysis_tests)
+UNITTEST("lock_dep_profiling_tests", lock_dep_profiling_tests)
 UNITTEST_END_TESTCASE(lock_dep_tests, "lock_dep_tests", "lock_dep_tests");
 
 #endif
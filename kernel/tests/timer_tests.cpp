@@ -485,6 +485,43 @@ static bool trylock_or_cancel_get_lock() {
     END_TEST;
 }
 
+static void timer_window_cb(struct timer*, zx_time_t now, void* void_arg) {
+    atomic_store_64(reinterpret_cast<volatile int64_t*>(void_arg), now);
+}
+
+// See that a timer whose early window is open fires in the same interrupt as
+// the timer ahead of it, rather than waiting for its own deadline.
+static bool fires_within_early_window() {
+    BEGIN_TEST;
+
+    const zx_duration_t off = ZX_MSEC(20);
+    int64_t first_fired = 0;
+    int64_t second_fired = 0;
+    timer_t first = TIMER_INITIAL_VALUE(first);
+    timer_t second = TIMER_INITIAL_VALUE(second);
+
+    // Both timers must land on the same cpu's queue.
+    arch_disable_ints();
+    zx_time_t when = current_time() + off;
+    // Queued first so it can't coalesce with |first| at insertion.
+    timer_set(&second, when + (5u * off), TIMER_SLACK_EARLY, 6u * off,
+              timer_window_cb, &second_fired);
+    // No slack, so it goes ahead of |second| unadjusted.
+    timer_set(&first, when, TIMER_SLACK_CENTER, 0, timer_window_cb, &first_fired);
+    arch_enable_ints();
+
+    while (atomic_load_64(&first_fired) == 0 || atomic_load_64(&second_fired) == 0) {
+        thread_sleep(current_time() + ZX_MSEC(1));
+    }
+    // |second| may also have been coalesced with some other timer on this
+    // cpu, but either way it must not have waited for its own deadline.
+    EXPECT_LE(atomic_load_64(&second_fired), atomic_load_64(&first_fired), "");
+
+    timer_cancel(&first);
+    timer_cancel(&second);
+    END_TEST;
+}
+
 UNITTEST_START_TESTCASE(timer_tests)
 UNITTEST("cancel_before_deadline", cancel_before_deadline)
 UNITTEST("cancel_after_fired", cancel_after_fired)
@@ -492,4 +529,5 @@ UNITTEST("cancel_from_callback", cancel_from_callback)
 UNITTEST("set_from_callback", set_from_callback)
 UNITTEST("trylock_or_cancel_canceled", trylock_or_cancel_canceled)
 UNITTEST("trylock_or_cancel_get_lock", trylock_or_cancel_get_lock)
+UNITTEST("fires_within_early_window", fires_within_early_window)
 UNITTEST_END_TESTCASE(timer_tests, "timer", "timer tests");
@@ -15,6 +15,9 @@
 
 #include <assert.h>
 #include <debug.h>
+#include <kernel/atomic.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
 #include <trace.h>
 #include <zircon/compiler.h>
 
@@ -27,6 +30,38 @@
 extern const struct lk_init_struct __start_lk_init[];
 extern const struct lk_init_struct __stop_lk_init[];
 
+/* async hooks still running, and the event signaled when that drops to zero */
+static volatile int async_hooks_running;
+static event_t async_hooks_done = EVENT_INITIAL_VALUE(async_hooks_done, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+static int async_hook_thread(void* arg) {
+    auto found = static_cast<const struct lk_init_struct*>(arg);
+
+    found->hook(found->level);
+    if (atomic_add(&async_hooks_running, -1) == 1)
+        event_signal(&async_hooks_done, true);
+    return 0;
+}
+
+/* Runs |found| in a thread of its own, returning false if there isn't one. */
+static bool call_hook_async(const struct lk_init_struct* found) {
+    /* left unpinned, so the scheduler is free to put it on a secondary cpu */
+    thread_t* t = thread_create(found->name, &async_hook_thread,
+                                const_cast<struct lk_init_struct*>(found), DEFAULT_PRIORITY);
+    if (!t)
+        return false;
+
+    atomic_add(&async_hooks_running, 1);
+    thread_detach(t);
+    thread_resume(t);
+    return true;
+}
+
+void lk_init_wait_async() {
+    while (atomic_load(&async_hooks_running) != 0)
+        event_wait(&async_hooks_done);
+}
+
 void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop_level) {
     LTRACEF("flags %#x, start_level %#x, stop_level %#x\n",
             (uint)required_flag, start_level, stop_level);
@@ -82,7 +117,11 @@ void lk_init_level(enum lk_init_flags required_flag, uint start_level, uint stop
             }
         }
 
-        found->hook(found->level);
+        bool async = (found->flags & LK_INIT_FLAG_ASYNC) &&
+                     required_flag == LK_INIT_FLAG_PRIMARY_CPU &&
+                     found->level >= LK_INIT_LEVEL_THREADING;
+        if (!async || !call_hook_async(found))
+            found->hook(found->level);
         last_called_level = found->level;
         last = found;
     }
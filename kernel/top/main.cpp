@@ -146,8 +146,13 @@ static int bootstrap2(void*) {
     // Hook 未实现
     target_init();
 
+    lk_primary_cpu_init_level(LK_INIT_LEVEL_TARGET, LK_INIT_LEVEL_USER - 1);
+
+    // userspace may use anything the async hooks set up
+    lk_init_wait_async();
+
     dprintf(SPEW, "moving to last init level\n");
-    lk_primary_cpu_init_level(LK_INIT_LEVEL_TARGET, LK_INIT_LEVEL_LAST);
+    lk_primary_cpu_init_level(LK_INIT_LEVEL_USER, LK_INIT_LEVEL_LAST);
 
     return 0;
 }
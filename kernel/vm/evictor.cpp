@@ -0,0 +1,97 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "vm_priv.h"
+
+#include <fbl/ref_ptr.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <trace.h>
+#include <vm/pmm.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// Background thread that drops pages of unlocked discardable VMOs when free
+// memory runs low, well before the OOM thread starts killing processes.
+
+#define VM_EVICT_DEFAULT_FREE_MB 100
+
+KCOUNTER(vm_evict_passes, "kernel.vm.evict.passes");
+
+namespace {
+
+// number of objects pulled off the global list per trip through its lock
+constexpr size_t kEvictBatch = 16;
+
+// Each page survives one pass after it was last touched, so it takes two
+// passes over an idle object to drop its pages.
+constexpr int kEvictMaxPasses = 2;
+
+// start evicting once the pmm has fewer free bytes than this
+uint64_t evict_free_bytes;
+
+size_t evict_pass(size_t target) {
+    size_t evicted = 0;
+    fbl::RefPtr<VmObject> cursor;
+    while (evicted < target) {
+        fbl::RefPtr<VmObject> batch[kEvictBatch];
+        size_t count = VmObject::TakeRefsAfter(cursor.get(), batch, kEvictBatch);
+        if (count == 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < count && evicted < target; i++) {
+            evicted += batch[i]->EvictPages(target - evicted);
+        }
+
+        // hold on to the last one so the next batch can pick up after it
+        cursor = batch[count - 1];
+    }
+
+    kcounter_add(vm_evict_passes, 1);
+    return evicted;
+}
+
+int evict_thread(void*) {
+    for (;;) {
+        thread_sleep_relative(ZX_SEC(1));
+
+        for (int pass = 0; pass < kEvictMaxPasses; pass++) {
+            const uint64_t free_bytes = pmm_count_free_pages() * PAGE_SIZE;
+            if (free_bytes >= evict_free_bytes) {
+                break;
+            }
+
+            size_t target = (evict_free_bytes - free_bytes) / PAGE_SIZE;
+            size_t evicted = evict_pass(target);
+            LTRACEF("evicted %zu of %zu pages\n", evicted, target);
+        }
+    }
+
+    return 0;
+}
+
+} // namespace
+
+static void vm_evict_init(uint level) {
+    evict_free_bytes =
+        cmdline_get_uint64("kernel.vm.evict-free-mb", VM_EVICT_DEFAULT_FREE_MB) * MB;
+    if (evict_free_bytes == 0) {
+        return;
+    }
+
+    thread_t* t = thread_create("evict", evict_thread, nullptr, LOW_PRIORITY);
+    if (!t) {
+        printf("VM: failed to create page eviction thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+LK_INIT_HOOK(vm_evict, &vm_evict_init, LK_INIT_LEVEL_LAST);
@@ -22,13 +22,17 @@ enum vm_page_state {
     VM_PAGE_STATE_MMU,   // allocated to serve arch-specific mmu purposes
     VM_PAGE_STATE_IOMMU, // allocated for platform-specific iommu structures
     VM_PAGE_STATE_IPC,
+    VM_PAGE_STATE_CACHED, // free, but parked in a per-cpu pmm page cache
 
     VM_PAGE_STATE_COUNT_
 };
 
-#define VM_PAGE_STATE_BITS 3
+#define VM_PAGE_STATE_BITS 4
 static_assert((1u << VM_PAGE_STATE_BITS) >= VM_PAGE_STATE_COUNT_, "");
 
+// |flags| bits used while a page is owned by a vm object
+#define VM_PAGE_FLAG_ACTIVE (1u << 0) // touched since the object was last aged
+
 // core per page structure allocated at pmm arena creation time
 typedef struct vm_page {
     struct list_node queue_node;
@@ -38,6 +42,9 @@ typedef struct vm_page {
     struct {
         uint32_t flags : 8;
         uint32_t state : VM_PAGE_STATE_BITS;
+        // set while a free page is known to hold nothing but zeros; only
+        // maintained while the page is owned by the pmm
+        uint32_t zeroed : 1;
     };
     // offset: 0x1c
 
@@ -50,6 +57,11 @@ typedef struct vm_page {
         } object; // attached to a vm object
     };
 
+    // NUMA node the page is local to, kept up to date by the pmm whoever owns
+    // the page. A byte of its own rather than a bitfield, so the pmm can update
+    // it without racing an owner writing |flags|.
+    uint8_t numa_node;
+
     // helper routines
     bool is_free() const {
         return state == VM_PAGE_STATE_FREE;
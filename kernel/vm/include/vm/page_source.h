@@ -0,0 +1,82 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/ref_counted.h>
+#include <kernel/lockdep.h>
+#include <kernel/mutex.h>
+#include <stdint.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+// Supplies the contents of a VmObjectPaged whose pages are not resident.
+//
+// When a fault hits a missing page, the object calls GetPage() under its lock.
+// That records a request for the current thread, asks the source to produce
+// the page and returns ZX_ERR_SHOULD_WAIT. The faulting code then drops every
+// lock it holds and calls WaitForRequest(), after which it retries the fault.
+// Code that cannot drop its locks must call CancelRequest() instead.
+//
+// A kernel fault on user memory taken with a mutex held doesn't wait; it
+// fails the user copy and leaves the request behind. Callers that copy under
+// a lock check HasRequest() when the copy fails, and wait once unlocked.
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    // |owner| is the koid of the object that services the requests.
+    explicit PageSource(zx_koid_t owner) : owner_(owner) {}
+    virtual ~PageSource() = default;
+
+    zx_koid_t owner() const { return owner_; }
+
+    // Registers a request for the page at |offset| on behalf of the current
+    // thread. Returns ZX_ERR_SHOULD_WAIT on success.
+    zx_status_t GetPage(uint64_t offset);
+
+    // Wakes every thread waiting for a page in [offset, offset + len).
+    void OnPagesSupplied(uint64_t offset, uint64_t len);
+
+    // Fails all outstanding and future requests with ZX_ERR_BAD_STATE.
+    void Detach();
+
+    // Called when the object the source backs is destroyed.
+    virtual void Close() {}
+
+    // Blocks until the request made by the current thread is resolved. Returns
+    // ZX_OK if there was no request or the page was supplied; the caller should
+    // retry the operation in that case.
+    static zx_status_t WaitForRequest();
+
+    // Drops the current thread's request, if any, without waiting for it.
+    static void CancelRequest();
+
+    // Returns true if the current thread has a request outstanding.
+    static bool HasRequest();
+
+protected:
+    // Asks the provider for the contents of [offset, offset + len). Called with
+    // the request lock held; must not block.
+    virtual zx_status_t SendRequest(uint64_t offset, uint64_t len) = 0;
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageSource);
+
+    // a thread blocked on one page of one source
+    struct Request;
+
+    // Requests from every source live on one list; there is at most one per
+    // thread and few are outstanding at any time.
+    DECLARE_SINGLETON_MUTEX(RequestLock);
+    static fbl::DoublyLinkedList<Request*> requests_ TA_GUARDED(RequestLock::Get());
+
+    static Request* FindCurrentLocked() TA_REQ(RequestLock::Get());
+
+    const zx_koid_t owner_;
+
+    bool detached_ TA_GUARDED(RequestLock::Get()) = false;
+};
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <kernel/cpu.h>
 #include <sys/types.h>
 #include <vm/page.h>
 #include <zircon/compiler.h>
@@ -29,9 +30,24 @@ typedef struct pmm_arena_info {
 // The arena data will be copied.
 zx_status_t pmm_add_arena(const pmm_arena_info_t* arena) __NONNULL((1));
 
+// Maximum number of NUMA nodes the pmm keeps separate free lists for. Nodes
+// are numbered densely from 0; node 0 is used until the platform says otherwise.
+#define PMM_MAX_NUMA_NODES 8
+#define PMM_MAX_NUMA_RANGES 32
+
+// Mark the physical range [base, base + size) as local to NUMA node |node|.
+// Free pages in the range are moved onto that node's free lists, and pages
+// that are currently allocated land there when they are freed.
+zx_status_t pmm_set_numa_range(paddr_t base, size_t size, uint node);
+
+// Mark |cpu| as local to NUMA node |node|. Allocations made on |cpu| are
+// served from that node first, falling back to the others in order.
+zx_status_t pmm_set_cpu_numa_node(cpu_num_t cpu, uint node);
+
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)    // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_LO_MEM (0x1) // allocate only from arenas marked LO_MEM
+#define PMM_ALLOC_FLAG_ZEROED (0x2) // hand back pages filled with zeros
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -324,6 +324,11 @@ private:
                         vaddr_t* pva, vaddr_t search_base, vaddr_t align,
                         size_t region_size, size_t min_gap, uint arch_mmu_flags);
 
+    // returns true if a region of |size| can be placed at |base|, which must
+    // be free, and if so populates pva with the base address to use.
+    bool CheckSpotLocked(vaddr_t base, vaddr_t align, size_t size, uint arch_mmu_flags,
+                         vaddr_t* pva);
+
     // search for a spot to allocate for a region of a given size
     zx_status_t AllocSpotLocked(size_t size, uint8_t align_pow2, uint arch_mmu_flags, vaddr_t* spot);
 
@@ -493,6 +498,19 @@ private:
     // in Clang around capability aliasing, we need to relax the analysis.
     void ActivateLocked();
 
+    // Returns true if the |size| byte window at |va| lies inside this mapping and
+    // the object backs it with resident, physically contiguous pages aligned to
+    // |size|, in which case |pa| is the base of the run. Requires the object's lock.
+    bool LargePageWindowLocked(vaddr_t va, size_t size, paddr_t* pa);
+
+    // Replace whatever is mapped in the |size| byte window at |va| with a single
+    // large leaf mapping of |pa|. Requires the object's lock.
+    zx_status_t MapLargePageLocked(vaddr_t va, size_t size, paddr_t pa);
+
+    // After a fault on |va|, map the pages around it that the object already has
+    // resident, up to the kernel.vm.fault-around window. Requires the object's lock.
+    void FaultAroundLocked(vaddr_t va, uint pf_flags);
+
     // pointer and region of the object we are mapping
     fbl::RefPtr<VmObject> object_;
     uint64_t object_offset_ = 0;
@@ -12,7 +12,7 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/macros.h>
 #include <fbl/name.h>
-#include <fbl/ref_counted.h>
+#include <fbl/ref_counted_upgradeable.h>
 #include <fbl/ref_ptr.h>
 #include <kernel/lockdep.h>
 #include <kernel/mutex.h>
@@ -29,17 +29,36 @@ class VmMapping;
 
 typedef zx_status_t (*vmo_lookup_fn_t)(void* context, size_t offset, size_t index, paddr_t pa);
 
+// One step of a VmObject::RangeOpBatch(), which fills in |status|.
+struct VmRangeOp {
+    enum class Type : uint32_t {
+        Commit,
+        Decommit,
+        CacheSync,
+        CacheInvalidate,
+        CacheClean,
+        CacheCleanInvalidate,
+    };
+
+    Type type;
+    uint64_t offset;
+    uint64_t len;
+    zx_status_t status;
+};
+
 class VmObjectChildObserver {
 public:
     virtual void OnZeroChild() = 0;
     virtual void OnOneChild() = 0;
+    virtual void OnPagesDiscarded() = 0;
+    virtual void OnDiscardAcknowledged() = 0;
 };
 
 // The base vm object that holds a range of bytes of data
 //
 // Can be created without mapping and used as a container of data, or mappable
 // into an address space via VmAddressRegion::CreateVmMapping
-class VmObject : public fbl::RefCounted<VmObject>,
+class VmObject : public fbl::RefCountedUpgradeable<VmObject>,
                  public fbl::DoublyLinkedListable<VmObject*> {
 public:
     // public API
@@ -56,6 +75,8 @@ public:
     virtual bool is_contiguous() const { return false; }
     // Returns true if the object size can be changed.
     virtual bool is_resizable() const { return false; }
+    // Returns true if missing pages are provided by a page source.
+    virtual bool is_pager_backed() const { return false; }
 
     // Returns the number of physical pages currently allocated to the
     // object where (offset <= page_offset < offset+len).
@@ -78,6 +99,38 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Give committed pages that hold nothing but zeros back to the pmm, so that
+    // they read from the shared zero page again. Returns the number of pages
+    // freed.
+    virtual size_t ReclaimZeroPages() { return 0; }
+
+    // Discardable objects may have their pages dropped under memory pressure
+    // while they are unlocked. Locking reports through |was_discarded| whether
+    // that happened since the previous lock.
+    virtual zx_status_t LockDiscardable(bool* was_discarded) { return ZX_ERR_NOT_SUPPORTED; }
+    virtual zx_status_t UnlockDiscardable() { return ZX_ERR_NOT_SUPPORTED; }
+
+    // Ages the pages of an unlocked discardable object, dropping up to
+    // |max_pages| of those that weren't touched since the previous call.
+    // Returns the number of pages freed.
+    virtual size_t EvictPages(size_t max_pages) { return 0; }
+
+    // Removes the pages backing [offset, offset + len) and appends them to
+    // |pages| in offset order, leaving the range decommitted. Uncommitted
+    // pages are handed out as freshly zeroed ones.
+    virtual zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Installs |pages|, as produced by TakePages(), into the range of a
+    // pager-backed object and wakes the threads waiting on it. |owner| must
+    // match the owner of the object's page source. Pages already present are
+    // kept and the supplied copies freed.
+    virtual zx_status_t SupplyPages(zx_koid_t owner, uint64_t offset, uint64_t len,
+                                    list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // Pin the given range of the vmo.  If any pages are not committed, this
     // returns a ZX_ERR_NO_MEMORY.
     virtual zx_status_t Pin(uint64_t offset, uint64_t len) {
@@ -157,6 +210,11 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Runs |count| commit, decommit or cache operations in order, recording the
+    // result of each in its |status|. A failing step doesn't stop the ones after
+    // it. Objects that can are expected to take their lock only once.
+    virtual void RangeOpBatch(VmRangeOp* ops, size_t count);
+
     virtual uint32_t GetMappingCachePolicy() const = 0;
     virtual zx_status_t SetMappingCachePolicy(const uint32_t cache_policy) {
         return ZX_ERR_NOT_SUPPORTED;
@@ -170,7 +228,15 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
-    // Returns true if this VMO was created via CloneCOW().
+    // create a non-resizable copy-on-write clone that keeps seeing the contents this
+    // vmo had at the time of the call; later writes to this vmo copy the old page
+    // into the clone first
+    virtual zx_status_t CloneSnapshot(uint64_t offset, uint64_t size, bool copy_name,
+                                      fbl::RefPtr<VmObject>* clone_vmo) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Returns true if this VMO was created via CloneCOW() or CloneSnapshot().
     // TODO: If more types of clones appear, replace this with a method that
     // returns an enum rather than adding a new method for each clone type.
     bool is_cow_clone() const;
@@ -182,6 +248,22 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // If every page in [offset, offset + len) is resident in this object and the
+    // pages are physically contiguous, return the physical address of the first
+    // one. Used by mappings to decide whether a range can be mapped with a large page.
+    virtual zx_status_t GetContiguousRunLocked(uint64_t offset, uint64_t len, paddr_t* pa)
+        TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // execute lookup_fn on every page in [offset, offset + len) that is already
+    // resident in this object, without faulting anything in
+    virtual zx_status_t LookupResidentLocked(uint64_t offset, uint64_t len,
+                                             vmo_lookup_fn_t lookup_fn, void* context)
+        TA_REQ(lock_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     Lock<fbl::Mutex>* lock() TA_RET_CAP(lock_) { return &lock_; }
     Lock<fbl::Mutex>& lock_ref() TA_RET_CAP(lock_) { return lock_; }
 
@@ -216,6 +298,12 @@ public:
         return ZX_OK;
     }
 
+    // Takes references to up to |count| live VMOs that come after |cursor| in
+    // the global list, or from the start of it if |cursor| is null, so they can
+    // be worked on without holding the list lock. The caller must hold a
+    // reference to |cursor|. Returns the number of references taken.
+    static size_t TakeRefsAfter(VmObject* cursor, fbl::RefPtr<VmObject>* out, size_t count);
+
 protected:
     // private constructor (use Create())
     explicit VmObject(fbl::RefPtr<VmObject> parent);
@@ -236,6 +324,19 @@ protected:
         // Called under the parent's lock, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS { RangeChangeUpdateLocked(offset, len); }
 
+    // Returns true once a user visible object has lost its handle and all of its
+    // mappings, leaving its children as the only way to reach its pages.
+    bool IsOrphanedLocked() const TA_REQ(lock_);
+
+    // Called when this object may have become an orphaned interior node of a
+    // clone tree. The caller must hold a reference to this object of its own,
+    // since collapsing drops the one held by the child.
+    virtual void CollapseLocked() TA_REQ(lock_) {}
+
+    // Tell the observer, if any, that pages were dropped or that the loss was
+    // acknowledged by locking.
+    void NotifyDiscardedLocked(bool discarded) TA_REQ(lock_);
+
     // magic value
     fbl::Canary<fbl::magic("VMO_")> canary_;
 
@@ -17,6 +17,7 @@
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
 #include <stdint.h>
+#include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
@@ -31,6 +32,10 @@ public:
     // |options_| is a bitmask of:
     static constexpr uint32_t kResizable = (1u << 0);
     static constexpr uint32_t kContiguous = (1u << 1);
+    // pages may be dropped under memory pressure while unlocked; starts locked
+    static constexpr uint32_t kDiscardable = (1u << 2);
+    // a clone that keeps the contents its parent had when it was created
+    static constexpr uint32_t kSnapshot = (1u << 3);
 
     static zx_status_t Create(uint32_t pmm_alloc_flags,
                               uint32_t options,
@@ -44,6 +49,11 @@ public:
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // Create a VMO whose pages are provided on demand by |src|. Faults on
+    // missing pages block until the source supplies them.
+    static zx_status_t CreateWithSource(uint32_t pmm_alloc_flags, uint64_t size,
+                                        fbl::RefPtr<PageSource> src, fbl::RefPtr<VmObject>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint32_t create_options() const override { return options_; }
@@ -54,11 +64,24 @@ public:
     bool is_paged() const override { return true; }
     bool is_contiguous() const override { return (options_ & kContiguous); }
     bool is_resizable() const override { return (options_ & kResizable); }
+    bool is_discardable() const { return (options_ & kDiscardable); }
+    bool is_snapshot() const { return (options_ & kSnapshot); }
+    bool is_pager_backed() const override { return page_source_ != nullptr; }
 
     size_t AllocatedPagesInRange(uint64_t offset, uint64_t len) const override;
 
     zx_status_t CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) override;
     zx_status_t DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) override;
+    size_t ReclaimZeroPages() override;
+    void RangeOpBatch(VmRangeOp* ops, size_t count) override;
+
+    zx_status_t LockDiscardable(bool* was_discarded) override;
+    zx_status_t UnlockDiscardable() override;
+    size_t EvictPages(size_t max_pages) override;
+
+    zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) override;
+    zx_status_t SupplyPages(zx_koid_t owner, uint64_t offset, uint64_t len,
+                            list_node* pages) override;
 
     zx_status_t Pin(uint64_t offset, uint64_t len) override;
     void Unpin(uint64_t offset, uint64_t len) override;
@@ -86,15 +109,26 @@ public:
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    zx_status_t GetContiguousRunLocked(uint64_t offset, uint64_t len, paddr_t* pa) override
+        TA_REQ(lock_);
+    zx_status_t LookupResidentLocked(uint64_t offset, uint64_t len, vmo_lookup_fn_t lookup_fn,
+                                     void* context) override TA_REQ(lock_);
+
     zx_status_t CloneCOW(bool resizable, uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
         // Calls a Locked method of the child, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
+    zx_status_t CloneSnapshot(uint64_t offset, uint64_t size, bool copy_name,
+                              fbl::RefPtr<VmObject>* clone_vmo) override;
 
     void RangeChangeUpdateFromParentLocked(uint64_t offset, uint64_t len) override
         // Called under the parent's lock, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
 
+    void CollapseLocked() override
+        // Moves pages into the child and relinks it, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
     uint32_t GetMappingCachePolicy() const override;
     zx_status_t SetMappingCachePolicy(const uint32_t cache_policy) override;
 
@@ -119,6 +153,13 @@ private:
                              Sync
     };
     zx_status_t CacheOp(const uint64_t offset, const uint64_t len, const CacheOpType type);
+    zx_status_t CacheOpLocked(const uint64_t offset, const uint64_t len, const CacheOpType type)
+        TA_REQ(lock_);
+
+    zx_status_t CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed)
+        TA_REQ(lock_);
+    zx_status_t DecommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* decommitted)
+        TA_REQ(lock_);
 
     // add a page to the object
     zx_status_t AddPage(vm_page_t* p, uint64_t offset);
@@ -137,6 +178,22 @@ private:
     template <typename T>
     zx_status_t ReadWriteInternal(uint64_t offset, size_t len, bool write, T copyfunc);
 
+    // shared by CloneCOW() and CloneSnapshot()
+    zx_status_t CreateClone(uint32_t options, uint64_t offset, uint64_t size, bool copy_name,
+                            fbl::RefPtr<VmObject>* clone_vmo)
+        // Calls a Locked method of the child, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Snapshot clones read our pages as they were when the snapshot was taken.
+    // Before one of our pages changes, each snapshot that still reads through
+    // to it gets its own copy. Only the root of a clone tree can have snapshots.
+    bool HasSnapshotChildrenLocked() const TA_REQ(lock_);
+    zx_status_t PreservePageForSnapshotsLocked(uint64_t offset)
+        // Adds pages to the children, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+    // preserves the pages we have in [start, end)
+    zx_status_t PreserveRangeForSnapshotsLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
     // set our offset within our parent
     zx_status_t SetParentOffsetLocked(uint64_t o) TA_REQ(lock_);
 
@@ -147,6 +204,15 @@ private:
     uint32_t pmm_alloc_flags_ TA_GUARDED(lock_) = PMM_ALLOC_FLAG_ANY;
     uint32_t cache_policy_ TA_GUARDED(lock_) = ARCH_MMU_FLAG_CACHED;
 
+    // outstanding LockDiscardable() calls, and whether pages were dropped since
+    // the last one
+    uint32_t discardable_locks_ TA_GUARDED(lock_) = 0;
+    bool discarded_ TA_GUARDED(lock_) = false;
+
+    // where missing pages come from, shared by every clone of a pager-backed
+    // object; set before the object is published and never changed
+    fbl::RefPtr<PageSource> page_source_;
+
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
 };
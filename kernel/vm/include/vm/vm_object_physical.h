@@ -40,6 +40,10 @@ public:
 
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
                               vm_page_t**, paddr_t* pa) override TA_REQ(lock_);
+    zx_status_t GetContiguousRunLocked(uint64_t offset, uint64_t len, paddr_t* pa) override
+        TA_REQ(lock_);
+    zx_status_t LookupResidentLocked(uint64_t offset, uint64_t len, vmo_lookup_fn_t lookup_fn,
+                                     void* context) override TA_REQ(lock_);
 
     uint32_t GetMappingCachePolicy() const override;
     zx_status_t SetMappingCachePolicy(const uint32_t cache_policy) override;
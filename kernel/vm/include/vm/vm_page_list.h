@@ -8,15 +8,14 @@
 
 #include <err.h>
 #include <fbl/canary.h>
-#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
-#include <fbl/unique_ptr.h>
+#include <list.h>
 #include <vm/vm.h>
 #include <zircon/types.h>
 
 struct vm_page;
 
-class VmPageListNode final : public fbl::WAVLTreeContainable<fbl::unique_ptr<VmPageListNode>> {
+class VmPageListNode final {
 public:
     explicit VmPageListNode(uint64_t offset);
     ~VmPageListNode();
@@ -27,7 +26,6 @@ public:
 
     // accessors
     uint64_t offset() const { return obj_offset_; }
-    uint64_t GetKey() const { return obj_offset_; }
 
     // for every valid page in the node call the passed in function
     template <typename T>
@@ -101,6 +99,13 @@ private:
     vm_page* pages_[kPageFanOut] = {};
 };
 
+// Sparse map from page aligned vmo offsets to pages.
+//
+// Pages are held in VmPageListNodes of kPageFanOut consecutive pages, which
+// form the leaves of a radix tree. Each interior node resolves kRadixShift bits
+// of the leaf index, and the tree only grows as tall as the largest offset in
+// use requires, so lookups in even very large vmos touch a handful of nodes
+// and range walks visit leaves in offset order without searching.
 class VmPageList final {
 public:
     VmPageList();
@@ -108,82 +113,52 @@ public:
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VmPageList);
 
-    // walk the page tree, calling the passed in function on every tree node
+    // walk the page tree, calling the passed in function on every page
     template <typename T>
     zx_status_t ForEveryPage(T per_page_func) {
-        for (auto& pl : list_) {
-            zx_status_t status = pl.ForEveryPage(per_page_func, pl.offset(),
-                                                 pl.offset() + pl.kPageFanOut * PAGE_SIZE);
-            if (unlikely(status != ZX_ERR_NEXT)) {
-                if (status == ZX_ERR_STOP) {
-                    break;
-                }
-                return status;
-            }
-        }
-        return ZX_OK;
+        return ForEveryPageInLeafRange(this, per_page_func, 0, UINT64_MAX);
     }
 
-    // walk the page tree, calling the passed in function on every tree node
+    // walk the page tree, calling the passed in function on every page
     template <typename T>
     zx_status_t ForEveryPage(T per_page_func) const {
-        for (auto& pl : list_) {
-            zx_status_t status = pl.ForEveryPage(per_page_func, pl.offset(),
-                                                 pl.offset() + pl.kPageFanOut * PAGE_SIZE);
-            if (unlikely(status != ZX_ERR_NEXT)) {
-                if (status == ZX_ERR_STOP) {
-                    break;
-                }
-                return status;
-            }
-        }
-        return ZX_OK;
+        return ForEveryPageInLeafRange(this, per_page_func, 0, UINT64_MAX);
     }
 
-    // walk the page tree, calling the passed in function on every tree node
+    // walk the page tree, calling the passed in function on every page in
+    // [start_offset, end_offset)
     template <typename T>
     zx_status_t ForEveryPageInRange(T per_page_func, uint64_t start_offset, uint64_t end_offset) {
         DEBUG_ASSERT(IS_PAGE_ALIGNED(start_offset) && IS_PAGE_ALIGNED(end_offset));
-        // Find the first node with a start after start_offset; if start_offset
-        // is in a node, it'll be in the one before it.
-        auto start = --list_.upper_bound(start_offset);
-        if (!start.IsValid()) {
-            start = list_.begin();
-        }
-        const auto end = list_.lower_bound(end_offset);
-        for (auto itr = start; itr != end; ++itr) {
-            auto& pl = *itr;
-            zx_status_t status = pl.ForEveryPage(per_page_func, start_offset, end_offset);
-            if (unlikely(status != ZX_ERR_NEXT)) {
-                if (status == ZX_ERR_STOP) {
-                    break;
-                }
-                return status;
-            }
-        }
-        return ZX_OK;
+        return ForEveryPageInLeafRange(this, per_page_func, start_offset, end_offset);
     }
 
     template <typename T>
     zx_status_t ForEveryPageInRange(T per_page_func, uint64_t start_offset,
                                     uint64_t end_offset) const {
         DEBUG_ASSERT(IS_PAGE_ALIGNED(start_offset) && IS_PAGE_ALIGNED(end_offset));
-        // Find the first node with a start after start_offset; if start_offset
-        // is in a node, it'll be in the one before it.
-        auto start = --list_.upper_bound(start_offset);
-        if (!start.IsValid()) {
-            start = list_.begin();
-        }
-        const auto end = list_.lower_bound(end_offset);
-        for (auto itr = start; itr != end; ++itr) {
-            auto& pl = *itr;
-            zx_status_t status = pl.ForEveryPage(per_page_func, start_offset, end_offset);
-            if (unlikely(status != ZX_ERR_NEXT)) {
-                if (status == ZX_ERR_STOP) {
-                    break;
+        return ForEveryPageInLeafRange(this, per_page_func, start_offset, end_offset);
+    }
+
+    // Call |gap_func(gap_start, gap_end)| for every maximal run of offsets in
+    // [start_offset, end_offset) that has no page. The tree is looked up
+    // afresh between calls, so |gap_func| may add pages to the list.
+    template <typename T>
+    zx_status_t ForEveryGapInRange(T gap_func, uint64_t start_offset, uint64_t end_offset) {
+        DEBUG_ASSERT(IS_PAGE_ALIGNED(start_offset) && IS_PAGE_ALIGNED(end_offset));
+        uint64_t cur = start_offset;
+        while (cur < end_offset) {
+            uint64_t next;
+            if (!FindNextPage(cur, end_offset, &next)) {
+                next = end_offset;
+            }
+            if (next > cur) {
+                zx_status_t status = gap_func(cur, next);
+                if (unlikely(status != ZX_ERR_NEXT)) {
+                    return (status == ZX_ERR_STOP) ? ZX_OK : status;
                 }
-                return status;
             }
+            cur = next + PAGE_SIZE;
         }
         return ZX_OK;
     }
@@ -191,9 +166,116 @@ public:
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
     zx_status_t FreePage(uint64_t offset);
+
+    // Take the page at |offset| out of the list without freeing it. Returns
+    // nullptr if there was no page there.
+    vm_page* RemovePage(uint64_t offset);
+
+    // Find the offset of the first page in [start_offset, end_offset).
+    bool FindNextPage(uint64_t start_offset, uint64_t end_offset, uint64_t* offset) const;
+
+    // Take every page in [start_offset, end_offset) out of the list, appending
+    // them to |pages|. Returns the number of pages removed.
+    size_t RemovePages(uint64_t start_offset, uint64_t end_offset, list_node* pages);
+
+    // Release every page in [start_offset, end_offset) back to the pmm in one
+    // batch. Returns the number of pages freed.
+    size_t FreePages(uint64_t start_offset, uint64_t end_offset);
+
     size_t FreeAllPages();
     bool IsEmpty();
 
+    // Number of pages in the list, kept up to date as pages are added and
+    // removed so that it can be read without walking the tree.
+    size_t page_count() const { return page_count_; }
+
 private:
-    fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmPageListNode>> list_;
+    static constexpr uint kRadixShift = 6;
+    static constexpr size_t kRadixFanOut = 1ul << kRadixShift;
+    static constexpr uint64_t kLeafSpan = VmPageListNode::kPageFanOut * PAGE_SIZE;
+    // enough levels to index a leaf anywhere in a 64 bit offset space
+    static constexpr uint kMaxHeight =
+        (64 - (PAGE_SIZE_SHIFT + 4) + kRadixShift - 1) / kRadixShift;
+    static_assert(VmPageListNode::kPageFanOut == 16, "kMaxHeight assumes 16 pages per leaf");
+
+    struct RadixNode {
+        // children at heights above 1, leaves at height 1
+        union {
+            RadixNode* children[kRadixFanOut] = {};
+            VmPageListNode* leaves[kRadixFanOut];
+        };
+        size_t count = 0;
+    };
+
+    // number of leaves a tree of |height| can address
+    static uint64_t Capacity(uint height) {
+        return (height == 0) ? 0 : (1ull << (height * kRadixShift));
+    }
+
+    static RadixNode* Root(VmPageList* list) { return list->root_; }
+    static const RadixNode* Root(const VmPageList* list) { return list->root_; }
+
+    VmPageListNode* FindLeaf(uint64_t leaf_index) const;
+    bool FindNextLeaf(const RadixNode* node, uint level, uint64_t base, uint64_t start,
+                      uint64_t end, const VmPageListNode** leaf) const;
+    void RemoveLeaf(uint64_t leaf_index);
+    static void FreeTree(RadixNode* node, uint level);
+
+    // Visit every leaf of the subtree at |node|, which covers leaf indices
+    // starting at |base|, that intersects leaf indices [start, end).
+    template <typename N, typename F>
+    static zx_status_t ForEveryLeaf(N* node, uint level, uint64_t base, uint64_t start,
+                                    uint64_t end, F func) {
+        const uint shift = (level - 1) * kRadixShift;
+        size_t i = (start > base) ? (size_t)((start - base) >> shift) : 0;
+        for (; i < kRadixFanOut; i++) {
+            const uint64_t child_base = base + ((uint64_t)i << shift);
+            if (child_base >= end) {
+                break;
+            }
+            zx_status_t status;
+            if (level == 1) {
+                if (!node->leaves[i]) {
+                    continue;
+                }
+                status = func(*node->leaves[i]);
+            } else {
+                if (!node->children[i]) {
+                    continue;
+                }
+                status = ForEveryLeaf(node->children[i], level - 1, child_base, start, end, func);
+            }
+            if (unlikely(status != ZX_ERR_NEXT)) {
+                return status;
+            }
+        }
+        return ZX_ERR_NEXT;
+    }
+
+    // Shared body of the ForEveryPage variants; |List| is VmPageList or
+    // const VmPageList so the callback sees the matching constness.
+    template <typename List, typename T>
+    static zx_status_t ForEveryPageInLeafRange(List* list, T per_page_func,
+                                               uint64_t start_offset, uint64_t end_offset) {
+        if (!list->root_ || end_offset <= start_offset) {
+            return ZX_OK;
+        }
+        const uint64_t start = start_offset / kLeafSpan;
+        const uint64_t end = (end_offset - 1) / kLeafSpan + 1;
+        zx_status_t status = ForEveryLeaf(
+            Root(list), list->height_, 0, start, end,
+            [&per_page_func, start_offset, end_offset](auto& pl) {
+                return pl.ForEveryPage(per_page_func, MAX(start_offset, pl.offset()),
+                                       MIN(end_offset, pl.offset() + kLeafSpan));
+            });
+        if (status == ZX_ERR_NEXT || status == ZX_ERR_STOP) {
+            return ZX_OK;
+        }
+        return status;
+    }
+
+    RadixNode* root_ = nullptr;
+    uint height_ = 0;
+    size_t leaf_count_ = 0;
+    size_t page_count_ = 0;
 };
@@ -11,6 +11,11 @@
 #include <string.h>
 #include <trace.h>
 
+#include <arch/ops.h>
+#include <kernel/align.h>
+#include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
@@ -24,6 +29,49 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER(kstack_cache_hits, "kernel.kstack.cache.hits");
+KCOUNTER(kstack_cache_misses, "kernel.kstack.cache.misses");
+// net number of stacks sitting in the caches, summed over all cpus
+KCOUNTER(kstack_cache_size, "kernel.kstack.cache.size");
+
+namespace {
+
+// How many freed stacks each cpu holds on to, still mapped and committed, so
+// that creating a thread after another one exited skips the VMAR work.
+constexpr size_t kKstackCacheDepth = 4;
+
+struct __CPU_ALIGN KstackCache {
+    DECLARE_SPINLOCK(KstackCache) lock;
+    size_t count TA_GUARDED(lock) = 0;
+    kstack_t stacks[kKstackCacheDepth] TA_GUARDED(lock) = {};
+};
+
+KstackCache kstack_cache[SMP_MAX_CPUS];
+
+bool kstack_cache_take(kstack_t* stack) {
+    KstackCache& cache = kstack_cache[arch_curr_cpu_num()];
+
+    Guard<SpinLock, IrqSave> guard{&cache.lock};
+    if (cache.count == 0) {
+        return false;
+    }
+    *stack = cache.stacks[--cache.count];
+    return true;
+}
+
+bool kstack_cache_put(const kstack_t* stack) {
+    KstackCache& cache = kstack_cache[arch_curr_cpu_num()];
+
+    Guard<SpinLock, IrqSave> guard{&cache.lock};
+    if (cache.count == kKstackCacheDepth) {
+        return false;
+    }
+    cache.stacks[cache.count++] = *stack;
+    return true;
+}
+
+} // namespace
+
 // Allocates and maps a kernel stack with one page of padding before and after the mapping.
 static zx_status_t allocate_vmar(bool unsafe,
                                  fbl::RefPtr<VmMapping>* out_kstack_mapping,
@@ -111,6 +159,13 @@ zx_status_t vm_allocate_kstack(kstack_t* stack) {
     DEBUG_ASSERT(stack->unsafe_vmar == nullptr);
 #endif
 
+    if (kstack_cache_take(stack)) {
+        kcounter_add(kstack_cache_hits, 1);
+        kcounter_add(kstack_cache_size, -1);
+        return ZX_OK;
+    }
+    kcounter_add(kstack_cache_misses, 1);
+
     fbl::RefPtr<VmMapping> mapping;
     fbl::RefPtr<VmAddressRegion> vmar;
     zx_status_t status = allocate_vmar(false, &mapping, &vmar);
@@ -141,6 +196,18 @@ zx_status_t vm_allocate_kstack(kstack_t* stack) {
 }
 
 zx_status_t vm_free_kstack(kstack_t* stack) {
+    // only whole stacks are worth keeping, not ones vm_allocate_kstack gave
+    // up on half way
+    bool complete = stack->vmar != nullptr;
+#if __has_feature(safe_stack)
+    complete = complete && stack->unsafe_vmar != nullptr;
+#endif
+    if (complete && kstack_cache_put(stack)) {
+        kcounter_add(kstack_cache_size, 1);
+        *stack = {};
+        return ZX_OK;
+    }
+
     stack->base = 0;
     stack->size = 0;
     stack->top = 0;
@@ -0,0 +1,175 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_source.h>
+
+#include "vm_priv.h"
+
+#include <assert.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <trace.h>
+#include <vm/vm.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(vm_page_source_requests, "kernel.vm.page_source.requests");
+KCOUNTER(vm_page_source_waits, "kernel.vm.page_source.waits");
+
+struct PageSource::Request : public fbl::DoublyLinkedListable<Request*> {
+    thread_t* thread;
+    fbl::RefPtr<PageSource> source;
+    uint64_t offset;
+    // set once the request is resolved, along with |status|
+    bool done;
+    zx_status_t status;
+    event_t event;
+};
+
+fbl::DoublyLinkedList<PageSource::Request*> PageSource::requests_;
+
+PageSource::Request* PageSource::FindCurrentLocked() {
+    thread_t* current = get_current_thread();
+    for (auto& r : requests_) {
+        if (r.thread == current) {
+            return &r;
+        }
+    }
+    return nullptr;
+}
+
+zx_status_t PageSource::GetPage(uint64_t offset) {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+
+    Guard<fbl::Mutex> guard{RequestLock::Get()};
+
+    if (detached_) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // a thread only waits on one page at a time, so a stale request left by a
+    // retried operation gets reused for the new one
+    Request* req = FindCurrentLocked();
+    if (req) {
+        requests_.erase(*req);
+    } else {
+        fbl::AllocChecker ac;
+        req = new (&ac) Request;
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        req->thread = get_current_thread();
+        event_init(&req->event, false, 0);
+    }
+    req->source = fbl::WrapRefPtr(this);
+    req->offset = offset;
+    req->done = false;
+    req->status = ZX_OK;
+    event_unsignal(&req->event);
+
+    // only the first thread to miss on a page sends a request for it
+    bool pending = false;
+    for (const auto& r : requests_) {
+        if (r.source.get() == this && r.offset == offset && !r.done) {
+            pending = true;
+            break;
+        }
+    }
+    if (!pending) {
+        zx_status_t status = SendRequest(offset, PAGE_SIZE);
+        if (status != ZX_OK) {
+            event_destroy(&req->event);
+            delete req;
+            return status;
+        }
+        kcounter_add(vm_page_source_requests, 1);
+    }
+
+    LTRACEF("source %p offset %#" PRIx64 " pending %d\n", this, offset, pending);
+
+    requests_.push_back(req);
+    return ZX_ERR_SHOULD_WAIT;
+}
+
+void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
+    Guard<fbl::Mutex> guard{RequestLock::Get()};
+
+    for (auto& r : requests_) {
+        if (r.source.get() == this && !r.done && r.offset >= offset && r.offset - offset < len) {
+            r.done = true;
+            r.status = ZX_OK;
+            event_signal_etc(&r.event, false, ZX_OK);
+        }
+    }
+}
+
+void PageSource::Detach() {
+    Guard<fbl::Mutex> guard{RequestLock::Get()};
+
+    detached_ = true;
+    for (auto& r : requests_) {
+        if (r.source.get() == this && !r.done) {
+            r.done = true;
+            r.status = ZX_ERR_BAD_STATE;
+            event_signal_etc(&r.event, false, ZX_ERR_BAD_STATE);
+        }
+    }
+}
+
+// static
+zx_status_t PageSource::WaitForRequest() {
+    Request* req;
+    {
+        Guard<fbl::Mutex> guard{RequestLock::Get()};
+        req = FindCurrentLocked();
+    }
+    if (!req) {
+        return ZX_OK;
+    }
+
+    kcounter_add(vm_page_source_waits, 1);
+
+    // Only this thread ever removes its request, so it is safe to wait on it
+    // without the lock.
+    zx_status_t status = event_wait_deadline(&req->event, ZX_TIME_INFINITE, true);
+
+    {
+        Guard<fbl::Mutex> guard{RequestLock::Get()};
+        requests_.erase(*req);
+        if (status == ZX_OK) {
+            status = req->status;
+        }
+    }
+
+    event_destroy(&req->event);
+    delete req;
+    return status;
+}
+
+// static
+void PageSource::CancelRequest() {
+    Request* req;
+    {
+        Guard<fbl::Mutex> guard{RequestLock::Get()};
+        req = FindCurrentLocked();
+        if (!req) {
+            return;
+        }
+        requests_.erase(*req);
+    }
+
+    event_destroy(&req->event);
+    delete req;
+}
+
+// static
+bool PageSource::HasRequest() {
+    Guard<fbl::Mutex> guard{RequestLock::Get()};
+    return FindCurrentLocked() != nullptr;
+}
@@ -10,7 +10,9 @@
 #include <assert.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <lib/console.h>
 #include <lk/init.h>
@@ -47,6 +49,43 @@ static void pmm_enforce_fill(uint level) {
 LK_INIT_HOOK(pmm_fill, &pmm_enforce_fill, LK_INIT_LEVEL_VM);
 #endif
 
+static void pmm_cache_init(uint level) {
+    uint32_t high = cmdline_get_uint32("kernel.pmm.cache-high", PMM_CACHE_DEFAULT_HIGH_WATERMARK);
+    uint32_t low = cmdline_get_uint32("kernel.pmm.cache-low", PMM_CACHE_DEFAULT_LOW_WATERMARK);
+    pmm_node.SetCacheWatermarks(high, low);
+}
+LK_INIT_HOOK(pmm_cache, &pmm_cache_init, LK_INIT_LEVEL_VM);
+
+// pages zeroed per trip through the node lock
+static constexpr size_t kPmmZeroBatch = 16;
+
+static int pmm_zero_thread(void*) {
+    for (;;) {
+        if (pmm_node.ZeroFreePages(kPmmZeroBatch) == 0) {
+            pmm_node.WaitForZeroingWork();
+        }
+    }
+    return 0;
+}
+
+static void pmm_zero_init(uint level) {
+    uint64_t pages = cmdline_get_uint64("kernel.pmm.zeroed-pool-pages",
+                                        PMM_ZEROED_POOL_DEFAULT_PAGES);
+    if (pages == 0) {
+        return;
+    }
+
+    // only soak up otherwise idle cpu time
+    thread_t* t = thread_create("pmm-zero", pmm_zero_thread, nullptr, IDLE_PRIORITY + 1);
+    if (!t) {
+        printf("PMM: failed to create page zeroing thread\n");
+        return;
+    }
+    pmm_node.SetZeroedPoolTarget(pages);
+    thread_detach_and_resume(t);
+}
+LK_INIT_HOOK(pmm_zero, &pmm_zero_init, LK_INIT_LEVEL_LAST);
+
 vm_page_t* paddr_to_vm_page(paddr_t addr) {
     return pmm_node.PaddrToPage(addr);
 }
@@ -99,6 +138,14 @@ void pmm_free_page(vm_page* page) {
     pmm_node.FreePage(page);
 }
 
+zx_status_t pmm_set_numa_range(paddr_t base, size_t size, uint node) {
+    return pmm_node.SetNumaRange(base, size, node);
+}
+
+zx_status_t pmm_set_cpu_numa_node(cpu_num_t cpu, uint node) {
+    return pmm_node.SetCpuNumaNode(cpu, node);
+}
+
 uint64_t pmm_count_free_pages() {
     return pmm_node.CountFreePages();
 }
@@ -7,6 +7,7 @@
 
 #include <err.h>
 #include <inttypes.h>
+#include <pow2.h>
 #include <pretty/sizes.h>
 #include <string.h>
 #include <trace.h>
@@ -20,66 +21,93 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+size_t PmmArena::StorageSize(size_t page_count) {
+    size_t leaves = 1ul << log2_ulong_ceil(page_count);
+    return ROUNDUP_PAGE_SIZE(page_count * sizeof(vm_page) + 2 * leaves);
+}
+
 zx_status_t PmmArena::Init(const pmm_arena_info_t* info, PmmNode* node) {
     // TODO: validate that info is sane (page aligned, etc)
-    info_ = *info;
 
-    // allocate an array of pages to back this one
-    size_t page_count = size() / PAGE_SIZE;
-    size_t page_array_size = ROUNDUP_PAGE_SIZE(page_count * sizeof(vm_page));
+    // allocate an array of pages to back this one, followed by the free index
+    size_t page_count = info->size / PAGE_SIZE;
+    size_t page_array_size = StorageSize(page_count);
 
     // if the arena is too small to be useful, bail
-    if (page_array_size >= size()) {
-        printf("PMM: arena too small to be useful (size %zu)\n", size());
+    if (page_array_size >= info->size) {
+        printf("PMM: arena too small to be useful (size %zu)\n", info->size);
         return ZX_ERR_BUFFER_TOO_SMALL;
     }
 
     // allocate a chunk to back the page array out of the arena itself, near the top of memory
     reserve_range_t range;
-    auto status = boot_reserve_range_search(base(), size(), page_array_size, &range);
+    auto status = boot_reserve_range_search(info->base, info->size, page_array_size, &range);
     if (status != ZX_OK) {
         printf("PMM: arena intersects with reserved memory in unresovable way\n");
         return ZX_ERR_NO_MEMORY;
     }
 
-    DEBUG_ASSERT(range.pa >= base() && range.len <= page_array_size);
+    DEBUG_ASSERT(range.pa >= info->base && range.len <= page_array_size);
 
     // get the kernel pointer
     void* raw_page_array = paddr_to_physmap(range.pa);
-    LTRACEF("arena for base 0%#" PRIxPTR " size %#zx page array at %p size %#zx\n", base(), size(),
-            raw_page_array, page_array_size);
-
-    memset(raw_page_array, 0, page_array_size);
-
-    page_array_ = (vm_page_t*)raw_page_array;
+    LTRACEF("arena for base 0%#" PRIxPTR " size %#zx page array at %p size %#zx\n", info->base,
+            info->size, raw_page_array, page_array_size);
 
     // compute the range of the array that backs the array itself
-    size_t array_start_index = (PAGE_ALIGN(range.pa) - info_.base) / PAGE_SIZE;
+    size_t array_start_index = (PAGE_ALIGN(range.pa) - info->base) / PAGE_SIZE;
     size_t array_end_index = array_start_index + page_array_size / PAGE_SIZE;
     LTRACEF("array_start_index %zu, array_end_index %zu, page_count %zu\n",
             array_start_index, array_end_index, page_count);
 
     DEBUG_ASSERT(array_start_index < page_count && array_end_index <= page_count);
 
-    // add all pages that aren't part of the page array to the free list
-    // pages part of the free array go to the WIRED state
     list_node list;
     list_initialize(&list);
+    InitStorage(info, raw_page_array, array_start_index, array_end_index, &list);
+
+    node->AddFreePages(&list);
+
+    return ZX_OK;
+}
+
+void PmmArena::InitStorage(const pmm_arena_info_t* info, void* storage, size_t wired_start,
+                           size_t wired_end, list_node* free_list) {
+    info_ = *info;
+
+    size_t page_count = size() / PAGE_SIZE;
+    size_t leaves = 1ul << log2_ulong_ceil(page_count);
+
+    memset(storage, 0, StorageSize(page_count));
+
+    page_array_ = (vm_page_t*)storage;
+    free_index_ = (uint8_t*)storage + page_count * sizeof(vm_page);
+    free_index_leaves_ = leaves;
+
+    // add all pages that aren't part of the page array to the free list
+    // pages part of the free array go to the WIRED state
     for (size_t i = 0; i < page_count; i++) {
         auto& p = page_array_[i];
 
         p.paddr_priv = base() + i * PAGE_SIZE;
-        if (i >= array_start_index && i < array_end_index) {
+        if (i >= wired_start && i < wired_end) {
             p.state = VM_PAGE_STATE_WIRED;
         } else {
             p.state = VM_PAGE_STATE_FREE;
-            list_add_tail(&list, &p.queue_node);
+            list_add_tail(free_list, &p.queue_node);
+            free_index_[leaves + i] = 1;
         }
     }
 
-    node->AddFreePages(&list);
-
-    return ZX_OK;
+    // build the rest of the free index bottom up
+    for (size_t n = leaves - 1, order = 1; n > 0; n--) {
+        if (n < (leaves >> order)) {
+            order++;
+        }
+        uint8_t left = free_index_[2 * n];
+        uint8_t right = free_index_[2 * n + 1];
+        free_index_[n] = (left == order && right == order) ? (uint8_t)(order + 1) : MAX(left, right);
+    }
 }
 
 vm_page_t* PmmArena::FindSpecific(paddr_t pa) {
@@ -94,7 +122,62 @@ vm_page_t* PmmArena::FindSpecific(paddr_t pa) {
     return get_page(index);
 }
 
+void PmmArena::UpdateFreeIndex(const vm_page_t* page, bool free) {
+    DEBUG_ASSERT(page_belongs_to_arena(page));
+
+    size_t node = free_index_leaves_ + (page - page_array_);
+    free_index_[node] = free ? 1 : 0;
+
+    // walk towards the root, stopping as soon as an entry doesn't change
+    for (uint order = 1; node > 1; order++) {
+        node /= 2;
+        uint8_t left = free_index_[2 * node];
+        uint8_t right = free_index_[2 * node + 1];
+        uint8_t value = (left == order && right == order) ? (uint8_t)(order + 1) : MAX(left, right);
+        if (free_index_[node] == value) {
+            break;
+        }
+        free_index_[node] = value;
+    }
+}
+
+vm_page_t* PmmArena::FindFreeBlock(uint order) {
+    if (free_index_[1] < order + 1) {
+        return nullptr;
+    }
+
+    // descend, preferring the lower half, until we reach a node covering
+    // exactly 2^order pages
+    size_t node = 1;
+    for (size_t span = free_index_leaves_; span > (1ul << order); span /= 2) {
+        node = (free_index_[2 * node] >= order + 1) ? 2 * node : 2 * node + 1;
+    }
+    DEBUG_ASSERT(free_index_[node] == order + 1);
+
+    size_t index = (node << order) - free_index_leaves_;
+    DEBUG_ASSERT(index + (1ul << order) <= size() / PAGE_SIZE);
+
+    return &page_array_[index];
+}
+
 vm_page_t* PmmArena::FindFreeContiguous(size_t count, uint8_t alignment_log2) {
+    // Blocks in the free index are aligned to their size relative to the
+    // arena base, so they can be used whenever the base is at least as
+    // aligned as the block. Only a request for exactly one block, aligned
+    // to its size, can be turned down by the index alone: a shorter run
+    // may fit where no whole block is free, and a less aligned one may
+    // straddle two blocks. Anything else falls back to the linear scan
+    // below if the index comes up empty.
+    uint align_order = alignment_log2 - PAGE_SIZE_SHIFT;
+    uint order = MAX(log2_ulong_ceil(count), align_order);
+    if ((1ul << order) <= free_index_leaves_ &&
+        IS_ALIGNED(base(), 1ul << (order + PAGE_SIZE_SHIFT))) {
+        vm_page_t* p = FindFreeBlock(order);
+        if (p || (order == align_order && count == (1ul << order))) {
+            return p;
+        }
+    }
+
     // walk the list starting at alignment boundaries.
     // calculate the starting offset into this arena, based on the
     // base address of the arena to handle the case where the arena
@@ -24,6 +24,17 @@ public:
     // initialize the arena and allocate memory for internal data structures
     zx_status_t Init(const pmm_arena_info_t* info, PmmNode* node);
 
+    // Bytes of storage needed for the page array and free index of an arena
+    // of |page_count| pages.
+    static size_t StorageSize(size_t page_count);
+
+    // Lay out the page array and free index in |storage|, which must be
+    // StorageSize() bytes, with pages [wired_start, wired_end) wired and
+    // the rest put on |free_list|. Init() uses this once it has carved the
+    // storage out of the arena; unit tests use it on memory of their own.
+    void InitStorage(const pmm_arena_info_t* info, void* storage, size_t wired_start,
+                     size_t wired_end, list_node* free_list);
+
     // accessors
     const pmm_arena_info_t& info() const { return info_; }
     const char* name() const { return info_.name; }
@@ -42,6 +53,10 @@ public:
     // find a free run of contiguous pages
     vm_page_t* FindFreeContiguous(size_t count, uint8_t alignment_log2);
 
+    // Record that |page| has been added to (|free| true) or taken off a pmm
+    // free list. Must be called with the owning node's lock held.
+    void UpdateFreeIndex(const vm_page_t* page, bool free);
+
     // return a pointer to a specific page
     vm_page_t* FindSpecific(paddr_t pa);
 
@@ -57,6 +72,17 @@ public:
     void Dump(bool dump_pages, bool dump_free_ranges) const;
 
 private:
+    // find a fully free block of 2^|order| pages, aligned to its size
+    vm_page_t* FindFreeBlock(uint order);
+
     pmm_arena_info_t info_ = {};
     vm_page_t* page_array_ = nullptr;
+
+    // Buddy-style index over the arena's free pages, stored as an implicit
+    // binary tree with the root at index 1 and |free_index_leaves_| leaves,
+    // one per page (rounded up to a power of two). Each entry holds one plus
+    // the order of the largest fully free, naturally aligned block under it,
+    // or 0 if the subtree has no free pages.
+    uint8_t* free_index_ = nullptr;
+    size_t free_index_leaves_ = 0;
 };
@@ -5,8 +5,10 @@
 // https://opensource.org/licenses/MIT
 #include "pmm_node.h"
 
+#include <debug.h>
 #include <inttypes.h>
 #include <kernel/mp.h>
+#include <lib/counters.h>
 #include <trace.h>
 #include <vm/bootalloc.h>
 #include <vm/physmap.h>
@@ -16,6 +18,12 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(pmm_cache_refills, "kernel.pmm.cache.refills");
+KCOUNTER(pmm_cache_drains, "kernel.pmm.cache.drains");
+KCOUNTER(pmm_zeroed_hits, "kernel.pmm.zeroed.hits");
+KCOUNTER(pmm_zeroed_misses, "kernel.pmm.zeroed.misses");
+KCOUNTER(pmm_zeroed_background, "kernel.pmm.zeroed.background");
+
 namespace {
 
 void set_state_alloc(vm_page* page) {
@@ -26,9 +34,21 @@ void set_state_alloc(vm_page* page) {
     page->state = VM_PAGE_STATE_ALLOC;
 }
 
+void zero_page(vm_page* page) {
+    void* ptr = paddr_to_physmap(page->paddr());
+    DEBUG_ASSERT(ptr);
+    arch_zero_page(ptr);
+}
+
 } // namespace
 
 PmmNode::PmmNode() {
+    for (auto& list : free_list_) {
+        list_initialize(&list);
+    }
+    for (auto& list : zeroed_list_) {
+        list_initialize(&list);
+    }
 }
 
 PmmNode::~PmmNode() {
@@ -77,14 +97,18 @@ done_add:
     return ZX_OK;
 }
 
-// called at boot time as arenas are brought online, no locks are acquired
+// called at boot time as arenas are brought online, no locks are acquired.
+// The arena has already accounted for these pages in its free index.
 void PmmNode::AddFreePages(list_node* list) TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACEF("list %p\n", list);
 
     vm_page *temp, *page;
     list_for_every_entry_safe (list, page, temp, vm_page, queue_node) {
         list_delete(&page->queue_node);
-        list_add_tail(&free_list_, &page->queue_node);
+        page->numa_node = static_cast<uint8_t>(NumaNodeForPaddr(page->paddr()));
+        page->zeroed = 0;
+        list_add_tail(&free_list_[page->numa_node], &page->queue_node);
+        numa_free_count_[page->numa_node]++;
         free_count_++;
     }
 
@@ -92,24 +116,40 @@ void PmmNode::AddFreePages(list_node* list) TA_NO_THREAD_SAFETY_ANALYSIS {
 }
 
 zx_status_t PmmNode::AllocPage(uint alloc_flags, vm_page_t** page_out, paddr_t* pa_out) {
-    Guard<fbl::Mutex> guard{&lock_};
+    const bool zeroed = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
 
-    vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
+    vm_page* page = CacheAllocPage(zeroed);
     if (!page) {
-        return ZX_ERR_NO_MEMORY;
-    }
+        Guard<fbl::Mutex> guard{&lock_};
 
-    DEBUG_ASSERT(free_count_ > 0);
-    free_count_--;
+        const uint node = CurrentNumaNode();
+        page = RemoveFreePageLocked(node, false, zeroed);
+        if (!page) {
+            // the node is out of pages, but other cpus may still be sitting on some
+            DrainAllCachesLocked();
+            page = RemoveFreePageLocked(node, false, zeroed);
+            if (!page) {
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
 
-    DEBUG_ASSERT(page->is_free());
+        DEBUG_ASSERT(page->is_free());
+
+        set_state_alloc(page);
 
-    set_state_alloc(page);
+        // top up this cpu's cache so the next few allocations can skip the lock
+        const uint32_t low = cache_low_;
+        if (cache_high_ > 0 && low > 0) {
+            RefillCacheLocked(&caches_[arch_curr_cpu_num()], low, zeroed);
+        }
+    }
 
 #if PMM_ENABLE_FREE_FILL
     CheckFreeFill(page);
 #endif
 
+    FinishAllocPage(page, alloc_flags);
+
     if (pa_out) {
         *pa_out = page->paddr();
     }
@@ -133,32 +173,44 @@ zx_status_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list)
         return ZX_OK;
     }
 
-    Guard<fbl::Mutex> guard{&lock_};
+    const bool zeroed = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
+    list_node allocated = LIST_INITIAL_VALUE(allocated);
+    {
+        Guard<fbl::Mutex> guard{&lock_};
 
-    while (count > 0) {
-        vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
-        if (unlikely(!page)) {
-            // free pages that have already been allocated
-            FreeListLocked(list);
-            return ZX_ERR_NO_MEMORY;
+        if (free_count_ < count) {
+            DrainAllCachesLocked();
         }
 
-        LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page->paddr());
-
-        DEBUG_ASSERT(free_count_ > 0);
+        const uint node = CurrentNumaNode();
+        while (count > 0) {
+            vm_page* page = RemoveFreePageLocked(node, false, zeroed);
+            if (unlikely(!page)) {
+                // free pages that have already been allocated
+                FreeListLocked(&allocated);
+                return ZX_ERR_NO_MEMORY;
+            }
 
-        free_count_--;
+            LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page->paddr());
 
-        DEBUG_ASSERT(page->is_free());
+            DEBUG_ASSERT(page->is_free());
 #if PMM_ENABLE_FREE_FILL
-        CheckFreeFill(page);
+            CheckFreeFill(page);
 #endif
 
-        page->state = VM_PAGE_STATE_ALLOC;
-        list_add_tail(list, &page->queue_node);
+            page->state = VM_PAGE_STATE_ALLOC;
+            list_add_tail(&allocated, &page->queue_node);
+
+            count--;
+        }
+    }
 
-        count--;
+    // any zeroing is done without the lock
+    vm_page* page;
+    list_for_every_entry (&allocated, page, vm_page, queue_node) {
+        FinishAllocPage(page, alloc_flags);
     }
+    list_splice_after(&allocated, list->prev);
 
     return ZX_OK;
 }
@@ -178,6 +230,10 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
 
     Guard<fbl::Mutex> guard{&lock_};
 
+    // cached pages are not free as far as the arenas are concerned, so give
+    // them back to the node before looking for a specific range
+    DrainAllCachesLocked();
+
     // walk through the arenas, looking to see if the physical page belongs to it
     for (auto& a : arena_list_) {
         while (allocated < count && a.address_in_arena(address)) {
@@ -190,15 +246,15 @@ zx_status_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list)
                 break;
             }
 
-            list_delete(&page->queue_node);
+            RemoveFromFreeListLocked(page);
 
             page->state = VM_PAGE_STATE_ALLOC;
+            page->zeroed = 0;
 
             list_add_tail(list, &page->queue_node);
 
             allocated++;
             address += PAGE_SIZE;
-            free_count_--;
         }
 
         if (allocated == count) {
@@ -230,7 +286,48 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
     DEBUG_ASSERT(pa);
     DEBUG_ASSERT(list);
 
-    Guard<fbl::Mutex> guard{&lock_};
+    zx_status_t status;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+        status = AllocContiguousLocked(count, alignment_log2, pa, list);
+    }
+    if (status != ZX_OK) {
+        LTRACEF("couldn't find run\n");
+        return status;
+    }
+
+    FinishAllocRun(*pa, count, alloc_flags);
+    return ZX_OK;
+}
+
+void PmmNode::FinishAllocRun(paddr_t pa, size_t count, uint alloc_flags) {
+    vm_page* p = PaddrToPage(pa);
+    for (size_t i = 0; i < count; i++, p++) {
+        FinishAllocPage(p, alloc_flags);
+    }
+}
+
+void PmmNode::FinishAllocPage(vm_page* page, uint alloc_flags) {
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_ALLOC);
+
+    const bool zeroed = page->zeroed;
+    page->zeroed = 0;
+    if (!(alloc_flags & PMM_ALLOC_FLAG_ZEROED)) {
+        return;
+    }
+
+    if (zeroed) {
+        kcounter_add(pmm_zeroed_hits, 1);
+    } else {
+        kcounter_add(pmm_zeroed_misses, 1);
+        zero_page(page);
+    }
+}
+
+zx_status_t PmmNode::AllocContiguousLocked(size_t count, uint8_t alignment_log2,
+                                           paddr_t* pa, list_node* list) {
+    // as with AllocRange, cached pages would otherwise break up free runs
+    DrainAllCachesLocked();
 
     for (auto& a : arena_list_) {
         vm_page_t* p = a.FindFreeContiguous(count, alignment_log2);
@@ -245,13 +342,9 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
             DEBUG_ASSERT_MSG(p->is_free(), "p %p state %u\n", p, p->state);
             DEBUG_ASSERT(list_in_list(&p->queue_node));
 
-            list_delete(&p->queue_node);
+            RemoveFromFreeListLocked(p);
             p->state = VM_PAGE_STATE_ALLOC;
 
-            DEBUG_ASSERT(free_count_ > 0);
-
-            free_count_--;
-
 #if PMM_ENABLE_FREE_FILL
             CheckFreeFill(p);
 #endif
@@ -262,15 +355,18 @@ zx_status_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8
         return ZX_OK;
     }
 
-    LTRACEF("couldn't find run\n");
     return ZX_ERR_NOT_FOUND;
 }
 
-void PmmNode::FreePageLocked(vm_page* page) {
+// Detaches |page| from whatever queue it was on ahead of it being put on a
+// free list. The caller is responsible for the state transition, which must
+// happen under the lock of the list the page ends up on.
+void PmmNode::PrepareFreePage(vm_page* page) {
     LTRACEF("page %p state %u paddr %#" PRIxPTR "\n", page, page->state, page->paddr());
 
     DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
     DEBUG_ASSERT(!page->is_free());
+    DEBUG_ASSERT(page->state != VM_PAGE_STATE_CACHED);
 
 #if PMM_ENABLE_FREE_FILL
     FreeFill(page);
@@ -281,16 +377,25 @@ void PmmNode::FreePageLocked(vm_page* page) {
         list_delete(&page->queue_node);
     }
 
+    // the caller owns the page, so it is safe to update this here
+    page->zeroed = 0;
+}
+
+void PmmNode::FreePageLocked(vm_page* page) {
+    PrepareFreePage(page);
+
     // mark it free
     page->state = VM_PAGE_STATE_FREE;
 
     // add it to the free queue
-    list_add_head(&free_list_, &page->queue_node);
-
-    free_count_++;
+    AddToFreeListLocked(page, false);
 }
 
 void PmmNode::FreePage(vm_page* page) {
+    if (CacheFreePage(page)) {
+        return;
+    }
+
     Guard<fbl::Mutex> guard{&lock_};
 
     FreePageLocked(page);
@@ -312,9 +417,380 @@ void PmmNode::FreeList(list_node* list) {
     FreeListLocked(list);
 }
 
+void PmmNode::SetCacheWatermarks(uint32_t high, uint32_t low) {
+    if (low > high) {
+        low = high;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    // flush whatever the old settings left behind before switching over
+    cache_high_ = 0;
+    DrainAllCachesLocked();
+
+    cache_low_ = low;
+    cache_high_ = high;
+}
+
+// Grabs a page from the current cpu's cache, if there is one. Returns the page
+// already in the alloc state, or nullptr if the caller needs to go to the node.
+// Recently freed pages sit at the head of the cache and refills at the tail,
+// so a caller after a |zeroed| page looks at the tail first.
+vm_page* PmmNode::CacheAllocPage(bool zeroed) {
+    if (cache_high_ == 0) {
+        return nullptr;
+    }
+
+    // it doesn't matter if we migrate after sampling the cpu number, the
+    // cache's own lock keeps it consistent; we just lose a bit of locality
+    PageCache& cache = caches_[arch_curr_cpu_num()];
+
+    Guard<SpinLock, IrqSave> guard{&cache.lock};
+
+    vm_page* page = nullptr;
+    if (zeroed) {
+        vm_page* tail = list_peek_tail_type(&cache.page_list, vm_page, queue_node);
+        if (tail && tail->zeroed) {
+            list_delete(&tail->queue_node);
+            page = tail;
+        }
+    }
+    if (!page) {
+        page = list_remove_head_type(&cache.page_list, vm_page, queue_node);
+        if (!page) {
+            return nullptr;
+        }
+    }
+
+    DEBUG_ASSERT(page->state == VM_PAGE_STATE_CACHED);
+    DEBUG_ASSERT(cache.count > 0);
+    cache.count--;
+
+    // go straight to alloc; passing through free here would let AllocRange or
+    // AllocContiguous mistake the page for one on the node free list
+    page->state = VM_PAGE_STATE_ALLOC;
+
+    return page;
+}
+
+// Parks |page| in the current cpu's cache, draining the cache back to the low
+// watermark if that pushes it over the high one. Returns false if the caches
+// are disabled and the page should be freed to the node instead.
+bool PmmNode::CacheFreePage(vm_page* page) {
+    const uint32_t high = cache_high_;
+    if (high == 0) {
+        return false;
+    }
+
+    // the caches only ever hold pages local to their cpu
+    const cpu_num_t cpu = arch_curr_cpu_num();
+    if (page->numa_node != cpu_numa_node_[cpu]) {
+        return false;
+    }
+
+    PrepareFreePage(page);
+
+    PageCache& cache = caches_[cpu];
+
+    bool over_high;
+    {
+        Guard<SpinLock, IrqSave> guard{&cache.lock};
+
+        page->state = VM_PAGE_STATE_CACHED;
+        list_add_head(&cache.page_list, &page->queue_node);
+        cache.count++;
+
+        over_high = cache.count > high;
+    }
+
+    if (over_high) {
+        Guard<fbl::Mutex> guard{&lock_};
+        DrainCacheLocked(&cache, cache_low_);
+    }
+
+    return true;
+}
+
+// Moves pages local to the current cpu from the node free lists into |cache|
+// until it holds |target|, preferring zeroed ones if |zeroed| is set.
+void PmmNode::RefillCacheLocked(PageCache* cache, uint32_t target, bool zeroed) {
+    const uint node = CurrentNumaNode();
+
+    Guard<SpinLock, IrqSave> guard{&cache->lock};
+
+    if (cache->count >= target) {
+        return;
+    }
+
+    kcounter_add(pmm_cache_refills, 1);
+
+    while (cache->count < target) {
+        vm_page* page = RemoveFreePageLocked(node, true, zeroed);
+        if (!page) {
+            break;
+        }
+
+        DEBUG_ASSERT(page->is_free());
+
+        page->state = VM_PAGE_STATE_CACHED;
+        list_add_tail(&cache->page_list, &page->queue_node);
+        cache->count++;
+    }
+}
+
+// Returns pages from |cache| to the node free list until it holds |target|.
+// The coldest pages, at the tail of the cache, go back first.
+void PmmNode::DrainCacheLocked(PageCache* cache, uint32_t target) {
+    Guard<SpinLock, IrqSave> guard{&cache->lock};
+
+    if (cache->count <= target) {
+        return;
+    }
+
+    kcounter_add(pmm_cache_drains, 1);
+
+    while (cache->count > target) {
+        vm_page* page = list_remove_tail_type(&cache->page_list, vm_page, queue_node);
+        DEBUG_ASSERT(page);
+        DEBUG_ASSERT(page->state == VM_PAGE_STATE_CACHED);
+        cache->count--;
+
+        page->state = VM_PAGE_STATE_FREE;
+        AddToFreeListLocked(page, true);
+    }
+}
+
+void PmmNode::DrainAllCachesLocked() {
+    for (auto& cache : caches_) {
+        DrainCacheLocked(&cache, 0);
+    }
+}
+
+uint PmmNode::NumaNodeForPaddr(paddr_t pa) const {
+    // walk backwards so that later ranges override earlier ones
+    for (size_t i = numa_range_count_; i > 0; i--) {
+        const NumaRange& r = numa_ranges_[i - 1];
+        if (pa >= r.base && pa - r.base < r.size) {
+            return r.node;
+        }
+    }
+    return 0;
+}
+
+vm_page* PmmNode::RemoveFreePageLocked(uint node, bool local_only, bool zeroed) {
+    DEBUG_ASSERT(node < PMM_MAX_NUMA_NODES);
+
+    const uint count = local_only ? 1 : numa_node_count_;
+    for (uint i = 0; i < count; i++) {
+        uint n = (node + i) % numa_node_count_;
+        list_node* first = zeroed ? &zeroed_list_[n] : &free_list_[n];
+        list_node* second = zeroed ? &free_list_[n] : &zeroed_list_[n];
+        vm_page* page = list_peek_head_type(first, vm_page, queue_node);
+        if (!page) {
+            page = list_peek_head_type(second, vm_page, queue_node);
+        }
+        if (page) {
+            DEBUG_ASSERT(page->numa_node == n);
+            RemoveFromFreeListLocked(page);
+            return page;
+        }
+    }
+    return nullptr;
+}
+
+void PmmNode::RemoveFromFreeListLocked(vm_page* page) {
+    DEBUG_ASSERT(page->is_free());
+    DEBUG_ASSERT(list_in_list(&page->queue_node));
+    DEBUG_ASSERT(numa_free_count_[page->numa_node] > 0);
+    DEBUG_ASSERT(free_count_ > 0);
+
+    list_delete(&page->queue_node);
+    numa_free_count_[page->numa_node]--;
+    free_count_--;
+    if (page->zeroed) {
+        DEBUG_ASSERT(zeroed_count_ > 0);
+        zeroed_count_--;
+    }
+    ArenaForPageLocked(page)->UpdateFreeIndex(page, false);
+
+    MaybeWakeZeroerLocked();
+}
+
+void PmmNode::AddToFreeListLocked(vm_page* page, bool at_tail) {
+    DEBUG_ASSERT(page->is_free());
+    DEBUG_ASSERT(page->numa_node < PMM_MAX_NUMA_NODES);
+
+    list_node* list;
+    if (page->zeroed) {
+        list = &zeroed_list_[page->numa_node];
+        zeroed_count_++;
+    } else {
+        list = &free_list_[page->numa_node];
+    }
+    if (at_tail) {
+        list_add_tail(list, &page->queue_node);
+    } else {
+        list_add_head(list, &page->queue_node);
+    }
+    numa_free_count_[page->numa_node]++;
+    free_count_++;
+    ArenaForPageLocked(page)->UpdateFreeIndex(page, true);
+
+    if (!page->zeroed) {
+        MaybeWakeZeroerLocked();
+    }
+}
+
+// Kicks the zeroing thread once the pool has drained to half its target, as
+// long as there is something for it to zero.
+void PmmNode::MaybeWakeZeroerLocked() {
+    if (!zeroer_waiting_ || zeroed_count_ >= zeroed_target_ / 2 || zeroed_count_ == free_count_) {
+        return;
+    }
+    zeroer_waiting_ = false;
+    event_signal(&zeroer_event_, false);
+}
+
+void PmmNode::SetZeroedPoolTarget(uint64_t pages) {
+#if PMM_ENABLE_FREE_FILL
+    // zeroed pages would trip the free fill checks
+    pages = 0;
+#endif
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    zeroed_target_ = pages;
+    MaybeWakeZeroerLocked();
+}
+
+size_t PmmNode::ZeroFreePages(size_t max) {
+    list_node batch = LIST_INITIAL_VALUE(batch);
+    size_t count = 0;
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        // the coldest dirty pages, at the tails of the free lists, go first
+        for (uint n = 0; n < numa_node_count_ && count < max; n++) {
+            while (count < max && zeroed_count_ + zeroing_count_ < zeroed_target_) {
+                vm_page* page = list_peek_tail_type(&free_list_[n], vm_page, queue_node);
+                if (!page) {
+                    break;
+                }
+                RemoveFromFreeListLocked(page);
+                set_state_alloc(page);
+                list_add_tail(&batch, &page->queue_node);
+                zeroing_count_++;
+                count++;
+            }
+        }
+
+        if (count == 0) {
+            zeroer_waiting_ = true;
+            return 0;
+        }
+    }
+
+    vm_page* page;
+    list_for_every_entry (&batch, page, vm_page, queue_node) {
+        zero_page(page);
+    }
+
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        while (!list_is_empty(&batch)) {
+            page = list_remove_head_type(&batch, vm_page, queue_node);
+            page->state = VM_PAGE_STATE_FREE;
+            page->zeroed = 1;
+            AddToFreeListLocked(page, true);
+            zeroing_count_--;
+        }
+    }
+
+    kcounter_add(pmm_zeroed_background, count);
+
+    return count;
+}
+
+void PmmNode::WaitForZeroingWork() {
+    event_wait(&zeroer_event_);
+}
+
+PmmArena* PmmNode::ArenaForPageLocked(const vm_page* page) {
+    for (auto& a : arena_list_) {
+        if (a.page_belongs_to_arena(page)) {
+            return &a;
+        }
+    }
+    panic("page %p (pa %#" PRIxPTR ") is not in any arena\n", page, page->paddr());
+}
+
+zx_status_t PmmNode::SetNumaRange(paddr_t base, size_t size, uint node) {
+    LTRACEF("base %#" PRIxPTR " size %#zx node %u\n", base, size, node);
+
+    if (node >= PMM_MAX_NUMA_NODES || size == 0 || base + size < base) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    if (numa_range_count_ == PMM_MAX_NUMA_RANGES) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    numa_ranges_[numa_range_count_] = {base, size, node};
+    numa_range_count_++;
+    numa_node_count_ = MAX(numa_node_count_, node + 1);
+
+    // cached pages may now sit in a cache of the wrong node
+    DrainAllCachesLocked();
+
+    // retag every page in the range, moving the free ones over to their node's
+    // free list; allocated pages land there when they are freed
+    for (auto& a : arena_list_) {
+        paddr_t start = MAX(base, a.base());
+        paddr_t end = MIN(base + size, a.base() + a.size());
+        for (paddr_t pa = ROUNDUP(start, PAGE_SIZE); pa < end; pa += PAGE_SIZE) {
+            vm_page* page = a.FindSpecific(pa);
+            if (page->numa_node == node) {
+                continue;
+            }
+            if (page->is_free()) {
+                RemoveFromFreeListLocked(page);
+                page->numa_node = static_cast<uint8_t>(node);
+                AddToFreeListLocked(page, true);
+            } else {
+                page->numa_node = static_cast<uint8_t>(node);
+            }
+        }
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t PmmNode::SetCpuNumaNode(cpu_num_t cpu, uint node) {
+    if (cpu >= SMP_MAX_CPUS || node >= PMM_MAX_NUMA_NODES) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    cpu_numa_node_[cpu] = static_cast<uint8_t>(node);
+    numa_node_count_ = MAX(numa_node_count_, node + 1);
+
+    // the cpu's cache may hold pages from its old node
+    DrainCacheLocked(&caches_[cpu], 0);
+
+    return ZX_OK;
+}
+
 // okay if accessed outside of a lock
 uint64_t PmmNode::CountFreePages() const TA_NO_THREAD_SAFETY_ANALYSIS {
-    return free_count_;
+    uint64_t count = free_count_ + zeroing_count_;
+    for (const auto& cache : caches_) {
+        count += cache.count;
+    }
+    return count;
 }
 
 uint64_t PmmNode::CountTotalBytes() const TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -338,8 +814,18 @@ void PmmNode::DumpFree() const TA_NO_THREAD_SAFETY_ANALYSIS {
 void PmmNode::Dump(bool is_panic) const {
     // No lock analysis here, as we want to just go for it in the panic case without the lock.
     auto dump = [this]() TA_NO_THREAD_SAFETY_ANALYSIS {
-        printf("pmm node %p: free_count %zu (%zu bytes), total size %zu\n",
-               this, free_count_, free_count_ * PAGE_SIZE, arena_cumulative_size_);
+        uint64_t cached_count = 0;
+        for (const auto& cache : caches_) {
+            cached_count += cache.count;
+        }
+        printf("pmm node %p: free_count %zu (%zu bytes), cached %zu, zeroed %zu, total size %zu\n",
+               this, free_count_, free_count_ * PAGE_SIZE, cached_count, zeroed_count_,
+               arena_cumulative_size_);
+        if (numa_node_count_ > 1) {
+            for (uint i = 0; i < numa_node_count_; i++) {
+                printf("\tnuma node %u: free_count %zu\n", i, numa_free_count_[i]);
+            }
+        }
         for (auto& a : arena_list_) {
             a.Dump(false, false);
         }
@@ -357,9 +843,11 @@ void PmmNode::Dump(bool is_panic) const {
 void PmmNode::EnforceFill() {
     DEBUG_ASSERT(!enforce_fill_);
 
-    vm_page* page;
-    list_for_every_entry (&free_list_, page, vm_page, queue_node) {
-        FreeFill(page);
+    for (auto& list : free_list_) {
+        vm_page* page;
+        list_for_every_entry (&list, page, vm_page, queue_node) {
+            FreeFill(page);
+        }
     }
 
     enforce_fill_ = true;
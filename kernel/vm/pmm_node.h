@@ -9,7 +9,10 @@
 #include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 
+#include <arch/ops.h>
+#include <kernel/event.h>
 #include <kernel/lockdep.h>
+#include <kernel/spinlock.h>
 #include <vm/pmm.h>
 
 #include "pmm_arena.h"
@@ -17,6 +20,15 @@
 #define PMM_ENABLE_FREE_FILL 0
 #define PMM_FREE_FILL_BYTE 0x42
 
+// default per-cpu page cache watermarks, in pages
+#define PMM_CACHE_DEFAULT_HIGH_WATERMARK 64
+#define PMM_CACHE_DEFAULT_LOW_WATERMARK 16
+
+// default number of free pages to keep zeroed, see SetZeroedPoolTarget()
+#define PMM_ZEROED_POOL_DEFAULT_PAGES 2048
+
+static_assert(PMM_MAX_NUMA_NODES - 1 <= UINT8_MAX, "vm_page::numa_node is a uint8_t");
+
 // per numa node collection of pmm arenas and worker threads
 class PmmNode {
 public:
@@ -40,6 +52,26 @@ public:
     uint64_t CountTotalBytes() const;
     void CountTotalStates(uint64_t state_count[VM_PAGE_STATE_COUNT_]) const;
 
+    // Configure the per-cpu page caches. A cpu's cache is drained back down to
+    // |low| pages once it holds more than |high|, and refilled with |low| pages
+    // when it runs dry. A |high| of zero disables the caches.
+    void SetCacheWatermarks(uint32_t high, uint32_t low);
+
+    // NUMA affinity, as reported by the platform. See pmm_set_numa_range()
+    // and pmm_set_cpu_numa_node().
+    zx_status_t SetNumaRange(paddr_t base, size_t size, uint node);
+    zx_status_t SetCpuNumaNode(cpu_num_t cpu, uint node);
+
+    // Background zeroing. Free pages are kept on two sets of lists, those
+    // known to be zero and the rest; ZeroFreePages() moves up to |max| pages
+    // from the latter to the former as long as fewer than the target are
+    // zeroed, and returns how many it moved. Once it runs out of work,
+    // WaitForZeroingWork() blocks until the pool drops to half the target
+    // while there are pages to zero.
+    void SetZeroedPoolTarget(uint64_t pages);
+    size_t ZeroFreePages(size_t max);
+    void WaitForZeroingWork();
+
     // printf free and overall state of the internal arenas
     // NOTE: both functions skip mutexes and can be called inside timer or crash context
     // though the data they return may be questionable
@@ -56,25 +88,93 @@ public:
     void AddFreePages(list_node* list);
 
 private:
+    // Per-cpu magazine of free pages, so that single page allocations and
+    // frees usually avoid lock_. Pages in a cache are in VM_PAGE_STATE_CACHED,
+    // which keeps AllocRange and AllocContiguous from pulling them out from
+    // under the cache. Pages only move between a cache and free_list_ with
+    // lock_ held, and lock_ is always acquired before a cache lock.
+    struct PageCache {
+        DECLARE_SPINLOCK(PageCache) lock;
+        list_node page_list TA_GUARDED(lock) = LIST_INITIAL_VALUE(page_list);
+        uint64_t count TA_GUARDED(lock) = 0;
+    };
+
+    struct NumaRange {
+        paddr_t base;
+        size_t size;
+        uint node;
+    };
+
+    uint NumaNodeForPaddr(paddr_t pa) const TA_NO_THREAD_SAFETY_ANALYSIS;
+    uint CurrentNumaNode() const { return cpu_numa_node_[arch_curr_cpu_num()]; }
+
+    // Take a free page, preferring |node|. If |local_only| is false, the other
+    // nodes are tried in order once |node| runs dry. Within a node, zeroed
+    // pages are taken first if |zeroed| is set and last otherwise.
+    vm_page* RemoveFreePageLocked(uint node, bool local_only, bool zeroed) TA_REQ(lock_);
+    void RemoveFromFreeListLocked(vm_page* page) TA_REQ(lock_);
+    PmmArena* ArenaForPageLocked(const vm_page* page) TA_REQ(lock_);
+
+    zx_status_t AllocContiguousLocked(size_t count, uint8_t alignment_log2,
+                                      paddr_t* pa, list_node* list) TA_REQ(lock_);
+    void AddToFreeListLocked(vm_page* page, bool at_tail) TA_REQ(lock_);
+    void MaybeWakeZeroerLocked() TA_REQ(lock_);
+
+    // Called on a page that has just left the pmm, without lock_ held. Zeros
+    // it if the allocation asked for it and it isn't already.
+    static void FinishAllocPage(vm_page* page, uint alloc_flags);
+    void FinishAllocRun(paddr_t pa, size_t count, uint alloc_flags);
+
+    void PrepareFreePage(vm_page* page);
     void FreePageLocked(vm_page* page) TA_REQ(lock_);
     void FreeListLocked(list_node* list) TA_REQ(lock_);
 
+    vm_page* CacheAllocPage(bool zeroed);
+    bool CacheFreePage(vm_page* page);
+    void RefillCacheLocked(PageCache* cache, uint32_t target, bool zeroed) TA_REQ(lock_);
+    void DrainCacheLocked(PageCache* cache, uint32_t target) TA_REQ(lock_);
+    void DrainAllCachesLocked() TA_REQ(lock_);
+
     fbl::Canary<fbl::magic("PNOD")> canary_;
 
     mutable DECLARE_MUTEX(PmmNode) lock_;
 
     uint64_t arena_cumulative_size_ TA_GUARDED(lock_) = 0;
     uint64_t free_count_ TA_GUARDED(lock_) = 0;
+    uint64_t numa_free_count_[PMM_MAX_NUMA_NODES] TA_GUARDED(lock_) = {};
 
     fbl::DoublyLinkedList<PmmArena*> arena_list_ TA_GUARDED(lock_);
 
-    // page queues
-    list_node free_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(free_list_);
+    // page queues; free pages are kept on the list of the NUMA node they are
+    // local to
+    list_node free_list_[PMM_MAX_NUMA_NODES] TA_GUARDED(lock_);
+    // free pages known to be zero, also counted in free_count_ and
+    // numa_free_count_
+    list_node zeroed_list_[PMM_MAX_NUMA_NODES] TA_GUARDED(lock_);
+    uint64_t zeroed_count_ TA_GUARDED(lock_) = 0;
     list_node inactive_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(inactive_list_);
     list_node active_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(active_list_);
     list_node modified_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(modified_list_);
     list_node wired_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(wired_list_);
 
+    // Written once at init time, read without locks.
+    uint32_t cache_high_ = 0;
+    uint32_t cache_low_ = 0;
+    PageCache caches_[SMP_MAX_CPUS];
+
+    // NUMA topology. Ranges are only appended, under lock_, and are read
+    // without it; later ranges take precedence over earlier ones.
+    NumaRange numa_ranges_[PMM_MAX_NUMA_RANGES] = {};
+    size_t numa_range_count_ TA_GUARDED(lock_) = 0;
+    uint numa_node_count_ TA_GUARDED(lock_) = 1;
+    uint8_t cpu_numa_node_[SMP_MAX_CPUS] = {};
+
+    uint64_t zeroed_target_ TA_GUARDED(lock_) = 0;
+    // pages taken off the free lists by ZeroFreePages(), still counted as free
+    uint64_t zeroing_count_ TA_GUARDED(lock_) = 0;
+    bool zeroer_waiting_ TA_GUARDED(lock_) = false;
+    event_t zeroer_event_ = EVENT_INITIAL_VALUE(zeroer_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
@@ -10,6 +10,7 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULE := $(LOCAL_DIR)
 
 MODULE_DEPS += \
+    kernel/lib/counters \
     kernel/lib/fbl \
     kernel/lib/pretty \
     kernel/lib/user_copy \
@@ -18,8 +19,10 @@ MODULE_DEPS += \
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootalloc.cpp \
     $(LOCAL_DIR)/bootreserve.cpp \
+    $(LOCAL_DIR)/evictor.cpp \
     $(LOCAL_DIR)/kstack.cpp \
     $(LOCAL_DIR)/page.cpp \
+    $(LOCAL_DIR)/page_source.cpp \
     $(LOCAL_DIR)/pinned_vm_object.cpp \
     $(LOCAL_DIR)/pmm.cpp \
     $(LOCAL_DIR)/pmm_arena.cpp \
@@ -35,5 +38,6 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/vm_page_list.cpp \
     $(LOCAL_DIR)/vm_unittest.cpp \
     $(LOCAL_DIR)/vmm.cpp \
+    $(LOCAL_DIR)/zero_scanner.cpp \
 
 include make/module.mk
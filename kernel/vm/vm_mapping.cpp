@@ -9,11 +9,16 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lib/counters.h>
+#include <lk/init.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
 #include <vm/vm_object.h>
@@ -21,6 +26,36 @@
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+#define VM_FAULT_AROUND_DEFAULT_PAGES 16
+// One 2MB window, so that a guest touching memory its VMM has already filled,
+// such as its kernel and ramdisk, takes one exit per window rather than one
+// per page.
+#define VM_GUEST_FAULT_AROUND_DEFAULT_PAGES 512
+
+KCOUNTER(vm_large_page_maps, "kernel.vm.large_page.maps");
+KCOUNTER(vm_fault_around_pages, "kernel.vm.fault_around.pages");
+
+namespace {
+
+// Leaf sizes, largest first, that mappings try to install in place of runs of
+// single pages. The arch layer falls back to smaller leaves if it can't use one.
+constexpr size_t kLargePageSizes[] = {1UL << 30, 1UL << 21};
+
+// Size, in pages, of the aligned window around a faulting page whose resident
+// neighbours are mapped along with it. 0 or 1 disables fault-around.
+uint32_t fault_around_pages = VM_FAULT_AROUND_DEFAULT_PAGES;
+// The same for faults on guest physical memory.
+uint32_t guest_fault_around_pages = VM_GUEST_FAULT_AROUND_DEFAULT_PAGES;
+
+} // namespace
+
+static void vm_fault_around_init(uint level) {
+    fault_around_pages = cmdline_get_uint32("kernel.vm.fault-around", VM_FAULT_AROUND_DEFAULT_PAGES);
+    guest_fault_around_pages = cmdline_get_uint32("kernel.vm.guest-fault-around",
+                                                  VM_GUEST_FAULT_AROUND_DEFAULT_PAGES);
+}
+LK_INIT_HOOK(vm_fault_around, &vm_fault_around_init, LK_INIT_LEVEL_VM);
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -463,6 +498,52 @@ zx_status_t VmMappingCoalescer::Flush() {
 
 } // namespace
 
+bool VmMapping::LargePageWindowLocked(vaddr_t va, size_t size, paddr_t* pa)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(object_->lock()->lock().IsHeld());
+    DEBUG_ASSERT(IS_ALIGNED(va, size));
+
+    if (va < base_ || size > size_ || va - base_ > size_ - size) {
+        return false;
+    }
+
+    uint64_t vmo_offset = va - base_ + object_offset_;
+    paddr_t run_pa;
+    if (object_->GetContiguousRunLocked(vmo_offset, size, &run_pa) != ZX_OK) {
+        return false;
+    }
+    if (!IS_ALIGNED(run_pa, size)) {
+        return false;
+    }
+
+    *pa = run_pa;
+    return true;
+}
+
+zx_status_t VmMapping::MapLargePageLocked(vaddr_t va, size_t size, paddr_t pa) {
+    DEBUG_ASSERT(object_->lock()->lock().IsHeld());
+
+    // Anything already mapped in the window maps the same physical pages, so it
+    // can be dropped and replaced by the single leaf without losing state.
+    const size_t count = size / PAGE_SIZE;
+    zx_status_t status = aspace_->arch_aspace().Unmap(va, count, nullptr);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    size_t mapped;
+    status = aspace_->arch_aspace().MapContiguous(va, pa, count, arch_mmu_flags_, &mapped);
+    if (status != ZX_OK) {
+        TRACEF("error %d mapping large page at va %#" PRIxPTR "\n", status, va);
+        return status;
+    }
+    DEBUG_ASSERT(mapped == count);
+
+    LTRACEF("mapped %#zx bytes at va %#" PRIxPTR " pa %#" PRIxPTR "\n", size, va, pa);
+    kcounter_add(vm_large_page_maps, 1);
+    return ZX_OK;
+}
+
 zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
     canary_.Assert();
 
@@ -507,11 +588,40 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
 
         zx_status_t status;
         paddr_t pa;
+
+        // map whole aligned, resident and contiguous windows with a single leaf
+        if (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_RWX_MASK) {
+            size_t large_size = 0;
+            for (size_t size : kLargePageSizes) {
+                if (IS_ALIGNED(base_ + o, size) && offset + len - o >= size &&
+                    LargePageWindowLocked(base_ + o, size, &pa)) {
+                    large_size = size;
+                    break;
+                }
+            }
+            if (large_size != 0) {
+                status = coalescer.Flush();
+                if (status != ZX_OK) {
+                    return status;
+                }
+                status = MapLargePageLocked(base_ + o, large_size, pa);
+                if (status != ZX_OK) {
+                    return status;
+                }
+                o += large_size - PAGE_SIZE;
+                continue;
+            }
+        }
+
         status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
         if (status != ZX_OK) {
             // no page to map
             if (commit) {
-                // fail when we can't commit every requested page
+                // fail when we can't commit every requested page; with the aspace
+                // lock held there's no waiting for a page source
+                if (status == ZX_ERR_SHOULD_WAIT) {
+                    PageSource::CancelRequest();
+                }
                 coalescer.Abort();
                 return status;
             }
@@ -656,6 +766,23 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         return status;
     }
 
+    // if the page sits in a resident, contiguous and suitably aligned window of the
+    // object, map the whole window with one large leaf. Only pages the object owns
+    // qualify, so mapping them with the region's full permissions is safe.
+    for (size_t size : kLargePageSizes) {
+        vaddr_t large_va = ROUNDDOWN(va, size);
+        paddr_t large_pa;
+        if (LargePageWindowLocked(large_va, size, &large_pa) &&
+            MapLargePageLocked(large_va, size, large_pa) == ZX_OK) {
+#if ARCH_ARM64
+            if (!(pf_flags & VMM_PF_FLAG_GUEST) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+                arch_sync_cache_range(large_va, size);
+            }
+#endif
+            return ZX_OK;
+        }
+    }
+
     // if we read faulted, make sure we map or modify the page without any write permissions
     // this ensures we will fault again if a write is attempted so we can potentially
     // replace this page with a copy or a new one
@@ -731,6 +858,8 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
             return ZX_ERR_NO_MEMORY;
         }
         DEBUG_ASSERT(mapped == 1);
+
+        FaultAroundLocked(va, pf_flags);
     }
 
 // TODO: figure out what to do with this
@@ -744,6 +873,78 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     return ZX_OK;
 }
 
+void VmMapping::FaultAroundLocked(vaddr_t va, uint pf_flags) TA_NO_THREAD_SAFETY_ANALYSIS {
+    DEBUG_ASSERT(object_->lock()->lock().IsHeld());
+
+    const uint32_t window_pages = (pf_flags & VMM_PF_FLAG_GUEST) ? guest_fault_around_pages
+                                                                 : fault_around_pages;
+    if (window_pages <= 1) {
+        return;
+    }
+
+    // clip the window that contains the faulting page to the mapping
+    const size_t window_size = (size_t)window_pages * PAGE_SIZE;
+    vaddr_t start = va - ((va / PAGE_SIZE) % window_pages) * PAGE_SIZE;
+    vaddr_t end = (start > UINTPTR_MAX - window_size) ? UINTPTR_MAX : start + window_size - 1;
+    start = fbl::max(start, base_);
+    end = fbl::min(end, base_ + size_ - 1);
+
+    struct FaultAroundContext {
+        VmMapping* mapping;
+        VmMappingCoalescer* coalescer;
+        vaddr_t start;
+        vaddr_t fault_va;
+        size_t mapped;
+        zx_status_t status;
+    };
+
+    VmMappingCoalescer coalescer(this, start);
+    FaultAroundContext context = {this, &coalescer, start, va, 0, ZX_OK};
+
+    // Only pages the object already has resident are mapped; nothing is faulted in.
+    // Neighbours that something else mapped in the meantime are left alone.
+    auto lookup_fn = [](void* ctx, size_t offset, size_t index, paddr_t pa) {
+        auto context = static_cast<FaultAroundContext*>(ctx);
+        vaddr_t page_va = context->start + index * PAGE_SIZE;
+        if (page_va == context->fault_va) {
+            return ZX_OK;
+        }
+        if (context->mapping->aspace()->arch_aspace().Query(page_va, nullptr, nullptr) == ZX_OK) {
+            return ZX_OK;
+        }
+        context->status = context->coalescer->Append(page_va, pa);
+        if (context->status != ZX_OK) {
+            return context->status;
+        }
+        context->mapped++;
+        return ZX_OK;
+    };
+
+    uint64_t vmo_offset = start - base_ + object_offset_;
+    zx_status_t status = object_->LookupResidentLocked(vmo_offset, end - start + 1,
+                                                       lookup_fn, &context);
+    if (context.status != ZX_OK) {
+        // the coalescer already gave up; the faulting page is mapped regardless
+        return;
+    }
+    if (status != ZX_OK) {
+        coalescer.Abort();
+        return;
+    }
+    if (coalescer.Flush() != ZX_OK) {
+        return;
+    }
+
+    LTRACEF_LEVEL(2, "faulted around va %#" PRIxPTR ", mapped %zu pages\n", va, context.mapped);
+    kcounter_add(vm_fault_around_pages, context.mapped);
+
+#if ARCH_ARM64
+    if (!(pf_flags & VMM_PF_FLAG_GUEST) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+        arch_sync_cache_range(start, end - start + 1);
+    }
+#endif
+}
+
 // We disable thread safety analysis here because one of the common uses of this
 // function is for splitting one mapping object into several that will be backed
 // by the same VmObject.  In that case, object_->lock() gets aliased across all
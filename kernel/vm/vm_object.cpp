@@ -55,8 +55,10 @@ VmObject::~VmObject() {
         if (need_lock) {
             Guard<fbl::Mutex> guard{&lock_};
             parent_->RemoveChildLocked(this);
+            parent_->CollapseLocked();
         } else {
             parent_->RemoveChildLocked(this);
+            parent_->CollapseLocked();
         }
     }
 
@@ -115,6 +117,32 @@ bool VmObject::is_cow_clone() const {
     return parent_ != nullptr;
 }
 
+void VmObject::RangeOpBatch(VmRangeOp* ops, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        VmRangeOp& op = ops[i];
+        switch (op.type) {
+        case VmRangeOp::Type::Commit:
+            op.status = CommitRange(op.offset, op.len, nullptr);
+            break;
+        case VmRangeOp::Type::Decommit:
+            op.status = DecommitRange(op.offset, op.len, nullptr);
+            break;
+        case VmRangeOp::Type::CacheSync:
+            op.status = SyncCache(op.offset, op.len);
+            break;
+        case VmRangeOp::Type::CacheInvalidate:
+            op.status = InvalidateCache(op.offset, op.len);
+            break;
+        case VmRangeOp::Type::CacheClean:
+            op.status = CleanCache(op.offset, op.len);
+            break;
+        case VmRangeOp::Type::CacheCleanInvalidate:
+            op.status = CleanInvalidateCache(op.offset, op.len);
+            break;
+        }
+    }
+}
+
 void VmObject::AddMappingLocked(VmMapping* r) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.lock().IsHeld());
@@ -128,6 +156,11 @@ void VmObject::RemoveMappingLocked(VmMapping* r) {
     mapping_list_.erase(*r);
     DEBUG_ASSERT(mapping_list_len_ > 0);
     mapping_list_len_--;
+
+    // the mapping still holds its reference, so this can't destroy us
+    if (mapping_list_len_ == 0) {
+        CollapseLocked();
+    }
 }
 
 uint32_t VmObject::num_mappings() const {
@@ -196,6 +229,48 @@ uint32_t VmObject::share_count() const {
 void VmObject::SetChildObserver(VmObjectChildObserver* child_observer) {
     Guard<fbl::Mutex> guard{&lock_};
     child_observer_ = child_observer;
+
+    // the dispatcher going away may orphan us; it still holds its reference
+    if (child_observer_ == nullptr) {
+        CollapseLocked();
+    }
+}
+
+void VmObject::NotifyDiscardedLocked(bool discarded) {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+    if (child_observer_ == nullptr) {
+        return;
+    }
+
+    if (discarded) {
+        child_observer_->OnPagesDiscarded();
+    } else {
+        child_observer_->OnDiscardAcknowledged();
+    }
+}
+
+bool VmObject::IsOrphanedLocked() const {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+    // only objects that were handed to user mode can lose their last handle;
+    // kernel owned objects never have a user id
+    return user_id_ != 0 && child_observer_ == nullptr && mapping_list_len_ == 0;
+}
+
+size_t VmObject::TakeRefsAfter(VmObject* cursor, fbl::RefPtr<VmObject>* out, size_t count) {
+    Guard<fbl::Mutex> guard{AllVmosLock::Get()};
+
+    // the caller's reference keeps |cursor| on the list
+    auto iter = cursor ? ++all_vmos_.make_iterator(*cursor) : all_vmos_.begin();
+
+    size_t taken = 0;
+    for (; iter != all_vmos_.end() && taken < count; ++iter) {
+        // objects already on their way out are skipped
+        auto ref = fbl::MakeRefPtrUpgradeFromRaw(&*iter, AllVmosLock::Get());
+        if (ref) {
+            out[taken++] = fbl::move(ref);
+        }
+    }
+    return taken;
 }
 
 void VmObject::AddChildLocked(VmObject* o) {
@@ -11,10 +11,12 @@
 #include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <inttypes.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
@@ -28,21 +30,31 @@
 
 namespace {
 
-void ZeroPage(paddr_t pa) {
-    void* ptr = paddr_to_physmap(pa);
-    DEBUG_ASSERT(ptr);
+KCOUNTER(vm_cow_collapses, "kernel.vm.cow.collapses");
+KCOUNTER(vm_cow_pages_migrated, "kernel.vm.cow.pages_migrated");
+KCOUNTER(vm_zero_pages_reclaimed, "kernel.vm.zero_scan.pages_reclaimed");
+KCOUNTER(vm_pages_evicted, "kernel.vm.evict.pages");
+KCOUNTER(vm_snapshot_pages_preserved, "kernel.vm.snapshot.pages_preserved");
 
-    arch_zero_page(ptr);
-}
+// how much of an object the scanners look at per trip through its lock
+constexpr uint64_t kScanChunk = 64 * PAGE_SIZE;
+
+bool IsZeroPage(vm_page_t* p) {
+    auto words = reinterpret_cast<const uint64_t*>(paddr_to_physmap(p->paddr()));
+    DEBUG_ASSERT(words);
 
-void ZeroPage(vm_page_t* p) {
-    paddr_t pa = p->paddr();
-    ZeroPage(pa);
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (words[i] != 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
+    p->flags = VM_PAGE_FLAG_ACTIVE;
     p->object.pin_count = 0;
 }
 
@@ -72,6 +84,11 @@ VmObjectPaged::VmObjectPaged(
     LTRACEF("%p\n", this);
 
     DEBUG_ASSERT(IS_PAGE_ALIGNED(size_));
+
+    // discardable objects start out locked so they can be filled safely
+    if (options_ & kDiscardable) {
+        discardable_locks_ = 1;
+    }
 }
 
 VmObjectPaged::~VmObjectPaged() {
@@ -90,6 +107,11 @@ VmObjectPaged::~VmObjectPaged() {
 
     // free all of the pages attached to us
     page_list_.FreeAllPages();
+
+    // clones share the source of the root, which is the one that goes last
+    if (page_source_ && !parent_) {
+        page_source_->Close();
+    }
 }
 
 zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags,
@@ -145,7 +167,8 @@ zx_status_t VmObjectPaged::CreateContiguous(uint32_t pmm_alloc_flags, uint64_t s
 
     size_t num_pages = size / PAGE_SIZE;
     paddr_t pa;
-    status = pmm_alloc_contiguous(num_pages, pmm_alloc_flags, alignment_log2, &pa, &page_list);
+    status = pmm_alloc_contiguous(num_pages, pmm_alloc_flags | PMM_ALLOC_FLAG_ZEROED,
+                                  alignment_log2, &pa, &page_list);
     if (status != ZX_OK) {
         LTRACEF("failed to allocate enough pages (asked for %zu)\n", num_pages);
         return ZX_ERR_NO_MEMORY;
@@ -162,9 +185,6 @@ zx_status_t VmObjectPaged::CreateContiguous(uint32_t pmm_alloc_flags, uint64_t s
 
         InitializeVmPage(p);
 
-        // TODO: remove once pmm returns zeroed pages
-        ZeroPage(p);
-
         // We don't need thread-safety analysis here, since this VMO has not
         // been shared anywhere yet.
         [&]() TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -215,7 +235,8 @@ zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::
 
             if (page->state == VM_PAGE_STATE_WIRED) {
                 // it's wired to the kernel, so we can just use it directly
-            } else if (page->state == VM_PAGE_STATE_FREE) {
+            } else if (page->state == VM_PAGE_STATE_FREE ||
+                       page->state == VM_PAGE_STATE_CACHED) {
                 list_node list = LIST_INITIAL_VALUE(list);
                 ASSERT(pmm_alloc_range(pa, 1, &list) == ZX_OK);
                 page->state = VM_PAGE_STATE_WIRED;
@@ -235,20 +256,57 @@ zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::CreateWithSource(uint32_t pmm_alloc_flags, uint64_t size,
+                                            fbl::RefPtr<PageSource> src,
+                                            fbl::RefPtr<VmObject>* obj) {
+    DEBUG_ASSERT(src);
+
+    zx_status_t status = RoundSize(size, &size);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(
+        new (&ac) VmObjectPaged(0, pmm_alloc_flags, size, nullptr));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    vmo->page_source_ = fbl::move(src);
+
+    *obj = fbl::move(vmo);
+
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPaged::CloneCOW(bool resizable, uint64_t offset, uint64_t size,
                                     bool copy_name, fbl::RefPtr<VmObject>* clone_vmo) {
-    LTRACEF("vmo %p offset %#" PRIx64 " size %#" PRIx64 "\n", this, offset, size);
+    return CreateClone(resizable ? kResizable : 0u, offset, size, copy_name, clone_vmo);
+}
+
+zx_status_t VmObjectPaged::CloneSnapshot(uint64_t offset, uint64_t size, bool copy_name,
+                                         fbl::RefPtr<VmObject>* clone_vmo) {
+    return CreateClone(kSnapshot, offset, size, copy_name, clone_vmo);
+}
+
+zx_status_t VmObjectPaged::CreateClone(uint32_t options, uint64_t offset, uint64_t size,
+                                       bool copy_name, fbl::RefPtr<VmObject>* clone_vmo) {
+    LTRACEF("vmo %p options %#x offset %#" PRIx64 " size %#" PRIx64 "\n", this, options, offset,
+            size);
 
     canary_.Assert();
 
+    // a clone would see its parent's pages vanish underneath it
+    if (is_discardable()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // make sure size is page aligned
     zx_status_t status = RoundSize(size, &size);
     if (status != ZX_OK) {
         return status;
     }
 
-    auto options = resizable ? kResizable : 0u;
-
     // allocate the clone up front outside of our lock
     fbl::AllocChecker ac;
     auto vmo = fbl::AdoptRef<VmObjectPaged>(
@@ -274,15 +332,187 @@ zx_status_t VmObjectPaged::CloneCOW(bool resizable, uint64_t offset, uint64_t si
         return status;
     }
 
+    if (options & kSnapshot) {
+        // Pages are only preserved for our direct children, so anything we read
+        // through to our own parent could still change under the snapshot. Pages
+        // that come from a source, or that stay pinned, change without the write
+        // fault that preserving them hangs off.
+        if (parent_ || page_source_ || is_contiguous()) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (offset < size_) {
+            const uint64_t len = MIN(size, size_ - offset);
+            if (AnyPagesPinnedLocked(offset, len)) {
+                return ZX_ERR_BAD_STATE;
+            }
+            // our writable mappings have to fault on the next write
+            RangeChangeUpdateLocked(offset, len);
+        }
+    }
+
     if (copy_name) {
         vmo->name_ = name_;
     }
 
+    // the clone reads through to pages only the source can provide
+    vmo->page_source_ = page_source_;
+
     *clone_vmo = fbl::move(vmo);
 
     return ZX_OK;
 }
 
+void VmObjectPaged::CollapseLocked() {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
+    // Only an interior node nobody can reach any more, with exactly one child
+    // still reading through it, is worth folding away. With more children the
+    // pages are genuinely shared and have to stay where they are.
+    if (children_list_len_ != 1 || !IsOrphanedLocked()) {
+        return;
+    }
+    if (AnyPagesPinnedLocked(0, size_)) {
+        return;
+    }
+
+    // a resizable child can grow into parts of us it can't see yet
+    auto child = static_cast<VmObjectPaged*>(&children_list_.front());
+    if (child->is_resizable()) {
+        return;
+    }
+
+    const uint64_t child_start = child->parent_offset_;
+    uint64_t child_end;
+    if (add_overflow(child_start, child->size_, &child_end)) {
+        child_end = UINT64_MAX;
+    }
+    const bool window_fits = child_end <= size_;
+    child_end = MIN(child_end, size_);
+
+    LTRACEF("vmo %p child %p window [%#" PRIx64 ", %#" PRIx64 ")\n", this, child, child_start,
+            child_end);
+
+    // pages the child can't see are unreachable now
+    page_list_.FreePages(0, MIN(child_start, size_));
+    page_list_.FreePages(child_end, size_);
+
+    // Hand the rest down to the child unless it already has its own copy. The
+    // child sees the same contents either way, so no mappings need updating.
+    size_t migrated = 0;
+    uint64_t off = child_start;
+    while (off < child_end && page_list_.FindNextPage(off, child_end, &off)) {
+        vm_page_t* p = page_list_.RemovePage(off);
+        DEBUG_ASSERT(p);
+        if (child->page_list_.AddPage(p, off - child_start) == ZX_OK) {
+            migrated++;
+        } else {
+            pmm_free_page(p);
+        }
+        off += PAGE_SIZE;
+    }
+    kcounter_add(vm_cow_pages_migrated, migrated);
+
+    // The root owns the lock the whole tree shares, so it stays in place as an
+    // empty pass-through. Anything else gets spliced out, leaving the child
+    // reading straight from our parent. A child that hangs off our end reads
+    // zeros there rather than our parent's pages, so it has to keep us too.
+    if (!parent_ || !window_fits) {
+        return;
+    }
+    auto parent = static_cast<VmObjectPaged*>(parent_.get());
+    uint64_t new_offset;
+    if (add_overflow(parent_offset_, child_start, &new_offset) ||
+        new_offset > MAX_SIZE) {
+        return;
+    }
+
+    // move the child across before dropping ourself so the parent never
+    // looks childless to its observer
+    RemoveChildLocked(child);
+    parent->AddChildLocked(child);
+    parent->RemoveChildLocked(this);
+
+    child->parent_offset_ = new_offset;
+    child->parent_ = parent_;
+
+    // our caller holds its own reference, so this doesn't destroy us
+    parent_.reset();
+
+    kcounter_add(vm_cow_collapses, 1);
+}
+
+bool VmObjectPaged::HasSnapshotChildrenLocked() const {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
+    for (const auto& child : children_list_) {
+        if (static_cast<const VmObjectPaged&>(child).is_snapshot()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+zx_status_t VmObjectPaged::PreservePageForSnapshotsLocked(uint64_t offset) {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+
+    vm_page_t* p = page_list_.GetPage(offset);
+
+    size_t preserved = 0;
+    zx_status_t status = ZX_OK;
+    for (auto& c : children_list_) {
+        auto child = static_cast<VmObjectPaged*>(&c);
+        if (!child->is_snapshot() || offset < child->parent_offset_) {
+            continue;
+        }
+        const uint64_t child_offset = offset - child->parent_offset_;
+        if (child_offset >= child->size_ || child->page_list_.GetPage(child_offset)) {
+            continue;
+        }
+
+        // where we have no page the child reads zeros, so it gets a zero page
+        vm_page_t* copy = nullptr;
+        paddr_t pa;
+        pmm_alloc_page(child->pmm_alloc_flags_ | (p ? 0 : PMM_ALLOC_FLAG_ZEROED), &copy, &pa);
+        if (!copy) {
+            status = ZX_ERR_NO_MEMORY;
+            break;
+        }
+
+        InitializeVmPage(copy);
+        if (p) {
+            memcpy(paddr_to_physmap(pa), paddr_to_physmap(p->paddr()), PAGE_SIZE);
+        }
+
+        // this also unmaps our page wherever the child had it mapped
+        status = child->AddPageLocked(copy, child_offset);
+        DEBUG_ASSERT(status == ZX_OK);
+        preserved++;
+    }
+
+    kcounter_add(vm_snapshot_pages_preserved, preserved);
+    return status;
+}
+
+zx_status_t VmObjectPaged::PreserveRangeForSnapshotsLocked(uint64_t start, uint64_t end) {
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+
+    if (!HasSnapshotChildrenLocked()) {
+        return ZX_OK;
+    }
+
+    // where we have no page the snapshots read zeros both before and after
+    uint64_t off = start;
+    while (off < end && page_list_.FindNextPage(off, end, &off)) {
+        zx_status_t status = PreservePageForSnapshotsLocked(off);
+        if (status != ZX_OK) {
+            return status;
+        }
+        off += PAGE_SIZE;
+    }
+    return ZX_OK;
+}
+
 void VmObjectPaged::Dump(uint depth, bool verbose) {
     canary_.Assert();
 
@@ -323,16 +553,20 @@ size_t VmObjectPaged::AllocatedPagesInRange(uint64_t offset, uint64_t len) const
     if (!TrimRange(offset, len, size_, &new_len)) {
         return 0;
     }
+    // The page list keeps a running count, so asking about the whole object
+    // (which is what memory accounting nearly always does) needs no walk.
+    if (offset == 0 && new_len == size_) {
+        return page_list_.page_count();
+    }
     size_t count = 0;
     // TODO: Figure out what to do with our parent's pages. If we're a clone,
     // page_list_ only contains pages that we've made copies of.
-    page_list_.ForEveryPage(
-        [&count, offset, new_len](const auto p, uint64_t off) {
-            if (off >= offset && off < offset + new_len) {
-                count++;
-            }
+    page_list_.ForEveryPageInRange(
+        [&count](const auto p, uint64_t off) {
+            count++;
             return ZX_ERR_NEXT;
-        });
+        },
+        ROUNDUP_PAGE_SIZE(offset), ROUNDUP_PAGE_SIZE(offset + new_len));
     return count;
 }
 
@@ -381,12 +615,21 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_ERR_OUT_OF_RANGE;
     }
 
+    // a write is about to change what our snapshots read here
+    if ((pf_flags & VMM_PF_FLAG_WRITE) && HasSnapshotChildrenLocked()) {
+        zx_status_t status = PreservePageForSnapshotsLocked(ROUNDDOWN(offset, PAGE_SIZE));
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
     vm_page_t* p;
     paddr_t pa;
 
     // see if we already have a page at that offset
     p = page_list_.GetPage(offset);
     if (p) {
+        p->flags |= VM_PAGE_FLAG_ACTIVE;
         if (page_out) {
             *page_out = p;
         }
@@ -406,11 +649,18 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         bool overflowed = add_overflow(parent_offset_, offset, &parent_offset);
         ASSERT(!overflowed);
 
-        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist
-        uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
+        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist.
+        // A pager-backed parent has to be faulted though, as only its source knows the contents; the
+        // write is what makes our copy, so it is never passed up.
+        uint parent_pf_flags = page_source_ ? (pf_flags & ~VMM_PF_FLAG_WRITE)
+                                            : (pf_flags & ~(VMM_PF_FLAG_FAULT_MASK));
 
         zx_status_t status = parent_->GetPageLocked(parent_offset, parent_pf_flags,
                                                     nullptr, &p, &pa);
+        if (status != ZX_OK && status != ZX_ERR_NOT_FOUND && status != ZX_ERR_OUT_OF_RANGE) {
+            // the page is on its way, or will never come
+            return status;
+        }
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -476,6 +726,12 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_ERR_NOT_FOUND;
     }
 
+    // the root of a pager-backed tree asks its source for the page; the caller
+    // waits for it and retries
+    if (page_source_ && !parent_) {
+        return page_source_->GetPage(offset);
+    }
+
     // if we're read faulting, we don't already have a page, and the parent doesn't have it,
     // return the single global zero page
     if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
@@ -497,7 +753,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
     if (!p) {
-        pmm_alloc_page(pmm_alloc_flags_, &p, &pa);
+        pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &p, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -505,9 +761,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
 // if ARM and not fully cached, clean/invalidate the page after zeroing it
 #if ARCH_ARM64
     if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
@@ -533,15 +786,98 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::GetContiguousRunLocked(uint64_t offset, uint64_t len, paddr_t* pa) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
+
+    if (len == 0 || !InRange(offset, len, size_)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // while snapshots read our pages, writes to them have to fault
+    if (HasSnapshotChildrenLocked()) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    // Only pages this object owns qualify. Pages borrowed from a parent or the
+    // zero page are mapped read-only and may be replaced on a write fault, so
+    // they can't sit under a single large mapping.
+    uint64_t expected_next_off = offset;
+    paddr_t base = 0;
+    zx_status_t status = page_list_.ForEveryPageInRange(
+        [&expected_next_off, &base, offset](const auto p, uint64_t off) {
+            if (off != expected_next_off) {
+                return ZX_ERR_NOT_FOUND;
+            }
+            paddr_t page_pa = p->paddr();
+            if (off == offset) {
+                base = page_pa;
+            } else if (page_pa != base + (off - offset)) {
+                return ZX_ERR_NOT_FOUND;
+            }
+            expected_next_off = off + PAGE_SIZE;
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + len);
+
+    if (status != ZX_OK || expected_next_off != offset + len) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    *pa = base;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::LookupResidentLocked(uint64_t offset, uint64_t len,
+                                                vmo_lookup_fn_t lookup_fn, void* context) {
+    canary_.Assert();
+    DEBUG_ASSERT(lock_.lock().IsHeld());
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
+
+    if (offset >= size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    len = fbl::min<uint64_t>(len, size_ - offset);
+
+    // while snapshots read our pages, writes to them have to fault, so they
+    // aren't mapped ahead of time
+    if (HasSnapshotChildrenLocked()) {
+        return ZX_OK;
+    }
+
+    // Only walks the pages this object owns; a clone's view of its parent's pages
+    // is established one write fault at a time.
+    return page_list_.ForEveryPageInRange(
+        [lookup_fn, context, offset](const auto p, uint64_t off) {
+            const size_t index = (off - offset) / PAGE_SIZE;
+            zx_status_t status = lookup_fn(context, off, index, p->paddr());
+            if (status != ZX_OK) {
+                return status;
+            }
+            return ZX_ERR_NEXT;
+        },
+        offset, offset + len);
+}
+
 zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t* committed) {
     canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    return CommitRangeLocked(offset, len, committed);
+}
+
+zx_status_t VmObjectPaged::CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed) {
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
     if (committed) {
         *committed = 0;
     }
 
-    Guard<fbl::Mutex> guard{&lock_};
+    // pages of a pager-backed object only come from its source
+    if (page_source_) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
 
     // trim the size
     uint64_t new_len;
@@ -583,7 +919,9 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     list_node page_list;
     list_initialize(&page_list);
 
-    zx_status_t status = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    // GetPageLocked() expects pages on the free list to come zeroed
+    zx_status_t status = pmm_alloc_pages(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED,
+                                         &page_list);
     if (status != ZX_OK) {
         return status;
     }
@@ -591,26 +929,28 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(offset, end - offset);
 
-    // add them to the appropriate range of the object
-    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
-        // Don't commit if we already have this page
-        vm_page_t* p = page_list_.GetPage(o);
-        if (p) {
-            continue;
-        }
-
-        // Check if our parent has the page
-        paddr_t pa;
-        const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
-        // Should not be able to fail, since we're providing it memory and the
-        // range should be valid.
-        zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
-        ASSERT(status == ZX_OK);
-
-        if (committed) {
-            *committed += PAGE_SIZE;
-        }
-    }
+    // add them to the appropriate range of the object, only visiting the
+    // offsets we don't already have a page for
+    page_list_.ForEveryGapInRange(
+        [this, &page_list, committed](uint64_t gap_start, uint64_t gap_end)
+            TA_NO_THREAD_SAFETY_ANALYSIS {
+            for (uint64_t o = gap_start; o < gap_end; o += PAGE_SIZE) {
+                // Check if our parent has the page
+                vm_page_t* p;
+                paddr_t pa;
+                const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
+                // Should not be able to fail, since we're providing it memory and the
+                // range should be valid.
+                zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
+                ASSERT(status == ZX_OK);
+
+                if (committed) {
+                    *committed += PAGE_SIZE;
+                }
+            }
+            return ZX_ERR_NEXT;
+        },
+        offset, end);
 
     DEBUG_ASSERT(list_is_empty(&page_list));
 
@@ -622,6 +962,13 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
 
 zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) {
     canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    return DecommitRangeLocked(offset, len, decommitted);
+}
+
+zx_status_t VmObjectPaged::DecommitRangeLocked(uint64_t offset, uint64_t len,
+                                               uint64_t* decommitted) {
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
     if (decommitted) {
@@ -632,8 +979,6 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
         return ZX_ERR_NOT_SUPPORTED;
     }
 
-    Guard<fbl::Mutex> guard{&lock_};
-
     // trim the size
     uint64_t new_len;
     if (!TrimRange(offset, len, size_, &new_len)) {
@@ -662,17 +1007,318 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
         return ZX_ERR_BAD_STATE;
     }
 
+    // snapshots keep the pages we're about to drop
+    zx_status_t status = PreserveRangeForSnapshotsLocked(start, end);
+    if (status != ZX_OK) {
+        return status;
+    }
+
     // unmap all of the pages in this range on all the mapping regions
     RangeChangeUpdateLocked(start, page_aligned_len);
 
-    // iterate through the pages, freeing them
-    // TODO: use page_list iterator, move pages to list, free at once
-    while (start < end) {
-        auto status = page_list_.FreePage(start);
-        if (status == ZX_OK && decommitted) {
-            *decommitted += PAGE_SIZE;
+    // pull the pages out of the list and free them in one batch
+    size_t freed = page_list_.FreePages(start, end);
+    if (decommitted) {
+        *decommitted = freed * PAGE_SIZE;
+    }
+
+    return ZX_OK;
+}
+
+void VmObjectPaged::RangeOpBatch(VmRangeOp* ops, size_t count) {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    for (size_t i = 0; i < count; i++) {
+        VmRangeOp& op = ops[i];
+        switch (op.type) {
+        case VmRangeOp::Type::Commit:
+            op.status = CommitRangeLocked(op.offset, op.len, nullptr);
+            break;
+        case VmRangeOp::Type::Decommit:
+            op.status = DecommitRangeLocked(op.offset, op.len, nullptr);
+            break;
+        case VmRangeOp::Type::CacheSync:
+            op.status = CacheOpLocked(op.offset, op.len, CacheOpType::Sync);
+            break;
+        case VmRangeOp::Type::CacheInvalidate:
+            op.status = CacheOpLocked(op.offset, op.len, CacheOpType::Invalidate);
+            break;
+        case VmRangeOp::Type::CacheClean:
+            op.status = CacheOpLocked(op.offset, op.len, CacheOpType::Clean);
+            break;
+        case VmRangeOp::Type::CacheCleanInvalidate:
+            op.status = CacheOpLocked(op.offset, op.len, CacheOpType::CleanInvalidate);
+            break;
         }
-        start += PAGE_SIZE;
+    }
+}
+
+size_t VmObjectPaged::ReclaimZeroPages() {
+    canary_.Assert();
+
+    size_t reclaimed = 0;
+    uint64_t offset = 0;
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    for (;;) {
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+
+            // Only anonymous memory handed out to user mode qualifies. Kernel
+            // objects may not tolerate faults, contiguous and uncached objects
+            // expose their physical pages, and a clone's zero filled page may be
+            // hiding a parent page that isn't. A pager-backed page would have to
+            // be requested again.
+            if (user_id_ == 0 || is_contiguous() || cache_policy_ != ARCH_MMU_FLAG_CACHED ||
+                parent_ || page_source_) {
+                break;
+            }
+            if (offset >= size_) {
+                break;
+            }
+            const uint64_t end = offset + MIN(size_ - offset, kScanChunk);
+
+            uint64_t first = UINT64_MAX;
+            uint64_t last = 0;
+            page_list_.ForEveryPageInRange([&first, &last](const auto p, uint64_t off) {
+                if (p->object.pin_count == 0 && IsZeroPage(p)) {
+                    first = MIN(first, off);
+                    last = off;
+                }
+                return ZX_ERR_NEXT;
+            }, offset, end);
+
+            if (first != UINT64_MAX) {
+                // Unmap the candidates everywhere before looking again, so a write
+                // through some mapping can't land after the check. Anything that
+                // faults them back in afterwards reads the zero page.
+                RangeChangeUpdateLocked(first, last + PAGE_SIZE - first);
+
+                uint64_t off = first;
+                while (off <= last && page_list_.FindNextPage(off, last + PAGE_SIZE, &off)) {
+                    vm_page_t* p = page_list_.GetPage(off);
+                    if (p->object.pin_count == 0 && IsZeroPage(p)) {
+                        page_list_.RemovePage(off);
+                        list_add_tail(&free_list, &p->queue_node);
+                        reclaimed++;
+                    }
+                    off += PAGE_SIZE;
+                }
+            }
+
+            offset = end;
+        }
+
+        // free outside the lock
+        if (!list_is_empty(&free_list)) {
+            pmm_free(&free_list);
+        }
+    }
+
+    kcounter_add(vm_zero_pages_reclaimed, reclaimed);
+    return reclaimed;
+}
+
+zx_status_t VmObjectPaged::LockDiscardable(bool* was_discarded) {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    if (!is_discardable()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (discardable_locks_ == UINT32_MAX) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    discardable_locks_++;
+    *was_discarded = discarded_;
+    if (discarded_) {
+        discarded_ = false;
+        NotifyDiscardedLocked(false);
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::UnlockDiscardable() {
+    canary_.Assert();
+
+    Guard<fbl::Mutex> guard{&lock_};
+    if (!is_discardable()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (discardable_locks_ == 0) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    discardable_locks_--;
+
+    return ZX_OK;
+}
+
+size_t VmObjectPaged::EvictPages(size_t max_pages) {
+    canary_.Assert();
+
+    size_t evicted = 0;
+    uint64_t offset = 0;
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    for (;;) {
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+
+            if (!is_discardable() || discardable_locks_ > 0) {
+                break;
+            }
+            if (offset >= size_ || evicted >= max_pages) {
+                break;
+            }
+            const uint64_t end = offset + MIN(size_ - offset, kScanChunk);
+
+            bool any_unpinned = false;
+            page_list_.ForEveryPageInRange([&any_unpinned](const auto p, uint64_t) {
+                if (p->object.pin_count == 0) {
+                    any_unpinned = true;
+                    return ZX_ERR_STOP;
+                }
+                return ZX_ERR_NEXT;
+            }, offset, end);
+
+            if (any_unpinned) {
+                // Second chance aging: pages touched since the last pass lose their
+                // active bit and are unmapped, so touching them again faults and sets
+                // it back. Pages nobody touched in between are dropped.
+                RangeChangeUpdateLocked(offset, end - offset);
+
+                const size_t before = evicted;
+                uint64_t off = offset;
+                while (evicted < max_pages && page_list_.FindNextPage(off, end, &off)) {
+                    vm_page_t* p = page_list_.GetPage(off);
+                    if (p->object.pin_count == 0) {
+                        if (p->flags & VM_PAGE_FLAG_ACTIVE) {
+                            p->flags &= ~VM_PAGE_FLAG_ACTIVE;
+                        } else {
+                            page_list_.RemovePage(off);
+                            list_add_tail(&free_list, &p->queue_node);
+                            evicted++;
+                        }
+                    }
+                    off += PAGE_SIZE;
+                }
+
+                if (evicted != before && !discarded_) {
+                    discarded_ = true;
+                    NotifyDiscardedLocked(true);
+                }
+            }
+
+            offset = end;
+        }
+
+        // free outside the lock
+        if (!list_is_empty(&free_list)) {
+            pmm_free(&free_list);
+        }
+    }
+
+    kcounter_add(vm_pages_evicted, evicted);
+    return evicted;
+}
+
+zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    Guard<fbl::Mutex> guard{&lock_};
+
+    if (!InRange(offset, len, size_)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // only pages nobody else can reach may change hands
+    if (parent_ || children_list_len_ != 0 || is_contiguous() || page_source_ ||
+        cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (AnyPagesPinnedLocked(offset, len)) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // allocate stand-ins for the holes up front so a failure leaves us untouched
+    size_t resident = 0;
+    page_list_.ForEveryPageInRange([&resident](const auto, uint64_t) {
+        resident++;
+        return ZX_ERR_NEXT;
+    }, offset, offset + len);
+
+    list_node zeroed = LIST_INITIAL_VALUE(zeroed);
+    const size_t missing = len / PAGE_SIZE - resident;
+    if (missing > 0) {
+        zx_status_t status = pmm_alloc_pages(missing, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED,
+                                             &zeroed);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(o);
+        if (!p) {
+            p = list_remove_head_type(&zeroed, vm_page, queue_node);
+            DEBUG_ASSERT(p);
+            InitializeVmPage(p);
+        }
+        list_add_tail(pages, &p->queue_node);
+    }
+    DEBUG_ASSERT(list_is_empty(&zeroed));
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SupplyPages(zx_koid_t owner, uint64_t offset, uint64_t len,
+                                       list_node* pages) {
+    canary_.Assert();
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(len)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    {
+        Guard<fbl::Mutex> guard{&lock_};
+
+        // only the root of the tree holds pages on the source's behalf
+        if (!page_source_ || parent_ || page_source_->owner() != owner) {
+            return ZX_ERR_BAD_STATE;
+        }
+        if (!InRange(offset, len, size_)) {
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+
+        uint64_t o = offset;
+        vm_page_t* p;
+        while ((p = list_remove_head_type(pages, vm_page, queue_node)) != nullptr) {
+            DEBUG_ASSERT(o < offset + len);
+            DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT && p->object.pin_count == 0);
+
+            p->flags |= VM_PAGE_FLAG_ACTIVE;
+            if (page_list_.AddPage(p, o) != ZX_OK) {
+                list_add_tail(&free_list, &p->queue_node);
+            }
+            o += PAGE_SIZE;
+        }
+
+        page_source_->OnPagesSupplied(offset, len);
+    }
+
+    // free outside the lock
+    if (!list_is_empty(&free_list)) {
+        pmm_free(&free_list);
     }
 
     return ZX_OK;
@@ -700,8 +1346,14 @@ zx_status_t VmObjectPaged::PinLocked(uint64_t offset, uint64_t len) {
     const uint64_t start_page_offset = ROUNDDOWN(offset, PAGE_SIZE);
     const uint64_t end_page_offset = ROUNDUP(offset + len, PAGE_SIZE);
 
+    // a pinned page can be written without faulting
+    zx_status_t status = PreserveRangeForSnapshotsLocked(start_page_offset, end_page_offset);
+    if (status != ZX_OK) {
+        return status;
+    }
+
     uint64_t expected_next_off = start_page_offset;
-    zx_status_t status = page_list_.ForEveryPageInRange(
+    status = page_list_.ForEveryPageInRange(
         [&expected_next_off](const auto p, uint64_t off) {
             if (off != expected_next_off) {
                 return ZX_ERR_NOT_FOUND;
@@ -732,6 +1384,9 @@ zx_status_t VmObjectPaged::PinLocked(uint64_t offset, uint64_t len) {
 void VmObjectPaged::Unpin(uint64_t offset, uint64_t len) {
     Guard<fbl::Mutex> guard{&lock_};
     UnpinLocked(offset, len);
+
+    // a pin may have been the only thing keeping us from collapsing
+    CollapseLocked();
 }
 
 void VmObjectPaged::UnpinLocked(uint64_t offset, uint64_t len) {
@@ -823,15 +1478,17 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
             return ZX_ERR_BAD_STATE;
         }
 
+        // snapshots keep the pages we're about to drop
+        status = PreserveRangeForSnapshotsLocked(start, end);
+        if (status != ZX_OK) {
+            return status;
+        }
+
         // unmap all of the pages in this range on all the mapping regions
         RangeChangeUpdateLocked(start, len);
 
-        // iterate through the pages, freeing them
-        // TODO: use page_list iterator, move pages to list, free at once
-        while (start < end) {
-            page_list_.FreePage(start);
-            start += PAGE_SIZE;
-        }
+        // pull the pages out of the list and free them in one batch
+        page_list_.FreePages(start, end);
     } else if (s > size_) {
         // expanding
         // figure the starting and ending page offset that is affected
@@ -882,50 +1539,70 @@ template <typename T>
 zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, bool write, T copyfunc) {
     canary_.Assert();
 
-    Guard<fbl::Mutex> guard{&lock_};
-
-    // are we uncached? abort in this case
-    if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
-        return ZX_ERR_BAD_STATE;
-    }
-
-    // test if in range
-    uint64_t end_offset;
-    if (add_overflow(offset, len, &end_offset) || end_offset > size_) {
-        return ZX_ERR_OUT_OF_RANGE;
-    }
-
-    // walk the list of pages and do the write
+    // walk the list of pages and do the write. A page that has to come from a
+    // page source is waited for with the lock dropped, and the walk picks up
+    // where it stopped.
     uint64_t src_offset = offset;
     size_t dest_offset = 0;
-    while (len > 0) {
-        size_t page_offset = src_offset % PAGE_SIZE;
-        size_t tocopy = MIN(PAGE_SIZE - page_offset, len);
+    for (;;) {
+        zx_status_t status = ZX_OK;
+        {
+            Guard<fbl::Mutex> guard{&lock_};
+
+            // are we uncached? abort in this case
+            if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+                return ZX_ERR_BAD_STATE;
+            }
 
-        // fault in the page
-        paddr_t pa;
-        auto status = GetPageLocked(src_offset,
-                                    VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
-                                    nullptr, nullptr, &pa);
-        if (status != ZX_OK) {
-            return status;
-        }
+            // test if in range
+            uint64_t end_offset;
+            if (add_overflow(src_offset, len, &end_offset) || end_offset > size_) {
+                return ZX_ERR_OUT_OF_RANGE;
+            }
+
+            while (len > 0) {
+                size_t page_offset = src_offset % PAGE_SIZE;
+                size_t tocopy = MIN(PAGE_SIZE - page_offset, len);
 
-        // compute the kernel mapping of this page
-        uint8_t* page_ptr = reinterpret_cast<uint8_t*>(paddr_to_physmap(pa));
+                // fault in the page
+                paddr_t pa;
+                status = GetPageLocked(src_offset,
+                                       VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
+                                       nullptr, nullptr, &pa);
+                if (status != ZX_OK) {
+                    break;
+                }
 
-        // call the copy routine
-        auto err = copyfunc(page_ptr + page_offset, dest_offset, tocopy);
-        if (err < 0) {
-            return err;
+                // compute the kernel mapping of this page
+                uint8_t* page_ptr = reinterpret_cast<uint8_t*>(paddr_to_physmap(pa));
+
+                // call the copy routine
+                auto err = copyfunc(page_ptr + page_offset, dest_offset, tocopy);
+                if (err < 0) {
+                    // A user page that has to come from a page source isn't
+                    // waited for under our lock; the fault left a request for
+                    // it instead, and the chunk is copied again once it's in.
+                    if (PageSource::HasRequest()) {
+                        status = ZX_ERR_SHOULD_WAIT;
+                        break;
+                    }
+                    return err;
+                }
+
+                src_offset += tocopy;
+                dest_offset += tocopy;
+                len -= tocopy;
+            }
         }
 
-        src_offset += tocopy;
-        dest_offset += tocopy;
-        len -= tocopy;
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            return status;
+        }
+        status = PageSource::WaitForRequest();
+        if (status != ZX_OK) {
+            return status;
+        }
     }
-
-    return ZX_OK;
 }
 
 zx_status_t VmObjectPaged::Read(void* _ptr, uint64_t offset, size_t len) {
@@ -995,6 +1672,9 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
                 zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr,
                                                          nullptr, &pa);
                 if (status != ZX_OK) {
+                    // callers hold locks across this, so they can't wait for a
+                    // page source
+                    PageSource::CancelRequest();
                     return ZX_ERR_NO_MEMORY;
                 }
                 const size_t index = (off - start_page_offset) / PAGE_SIZE;
@@ -1030,6 +1710,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
         paddr_t pa;
         zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, &pa);
         if (status != ZX_OK) {
+            PageSource::CancelRequest();
             return ZX_ERR_NO_MEMORY;
         }
         const size_t index = (off - start_page_offset) / PAGE_SIZE;
@@ -1104,12 +1785,16 @@ zx_status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t l
                                    const CacheOpType type) {
     canary_.Assert();
 
+    Guard<fbl::Mutex> guard{&lock_};
+    return CacheOpLocked(start_offset, len, type);
+}
+
+zx_status_t VmObjectPaged::CacheOpLocked(const uint64_t start_offset, const uint64_t len,
+                                         const CacheOpType type) {
     if (unlikely(len == 0)) {
         return ZX_ERR_INVALID_ARGS;
     }
 
-    Guard<fbl::Mutex> guard{&lock_};
-
     if (unlikely(!InRange(start_offset, len, size_))) {
         return ZX_ERR_OUT_OF_RANGE;
     }
@@ -10,6 +10,7 @@
 
 #include <assert.h>
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <inttypes.h>
 #include <lib/console.h>
@@ -91,6 +92,44 @@ zx_status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, list
     return ZX_OK;
 }
 
+zx_status_t VmObjectPhysical::GetContiguousRunLocked(uint64_t offset, uint64_t len,
+                                                     paddr_t* pa) {
+    canary_.Assert();
+
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
+    if (!InRange(offset, len, size_)) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    uint64_t base = base_ + offset;
+    if (base + len - 1 > UINTPTR_MAX) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    *pa = (paddr_t)base;
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPhysical::LookupResidentLocked(uint64_t offset, uint64_t len,
+                                                   vmo_lookup_fn_t lookup_fn, void* context) {
+    canary_.Assert();
+
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(len));
+    if (offset >= size_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    len = fbl::min<uint64_t>(len, size_ - offset);
+
+    for (uint64_t off = offset; off < offset + len; off += PAGE_SIZE) {
+        const size_t index = (off - offset) / PAGE_SIZE;
+        zx_status_t status = lookup_fn(context, off, index, (paddr_t)(base_ + off));
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
 zx_status_t VmObjectPhysical::LookupUser(uint64_t offset, uint64_t len, user_inout_ptr<paddr_t> buffer,
                                          size_t buffer_size) {
     canary_.Assert();
@@ -7,6 +7,7 @@
 #include <vm/vm_page_list.h>
 
 #include <err.h>
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <inttypes.h>
 #include <trace.h>
@@ -68,82 +69,349 @@ VmPageList::VmPageList() {
 
 VmPageList::~VmPageList() {
     LTRACEF("%p\n", this);
-    DEBUG_ASSERT(list_.is_empty());
+    DEBUG_ASSERT(leaf_count_ == 0);
+    DEBUG_ASSERT(root_ == nullptr);
+}
+
+void VmPageList::FreeTree(RadixNode* node, uint level) {
+    if (!node) {
+        return;
+    }
+    if (level > 1) {
+        for (auto child : node->children) {
+            FreeTree(child, level - 1);
+        }
+    } else {
+        for (auto leaf : node->leaves) {
+            delete leaf;
+        }
+    }
+    delete node;
+}
+
+VmPageListNode* VmPageList::FindLeaf(uint64_t leaf_index) const {
+    if (leaf_index >= Capacity(height_)) {
+        return nullptr;
+    }
+
+    const RadixNode* node = root_;
+    for (uint level = height_; node; level--) {
+        size_t slot = (leaf_index >> ((level - 1) * kRadixShift)) & (kRadixFanOut - 1);
+        if (level == 1) {
+            return node->leaves[slot];
+        }
+        node = node->children[slot];
+    }
+    return nullptr;
 }
 
 zx_status_t VmPageList::AddPage(vm_page* p, uint64_t offset) {
-    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    uint64_t node_offset = ROUNDDOWN(offset, kLeafSpan);
+    uint64_t leaf_index = offset / kLeafSpan;
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
 
     LTRACEF_LEVEL(2, "%p page %p, offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, p, offset,
                   node_offset, index);
 
-    // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
-        fbl::AllocChecker ac;
-        fbl::unique_ptr<VmPageListNode> pl =
-            fbl::unique_ptr<VmPageListNode>(new (&ac) VmPageListNode(node_offset));
+    // work out how tall the tree has to be to address this leaf, and which
+    // nodes on the way down to it are missing
+    uint height = height_;
+    while (leaf_index >= Capacity(height)) {
+        height++;
+    }
+    DEBUG_ASSERT(height <= kMaxHeight);
+
+    size_t new_roots = 0;
+    size_t new_nodes;
+    bool new_leaf = true;
+    if (!root_) {
+        DEBUG_ASSERT(height_ == 0);
+        new_nodes = height;
+    } else if (height > height_) {
+        // the existing tree is pushed down into slot 0 of the new roots, and
+        // the leaf hangs off a nonzero slot of the topmost one
+        new_roots = height - height_;
+        new_nodes = new_roots + height - 1;
+    } else {
+        const RadixNode* node = root_;
+        uint level = height_;
+        for (; level > 1; level--) {
+            size_t slot = (leaf_index >> ((level - 1) * kRadixShift)) & (kRadixFanOut - 1);
+            if (!node->children[slot]) {
+                break;
+            }
+            node = node->children[slot];
+        }
+        new_nodes = level - 1;
+        if (level == 1) {
+            new_leaf = !node->leaves[leaf_index & (kRadixFanOut - 1)];
+        }
+    }
+
+    // allocate all of them before linking any in, so that running out of
+    // memory leaves the tree as it was
+    RadixNode* spares[2 * kMaxHeight];
+    DEBUG_ASSERT(new_nodes <= fbl::count_of(spares));
+    fbl::AllocChecker ac;
+    for (size_t i = 0; i < new_nodes; i++) {
+        spares[i] = new (&ac) RadixNode;
         if (!ac.check()) {
+            while (i > 0) {
+                delete spares[--i];
+            }
             return ZX_ERR_NO_MEMORY;
         }
+    }
+    VmPageListNode* pl = nullptr;
+    if (new_leaf) {
+        pl = new (&ac) VmPageListNode(node_offset);
+        if (!ac.check()) {
+            for (size_t i = 0; i < new_nodes; i++) {
+                delete spares[i];
+            }
+            return ZX_ERR_NO_MEMORY;
+        }
+        LTRACEF("allocating new inner node %p\n", pl);
+    }
+    size_t next_spare = 0;
+
+    // grow the tree until it can address this leaf, pushing the existing
+    // tree down into slot 0 of a new root
+    for (size_t i = 0; i < new_roots; i++) {
+        RadixNode* new_root = spares[next_spare++];
+        new_root->children[0] = root_;
+        new_root->count = 1;
+        root_ = new_root;
+        height_++;
+    }
+    if (!root_) {
+        root_ = spares[next_spare++];
+        height_ = height;
+    }
 
-        LTRACEF("allocating new inner node %p\n", pl.get());
-        __UNUSED auto status = pl->AddPage(p, index);
-        DEBUG_ASSERT(status == ZX_OK);
-
-        list_.insert(fbl::move(pl));
+    // walk down to the leaf, filling in interior nodes as needed
+    RadixNode* node = root_;
+    for (uint level = height_; level > 1; level--) {
+        size_t slot = (leaf_index >> ((level - 1) * kRadixShift)) & (kRadixFanOut - 1);
+        if (!node->children[slot]) {
+            node->children[slot] = spares[next_spare++];
+            node->count++;
+        }
+        node = node->children[slot];
+    }
+    DEBUG_ASSERT(next_spare == new_nodes);
+
+    size_t slot = leaf_index & (kRadixFanOut - 1);
+    if (pl) {
+        DEBUG_ASSERT(!node->leaves[slot]);
+        node->leaves[slot] = pl;
+        node->count++;
+        leaf_count_++;
     } else {
-        pln->AddPage(p, index);
+        pl = node->leaves[slot];
     }
 
-    return ZX_OK;
+    zx_status_t status = pl->AddPage(p, index);
+    if (status == ZX_OK) {
+        page_count_++;
+    }
+    return status;
 }
 
 vm_page* VmPageList::GetPage(uint64_t offset) {
-    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    uint64_t leaf_index = offset / kLeafSpan;
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
 
-    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, offset, node_offset,
+    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " leaf %#" PRIx64 " index %zu\n", this, offset, leaf_index,
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
+    VmPageListNode* pl = FindLeaf(leaf_index);
+    if (!pl) {
         return nullptr;
     }
 
-    return pln->GetPage(index);
+    return pl->GetPage(index);
 }
 
-zx_status_t VmPageList::FreePage(uint64_t offset) {
-    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+// Unlinks and deletes the (empty) leaf at |leaf_index|, along with any
+// interior nodes that become empty as a result.
+void VmPageList::RemoveLeaf(uint64_t leaf_index) {
+    RadixNode* path[kMaxHeight];
+    size_t slots[kMaxHeight];
+
+    RadixNode* node = root_;
+    for (uint level = height_; level > 0; level--) {
+        DEBUG_ASSERT(node);
+        size_t slot = (leaf_index >> ((level - 1) * kRadixShift)) & (kRadixFanOut - 1);
+        path[level - 1] = node;
+        slots[level - 1] = slot;
+        if (level > 1) {
+            node = node->children[slot];
+        }
+    }
+
+    VmPageListNode* pl = path[0]->leaves[slots[0]];
+    DEBUG_ASSERT(pl && pl->IsEmpty());
+    delete pl;
+    path[0]->leaves[slots[0]] = nullptr;
+    leaf_count_--;
+
+    // prune interior nodes bottom up while they are empty
+    for (uint level = 1; level <= height_; level++) {
+        RadixNode* n = path[level - 1];
+        DEBUG_ASSERT(n->count > 0);
+        if (level > 1) {
+            n->children[slots[level - 1]] = nullptr;
+        }
+        if (--n->count > 0) {
+            return;
+        }
+        if (level == height_) {
+            delete n;
+            root_ = nullptr;
+            height_ = 0;
+            return;
+        }
+        delete n;
+    }
+}
+
+vm_page* VmPageList::RemovePage(uint64_t offset) {
+    uint64_t leaf_index = offset / kLeafSpan;
     size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
 
-    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, offset, node_offset,
+    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " leaf %#" PRIx64 " index %zu\n", this, offset, leaf_index,
                   index);
 
     // lookup the tree node that holds this page
-    auto pln = list_.find(node_offset);
-    if (!pln.IsValid()) {
-        return ZX_ERR_NOT_FOUND;
+    VmPageListNode* pl = FindLeaf(leaf_index);
+    if (!pl) {
+        return nullptr;
     }
 
-    // free this page
-    auto page = pln->RemovePage(index);
+    auto page = pl->RemovePage(index);
     if (page) {
+        page_count_--;
+    }
+    if (page && pl->IsEmpty()) {
         // if it was the last page in the node, remove the node from the tree
-        if (pln->IsEmpty()) {
-            LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
-            list_.erase(*pln);
-        }
+        LTRACEF_LEVEL(2, "%p freeing the list node\n", this);
+        RemoveLeaf(leaf_index);
+    }
+
+    return page;
+}
 
-        pmm_free_page(page);
+zx_status_t VmPageList::FreePage(uint64_t offset) {
+    vm_page* page = RemovePage(offset);
+    if (!page) {
+        return ZX_ERR_NOT_FOUND;
     }
 
+    pmm_free_page(page);
+
     return ZX_OK;
 }
 
+bool VmPageList::FindNextLeaf(const RadixNode* node, uint level, uint64_t base, uint64_t start,
+                              uint64_t end, const VmPageListNode** leaf) const {
+    const VmPageListNode* found = nullptr;
+    ForEveryLeaf(node, level, base, start, end, [&found](const VmPageListNode& pl) {
+        if (pl.IsEmpty()) {
+            return ZX_ERR_NEXT;
+        }
+        found = &pl;
+        return ZX_ERR_STOP;
+    });
+    *leaf = found;
+    return found != nullptr;
+}
+
+bool VmPageList::FindNextPage(uint64_t start_offset, uint64_t end_offset, uint64_t* offset) const {
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(start_offset) && IS_PAGE_ALIGNED(end_offset));
+    if (!root_ || end_offset <= start_offset) {
+        return false;
+    }
+
+    uint64_t start = start_offset / kLeafSpan;
+    const uint64_t end = (end_offset - 1) / kLeafSpan + 1;
+    while (start < end) {
+        const VmPageListNode* pl;
+        if (!FindNextLeaf(root_, height_, 0, start, end, &pl)) {
+            return false;
+        }
+
+        bool found = false;
+        pl->ForEveryPage([&found, offset](const vm_page*, uint64_t off) {
+            *offset = off;
+            found = true;
+            return ZX_ERR_STOP;
+        }, MAX(start_offset, pl->offset()), MIN(end_offset, pl->offset() + kLeafSpan));
+        if (found) {
+            return true;
+        }
+
+        // the leaf only had pages before start_offset, move on to the next one
+        start = pl->offset() / kLeafSpan + 1;
+    }
+    return false;
+}
+
+size_t VmPageList::RemovePages(uint64_t start_offset, uint64_t end_offset, list_node* pages) {
+    LTRACEF("%p start %#" PRIx64 " end %#" PRIx64 "\n", this, start_offset, end_offset);
+
+    size_t count = 0;
+    uint64_t empty_leaves[16];
+    size_t empty_count = 0;
+
+    // Pull the pages out in one ordered walk. Emptied leaves can't be unlinked
+    // while walking, so remember them and go back for them in batches.
+    uint64_t cur = start_offset;
+    while (root_ && cur < end_offset) {
+        uint64_t resume = end_offset;
+        ForEveryLeaf(
+            root_, height_, 0, cur / kLeafSpan, (end_offset - 1) / kLeafSpan + 1,
+            [&](VmPageListNode& pl) {
+                pl.ForEveryPage([&](vm_page*& p, uint64_t off) {
+                    list_add_tail(pages, &p->queue_node);
+                    p = nullptr;
+                    count++;
+                    return ZX_ERR_NEXT;
+                }, MAX(start_offset, pl.offset()), MIN(end_offset, pl.offset() + kLeafSpan));
+                if (pl.IsEmpty()) {
+                    empty_leaves[empty_count++] = pl.offset() / kLeafSpan;
+                    if (empty_count == fbl::count_of(empty_leaves)) {
+                        resume = pl.offset() + kLeafSpan;
+                        return ZX_ERR_STOP;
+                    }
+                }
+                return ZX_ERR_NEXT;
+            });
+
+        for (size_t i = 0; i < empty_count; i++) {
+            RemoveLeaf(empty_leaves[i]);
+        }
+        empty_count = 0;
+
+        cur = resume;
+    }
+
+    page_count_ -= count;
+    return count;
+}
+
+size_t VmPageList::FreePages(uint64_t start_offset, uint64_t end_offset) {
+    list_node list = LIST_INITIAL_VALUE(list);
+
+    size_t count = RemovePages(start_offset, end_offset, &list);
+
+    // return all the pages to the pmm at once
+    pmm_free(&list);
+
+    return count;
+}
+
 size_t VmPageList::FreeAllPages() {
     LTRACEF("%p\n", this);
 
@@ -169,11 +437,16 @@ size_t VmPageList::FreeAllPages() {
     pmm_free(&list);
 
     // empty the tree
-    list_.clear();
+    FreeTree(root_, height_);
+    root_ = nullptr;
+    height_ = 0;
+    leaf_count_ = 0;
+    DEBUG_ASSERT(page_count_ == count);
+    page_count_ = 0;
 
     return count;
 }
 
 bool VmPageList::IsEmpty() {
-    return list_.is_empty();
+    return leaf_count_ == 0;
 }
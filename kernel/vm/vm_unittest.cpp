@@ -8,7 +8,10 @@
 #include <err.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <fbl/unique_ptr.h>
 #include <lib/unittest/unittest.h>
+#include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -16,8 +19,11 @@
 #include <vm/vm_object.h>
 #include <vm/vm_object_paged.h>
 #include <vm/vm_object_physical.h>
+#include <vm/vm_page_list.h>
 #include <zircon/types.h>
 
+#include "pmm_arena.h"
+
 static const uint kArchRwFlags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
 
 // Allocates a single page, translates it to a vm_page_t and frees it.
@@ -84,6 +90,138 @@ static bool pmm_alloc_contiguous_one_test() {
     END_TEST;
 }
 
+// Allocates naturally aligned power of two runs, which the arenas' free index
+// should be able to answer directly, and checks the pages are really contiguous.
+static bool pmm_alloc_contiguous_aligned_test() {
+    BEGIN_TEST;
+    for (uint order = 1; order <= 6; order++) {
+        list_node list = LIST_INITIAL_VALUE(list);
+        paddr_t pa;
+        size_t count = 1ul << order;
+        zx_status_t status = pmm_alloc_contiguous(count, 0, (uint8_t)(PAGE_SIZE_SHIFT + order),
+                                                  &pa, &list);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc_contiguous returned failure\n");
+        EXPECT_EQ(count, list_length(&list), "pmm_alloc_contiguous list size is wrong");
+        EXPECT_TRUE(IS_ALIGNED(pa, count * PAGE_SIZE), "run is misaligned");
+
+        paddr_t expected = pa;
+        vm_page_t* page;
+        list_for_every_entry (&list, page, vm_page_t, queue_node) {
+            EXPECT_EQ(expected, page->paddr(), "run is not contiguous");
+            EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "page state");
+            expected += PAGE_SIZE;
+        }
+        pmm_free(&list);
+    }
+    END_TEST;
+}
+
+// Builds a fragmented arena over memory of its own, where the only aligned
+// run of three free pages sits in a block of four whose last page is in use,
+// and checks that a three page aligned request still finds it.
+static bool pmm_arena_contiguous_fragmented_test() {
+    BEGIN_TEST;
+
+    constexpr size_t kPages = 64;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> storage(new (&ac) uint8_t[PmmArena::StorageSize(kPages)]);
+    ASSERT_TRUE(ac.check(), "");
+
+    // the pages are never touched, only their vm_page_t
+    pmm_arena_info_t info = {"test", 0, 0, 1ul << 30, kPages * PAGE_SIZE};
+    PmmArena arena;
+    list_node free_list = LIST_INITIAL_VALUE(free_list);
+    arena.InitStorage(&info, storage.get(), 0, 0, &free_list);
+
+    // leave pages 1-3 and 4-6 free: the first run is misaligned and neither
+    // is a whole free block of four
+    for (size_t i = 0; i < kPages; i++) {
+        if ((i >= 1 && i <= 3) || (i >= 4 && i <= 6)) {
+            continue;
+        }
+        vm_page_t* page = arena.get_page(i);
+        page->state = VM_PAGE_STATE_ALLOC;
+        arena.UpdateFreeIndex(page, false);
+    }
+
+    vm_page_t* run = arena.FindFreeContiguous(3, PAGE_SIZE_SHIFT + 2);
+    EXPECT_EQ(arena.get_page(4), run, "aligned run of three not found");
+
+    // a request for exactly one aligned block is still turned down
+    EXPECT_NULL(arena.FindFreeContiguous(4, PAGE_SIZE_SHIFT + 2), "no free block of four");
+
+    END_TEST;
+}
+
+// Frees a page, which will usually leave it in this cpu's page cache, then
+// makes sure it can still be allocated by physical address.
+static bool pmm_alloc_range_cached_page_test() {
+    BEGIN_TEST;
+    paddr_t pa;
+    vm_page_t* page;
+
+    zx_status_t status = pmm_alloc_page(0, &page, &pa);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc single page");
+    pmm_free_page(page);
+    EXPECT_TRUE(page->is_free() || page->state == VM_PAGE_STATE_CACHED, "freed page state");
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    status = pmm_alloc_range(pa, 1, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_range on freed page");
+    EXPECT_EQ(1u, list_length(&list), "pmm_alloc_range list size");
+    EXPECT_EQ(page, list_peek_head_type(&list, vm_page_t, queue_node), "same page");
+    EXPECT_EQ(VM_PAGE_STATE_ALLOC, page->state, "allocated page state");
+
+    pmm_free(&list);
+    END_TEST;
+}
+
+static bool page_is_zero(vm_page_t* page) {
+    auto bytes = static_cast<const uint8_t*>(paddr_to_physmap(page->paddr()));
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        if (bytes[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Dirties and frees pages, then asks for them back zeroed, whether they come
+// from the pre-zeroed pool or get zeroed on the way out.
+static bool pmm_alloc_zeroed_test() {
+    BEGIN_TEST;
+    static constexpr size_t alloc_count = 16;
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    zx_status_t status = pmm_alloc_pages(alloc_count, 0, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages");
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        memset(paddr_to_physmap(page->paddr()), 0xa5, PAGE_SIZE);
+    }
+    pmm_free(&list);
+
+    status = pmm_alloc_pages(alloc_count, PMM_ALLOC_FLAG_ZEROED, &list);
+    ASSERT_EQ(ZX_OK, status, "pmm_alloc_pages zeroed");
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        EXPECT_TRUE(page_is_zero(page), "page is zero");
+    }
+    pmm_free(&list);
+
+    for (size_t i = 0; i < alloc_count; i++) {
+        status = pmm_alloc_page(0, &page);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc single page");
+        memset(paddr_to_physmap(page->paddr()), 0xa5, PAGE_SIZE);
+        pmm_free_page(page);
+
+        status = pmm_alloc_page(PMM_ALLOC_FLAG_ZEROED, &page);
+        ASSERT_EQ(ZX_OK, status, "pmm_alloc single page zeroed");
+        EXPECT_TRUE(page_is_zero(page), "page is zero");
+        pmm_free_page(page);
+    }
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -324,6 +462,38 @@ static bool vmaspace_alloc_smoke_test() {
     END_TEST;
 }
 
+// Allocates many regions in an address space with ASLR, which places them at
+// random, and checks that none of them overlap.
+static bool vmaspace_random_alloc_test() {
+    BEGIN_TEST;
+    auto aspace = VmAspace::Create(0, "test aspace3");
+    ASSERT_NE(nullptr, aspace, "VmAspace::Create pointer");
+
+    static const size_t kCount = 64;
+    vaddr_t bases[kCount];
+    for (size_t i = 0; i < kCount; i++) {
+        void* ptr;
+        auto err = aspace->Alloc("test", PAGE_SIZE * (i % 4 + 1), &ptr, 0, 0, kArchRwFlags);
+        ASSERT_EQ(ZX_OK, err, "allocating region\n");
+        bases[i] = reinterpret_cast<vaddr_t>(ptr);
+        EXPECT_TRUE(bases[i] >= aspace->base() &&
+                        bases[i] - aspace->base() + PAGE_SIZE * (i % 4 + 1) <= aspace->size(),
+                    "region outside of aspace\n");
+    }
+
+    for (size_t i = 0; i < kCount; i++) {
+        const vaddr_t end_i = bases[i] + PAGE_SIZE * (i % 4 + 1);
+        for (size_t j = i + 1; j < kCount; j++) {
+            const vaddr_t end_j = bases[j] + PAGE_SIZE * (j % 4 + 1);
+            EXPECT_TRUE(end_i <= bases[j] || end_j <= bases[i], "regions overlap\n");
+        }
+    }
+
+    auto err = aspace->Destroy();
+    EXPECT_EQ(ZX_OK, err, "VmAspace::Destroy");
+    END_TEST;
+}
+
 // Doesn't do anything, just prints all aspaces.
 // Should be run after all other tests so that people can manually comb
 // through the output for leaked test aspaces.
@@ -964,6 +1134,280 @@ static bool vmo_lookup_test() {
     END_TEST;
 }
 
+// Committed pages that only hold zeros should go back to the pmm.
+static bool vmo_reclaim_zero_pages_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    uint64_t committed;
+    status = vmo->CommitRange(0, alloc_size, &committed);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> a(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    ASSERT_TRUE(ac.check(), "");
+    fill_region(7, a.get(), PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, vmo->Write(a.get(), PAGE_SIZE, PAGE_SIZE), "writing object\n");
+
+    // kernel objects are never touched
+    EXPECT_EQ(0u, vmo->ReclaimZeroPages(), "kernel object skipped\n");
+    EXPECT_EQ(4u, vmo->AllocatedPages(), "all pages committed\n");
+
+    vmo->set_user_id(1);
+    EXPECT_EQ(3u, vmo->ReclaimZeroPages(), "zero pages reclaimed\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "written page kept\n");
+
+    fbl::Array<uint8_t> b(new (&ac) uint8_t[alloc_size], alloc_size);
+    ASSERT_TRUE(ac.check(), "");
+    EXPECT_EQ(ZX_OK, vmo->Read(b.get(), 0, alloc_size), "reading object\n");
+    EXPECT_TRUE(test_region(7, b.get() + PAGE_SIZE, PAGE_SIZE), "written page intact\n");
+    for (size_t i = 0; i < PAGE_SIZE; i++) {
+        if (b[i] != 0) {
+            EXPECT_EQ(0u, b[i], "reclaimed page reads as zero\n");
+            break;
+        }
+    }
+
+    END_TEST;
+}
+
+// Unlocked discardable objects lose pages nobody touched since the last pass.
+static bool vmo_discardable_evict_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, VmObjectPaged::kDiscardable,
+                                               alloc_size, &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    uint64_t committed;
+    status = vmo->CommitRange(0, alloc_size, &committed);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+
+    // created locked
+    EXPECT_EQ(0u, vmo->EvictPages(SIZE_MAX), "locked object kept\n");
+    EXPECT_EQ(ZX_OK, vmo->UnlockDiscardable(), "unlock\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, vmo->UnlockDiscardable(), "unlock twice\n");
+
+    // the first pass only ages the freshly committed pages
+    EXPECT_EQ(0u, vmo->EvictPages(SIZE_MAX), "first pass ages\n");
+
+    // touching a page gives it another pass
+    uint8_t byte;
+    EXPECT_EQ(ZX_OK, vmo->Read(&byte, 0, sizeof(byte)), "reading object\n");
+    EXPECT_EQ(3u, vmo->EvictPages(SIZE_MAX), "idle pages evicted\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "touched page kept\n");
+
+    bool was_discarded = false;
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&was_discarded), "lock\n");
+    EXPECT_TRUE(was_discarded, "discard reported\n");
+    EXPECT_EQ(0u, vmo->EvictPages(SIZE_MAX), "locked object kept\n");
+    EXPECT_EQ(ZX_OK, vmo->LockDiscardable(&was_discarded), "nested lock\n");
+    EXPECT_FALSE(was_discarded, "discard reported once\n");
+
+    fbl::RefPtr<VmObject> clone;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->CloneCOW(false, 0, alloc_size, false, &clone),
+              "discardable objects can't be cloned\n");
+
+    END_TEST;
+}
+
+// Counts the requests it gets instead of passing them anywhere.
+class TestPageSource final : public PageSource {
+public:
+    TestPageSource() : PageSource(1) {}
+
+    size_t requests = 0;
+    uint64_t last_offset = UINT64_MAX;
+
+protected:
+    zx_status_t SendRequest(uint64_t offset, uint64_t len) final {
+        requests++;
+        last_offset = offset;
+        return ZX_OK;
+    }
+};
+
+// Missing pages of a pager-backed object are requested once, and arrive by
+// moving pages out of another object.
+static bool vmo_page_source_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 2;
+    fbl::AllocChecker ac;
+    auto src = fbl::AdoptRef(new (&ac) TestPageSource());
+    ASSERT_TRUE(ac.check(), "");
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::CreateWithSource(PMM_ALLOC_FLAG_ANY, alloc_size, src,
+                                                         &vmo);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+    EXPECT_TRUE(vmo->is_pager_backed(), "pager backed\n");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, vmo->CommitRange(0, alloc_size, nullptr),
+              "commit not supported\n");
+
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        paddr_t pa;
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, vmo->GetPageLocked(PAGE_SIZE, 0, nullptr, nullptr, &pa),
+                  "lookup doesn't request\n");
+        EXPECT_EQ(ZX_ERR_SHOULD_WAIT,
+                  vmo->GetPageLocked(PAGE_SIZE, VMM_PF_FLAG_SW_FAULT, nullptr, nullptr, &pa),
+                  "fault requests\n");
+        EXPECT_EQ(ZX_ERR_SHOULD_WAIT,
+                  vmo->GetPageLocked(PAGE_SIZE, VMM_PF_FLAG_SW_FAULT, nullptr, nullptr, &pa),
+                  "fault again\n");
+    }
+    EXPECT_EQ(1u, src->requests, "one request per page\n");
+    EXPECT_EQ(PAGE_SIZE, src->last_offset, "request offset\n");
+    PageSource::CancelRequest();
+
+    fbl::RefPtr<VmObject> aux;
+    status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &aux);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+    fbl::Array<uint8_t> a(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    ASSERT_TRUE(ac.check(), "");
+    fill_region(7, a.get(), PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, aux->Write(a.get(), 0, PAGE_SIZE), "writing aux\n");
+
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    EXPECT_EQ(ZX_OK, aux->TakePages(0, PAGE_SIZE, &pages), "taking pages\n");
+    EXPECT_EQ(0u, aux->AllocatedPages(), "pages moved out\n");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, vmo->SupplyPages(2, PAGE_SIZE, PAGE_SIZE, &pages),
+              "wrong owner\n");
+    EXPECT_EQ(ZX_OK, vmo->SupplyPages(1, PAGE_SIZE, PAGE_SIZE, &pages), "supplying pages\n");
+    EXPECT_TRUE(list_is_empty(&pages), "pages consumed\n");
+
+    // a resident page reads without a request
+    memset(a.get(), 0, PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, vmo->Read(a.get(), PAGE_SIZE, PAGE_SIZE), "reading supplied page\n");
+    EXPECT_TRUE(test_region(7, a.get(), PAGE_SIZE), "supplied contents\n");
+    EXPECT_EQ(1u, src->requests, "no further request\n");
+
+    // once detached, faults fail rather than wait
+    src->Detach();
+    {
+        Guard<fbl::Mutex> guard{vmo->lock()};
+        paddr_t pa;
+        EXPECT_EQ(ZX_ERR_BAD_STATE,
+                  vmo->GetPageLocked(0, VMM_PF_FLAG_SW_FAULT, nullptr, nullptr, &pa),
+                  "detached source\n");
+    }
+
+    END_TEST;
+}
+
+// An interior clone that loses its handle should fold into its only child
+// without changing what the child sees.
+static bool vmo_clone_collapse_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> root;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &root);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> a(new (&ac) uint8_t[alloc_size], alloc_size);
+    ASSERT_TRUE(ac.check(), "");
+    fill_region(1, a.get(), alloc_size);
+    EXPECT_EQ(ZX_OK, root->Write(a.get(), 0, alloc_size), "writing root\n");
+
+    // the middle clone gets a private copy of its first page
+    fbl::RefPtr<VmObject> middle;
+    status = root->CloneCOW(false, 0, alloc_size, false, &middle);
+    ASSERT_EQ(ZX_OK, status, "cloning root\n");
+    middle->set_user_id(2);
+    fill_region(2, a.get(), PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, middle->Write(a.get(), 0, PAGE_SIZE), "writing middle\n");
+
+    fbl::RefPtr<VmObject> leaf;
+    status = middle->CloneCOW(false, 0, alloc_size, false, &leaf);
+    ASSERT_EQ(ZX_OK, status, "cloning middle\n");
+    leaf->set_user_id(3);
+
+    // drop the last user of the middle clone, which collapses it into the leaf
+    middle->SetChildObserver(nullptr);
+    EXPECT_EQ(0u, middle->num_children(), "middle clone collapsed\n");
+    EXPECT_EQ(0u, middle->AllocatedPages(), "middle clone drained\n");
+    EXPECT_EQ(1u, leaf->AllocatedPages(), "page moved to leaf\n");
+    EXPECT_EQ(1u, root->num_children(), "leaf hangs off the root\n");
+
+    fbl::Array<uint8_t> b(new (&ac) uint8_t[alloc_size], alloc_size);
+    ASSERT_TRUE(ac.check(), "");
+    EXPECT_EQ(ZX_OK, leaf->Read(b.get(), 0, alloc_size), "reading leaf\n");
+    EXPECT_TRUE(test_region(2, b.get(), PAGE_SIZE), "leaf keeps middle's page\n");
+    fill_region(1, a.get(), alloc_size);
+    EXPECT_EQ(0, memcmp(b.get() + PAGE_SIZE, a.get() + PAGE_SIZE, alloc_size - PAGE_SIZE),
+              "leaf reads through to the root\n");
+
+    // writes to the root stay visible through pages the leaf never copied
+    fill_region(3, a.get(), PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, root->Write(a.get(), PAGE_SIZE, PAGE_SIZE), "writing root\n");
+    EXPECT_EQ(ZX_OK, leaf->Read(b.get(), PAGE_SIZE, PAGE_SIZE), "reading leaf\n");
+    EXPECT_TRUE(test_region(3, b.get(), PAGE_SIZE), "leaf sees root write\n");
+
+    END_TEST;
+}
+
+// A snapshot keeps what the root held when it was taken, however the root
+// changes afterwards.
+static bool vmo_clone_snapshot_test() {
+    BEGIN_TEST;
+
+    static const size_t alloc_size = PAGE_SIZE * 4;
+    fbl::RefPtr<VmObject> root;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, 0u, alloc_size, &root);
+    ASSERT_EQ(ZX_OK, status, "vmobject creation\n");
+
+    // leave the last page uncommitted
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> a(new (&ac) uint8_t[alloc_size], alloc_size);
+    ASSERT_TRUE(ac.check(), "");
+    fill_region(1, a.get(), alloc_size);
+    EXPECT_EQ(ZX_OK, root->Write(a.get(), 0, alloc_size - PAGE_SIZE), "writing root\n");
+
+    fbl::RefPtr<VmObject> snapshot;
+    status = root->CloneSnapshot(0, alloc_size, false, &snapshot);
+    ASSERT_EQ(ZX_OK, status, "snapshotting root\n");
+    EXPECT_EQ(0u, snapshot->AllocatedPages(), "snapshot starts empty\n");
+
+    // a snapshot of a clone can't be kept
+    fbl::RefPtr<VmObject> nested;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, snapshot->CloneSnapshot(0, alloc_size, false, &nested),
+              "snapshotting a clone\n");
+
+    // overwrite the first page and the uncommitted one, and drop the second
+    fill_region(2, a.get(), PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, root->Write(a.get(), 0, PAGE_SIZE), "writing root\n");
+    EXPECT_EQ(ZX_OK, root->Write(a.get(), alloc_size - PAGE_SIZE, PAGE_SIZE), "writing root\n");
+    EXPECT_EQ(ZX_OK, root->DecommitRange(PAGE_SIZE, PAGE_SIZE, nullptr), "decommitting root\n");
+    EXPECT_EQ(3u, snapshot->AllocatedPages(), "one page preserved per change\n");
+
+    fbl::Array<uint8_t> b(new (&ac) uint8_t[alloc_size], alloc_size);
+    ASSERT_TRUE(ac.check(), "");
+    EXPECT_EQ(ZX_OK, snapshot->Read(b.get(), 0, alloc_size), "reading snapshot\n");
+    fill_region(1, a.get(), alloc_size);
+    EXPECT_EQ(0, memcmp(b.get(), a.get(), alloc_size - PAGE_SIZE), "snapshot unchanged\n");
+    memset(a.get(), 0, PAGE_SIZE);
+    EXPECT_EQ(0, memcmp(b.get() + alloc_size - PAGE_SIZE, a.get(), PAGE_SIZE),
+              "uncommitted page still reads zeros\n");
+
+    // only the first change to a page costs a copy
+    fill_region(3, a.get(), PAGE_SIZE);
+    EXPECT_EQ(ZX_OK, root->Write(a.get(), 0, PAGE_SIZE), "writing root\n");
+    EXPECT_EQ(3u, snapshot->AllocatedPages(), "page already preserved\n");
+    EXPECT_EQ(ZX_OK, root->Read(b.get(), 0, PAGE_SIZE), "reading root\n");
+    EXPECT_TRUE(test_region(3, b.get(), PAGE_SIZE), "root sees its own write\n");
+
+    END_TEST;
+}
+
 // TODO(ZX-1431): The ARM code's error codes are always ZX_ERR_INTERNAL, so
 // special case that.
 #if ARCH_ARM64
@@ -1040,6 +1484,117 @@ static bool arch_noncontiguous_map() {
     END_TEST;
 }
 
+// Maps a large page sized, aligned physical run and checks that unmapping and
+// reprotecting single pages inside it leave the rest of the run mapped.
+static bool arch_large_page_split_test() {
+    BEGIN_TEST;
+
+    static const size_t large_size = 1UL << 21;
+    static const size_t count = large_size / PAGE_SIZE;
+    list_node list = LIST_INITIAL_VALUE(list);
+    paddr_t pa;
+    zx_status_t status = pmm_alloc_contiguous(count, 0, 21, &pa, &list);
+    ASSERT_EQ(ZX_OK, status, "large page alloc");
+
+    {
+        ArchVmAspace aspace;
+        status = aspace.Init(USER_ASPACE_BASE, USER_ASPACE_SIZE, 0);
+        ASSERT_EQ(ZX_OK, status, "failed to init aspace\n");
+
+        const uint flags = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE;
+        vaddr_t base = ROUNDUP(USER_ASPACE_BASE, large_size) + large_size;
+        size_t mapped;
+        status = aspace.MapContiguous(base, pa, count, flags, &mapped);
+        ASSERT_EQ(ZX_OK, status, "failed large map\n");
+        EXPECT_EQ(count, mapped, "weird large map\n");
+
+        status = aspace.Unmap(base + 10 * PAGE_SIZE, 1, &mapped);
+        EXPECT_EQ(ZX_OK, status, "failed partial unmap\n");
+        status = aspace.Protect(base + 20 * PAGE_SIZE, 1, ARCH_MMU_FLAG_PERM_READ);
+        EXPECT_EQ(ZX_OK, status, "failed partial protect\n");
+
+        for (size_t i = 0; i < count; ++i) {
+            paddr_t paddr;
+            uint mmu_flags;
+            status = aspace.Query(base + i * PAGE_SIZE, &paddr, &mmu_flags);
+            if (i == 10) {
+                EXPECT_EQ(ZX_ERR_NOT_FOUND, status, "page still mapped\n");
+                continue;
+            }
+            EXPECT_EQ(ZX_OK, status, "page lost by split\n");
+            EXPECT_EQ(pa + i * PAGE_SIZE, paddr, "bad split mapping\n");
+            EXPECT_EQ(i == 20 ? ARCH_MMU_FLAG_PERM_READ : flags, mmu_flags,
+                      "bad split flags\n");
+        }
+
+        status = aspace.Destroy();
+        EXPECT_EQ(ZX_OK, status, "failed to destroy aspace\n");
+    }
+
+    pmm_free(&list);
+
+    END_TEST;
+}
+
+// Populates a page list sparsely across a huge offset range and checks that
+// lookups, ordered range walks, gap walks and range removal agree.
+static bool vm_page_list_sparse_test() {
+    BEGIN_TEST;
+
+    static const uint64_t kOffsets[] = {
+        0, PAGE_SIZE, 17 * PAGE_SIZE, 1ull << 30, (1ull << 40) + PAGE_SIZE, 1ull << 47,
+    };
+    vm_page_t pages[fbl::count_of(kOffsets)] = {};
+
+    VmPageList pl;
+    for (size_t i = 0; i < fbl::count_of(kOffsets); i++) {
+        EXPECT_EQ(ZX_OK, pl.AddPage(&pages[i], kOffsets[i]), "add page");
+    }
+    EXPECT_EQ(ZX_ERR_ALREADY_EXISTS, pl.AddPage(&pages[0], kOffsets[0]), "double add");
+    EXPECT_EQ(fbl::count_of(kOffsets), pl.page_count(), "page count");
+
+    for (size_t i = 0; i < fbl::count_of(kOffsets); i++) {
+        EXPECT_EQ(&pages[i], pl.GetPage(kOffsets[i]), "get page");
+    }
+    EXPECT_NULL(pl.GetPage(2 * PAGE_SIZE), "get missing page");
+    EXPECT_NULL(pl.GetPage(1ull << 50), "get page past the tree");
+
+    // pages in a range come back in offset order
+    size_t seen = 1;
+    pl.ForEveryPageInRange([&](const vm_page_t* p, uint64_t off) {
+        EXPECT_EQ(kOffsets[seen], off, "range walk offset");
+        EXPECT_EQ(&pages[seen], p, "range walk page");
+        seen++;
+        return ZX_ERR_NEXT;
+    }, PAGE_SIZE, 1ull << 47);
+    EXPECT_EQ(fbl::count_of(kOffsets) - 1, seen, "range walk count");
+
+    // gaps are the complement of the pages
+    uint64_t gap_pages = 0;
+    pl.ForEveryGapInRange([&](uint64_t start, uint64_t end) {
+        EXPECT_NULL(pl.GetPage(start), "gap start has no page");
+        gap_pages += (end - start) / PAGE_SIZE;
+        return ZX_ERR_NEXT;
+    }, 0, 32 * PAGE_SIZE);
+    EXPECT_EQ(29u, gap_pages, "gap count");
+
+    // remove everything from the second page up and check what's left
+    list_node removed = LIST_INITIAL_VALUE(removed);
+    EXPECT_EQ(fbl::count_of(kOffsets) - 1, pl.RemovePages(PAGE_SIZE, UINT64_MAX & ~(PAGE_SIZE - 1), &removed),
+              "remove pages");
+    EXPECT_EQ(fbl::count_of(kOffsets) - 1, list_length(&removed), "removed list length");
+    EXPECT_EQ(&pages[0], pl.GetPage(0), "first page survives");
+    EXPECT_NULL(pl.GetPage(1ull << 30), "removed page is gone");
+    EXPECT_FALSE(pl.IsEmpty(), "list not empty");
+    EXPECT_EQ(1u, pl.page_count(), "page count after range removal");
+
+    EXPECT_EQ(1u, pl.RemovePages(0, PAGE_SIZE, &removed), "remove last page");
+    EXPECT_TRUE(pl.IsEmpty(), "list empty");
+    EXPECT_EQ(0u, pl.page_count(), "page count when empty");
+
+    END_TEST;
+}
+
 // Use the function name as the test name
 #define VM_UNITTEST(fname) UNITTEST(#fname, fname)
 
@@ -1049,6 +1604,10 @@ VM_UNITTEST(pmm_smoke_test)
 //VM_UNITTEST(pmm_large_alloc_test)
 //VM_UNITTEST(pmm_oversized_alloc_test)
 VM_UNITTEST(pmm_alloc_contiguous_one_test)
+VM_UNITTEST(pmm_alloc_contiguous_aligned_test)
+VM_UNITTEST(pmm_arena_contiguous_fragmented_test)
+VM_UNITTEST(pmm_alloc_range_cached_page_test)
+VM_UNITTEST(pmm_alloc_zeroed_test)
 VM_UNITTEST(vmm_alloc_smoke_test)
 VM_UNITTEST(vmm_alloc_contiguous_smoke_test)
 VM_UNITTEST(multiple_regions_test)
@@ -1058,6 +1617,7 @@ VM_UNITTEST(vmm_alloc_contiguous_missing_flag_commit_fails)
 VM_UNITTEST(vmm_alloc_contiguous_zero_size_fails)
 VM_UNITTEST(vmaspace_create_smoke_test)
 VM_UNITTEST(vmaspace_alloc_smoke_test)
+VM_UNITTEST(vmaspace_random_alloc_test)
 VM_UNITTEST(vmo_create_test)
 VM_UNITTEST(vmo_pin_test)
 VM_UNITTEST(vmo_multiple_pin_test)
@@ -1074,7 +1634,14 @@ VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
+VM_UNITTEST(vmo_clone_collapse_test)
+VM_UNITTEST(vmo_clone_snapshot_test)
+VM_UNITTEST(vmo_reclaim_zero_pages_test)
+VM_UNITTEST(vmo_discardable_evict_test)
+VM_UNITTEST(vmo_page_source_test)
+VM_UNITTEST(vm_page_list_sparse_test)
 VM_UNITTEST(arch_noncontiguous_map)
+VM_UNITTEST(arch_large_page_split_test)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
 UNITTEST_END_TESTCASE(vm_tests, "vmtests", "Virtual memory tests");
@@ -10,6 +10,7 @@
 #include <err.h>
 #include <inttypes.h>
 #include <kernel/mutex.h>
+#include <kernel/thread.h>
 #include <kernel/thread_lock.h>
 #include <lib/console.h>
 #include <lib/ktrace.h>
@@ -17,6 +18,7 @@
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -61,6 +63,22 @@ zx_status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
     // page fault it
     zx_status_t status = aspace->PageFault(addr, flags);
 
+    // The page has to come from a page source. Wait for it with the aspace lock
+    // dropped and fault again. A kernel fault taken while copying to or from
+    // user memory with a mutex held, such as a VMO lock, must not wait: that
+    // would block everyone else on the mutex behind the pager. The copy fails
+    // instead, and the request is left for the caller to wait on once it has
+    // dropped its locks; see PageSource::HasRequest().
+    while (status == ZX_ERR_SHOULD_WAIT) {
+        if (!(flags & VMM_PF_FLAG_USER) && get_current_thread()->mutexes_held > 0) {
+            break;
+        }
+        status = PageSource::WaitForRequest();
+        if (status == ZX_OK) {
+            status = aspace->PageFault(addr, flags);
+        }
+    }
+
     // If it's a user fault, dump info about process memory usage.
     // If it's a kernel fault, the kernel could possibly already
     // hold locks on VMOs, Aspaces, etc, so we can't safely do
@@ -0,0 +1,77 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "vm_priv.h"
+
+#include <fbl/ref_ptr.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <trace.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// Background scanner that looks for committed pages which were only ever
+// filled with zeros and hands them back to the pmm. Disabled unless
+// kernel.vm.zero-scan-interval is set.
+
+KCOUNTER(vm_zero_scan_passes, "kernel.vm.zero_scan.passes");
+
+namespace {
+
+// number of objects pulled off the global list per trip through its lock
+constexpr size_t kZeroScanBatch = 16;
+
+// seconds between passes over every object; 0 disables the scanner
+uint32_t zero_scan_interval;
+
+int zero_scan_thread(void*) {
+    for (;;) {
+        thread_sleep_relative(ZX_SEC(zero_scan_interval));
+
+        size_t reclaimed = 0;
+        fbl::RefPtr<VmObject> cursor;
+        for (;;) {
+            fbl::RefPtr<VmObject> batch[kZeroScanBatch];
+            size_t count = VmObject::TakeRefsAfter(cursor.get(), batch, kZeroScanBatch);
+            if (count == 0) {
+                break;
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                reclaimed += batch[i]->ReclaimZeroPages();
+            }
+
+            // hold on to the last one so the next batch can pick up after it
+            cursor = batch[count - 1];
+        }
+
+        kcounter_add(vm_zero_scan_passes, 1);
+        LTRACEF("reclaimed %zu zero pages\n", reclaimed);
+    }
+
+    return 0;
+}
+
+} // namespace
+
+static void vm_zero_scan_init(uint level) {
+    zero_scan_interval = cmdline_get_uint32("kernel.vm.zero-scan-interval", 0);
+    if (zero_scan_interval == 0) {
+        return;
+    }
+
+    thread_t* t = thread_create("zero-scan", zero_scan_thread, nullptr, LOW_PRIORITY);
+    if (!t) {
+        printf("VM: failed to create zero page scanner\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+LK_INIT_HOOK(vm_zero_scan, &vm_zero_scan_init, LK_INIT_LEVEL_LAST);
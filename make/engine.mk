@@ -27,12 +27,14 @@ ENABLE_INSTALL_SAMPLES ?= false
 ENABLE_NEW_BOOTDATA := true
 ENABLE_LOCK_DEP ?= false
 ENABLE_LOCK_DEP_TESTS ?= $(ENABLE_LOCK_DEP)
+ENABLE_LOCK_PROFILING ?= false
 DISABLE_UTEST ?= false
 ENABLE_ULIB_ONLY ?= false
 USE_ASAN ?= false
 USE_SANCOV ?= false
 USE_PROFILE ?= false
 USE_LTO ?= false
+USE_HARDENED_MALLOC ?= false
 USE_THINLTO ?= $(USE_LTO)
 USE_CLANG ?= $(firstword $(filter true,$(call TOBOOL,$(USE_ASAN)) \
 	     		 	       $(call TOBOOL,$(USE_SANCOV)) \
@@ -421,6 +423,15 @@ KERNEL_DEFINES += WITH_LOCK_DEP=1
 KERNEL_DEFINES += LOCK_DEP_ENABLE_VALIDATION=1
 endif
 
+# Kernel lock contention profiling. This builds on lock dependency tracking,
+# which must be enabled too.
+ifeq ($(call TOBOOL,$(ENABLE_LOCK_PROFILING)),true)
+ifneq ($(call TOBOOL,$(ENABLE_LOCK_DEP)),true)
+$(error ENABLE_LOCK_PROFILING requires ENABLE_LOCK_DEP)
+endif
+KERNEL_DEFINES += LOCK_DEP_ENABLE_PROFILING=1
+endif
+
 # Kernel lock dependency tracking tests. By default this is enabled when
 # tracking is enabled, but can also be eanbled independently to assess whether
 # the tests build and *fail correctly* when lockdep is disabled.
@@ -291,6 +291,9 @@ struct Driver {
     // Binding size in number of bytes, not number of entries
     // TODO: Change it to number of entries
     uint32_t binding_size = 0;
+    // The protocol which |binding| requires of a device, as found by
+    // dc_bind_protocol(), or 0 if it could not tell.
+    uint32_t bind_protocol = 0;
     uint32_t flags = 0;
     zx::vmo dso_vmo;
 
@@ -307,6 +310,11 @@ struct Driver {
 
 #define DRIVER_NAME_LEN_MAX 64
 
+// This driver is bound in the devhost of a device which asks for its
+// children to be isolated, rather than behind a proxy in a new devhost,
+// so that its calls to the device's protocol need no rpc
+#define DRIVER_FLAG_COLOCATE  0x01
+
 zx_status_t devfs_publish(Device* parent, Device* dev);
 void devfs_unpublish(Device* dev);
 void devfs_advertise(Device* dev);
@@ -317,9 +325,16 @@ void coordinator();
 
 void load_driver(const char* path,
                  void (*func)(Driver* drv, const char* version));
+// Adds the drivers in |path|, in directory order.  If |cache_dso|, the DSO
+// VMO of each driver is loaded into Driver::dso_vmo as well.
 void find_loadable_drivers(const char* path,
-                           void (*func)(Driver* drv, const char* version));
+                           void (*func)(Driver* drv, const char* version),
+                           bool cache_dso = false);
+zx_status_t load_vmo(const char* libname, zx::vmo* out_vmo);
 
+// Returns the value of BIND_PROTOCOL which any device matched by the |count|
+// instructions at |binding| must have, or 0 if there isn't one.
+uint32_t dc_bind_protocol(const zx_bind_inst_t* binding, size_t count);
 bool dc_is_bindable(const Driver* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind);
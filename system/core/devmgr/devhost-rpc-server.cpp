@@ -341,6 +341,11 @@ static zx_status_t fidl_directory_watch(void* ctx, uint32_t mask, uint32_t optio
     return fuchsia_io_DirectoryWatch_reply(txn, ZX_ERR_NOT_SUPPORTED);
 }
 
+static zx_status_t fidl_directory_readdirents_plus(void* ctx, uint64_t max_out,
+                                                   fidl_txn_t* txn) {
+    return fuchsia_io_DirectoryReadDirentsPlus_reply(txn, ZX_ERR_NOT_SUPPORTED, nullptr, 0);
+}
+
 static const fuchsia_io_Directory_ops_t kDirectoryOps = []() {
     fuchsia_io_Directory_ops_t ops;
     ops.Open = fidl_directory_open;
@@ -351,6 +356,7 @@ static const fuchsia_io_Directory_ops_t kDirectoryOps = []() {
     ops.Rename = fidl_directory_rename;
     ops.Link = fidl_directory_link;
     ops.Watch = fidl_directory_watch;
+    ops.ReadDirentsPlus = fidl_directory_readdirents_plus;
     return ops;
 }();
 
@@ -551,6 +557,11 @@ static zx_status_t fidl_file_getvmo(void* ctx, uint32_t flags, fidl_txn_t* txn)
     return fuchsia_io_FileGetVmo_reply(txn, ZX_ERR_NOT_SUPPORTED, ZX_HANDLE_INVALID);
 }
 
+static zx_status_t fidl_file_getbuffer(void* ctx, fidl_txn_t* txn) {
+    return fuchsia_io_FileGetBuffer_reply(txn, ZX_ERR_NOT_SUPPORTED, ZX_HANDLE_INVALID, 0,
+                                          ZX_HANDLE_INVALID);
+}
+
 static const fuchsia_io_File_ops_t kFileOps = []() {
     fuchsia_io_File_ops_t ops;
     ops.Read = fidl_file_read;
@@ -562,6 +573,7 @@ static const fuchsia_io_File_ops_t kFileOps = []() {
     ops.GetFlags = fidl_file_getflags;
     ops.SetFlags = fidl_file_setflags;
     ops.GetVmo = fidl_file_getvmo;
+    ops.GetBuffer = fidl_file_getbuffer;
     return ops;
 }();
 
@@ -646,10 +658,10 @@ zx_status_t devhost_fidl_handler(fidl_msg_t* msg, fidl_txn_t* txn, void* cookie)
         hdr->ordinal <= fuchsia_io_NodeIoctlOrdinal) {
         return fuchsia_io_Node_dispatch(cookie, txn, msg, &kNodeOps);
     } else if (hdr->ordinal >= fuchsia_io_FileReadOrdinal &&
-               hdr->ordinal <= fuchsia_io_FileGetVmoOrdinal) {
+               hdr->ordinal <= fuchsia_io_FileGetBufferOrdinal) {
         return fuchsia_io_File_dispatch(cookie, txn, msg, &kFileOps);
     } else if (hdr->ordinal >= fuchsia_io_DirectoryOpenOrdinal &&
-               hdr->ordinal <= fuchsia_io_DirectoryWatchOrdinal) {
+               hdr->ordinal <= fuchsia_io_DirectoryReadDirentsPlusOrdinal) {
         return fuchsia_io_Directory_dispatch(cookie, txn, msg, &kDirectoryOps);
     } else if (hdr->ordinal >= fuchsia_io_DirectoryAdminMountOrdinal &&
                hdr->ordinal <= fuchsia_io_DirectoryAdminGetDevicePathOrdinal) {
@@ -140,6 +140,29 @@ next_instruction:
     return false;
 }
 
+uint32_t dc_bind_protocol(const zx_bind_inst_t* binding, size_t count) {
+    // Every instruction before the first GOTO or MATCH runs in order unless
+    // the program aborts, so an abort there unless BIND_PROTOCOL is some
+    // value means no device with another protocol can match.
+    for (const zx_bind_inst_t* ip = binding; ip < binding + count; ip++) {
+        uint32_t inst = ip->op;
+        switch (BINDINST_OP(inst)) {
+        case OP_ABORT:
+            if ((BINDINST_CC(inst) == COND_NE) && (BINDINST_PB(inst) == BIND_PROTOCOL)) {
+                return ip->arg;
+            }
+            break;
+        case OP_SET:
+        case OP_CLEAR:
+        case OP_LABEL:
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
+
 bool dc_is_bindable(const Driver* drv, uint32_t protocol_id,
                     zx_device_prop_t* props, size_t prop_count,
                     bool autobind) {
@@ -150,10 +173,15 @@ bool dc_is_bindable(const Driver* drv, uint32_t protocol_id,
     ctx.props = props;
     ctx.end = props + prop_count;
     ctx.protocol_id = protocol_id;
+    ctx.autobind = autobind ? 1 : 0;
+    // Most drivers are for one protocol, so most can be ruled out without
+    // running their programs.
+    if ((drv->bind_protocol != 0) && (dev_get_prop(&ctx, BIND_PROTOCOL) != drv->bind_protocol)) {
+        return false;
+    }
     ctx.binding = drv->binding.get();
     ctx.binding_size = drv->binding_size;
     ctx.name = drv->name.c_str();
-    ctx.autobind = autobind ? 1 : 0;
     return is_bindable(&ctx);
 }
 
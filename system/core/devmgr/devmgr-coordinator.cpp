@@ -320,7 +320,7 @@ static const Driver* libname_to_driver(const char* libname) {
     return nullptr;
 }
 
-static zx_status_t load_vmo(const char* libname, zx::vmo* out_vmo) {
+zx_status_t load_vmo(const char* libname, zx::vmo* out_vmo) {
     int fd = open(libname, O_RDONLY);
     if (fd < 0) {
         log(ERROR, "devcoord: cannot open driver '%s'\n", libname);
@@ -1749,7 +1749,10 @@ static zx_status_t dc_attempt_bind(const Driver* drv, Device* dev) {
     if ((dev->flags & DEV_CTX_BOUND) && (!(dev->flags & DEV_CTX_MULTI_BIND))) {
         return ZX_ERR_BAD_STATE;
     }
-    if (!(dev->flags & DEV_CTX_MUST_ISOLATE)) {
+    // A colocated driver is bound as if the busdev were a plain device,
+    // unless the busdev is one of the root devices, which have no devhost
+    bool colocate = (drv->flags & DRIVER_FLAG_COLOCATE) && (dev->host != nullptr);
+    if (!(dev->flags & DEV_CTX_MUST_ISOLATE) || colocate) {
         // non-busdev is pretty simple
         if (dev->host == nullptr) {
             log(ERROR, "devcoord: can't bind to device without devhost\n");
@@ -2219,7 +2222,8 @@ static port_handler_t control_handler = []() {
 static void dc_driver_added_sys(Driver* drv, const char* version) {
     log(INFO, "devmgr: adding system driver '%s' '%s'\n", drv->name.c_str(), drv->libname.c_str());
 
-    if (load_vmo(drv->libname.c_str(), &drv->dso_vmo)) {
+    // The DSO is normally cached by find_loadable_drivers().
+    if (!drv->dso_vmo.is_valid() && load_vmo(drv->libname.c_str(), &drv->dso_vmo)) {
         log(ERROR, "devmgr: system driver '%s' '%s' could not cache DSO\n", drv->name.c_str(),
             drv->libname.c_str());
     }
@@ -2232,8 +2236,8 @@ static void dc_driver_added_sys(Driver* drv, const char* version) {
 }
 
 static int system_driver_loader(void* arg) {
-    find_loadable_drivers("/system/driver", dc_driver_added_sys);
-    find_loadable_drivers("/system/lib/driver", dc_driver_added_sys);
+    find_loadable_drivers("/system/driver", dc_driver_added_sys, true);
+    find_loadable_drivers("/system/lib/driver", dc_driver_added_sys, true);
     port_queue(&dc_port, &control_handler, CTL_ADD_SYSTEM);
     return 0;
 }
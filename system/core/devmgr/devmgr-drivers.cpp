@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include "devmgr.h"
@@ -14,6 +15,9 @@
 #include "log.h"
 
 #include <driver-info/driver-info.h>
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <fbl/vector.h>
 
 #include <zircon/driver/binding.h>
 #include <zxcpp/new.h>
@@ -24,6 +28,9 @@ struct AddContext {
     const char* libname;
     using Func = void(*)(Driver* drv, const char* version);
     Func func;
+    // A DSO VMO already loaded for |libname|, if any, which is handed to
+    // the first driver found in it.
+    zx::vmo* dso_vmo;
 };
 
 static bool is_driver_disabled(const char* name) {
@@ -33,6 +40,13 @@ static bool is_driver_disabled(const char* name) {
     return getenv_bool(opt, false);
 }
 
+static bool is_driver_colocated(const char* name) {
+    // driver.<driver_name>.colocate
+    char opt[16 + DRIVER_NAME_LEN_MAX];
+    snprintf(opt, 16 + DRIVER_NAME_LEN_MAX, "driver.%s.colocate", name);
+    return getenv_bool(opt, false);
+}
+
 static void found_driver(zircon_driver_note_payload_t* note,
                          const zx_bind_inst_t* bi, void* cookie) {
     auto context = static_cast<const AddContext*>(cookie);
@@ -71,9 +85,16 @@ static void found_driver(zircon_driver_note_payload_t* note,
     memcpy(binding.get(), bi, bindlen);
     drv->binding.reset(binding.release());
     drv->binding_size = static_cast<uint32_t>(bindlen);
+    drv->bind_protocol = dc_bind_protocol(drv->binding.get(), note->bindcount);
 
     drv->libname.Set(libname);
     drv->name.Set(note->name);
+    if (is_driver_colocated(note->name)) {
+        drv->flags |= DRIVER_FLAG_COLOCATE;
+    }
+    if (context->dso_vmo != nullptr) {
+        drv->dso_vmo = fbl::move(*context->dso_vmo);
+    }
 
 #if VERBOSE_DRIVER_LOAD
     printf("found driver: %s\n", (char*) cookie);
@@ -90,13 +111,79 @@ static void found_driver(zircon_driver_note_payload_t* note,
     context->func(drv.release(), note->version);
 }
 
+// The number of threads, including the caller, which read driver files in
+// find_loadable_drivers().
+static constexpr size_t kDriverScanThreads = 4;
+
+namespace {
+
+// A driver note read from a file by a scan thread, to be added on the
+// calling thread.
+struct FoundNote {
+    zircon_driver_note_payload_t note;
+    fbl::unique_ptr<zx_bind_inst_t[]> binding;
+};
+
+struct DriverFile {
+    fbl::String libname;
+    fbl::Vector<FoundNote> notes;
+    zx::vmo dso_vmo;
+    bool opened = false;
+    zx_status_t status = ZX_OK;
+};
+
+struct ScanContext {
+    fbl::Vector<DriverFile>* files;
+    bool cache_dso;
+    fbl::atomic<size_t> next;
+};
+
+} // namespace
+
+static void copy_note(zircon_driver_note_payload_t* note,
+                      const zx_bind_inst_t* bi, void* cookie) {
+    auto file = static_cast<DriverFile*>(cookie);
+    FoundNote found;
+    found.note = *note;
+    found.binding = fbl::make_unique<zx_bind_inst_t[]>(note->bindcount);
+    if (found.binding == nullptr) {
+        return;
+    }
+    memcpy(found.binding.get(), bi, note->bindcount * sizeof(zx_bind_inst_t));
+    file->notes.push_back(fbl::move(found));
+}
+
+// Reads the driver notes, and if asked the DSO, of each file not yet claimed
+// by another scan thread.  Nothing here may touch coordinator state.
+static int scan_driver_files(void* arg) {
+    auto ctx = static_cast<ScanContext*>(arg);
+    size_t n;
+    while ((n = ctx->next.fetch_add(1)) < ctx->files->size()) {
+        DriverFile* file = &(*ctx->files)[n];
+        int fd;
+        if ((fd = open(file->libname.c_str(), O_RDONLY)) < 0) {
+            continue;
+        }
+        file->opened = true;
+        file->status = di_read_driver_info(fd, file, copy_note);
+        close(fd);
+
+        if ((file->status == ZX_OK) && ctx->cache_dso && !file->notes.is_empty()) {
+            load_vmo(file->libname.c_str(), &file->dso_vmo);
+        }
+    }
+    return 0;
+}
+
 void find_loadable_drivers(const char* path,
-                           void (*func)(Driver* drv, const char* version)) {
+                           void (*func)(Driver* drv, const char* version),
+                           bool cache_dso) {
 
     DIR* dir = opendir(path);
     if (dir == nullptr) {
         return;
     }
+    fbl::Vector<DriverFile> files;
     struct dirent* de;
     while ((de = readdir(dir)) != nullptr) {
         if (de->d_name[0] == '.') {
@@ -110,24 +197,48 @@ void find_loadable_drivers(const char* path,
         if ((r < 0) || (r >= (int)sizeof(libname))) {
             continue;
         }
+        DriverFile file;
+        file.libname.Set(libname);
+        files.push_back(fbl::move(file));
+    }
+    closedir(dir);
+
+    // Opening and parsing each file, and cloning its VMO, is mostly waiting
+    // on the filesystem, so files are read by several threads at once.  The
+    // drivers are still added here, in directory order, so that the order
+    // of the driver lists does not depend on which thread finished first.
+    ScanContext ctx = { &files, cache_dso, {0} };
+    thrd_t threads[kDriverScanThreads - 1];
+    size_t thread_count = 0;
+    for (; (thread_count < fbl::count_of(threads)) &&
+           (thread_count + 1 < files.size()); thread_count++) {
+        if (thrd_create_with_name(&threads[thread_count], scan_driver_files, &ctx,
+                                  "driver-scan") != thrd_success) {
+            break;
+        }
+    }
+    scan_driver_files(&ctx);
+    for (size_t i = 0; i < thread_count; i++) {
+        thrd_join(threads[i], nullptr);
+    }
 
-        int fd;
-        if ((fd = openat(dirfd(dir), de->d_name, O_RDONLY)) < 0) {
+    for (auto& file : files) {
+        if (!file.opened) {
             continue;
         }
-        AddContext context = { libname, func };
-        zx_status_t status = di_read_driver_info(fd, &context, found_driver);
-        close(fd);
-
-        if (status) {
-            if (status == ZX_ERR_NOT_FOUND) {
-                printf("devcoord: no driver info in '%s'\n", libname);
+        if (file.status) {
+            if (file.status == ZX_ERR_NOT_FOUND) {
+                printf("devcoord: no driver info in '%s'\n", file.libname.c_str());
             } else {
-                printf("devcoord: error reading info from '%s'\n", libname);
+                printf("devcoord: error reading info from '%s'\n", file.libname.c_str());
             }
+            continue;
+        }
+        AddContext context = { file.libname.c_str(), func, &file.dso_vmo };
+        for (auto& found : file.notes) {
+            found_driver(&found.note, found.binding.get(), &context);
         }
     }
-    closedir(dir);
 }
 
 void load_driver(const char* path,
@@ -139,7 +250,7 @@ void load_driver(const char* path,
         return;
     }
 
-    AddContext context = { path, func };
+    AddContext context = { path, func, nullptr };
     zx_status_t status = di_read_driver_info(fd, &context, found_driver);
     close(fd);
 
@@ -33,28 +33,45 @@ static unsigned num_unacked = 0;
 // How long to wait between sending.
 static zx_duration_t send_delay = SEND_DELAY_SHORT;
 
+// Records are read from the debuglog in batches, and handed out one line at
+// a time.
+static uint8_t log_batch[16 * ZX_LOG_RECORD_MAX] __ALIGNED(8);
+static size_t log_batch_len;
+static size_t log_batch_off;
+
+static zx_log_record_t* next_log_record(void) {
+    if (log_batch_off >= log_batch_len) {
+        zx_status_t r = zx_debuglog_read(loghandle, ZX_LOG_READ_BATCH, log_batch,
+                                         sizeof(log_batch));
+        if (r <= 0) {
+            return NULL;
+        }
+        log_batch_len = r;
+        log_batch_off = 0;
+    }
+    zx_log_record_t* rec = (zx_log_record_t*)(log_batch + log_batch_off);
+    log_batch_off += ZX_LOG_RECORD_STRIDE(rec->datalen);
+    return rec;
+}
+
 static int get_log_line(char* out) {
-    char buf[ZX_LOG_RECORD_MAX + 1];
-    zx_log_record_t* rec = (zx_log_record_t*)buf;
-    for (;;) {
-        if (zx_debuglog_read(loghandle, 0, rec, ZX_LOG_RECORD_MAX) > 0) {
-            if (rec->datalen && (rec->data[rec->datalen - 1] == '\n')) {
-                rec->datalen--;
-            }
-            // records flagged for local display are ignored
-            if (rec->flags & ZX_LOG_LOCAL) {
-                continue;
-            }
-            rec->data[rec->datalen] = 0;
-            snprintf(out, MAX_LOG_LINE, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %s\n",
-                     (int)(rec->timestamp / 1000000000ULL),
-                     (int)((rec->timestamp / 1000000ULL) % 1000ULL),
-                     rec->pid, rec->tid, rec->data);
-            return strlen(out);
-        } else {
-            return 0;
+    zx_log_record_t* rec;
+    while ((rec = next_log_record()) != NULL) {
+        // records flagged for local display are ignored
+        if (rec->flags & ZX_LOG_LOCAL) {
+            continue;
         }
+        int datalen = rec->datalen;
+        if (datalen && (rec->data[datalen - 1] == '\n')) {
+            datalen--;
+        }
+        snprintf(out, MAX_LOG_LINE, "[%05d.%03d] %05" PRIu64 ".%05" PRIu64 "> %.*s\n",
+                 (int)(rec->timestamp / 1000000000ULL),
+                 (int)((rec->timestamp / 1000000ULL) % 1000ULL),
+                 rec->pid, rec->tid, datalen, rec->data);
+        return strlen(out);
     }
+    return 0;
 }
 
 int debuglog_init(void) {
@@ -67,6 +84,8 @@ int debuglog_init(void) {
 
     seqno = 1;
     pending = 0;
+    log_batch_len = 0;
+    log_batch_off = 0;
 
     return 0;
 }
@@ -27,6 +27,10 @@
 
 #define TFTP_TIMEOUT_SECS 1
 
+// Holds the blocks received after a lost one, so that the host only has to
+// send that one again, rather than the rest of its window.
+#define REORDER_BUF_SZ (256 * 1024)
+
 #define NB_IMAGE_PREFIX_LEN (strlen(NB_IMAGE_PREFIX))
 #define NB_FILENAME_PREFIX_LEN (strlen(NB_FILENAME_PREFIX))
 
@@ -67,6 +71,7 @@ typedef struct {
 
 static char tftp_session_scratch[SCRATCHSZ];
 char tftp_out_scratch[SCRATCHSZ];
+static uint8_t tftp_reorder_buf[REORDER_BUF_SZ];
 
 static size_t last_msg_size = 0;
 static tftp_session* session = NULL;
@@ -439,6 +444,7 @@ static void initialize_connection(const ip6_addr_t* saddr, uint16_t sport) {
         session = NULL;
         return;
     }
+    tftp_session_set_reorder_buffer(session, tftp_reorder_buf, sizeof(tftp_reorder_buf));
 
     // Initialize file interface
     tftp_file_interface file_ifc = {file_open_read, file_open_write,
@@ -263,6 +263,7 @@ zx_status_t IntelHDAStream::ProcessClientRequest(dispatcher::Channel* channel) {
         audio_proto::RingBufGetBufferReq    get_buffer;
         audio_proto::RingBufStartReq        start;
         audio_proto::RingBufStopReq         stop;
+        audio_proto::RingBufGetPositionBufferReq get_position_buffer;
     } req;
     // TODO(johngro) : How large is too large?
     static_assert(sizeof(req) <= 256, "Request buffer is too large to hold on the stack!");
@@ -305,6 +306,8 @@ zx_status_t IntelHDAStream::ProcessClientRequest(dispatcher::Channel* channel) {
     HANDLE_REQ(AUDIO_RB_CMD_GET_BUFFER,     get_buffer,     ProcessGetBufferLocked,    false);
     HANDLE_REQ(AUDIO_RB_CMD_START,          start,          ProcessStartLocked,        false);
     HANDLE_REQ(AUDIO_RB_CMD_STOP,           stop,           ProcessStopLocked,         false);
+    HANDLE_REQ(AUDIO_RB_CMD_GET_POSITION_BUFFER, get_position_buffer,
+               ProcessGetPositionBufferLocked, false);
     default:
         LOG(TRACE, "Unrecognized command ID 0x%04x\n", req.hdr.cmd);
         return ZX_ERR_INVALID_ARGS;
@@ -352,6 +355,7 @@ void IntelHDAStream::ProcessStreamIRQ() {
         msg.hdr.cmd = AUDIO_RB_POSITION_NOTIFY;
         msg.hdr.transaction_id = AUDIO_INVALID_TRANSACTION_ID;
         msg.ring_buffer_pos = REG_RD(&regs_->lpib);
+        position_buffer_.Update(msg.ring_buffer_pos, zx_clock_get_monotonic());
         irq_channel_->Write(&msg, sizeof(msg));
     }
 }
@@ -362,6 +366,7 @@ void IntelHDAStream::DeactivateLocked() {
     {
         fbl::AutoLock notif_lock(&notif_lock_);
         irq_channel_ = nullptr;
+        position_buffer_.Release();
     }
 
     // If we have a connection to a client, close it.
@@ -680,6 +685,7 @@ zx_status_t IntelHDAStream::ProcessStartLocked(const audio_proto::RingBufStartRe
         REG_SET_BITS(&regs_->ctl_sts.w, SET);
         hw_wmb();
         resp.start_time = zx_clock_get_monotonic();
+        position_buffer_.Update(0, resp.start_time);
     }
 
     // Success, we are now running.
@@ -701,6 +707,7 @@ zx_status_t IntelHDAStream::ProcessStopLocked(const audio_proto::RingBufStopReq&
             fbl::AutoLock notif_lock(&notif_lock_);
             ZX_DEBUG_ASSERT(irq_channel_ != nullptr);
             irq_channel_ = nullptr;
+            position_buffer_.Update(0, 0);
         }
 
         // Make sure that we have been stopped and that all interrupts have been acked.
@@ -714,6 +721,27 @@ zx_status_t IntelHDAStream::ProcessStopLocked(const audio_proto::RingBufStopReq&
     return channel_->Write(&resp, sizeof(resp));
 }
 
+zx_status_t IntelHDAStream::ProcessGetPositionBufferLocked(
+        const audio_proto::RingBufGetPositionBufferReq& req) {
+    audio_proto::RingBufGetPositionBufferResp resp = { };
+    resp.hdr = req.hdr;
+
+    // The IRQ thread publishes positions to the buffer from within the
+    // notification lock.
+    zx::vmo client_handle;
+    {
+        fbl::AutoLock notif_lock(&notif_lock_);
+        resp.result = position_buffer_.GetClientVmo(&client_handle);
+    }
+
+    if (resp.result != ZX_OK) {
+        LOG(TRACE, "Failed to create position buffer (res %d)\n", resp.result);
+        return channel_->Write(&resp, sizeof(resp));
+    }
+
+    return channel_->Write(&resp, sizeof(resp), fbl::move(client_handle));
+}
+
 void IntelHDAStream::ReleaseRingBufferLocked() {
     pinned_ring_buffer_.Unpin();
     memset(bdl_cpu_mem_.start(), 0, bdl_cpu_mem_.size());
@@ -15,6 +15,7 @@
 #include <zircon/thread_annotations.h>
 
 #include <audio-proto/audio-proto.h>
+#include <audio-proto-utils/position-buffer.h>
 #include <dispatcher-pool/dispatcher-channel.h>
 #include <intel-hda/utils/intel-hda-registers.h>
 #include <intel-hda/utils/utils.h>
@@ -86,6 +87,8 @@ private:
         TA_REQ(channel_lock_);
     zx_status_t ProcessStartLocked(const audio_proto::RingBufStartReq& req) TA_REQ(channel_lock_);
     zx_status_t ProcessStopLocked(const audio_proto::RingBufStopReq& req) TA_REQ(channel_lock_);
+    zx_status_t ProcessGetPositionBufferLocked(
+            const audio_proto::RingBufGetPositionBufferReq& req) TA_REQ(channel_lock_);
 
     // Release the client ring buffer (if one has been assigned)
     void ReleaseRingBufferLocked() TA_REQ(channel_lock_);
@@ -155,6 +158,7 @@ private:
     // State used by the IRQ thread to deliver position update notifications.
     fbl::Mutex notif_lock_ TA_ACQ_AFTER(channel_lock_);
     fbl::RefPtr<dispatcher::Channel> irq_channel_ TA_GUARDED(notif_lock_);
+    utils::PositionBuffer position_buffer_ TA_GUARDED(notif_lock_);
 };
 
 }  // namespace intel_hda
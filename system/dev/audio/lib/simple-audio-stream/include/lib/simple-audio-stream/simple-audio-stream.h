@@ -5,6 +5,7 @@
 #pragma once
 
 #include <audio-proto/audio-proto.h>
+#include <audio-proto-utils/position-buffer.h>
 #include <ddktl/device.h>
 #include <dispatcher-pool/dispatcher-channel.h>
 #include <dispatcher-pool/dispatcher-execution-domain.h>
@@ -239,8 +240,21 @@ class SimpleAudioStream : public SimpleAudioStreamBase,
     // NotifyPosition is always called from within the context of the execution
     // domain and not need to worry about any locking for the ring buffer
     // channel.
+    //
+    // The position is also published to the client's position buffer, if it
+    // has fetched one, as of the time of the call.
     zx_status_t NotifyPosition(const audio_proto::RingBufPositionNotify& notif);
 
+    // UpdatePosition - RingBuffer interface event
+    //
+    // Publish the ring buffer position as of |timestamp| to the client's
+    // position buffer without sending a notification.  May be called from any
+    // thread.  Drivers which can read their DMA position cheaply (from a
+    // register, for example) may call this more often than they send position
+    // notifications, allowing clients to keep very little audio in flight
+    // without waking up for each notification.
+    void UpdatePosition(uint32_t ring_buffer_pos, zx_time_t timestamp);
+
     // The execution domain
     fbl::RefPtr<dispatcher::ExecutionDomain> domain_;
 
@@ -322,10 +336,15 @@ class SimpleAudioStream : public SimpleAudioStreamBase,
     zx_status_t OnStop(dispatcher::Channel* channel, const audio_proto::RingBufStopReq& req)
         __TA_REQUIRES(domain_->token());
 
+    zx_status_t OnGetPositionBuffer(dispatcher::Channel* channel,
+                                    const audio_proto::RingBufGetPositionBufferReq& req)
+        __TA_REQUIRES(domain_->token());
+
     // Stream and ring buffer channel state.
     fbl::Mutex channel_lock_ __TA_ACQUIRED_AFTER(domain_->token());
     fbl::RefPtr<dispatcher::Channel> stream_channel_ __TA_GUARDED(channel_lock_);
     fbl::RefPtr<dispatcher::Channel> rb_channel_ __TA_GUARDED(channel_lock_);
+    utils::PositionBuffer position_buffer_ __TA_GUARDED(channel_lock_);
 
     // State used for protocol enforcement.
     bool rb_started_ __TA_GUARDED(domain_->token()) = false;
@@ -82,6 +82,8 @@ zx_status_t SimpleAudioStream::PublishInternal() {
 zx_status_t SimpleAudioStream::NotifyPosition(const audio_proto::RingBufPositionNotify& notif) {
     fbl::AutoLock channel_lock(&channel_lock_);
 
+    position_buffer_.Update(notif.ring_buffer_pos, zx_clock_get_monotonic());
+
     if (!expected_notifications_per_ring_.load() || (rb_channel_ == nullptr)) {
         return ZX_ERR_BAD_STATE;
     }
@@ -89,6 +91,11 @@ zx_status_t SimpleAudioStream::NotifyPosition(const audio_proto::RingBufPosition
     return rb_channel_->Write(&notif, sizeof(notif));
 }
 
+void SimpleAudioStream::UpdatePosition(uint32_t ring_buffer_pos, zx_time_t timestamp) {
+    fbl::AutoLock channel_lock(&channel_lock_);
+    position_buffer_.Update(ring_buffer_pos, timestamp);
+}
+
 void SimpleAudioStream::DdkUnbind() {
     Shutdown();
 
@@ -226,6 +233,7 @@ zx_status_t SimpleAudioStream::ProcessRingBufferChannel(dispatcher::Channel* cha
         audio_proto::RingBufGetBufferReq get_buffer;
         audio_proto::RingBufStartReq rb_start;
         audio_proto::RingBufStopReq rb_stop;
+        audio_proto::RingBufGetPositionBufferReq get_position_buffer;
     } req;
 
     static_assert(sizeof(req) <= 256,
@@ -247,6 +255,7 @@ zx_status_t SimpleAudioStream::ProcessRingBufferChannel(dispatcher::Channel* cha
         HREQ(AUDIO_RB_CMD_GET_BUFFER, get_buffer, OnGetBuffer, false);
         HREQ(AUDIO_RB_CMD_START, rb_start, OnStart, false);
         HREQ(AUDIO_RB_CMD_STOP, rb_stop, OnStop, false);
+        HREQ(AUDIO_RB_CMD_GET_POSITION_BUFFER, get_position_buffer, OnGetPositionBuffer, false);
     default:
         zxlogf(ERROR, "Unrecognized ring buffer command 0x%04x\n", req.hdr.cmd);
         return ZX_ERR_NOT_SUPPORTED;
@@ -268,6 +277,7 @@ void SimpleAudioStream::DeactivateRingBufferChannel(const dispatcher::Channel* c
         }
         rb_fetched_ = false;
         expected_notifications_per_ring_.store(0);
+        position_buffer_.Release();
         rb_channel_.reset();
     }
 }
@@ -548,6 +558,7 @@ zx_status_t SimpleAudioStream::OnStart(dispatcher::Channel* channel,
         resp.result = Start(&resp.start_time);
         if (resp.result == ZX_OK) {
             rb_started_ = true;
+            UpdatePosition(0, resp.start_time);
         }
     }
 
@@ -565,10 +576,29 @@ zx_status_t SimpleAudioStream::OnStop(dispatcher::Channel* channel,
         resp.result = Stop();
         if (resp.result == ZX_OK) {
             rb_started_ = false;
+            UpdatePosition(0, 0);
         }
     }
 
     return channel->Write(&resp, sizeof(resp));
 }
 
+zx_status_t SimpleAudioStream::OnGetPositionBuffer(
+        dispatcher::Channel* channel, const audio_proto::RingBufGetPositionBufferReq& req) {
+    audio_proto::RingBufGetPositionBufferResp resp = {};
+    resp.hdr = req.hdr;
+
+    zx::vmo buffer;
+    {
+        fbl::AutoLock channel_lock(&channel_lock_);
+        resp.result = position_buffer_.GetClientVmo(&buffer);
+    }
+
+    if (resp.result == ZX_OK) {
+        return channel->Write(&resp, sizeof(resp), fbl::move(buffer));
+    }
+
+    return channel->Write(&resp, sizeof(resp));
+}
+
 }  // namespace audio
@@ -209,6 +209,7 @@ static bool cmd_is_read(uint8_t cmd) {
 static bool cmd_is_write(uint8_t cmd) {
     if (cmd == SATA_CMD_WRITE_DMA ||
         cmd == SATA_CMD_WRITE_DMA_EXT ||
+        cmd == SATA_CMD_WRITE_DMA_FUA_EXT ||
         cmd == SATA_CMD_WRITE_FPDMA_QUEUED) {
         return true;
     } else {
@@ -274,13 +275,21 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
     uint64_t count = txn->bop.rw.length;
 
     // use queued command if available
-    if (dev->cap & AHCI_CAP_NCQ) {
+    if ((dev->cap & AHCI_CAP_NCQ) && port->devinfo.ncq) {
         if (cmd == SATA_CMD_READ_DMA_EXT) {
             cmd = SATA_CMD_READ_FPDMA_QUEUED;
         } else if (cmd == SATA_CMD_WRITE_DMA_EXT) {
             cmd = SATA_CMD_WRITE_FPDMA_QUEUED;
         }
     }
+    if (!cmd_is_queued(cmd) && (device & SATA_DEVICE_FUA)) {
+        // the FUA bit is only part of queued commands, and unqueued writes
+        // have a command of their own for it
+        device &= ~SATA_DEVICE_FUA;
+        if (cmd == SATA_CMD_WRITE_DMA_EXT && port->devinfo.fua) {
+            cmd = SATA_CMD_WRITE_DMA_FUA_EXT;
+        }
+    }
 
     // build the command
     ahci_cl_t* cl = port->cl + slot;
@@ -299,7 +308,8 @@ static zx_status_t ahci_do_txn(ahci_device_t* dev, ahci_port_t* port, int slot,
 
     // some commands have lba/count fields
     if (cmd == SATA_CMD_READ_DMA_EXT ||
-        cmd == SATA_CMD_WRITE_DMA_EXT) {
+        cmd == SATA_CMD_WRITE_DMA_EXT ||
+        cmd == SATA_CMD_WRITE_DMA_FUA_EXT) {
         cfis[4] = lba & 0xff;
         cfis[5] = (lba >> 8) & 0xff;
         cfis[6] = (lba >> 16) & 0xff;
@@ -477,6 +487,53 @@ void ahci_set_devinfo(ahci_device_t* device, int portnr, sata_devinfo_t* devinfo
     memcpy(&port->devinfo, devinfo, sizeof(port->devinfo));
 }
 
+// Starts as many queued txns as there are free command slots. Called with the
+// port lock held.
+static void ahci_port_process_txns(ahci_device_t* dev, ahci_port_t* port) {
+    sata_txn_t* txn;
+    while (!(port->flags & AHCI_PORT_FLAG_SYNC_PAUSED)) {
+        txn = list_peek_head_type(&port->txn_list, sata_txn_t, node);
+        if (!txn) {
+            break;
+        }
+
+        // find a free command tag
+        int max = MIN(port->devinfo.max_cmd, (int)((dev->cap >> 8) & 0x1f));
+        int i = 0;
+        for (i = 0; i <= max; i++) {
+            if (!ahci_port_cmd_busy(port, i)) break;
+        }
+        if (i > max) {
+            break;
+        }
+
+        list_delete(&txn->node);
+
+        if (BLOCK_OP(txn->bop.command) == BLOCK_OP_FLUSH) {
+            if (port->running) {
+                ZX_DEBUG_ASSERT(port->sync == NULL);
+                // pause the port if FLUSH command
+                port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
+                port->sync = txn;
+            } else {
+                // complete immediately if nothing in flight
+                mtx_unlock(&port->lock);
+                block_complete(txn, ZX_OK);
+                mtx_lock(&port->lock);
+            }
+        } else {
+            // run the transaction
+            zx_status_t st = ahci_do_txn(dev, port, i, txn);
+            // complete the transaction with if it failed during processing
+            if (st != ZX_OK) {
+                mtx_unlock(&port->lock);
+                block_complete(txn, st);
+                mtx_lock(&port->lock);
+            }
+        }
+    }
+}
+
 void ahci_queue(ahci_device_t* device, int portnr, sata_txn_t* txn) {
     ZX_DEBUG_ASSERT(ahci_port_valid(device, portnr));
 
@@ -488,12 +545,11 @@ void ahci_queue(ahci_device_t* device, int portnr, sata_txn_t* txn) {
     // reset the physical address
     txn->pmt = ZX_HANDLE_INVALID;
 
-    // put the cmd on the queue
+    // put the cmd on the queue, and start it right away if there is a free
+    // command slot, rather than waiting for the worker thread
     mtx_lock(&port->lock);
     list_add_tail(&port->txn_list, &txn->node);
-
-    // hit the worker thread
-    sync_completion_signal(&device->worker_completion);
+    ahci_port_process_txns(device, port);
     mtx_unlock(&port->lock);
 }
 
@@ -553,53 +609,7 @@ static int ahci_worker_thread(void* arg) {
                 }
             }
 
-            if (port->flags & AHCI_PORT_FLAG_SYNC_PAUSED) {
-                goto next;
-            }
-
-            // process queued txns
-            for (;;) {
-                txn = list_peek_head_type(&port->txn_list, sata_txn_t, node);
-                if (!txn) {
-                    break;
-                }
-
-                // find a free command tag
-                int max = MIN(port->devinfo.max_cmd, (int)((dev->cap >> 8) & 0x1f));
-                int i = 0;
-                for (i = 0; i <= max; i++) {
-                    if (!ahci_port_cmd_busy(port, i)) break;
-                }
-                if (i > max) {
-                    break;
-                }
-
-                list_delete(&txn->node);
-
-                if (BLOCK_OP(txn->bop.command) == BLOCK_OP_FLUSH) {
-                    if (port->running) {
-                        ZX_DEBUG_ASSERT(port->sync == NULL);
-                        // pause the port if FLUSH command
-                        port->flags |= AHCI_PORT_FLAG_SYNC_PAUSED;
-                        port->sync = txn;
-                    } else {
-                        // complete immediately if nothing in flight
-                        mtx_unlock(&port->lock);
-                        block_complete(txn, ZX_OK);
-                        mtx_lock(&port->lock);
-                    }
-                } else {
-                    // run the transaction
-                    zx_status_t st = ahci_do_txn(dev, port, i, txn);
-                    // complete the transaction with if it failed during processing
-                    if (st != ZX_OK) {
-                        mtx_unlock(&port->lock);
-                        block_complete(txn, st);
-                        mtx_lock(&port->lock);
-                        continue;
-                    }
-                }
-            }
+            ahci_port_process_txns(dev, port);
 next:
             mtx_unlock(&port->lock);
         }
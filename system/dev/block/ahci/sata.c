@@ -141,8 +141,11 @@ static zx_status_t sata_device_identify(sata_device_t* dev, ahci_device_t* contr
     } else {
         zxlogf(INFO, " PIO");
     }
-    dev->max_cmd = *(devinfo + SATA_DEVINFO_QUEUE_DEPTH);
-    zxlogf(INFO, " %d commands\n", dev->max_cmd + 1);
+    // the queue depth is only meaningful if the device supports NCQ
+    bool ncq = *(devinfo + SATA_DEVINFO_SATA_CAP) & (1 << 8);
+    dev->max_cmd = ncq ? (*(devinfo + SATA_DEVINFO_QUEUE_DEPTH) & 0x1f) : 0;
+    zxlogf(INFO, " %d commands%s\n", dev->max_cmd + 1, ncq ? " NCQ" : "");
+    bool fua = *(devinfo + SATA_DEVINFO_CMD_SET_EXT) & (1 << 6);
 
     uint32_t block_size = 512; // default
     uint64_t block_count = 0;
@@ -177,6 +180,8 @@ static zx_status_t sata_device_identify(sata_device_t* dev, ahci_device_t* contr
     // set devinfo on controller
     di.block_size = block_size,
     di.max_cmd = dev->max_cmd,
+    di.ncq = ncq;
+    di.fua = fua;
 
     ahci_set_devinfo(controller, dev->port, &di);
 
@@ -255,7 +260,10 @@ static void sata_queue(void* ctx, block_op_t* bop, block_impl_queue_callback com
 
         txn->cmd = (BLOCK_OP(bop->command) == BLOCK_OP_READ) ?
                    SATA_CMD_READ_DMA_EXT : SATA_CMD_WRITE_DMA_EXT;
-        txn->device = 0x40;
+        txn->device = SATA_DEVICE_LBA;
+        if (bop->command & BLOCK_FL_FORCE_ACCESS) {
+            txn->device |= SATA_DEVICE_FUA;
+        }
         zxlogf(TRACE, "sata: queue op 0x%x txn %p\n", bop->command, txn);
         break;
     case BLOCK_OP_FLUSH:
@@ -13,8 +13,13 @@
 #define SATA_CMD_READ_FPDMA_QUEUED    0x60
 #define SATA_CMD_WRITE_DMA            0xca
 #define SATA_CMD_WRITE_DMA_EXT        0x35
+#define SATA_CMD_WRITE_DMA_FUA_EXT    0x3d
 #define SATA_CMD_WRITE_FPDMA_QUEUED   0x61
 
+// device register bits
+#define SATA_DEVICE_LBA               (1 << 6)
+#define SATA_DEVICE_FUA               (1 << 7) // only valid for queued commands
+
 #define SATA_DEVINFO_SERIAL              10
 #define SATA_DEVINFO_FW_REV              23
 #define SATA_DEVINFO_MODEL_ID            27
@@ -25,6 +30,7 @@
 #define SATA_DEVINFO_SATA_CAP2           77
 #define SATA_DEVINFO_MAJOR_VERS          80
 #define SATA_DEVINFO_CMD_SET_2           83
+#define SATA_DEVINFO_CMD_SET_EXT         84
 #define SATA_DEVINFO_LBA_CAPACITY_2      100
 #define SATA_DEVINFO_SECTOR_SIZE         106
 #define SATA_DEVINFO_LOGICAL_SECTOR_SIZE 117
@@ -57,6 +63,8 @@ typedef struct ahci_device ahci_device_t;
 typedef struct sata_devinfo {
     uint32_t block_size;
     int max_cmd;
+    bool ncq; // supports native command queuing
+    bool fua; // supports WRITE DMA FUA EXT
 } sata_devinfo_t;
 
 zx_status_t sata_bind(ahci_device_t* controller, zx_device_t* parent, int port);
@@ -170,6 +170,23 @@ done:
     return status;
 }
 
+static zx_status_t blkdev_fifo_set_coalescing(blkdev_t* bdev, const void* in_buf,
+                                              size_t in_len) {
+    if (in_len < sizeof(block_fifo_coalescing_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t status;
+    mtx_lock(&bdev->lock);
+    if (bdev->bs == NULL) {
+        status = ZX_ERR_BAD_STATE;
+    } else {
+        status = blockserver_set_coalescing(bdev->bs, in_buf);
+    }
+    mtx_unlock(&bdev->lock);
+    return status;
+}
+
 static zx_status_t blkdev_fifo_close_locked(blkdev_t* bdev) {
     if (bdev->bs != NULL) {
         blockserver_shutdown(bdev->bs);
@@ -193,6 +210,8 @@ static zx_status_t blkdev_ioctl(void* ctx, uint32_t op, const void* cmd,
         return blkdev_get_fifos(blkdev, reply, max, out_actual);
     case IOCTL_BLOCK_ATTACH_VMO:
         return blkdev_attach_vmo(blkdev, cmd, cmdlen, reply, max, out_actual);
+    case IOCTL_BLOCK_FIFO_SET_COALESCING:
+        return blkdev_fifo_set_coalescing(blkdev, cmd, cmdlen);
     case IOCTL_BLOCK_FIFO_CLOSE: {
         mtx_lock(&blkdev->lock);
         zx_status_t status = blkdev_fifo_close_locked(blkdev);
@@ -29,33 +29,52 @@ namespace {
 // to terminate.
 constexpr zx_signals_t kSignalFifoTerminate   = ZX_USER_SIGNAL_0;
 // This signal is set on the FIFO when, after the thread enqueueing operations
-// has encountered a barrier, all prior operations have completed.
+// has encountered a barrier, all prior operations have completed, or after
+// it has been throttled, an operation has completed.
 constexpr zx_signals_t kSignalFifoOpsComplete = ZX_USER_SIGNAL_1;
 // Signalled on the fifo when it has finished terminating.
 // (If we need to free up user signals, this could easily be transformed
 // into a completion object).
 constexpr zx_signals_t kSignalFifoTerminated  = ZX_USER_SIGNAL_2;
+// Signalled on the fifo when a response is queued for a later write, so that
+// the server thread waits no longer than its deadline.
+constexpr zx_signals_t kSignalFifoResponsesQueued = ZX_USER_SIGNAL_3;
 
 // Impossible groupid used internally to signify that an operation
 // has no accompanying group.
 constexpr groupid_t kNoGroup = MAX_TXN_GROUP_COUNT;
 
-void OutOfBandRespond(const fzl::fifo<block_fifo_response_t, block_fifo_request_t>& fifo,
-                      zx_status_t status, reqid_t reqid, groupid_t group) {
+// The number of operations the server keeps in flight on the device. The rest
+// wait in the input queue, where they may still be merged and reordered.
+constexpr size_t kMaxInFlight = 32;
+
+// How long reads may keep overtaking a queued message.
+constexpr zx_duration_t kMaxDispatchDelay = ZX_MSEC(100);
+
+// How far into the input queue the scheduler looks for messages to send
+// ahead of, or merge with, the one at its front.
+constexpr size_t kSchedulerWindow = 64;
+
+block_fifo_response_t OutOfBandResponse(zx_status_t status, reqid_t reqid, groupid_t group) {
     block_fifo_response_t response;
     response.status = status;
     response.reqid = reqid;
     response.group = group;
     response.count = 1;
-
-    status = fifo.write_one(response);
-    if (status != ZX_OK) {
-        fprintf(stderr, "Block Server I/O error: Could not write response\n");
-    }
+    return response;
 }
 
 void BlockComplete(BlockMsg* msg, zx_status_t status) {
     auto extra = msg->extra();
+    // The messages merged into this one were sent to the device as part of it.
+    BlockMsg merged(extra->merged);
+    extra->merged = nullptr;
+    while (merged.valid()) {
+        BlockMsg next(merged.extra()->merged);
+        merged.extra()->iobuf = nullptr;
+        extra->server->TxnComplete(status, merged.extra()->reqid, merged.extra()->group);
+        merged = fbl::move(next);
+    }
     // Since iobuf is a RefPtr, it lives at least as long as the txn,
     // and is not discarded underneath the block device driver.
     extra->iobuf = nullptr;
@@ -81,6 +100,14 @@ uint32_t OpcodeToCommand(uint32_t opcode) {
     return opcode & shared;
 }
 
+// Returns true if |msg| may be sent to the device before or after the
+// messages queued around it.
+bool IsReorderable(const block_msg_t* msg) {
+    const uint32_t op = msg->op.command & BLOCK_OP_MASK;
+    return (op == BLOCK_OP_READ || op == BLOCK_OP_WRITE) &&
+           !(msg->op.command & (BLOCK_FL_BARRIER_BEFORE | BLOCK_FL_BARRIER_AFTER));
+}
+
 void InQueueAdd(zx_handle_t vmo, uint64_t length, uint64_t vmo_offset,
                 uint64_t dev_offset, block_msg_t* msg, BlockMsgQueue* queue) {
     block_op_t* bop = &msg->op;
@@ -88,6 +115,7 @@ void InQueueAdd(zx_handle_t vmo, uint64_t length, uint64_t vmo_offset,
     bop->rw.vmo = vmo;
     bop->rw.offset_dev = dev_offset;
     bop->rw.offset_vmo = vmo_offset;
+    msg->extra.deadline = zx_deadline_after(kMaxDispatchDelay);
     queue->push_back(msg);
 }
 
@@ -113,6 +141,7 @@ void BlockServer::BarrierComplete() {
     // signal. We'll never "miss" a signal, because we process
     // the queue AFTER unsetting it.
     barrier_in_progress_.store(false);
+    throttled_.store(false);
     fifo_.signal(kSignalFifoOpsComplete, 0);
     InQueueDrainer();
 }
@@ -132,14 +161,76 @@ void BlockServer::TerminateQueue() {
     }
 }
 void BlockServer::TxnComplete(zx_status_t status, reqid_t reqid, groupid_t group) {
+    block_fifo_response_t response;
     if (group == kNoGroup) {
-        OutOfBandRespond(fifo_, status, reqid, group);
+        response = OutOfBandResponse(status, reqid, group);
     } else {
         ZX_DEBUG_ASSERT(group < MAX_TXN_GROUP_COUNT);
-        groups_[group].Complete(status);
+        if (!groups_[group].Complete(status, &response)) {
+            return;
+        }
+    }
+    Respond(response);
+}
+
+zx_status_t BlockServer::SetCoalescing(const block_fifo_coalescing_t& config) {
+    if (config.max_delay < 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    fbl::AutoLock lock(&response_lock_);
+    max_responses_ = fbl::clamp<uint32_t>(config.max_responses, 1, BLOCK_FIFO_MAX_DEPTH);
+    max_response_delay_ = zx::duration(config.max_delay);
+    if (response_count_ >= max_responses_) {
+        FlushResponsesLocked();
+    }
+    return ZX_OK;
+}
+
+void BlockServer::Respond(const block_fifo_response_t& response) {
+    fbl::AutoLock lock(&response_lock_);
+    responses_[response_count_++] = response;
+    if (response_count_ == 1) {
+        response_deadline_ = zx::deadline_after(max_response_delay_);
+    }
+    // Responses not written here wait for the next completion, or for the
+    // last operation in flight to end, or for their deadline.
+    if (response_count_ >= max_responses_ || pending_count_.load() == 0 ||
+        zx::clock::get_monotonic() >= response_deadline_) {
+        FlushResponsesLocked();
+    } else if (response_count_ == 1) {
+        fifo_.signal(0, kSignalFifoResponsesQueued);
     }
 }
 
+void BlockServer::FlushResponses() {
+    fbl::AutoLock lock(&response_lock_);
+    FlushResponsesLocked();
+}
+
+zx::time BlockServer::FlushResponsesIfDue() {
+    fbl::AutoLock lock(&response_lock_);
+    if (response_count_ == 0) {
+        return zx::time::infinite();
+    }
+    if (zx::clock::get_monotonic() < response_deadline_) {
+        return response_deadline_;
+    }
+    FlushResponsesLocked();
+    return zx::time::infinite();
+}
+
+void BlockServer::FlushResponsesLocked() {
+    if (response_count_ == 0) {
+        return;
+    }
+    size_t actual = 0;
+    zx_status_t status = fifo_.write(responses_, response_count_, &actual);
+    if (status != ZX_OK || actual != response_count_) {
+        fprintf(stderr, "Block Server I/O error: Could not write response\n");
+    }
+    response_count_ = 0;
+}
+
 zx_status_t BlockServer::Read(block_fifo_request_t* requests, size_t* count) {
     auto cleanup = fbl::MakeAutoCall([this]() {
         TerminateQueue();
@@ -158,10 +249,20 @@ zx_status_t BlockServer::Read(block_fifo_request_t* requests, size_t* count) {
         switch (status) {
         case ZX_ERR_SHOULD_WAIT:
             signals = ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED |
-                    kSignalFifoTerminate | kSignalFifoOpsComplete;
-            if ((status = fifo_.wait_one(signals, zx::time::infinite(), &seen)) != ZX_OK) {
+                    kSignalFifoTerminate | kSignalFifoOpsComplete | kSignalFifoResponsesQueued;
+            // Queued responses are written by their deadline, if nothing
+            // else writes them first.
+            status = fifo_.wait_one(signals, FlushResponsesIfDue(), &seen);
+            if (status == ZX_ERR_TIMED_OUT) {
+                continue;
+            }
+            if (status != ZX_OK) {
                 return status;
             }
+            if (seen & kSignalFifoResponsesQueued) {
+                fifo_.signal(kSignalFifoResponsesQueued, 0);
+                continue;
+            }
             if (seen & kSignalFifoOpsComplete) {
                 BarrierComplete();
                 continue;
@@ -219,7 +320,11 @@ zx_status_t BlockServer::AttachVmo(zx::vmo vmo, vmoid_t* out) {
 void BlockServer::TxnEnd() {
     size_t old_count = pending_count_.fetch_sub(1);
     ZX_ASSERT(old_count > 0);
-    if ((old_count == 1) && barrier_in_progress_.load()) {
+    if (old_count == 1) {
+        // Nothing left in flight will complete the responses' coalescing.
+        FlushResponses();
+    }
+    if (((old_count == 1) && barrier_in_progress_.load()) || throttled_.load()) {
         // Since we're avoiding locking, and there is a gap between
         // "pending count decremented" and "FIFO signalled", it's possible
         // that we'll receive spurious wakeup requests.
@@ -247,19 +352,94 @@ void BlockServer::InQueueDrainer() {
             // Since we're the only thread that could add to pending
             // count, we reliably know it has terminated.
             barrier_in_progress_.store(false);
+            // With the barrier behind it, the message may be grouped with
+            // those which follow it.
+            msg->op.command &= ~BLOCK_FL_BARRIER_BEFORE;
         }
-        if (msg->op.command & BLOCK_FL_BARRIER_AFTER) {
+
+        if (pending_count_.load() >= kMaxInFlight) {
+            // As with barriers, TxnEnd may see the old flag, so check again.
+            throttled_.store(true);
+            if (pending_count_.load() >= kMaxInFlight) {
+                return;
+            }
+            throttled_.store(false);
+        }
+
+        block_msg_t* next = InQueuePop();
+        if (next->op.command & BLOCK_FL_BARRIER_AFTER) {
             deferred_barrier_before_ = true;
         }
         pending_count_.fetch_add(1);
-        in_queue_.pop_front();
         // Underlying block device drivers should not see block barriers
         // which are already handled by the block midlayer.
         //
         // This may be altered in the future if block devices
         // are capable of implementing hardware barriers.
-        msg->op.command &= ~(BLOCK_FL_BARRIER_BEFORE | BLOCK_FL_BARRIER_AFTER);
-        bp_->ops->queue(bp_->ctx, &msg->op, BlockCompleteCb, &*msg);
+        next->op.command &= ~(BLOCK_FL_BARRIER_BEFORE | BLOCK_FL_BARRIER_AFTER);
+        bp_->ops->queue(bp_->ctx, &next->op, BlockCompleteCb, next);
+    }
+}
+
+block_msg_t* BlockServer::InQueuePop() {
+    block_msg_t* next = &*in_queue_.begin();
+    if (!IsReorderable(next)) {
+        return in_queue_.pop_front();
+    }
+
+    if (zx_clock_get_monotonic() < next->extra.deadline) {
+        size_t scanned = 0;
+        for (auto& msg : in_queue_) {
+            if (!IsReorderable(&msg) || scanned++ == kSchedulerWindow) {
+                break;
+            }
+            if ((msg.op.command & BLOCK_OP_MASK) == BLOCK_OP_READ) {
+                next = &msg;
+                break;
+            }
+        }
+    }
+    in_queue_.erase(*next);
+    InQueueMerge(next);
+    return next;
+}
+
+void BlockServer::InQueueMerge(block_msg_t* msg) {
+    uint64_t max_length = info_.max_transfer_size / info_.block_size;
+    if (max_length == 0 || max_length > fbl::numeric_limits<uint32_t>::max()) {
+        max_length = fbl::numeric_limits<uint32_t>::max();
+    }
+
+    block_op_t* op = &msg->op;
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        size_t scanned = 0;
+        for (auto iter = in_queue_.begin(); iter != in_queue_.end(); ++iter) {
+            if (!IsReorderable(&*iter) || scanned++ == kSchedulerWindow) {
+                break;
+            }
+            const block_op_t* other = &iter->op;
+            if ((other->command != op->command) || (other->rw.vmo != op->rw.vmo) ||
+                (op->rw.length + other->rw.length > max_length)) {
+                continue;
+            }
+            if ((other->rw.offset_vmo + other->rw.length == op->rw.offset_vmo) &&
+                (other->rw.offset_dev + other->rw.length == op->rw.offset_dev)) {
+                op->rw.offset_vmo = other->rw.offset_vmo;
+                op->rw.offset_dev = other->rw.offset_dev;
+            } else if ((op->rw.offset_vmo + op->rw.length != other->rw.offset_vmo) ||
+                       (op->rw.offset_dev + op->rw.length != other->rw.offset_dev)) {
+                continue;
+            }
+            op->rw.length += other->rw.length;
+
+            block_msg_t* other_msg = in_queue_.erase(iter);
+            other_msg->extra.merged = msg->extra.merged;
+            msg->extra.merged = other_msg;
+            merged = true;
+            break;
+        }
     }
 }
 
@@ -278,7 +458,7 @@ zx_status_t BlockServer::Create(block_impl_protocol_t* bp, fzl::fifo<block_fifo_
     }
 
     for (size_t i = 0; i < fbl::count_of(bs->groups_); i++) {
-        bs->groups_[i].Initialize(bs->fifo_.get_handle(), static_cast<groupid_t>(i));
+        bs->groups_[i].Initialize(static_cast<groupid_t>(i));
     }
 
     // Notably, drop ZX_RIGHT_SIGNAL_PEER, since we use bs->fifo for thread
@@ -434,6 +614,31 @@ void BlockServer::ProcessRequest(block_fifo_request_t* request) {
         InQueueAdd(ZX_HANDLE_INVALID, 0, 0, 0, msg.release(), &in_queue_);
         break;
     }
+    case BLOCKIO_TRIM: {
+        if ((request->length < 1) ||
+            (request->length > fbl::numeric_limits<uint32_t>::max())) {
+            TxnComplete(ZX_ERR_INVALID_ARGS, reqid, group);
+            return;
+        }
+
+        zx_status_t status;
+        BlockMsg msg;
+        if ((status = BlockMsg::Create(block_op_size_, &msg)) != ZX_OK) {
+            TxnComplete(status, reqid, group);
+            return;
+        }
+        block_msg_extra_t* extra = msg.extra();
+        extra->iobuf = nullptr;
+        extra->server = this;
+        extra->reqid = reqid;
+        extra->group = group;
+        // Trims move no data, so they are not split by the maximum transfer size.
+        msg.op()->command = BLOCK_OP_TRIM |
+                (request->opcode & (BLOCKIO_BARRIER_BEFORE | BLOCKIO_BARRIER_AFTER));
+        InQueueAdd(ZX_HANDLE_INVALID, request->length, 0, request->dev_offset, msg.release(),
+                   &in_queue_);
+        break;
+    }
     default: {
         fprintf(stderr, "Unrecognized Block Server operation: %x\n",
                 request->opcode);
@@ -466,7 +671,7 @@ zx_status_t BlockServer::Serve() {
                 if (group >= MAX_TXN_GROUP_COUNT) {
                     // Operation which is not accessing a valid group.
                     if (wants_reply) {
-                        OutOfBandRespond(fifo_, ZX_ERR_IO, reqid, group);
+                        Respond(OutOfBandResponse(ZX_ERR_IO, reqid, group));
                     }
                     continue;
                 }
@@ -488,6 +693,7 @@ zx_status_t BlockServer::Serve() {
 
 BlockServer::BlockServer(block_impl_protocol_t* bp) :
     bp_(bp), block_op_size_(0), pending_count_(0), barrier_in_progress_(false),
+    throttled_(false), response_count_(0), max_responses_(1),
     last_id_(VMOID_INVALID + 1) {
     size_t block_op_size;
     bp->ops->query(bp->ctx, &info_, &block_op_size);
@@ -528,3 +734,6 @@ zx_status_t blockserver_attach_vmo(BlockServer* bs, zx_handle_t raw_vmo, vmoid_t
     zx::vmo vmo(raw_vmo);
     return bs->AttachVmo(fbl::move(vmo), out);
 }
+zx_status_t blockserver_set_coalescing(BlockServer* bs, const block_fifo_coalescing_t* config) {
+    return bs->SetCoalescing(*config);
+}
@@ -23,6 +23,7 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <lib/fzl/fifo.h>
+#include <lib/zx/time.h>
 #include <lib/zx/vmo.h>
 #include <lib/sync/completion.h>
 
@@ -66,6 +67,11 @@ struct block_msg_extra {
     BlockServer* server;
     reqid_t reqid;
     groupid_t group;
+    // Until then, reads queued after it may be sent to the device first.
+    zx_time_t deadline;
+    // Messages merged into this one by the scheduler, which complete along
+    // with it.
+    block_msg_t* merged;
 };
 
 // A single unit of work transmitted to the underlying block layer.
@@ -167,6 +173,10 @@ public:
     // (If appropriate) tells the client that their operation is done.
     void TxnComplete(zx_status_t status, reqid_t reqid, groupid_t group);
 
+    // Sets how long responses may wait to be written together; see
+    // block_fifo_coalescing_t.
+    zx_status_t SetCoalescing(const block_fifo_coalescing_t& config) TA_EXCL(response_lock_);
+
     void ShutDown();
     ~BlockServer();
 private:
@@ -177,7 +187,8 @@ private:
     void ProcessRequest(block_fifo_request_t* request);
 
     // Helper for the server to react to a signal that a barrier
-    // operation has completed. Unsets the local "waiting for barrier"
+    // operation has completed, or that there is room on the device
+    // for more operations. Unsets the local "waiting for barrier"
     // signal, and enqueues any further operations that might be
     // pending.
     void BarrierComplete();
@@ -188,12 +199,35 @@ private:
     void TerminateQueue();
 
     // Attempts to enqueue all operations on the |in_queue_|. Stops
-    // when either the queue is empty, or a BARRIER_BEFORE is reached and
-    // operations are in-flight.
+    // when either the queue is empty, a BARRIER_BEFORE is reached and
+    // operations are in-flight, or kMaxInFlight operations are in-flight.
     void InQueueDrainer();
 
+    // Removes the message to send to the device next from |in_queue_|.
+    //
+    // Messages between barriers, and other than flushes, may be sent in any
+    // order, so reads overtake the writes queued before them, unless those
+    // have waited past their deadline. Messages which continue the chosen
+    // one, both on disk and in its vmo, are merged into it.
+    block_msg_t* InQueuePop();
+
+    // Merges into |msg| the messages near the front of |in_queue_| which it
+    // may be reordered with, and which continue it or are continued by it.
+    void InQueueMerge(block_msg_t* msg);
+
     zx_status_t FindVmoIDLocked(vmoid_t* out) TA_REQ(server_lock_);
 
+    // Queues |response| for the client, and writes out the queued responses
+    // if the coalescing limits have been reached.
+    void Respond(const block_fifo_response_t& response) TA_EXCL(response_lock_);
+
+    // Writes out any queued responses; the deadline variant only does so once
+    // they have waited as long as they may, and returns when it must be
+    // called next.
+    void FlushResponses() TA_EXCL(response_lock_);
+    zx::time FlushResponsesIfDue() TA_EXCL(response_lock_);
+    void FlushResponsesLocked() TA_REQ(response_lock_);
+
     fzl::fifo<block_fifo_response_t, block_fifo_request_t> fifo_;
     block_info_t info_;
     block_impl_protocol_t* bp_;
@@ -205,8 +239,17 @@ private:
     BlockMsgQueue in_queue_;
     fbl::atomic<size_t> pending_count_;
     fbl::atomic<bool> barrier_in_progress_;
+    fbl::atomic<bool> throttled_;
     TransactionGroup groups_[MAX_TXN_GROUP_COUNT];
 
+    fbl::Mutex response_lock_;
+    block_fifo_response_t responses_[BLOCK_FIFO_MAX_DEPTH] TA_GUARDED(response_lock_);
+    size_t response_count_ TA_GUARDED(response_lock_);
+    // When the first of the queued responses must be written.
+    zx::time response_deadline_ TA_GUARDED(response_lock_);
+    uint32_t max_responses_ TA_GUARDED(response_lock_);
+    zx::duration max_response_delay_ TA_GUARDED(response_lock_);
+
     fbl::Mutex server_lock_;
     fbl::WAVLTree<vmoid_t, fbl::RefPtr<IoBuffer>> tree_ TA_GUARDED(server_lock_);
     vmoid_t last_id_ TA_GUARDED(server_lock_);
@@ -236,4 +279,7 @@ zx_status_t blockserver_serve(BlockServer* bs);
 // Attach an IO buffer to the Block Server
 zx_status_t blockserver_attach_vmo(BlockServer* bs, zx_handle_t vmo, vmoid_t* out);
 
+// Configure how the Block Server coalesces its responses
+zx_status_t blockserver_set_coalescing(BlockServer* bs, const block_fifo_coalescing_t* config);
+
 __END_CDECLS
@@ -24,15 +24,13 @@
 #include "server.h"
 
 TransactionGroup::TransactionGroup() :
-    fifo_(ZX_HANDLE_INVALID), flags_(0), ctr_(0) {
+    flags_(0), ctr_(0) {
     memset(&response_, 0, sizeof(response_));
 }
 
 TransactionGroup::~TransactionGroup() {}
 
-void TransactionGroup::Initialize(zx_handle_t fifo, groupid_t group) {
-    ZX_DEBUG_ASSERT(fifo_ == ZX_HANDLE_INVALID);
-    fifo_ = fifo;
+void TransactionGroup::Initialize(groupid_t group) {
     response_.group = group;
 }
 
@@ -60,7 +58,7 @@ void TransactionGroup::CtrAdd(uint32_t n) {
     ctr_ += n;
 }
 
-void TransactionGroup::Complete(zx_status_t status) {
+bool TransactionGroup::Complete(zx_status_t status, block_fifo_response_t* out) {
     fbl::AutoLock lock(&lock_);
     if ((status != ZX_OK) && (response_.status == ZX_OK)) {
         response_.status = status;
@@ -71,14 +69,13 @@ void TransactionGroup::Complete(zx_status_t status) {
     ZX_DEBUG_ASSERT(response_.count <= ctr_);
 
     if ((flags_ & kTxnFlagRespond) && (response_.count == ctr_)) {
-        status = zx_fifo_write(fifo_, sizeof(response_), &response_, 1, nullptr);
-        if (status != ZX_OK) {
-            fprintf(stderr, "Block Server I/O error: Could not write response\n");
-        }
+        *out = response_;
         response_.count = 0;
         response_.status = ZX_OK;
         response_.reqid = 0;
         ctr_ = 0;
         flags_ &= ~kTxnFlagRespond;
+        return true;
     }
+    return false;
 }
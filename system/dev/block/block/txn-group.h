@@ -34,7 +34,7 @@ public:
     ~TransactionGroup();
     // Initialize must be called before utilizing other functions in
     // TransactionGroup. Initialize should only be called once.
-    void Initialize(zx_handle_t fifo, groupid_t group) TA_NO_THREAD_SAFETY_ANALYSIS;
+    void Initialize(groupid_t group) TA_NO_THREAD_SAFETY_ANALYSIS;
 
     // Verifies that the incoming txn does not break the Block IO fifo protocol.
     // If it is successful, sets up the response_ with the registered cookie,
@@ -47,14 +47,12 @@ public:
     void CtrAdd(uint32_t n) TA_EXCL(lock_);
 
     // Called once the transaction has completed successfully.
-    // This function may respond on the fifo, resetting |response_|.
-    void Complete(zx_status_t status) TA_EXCL(lock_);
+    // Returns true, with the response for the client in |out|, if this
+    // completes the group, and resets |response_|.
+    bool Complete(zx_status_t status, block_fifo_response_t* out) TA_EXCL(lock_);
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(TransactionGroup);
 
-    // Should only be set once.
-    zx_handle_t fifo_;
-
     fbl::Mutex lock_;
     block_fifo_response_t response_ TA_GUARDED(lock_); // The response to be sent back to the client
     uint32_t flags_ TA_GUARDED(lock_);
@@ -160,6 +160,9 @@ private:
 
     zx_status_t FindFreeVPartEntryLocked(size_t* out) const TA_REQ(lock_);
     zx_status_t FindFreeSliceLocked(size_t* out, size_t hint) const TA_REQ(lock_);
+    // Finds the first run of |count| free pslices, trying the run starting at
+    // |hint| before any other.
+    zx_status_t FindFreeRunLocked(size_t* out, size_t count, size_t hint) const TA_REQ(lock_);
 
     fvm_t* GetFvmLocked() const TA_REQ(lock_) {
         return reinterpret_cast<fvm_t*>(metadata_.start());
@@ -240,6 +243,16 @@ public:
     // to it. If no slice is allocated, return PSLICE_UNALLOCATED.
     uint32_t SliceGetLocked(size_t vslice) const TA_REQ(lock_);
 
+    // Looks up the pslice backing |vslice|, and sets |*run_end| to the last
+    // vslice, no further than |vslice_end|, of the run starting there which is
+    // backed by physically contiguous pslices. The slice map is searched once
+    // per extent, rather than once per slice.
+    //
+    // Returns PSLICE_UNALLOCATED, leaving |*run_end| untouched, if |vslice| is
+    // not allocated.
+    uint32_t SliceRunLocked(size_t vslice, size_t vslice_end, size_t* run_end) const
+        TA_REQ(lock_);
+
     // Check slices starting from |vslice_start|.
     // Sets |*count| to the number of contiguous allocated or unallocated slices found.
     // Sets |*allocated| to true if the vslice range is allocated, and false otherwise.
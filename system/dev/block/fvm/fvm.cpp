@@ -411,6 +411,35 @@ zx_status_t VPartitionManager::FindFreeSliceLocked(size_t* out, size_t hint) con
     return ZX_ERR_NO_SPACE;
 }
 
+zx_status_t VPartitionManager::FindFreeRunLocked(size_t* out, size_t count, size_t hint) const {
+    if (count == 0 || count > pslice_total_count_) {
+        return ZX_ERR_NO_SPACE;
+    }
+    auto is_free_run = [this, count](size_t start, size_t* next) {
+        for (size_t i = start; i < start + count; i++) {
+            if (GetSliceEntryLocked(i)->Vpart() != FVM_SLICE_ENTRY_FREE) {
+                *next = i + 1;
+                return false;
+            }
+        }
+        return true;
+    };
+
+    size_t next;
+    if (hint >= 1 && hint + count - 1 <= pslice_total_count_ && is_free_run(hint, &next)) {
+        *out = hint;
+        return ZX_OK;
+    }
+    // First fit; a run is never retried from inside a range known to be in use.
+    for (size_t i = 1; i + count - 1 <= pslice_total_count_; i = next) {
+        if (is_free_run(i, &next)) {
+            *out = i;
+            return ZX_OK;
+        }
+    }
+    return ZX_ERR_NO_SPACE;
+}
+
 zx_status_t VPartitionManager::AllocateSlices(VPartition* vp, size_t vslice_start,
                                               size_t count) {
     fbl::AutoLock lock(&lock_);
@@ -431,14 +460,27 @@ zx_status_t VPartitionManager::AllocateSlicesLocked(VPartition* vp, size_t vslic
         if (vp->IsKilledLocked()) {
             return ZX_ERR_BAD_STATE;
         }
+        // Place the new slices right after the ones they follow in the
+        // partition, so that extending a partition keeps it physically
+        // contiguous, and IO across the boundary isn't split.
+        if (vslice_start > 0) {
+            uint32_t prev = vp->SliceGetLocked(vslice_start - 1);
+            if (prev != PSLICE_UNALLOCATED) {
+                hint = prev + 1;
+            }
+        }
+        // Prefer a single run of free slices, falling back to whichever
+        // slices are free if the volume is too fragmented for one.
+        size_t run_start = 0;
+        bool have_run = FindFreeRunLocked(&run_start, count, hint) == ZX_OK;
         for (size_t i = 0; i < count; i++) {
-            size_t pslice;
+            size_t pslice = run_start + i;
             auto vslice = vslice_start + i;
             if (vp->SliceGetLocked(vslice) != PSLICE_UNALLOCATED) {
                 status = ZX_ERR_INVALID_ARGS;
             }
             if ((status != ZX_OK) ||
-                ((status = FindFreeSliceLocked(&pslice, hint)) != ZX_OK) ||
+                (!have_run && (status = FindFreeSliceLocked(&pslice, hint)) != ZX_OK) ||
                 ((status = vp->SliceSetLocked(vslice, static_cast<uint32_t>(pslice)) != ZX_OK))) {
                 for (int j = static_cast<int>(i - 1); j >= 0; j--) {
                     vslice = vslice_start + j;
@@ -732,6 +774,38 @@ uint32_t VPartition::SliceGetLocked(size_t vslice) const {
     return extent->get(vslice);
 }
 
+uint32_t VPartition::SliceRunLocked(size_t vslice, size_t vslice_end, size_t* run_end) const {
+    ZX_DEBUG_ASSERT(vslice_end < mgr_->VSliceMax());
+    auto extent = --slice_map_.upper_bound(vslice);
+    if (!extent.IsValid()) {
+        return PSLICE_UNALLOCATED;
+    }
+    const uint32_t pslice = extent->get(vslice);
+    if (pslice == PSLICE_UNALLOCATED) {
+        return PSLICE_UNALLOCATED;
+    }
+
+    size_t end = vslice;
+    uint32_t last = pslice;
+    while (end < vslice_end) {
+        if (end + 1 == extent->end()) {
+            // Runs may continue into a neighbouring extent.
+            auto next = extent;
+            if (!(++next).IsValid() || next->start() != extent->end()) {
+                break;
+            }
+            extent = next;
+        }
+        if (extent->get(end + 1) != last + 1) {
+            break;
+        }
+        last++;
+        end++;
+    }
+    *run_end = end;
+    return pslice;
+}
+
 zx_status_t VPartition::CheckSlices(size_t vslice_start, size_t* count, bool* allocated) {
     fbl::AutoLock lock(&lock_);
 
@@ -1017,6 +1091,8 @@ void VPartition::BlockImplQueue(block_op_t* txn, block_impl_queue_callback compl
     switch (txn->command & BLOCK_OP_MASK) {
     case BLOCK_OP_READ:
     case BLOCK_OP_WRITE:
+    // Trims are given by rw.length and rw.offset_dev, and are remapped like writes.
+    case BLOCK_OP_TRIM:
         break;
     // Pass-through operations
     case BLOCK_OP_FLUSH:
@@ -1063,19 +1139,20 @@ void VPartition::BlockImplQueue(block_op_t* txn, block_impl_queue_callback compl
 
     // First, check that all slices are allocated.
     // If any are missing, then this txn will fail.
-    bool contiguous = true;
-    for (size_t vslice = vslice_start; vslice <= vslice_end; vslice++) {
-        if (SliceGetLocked(vslice) == PSLICE_UNALLOCATED) {
+    // The txn is split at the breaks between physically contiguous runs of
+    // slices, rather than at every slice.
+    size_t txn_count = 0;
+    size_t run_end = 0;
+    for (size_t vslice = vslice_start; vslice <= vslice_end; vslice = run_end + 1) {
+        if (SliceRunLocked(vslice, vslice_end, &run_end) == PSLICE_UNALLOCATED) {
             completion_cb(cookie, ZX_ERR_OUT_OF_RANGE, txn);
             return;
         }
-        if (vslice != vslice_start && SliceGetLocked(vslice - 1) + 1 != SliceGetLocked(vslice)) {
-            contiguous = false;
-        }
+        txn_count++;
     }
 
     // Ideal case: slices are contiguous
-    if (contiguous) {
+    if (txn_count == 1) {
         uint32_t pslice = SliceGetLocked(vslice_start);
         txn->rw.offset_dev = SliceStart(disk_size, slice_size, pslice) /
                 BlockSize() + (txn->rw.offset_dev % blocks_per_slice);
@@ -1084,7 +1161,6 @@ void VPartition::BlockImplQueue(block_op_t* txn, block_impl_queue_callback compl
     }
 
     // Harder case: Noncontiguous slices
-    const size_t txn_count = vslice_end - vslice_start + 1;
     fbl::Vector<block_op_t*> txns;
     txns.reserve(txn_count);
 
@@ -1096,24 +1172,14 @@ void VPartition::BlockImplQueue(block_op_t* txn, block_impl_queue_callback compl
         return;
     }
 
-    uint32_t length_remaining = txn->rw.length;
+    // Both in blocks of the partition.
+    const uint64_t txn_end = txn->rw.offset_dev + txn->rw.length;
+    uint64_t offset = txn->rw.offset_dev;
+    size_t vslice = vslice_start;
     for (size_t i = 0; i < txn_count; i++) {
-        size_t vslice = vslice_start + i;
-        uint32_t pslice = SliceGetLocked(vslice);
-
-        uint64_t offset_vmo = txn->rw.offset_vmo;
-        uint64_t length;
-        if (vslice == vslice_start) {
-            length = fbl::round_up(txn->rw.offset_dev + 1, blocks_per_slice) - txn->rw.offset_dev;
-        } else if (vslice == vslice_end) {
-            length = length_remaining;
-            offset_vmo += txn->rw.length - length_remaining;
-        } else {
-            length = blocks_per_slice;
-            offset_vmo += txns[0]->rw.length + blocks_per_slice * (i - 1);
-        }
-        ZX_DEBUG_ASSERT(length <= blocks_per_slice);
-        ZX_DEBUG_ASSERT(length <= length_remaining);
+        uint32_t pslice = SliceRunLocked(vslice, vslice_end, &run_end);
+        const uint64_t run_limit = fbl::min(txn_end, (run_end + 1) * blocks_per_slice);
+        ZX_DEBUG_ASSERT(run_limit > offset);
 
         txns.push_back(reinterpret_cast<block_op_t*>(new uint8_t[mgr_->BlockOpSize()]));
         if (txns[i] == nullptr) {
@@ -1124,15 +1190,15 @@ void VPartition::BlockImplQueue(block_op_t* txn, block_impl_queue_callback compl
             return;
         }
         memcpy(txns[i], txn, sizeof(*txn));
-        txns[i]->rw.offset_vmo = offset_vmo;
-        txns[i]->rw.length = static_cast<uint32_t>(length);
-        txns[i]->rw.offset_dev = SliceStart(disk_size, slice_size, pslice) / BlockSize();
-        if (vslice == vslice_start) {
-            txns[i]->rw.offset_dev += (txn->rw.offset_dev % blocks_per_slice);
-        }
-        length_remaining -= txns[i]->rw.length;
+        txns[i]->rw.offset_vmo = txn->rw.offset_vmo + (offset - txn->rw.offset_dev);
+        txns[i]->rw.length = static_cast<uint32_t>(run_limit - offset);
+        txns[i]->rw.offset_dev = SliceStart(disk_size, slice_size, pslice) / BlockSize() +
+                                 (offset % blocks_per_slice);
+
+        offset = run_limit;
+        vslice = run_end + 1;
     }
-    ZX_DEBUG_ASSERT(length_remaining == 0);
+    ZX_DEBUG_ASSERT(offset == txn_end);
 
     for (size_t i = 0; i < txn_count; i++) {
         mgr_->Queue(txns[i], multi_txn_completion, state.get());
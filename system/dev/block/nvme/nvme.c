@@ -4,6 +4,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -48,6 +49,7 @@ typedef struct {
     void* virt;         // io buffer virt base
     zx_handle_t pmt;    // pinned memory
     nvme_txn_t* txn;    // related txn
+    uint64_t prp_pages; // bitmask of the prp pool pages it has borrowed
     uint16_t id;
     uint16_t reserved0;
     uint32_t reserved1;
@@ -61,15 +63,33 @@ static_assert(PAGE_SIZE == (1ULL << PAGE_SHIFT), "");
 
 #define PAGE_MASK (PAGE_SIZE - 1ULL)
 
-// Limit maximum transfer size to 1MB which fits comfortably
-// within our single scatter gather page per utxn setup
-#define MAX_XFER (1024*1024)
+// Limit maximum transfer size to 8MB.  A utxn's own page holds
+// the PRP list of a transfer of up to 2MB; larger ones chain
+// further list pages borrowed from their queue's prp pool.
+#define MAX_XFER (8*1024*1024)
+
+// Number of PRP entries that fit in a PRP list page.
+#define PRP_ENTRIES (PAGE_SIZE / sizeof(uint64_t))
+
+// Number of pages in the prp pool of each io queue.
+#define PRP_POOL_COUNT 32
 
 // Maximum submission and completion queue item counts, for
 // queues that are a single page in size.
 #define SQMAX (PAGE_SIZE / sizeof(nvme_cmd_t))
 #define CQMAX (PAGE_SIZE / sizeof(nvme_cpl_t))
 
+// Maximum number of io submission/completion queue pairs.
+#define MAX_IO_QUEUES 8
+
+// dedicated pages of each io queue in the io queue page pool
+#define IOQ_IDX_SQ         0
+#define IOQ_IDX_CQ         1
+#define IOQ_IDX_UTXN_POOL  2
+#define IOQ_IDX_PRP_POOL   (IOQ_IDX_UTXN_POOL + UTXN_COUNT) // this must always be last
+
+#define IOQ_PAGE_COUNT (IOQ_IDX_PRP_POOL + PRP_POOL_COUNT)
+
 // global driver state bits
 #define FLAG_IRQ_THREAD_STARTED  0x0001
 #define FLAG_IO_THREAD_STARTED   0x0002
@@ -77,26 +97,33 @@ static_assert(PAGE_SIZE == (1ULL << PAGE_SHIFT), "");
 
 #define FLAG_HAS_VWC             0x0100
 
+typedef struct nvme_device nvme_device_t;
+
+// An io submission queue and the completion queue it posts to, along with the
+// txns and utxns being served through them.  Each queue pair has an io thread
+// of its own and, if there are enough interrupt vectors, a vector and irq
+// thread of its own too.  Otherwise it receives its completions on vector 0,
+// alongside the admin queue.
 typedef struct {
-    mmio_buffer_t mmio;
-    zx_handle_t irqh;
-    zx_handle_t bti;
-    uint32_t flags;
-    mtx_t lock;
+    nvme_device_t* nvme;
+    uint16_t id;        // queue id, shared by the sq and cq
+    uint16_t vector;    // interrupt vector the cq signals
+    uint32_t flags;     // FLAG_*_THREAD_STARTED
 
-    // io queue doorbell registers
-    void* io_sq_tail_db;
-    void* io_cq_head_db;
+    // doorbell registers
+    void* sq_tail_db;
+    void* cq_head_db;
 
-    nvme_cpl_t* io_cq;
-    nvme_cmd_t* io_sq;
-    uint32_t io_nsid;
-    uint16_t io_cq_head;
-    uint16_t io_cq_toggle;
-    uint16_t io_sq_tail;
-    uint16_t io_sq_head;
+    nvme_cpl_t* cq;
+    nvme_cmd_t* sq;
+    uint16_t cq_head;
+    uint16_t cq_toggle;
+    uint16_t sq_tail;
+    uint16_t sq_head;
 
     uint64_t utxn_avail;   // bitmask of available utxns
+    uint64_t prp_avail;    // bitmask of available prp pool pages
+    size_t page_base;      // index of its first page in the io queue page pool
 
     // The pending list is txns that have been received
     // via nvme_queue() and are waiting for io to start.
@@ -106,14 +133,39 @@ typedef struct {
     // The active list consists of txns where all utxns have
     // been created and we're waiting for them to complete or
     // error out.
+    mtx_t lock;
     list_node_t pending_txns;      // inbound txns to process
     list_node_t active_txns;       // txns in flight
 
     // The io signal completion is signaled from nvme_queue()
-    // or from the irq thread, notifying the io thread that
+    // or from an irq thread, notifying the io thread that
     // it has work to do.
     sync_completion_t io_signal;
 
+    zx_handle_t irqh;   // valid only if vector != 0
+    thrd_t irqthread;
+    thrd_t iothread;
+
+    // pool of utxns
+    nvme_utxn_t utxn[UTXN_COUNT];
+
+    // physical addresses of the pages of the transfer being set up by the
+    // io thread, before they are copied into its PRP list
+    zx_paddr_t pages[MAX_XFER / PAGE_SIZE + 1];
+} nvme_ioq_t;
+
+struct nvme_device {
+    mmio_buffer_t mmio;
+    zx_handle_t irqh;
+    zx_handle_t bti;
+    uint32_t flags;
+    uint32_t irq_count;
+
+    // io queues, of which the first ioq_count are initialized
+    nvme_ioq_t ioq[MAX_IO_QUEUES];
+    uint32_t ioq_count;
+    uint32_t io_nsid;
+
     uint32_t max_xfer;
     block_info_t info;
 
@@ -140,15 +192,13 @@ typedef struct {
 
     size_t iosz;
 
-    // source of physical pages for queues and admin commands
+    // source of physical pages for the admin queues and admin commands
     io_buffer_t iob;
+    // source of physical pages for the io queues and their utxn scatter lists
+    io_buffer_t ioq_iob;
 
     thrd_t irqthread;
-    thrd_t iothread;
-
-    // pool of utxns
-    nvme_utxn_t utxn[UTXN_COUNT];
-} nvme_device_t;
+};
 
 
 // We break IO transactions down into one or more "micro transactions" (utxn)
@@ -157,26 +207,79 @@ typedef struct {
 // queued to the NVME device.  This id is the same as its index into the
 // pool of utxns and the bitmask of free txns, to simplify management.
 //
-// We maintain a pool of 63 of these, which is the number of commands
+// Each io queue has a pool of 63 of these, which is the number of commands
 // that can be submitted to NVME via a single page submit queue.
 //
 // The utxns are not protected by locks.  Instead, after initialization,
-// they may only be touched by the io thread, which is responsible for
-// queueing commands and dequeuing completion messages.
+// they may only be touched by the io thread of their queue, which is
+// responsible for queueing commands and dequeuing completion messages.
 
-static nvme_utxn_t* utxn_get(nvme_device_t* nvme) {
-    uint64_t n = __builtin_ffsll(nvme->utxn_avail);
+static nvme_utxn_t* utxn_get(nvme_ioq_t* q) {
+    uint64_t n = __builtin_ffsll(q->utxn_avail);
     if (n == 0) {
         return NULL;
     }
     n--;
-    nvme->utxn_avail &= ~(1ULL << n);
-    return nvme->utxn + n;
+    q->utxn_avail &= ~(1ULL << n);
+    return q->utxn + n;
 }
 
-static void utxn_put(nvme_device_t* nvme, nvme_utxn_t* utxn) {
+static void utxn_put(nvme_ioq_t* q, nvme_utxn_t* utxn) {
     uint64_t n = utxn->id;
-    nvme->utxn_avail |= (1ULL << n);
+    q->utxn_avail |= (1ULL << n);
+    q->prp_avail |= utxn->prp_pages;
+    utxn->prp_pages = 0;
+}
+
+// Returns the number of PRP list pages needed to describe a transfer
+// touching |pagecount| pages.  The first page is never in the list, and
+// every list page but the last gives its final entry to the address of
+// the next one.
+static size_t prp_list_pages(size_t pagecount) {
+    if (pagecount <= 2) {
+        return 0;
+    }
+    size_t entries = pagecount - 1;
+    size_t count = 1;
+    while (entries > PRP_ENTRIES) {
+        entries -= PRP_ENTRIES - 1;
+        count++;
+    }
+    return count;
+}
+
+// Lends |count| pages of the prp pool to |utxn|, in addition to its own.
+// Returns false if there aren't that many available.
+static bool utxn_borrow_prp_pages(nvme_ioq_t* q, nvme_utxn_t* utxn, size_t count) {
+    if ((size_t) __builtin_popcountll(q->prp_avail) < count) {
+        return false;
+    }
+    while (count-- > 0) {
+        uint64_t page = q->prp_avail & -q->prp_avail;
+        q->prp_avail &= ~page;
+        utxn->prp_pages |= page;
+    }
+    return true;
+}
+
+// Writes the PRP list of a transfer of the |pagecount| pages |pages| into
+// |utxn|'s own page, chaining into the pages it has borrowed as needed.
+static void utxn_fill_prp_list(nvme_ioq_t* q, nvme_utxn_t* utxn, const zx_paddr_t* pages,
+                               size_t pagecount) {
+    io_buffer_t* iob = &q->nvme->ioq_iob;
+    uint64_t* list = utxn->virt;
+    uint64_t borrowed = utxn->prp_pages;
+    size_t slot = 0;
+    for (size_t n = 1; n < pagecount; n++) {
+        if ((slot == PRP_ENTRIES - 1) && (pagecount - n > 1)) {
+            size_t next = q->page_base + IOQ_IDX_PRP_POOL + __builtin_ctzll(borrowed);
+            borrowed &= borrowed - 1;
+            list[slot] = iob->phys_list[next];
+            list = iob->virt + next * PAGE_SIZE;
+            slot = 0;
+        }
+        list[slot++] = pages[n];
+    }
 }
 
 static zx_status_t nvme_admin_cq_get(nvme_device_t* nvme, nvme_cpl_t* cpl) {
@@ -215,44 +318,46 @@ static zx_status_t nvme_admin_sq_put(nvme_device_t* nvme, nvme_cmd_t* cmd) {
     return ZX_OK;
 }
 
-static zx_status_t nvme_io_cq_get(nvme_device_t* nvme, nvme_cpl_t* cpl) {
-    if ((readw(&nvme->io_cq[nvme->io_cq_head].status) & 1) != nvme->io_cq_toggle) {
+static zx_status_t nvme_io_cq_get(nvme_ioq_t* q, nvme_cpl_t* cpl) {
+    if ((readw(&q->cq[q->cq_head].status) & 1) != q->cq_toggle) {
         return ZX_ERR_SHOULD_WAIT;
     }
-    *cpl = nvme->io_cq[nvme->io_cq_head];
+    *cpl = q->cq[q->cq_head];
 
     // advance the head pointer, wrapping and inverting toggle at max
-    uint16_t next = (nvme->io_cq_head + 1) & (CQMAX - 1);
-    if ((nvme->io_cq_head = next) == 0) {
-        nvme->io_cq_toggle ^= 1;
+    uint16_t next = (q->cq_head + 1) & (CQMAX - 1);
+    if ((q->cq_head = next) == 0) {
+        q->cq_toggle ^= 1;
     }
 
     // note the new sq head reported by hw
-    nvme->io_sq_head = cpl->sq_head;
+    q->sq_head = cpl->sq_head;
     return ZX_OK;
 }
 
-static void nvme_io_cq_ack(nvme_device_t* nvme) {
+static void nvme_io_cq_ack(nvme_ioq_t* q) {
     // ring the doorbell
-    writel(nvme->io_cq_head, nvme->io_cq_head_db);
+    writel(q->cq_head, q->cq_head_db);
 }
 
-static zx_status_t nvme_io_sq_put(nvme_device_t* nvme, nvme_cmd_t* cmd) {
-    uint16_t next = (nvme->io_sq_tail + 1) & (SQMAX - 1);
+static zx_status_t nvme_io_sq_put(nvme_ioq_t* q, nvme_cmd_t* cmd) {
+    uint16_t next = (q->sq_tail + 1) & (SQMAX - 1);
 
     // if head+1 == tail: queue is full
-    if (next == nvme->io_sq_head) {
+    if (next == q->sq_head) {
         return ZX_ERR_SHOULD_WAIT;
     }
 
-    nvme->io_sq[nvme->io_sq_tail] = *cmd;
-    nvme->io_sq_tail = next;
+    q->sq[q->sq_tail] = *cmd;
+    q->sq_tail = next;
 
     // ring the doorbell
-    writel(next, nvme->io_sq_tail_db);
+    writel(next, q->sq_tail_db);
     return ZX_OK;
 }
 
+// Serves interrupt vector 0, which the admin completion queue shares with any
+// io queues without a vector of their own.
 static int irq_thread(void* arg) {
     nvme_device_t* nvme = arg;
     for (;;) {
@@ -268,7 +373,25 @@ static int irq_thread(void* arg) {
             sync_completion_signal(&nvme->admin_signal);
         }
 
-        sync_completion_signal(&nvme->io_signal);
+        for (uint32_t n = 0; n < nvme->ioq_count; n++) {
+            if (nvme->ioq[n].vector == 0) {
+                sync_completion_signal(&nvme->ioq[n].io_signal);
+            }
+        }
+    }
+    return 0;
+}
+
+// Serves the interrupt vector of an io queue which has one of its own.
+static int ioq_irq_thread(void* arg) {
+    nvme_ioq_t* q = arg;
+    for (;;) {
+        zx_status_t r;
+        if ((r = zx_interrupt_wait(q->irqh, NULL)) != ZX_OK) {
+            zxlogf(ERROR, "nvme: irq wait failed (queue %u): %d\n", q->id, r);
+            break;
+        }
+        sync_completion_signal(&q->io_signal);
     }
     return 0;
 }
@@ -305,7 +428,8 @@ static inline void txn_complete(nvme_txn_t* txn, zx_status_t status) {
 // Attempt to generate utxns and queue nvme commands for a txn
 // Returns true if this could not be completed due to temporary
 // lack of resources or false if either it succeeded or errored out.
-static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
+static bool io_process_txn(nvme_ioq_t* q, nvme_txn_t* txn) {
+    nvme_device_t* nvme = q->nvme;
     zx_handle_t vmo = txn->op.rw.vmo;
     nvme_utxn_t* utxn;
     zx_paddr_t* pages;
@@ -314,7 +438,7 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     for (;;) {
         // If there are no available utxns, we can't proceed
         // and we tell the caller to retain the txn (true)
-        if ((utxn = utxn_get(nvme)) == NULL) {
+        if ((utxn = utxn_get(q)) == NULL) {
             return true;
         }
 
@@ -335,11 +459,21 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         // Total pages mapped / touched
         size_t pagecount = (byteoffset + bytes + PAGE_MASK) >> PAGE_SHIFT;
 
+        // If the PRP list doesn't fit in the utxn's own page, borrow more
+        // from the pool, or failing that, transfer only what it can describe
+        size_t list_pages = prp_list_pages(pagecount);
+        if ((list_pages > 1) && !utxn_borrow_prp_pages(q, utxn, list_pages - 1)) {
+            pagecount = PRP_ENTRIES + 1;
+            blocks = (uint32_t) (((pagecount << PAGE_SHIFT) - byteoffset) / nvme->info.block_size);
+            bytes = ((size_t) blocks) * ((size_t) nvme->info.block_size);
+            pagecount = (byteoffset + bytes + PAGE_MASK) >> PAGE_SHIFT;
+        }
+
         // read disk (OP_READ) -> memory (PERM_WRITE) or
         // write memory (PERM_READ) -> disk (OP_WRITE)
         uint32_t opt = (txn->opcode == NVME_OP_READ) ? ZX_BTI_PERM_WRITE : ZX_BTI_PERM_READ;
 
-        pages = utxn->virt;
+        pages = q->pages;
 
         if ((r = zx_bti_pin(nvme->bti, opt, vmo, pageoffset, pagecount << PAGE_SHIFT,
                             pages, pagecount, &utxn->pmt)) != ZX_OK) {
@@ -356,12 +490,13 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         // The NVME command has room for two data pointers inline.
         // The first is always the pointer to the first page where data is.
         // The second is the second page if pagecount is 2.
-        // The second is the address of an array of page 2..n if pagecount > 2
+        // The second is the address of a list of pages 2..n if pagecount > 2
         cmd.dptr.prp[0] = pages[0] | byteoffset;
         if (pagecount == 2) {
             cmd.dptr.prp[1] = pages[1];
         } else if (pagecount > 2) {
-            cmd.dptr.prp[1] = utxn->phys + sizeof(uint64_t);
+            utxn_fill_prp_list(q, utxn, pages, pagecount);
+            cmd.dptr.prp[1] = utxn->phys;
         }
 
         zxlogf(TRACE, "nvme: txn=%p utxn id=%u pages=%zu op=%s\n", txn, utxn->id, pagecount,
@@ -370,7 +505,7 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         zxlogf(SPEW, "nvme: pages[] = { %016zx, %016zx, %016zx, %016zx, ... }\n",
                pages[0], pages[1], pages[2], pages[3]);
 
-        if ((r = nvme_io_sq_put(nvme, &cmd)) != ZX_OK) {
+        if ((r = nvme_io_sq_put(q, &cmd)) != ZX_OK) {
             zxlogf(ERROR, "nvme: could not submit cmd (txn=%p id=%u)\n", txn, utxn->id);
             break;
         }
@@ -387,9 +522,9 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
         // move this txn to the active list and tell the
         // caller not to retain the txn (false)
         if (txn->op.rw.length == 0) {
-            mtx_lock(&nvme->lock);
-            list_add_tail(&nvme->active_txns, &txn->node);
-            mtx_unlock(&nvme->lock);
+            mtx_lock(&q->lock);
+            list_add_tail(&q->active_txns, &txn->node);
+            mtx_unlock(&q->lock);
             return false;
         }
     }
@@ -398,17 +533,17 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     if ((r = zx_pmt_unpin(utxn->pmt)) != ZX_OK) {
         zxlogf(ERROR, "nvme: cannot unpin io buffer: %d\n", r);
     }
-    utxn_put(nvme, utxn);
+    utxn_put(q, utxn);
 
-    mtx_lock(&nvme->lock);
+    mtx_lock(&q->lock);
     txn->flags |= TXN_FLAG_FAILED;
     if (txn->pending_utxns) {
         // if there are earlier uncompleted IOs we become active now
         // and will finish erroring out when they complete
-        list_add_tail(&nvme->active_txns, &txn->node);
+        list_add_tail(&q->active_txns, &txn->node);
         txn = NULL;
     }
-    mtx_unlock(&nvme->lock);
+    mtx_unlock(&q->lock);
 
     if (txn != NULL) {
         txn_complete(txn, ZX_ERR_INTERNAL);
@@ -418,40 +553,40 @@ static bool io_process_txn(nvme_device_t* nvme, nvme_txn_t* txn) {
     return false;
 }
 
-static void io_process_txns(nvme_device_t* nvme) {
+static void io_process_txns(nvme_ioq_t* q) {
     nvme_txn_t* txn;
 
     for (;;) {
-        mtx_lock(&nvme->lock);
-        txn = list_remove_head_type(&nvme->pending_txns, nvme_txn_t, node);
-        mtx_unlock(&nvme->lock);
+        mtx_lock(&q->lock);
+        txn = list_remove_head_type(&q->pending_txns, nvme_txn_t, node);
+        mtx_unlock(&q->lock);
 
         if (txn == NULL) {
             return;
         }
 
-        if (io_process_txn(nvme, txn)) {
+        if (io_process_txn(q, txn)) {
             // put txn back at front of queue for further processing later
-            mtx_lock(&nvme->lock);
-            list_add_head(&nvme->pending_txns, &txn->node);
-            mtx_unlock(&nvme->lock);
+            mtx_lock(&q->lock);
+            list_add_head(&q->pending_txns, &txn->node);
+            mtx_unlock(&q->lock);
             return;
         }
     }
 }
 
-static void io_process_cpls(nvme_device_t* nvme) {
+static void io_process_cpls(nvme_ioq_t* q) {
     bool ring_doorbell = false;
     nvme_cpl_t cpl;
 
-    while (nvme_io_cq_get(nvme, &cpl) == ZX_OK) {
+    while (nvme_io_cq_get(q, &cpl) == ZX_OK) {
         ring_doorbell = true;
 
         if (cpl.cmd_id >= UTXN_COUNT) {
             zxlogf(ERROR, "nvme: unexpected cmd id %u\n", cpl.cmd_id);
             continue;
         }
-        nvme_utxn_t* utxn = nvme->utxn + cpl.cmd_id;
+        nvme_utxn_t* utxn = q->utxn + cpl.cmd_id;
         nvme_txn_t* txn = utxn->txn;
 
         if (txn == NULL) {
@@ -478,48 +613,61 @@ static void io_process_cpls(nvme_device_t* nvme) {
 
         // release the microtransaction
         utxn->txn = NULL;
-        utxn_put(nvme, utxn);
+        utxn_put(q, utxn);
 
         txn->pending_utxns--;
         if ((txn->pending_utxns == 0) && (txn->op.rw.length == 0)) {
             // remove from either pending or active list
-            mtx_lock(&nvme->lock);
+            mtx_lock(&q->lock);
             list_delete(&txn->node);
-            mtx_unlock(&nvme->lock);
+            mtx_unlock(&q->lock);
             zxlogf(TRACE, "nvme: txn %p %s\n", txn, txn->flags & TXN_FLAG_FAILED ? "error" : "okay");
             txn_complete(txn, txn->flags & TXN_FLAG_FAILED ? ZX_ERR_IO : ZX_OK);
         }
     }
 
     if (ring_doorbell) {
-        nvme_io_cq_ack(nvme);
+        nvme_io_cq_ack(q);
     }
 }
 
 static int io_thread(void* arg) {
-    nvme_device_t* nvme = arg;
+    nvme_ioq_t* q = arg;
     for (;;) {
-        if (sync_completion_wait(&nvme->io_signal, ZX_TIME_INFINITE)) {
+        if (sync_completion_wait(&q->io_signal, ZX_TIME_INFINITE)) {
             break;
         }
-        if (nvme->flags & FLAG_SHUTDOWN) {
+        if (q->nvme->flags & FLAG_SHUTDOWN) {
             //TODO: cancel out pending IO
-            zxlogf(INFO, "nvme: io thread exiting\n");
+            zxlogf(INFO, "nvme: io thread (queue %u) exiting\n", q->id);
             break;
         }
 
-        sync_completion_reset(&nvme->io_signal);
+        sync_completion_reset(&q->io_signal);
 
         // process completion messages
-        io_process_cpls(nvme);
+        io_process_cpls(q);
 
         // process work queue
-        io_process_txns(nvme);
+        io_process_txns(q);
 
     }
     return 0;
 }
 
+// Picks the io queue for txns submitted from the calling thread.  Each thread
+// is assigned a queue once, round-robin, so that every block fifo client,
+// which has a thread of its own, keeps to one queue and doesn't contend for it
+// with the other clients.
+static nvme_ioq_t* nvme_ioq_for_caller(nvme_device_t* nvme) {
+    static atomic_uint next_thread_index;
+    static thread_local unsigned thread_index = UINT_MAX;
+    if (thread_index == UINT_MAX) {
+        thread_index = atomic_fetch_add(&next_thread_index, 1);
+    }
+    return &nvme->ioq[thread_index % nvme->ioq_count];
+}
+
 static void nvme_queue(void* ctx, block_op_t* op, block_impl_queue_callback completion_cb,
                        void* cookie) {
     nvme_device_t* nvme = ctx;
@@ -564,11 +712,12 @@ static void nvme_queue(void* ctx, block_op_t* op, block_impl_queue_callback comp
            txn->opcode == NVME_OP_WRITE ? "wr" : "rd",
            txn->op.rw.length + 1U, txn->op.rw.offset_dev);
 
-    mtx_lock(&nvme->lock);
-    list_add_tail(&nvme->pending_txns, &txn->node);
-    mtx_unlock(&nvme->lock);
+    nvme_ioq_t* q = nvme_ioq_for_caller(nvme);
+    mtx_lock(&q->lock);
+    list_add_tail(&q->pending_txns, &txn->node);
+    mtx_unlock(&q->lock);
 
-    sync_completion_signal(&nvme->io_signal);
+    sync_completion_signal(&q->io_signal);
 }
 
 static void nvme_query(void* ctx, block_info_t* info_out, size_t* block_op_size_out) {
@@ -624,26 +773,36 @@ static void nvme_release(void* ctx) {
         // TODO: risks a handle use-after-close, will be resolved by IRQ api
         // changes coming soon
         zx_handle_close(nvme->irqh);
+        for (uint32_t n = 0; n < nvme->ioq_count; n++) {
+            zx_handle_close(nvme->ioq[n].irqh);
+        }
     }
     if (nvme->flags & FLAG_IRQ_THREAD_STARTED) {
         thrd_join(nvme->irqthread, &r);
     }
-    if (nvme->flags & FLAG_IO_THREAD_STARTED) {
-        sync_completion_signal(&nvme->io_signal);
-        thrd_join(nvme->iothread, &r);
-    }
+    for (uint32_t n = 0; n < nvme->ioq_count; n++) {
+        nvme_ioq_t* q = &nvme->ioq[n];
+        if (q->flags & FLAG_IRQ_THREAD_STARTED) {
+            thrd_join(q->irqthread, &r);
+        }
+        if (q->flags & FLAG_IO_THREAD_STARTED) {
+            sync_completion_signal(&q->io_signal);
+            thrd_join(q->iothread, &r);
+        }
 
-    // error out any pending txns
-    mtx_lock(&nvme->lock);
-    nvme_txn_t* txn;
-    while ((txn = list_remove_head_type(&nvme->active_txns, nvme_txn_t, node)) != NULL) {
-        txn_complete(txn, ZX_ERR_PEER_CLOSED);
-    }
-    while ((txn = list_remove_head_type(&nvme->pending_txns, nvme_txn_t, node)) != NULL) {
-        txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        // error out any pending txns
+        mtx_lock(&q->lock);
+        nvme_txn_t* txn;
+        while ((txn = list_remove_head_type(&q->active_txns, nvme_txn_t, node)) != NULL) {
+            txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        }
+        while ((txn = list_remove_head_type(&q->pending_txns, nvme_txn_t, node)) != NULL) {
+            txn_complete(txn, ZX_ERR_PEER_CLOSED);
+        }
+        mtx_unlock(&q->lock);
     }
-    mtx_unlock(&nvme->lock);
 
+    io_buffer_release(&nvme->ioq_iob);
     io_buffer_release(&nvme->iob);
     free(nvme);
 }
@@ -690,15 +849,12 @@ static void infostring(const char* prefix, uint8_t* str, size_t len) {
 #define wr32(v,r) writel(v, nvme->mmio.vaddr + NVME_REG_##r)
 #define wr64(v,r) writell(v, nvme->mmio.vaddr + NVME_REG_##r)
 
-// dedicated pages from the page pool
+// dedicated pages from the admin page pool
 #define IDX_ADMIN_SQ   0
 #define IDX_ADMIN_CQ   1
-#define IDX_IO_SQ      2
-#define IDX_IO_CQ      3
-#define IDX_SCRATCH    4
-#define IDX_UTXN_POOL  5 // this must always be last
+#define IDX_SCRATCH    2
 
-#define IO_PAGE_COUNT  (IDX_UTXN_POOL + UTXN_COUNT)
+#define IO_PAGE_COUNT  3
 
 static inline uint64_t U64(uint8_t* x) {
     return *((uint64_t*) (void*) x);
@@ -712,6 +868,93 @@ static inline uint32_t U16(uint8_t* x) {
 
 #define WAIT_MS 5000
 
+// Sets up io queue pair #n, using its pages of the io queue page pool, creates
+// it on the controller, and starts its threads.  Once this is called, the
+// queue is torn down by nvme_release(), whether or not this succeeds.
+static zx_status_t nvme_ioq_create(nvme_device_t* nvme, uint32_t n, uint64_t cap) {
+    nvme_ioq_t* q = &nvme->ioq[n];
+    const size_t base = n * IOQ_PAGE_COUNT;
+
+    q->nvme = nvme;
+    q->id = (uint16_t) (n + 1);
+    q->vector = (nvme->irq_count > 1) ? q->id : 0;
+    q->page_base = base;
+    q->irqh = ZX_HANDLE_INVALID;
+    mtx_init(&q->lock, mtx_plain);
+    list_initialize(&q->pending_txns);
+    list_initialize(&q->active_txns);
+
+    // initialize the microtransaction pool
+    q->utxn_avail = 0x7FFFFFFFFFFFFFFFULL;
+    q->prp_avail = (1ULL << PRP_POOL_COUNT) - 1;
+    for (unsigned i = 0; i < UTXN_COUNT; i++) {
+        q->utxn[i].id = i;
+        q->utxn[i].phys = nvme->ioq_iob.phys_list[base + IOQ_IDX_UTXN_POOL + i];
+        q->utxn[i].virt = nvme->ioq_iob.virt + (base + IOQ_IDX_UTXN_POOL + i) * PAGE_SIZE;
+    }
+
+    // registers and buffers for the queues
+    q->sq_tail_db = nvme->mmio.vaddr + NVME_REG_SQnTDBL(q->id, cap);
+    q->cq_head_db = nvme->mmio.vaddr + NVME_REG_CQnHDBL(q->id, cap);
+
+    q->sq = nvme->ioq_iob.virt + PAGE_SIZE * (base + IOQ_IDX_SQ);
+    q->sq_head = 0;
+    q->sq_tail = 0;
+
+    q->cq = nvme->ioq_iob.virt + PAGE_SIZE * (base + IOQ_IDX_CQ);
+    q->cq_head = 0;
+    q->cq_toggle = 1;
+
+    nvme->ioq_count = n + 1;
+
+    // create the IO completion queue
+    nvme_cmd_t cmd;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOCQ);
+    cmd.dptr.prp[0] = nvme->ioq_iob.phys_list[base + IOQ_IDX_CQ];
+    cmd.u.raw[0] = ((CQMAX - 1) << 16) | q->id; // queue size, queue id
+    cmd.u.raw[1] = (q->vector << 16) | 2 | 1; // irq vector, irq enable, phys contig
+
+    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+        zxlogf(ERROR, "nvme: completion queue %u creation op failed\n", q->id);
+        return ZX_ERR_INTERNAL;
+    }
+
+    // create the IO submit queue
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOSQ);
+    cmd.dptr.prp[0] = nvme->ioq_iob.phys_list[base + IOQ_IDX_SQ];
+    cmd.u.raw[0] = ((SQMAX - 1) << 16) | q->id; // queue size, queue id
+    cmd.u.raw[1] = (q->id << 16) | 0 | 1; // cqid, qprio, phys contig
+
+    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
+        zxlogf(ERROR, "nvme: submit queue %u creation op failed\n", q->id);
+        return ZX_ERR_INTERNAL;
+    }
+
+    char name[ZX_MAX_NAME_LEN];
+    if (q->vector != 0) {
+        if (pci_map_interrupt(&nvme->pci, q->vector, &q->irqh) != ZX_OK) {
+            zxlogf(ERROR, "nvme: could not map irq %u\n", q->vector);
+            return ZX_ERR_INTERNAL;
+        }
+        snprintf(name, sizeof(name), "nvme-irq-thread-%u", q->id);
+        if (thrd_create_with_name(&q->irqthread, ioq_irq_thread, q, name)) {
+            zxlogf(ERROR, "nvme; cannot create irq thread\n");
+            return ZX_ERR_INTERNAL;
+        }
+        q->flags |= FLAG_IRQ_THREAD_STARTED;
+    }
+
+    snprintf(name, sizeof(name), "nvme-io-thread-%u", q->id);
+    if (thrd_create_with_name(&q->iothread, io_thread, q, name)) {
+        zxlogf(ERROR, "nvme; cannot create io thread\n");
+        return ZX_ERR_INTERNAL;
+    }
+    q->flags |= FLAG_IO_THREAD_STARTED;
+    return ZX_OK;
+}
+
 static zx_status_t nvme_init(nvme_device_t* nvme) {
     uint32_t n = rd32(VS);
     uint64_t cap = rd64(CAP);
@@ -734,7 +977,8 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
         zxlogf(ERROR, "nvme: minimum page size larger than platform page size\n");
         return ZX_ERR_NOT_SUPPORTED;
     }
-    // allocate pages for various queues and the utxn scatter lists
+    // allocate pages for the admin queues; those of the io queues are allocated
+    // once we know how many there are
     // TODO: these should all be RO to hardware apart from the scratch io page(s)
     if (io_buffer_init(&nvme->iob, nvme->bti, PAGE_SIZE * IO_PAGE_COUNT, IO_BUFFER_RW) ||
         io_buffer_physmap(&nvme->iob)) {
@@ -742,14 +986,6 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
         return ZX_ERR_NO_MEMORY;
     }
 
-    // initialize the microtransaction pool
-    nvme->utxn_avail = 0x7FFFFFFFFFFFFFFFULL;
-    for (unsigned n = 0; n < UTXN_COUNT; n++) {
-        nvme->utxn[n].id = n;
-        nvme->utxn[n].phys = nvme->iob.phys_list[IDX_UTXN_POOL + n];
-        nvme->utxn[n].virt = nvme->iob.virt + (IDX_UTXN_POOL + n) * PAGE_SIZE;
-    }
-
     if (rd32(CSTS) & NVME_CSTS_RDY) {
         zxlogf(INFO, "nvme: controller is active. resetting...\n");
         wr32(rd32(CC) & ~NVME_CC_EN, CC); // disable
@@ -799,18 +1035,6 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     nvme->admin_cq_head = 0;
     nvme->admin_cq_toggle = 1;
 
-    // registers and buffers for IO queues
-    nvme->io_sq_tail_db = nvme->mmio.vaddr + NVME_REG_SQnTDBL(1, cap);
-    nvme->io_cq_head_db = nvme->mmio.vaddr + NVME_REG_CQnHDBL(1, cap);
-
-    nvme->io_sq = nvme->iob.virt + PAGE_SIZE * IDX_IO_SQ;
-    nvme->io_sq_head = 0;
-    nvme->io_sq_tail = 0;
-
-    nvme->io_cq = nvme->iob.virt + PAGE_SIZE * IDX_IO_CQ;
-    nvme->io_cq_head = 0;
-    nvme->io_cq_toggle = 1;
-
     // scratch page for admin ops
     void* scratch = nvme->iob.virt + PAGE_SIZE * IDX_SCRATCH;
 
@@ -820,12 +1044,6 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     }
     nvme->flags |= FLAG_IRQ_THREAD_STARTED;
 
-    if (thrd_create_with_name(&nvme->iothread, io_thread, nvme, "nvme-io-thread")) {
-        zxlogf(ERROR, "nvme; cannot create io thread\n");
-        return ZX_ERR_INTERNAL;
-    }
-    nvme->flags |= FLAG_IO_THREAD_STARTED;
-
     nvme_cmd_t cmd;
 
     // identify device
@@ -902,11 +1120,21 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     FEATURE(ONCS, WRITE_UNCORRECTABLE);
     FEATURE(ONCS, COMPARE);
 
-    // set feature (number of queues) to 1 iosq and 1 iocq
+    // Ask for an io queue pair per cpu.  With enough MSI-X vectors, each gets
+    // a vector of its own; otherwise they all share vector 0.
+    uint32_t ioq_count = zx_system_get_num_cpus();
+    if (ioq_count > MAX_IO_QUEUES) {
+        ioq_count = MAX_IO_QUEUES;
+    }
+    if ((nvme->irq_count > 1) && (ioq_count > nvme->irq_count - 1)) {
+        ioq_count = nvme->irq_count - 1;
+    }
+
+    // set feature (number of queues) to ioq_count iosqs and iocqs
     memset(&cmd, 0, sizeof(cmd));
     cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_SET_FEATURE);
     cmd.u.raw[0] = NVME_FEATURE_NUMBER_OF_QUEUES;
-    cmd.u.raw[1] = 0;
+    cmd.u.raw[1] = ((ioq_count - 1) << 16) | (ioq_count - 1);
 
     nvme_cpl_t cpl;
     if (nvme_admin_txn(nvme, &cmd, &cpl) != ZX_OK) {
@@ -915,28 +1143,26 @@ static zx_status_t nvme_init(nvme_device_t* nvme) {
     }
     zxlogf(INFO,"cpl.cmd %08x\n", cpl.cmd);
 
-    // create the IO completion queue
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOCQ);
-    cmd.dptr.prp[0] = nvme->iob.phys_list[IDX_IO_CQ];
-    cmd.u.raw[0] = ((CQMAX - 1) << 16) | 1; // queue size, queue id
-    cmd.u.raw[1] = (0 << 16) | 2 | 1; // irq vector, irq enable, phys contig
-
-    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
-        zxlogf(ERROR, "nvme: completion queue creation op failed\n");
-        return ZX_ERR_INTERNAL;
+    // The controller reports how many of each it allocated, less one.
+    if (ioq_count > (cpl.cmd & 0xFFFF) + 1) {
+        ioq_count = (cpl.cmd & 0xFFFF) + 1;
     }
+    if (ioq_count > (cpl.cmd >> 16) + 1) {
+        ioq_count = (cpl.cmd >> 16) + 1;
+    }
+    zxlogf(INFO, "nvme: io queues: %u, irq vectors: %u\n", ioq_count, nvme->irq_count);
 
-    // create the IO submit queue
-    memset(&cmd, 0, sizeof(cmd));
-    cmd.cmd = NVME_CMD_CID(0) | NVME_CMD_PRP | NVME_CMD_NORMAL | NVME_CMD_OPC(NVME_ADMIN_OP_CREATE_IOSQ);
-    cmd.dptr.prp[0] = nvme->iob.phys_list[IDX_IO_SQ];
-    cmd.u.raw[0] = ((SQMAX - 1) << 16) | 1; // queue size, queue id
-    cmd.u.raw[1] = (1 << 16) | 0 | 1; // cqid, qprio, phys contig
-
-    if (nvme_admin_txn(nvme, &cmd, NULL) != ZX_OK) {
-        zxlogf(ERROR, "nvme: submit queue creation op failed\n");
-        return ZX_ERR_INTERNAL;
+    // allocate pages for the io queues and their utxn scatter lists
+    if (io_buffer_init(&nvme->ioq_iob, nvme->bti, PAGE_SIZE * IOQ_PAGE_COUNT * ioq_count,
+                       IO_BUFFER_RW) ||
+        io_buffer_physmap(&nvme->ioq_iob)) {
+        zxlogf(ERROR, "nvme: could not allocate io queue buffers\n");
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (uint32_t n = 0; n < ioq_count; n++) {
+        if (nvme_ioq_create(nvme, n, cap) != ZX_OK) {
+            return ZX_ERR_INTERNAL;
+        }
     }
 
     // identify namespace 1
@@ -1020,9 +1246,6 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     if ((nvme = calloc(1, sizeof(nvme_device_t))) == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
-    list_initialize(&nvme->pending_txns);
-    list_initialize(&nvme->active_txns);
-    mtx_init(&nvme->lock, mtx_plain);
     mtx_init(&nvme->admin_lock, mtx_plain);
 
     if (device_get_protocol(dev, ZX_PROTOCOL_PCI, &nvme->pci)) {
@@ -1039,9 +1262,21 @@ static zx_status_t nvme_bind(void* ctx, zx_device_t* dev) {
     };
     uint32_t nirq = 0;
     for (unsigned n = 0; n < countof(modes); n++) {
-        if ((pci_query_irq_mode(&nvme->pci, modes[n], &nirq) == ZX_OK) &&
-            (pci_set_irq_mode(&nvme->pci, modes[n], 1) == ZX_OK)) {
-            zxlogf(INFO, "nvme: irq mode %u, irq count %u (#%u)\n", modes[n], nirq, n);
+        if (pci_query_irq_mode(&nvme->pci, modes[n], &nirq) != ZX_OK) {
+            continue;
+        }
+        // With MSI-X, ask for a vector per io queue, on top of the admin
+        // queue's, settling for a single one if that fails.
+        uint32_t count = 1;
+        if ((modes[n] == ZX_PCIE_IRQ_MODE_MSI_X) && (nirq > 1)) {
+            count = (nirq < MAX_IO_QUEUES + 1) ? nirq : (MAX_IO_QUEUES + 1);
+            if (pci_set_irq_mode(&nvme->pci, modes[n], count) != ZX_OK) {
+                count = 1;
+            }
+        }
+        if ((count > 1) || (pci_set_irq_mode(&nvme->pci, modes[n], 1) == ZX_OK)) {
+            zxlogf(INFO, "nvme: irq mode %u, irq count %u/%u (#%u)\n", modes[n], count, nirq, n);
+            nvme->irq_count = count;
             goto irq_configured;
         }
     }
@@ -50,6 +50,14 @@ typedef struct ramdisk_device {
     bool asleep; // true if the ramdisk is "sleeping"
     uint64_t sa_blk_count; // number of blocks to sleep after
     ramdisk_blk_counts_t blk_counts; // current block counts
+    ramdisk_perf_t perf; // the device being emulated
+
+    // Only accessed by the worker thread: the operations which are done but
+    // held back by |perf|, by completion time, and when the emulated device
+    // is next free to move data.
+    list_node_t delayed_list;
+    size_t delayed_count;
+    zx_time_t busy_until;
 
     thrd_t worker;
     char name[NAME_MAX];
@@ -60,31 +68,113 @@ typedef struct {
     list_node_t node;
     block_impl_queue_callback completion_cb;
     void* cookie;
+    // While on the delayed list.
+    zx_status_t status;
+    zx_time_t deadline;
 } ramdisk_txn_t;
 
+// Drops the contents of the blocks in the range. Whole pages are decommitted,
+// so that a ramdisk doesn't keep memory for blocks its filesystem has freed,
+// and the rest is zeroed.
+static zx_status_t ramdisk_trim(ramdisk_device_t* dev, uint64_t offset_dev, uint64_t length) {
+    size_t start = offset_dev * dev->blk_size;
+    size_t end = start + length * dev->blk_size;
+    size_t page_start = ROUNDUP(start, PAGE_SIZE);
+    size_t page_end = ROUNDDOWN(end, PAGE_SIZE);
+    if (page_start >= page_end) {
+        memset((void*) dev->mapped_addr + start, 0, end - start);
+        return ZX_OK;
+    }
+    memset((void*) dev->mapped_addr + start, 0, page_start - start);
+    memset((void*) dev->mapped_addr + page_end, 0, end - page_end);
+    return zx_vmo_op_range(dev->vmo, ZX_VMO_OP_DECOMMIT, page_start, page_end - page_start,
+                           NULL, 0);
+}
+
+// Completes |txn|, which moved |bytes| bytes, or holds it back until the
+// device modelled by |perf| would have completed it.
+static void ramdisk_complete(ramdisk_device_t* dev, const ramdisk_perf_t* perf,
+                             ramdisk_txn_t* txn, zx_status_t status, uint64_t bytes) {
+    if (perf->latency == 0 && perf->bytes_per_sec == 0) {
+        if (txn->completion_cb) {
+            txn->completion_cb(txn->cookie, status, &txn->op);
+        }
+        return;
+    }
+
+    zx_time_t done = zx_clock_get_monotonic();
+    if (perf->bytes_per_sec != 0 && bytes != 0) {
+        // Transfers take turns on the emulated device.
+        done = MAX(done, dev->busy_until) + (zx_duration_t)(bytes * ZX_SEC(1) /
+                                                             perf->bytes_per_sec);
+        dev->busy_until = done;
+    }
+    txn->status = status;
+    txn->deadline = done + perf->latency;
+
+    ramdisk_txn_t* pos;
+    list_for_every_entry(&dev->delayed_list, pos, ramdisk_txn_t, node) {
+        if (pos->deadline > txn->deadline) {
+            // Adding to the "tail" of an entry inserts before it.
+            list_add_tail(&pos->node, &txn->node);
+            dev->delayed_count++;
+            return;
+        }
+    }
+    list_add_tail(&dev->delayed_list, &txn->node);
+    dev->delayed_count++;
+}
+
+// Completes the delayed operations whose time has come. Returns when the
+// next of them is due.
+static zx_time_t ramdisk_complete_due(ramdisk_device_t* dev) {
+    zx_time_t now = zx_clock_get_monotonic();
+    ramdisk_txn_t* txn;
+    while ((txn = list_peek_head_type(&dev->delayed_list, ramdisk_txn_t, node)) != NULL) {
+        if (txn->deadline > now) {
+            return txn->deadline;
+        }
+        list_delete(&txn->node);
+        dev->delayed_count--;
+        if (txn->completion_cb) {
+            txn->completion_cb(txn->cookie, txn->status, &txn->op);
+        }
+    }
+    return ZX_TIME_INFINITE;
+}
+
 // The worker thread processes messages from iotxns in the background
 static int worker_thread(void* arg) {
     zx_status_t status = ZX_OK;
     ramdisk_device_t* dev = (ramdisk_device_t*)arg;
     ramdisk_txn_t* txn = NULL;
-    bool dead, asleep, defer;
+    bool dead, asleep, defer, full;
     size_t blocks = 0;
+    ramdisk_perf_t perf;
 
     for (;;) {
         for (;;) {
+            zx_time_t next_due = ramdisk_complete_due(dev);
+
             mtx_lock(&dev->lock);
             txn = NULL;
             dead = dev->dead;
             asleep = dev->asleep;
             defer = (dev->flags & RAMDISK_FLAG_RESUME_ON_WAKE) != 0;
             blocks = dev->sa_blk_count;
-
-            if (!asleep) {
+            perf = dev->perf;
+            // An emulated device with a full queue takes nothing new until
+            // an operation completes.
+            full = perf.queue_depth != 0 && dev->delayed_count >= perf.queue_depth;
+
+            if (full) {
+                // Leave everything queued.
+            } else if (!asleep) {
                 // If we are awake, try grabbing pending transactions from the deferred list.
                 txn = list_remove_head_type(&dev->deferred_list, ramdisk_txn_t, node);
             }
 
-            if (txn == NULL) {
+            if (txn == NULL && !full) {
                 // If no transactions were available in the deferred list (or we are asleep),
                 // grab one from the regular txn_list.
                 txn = list_remove_head_type(&dev->txn_list, ramdisk_txn_t, node);
@@ -97,13 +187,21 @@ static int worker_thread(void* arg) {
             }
 
             if (txn == NULL) {
-                sync_completion_wait(&dev->signal, ZX_TIME_INFINITE);
+                sync_completion_wait_deadline(&dev->signal, next_due);
             } else {
                 sync_completion_reset(&dev->signal);
                 break;
             }
         }
 
+        if (txn->op.command == BLOCK_OP_TRIM) {
+            // Like reads, trims succeed even if the ramdisk is "asleep", and
+            // aren't counted.
+            status = ramdisk_trim(dev, txn->op.rw.offset_dev, txn->op.rw.length);
+            ramdisk_complete(dev, &perf, txn, status, 0);
+            continue;
+        }
+
         size_t txn_blocks = txn->op.rw.length;
         if (txn->op.command == BLOCK_OP_READ || blocks == 0 || blocks > txn_blocks) {
             // If the ramdisk is not configured to sleep after x blocks, or the number of blocks in
@@ -181,12 +279,17 @@ static int worker_thread(void* arg) {
             }
         }
 
-        if (txn->completion_cb) {
-            txn->completion_cb(txn->cookie, status, &txn->op);
-        }
+        ramdisk_complete(dev, &perf, txn, status, length);
     }
 
 goodbye:
+    // The delayed operations are done, so they keep their results.
+    for (ramdisk_txn_t* delayed;
+         (delayed = list_remove_head_type(&dev->delayed_list, ramdisk_txn_t, node)) != NULL;) {
+        if (delayed->completion_cb) {
+            delayed->completion_cb(delayed->cookie, delayed->status, &delayed->op);
+        }
+    }
     while (txn != NULL) {
         txn->completion_cb(txn->cookie, ZX_ERR_BAD_STATE, &txn->op);
         txn = list_remove_head_type(&dev->deferred_list, ramdisk_txn_t, node);
@@ -211,7 +314,7 @@ static void ramdisk_get_info(void* ctx, block_info_t* info) {
     info->block_count = ramdev->blk_count;
     // Arbitrarily set, but matches the SATA driver for testing
     info->max_transfer_size = MAX_TRANSFER_SIZE;
-    info->flags = ramdev->flags;
+    info->flags = ramdev->flags | BLOCK_FLAG_TRIM_SUPPORT;
 }
 
 // implement device protocol:
@@ -271,6 +374,21 @@ static zx_status_t ramdisk_ioctl(void* ctx, uint32_t op, const void* cmd, size_t
         mtx_unlock(&ramdev->lock);
         return ZX_OK;
     }
+    case IOCTL_RAMDISK_SET_PERFORMANCE: {
+        if (cmd_len < sizeof(ramdisk_perf_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        const ramdisk_perf_t* perf = cmd;
+        if (perf->latency < 0) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        mtx_lock(&ramdev->lock);
+        ramdev->perf = *perf;
+        mtx_unlock(&ramdev->lock);
+        // A deeper queue may let the worker take more operations.
+        sync_completion_signal(&ramdev->signal);
+        return ZX_OK;
+    }
     case IOCTL_RAMDISK_GET_BLK_COUNTS: {
         if (max < sizeof(ramdisk_blk_counts_t)) {
             return ZX_ERR_INVALID_ARGS;
@@ -322,6 +440,7 @@ static void ramdisk_queue(void* ctx, block_op_t* bop, block_impl_queue_callback
 
     switch ((txn->op.command &= BLOCK_OP_MASK)) {
     case BLOCK_OP_READ:
+    case BLOCK_OP_TRIM:
         read = true;
         __FALLTHROUGH;
     case BLOCK_OP_WRITE:
@@ -436,6 +555,7 @@ static zx_status_t ramctl_config(ramctl_device_t* ramctl, zx_handle_t vmo,
     }
     list_initialize(&ramdev->txn_list);
     list_initialize(&ramdev->deferred_list);
+    list_initialize(&ramdev->delayed_list);
     if (thrd_create(&ramdev->worker, worker_thread, ramdev) != thrd_success) {
         goto fail_unmap;
     }
@@ -177,12 +177,45 @@ static zx_status_t mmc_decode_ext_csd(sdmmc_device_t* dev, const uint8_t* raw_ex
     dev->block_info.block_count = sectors * MMC_SECTOR_SIZE / MMC_BLOCK_SIZE;
     dev->block_info.block_size = (uint32_t)MMC_BLOCK_SIZE;
 
+    if (raw_ext_csd[MMC_EXT_CSD_SEC_FEATURE_SUPPORT] & MMC_EXT_CSD_SEC_GB_CL_EN) {
+        dev->trim_supported = true;
+        dev->block_info.flags |= BLOCK_FLAG_TRIM_SUPPORT;
+    }
+
     zxlogf(TRACE, "mmc: found card with capacity = %" PRIu64 "B\n",
            dev->block_info.block_count * dev->block_info.block_size);
 
     return ZX_OK;
 }
 
+static uint32_t mmc_cache_size(sdmmc_device_t* dev) {
+    // In units of kilobytes
+    const uint8_t* size = &dev->raw_ext_csd[MMC_EXT_CSD_CACHE_SIZE_LSB];
+    return size[0] | (size[1] << 8) | (size[2] << 16) | ((uint32_t)size[3] << 24);
+}
+
+static void mmc_enable_cache(sdmmc_device_t* dev) {
+    // Small random writes are much faster when the card can absorb them in
+    // its cache. Running without it is only slower, so this never fails.
+    uint32_t size = mmc_cache_size(dev);
+    if (size == 0) {
+        return;
+    }
+    if (mmc_do_switch(dev, MMC_EXT_CSD_CACHE_CTRL, 1) != ZX_OK) {
+        zxlogf(ERROR, "mmc: failed to enable the %u KB cache\n", size);
+        return;
+    }
+    dev->cache_enabled = true;
+    zxlogf(TRACE, "mmc: enabled the %u KB cache\n", size);
+}
+
+zx_status_t mmc_flush_cache(sdmmc_device_t* dev) {
+    if (!dev->cache_enabled) {
+        return ZX_OK;
+    }
+    return mmc_do_switch(dev, MMC_EXT_CSD_FLUSH_CACHE, 1);
+}
+
 static bool mmc_supports_hs(sdmmc_device_t* dev) {
     uint8_t device_type = dev->raw_ext_csd[MMC_EXT_CSD_DEVICE_TYPE];
     return (device_type & (1 << 1));
@@ -354,8 +387,10 @@ zx_status_t sdmmc_probe_mmc(sdmmc_device_t* dev) {
         dev->timing = SDMMC_TIMING_LEGACY;
     }
 
-    zxlogf(INFO, "mmc: initialized mmc @ %u MHz, bus width %d, timing %d\n",
-            dev->clock_rate / 1000000, dev->bus_width, dev->timing);
+    mmc_enable_cache(dev);
+
+    zxlogf(INFO, "mmc: initialized mmc @ %u MHz, bus width %d, timing %d, cache %d\n",
+            dev->clock_rate / 1000000, dev->bus_width, dev->timing, dev->cache_enabled);
 
 err:
     return st;
@@ -369,3 +369,26 @@ zx_status_t mmc_switch(sdmmc_device_t* dev, uint8_t index, uint8_t value) {
     };
     return sdmmc_request(&dev->host, &req);
 }
+
+zx_status_t mmc_erase(sdmmc_device_t* dev, uint32_t start, uint32_t end, uint32_t arg) {
+    sdmmc_req_t req = {
+        .cmd_idx = MMC_ERASE_GROUP_START,
+        .arg = start,
+        .cmd_flags = MMC_ERASE_GROUP_START_FLAGS,
+        .use_dma = sdmmc_use_dma(dev),
+    };
+    zx_status_t st = sdmmc_request(&dev->host, &req);
+    if (st != ZX_OK) {
+        return st;
+    }
+    req.cmd_idx = MMC_ERASE_GROUP_END;
+    req.arg = end;
+    req.cmd_flags = MMC_ERASE_GROUP_END_FLAGS;
+    if ((st = sdmmc_request(&dev->host, &req)) != ZX_OK) {
+        return st;
+    }
+    req.cmd_idx = MMC_ERASE;
+    req.arg = arg;
+    req.cmd_flags = MMC_ERASE_FLAGS;
+    return sdmmc_request(&dev->host, &req);
+}
@@ -40,6 +40,9 @@
 
 #define BLOCK_OP(op)    ((op) & BLOCK_OP_MASK)
 
+// The most blocks trimmed by a single erase command (32MB)
+#define MMC_TRIM_MAX_BLOCKS     65536
+
 // block io transactions. one per client request
 typedef struct sdmmc_txn {
     block_op_t bop;
@@ -118,6 +121,9 @@ static void sdmmc_release(void* ctx) {
         SDMMC_UNLOCK(dev);
 
         thrd_join(dev->worker_thread, NULL);
+
+        // Nothing else is using the card now, so the cache can be written back.
+        mmc_flush_cache(dev);
     }
 
     if (dev->worker_event != ZX_HANDLE_INVALID) {
@@ -167,6 +173,22 @@ static void sdmmc_queue(void* ctx, block_op_t* btxn, block_impl_queue_callback c
         // queue the flush op. because there is no out of order execution in this
         // driver, when this op gets processed all previous ops are complete.
         break;
+    case BLOCK_OP_TRIM: {
+        uint64_t max = dev->block_info.block_count;
+        if (!dev->trim_supported) {
+            block_complete(txn, ZX_ERR_NOT_SUPPORTED, dev);
+            return;
+        }
+        if ((btxn->rw.offset_dev >= max) || ((max - btxn->rw.offset_dev) < btxn->rw.length)) {
+            block_complete(txn, ZX_ERR_OUT_OF_RANGE, dev);
+            return;
+        }
+        if (btxn->rw.length == 0) {
+            block_complete(txn, ZX_OK, dev);
+            return;
+        }
+        break;
+    }
     default:
         block_complete(txn, ZX_ERR_NOT_SUPPORTED, dev);
         return;
@@ -268,9 +290,34 @@ static void sdmmc_do_txn(sdmmc_device_t* dev, sdmmc_txn_t* txn) {
             cmd_flags = SDMMC_WRITE_BLOCK_FLAGS;
         }
         break;
-    case BLOCK_OP_FLUSH:
-        block_complete(txn, ZX_OK, dev);
+    case BLOCK_OP_TRIM: {
+        // Each erase keeps the card busy until it is done, so a large trim is
+        // sent in pieces to stay within the host's busy timeout.
+        zx_status_t st = ZX_OK;
+        uint64_t offset = txn->bop.rw.offset_dev;
+        uint64_t end = offset + txn->bop.rw.length;
+        while (offset < end) {
+            uint64_t length = MIN(end - offset, MMC_TRIM_MAX_BLOCKS);
+            st = mmc_erase(dev, (uint32_t)offset, (uint32_t)(offset + length - 1),
+                           MMC_ERASE_TRIM_ARG);
+            if (st != ZX_OK) {
+                zxlogf(ERROR, "sdmmc: trim error %d\n", st);
+                break;
+            }
+            offset += length;
+        }
+        block_complete(txn, st, dev);
+        return;
+    }
+    case BLOCK_OP_FLUSH: {
+        // Writes only reach the media once the card's cache is flushed.
+        zx_status_t st = mmc_flush_cache(dev);
+        if (st != ZX_OK) {
+            zxlogf(ERROR, "sdmmc: cache flush error %d\n", st);
+        }
+        block_complete(txn, st, dev);
         return;
+    }
     default:
         // should not get here
         zxlogf(ERROR, "sdmmc: do_txn invalid block op %d\n", BLOCK_OP(txn->bop.command));
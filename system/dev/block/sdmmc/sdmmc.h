@@ -56,6 +56,8 @@ typedef struct sdmmc_device {
     uint32_t raw_cid[4];
     uint32_t raw_csd[4];
     uint8_t raw_ext_csd[512];
+    bool cache_enabled;     // Volatile write cache, flushed by BLOCK_OP_FLUSH
+    bool trim_supported;    // BLOCK_OP_TRIM is sent as a TRIM erase
 
     // sdio
     sdio_device_t sdio_dev;
@@ -130,6 +132,9 @@ zx_status_t mmc_send_csd(sdmmc_device_t* dev, uint32_t csd[4]);
 zx_status_t mmc_send_ext_csd(sdmmc_device_t* dev, uint8_t ext_csd[512]);
 zx_status_t mmc_select_card(sdmmc_device_t* dev);
 zx_status_t mmc_switch(sdmmc_device_t* dev, uint8_t index, uint8_t value);
+zx_status_t mmc_flush_cache(sdmmc_device_t* dev);
+// Erases the blocks from |start| to |end| inclusive, as selected by |arg|.
+zx_status_t mmc_erase(sdmmc_device_t* dev, uint32_t start, uint32_t end, uint32_t arg);
 
 zx_status_t sdmmc_probe_sd(sdmmc_device_t* dev);
 zx_status_t sdmmc_probe_mmc(sdmmc_device_t* dev);
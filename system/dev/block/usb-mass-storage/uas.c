@@ -0,0 +1,491 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ddk/debug.h>
+#include <ddk/protocol/usb.h>
+#include <ddk/usb/usb.h>
+#include <usb/usb-request.h>
+#include <zircon/assert.h>
+#include <zircon/hw/usb.h>
+#include <zircon/hw/usb-mass-storage.h>
+
+#include <endian.h>
+#include <string.h>
+
+#include "usb-mass-storage.h"
+
+// USB Attached SCSI, as used below SuperSpeed. Each command is sent on the command pipe with
+// its own tag. The device then uses the status pipe to say which command it is ready to move
+// data for, and finally to report the status of each command. Up to UAS_MAX_COMMANDS commands
+// are kept in flight, and every request completion is handled on the worker thread.
+
+static uint16_t uas_tag(ums_t* ums, uas_cmd_t* cmd) {
+    return (uint16_t)(cmd - ums->uas_cmds + 1);
+}
+
+static void uas_req_complete(usb_request_t* req, void* cookie) {
+    ums_t* ums = cookie;
+
+    mtx_lock(&ums->txn_lock);
+    list_add_tail(&ums->uas_completed, &req->node);
+    mtx_unlock(&ums->txn_lock);
+    sync_completion_signal(&ums->txn_completion);
+}
+
+static void uas_queue(ums_t* ums, usb_request_t* req) {
+    req->complete_cb = uas_req_complete;
+    req->cookie = ums;
+    ums->uas_outstanding++;
+    usb_request_queue(&ums->usb, req);
+}
+
+// Keeps a request queued on the status pipe while any command is waiting for its status.
+static void uas_queue_status(ums_t* ums) {
+    if (ums->status_queued || ums->uas_stopping) {
+        return;
+    }
+    for (uint32_t i = 0; i < UAS_MAX_COMMANDS; i++) {
+        uas_cmd_t* cmd = &ums->uas_cmds[i];
+        if (cmd->busy && !cmd->status_done) {
+            ums->status_req->header.length = ums->status_in_max_packet;
+            ums->status_queued = true;
+            uas_queue(ums, ums->status_req);
+            return;
+        }
+    }
+}
+
+static void uas_send_command(ums_t* ums, uas_cmd_t* cmd, uint8_t lun, const void* command,
+                             uint8_t command_len) {
+    ZX_DEBUG_ASSERT(command_len <= sizeof(((uas_command_iu_t*)NULL)->cdb));
+
+    uas_command_iu_t iu;
+    memset(&iu, 0, sizeof(iu));
+    iu.iu_id = UAS_IU_COMMAND;
+    iu.tag = htobe16(uas_tag(ums, cmd));
+    // single level LUN addressing
+    iu.lun = htobe64((uint64_t)lun << 48);
+    memcpy(iu.cdb, command, command_len);
+    usb_request_copy_to(cmd->cmd_req, &iu, sizeof(iu), 0);
+    cmd->cmd_req->header.length = sizeof(iu);
+
+    cmd->cmd_done = false;
+    cmd->data_queued = false;
+    cmd->data_done = false;
+    cmd->status_done = false;
+    cmd->status = ZX_OK;
+
+    uas_queue(ums, cmd->cmd_req);
+    uas_queue_status(ums);
+}
+
+// Sends the command for the next chunk of the command's txn.
+static zx_status_t uas_start_io(ums_t* ums, uas_cmd_t* cmd) {
+    ums_txn_t* txn = cmd->txn;
+    ums_block_t* dev = txn->dev;
+    bool write = (txn->op.command & BLOCK_OP_MASK) == BLOCK_OP_WRITE;
+
+    uint32_t blocks = cmd->blocks_left;
+    size_t max_blocks = ums->max_transfer / dev->block_size;
+    if (blocks > max_blocks) {
+        blocks = (uint32_t)max_blocks;
+    }
+    size_t length = blocks * dev->block_size;
+
+    zx_status_t status = usb_request_init(&cmd->io_req, txn->op.rw.vmo, cmd->vmo_offset, length,
+                                          write ? ums->bulk_out_addr : ums->bulk_in_addr);
+    if (status != ZX_OK) {
+        return status;
+    }
+    cmd->data = &cmd->io_req;
+
+    uint8_t command[16];
+    uint8_t command_len = ums_rw_command(dev, write, cmd->block_offset, blocks, command);
+    cmd->block_offset += blocks;
+    cmd->blocks_left -= blocks;
+    cmd->vmo_offset += length;
+
+    uas_send_command(ums, cmd, dev->lun, command, command_len);
+    return ZX_OK;
+}
+
+static void uas_finish(ums_t* ums, uas_cmd_t* cmd) {
+    if (!cmd->busy || !cmd->cmd_done || !cmd->status_done ||
+        (cmd->data_queued && !cmd->data_done)) {
+        return;
+    }
+
+    if (cmd->data == &cmd->io_req) {
+        // the device reported success without moving any data
+        if (cmd->status == ZX_OK && !cmd->data_queued) {
+            cmd->status = ZX_ERR_IO;
+        }
+        usb_request_release(&cmd->io_req);
+    }
+    cmd->data = NULL;
+
+    ums_txn_t* txn = cmd->txn;
+    if (txn != NULL) {
+        if (cmd->status == ZX_OK && cmd->blocks_left > 0 && !ums->uas_stopping) {
+            cmd->status = uas_start_io(ums, cmd);
+            if (cmd->status == ZX_OK) {
+                return;
+            }
+        }
+        if (cmd->status != ZX_OK) {
+            zxlogf(ERROR, "ums: %s of %u @ %zu failed: %d\n",
+                   (txn->op.command & BLOCK_OP_MASK) == BLOCK_OP_READ ? "read" : "write",
+                   txn->op.rw.length, txn->op.rw.offset_dev, cmd->status);
+        }
+        cmd->txn = NULL;
+    }
+
+    cmd->busy = false;
+    ums->uas_active--;
+    if (txn != NULL) {
+        txn_complete(txn, cmd->status);
+    }
+}
+
+// Fails every command still waiting for its status.
+static void uas_fail_all(ums_t* ums, zx_status_t status) {
+    for (uint32_t i = 0; i < UAS_MAX_COMMANDS; i++) {
+        uas_cmd_t* cmd = &ums->uas_cmds[i];
+        if (cmd->busy && !cmd->status_done) {
+            cmd->status_done = true;
+            if (cmd->status == ZX_OK) {
+                cmd->status = status;
+            }
+            uas_finish(ums, cmd);
+        }
+    }
+}
+
+static void uas_handle_status(ums_t* ums, usb_request_t* req) {
+    ums->status_queued = false;
+
+    if (req->response.status != ZX_OK) {
+        if (req->response.status != ZX_ERR_CANCELED) {
+            zxlogf(ERROR, "UMS: UAS status pipe failed %d\n", req->response.status);
+            if (!ums->uas_stopping) {
+                usb_reset_endpoint(&ums->usb, ums->status_in_addr);
+            }
+        }
+        uas_fail_all(ums, req->response.status);
+        return;
+    }
+
+    uas_iu_header_t header;
+    if (req->response.actual < sizeof(header)) {
+        zxlogf(ERROR, "UMS: short UAS status IU (%zu bytes)\n", (size_t)req->response.actual);
+        return;
+    }
+    usb_request_copy_from(req, &header, sizeof(header), 0);
+
+    uint16_t tag = betoh16(header.tag);
+    uas_cmd_t* cmd = (tag >= 1 && tag <= UAS_MAX_COMMANDS) ? &ums->uas_cmds[tag - 1] : NULL;
+    if (cmd == NULL || !cmd->busy || cmd->status_done) {
+        zxlogf(ERROR, "UMS: UAS IU 0x%02x for unexpected tag %u\n", header.iu_id, tag);
+        return;
+    }
+
+    switch (header.iu_id) {
+    case UAS_IU_READ_READY:
+    case UAS_IU_WRITE_READY:
+        if (cmd->data != NULL && !cmd->data_queued) {
+            cmd->data_queued = true;
+            uas_queue(ums, cmd->data);
+        } else {
+            zxlogf(ERROR, "UMS: unexpected UAS ready IU for tag %u\n", tag);
+        }
+        break;
+    case UAS_IU_SENSE: {
+        uas_sense_iu_t sense;
+        if (req->response.actual < sizeof(sense)) {
+            cmd->status = ZX_ERR_IO;
+        } else {
+            usb_request_copy_from(req, &sense, sizeof(sense), 0);
+            // CHECK CONDITION, like a failed CSW, is reported as ZX_ERR_BAD_STATE.
+            if (sense.status != SCSI_STATUS_GOOD && cmd->status == ZX_OK) {
+                cmd->status = ZX_ERR_BAD_STATE;
+            }
+        }
+        cmd->status_done = true;
+        break;
+    }
+    case UAS_IU_RESPONSE:
+        cmd->status = ZX_ERR_IO;
+        cmd->status_done = true;
+        break;
+    default:
+        zxlogf(ERROR, "UMS: unexpected UAS IU 0x%02x\n", header.iu_id);
+        break;
+    }
+
+    uas_finish(ums, cmd);
+}
+
+static void uas_handle_completed(ums_t* ums) {
+    while (1) {
+        mtx_lock(&ums->txn_lock);
+        usb_request_t* req = list_remove_head_type(&ums->uas_completed, usb_request_t, node);
+        mtx_unlock(&ums->txn_lock);
+        if (req == NULL) {
+            break;
+        }
+        ums->uas_outstanding--;
+
+        if (req == ums->status_req) {
+            uas_handle_status(ums, req);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < UAS_MAX_COMMANDS; i++) {
+            uas_cmd_t* cmd = &ums->uas_cmds[i];
+            if (req == cmd->cmd_req) {
+                cmd->cmd_done = true;
+                if (req->response.status != ZX_OK) {
+                    // the device will never report a status for this command
+                    cmd->status = req->response.status;
+                    cmd->status_done = true;
+                }
+            } else if (req == cmd->data) {
+                cmd->data_done = true;
+                if (req->response.status != ZX_OK) {
+                    cmd->status = req->response.status;
+                } else if (req == &cmd->io_req && req->response.actual != req->header.length) {
+                    cmd->status = ZX_ERR_IO;
+                }
+            } else {
+                continue;
+            }
+            uas_finish(ums, cmd);
+            break;
+        }
+    }
+
+    uas_queue_status(ums);
+}
+
+static void uas_start_txns(ums_t* ums) {
+    while (ums->uas_active < UAS_MAX_COMMANDS) {
+        mtx_lock(&ums->txn_lock);
+        ums_txn_t* txn = list_peek_head_type(&ums->queued_txns, ums_txn_t, node);
+        // A flush is complete once every txn queued before it is.
+        if (txn != NULL && (txn->op.command & BLOCK_OP_MASK) == BLOCK_OP_FLUSH &&
+            ums->uas_active > 0) {
+            txn = NULL;
+        }
+        if (txn != NULL) {
+            list_delete(&txn->node);
+        }
+        mtx_unlock(&ums->txn_lock);
+        if (txn == NULL) {
+            return;
+        }
+        zxlogf(TRACE, "UMS PROCESS (%p)\n", &txn->op);
+
+        ums_block_t* dev = txn->dev;
+        uint32_t op = txn->op.command & BLOCK_OP_MASK;
+        if (op == BLOCK_OP_FLUSH) {
+            txn_complete(txn, ZX_OK);
+            continue;
+        } else if (op != BLOCK_OP_READ && op != BLOCK_OP_WRITE) {
+            txn_complete(txn, ZX_ERR_INVALID_ARGS);
+            continue;
+        }
+
+        zx_off_t block_offset = txn->op.rw.offset_dev;
+        uint32_t num_blocks = txn->op.rw.length;
+        if ((block_offset >= dev->total_blocks) ||
+            ((dev->total_blocks - block_offset) < num_blocks)) {
+            txn_complete(txn, ZX_ERR_OUT_OF_RANGE);
+            continue;
+        }
+        if (num_blocks == 0) {
+            txn_complete(txn, ZX_OK);
+            continue;
+        }
+
+        uas_cmd_t* cmd = ums->uas_cmds;
+        while (cmd->busy) {
+            cmd++;
+        }
+        cmd->busy = true;
+        ums->uas_active++;
+        cmd->txn = txn;
+        cmd->block_offset = block_offset;
+        cmd->blocks_left = num_blocks;
+        cmd->vmo_offset = txn->op.rw.offset_vmo * dev->block_size;
+
+        zx_status_t status = uas_start_io(ums, cmd);
+        if (status != ZX_OK) {
+            cmd->txn = NULL;
+            cmd->busy = false;
+            ums->uas_active--;
+            txn_complete(txn, status);
+        }
+    }
+}
+
+zx_status_t uas_probe(usb_protocol_t* usb, uas_pipes_t* out_pipes) {
+    usb_desc_iter_t iter;
+    zx_status_t status = usb_desc_iter_init(usb, &iter);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    status = ZX_ERR_NOT_SUPPORTED;
+    usb_interface_descriptor_t* intf;
+    while (status != ZX_OK && (intf = usb_desc_iter_next_interface(&iter, false)) != NULL) {
+        if (intf->bInterfaceClass != USB_CLASS_MSC ||
+            intf->bInterfaceSubClass != USB_SUBCLASS_MSC_SCSI ||
+            intf->bInterfaceProtocol != USB_PROTOCOL_MSC_UAS) {
+            continue;
+        }
+
+        uas_pipes_t pipes;
+        memset(&pipes, 0, sizeof(pipes));
+        pipes.alt_setting = intf->bAlternateSetting;
+
+        // Each endpoint descriptor is followed by a pipe usage descriptor saying what it is for.
+        usb_endpoint_descriptor_t* endp = NULL;
+        usb_descriptor_header_t* header;
+        while ((header = usb_desc_iter_peek(&iter)) != NULL &&
+               header->bDescriptorType != USB_DT_INTERFACE) {
+            usb_desc_iter_next(&iter);
+            if (header->bDescriptorType == USB_DT_ENDPOINT) {
+                endp = (usb_endpoint_descriptor_t*)header;
+                continue;
+            }
+            if (header->bDescriptorType != UAS_DT_PIPE_USAGE ||
+                header->bLength < sizeof(uas_pipe_usage_descriptor_t) || endp == NULL ||
+                usb_ep_type(endp) != USB_ENDPOINT_BULK) {
+                continue;
+            }
+            bool in = usb_ep_direction(endp) == USB_ENDPOINT_IN;
+            switch (((uas_pipe_usage_descriptor_t*)header)->bPipeID) {
+            case UAS_PIPE_COMMAND:
+                if (!in) {
+                    pipes.cmd_out_addr = endp->bEndpointAddress;
+                }
+                break;
+            case UAS_PIPE_STATUS:
+                if (in) {
+                    pipes.status_in_addr = endp->bEndpointAddress;
+                    pipes.status_in_max_packet = usb_ep_max_packet(endp);
+                }
+                break;
+            case UAS_PIPE_DATA_IN:
+                if (in) {
+                    pipes.data_in_addr = endp->bEndpointAddress;
+                    pipes.data_in_max_packet = usb_ep_max_packet(endp);
+                }
+                break;
+            case UAS_PIPE_DATA_OUT:
+                if (!in) {
+                    pipes.data_out_addr = endp->bEndpointAddress;
+                    pipes.data_out_max_packet = usb_ep_max_packet(endp);
+                }
+                break;
+            }
+            endp = NULL;
+        }
+
+        if (pipes.cmd_out_addr && pipes.status_in_addr && pipes.data_in_addr &&
+            pipes.data_out_addr) {
+            *out_pipes = pipes;
+            status = ZX_OK;
+        }
+    }
+    usb_desc_iter_release(&iter);
+    return status;
+}
+
+zx_status_t uas_init(ums_t* ums) {
+    zx_status_t status = usb_request_alloc(&ums->status_req, ums->status_in_max_packet,
+                                           ums->status_in_addr, sizeof(usb_request_t));
+    if (status != ZX_OK) {
+        return status;
+    }
+    for (uint32_t i = 0; i < UAS_MAX_COMMANDS; i++) {
+        status = usb_request_alloc(&ums->uas_cmds[i].cmd_req, sizeof(uas_command_iu_t),
+                                   ums->cmd_out_addr, sizeof(usb_request_t));
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    return ZX_OK;
+}
+
+void uas_release(ums_t* ums) {
+    if (ums->status_req) {
+        usb_request_release(ums->status_req);
+    }
+    for (uint32_t i = 0; i < UAS_MAX_COMMANDS; i++) {
+        if (ums->uas_cmds[i].cmd_req) {
+            usb_request_release(ums->uas_cmds[i].cmd_req);
+        }
+    }
+}
+
+zx_status_t uas_command(ums_t* ums, uint8_t lun, const void* command, uint8_t command_len,
+                        uint32_t transfer_length) {
+    ZX_DEBUG_ASSERT(ums->uas_active == 0);
+
+    uas_cmd_t* cmd = &ums->uas_cmds[0];
+    cmd->busy = true;
+    ums->uas_active++;
+    cmd->txn = NULL;
+    if (transfer_length > 0) {
+        ums->data_req->header.length = transfer_length;
+        cmd->data = ums->data_req;
+    } else {
+        cmd->data = NULL;
+    }
+    uas_send_command(ums, cmd, lun, command, command_len);
+
+    while (cmd->busy) {
+        sync_completion_wait(&ums->txn_completion, ZX_TIME_INFINITE);
+        sync_completion_reset(&ums->txn_completion);
+        uas_handle_completed(ums);
+    }
+
+    // We may have consumed the signal for newly queued txns.
+    sync_completion_signal(&ums->txn_completion);
+    return cmd->status;
+}
+
+void uas_process(ums_t* ums) {
+    uas_handle_completed(ums);
+    uas_start_txns(ums);
+}
+
+void uas_shutdown(ums_t* ums) {
+    ums->uas_stopping = true;
+
+    // Canceled requests complete with errors, which fail their commands.
+    usb_cancel_all(&ums->usb, ums->cmd_out_addr);
+    usb_cancel_all(&ums->usb, ums->status_in_addr);
+    usb_cancel_all(&ums->usb, ums->bulk_in_addr);
+    usb_cancel_all(&ums->usb, ums->bulk_out_addr);
+
+    while (ums->uas_outstanding > 0) {
+        sync_completion_wait(&ums->txn_completion, ZX_TIME_INFINITE);
+        sync_completion_reset(&ums->txn_completion);
+        uas_handle_completed(ums);
+    }
+
+    // Nothing is in flight anymore, so fail whatever is left.
+    for (uint32_t i = 0; i < UAS_MAX_COMMANDS; i++) {
+        uas_cmd_t* cmd = &ums->uas_cmds[i];
+        if (cmd->busy) {
+            cmd->cmd_done = true;
+            cmd->data_done = true;
+            cmd->status_done = true;
+            cmd->status = ZX_ERR_IO_NOT_PRESENT;
+            uas_finish(ums, cmd);
+        }
+    }
+}
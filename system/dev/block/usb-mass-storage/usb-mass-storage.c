@@ -28,11 +28,6 @@
 
 static csw_status_t ums_verify_csw(ums_t* ums, usb_request_t* csw_request, uint32_t* out_residue);
 
-static inline void txn_complete(ums_txn_t* txn, zx_status_t status) {
-    zxlogf(TRACE, "UMS DONE %d (%p)\n", status, &txn->op);
-    txn->completion_cb(txn->cookie, status, &txn->op);
-}
-
 static zx_status_t ums_reset(ums_t* ums) {
     // UMS Reset Recovery. See section 5.3.4 of
     // "Universal Serial Bus Mass Storage Class Bulk-Only Transport"
@@ -154,19 +149,28 @@ static void ums_queue_read(ums_t* ums, uint16_t transfer_length) {
     usb_request_queue(&ums->usb, read_request);
 }
 
+// Runs a SCSI command which reads up to |transfer_length| bytes into ums->data_req.
+static zx_status_t ums_command(ums_t* ums, uint8_t lun, void* command, uint8_t command_len,
+                               uint16_t transfer_length) {
+    if (ums->uas) {
+        return uas_command(ums, lun, command, command_len, transfer_length);
+    }
+
+    ums_send_cbw(ums, lun, transfer_length, USB_DIR_IN, command_len, command);
+    if (transfer_length > 0) {
+        ums_queue_read(ums, transfer_length);
+    }
+    return ums_read_csw(ums, NULL);
+}
+
 static zx_status_t ums_inquiry(ums_t* ums, uint8_t lun, uint8_t* out_data) {
     // CBW Configuration
     scsi_command6_t command;
     memset(&command, 0, sizeof(command));
     command.opcode = UMS_INQUIRY;
     command.length = UMS_INQUIRY_TRANSFER_LENGTH;
-    ums_send_cbw(ums, lun, UMS_INQUIRY_TRANSFER_LENGTH, USB_DIR_IN, sizeof(command), &command);
-
-    // read inquiry response
-    ums_queue_read(ums, UMS_INQUIRY_TRANSFER_LENGTH);
-
-    // wait for CSW
-    zx_status_t status = ums_read_csw(ums, NULL);
+    zx_status_t status = ums_command(ums, lun, &command, sizeof(command),
+                                     UMS_INQUIRY_TRANSFER_LENGTH);
     if (status == ZX_OK) {
         usb_request_copy_from(ums->data_req, out_data, UMS_INQUIRY_TRANSFER_LENGTH, 0);
     }
@@ -178,10 +182,7 @@ static zx_status_t ums_test_unit_ready(ums_t* ums, uint8_t lun) {
     scsi_command6_t command;
     memset(&command, 0, sizeof(command));
     command.opcode = UMS_TEST_UNIT_READY;
-    ums_send_cbw(ums, lun, 0, USB_DIR_IN, sizeof(command), &command);
-
-    // wait for CSW
-    return ums_read_csw(ums, NULL);
+    return ums_command(ums, lun, &command, sizeof(command), 0);
 }
 
 static zx_status_t ums_request_sense(ums_t* ums, uint8_t lun, uint8_t* out_data) {
@@ -190,13 +191,8 @@ static zx_status_t ums_request_sense(ums_t* ums, uint8_t lun, uint8_t* out_data)
     memset(&command, 0, sizeof(command));
     command.opcode = UMS_REQUEST_SENSE;
     command.length = UMS_REQUEST_SENSE_TRANSFER_LENGTH;
-    ums_send_cbw(ums, lun, UMS_REQUEST_SENSE_TRANSFER_LENGTH, USB_DIR_IN, sizeof(command), &command);
-
-    // read request sense response
-    ums_queue_read(ums, UMS_REQUEST_SENSE_TRANSFER_LENGTH);
-
-    // wait for CSW
-    zx_status_t status = ums_read_csw(ums, NULL);
+    zx_status_t status = ums_command(ums, lun, &command, sizeof(command),
+                                     UMS_REQUEST_SENSE_TRANSFER_LENGTH);
     if (status == ZX_OK) {
         usb_request_copy_from(ums->data_req, out_data, UMS_REQUEST_SENSE_TRANSFER_LENGTH, 0);
     }
@@ -208,12 +204,7 @@ static zx_status_t ums_read_capacity10(ums_t* ums, uint8_t lun, scsi_read_capaci
     scsi_command10_t command;
     memset(&command, 0, sizeof(command));
     command.opcode = UMS_READ_CAPACITY10;
-    ums_send_cbw(ums, lun, sizeof(*out_data), USB_DIR_IN, sizeof(command), &command);
-
-    // read capacity10 response
-    ums_queue_read(ums, sizeof(*out_data));
-
-    zx_status_t status = ums_read_csw(ums, NULL);
+    zx_status_t status = ums_command(ums, lun, &command, sizeof(command), sizeof(*out_data));
     if (status == ZX_OK) {
         usb_request_copy_from(ums->data_req, out_data, sizeof(*out_data), 0);
     }
@@ -228,12 +219,7 @@ static zx_status_t ums_read_capacity16(ums_t* ums, uint8_t lun, scsi_read_capaci
     // service action = 10, not sure what that means
     command.misc = 0x10;
     command.length = sizeof(*out_data);
-    ums_send_cbw(ums, lun, sizeof(*out_data), USB_DIR_IN, sizeof(command), &command);
-
-    // read capacity16 response
-    ums_queue_read(ums, sizeof(*out_data));
-
-    zx_status_t status = ums_read_csw(ums, NULL);
+    zx_status_t status = ums_command(ums, lun, &command, sizeof(command), sizeof(*out_data));
     if (status == ZX_OK) {
         usb_request_copy_from(ums->data_req, out_data, sizeof(*out_data), 0);
     }
@@ -247,19 +233,44 @@ static zx_status_t ums_mode_sense6(ums_t* ums, uint8_t lun, scsi_mode_sense_6_da
     command.opcode = UMS_MODE_SENSE6;
     command.page = 0x3F;   // all pages, current values
     command.allocation_length = sizeof(*out_data);
-
-    ums_send_cbw(ums, lun, sizeof(*out_data), USB_DIR_IN, sizeof(command), &command);
-
-    // read mode sense response
-    ums_queue_read(ums, sizeof(*out_data));
-
-    zx_status_t status = ums_read_csw(ums, NULL);
+    zx_status_t status = ums_command(ums, lun, &command, sizeof(command), sizeof(*out_data));
     if (status == ZX_OK) {
         usb_request_copy_from(ums->data_req, out_data, sizeof(*out_data), 0);
     }
     return status;
 }
 
+uint8_t ums_rw_command(ums_block_t* dev, bool write, zx_off_t lba, uint32_t blocks,
+                       uint8_t* out_command) {
+    // Need to use READ16/WRITE16 if block addresses are greater than 32 bit
+    if (dev->total_blocks > UINT32_MAX) {
+        scsi_command16_t command;
+        memset(&command, 0, sizeof(command));
+        command.opcode = write ? UMS_WRITE16 : UMS_READ16;
+        command.lba = htobe64(lba);
+        command.length = htobe32(blocks);
+        memcpy(out_command, &command, sizeof(command));
+        return sizeof(command);
+    } else if (blocks <= UINT16_MAX) {
+        scsi_command10_t command;
+        memset(&command, 0, sizeof(command));
+        command.opcode = write ? UMS_WRITE10 : UMS_READ10;
+        command.lba = htobe32(lba);
+        command.length_hi = blocks >> 8;
+        command.length_lo = blocks & 0xFF;
+        memcpy(out_command, &command, sizeof(command));
+        return sizeof(command);
+    } else {
+        scsi_command12_t command;
+        memset(&command, 0, sizeof(command));
+        command.opcode = write ? UMS_WRITE12 : UMS_READ12;
+        command.lba = htobe32(lba);
+        command.length = htobe32(blocks);
+        memcpy(out_command, &command, sizeof(command));
+        return sizeof(command);
+    }
+}
+
 static zx_status_t ums_data_transfer(ums_t* ums, ums_txn_t* txn, zx_off_t offset, size_t length,
                                      uint8_t ep_address) {
     usb_request_t* req = &ums->data_transfer_req;
@@ -306,30 +317,9 @@ static zx_status_t ums_read(ums_block_t* dev, ums_txn_t* txn) {
         size_t length = blocks * block_size;
 
         // CBW Configuration
-        // Need to use UMS_READ16 if block addresses are greater than 32 bit
-        if (dev->total_blocks > UINT32_MAX) {
-            scsi_command16_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_READ16;
-            command.lba = htobe64(block_offset);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
-        } else if (blocks <= UINT16_MAX) {
-            scsi_command10_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_READ10;
-            command.lba = htobe32(block_offset);
-            command.length_hi = blocks >> 8;
-            command.length_lo = blocks & 0xFF;
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
-        } else {
-            scsi_command12_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_READ12;
-            command.lba = htobe32(block_offset);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, sizeof(command), &command);
-        }
+        uint8_t command[16];
+        uint8_t command_len = ums_rw_command(dev, false, block_offset, blocks, command);
+        ums_send_cbw(ums, dev->lun, length, USB_DIR_IN, command_len, command);
 
         status = ums_data_transfer(ums, txn, vmo_offset, length, ums->bulk_in_addr);
 
@@ -371,30 +361,9 @@ static zx_status_t ums_write(ums_block_t* dev, ums_txn_t* txn) {
         size_t length = blocks * block_size;
 
         // CBW Configuration
-        // Need to use UMS_WRITE16 if block addresses are greater than 32 bit
-        if (dev->total_blocks > UINT32_MAX) {
-            scsi_command16_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_WRITE16;
-            command.lba = htobe64(block_offset);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
-        } else if (blocks <= UINT16_MAX) {
-            scsi_command10_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_WRITE10;
-            command.lba = htobe32(block_offset);
-            command.length_hi = blocks >> 8;
-            command.length_lo = blocks & 0xFF;
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
-        } else {
-            scsi_command12_t command;
-            memset(&command, 0, sizeof(command));
-            command.opcode = UMS_WRITE12;
-            command.lba = htobe32(block_offset);
-            command.length = htobe32(blocks);
-            ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, sizeof(command), &command);
-        }
+        uint8_t command[16];
+        uint8_t command_len = ums_rw_command(dev, true, block_offset, blocks, command);
+        ums_send_cbw(ums, dev->lun, length, USB_DIR_OUT, command_len, command);
 
         status = ums_data_transfer(ums, txn, vmo_offset, length, ums->bulk_out_addr);
 
@@ -441,6 +410,8 @@ static void ums_unbind(void* ctx) {
 static void ums_release(void* ctx) {
     ums_t* ums = ctx;
 
+    uas_release(ums);
+
     if (ums->cbw_req) {
         usb_request_release(ums->cbw_req);
     }
@@ -578,7 +549,8 @@ static int ums_worker_thread(void* arg) {
         if (wait) {
             status = sync_completion_wait(&ums->txn_completion, ZX_SEC(1));
             if (status == ZX_ERR_TIMED_OUT) {
-                if (ums_check_luns_ready(ums) != ZX_OK) {
+                // UAS commands may still be in flight on a slow device.
+                if (ums->uas_active == 0 && ums_check_luns_ready(ums) != ZX_OK) {
                     return status;
                 }
                 continue;
@@ -591,6 +563,13 @@ static int ums_worker_thread(void* arg) {
             mtx_unlock(&ums->txn_lock);
             break;
         }
+        if (ums->uas) {
+            // Every request completion and every new txn signals txn_completion.
+            mtx_unlock(&ums->txn_lock);
+            uas_process(ums);
+            wait = true;
+            continue;
+        }
         ums_txn_t* txn = list_remove_head_type(&ums->queued_txns, ums_txn_t, node);
         if (txn == NULL) {
             mtx_unlock(&ums->txn_lock);
@@ -631,6 +610,10 @@ static int ums_worker_thread(void* arg) {
         txn_complete(txn, status);
     }
 
+    if (ums->uas) {
+        uas_shutdown(ums);
+    }
+
     // complete any pending txns
     list_node_t txns = LIST_INITIAL_VALUE(txns);
     mtx_lock(&ums->txn_lock);
@@ -678,6 +661,7 @@ static zx_status_t ums_bind(void* ctx, zx_device_t* device) {
     }
 
     uint8_t interface_number = intf->bInterfaceNumber;
+    uint8_t interface_protocol = intf->bInterfaceProtocol;
     uint8_t bulk_in_addr = 0;
     uint8_t bulk_out_addr = 0;
     size_t bulk_in_max_packet = 0;
@@ -700,16 +684,43 @@ static zx_status_t ums_bind(void* ctx, zx_device_t* device) {
     }
     usb_desc_iter_release(&iter);
 
+    // Prefer UAS if the device has it. Without streams, which our host controller stack does
+    // not support, UAS can only be used below SuperSpeed.
+    uas_pipes_t uas_pipes;
+    bool uas = (usb_get_speed(&usb) != USB_SPEED_SUPER) && (uas_probe(&usb, &uas_pipes) == ZX_OK);
+    if (uas) {
+        bulk_in_addr = uas_pipes.data_in_addr;
+        bulk_out_addr = uas_pipes.data_out_addr;
+        bulk_in_max_packet = uas_pipes.data_in_max_packet;
+        bulk_out_max_packet = uas_pipes.data_out_max_packet;
+    } else if (interface_protocol != USB_PROTOCOL_MSC_BULK_ONLY) {
+        zxlogf(ERROR, "UMS: device only supports UAS, which needs streams at this speed\n");
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     if (!bulk_in_addr || !bulk_out_addr) {
         DEBUG_PRINT(("UMS:ums_bind could not find endpoints\n"));
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    zx_status_t status;
     uint8_t max_lun;
     size_t out_length;
-    zx_status_t status = usb_control(&usb, USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
-                                     USB_REQ_GET_MAX_LUN, 0x00, 0x00, &max_lun, sizeof(max_lun),
-                                     ZX_TIME_INFINITE, &out_length);
+    if (uas) {
+        status = usb_set_interface(&usb, interface_number, uas_pipes.alt_setting);
+        if (status != ZX_OK) {
+            zxlogf(ERROR, "UMS: selecting UAS alternate setting failed %d\n", status);
+            return status;
+        }
+        // GET_MAX_LUN is only defined for Bulk-Only Transport. Only LUN 0 is used over UAS.
+        max_lun = 0;
+        out_length = sizeof(max_lun);
+        status = ZX_OK;
+    } else {
+        status = usb_control(&usb, USB_DIR_IN | USB_TYPE_CLASS | USB_RECIP_INTERFACE,
+                             USB_REQ_GET_MAX_LUN, 0x00, 0x00, &max_lun, sizeof(max_lun),
+                             ZX_TIME_INFINITE, &out_length);
+    }
 
     if (status == ZX_ERR_IO_REFUSED) {
         // Devices that do not support multiple LUNS may stall this command.
@@ -739,6 +750,7 @@ static zx_status_t ums_bind(void* ctx, zx_device_t* device) {
     }
 
     list_initialize(&ums->queued_txns);
+    list_initialize(&ums->uas_completed);
     sync_completion_reset(&ums->txn_completion);
     mtx_init(&ums->txn_lock, mtx_plain);
 
@@ -749,30 +761,44 @@ static zx_status_t ums_bind(void* ctx, zx_device_t* device) {
     ums->bulk_in_max_packet = bulk_in_max_packet;
     ums->bulk_out_max_packet = bulk_out_max_packet;
     ums->interface_number = interface_number;
+    ums->uas = uas;
+    if (uas) {
+        ums->cmd_out_addr = uas_pipes.cmd_out_addr;
+        ums->status_in_addr = uas_pipes.status_in_addr;
+        ums->status_in_max_packet = uas_pipes.status_in_max_packet;
+    }
 
     size_t max_in = usb_get_max_transfer_size(&usb, bulk_in_addr);
     size_t max_out = usb_get_max_transfer_size(&usb, bulk_out_addr);
     ums->max_transfer = (max_in < max_out ? max_in : max_out);
 
-    status = usb_request_alloc(&ums->cbw_req, sizeof(ums_cbw_t), bulk_out_addr,
-                               sizeof(usb_request_t));
-    if (status != ZX_OK) {
-        goto fail;
-    }
     status = usb_request_alloc(&ums->data_req, PAGE_SIZE, bulk_in_addr,
                                sizeof(usb_request_t));
     if (status != ZX_OK) {
         goto fail;
     }
-    status = usb_request_alloc(&ums->csw_req, sizeof(ums_csw_t), bulk_in_addr,
-                               sizeof(usb_request_t));
-    if (status != ZX_OK) {
-        goto fail;
-    }
-
-    ums->cbw_req->complete_cb = ums_req_complete;
     ums->data_req->complete_cb = ums_req_complete;
-    ums->csw_req->complete_cb = ums_req_complete;
+
+    if (uas) {
+        status = uas_init(ums);
+        if (status != ZX_OK) {
+            goto fail;
+        }
+    } else {
+        status = usb_request_alloc(&ums->cbw_req, sizeof(ums_cbw_t), bulk_out_addr,
+                                   sizeof(usb_request_t));
+        if (status != ZX_OK) {
+            goto fail;
+        }
+        status = usb_request_alloc(&ums->csw_req, sizeof(ums_csw_t), bulk_in_addr,
+                                   sizeof(usb_request_t));
+        if (status != ZX_OK) {
+            goto fail;
+        }
+
+        ums->cbw_req->complete_cb = ums_req_complete;
+        ums->csw_req->complete_cb = ums_req_complete;
+    }
 
     ums->tag_send = ums->tag_receive = 8;
 
@@ -809,9 +835,10 @@ static zx_driver_ops_t usb_mass_storage_driver_ops = {
     .bind = ums_bind,
 };
 
-ZIRCON_DRIVER_BEGIN(usb_mass_storage, usb_mass_storage_driver_ops, "zircon", "0.1", 4)
+ZIRCON_DRIVER_BEGIN(usb_mass_storage, usb_mass_storage_driver_ops, "zircon", "0.1", 5)
     BI_ABORT_IF(NE, BIND_PROTOCOL, ZX_PROTOCOL_USB),
     BI_ABORT_IF(NE, BIND_USB_CLASS, USB_CLASS_MSC),
     BI_ABORT_IF(NE, BIND_USB_SUBCLASS, USB_SUBCLASS_MSC_SCSI),
     BI_MATCH_IF(EQ, BIND_USB_PROTOCOL, USB_PROTOCOL_MSC_BULK_ONLY),
+    BI_MATCH_IF(EQ, BIND_USB_PROTOCOL, USB_PROTOCOL_MSC_UAS),
 ZIRCON_DRIVER_END(usb_mass_storage)
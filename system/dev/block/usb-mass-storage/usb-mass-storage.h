@@ -5,6 +5,7 @@
 #pragma once
 
 #include <inttypes.h>
+#include <ddk/debug.h>
 #include <ddk/device.h>
 #include <ddk/protocol/block.h>
 #include <ddk/protocol/usb.h>
@@ -26,6 +27,31 @@ typedef struct {
     bool device_added;
 } ums_block_t;
 
+typedef struct ums_txn ums_txn_t;
+
+// maximum number of commands in flight on a UAS device
+#define UAS_MAX_COMMANDS 16
+
+// state of a command in flight on a UAS device. Each has its own tag.
+typedef struct {
+    usb_request_t* cmd_req;     // command IU
+    usb_request_t* data;        // request for the data phase, or NULL if there is none
+    usb_request_t io_req;       // data phase of block I/O, set up with usb_request_init()
+
+    // block txn this command belongs to, which may take several commands
+    ums_txn_t* txn;
+    zx_off_t block_offset;      // next block to transfer
+    uint32_t blocks_left;       // blocks left to transfer after the current command
+    zx_off_t vmo_offset;        // offset of the data for the current command
+
+    bool busy;
+    bool cmd_done;
+    bool data_queued;
+    bool data_done;
+    bool status_done;
+    zx_status_t status;
+} uas_cmd_t;
+
 // main struct for the UMS driver
 typedef struct {
     zx_device_t* zxdev;         // root device we publish
@@ -39,11 +65,25 @@ typedef struct {
     size_t max_transfer;        // maximum transfer size reported by usb_get_max_transfer_size()
 
     uint8_t interface_number;
-    uint8_t bulk_in_addr;
-    uint8_t bulk_out_addr;
+    uint8_t bulk_in_addr;       // data in pipe for UAS
+    uint8_t bulk_out_addr;      // data out pipe for UAS
     size_t bulk_in_max_packet;
     size_t bulk_out_max_packet;
 
+    // USB Attached SCSI, used instead of Bulk-Only Transport when the device supports it.
+    // Only the worker thread touches this state, apart from uas_completed.
+    bool uas;
+    uint8_t cmd_out_addr;       // command pipe
+    uint8_t status_in_addr;     // status pipe
+    size_t status_in_max_packet;
+    usb_request_t* status_req;  // kept queued on the status pipe while commands are in flight
+    bool status_queued;
+    bool uas_stopping;          // set by uas_shutdown()
+    uint32_t uas_active;        // number of busy entries in uas_cmds
+    uint32_t uas_outstanding;   // number of requests queued to the USB stack
+    list_node_t uas_completed;  // requests which have completed, protected by txn_lock
+    uas_cmd_t uas_cmds[UAS_MAX_COMMANDS];
+
     usb_request_t* cbw_req;
     usb_request_t* data_req;
     usb_request_t* csw_req;
@@ -64,13 +104,54 @@ typedef struct {
 } ums_t;
 #define block_to_ums(block) containerof(block - block->lun, ums_t, block_devs)
 
-typedef struct ums_txn {
+struct ums_txn {
     block_op_t op;
     block_impl_queue_callback completion_cb;
     void* cookie;
     list_node_t node;
     ums_block_t* dev;
-} ums_txn_t;
+};
 #define block_op_to_txn(op) containerof(op, ums_txn_t, op)
 
+static inline void txn_complete(ums_txn_t* txn, zx_status_t status) {
+    zxlogf(TRACE, "UMS DONE %d (%p)\n", status, &txn->op);
+    txn->completion_cb(txn->cookie, status, &txn->op);
+}
+
 zx_status_t ums_block_add_device(ums_t* ums, ums_block_t* dev);
+
+// Builds the SCSI command to read or write |blocks| blocks at |lba| in |out_command|, which must
+// hold 16 bytes, and returns its length.
+uint8_t ums_rw_command(ums_block_t* dev, bool write, zx_off_t lba, uint32_t blocks,
+                       uint8_t* out_command);
+
+// UAS pipes found by uas_probe()
+typedef struct {
+    uint8_t alt_setting;
+    uint8_t cmd_out_addr;
+    uint8_t status_in_addr;
+    uint8_t data_in_addr;
+    uint8_t data_out_addr;
+    size_t status_in_max_packet;
+    size_t data_in_max_packet;
+    size_t data_out_max_packet;
+} uas_pipes_t;
+
+// Looks for a UAS alternate setting of the interface, returning ZX_ERR_NOT_SUPPORTED if there
+// is none.
+zx_status_t uas_probe(usb_protocol_t* usb, uas_pipes_t* out_pipes);
+zx_status_t uas_init(ums_t* ums);
+void uas_release(ums_t* ums);
+
+// Runs a SCSI command which reads up to |transfer_length| bytes into ums->data_req. Must only
+// be called from the worker thread while no other commands are in flight.
+zx_status_t uas_command(ums_t* ums, uint8_t lun, const void* command, uint8_t command_len,
+                        uint32_t transfer_length);
+
+// Handles completed requests and starts queued txns. Called by the worker thread whenever
+// txn_completion is signaled.
+void uas_process(ums_t* ums);
+
+// Cancels all commands in flight and completes their txns, once the USB stack has returned
+// every request.
+void uas_shutdown(ums_t* ums);
@@ -23,6 +23,7 @@
 #include <zircon/device/block.h>
 #include <zircon/errors.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 #include <zxcrypt/volume.h>
@@ -38,6 +39,40 @@ namespace {
 // Cap largest transaction to a quarter of the VMO buffer.
 const uint32_t kMaxTransferSize = Volume::kBufferSize / 4;
 
+// Writes larger than this are split into chunks, each of which is encrypted and sent to the parent
+// device on its own. Chunks are encrypted by different workers at once, and the first ones are
+// written while the later ones are still being encrypted. Each chunk also needs only its own
+// length of contiguous space in the write buffer, rather than that of the whole write.
+const uint32_t kWriteChunkSize = Volume::kBufferSize / 32;
+
+// The state of a write split into chunks by |Device::SplitWrite|.
+struct split_write_t {
+    Device* device;
+    // The original request.
+    block_op_t* block;
+    // The number of chunks yet to complete.
+    fbl::atomic_uint64_t remaining;
+    // The first error any chunk completed with.
+    fbl::atomic_int32_t status;
+    // Storage for the chunks' block ops.
+    fbl::unique_ptr<uint8_t[]> chunks;
+};
+
+// Completion callback for the chunks of a split write. Completes the original request along with
+// the last chunk.
+void ChunkCallback(void* cookie, zx_status_t status, block_op_t* chunk) {
+    split_write_t* split = static_cast<split_write_t*>(cookie);
+    if (status != ZX_OK) {
+        zx_status_t expected = ZX_OK;
+        split->status.compare_exchange_strong(&expected, status, fbl::memory_order_seq_cst,
+                                              fbl::memory_order_seq_cst);
+    }
+    if (split->remaining.fetch_sub(1) == 1) {
+        fbl::unique_ptr<split_write_t> reclaimed(split);
+        reclaimed->device->BlockComplete(reclaimed->block, reclaimed->status.load());
+    }
+}
+
 // Kick off |Init| thread when binding.
 int InitThread(void* arg) {
     return static_cast<Device*>(arg)->Init();
@@ -158,13 +193,17 @@ zx_status_t Device::Init() {
         return rc;
     }
 
-    // Start workers
-    // TODO(aarongreen): Investigate performance implications of adding more workers.
+    // Start workers. Each works on a whole block op at a time, so beyond one per CPU they would
+    // only contend for the CPUs.
     if ((rc = zx::port::create(0, &port_)) != ZX_OK) {
         zxlogf(ERROR, "zx::port::create failed: %s\n", zx_status_get_string(rc));
         return rc;
     }
-    for (size_t i = 0; i < kNumWorkers; ++i) {
+    size_t num_workers = zx_system_get_num_cpus();
+    if (num_workers > kMaxWorkers) {
+        num_workers = kMaxWorkers;
+    }
+    for (size_t i = 0; i < num_workers; ++i) {
         zx::port port;
         port_.duplicate(ZX_RIGHT_SAME_RIGHTS, &port);
         if ((rc = workers_[i].Start(this, *volume, fbl::move(port))) != ZX_OK) {
@@ -350,7 +389,9 @@ void Device::BlockImplQueue(block_op_t* block, block_impl_queue_callback complet
 
     switch (block->command & BLOCK_OP_MASK) {
     case BLOCK_OP_WRITE:
-        EnqueueWrite(block);
+        if (!SplitWrite(block)) {
+            EnqueueWrite(block);
+        }
         break;
     case BLOCK_OP_READ:
     default:
@@ -478,6 +519,54 @@ void Device::EnqueueWrite(block_op_t* block) {
     }
 }
 
+bool Device::SplitWrite(block_op_t* block) {
+    LOG_ENTRY_ARGS("block=%p", block);
+
+    const uint32_t chunk_len = kWriteChunkSize / info_->block_size;
+    if (block->rw.length <= chunk_len) {
+        return false;
+    }
+    const uint32_t num_chunks = fbl::round_up(block->rw.length, chunk_len) / chunk_len;
+    const size_t stride = fbl::round_up(info_->op_size, alignof(block_op_t));
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<split_write_t> split(new (&ac) split_write_t);
+    if (!ac.check()) {
+        return false;
+    }
+    split->chunks.reset(new (&ac) uint8_t[stride * num_chunks]);
+    if (!ac.check()) {
+        return false;
+    }
+    split->device = this;
+    split->block = block;
+    split->remaining.store(num_chunks);
+    split->status.store(ZX_OK);
+
+    // Each chunk is an op "in-flight" until |BlockComplete| is called on it, like |block| itself.
+    num_ops_.fetch_add(num_chunks);
+
+    // |split| is freed by the last chunk to complete, which can't happen until after the last one
+    // is queued below.
+    uint8_t* chunks = split->chunks.get();
+    split_write_t* cookie = split.release();
+    for (uint32_t i = 0; i < num_chunks; ++i) {
+        block_op_t* chunk = reinterpret_cast<block_op_t*>(chunks + i * stride);
+        memcpy(chunk, block, sizeof(*block));
+        const uint32_t off = i * chunk_len;
+        chunk->rw.length = fbl::min(block->rw.length - off, chunk_len);
+        chunk->rw.offset_dev += off;
+        chunk->rw.offset_vmo += off;
+
+        // |block| has already been adjusted for the reserved blocks.
+        extra_op_t* extra = BlockToExtra(chunk, info_->op_size);
+        __UNUSED zx_status_t rc = extra->Init(chunk, ChunkCallback, cookie, 0);
+        ZX_DEBUG_ASSERT(rc == ZX_OK);
+        EnqueueWrite(chunk);
+    }
+    return true;
+}
+
 void Device::SendToWorker(block_op_t* block) {
     LOG_ENTRY_ARGS("block=%p", block);
     zx_status_t rc;
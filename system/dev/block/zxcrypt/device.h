@@ -84,14 +84,18 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Device);
 
-    // TODO(aarongreen): Investigate performance impact of changing this.
-    // Number of encrypting/decrypting workers
-    static const size_t kNumWorkers = 2;
+    // Maximum number of encrypting/decrypting workers. One is started per CPU, up to this limit.
+    static const size_t kMaxWorkers = 8;
 
     // Adds |block| to the write queue if not null, and sends to the workers as many write requests
     // as fit in the space available in the write buffer.
     void EnqueueWrite(block_op_t* block = nullptr) __TA_EXCLUDES(mtx_);
 
+    // Splits |block| into chunks which are enqueued as writes of their own, if it is a write large
+    // enough to benefit. |block| completes once all of the chunks have. Returns false if |block|
+    // was left for the caller to enqueue as is, including if the chunks couldn't be allocated.
+    bool SplitWrite(block_op_t* block) __TA_EXCLUDES(mtx_);
+
     // Sends a block I/O request to a worker to be encrypted or decrypted.
     void SendToWorker(block_op_t* block) __TA_EXCLUDES(mtx_);
 
@@ -142,7 +146,7 @@ private:
     thrd_t init_;
 
     // Threads that performs encryption/decryption.
-    Worker workers_[kNumWorkers];
+    Worker workers_[kMaxWorkers];
 
     // Port used to send write/read operations to be encrypted/decrypted.
     zx::port port_;
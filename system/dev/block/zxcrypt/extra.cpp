@@ -30,6 +30,7 @@ zx_status_t extra_op_t::Init(block_op_t* block, block_impl_queue_callback cb, vo
     switch (block->command & BLOCK_OP_MASK) {
     case BLOCK_OP_READ:
     case BLOCK_OP_WRITE:
+    case BLOCK_OP_TRIM:
         if (add_overflow(block->rw.offset_dev, reserved_blocks, &block->rw.offset_dev)) {
             zxlogf(ERROR, "adjusted offset overflow: block->rw.offset_dev=%" PRIu64 "\n",
                    block->rw.offset_dev);
@@ -6,6 +6,8 @@
 
 #include <ddk/debug.h>
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <pretty/hexdump.h>
@@ -14,6 +16,7 @@
 #include <string.h>
 #include <sys/param.h>
 #include <zircon/compiler.h>
+#include <zircon/syscalls.h>
 
 #include "trace.h"
 
@@ -51,12 +54,18 @@ void BlockDevice::GetInfo(block_info_t* info) {
     memset(info, 0, sizeof(*info));
     info->block_size = GetBlockSize();
     info->block_count = GetSize() / GetBlockSize();
-    info->max_transfer_size = (uint32_t)(PAGE_SIZE * (ring_size - 2));
+    // Without indirect descriptors, a transfer's scatter list must fit in
+    // the ring itself.
+    info->max_transfer_size = queues_[0]->vring.HasIndirect() ? MAX_MAX_XFER :
+                              (uint32_t)(PAGE_SIZE * (ring_size - 2));
 
     // limit max transfer to our worst case scatter list size
     if (info->max_transfer_size > MAX_MAX_XFER) {
         info->max_transfer_size = MAX_MAX_XFER;
     }
+    if (trim_type_ != 0) {
+        info->flags |= BLOCK_FLAG_TRIM_SUPPORT;
+    }
 }
 
 void BlockDevice::virtio_block_query(void* ctx, block_info_t* info, size_t* bopsz) {
@@ -80,6 +89,9 @@ void BlockDevice::virtio_block_queue(void* ctx, block_op_t* bop,
     case BLOCK_OP_WRITE:
         bd->QueueReadWriteTxn(txn, true);
         break;
+    case BLOCK_OP_TRIM:
+        bd->QueueTrimTxn(txn);
+        break;
     case BLOCK_OP_FLUSH:
         //TODO: this should complete after any in-flight IO and before
         //      any later IO begins
@@ -114,15 +126,9 @@ zx_status_t BlockDevice::virtio_block_ioctl(void* ctx, uint32_t op, const void*
 }
 
 BlockDevice::BlockDevice(zx_device_t* bus_device, zx::bti bti, fbl::unique_ptr<Backend> backend)
-    : Device(bus_device, fbl::move(bti), fbl::move(backend)) {
-    sync_completion_reset(&txn_signal_);
+    : Device(bus_device, fbl::move(bti), fbl::move(backend)) {}
 
-    memset(&blk_req_buf_, 0, sizeof(blk_req_buf_));
-}
-
-BlockDevice::~BlockDevice() {
-    io_buffer_release(&blk_req_buf_);
-}
+BlockDevice::~BlockDevice() {}
 
 zx_status_t BlockDevice::Init() {
     LTRACE_ENTRY;
@@ -148,34 +154,62 @@ zx_status_t BlockDevice::Init() {
     // ack and set the driver status bit
     DriverStatusAck();
 
-    // XXX check features bits and ack/nak them
+    // Indirect descriptors let each request take a single slot in the ring,
+    // and event indices let the device skip interrupts, and the driver kicks,
+    // while the other side is still busy with the ring.
+    bool indirect = DeviceFeatureSupported(VIRTIO_F_RING_INDIRECT_DESC);
+    if (indirect) {
+        DriverFeatureAck(VIRTIO_F_RING_INDIRECT_DESC);
+    }
+    bool event_idx = DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX);
+    if (event_idx) {
+        DriverFeatureAck(VIRTIO_F_RING_EVENT_IDX);
+    }
 
-    // allocate the main vring
-    auto err = vring_.Init(0, ring_size);
-    if (err < 0) {
-        zxlogf(ERROR, "failed to allocate vring\n");
-        return err;
+    // 5.2.6.2 Driver Requirements: Device Operation
+    //
+    // With VIRTIO_BLK_F_MQ there are num_queues request queues, each of which
+    // the driver may use independently; a queue per CPU lets each submitting
+    // thread keep to its own.
+    num_queues_ = 1;
+    if (DeviceFeatureSupported(FeatureBit(VIRTIO_BLK_F_MQ)) && config_.num_queues > 1) {
+        DriverFeatureAck(FeatureBit(VIRTIO_BLK_F_MQ));
+        uint32_t max_queues = fbl::min(zx_system_get_num_cpus(),
+                                       static_cast<uint32_t>(kMaxQueues));
+        num_queues_ = static_cast<uint16_t>(fbl::min(static_cast<uint32_t>(config_.num_queues),
+                                                     max_queues));
     }
 
-    // allocate a queue of block requests
-    size_t size = sizeof(virtio_blk_req_t) * blk_req_count + sizeof(uint8_t) * blk_req_count;
+    // Trims are sent as discards or, failing that, as write zeroes requests
+    // which the device may satisfy by unmapping the blocks. The block
+    // protocol has no way to ask for zeroes themselves.
+    if (DeviceFeatureSupported(FeatureBit(VIRTIO_BLK_F_DISCARD)) &&
+        config_.max_discard_sectors > 0 && config_.max_discard_seg > 0) {
+        DriverFeatureAck(FeatureBit(VIRTIO_BLK_F_DISCARD));
+        trim_type_ = VIRTIO_BLK_T_DISCARD;
+        trim_max_segments_ = config_.max_discard_seg;
+        trim_max_sectors_ = config_.max_discard_sectors;
+    } else if (DeviceFeatureSupported(FeatureBit(VIRTIO_BLK_F_WRITE_ZEROES)) &&
+               config_.write_zeroes_may_unmap && config_.max_write_zeroes_sectors > 0 &&
+               config_.max_write_zeroes_seg > 0) {
+        DriverFeatureAck(FeatureBit(VIRTIO_BLK_F_WRITE_ZEROES));
+        trim_type_ = VIRTIO_BLK_T_WRITE_ZEROES;
+        trim_max_segments_ = config_.max_write_zeroes_seg;
+        trim_max_sectors_ = config_.max_write_zeroes_sectors;
+    }
+    trim_max_segments_ = fbl::min(trim_max_segments_, kMaxTrimSegments);
 
-    zx_status_t status = io_buffer_init(&blk_req_buf_, bti_.get(), size,
-                                        IO_BUFFER_RW | IO_BUFFER_CONTIG);
+    zx_status_t status = DeviceStatusFeaturesOk();
     if (status != ZX_OK) {
-        zxlogf(ERROR, "cannot alloc blk_req buffers %d\n", status);
+        zxlogf(ERROR, "%s: Feature negotiation failed (%d)\n", tag(), status);
         return status;
     }
-    blk_req_ = static_cast<virtio_blk_req_t*>(io_buffer_virt(&blk_req_buf_));
-
-    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n", blk_req_,
-            io_buffer_phys(&blk_req_buf_));
 
-    // responses are 32 words at the end of the allocated block
-    blk_res_pa_ = io_buffer_phys(&blk_req_buf_) + sizeof(virtio_blk_req_t) * blk_req_count;
-    blk_res_ = (uint8_t*)((uintptr_t)blk_req_ + sizeof(virtio_blk_req_t) * blk_req_count);
-
-    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", blk_res_, blk_res_pa_);
+    for (uint16_t i = 0; i < num_queues_; i++) {
+        if ((status = InitQueue(i, indirect, event_idx)) != ZX_OK) {
+            return status;
+        }
+    }
 
     // start the interrupt thread
     StartIrqThread();
@@ -208,97 +242,169 @@ zx_status_t BlockDevice::Init() {
     return ZX_OK;
 }
 
-void BlockDevice::IrqRingUpdate() {
-    LTRACE_ENTRY;
+zx_status_t BlockDevice::InitQueue(uint16_t index, bool indirect, bool event_idx) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Queue> queue(new (&ac) Queue(this));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
 
-    // parse our descriptor chain, add back to the free queue
-    auto free_chain = [this](vring_used_elem* used_elem) {
-        uint32_t i = (uint16_t)used_elem->id;
-        struct vring_desc* desc = vring_.DescFromIndex((uint16_t)i);
-        auto head_desc = desc; // save the first element
-        {
-            fbl::AutoLock lock(&ring_lock_);
-            for (;;) {
-                int next;
-                LTRACE_DO(virtio_dump_desc(desc));
-                if (desc->flags & VRING_DESC_F_NEXT) {
-                    next = desc->next;
-                } else {
-                    /* end of chain */
-                    next = -1;
-                }
+    // allocate the vring
+    auto err = queue->vring.Init(index, ring_size);
+    if (err < 0) {
+        zxlogf(ERROR, "failed to allocate vring\n");
+        return err;
+    }
+    queue->vring.SetEventIdx(event_idx);
+    // Each block request gets a table long enough for its header, its
+    // largest scatter list and its status.
+    if (indirect && (err = queue->vring.InitIndirect(blk_req_count, MAX_SCATTER + 2)) != ZX_OK) {
+        zxlogf(ERROR, "failed to allocate indirect descriptors\n");
+        return err;
+    }
 
-                vring_.FreeDesc((uint16_t)i);
+    // allocate a queue of block requests
+    const size_t req_size = sizeof(virtio_blk_req_t) * blk_req_count;
+    const size_t seg_size = sizeof(virtio_blk_discard_write_zeroes_t) * kMaxTrimSegments *
+                            blk_req_count;
+    size_t size = req_size + seg_size + sizeof(uint8_t) * blk_req_count;
 
-                if (next < 0)
-                    break;
-                i = next;
-                desc = vring_.DescFromIndex((uint16_t)i);
-            }
-        }
+    zx_status_t status = io_buffer_init(&queue->blk_req_buf, bti_.get(), size,
+                                        IO_BUFFER_RW | IO_BUFFER_CONTIG);
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "cannot alloc blk_req buffers %d\n", status);
+        return status;
+    }
+    uintptr_t base = reinterpret_cast<uintptr_t>(io_buffer_virt(&queue->blk_req_buf));
+    zx_paddr_t base_pa = io_buffer_phys(&queue->blk_req_buf);
+    queue->blk_req = reinterpret_cast<virtio_blk_req_t*>(base);
 
-        bool need_signal = false;
-        bool need_complete = false;
-        block_txn_t* txn = nullptr;
-        {
-            fbl::AutoLock lock(&txn_lock_);
+    LTRACEF("allocated blk request at %p, physical address %#" PRIxPTR "\n", queue->blk_req,
+            base_pa);
 
-            // search our pending txn list to see if this completes it
+    // the discard ranges follow the requests, and the responses are 32 bytes
+    // at the end of the allocated block
+    queue->blk_seg = reinterpret_cast<virtio_blk_discard_write_zeroes_t*>(base + req_size);
+    queue->blk_seg_pa = base_pa + req_size;
+    queue->blk_res_pa = base_pa + req_size + seg_size;
+    queue->blk_res = reinterpret_cast<uint8_t*>(base + req_size + seg_size);
 
-            list_for_every_entry (&txn_list_, txn, block_txn_t, node) {
-                if (txn->desc == head_desc) {
-                    LTRACEF("completes txn %p\n", txn);
-                    free_blk_req((unsigned int)txn->index);
-                    list_delete(&txn->node);
+    LTRACEF("allocated blk responses at %p, physical address %#" PRIxPTR "\n", queue->blk_res,
+            queue->blk_res_pa);
 
-                    // we will do this outside of the lock
-                    need_complete = true;
+    queues_[index] = fbl::move(queue);
+    return ZX_OK;
+}
 
-                    // check to see if QueueTxn is waiting on
-                    // resources becoming available
-                    if ((need_signal = txn_wait_)) {
-                        txn_wait_ = false;
+void BlockDevice::IrqRingUpdate() {
+    LTRACE_ENTRY;
+
+    for (uint16_t q = 0; q < num_queues_; q++) {
+        Queue* queue = queues_[q].get();
+
+        // parse our descriptor chain, add back to the free queue
+        auto free_chain = [this, queue](vring_used_elem* used_elem) {
+            uint32_t i = (uint16_t)used_elem->id;
+            struct vring_desc* desc = queue->vring.DescFromIndex((uint16_t)i);
+            auto head_desc = desc; // save the first element
+            {
+                fbl::AutoLock lock(&queue->ring_lock);
+                for (;;) {
+                    int next;
+                    LTRACE_DO(virtio_dump_desc(desc));
+                    if (desc->flags & VRING_DESC_F_NEXT) {
+                        next = desc->next;
+                    } else {
+                        /* end of chain */
+                        next = -1;
                     }
-                    break;
+
+                    queue->vring.FreeDesc((uint16_t)i);
+
+                    if (next < 0)
+                        break;
+                    i = next;
+                    desc = queue->vring.DescFromIndex((uint16_t)i);
                 }
             }
-        }
 
-        if (need_signal) {
-            sync_completion_signal(&txn_signal_);
-        }
-        if (need_complete) {
-            txn_complete(txn, ZX_OK);
-        }
-    };
+            bool need_signal = false;
+            bool need_complete = false;
+            zx_status_t status = ZX_OK;
+            block_txn_t* txn = nullptr;
+            {
+                fbl::AutoLock lock(&queue->txn_lock);
+
+                // search our pending txn list to see if this completes it
+
+                list_for_every_entry (&queue->txn_list, txn, block_txn_t, node) {
+                    if (txn->desc == head_desc) {
+                        LTRACEF("completes txn %p\n", txn);
+                        switch (queue->blk_res[txn->index]) {
+                        case VIRTIO_BLK_S_OK:
+                            break;
+                        case VIRTIO_BLK_S_UNSUPP:
+                            status = ZX_ERR_NOT_SUPPORTED;
+                            break;
+                        default:
+                            status = ZX_ERR_IO;
+                            break;
+                        }
+                        queue->free_blk_req((unsigned int)txn->index);
+                        list_delete(&txn->node);
+
+                        // we will do this outside of the lock
+                        need_complete = true;
+
+                        // check to see if QueueTxn is waiting on
+                        // resources becoming available
+                        if ((need_signal = queue->txn_wait)) {
+                            queue->txn_wait = false;
+                        }
+                        break;
+                    }
+                }
+            }
 
-    // tell the ring to find free chains and hand it back to our lambda
-    vring_.IrqRingUpdate(free_chain);
+            if (need_signal) {
+                sync_completion_signal(&queue->txn_signal);
+            }
+            if (need_complete) {
+                txn_complete(txn, status);
+            }
+        };
+
+        // tell the ring to find free chains and hand it back to our lambda
+        queue->vring.IrqRingUpdate(free_chain);
+    }
 }
 
 void BlockDevice::IrqConfigChange() {
     LTRACE_ENTRY;
 }
 
-zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
+zx_status_t BlockDevice::QueueTxn(Queue* queue, block_txn_t* txn, uint32_t type, size_t bytes,
                                   uint64_t* pages, size_t pagecount, uint16_t* idx) {
 
     size_t index;
     {
-        fbl::AutoLock lock(&txn_lock_);
-        index = alloc_blk_req();
+        fbl::AutoLock lock(&queue->txn_lock);
+        index = queue->alloc_blk_req();
         if (index >= blk_req_count) {
             LTRACEF("too many block requests queued (%zu)!\n", index);
             return ZX_ERR_NO_RESOURCES;
         }
     }
 
-    auto req = &blk_req_[index];
-    req->type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    const bool trim = (type == VIRTIO_BLK_T_DISCARD || type == VIRTIO_BLK_T_WRITE_ZEROES);
+    auto req = &queue->blk_req[index];
+    req->type = type;
     req->ioprio = 0;
-    req->sector = txn->op.rw.offset_dev;
+    // the ranges of a discard or write zeroes request carry their own sectors
+    req->sector = trim ? 0 : txn->op.rw.offset_dev;
     LTRACEF("blk_req type %u ioprio %u sector %" PRIu64 "\n",
             req->type, req->ioprio, req->sector);
+    queue->blk_res[index] = VIRTIO_BLK_S_IOERR;
 
     // save the req index into the txn->extra[1] slot so we can free it when we complete the transfer
     txn->index = index;
@@ -316,59 +422,101 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     /* put together a transfer */
     uint16_t i;
     vring_desc *desc;
+    const bool indirect = queue->vring.HasIndirect();
     {
-        fbl::AutoLock lock(&ring_lock_);
-        desc = vring_.AllocDescChain((uint16_t)(2u + pagecount), &i);
+        fbl::AutoLock lock(&queue->ring_lock);
+        if (indirect) {
+            desc = queue->vring.AllocIndirectChain((uint16_t)index, (uint16_t)(2u + pagecount),
+                                                   &i);
+        } else {
+            desc = queue->vring.AllocDescChain((uint16_t)(2u + pagecount), &i);
+        }
     }
     if (!desc) {
         LTRACEF("failed to allocate descriptor chain of length %zu\n", 2u + pagecount);
-        fbl::AutoLock lock(&txn_lock_);
-        free_blk_req(index);
+        fbl::AutoLock lock(&queue->txn_lock);
+        queue->free_blk_req(index);
         return ZX_ERR_NO_RESOURCES;
     }
 
     LTRACEF("after alloc chain desc %p, i %u\n", desc, i);
 
-    /* point the txn at this head descriptor */
-    txn->desc = desc;
+    /* point the txn at the head descriptor in the ring */
+    txn->desc = queue->vring.DescFromIndex(i);
+
+    // An indirect table's descriptors follow each other in memory.
+    auto next_desc = [queue, indirect](vring_desc* desc) {
+        return indirect ? desc + 1 : queue->vring.DescFromIndex(desc->next);
+    };
 
     /* set up the descriptor pointing to the head */
-    desc->addr = io_buffer_phys(&blk_req_buf_) + index * sizeof(virtio_blk_req_t);
+    desc->addr = io_buffer_phys(&queue->blk_req_buf) + index * sizeof(virtio_blk_req_t);
     desc->len = sizeof(virtio_blk_req_t);
     desc->flags = VRING_DESC_F_NEXT;
     LTRACE_DO(virtio_dump_desc(desc));
 
-    for (size_t n = 0; n < pagecount; n++) {
-        desc = vring_.DescFromIndex(desc->next);
-        desc->addr = pages[n];
-        desc->len = (uint32_t) ((bytes > PAGE_SIZE) ? PAGE_SIZE : bytes);
-        if (n == 0) {
-            // first entry may not be page aligned
-            size_t page0_offset = txn->op.rw.offset_vmo & PAGE_MASK;
-
-            // adjust starting address
-            desc->addr += page0_offset;
-
-            // trim length if necessary
-            size_t max = PAGE_SIZE - page0_offset;
-            if (desc->len > max) {
-                desc->len = (uint32_t) max;
-            }
+    if (trim) {
+        // 5.2.6 Device Operation
+        //
+        // A discard or write zeroes request's data is a list of ranges. A trim
+        // larger than the ranges of one request can cover is cut short, which
+        // only leaves the rest of its blocks as they were.
+        virtio_blk_discard_write_zeroes_t* seg = &queue->blk_seg[index * kMaxTrimSegments];
+        uint64_t sector = txn->op.rw.offset_dev;
+        uint64_t left = txn->op.rw.length;
+        uint32_t count = 0;
+        while (left > 0 && count < trim_max_segments_) {
+            uint32_t length = static_cast<uint32_t>(fbl::min(left,
+                static_cast<uint64_t>(trim_max_sectors_)));
+            seg[count].sector = sector;
+            seg[count].num_sectors = length;
+            seg[count].flags = (type == VIRTIO_BLK_T_WRITE_ZEROES) ?
+                               VIRTIO_BLK_WRITE_ZEROES_F_UNMAP : 0;
+            sector += length;
+            left -= length;
+            count++;
         }
+
+        desc = next_desc(desc);
+        desc->addr = queue->blk_seg_pa +
+                     index * kMaxTrimSegments * sizeof(virtio_blk_discard_write_zeroes_t);
+        desc->len = static_cast<uint32_t>(count * sizeof(virtio_blk_discard_write_zeroes_t));
         desc->flags = VRING_DESC_F_NEXT;
-        LTRACEF("pa %#lx, len %#x\n", desc->addr, desc->len);
+        LTRACE_DO(virtio_dump_desc(desc));
+    } else {
+        const bool write = (type == VIRTIO_BLK_T_OUT);
+        for (size_t n = 0; n < pagecount; n++) {
+            desc = next_desc(desc);
+            desc->addr = pages[n];
+            desc->len = (uint32_t) ((bytes > PAGE_SIZE) ? PAGE_SIZE : bytes);
+            if (n == 0) {
+                // first entry may not be page aligned
+                size_t page0_offset = txn->op.rw.offset_vmo & PAGE_MASK;
+
+                // adjust starting address
+                desc->addr += page0_offset;
+
+                // trim length if necessary
+                size_t max = PAGE_SIZE - page0_offset;
+                if (desc->len > max) {
+                    desc->len = (uint32_t) max;
+                }
+            }
+            desc->flags = VRING_DESC_F_NEXT;
+            LTRACEF("pa %#lx, len %#x\n", desc->addr, desc->len);
 
-        if (!write)
-            desc->flags |= VRING_DESC_F_WRITE; /* mark buffer as write-only if its a block read */
+            if (!write)
+                desc->flags |= VRING_DESC_F_WRITE; /* mark buffer as write-only if its a block read */
 
-        bytes -= desc->len;
+            bytes -= desc->len;
+        }
+        LTRACE_DO(virtio_dump_desc(desc));
+        assert(bytes == 0);
     }
-    LTRACE_DO(virtio_dump_desc(desc));
-    assert(bytes == 0);
 
     /* set up the descriptor pointing to the response */
-    desc = vring_.DescFromIndex(desc->next);
-    desc->addr = blk_res_pa_ + index;
+    desc = next_desc(desc);
+    desc->addr = queue->blk_res_pa + index;
     desc->len = 1;
     desc->flags = VRING_DESC_F_WRITE;
     LTRACE_DO(virtio_dump_desc(desc));
@@ -377,10 +525,70 @@ zx_status_t BlockDevice::QueueTxn(block_txn_t* txn, bool write, size_t bytes,
     return ZX_OK;
 }
 
+BlockDevice::Queue* BlockDevice::QueueForCaller() {
+    // Each thread is assigned a queue once, round-robin, so that every block
+    // fifo client, which has a thread of its own, keeps to one queue and
+    // doesn't contend for it with the other clients.
+    static fbl::atomic<uint32_t> next_thread_index(0);
+    static thread_local uint32_t thread_index = UINT32_MAX;
+    if (thread_index == UINT32_MAX) {
+        thread_index = next_thread_index.fetch_add(1);
+    }
+    return queues_[thread_index % num_queues_].get();
+}
+
+void BlockDevice::SubmitTxn(Queue* queue, block_txn_t* txn, uint32_t type, size_t bytes,
+                            uint64_t* pages, size_t pagecount) {
+    bool cannot_fail = false;
+
+    for (;;) {
+        uint16_t idx;
+
+        // attempt to setup hw txn
+        zx_status_t status = QueueTxn(queue, txn, type, bytes, pages, pagecount, &idx);
+        if (status == ZX_OK) {
+            fbl::AutoLock lock(&queue->txn_lock);
+
+            // save the txn in a list
+            list_add_tail(&queue->txn_list, &txn->node);
+
+            /* submit the transfer */
+            queue->vring.SubmitChain(idx);
+
+            /* kick it off */
+            queue->vring.Kick();
+
+            return;
+        } else {
+            if (cannot_fail) {
+                printf("virtio-block: failed to queue txn to hw: %d\n", status);
+                txn_complete(txn, status);
+                return;
+            }
+
+            fbl::AutoLock lock(&queue->txn_lock);
+
+            if (list_is_empty(&queue->txn_list)) {
+                // we hold the queue lock and the list is empty
+                // if we fail this time around, no point in trying again
+                cannot_fail = true;
+                continue;
+            } else {
+                // let the completer know we need to wake up
+                queue->txn_wait = true;
+            }
+        }
+
+        sync_completion_wait(&queue->txn_signal, ZX_TIME_INFINITE);
+        sync_completion_reset(&queue->txn_signal);
+    }
+}
+
 void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
     LTRACEF("txn %p, command %#x\n", txn, txn->op.command);
 
-    fbl::AutoLock lock(&lock_);
+    Queue* queue = QueueForCaller();
+    fbl::AutoLock lock(&queue->submit_lock);
 
     txn->op.rw.offset_vmo *= config_.blk_size;
 
@@ -421,49 +629,34 @@ void BlockDevice::QueueReadWriteTxn(block_txn_t* txn, bool write) {
 
     pages[0] += suboffset;
 
-    bool cannot_fail = false;
-
-    for (;;) {
-        uint16_t idx;
-
-        // attempt to setup hw txn
-        zx_status_t status = QueueTxn(txn, write, bytes, pages, num_pages, &idx);
-        if (status == ZX_OK) {
-            fbl::AutoLock lock(&txn_lock_);
-
-            // save the txn in a list
-            list_add_tail(&txn_list_, &txn->node);
-
-            /* submit the transfer */
-            vring_.SubmitChain(idx);
-
-            /* kick it off */
-            vring_.Kick();
+    SubmitTxn(queue, txn, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN, bytes, pages, num_pages);
+}
 
-            return;
-        } else {
-            if (cannot_fail) {
-                printf("virtio-block: failed to queue txn to hw: %d\n", status);
-                txn_complete(txn, status);
-                return;
-            }
+void BlockDevice::QueueTrimTxn(block_txn_t* txn) {
+    LTRACEF("txn %p, command %#x\n", txn, txn->op.command);
 
-            fbl::AutoLock lock(&txn_lock_);
+    if (trim_type_ == 0) {
+        txn_complete(txn, ZX_ERR_NOT_SUPPORTED);
+        return;
+    }
 
-            if (list_is_empty(&txn_list_)) {
-                // we hold the queue lock and the list is empty
-                // if we fail this time around, no point in trying again
-                cannot_fail = true;
-                continue;
-            } else {
-                // let the completer know we need to wake up
-                txn_wait_ = true;
-            }
-        }
+    // transaction must fit within device
+    if ((txn->op.rw.offset_dev >= config_.capacity) ||
+        (config_.capacity - txn->op.rw.offset_dev < txn->op.rw.length)) {
+        LTRACEF("request beyond the end of the device!\n");
+        txn_complete(txn, ZX_ERR_OUT_OF_RANGE);
+        return;
+    }
 
-        sync_completion_wait(&txn_signal_, ZX_TIME_INFINITE);
-        sync_completion_reset(&txn_signal_);
+    if (txn->op.rw.length == 0) {
+        txn_complete(txn, ZX_OK);
+        return;
     }
+
+    Queue* queue = QueueForCaller();
+    fbl::AutoLock lock(&queue->submit_lock);
+    // The ranges take the place of the data pages.
+    SubmitTxn(queue, txn, trim_type_, 0, nullptr, 1);
 }
 
 } // namespace virtio
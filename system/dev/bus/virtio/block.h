@@ -6,13 +6,17 @@
 #include "device.h"
 #include "ring.h"
 
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <zircon/compiler.h>
 
 #include "backends/backend.h"
 #include <virtio/block.h>
 #include <zircon/device/block.h>
 #include <ddk/protocol/block.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
 
 #include <lib/sync/completion.h>
 
@@ -57,54 +61,98 @@ private:
 
     void GetInfo(block_info_t* info);
 
-    zx_status_t QueueTxn(block_txn_t* txn, bool write, size_t bytes,
+    // The most virtqueues used, of the ones a device may offer. No more than
+    // one is used per CPU.
+    static const uint16_t kMaxQueues = 8;
+
+    // The most ranges in a single discard or write zeroes request.
+    static const uint32_t kMaxTrimSegments = 16;
+
+    // a queue of block request/responses
+    static const size_t blk_req_count = 32;
+
+    // A virtqueue with its own requests and pending txns, so that threads
+    // submitting to different queues don't contend.
+    struct Queue {
+        explicit Queue(Device* device) : vring(device) {
+            sync_completion_reset(&txn_signal);
+            memset(&blk_req_buf, 0, sizeof(blk_req_buf));
+        }
+        ~Queue() { io_buffer_release(&blk_req_buf); }
+
+        // the virtio ring
+        Ring vring;
+
+        // lock to be used around Ring::AllocDescChain and FreeDesc
+        // TODO: move this into Ring class once it's certain that other
+        // users of the class are okay with it.
+        fbl::Mutex ring_lock;
+
+        // Serializes submissions, which may wait for resources.
+        fbl::Mutex submit_lock;
+
+        // The requests, their discard ranges, and their one byte statuses,
+        // in that order.
+        io_buffer_t blk_req_buf;
+        virtio_blk_req_t* blk_req = nullptr;
+        virtio_blk_discard_write_zeroes_t* blk_seg = nullptr;
+        zx_paddr_t blk_seg_pa = 0;
+        zx_paddr_t blk_res_pa = 0;
+        uint8_t* blk_res = nullptr;
+
+        uint32_t blk_req_bitmap = 0;
+        static_assert(blk_req_count <= sizeof(blk_req_bitmap) * CHAR_BIT, "");
+
+        size_t alloc_blk_req() {
+            size_t i = 0;
+            if (blk_req_bitmap != 0)
+                i = sizeof(blk_req_bitmap) * CHAR_BIT - __builtin_clz(blk_req_bitmap);
+            blk_req_bitmap |= (1 << i);
+            return i;
+        }
+
+        void free_blk_req(size_t i) {
+            blk_req_bitmap &= ~(1 << i);
+        }
+
+        // pending iotxns and waiter state
+        fbl::Mutex txn_lock;
+        list_node txn_list = LIST_INITIAL_VALUE(txn_list);
+        bool txn_wait = false;
+        sync_completion_t txn_signal;
+    };
+
+    zx_status_t InitQueue(uint16_t index, bool indirect, bool event_idx);
+
+    // Picks the queue for txns submitted from the calling thread.
+    Queue* QueueForCaller();
+
+    // Builds the chain of |txn| in |queue|: a request header, then |pagecount|
+    // pages of data or, for a discard or write zeroes request, its ranges,
+    // and then the status.
+    zx_status_t QueueTxn(Queue* queue, block_txn_t* txn, uint32_t type, size_t bytes,
                          uint64_t* pages, size_t pagecount, uint16_t* idx);
+    // Submits |txn|, waiting for resources in |queue| if need be.
+    void SubmitTxn(Queue* queue, block_txn_t* txn, uint32_t type, size_t bytes,
+                   uint64_t* pages, size_t pagecount);
     void QueueReadWriteTxn(block_txn_t* txn, bool write);
+    void QueueTrimTxn(block_txn_t* txn);
 
     void txn_complete(block_txn_t* txn, zx_status_t status);
 
-    // the main virtio ring
-    Ring vring_ = {this};
-
-    // lock to be used around Ring::AllocDescChain and FreeDesc
-    // TODO: move this into Ring class once it's certain that other
-    // users of the class are okay with it.
-    fbl::Mutex ring_lock_;
+    fbl::unique_ptr<Queue> queues_[kMaxQueues];
+    uint16_t num_queues_ = 0;
 
     static const uint16_t ring_size = 128; // 128 matches legacy pci
 
     // saved block device configuration out of the pci config BAR
     virtio_blk_config_t config_ = {};
 
-    // a queue of block request/responses
-    static const size_t blk_req_count = 32;
-
-    io_buffer_t blk_req_buf_;
-    virtio_blk_req_t* blk_req_ = nullptr;
-
-    zx_paddr_t blk_res_pa_ = 0;
-    uint8_t* blk_res_ = nullptr;
-
-    uint32_t blk_req_bitmap_ = 0;
-    static_assert(blk_req_count <= sizeof(blk_req_bitmap_) * CHAR_BIT, "");
-
-    size_t alloc_blk_req() {
-        size_t i = 0;
-        if (blk_req_bitmap_ != 0)
-            i = sizeof(blk_req_bitmap_) * CHAR_BIT - __builtin_clz(blk_req_bitmap_);
-        blk_req_bitmap_ |= (1 << i);
-        return i;
-    }
-
-    void free_blk_req(size_t i) {
-        blk_req_bitmap_ &= ~(1 << i);
-    }
-
-    // pending iotxns and waiter state
-    fbl::Mutex txn_lock_;
-    list_node txn_list_ = LIST_INITIAL_VALUE(txn_list_);
-    bool txn_wait_ = false;
-    sync_completion_t txn_signal_;
+    // The request type trims are sent as, if the device supports one, and
+    // the most ranges, and sectors per range, the device takes in one.
+    uint32_t trim_type_ = 0;
+    uint32_t trim_max_segments_ = 0;
+    uint32_t trim_max_sectors_ = 0;
 
     block_impl_protocol_ops_t block_ops_ = {};
 };
@@ -60,9 +60,12 @@ public:
     const zx::bti& bti() { return bti_; }
 protected:
     // Methods for checking / acknowledging features
+    // The VIRTIO_<type>_F_* flags of the device types are masks, but these
+    // take the numbers of feature bits, as the VIRTIO_F_* are.
+    static constexpr uint32_t FeatureBit(uint32_t flag) { return __builtin_ctz(flag); }
     bool DeviceFeatureSupported(uint32_t feature) { return backend_->ReadFeature(feature); }
     void DriverFeatureAck(uint32_t feature) { backend_->SetFeature(feature); }
-    bool DeviceStatusFeaturesOk() { return backend_->ConfirmFeatures(); }
+    zx_status_t DeviceStatusFeaturesOk() { return backend_->ConfirmFeatures(); }
 
     // Devie lifecycle methods
     void DeviceReset() { backend_->DeviceReset(); }
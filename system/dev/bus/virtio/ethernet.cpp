@@ -23,6 +23,7 @@
 #include <virtio/virtio.h>
 #include <zircon/assert.h>
 #include <zircon/status.h>
+#include <zircon/syscalls.h>
 #include <zircon/types.h>
 
 #include "ring.h"
@@ -48,10 +49,24 @@ const size_t kL1EthHdrLen = 26;
 // The goal here is to allocate single-page I/O buffers.
 const size_t kFrameSize = sizeof(virtio_net_hdr_t) + kL1EthHdrLen + kVirtioMtu;
 const size_t kFramesInBuf = PAGE_SIZE / kFrameSize;
-const size_t kNumIoBufs = fbl::round_up(kBacklog * 2, kFramesInBuf) / kFramesInBuf;
 
-const uint16_t kRxId = 0u;
-const uint16_t kTxId = 1u;
+// The rx and tx virtqueues of pair |n| are queues 2n and 2n + 1; see section
+// 5.1.2 of the spec.
+uint16_t RxId(uint16_t pair) {
+    return static_cast<uint16_t>(pair * 2);
+}
+uint16_t TxId(uint16_t pair) {
+    return static_cast<uint16_t>(pair * 2 + 1);
+}
+
+// Each pair's backlogs get their own frames in the I/O buffers.
+size_t NumIoBufs(uint16_t pairs) {
+    return fbl::round_up(kBacklog * 2 * pairs, kFramesInBuf) / kFramesInBuf;
+}
+
+// How long to wait for the device to ack a control command.
+const zx_duration_t kCtrlPollInterval = ZX_MSEC(1);
+const uint32_t kCtrlPollTries = 100;
 
 // Strictly for convenience...
 typedef struct vring_desc desc_t;
@@ -120,17 +135,18 @@ ethmac_protocol_ops_t kProtoOps = {
 };
 
 // I/O buffer helpers
-zx_status_t InitBuffers(const zx::bti& bti, fbl::unique_ptr<io_buffer_t[]>* out) {
+zx_status_t InitBuffers(const zx::bti& bti, size_t num_bufs,
+                        fbl::unique_ptr<io_buffer_t[]>* out) {
     zx_status_t rc;
     fbl::AllocChecker ac;
-    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[kNumIoBufs]);
+    fbl::unique_ptr<io_buffer_t[]> bufs(new (&ac) io_buffer_t[num_bufs]);
     if (!ac.check()) {
         zxlogf(ERROR, "out of memory!\n");
         return ZX_ERR_NO_MEMORY;
     }
-    memset(bufs.get(), 0, sizeof(io_buffer_t) * kNumIoBufs);
+    memset(bufs.get(), 0, sizeof(io_buffer_t) * num_bufs);
     size_t buf_size = kFrameSize * kFramesInBuf;
-    for (uint16_t id = 0; id < kNumIoBufs; ++id) {
+    for (size_t id = 0; id < num_bufs; ++id) {
         if ((rc = io_buffer_init(&bufs[id], bti.get(), buf_size,
                                  IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
             zxlogf(ERROR, "failed to allocate I/O buffers: %s\n", zx_status_get_string(rc));
@@ -141,11 +157,11 @@ zx_status_t InitBuffers(const zx::bti& bti, fbl::unique_ptr<io_buffer_t[]>* out)
     return ZX_OK;
 }
 
-void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs) {
+void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs, size_t num_bufs) {
     if (!bufs) {
         return;
     }
-    for (size_t i = 0; i < kNumIoBufs; ++i) {
+    for (size_t i = 0; i < num_bufs; ++i) {
         if (io_buffer_is_valid(&bufs[i])) {
             io_buffer_release(&bufs[i]);
         }
@@ -154,7 +170,7 @@ void ReleaseBuffers(fbl::unique_ptr<io_buffer_t[]> bufs) {
 
 // Frame access helpers
 zx_off_t GetFrame(io_buffer_t** bufs, uint16_t ring_id, uint16_t desc_id) {
-    uint16_t i = static_cast<uint16_t>(desc_id + ring_id * kBacklog);
+    size_t i = desc_id + ring_id * kBacklog;
     *bufs = &((*bufs)[i / kFramesInBuf]);
     return (i % kFramesInBuf) * kFrameSize;
 }
@@ -182,8 +198,9 @@ uint8_t* GetFrameData(io_buffer_t* bufs, uint16_t ring_id, uint16_t desc_id, siz
 } // namespace
 
 EthernetDevice::EthernetDevice(zx_device_t* bus_device, zx::bti bti, fbl::unique_ptr<Backend> backend)
-    : Device(bus_device, fbl::move(bti), fbl::move(backend)), rx_(this), tx_(this), bufs_(nullptr),
-      unkicked_(0), ifc_(nullptr), cookie_(nullptr) {
+    : Device(bus_device, fbl::move(bti), fbl::move(backend)), num_pairs_(0), active_pairs_(0),
+      bufs_(nullptr), num_bufs_(0), ctrl_(this), ifc_(nullptr), cookie_(nullptr) {
+    memset(&ctrl_buf_, 0, sizeof(ctrl_buf_));
 }
 
 EthernetDevice::~EthernetDevice() {
@@ -193,8 +210,7 @@ EthernetDevice::~EthernetDevice() {
 zx_status_t EthernetDevice::Init() {
     LTRACE_ENTRY;
     zx_status_t rc;
-    if (mtx_init(&state_lock_, mtx_plain) != thrd_success ||
-        mtx_init(&tx_lock_, mtx_plain) != thrd_success) {
+    if (mtx_init(&state_lock_, mtx_plain) != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
     }
     fbl::AutoLock lock(&state_lock_);
@@ -210,10 +226,19 @@ zx_status_t EthernetDevice::Init() {
     // Ack and set the driver status bit
     DriverStatusAck();
 
+    // 5.1.6.3 Setting Up Receive Buffers
+    //
+    // With VIRTIO_NET_F_MRG_RXBUF, the device may spread a packet over
+    // several rx buffers, the number of which it writes to the header of the
+    // first.
     virtio_hdr_len_ = sizeof(virtio_net_hdr_t);
+    if (DeviceFeatureSupported(FeatureBit(VIRTIO_NET_F_MRG_RXBUF))) {
+        DriverFeatureAck(FeatureBit(VIRTIO_NET_F_MRG_RXBUF));
+        mrg_rxbuf_ = true;
+    }
     if (DeviceFeatureSupported(VIRTIO_F_VERSION_1)) {
       DriverFeatureAck(VIRTIO_F_VERSION_1);
-    } else {
+    } else if (!mrg_rxbuf_) {
       // 5.1.6.1 Legacy Interface: Device Operation
       //
       // The legacy driver only presented num_buffers in the struct
@@ -222,6 +247,52 @@ zx_status_t EthernetDevice::Init() {
       virtio_hdr_len_ -= 2;
     }
 
+    // 5.1.6.5.5 Automatic receive steering in multiqueue mode
+    //
+    // Additional pairs are enabled with a command on the control virtqueue,
+    // after which the device answers each flow on the rx queue paired with
+    // the tx queue it was last sent on.
+    //
+    // A pair per CPU lets each serve its own flows.
+    num_pairs_ = 1;
+    const uint16_t max_pairs = static_cast<uint16_t>(
+        fbl::min(zx_system_get_num_cpus(), static_cast<uint32_t>(kMaxQueuePairs)));
+    if (DeviceFeatureSupported(FeatureBit(VIRTIO_NET_F_MQ)) &&
+        DeviceFeatureSupported(FeatureBit(VIRTIO_NET_F_CTRL_VQ)) &&
+        config_.max_virtqueue_pairs > 1 && max_pairs > 1) {
+        DriverFeatureAck(FeatureBit(VIRTIO_NET_F_CTRL_VQ));
+        DriverFeatureAck(FeatureBit(VIRTIO_NET_F_MQ));
+        num_pairs_ = fbl::min(config_.max_virtqueue_pairs, max_pairs);
+    }
+
+    // 5.1.6.2 Packet Transmission and 5.1.6.4 Processing of Incoming Packets
+    //
+    // The device completes the L4 checksum of a packet sent with
+    // VIRTIO_NET_HDR_F_NEEDS_CSUM, and marks the packets whose checksums it
+    // has validated with VIRTIO_NET_HDR_F_DATA_VALID. The segmentation
+    // offloads aren't used, as each tx buffer only holds one frame.
+    if (DeviceFeatureSupported(FeatureBit(VIRTIO_NET_F_CSUM))) {
+        DriverFeatureAck(FeatureBit(VIRTIO_NET_F_CSUM));
+        tx_csum_ = true;
+    }
+    if (DeviceFeatureSupported(FeatureBit(VIRTIO_NET_F_GUEST_CSUM))) {
+        DriverFeatureAck(FeatureBit(VIRTIO_NET_F_GUEST_CSUM));
+        rx_csum_ = true;
+    }
+
+    // 2.4.7 Used Buffer Notification Suppression
+    //
+    // With VIRTIO_F_RING_EVENT_IDX, each side tells the other how far along
+    // the ring it wants to be notified, so the device only interrupts once
+    // per batch of rx buffers, and is only kicked when it is waiting for
+    // more. The tx rings are only reclaimed once they run out, so the device
+    // interrupts for them at most once per reclaim.
+    bool event_idx = false;
+    if (DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX)) {
+        DriverFeatureAck(VIRTIO_F_RING_EVENT_IDX);
+        event_idx = true;
+    }
+
     // TODO(aarongreen): Check additional features bits and ack/nak them
     rc = DeviceStatusFeaturesOk();
     if (rc != ZX_OK) {
@@ -234,34 +305,72 @@ zx_status_t EthernetDevice::Init() {
 
     // Allocate I/O buffers and virtqueues.
     uint16_t num_descs = static_cast<uint16_t>(kBacklog & 0xffff);
-    if ((rc = InitBuffers(bti_, &bufs_)) != ZX_OK || (rc = rx_.Init(kRxId, num_descs)) != ZX_OK ||
-        (rc = tx_.Init(kTxId, num_descs)) != ZX_OK) {
-        zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
+    num_bufs_ = NumIoBufs(num_pairs_);
+    if ((rc = InitBuffers(bti_, num_bufs_, &bufs_)) != ZX_OK) {
         return rc;
     }
+    fbl::AllocChecker ac;
+    for (uint16_t pair = 0; pair < num_pairs_; ++pair) {
+        queues_[pair].reset(new (&ac) QueuePair(this));
+        if (!ac.check()) {
+            zxlogf(ERROR, "out of memory!\n");
+            return ZX_ERR_NO_MEMORY;
+        }
+        if ((rc = queues_[pair]->rx.Init(RxId(pair), num_descs)) != ZX_OK ||
+            (rc = queues_[pair]->tx.Init(TxId(pair), num_descs)) != ZX_OK) {
+            zxlogf(ERROR, "failed to allocate virtqueue: %s\n", zx_status_get_string(rc));
+            return rc;
+        }
+        queues_[pair]->rx.SetEventIdx(event_idx);
+        queues_[pair]->tx.SetEventIdx(event_idx);
+        if (mrg_rxbuf_) {
+            queues_[pair]->merge_buf.reset(new (&ac) uint8_t[kL1EthHdrLen + kVirtioMtu]);
+            if (!ac.check()) {
+                zxlogf(ERROR, "out of memory!\n");
+                return ZX_ERR_NO_MEMORY;
+            }
+        }
+    }
+    // The control virtqueue follows the last of the device's pairs, whether
+    // or not they are all used.
+    if (num_pairs_ > 1) {
+        uint16_t ctrl_id = static_cast<uint16_t>(config_.max_virtqueue_pairs * 2);
+        if ((rc = ctrl_.Init(ctrl_id, 4)) != ZX_OK ||
+            (rc = io_buffer_init(&ctrl_buf_, bti_.get(), PAGE_SIZE,
+                                 IO_BUFFER_RW | IO_BUFFER_CONTIG)) != ZX_OK) {
+            zxlogf(ERROR, "failed to allocate control virtqueue: %s\n",
+                   zx_status_get_string(rc));
+            return rc;
+        }
+    }
 
     // Associate the I/O buffers with the virtqueue descriptors
     desc_t* desc = nullptr;
     uint16_t id;
 
-    // For rx buffers, we queue a bunch of "reads" from the network that
-    // complete when packets arrive.
-    for (uint16_t i = 0; i < num_descs; ++i) {
-        desc = rx_.AllocDescChain(1, &id);
-        desc->addr = GetFramePhys(bufs_.get(), kRxId, id);
-        desc->len = kFrameSize;
-        desc->flags |= VRING_DESC_F_WRITE;
-        LTRACE_DO(virtio_dump_desc(desc));
-        rx_.SubmitChain(id);
-    }
+    for (uint16_t pair = 0; pair < num_pairs_; ++pair) {
+        Ring& rx = queues_[pair]->rx;
+        Ring& tx = queues_[pair]->tx;
+
+        // For rx buffers, we queue a bunch of "reads" from the network that
+        // complete when packets arrive.
+        for (uint16_t i = 0; i < num_descs; ++i) {
+            desc = rx.AllocDescChain(1, &id);
+            desc->addr = GetFramePhys(bufs_.get(), RxId(pair), id);
+            desc->len = kFrameSize;
+            desc->flags |= VRING_DESC_F_WRITE;
+            LTRACE_DO(virtio_dump_desc(desc));
+            rx.SubmitChain(id);
+        }
 
-    // For tx buffers, we hold onto them until we need to send a packet.
-    for (uint16_t id = 0; id < num_descs; ++id) {
-        desc = tx_.DescFromIndex(id);
-        desc->addr = GetFramePhys(bufs_.get(), kTxId, id);
-        desc->len = 0;
-        desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
-        LTRACE_DO(virtio_dump_desc(desc));
+        // For tx buffers, we hold onto them until we need to send a packet.
+        for (uint16_t id = 0; id < num_descs; ++id) {
+            desc = tx.DescFromIndex(id);
+            desc->addr = GetFramePhys(bufs_.get(), TxId(pair), id);
+            desc->len = 0;
+            desc->flags &= static_cast<uint16_t>(~VRING_DESC_F_WRITE);
+            LTRACE_DO(virtio_dump_desc(desc));
+        }
     }
 
     // Start the interrupt thread and set the driver OK status
@@ -281,14 +390,98 @@ zx_status_t EthernetDevice::Init() {
         return rc;
     }
     // Give the rx buffers to the host
-    rx_.Kick();
+    for (uint16_t pair = 0; pair < num_pairs_; ++pair) {
+        queues_[pair]->rx.Kick();
+    }
 
     // Woohoo! Driver should be ready.
     cleanup.cancel();
     DriverStatusOk();
+
+    // 5.1.6.5.5.2 Driver Requirements: Automatic receive steering
+    //
+    // The device only uses the first pair until told how many to use, so if
+    // it refuses, the driver carries on with one.
+    active_pairs_ = 1;
+    if (num_pairs_ > 1) {
+        virtio_net_ctrl_mq_t mq = {};
+        mq.virtqueue_pairs = num_pairs_;
+        if ((rc = SendCtrlCommand(VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET, &mq,
+                                  sizeof(mq))) == ZX_OK) {
+            active_pairs_ = num_pairs_;
+        } else {
+            zxlogf(ERROR, "%s: failed to enable %u queue pairs: %s\n", tag(), num_pairs_,
+                   zx_status_get_string(rc));
+        }
+    }
     return ZX_OK;
 }
 
+zx_status_t EthernetDevice::SendCtrlCommand(uint8_t class_id, uint8_t command, const void* data,
+                                            size_t len) {
+    // 5.1.6.5 Control Virtqueue
+    //
+    // A command is a header, its data, and an ack byte written by the device.
+    virtio_net_ctrl_hdr_t hdr = {};
+    hdr.class_id = class_id;
+    hdr.command = command;
+    size_t ack_offset = sizeof(hdr) + len;
+    ZX_DEBUG_ASSERT(ack_offset < PAGE_SIZE);
+
+    uint8_t* base = static_cast<uint8_t*>(io_buffer_virt(&ctrl_buf_));
+    zx_paddr_t base_pa = io_buffer_phys(&ctrl_buf_);
+    memcpy(base, &hdr, sizeof(hdr));
+    memcpy(base + sizeof(hdr), data, len);
+    volatile uint8_t* ack = base + ack_offset;
+    *ack = VIRTIO_NET_ERR;
+
+    uint16_t id;
+    desc_t* desc = ctrl_.AllocDescChain(3, &id);
+    if (!desc) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+    desc->addr = base_pa;
+    desc->len = static_cast<uint32_t>(sizeof(hdr));
+    desc->flags = VRING_DESC_F_NEXT;
+    desc = ctrl_.DescFromIndex(desc->next);
+    desc->addr = base_pa + sizeof(hdr);
+    desc->len = static_cast<uint32_t>(len);
+    desc->flags = VRING_DESC_F_NEXT;
+    desc = ctrl_.DescFromIndex(desc->next);
+    desc->addr = base_pa + ack_offset;
+    desc->len = 1;
+    desc->flags = VRING_DESC_F_WRITE;
+    ctrl_.SubmitChain(id);
+    ctrl_.Kick();
+
+    // Commands are rare, so rather than route the control queue's interrupt
+    // here, poll for the device to return the chain.
+    bool done = false;
+    for (uint32_t i = 0; i < kCtrlPollTries && !done; ++i) {
+        ctrl_.IrqRingUpdate([this, &done](vring_used_elem* used_elem) {
+            uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
+            for (;;) {
+                desc_t* desc = ctrl_.DescFromIndex(id);
+                bool next = (desc->flags & VRING_DESC_F_NEXT) != 0;
+                uint16_t next_id = desc->next;
+                ctrl_.FreeDesc(id);
+                if (!next) {
+                    break;
+                }
+                id = next_id;
+            }
+            done = true;
+        });
+        if (!done) {
+            zx_nanosleep(zx_deadline_after(kCtrlPollInterval));
+        }
+    }
+    if (!done) {
+        return ZX_ERR_TIMED_OUT;
+    }
+    return *ack == VIRTIO_NET_OK ? ZX_OK : ZX_ERR_IO;
+}
+
 void EthernetDevice::Release() {
     LTRACE_ENTRY;
     fbl::AutoLock lock(&state_lock_);
@@ -297,56 +490,146 @@ void EthernetDevice::Release() {
 
 void EthernetDevice::ReleaseLocked() {
     ifc_ = nullptr;
-    ReleaseBuffers(fbl::move(bufs_));
+    ReleaseBuffers(fbl::move(bufs_), num_bufs_);
+    io_buffer_release(&ctrl_buf_);
     Device::Release();
 }
 
 void EthernetDevice::IrqRingUpdate() {
     LTRACE_ENTRY;
-    // Lock to prevent changes to ifc_.
-    {
-        fbl::AutoLock lock(&state_lock_);
-        if (!ifc_) {
+    for (uint16_t pair = 0; pair < num_pairs_; ++pair) {
+        Ring& rx = queues_[pair]->rx;
+        // The buffers are handed straight back to the device, in one update
+        // of the avail ring, rather than through the free list.
+        uint16_t recycled[kBacklog];
+        size_t num_recycled = 0;
+        // Lock to prevent changes to ifc_.
+        {
+            fbl::AutoLock lock(&state_lock_);
+            if (!ifc_) {
+                return;
+            }
+            // Ring::IrqRingUpdate will call this lambda on each rx buffer filled by
+            // the underlying device since the last IRQ.
+            // Thread safety analysis is explicitly disabled as clang isn't able to determine that
+            // the state_lock_ is  held when the lambda invoked.
+            rx.IrqRingUpdate([this, &rx, pair, &recycled, &num_recycled](vring_used_elem* used_elem)
+                                 TA_NO_THREAD_SAFETY_ANALYSIS {
+                uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
+                desc_t* desc = rx.DescFromIndex(id);
+                assert((desc->flags & VRING_DESC_F_NEXT) == 0);
+                LTRACE_DO(virtio_dump_desc(desc));
+                RxBuffer(pair, id, fbl::min(static_cast<size_t>(used_elem->len), kFrameSize));
+                ZX_DEBUG_ASSERT(num_recycled < kBacklog);
+                recycled[num_recycled++] = id;
+            });
+        }
+
+        // Now recycle the rx buffers.  As in Init(), this means queuing a bunch of
+        // "reads" from the network that will complete when packets arrive.
+        if (num_recycled == 0) {
+            continue;
+        }
+        for (size_t i = 0; i < num_recycled; ++i) {
+            rx.DescFromIndex(recycled[i])->len = kFrameSize;
+        }
+        rx.SubmitChains(recycled, num_recycled);
+
+        // Poke the virtqueue to pick them up.
+        rx.Kick();
+    }
+}
+
+void EthernetDevice::RxBuffer(uint16_t pair, uint16_t id, size_t len) {
+    QueuePair* queue = queues_[pair].get();
+    const virtio_net_hdr_t* hdr;
+    uint8_t* data;
+
+    if (queue->merge_left == 0) {
+        // The first buffer of a packet starts with its header.
+        if (len < virtio_hdr_len_) {
+            LTRACEF("dropping runt buffer of %zu bytes on queue %u\n", len, pair);
             return;
         }
-        // Ring::IrqRingUpdate will call this lambda on each rx buffer filled by
-        // the underlying device since the last IRQ.
-        // Thread safety analysis is explicitly disabled as clang isn't able to determine that the
-        // state_lock_ is  held when the lambda invoked.
-        rx_.IrqRingUpdate([this](vring_used_elem* used_elem) TA_NO_THREAD_SAFETY_ANALYSIS {
-            uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-            desc_t* desc = rx_.DescFromIndex(id);
-
-            // Transitional driver does not merge rx buffers.
-            assert(used_elem->len < desc->len);
-            uint8_t* data = GetFrameData(bufs_.get(), kRxId, id, virtio_hdr_len_);
-            size_t len = used_elem->len - virtio_hdr_len_;
-            LTRACEF("Receiving %zu bytes:\n", len);
-            LTRACE_DO(hexdump8_ex(data, len, 0));
-
-            // Pass the data up the stack to the generic Ethernet driver
-            ifc_->recv(cookie_, data, len, 0);
-            assert((desc->flags & VRING_DESC_F_NEXT) == 0);
-            LTRACE_DO(virtio_dump_desc(desc));
-            rx_.FreeDesc(id);
-        });
+        hdr = GetFrameHdr(bufs_.get(), RxId(pair), id);
+        data = GetFrameData(bufs_.get(), RxId(pair), id, virtio_hdr_len_);
+        len -= virtio_hdr_len_;
+        if (mrg_rxbuf_ && hdr->num_buffers > 1) {
+            memcpy(&queue->merge_hdr, hdr, sizeof(queue->merge_hdr));
+            memcpy(queue->merge_buf.get(), data, fbl::min(len, kL1EthHdrLen + kVirtioMtu));
+            queue->merge_overflow = len > kL1EthHdrLen + kVirtioMtu;
+            queue->merge_len = len;
+            queue->merge_left = static_cast<uint16_t>(hdr->num_buffers - 1);
+            return;
+        }
+    } else {
+        // The rest only hold data.
+        uint8_t* frag = static_cast<uint8_t*>(GetFrameVirt(bufs_.get(), RxId(pair), id));
+        if (queue->merge_len + len > kL1EthHdrLen + kVirtioMtu) {
+            queue->merge_overflow = true;
+        } else {
+            memcpy(queue->merge_buf.get() + queue->merge_len, frag, len);
+        }
+        queue->merge_len += len;
+        if (--queue->merge_left > 0) {
+            return;
+        }
+        if (queue->merge_overflow) {
+            LTRACEF("dropping packet of %zu bytes on queue %u\n", queue->merge_len, pair);
+            return;
+        }
+        hdr = &queue->merge_hdr;
+        data = queue->merge_buf.get();
+        len = queue->merge_len;
     }
 
-    // Now recycle the rx buffers.  As in Init(), this means queuing a bunch of
-    // "reads" from the network that will complete when packets arrive.
-    desc_t* desc = nullptr;
-    uint16_t id;
-    bool need_kick = false;
-    while ((desc = rx_.AllocDescChain(1, &id))) {
-        desc->len = kFrameSize;
-        rx_.SubmitChain(id);
-        need_kick = true;
+    LTRACEF("Receiving %zu bytes on queue %u:\n", len, pair);
+    LTRACE_DO(hexdump8_ex(data, len, 0));
+    uint32_t flags = RxCsumFlags(hdr, data, len);
+
+    // Pass the data up the stack to the generic Ethernet driver
+    if (ifc_->recv_queue) {
+        ifc_->recv_queue(cookie_, pair, data, len, flags);
+    } else {
+        ifc_->recv(cookie_, data, len, flags);
+    }
+}
+
+uint32_t EthernetDevice::RxCsumFlags(const virtio_net_hdr_t* hdr, uint8_t* data, size_t len) {
+    if (!rx_csum_) {
+        return 0;
+    }
+    if (hdr->flags & VIRTIO_NET_HDR_F_DATA_VALID) {
+        return ETHMAC_RX_CSUM_L4_OK;
+    }
+    if ((hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) == 0) {
+        return 0;
     }
 
-    // If we have re-queued any rx buffers, poke the virtqueue to pick them up.
-    if (need_kick) {
-        rx_.Kick();
+    // 5.1.6.4 Processing of Incoming Packets
+    //
+    // A packet from another guest on the same host may arrive with only the
+    // pseudo-header checksum filled in, which the driver completes. Its
+    // contents never crossed a wire, so it is known to be intact.
+    size_t start = hdr->csum_start;
+    size_t offset = start + hdr->csum_offset;
+    if (offset + sizeof(uint16_t) > len) {
+        return 0;
+    }
+    uint32_t sum = 0;
+    for (size_t i = start; i + 1 < len; i += 2) {
+        sum += static_cast<uint32_t>(data[i] << 8 | data[i + 1]);
+    }
+    if ((len - start) % 2) {
+        sum += static_cast<uint32_t>(data[len - 1] << 8);
     }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    uint16_t csum = static_cast<uint16_t>(~sum);
+    data[offset] = static_cast<uint8_t>(csum >> 8);
+    data[offset + 1] = static_cast<uint8_t>(csum);
+    return ETHMAC_RX_CSUM_L4_OK;
 }
 
 void EthernetDevice::IrqConfigChange() {
@@ -368,9 +651,11 @@ zx_status_t EthernetDevice::Query(uint32_t options, ethmac_info_t* info) {
     }
     fbl::AutoLock lock(&state_lock_);
     if (info) {
-        // TODO(aarongreen): Add info->features = GetFeatures();
+        info->features = (tx_csum_ ? ETHMAC_FEATURE_TX_CSUM_L4 : 0) |
+                         (rx_csum_ ? ETHMAC_FEATURE_RX_CSUM : 0);
         info->mtu = kVirtioMtu;
         memcpy(info->mac, config_.mac, sizeof(info->mac));
+        info->queue_count = active_pairs_;
     }
     return ZX_OK;
 }
@@ -405,25 +690,32 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
         LTRACEF("dropping packet; invalid packet\n");
         return ZX_ERR_INVALID_ARGS;
     }
+    if (netbuf->queue >= active_pairs_) {
+        LTRACEF("dropping packet; invalid queue %u\n", netbuf->queue);
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const uint16_t pair = netbuf->queue;
+    QueuePair* queue = queues_[pair].get();
+    Ring& tx = queue->tx;
 
-    fbl::AutoLock lock(&tx_lock_);
+    fbl::AutoLock lock(&queue->tx_lock);
 
     // Flush outstanding descriptors.  Ring::IrqRingUpdate will call this lambda
     // on each sent tx_buffer, allowing us to reclaim them.
-    auto flush = [this](vring_used_elem* used_elem) {
+    auto flush = [&tx](vring_used_elem* used_elem) {
         uint16_t id = static_cast<uint16_t>(used_elem->id & 0xffff);
-        desc_t* desc = tx_.DescFromIndex(id);
+        desc_t* desc = tx.DescFromIndex(id);
         assert((desc->flags & VRING_DESC_F_NEXT) == 0);
         LTRACE_DO(virtio_dump_desc(desc));
-        tx_.FreeDesc(id);
+        tx.FreeDesc(id);
     };
 
     // Grab a free descriptor
     uint16_t id;
-    desc_t* desc = tx_.AllocDescChain(1, &id);
+    desc_t* desc = tx.AllocDescChain(1, &id);
     if (!desc) {
-        tx_.IrqRingUpdate(flush);
-        desc = tx_.AllocDescChain(1, &id);
+        tx.IrqRingUpdate(flush);
+        desc = tx.AllocDescChain(1, &id);
     }
     if (!desc) {
         LTRACEF("dropping packet; out of descriptors\n");
@@ -431,7 +723,7 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
     }
 
     // Add the data to be sent
-    virtio_net_hdr_t* tx_hdr = GetFrameHdr(bufs_.get(), kTxId, id);
+    virtio_net_hdr_t* tx_hdr = GetFrameHdr(bufs_.get(), TxId(pair), id);
     memset(tx_hdr, 0, virtio_hdr_len_);
 
     // 5.1.6.2.1 Driver Requirements: Packet Transmission
@@ -447,13 +739,23 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
 
     // If VIRTIO_NET_F_CSUM is not negotiated, the driver MUST set flags to
     // zero and SHOULD supply a fully checksummed packet to the device.
+    //
+    // Otherwise the ethernet core has seeded the L4 checksum with the
+    // pseudo-header, as the device expects, for it to complete.
     tx_hdr->flags = 0;
+    const ethmac_tx_offload_t& offload = netbuf->offload;
+    if (tx_csum_ && (offload.flags & (ETHMAC_TX_OFFLOAD_TCP_CSUM | ETHMAC_TX_OFFLOAD_UDP_CSUM))) {
+        tx_hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+        tx_hdr->csum_start = offload.l4_offset;
+        // The offset of the checksum field in a TCP or UDP header.
+        tx_hdr->csum_offset = (offload.flags & ETHMAC_TX_OFFLOAD_TCP_CSUM) ? 16 : 6;
+    }
 
     // If none of the VIRTIO_NET_F_HOST_TSO4, TSO6 or UFO options have been
     // negotiated, the driver MUST set gso_type to VIRTIO_NET_HDR_GSO_NONE.
     tx_hdr->gso_type = VIRTIO_NET_HDR_GSO_NONE;
 
-    void* tx_buf = GetFrameData(bufs_.get(), kTxId, id, virtio_hdr_len_);
+    void* tx_buf = GetFrameData(bufs_.get(), TxId(pair), id, virtio_hdr_len_);
     memcpy(tx_buf, data, length);
     desc->len = static_cast<uint32_t>(virtio_hdr_len_ + length);
 
@@ -461,11 +763,11 @@ zx_status_t EthernetDevice::QueueTx(uint32_t options, ethmac_netbuf_t* netbuf) {
     LTRACE_DO(virtio_dump_desc(desc));
     LTRACEF("Sending %zu bytes:\n", length);
     LTRACE_DO(hexdump8_ex(tx_buf, length, 0));
-    tx_.SubmitChain(id);
-    ++unkicked_;
-    if ((options & ETHMAC_TX_OPT_MORE) == 0 || unkicked_ > kBacklog / 2) {
-        tx_.Kick();
-        unkicked_ = 0;
+    tx.SubmitChain(id);
+    ++queue->unkicked;
+    if ((options & ETHMAC_TX_OPT_MORE) == 0 || queue->unkicked > kBacklog / 2) {
+        tx.Kick();
+        queue->unkicked = 0;
     }
     return ZX_OK;
 }
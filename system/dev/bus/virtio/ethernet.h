@@ -45,25 +45,76 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(EthernetDevice);
 
+    // The most virtqueue pairs used, of the ones a device may offer. No more
+    // than one is used per CPU.
+    static constexpr uint16_t kMaxQueuePairs = ETHMAC_MAX_QUEUES;
+
+    // An rx and a tx virtqueue. Packets sent on a pair's tx queue are
+    // answered on its rx queue: the device steers each flow to the rx queue
+    // paired with the tx queue it was last sent on; see section 5.1.6.5.5 of
+    // the spec.
+    struct QueuePair {
+        explicit QueuePair(Device* device) : rx(device), tx(device) {
+            mtx_init(&tx_lock, mtx_plain);
+        }
+        ~QueuePair() { mtx_destroy(&tx_lock); }
+
+        Ring rx;
+        Ring tx;
+        mtx_t tx_lock;
+        size_t unkicked TA_GUARDED(tx_lock) = 0;
+
+        // A packet spread over several rx buffers, as the device may do once
+        // VIRTIO_NET_F_MRG_RXBUF is negotiated, is gathered here. These are
+        // only used by the irq thread.
+        fbl::unique_ptr<uint8_t[]> merge_buf;
+        virtio_net_hdr_t merge_hdr;
+        size_t merge_len = 0;
+        uint16_t merge_left = 0;
+        bool merge_overflow = false;
+    };
+
     // DDK device hooks; see ddk/device.h
     void ReleaseLocked() TA_REQ(state_lock_);
 
+    // The ETHMAC_RX_CSUM_* flags of the |len| byte packet |data| received with
+    // |hdr|, whose L4 checksum is completed first if the device left it partial.
+    uint32_t RxCsumFlags(const virtio_net_hdr_t* hdr, uint8_t* data, size_t len);
+
+    // Handles the used rx buffer |id| of |pair|, which holds |len| bytes,
+    // passing a packet up the stack once all of its buffers have arrived.
+    void RxBuffer(uint16_t pair, uint16_t id, size_t len) TA_REQ(state_lock_);
+
+    // Sends a command on the control virtqueue, and waits for its ack.
+    zx_status_t SendCtrlCommand(uint8_t class_id, uint8_t command, const void* data,
+                                size_t len) TA_REQ(state_lock_);
+
     // Mutexes to control concurrent access
     mtx_t state_lock_;
-    mtx_t tx_lock_;
 
     // Virtqueues; see section 5.1.2 of the spec
-    // This driver doesn't currently support multi-queueing, automatic
-    // steering, or the control virtqueue, so only a single queue is needed in
-    // each direction.
-    Ring rx_;
-    Ring tx_;
+    // Each of the |num_pairs_| pairs has its own I/O buffers, but only the
+    // first |active_pairs_| carry traffic. Both are set by Init().
+    fbl::unique_ptr<QueuePair> queues_[kMaxQueuePairs];
+    uint16_t num_pairs_;
+    uint16_t active_pairs_;
     fbl::unique_ptr<io_buffer_t[]> bufs_;
-    size_t unkicked_ TA_GUARDED(tx_lock_);
+    size_t num_bufs_;
+
+    // The control virtqueue, and the buffer holding its one command in
+    // flight, present when there is more than one pair.
+    Ring ctrl_;
+    io_buffer_t ctrl_buf_;
 
     // Saved net device configuration out of the pci config BAR
     virtio_net_config_t config_ TA_GUARDED(state_lock_);
     size_t virtio_hdr_len_;
+    // Whether VIRTIO_NET_F_CSUM and VIRTIO_NET_F_GUEST_CSUM were negotiated,
+    // so that the device computes L4 checksums on tx, and validates them on rx.
+    bool tx_csum_ = false;
+    bool rx_csum_ = false;
+    // Whether VIRTIO_NET_F_MRG_RXBUF was negotiated; see RxBuffer.
+    bool mrg_rxbuf_ = false;
 
     // Ethmac callback interface; see ddk/protocol/ethernet.h
     ethmac_ifc_t* ifc_ TA_GUARDED(state_lock_);
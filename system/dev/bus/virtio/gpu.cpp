@@ -499,14 +499,25 @@ zx_status_t GpuDevice::Init() {
     // Ack and set the driver status bit
     DriverStatusAck();
 
-    // XXX check features bits and ack/nak them
+    // Event indices let the device skip interrupts, and the driver kicks,
+    // while the other side is still busy with the ring.
+    bool event_idx = DeviceFeatureSupported(VIRTIO_F_RING_EVENT_IDX);
+    if (event_idx) {
+        DriverFeatureAck(VIRTIO_F_RING_EVENT_IDX);
+    }
+    zx_status_t status = DeviceStatusFeaturesOk();
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "%s: Feature negotiation failed (%d)\n", tag(), status);
+        return status;
+    }
 
     // Allocate the main vring
-    zx_status_t status = vring_.Init(0, 16);
+    status = vring_.Init(0, 16);
     if (status != ZX_OK) {
         zxlogf(ERROR, "%s: failed to allocate vring\n", tag());
         return status;
     }
+    vring_.SetEventIdx(event_idx);
 
     // Allocate a GPU request
     status = io_buffer_init(&gpu_req_, bti_.get(), PAGE_SIZE, IO_BUFFER_RW | IO_BUFFER_CONTIG);
@@ -33,9 +33,11 @@ Ring::Ring(Device* device)
     : device_(device) {
 
     memset(&ring_buf_, 0, sizeof(ring_buf_));
+    memset(&indirect_buf_, 0, sizeof(indirect_buf_));
 }
 
 Ring::~Ring() {
+    io_buffer_release(&indirect_buf_);
     io_buffer_release(&ring_buf_);
 }
 
@@ -70,6 +72,7 @@ zx_status_t Ring::Init(uint16_t index, uint16_t count) {
     vring_init(&ring_, count, io_buffer_virt(&ring_buf_), PAGE_SIZE);
     ring_.free_list = 0xffff;
     ring_.free_count = 0;
+    kicked_idx_ = 0;
 
     /* add all the descriptors to the free list */
     for (uint16_t i = 0; i < count; i++) {
@@ -85,8 +88,56 @@ zx_status_t Ring::Init(uint16_t index, uint16_t count) {
     return ZX_OK;
 }
 
+zx_status_t Ring::InitIndirect(uint16_t table_count, uint16_t table_size) {
+    LTRACEF("%u tables of %u descriptors\n", table_count, table_size);
+
+    size_t size = sizeof(struct vring_desc) * table_count * table_size;
+    zx_status_t status = io_buffer_init(&indirect_buf_, device_->bti().get(), size,
+                                        IO_BUFFER_RW | IO_BUFFER_CONTIG);
+    if (status != ZX_OK) {
+        return status;
+    }
+    indirect_count_ = table_count;
+    indirect_size_ = table_size;
+    return ZX_OK;
+}
+
+struct vring_desc* Ring::AllocIndirectChain(uint16_t table, uint16_t count,
+                                            uint16_t* start_index) {
+    assert(table < indirect_count_);
+    if (count == 0 || count > indirect_size_) {
+        return NULL;
+    }
+
+    uint16_t i;
+    struct vring_desc* head = AllocDescChain(1, &i);
+    if (!head) {
+        return NULL;
+    }
+
+    size_t offset = sizeof(struct vring_desc) * table * indirect_size_;
+    struct vring_desc* descs = reinterpret_cast<struct vring_desc*>(
+        static_cast<uint8_t*>(io_buffer_virt(&indirect_buf_)) + offset);
+    for (uint16_t n = 0; n < count; n++) {
+        descs[n].flags = VRING_DESC_F_NEXT;
+        descs[n].next = static_cast<uint16_t>(n + 1);
+    }
+    descs[count - 1].flags = 0;
+    descs[count - 1].next = 0;
+
+    head->addr = io_buffer_phys(&indirect_buf_) + offset;
+    head->len = static_cast<uint32_t>(sizeof(struct vring_desc) * count);
+    head->flags = VRING_DESC_F_INDIRECT;
+
+    if (start_index)
+        *start_index = i;
+
+    return descs;
+}
+
 void Ring::FreeDesc(uint16_t desc_index) {
     LTRACEF("index %u free_count %u\n", desc_index, ring_.free_count);
+    ring_.desc[desc_index].flags &= static_cast<uint16_t>(~VRING_DESC_F_INDIRECT);
     ring_.desc[desc_index].next = ring_.free_list;
     ring_.free_list = desc_index;
     ring_.free_count++;
@@ -134,13 +185,38 @@ void Ring::SubmitChain(uint16_t desc_index) {
     struct vring_avail* avail = ring_.avail;
 
     avail->ring[avail->idx & ring_.num_mask] = desc_index;
-    //mb();
+    // The device must see the entry before the index which covers it.
+    hw_wmb();
     avail->idx++;
 }
 
+void Ring::SubmitChains(const uint16_t* desc_indices, size_t count) {
+    LTRACEF("%zu chains\n", count);
+
+    struct vring_avail* avail = ring_.avail;
+    uint16_t idx = avail->idx;
+    for (size_t i = 0; i < count; i++) {
+        avail->ring[idx++ & ring_.num_mask] = desc_indices[i];
+    }
+    hw_wmb();
+    avail->idx = idx;
+}
+
 void Ring::Kick() {
     LTRACE_ENTRY;
 
+    if (event_idx_) {
+        // The avail index must be visible before the device's event index is
+        // read, or the device may go to sleep without seeing the new chains.
+        hw_mb();
+        uint16_t new_idx = ring_.avail->idx;
+        uint16_t old_idx = kicked_idx_;
+        kicked_idx_ = new_idx;
+        uint16_t event = *reinterpret_cast<volatile uint16_t*>(&vring_avail_event(&ring_));
+        if (!vring_need_event(event, new_idx, old_idx)) {
+            return;
+        }
+    }
     device_->RingKick(index_);
 }
 
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <ddk/io-buffer.h>
+#include <hw/arch_ops.h>
 #include <virtio/virtio_ring.h>
 #include <zircon/types.h>
 
@@ -20,9 +21,33 @@ public:
 
     zx_status_t Init(uint16_t index, uint16_t count);
 
+    // Suppresses notifications with the avail and used event indices, once
+    // VIRTIO_RING_F_EVENT_IDX has been negotiated; see section 2.4.7 of the
+    // spec. Kick then only notifies the device if it has asked to be told of
+    // the chains submitted since the last one, and IrqRingUpdate asks the
+    // device to interrupt again only once it has used another chain.
+    void SetEventIdx(bool event_idx) { event_idx_ = event_idx; }
+
+    // Sets up |table_count| tables of |table_size| descriptors each, once
+    // VIRTIO_F_RING_INDIRECT_DESC has been negotiated; see section 2.4.5.3 of
+    // the spec. A chain built in a table takes up a single descriptor of the
+    // ring, however long it is.
+    zx_status_t InitIndirect(uint16_t table_count, uint16_t table_size);
+    bool HasIndirect() const { return indirect_size_ != 0; }
+
     void FreeDesc(uint16_t desc_index);
     struct vring_desc* AllocDescChain(uint16_t count, uint16_t* start_index);
+    // Allocates a descriptor of the ring which refers to indirect table
+    // |table|, and returns the first of |count| descriptors chained together
+    // in the table, each of which follows the one before it in memory. The
+    // ring descriptor's index, which is submitted and used like that of any
+    // other chain, is returned in |start_index|.
+    struct vring_desc* AllocIndirectChain(uint16_t table, uint16_t count,
+                                          uint16_t* start_index);
     void SubmitChain(uint16_t desc_index);
+    // Makes the |count| chains starting at |desc_indices| available with a
+    // single update of the avail index.
+    void SubmitChains(const uint16_t* desc_indices, size_t count);
     void Kick();
 
     struct vring_desc* DescFromIndex(uint16_t index) {
@@ -36,10 +61,17 @@ private:
     Device* device_ = nullptr;
 
     io_buffer_t ring_buf_;
+    io_buffer_t indirect_buf_;
+    uint16_t indirect_count_ = 0;
+    uint16_t indirect_size_ = 0;
 
     uint16_t index_ = 0;
 
     vring ring_ = {};
+
+    bool event_idx_ = false;
+    // The avail index as of the last Kick.
+    uint16_t kicked_idx_ = 0;
 };
 
 // perform the main loop of finding free descriptor chains and passing it to a passed in function
@@ -49,18 +81,33 @@ inline void Ring::IrqRingUpdate(T free_chain) {
     //         ring_.used->flags, ring_.used->idx, ring_.last_used);
 
     // find a new free chain of descriptors
-    uint16_t cur_idx = ring_.used->idx;
     uint16_t i = ring_.last_used;
-    for (; i != cur_idx; ++i) {
-        // TRACEF("looking at idx %u\n", i);
-
-        struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
-        // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
-
-        // free the chain
-        free_chain(used_elem);
+    for (;;) {
+        uint16_t cur_idx = *reinterpret_cast<volatile uint16_t*>(&ring_.used->idx);
+        // The used elements must not be read before the index covering them.
+        hw_rmb();
+        for (; i != cur_idx; ++i) {
+            // TRACEF("looking at idx %u\n", i);
+
+            struct vring_used_elem* used_elem = &ring_.used->ring[i & ring_.num_mask];
+            // TRACEF("used chain id %u, len %u\n", used_elem->id, used_elem->len);
+
+            // free the chain
+            free_chain(used_elem);
+        }
+        ring_.last_used = i;
+        if (!event_idx_) {
+            break;
+        }
+
+        // Ask for an interrupt once the next chain is used, then look again in
+        // case the device used one before it could see the request.
+        *reinterpret_cast<volatile uint16_t*>(&vring_used_event(&ring_)) = i;
+        hw_mb();
+        if (*reinterpret_cast<volatile uint16_t*>(&ring_.used->idx) == i) {
+            break;
+        }
     }
-    ring_.last_used = i;
 }
 
 void virtio_dump_desc(const struct vring_desc* desc);
@@ -1356,7 +1356,16 @@ void Client::OnFenceFired(FenceReference* fence) {
             waiting->self->OnFenceReady(fence);
         }
     }
-    ApplyConfig();
+    if (!fences_fired_task_.is_pending()) {
+        fences_fired_task_.Post(controller_->loop().dispatcher());
+    }
+}
+
+void Client::HandleFencesFired(async_dispatcher_t* dispatcher, async::TaskBase* self,
+                               zx_status_t status) {
+    if (status == ZX_OK) {
+        ApplyConfig();
+    }
 }
 
 void Client::OnRefForFenceDead(Fence* fence) {
@@ -1382,6 +1391,7 @@ void Client::TearDown() {
         api_wait_.set_object(ZX_HANDLE_INVALID);
     }
     server_handle_ = ZX_HANDLE_INVALID;
+    fences_fired_task_.Cancel();
 
     CleanUpImage(nullptr);
 
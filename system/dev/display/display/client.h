@@ -237,6 +237,12 @@ private:
     bool CheckConfig(fidl::Builder* resp_builder);
 
     fbl::RefPtr<FenceReference> GetFence(uint64_t id);
+
+    // Fences which fire close together, e.g. those of several layers rendered
+    // for the same frame, are applied to the display with a single config.
+    void HandleFencesFired(async_dispatcher_t* dispatcher, async::TaskBase* self,
+                           zx_status_t status);
+    async::TaskMethod<Client, &Client::HandleFencesFired> fences_fired_task_{this};
 };
 
 // ClientProxy manages interactions between its Client instance and the ddk and the
@@ -14,7 +14,9 @@
 #include <zircon/listnode.h>
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/profile.h>
 #include <zircon/thread_annotations.h>
+#include <zircon/threads.h>
 #include <zircon/types.h>
 
 #include <limits.h>
@@ -31,6 +33,10 @@
 // This is used for signaling that eth_tx_thread() should exit.
 static const zx_signals_t kSignalFifoTerminate = ZX_USER_SIGNAL_0;
 
+// This is raised on a tx fifo while completed transmits wait for
+// eth_tx_thread() to write them back to it.
+static const zx_signals_t kSignalTxDone = ZX_USER_SIGNAL_1;
+
 // ensure that we will not exceed fifo capacity
 static_assert((FIFO_DEPTH * FIFO_ESIZE) <= 4096, "");
 
@@ -53,17 +59,23 @@ typedef struct ethdev0 {
     ethmac_info_t info;
     uint32_t status;
     zx_device_t* zxdev;
+
+    // The cpus which the traffic of each queue is steered to, and profiles
+    // binding the threads which send on them there.
+    uint32_t queue_cpu_mask[ETHMAC_MAX_QUEUES];
+    zx_handle_t queue_profile[ETHMAC_MAX_QUEUES];
 } ethdev0_t;
 
 typedef struct tx_info {
-    struct ethdev* edev;
+    struct eth_queue* queue;
     uint64_t fifo_cookie;
+    // the bytes of the fifo entry's data before netbuf.data
+    uint16_t header_len;
+    // set if netbuf is a segment in the queue's gso buffer
+    bool gso;
     ethmac_netbuf_t netbuf;
 } tx_info_t;
 
-// transmit thread has been created
-#define ETHDEV_TX_THREAD (1u)
-
 // connected to the ethmac and handling traffic
 #define ETHDEV_RUNNING (2u)
 
@@ -88,20 +100,45 @@ typedef struct tx_info {
 // Number of empty fifo entries to read at a time
 #define FIFO_BATCH_SZ 32
 
+// Number of tx fifo entries to read at a time
+#define TX_BATCH_SZ (FIFO_DEPTH / 2)
+
+// Completed transmits waiting to be written back: those the device still
+// owns, and a batch completed as it was read.
+#define TX_DONE_MAX (FIFO_DEPTH + TX_BATCH_SZ)
+
 // How many multicast addresses to remember before punting and turning on multicast-promiscuous
 // TODO(eventually): enable deleting addresses
 // If this value is changed, change the EthernetMulticastPromiscOnOverflow() test in
 //   zircon/system/utest/ethernet/ethernet.cpp
 #define MULTICAST_LIST_LIMIT (32)
 
-// ethernet instance device
-typedef struct ethdev {
-    list_node_t node;
+// Devices without ETHMAC_FEATURE_TSO are sent TSO packets as segments built
+// in a buffer of their queue, of GSO_MAX_SEGS slots of GSO_SEG_SIZE bytes.
+#define GSO_MAX_SEGS 64
+#define GSO_SEG_SIZE 2048
+#define GSO_BUF_SIZE (GSO_MAX_SEGS * GSO_SEG_SIZE)
 
-    ethdev0_t* edev0;
+static_assert(GSO_SEG_SIZE >= ETH_FRAME_MAX_SIZE && (PAGE_SIZE % GSO_SEG_SIZE) == 0, "");
 
-    uint32_t state;
-    char name[zircon_ethernet_MAX_CLIENT_NAME_LEN+1];
+// the gso buffer of a queue, mapped the first time it is needed
+typedef struct eth_gso {
+    zx_handle_t vmo;
+    uint8_t* buf;
+    zx_handle_t pmt;
+    zx_paddr_t paddr_map[GSO_BUF_SIZE / PAGE_SIZE];
+    tx_info_t segs[GSO_MAX_SEGS];
+
+    // The segments which the device has yet to return, guarded by the
+    // queue's lock. The buffer is only reused once they are all back.
+    uint32_t pending;
+    cnd_t idle;
+} eth_gso_t;
+
+// the fifos of one rx/tx queue pair of an ethernet instance
+typedef struct eth_queue {
+    struct ethdev* edev;
+    uint16_t index;
 
     // fifos are named from the perspective
     // of the packet from from the client
@@ -113,6 +150,35 @@ typedef struct ethdev {
     zircon_ethernet_FifoEntry rx_entries[FIFO_BATCH_SZ];
     size_t rx_entry_count;
 
+    tx_info_t all_tx_bufs[FIFO_DEPTH];
+    mtx_t lock;               // Protects free_tx_bufs, tx_done and gso.pending
+    list_node_t free_tx_bufs; // tx_info_t elements
+
+    // The entries of completed transmits, which the tx thread writes back to
+    // the tx fifo all at once. kSignalTxDone is raised on the fifo while
+    // there are any.
+    zircon_ethernet_FifoEntry tx_done[TX_DONE_MAX];
+    size_t tx_done_count;
+
+    eth_gso_t gso;
+
+    // fifo thread, if tx_thread is set
+    thrd_t tx_thr;
+    bool tx_thread;
+
+    uint32_t fail_rx_read;
+    uint32_t fail_rx_write;
+} eth_queue_t;
+
+// ethernet instance device
+typedef struct ethdev {
+    list_node_t node;
+
+    ethdev0_t* edev0;
+
+    uint32_t state;
+    char name[zircon_ethernet_MAX_CLIENT_NAME_LEN+1];
+
     // io buffer
     zx_handle_t io_vmo;
     void* io_buf;
@@ -120,21 +186,15 @@ typedef struct ethdev {
     zx_paddr_t* paddr_map;
     zx_handle_t pmt;
 
-    tx_info_t all_tx_bufs[FIFO_DEPTH];
-    mtx_t lock;               // Protects free_tx_bufs
-    list_node_t free_tx_bufs; // tx_info_t elements
-
-    // fifo thread
-    thrd_t tx_thr;
-
     zx_device_t* zxdev;
 
     uint8_t multicast[MULTICAST_LIST_LIMIT][ETH_MAC_SIZE];
     uint32_t n_multicast;
 
-    uint32_t fail_rx_read;
-    uint32_t fail_rx_write;
-    uint32_t fail_tx_write;
+    // one for each queue of the device; queue 0's fifos are the ones
+    // handed out by GetFifos
+    uint32_t queue_count;
+    eth_queue_t queues[];
 } ethdev_t;
 
 #define FAIL_REPORT_RATE 50
@@ -255,18 +315,262 @@ static ssize_t eth_test_clear_multicast_promisc_locked(ethdev_t* edev) {
     return status;
 }
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
+static zx_status_t eth_set_rss_locked(ethdev_t* edev, const zircon_ethernet_RssConfig* config) {
+    static_assert(zircon_ethernet_RSS_HASH_IPV4 == ETHMAC_RSS_HASH_IPV4, "");
+    static_assert(zircon_ethernet_RSS_HASH_TCP_IPV4 == ETHMAC_RSS_HASH_TCP_IPV4, "");
+    static_assert(zircon_ethernet_RSS_HASH_UDP_IPV4 == ETHMAC_RSS_HASH_UDP_IPV4, "");
+    static_assert(zircon_ethernet_RSS_HASH_IPV6 == ETHMAC_RSS_HASH_IPV6, "");
+    static_assert(zircon_ethernet_RSS_HASH_TCP_IPV6 == ETHMAC_RSS_HASH_TCP_IPV6, "");
+    static_assert(zircon_ethernet_RSS_HASH_UDP_IPV6 == ETHMAC_RSS_HASH_UDP_IPV6, "");
+    static_assert(sizeof(config->key) == ETHMAC_RSS_KEY_SIZE, "");
+    static_assert(sizeof(config->table) == ETHMAC_RSS_TABLE_SIZE, "");
+
+    ethdev0_t* edev0 = edev->edev0;
+    for (size_t i = 0; i < ETHMAC_RSS_TABLE_SIZE; i++) {
+        if (config->table[i] >= edev0->info.queue_count) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+    ethmac_rss_config_t rss = {.hash_types = config->hash_types};
+    memcpy(rss.key, config->key, sizeof(rss.key));
+    memcpy(rss.table, config->table, sizeof(rss.table));
+    return edev0->mac.ops->set_param(edev0->mac.ctx, ETHMAC_SETPARAM_RSS, 0, &rss);
+}
+
+#define IP_PROTO_TCP 6
+#define IP_PROTO_UDP 17
+#define IPV4_CSUM_OFFSET 10
+#define IPV6_HDR_LEN 40
+#define TCP_CSUM_OFFSET 16
+#define TCP_MIN_HDR_LEN 20
+#define UDP_CSUM_OFFSET 6
+#define UDP_HDR_LEN 8
+
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_PSH 0x08
+#define TCP_FLAG_CWR 0x80
+
+static uint16_t eth_get16(const uint8_t* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void eth_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint32_t eth_get32(const uint8_t* p) {
+    return ((uint32_t)eth_get16(p) << 16) | eth_get16(p + 2);
+}
+
+static void eth_put32(uint8_t* p, uint32_t v) {
+    eth_put16(p, (uint16_t)(v >> 16));
+    eth_put16(p + 2, (uint16_t)v);
+}
+
+// Adds |len| bytes to a ones' complement sum; see RFC 1071.
+static uint32_t eth_csum_add(uint32_t sum, const uint8_t* data, size_t len) {
+    for (; len > 1; data += 2, len -= 2) {
+        sum += eth_get16(data);
+    }
+    if (len) {
+        sum += (uint32_t)data[0] << 8;
+    }
+    return sum;
+}
+
+static uint16_t eth_csum_fold(uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)sum;
+}
+
+static bool eth_offload_ipv4(const uint8_t* frame, const ethmac_tx_offload_t* offload) {
+    return (frame[offload->l3_offset] >> 4) == 4;
+}
+
+// The length of the TCP or UDP segment in |frame|, by its IP header.
+static size_t eth_offload_l4_len(const uint8_t* frame, const ethmac_tx_offload_t* offload) {
+    const uint8_t* ip = frame + offload->l3_offset;
+    size_t end = offload->l3_offset;
+    end += eth_offload_ipv4(frame, offload) ? eth_get16(ip + 2)
+                                            : IPV6_HDR_LEN + eth_get16(ip + 4);
+    return end - offload->l4_offset;
+}
+
+// The sum of the pseudo-header of the TCP or UDP segment of |l4_len| bytes
+// in |frame|.
+static uint32_t eth_pseudo_csum(const uint8_t* frame, const ethmac_tx_offload_t* offload,
+                                size_t l4_len) {
+    const uint8_t* ip = frame + offload->l3_offset;
+    uint32_t sum = (offload->flags & ETHMAC_TX_OFFLOAD_UDP_CSUM) ? IP_PROTO_UDP : IP_PROTO_TCP;
+    sum += (uint32_t)l4_len;
+    if (eth_offload_ipv4(frame, offload)) {
+        return eth_csum_add(sum, ip + 12, 8);
+    }
+    return eth_csum_add(sum, ip + 8, 32);
+}
+
+// Checks that the headers which |offload| asks to work on are within the
+// |len| bytes of |frame|, and adds the flags which its other flags imply.
+static zx_status_t eth_check_offload(const uint8_t* frame, size_t len,
+                                     ethmac_tx_offload_t* offload) {
+    const uint16_t kAll = ETHMAC_TX_OFFLOAD_IPV4_CSUM | ETHMAC_TX_OFFLOAD_TCP_CSUM |
+                          ETHMAC_TX_OFFLOAD_UDP_CSUM | ETHMAC_TX_OFFLOAD_TSO;
+    if (offload->flags & ~kAll) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (offload->flags & ETHMAC_TX_OFFLOAD_TSO) {
+        offload->flags |= ETHMAC_TX_OFFLOAD_TCP_CSUM;
+    }
+    if (offload->flags == 0) {
+        return ZX_OK;
+    }
+    if ((offload->flags & ETHMAC_TX_OFFLOAD_TCP_CSUM) &&
+        (offload->flags & ETHMAC_TX_OFFLOAD_UDP_CSUM)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // The IP header.
+    if (offload->l3_offset >= len) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    size_t l3_len;
+    bool ipv4 = eth_offload_ipv4(frame, offload);
+    if (ipv4) {
+        l3_len = (frame[offload->l3_offset] & 0xf) * 4u;
+        if (l3_len < 20) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        // Each segment needs its header checksum.
+        if (offload->flags & ETHMAC_TX_OFFLOAD_TSO) {
+            offload->flags |= ETHMAC_TX_OFFLOAD_IPV4_CSUM;
+        }
+    } else if ((frame[offload->l3_offset] >> 4) == 6 &&
+               !(offload->flags & ETHMAC_TX_OFFLOAD_IPV4_CSUM)) {
+        l3_len = IPV6_HDR_LEN;
+    } else {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (offload->l3_offset + l3_len > len) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (!(offload->flags & (ETHMAC_TX_OFFLOAD_TCP_CSUM | ETHMAC_TX_OFFLOAD_UDP_CSUM))) {
+        return ZX_OK;
+    }
+
+    // The TCP or UDP header.
+    size_t l4_len = UDP_HDR_LEN;
+    if (offload->l4_offset < offload->l3_offset + l3_len) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (offload->flags & ETHMAC_TX_OFFLOAD_TCP_CSUM) {
+        if (offload->l4_offset + TCP_MIN_HDR_LEN > len) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        l4_len = (frame[offload->l4_offset + 12] >> 4) * 4u;
+        if (l4_len < TCP_MIN_HDR_LEN) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+    }
+    if (offload->l4_offset + l4_len > len) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // The lengths in the headers of a TSO packet are rewritten for each
+    // segment, but those of any other packet must fit in it.
+    if (offload->flags & ETHMAC_TX_OFFLOAD_TSO) {
+        return offload->mss > 0 ? ZX_OK : ZX_ERR_INVALID_ARGS;
+    }
+    size_t ip_end = offload->l3_offset +
+                    (ipv4 ? eth_get16(frame + offload->l3_offset + 2)
+                          : IPV6_HDR_LEN + eth_get16(frame + offload->l3_offset + 4));
+    if (ip_end > len || ip_end < offload->l4_offset + l4_len) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    return ZX_OK;
+}
+
+// Fills in the checksums which |offload| asks for and which a device with
+// |features| can't, and clears their flags. The TCP or UDP checksum field is
+// seeded with the sum of the pseudo-header, for the device to finish.
+static void eth_fill_csums(uint32_t features, uint8_t* frame, size_t len,
+                           ethmac_tx_offload_t* offload) {
+    uint8_t* ip = frame + offload->l3_offset;
+    uint8_t* l4 = frame + offload->l4_offset;
+    if (offload->flags & ETHMAC_TX_OFFLOAD_TSO) {
+        // The device fills in every checksum of the segments, whose pseudo-
+        // headers all differ by their lengths.
+        eth_put16(l4 + TCP_CSUM_OFFSET, eth_csum_fold(eth_pseudo_csum(frame, offload, 0)));
+        return;
+    }
+
+    if ((offload->flags & ETHMAC_TX_OFFLOAD_IPV4_CSUM) &&
+        !(features & ETHMAC_FEATURE_TX_CSUM_IPV4)) {
+        eth_put16(ip + IPV4_CSUM_OFFSET, 0);
+        uint32_t sum = eth_csum_add(0, ip, (ip[0] & 0xf) * 4u);
+        eth_put16(ip + IPV4_CSUM_OFFSET, (uint16_t)~eth_csum_fold(sum));
+        offload->flags &= ~ETHMAC_TX_OFFLOAD_IPV4_CSUM;
+    }
+
+    const uint16_t kL4 = ETHMAC_TX_OFFLOAD_TCP_CSUM | ETHMAC_TX_OFFLOAD_UDP_CSUM;
+    if (offload->flags & kL4) {
+        const bool udp = offload->flags & ETHMAC_TX_OFFLOAD_UDP_CSUM;
+        uint8_t* csum = l4 + (udp ? UDP_CSUM_OFFSET : TCP_CSUM_OFFSET);
+        size_t l4_len = eth_offload_l4_len(frame, offload);
+        eth_put16(csum, eth_csum_fold(eth_pseudo_csum(frame, offload, l4_len)));
+        if (!(features & ETHMAC_FEATURE_TX_CSUM_L4)) {
+            uint16_t sum = (uint16_t)~eth_csum_fold(eth_csum_add(0, l4, l4_len));
+            // A UDP checksum of 0 means there is none.
+            eth_put16(csum, (udp && sum == 0) ? 0xffff : sum);
+            offload->flags &= ~kL4;
+        }
+    }
+}
+
+// Reads the TxOffload which the data of |e| starts with, if it has one, and
+// points |frame| and |len| at the frame after it.
+static zx_status_t eth_get_offload(ethdev_t* edev, const zircon_ethernet_FifoEntry* e,
+                                   uint8_t** frame, size_t* len, ethmac_tx_offload_t* offload) {
+    static_assert(zircon_ethernet_TX_OFFLOAD_IPV4_CSUM == ETHMAC_TX_OFFLOAD_IPV4_CSUM, "");
+    static_assert(zircon_ethernet_TX_OFFLOAD_TCP_CSUM == ETHMAC_TX_OFFLOAD_TCP_CSUM, "");
+    static_assert(zircon_ethernet_TX_OFFLOAD_UDP_CSUM == ETHMAC_TX_OFFLOAD_UDP_CSUM, "");
+    static_assert(zircon_ethernet_TX_OFFLOAD_TSO == ETHMAC_TX_OFFLOAD_TSO, "");
+
+    *frame = edev->io_buf + e->offset;
+    *len = e->length;
+    memset(offload, 0, sizeof(*offload));
+    if (!(e->flags & zircon_ethernet_FIFO_TX_OFFLOAD)) {
+        return ZX_OK;
+    }
+    zircon_ethernet_TxOffload header;
+    if (*len < sizeof(header)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    memcpy(&header, *frame, sizeof(header));
+    *frame += sizeof(header);
+    *len -= sizeof(header);
+    offload->flags = header.flags;
+    offload->l3_offset = header.l3_offset;
+    offload->l4_offset = header.l4_offset;
+    offload->mss = header.mss;
+    return eth_check_offload(*frame, *len, offload);
+}
+
+static void eth_handle_rx(eth_queue_t* queue, const void* data, size_t len, uint32_t extra) {
+    ethdev_t* edev = queue->edev;
     zx_status_t status;
     size_t count;
 
-    if (edev->rx_entry_count == 0) {
-        status = zx_fifo_read(edev->rx_fifo, sizeof(edev->rx_entries[0]), edev->rx_entries,
-                              countof(edev->rx_entries), &count);
+    if (queue->rx_entry_count == 0) {
+        status = zx_fifo_read(queue->rx_fifo, sizeof(queue->rx_entries[0]), queue->rx_entries,
+                              countof(queue->rx_entries), &count);
         if (status != ZX_OK) {
             if (status == ZX_ERR_SHOULD_WAIT) {
-                if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
+                if ((queue->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
                     zxlogf(ERROR, "eth [%s]: no rx buffers available (%u times)\n",
-                           edev->name, edev->fail_rx_read);
+                           edev->name, queue->fail_rx_read);
                 }
             } else {
                 // Fatal, should force teardown
@@ -274,10 +578,10 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
             }
             return;
         }
-        edev->rx_entry_count = count;
+        queue->rx_entry_count = count;
     }
 
-    zircon_ethernet_FifoEntry* e = &edev->rx_entries[--edev->rx_entry_count];
+    zircon_ethernet_FifoEntry* e = &queue->rx_entries[--queue->rx_entry_count];
     if ((e->offset >= edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
         // invalid offset/length. report error. drop packet
         e->length = 0;
@@ -292,11 +596,11 @@ static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t
         e->flags = zircon_ethernet_FIFO_RX_OK | extra;
     }
 
-    if ((status = zx_fifo_write(edev->rx_fifo, sizeof(*e), e, 1, NULL)) < 0) {
+    if ((status = zx_fifo_write(queue->rx_fifo, sizeof(*e), e, 1, NULL)) < 0) {
         if (status == ZX_ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
+            if ((queue->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
                 zxlogf(ERROR, "eth [%s]: no rx_fifo space available (%u times)\n",
-                       edev->name, edev->fail_rx_write);
+                       edev->name, queue->fail_rx_write);
             }
         } else {
             // Fatal, should force teardown
@@ -318,22 +622,24 @@ static void eth0_status(void* cookie, uint32_t status) {
     static_assert(zircon_ethernet_SIGNAL_STATUS == ZX_USER_SIGNAL_0, "");
     ethdev_t* edev;
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        zx_object_signal_peer(edev->rx_fifo, 0, zircon_ethernet_SIGNAL_STATUS);
+        zx_object_signal_peer(edev->queues[0].rx_fifo, 0, zircon_ethernet_SIGNAL_STATUS);
     }
     mtx_unlock(&edev0->lock);
 }
 
-static int tx_fifo_write(ethdev_t* edev, zircon_ethernet_FifoEntry* entries, size_t count) {
+static int tx_fifo_write(eth_queue_t* queue, zircon_ethernet_FifoEntry* entries, size_t count) {
     zx_status_t status;
     size_t actual;
     // Writing should never fail, or fail to write all entries
-    status = zx_fifo_write(edev->tx_fifo, sizeof(zircon_ethernet_FifoEntry), entries, count, &actual);
+    status = zx_fifo_write(queue->tx_fifo, sizeof(zircon_ethernet_FifoEntry), entries, count,
+                           &actual);
     if (status < 0) {
-        zxlogf(ERROR, "eth [%s]: tx_fifo write failed %d\n", edev->name, status);
+        zxlogf(ERROR, "eth [%s]: tx_fifo write failed %d\n", queue->edev->name, status);
         return -1;
     }
     if (actual != count) {
-        zxlogf(ERROR, "eth [%s]: tx_fifo: only wrote %zu of %zu!\n", edev->name, actual, count);
+        zxlogf(ERROR, "eth [%s]: tx_fifo: only wrote %zu of %zu!\n", queue->edev->name, actual,
+               count);
         return -1;
     }
     return 0;
@@ -341,55 +647,106 @@ static int tx_fifo_write(ethdev_t* edev, zircon_ethernet_FifoEntry* entries, siz
 
 // TODO: I think if this arrives at the wrong time during teardown we
 // can deadlock with the ethermac device
-static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
+static void eth0_recv_queue(void* cookie, uint32_t queue, void* data, size_t len,
+                            uint32_t flags) {
     ethdev0_t* edev0 = cookie;
 
+    uint32_t extra = 0;
+    if (flags & ETHMAC_RX_CSUM_IPV4_OK) {
+        extra |= zircon_ethernet_FIFO_RX_CSUM_IPV4_OK;
+    }
+    if (flags & ETHMAC_RX_CSUM_L4_OK) {
+        extra |= zircon_ethernet_FIFO_RX_CSUM_L4_OK;
+    }
+
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
-        eth_handle_rx(edev, data, len, 0);
+        // Clients which don't service this queue get its packets on queue 0.
+        if (queue < edev->queue_count && edev->queues[queue].rx_fifo != ZX_HANDLE_INVALID) {
+            eth_handle_rx(&edev->queues[queue], data, len, extra);
+        } else {
+            eth_handle_rx(&edev->queues[0], data, len, extra);
+        }
     }
     mtx_unlock(&edev0->lock);
 }
 
+static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
+    eth0_recv_queue(cookie, 0, data, len, flags);
+}
+
 // Borrows a TX buffer from the pool. Logs and returns NULL if none is available
-static tx_info_t* eth_get_tx_info(ethdev_t* edev) {
-    mtx_lock(&edev->lock);
-    tx_info_t* tx_info = list_remove_head_type(&edev->free_tx_bufs, tx_info_t, netbuf.node);
-    mtx_unlock(&edev->lock);
+static tx_info_t* eth_get_tx_info(eth_queue_t* queue) {
+    mtx_lock(&queue->lock);
+    tx_info_t* tx_info = list_remove_head_type(&queue->free_tx_bufs, tx_info_t, netbuf.node);
+    mtx_unlock(&queue->lock);
     if (tx_info == NULL) {
-        zxlogf(ERROR, "eth [%s]: tx_info pool empty\n", edev->name);
+        zxlogf(ERROR, "eth [%s]: tx_info pool empty\n", queue->edev->name);
     }
     return tx_info;
 }
 
-// Returns a TX buffer to the pool
-static void eth_put_tx_info(ethdev_t* edev, tx_info_t* tx_info) {
-    mtx_lock(&edev->lock);
-    list_add_head(&edev->free_tx_bufs, &tx_info->netbuf.node);
-    mtx_unlock(&edev->lock);
+// Returns a segment of the gso buffer, which is reusable once it has them all
+static void eth_put_gso_seg(eth_queue_t* queue) {
+    mtx_lock(&queue->lock);
+    if (--queue->gso.pending == 0) {
+        cnd_signal(&queue->gso.idle);
+    }
+    mtx_unlock(&queue->lock);
+}
+
+// Queues completed entries to be written back by the tx thread
+static void eth_tx_done_locked(eth_queue_t* queue, const zircon_ethernet_FifoEntry* entries,
+                               size_t count) {
+    ZX_DEBUG_ASSERT(queue->tx_done_count + count <= TX_DONE_MAX);
+    memcpy(queue->tx_done + queue->tx_done_count, entries, count * sizeof(entries[0]));
+    queue->tx_done_count += count;
+}
+
+// Writes the completed entries back to the client in one batch
+static void eth_flush_tx_done(eth_queue_t* queue) {
+    mtx_lock(&queue->lock);
+    if (queue->tx_done_count > 0) {
+        zx_object_signal(queue->tx_fifo, kSignalTxDone, 0);
+        tx_fifo_write(queue, queue->tx_done, queue->tx_done_count);
+        queue->tx_done_count = 0;
+    }
+    mtx_unlock(&queue->lock);
 }
 
 static void eth0_complete_tx(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status) {
     tx_info_t* tx_info = containerof(netbuf, tx_info_t, netbuf);
-    ethdev_t* edev = tx_info->edev;
-    zircon_ethernet_FifoEntry entry = {.offset = netbuf->data - edev->io_buf,
-                              .length = netbuf->len,
+    eth_queue_t* queue = tx_info->queue;
+    ethdev_t* edev = queue->edev;
+    if (tx_info->gso) {
+        // The entry of the packet was returned once it was segmented.
+        eth_put_gso_seg(queue);
+        return;
+    }
+    zircon_ethernet_FifoEntry entry = {.offset = netbuf->data - edev->io_buf -
+                                                 tx_info->header_len,
+                              .length = netbuf->len + tx_info->header_len,
                               .flags = status == ZX_OK ? zircon_ethernet_FIFO_TX_OK : 0,
                               .cookie = tx_info->fifo_cookie};
 
     // Now that we've copied all pertinent data from the netbuf, return it to the free list so
-    // it is avaialble immediately for the next request.
-    eth_put_tx_info(edev, tx_info);
-
-    // Send the entry back to the client
-    tx_fifo_write(edev, &entry, 1);
+    // it is avaialble immediately for the next request, and leave the entry for the tx thread
+    // to send back to the client, along with any others completed before it gets to them.
+    mtx_lock(&queue->lock);
+    list_add_head(&queue->free_tx_bufs, &tx_info->netbuf.node);
+    if (queue->tx_done_count == 0) {
+        zx_object_signal(queue->tx_fifo, 0, kSignalTxDone);
+    }
+    eth_tx_done_locked(queue, &entry, 1);
+    mtx_unlock(&queue->lock);
 }
 
 static ethmac_ifc_t ethmac_ifc = {
     .status = eth0_status,
     .recv = eth0_recv,
     .complete_tx = eth0_complete_tx,
+    .recv_queue = eth0_recv_queue,
 };
 
 static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
@@ -397,7 +754,7 @@ static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, zircon_ethernet_FIFO_RX_TX);
+            eth_handle_rx(&edev->queues[0], data, len, zircon_ethernet_FIFO_RX_TX);
         }
     }
     mtx_unlock(&edev0->lock);
@@ -433,24 +790,177 @@ static zx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     return ZX_OK;
 }
 
+static zx_status_t eth_gso_init(eth_queue_t* queue) {
+    ethdev_t* edev = queue->edev;
+    eth_gso_t* gso = &queue->gso;
+    zx_status_t status;
+    if ((status = zx_vmo_create(GSO_BUF_SIZE, 0, &gso->vmo)) != ZX_OK) {
+        zxlogf(ERROR, "eth [%s]: could not create gso buffer: %d\n", edev->name, status);
+        return status;
+    }
+    uintptr_t addr;
+    if ((status = zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0,
+                              gso->vmo, 0, GSO_BUF_SIZE, &addr)) != ZX_OK) {
+        zxlogf(ERROR, "eth [%s]: could not map gso buffer: %d\n", edev->name, status);
+        goto fail;
+    }
+    if (edev->edev0->info.features & ETHMAC_FEATURE_DMA) {
+        zx_handle_t bti = edev->edev0->mac.ops->get_bti(edev->edev0->mac.ctx);
+        if ((status = zx_bti_pin(bti, ZX_BTI_PERM_READ, gso->vmo, 0, GSO_BUF_SIZE,
+                                 gso->paddr_map, countof(gso->paddr_map), &gso->pmt)) != ZX_OK) {
+            zxlogf(ERROR, "eth [%s]: could not pin gso buffer: %d\n", edev->name, status);
+            zx_vmar_unmap(zx_vmar_root_self(), addr, GSO_BUF_SIZE);
+            goto fail;
+        }
+    }
+    gso->buf = (uint8_t*)addr;
+    return ZX_OK;
+
+fail:
+    zx_handle_close(gso->vmo);
+    gso->vmo = ZX_HANDLE_INVALID;
+    return status;
+}
+
+static void eth_gso_release(eth_queue_t* queue) {
+    eth_gso_t* gso = &queue->gso;
+    if (gso->buf == NULL) {
+        return;
+    }
+    zx_vmar_unmap(zx_vmar_root_self(), (uintptr_t)gso->buf, GSO_BUF_SIZE);
+    gso->buf = NULL;
+    if (gso->pmt != ZX_HANDLE_INVALID) {
+        if (zx_pmt_unpin(gso->pmt) != ZX_OK) {
+            zxlogf(ERROR, "eth [%s]: cannot unpin gso buffer?!\n", queue->edev->name);
+        }
+        gso->pmt = ZX_HANDLE_INVALID;
+    }
+    zx_handle_close(gso->vmo);
+    gso->vmo = ZX_HANDLE_INVALID;
+}
+
+// Sends the TSO packet |frame| as segments of at most |offload->mss| payload
+// bytes, built in the queue's gso buffer, for a device which can't segment it
+// itself. The client's buffer is free again on return.
+static zx_status_t eth_send_gso(eth_queue_t* queue, uint32_t opts, const uint8_t* frame,
+                                size_t len, const ethmac_tx_offload_t* offload) {
+    ethdev_t* edev = queue->edev;
+    ethdev0_t* edev0 = edev->edev0;
+    eth_gso_t* gso = &queue->gso;
+
+    const uint8_t* tcp = frame + offload->l4_offset;
+    const size_t hdr_len = offload->l4_offset + (tcp[12] >> 4) * 4u;
+    const size_t payload = len - hdr_len;
+    const size_t mss = offload->mss;
+    const size_t segs = payload == 0 ? 1 : (payload + mss - 1) / mss;
+    if (segs > GSO_MAX_SEGS || hdr_len + (payload < mss ? payload : mss) > GSO_SEG_SIZE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status;
+    if (gso->buf == NULL && (status = eth_gso_init(queue)) != ZX_OK) {
+        return status;
+    }
+
+    // Wait for the device to be done with the segments of the last packet.
+    mtx_lock(&queue->lock);
+    while (gso->pending > 0) {
+        cnd_wait(&gso->idle, &queue->lock);
+    }
+    mtx_unlock(&queue->lock);
+
+    const bool ipv4 = eth_offload_ipv4(frame, offload);
+    const uint16_t ip_id = ipv4 ? eth_get16(frame + offload->l3_offset + 4) : 0;
+    const uint32_t seq = eth_get32(tcp + 4);
+    const uint8_t tcp_flags = tcp[13];
+    zx_status_t result = ZX_OK;
+    for (size_t i = 0; i < segs; i++) {
+        const size_t offset = i * mss;
+        const size_t seg_payload = payload - offset < mss ? payload - offset : mss;
+        const size_t seg_len = hdr_len + seg_payload;
+        uint8_t* seg = gso->buf + i * GSO_SEG_SIZE;
+        memcpy(seg, frame, hdr_len);
+        memcpy(seg + hdr_len, frame + hdr_len + offset, seg_payload);
+
+        // Each segment is a packet of its own.
+        uint8_t* ip = seg + offload->l3_offset;
+        uint8_t* th = seg + offload->l4_offset;
+        if (ipv4) {
+            eth_put16(ip + 2, (uint16_t)(seg_len - offload->l3_offset));
+            eth_put16(ip + 4, (uint16_t)(ip_id + i));
+        } else {
+            eth_put16(ip + 4, (uint16_t)(seg_len - offload->l3_offset - IPV6_HDR_LEN));
+        }
+        eth_put32(th + 4, seq + (uint32_t)offset);
+        // FIN and PSH belong to the last segment, and CWR to the first.
+        uint8_t flags = tcp_flags;
+        if (i + 1 < segs) {
+            flags &= (uint8_t)~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+        }
+        if (i > 0) {
+            flags &= (uint8_t)~TCP_FLAG_CWR;
+        }
+        th[13] = flags;
+
+        tx_info_t* tx_info = &gso->segs[i];
+        tx_info->netbuf.offload = *offload;
+        tx_info->netbuf.offload.flags &= ~ETHMAC_TX_OFFLOAD_TSO;
+        eth_fill_csums(edev0->info.features, seg, seg_len, &tx_info->netbuf.offload);
+        tx_info->netbuf.data = seg;
+        if (edev0->info.features & ETHMAC_FEATURE_DMA) {
+            const size_t buf_offset = i * GSO_SEG_SIZE;
+            tx_info->netbuf.phys = gso->paddr_map[buf_offset / PAGE_SIZE] +
+                                   (buf_offset & PAGE_MASK);
+        }
+        tx_info->netbuf.len = (uint16_t)seg_len;
+        tx_info->netbuf.queue = queue->index;
+
+        mtx_lock(&queue->lock);
+        gso->pending++;
+        mtx_unlock(&queue->lock);
+        uint32_t seg_opts = i + 1 < segs ? ETHMAC_TX_OPT_MORE : opts;
+        status = edev0->mac.ops->queue_tx(edev0->mac.ctx, seg_opts, &tx_info->netbuf);
+        if (edev->state & ETHDEV_TX_LOOPBACK) {
+            eth_tx_echo(edev0, seg, seg_len);
+        }
+        if (status != ZX_ERR_SHOULD_WAIT) {
+            eth_put_gso_seg(queue);
+            if (status != ZX_OK) {
+                result = status;
+            }
+        }
+    }
+    return result;
+}
+
 // The array of entries is invalidated after the call
-static int eth_send(ethdev_t* edev, zircon_ethernet_FifoEntry* entries, uint32_t count) {
+static int eth_send(eth_queue_t* queue, zircon_ethernet_FifoEntry* entries, uint32_t count) {
     tx_info_t* tx_info = NULL;
+    ethdev_t* edev = queue->edev;
     ethdev0_t* edev0 = edev->edev0;
     // The entries that we can't send back to the fifo immediately are filtered
     // out in-place using a classic algorithm a-la "std::remove_if".
     // Once the loop finishes, the first 'to_write' entries in the array
-    // will be written back to the fifo. The rest will be written later by
+    // are queued to be written back to the fifo. The rest are queued later by
     // the eth0_complete_tx callback.
     uint32_t to_write = 0;
     for (zircon_ethernet_FifoEntry* e = entries; count > 0; e++) {
-        if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
+        uint8_t* frame;
+        size_t len;
+        ethmac_tx_offload_t offload;
+        if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset))) ||
+            eth_get_offload(edev, e, &frame, &len, &offload) != ZX_OK) {
             e->flags = zircon_ethernet_FIFO_INVALID;
             entries[to_write++] = *e;
+        } else if ((offload.flags & ETHMAC_TX_OFFLOAD_TSO) &&
+                   !(edev0->info.features & ETHMAC_FEATURE_TSO)) {
+            zx_status_t status = eth_send_gso(queue, count > 1 ? ETHMAC_TX_OPT_MORE : 0u, frame,
+                                              len, &offload);
+            e->flags = status == ZX_OK ? zircon_ethernet_FIFO_TX_OK : 0;
+            entries[to_write++] = *e;
         } else {
             zx_status_t status;
             if (tx_info == NULL) {
-                tx_info = eth_get_tx_info(edev);
+                tx_info = eth_get_tx_info(queue);
                 if (tx_info == NULL) {
                     return -1;
                 }
@@ -459,16 +969,23 @@ static int eth_send(ethdev_t* edev, zircon_ethernet_FifoEntry* entries, uint32_t
             if (opts) {
                 zxlogf(SPEW, "setting OPT_MORE (%u packets to go)\n", count);
             }
-            tx_info->netbuf.data = edev->io_buf + e->offset;
+            if (offload.flags) {
+                eth_fill_csums(edev0->info.features, frame, len, &offload);
+            }
+            const size_t offset = frame - (uint8_t*)edev->io_buf;
+            tx_info->netbuf.data = frame;
             if (edev0->info.features & ETHMAC_FEATURE_DMA) {
-                tx_info->netbuf.phys = edev->paddr_map[e->offset / PAGE_SIZE] +
-                                       (e->offset & PAGE_MASK);
+                tx_info->netbuf.phys = edev->paddr_map[offset / PAGE_SIZE] +
+                                       (offset & PAGE_MASK);
             }
-            tx_info->netbuf.len = e->length;
+            tx_info->netbuf.len = (uint16_t)len;
+            tx_info->netbuf.queue = queue->index;
+            tx_info->netbuf.offload = offload;
+            tx_info->header_len = (uint16_t)(offset - e->offset);
             tx_info->fifo_cookie = e->cookie;
             status = edev0->mac.ops->queue_tx(edev0->mac.ctx, opts, &tx_info->netbuf);
             if (edev->state & ETHDEV_TX_LOOPBACK) {
-                eth_tx_echo(edev0, edev->io_buf + e->offset, e->length);
+                eth_tx_echo(edev0, frame, len);
             }
             if (status != ZX_ERR_SHOULD_WAIT) {
                 // Transmission completed. To avoid extra mutex locking/unlocking,
@@ -484,30 +1001,36 @@ static int eth_send(ethdev_t* edev, zircon_ethernet_FifoEntry* entries, uint32_t
         }
         count--;
     }
+    mtx_lock(&queue->lock);
     if (tx_info) {
-        eth_put_tx_info(edev, tx_info);
-    }
-    if (to_write) {
-        tx_fifo_write(edev, entries, to_write);
+        list_add_head(&queue->free_tx_bufs, &tx_info->netbuf.node);
     }
+    eth_tx_done_locked(queue, entries, to_write);
+    mtx_unlock(&queue->lock);
     return 0;
 }
 
+// Reads the client's tx fifo and submits each batch straight to the device,
+// then writes back every entry completed since the last batch, whether by the
+// device or as it was read, in one fifo write.
 static int eth_tx_thread(void* arg) {
-    ethdev_t* edev = (ethdev_t*)arg;
-    zircon_ethernet_FifoEntry entries[FIFO_DEPTH / 2];
+    eth_queue_t* queue = (eth_queue_t*)arg;
+    ethdev_t* edev = queue->edev;
+    zircon_ethernet_FifoEntry entries[TX_BATCH_SZ];
     zx_status_t status;
     size_t count;
 
     for (;;) {
-        if ((status = zx_fifo_read(edev->tx_fifo, sizeof(entries[0]), entries,
+        eth_flush_tx_done(queue);
+        if ((status = zx_fifo_read(queue->tx_fifo, sizeof(entries[0]), entries,
                                    countof(entries), &count)) < 0) {
             if (status == ZX_ERR_SHOULD_WAIT) {
                 zx_signals_t observed;
-                if ((status = zx_object_wait_one(edev->tx_fifo,
+                if ((status = zx_object_wait_one(queue->tx_fifo,
                                                  ZX_FIFO_READABLE |
                                                  ZX_FIFO_PEER_CLOSED |
-                                                 kSignalFifoTerminate,
+                                                 kSignalFifoTerminate |
+                                                 kSignalTxDone,
                                                  ZX_TIME_INFINITE,
                                                  &observed)) < 0) {
                     zxlogf(ERROR, "eth [%s]: tx_fifo: error waiting: %d\n", edev->name, status);
@@ -521,34 +1044,71 @@ static int eth_tx_thread(void* arg) {
                 break;
             }
         }
-        if (eth_send(edev, entries, count)) {
+        if (eth_send(queue, entries, count)) {
             break;
         }
     }
 
-    zxlogf(INFO, "eth [%s]: tx_thread: exit: %d\n", edev->name, status);
+    zxlogf(INFO, "eth [%s]: tx_thread %u: exit: %d\n", edev->name, queue->index, status);
     return 0;
 }
 
-static zx_status_t eth_get_fifos_locked(ethdev_t* edev, struct zircon_ethernet_Fifos* fifos) {
+static zx_status_t eth_start_tx_thread_locked(eth_queue_t* queue) {
+    ethdev_t* edev = queue->edev;
+    if (queue->tx_thread) {
+        return ZX_OK;
+    }
+    int r = thrd_create_with_name(&queue->tx_thr, eth_tx_thread, queue, "eth-tx-thread");
+    if (r != thrd_success) {
+        zxlogf(ERROR, "eth [%s]: failed to start tx thread: %d\n", edev->name, r);
+        return ZX_ERR_INTERNAL;
+    }
+    queue->tx_thread = true;
+
+    // Keep the thread on the cpu the queue's traffic is steered to.
+    zx_handle_t profile = edev->edev0->queue_profile[queue->index];
+    if (profile != ZX_HANDLE_INVALID) {
+        zx_status_t status = zx_object_set_profile(thrd_get_zx_handle(queue->tx_thr), profile, 0);
+        if (status != ZX_OK) {
+            zxlogf(TRACE, "eth [%s]: cannot bind tx thread %u: %d\n", edev->name, queue->index,
+                   status);
+        }
+    }
+    return ZX_OK;
+}
+
+static zx_status_t eth_get_fifos_locked(ethdev_t* edev, uint32_t index,
+                                        struct zircon_ethernet_Fifos* fifos) {
+    if (index >= edev->queue_count) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    eth_queue_t* queue = &edev->queues[index];
+    if (queue->tx_fifo != ZX_HANDLE_INVALID) {
+        return ZX_ERR_ALREADY_BOUND;
+    }
+
     zx_status_t status;
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx, &edev->tx_fifo)) < 0) {
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->tx, &queue->tx_fifo)) < 0) {
         zxlogf(ERROR, "eth_create  [%s]: failed to create tx fifo: %d\n", edev->name, status);
         return status;
     }
-    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx, &edev->rx_fifo)) < 0) {
+    if ((status = zx_fifo_create(FIFO_DEPTH, FIFO_ESIZE, 0, &fifos->rx, &queue->rx_fifo)) < 0) {
         zxlogf(ERROR, "eth_create  [%s]: failed to create rx fifo: %d\n", edev->name, status);
         zx_handle_close(fifos->tx);
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+        zx_handle_close(queue->tx_fifo);
+        queue->tx_fifo = ZX_HANDLE_INVALID;
         return status;
     }
 
-    edev->tx_depth = FIFO_DEPTH;
-    edev->rx_depth = FIFO_DEPTH;
+    queue->tx_depth = FIFO_DEPTH;
+    queue->rx_depth = FIFO_DEPTH;
     fifos->tx_depth = FIFO_DEPTH;
     fifos->rx_depth = FIFO_DEPTH;
 
+    // The fifos of a queue may be obtained once the instance is running.
+    if (edev->state & ETHDEV_RUNNING) {
+        return eth_start_tx_thread_locked(queue);
+    }
     return ZX_OK;
 }
 
@@ -612,6 +1172,44 @@ fail:
     return status;
 }
 
+// Spreads the queues of a device which has several of them across the cpus,
+// and creates the profiles which keep the threads sending on each queue on
+// its cpu.
+static void eth_assign_queue_cpus(ethdev0_t* edev0) {
+    if (edev0->info.queue_count < 2) {
+        return;
+    }
+    const uint32_t num_cpus = zx_system_get_num_cpus();
+    for (uint32_t i = 0; i < edev0->info.queue_count; i++) {
+        edev0->queue_cpu_mask[i] = 1u << (i % num_cpus);
+        zx_profile_info_t info = {.type = ZX_PROFILE_INFO_CPU_AFFINITY};
+        info.cpu_affinity.cpu_mask = edev0->queue_cpu_mask[i];
+        zx_status_t status = zx_profile_create(get_root_resource(), &info,
+                                               &edev0->queue_profile[i]);
+        if (status != ZX_OK) {
+            zxlogf(TRACE, "eth: cannot create profile for queue %u: %d\n", i, status);
+            edev0->queue_profile[i] = ZX_HANDLE_INVALID;
+        }
+    }
+}
+
+// Asks the device to steer the interrupts of each queue to its cpu. This is
+// only a hint, which devices may not support.
+static void eth_steer_queues(ethdev0_t* edev0) {
+    for (uint32_t i = 0; i < edev0->info.queue_count; i++) {
+        if (edev0->queue_cpu_mask[i] == 0) {
+            continue;
+        }
+        uint32_t cpu = __builtin_ctz(edev0->queue_cpu_mask[i]);
+        zx_status_t status = edev0->mac.ops->set_param(edev0->mac.ctx,
+                                                       ETHMAC_SETPARAM_QUEUE_AFFINITY,
+                                                       (int32_t)i, &cpu);
+        if (status != ZX_OK && status != ZX_ERR_NOT_SUPPORTED) {
+            zxlogf(ERROR, "eth: cannot steer queue %u to cpu %u: %d\n", i, cpu, status);
+        }
+    }
+}
+
 // The thread safety analysis cannot reason through the aliasing of
 // edev0 and edev->edev0, so disable it.
 static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -619,8 +1217,8 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
 
     // Cannot start unless tx/rx rings are configured
     if ((edev->io_vmo == ZX_HANDLE_INVALID) ||
-        (edev->tx_fifo == ZX_HANDLE_INVALID) ||
-        (edev->rx_fifo == ZX_HANDLE_INVALID)) {
+        (edev->queues[0].tx_fifo == ZX_HANDLE_INVALID) ||
+        (edev->queues[0].rx_fifo == ZX_HANDLE_INVALID)) {
         return ZX_ERR_BAD_STATE;
     }
 
@@ -628,23 +1226,23 @@ static zx_status_t eth_start_locked(ethdev_t* edev) TA_NO_THREAD_SAFETY_ANALYSIS
         return ZX_OK;
     }
 
-    if (!(edev->state & ETHDEV_TX_THREAD)) {
-        int r = thrd_create_with_name(&edev->tx_thr, eth_tx_thread,
-                                      edev, "eth-tx-thread");
-        if (r != thrd_success) {
-            zxlogf(ERROR, "eth [%s]: failed to start tx thread: %d\n", edev->name, r);
-            return ZX_ERR_INTERNAL;
+    zx_status_t status;
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        if (edev->queues[i].tx_fifo != ZX_HANDLE_INVALID &&
+            (status = eth_start_tx_thread_locked(&edev->queues[i])) != ZX_OK) {
+            return status;
         }
-        edev->state |= ETHDEV_TX_THREAD;
     }
 
-    zx_status_t status;
     if (list_is_empty(&edev0->list_active)) {
         // Release the lock to allow other device operations in callback routine.
         // Re-acquire lock afterwards. Set busy to prevent problems with other ioctls.
         edev0->state |= ETHDEV0_BUSY;
         mtx_unlock(&edev0->lock);
         status = edev0->mac.ops->start(edev0->mac.ctx, &ethmac_ifc, edev0);
+        if (status == ZX_OK) {
+            eth_steer_queues(edev0);
+        }
         mtx_lock(&edev0->lock);
         edev0->state &= ~ETHDEV0_BUSY;
     } else {
@@ -709,10 +1307,11 @@ static zx_status_t eth_get_status_locked(ethdev_t* edev, void* out_buf, size_t o
     if (out_len < sizeof(uint32_t)) {
         return ZX_ERR_INVALID_ARGS;
     }
-    if (edev->rx_fifo == ZX_HANDLE_INVALID) {
+    if (edev->queues[0].rx_fifo == ZX_HANDLE_INVALID) {
         return ZX_ERR_BAD_STATE;
     }
-    if (zx_object_signal_peer(edev->rx_fifo, zircon_ethernet_SIGNAL_STATUS, 0) != ZX_OK) {
+    if (zx_object_signal_peer(edev->queues[0].rx_fifo, zircon_ethernet_SIGNAL_STATUS, 0) !=
+        ZX_OK) {
         return ZX_ERR_INTERNAL;
     }
 
@@ -735,6 +1334,18 @@ static zx_status_t fidl_GetInfo_locked(void* ctx, fidl_txn_t* txn) {
     if (edev->edev0->info.features & ETHMAC_FEATURE_SYNTH) {
         info.features |= zircon_ethernet_INFO_FEATURE_SYNTH;
     }
+    if (edev->edev0->info.features & ETHMAC_FEATURE_TX_CSUM_IPV4) {
+        info.features |= zircon_ethernet_INFO_FEATURE_TX_CSUM_IPV4;
+    }
+    if (edev->edev0->info.features & ETHMAC_FEATURE_TX_CSUM_L4) {
+        info.features |= zircon_ethernet_INFO_FEATURE_TX_CSUM_L4;
+    }
+    if (edev->edev0->info.features & ETHMAC_FEATURE_TSO) {
+        info.features |= zircon_ethernet_INFO_FEATURE_TSO;
+    }
+    if (edev->edev0->info.features & ETHMAC_FEATURE_RX_CSUM) {
+        info.features |= zircon_ethernet_INFO_FEATURE_RX_CSUM;
+    }
     info.mtu = edev->edev0->info.mtu;
     return REPLY(GetInfo)(txn, &info);
 }
@@ -742,7 +1353,7 @@ static zx_status_t fidl_GetInfo_locked(void* ctx, fidl_txn_t* txn) {
 static zx_status_t fidl_GetFifos_locked(void* ctx, fidl_txn_t* txn) {
     ethdev_t* edev = ctx;
     zircon_ethernet_Fifos fifos;
-    return REPLY(GetFifos)(txn, eth_get_fifos_locked(edev, &fifos), &fifos);
+    return REPLY(GetFifos)(txn, eth_get_fifos_locked(edev, 0, &fifos), &fifos);
 }
 
 static zx_status_t fidl_SetIOBuffer_locked(void* ctx, zx_handle_t h, fidl_txn_t* txn) {
@@ -780,7 +1391,8 @@ static zx_status_t fidl_SetClientName_locked(void* ctx, const char* buf, size_t
 
 static zx_status_t fidl_GetStatus_locked(void* ctx, fidl_txn_t* txn) {
     ethdev_t* edev = ctx;
-    if (zx_object_signal_peer(edev->rx_fifo, zircon_ethernet_SIGNAL_STATUS, 0) != ZX_OK) {
+    if (zx_object_signal_peer(edev->queues[0].rx_fifo, zircon_ethernet_SIGNAL_STATUS, 0) !=
+        ZX_OK) {
         return ZX_ERR_INTERNAL;
     }
     return REPLY(GetStatus)(txn, edev->edev0->status);
@@ -829,6 +1441,26 @@ static zx_status_t fidl_DumpRegisters_locked(void* ctx, fidl_txn_t* txn) {
     return REPLY(DumpRegisters)(txn, status);
 }
 
+static zx_status_t fidl_GetQueueCount_locked(void* ctx, fidl_txn_t* txn) {
+    ethdev_t* edev = ctx;
+    return REPLY(GetQueueCount)(txn, edev->queue_count);
+}
+
+static zx_status_t fidl_GetQueueFifos_locked(void* ctx, uint32_t queue, fidl_txn_t* txn) {
+    ethdev_t* edev = ctx;
+    zircon_ethernet_Fifos fifos;
+    zx_status_t status = eth_get_fifos_locked(edev, queue, &fifos);
+    uint32_t cpu_mask = status == ZX_OK ? edev->edev0->queue_cpu_mask[queue] : 0;
+    return REPLY(GetQueueFifos)(txn, status, &fifos, cpu_mask);
+}
+
+static zx_status_t fidl_SetRss_locked(void* ctx, const zircon_ethernet_RssConfig* config,
+                                      fidl_txn_t* txn) {
+    ethdev_t* edev = ctx;
+    zx_status_t status = eth_set_rss_locked(edev, config);
+    return REPLY(SetRss)(txn, status);
+}
+
 #undef REPLY
 
 zircon_ethernet_Device_ops_t fidl_ops = {
@@ -847,6 +1479,9 @@ zircon_ethernet_Device_ops_t fidl_ops = {
     .ConfigMulticastSetPromiscuousMode = fidl_ConfigMulticastSetPromiscuousMode_locked,
     .ConfigMulticastTestFilter = fidl_ConfigMulticastTestFilter_locked,
     .DumpRegisters = fidl_DumpRegisters_locked,
+    .GetQueueCount = fidl_GetQueueCount_locked,
+    .GetQueueFifos = fidl_GetQueueFifos_locked,
+    .SetRss = fidl_SetRss_locked,
 };
 
 static zx_status_t eth_message(void* ctx, fidl_msg_t* msg, fidl_txn_t* txn) {
@@ -865,37 +1500,42 @@ static void eth_kill_locked(ethdev_t* edev) {
         return;
     }
 
-    zxlogf(TRACE, "eth [%s]: kill: tearing down%s\n",
-           edev->name, (edev->state & ETHDEV_TX_THREAD) ? " tx thread" : "");
+    zxlogf(TRACE, "eth [%s]: kill: tearing down\n", edev->name);
     eth_set_promisc_locked(edev, false);
 
     // make sure any future ioctls or other ops will fail
     edev->state |= ETHDEV_DEAD;
 
     // try to convince clients to close us
-    if (edev->rx_fifo) {
-        zx_handle_close(edev->rx_fifo);
-        edev->rx_fifo = ZX_HANDLE_INVALID;
-    }
-    if (edev->tx_fifo) {
-        // Ask the TX thread to exit.
-        zx_object_signal(edev->tx_fifo, 0, kSignalFifoTerminate);
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        eth_queue_t* queue = &edev->queues[i];
+        if (queue->rx_fifo) {
+            zx_handle_close(queue->rx_fifo);
+            queue->rx_fifo = ZX_HANDLE_INVALID;
+        }
+        if (queue->tx_fifo) {
+            // Ask the TX thread to exit.
+            zx_object_signal(queue->tx_fifo, 0, kSignalFifoTerminate);
+        }
     }
     if (edev->io_vmo) {
         zx_handle_close(edev->io_vmo);
         edev->io_vmo = ZX_HANDLE_INVALID;
     }
 
-    if (edev->state & ETHDEV_TX_THREAD) {
-        edev->state &= (~ETHDEV_TX_THREAD);
-        int ret;
-        thrd_join(edev->tx_thr, &ret);
-        zxlogf(TRACE, "eth [%s]: kill: tx thread exited\n", edev->name);
-    }
-
-    if (edev->tx_fifo) {
-        zx_handle_close(edev->tx_fifo);
-        edev->tx_fifo = ZX_HANDLE_INVALID;
+    for (uint32_t i = 0; i < edev->queue_count; i++) {
+        eth_queue_t* queue = &edev->queues[i];
+        if (queue->tx_thread) {
+            queue->tx_thread = false;
+            int ret;
+            thrd_join(queue->tx_thr, &ret);
+            zxlogf(TRACE, "eth [%s]: kill: tx thread %u exited\n", edev->name, i);
+        }
+        if (queue->tx_fifo) {
+            zx_handle_close(queue->tx_fifo);
+            queue->tx_fifo = ZX_HANDLE_INVALID;
+        }
+        eth_gso_release(queue);
     }
 
     if (edev->io_buf) {
@@ -945,18 +1585,30 @@ static zx_protocol_device_t ethdev_ops = {
 static zx_status_t eth0_open(void* ctx, zx_device_t** out, uint32_t flags) {
     ethdev0_t* edev0 = ctx;
 
+    const uint32_t queue_count = edev0->info.queue_count;
     ethdev_t* edev;
-    if ((edev = calloc(1, sizeof(ethdev_t))) == NULL) {
+    if ((edev = calloc(1, sizeof(ethdev_t) + queue_count * sizeof(eth_queue_t))) == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
     edev->edev0 = edev0;
 
-    list_initialize(&edev->free_tx_bufs);
-    for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
-        edev->all_tx_bufs[ndx].edev = edev;
-        list_add_tail(&edev->free_tx_bufs, &edev->all_tx_bufs[ndx].netbuf.node);
+    edev->queue_count = queue_count;
+    for (uint32_t i = 0; i < queue_count; i++) {
+        eth_queue_t* queue = &edev->queues[i];
+        queue->edev = edev;
+        queue->index = (uint16_t)i;
+        list_initialize(&queue->free_tx_bufs);
+        for (size_t ndx = 0; ndx < FIFO_DEPTH; ndx++) {
+            queue->all_tx_bufs[ndx].queue = queue;
+            list_add_tail(&queue->free_tx_bufs, &queue->all_tx_bufs[ndx].netbuf.node);
+        }
+        for (size_t ndx = 0; ndx < GSO_MAX_SEGS; ndx++) {
+            queue->gso.segs[ndx].queue = queue;
+            queue->gso.segs[ndx].gso = true;
+        }
+        mtx_init(&queue->lock, mtx_plain);
+        cnd_init(&queue->gso.idle);
     }
-    mtx_init(&edev->lock, mtx_plain);
 
     device_add_args_t args = {
         .version = DEVICE_ADD_ARGS_VERSION,
@@ -1003,6 +1655,9 @@ static void eth0_unbind(void* ctx) {
 
 static void eth0_release(void* ctx) {
     ethdev0_t* edev0 = ctx;
+    for (uint32_t i = 0; i < edev0->info.queue_count; i++) {
+        zx_handle_close(edev0->queue_profile[i]);
+    }
     free(edev0);
 }
 
@@ -1048,6 +1703,13 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
         goto fail;
     }
 
+    if (edev0->info.queue_count == 0) {
+        edev0->info.queue_count = 1;
+    } else if (edev0->info.queue_count > ETHMAC_MAX_QUEUES) {
+        edev0->info.queue_count = ETHMAC_MAX_QUEUES;
+    }
+    eth_assign_queue_cpus(edev0);
+
     mtx_init(&edev0->lock, mtx_plain);
     list_initialize(&edev0->list_active);
     list_initialize(&edev0->list_idle);
@@ -1069,6 +1731,9 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
     return ZX_OK;
 
 fail:
+    for (uint32_t i = 0; i < ETHMAC_MAX_QUEUES; i++) {
+        zx_handle_close(edev0->queue_profile[i]);
+    }
     free(edev0);
     return status;
 }
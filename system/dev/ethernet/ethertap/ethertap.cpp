@@ -80,6 +80,8 @@ int tap_device_thread(void* arg) {
 }
 
 #define TAP_SHUTDOWN ZX_USER_SIGNAL_7
+// Set when a batch of frames is waiting to be sent.
+#define TAP_TX_PENDING ZX_USER_SIGNAL_6
 
 TapDevice::TapDevice(zx_device_t* device, const ethertap_ioctl_config* config, zx::socket data)
   : ddk::Device<TapDevice, ddk::Unbindable>(device),
@@ -89,6 +91,9 @@ TapDevice::TapDevice(zx_device_t* device, const ethertap_ioctl_config* config, z
     data_(fbl::move(data)) {
     ZX_DEBUG_ASSERT(data_.is_valid());
     memcpy(mac_, config->mac, 6);
+    if (options_ & ETHERTAP_OPT_BATCH) {
+        tx_batch_.reset(new uint8_t[ETHERTAP_MAX_BATCH_SIZE]);
+    }
 
     int ret = thrd_create_with_name(&thread_, tap_device_thread, reinterpret_cast<void*>(this),
                                     "ethertap-thread");
@@ -141,6 +146,9 @@ zx_status_t TapDevice::EthmacQueueTx(uint32_t options, ethmac_netbuf_t* netbuf)
     if (dead_) {
         return ZX_ERR_PEER_CLOSED;
     }
+    if (options_ & ETHERTAP_OPT_BATCH) {
+        return QueueBatchTxLocked(netbuf->data, netbuf->len);
+    }
     uint8_t temp_buf[ETHERTAP_MAX_MTU + sizeof(ethertap_socket_header_t)];
     auto header = reinterpret_cast<ethertap_socket_header*>(temp_buf);
     uint8_t* data = temp_buf + sizeof(ethertap_socket_header_t);
@@ -162,6 +170,58 @@ zx_status_t TapDevice::EthmacQueueTx(uint32_t options, ethmac_netbuf_t* netbuf)
     return status == ZX_ERR_SHOULD_WAIT ? ZX_ERR_UNAVAILABLE : status;
 }
 
+zx_status_t TapDevice::QueueBatchTxLocked(const void* data, size_t length) {
+    ZX_DEBUG_ASSERT(length <= mtu_);
+    const size_t frame_size = sizeof(ethertap_batch_frame_t) + length;
+    if (tx_batch_len_ + frame_size > ETHERTAP_MAX_BATCH_SIZE) {
+        // The thread hasn't sent the batch yet, so make room for this frame in its place.
+        zx_status_t status = FlushTxLocked();
+        if (status != ZX_OK) {
+            // returning ZX_ERR_SHOULD_WAIT indicates that we will call complete_tx(), which we
+            // will not
+            return status == ZX_ERR_SHOULD_WAIT ? ZX_ERR_UNAVAILABLE : status;
+        }
+    }
+
+    if (unlikely(options_ & ETHERTAP_OPT_TRACE_PACKETS)) {
+        ethertap_trace("queueing %zu bytes\n", length);
+        hexdump8_ex(data, length, 0);
+    }
+    ethertap_batch_frame_t frame = { static_cast<uint32_t>(length) };
+    memcpy(tx_batch_.get() + tx_batch_len_, &frame, sizeof(frame));
+    memcpy(tx_batch_.get() + tx_batch_len_ + sizeof(frame), data, length);
+    tx_batch_len_ += frame_size;
+
+    // Only the first frame of a batch needs to wake the thread.
+    if (tx_batch_count_++ == 0) {
+        zx_status_t status = data_.signal(0, TAP_TX_PENDING);
+        ZX_DEBUG_ASSERT(status == ZX_OK);
+    }
+    return ZX_OK;
+}
+
+zx_status_t TapDevice::FlushTxLocked() {
+    if (tx_batch_count_ == 0) {
+        return ZX_OK;
+    }
+    auto header = reinterpret_cast<ethertap_socket_header_t*>(tx_batch_.get());
+    header->type = ETHERTAP_MSG_PACKET_BATCH;
+    header->info = static_cast<int32_t>(tx_batch_count_);
+
+    zx_status_t status = data_.write(0u, tx_batch_.get(), tx_batch_len_, nullptr);
+    // Keep the batch until the socket has room for it.
+    tx_blocked_ = (status == ZX_ERR_SHOULD_WAIT);
+    if (tx_blocked_) {
+        return status;
+    }
+    if (status != ZX_OK) {
+        zxlogf(ERROR, "ethertap: error writing batch of %u frames: %d\n", tx_batch_count_, status);
+    }
+    tx_batch_len_ = sizeof(ethertap_socket_header_t);
+    tx_batch_count_ = 0;
+    return status;
+}
+
 zx_status_t TapDevice::EthmacSetParam(uint32_t param, int32_t value, void* data) {
     fbl::AutoLock lock(&lock_);
     if (!(options_ & ETHERTAP_OPT_REPORT_PARAM) || dead_) {
@@ -214,18 +274,34 @@ zx_handle_t TapDevice::EthmacGetBti() {
 int TapDevice::Thread() {
     ethertap_trace("starting main thread\n");
     zx_signals_t pending;
-    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[mtu_]);
+    const bool batch = options_ & ETHERTAP_OPT_BATCH;
+    const uint32_t capacity = batch ? ETHERTAP_MAX_BATCH_SIZE : mtu_;
+    fbl::unique_ptr<uint8_t[]> buf(new uint8_t[capacity]);
 
     zx_status_t status = ZX_OK;
     const zx_signals_t wait = ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED | ETHERTAP_SIGNAL_ONLINE
-        | ETHERTAP_SIGNAL_OFFLINE | TAP_SHUTDOWN;
+        | ETHERTAP_SIGNAL_OFFLINE | TAP_SHUTDOWN | TAP_TX_PENDING;
     while (true) {
-        status = data_.wait_one(wait, zx::time::infinite(), &pending);
+        bool tx_blocked = false;
+        if (batch) {
+            fbl::AutoLock lock(&lock_);
+            tx_blocked = tx_blocked_;
+        }
+        status = data_.wait_one(wait | (tx_blocked ? ZX_SOCKET_WRITABLE : 0),
+                                zx::time::infinite(), &pending);
         if (status != ZX_OK) {
             ethertap_trace("error waiting on data: %d\n", status);
             break;
         }
 
+        if ((pending & TAP_TX_PENDING) || (tx_blocked && (pending & ZX_SOCKET_WRITABLE))) {
+            fbl::AutoLock lock(&lock_);
+            status = data_.signal(TAP_TX_PENDING, 0);
+            ZX_DEBUG_ASSERT(status == ZX_OK);
+            // A peer which has gone away is noticed below.
+            FlushTxLocked();
+        }
+
         if (pending & (ETHERTAP_SIGNAL_OFFLINE | ETHERTAP_SIGNAL_ONLINE)) {
             status = UpdateLinkStatus(pending);
             if (status != ZX_OK) {
@@ -234,7 +310,7 @@ int TapDevice::Thread() {
         }
 
         if (pending & ZX_SOCKET_READABLE) {
-            status = Recv(buf.get(), mtu_);
+            status = Recv(buf.get(), capacity);
             if (status != ZX_OK) {
                 break;
             }
@@ -311,6 +387,10 @@ zx_status_t TapDevice::Recv(uint8_t* buffer, uint32_t capacity) {
         zxlogf(ERROR, "ethertap: error reading data: %d\n", status);
         return status;
     }
+    if (options_ & ETHERTAP_OPT_BATCH) {
+        RecvBatch(buffer, actual);
+        return ZX_OK;
+    }
 
     fbl::AutoLock lock(&lock_);
     if (unlikely(options_ & ETHERTAP_OPT_TRACE_PACKETS)) {
@@ -323,6 +403,50 @@ zx_status_t TapDevice::Recv(uint8_t* buffer, uint32_t capacity) {
     return ZX_OK;
 }
 
+void TapDevice::RecvBatch(const uint8_t* buffer, size_t length) {
+    ethertap_socket_header_t header;
+    if (length < sizeof(header)) {
+        zxlogf(ERROR, "ethertap: short batch of %zu bytes\n", length);
+        return;
+    }
+    memcpy(&header, buffer, sizeof(header));
+    if (header.type != ETHERTAP_MSG_PACKET_BATCH || header.info < 0) {
+        zxlogf(ERROR, "ethertap: bad batch header (type %u, count %d)\n", header.type,
+               header.info);
+        return;
+    }
+
+    fbl::AutoLock lock(&lock_);
+    size_t offset = sizeof(header);
+    for (int32_t i = 0; i < header.info; i++) {
+        ethertap_batch_frame_t frame;
+        if (length - offset < sizeof(frame)) {
+            zxlogf(ERROR, "ethertap: batch truncated after %d of %d frames\n", i, header.info);
+            return;
+        }
+        memcpy(&frame, buffer + offset, sizeof(frame));
+        offset += sizeof(frame);
+        if (frame.length > length - offset) {
+            zxlogf(ERROR, "ethertap: batch truncated after %d of %d frames\n", i, header.info);
+            return;
+        }
+        const uint8_t* data = buffer + offset;
+        offset += frame.length;
+        if (frame.length > mtu_) {
+            ethertap_trace("dropping frame of %u bytes\n", frame.length);
+            continue;
+        }
+
+        if (unlikely(options_ & ETHERTAP_OPT_TRACE_PACKETS)) {
+            ethertap_trace("received %u bytes\n", frame.length);
+            hexdump8_ex(data, frame.length, 0);
+        }
+        if (ethmac_proxy_ != nullptr) {
+            ethmac_proxy_->Recv(const_cast<uint8_t*>(data), frame.length, 0u);
+        }
+    }
+}
+
 }  // namespace eth
 
 extern "C" zx_status_t tapctl_bind(void* ctx, zx_device_t* device, void** cookie) {
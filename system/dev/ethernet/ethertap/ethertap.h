@@ -48,6 +48,12 @@ class TapDevice : public ddk::Device<TapDevice, ddk::Unbindable>,
   private:
     zx_status_t UpdateLinkStatus(zx_signals_t observed);
     zx_status_t Recv(uint8_t* buffer, uint32_t capacity);
+    void RecvBatch(const uint8_t* buffer, size_t length);
+
+    // Adds a frame to the batch to be sent by the thread.
+    zx_status_t QueueBatchTxLocked(const void* data, size_t length) __TA_REQUIRES(lock_);
+    // Sends the current batch, unless the socket is full.
+    zx_status_t FlushTxLocked() __TA_REQUIRES(lock_);
 
     // ethertap options
     uint32_t options_ = 0;
@@ -61,6 +67,13 @@ class TapDevice : public ddk::Device<TapDevice, ddk::Unbindable>,
     bool dead_ = false;
     fbl::unique_ptr<ddk::EthmacIfcProxy> ethmac_proxy_ __TA_GUARDED(lock_);
 
+    // With ETHERTAP_OPT_BATCH, the message being built of the frames waiting to be sent, and
+    // whether the socket was too full to take the last one.
+    fbl::unique_ptr<uint8_t[]> tx_batch_ __TA_GUARDED(lock_);
+    size_t tx_batch_len_ __TA_GUARDED(lock_) = sizeof(ethertap_socket_header_t);
+    uint32_t tx_batch_count_ __TA_GUARDED(lock_) = 0;
+    bool tx_blocked_ __TA_GUARDED(lock_) = false;
+
     // Only accessed from Thread, so not locked.
     bool online_ = false;
     zx::socket data_;
@@ -62,12 +62,27 @@ static int irq_thread(void* arg) {
         if (irq & ETH_IRQ_RX) {
             void* data;
             size_t len;
-
-            while (eth_rx(&edev->eth, &data, &len) == ZX_OK) {
-                if (edev->ifc && (edev->state == ETH_RUNNING)) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
+            uint32_t csum;
+
+            // The queues share one interrupt.
+            for (uint32_t q = 0; q < edev->eth.queue_count; q++) {
+                while (eth_rx(&edev->eth, q, &data, &len, &csum) == ZX_OK) {
+                    if (edev->ifc && (edev->state == ETH_RUNNING)) {
+                        uint32_t flags = 0;
+                        if (csum & ETH_RX_CSUM_IP_OK) {
+                            flags |= ETHMAC_RX_CSUM_IPV4_OK;
+                        }
+                        if (csum & ETH_RX_CSUM_L4_OK) {
+                            flags |= ETHMAC_RX_CSUM_L4_OK;
+                        }
+                        if (edev->ifc->recv_queue) {
+                            edev->ifc->recv_queue(edev->cookie, q, data, len, flags);
+                        } else {
+                            edev->ifc->recv(edev->cookie, data, len, flags);
+                        }
+                    }
+                    eth_rx_ack(&edev->eth, q);
                 }
-                eth_rx_ack(&edev->eth);
             }
         }
         if (irq & ETH_IRQ_LSC) {
@@ -97,6 +112,10 @@ static zx_status_t eth_query(void* ctx, uint32_t options, ethmac_info_t* info) {
     ZX_DEBUG_ASSERT(ETH_TXBUF_SIZE >= ETH_MTU);
     info->mtu = ETH_MTU;
     memcpy(info->mac, edev->eth.mac, sizeof(edev->eth.mac));
+    info->queue_count = edev->eth.queue_count;
+    // Legacy descriptors insert one checksum, so the IPv4 header checksum is
+    // left to the ethernet driver.
+    info->features = ETHMAC_FEATURE_TX_CSUM_L4 | ETHMAC_FEATURE_RX_CSUM;
 
     return ZX_OK;
 }
@@ -130,8 +149,47 @@ static zx_status_t eth_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t* ne
     if (edev->state != ETH_RUNNING) {
         return ZX_ERR_BAD_STATE;
     }
+    if (netbuf->queue >= edev->eth.queue_count) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    uint32_t csum_start = 0;
+    uint32_t csum_offset = 0;
+    if (netbuf->offload.flags & (ETHMAC_TX_OFFLOAD_TCP_CSUM | ETHMAC_TX_OFFLOAD_UDP_CSUM)) {
+        // The checksum field holds the sum of the pseudo-header, which the
+        // controller adds the segment to.
+        csum_start = netbuf->offload.l4_offset;
+        csum_offset = csum_start +
+                      (netbuf->offload.flags & ETHMAC_TX_OFFLOAD_TCP_CSUM ? 16 : 6);
+        if (csum_offset > UINT8_MAX) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+    }
     // TODO: Add support for DMA directly from netbuf
-    return eth_tx(&edev->eth, netbuf->data, netbuf->len);
+    return eth_tx(&edev->eth, netbuf->queue, netbuf->data, netbuf->len, csum_start,
+                  csum_offset);
+}
+
+static uint32_t eth_rss_fields(uint32_t hash_types) {
+    uint32_t fields = 0;
+    if (hash_types & ETHMAC_RSS_HASH_IPV4) {
+        fields |= IE_MRQC_IPV4;
+    }
+    if (hash_types & ETHMAC_RSS_HASH_TCP_IPV4) {
+        fields |= IE_MRQC_TCPIPV4;
+    }
+    if (hash_types & ETHMAC_RSS_HASH_UDP_IPV4) {
+        fields |= IE_MRQC_UDPIPV4;
+    }
+    if (hash_types & ETHMAC_RSS_HASH_IPV6) {
+        fields |= IE_MRQC_IPV6;
+    }
+    if (hash_types & ETHMAC_RSS_HASH_TCP_IPV6) {
+        fields |= IE_MRQC_TCPIPV6;
+    }
+    if (hash_types & ETHMAC_RSS_HASH_UDP_IPV6) {
+        fields |= IE_MRQC_UDPIPV6;
+    }
+    return fields;
 }
 
 static zx_status_t eth_set_param(void *ctx, uint32_t param, int32_t value, void* data) {
@@ -149,6 +207,24 @@ static zx_status_t eth_set_param(void *ctx, uint32_t param, int32_t value, void*
         }
         status = ZX_OK;
         break;
+    case ETHMAC_SETPARAM_RSS: {
+        const ethmac_rss_config_t* config = data;
+        if (edev->eth.queue_count < 2) {
+            status = ZX_ERR_NOT_SUPPORTED;
+            break;
+        }
+        eth_set_rss(&edev->eth, eth_rss_fields(config->hash_types), config->key, config->table);
+        status = ZX_OK;
+        break;
+    }
+    case ETHMAC_SETPARAM_QUEUE_AFFINITY:
+        // All queues share one interrupt, which follows queue 0.
+        if (value != 0) {
+            status = ZX_ERR_NOT_SUPPORTED;
+            break;
+        }
+        status = zx_interrupt_set_affinity(edev->irqh, 0, *(uint32_t*)data);
+        break;
     default:
         status = ZX_ERR_NOT_SUPPORTED;
     }
@@ -231,7 +307,9 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
         return ZX_ERR_NO_MEMORY;
     }
     mtx_init(&edev->lock, mtx_plain);
-    mtx_init(&edev->eth.send_lock, mtx_plain);
+    for (uint32_t q = 0; q < ETH_MAX_QUEUES; q++) {
+        mtx_init(&edev->eth.queues[q].send_lock, mtx_plain);
+    }
 
     if (device_get_protocol(dev, ZX_PROTOCOL_PCI, &edev->pci)) {
         printf("no pci protocol\n");
@@ -276,6 +354,7 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
         goto fail;
     }
     edev->eth.pci_did = pci_info.device_id;
+    edev->eth.queue_count = eth_queue_count(edev->eth.pci_did);
 
     if ((r = pci_enable_bus_master(&edev->pci, true)) < 0) {
         printf("eth: cannot enable bus master %d\n", r);
@@ -290,7 +369,8 @@ static zx_status_t eth_bind(void* ctx, zx_device_t* dev) {
         goto fail;
     }
 
-    r = io_buffer_init(&edev->buffer, edev->btih, ETH_ALLOC, IO_BUFFER_RW | IO_BUFFER_CONTIG);
+    r = io_buffer_init(&edev->buffer, edev->btih, ETH_ALLOC(edev->eth.queue_count),
+                       IO_BUFFER_RW | IO_BUFFER_CONTIG);
     if (r < 0) {
         printf("eth: cannot alloc io-buffer %d\n", r);
         goto fail;
@@ -116,6 +116,9 @@
 #define IE_RCTL_BSEX      (1u << 25) // Buffer Size Extension (x16)
 #define IE_RCTL_SECRC     (1u << 26) // Strip CRC Field
 
+#define IE_RXCSUM_IPOFLD  (1u << 8) // IP Checksum Offload Enable
+#define IE_RXCSUM_TUOFLD  (1u << 9) // TCP/UDP Checksum Offload Enable
+
 #define IE_TCTL_RESERVED  ((1u << 2) | (1u << 23) | (0xfu << 25) | (1u << 31))
 #define IE_TCTL_RST       (1u << 0) // TX Reset?
 #define IE_TCTL_EN        (1u << 1) // TX Enable
@@ -227,3 +230,24 @@ typedef struct ie_txd {
                                                       // the I211 writes back an Rx descriptor to
                                                       // memory.
 #define IE_EEC_AUTO_RD          (1u << 9)
+
+// The I211 has two rx and two tx queues. The registers of queue |n| are found
+// from the legacy offset |reg| of queue 0's, which aliases them.
+#define IE_I211_QUEUES          2
+#define IE_I211_RXQ(reg, n)     (0xc000 + ((reg) - 0x2800) + ((n) * 0x40))
+#define IE_I211_TXQ(reg, n)     (0xe000 + ((reg) - 0x3800) + ((n) * 0x40))
+
+#define IE_MRQC                 0x5818                 // Multiple Receive Queues Command
+#define IE_RETA(n)              (0x5c00 + ((n) * 4))   // Redirection Table [0:31]
+#define IE_RSSRK(n)             (0x5c80 + ((n) * 4))   // RSS Random Key [0:9]
+
+#define IE_RETA_COUNT           32                     // Four queue indices each
+#define IE_RSSRK_COUNT          10
+
+#define IE_MRQC_RSS             (2u << 0)              // RSS only, no VMDq
+#define IE_MRQC_TCPIPV4         (1u << 16)             // Hash TCP/IPv4 headers
+#define IE_MRQC_IPV4            (1u << 17)             // Hash IPv4 headers
+#define IE_MRQC_IPV6            (1u << 20)             // Hash IPv6 headers
+#define IE_MRQC_TCPIPV6         (1u << 21)             // Hash TCP/IPv6 headers
+#define IE_MRQC_UDPIPV4         (1u << 22)             // Hash UDP/IPv4 headers
+#define IE_MRQC_UDPIPV6         (1u << 23)             // Hash UDP/IPv6 headers
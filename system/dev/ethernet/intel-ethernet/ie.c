@@ -28,6 +28,20 @@ typedef int status_t;
 
 #include "ie.h"
 
+// The offsets of the rx and tx registers |reg| of queue |q|, given those of
+// queue 0. Only the I211 has more than one queue.
+static uint32_t rxq_reg(uint32_t q, uint32_t reg) {
+    return q == 0 ? reg : IE_I211_RXQ(reg, q);
+}
+
+static uint32_t txq_reg(uint32_t q, uint32_t reg) {
+    return q == 0 ? reg : IE_I211_TXQ(reg, q);
+}
+
+uint32_t eth_queue_count(uint16_t pci_did) {
+    return pci_did == IE_DID_I211_AT ? IE_I211_QUEUES : 1;
+}
+
 void eth_dump_regs(ethdev_t* eth) {
     printf("STAT %08x CTRL %08x EXT %08x IMS %08x\n",
            readl(IE_STATUS), readl(IE_CTRL), readl(IE_CTRL_EXT), readl(IE_IMS));
@@ -50,9 +64,10 @@ bool eth_status_online(ethdev_t* eth) {
     return readl(IE_STATUS) & IE_STATUS_LU;
 }
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
-    uint32_t n = eth->rx_rd_ptr;
-    uint64_t info = eth->rxd[n].info;
+status_t eth_rx(ethdev_t* eth, uint32_t q, void** data, size_t* len, uint32_t* csum) {
+    ie_queue_t* queue = &eth->queues[q];
+    uint32_t n = queue->rx_rd_ptr;
+    uint64_t info = queue->rxd[n].info;
 
     if (!(info & IE_RXD_DONE)) {
         return ZX_ERR_SHOULD_WAIT;
@@ -61,20 +76,32 @@ status_t eth_rx(ethdev_t* eth, void** data, size_t* len) {
     // copy out packet
     zx_status_t r = IE_RXD_LEN(info);
 
-    *data = eth->rxb + ETH_RXBUF_SIZE * n;
+    *data = queue->rxb + ETH_RXBUF_SIZE * n;
     *len = r;
 
+    // TCPCS covers UDP as well
+    *csum = 0;
+    if (!(info & IE_RXD_IXSM)) {
+        if ((info & IE_RXD_IPCS) && !(info & IE_RXD_IPE)) {
+            *csum |= ETH_RX_CSUM_IP_OK;
+        }
+        if ((info & IE_RXD_TCPCS) && !(info & IE_RXD_TCPE)) {
+            *csum |= ETH_RX_CSUM_L4_OK;
+        }
+    }
+
     return ZX_OK;
 }
 
-void eth_rx_ack(ethdev_t* eth) {
-    uint32_t n = eth->rx_rd_ptr;
+void eth_rx_ack(ethdev_t* eth, uint32_t q) {
+    ie_queue_t* queue = &eth->queues[q];
+    uint32_t n = queue->rx_rd_ptr;
 
     // make buffer available to hw
-    eth->rxd[n].info = 0;
-    writel(n, IE_RDT);
+    queue->rxd[n].info = 0;
+    writel(n, rxq_reg(q, IE_RDT));
     n = (n + 1) & (ETH_RXBUF_COUNT - 1);
-    eth->rx_rd_ptr = n;
+    queue->rx_rd_ptr = n;
 }
 
 void eth_enable_rx(ethdev_t* eth) {
@@ -87,69 +114,82 @@ void eth_disable_rx(ethdev_t* eth) {
     writel(rctl & ~IE_RCTL_EN, IE_RCTL);
 }
 
-static void reap_tx_buffers(ethdev_t* eth) {
-    uint32_t n = eth->tx_rd_ptr;
+static void reap_tx_buffers(ie_queue_t* queue) {
+    uint32_t n = queue->tx_rd_ptr;
     for (;;) {
-        uint64_t info = eth->txd[n].info;
+        uint64_t info = queue->txd[n].info;
         if (!(info & IE_TXD_DONE)) {
             break;
         }
-        framebuf_t* frame = list_remove_head_type(&eth->busy_frames, framebuf_t, node);
+        framebuf_t* frame = list_remove_head_type(&queue->busy_frames, framebuf_t, node);
         if (frame == NULL) {
             panic();
         }
         // TODO: verify that this is the matching buffer to txd[n] addr?
-        list_add_tail(&eth->free_frames, &frame->node);
-        eth->txd[n].info = 0;
+        list_add_tail(&queue->free_frames, &frame->node);
+        queue->txd[n].info = 0;
         n = (n + 1) & (ETH_TXBUF_COUNT - 1);
     }
-    eth->tx_rd_ptr = n;
+    queue->tx_rd_ptr = n;
 }
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
+status_t eth_tx(ethdev_t* eth, uint32_t q, const void* data, size_t len, uint32_t csum_start,
+                uint32_t csum_offset) {
     if (len > ETH_TXBUF_DSIZE) {
         printf("intel-eth: unsupported packet length %zu\n", len);
         return ZX_ERR_INVALID_ARGS;
     }
 
     zx_status_t status = ZX_OK;
+    ie_queue_t* queue = &eth->queues[q];
 
-    mtx_lock(&eth->send_lock);
+    mtx_lock(&queue->send_lock);
 
-    reap_tx_buffers(eth);
+    reap_tx_buffers(queue);
 
     // obtain buffer, copy into it, setup descriptor
-    framebuf_t *frame = list_remove_head_type(&eth->free_frames, framebuf_t, node);
+    framebuf_t *frame = list_remove_head_type(&queue->free_frames, framebuf_t, node);
     if (frame == NULL) {
         status = ZX_ERR_NO_RESOURCES;
         goto out;
     }
 
-    uint32_t n = eth->tx_wr_ptr;
+    uint32_t n = queue->tx_wr_ptr;
     memcpy(frame->data, data, len);
     // Pad out short packets.
     if (len < 60) {
       memset(frame->data + len, 0, 60 - len);
       len = 60;
     }
-    eth->txd[n].addr = frame->phys;
-    eth->txd[n].info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
-    list_add_tail(&eth->busy_frames, &frame->node);
+    queue->txd[n].addr = frame->phys;
+    queue->txd[n].info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
+    if (csum_offset) {
+        queue->txd[n].info |= IE_TXD_IC | IE_TXD_CSS(csum_start) | IE_TXD_CSO(csum_offset);
+    }
+    list_add_tail(&queue->busy_frames, &frame->node);
 
     // inform hw of buffer availability
     n = (n + 1) & (ETH_TXBUF_COUNT - 1);
-    eth->tx_wr_ptr = n;
-    writel(n, IE_TDT);
+    queue->tx_wr_ptr = n;
+    writel(n, txq_reg(q, IE_TDT));
 
 out:
-    mtx_unlock(&eth->send_lock);
+    mtx_unlock(&queue->send_lock);
     return status;
 }
 
-// Returns the number of Tx packets in the hw queue
+// Returns the number of Tx packets in the hw queues
 size_t eth_tx_queued(ethdev_t* eth) {
-    reap_tx_buffers(eth);
-    return ((eth->tx_wr_ptr + ETH_TXBUF_COUNT) - eth->tx_rd_ptr) & (ETH_TXBUF_COUNT - 1);
+    size_t queued = 0;
+    for (uint32_t q = 0; q < eth->queue_count; q++) {
+        ie_queue_t* queue = &eth->queues[q];
+        mtx_lock(&queue->send_lock);
+        reap_tx_buffers(queue);
+        queued += ((queue->tx_wr_ptr + ETH_TXBUF_COUNT) - queue->tx_rd_ptr) &
+                  (ETH_TXBUF_COUNT - 1);
+        mtx_unlock(&queue->send_lock);
+    }
+    return queued;
 }
 
 void eth_enable_tx(ethdev_t* eth) {
@@ -172,6 +212,25 @@ void eth_stop_promisc(ethdev_t* eth) {
     writel(rctl & ~IE_RCTL_UPE, IE_RCTL);
 }
 
+void eth_set_rss(ethdev_t* eth, uint32_t fields, const uint8_t* key, const uint8_t* table) {
+    // Stop hashing while the key and table change.
+    writel(0, IE_MRQC);
+    if (fields == 0) {
+        return;
+    }
+    for (uint32_t n = 0; n < IE_RSSRK_COUNT; n++) {
+        uint32_t reg;
+        memcpy(&reg, key + n * 4, sizeof(reg));
+        writel(reg, IE_RSSRK(n));
+    }
+    for (uint32_t n = 0; n < IE_RETA_COUNT; n++) {
+        uint32_t reg;
+        memcpy(&reg, table + n * 4, sizeof(reg));
+        writel(reg, IE_RETA(n));
+    }
+    writel(IE_MRQC_RSS | fields, IE_MRQC);
+}
+
 static zx_status_t wait_for_mdic(ethdev_t* eth, uint32_t* reg_value) {
     uint32_t mdic;
     uint32_t iterations = 0;
@@ -335,49 +394,58 @@ void eth_init_hw(ethdev_t* eth) {
 
     usleep(15);
 
-    // setup rx ring
-    eth->rx_rd_ptr = 0;
-    writel(eth->rxd_phys, IE_RDBAL);
-    writel(eth->rxd_phys >> 32, IE_RDBAH);
-    writel(ETH_RXBUF_COUNT * 16, IE_RDLEN);
-
-    reg = IE_RXDCTL_PTHRESH(12) | IE_RXDCTL_HTHRESH(10) | IE_RXDCTL_WTHRESH(1);
-    if (eth->pci_did == IE_DID_I211_AT) {
-        reg |= IE_RXDCTL_ENABLE;
-    } else {
-        reg |= IE_RXDCTL_GRAN;
-    }
-    writel(reg, IE_RXDCTL);
+    // setup rx rings; every packet is received on queue 0 until RSS is
+    // configured
+    writel(0, IE_MRQC);
+    for (uint32_t q = 0; q < eth->queue_count; q++) {
+        ie_queue_t* queue = &eth->queues[q];
+        queue->rx_rd_ptr = 0;
+        writel(queue->rxd_phys, rxq_reg(q, IE_RDBAL));
+        writel(queue->rxd_phys >> 32, rxq_reg(q, IE_RDBAH));
+        writel(ETH_RXBUF_COUNT * 16, rxq_reg(q, IE_RDLEN));
+
+        reg = IE_RXDCTL_PTHRESH(12) | IE_RXDCTL_HTHRESH(10) | IE_RXDCTL_WTHRESH(1);
+        if (eth->pci_did == IE_DID_I211_AT) {
+            reg |= IE_RXDCTL_ENABLE;
+        } else {
+            reg |= IE_RXDCTL_GRAN;
+        }
+        writel(reg, rxq_reg(q, IE_RXDCTL));
 
-    // wait for enable to complete
-    if (eth->pci_did == IE_DID_I211_AT) {
-        while (!(readl(IE_RXDCTL) & IE_RXDCTL_ENABLE)) {
+        // wait for enable to complete
+        if (eth->pci_did == IE_DID_I211_AT) {
+            while (!(readl(rxq_reg(q, IE_RXDCTL)) & IE_RXDCTL_ENABLE)) {
+            }
         }
-    }
 
-    writel(ETH_RXBUF_COUNT - 1, IE_RDT);
+        writel(ETH_RXBUF_COUNT - 1, rxq_reg(q, IE_RDT));
+    }
+    writel(IE_RXCSUM_IPOFLD | IE_RXCSUM_TUOFLD, IE_RXCSUM);
     writel(IE_RCTL_BSIZE2048 | IE_RCTL_DPF | IE_RCTL_SECRC |
            IE_RCTL_BAM | IE_RCTL_MPE | IE_RCTL_EN,
            IE_RCTL);
 
-    // setup tx ring
-    eth->tx_wr_ptr = 0;
-    eth->tx_rd_ptr = 0;
-    writel(eth->txd_phys, IE_TDBAL);
-    writel(eth->txd_phys >> 32, IE_TDBAH);
-    writel(ETH_TXBUF_COUNT * 16, IE_TDLEN);
-
-    reg = IE_TXDCTL_WTHRESH(1);
-    if (eth->pci_did == IE_DID_I211_AT) {
-        reg |= IE_TXDCTL_ENABLE;
-    } else {
-        reg |= IE_TXDCTL_GRAN;
-    }
-    writel(reg, IE_TXDCTL);
+    // setup tx rings
+    for (uint32_t q = 0; q < eth->queue_count; q++) {
+        ie_queue_t* queue = &eth->queues[q];
+        queue->tx_wr_ptr = 0;
+        queue->tx_rd_ptr = 0;
+        writel(queue->txd_phys, txq_reg(q, IE_TDBAL));
+        writel(queue->txd_phys >> 32, txq_reg(q, IE_TDBAH));
+        writel(ETH_TXBUF_COUNT * 16, txq_reg(q, IE_TDLEN));
+
+        reg = IE_TXDCTL_WTHRESH(1);
+        if (eth->pci_did == IE_DID_I211_AT) {
+            reg |= IE_TXDCTL_ENABLE;
+        } else {
+            reg |= IE_TXDCTL_GRAN;
+        }
+        writel(reg, txq_reg(q, IE_TXDCTL));
 
-    // wait for enable to complete
-    if (eth->pci_did == IE_DID_I211_AT) {
-        while (!(readl(IE_TXDCTL) & IE_TXDCTL_ENABLE)) {
+        // wait for enable to complete
+        if (eth->pci_did == IE_DID_I211_AT) {
+            while (!(readl(txq_reg(q, IE_TXDCTL)) & IE_TXDCTL_ENABLE)) {
+            }
         }
     }
 
@@ -402,36 +470,42 @@ void eth_init_hw(ethdev_t* eth) {
 void eth_setup_buffers(ethdev_t* eth, void* iomem, zx_paddr_t iophys) {
     printf("eth: iomem @%p (phys %" PRIxPTR ")\n", iomem, iophys);
 
-    list_initialize(&eth->free_frames);
-    list_initialize(&eth->busy_frames);
-
-    eth->rxd = iomem;
-    eth->rxd_phys = iophys;
-    iomem += ETH_DRING_SIZE;
-    iophys += ETH_DRING_SIZE;
-    memset(eth->rxd, 0, ETH_DRING_SIZE);
-
-    eth->txd = iomem;
-    eth->txd_phys = iophys;
-    iomem += ETH_DRING_SIZE;
-    iophys += ETH_DRING_SIZE;
-    memset(eth->txd, 0, ETH_DRING_SIZE);
-
-    eth->rxb = iomem;
-    eth->rxb_phys = iophys;
-    iomem += ETH_RXBUF_SIZE * ETH_RXBUF_COUNT;
-    iophys += ETH_RXBUF_SIZE * ETH_RXBUF_COUNT;
-
-    for (int n = 0; n < ETH_RXBUF_COUNT; n++) {
-        eth->rxd[n].addr = eth->rxb_phys + ETH_RXBUF_SIZE * n;
-    }
-    for (int n = 0; n < ETH_TXBUF_COUNT - 1; n++) {
-        framebuf_t *txb = iomem;
-        txb->phys = iophys + ETH_TXBUF_HSIZE;
-        txb->size = ETH_TXBUF_SIZE - ETH_TXBUF_HSIZE;
-        txb->data = iomem + ETH_TXBUF_HSIZE;
-        list_add_tail(&eth->free_frames, &txb->node);
-
+    for (uint32_t q = 0; q < eth->queue_count; q++) {
+        ie_queue_t* queue = &eth->queues[q];
+        list_initialize(&queue->free_frames);
+        list_initialize(&queue->busy_frames);
+
+        queue->rxd = iomem;
+        queue->rxd_phys = iophys;
+        iomem += ETH_DRING_SIZE;
+        iophys += ETH_DRING_SIZE;
+        memset(queue->rxd, 0, ETH_DRING_SIZE);
+
+        queue->txd = iomem;
+        queue->txd_phys = iophys;
+        iomem += ETH_DRING_SIZE;
+        iophys += ETH_DRING_SIZE;
+        memset(queue->txd, 0, ETH_DRING_SIZE);
+
+        queue->rxb = iomem;
+        queue->rxb_phys = iophys;
+        iomem += ETH_RXBUF_SIZE * ETH_RXBUF_COUNT;
+        iophys += ETH_RXBUF_SIZE * ETH_RXBUF_COUNT;
+
+        for (int n = 0; n < ETH_RXBUF_COUNT; n++) {
+            queue->rxd[n].addr = queue->rxb_phys + ETH_RXBUF_SIZE * n;
+        }
+        // The last tx buffer of a queue is left unused.
+        for (int n = 0; n < ETH_TXBUF_COUNT - 1; n++) {
+            framebuf_t *txb = iomem;
+            txb->phys = iophys + ETH_TXBUF_HSIZE;
+            txb->size = ETH_TXBUF_SIZE - ETH_TXBUF_HSIZE;
+            txb->data = iomem + ETH_TXBUF_HSIZE;
+            list_add_tail(&queue->free_frames, &txb->node);
+
+            iomem += ETH_TXBUF_SIZE;
+            iophys += ETH_TXBUF_SIZE;
+        }
         iomem += ETH_TXBUF_SIZE;
         iophys += ETH_TXBUF_SIZE;
     }
@@ -12,6 +12,7 @@
 #define IE_DID_I219_LM 0x156f
 
 typedef struct framebuf framebuf_t;
+typedef struct ie_queue ie_queue_t;
 typedef struct ethdev ethdev_t;
 
 struct framebuf {
@@ -21,9 +22,8 @@ struct framebuf {
     size_t size;
 };
 
-struct ethdev {
-    uintptr_t iobase;
-
+// One rx/tx queue pair
+struct ie_queue {
     // tx/rx descriptor rings
     ie_txd_t* txd;
     ie_rxd_t* rxd;
@@ -43,10 +43,20 @@ struct ethdev {
     uint64_t rxb_phys;
     void* rxb;
 
+    mtx_t send_lock;
+};
+
+#define ETH_MAX_QUEUES 2
+
+struct ethdev {
+    uintptr_t iobase;
+
+    ie_queue_t queues[ETH_MAX_QUEUES];
+    uint32_t queue_count;
+
     uint8_t mac[6];
 
     uint8_t phy_addr;
-    mtx_t send_lock;
 
     uint16_t pci_did;
 };
@@ -63,9 +73,15 @@ struct ethdev {
 
 #define ETH_DRING_SIZE 2048
 
-#define ETH_ALLOC ((ETH_RXBUF_SIZE * ETH_RXBUF_COUNT) + \
-                   (ETH_TXBUF_SIZE * ETH_TXBUF_COUNT) + \
-                   (ETH_DRING_SIZE * 2))
+// The memory of one queue pair
+#define ETH_QUEUE_ALLOC ((ETH_RXBUF_SIZE * ETH_RXBUF_COUNT) + \
+                         (ETH_TXBUF_SIZE * ETH_TXBUF_COUNT) + \
+                         (ETH_DRING_SIZE * 2))
+
+#define ETH_ALLOC(queues) (ETH_QUEUE_ALLOC * (queues))
+
+// The number of queue pairs the controller is run with
+uint32_t eth_queue_count(uint16_t pci_did);
 
 status_t eth_reset_hw(ethdev_t* eth);
 void eth_setup_buffers(ethdev_t* eth, void* iomem, uintptr_t iophys);
@@ -73,12 +89,20 @@ void eth_init_hw(ethdev_t* eth);
 
 void eth_dump_regs(ethdev_t* eth);
 
-status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
-void eth_rx_ack(ethdev_t* eth);
+// eth_rx() |csum| flags, for the checksums the controller found valid
+#define ETH_RX_CSUM_IP_OK (1u)
+#define ETH_RX_CSUM_L4_OK (2u)
+
+status_t eth_rx(ethdev_t* eth, uint32_t q, void** data, size_t* len, uint32_t* csum);
+void eth_rx_ack(ethdev_t* eth, uint32_t q);
 void eth_enable_rx(ethdev_t* eth);
 void eth_disable_rx(ethdev_t* eth);
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
+// Sends the |len| bytes of |data|. If |csum_offset| is not 0, the controller
+// stores the checksum of the bytes from |csum_start| to the end of the packet
+// there; both are below 256.
+status_t eth_tx(ethdev_t* eth, uint32_t q, const void* data, size_t len, uint32_t csum_start,
+                uint32_t csum_offset);
 size_t eth_tx_queued(ethdev_t* eth);
 void eth_enable_tx(ethdev_t* eth);
 void eth_disable_tx(ethdev_t* eth);
@@ -86,6 +110,12 @@ void eth_disable_tx(ethdev_t* eth);
 void eth_start_promisc(ethdev_t* eth);
 void eth_stop_promisc(ethdev_t* eth);
 
+// Spreads received packets across the queues: the hash of the headers in
+// |fields|, a set of IE_MRQC_ hash bits, keyed by the 40 bytes of |key|,
+// selects the entry of the 128-entry |table| holding a packet's queue. No
+// |fields| receives everything on queue 0.
+void eth_set_rss(ethdev_t* eth, uint32_t fields, const uint8_t* key, const uint8_t* table);
+
 zx_status_t eth_enable_phy(ethdev_t* eth);
 zx_status_t eth_disable_phy(ethdev_t* eth);
 
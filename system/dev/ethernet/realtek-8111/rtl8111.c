@@ -11,6 +11,7 @@
 #include <ddk/protocol/ethernet.h>
 #include <ddk/protocol/pci.h>
 #include <ddk/protocol/pci-lib.h>
+#include <hw/arch_ops.h>
 #include <hw/reg.h>
 
 #include <zircon/types.h>
@@ -153,6 +154,23 @@ static void rtl8111_init_regs(ethernet_device_t* edev) {
             edev->online ? "online" : "offline");
 }
 
+// The checksums the controller found valid in a received packet
+static uint32_t rtl8111_rx_csum(const eth_desc_t* rxd) {
+    uint32_t flags = 0;
+    uint32_t proto = rxd->status1 & RX_DESC_PROTO_MASK;
+    if (proto == 0) {
+        return flags;
+    }
+    if ((rxd->status2 & RX_DESC2_V4) && !(rxd->status1 & RX_DESC_IPF)) {
+        flags |= ETHMAC_RX_CSUM_IPV4_OK;
+    }
+    if ((proto == RX_DESC_PROTO_TCP && !(rxd->status1 & RX_DESC_TCPF)) ||
+        (proto == RX_DESC_PROTO_UDP && !(rxd->status1 & RX_DESC_UDPF))) {
+        flags |= ETHMAC_RX_CSUM_L4_OK;
+    }
+    return flags;
+}
+
 static int irq_thread(void* arg) {
     ethernet_device_t* edev = arg;
     while (1) {
@@ -185,8 +203,8 @@ static int irq_thread(void* arg) {
             while (!((rxd = edev->rxd_ring + edev->rxd_idx)->status1 & RX_DESC_OWN)) {
                 if (edev->ifc) {
                     size_t len = rxd->status1 & RX_DESC_LEN_MASK;
-                    edev->ifc->recv(
-                        edev->cookie, edev->rxb + (edev->rxd_idx * ETH_BUF_SIZE), len, 0);
+                    edev->ifc->recv(edev->cookie, edev->rxb + (edev->rxd_idx * ETH_BUF_SIZE),
+                                    len, rtl8111_rx_csum(rxd));
                 } else {
                     zxlogf(ERROR, "rtl8111: No ethmac callback, dropping packet\n");
                 }
@@ -214,6 +232,8 @@ static zx_status_t rtl8111_query(void* ctx, uint32_t options, ethmac_info_t* inf
 
     memset(info, 0, sizeof(*info));
     info->mtu = ETH_BUF_SIZE;
+    info->features = ETHMAC_FEATURE_TX_CSUM_IPV4 | ETHMAC_FEATURE_TX_CSUM_L4 |
+                     ETHMAC_FEATURE_TSO | ETHMAC_FEATURE_RX_CSUM;
     memcpy(info->mac, edev->mac, sizeof(edev->mac));
 
     return ZX_OK;
@@ -243,22 +263,76 @@ static zx_status_t rtl8111_start(void* ctx, ethmac_ifc_t* ifc, void* cookie) {
     return status;
 }
 
+// The bits of both words of the tx descriptors which ask for the offloads of
+// |netbuf|.
+static zx_status_t rtl8111_tx_offload(const ethmac_netbuf_t* netbuf, uint32_t* status1,
+                                      uint32_t* status2) {
+    const ethmac_tx_offload_t* offload = &netbuf->offload;
+    *status1 = 0;
+    *status2 = 0;
+    if (offload->flags == 0) {
+        return ZX_OK;
+    }
+    const uint8_t* ip = (const uint8_t*)netbuf->data + offload->l3_offset;
+    const bool ipv6 = (ip[0] >> 4) == 6;
+    if (offload->flags & ETHMAC_TX_OFFLOAD_TSO) {
+        if (offload->l4_offset > TX_DESC_GTTCPHO_MAX || offload->mss > TX_DESC2_MSS_MAX) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        // The controller fills in the checksums of each segment.
+        *status1 = (ipv6 ? TX_DESC_GTSENV6 : TX_DESC_GTSENV4) |
+                   ((uint32_t)offload->l4_offset << TX_DESC_GTTCPHO_SHIFT);
+        *status2 = (uint32_t)offload->mss << TX_DESC2_MSS_SHIFT;
+        return ZX_OK;
+    }
+    if (offload->flags & ETHMAC_TX_OFFLOAD_IPV4_CSUM) {
+        *status2 |= TX_DESC2_IPCS;
+    }
+    if (offload->flags & (ETHMAC_TX_OFFLOAD_TCP_CSUM | ETHMAC_TX_OFFLOAD_UDP_CSUM)) {
+        if (offload->l4_offset > TX_DESC2_TCPHO_MAX) {
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        *status2 |= (offload->flags & ETHMAC_TX_OFFLOAD_TCP_CSUM ? TX_DESC2_TCPCS
+                                                                 : TX_DESC2_UDPCS) |
+                    (ipv6 ? TX_DESC2_IPV6 : 0) |
+                    ((uint32_t)offload->l4_offset << TX_DESC2_TCPHO_SHIFT);
+    }
+    return ZX_OK;
+}
+
 static zx_status_t rtl8111_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t* netbuf) {
     size_t length = netbuf->len;
-    if (length > ETH_BUF_SIZE) {
+    size_t max_length = netbuf->offload.flags & ETHMAC_TX_OFFLOAD_TSO ? ETH_TSO_MAX_SIZE
+                                                                      : ETH_BUF_SIZE;
+    if (length > max_length) {
         zxlogf(ERROR, "rtl8111: Unsupported packet length %zu\n", length);
         return ZX_ERR_INVALID_ARGS;
     }
+    uint32_t status1;
+    uint32_t status2;
+    zx_status_t status = rtl8111_tx_offload(netbuf, &status1, &status2);
+    if (status != ZX_OK) {
+        return status;
+    }
     ethernet_device_t* edev = ctx;
 
+    // A large send is split across as many tx buffers as it needs, and the
+    // controller frees them in order, so the last one being free means they
+    // all are.
+    int count = (int)((length + ETH_BUF_SIZE - 1) / ETH_BUF_SIZE);
+    if (count == 0) {
+        count = 1;
+    }
+
     mtx_lock(&edev->tx_lock);
 
-    if (edev->txd_ring[edev->txd_idx].status1 & TX_DESC_OWN) {
+    int last_idx = (edev->txd_idx + count - 1) % ETH_BUF_COUNT;
+    if (edev->txd_ring[last_idx].status1 & TX_DESC_OWN) {
         mtx_lock(&edev->lock);
         WRITE16(RTL_IMR, READ16(RTL_IMR) | RTL_INT_TOK);
         WRITE16(RTL_ISR, RTL_INT_TOK);
 
-        while (edev->txd_ring[edev->txd_idx].status1 & TX_DESC_OWN) {
+        while (edev->txd_ring[last_idx].status1 & TX_DESC_OWN) {
             zxlogf(TRACE, "rtl8111: Waiting for buffer\n");
             cnd_wait(&edev->tx_cond, &edev->lock);
         }
@@ -267,15 +341,28 @@ static zx_status_t rtl8111_queue_tx(void* ctx, uint32_t options, ethmac_netbuf_t
         mtx_unlock(&edev->lock);
     }
 
-    memcpy(edev->txb + (edev->txd_idx * ETH_BUF_SIZE), netbuf->data, length);
-
-    bool is_end = edev->txd_idx == (ETH_BUF_COUNT - 1);
-    edev->txd_ring[edev->txd_idx].status1 =
-        (is_end ? TX_DESC_EOR : 0) | length | TX_DESC_OWN | TX_DESC_FS | TX_DESC_LS;
+    // Hand the first descriptor to the controller last, once the rest of the
+    // packet is in place.
+    const uint8_t* data = netbuf->data;
+    int first_idx = edev->txd_idx;
+    for (int i = count - 1; i >= 0; i--) {
+        int idx = (first_idx + i) % ETH_BUF_COUNT;
+        size_t chunk = i == count - 1 ? length - (size_t)i * ETH_BUF_SIZE : ETH_BUF_SIZE;
+        memcpy(edev->txb + (idx * ETH_BUF_SIZE), data + (size_t)i * ETH_BUF_SIZE, chunk);
+
+        bool is_end = idx == (ETH_BUF_COUNT - 1);
+        eth_desc_t* txd = &edev->txd_ring[idx];
+        txd->status2 = status2;
+        if (i == 0) {
+            hw_wmb();
+        }
+        txd->status1 = (is_end ? TX_DESC_EOR : 0) | (uint32_t)chunk | status1 | TX_DESC_OWN |
+                       (i == 0 ? TX_DESC_FS : 0) | (i == count - 1 ? TX_DESC_LS : 0);
+    }
 
     WRITE8(RTL_TPPOLL, READ8(RTL_TPPOLL) | RTL_TPPOLL_NPQ);
 
-    edev->txd_idx = (edev->txd_idx + 1) % ETH_BUF_COUNT;
+    edev->txd_idx = (first_idx + count) % ETH_BUF_COUNT;
 
     mtx_unlock(&edev->tx_lock);
     return ZX_OK;
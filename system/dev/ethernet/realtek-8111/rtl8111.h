@@ -9,8 +9,7 @@
 // TODO(stevensd): Handle errors (rx/tx/checksum/...)
 // TODO(stevensd): Add support for VLAN tagging
 // TODO(stevensd): Add support for multicast filtering
-// TODO(stevensd): Surface hardware support for checksums to the netstack
-// TODO(stevensd): Support jumbo packet and large send
+// TODO(stevensd): Support jumbo packet
 
 // A ton of realtek controllers match this driver's VID/DID. This driver has only been tested
 // on the 8111h rev2 (i.e. 0x54100000), but it should work (or mostly work) with any model of
@@ -21,6 +20,7 @@
 
 #define ETH_BUF_SIZE ROUNDDOWN(1522, 8) // maximum ethernet frame, rtl8111 requires 8 byte size
 #define ETH_BUF_COUNT 64
+#define ETH_TSO_MAX_SIZE 0xffff // a large send spans several tx buffers
 #define ETH_DESC_ELT_SIZE 16
 #define ETH_DESC_RING_SIZE (ETH_DESC_ELT_SIZE * ETH_BUF_COUNT)
 
@@ -85,8 +85,31 @@
 #define TX_DESC_EOR (1 << 30)
 #define TX_DESC_FS (1 << 29)
 #define TX_DESC_LS (1 << 28)
+#define TX_DESC_GTSENV4 (1 << 26) // Large send of TCP over IPv4
+#define TX_DESC_GTSENV6 (1 << 25) // Large send of TCP over IPv6
+#define TX_DESC_GTTCPHO_SHIFT 18  // Offset of the TCP header, for large send
 #define TX_DESC_LEN_MASK 0xffff
 
+// The second word of a tx descriptor
+#define TX_DESC2_UDPCS (1u << 31)
+#define TX_DESC2_TCPCS (1 << 30)
+#define TX_DESC2_IPCS (1 << 29)
+#define TX_DESC2_IPV6 (1 << 28)
+#define TX_DESC2_MSS_SHIFT 18     // Segment size, for large send
+#define TX_DESC2_TCPHO_SHIFT 18   // Offset of the TCP or UDP header, for checksums
+#define TX_DESC_GTTCPHO_MAX 0x7f
+#define TX_DESC2_TCPHO_MAX 0x3ff
+#define TX_DESC2_MSS_MAX 0x7ff
+
 #define RX_DESC_OWN (1 << 31)
 #define RX_DESC_EOR (1 << 30)
+#define RX_DESC_PROTO_MASK (3 << 17)
+#define RX_DESC_PROTO_TCP (1 << 17)
+#define RX_DESC_PROTO_UDP (2 << 17)
+#define RX_DESC_IPF (1 << 16)     // IP checksum failed
+#define RX_DESC_UDPF (1 << 15)    // UDP checksum failed
+#define RX_DESC_TCPF (1 << 14)    // TCP checksum failed
 #define RX_DESC_LEN_MASK 0x3fff
+
+// The second word of an rx descriptor
+#define RX_DESC2_V4 (1 << 30)     // IPv4 packet
@@ -543,22 +543,6 @@ static zx_status_t x86_pt_alloc_buffer(insntrace_device_t* dev,
     return ZX_OK;
 }
 
-static zx_status_t x86_pt_assign_thread_buffer(insntrace_device_t* dev,
-                                               zx_itrace_buffer_descriptor_t descriptor,
-                                               zx_handle_t thread) {
-    zx_handle_close(thread);
-    // TODO(dje): Thread support is still work-in-progress.
-    return ZX_ERR_NOT_SUPPORTED;
-}
-
-static zx_status_t x86_pt_release_thread_buffer(insntrace_device_t* dev,
-                                                zx_itrace_buffer_descriptor_t descriptor,
-                                                zx_handle_t thread) {
-    zx_handle_close(thread);
-    // TODO(dje): Thread support is still work-in-progress.
-    return ZX_ERR_NOT_SUPPORTED;
-}
-
 static zx_status_t x86_pt_free_buffer(insntrace_device_t* dev,
                                       zx_itrace_buffer_descriptor_t descriptor) {
     if (dev->active)
@@ -624,6 +608,88 @@ static zx_status_t x86_pt_get_trace_data(insntrace_device_t* dev, zx_handle_t re
     return ZX_OK;
 }
 
+static zx_status_t x86_pt_assign_thread_buffer1(insntrace_device_t* dev,
+                                                zx_itrace_buffer_descriptor_t descriptor,
+                                                zx_handle_t thread) {
+    if (dev->mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (descriptor >= dev->num_traces)
+        return ZX_ERR_INVALID_ARGS;
+    ipt_per_trace_state_t* per_trace = &dev->per_trace_state[descriptor];
+    if (!per_trace->allocated)
+        return ZX_ERR_INVALID_ARGS;
+    if (per_trace->assigned)
+        return ZX_ERR_BAD_STATE;
+
+    zx_handle_t resource = get_root_resource();
+    zx_status_t status = x86_pt_stage_trace_data(dev, resource, descriptor);
+    if (status != ZX_OK)
+        return status;
+    status = zx_mtrace_control(resource, MTRACE_KIND_INSNTRACE,
+                               MTRACE_INSNTRACE_ASSIGN_THREAD_BUFFER,
+                               descriptor, &thread, sizeof(thread));
+    if (status != ZX_OK)
+        return status;
+
+    per_trace->owner.thread = thread;
+    per_trace->assigned = true;
+    return ZX_OK;
+}
+
+// The buffer keeps |thread| to identify its thread until it is released.
+
+static zx_status_t x86_pt_assign_thread_buffer(insntrace_device_t* dev,
+                                               zx_itrace_buffer_descriptor_t descriptor,
+                                               zx_handle_t thread) {
+    zx_status_t status = x86_pt_assign_thread_buffer1(dev, descriptor, thread);
+    if (status != ZX_OK)
+        zx_handle_close(thread);
+    return status;
+}
+
+static zx_status_t x86_pt_release_thread_buffer1(insntrace_device_t* dev,
+                                                 zx_itrace_buffer_descriptor_t descriptor,
+                                                 zx_handle_t thread) {
+    if (dev->mode != IPT_TRACE_THREADS)
+        return ZX_ERR_BAD_STATE;
+    if (descriptor >= dev->num_traces)
+        return ZX_ERR_INVALID_ARGS;
+    ipt_per_trace_state_t* per_trace = &dev->per_trace_state[descriptor];
+    if (!per_trace->assigned)
+        return ZX_ERR_INVALID_ARGS;
+
+    // The kernel checks that |thread| is the one the buffer was assigned to.
+    zx_handle_t resource = get_root_resource();
+    zx_status_t status = zx_mtrace_control(resource, MTRACE_KIND_INSNTRACE,
+                                           MTRACE_INSNTRACE_RELEASE_THREAD_BUFFER,
+                                           descriptor, &thread, sizeof(thread));
+    if (status != ZX_OK)
+        return status;
+
+    zx_handle_close(per_trace->owner.thread);
+    per_trace->owner.thread = ZX_HANDLE_INVALID;
+    per_trace->assigned = false;
+
+    // The MSRs now say where the thread's trace stopped.
+    status = x86_pt_get_trace_data(dev, resource, descriptor);
+    if (status != ZX_OK)
+        return status;
+    // If there was an operational error, report it.
+    if (per_trace->status & IPT_STATUS_ERROR_MASK) {
+        printf("%s: WARNING: operational error detected on buffer %u\n",
+               __func__, descriptor);
+    }
+    return ZX_OK;
+}
+
+static zx_status_t x86_pt_release_thread_buffer(insntrace_device_t* dev,
+                                                zx_itrace_buffer_descriptor_t descriptor,
+                                                zx_handle_t thread) {
+    zx_status_t status = x86_pt_release_thread_buffer1(dev, descriptor, thread);
+    zx_handle_close(thread);
+    return status;
+}
+
 
 // ioctl handlers
 
@@ -643,10 +709,6 @@ static zx_status_t ipt_alloc_trace(insntrace_device_t* dev,
         return ZX_ERR_INVALID_ARGS;
     memcpy(&config, cmd, sizeof(config));
 
-    // TODO(dje): Until thread tracing is supported.
-    if (config.mode == IPT_MODE_THREADS)
-        return ZX_ERR_NOT_SUPPORTED;
-
     ipt_trace_mode_t internal_mode;
     switch (config.mode) {
     case IPT_MODE_CPUS:
@@ -895,14 +957,12 @@ static zx_status_t ipt_free_buffer(insntrace_device_t* dev,
 }
 
 // Begin tracing.
-// This is basically a nop in thread mode, it is still used for thread-mode
-// for consistency and in case we some day need it to do something.
+// In thread mode this starts tracing each thread with a buffer assigned,
+// as well as threads assigned one later on.
 
 static zx_status_t ipt_start(insntrace_device_t* dev) {
     if (dev->active)
         return ZX_ERR_BAD_STATE;
-    if (dev->mode != IPT_TRACE_CPUS)
-        return ZX_ERR_BAD_STATE;
 
     zx_handle_t resource = get_root_resource();
     zx_status_t status;
@@ -942,9 +1002,8 @@ static zx_status_t ipt_start(insntrace_device_t* dev) {
 }
 
 // Stop tracing.
-// In thread-mode all buffers must be released first. That is how we know that
-// if we return ZX_OK then all threads are no longer being traced. Otherwise,
-// this is basically a nop in thread-mode.
+// In thread mode buffers stay assigned to their threads; the status of a
+// thread's trace is collected when its buffer is released.
 
 static zx_status_t ipt_stop(insntrace_device_t* dev) {
     if (!dev->active)
@@ -1097,6 +1156,13 @@ static void insntrace_release(void* ctx) {
     // TODO(dje): None of these should fail. What to do?
     // For now flag things as busted and prevent further use.
     ipt_stop(dev);
+    if (dev->per_trace_state && dev->mode == IPT_TRACE_THREADS) {
+        for (uint32_t i = 0; i < dev->num_traces; ++i) {
+            ipt_per_trace_state_t* per_trace = &dev->per_trace_state[i];
+            if (per_trace->assigned)
+                x86_pt_release_thread_buffer1(dev, i, per_trace->owner.thread);
+        }
+    }
     ipt_free_trace(dev);
 
     zx_handle_close(dev->bti);
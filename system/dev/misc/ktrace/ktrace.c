@@ -72,6 +72,14 @@ static zx_status_t ktrace_ioctl(void* ctx, uint32_t op,
         uint32_t group_mask = *(uint32_t *)cmd;
         return zx_ktrace_control(get_root_resource(), KTRACE_ACTION_START, group_mask, NULL);
     }
+    case IOCTL_KTRACE_START_STREAMING: {
+        if (cmdlen != sizeof(uint32_t)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        uint32_t group_mask = *(uint32_t *)cmd;
+        return zx_ktrace_control(get_root_resource(), KTRACE_ACTION_START_STREAMING,
+                                 group_mask, NULL);
+    }
     case IOCTL_KTRACE_STOP: {
         zx_ktrace_control(get_root_resource(), KTRACE_ACTION_STOP, 0, NULL);
         zx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0, NULL);
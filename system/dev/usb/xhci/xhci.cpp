@@ -28,8 +28,12 @@
 // The Interrupter Moderation Interval prevents the controller from sending interrupts too often.
 // According to XHCI Rev 1.1 4.17.2, the default is 4000 (= 1 ms). We set it to 1000 (= 250 us) to
 // get better latency on completions for bulk transfers; setting it too low seems to destabilize the
-// system.
-#define XHCI_IMODI_VAL      1000
+// system.  The isochronous interrupter only sees periodic completions, so it can afford to be
+// moderated to a single microframe (= 125 us).
+#define XHCI_IMODI_VAL          1000
+#define XHCI_ISOCH_IMODI_VAL    500
+// IMODI is in units of 250 ns.
+#define XHCI_IMODI_PER_USEC     4
 
 uint8_t xhci_endpoint_index(uint8_t ep_address) {
     if (ep_address == 0) return 0;
@@ -378,13 +382,28 @@ static void xhci_update_erdp(xhci_t* xhci, int interrupter) {
     XHCI_WRITE64(&intr_regs->erdp, erdp);
 }
 
+// Returns the moderation interval for |interrupter|, which may be overridden in microseconds by
+// driver.usb_xhci.imod (or driver.usb_xhci.isoch_imod for the isochronous interrupter).
+static uint32_t xhci_get_imodi(xhci_t* xhci, int interrupter) {
+    bool isoch = (interrupter == ISOCH_INTERRUPTER && xhci->num_interrupts > 1);
+    const char* value = getenv(isoch ? "driver.usb_xhci.isoch_imod" : "driver.usb_xhci.imod");
+    if (value == nullptr) {
+        return isoch ? XHCI_ISOCH_IMODI_VAL : XHCI_IMODI_VAL;
+    }
+    unsigned long usec = strtoul(value, nullptr, 10);
+    if (usec > IMODI_MASK / XHCI_IMODI_PER_USEC) {
+        return IMODI_MASK;
+    }
+    return static_cast<uint32_t>(usec * XHCI_IMODI_PER_USEC);
+}
+
 static void xhci_interrupter_init(xhci_t* xhci, int interrupter) {
     xhci_intr_regs_t* intr_regs = &xhci->runtime_regs->intr_regs[interrupter];
 
     xhci_update_erdp(xhci, interrupter);
 
     XHCI_SET32(&intr_regs->iman, IMAN_IE, IMAN_IE);
-    XHCI_SET32(&intr_regs->imod, IMODI_MASK, XHCI_IMODI_VAL);
+    XHCI_SET32(&intr_regs->imod, IMODI_MASK, xhci_get_imodi(xhci, interrupter));
     XHCI_SET32(&intr_regs->erstsz, ERSTSZ_MASK, ERST_ARRAY_SIZE);
     XHCI_WRITE64(&intr_regs->erstba, xhci->erst_arrays_phys[interrupter]);
 }
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <string.h>
+
 #include <vector>
 
 #include <blobfs/host.h>
@@ -50,12 +52,7 @@ private:
                 rhs.digest.ReleaseBytes();
             });
 
-            for (size_t i = 0; i < digest::Digest::kLength; i++) {
-                if (lhs_bytes[i] < rhs_bytes[i]) {
-                    return true;
-                }
-            }
-            return false;
+            return memcmp(lhs_bytes, rhs_bytes, digest::Digest::kLength) < 0;
         }
     };
 
@@ -3,6 +3,9 @@
 // found in the LICENSE file.
 
 #include <algorithm>
+#include <array>
+#include <mutex>
+#include <set>
 #include <thread>
 #include <vector>
 
@@ -113,6 +116,9 @@ zx_status_t BlobfsCreator::ProcessCustom(int argc, char** argv, uint8_t* process
 }
 
 zx_status_t BlobfsCreator::CalculateRequiredSize(off_t* out) {
+    // A pool of workers computes merkle roots, and compresses each blob the
+    // first time its merkle root is seen.  Duplicates are dropped before any
+    // time is spent compressing them.
     std::vector<std::thread> threads;
     unsigned blob_index = 0;
     unsigned n_threads = std::thread::hardware_concurrency();
@@ -121,6 +127,7 @@ zx_status_t BlobfsCreator::CalculateRequiredSize(off_t* out) {
     }
     zx_status_t status = ZX_OK;
     std::mutex mtx;
+    std::set<std::array<uint8_t, digest::Digest::kLength>> digests;
     for (unsigned j = n_threads; j > 0; j--) {
         threads.push_back(std::thread([&] {
             unsigned i = 0;
@@ -146,9 +153,31 @@ zx_status_t BlobfsCreator::CalculateRequiredSize(off_t* out) {
 
                 blobfs::MerkleInfo info;
                 fbl::unique_fd data_fd(open(path, O_RDONLY, 0644));
+                if (!data_fd) {
+                    fprintf(stderr, "error: cannot open '%s'\n", path);
+                    res = ZX_ERR_IO;
+                } else {
+                    res = blobfs::blobfs_create_merkle(data_fd.get(), &info);
+                }
+                if (res != ZX_OK) {
+                    mtx.lock();
+                    status = res;
+                    mtx.unlock();
+                    return;
+                }
 
-                if ((res = blobfs::blobfs_preprocess(data_fd.get(), ShouldCompress(), &info))
-                    != ZX_OK) {
+                std::array<uint8_t, digest::Digest::kLength> digest;
+                info.digest.CopyTo(digest.data(), digest.size());
+                mtx.lock();
+                bool duplicate = !digests.insert(digest).second;
+                mtx.unlock();
+                if (duplicate) {
+                    continue;
+                }
+
+                if (ShouldCompress() &&
+                    (res = blobfs::blobfs_compress(data_fd.get(), &info)) != ZX_OK) {
+                    mtx.lock();
                     status = res;
                     mtx.unlock();
                     return;
@@ -171,14 +200,9 @@ zx_status_t BlobfsCreator::CalculateRequiredSize(off_t* out) {
         return status;
     }
 
-    // Remove all duplicate blobs by first sorting the merkle trees by
-    // digest, and then by reshuffling the vector to exclude duplicates.
+    // Blobs are written out in digest order, so that the image does not
+    // depend on the order in which the workers finished.
     std::sort(merkle_list_.begin(), merkle_list_.end(), DigestCompare());
-    auto compare = [](const blobfs::MerkleInfo& lhs, const blobfs::MerkleInfo& rhs) {
-        return lhs.digest == rhs.digest;
-    };
-    auto it = std::unique(merkle_list_.begin(), merkle_list_.end(), compare);
-    merkle_list_.resize(std::distance(merkle_list_.begin(), it));
 
     for (const auto& info : merkle_list_) {
         blobfs::Inode node;
@@ -236,42 +260,15 @@ zx_status_t BlobfsCreator::Add() {
         return status;
     }
 
-    std::vector<std::thread> threads;
-    std::mutex mtx;
-
-    unsigned n_threads = std::thread::hardware_concurrency();
-    if (!n_threads) {
-        n_threads = 4;
-    }
-    unsigned blob_index = 0;
-    for (unsigned j = n_threads; j > 0; j--) {
-        threads.push_back(std::thread([&] {
-            unsigned i = 0;
-            while (true) {
-                mtx.lock();
-                i = blob_index++;
-                if (i >= merkle_list_.size()) {
-                    mtx.unlock();
-                    return;
-                }
-                mtx.unlock();
-
-                zx_status_t res;
-                if ((res = AddBlob(blobfs.get(), merkle_list_[i])) < 0) {
-                    mtx.lock();
-                    status = res;
-                    mtx.unlock();
-                    return;
-                }
-            }
-        }));
-    }
-
-    for (unsigned i = 0; i < threads.size(); i++) {
-        threads[i].join();
+    // Blobfs serializes additions to the image, so they are made from one
+    // thread, in order.  Each blob is then laid out right after the last.
+    for (const auto& info : merkle_list_) {
+        if ((status = AddBlob(blobfs.get(), info)) < 0) {
+            return status;
+        }
     }
 
-    return status;
+    return ZX_OK;
 }
 
 int main(int argc, char** argv) {
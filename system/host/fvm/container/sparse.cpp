@@ -4,6 +4,12 @@
 
 #include <inttypes.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <fbl/algorithm.h>
+
 #include "fvm/container.h"
 
 constexpr size_t kLz4HeaderSize = 15;
@@ -16,6 +22,9 @@ static LZ4F_preferences_t lz4_prefs = {
     .compressionLevel = 0,
 };
 
+// The level lz4hc.h recommends for LZ4 HC.
+constexpr int kLz4HcCompressionLevel = 9;
+
 zx_status_t CompressionContext::Setup(size_t max_len) {
     LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&cctx_, LZ4F_VERSION);
     if (LZ4F_isError(errc)) {
@@ -23,9 +32,17 @@ zx_status_t CompressionContext::Setup(size_t max_len) {
         return ZX_ERR_INTERNAL;
     }
 
-    Reset(kLz4HeaderSize + LZ4F_compressBound(max_len, &lz4_prefs));
+    LZ4F_preferences_t prefs = lz4_prefs;
+    if (high_) {
+        prefs.compressionLevel = kLz4HcCompressionLevel;
+    }
+    // Recording the length lets readers find the end of the frame, which LZ4 also checks when the
+    // frame is finished.
+    prefs.frameInfo.contentSize = max_len;
 
-    size_t r = LZ4F_compressBegin(cctx_, GetBuffer(), GetRemaining(), &lz4_prefs);
+    Reset(kLz4HeaderSize + LZ4F_compressBound(max_len, &prefs));
+
+    size_t r = LZ4F_compressBegin(cctx_, GetBuffer(), GetRemaining(), &prefs);
     if (LZ4F_isError(r)) {
         fprintf(stderr, "Could not begin compression: %s\n", LZ4F_getErrorName(r));
         return ZX_ERR_INTERNAL;
@@ -145,6 +162,9 @@ zx_status_t SparseContainer::Init() {
     image_.partition_count = 0;
     image_.header_length = sizeof(fvm::sparse_image_t);
     image_.flags = flags_;
+    if ((flags_ & fvm::kSparseFlagLz4) != 0) {
+        image_.flags |= fvm::kSparseFlagLz4Extents;
+    }
     partitions_.reset();
     dirty_ = true;
     valid_ = true;
@@ -260,39 +280,13 @@ zx_status_t SparseContainer::Commit() {
     }
 
     zx_status_t status;
-    if ((status = PrepareWrite(extent_size_)) != ZX_OK) {
-        return status;
-    }
-
-    // Write each partition out to sparse file
-    for (unsigned i = 0; i < image_.partition_count; i++) {
-        fvm::partition_descriptor_t partition = partitions_[i].descriptor;
-        Format* format = partitions_[i].format.get();
-
-        vslice_info_t vslice_info;
-        // Write out each extent in the partition
-        for (unsigned j = 0; j < partition.extent_count; j++) {
-            if (format->GetVsliceRange(j, &vslice_info) != ZX_OK) {
-                fprintf(stderr, "Unable to access partition extent\n");
-                return ZX_ERR_OUT_OF_RANGE;
-            }
-
-            // Write out each block in the extent
-            for (unsigned k = 0; k < vslice_info.block_count; k++) {
-                if (format->FillBlock(vslice_info.block_offset + k) != ZX_OK) {
-                    fprintf(stderr, "Failed to read block\n");
-                    return ZX_ERR_IO;
-                }
-
-                if (WriteData(format->Data(), format->BlockSize()) != ZX_OK) {
-                    fprintf(stderr, "Failed to write data to sparse file\n");
-                    return ZX_ERR_IO;
-                }
-            }
-        }
+    if ((flags_ & fvm::kSparseFlagLz4) != 0) {
+        status = WriteCompressedExtents();
+    } else {
+        status = WriteExtents();
     }
 
-    if ((status = CompleteWrite()) != ZX_OK) {
+    if (status != ZX_OK) {
         return status;
     }
 
@@ -396,38 +390,131 @@ zx_status_t SparseContainer::AllocateExtent(uint32_t part_index, uint64_t slice_
     return ZX_OK;
 }
 
-zx_status_t SparseContainer::PrepareWrite(size_t max_len) {
-    if ((flags_ & fvm::kSparseFlagLz4) == 0) {
-        return ZX_OK;
-    }
+zx_status_t SparseContainer::WriteExtents() {
+    // Write each partition out to sparse file
+    for (unsigned i = 0; i < image_.partition_count; i++) {
+        fvm::partition_descriptor_t partition = partitions_[i].descriptor;
+        Format* format = partitions_[i].format.get();
 
-    return compression_.Setup(max_len);
-}
+        vslice_info_t vslice_info;
+        // Write out each extent in the partition
+        for (unsigned j = 0; j < partition.extent_count; j++) {
+            if (format->GetVsliceRange(j, &vslice_info) != ZX_OK) {
+                fprintf(stderr, "Unable to access partition extent\n");
+                return ZX_ERR_OUT_OF_RANGE;
+            }
 
-zx_status_t SparseContainer::WriteData(const void* data, size_t length) {
-    if ((flags_ & fvm::kSparseFlagLz4) != 0) {
-        return compression_.Compress(data, length);
-    } else if (write(fd_.get(), data, length) != length) {
-        return ZX_ERR_IO;
+            // Write out each block in the extent
+            for (unsigned k = 0; k < vslice_info.block_count; k++) {
+                if (format->FillBlock(vslice_info.block_offset + k) != ZX_OK) {
+                    fprintf(stderr, "Failed to read block\n");
+                    return ZX_ERR_IO;
+                }
+
+                if (write(fd_.get(), format->Data(), format->BlockSize()) !=
+                        static_cast<ssize_t>(format->BlockSize())) {
+                    fprintf(stderr, "Failed to write data to sparse file\n");
+                    return ZX_ERR_IO;
+                }
+            }
+        }
     }
 
     return ZX_OK;
 }
 
-zx_status_t SparseContainer::CompleteWrite() {
-    if ((flags_ & fvm::kSparseFlagLz4) == 0) {
-        return ZX_OK;
+zx_status_t SparseContainer::WriteCompressedExtents() {
+    size_t partition_count = image_.partition_count;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<CompressedExtents[]> compressed(new (&ac) CompressedExtents[partition_count]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    fbl::unique_ptr<zx_status_t[]> results(new (&ac) zx_status_t[partition_count]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
     }
 
-    zx_status_t status = compression_.Finish();
+    // Each partition is read through a Format of its own, so partitions may be compressed
+    // concurrently. They are written out in order once they all have been.
+    std::atomic<size_t> next_partition(0);
+    auto compress = [&]() {
+        size_t i;
+        while ((i = next_partition.fetch_add(1)) < partition_count) {
+            results[i] = CompressPartition(static_cast<unsigned>(i), &compressed[i]);
+        }
+    };
 
-    if (status != ZX_OK) {
-        return status;
+    size_t n_threads = fbl::min(static_cast<size_t>(std::thread::hardware_concurrency()),
+                                partition_count);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < n_threads; i++) {
+        threads.push_back(std::thread(compress));
+    }
+    compress();
+    for (std::thread& thread : threads) {
+        thread.join();
     }
 
-    if (write(fd_.get(), compression_.GetData(), compression_.GetLength())
-        != compression_.GetLength()) {
-        return ZX_ERR_IO;
+    for (size_t i = 0; i < partition_count; i++) {
+        if (results[i] != ZX_OK) {
+            return results[i];
+        }
+
+        for (const fbl::unique_ptr<CompressionContext>& frame : compressed[i]) {
+            if (write(fd_.get(), frame->GetData(), frame->GetLength()) !=
+                    static_cast<ssize_t>(frame->GetLength())) {
+                fprintf(stderr, "Failed to write data to sparse file\n");
+                return ZX_ERR_IO;
+            }
+        }
+    }
+
+    return ZX_OK;
+}
+
+zx_status_t SparseContainer::CompressPartition(unsigned part_index, CompressedExtents* out) {
+    const partition_info_t& partition = partitions_[part_index];
+    Format* format = partition.format.get();
+
+    vslice_info_t vslice_info;
+    for (unsigned j = 0; j < partition.descriptor.extent_count; j++) {
+        if (format->GetVsliceRange(j, &vslice_info) != ZX_OK) {
+            fprintf(stderr, "Unable to access partition extent\n");
+            return ZX_ERR_OUT_OF_RANGE;
+        }
+
+        fbl::AllocChecker ac;
+        fbl::unique_ptr<CompressionContext> frame(new (&ac) CompressionContext());
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        frame->SetHighCompression(high_compression_);
+
+        zx_status_t status;
+        if ((status = frame->Setup(partition.extents[j].extent_length)) != ZX_OK) {
+            return status;
+        }
+
+        for (unsigned k = 0; k < vslice_info.block_count; k++) {
+            if (format->FillBlock(vslice_info.block_offset + k) != ZX_OK) {
+                fprintf(stderr, "Failed to read block\n");
+                return ZX_ERR_IO;
+            }
+
+            if ((status = frame->Compress(format->Data(), format->BlockSize())) != ZX_OK) {
+                return status;
+            }
+        }
+
+        if ((status = frame->Finish()) != ZX_OK) {
+            return status;
+        }
+
+        out->push_back(fbl::move(frame), &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
     }
 
     return ZX_OK;
@@ -119,6 +119,10 @@ class CompressionContext {
 public:
     CompressionContext() {}
     ~CompressionContext() {}
+    // Selects LZ4 HC, which compresses several times slower for a better
+    // ratio. The output is decompressed just like that of plain LZ4.
+    void SetHighCompression(bool high) { high_ = high; }
+    // Begins a frame of exactly |max_len| bytes of data, which is recorded in its header.
     zx_status_t Setup(size_t max_len);
     zx_status_t Compress(const void* data, size_t length);
     zx_status_t Finish();
@@ -150,6 +154,7 @@ private:
     fbl::unique_ptr<uint8_t[]> data_;
     size_t size_ = 0;
     size_t offset_ = 0;
+    bool high_ = false;
 };
 
 class SparseContainer final : public Container {
@@ -170,19 +175,29 @@ public:
     size_t SliceSize() const final;
     zx_status_t AddPartition(const char* path, const char* type_name) final;
 
+    // Compresses with LZ4 HC rather than LZ4, if |kSparseFlagLz4| is set.
+    void SetHighCompression(bool high) { high_compression_ = high; }
+
 private:
+    // The frames of a partition's extents, in order.
+    using CompressedExtents = fbl::Vector<fbl::unique_ptr<CompressionContext>>;
+
     bool valid_;
     size_t disk_size_;
     size_t extent_size_;
     fvm::sparse_image_t image_;
     fbl::Vector<partition_info_t> partitions_;
-    CompressionContext compression_;
+    bool high_compression_ = false;
 
     zx_status_t AllocatePartition(fbl::unique_ptr<Format> format);
     zx_status_t AllocateExtent(uint32_t part_index, uint64_t slice_start, uint64_t slice_count,
                                uint64_t extent_length);
 
-    zx_status_t PrepareWrite(size_t max_len);
-    zx_status_t WriteData(const void* data, size_t length);
-    zx_status_t CompleteWrite();
+    // Write the data of every extent to disk, as is.
+    zx_status_t WriteExtents();
+    // Write the data of every extent to disk, each compressed as an LZ4 frame of its own.
+    // Partitions are compressed in parallel.
+    zx_status_t WriteCompressedExtents();
+    // Compress each extent of the |part_index|th partition into |out|.
+    zx_status_t CompressPartition(unsigned part_index, CompressedExtents* out);
 };
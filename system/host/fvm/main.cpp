@@ -30,7 +30,8 @@ int usage(void) {
     fprintf(stderr, " --slice [bytes] - specify slice size (default: %zu)\n", DEFAULT_SLICE_SIZE);
     fprintf(stderr, " --offset [bytes] - offset at which container begins (fvm only)\n");
     fprintf(stderr, " --length [bytes] - length of container within file (fvm only)\n");
-    fprintf(stderr, " --compress - specify that file should be compressed (sparse only)\n");
+    fprintf(stderr, " --compress [lz4|lz4hc] - specify that file should be compressed, with LZ4 or"
+                    " the slower, higher ratio LZ4 HC (sparse only)\n");
     fprintf(stderr, "Input options:\n");
     fprintf(stderr, " --blob [path] - Add path as blob type (must be blobfs)\n");
     fprintf(stderr, " --data [path] - Add path as encrypted data type (must be minfs)\n");
@@ -119,6 +120,7 @@ int main(int argc, char** argv) {
     size_t slice_size = DEFAULT_SLICE_SIZE;
     bool should_unlink = true;
     uint32_t flags = 0;
+    bool high_compression = false;
     while (i < argc) {
         if (!strcmp(argv[i], "--slice") && i + 1 < argc) {
             if (parse_size(argv[++i], &slice_size) < 0) {
@@ -143,6 +145,9 @@ int main(int argc, char** argv) {
         } else if (!strcmp(argv[i], "--compress")) {
             if (!strcmp(argv[++i], "lz4")) {
                 flags |= fvm::kSparseFlagLz4;
+            } else if (!strcmp(argv[i], "lz4hc")) {
+                flags |= fvm::kSparseFlagLz4;
+                high_compression = true;
             } else {
                 fprintf(stderr, "Invalid compression type\n");
                 return -1;
@@ -234,6 +239,7 @@ int main(int argc, char** argv) {
         if (SparseContainer::Create(path, slice_size, flags, &sparseContainer) != ZX_OK) {
             return -1;
         }
+        sparseContainer->SetHighCompression(high_compression);
 
         if (add_partitions(sparseContainer.get(), argc - i, argv + i) < 0) {
             return -1;
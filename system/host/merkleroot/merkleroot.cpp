@@ -2,8 +2,10 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
+#include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,6 +31,9 @@ using digest::MerkleTree;
 struct FileEntry {
     std::string filename;
     char digest[Digest::kLength * 2 + 1]{};
+    // Set by stat_entry().
+    bool regular = false;
+    size_t size = 0;
 };
 
 void usage(char** argv) {
@@ -68,7 +73,23 @@ int handle_argument(char** argv, const char* arg,
     }
 }
 
-void handle_entry(FileEntry* entry) {
+void stat_entry(FileEntry* entry) {
+    struct stat info;
+    if (stat(entry->filename.c_str(), &info) < 0) {
+        perror(entry->filename.c_str());
+        exit(1);
+    }
+    entry->regular = S_ISREG(info.st_mode);
+    entry->size = entry->regular ? info.st_size : 0;
+}
+
+// Hashes the data of |entry| on up to |threads| threads, including the
+// caller's.
+void handle_entry(FileEntry* entry, uint32_t threads) {
+    if (!entry->regular) {
+        return;
+    }
+
     fbl::unique_fd fd{open(entry->filename.c_str(), O_RDONLY)};
     if (!fd) {
         perror(entry->filename.c_str());
@@ -102,8 +123,8 @@ void handle_entry(FileEntry* entry) {
         perror("mmap");
         exit(1);
     }
-    zx_status_t rc =
-        MerkleTree::Create(data, info.st_size, tree.get(), len, &digest);
+    zx_status_t rc = MerkleTree::CreateParallel(data, info.st_size, tree.get(), len, &digest,
+                                                threads);
     if (info.st_size != 0 && munmap(data, info.st_size) != 0) {
         perror("munmap");
         exit(1);
@@ -149,6 +170,22 @@ int main(int argc, char** argv) {
             return 1;
     }
 
+    size_t total_size = 0;
+    for (auto& entry : entries) {
+        stat_entry(&entry);
+        total_size += entry.size;
+    }
+
+    // Files are hashed largest first, so that a few big files started last
+    // don't leave the other threads idle at the end.
+    std::vector<size_t> order(entries.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&entries](size_t a, size_t b) {
+        return entries[a].size > entries[b].size;
+    });
+
     std::vector<std::thread> threads;
     std::mutex mtx;
     size_t next_entry = 0;
@@ -156,19 +193,26 @@ int main(int argc, char** argv) {
     if (!n_threads) {
         n_threads = 4;
     }
-    if (n_threads > entries.size()) {
-        n_threads = entries.size();
+    size_t n_files = n_threads;
+    if (n_files > entries.size()) {
+        n_files = entries.size();
     }
-    for (size_t i = n_threads; i > 0; --i) {
+    for (size_t i = n_files; i > 0; --i) {
         threads.push_back(std::thread([&] {
             while (true) {
                 mtx.lock();
                 auto j = next_entry++;
                 mtx.unlock();
-                if (j >= entries.size()) {
+                if (j >= order.size()) {
                     return;
                 }
-                handle_entry(&entries[j]);
+                // A file that is more than its share of all the data gets
+                // more threads of its own, in proportion to its size.
+                FileEntry* entry = &entries[order[j]];
+                size_t share = total_size / n_threads;
+                size_t file_threads = share ? entry->size / share : 1;
+                file_threads = std::max<size_t>(1, std::min(file_threads, n_threads));
+                handle_entry(entry, static_cast<uint32_t>(file_threads));
             }
         }));
     }
@@ -9,7 +9,9 @@
 #include <string.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/unique_free_ptr.h>
+#include <fbl/unique_ptr.h>
 #include <minfs/fsck.h>
 #include <minfs/host.h>
 #include <minfs/minfs.h>
@@ -76,6 +78,11 @@ zx_status_t IsDirectory(const char* path, bool* result) {
     return ZX_OK;
 }
 
+// Files are copied in chunks of up to this many bytes. Each chunk is a single
+// write to the destination, so when that is minfs, the blocks of a chunk are
+// reserved and allocated together, and reach the image in long runs.
+constexpr size_t kMaxCopyChunk = 16 * 1024 * 1024;
+
 // Copies a file to minfs from the host, or vice versa.
 zx_status_t CopyFile(const char* src_path, const char* dst_path) {
     FileWrapper src;
@@ -91,16 +98,30 @@ zx_status_t CopyFile(const char* src_path, const char* dst_path) {
         return ZX_ERR_IO;
     }
 
-    char buffer[256 * 1024];
+    // Smaller files only need a buffer as large as they are.
+    struct stat s;
+    int rs = host_path(src_path) ? stat(src_path, &s) : emu_stat(src_path, &s);
+    size_t chunk = kMaxCopyChunk;
+    if (rs == 0 && static_cast<size_t>(s.st_size) < chunk) {
+        chunk = fbl::max(static_cast<size_t>(s.st_size),
+                         static_cast<size_t>(minfs::kMinfsBlockSize));
+    }
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<char[]> buffer(new (&ac) char[chunk]);
+    if (!ac.check()) {
+        fprintf(stderr, "error: cannot allocate copy buffer\n");
+        return ZX_ERR_NO_MEMORY;
+    }
+
     ssize_t r;
     for (;;) {
-        if ((r = src.Read(buffer, sizeof(buffer))) < 0) {
+        if ((r = src.Read(buffer.get(), chunk)) < 0) {
             fprintf(stderr, "error: reading from '%s'\n", src_path);
             break;
         } else if (r == 0) {
             break;
         }
-        void* ptr = buffer;
+        void* ptr = buffer.get();
         ssize_t len = r;
         while (len > 0) {
             if ((r = dst.Write(ptr, len)) < 0) {
@@ -31,6 +31,7 @@
 #include <zircon/boot/netboot.h>
 
 #define TFTP_BUF_SZ 2048
+#define TFTP_REORDER_BUF_SZ (1024 * 1024)
 
 typedef struct {
     int fd;
@@ -219,6 +220,13 @@ static int transfer_file(bool push, int s, struct sockaddr_in6* addr, const char
     // Set our preferred transport options
     tftp_set_options(session, &tftp_block_size, NULL, &tftp_window_size);
 
+    // Hold blocks received out of order, so that files pulled from the device
+    // only need their lost blocks sent again.
+    void* reorder_buf = malloc(TFTP_REORDER_BUF_SZ);
+    if (reorder_buf != NULL) {
+        tftp_session_set_reorder_buffer(session, reorder_buf, TFTP_REORDER_BUF_SZ);
+    }
+
     // Prepare buffers
     char err_msg[128];
     tftp_request_opts opts = {0};
@@ -237,6 +245,7 @@ static int transfer_file(bool push, int s, struct sockaddr_in6* addr, const char
     }
 
     free(session_data);
+    free(reorder_buf);
     free(opts.inbuf);
     free(opts.outbuf);
 
@@ -13,8 +13,10 @@
 
 #define MAXSIZE 1024
 
-#define TFTP_DEFAULT_BLOCK_SZ 1024
-#define TFTP_DEFAULT_WINDOW_SZ 256
+// The largest block that fits in a packet on a 1500 byte MTU, and the same
+// window as bootserver's.
+#define TFTP_DEFAULT_BLOCK_SZ 1428
+#define TFTP_DEFAULT_WINDOW_SZ 1024
 
 typedef struct {
     struct nbmsg_t hdr;
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <climits>
@@ -23,6 +24,7 @@
 #include <numeric>
 #include <set>
 #include <string>
+#include <thread>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
@@ -34,6 +36,7 @@
 #include <fbl/unique_fd.h>
 #include <lib/cksum.h>
 #include <lz4/lz4frame.h>
+#include <lz4/lz4hc.h>
 #include <zircon/boot/image.h>
 
 namespace {
@@ -126,6 +129,11 @@ public:
             Flush();
         } else if (owned) {
             owned_buffers_.push_front(std::move(owned));
+            // Don't let buffers made just for the output pile up.
+            owned_size_ += buffer.iov_len;
+            if (owned_size_ >= kMaxOwnedSize) {
+                Flush();
+            }
         }
     }
 
@@ -140,6 +148,7 @@ public:
         }
         write_pos_ = iov_.begin();
         owned_buffers_.clear();
+        owned_size_ = 0;
     }
 
     // Emit a placeholder.  The return value will be passed to PatchHeader.
@@ -194,6 +203,8 @@ private:
     // iov_[n].iov_base might point into these buffers.  They're just
     // stored here to own the buffers until iov_ is flushed.
     std::forward_list<std::unique_ptr<std::byte[]>> owned_buffers_;
+    size_t owned_size_ = 0;
+    static constexpr size_t kMaxOwnedSize = 64 << 20;
     fbl::unique_fd fd_;
     uint32_t flushed_ = 0;
     uint32_t total_ = 0;
@@ -408,13 +419,24 @@ private:
     uint32_t crc_ = 0;
 };
 
-// This tells LZ4f_compressUpdate it can keep a pointer to data.
-constexpr const LZ4F_compressOptions_t kCompressOpt = {1, {}};
+// Settings for compressing items as they are written out.
+struct CompressOptions {
+    // Compression of an item is spread across this many threads.
+    unsigned int threads = 1;
+
+    // Compressed items of a previous image.  One of these is written out
+    // again, instead of compressing afresh, whenever its uncompressed
+    // contents match those of the item being written.
+    const std::vector<ItemPtr>* reuse = nullptr;
+};
 
 class Compressor {
 public:
     DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(Compressor);
-    Compressor() = default;
+
+    explicit Compressor(unsigned int threads)
+        : threads_(std::max(threads, 1u)) {
+    }
 
 #define LZ4F_CALL(func, ...)                                               \
     [&]() {                                                                \
@@ -435,54 +457,86 @@ public:
         // and fill in once we know the payload length and CRC.
         header_pos_ = out->PlaceHeader();
 
-        prefs_.frameInfo.contentSize = header_.length;
+        LZ4F_preferences_t prefs{};
+        prefs.frameInfo.contentSize = header_.length;
 
-        prefs_.frameInfo.blockSizeID = LZ4F_max64KB;
-        prefs_.frameInfo.blockMode = LZ4F_blockIndependent;
+        // Every block is compressed on its own, so blocks can be compressed
+        // in parallel and still make up a single LZ4 frame.
+        prefs.frameInfo.blockSizeID = LZ4F_max64KB;
+        prefs.frameInfo.blockMode = LZ4F_blockIndependent;
 
         // LZ4 compression levels 1-3 are for "fast" compression, and 4-16
         // are for higher compression. The additional compression going from
         // 4 to 16 is not worth the extra time needed during compression.
-        prefs_.compressionLevel = 4;
-
-        LZ4F_CALL(LZ4F_createCompressionContext, &ctx_, LZ4F_VERSION);
+        prefs.compressionLevel = kCompressionLevel;
 
         // Record the original uncompressed size in header_.extra.
         // WriteBuffer will accumulate the compressed size in header_.length.
         header_.extra = header_.length;
         header_.length = 0;
 
-        // This might start writing compression format headers before it
-        // receives any data.
-        auto buffer = GetBuffer(kLZ4FMaxHeaderFrameSize);
-        size_t size = LZ4F_CALL(LZ4F_compressBegin, ctx_,
-                                buffer.data.get(), buffer.size, &prefs_);
-        assert(size <= buffer.size);
+        // Only the frame header comes from the frame API.  The blocks and
+        // the end mark are written out directly.
+        LZ4F_compressionContext_t ctx;
+        LZ4F_CALL(LZ4F_createCompressionContext, &ctx, LZ4F_VERSION);
+        auto buffer = std::make_unique<std::byte[]>(kLZ4FMaxHeaderFrameSize);
+        size_t size = LZ4F_CALL(LZ4F_compressBegin, ctx,
+                                buffer.get(), kLZ4FMaxHeaderFrameSize, &prefs);
+        assert(size <= kLZ4FMaxHeaderFrameSize);
+        LZ4F_CALL(LZ4F_freeCompressionContext, ctx);
         WriteBuffer(out, std::move(buffer), size);
-    }
 
-    ~Compressor() {
-        LZ4F_CALL(LZ4F_freeCompressionContext, ctx_);
+        // Each window of blocks is compressed in parallel, and then written
+        // out before more input is taken, so memory use is bounded by the
+        // size of a window no matter how large the item is.
+        window_blocks_ = threads_ * kBlocksPerThread;
+        for (unsigned int i = 0; i < threads_; ++i) {
+            states_.push_back(
+                std::make_unique<std::byte[]>(LZ4_sizeofStateHC()));
+        }
     }
 
     // NOTE: Input buffer may be referenced for the life of the Compressor!
     void Write(OutputStream* out, const iovec& input) {
-        auto buffer = GetBuffer(LZ4F_compressBound(input.iov_len, &prefs_));
-        size_t actual_size = LZ4F_CALL(LZ4F_compressUpdate,
-                                       ctx_, buffer.data.get(), buffer.size,
-                                       input.iov_base, input.iov_len,
-                                       &kCompressOpt);
-        WriteBuffer(out, std::move(buffer), actual_size);
+        auto data = static_cast<const std::byte*>(input.iov_base);
+        size_t left = input.iov_len;
+        while (left > 0) {
+            if (partial_size_ > 0 || left < kBlockSize) {
+                // A block which straddles input buffers is gathered up in a
+                // buffer of its own.
+                if (!partial_) {
+                    partial_ = std::make_unique<std::byte[]>(kBlockSize);
+                }
+                size_t n = std::min(left, kBlockSize - partial_size_);
+                memcpy(partial_.get() + partial_size_, data, n);
+                partial_size_ += n;
+                data += n;
+                left -= n;
+                if (partial_size_ == kBlockSize) {
+                    AddPartialBlock(out);
+                }
+            } else {
+                AddBlock(out, Iovec(data, kBlockSize));
+                data += kBlockSize;
+                left -= kBlockSize;
+            }
+        }
     }
 
     uint32_t Finish(OutputStream* out) {
-        // Write the closing chunk from the compressor.
-        auto buffer = GetBuffer(LZ4F_compressBound(0, &prefs_));
-        size_t actual_size = LZ4F_CALL(LZ4F_compressEnd,
-                                       ctx_, buffer.data.get(), buffer.size,
-                                       &kCompressOpt);
+        if (partial_size_ > 0) {
+            AddPartialBlock(out);
+        }
+        if (!blocks_.empty()) {
+            CompressWindow(out);
+        }
 
-        WriteBuffer(out, std::move(buffer), actual_size);
+        // Write the end mark.  There is no content checksum.
+        static const uint32_t end_mark = 0;
+        const iovec iov = Iovec(&end_mark);
+        header_.length += iov.iov_len;
+        crc_.Write(iov);
+        out->Write(iov);
 
         // Complete the checksum.
         crc_.FinalizeHeader(&header_);
@@ -493,60 +547,109 @@ public:
     }
 
 private:
-    struct Buffer {
-        // Move-only type: after moving, data is nullptr and size is 0.
-        Buffer() = default;
-        Buffer(std::unique_ptr<std::byte[]> buffer, size_t max_size)
-            : data(std::move(buffer)), size(max_size) {
-        }
-        Buffer(Buffer&& other) {
-            *this = std::move(other);
-        }
-        Buffer& operator=(Buffer&& other) {
-            data = std::move(other.data);
-            size = other.size;
-            other.size = 0;
-            return *this;
-        }
-        std::unique_ptr<std::byte[]> data;
-        size_t size = 0;
-    } unused_buffer_;
+    static constexpr int kCompressionLevel = 4;
+    static constexpr size_t kBlockSize = 64 << 10;
+    static constexpr uint32_t kBlockUncompressed = 0x80000000;
+    static constexpr unsigned int kBlocksPerThread = 16;
+
     zbi_header_t header_;
     Checksummer crc_;
-    LZ4F_compressionContext_t ctx_;
-    LZ4F_preferences_t prefs_{};
     uint32_t header_pos_ = 0;
-    // IOV_MAX buffers might be live at once.
-    static constexpr const size_t kMinBufferSize = (128 << 20) / IOV_MAX;
+    const unsigned int threads_;
+    size_t window_blocks_ = 0;
+    // The LZ4 HC state used by each thread.
+    std::vector<std::unique_ptr<std::byte[]>> states_;
+    // The blocks of the current window, and the buffers owning any of them
+    // which had to be gathered up.
+    std::vector<iovec> blocks_;
+    std::vector<std::unique_ptr<std::byte[]>> gathered_;
+    std::unique_ptr<std::byte[]> partial_;
+    size_t partial_size_ = 0;
+
+    void AddBlock(OutputStream* out, const iovec& block) {
+        blocks_.push_back(block);
+        if (blocks_.size() == window_blocks_) {
+            CompressWindow(out);
+        }
+    }
+
+    void AddPartialBlock(OutputStream* out) {
+        const iovec block = Iovec(partial_.get(), partial_size_);
+        gathered_.push_back(std::move(partial_));
+        partial_size_ = 0;
+        AddBlock(out, block);
+    }
+
+    // Compress one block into dst, which has room for the block header and
+    // the whole block, just as LZ4F_compressUpdate would.
+    static size_t CompressBlock(void* state, const iovec& block,
+                                std::byte* dst) {
+        int size = LZ4_compress_HC_extStateHC(
+            state, static_cast<const char*>(block.iov_base),
+            reinterpret_cast<char*>(dst + sizeof(uint32_t)),
+            static_cast<int>(block.iov_len),
+            static_cast<int>(block.iov_len - 1), kCompressionLevel);
+        uint32_t block_header = static_cast<uint32_t>(size);
+        if (size == 0) {
+            // It didn't get any smaller, so store it as is.
+            block_header = static_cast<uint32_t>(block.iov_len) |
+                           kBlockUncompressed;
+            memcpy(dst + sizeof(uint32_t), block.iov_base, block.iov_len);
+            size = static_cast<int>(block.iov_len);
+        }
+        static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                      "LZ4 block headers are little-endian");
+        memcpy(dst, &block_header, sizeof(block_header));
+        return sizeof(uint32_t) + size;
+    }
+
+    void CompressWindow(OutputStream* out) {
+        // Each block gets a slot large enough for it to go out uncompressed.
+        constexpr size_t kSlotSize = sizeof(uint32_t) + kBlockSize;
+        const size_t count = blocks_.size();
+        auto buffer = std::make_unique<std::byte[]>(count * kSlotSize);
+        std::vector<size_t> sizes(count);
+
+        std::atomic<size_t> next{0};
+        auto worker = [&](void* state) {
+            for (size_t i = next++; i < count; i = next++) {
+                sizes[i] = CompressBlock(state, blocks_[i],
+                                         buffer.get() + (i * kSlotSize));
+            }
+        };
+        std::vector<std::thread> threads;
+        const size_t nthreads = std::min<size_t>(threads_, count);
+        for (size_t i = 1; i < nthreads; ++i) {
+            threads.emplace_back(worker, states_[i].get());
+        }
+        worker(states_[0].get());
+        for (auto& thread : threads) {
+            thread.join();
+        }
 
-    Buffer GetBuffer(size_t max_size) {
-        if (unused_buffer_.size >= max_size) {
-            // We have an old buffer that will do fine.
-            return std::move(unused_buffer_);
-        } else {
-            // Get a new buffer.
-            max_size = std::max(max_size, kMinBufferSize);
-            return {std::make_unique<std::byte[]>(max_size), max_size};
+        // Pack the compressed blocks together, in order.
+        size_t size = 0;
+        for (size_t i = 0; i < count; ++i) {
+            memmove(buffer.get() + size, buffer.get() + (i * kSlotSize),
+                    sizes[i]);
+            size += sizes[i];
         }
+        WriteBuffer(out, std::move(buffer), size);
+
+        blocks_.clear();
+        gathered_.clear();
     }
 
-    void WriteBuffer(OutputStream* out, Buffer buffer, size_t actual_size) {
-        if (actual_size > 0) {
-            header_.length += actual_size;
-            const iovec iov{buffer.data.get(), actual_size};
-            crc_.Write(iov);
-            out->Write(iov, std::move(buffer.data));
-            buffer.size = 0;
-        } else {
-            // The compressor often delivers zero bytes for an input chunk.
-            // Stash the unused buffer for next time to cut down on new/delete.
-            unused_buffer_ = std::move(buffer);
-        }
+    void WriteBuffer(OutputStream* out, std::unique_ptr<std::byte[]> buffer,
+                     size_t size) {
+        assert(size > 0);
+        header_.length += size;
+        const iovec iov{buffer.get(), size};
+        crc_.Write(iov);
+        out->Write(iov, std::move(buffer));
     }
 };
 
-const size_t Compressor::kMinBufferSize;
-
 constexpr const LZ4F_decompressOptions_t kDecompressOpt{};
 
 std::unique_ptr<std::byte[]> Decompress(const std::list<const iovec>& payload,
@@ -1077,9 +1180,10 @@ Extracted items use the file names shown below:\n\
     // Streaming exhausts the item's payload.  The OutputStream will now
     // have pointers into buffers owned by this Item, so this Item must be
     // kept alive until out->Flush() runs (while *this is alive, to be safe).
-    void Stream(OutputStream* out) {
+    void Stream(OutputStream* out, const CompressOptions& options) {
         assert(Aligned(out->WritePosition()));
-        uint32_t wrote = compress_ ? StreamCompressed(out) : StreamRaw(out);
+        uint32_t wrote = compress_ ? StreamCompressed(out, options)
+                                   : StreamRaw(out);
         assert(out->WritePosition() % ZBI_ALIGNMENT == wrote % ZBI_ALIGNMENT);
         uint32_t aligned = ZBI_ALIGN(wrote);
         if (aligned > wrote) {
@@ -1358,7 +1462,8 @@ Extracted items use the file names shown below:\n\
 
     template <typename ItemList>
     static void WriteZBI(FileWriter* writer, const char* name,
-                         const ItemList& items) {
+                         const ItemList& items,
+                         const CompressOptions& options = CompressOptions()) {
         auto out = writer->RawFile(name);
 
         uint32_t header_start = out.PlaceHeader();
@@ -1369,7 +1474,7 @@ Extracted items use the file names shown below:\n\
             // The OutputStream stores pointers into Item buffers in its write
             // queue until it goes out of scope below.  The ItemList keeps all
             // the items alive past then.
-            item->Stream(&out);
+            item->Stream(&out, options);
         }
 
         const zbi_header_t header =
@@ -1460,9 +1565,24 @@ private:
         return sizeof(header_) + header_.length;
     }
 
-    uint32_t StreamCompressed(OutputStream* out) {
+    uint32_t StreamCompressed(OutputStream* out,
+                              const CompressOptions& options) {
+        if (options.reuse) {
+            for (const auto& old : *options.reuse) {
+                if (old->CompressesPayloadOf(*this)) {
+                    // The old item is fully baked, header and all.  It
+                    // outlives the OutputStream, just as this item does.
+                    out->Write(Iovec(&old->header_, sizeof(old->header_)));
+                    for (const auto& iov : old->payload_) {
+                        out->Write(iov);
+                    }
+                    return sizeof(old->header_) + old->header_.length;
+                }
+            }
+        }
+
         // Compress and checksum the payload.
-        Compressor compressor;
+        Compressor compressor(options.threads);
         compressor.Init(out, header_);
         do {
             // The compressor streams the header and compressed payload out.
@@ -1473,6 +1593,27 @@ private:
         return compressor.Finish(out);
     }
 
+    // True if this is an already compressed item whose uncompressed payload
+    // is the same as that of |uncompressed|, which is yet to be compressed.
+    bool CompressesPayloadOf(const Item& uncompressed) const {
+        if (!AlreadyCompressed() || !(header_.flags & ZBI_FLAG_CRC32) ||
+            header_.type != uncompressed.header_.type ||
+            header_.extra != uncompressed.header_.length) {
+            return false;
+        }
+        // Decompression is much cheaper than compression, so checking is
+        // well worth it.
+        auto contents = Decompress(payload_, header_.extra);
+        const std::byte* pos = contents.get();
+        for (const auto& iov : uncompressed.payload_) {
+            if (memcmp(pos, iov.iov_base, iov.iov_len) != 0) {
+                return false;
+            }
+            pos += iov.iov_len;
+        }
+        return true;
+    }
+
     int ShowCmdline() const {
         std::string cmdline = std::accumulate(
             payload_.begin(), payload_.end(), std::string(),
@@ -1716,7 +1857,7 @@ const char* IncompleteImage(const ItemList& items, const uint32_t image_arch) {
     return nullptr;
 }
 
-constexpr const char kOptString[] = "-B:cd:e:FxXRg:hto:p:sT:uv";
+constexpr const char kOptString[] = "-B:cd:e:FxXRg:hj:to:p:r:sT:uv";
 constexpr const option kLongOpts[] = {
     {"complete", required_argument, nullptr, 'B'},
     {"compressed", no_argument, nullptr, 'c'},
@@ -1728,9 +1869,11 @@ constexpr const option kLongOpts[] = {
     {"extract-raw", no_argument, nullptr, 'R'},
     {"groups", required_argument, nullptr, 'g'},
     {"help", no_argument, nullptr, 'h'},
+    {"threads", required_argument, nullptr, 'j'},
     {"list", no_argument, nullptr, 't'},
     {"output", required_argument, nullptr, 'o'},
     {"prefix", required_argument, nullptr, 'p'},
+    {"reuse", required_argument, nullptr, 'r'},
     {"sort", no_argument, nullptr, 's'},
     {"type", required_argument, nullptr, 'T'},
     {"uncompressed", no_argument, nullptr, 'u'},
@@ -1787,6 +1930,12 @@ Format control switches (last switch affects all output):\n\
     --compressed, -c               compress BOOTFS images (default)\n\
     --uncompressed, -u             do not compress BOOTFS images\n\
     --sort, -s                     sort BOOTFS entries by name\n\
+    --threads=N, -j N              compress using N threads (default: all CPUs)\n\
+    --reuse=FILE, -r FILE          reuse unchanged compressed items from FILE\n\
+\n\
+With `--reuse` or `-r`, FILE is a previous ZBI image.  Each item that would\n\
+be compressed is instead copied from FILE if FILE has a compressed item of\n\
+the same type with the same uncompressed contents.\n\
 \n\
 In all cases there is only a single BOOTFS item (if any) written out.\n\
 The BOOTFS image contains all files from BOOTFS items in ZBI input files,\n\
@@ -1834,6 +1983,9 @@ int main(int argc, char** argv) {
     bool sort = false;
     bool verbose = false;
     ItemList items;
+    ItemList reuse_items;
+    CompressOptions compress_options;
+    compress_options.threads = std::thread::hardware_concurrency();
     InputFileGeneratorList bootfs_input;
     std::string prefix;
     int opt;
@@ -1943,6 +2095,35 @@ int main(int argc, char** argv) {
             sort = true;
             continue;
 
+        case 'j': {
+            char* end;
+            unsigned long threads = strtoul(optarg, &end, 0);
+            if (*end != '\0' || threads == 0 || threads > UINT_MAX) {
+                fprintf(stderr, "--threads requires a positive number\n");
+                exit(1);
+            }
+            compress_options.threads = static_cast<unsigned int>(threads);
+            continue;
+        }
+
+        case 'r': {
+            if (!reuse_items.empty()) {
+                fprintf(stderr, "only one --reuse file\n");
+                exit(1);
+            }
+            struct stat st;
+            auto fd = opener.Open(optarg, &st);
+            RequireRegularFile(st, optarg);
+            auto file = FileContents::Map(std::move(fd), st, optarg);
+            if (!ImportFile(file, optarg, &reuse_items)) {
+                fprintf(stderr, "%s: not a Zircon Boot container\n", optarg);
+                exit(1);
+            }
+            reuse_items.back()->OwnFile(std::move(file));
+            compress_options.reuse = &reuse_items;
+            continue;
+        }
+
         case 'x':
             extract = true;
             continue;
@@ -2191,7 +2372,7 @@ int main(int argc, char** argv) {
             exit(status);
         }
     } else {
-        Item::WriteZBI(&writer, "boot.zbi", items);
+        Item::WriteZBI(&writer, "boot.zbi", items, compress_options);
     }
 
     name_matcher.Summary(extract ? "extracted" : "matched",
@@ -39,6 +39,7 @@ typedef uint32_t audio_cmd_t;
 #define AUDIO_RB_CMD_GET_BUFFER         ((audio_cmd_t)0x3001)
 #define AUDIO_RB_CMD_START              ((audio_cmd_t)0x3002)
 #define AUDIO_RB_CMD_STOP               ((audio_cmd_t)0x3003)
+#define AUDIO_RB_CMD_GET_POSITION_BUFFER ((audio_cmd_t)0x3004)
 
 // Async notifications sent on the ring buffer channel.
 #define AUDIO_RB_POSITION_NOTIFY        ((audio_cmd_t)0x4000)
@@ -397,6 +398,40 @@ typedef struct audio_rb_cmd_stop_resp {
     zx_status_t     result;
 } audio_rb_cmd_stop_resp_t;
 
+// AUDIO_RB_CMD_GET_POSITION_BUFFER
+//
+// May be not used with the NO_ACK flag.
+typedef struct audio_rb_cmd_get_position_buffer_req {
+    audio_cmd_hdr_t hdr;
+} audio_rb_cmd_get_position_buffer_req_t;
+
+typedef struct audio_rb_cmd_get_position_buffer_resp {
+    audio_cmd_hdr_t hdr;
+    zx_status_t     result;
+
+    // NOTE: If result == ZX_OK, a read-only VMO handle will be returned as
+    // well.  Its first page holds an audio_rb_position_buffer_t which the
+    // driver keeps up to date for as long as the ring buffer channel is open,
+    // allowing clients to track the ring buffer position without waiting for
+    // position notifications.
+} audio_rb_cmd_get_position_buffer_resp_t;
+
+// The contents of the VMO returned by AUDIO_RB_CMD_GET_POSITION_BUFFER.
+//
+// The driver is the only writer.  |seq| is odd while the other fields are
+// being updated, and is advanced again once they are consistent, so readers
+// must retry until they see the same even |seq| before and after reading them.
+// A |timestamp| of 0 means that the ring buffer is not running.
+typedef struct audio_rb_position_buffer {
+    uint32_t seq;
+
+    // The position (in bytes) of the driver/hardware's read (output) or write
+    // (input) pointer in the ring buffer, as of |timestamp| on the
+    // CLOCK_MONOTONIC timeline.
+    uint32_t  ring_buffer_pos;
+    zx_time_t timestamp;
+} audio_rb_position_buffer_t;
+
 // AUDIO_RB_POSITION_NOTIFY
 typedef struct audio_rb_position_notify {
     audio_cmd_hdr_t hdr;
@@ -77,6 +77,10 @@
 // clears the counters
 #define IOCTL_BLOCK_GET_STATS   \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 18)
+// Lets the block server hold back the responses to completed transactions,
+// so that those which complete close together share one fifo write
+#define IOCTL_BLOCK_FIFO_SET_COALESCING \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_BLOCK, 19)
 
 // Block Impl ioctls (specific to each block device):
 
@@ -84,6 +88,7 @@
 #define BLOCK_FLAG_REMOVABLE 0x00000002
 #define BLOCK_FLAG_BOOTPART 0x00000004  // block device has bootdata partition map
                                         // provided by device metadata
+#define BLOCK_FLAG_TRIM_SUPPORT 0x00000008  // block device supports BLOCKIO_TRIM
 
 #define BLOCK_MAX_TRANSFER_UNBOUNDED 0xFFFFFFFF
 
@@ -139,6 +144,20 @@ IOCTL_WRAPPER_INOUT(ioctl_block_attach_vmo, IOCTL_BLOCK_ATTACH_VMO, zx_handle_t,
 // ssize_t ioctl_block_fifo_close(int fd);
 IOCTL_WRAPPER(ioctl_block_fifo_close, IOCTL_BLOCK_FIFO_CLOSE);
 
+typedef struct {
+    // Responses are written once this many of them are waiting; zero or one
+    // writes each as soon as it is ready, which is the default.
+    uint32_t max_responses;
+    uint32_t reserved;
+    // ... or once the first of them has waited this long. Responses never
+    // wait when the device has nothing left in flight.
+    zx_duration_t max_delay;
+} block_fifo_coalescing_t;
+
+// ssize_t ioctl_block_fifo_set_coalescing(int fd, const block_fifo_coalescing_t* config);
+IOCTL_WRAPPER_IN(ioctl_block_fifo_set_coalescing, IOCTL_BLOCK_FIFO_SET_COALESCING,
+                 block_fifo_coalescing_t);
+
 #define GUID_LEN 16
 #define NAME_LEN 24
 #define MAX_FVM_VSLICE_REQUESTS 16
@@ -281,6 +300,9 @@ typedef uint16_t groupid_t;
 #define BLOCKIO_FLUSH          0x00000003
 // Detaches the VMO from the block device.
 #define BLOCKIO_CLOSE_VMO      0x00000004
+// Tells the device that the blocks starting at dev_offset need not be
+// preserved. vmoid and vmo_offset are ignored.
+#define BLOCKIO_TRIM           0x00000005
 #define BLOCKIO_OP_MASK        0x000000FF
 
 // Require that this operation will not begin until all prior operations
@@ -18,7 +18,7 @@
 // Ethertap signals on the socket are used to indicate link status. It is an error to assert that a
 // device is both online and offline; the device will be shutdown. A device is in the offline state
 // when it is created.
-// ZX_USER_SIGNAL_7 is reserved for internal ethertap use.
+// ZX_USER_SIGNAL_6 and ZX_USER_SIGNAL_7 are reserved for internal ethertap use.
 #define ETHERTAP_SIGNAL_ONLINE  ZX_USER_SIGNAL_0
 #define ETHERTAP_SIGNAL_OFFLINE ZX_USER_SIGNAL_1
 
@@ -28,6 +28,9 @@
 // Report EthmacSetParam() over Control channel of socket, and return success from EthmacSetParam().
 // If this option is not set, EthmacSetParam() will return ZX_ERR_NOT_SUPPORTED.
 #define ETHERTAP_OPT_REPORT_PARAM  (1u << 2)
+// Send and receive frames over the data socket in batches (see ETHERTAP_MSG_PACKET_BATCH), rather
+// than one frame per message.
+#define ETHERTAP_OPT_BATCH         (1u << 3)
 
 // An ethertap device has a fixed mac address and mtu, and transfers ethernet frames over the
 // returned data socket. To destroy the device, close the socket.
@@ -49,12 +52,28 @@ typedef struct ethertap_ioctl_config {
 
 #define ETHERTAP_MSG_PACKET (1u)
 #define ETHERTAP_MSG_PARAM_REPORT (2u)
+#define ETHERTAP_MSG_PACKET_BATCH (3u)
 
 typedef struct ethertap_socket_header {
     uint32_t type;
     int32_t info; // Might not be used yet; also there for 64-bit alignment
 } ethertap_socket_header_t;
 
+// With ETHERTAP_OPT_BATCH, frames are carried in ETHERTAP_MSG_PACKET_BATCH messages in both
+// directions, so frames written by the ethertap client are prefixed by a header too. The header's
+// |info| is the number of frames in the message, which follow it back to back, each preceded by
+// an ethertap_batch_frame_t giving its length.
+//
+// The device sends the frames queued while it was busy sending the previous batch in the next
+// one, so a frame is never held back waiting for others. A message is at most
+// ETHERTAP_MAX_BATCH_SIZE bytes, and frames longer than the mtu are dropped.
+
+#define ETHERTAP_MAX_BATCH_SIZE (64u * 1024u)
+
+typedef struct ethertap_batch_frame {
+    uint32_t length;
+} ethertap_batch_frame_t;
+
 // If EthmacSetParam() reporting is requested, this struct is written to the Control
 // channel of the ethertap socket each time the function is called.
 //
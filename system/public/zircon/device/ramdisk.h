@@ -24,6 +24,8 @@
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 5)
 #define IOCTL_RAMDISK_GET_BLK_COUNTS \
     IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 6)
+#define IOCTL_RAMDISK_SET_PERFORMANCE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_RAMDISK, 7)
 
 // Ramdisk-specific flags
 #define RAMDISK_FLAG_RESUME_ON_WAKE 0xFF000001
@@ -44,6 +46,20 @@ typedef struct ramdisk_blk_counts {
     uint64_t failed;
 } ramdisk_blk_counts_t;
 
+// A model of a slower device, which the ramdisk's completions follow.
+// All zeroes, the default, completes each operation as soon as it is done.
+typedef struct ramdisk_perf {
+    // Added to the completion of every read, write and trim.
+    zx_duration_t latency;
+    // The rate at which reads and writes move data, one after another; zero
+    // for no limit.
+    uint64_t bytes_per_sec;
+    // The number of operations the device works on at once; the rest wait
+    // for one of them to complete. Zero for no limit.
+    uint32_t queue_depth;
+    uint32_t reserved;
+} ramdisk_perf_t;
+
 // ssize_t ioctl_ramdisk_config(int fd, const ramdisk_ioctl_config_t* in,
 //                              ramdisk_ioctl_config_response_t* out);
 IOCTL_WRAPPER_INOUT(ioctl_ramdisk_config, IOCTL_RAMDISK_CONFIG, ramdisk_ioctl_config_t,
@@ -81,3 +97,8 @@ IOCTL_WRAPPER_IN(ioctl_ramdisk_sleep_after, IOCTL_RAMDISK_SLEEP_AFTER, uint64_t)
 // Retrieve the number of received, successful, and failed block writes since the last call to
 // sleep/wake.
 IOCTL_WRAPPER_OUT(ioctl_ramdisk_get_blk_counts, IOCTL_RAMDISK_GET_BLK_COUNTS, ramdisk_blk_counts_t);
+
+// ssize_t ioctl_ramdisk_set_performance(int fd, const ramdisk_perf_t* in);
+// Make the ramdisk emulate a device with the given latency, bandwidth and queue depth.
+// Operations already in flight keep their old completion times.
+IOCTL_WRAPPER_IN(ioctl_ramdisk_set_performance, IOCTL_RAMDISK_SET_PERFORMANCE, ramdisk_perf_t);
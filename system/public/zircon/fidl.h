@@ -354,6 +354,19 @@ typedef struct fidl_epitaph {
 // This ordinal value is reserved for Epitaphs.
 #define FIDL_EPITAPH_ORDINAL 0xFFFFFFFF
 
+// A batch is a single channel message that carries several small encoded
+// messages, to save a channel write and a wakeup for each of them. Its header
+// has this ordinal, and is followed by one record for each message. A record
+// is a fidl_batch_record_t, then the |num_bytes| bytes of the message padded
+// to FIDL_ALIGNMENT. The handles of the messages follow each other, in order,
+// in the handles of the batch.
+#define FIDL_BATCH_ORDINAL 0xFFFFFFFE
+
+typedef struct fidl_batch_record {
+    uint32_t num_bytes;
+    uint32_t num_handles;
+} fidl_batch_record_t;
+
 // Assumptions.
 
 // Ensure that FIDL_ALIGNMENT is sufficient.
@@ -154,3 +154,81 @@ typedef struct {
     uint8_t     bmCSWStatus;
 } __PACKED ums_csw_t;
 static_assert(sizeof(ums_csw_t) == 13, "");
+
+// USB Attached SCSI (UAS)
+
+// pipe usage descriptor, which follows each endpoint descriptor of a UAS interface
+#define UAS_DT_PIPE_USAGE           0x24
+#define UAS_PIPE_COMMAND            1
+#define UAS_PIPE_STATUS             2
+#define UAS_PIPE_DATA_IN            3
+#define UAS_PIPE_DATA_OUT           4
+
+typedef struct {
+    uint8_t     bLength;
+    uint8_t     bDescriptorType;    // UAS_DT_PIPE_USAGE
+    uint8_t     bPipeID;
+    uint8_t     reserved;
+} __PACKED uas_pipe_usage_descriptor_t;
+static_assert(sizeof(uas_pipe_usage_descriptor_t) == 4, "");
+
+// information unit IDs
+#define UAS_IU_COMMAND              0x01
+#define UAS_IU_SENSE                0x03
+#define UAS_IU_RESPONSE             0x04
+#define UAS_IU_TASK_MANAGEMENT      0x05
+#define UAS_IU_READ_READY           0x06
+#define UAS_IU_WRITE_READY          0x07
+
+// SCSI status codes reported in the sense IU
+#define SCSI_STATUS_GOOD            0x00
+#define SCSI_STATUS_CHECK_CONDITION 0x02
+
+// Command IU
+// This is big endian
+typedef struct {
+    uint8_t     iu_id;              // UAS_IU_COMMAND
+    uint8_t     reserved;
+    uint16_t    tag;
+    uint8_t     prio_attr;
+    uint8_t     reserved2;
+    uint8_t     add_cdb_length;
+    uint8_t     reserved3;
+    uint64_t    lun;
+    uint8_t     cdb[16];
+} __PACKED uas_command_iu_t;
+static_assert(sizeof(uas_command_iu_t) == 32, "");
+
+// Header common to the IUs received on the status pipe
+// This is big endian
+typedef struct {
+    uint8_t     iu_id;
+    uint8_t     reserved;
+    uint16_t    tag;
+} __PACKED uas_iu_header_t;
+static_assert(sizeof(uas_iu_header_t) == 4, "");
+
+// Sense IU
+// This is big endian
+typedef struct {
+    uint8_t     iu_id;              // UAS_IU_SENSE
+    uint8_t     reserved;
+    uint16_t    tag;
+    uint16_t    status_qualifier;
+    uint8_t     status;
+    uint8_t     reserved2[7];
+    uint16_t    sense_length;
+    // followed by sense_length bytes of sense data
+} __PACKED uas_sense_iu_t;
+static_assert(sizeof(uas_sense_iu_t) == 16, "");
+
+// Response IU
+// This is big endian
+typedef struct {
+    uint8_t     iu_id;              // UAS_IU_RESPONSE
+    uint8_t     reserved;
+    uint16_t    tag;
+    uint8_t     add_response_info[3];
+    uint8_t     response_code;
+} __PACKED uas_response_iu_t;
+static_assert(sizeof(uas_response_iu_t) == 8, "");
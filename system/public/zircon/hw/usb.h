@@ -63,6 +63,7 @@ __BEGIN_CDECLS;
 
 #define USB_SUBCLASS_MSC_SCSI               0x06
 #define USB_PROTOCOL_MSC_BULK_ONLY          0x50
+#define USB_PROTOCOL_MSC_UAS                0x62
 
 /* Descriptor Types */
 #define USB_DT_DEVICE                      0x01
@@ -99,4 +99,14 @@
 #define ZX_DEFAULT_SUSPEND_TOKEN_RIGHTS \
     (ZX_RIGHT_TRANSFER | ZX_RIGHT_INSPECT)
 
+#define ZX_DEFAULT_PAGER_RIGHTS \
+    (ZX_RIGHT_TRANSFER | ZX_RIGHT_DUPLICATE | ZX_RIGHT_INSPECT | ZX_RIGHT_READ | \
+     ZX_RIGHT_WRITE)
+
+#define ZX_DEFAULT_WAITSET_RIGHTS \
+    ((ZX_RIGHTS_BASIC & (~ZX_RIGHT_WAIT)) | ZX_RIGHTS_IO)
+
+#define ZX_DEFAULT_ASPACE_TEMPLATE_RIGHTS \
+    ((ZX_RIGHTS_BASIC & (~ZX_RIGHT_WAIT)) | ZX_RIGHTS_IO)
+
 #endif // ZIRCON_RIGHTS_H_
@@ -6,6 +6,7 @@
 #define ZIRCON_SYSCALLS_EXCEPTION_H_
 
 #include <zircon/compiler.h>
+#include <zircon/syscalls/debug.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
 
@@ -110,6 +111,39 @@ typedef struct zx_exception_report {
     zx_exception_context_t context;
 } zx_exception_report_t;
 
+// In-process exception handlers, set with zx_object_set_property() and
+// ZX_PROP_PROCESS_EXCEPTION_HANDLER.
+//
+// When a thread takes an architectural exception whose type is in
+// |type_mask| and the process has no debugger attached, the kernel skips
+// the exception ports.  It pushes a zx_exception_frame_t onto the
+// thread's stack and resumes the thread at |entry| as if it had called
+//
+//   void entry(zx_exception_frame_t* frame);
+//
+// The frame sits below the x86-64 red zone.  The return address is zero,
+// so the handler must not return.  To resume, the handler loads the
+// (possibly modified) registers from |frame->regs| itself.  Vector and
+// floating point state is left as it was at the fault.  If the frame
+// can't be written, e.g. because the stack has overflowed, the
+// exception goes to the exception ports as usual.
+typedef struct zx_exception_handler {
+    // Zero removes the handler.
+    uintptr_t entry;
+    // ZX_EXCP_HANDLER_TYPE() of each exception type to handle.
+    uint32_t type_mask;
+    uint32_t reserved;
+} zx_exception_handler_t;
+
+// The |type_mask| bit for architectural exception type |excp|.
+#define ZX_EXCP_HANDLER_TYPE(excp) ((uint32_t)1u << (((excp) >> 8) & 0x1Fu))
+
+typedef struct zx_exception_frame {
+    // The registers at the time of the exception.
+    zx_thread_state_general_regs_t regs;
+    zx_exception_report_t report;
+} zx_exception_frame_t;
+
 // Options for zx_task_resume()
 #define ZX_RESUME_EXCEPTION ((uint32_t)1)
 // Indicates that we should resume the thread from stopped-in-exception state
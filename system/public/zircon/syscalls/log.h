@@ -52,4 +52,14 @@ typedef struct zx_log_record {
 
 #define ZX_LOG_FLAG_READABLE  0x40000000
 
+// Read options
+
+// Read as many records as fit in the buffer, rather than one.  Each record
+// starts ZX_LOG_RECORD_STRIDE(datalen) bytes after the one before it, and
+// the buffer must have room for at least ZX_LOG_RECORD_MAX bytes.
+#define ZX_LOG_READ_BATCH     0x00000001
+
+#define ZX_LOG_RECORD_STRIDE(datalen) \
+    ((sizeof(zx_log_record_t) + (datalen) + 7) & ~((size_t)7))
+
 __END_CDECLS
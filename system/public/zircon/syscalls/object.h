@@ -36,6 +36,7 @@ typedef uint32_t zx_object_info_topic_t;
 #define ZX_INFO_PROCESS_HANDLE_STATS    ((zx_object_info_topic_t) 21u) // zx_info_process_handle_stats_t[1]
 #define ZX_INFO_SOCKET                  ((zx_object_info_topic_t) 22u) // zx_info_socket_t[1]
 #define ZX_INFO_VMO                     ((zx_object_info_topic_t) 23u) // zx_info_vmo_t[1]
+#define ZX_INFO_JOB_PROCESS_STATS       ((zx_object_info_topic_t) 24u) // zx_info_process_stats_t[n]
 
 typedef uint32_t zx_obj_props_t;
 #define ZX_OBJ_PROP_NONE                ((zx_obj_props_t)0u)
@@ -138,6 +139,28 @@ typedef struct zx_info_task_stats {
     size_t mem_scaled_shared_bytes;
 } zx_info_task_stats_t;
 
+// Statistics about one process of a job tree, as returned by
+// ZX_INFO_JOB_PROCESS_STATS.
+typedef struct zx_info_process_stats {
+    // The koid of the process.
+    zx_koid_t koid;
+
+    // The koid of the job that directly contains the process.
+    zx_koid_t job_koid;
+
+    // Total accumulated running time of the process's threads, including
+    // threads that have exited.
+    zx_duration_t cpu_runtime;
+
+    // The number of threads in the process.
+    uint32_t thread_count;
+    uint32_t padding1;
+
+    // Memory usage, as returned by ZX_INFO_TASK_STATS. All zero if the
+    // process has exited.
+    zx_info_task_stats_t task_stats;
+} zx_info_process_stats_t;
+
 typedef struct zx_info_vmar {
     // Base address of the region.
     uintptr_t base;
@@ -423,6 +446,9 @@ typedef struct zx_info_resource {
 // Terminate this job if the system is low on memory.
 #define ZX_PROP_JOB_KILL_ON_OOM             15u
 
+// Argument is a zx_exception_handler_t.  See zircon/syscalls/exception.h.
+#define ZX_PROP_PROCESS_EXCEPTION_HANDLER   16u
+
 // Basic thread states, in zx_info_thread_t.state.
 #define ZX_THREAD_STATE_NEW                 ((zx_thread_state_t) 0x0000u)
 #define ZX_THREAD_STATE_RUNNING             ((zx_thread_state_t) 0x0001u)
@@ -26,9 +26,11 @@ __BEGIN_CDECLS
 #define ZX_PKT_TYPE_GUEST_VCPU      ((uint8_t)0x06u)
 #define ZX_PKT_TYPE_INTERRUPT       ((uint8_t)0x07u)
 #define ZX_PKT_TYPE_EXCEPTION(n)    ((uint32_t)(0x08u | (((n) & 0xFFu) << 8)))
+#define ZX_PKT_TYPE_PAGE_REQUEST    ((uint8_t)0x09u)
 
 // For options passed to port_create
 #define ZX_PORT_BIND_TO_INTERRUPT   ((uint32_t)(0x1u << 0))
+#define ZX_PORT_WAKE_NEWEST         ((uint32_t)(0x1u << 1))
 
 #define ZX_PKT_TYPE_MASK            ((uint32_t)0x000000FFu)
 
@@ -41,10 +43,14 @@ __BEGIN_CDECLS
 #define ZX_PKT_IS_GUEST_VCPU(type)  ((type) == ZX_PKT_TYPE_GUEST_VCPU)
 #define ZX_PKT_IS_INTERRUPT(type)   ((type) == ZX_PKT_TYPE_INTERRUPT)
 #define ZX_PKT_IS_EXCEPTION(type)   (((type) & ZX_PKT_TYPE_MASK) == ZX_PKT_TYPE_EXCEPTION(0))
+#define ZX_PKT_IS_PAGE_REQUEST(type) ((type) == ZX_PKT_TYPE_PAGE_REQUEST)
 
 // zx_packet_guest_vcpu_t::type
 #define ZX_PKT_GUEST_VCPU_INTERRUPT  ((uint8_t)0)
 #define ZX_PKT_GUEST_VCPU_STARTUP    ((uint8_t)1)
+
+// zx_packet_page_request_t::command
+#define ZX_PAGER_VMO_READ            ((uint16_t)0)
 // clang-format on
 
 // port_packet_t::type ZX_PKT_TYPE_USER.
@@ -127,10 +133,23 @@ typedef struct zx_packet_guest_vcpu {
     uint64_t reserved;
 } zx_packet_guest_vcpu_t;
 
+// |count| is the number of interrupts the packet stands for, more than one
+// if they were coalesced; see zx_interrupt_set_moderation().
 typedef struct zx_packet_interrupt {
     zx_time_t timestamp;
+    uint64_t count;
 } zx_packet_interrupt_t;
 
+// port_packet_t::type ZX_PKT_TYPE_PAGE_REQUEST.
+typedef struct zx_packet_page_request {
+    uint16_t command;
+    uint16_t flags;
+    uint32_t reserved0;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t reserved1;
+} zx_packet_page_request_t;
+
 typedef struct zx_port_packet {
     uint64_t key;
     uint32_t type;
@@ -144,6 +163,7 @@ typedef struct zx_port_packet {
         zx_packet_guest_io_t guest_io;
         zx_packet_guest_vcpu_t guest_vcpu;
         zx_packet_interrupt_t interrupt;
+        zx_packet_page_request_t page_request;
     };
 } zx_port_packet_t;
 
@@ -12,6 +12,8 @@ __BEGIN_CDECLS
 // clang-format off
 
 #define ZX_PROFILE_INFO_SCHEDULER   1
+#define ZX_PROFILE_INFO_DEADLINE    2
+#define ZX_PROFILE_INFO_CPU_AFFINITY 3
 
 typedef struct zx_profile_scheduler {
     int32_t priority;
@@ -20,6 +22,23 @@ typedef struct zx_profile_scheduler {
     uint32_t quantum;
 } zx_profile_scheduler_t;
 
+// A deadline profile guarantees a thread |capacity| of cpu time within
+// |relative_deadline| of the start of every |period|. Deadline threads are
+// scheduled earliest-deadline-first ahead of all priority based threads.
+// Requires 0 < capacity <= relative_deadline <= period.
+typedef struct zx_profile_deadline {
+    zx_duration_t capacity;
+    zx_duration_t relative_deadline;
+    zx_duration_t period;
+} zx_profile_deadline_t;
+
+// A cpu affinity profile restricts a thread to the cpus set in |cpu_mask|,
+// e.g. to run next to the cpu an interrupt is steered to. At least one of
+// them must be online when the profile is applied.
+typedef struct zx_profile_cpu_affinity {
+    uint32_t cpu_mask;
+} zx_profile_cpu_affinity_t;
+
 #define ZX_PRIORITY_LOWEST              0
 #define ZX_PRIORITY_LOW                 8
 #define ZX_PRIORITY_DEFAULT             16
@@ -30,6 +49,8 @@ typedef struct zx_profile_info {
     uint32_t type;                  // one of ZX_PROFILE_INFO_
     union {
         zx_profile_scheduler_t scheduler;
+        zx_profile_deadline_t deadline;
+        zx_profile_cpu_affinity_t cpu_affinity;
     };
 } zx_profile_info_t;
 
@@ -168,6 +168,7 @@ typedef uint32_t zx_signals_t;
 
 // VMO
 #define ZX_VMO_ZERO_CHILDREN        __ZX_OBJECT_SIGNALED
+#define ZX_VMO_DISCARDED            __ZX_OBJECT_SIGNAL_4
 
 // global kernel object id.
 typedef uint64_t zx_koid_t;
@@ -188,6 +189,14 @@ typedef struct zx_channel_call_args {
     uint32_t rd_num_handles;
 } zx_channel_call_args_t;
 
+// One buffer of a message written by zx_channel_writev() or read by
+// zx_channel_readv().
+typedef struct zx_channel_iovec {
+    void* buffer;
+    uint32_t capacity;
+    uint32_t reserved;
+} zx_channel_iovec_t;
+
 // Maximum number of wait items allowed for zx_object_wait_many()
 // TODO(ZX-1349) Re-lower this.
 #define ZX_WAIT_MANY_MAX_ITEMS ((size_t)16)
@@ -199,6 +208,18 @@ typedef struct zx_wait_item {
     zx_signals_t pending;
 } zx_wait_item_t;
 
+// Options for zx_waitset_add(). By default an entry is level triggered and is
+// reported by every zx_waitset_wait() while its signals are asserted.
+// ZX_WAITSET_EDGE reports it once each time one of its signals becomes asserted.
+#define ZX_WAITSET_EDGE ((uint32_t)1u << 0)
+
+// Structure for zx_waitset_wait():
+typedef struct zx_waitset_result {
+    uint64_t key;
+    zx_status_t status;
+    zx_signals_t observed;
+} zx_waitset_result_t;
+
 typedef uint32_t zx_rights_t;
 #define ZX_RIGHT_NONE             ((zx_rights_t)0u)
 #define ZX_RIGHT_DUPLICATE        ((zx_rights_t)1u << 0)
@@ -239,6 +260,7 @@ typedef uint32_t zx_rights_t;
 
 // VM Object creation options
 #define ZX_VMO_NON_RESIZABLE             ((uint32_t)1u)
+#define ZX_VMO_DISCARDABLE               ((uint32_t)1u << 1)
 
 // VM Object opcodes
 #define ZX_VMO_OP_COMMIT                 ((uint32_t)1u)
@@ -251,9 +273,18 @@ typedef uint32_t zx_rights_t;
 #define ZX_VMO_OP_CACHE_CLEAN            ((uint32_t)8u)
 #define ZX_VMO_OP_CACHE_CLEAN_INVALIDATE ((uint32_t)9u)
 
+// One operation of a zx_vmo_op_range_batch() call, which fills in |status|.
+typedef struct zx_vmo_op_range_entry {
+    uint32_t op;
+    zx_status_t status;
+    uint64_t offset;
+    uint64_t size;
+} zx_vmo_op_range_entry_t;
+
 // VM Object clone flags
 #define ZX_VMO_CLONE_COPY_ON_WRITE        ((uint32_t)1u << 0)
 #define ZX_VMO_CLONE_NON_RESIZEABLE       ((uint32_t)1u << 1)
+#define ZX_VMO_CLONE_SNAPSHOT             ((uint32_t)1u << 2)
 
 typedef uint32_t zx_vm_option_t;
 // Mapping flags to vmar routines
@@ -270,6 +301,10 @@ typedef uint32_t zx_vm_option_t;
 #define ZX_VM_MAP_RANGE             ((zx_vm_option_t)(1u << 10))
 #define ZX_VM_REQUIRE_NON_RESIZABLE ((zx_vm_option_t)(1u << 11))
 
+// Option for zx_aspace_template_add(): map a copy-on-write clone of the VMO,
+// made afresh each time the template is applied, rather than the VMO itself.
+#define ZX_ASPACE_TEMPLATE_COW      ((zx_vm_option_t)(1u << 31))
+
 
 // virtual address
 typedef uintptr_t zx_vaddr_t;
@@ -312,9 +347,11 @@ typedef uint64_t zx_off_t;
 
 // Channel options and limits.
 #define ZX_CHANNEL_READ_MAY_DISCARD         ((uint32_t)1u)
+#define ZX_CHANNEL_WRITE_MOVE_PAGES         ((uint32_t)2u)
 
 #define ZX_CHANNEL_MAX_MSG_BYTES            ((uint32_t)65536u)
 #define ZX_CHANNEL_MAX_MSG_HANDLES          ((uint32_t)64u)
+#define ZX_CHANNEL_MAX_MSG_IOVECS           ((uint32_t)16u)
 
 // Socket options and limits.
 // These options can be passed to zx_socket_write()
@@ -327,10 +364,49 @@ typedef uint64_t zx_off_t;
 #define ZX_SOCKET_DATAGRAM                  ((uint32_t)1u << 0)
 #define ZX_SOCKET_HAS_CONTROL               ((uint32_t)1u << 1)
 #define ZX_SOCKET_HAS_ACCEPT                ((uint32_t)1u << 2)
-#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | ZX_SOCKET_HAS_ACCEPT)
+#define ZX_SOCKET_RING                      ((uint32_t)1u << 3)
+#define ZX_SOCKET_CREATE_MASK               (ZX_SOCKET_DATAGRAM | ZX_SOCKET_HAS_CONTROL | ZX_SOCKET_HAS_ACCEPT | \
+                                             ZX_SOCKET_RING)
 
 // These can be passed to zx_socket_read() and zx_socket_write().
 #define ZX_SOCKET_CONTROL                   ((uint32_t)1u << 2)
+#define ZX_SOCKET_RING_ADVANCE              ((uint32_t)1u << 3)
+
+// These can be passed to zx_socket_get_ring().
+#define ZX_SOCKET_RING_RX                   ((uint32_t)0u)
+#define ZX_SOCKET_RING_TX                   ((uint32_t)1u << 0)
+
+// The first page of a ZX_SOCKET_RING VMO. The kernel rewrites it after every
+// transfer; |head| and |tail| count bytes ever written and read, and the data
+// for stream offset n lives at ZX_SOCKET_RING_DATA_OFFSET + n % |size|.
+typedef struct zx_socket_ring_header {
+    uint64_t head;
+    uint64_t tail;
+    uint64_t size;
+    uint64_t reserved;
+} zx_socket_ring_header_t;
+
+#define ZX_SOCKET_RING_DATA_OFFSET          ((uint64_t)4096u)
+
+// These can be passed to zx_fifo_create().
+#define ZX_FIFO_SHARED                      ((uint32_t)1u << 0)
+
+// These can be passed to zx_fifo_get_ring().
+#define ZX_FIFO_RING_RX                     ((uint32_t)0u)
+#define ZX_FIFO_RING_TX                     ((uint32_t)1u << 0)
+
+// The start of a ZX_FIFO_SHARED ring VMO. |head| counts entries ever written
+// and is only advanced by the writer; |tail| counts entries ever read and is
+// only advanced by the reader. Entry n is at ZX_FIFO_RING_DATA_OFFSET +
+// (n % |elem_count|) * |elem_size|.
+typedef struct zx_fifo_ring_header {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t elem_count;
+    uint32_t elem_size;
+} zx_fifo_ring_header_t;
+
+#define ZX_FIFO_RING_DATA_OFFSET            ((uint64_t)4096u)
 
 // Flags which can be used to to control cache policy for APIs which map memory.
 #define ZX_CACHE_POLICY_CACHED              ((uint32_t)0u)
@@ -355,6 +431,15 @@ typedef uint64_t zx_off_t;
 #define ZX_BTI_PERM_EXECUTE       ((uint32_t)1u << 2)
 #define ZX_BTI_COMPRESS           ((uint32_t)1u << 3)
 #define ZX_BTI_CONTIGUOUS         ((uint32_t)1u << 4)
+#define ZX_BTI_CACHED             ((uint32_t)1u << 5)
+
+// One range of a zx_bti_pin_batch() call.
+typedef struct zx_bti_pin_range {
+    zx_handle_t vmo;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+} zx_bti_pin_range_t;
 
 typedef uint32_t zx_obj_type_t;
 
@@ -382,7 +467,10 @@ typedef uint32_t zx_obj_type_t;
 #define ZX_OBJ_TYPE_PROFILE         ((zx_obj_type_t)25u)
 #define ZX_OBJ_TYPE_PMT             ((zx_obj_type_t)26u)
 #define ZX_OBJ_TYPE_SUSPEND_TOKEN   ((zx_obj_type_t)27u)
-#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)28u)
+#define ZX_OBJ_TYPE_PAGER           ((zx_obj_type_t)28u)
+#define ZX_OBJ_TYPE_WAITSET         ((zx_obj_type_t)29u)
+#define ZX_OBJ_TYPE_ASPACE_TEMPLATE ((zx_obj_type_t)30u)
+#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)31u)
 
 typedef struct zx_handle_info {
     zx_handle_t handle;
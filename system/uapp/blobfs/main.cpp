@@ -54,6 +54,13 @@ int Mount(fbl::unique_fd fd, blobfs::MountOptions* options) {
                             fbl::move(root), fbl::move(loop_quit)) != ZX_OK) {
         return -1;
     }
+    // The calling thread serves too.
+    for (uint32_t i = 1; i < options->dispatch_threads; i++) {
+        if (loop.StartThread() != ZX_OK) {
+            FS_TRACE_ERROR("blobfs: Could not start dispatcher thread %u\n", i);
+            break;
+        }
+    }
     loop.Run();
     return ZX_OK;
 }
@@ -97,6 +104,8 @@ int usage() {
             "\n"
             "options: -r|--readonly  Mount filesystem read-only\n"
             "         -m|--metrics   Collect filesystem metrics\n"
+            "         -c|--cache <mb> Keep up to <mb> MiB of closed blobs in memory\n"
+            "         -t|--threads <n> Serve connections on <n> threads\n"
             "         -h|--help      Display this message\n"
             "\n"
             "On Fuchsia, blobfs takes the block device argument by handle.\n"
@@ -118,11 +127,13 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
             {"readonly", no_argument, nullptr, 'r'},
             {"metrics", no_argument, nullptr, 'm'},
             {"journal", no_argument, nullptr, 'j'},
+            {"cache", required_argument, nullptr, 'c'},
+            {"threads", required_argument, nullptr, 't'},
             {"help", no_argument, nullptr, 'h'},
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjh", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmjc:t:h", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -136,6 +147,26 @@ int ProcessArgs(int argc, char** argv, CommandFunction* func, blobfs::MountOptio
         case 'j':
             options->journal = true;
             break;
+        case 'c': {
+            char* end;
+            unsigned long mb = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0') {
+                return usage();
+            }
+            options->cache_policy = blobfs::CachePolicy::EvictLeastRecentlyUsed;
+            options->cache_budget = mb << 20;
+            break;
+        }
+        case 't': {
+            char* end;
+            unsigned long threads = strtoul(optarg, &end, 10);
+            if (*optarg == '\0' || *end != '\0' || threads == 0 ||
+                threads > blobfs::kMaxDispatchThreads) {
+                return usage();
+            }
+            options->dispatch_threads = static_cast<uint32_t>(threads);
+            break;
+        }
         case 'h':
         default:
             return usage();
@@ -8,12 +8,15 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include <threads.h>
 
 #include <block-client/cpp/client.h>
 #include <crypto/bytes.h>
 #include <fbl/algorithm.h>
 #include <fbl/array.h>
 #include <fbl/auto_call.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_fd.h>
 #include <fbl/vector.h>
 #include <fs-management/fvm.h>
@@ -33,6 +36,7 @@
 #include <zircon/skipblock/c/fidl.h>
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
+#include <zircon/thread_annotations.h>
 #include <zxcrypt/volume.h>
 
 #include "fvm/fvm-sparse.h"
@@ -126,12 +130,176 @@ zx_status_t RegisterFastBlockIo(const fbl::unique_fd& fd, const zx::vmo& vmo,
     return block_client::Client::Create(fbl::move(fifo), client_out);
 }
 
+// The stream vmo is split into this many chunks, each of which holds the
+// data of one batch of writes. The image is read, and decompressed, into one
+// chunk while those before it are written out, so the memory in flight is
+// bounded by the size of the vmo.
+constexpr size_t kStreamChunkCount = 4;
+constexpr size_t kStreamChunkSize = 1 << 20;
+
+// Writes the chunks of a stream vmo to a partition from a thread of its own.
+class StreamWriter {
+public:
+    StreamWriter(const fzl::VmoMapper& mapper, const block_client::Client& client,
+                 const block_fifo_request_t& request, size_t block_size, uint32_t max_transfer)
+        : mapper_(mapper), client_(client), request_(request), block_size_(block_size),
+          max_transfer_blocks_(max_transfer == BLOCK_MAX_TRANSFER_UNBOUNDED ?
+                               UINT32_MAX : static_cast<uint32_t>(max_transfer / block_size)) {
+        cnd_init(&submitted_);
+        cnd_init(&completed_);
+    }
+
+    ~StreamWriter() {
+        if (started_) {
+            {
+                fbl::AutoLock lock(&lock_);
+                exit_ = true;
+                cnd_signal(&submitted_);
+            }
+            thrd_join(thread_, nullptr);
+        }
+        cnd_destroy(&submitted_);
+        cnd_destroy(&completed_);
+    }
+
+    zx_status_t Start() {
+        if (max_transfer_blocks_ == 0 || kStreamChunkSize % block_size_ != 0) {
+            ERROR("Unsupported block size: %zu\n", block_size_);
+            return ZX_ERR_NOT_SUPPORTED;
+        }
+        if (thrd_create_with_name(&thread_, WriterThread, this, "pave-stream-writer") !=
+            thrd_success) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+        started_ = true;
+        return ZX_OK;
+    }
+
+    // Returns the next chunk to fill, once the last write from it has
+    // completed, or nullptr if any write has failed.
+    uint8_t* NextChunk() {
+        fbl::AutoLock lock(&lock_);
+        while (submitted_count_ - written_count_ == kStreamChunkCount && status_ == ZX_OK) {
+            cnd_wait(&completed_, lock_.GetInternal());
+        }
+        if (status_ != ZX_OK) {
+            return nullptr;
+        }
+        return static_cast<uint8_t*>(mapper_.start()) +
+               (submitted_count_ % kStreamChunkCount) * kStreamChunkSize;
+    }
+
+    // Queues a write of the first |length| bytes of the chunk returned by
+    // NextChunk to byte |offset| of the partition.
+    void Submit(size_t length, size_t offset) {
+        fbl::AutoLock lock(&lock_);
+        pending_[submitted_count_ % kStreamChunkCount] = { length, offset };
+        submitted_count_++;
+        cnd_signal(&submitted_);
+    }
+
+    // Waits for all queued writes, and returns the first error any of them hit.
+    zx_status_t Drain() {
+        fbl::AutoLock lock(&lock_);
+        while (written_count_ != submitted_count_ && status_ == ZX_OK) {
+            cnd_wait(&completed_, lock_.GetInternal());
+        }
+        return status_;
+    }
+
+private:
+    struct PendingWrite {
+        size_t length;
+        size_t offset;
+    };
+
+    static int WriterThread(void* arg) {
+        static_cast<StreamWriter*>(arg)->Run();
+        return 0;
+    }
+
+    void Run() {
+        lock_.Acquire();
+        while (true) {
+            while (written_count_ == submitted_count_ && !exit_) {
+                cnd_wait(&submitted_, lock_.GetInternal());
+            }
+            if (written_count_ == submitted_count_) {
+                break;
+            }
+            const size_t chunk = written_count_ % kStreamChunkCount;
+            const PendingWrite write = pending_[chunk];
+            zx_status_t status = ZX_OK;
+            if (status_ == ZX_OK) {
+                lock_.Release();
+                status = Write(chunk, write);
+                lock_.Acquire();
+            }
+            if (status != ZX_OK && status_ == ZX_OK) {
+                status_ = status;
+            }
+            written_count_++;
+            cnd_signal(&completed_);
+        }
+        lock_.Release();
+    }
+
+    // Writes a chunk in as few requests as the device's transfer size allows,
+    // sending up to a group's worth of them at a time.
+    zx_status_t Write(size_t chunk, const PendingWrite& write) const {
+        block_fifo_request_t requests[MAX_TXN_GROUP_COUNT];
+        const uint64_t vmo_offset = chunk * kStreamChunkSize / block_size_;
+        const uint64_t dev_offset = write.offset / block_size_;
+        const uint64_t blocks = write.length / block_size_;
+        uint64_t done = 0;
+        while (done < blocks) {
+            size_t count = 0;
+            while (count < fbl::count_of(requests) && done < blocks) {
+                const uint64_t length = fbl::min(blocks - done,
+                                                 static_cast<uint64_t>(max_transfer_blocks_));
+                requests[count] = request_;
+                requests[count].length = static_cast<uint32_t>(length);
+                requests[count].vmo_offset = vmo_offset + done;
+                requests[count].dev_offset = dev_offset + done;
+                count++;
+                done += length;
+            }
+            zx_status_t status;
+            if ((status = client_.Transaction(requests, count)) != ZX_OK) {
+                ERROR("Error writing partition data\n");
+                return status;
+            }
+        }
+        return ZX_OK;
+    }
+
+    const fzl::VmoMapper& mapper_;
+    const block_client::Client& client_;
+    const block_fifo_request_t request_;
+    const size_t block_size_;
+    const uint32_t max_transfer_blocks_;
+    thrd_t thread_;
+    bool started_ = false;
+
+    fbl::Mutex lock_;
+    cnd_t submitted_;
+    cnd_t completed_;
+    // Chunk |n % kStreamChunkCount| holds the |n|th write, which is pending
+    // from |written_count_| up to |submitted_count_|.
+    PendingWrite pending_[kStreamChunkCount] TA_GUARDED(lock_);
+    size_t submitted_count_ TA_GUARDED(lock_) = 0;
+    size_t written_count_ TA_GUARDED(lock_) = 0;
+    bool exit_ TA_GUARDED(lock_) = false;
+    zx_status_t status_ TA_GUARDED(lock_) = ZX_OK;
+};
+
 // Stream an FVM partition to disk.
+//
+// Reading and decompressing the image overlaps with writing it: each chunk of
+// the stream vmo is handed to |writer| once it has been filled.
 zx_status_t StreamFvmPartition(fvm::SparseReader* reader, PartitionInfo* part,
-                               const fzl::VmoMapper& mapper, const block_client::Client& client,
-                               size_t block_size, block_fifo_request_t* request) {
+                               StreamWriter* writer, size_t block_size) {
     size_t slice_size = reader->Image()->slice_size;
-    const size_t vmo_cap = mapper.size();
     for (size_t e = 0; e < part->pd->extent_count; e++) {
         LOG("Writing extent %zu... \n", e);
         fvm::extent_descriptor_t* ext = GetExtent(part->pd, e);
@@ -140,41 +308,28 @@ zx_status_t StreamFvmPartition(fvm::SparseReader* reader, PartitionInfo* part,
 
         // Write real data
         while (bytes_left > 0) {
-            size_t vmo_sz = 0;
-            size_t actual;
-            zx_status_t status = reader->ReadData(
-                &reinterpret_cast<uint8_t*>(mapper.start())[vmo_sz],
-                fbl::min(bytes_left, vmo_cap - vmo_sz), &actual);
-            vmo_sz += actual;
+            uint8_t* chunk = writer->NextChunk();
+            if (chunk == nullptr) {
+                return writer->Drain();
+            }
+            size_t actual = 0;
+            zx_status_t status = reader->ReadData(chunk, fbl::min(bytes_left, kStreamChunkSize),
+                                                  &actual);
             bytes_left -= actual;
 
-            if (vmo_sz == 0) {
+            if (actual == 0) {
                 ERROR("Read nothing from src_fd; %zu bytes left\n", bytes_left);
                 return ZX_ERR_IO;
-            } else if (vmo_sz % block_size != 0) {
-                ERROR("Cannot write non-block size multiple: %zu\n", vmo_sz);
+            } else if (actual % block_size != 0) {
+                ERROR("Cannot write non-block size multiple: %zu\n", actual);
                 return ZX_ERR_IO;
             } else if (status != ZX_OK) {
                 ERROR("Error reading partition data\n");
                 return status;
             }
 
-            uint64_t length = vmo_sz / block_size;
-            if (length > UINT32_MAX) {
-                ERROR("Error writing partition: Too large\n");
-                return ZX_ERR_OUT_OF_RANGE;
-            }
-            request->length = static_cast<uint32_t>(length);
-            request->vmo_offset = 0;
-            request->dev_offset = offset / block_size;
-
-            ssize_t r;
-            if ((r = client.Transaction(request, 1)) != ZX_OK) {
-                ERROR("Error writing partition data\n");
-                return static_cast<zx_status_t>(r);
-            }
-
-            offset += vmo_sz;
+            writer->Submit(actual, offset);
+            offset += actual;
         }
 
         // Write trailing zeroes (which are implied, but were omitted from
@@ -182,29 +337,25 @@ zx_status_t StreamFvmPartition(fvm::SparseReader* reader, PartitionInfo* part,
         bytes_left = (ext->slice_count * slice_size) - ext->extent_length;
         if (bytes_left > 0) {
             LOG("%zu bytes written, %zu zeroes left\n", ext->extent_length, bytes_left);
-            memset(mapper.start(), 0, vmo_cap);
         }
         while (bytes_left > 0) {
-            uint64_t length = fbl::min(bytes_left, vmo_cap) / block_size;
-            if (length > UINT32_MAX) {
-                ERROR("Error writing trailing zeroes: Too large\n");
-                return ZX_ERR_OUT_OF_RANGE;
+            uint8_t* chunk = writer->NextChunk();
+            if (chunk == nullptr) {
+                return writer->Drain();
             }
-            request->length = static_cast<uint32_t>(length);
-            request->vmo_offset = 0;
-            request->dev_offset = offset / block_size;
-
-            zx_status_t status;
-            if ((status = client.Transaction(request, 1)) != ZX_OK) {
-                ERROR("Error writing trailing zeroes\n");
-                return status;
+            const size_t length = fbl::round_down(fbl::min(bytes_left, kStreamChunkSize),
+                                                  block_size);
+            if (length == 0) {
+                ERROR("Cannot write non-block size multiple of zeroes: %zu\n", bytes_left);
+                return ZX_ERR_IO;
             }
-
-            offset += request->length * block_size;
-            bytes_left -= request->length * block_size;
+            memset(chunk, 0, length);
+            writer->Submit(length, offset);
+            offset += length;
+            bytes_left -= length;
         }
     }
-    return ZX_OK;
+    return writer->Drain();
 }
 
 // Stream a raw (non-FVM) partition to a vmo.
@@ -761,7 +912,7 @@ zx_status_t FvmStreamPartitions(fbl::unique_fd partition_fd, fbl::unique_fd src_
 
     LOG("Partition space pre-allocated successfully.\n");
 
-    constexpr size_t vmo_size = 1 << 20;
+    constexpr size_t vmo_size = kStreamChunkCount * kStreamChunkSize;
 
     fzl::VmoMapper mapping;
     zx::vmo vmo;
@@ -794,8 +945,12 @@ zx_status_t FvmStreamPartitions(fbl::unique_fd partition_fd, fbl::unique_fd src_
         request.opcode = BLOCKIO_WRITE;
 
         LOG("Streaming partition %zu\n", p);
-        status = StreamFvmPartition(reader.get(), &parts[p], mapping, client, block_size,
-                                    &request);
+        {
+            StreamWriter writer(mapping, client, request, block_size, binfo.max_transfer_size);
+            if ((status = writer.Start()) == ZX_OK) {
+                status = StreamFvmPartition(reader.get(), &parts[p], &writer, block_size);
+            }
+        }
         LOG("Done streaming partition %zu\n", p);
         if (status != ZX_OK) {
             ERROR("Failed to stream partition\n");
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/algorithm.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <fuchsia/sysinfo/c/fidl.h>
@@ -62,13 +63,8 @@ zx_status_t get_root_resource(zx::resource* root_resource) {
     return ZX_OK;
 }
 
-zx_status_t get_kmem_stats(zx_info_kmem_stats_t* kmem_stats) {
-    zx::resource root_resource;
-    zx_status_t ret = get_root_resource(&root_resource);
-    if (ret != ZX_OK) {
-        return ret;
-    }
-
+zx_status_t get_kmem_stats(const zx::resource& root_resource,
+                           zx_info_kmem_stats_t* kmem_stats) {
     zx_status_t err = zx_object_get_info(
         root_resource.get(), ZX_INFO_KMEM_STATS, kmem_stats, sizeof(*kmem_stats), nullptr, nullptr);
     if (err != ZX_OK) {
@@ -80,10 +76,51 @@ zx_status_t get_kmem_stats(zx_info_kmem_stats_t* kmem_stats) {
     return ZX_OK;
 }
 
+// Tracks how much the number of free pages in the PMM moves around, from
+// kmem stats sampled about once a second.
+class PmmSampler {
+public:
+    explicit PmmSampler(const zx_info_kmem_stats_t& stats)
+        : last_free_(stats.free_bytes), min_free_(stats.free_bytes),
+          max_free_(stats.free_bytes) {}
+
+    void Sample(const zx_info_kmem_stats_t& stats) {
+        uint64_t free = stats.free_bytes;
+        churn_ += (free > last_free_) ? free - last_free_ : last_free_ - free;
+        last_free_ = free;
+        min_free_ = fbl::min(min_free_, free);
+        max_free_ = fbl::max(max_free_, free);
+        vmo_bytes_ = stats.vmo_bytes;
+    }
+
+    // Print the free memory range and churn seen since the last report, and
+    // start a new reporting interval.
+    void Report(zx::duration interval) {
+        const double mb = 1024 * 1024;
+        const double secs = static_cast<double>(interval.get()) / 1e9;
+        printf("pmm: free %.1f MB (min %.1f MB, max %.1f MB), vmo %.1f MB, "
+               "churn %.1f MB/s\n",
+               static_cast<double>(last_free_) / mb, static_cast<double>(min_free_) / mb,
+               static_cast<double>(max_free_) / mb, static_cast<double>(vmo_bytes_) / mb,
+               static_cast<double>(churn_) / mb / secs);
+        min_free_ = max_free_ = last_free_;
+        churn_ = 0;
+    }
+
+private:
+    uint64_t last_free_;
+    uint64_t min_free_;
+    uint64_t max_free_;
+    uint64_t vmo_bytes_ = 0;
+    // sum of the changes in free memory between samples
+    uint64_t churn_ = 0;
+};
+
 void print_help(char** argv, FILE* f) {
     fprintf(f, "Usage: %s [options]\n", argv[0]);
     fprintf(f, "options:\n");
     fprintf(f, "\t-h:                   This help\n");
+    fprintf(f, "\t-m [time in seconds]: measure performance, printing stats at this interval\n");
     fprintf(f, "\t-t [time in seconds]: stop all tests after the time has elapsed\n");
     fprintf(f, "\t-v:                   verbose, status output\n");
 }
@@ -95,13 +132,24 @@ int main(int argc, char** argv) {
 
     bool verbose = false;
     zx::duration run_duration = zx::duration::infinite();
+    zx::duration report_interval = zx::duration::infinite();
 
     int c;
-    while ((c = getopt(argc, argv, "ht:v")) > 0) {
+    while ((c = getopt(argc, argv, "hm:t:v")) > 0) {
         switch (c) {
         case 'h':
             print_help(argv, stdout);
             return 0;
+        case 'm': {
+            long t = atol(optarg);
+            if (t <= 0) {
+                fprintf(stderr, "bad measurement interval argument\n");
+                print_help(argv, stderr);
+                return 1;
+            }
+            report_interval = zx::sec(t);
+            break;
+        }
         case 't': {
             long t = atol(optarg);
             if (t <= 0) {
@@ -122,9 +170,17 @@ int main(int argc, char** argv) {
         }
     }
 
+    const bool measure = (report_interval != zx::duration::infinite());
+
+    zx::resource root_resource;
+    status = get_root_resource(&root_resource);
+    if (status != ZX_OK) {
+        return 1;
+    }
+
     // read some system stats for each test to use
     zx_info_kmem_stats_t kmem_stats;
-    status = get_kmem_stats(&kmem_stats);
+    status = get_kmem_stats(root_resource, &kmem_stats);
     if (status != ZX_OK) {
         fprintf(stderr, "error reading kmem stats\n");
         return 1;
@@ -139,7 +195,7 @@ int main(int argc, char** argv) {
     // initialize all the tests
     for (auto& test : StressTest::tests()) {
         printf("Initializing %s test\n", test->name());
-        status = test->Init(verbose, kmem_stats);
+        status = test->Init(verbose, measure, kmem_stats);
         if (status != ZX_OK) {
             fprintf(stderr, "error initializing test\n");
             return 1;
@@ -160,6 +216,8 @@ int main(int argc, char** argv) {
     fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
 
     zx::time start_time = zx::clock::get_monotonic();
+    zx::time last_report_time = start_time;
+    PmmSampler pmm(kmem_stats);
     bool stop = false;
     for (;;) {
         // look for ctrl-c for terminals that do not support it
@@ -177,6 +235,23 @@ int main(int argc, char** argv) {
         // wait for a second to try again
         zx::nanosleep(zx::deadline_after(zx::sec(1)));
 
+        if (measure) {
+            if (get_kmem_stats(root_resource, &kmem_stats) == ZX_OK) {
+                pmm.Sample(kmem_stats);
+            }
+
+            zx::time now = zx::clock::get_monotonic();
+            if (now - last_report_time >= report_interval) {
+                zx::duration interval = now - last_report_time;
+                last_report_time = now;
+                printf("--- %" PRIu64 " seconds ---\n", (now - start_time).to_secs());
+                pmm.Report(interval);
+                for (auto& test : StressTest::tests()) {
+                    test->ReportStats(interval);
+                }
+            }
+        }
+
         if (run_duration != zx::duration::infinite()) {
             zx::time now = zx::clock::get_monotonic();
             if (now - start_time >= run_duration) {
@@ -9,6 +9,7 @@
 #include <fbl/macros.h>
 #include <fbl/vector.h>
 #include <fbl/unique_ptr.h>
+#include <lib/zx/time.h>
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
 
@@ -26,8 +27,12 @@ public:
     // the test here.
     //
     // If overridden in a subclass, call through to this version first.
-    virtual zx_status_t Init(bool verbose, const zx_info_kmem_stats& stats) {
+    //
+    // If |measure| is set, the test should record performance statistics
+    // while it runs, to be printed by ReportStats().
+    virtual zx_status_t Init(bool verbose, bool measure, const zx_info_kmem_stats& stats) {
         verbose_ = verbose;
+        measure_ = measure;
 
         // gather some info about the system
         kmem_stats_ = stats;
@@ -42,6 +47,10 @@ public:
     // been shut down.
     virtual zx_status_t Stop() = 0;
 
+    // Called periodically in measurement mode to print the statistics
+    // gathered over the last |interval|, which should then be reset.
+    virtual void ReportStats(zx::duration interval) {}
+
     // Return the name of the test in C string format
     virtual const char* name() const = 0;
 
@@ -76,6 +85,7 @@ protected:
     }
 
     bool verbose_{false};
+    bool measure_{false};
     zx_info_kmem_stats_t kmem_stats_{};
     uint32_t num_cpus_{};
 };
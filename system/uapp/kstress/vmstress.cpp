@@ -27,6 +27,31 @@
 
 #include "stress_test.h"
 
+// Counters for one kind of VM operation. Each worker thread has its own
+// set, which the reporting thread reads and sums.
+struct OpStats {
+    // Latencies are bucketed by power of two nanoseconds.
+    static constexpr size_t kBuckets = 64;
+
+    void Record(zx_duration_t latency, uint64_t len) {
+        size_t bucket = latency > 0 ? 64 - __builtin_clzll(latency) : 0;
+        count.fetch_add(1, fbl::memory_order_relaxed);
+        bytes.fetch_add(len, fbl::memory_order_relaxed);
+        buckets[bucket].fetch_add(1, fbl::memory_order_relaxed);
+    }
+
+    fbl::atomic<uint64_t> count{0};
+    fbl::atomic<uint64_t> bytes{0};
+    fbl::atomic<uint64_t> buckets[kBuckets]{};
+};
+
+// A plain copy of the OpStats summed over all the worker threads.
+struct OpTotals {
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t buckets[OpStats::kBuckets];
+};
+
 class VmStressTest : public StressTest {
 public:
     VmStressTest() = default;
@@ -34,17 +59,37 @@ public:
 
     virtual zx_status_t Start();
     virtual zx_status_t Stop();
+    virtual void ReportStats(zx::duration interval);
 
     virtual const char* name() const { return "VM Stress"; }
 
 private:
-    int stress_thread();
+    enum Op {
+        kCommit,
+        kDecommit,
+        kMap,
+        kUnmap,
+        kRead,
+        kWrite,
+        kFault,
+        kOpCount,
+    };
+
+    static constexpr size_t kNumThreads = 16;
+
+    int stress_thread(size_t index);
 
-    thrd_t threads_[16]{};
+    thrd_t threads_[kNumThreads]{};
 
     // used by the worker threads at runtime
     fbl::atomic<bool> shutdown_{false};
     zx::vmo vmo_{};
+
+    // per-thread statistics, only updated in measurement mode
+    OpStats stats_[kNumThreads][kOpCount];
+
+    // totals at the time of the last report
+    OpTotals last_totals_[kOpCount]{};
 };
 
 // our singleton
@@ -61,8 +106,34 @@ VmStressTest vmstress;
 // that the apis do not return an error.
 //
 // Will evolve over time to use multiple VMOs simultaneously along with cloned vmos.
+//
+// In measurement mode each operation is also timed, and writes through the mapping
+// first decommit the page they touch so that the time taken to fault it back in
+// can be recorded.
 
-int VmStressTest::stress_thread() {
+namespace {
+
+const char* const kOpNames[] = {
+    "commit", "decommit", "map", "unmap", "read", "write", "fault",
+};
+
+// Returns the (exclusive) upper bound in nanoseconds of the bucket that
+// holds the |percentile|th percentile of the latencies in |totals|.
+uint64_t LatencyPercentile(const OpTotals& totals, uint64_t percentile) {
+    uint64_t target = (totals.count * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < OpStats::kBuckets - 1; i++) {
+        seen += totals.buckets[i];
+        if (seen >= target) {
+            return 1ull << i;
+        }
+    }
+    return 1ull << (OpStats::kBuckets - 1);
+}
+
+} // namespace
+
+int VmStressTest::stress_thread(size_t index) {
     zx_status_t status;
 
     uintptr_t ptr = 0;
@@ -87,62 +158,82 @@ int VmStressTest::stress_thread() {
 
     ZX_ASSERT(buf_size < vmo_size);
 
+    OpStats* stats = stats_[index];
+    auto record = [this, stats](Op op, zx_time_t start, uint64_t len) {
+        if (measure_) {
+            stats[op].Record(zx_clock_get_monotonic() - start, len);
+        }
+    };
+
     while (!shutdown_.load()) {
         uint64_t off, len;
+        zx_time_t start;
 
         int r = rand() % 100;
         switch (r) {
         case 0 ... 9: // commit a range of the vmo
             Printf("c");
             rand_vmo_range(&off, &len);
+            start = zx_clock_get_monotonic();
             status = vmo_.op_range(ZX_VMO_OP_COMMIT, off, len, nullptr, 0);
             if (status != ZX_OK) {
                 fprintf(stderr, "failed to commit range, error %d (%s)\n", status, zx_status_get_string(status));
             }
+            record(kCommit, start, len);
             break;
         case 10 ... 19: // decommit a range of the vmo
             Printf("d");
             rand_vmo_range(&off, &len);
+            start = zx_clock_get_monotonic();
             status = vmo_.op_range(ZX_VMO_OP_DECOMMIT, off, len, nullptr, 0);
             if (status != ZX_OK) {
                 fprintf(stderr, "failed to decommit range, error %d (%s)\n", status, zx_status_get_string(status));
             }
+            record(kDecommit, start, len);
             break;
         case 20 ... 29:
             if (ptr) {
                 // unmap the vmo if it already was
                 Printf("u");
+                start = zx_clock_get_monotonic();
                 status = zx::vmar::root_self()->unmap(ptr, vmo_size);
                 if (status != ZX_OK) {
                     fprintf(stderr, "failed to unmap range, error %d (%s)\n", status, zx_status_get_string(status));
                 }
+                record(kUnmap, start, 0);
                 ptr = 0;
             }
             // map it somewhere
             Printf("m");
+            start = zx_clock_get_monotonic();
             status = zx::vmar::root_self()->map(0, vmo_, 0, vmo_size,
                                                 ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, &ptr);
             if (status != ZX_OK) {
                 fprintf(stderr, "failed to map range, error %d (%s)\n", status, zx_status_get_string(status));
             }
+            record(kMap, start, 0);
             break;
         case 30 ... 39:
             // read from a random range of the vmo
             Printf("r");
             rand_buffer_range(&off, &len);
+            start = zx_clock_get_monotonic();
             status = vmo_.read(buf.get(), off, len);
             if (status != ZX_OK) {
                 fprintf(stderr, "error reading from vmo\n");
             }
+            record(kRead, start, len);
             break;
         case 40 ... 49:
             // write to a random range of the vmo
             Printf("w");
             rand_buffer_range(&off, &len);
+            start = zx_clock_get_monotonic();
             status = vmo_.write(buf.get(), off, len);
             if (status != ZX_OK) {
                 fprintf(stderr, "error writing to vmo\n");
             }
+            record(kWrite, start, len);
             break;
         case 50 ... 74:
             // read from a random range of the vmo via a direct memory reference
@@ -157,12 +248,24 @@ int VmStressTest::stress_thread() {
             if (ptr) {
                 Printf("W");
                 rand_buffer_range(&off, &len);
+                if (measure_) {
+                    // Time a first touch of a freshly decommitted page. Another
+                    // thread may commit it again in between, so this also
+                    // samples the cost of writing to a resident page.
+                    uint64_t page = fbl::round_down(off, static_cast<uint64_t>(PAGE_SIZE));
+                    vmo_.op_range(ZX_VMO_OP_DECOMMIT, page, PAGE_SIZE, nullptr, 0);
+                    start = zx_clock_get_monotonic();
+                    *reinterpret_cast<volatile uint8_t*>(ptr + page) = 0;
+                    record(kFault, start, PAGE_SIZE);
+                }
                 memcpy(reinterpret_cast<void *>(ptr + off), buf.get(), len);
             }
             break;
         }
 
-        fflush(stdout);
+        if (verbose_) {
+            fflush(stdout);
+        }
     }
 
     if (ptr) {
@@ -188,14 +291,18 @@ zx_status_t VmStressTest::Start() {
 
     // create a pile of threads
     // TODO: scale based on the number of cores in the system and/or command line arg
+    struct WorkerArgs {
+        VmStressTest* test;
+        size_t index;
+    };
     auto worker = [](void* arg) -> int {
-        VmStressTest* test = static_cast<VmStressTest*>(arg);
+        fbl::unique_ptr<WorkerArgs> args(static_cast<WorkerArgs*>(arg));
 
-        return test->stress_thread();
+        return args->test->stress_thread(args->index);
     };
 
-    for (auto& t : threads_) {
-        thrd_create_with_name(&t, worker, this, "vmstress_worker");
+    for (size_t i = 0; i < kNumThreads; i++) {
+        thrd_create_with_name(&threads_[i], worker, new WorkerArgs{this, i}, "vmstress_worker");
     }
 
     return ZX_OK;
@@ -210,3 +317,38 @@ zx_status_t VmStressTest::Stop() {
 
     return ZX_OK;
 }
+
+void VmStressTest::ReportStats(zx::duration interval) {
+    static_assert(fbl::count_of(kOpNames) == kOpCount, "");
+    const double secs = static_cast<double>(interval.get()) / 1e9;
+
+    for (size_t op = 0; op < kOpCount; op++) {
+        // sum the counters of all the threads and take the difference from the last report
+        OpTotals totals{};
+        for (size_t t = 0; t < kNumThreads; t++) {
+            const OpStats& stats = stats_[t][op];
+            totals.count += stats.count.load(fbl::memory_order_relaxed);
+            totals.bytes += stats.bytes.load(fbl::memory_order_relaxed);
+            for (size_t i = 0; i < OpStats::kBuckets; i++) {
+                totals.buckets[i] += stats.buckets[i].load(fbl::memory_order_relaxed);
+            }
+        }
+        OpTotals delta = totals;
+        delta.count -= last_totals_[op].count;
+        delta.bytes -= last_totals_[op].bytes;
+        for (size_t i = 0; i < OpStats::kBuckets; i++) {
+            delta.buckets[i] -= last_totals_[op].buckets[i];
+        }
+        last_totals_[op] = totals;
+
+        if (delta.count == 0) {
+            continue;
+        }
+        PrintfAlways("vmstress: %-8s %10.0f ops/s %10.1f MB/s  latency p50 <%" PRIu64
+                     "ns p90 <%" PRIu64 "ns p99 <%" PRIu64 "ns\n",
+                     kOpNames[op], static_cast<double>(delta.count) / secs,
+                     static_cast<double>(delta.bytes) / secs / (1024 * 1024),
+                     LatencyPercentile(delta, 50), LatencyPercentile(delta, 90),
+                     LatencyPercentile(delta, 99));
+    }
+}
@@ -2,74 +2,161 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <threads.h>
 #include <unistd.h>
 
+#include <fuchsia/sysinfo/c/fidl.h>
+#include <lib/fdio/util.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/resource.h>
 #include <zircon/errors.h>
+#include <zircon/process.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/syscalls/profile.h>
+#include <zircon/threads.h>
 #include <zircon/time.h>
 #include <zircon/types.h>
-#include <zircon/syscalls.h>
 #include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
+#include <fbl/array.h>
 #include <fbl/auto_call.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/limits.h>
+#include <fbl/string.h>
+#include <fbl/string_printf.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 
 static constexpr uint32_t kDefaultNumThreads = 4;
 static constexpr float kDefaultMinWorkMsec = 5.0f;
 static constexpr float kDefaultMaxWorkMsec = 15.0f;
 static constexpr float kDefaultMinSleepMsec = 1.0f;
 static constexpr float kDefaultMaxSleepMsec = 2.5f;
+static constexpr uint32_t kDefaultTimerPeriodUsec = 500;
+static constexpr const char* kDefaultIoPath = "/tmp";
+
+// Blocking I/O threads rewrite random blocks of a file of this size.
+static constexpr size_t kIoBlockSize = 4096;
+static constexpr size_t kIoFileSize = 1024 * 1024;
+
+// What a load thread does while it is working.
+enum class LoadType {
+    kCpu,    // floating point math
+    kIpc,    // channel round trips with a peer thread
+    kIo,     // synchronous file writes
+    kTimer,  // short sleeps, measuring how late each wakeup is
+};
+
+static const char* const kLoadTypeNames[] = { "cpu", "ipc", "io", "timer" };
+
+// Settings for a group of load threads, parsed from one load spec.
+struct LoadProfile {
+    LoadType type = LoadType::kCpu;
+    uint32_t num_threads = kDefaultNumThreads;
+    float min_work_msec = kDefaultMinWorkMsec;
+    float max_work_msec = kDefaultMaxWorkMsec;
+    float min_sleep_msec = kDefaultMinSleepMsec;
+    float max_sleep_msec = kDefaultMaxSleepMsec;
+
+    // Scheduler priority for the threads, or -1 to leave the default.
+    int32_t priority = -1;
+    // Deadline profile for the threads, used if |deadline_period| is non-zero.
+    zx_duration_t deadline_capacity = 0;
+    zx_duration_t deadline_relative = 0;
+    zx_duration_t deadline_period = 0;
+
+    zx_duration_t timer_period = ZX_USEC(kDefaultTimerPeriodUsec);
+    fbl::String io_path = kDefaultIoPath;
+};
 
 class LoadGeneratorThread :
     public fbl::SinglyLinkedListable<fbl::unique_ptr<LoadGeneratorThread>> {
 public:
-    LoadGeneratorThread(unsigned int seed) : seed_(seed) { }
+    LoadGeneratorThread(const LoadProfile& profile, uint32_t group, uint32_t id,
+                        unsigned int seed)
+        : profile_(profile), group_(group), id_(id), seed_(seed) { }
     ~LoadGeneratorThread();
 
-    zx_status_t Start();
+    zx_status_t Start(const zx::resource& root_resource);
 
-    static float& min_work_msec() { return min_work_msec_; }
-    static float& max_work_msec() { return max_work_msec_; }
-    static float& min_sleep_msec() { return min_sleep_msec_; }
-    static float& max_sleep_msec() { return max_sleep_msec_; }
+    // Stops the thread and waits for it to exit.
+    void Join();
+
+    // Prints what this thread got done. Only valid once the thread has been joined.
+    void PrintStats(zx_duration_t elapsed) const;
 
 private:
     int Run();
+    int RunIpcPeer();
+
+    zx_status_t SetupWork();
+    void DoWork();
+    void TeardownWork();
+    zx_status_t ApplyProfile(const zx::resource& root_resource, zx_handle_t thread);
 
     double MakeRandomDouble(double min, double max);
 
-    static float min_work_msec_;
-    static float max_work_msec_;
-    static float min_sleep_msec_;
-    static float max_sleep_msec_;
     static volatile bool quit_;
 
+    const LoadProfile& profile_;
+    const uint32_t group_;
+    const uint32_t id_;
     unsigned int seed_;
-    bool thread_started_;
+    bool thread_started_ = false;
     thrd_t thread_;
     volatile double accumulator_;
+
+    // kIpc state
+    zx::channel channel_;
+    zx::channel peer_channel_;
+    bool peer_started_ = false;
+    thrd_t peer_thread_;
+
+    // kIo state
+    int fd_ = -1;
+    fbl::String io_file_;
+    uint8_t io_buf_[kIoBlockSize] = {};
+
+    // Statistics, written by the thread and read once it has been joined.
+    uint64_t ops_ = 0;
+    zx_duration_t runtime_ = 0;
+    zx_duration_t total_lateness_ = 0;
+    zx_duration_t max_lateness_ = 0;
 };
 
-float LoadGeneratorThread::min_work_msec_ = kDefaultMinWorkMsec;
-float LoadGeneratorThread::max_work_msec_ = kDefaultMaxWorkMsec;
-float LoadGeneratorThread::min_sleep_msec_ = kDefaultMinSleepMsec;
-float LoadGeneratorThread::max_sleep_msec_ = kDefaultMaxSleepMsec;
 volatile bool LoadGeneratorThread::quit_ = false;
 
 LoadGeneratorThread::~LoadGeneratorThread() {
+    Join();
+}
+
+void LoadGeneratorThread::Join() {
     if (thread_started_) {
         int musl_ret;
         quit_ = true;
         thrd_join(thread_, &musl_ret);
+        thread_started_ = false;
     }
+    TeardownWork();
 }
 
-zx_status_t LoadGeneratorThread::Start() {
+zx_status_t LoadGeneratorThread::Start(const zx::resource& root_resource) {
     if (thread_started_) return ZX_ERR_BAD_STATE;
 
+    zx_status_t res = SetupWork();
+    if (res != ZX_OK) {
+        return res;
+    }
+
     int c11_res = thrd_create(
             &thread_,
             [](void* ctx) -> int { return static_cast<LoadGeneratorThread*>(ctx)->Run(); },
@@ -80,8 +167,145 @@ zx_status_t LoadGeneratorThread::Start() {
         // TODO(johngro) : translate musl error
         return ZX_ERR_INTERNAL;
     }
+    thread_started_ = true;
 
-    return ZX_OK;
+    res = ApplyProfile(root_resource, thrd_get_zx_handle(thread_));
+    if ((res == ZX_OK) && peer_started_) {
+        res = ApplyProfile(root_resource, thrd_get_zx_handle(peer_thread_));
+    }
+    return res;
+}
+
+zx_status_t LoadGeneratorThread::ApplyProfile(const zx::resource& root_resource,
+                                              zx_handle_t thread) {
+    zx_profile_info_t info = {};
+    if (profile_.deadline_period != 0) {
+        info.type = ZX_PROFILE_INFO_DEADLINE;
+        info.deadline.capacity = profile_.deadline_capacity;
+        info.deadline.relative_deadline = profile_.deadline_relative;
+        info.deadline.period = profile_.deadline_period;
+    } else if (profile_.priority >= 0) {
+        info.type = ZX_PROFILE_INFO_SCHEDULER;
+        info.scheduler.priority = profile_.priority;
+    } else {
+        return ZX_OK;
+    }
+
+    zx::handle profile;
+    zx_status_t res = zx_profile_create(root_resource.get(), &info,
+                                        profile.reset_and_get_address());
+    if (res != ZX_OK) {
+        printf("Failed to create scheduler profile (res %d)\n", res);
+        return res;
+    }
+    return zx_object_set_profile(thread, profile.get(), 0);
+}
+
+zx_status_t LoadGeneratorThread::SetupWork() {
+    switch (profile_.type) {
+    case LoadType::kIpc: {
+        zx_status_t res = zx::channel::create(0, &channel_, &peer_channel_);
+        if (res != ZX_OK) {
+            return res;
+        }
+        int c11_res = thrd_create(
+                &peer_thread_,
+                [](void* ctx) -> int {
+                    return static_cast<LoadGeneratorThread*>(ctx)->RunIpcPeer();
+                },
+                this);
+        if (c11_res != thrd_success) {
+            printf("Failed to create IPC peer thread (res %d)!\n", c11_res);
+            return ZX_ERR_INTERNAL;
+        }
+        peer_started_ = true;
+        return ZX_OK;
+    }
+    case LoadType::kIo:
+        io_file_ = fbl::StringPrintf("%s/loadgen-%u-%u", profile_.io_path.c_str(), group_, id_);
+        fd_ = open(io_file_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            printf("Failed to create %s\n", io_file_.c_str());
+            return ZX_ERR_IO;
+        }
+        if (ftruncate(fd_, kIoFileSize) != 0) {
+            printf("Failed to size %s\n", io_file_.c_str());
+            return ZX_ERR_IO;
+        }
+        return ZX_OK;
+    default:
+        return ZX_OK;
+    }
+}
+
+void LoadGeneratorThread::TeardownWork() {
+    if (peer_started_) {
+        // Closing our end of the channel tells the peer to exit.
+        channel_.reset();
+        thrd_join(peer_thread_, nullptr);
+        peer_started_ = false;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        unlink(io_file_.c_str());
+        fd_ = -1;
+    }
+}
+
+int LoadGeneratorThread::RunIpcPeer() {
+    uint8_t byte;
+    for (;;) {
+        zx_signals_t observed;
+        zx_status_t res = peer_channel_.wait_one(ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                                 zx::time::infinite(), &observed);
+        if ((res != ZX_OK) || !(observed & ZX_CHANNEL_READABLE)) {
+            return 0;
+        }
+        if ((peer_channel_.read(0, &byte, sizeof(byte), nullptr, nullptr, 0, nullptr) != ZX_OK) ||
+            (peer_channel_.write(0, &byte, sizeof(byte), nullptr, 0) != ZX_OK)) {
+            return 0;
+        }
+    }
+}
+
+void LoadGeneratorThread::DoWork() {
+    constexpr double kMinNum = 1.0;
+    constexpr double kMaxNum = 100000000.0;
+
+    switch (profile_.type) {
+    case LoadType::kCpu: {
+        accumulator_ += MakeRandomDouble(kMinNum, kMaxNum);
+        accumulator_ *= MakeRandomDouble(kMinNum, kMaxNum);
+        accumulator_ -= MakeRandomDouble(kMinNum, kMaxNum);
+        accumulator_ /= MakeRandomDouble(kMinNum, kMaxNum);
+
+        double tmp = accumulator_;
+        accumulator_  = fbl::clamp<double>(tmp, 0.0, kMaxNum);
+        break;
+    }
+    case LoadType::kIpc: {
+        uint8_t byte = 0;
+        channel_.write(0, &byte, sizeof(byte), nullptr, 0);
+        channel_.wait_one(ZX_CHANNEL_READABLE, zx::time::infinite(), nullptr);
+        channel_.read(0, &byte, sizeof(byte), nullptr, nullptr, 0, nullptr);
+        break;
+    }
+    case LoadType::kIo: {
+        off_t block = rand_r(&seed_) % (kIoFileSize / kIoBlockSize);
+        pwrite(fd_, io_buf_, kIoBlockSize, block * kIoBlockSize);
+        fsync(fd_);
+        break;
+    }
+    case LoadType::kTimer: {
+        zx_time_t deadline = zx_deadline_after(profile_.timer_period);
+        zx_nanosleep(deadline);
+        zx_duration_t lateness = zx_time_sub_time(zx_clock_get_monotonic(), deadline);
+        total_lateness_ += lateness;
+        max_lateness_ = fbl::max(max_lateness_, lateness);
+        break;
+    }
+    }
+    ++ops_;
 }
 
 int LoadGeneratorThread::Run() {
@@ -90,27 +314,21 @@ int LoadGeneratorThread::Run() {
     uint32_t ticks_per_msec = static_cast<uint32_t>(zx_ticks_per_second() / 1000);
     accumulator_ = MakeRandomDouble(kMinNum, kMaxNum);
 
-    // While it is not time to quit, waste time performing pointless double
-    // precision floating point math.
+    // While it is not time to quit, alternate between doing this thread's kind of
+    // work and sleeping.
     while (!quit_) {
-        double work_delay = MakeRandomDouble(min_work_msec(), max_work_msec());
+        double work_delay = MakeRandomDouble(profile_.min_work_msec, profile_.max_work_msec);
         zx_ticks_t work_deadline_ticks = zx_ticks_get()
                                        + static_cast<zx_ticks_t>(work_delay * ticks_per_msec);
 
         while (!quit_ && (zx_ticks_get() < work_deadline_ticks)) {
-            accumulator_ += MakeRandomDouble(kMinNum, kMaxNum);
-            accumulator_ *= MakeRandomDouble(kMinNum, kMaxNum);
-            accumulator_ -= MakeRandomDouble(kMinNum, kMaxNum);
-            accumulator_ /= MakeRandomDouble(kMinNum, kMaxNum);
-
-            double tmp = accumulator_;
-            accumulator_  = fbl::clamp<double>(tmp, 0.0, kMaxNum);
+            DoWork();
         }
 
         if (quit_)
             break;
 
-        double sleep_delay = MakeRandomDouble(min_sleep_msec(), max_sleep_msec());
+        double sleep_delay = MakeRandomDouble(profile_.min_sleep_msec, profile_.max_sleep_msec);
         zx_time_t sleep_deadline =
             zx_deadline_after(static_cast<zx_duration_t>(sleep_delay * 1000000.0));
 
@@ -130,35 +348,273 @@ int LoadGeneratorThread::Run() {
         } while (!quit_);
     }
 
+    // The thread's handle is closed once it has been joined, so sample its
+    // runtime on the way out.
+    zx_info_thread_stats_t stats;
+    if (zx_object_get_info(zx_thread_self(), ZX_INFO_THREAD_STATS, &stats, sizeof(stats),
+                           nullptr, nullptr) == ZX_OK) {
+        runtime_ = stats.total_runtime;
+    }
+
     return 0;
 }
 
+void LoadGeneratorThread::PrintStats(zx_duration_t elapsed) const {
+    double secs = static_cast<double>(elapsed) / ZX_SEC(1);
+    printf("%5u %5u %-5s %12.3f %6.1f%% %12" PRIu64 " %12.1f",
+           group_, id_, kLoadTypeNames[static_cast<size_t>(profile_.type)],
+           static_cast<double>(runtime_) / ZX_MSEC(1),
+           100.0 * static_cast<double>(runtime_) / static_cast<double>(elapsed),
+           ops_, static_cast<double>(ops_) / secs);
+    if ((profile_.type == LoadType::kTimer) && (ops_ > 0)) {
+        printf("  late avg %.1f usec max %.1f usec",
+               static_cast<double>(total_lateness_) / static_cast<double>(ops_) / ZX_USEC(1),
+               static_cast<double>(max_lateness_) / ZX_USEC(1));
+    }
+    printf("\n");
+}
+
 double LoadGeneratorThread::MakeRandomDouble(double min, double max) {
     double norm(rand_r(&seed_));
     norm /= fbl::numeric_limits<int>::max();
     return min + (norm * (max - min));
 }
 
+static zx_status_t get_root_resource(zx::resource* root_resource) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    zx::channel channel;
+    zx_status_t status = fdio_get_service_handle(fd, channel.reset_and_get_address());
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    zx_handle_t h;
+    zx_status_t fidl_status = fuchsia_sysinfo_DeviceGetRootResource(channel.get(), &status, &h);
+    if (fidl_status != ZX_OK) {
+        return fidl_status;
+    } else if (status != ZX_OK) {
+        return status;
+    }
+
+    root_resource->reset(h);
+    return ZX_OK;
+}
+
+static zx_status_t get_cpu_stats(const zx::resource& root_resource,
+                                 fbl::Array<zx_info_cpu_stats_t>* stats) {
+    size_t num_cpus = zx_system_get_num_cpus();
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<zx_info_cpu_stats_t[]> buf(new (&ac) zx_info_cpu_stats_t[num_cpus]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    size_t actual;
+    zx_status_t res = zx_object_get_info(root_resource.get(), ZX_INFO_CPU_STATS, buf.get(),
+                                         num_cpus * sizeof(zx_info_cpu_stats_t),
+                                         &actual, nullptr);
+    if (res == ZX_OK) {
+        stats->reset(buf.release(), actual);
+    }
+    return res;
+}
+
+// Prints the change in the per cpu scheduler counters over the run.
+static void print_cpu_stats(const fbl::Array<zx_info_cpu_stats_t>& before,
+                            const fbl::Array<zx_info_cpu_stats_t>& after,
+                            zx_duration_t elapsed) {
+    double secs = static_cast<double>(elapsed) / ZX_SEC(1);
+    printf("\n%4s %6s %12s %12s %12s %12s\n",
+           "cpu", "busy", "csw/s", "preempt/s", "irq_pre/s", "resch_ipi/s");
+    for (size_t i = 0; i < fbl::min(before.size(), after.size()); ++i) {
+        const zx_info_cpu_stats_t& b = before[i];
+        const zx_info_cpu_stats_t& a = after[i];
+        double idle = static_cast<double>(a.idle_time - b.idle_time);
+        printf("%4u %5.1f%% %12.1f %12.1f %12.1f %12.1f\n",
+               a.cpu_number, 100.0 * (1.0 - idle / static_cast<double>(elapsed)),
+               static_cast<double>(a.context_switches - b.context_switches) / secs,
+               static_cast<double>(a.preempts - b.preempts) / secs,
+               static_cast<double>(a.irq_preempts - b.irq_preempts) / secs,
+               static_cast<double>(a.reschedule_ipis - b.reschedule_ipis) / secs);
+    }
+}
+
+static bool parse_range(const char* value, float* min, float* max) {
+    if (sscanf(value, "%f:%f", min, max) != 2) return false;
+    return (*min > 0.0f) && (*min <= *max);
+}
+
+// Parses a load spec of the form <type>[,key=value...] into |profile|.
+static bool parse_load_spec(const char* spec, LoadProfile* profile) {
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) return false;
+    strcpy(buf, spec);
+
+    char* save;
+    char* type = strtok_r(buf, ",", &save);
+    if (type == nullptr) return false;
+    size_t i;
+    for (i = 0; i < fbl::count_of(kLoadTypeNames); ++i) {
+        if (!strcmp(type, kLoadTypeNames[i])) {
+            profile->type = static_cast<LoadType>(i);
+            break;
+        }
+    }
+    if (i == fbl::count_of(kLoadTypeNames)) return false;
+
+    for (char* opt = strtok_r(nullptr, ",", &save); opt; opt = strtok_r(nullptr, ",", &save)) {
+        char* value = strchr(opt, '=');
+        if (value == nullptr) return false;
+        *value++ = '\0';
+
+        if (!strcmp(opt, "threads")) {
+            if (sscanf(value, "%u", &profile->num_threads) != 1) return false;
+            if (profile->num_threads == 0) return false;
+        } else if (!strcmp(opt, "work")) {
+            if (!parse_range(value, &profile->min_work_msec, &profile->max_work_msec))
+                return false;
+        } else if (!strcmp(opt, "sleep")) {
+            if (!parse_range(value, &profile->min_sleep_msec, &profile->max_sleep_msec))
+                return false;
+        } else if (!strcmp(opt, "priority")) {
+            if (sscanf(value, "%d", &profile->priority) != 1) return false;
+            if ((profile->priority < ZX_PRIORITY_LOWEST) ||
+                (profile->priority > ZX_PRIORITY_HIGHEST))
+                return false;
+        } else if (!strcmp(opt, "deadline")) {
+            uint32_t capacity, relative, period;
+            if (sscanf(value, "%u:%u:%u", &capacity, &relative, &period) != 3) return false;
+            if ((capacity == 0) || (capacity > relative) || (relative > period)) return false;
+            profile->deadline_capacity = ZX_USEC(capacity);
+            profile->deadline_relative = ZX_USEC(relative);
+            profile->deadline_period = ZX_USEC(period);
+        } else if (!strcmp(opt, "period")) {
+            uint32_t period;
+            if (sscanf(value, "%u", &period) != 1) return false;
+            profile->timer_period = ZX_USEC(period);
+        } else if (!strcmp(opt, "path")) {
+            profile->io_path = value;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Reads load specs from |path|, one per line. Blank lines and lines starting
+// with '#' are skipped.
+static bool parse_load_file(const char* path, fbl::Vector<LoadProfile>* profiles) {
+    FILE* f = fopen(path, "r");
+    if (f == nullptr) {
+        printf("Failed to open %s\n", path);
+        return false;
+    }
+    auto close_file = fbl::MakeAutoCall([f]() { fclose(f); });
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        line[strcspn(line, "\r\n")] = '\0';
+        const char* spec = line + strspn(line, " \t");
+        if ((*spec == '\0') || (*spec == '#')) continue;
+
+        LoadProfile profile;
+        if (!parse_load_spec(spec, &profile)) {
+            printf("Bad load spec \"%s\" in %s\n", spec, path);
+            return false;
+        }
+        profiles->push_back(fbl::move(profile));
+    }
+    return true;
+}
+
 void usage(const char* program_name) {
-    printf("usage: %s [N] [min_work max_work] [min_sleep max_sleep] [seed]\n"
-           "  All arguments are positional and optional.\n"
+    printf("usage: %s [-l spec]... [-f file] [-t seconds] [-s]\n"
+           "       %s [N] [min_work max_work] [min_sleep max_sleep] [seed]\n"
+           "  -l spec       : Add a group of load threads.  See below.\n"
+           "  -f file       : Add the groups of load threads listed in file, one spec per line.\n"
+           "  -t seconds    : Run for this long rather than until a key is pressed.\n"
+           "  -s            : Print per thread runtime and per cpu scheduler stats at exit,\n"
+           "                  and dump the kernel scheduler latency histograms to the debug log.\n"
+           "\n"
+           "  With no -l or -f, the positional arguments describe a single group of cpu threads.\n"
            "  N             : Number of threads to create.  Default %u\n"
            "  min/max_work  : Min/max msec for threads to work for.  Default %.1f,%.1f mSec\n"
            "  min/max_sleep : Min/max msec for threads to sleep for.  Default %.1f,%.1f mSec\n"
-           "  seed          : RNG seed to use.  Defaults to seeding from zx_clock_get\n",
+           "  seed          : RNG seed to use.  Defaults to seeding from zx_clock_get\n"
+           "\n"
+           "  A load spec is <type>[,key=value...], where type is one of\n"
+           "    cpu         : floating point math\n"
+           "    ipc         : channel round trips with a peer thread\n"
+           "    io          : synchronous 4K writes to a file\n"
+           "    timer       : back to back short sleeps, measuring wakeup lateness\n"
+           "  and the keys are\n"
+           "    threads=N                     : number of threads.  Default %u\n"
+           "    work=min:max                  : msec to work for.  Default %.1f:%.1f\n"
+           "    sleep=min:max                 : msec to sleep for.  Default %.1f:%.1f\n"
+           "    priority=P                    : scheduler priority, %d to %d\n"
+           "    deadline=capacity:deadline:period : deadline profile, in usec\n"
+           "    period=usec                   : timer sleep length.  Default %u\n"
+           "    path=dir                      : directory for io files.  Default %s\n"
+           "  e.g. -l cpu,threads=2,priority=24 -l timer,period=100 -l io,path=/data\n",
+           program_name,
            program_name,
            kDefaultNumThreads,
            kDefaultMinWorkMsec,
            kDefaultMaxWorkMsec,
            kDefaultMinSleepMsec,
-           kDefaultMaxSleepMsec);
+           kDefaultMaxSleepMsec,
+           kDefaultNumThreads,
+           kDefaultMinWorkMsec,
+           kDefaultMaxWorkMsec,
+           kDefaultMinSleepMsec,
+           kDefaultMaxSleepMsec,
+           ZX_PRIORITY_LOWEST,
+           ZX_PRIORITY_HIGHEST,
+           kDefaultTimerPeriodUsec,
+           kDefaultIoPath);
 }
 
 int main(int argc, char** argv) {
     auto show_usage = fbl::MakeAutoCall([argv]() { usage(argv[0]); });
 
-    // 0, 1, 3, 5 and 6 arguments are the only legal number of args.
-    switch (argc) {
+    fbl::Vector<LoadProfile> profiles;
+    zx_duration_t run_duration = ZX_TIME_INFINITE;
+    bool print_stats = false;
+
+    int c;
+    while ((c = getopt(argc, argv, "f:hl:st:")) > 0) {
+        switch (c) {
+        case 'f':
+            if (!parse_load_file(optarg, &profiles)) return -1;
+            break;
+        case 'l': {
+            LoadProfile profile;
+            if (!parse_load_spec(optarg, &profile)) return -1;
+            profiles.push_back(fbl::move(profile));
+            break;
+        }
+        case 's':
+            print_stats = true;
+            break;
+        case 't': {
+            long t = atol(optarg);
+            if (t <= 0) return -1;
+            run_duration = ZX_SEC(t);
+            break;
+        }
+        default:
+            return -1;
+        }
+    }
+
+    // 0, 1, 3, 5 and 6 positional arguments are the only legal number of args.
+    int pos_argc = argc - optind + 1;
+    char** pos_argv = argv + optind - 1;
+    switch (pos_argc) {
     case 1:
     case 2:
     case 4:
@@ -169,77 +625,145 @@ int main(int argc, char** argv) {
         return -1;
     }
 
-    // Parse and sanity check number of threads, if present.
-    uint32_t num_threads = kDefaultNumThreads;
-    if (argc >= 2) {
-        if (sscanf(argv[1], "%u", &num_threads) != 1) return -1;
-        if (num_threads == 0) return -1;
-    }
+    if (profiles.is_empty() || (pos_argc > 1)) {
+        LoadProfile profile;
 
-    // Parse and sanity check min/max work times, if present.
-    if (argc >= 4) {
-        if (sscanf(argv[2], "%f", &LoadGeneratorThread::min_work_msec()) != 1) return -1;
-        if (sscanf(argv[3], "%f", &LoadGeneratorThread::max_work_msec()) != 1) return -1;
-        if (LoadGeneratorThread::min_work_msec() <= 0.0f) return -1;
-        if (LoadGeneratorThread::min_work_msec() > LoadGeneratorThread::max_work_msec()) return -1;
-    }
+        // Parse and sanity check number of threads, if present.
+        if (pos_argc >= 2) {
+            if (sscanf(pos_argv[1], "%u", &profile.num_threads) != 1) return -1;
+            if (profile.num_threads == 0) return -1;
+        }
 
-    // Parse and sanity check min/max sleep times, if present.
-    if (argc >= 6) {
-        if (sscanf(argv[4], "%f", &LoadGeneratorThread::min_sleep_msec()) != 1) return -1;
-        if (sscanf(argv[5], "%f", &LoadGeneratorThread::max_sleep_msec()) != 1) return -1;
-        if (LoadGeneratorThread::min_sleep_msec() <= 0.0f) return -1;
-        if (LoadGeneratorThread::min_sleep_msec() > LoadGeneratorThread::max_sleep_msec())
-            return -1;
+        // Parse and sanity check min/max work times, if present.
+        if (pos_argc >= 4) {
+            if (sscanf(pos_argv[2], "%f", &profile.min_work_msec) != 1) return -1;
+            if (sscanf(pos_argv[3], "%f", &profile.max_work_msec) != 1) return -1;
+            if (profile.min_work_msec <= 0.0f) return -1;
+            if (profile.min_work_msec > profile.max_work_msec) return -1;
+        }
+
+        // Parse and sanity check min/max sleep times, if present.
+        if (pos_argc >= 6) {
+            if (sscanf(pos_argv[4], "%f", &profile.min_sleep_msec) != 1) return -1;
+            if (sscanf(pos_argv[5], "%f", &profile.max_sleep_msec) != 1) return -1;
+            if (profile.min_sleep_msec <= 0.0f) return -1;
+            if (profile.min_sleep_msec > profile.max_sleep_msec) return -1;
+        }
+
+        profiles.push_back(fbl::move(profile));
     }
 
     // Parse the PRNG seed, if present.
     unsigned int seed = static_cast<unsigned int>(zx_clock_get(CLOCK_MONOTONIC));
-    if (argc >= 7) {
-        if (sscanf(argv[6], "%u", &seed) != 1) return -1;
+    if (pos_argc >= 7) {
+        if (sscanf(pos_argv[6], "%u", &seed) != 1) return -1;
     }
 
     // Argument parsing checks out, cancel the showing of the usage message.
     show_usage.cancel();
 
-    printf("Creating %u load generation thread%s.\n"
-           "Work times  : [%.3f, %.3f] mSec\n"
-           "Sleep times : [%.3f, %.3f] mSec\n"
-           "Seed        : %u\n",
-           num_threads,
-           num_threads == 1 ? "" : "s",
-           LoadGeneratorThread::min_work_msec(),
-           LoadGeneratorThread::max_work_msec(),
-           LoadGeneratorThread::min_sleep_msec(),
-           LoadGeneratorThread::max_sleep_msec(),
-           seed);
+    // The root resource is needed for scheduler profiles and cpu stats.
+    zx::resource root_resource;
+    zx_status_t res = get_root_resource(&root_resource);
+    bool need_root = print_stats;
+    for (const auto& profile : profiles) {
+        need_root = need_root || (profile.priority >= 0) || (profile.deadline_period != 0);
+    }
+    if (need_root && (res != ZX_OK)) {
+        printf("Failed to get the root resource (res %d)\n", res);
+        return res;
+    }
+
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const LoadProfile& profile = profiles[i];
+        printf("Group %zu: %u %s load thread%s.\n"
+               "  Work times  : [%.3f, %.3f] mSec\n"
+               "  Sleep times : [%.3f, %.3f] mSec\n",
+               i, profile.num_threads, kLoadTypeNames[static_cast<size_t>(profile.type)],
+               profile.num_threads == 1 ? "" : "s",
+               profile.min_work_msec, profile.max_work_msec,
+               profile.min_sleep_msec, profile.max_sleep_msec);
+        if (profile.deadline_period != 0) {
+            printf("  Deadline    : %" PRIi64 "/%" PRIi64 "/%" PRIi64 " uSec\n",
+                   profile.deadline_capacity / ZX_USEC(1),
+                   profile.deadline_relative / ZX_USEC(1),
+                   profile.deadline_period / ZX_USEC(1));
+        } else if (profile.priority >= 0) {
+            printf("  Priority    : %d\n", profile.priority);
+        }
+    }
+    printf("Seed        : %u\n", seed);
 
     fbl::SinglyLinkedList<fbl::unique_ptr<LoadGeneratorThread>> threads;
-    for (uint32_t i = 0; i < num_threads; ++i) {
-        fbl::AllocChecker ac;
-        fbl::unique_ptr<LoadGeneratorThread> t(new (&ac) LoadGeneratorThread(rand_r(&seed)));
+    for (uint32_t group = 0; group < profiles.size(); ++group) {
+        const LoadProfile& profile = profiles[group];
+        for (uint32_t i = 0; i < profile.num_threads; ++i) {
+            fbl::AllocChecker ac;
+            fbl::unique_ptr<LoadGeneratorThread> t(
+                new (&ac) LoadGeneratorThread(profile, group, i, rand_r(&seed)));
+
+            if (!ac.check()) {
+                printf("Failed to create thread %u/%u of group %u\n",
+                       i + 1, profile.num_threads, group);
+                return -1;
+            }
 
-        if (!ac.check()) {
-            printf("Failed to create thread %u/%u\n", i + 1, num_threads);
-            return -1;
+            threads.push_front(fbl::move(t));
         }
+    }
 
-        threads.push_front(fbl::move(t));
+    fbl::Array<zx_info_cpu_stats_t> cpu_stats_before;
+    if (print_stats && (get_cpu_stats(root_resource, &cpu_stats_before) != ZX_OK)) {
+        printf("Failed to read cpu stats\n");
+        print_stats = false;
     }
+    zx_time_t start_time = zx_clock_get_monotonic();
 
     for (auto& t : threads) {
-        zx_status_t res = t.Start();
+        res = t.Start(root_resource);
         if (res != ZX_OK) {
             printf("Failed to start thread.  (res %d)\n", res);
             return res;
         }
     }
 
-    printf("Running.  Press any key to exit\n");
-    char junk;
-    ::read(STDIN_FILENO, &junk, sizeof(junk));
+    if (run_duration != ZX_TIME_INFINITE) {
+        printf("Running for %" PRIi64 " seconds\n", run_duration / ZX_SEC(1));
+        zx_nanosleep(zx_deadline_after(run_duration));
+    } else {
+        printf("Running.  Press any key to exit\n");
+        char junk;
+        ::read(STDIN_FILENO, &junk, sizeof(junk));
+    }
 
     printf("Shutting down...\n");
+    zx_duration_t elapsed = zx_time_sub_time(zx_clock_get_monotonic(), start_time);
+    fbl::Array<zx_info_cpu_stats_t> cpu_stats_after;
+    if (print_stats && (get_cpu_stats(root_resource, &cpu_stats_after) != ZX_OK)) {
+        printf("Failed to read cpu stats\n");
+        print_stats = false;
+    }
+
+    // Join every thread before looking at its stats.
+    for (auto& t : threads) {
+        t.Join();
+    }
+
+    if (print_stats) {
+        printf("\n%5s %5s %-5s %12s %7s %12s %12s\n",
+               "group", "id", "type", "runtime(ms)", "cpu", "ops", "ops/s");
+        for (const auto& t : threads) {
+            t.PrintStats(elapsed);
+        }
+        print_cpu_stats(cpu_stats_before, cpu_stats_after, elapsed);
+
+        static const char kSchedStats[] = "sched stats";
+        if (zx_debug_send_command(root_resource.get(), kSchedStats,
+                                  strlen(kSchedStats)) == ZX_OK) {
+            printf("\nKernel scheduler latency histograms written to the debug log\n");
+        }
+    }
+
     threads.clear();
     printf("Finished\n");
 
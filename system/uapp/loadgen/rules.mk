@@ -12,6 +12,7 @@ MODULE_SRCS += \
 
 MODULE_STATIC_LIBS := \
     system/ulib/zxcpp \
+    system/ulib/zx \
     system/ulib/fbl
 
 MODULE_LIBS := \
@@ -19,4 +20,7 @@ MODULE_LIBS := \
     system/ulib/zircon \
     system/ulib/c
 
+MODULE_FIDL_LIBS := \
+    system/fidl/fuchsia-sysinfo
+
 include make/module.mk
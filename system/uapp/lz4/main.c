@@ -4,6 +4,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -14,6 +15,7 @@
 #include <unistd.h>
 
 #include <lz4/lz4frame.h>
+#include <zircon/syscalls.h>
 
 #define BLOCK_SIZE 65536
 
@@ -55,6 +57,10 @@ static int do_decompress(const char* infile, const char* outfile) {
     uint8_t inbuf[BLOCK_SIZE];
     uint8_t outbuf[BLOCK_SIZE];
 
+    // Time spent in the decoder alone, to measure decompression throughput.
+    zx_duration_t decode_time = 0;
+    size_t total_out = 0;
+
     // Read first 4 bytes to let LZ4 tell us how much it expects in the first
     // pass.
     size_t src_sz = 4;
@@ -84,7 +90,10 @@ static int do_decompress(const char* infile, const char* outfile) {
 
         while (pos < nr) {
             dst_sz = BLOCK_SIZE;
+            zx_time_t start = zx_clock_get_monotonic();
             next = LZ4F_decompress(dctx, outbuf, &dst_sz, inbuf + pos, &src_sz, NULL);
+            decode_time += zx_clock_get_monotonic() - start;
+            total_out += dst_sz;
             if (LZ4F_isError(next)) {
                 fprintf(stderr, "could not decompress %s: %s\n", infile, LZ4F_getErrorName(to_read));
                 goto done;
@@ -116,6 +125,13 @@ static int do_decompress(const char* infile, const char* outfile) {
         goto done;
     }
 
+    if (decode_time > 0) {
+        double secs = (double)decode_time / ZX_SEC(1);
+        printf("decompressed %zu bytes in %" PRIu64 " us (%.1f MB/s)\n",
+               total_out, (uint64_t)(decode_time / ZX_USEC(1)),
+               (double)total_out / (1024 * 1024) / secs);
+    }
+
 done:
     LZ4F_freeDecompressionContext(dctx);
     close(outfd);
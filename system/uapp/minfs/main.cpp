@@ -82,6 +82,7 @@ int usage() {
                     "    -v|--verbose                  Some debug messages\n"
                     "    -r|--readonly                 Mount filesystem read-only\n"
                     "    -m|--metrics                  Collect filesystem metrics\n"
+                    "    -t|--trim                     Trim all free blocks on mount\n"
                     "    -s|--fvm_data_slices SLICES   When mkfs on top of FVM,\n"
                     "                                  preallocate |SLICES| slices of data. \n"
                     "    -h|--help                     Display this message\n"
@@ -119,6 +120,7 @@ int main(int argc, char** argv) {
         static struct option opts[] = {
             {"readonly", no_argument, nullptr, 'r'},
             {"metrics", no_argument, nullptr, 'm'},
+            {"trim", no_argument, nullptr, 't'},
             {"journal", no_argument, nullptr, 'j'},
             {"verbose", no_argument, nullptr, 'v'},
             {"fvm_data_slices", required_argument, nullptr, 's'},
@@ -126,7 +128,7 @@ int main(int argc, char** argv) {
             {nullptr, 0, nullptr, 0},
         };
         int opt_index;
-        int c = getopt_long(argc, argv, "rmjvhs:", opts, &opt_index);
+        int c = getopt_long(argc, argv, "rmtjvhs:", opts, &opt_index);
         if (c < 0) {
             break;
         }
@@ -137,6 +139,9 @@ int main(int argc, char** argv) {
         case 'm':
             options.metrics = true;
             break;
+        case 't':
+            options.trim = true;
+            break;
         case 'j':
             //TODO(planders): Enable journaling here once minfs supports it.
             fprintf(stderr, "minfs: Journaling option not supported\n");
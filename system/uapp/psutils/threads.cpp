@@ -74,10 +74,10 @@ void dump_memory(zx_handle_t proc, uintptr_t start, size_t len) {
     }
 }
 
-void dump_thread(zx_handle_t process, inspector_dsoinfo_t* dso_list,
-                 uint64_t tid, zx_handle_t thread) {
+void dump_thread(zx_handle_t process, uint64_t tid, zx_handle_t thread,
+                 const char* backtrace) {
     zx_thread_state_general_regs_t regs;
-    zx_vaddr_t pc = 0, sp = 0, fp = 0;
+    zx_vaddr_t sp = 0;
 
     if (inspector_read_general_regs(thread, &regs) != ZX_OK) {
         // Error message has already been printed.
@@ -85,13 +85,9 @@ void dump_thread(zx_handle_t process, inspector_dsoinfo_t* dso_list,
     }
 
 #if defined(__x86_64__)
-    pc = regs.rip;
     sp = regs.rsp;
-    fp = regs.rbp;
 #elif defined(__aarch64__)
-    pc = regs.pc;
     sp = regs.sp;
-    fp = regs.r[29];
 #else
     // It's unlikely we'll get here as trying to read the regs will likely
     // fail, but we don't assume that.
@@ -112,12 +108,23 @@ void dump_thread(zx_handle_t process, inspector_dsoinfo_t* dso_list,
     printf("bottom of user stack:\n");
     dump_memory(process, sp, kMemoryDumpSize);
 
-    inspector_print_backtrace(stdout, process, thread, dso_list, pc, sp, fp, true);
+    if (backtrace != nullptr) {
+        fputs(backtrace, stdout);
+    }
 
     if (verbosity_level >= 1)
         printf("Done handling thread %" PRIu64 ".%" PRIu64 ".\n", get_koid(process), get_koid(thread));
 }
 
+// A thread we've asked to suspend, and where its backtrace was written.
+struct SuspendedThread {
+    zx_koid_t tid;
+    zx_handle_t thread;
+    zx_handle_t suspend_token;
+    char* backtrace;
+    size_t backtrace_size;
+};
+
 void dump_all_threads(uint64_t pid, zx_handle_t process) {
     // First get the thread count so that we can allocate an appropriately
     // sized buffer. This is racy but it's the nature of the beast.
@@ -155,9 +162,8 @@ void dump_all_threads(uint64_t pid, zx_handle_t process) {
     inspector_dsoinfo_t* dso_list = inspector_dso_fetch_list(process);
     inspector_dso_print_list(stdout, dso_list);
 
-    // TODO(dje): Move inspector's DebugInfoCache here, so that we can use it
-    // across all threads.
-
+    // Suspend every thread first so that they can all be unwound at once.
+    fbl::Vector<SuspendedThread> suspended;
     for (size_t i = 0; i < num_threads; ++i) {
         zx_koid_t tid = threads[i];
         zx_handle_t thread;
@@ -176,7 +182,13 @@ void dump_all_threads(uint64_t pid, zx_handle_t process) {
             zx_handle_close(thread);
             continue;
         }
+        suspended.push_back({tid, thread, suspend_token, nullptr, 0});
+    }
 
+    // Wait for them to stop, dropping any that don't.
+    fbl::Vector<zx_handle_t> stopped;
+    fbl::Vector<FILE*> files;
+    for (auto& t : suspended) {
         zx_signals_t observed = 0u;
         // Try to be robust and don't wait forever. The timeout is a little
         // high as we want to work well in really loaded systems.
@@ -186,22 +198,41 @@ void dump_all_threads(uint64_t pid, zx_handle_t process) {
         // forever (or until the timeout). Thus we need to explicitly wait for
         // ZX_THREAD_TERMINATED too.
         zx_signals_t signals = ZX_THREAD_SUSPENDED | ZX_THREAD_TERMINATED;
-        status = zx_object_wait_one(thread, signals, deadline, &observed);
-        if (status == ZX_OK) {
-            if (observed & ZX_THREAD_TERMINATED) {
-                printf("Unable to print backtrace of thread %" PRIu64 ".%" PRIu64 ": terminated\n",
-                       pid, tid);
-            } else {
-                dump_thread(process, dso_list, tid, thread);
-            }
-        } else {
+        status = zx_object_wait_one(t.thread, signals, deadline, &observed);
+        if (status != ZX_OK) {
             print_zx_error(status,
                            "failure waiting for thread %" PRIu64 ".%" PRIu64 " to suspend, skipping",
-                           pid, tid);
+                           pid, t.tid);
+            continue;
         }
+        if (observed & ZX_THREAD_TERMINATED) {
+            printf("Unable to print backtrace of thread %" PRIu64 ".%" PRIu64 ": terminated\n",
+                   pid, t.tid);
+            continue;
+        }
+        FILE* f = open_memstream(&t.backtrace, &t.backtrace_size);
+        if (f == nullptr) {
+            print_error("unable to create backtrace buffer for thread %" PRIu64 ".%" PRIu64,
+                        pid, t.tid);
+            continue;
+        }
+        stopped.push_back(t.thread);
+        files.push_back(f);
+    }
+
+    inspector_print_backtraces(files.get(), process, stopped.get(), stopped.size(),
+                               dso_list, true);
+    for (FILE* f : files) {
+        fclose(f);
+    }
 
-        zx_handle_close(suspend_token);
-        zx_handle_close(thread);
+    for (auto& t : suspended) {
+        if (t.backtrace != nullptr) {
+            dump_thread(process, t.tid, t.thread, t.backtrace);
+            free(t.backtrace);
+        }
+        zx_handle_close(t.suspend_token);
+        zx_handle_close(t.thread);
     }
 
     inspector_dso_free_list(dso_list);
@@ -26,6 +26,26 @@
 // The port wait key associated with the dispatcher's control messages.
 #define KEY_CONTROL (0u)
 
+// The number of packets read from the port at once when a single thread
+// is running the loop.
+#define PACKET_BATCH_SIZE (8u)
+
+// The number of independently locked lists pending waits are spread over,
+// so that threads beginning and dispatching different waits rarely contend.
+#define WAIT_SHARD_COUNT (16u)
+
+// The number of pending tasks the task heap initially has room for.
+#define TASK_HEAP_INITIAL_CAPACITY (16u)
+
+// The number of children of each entry in the task heap.  A wider heap is
+// shallower, and the children of an entry share a cache line.
+#define TASK_HEAP_ARITY (4u)
+
+// The number of times the thread dispatching tasks looks for more tasks that
+// came due while it was busy before handing back to the timer, so that
+// packets on the port still get a turn when tasks keep posting tasks.
+#define TASK_DISPATCH_ROUNDS (4u)
+
 static zx_time_t async_loop_now(async_dispatcher_t* dispatcher);
 static zx_status_t async_loop_begin_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
 static zx_status_t async_loop_cancel_wait(async_dispatcher_t* dispatcher, async_wait_t* wait);
@@ -74,6 +94,18 @@ const async_loop_config_t kAsyncLoopConfigAttachToThread = {
 const async_loop_config_t kAsyncLoopConfigNoAttachToThread = {
     .make_default_for_current_thread = false};
 
+// A pending task in the task heap.
+typedef struct task_entry {
+    zx_time_t deadline;
+    uint64_t sequence; // orders tasks with equal deadlines by when they were posted
+    async_task_t* task;
+} task_entry_t;
+
+typedef struct wait_shard {
+    mtx_t lock; // guards |list|
+    list_node_t list; // most recently added first
+} wait_shard_t;
+
 typedef struct async_loop {
     async_dispatcher_t dispatcher; // must be first (the loop inherits from async_dispatcher_t)
     async_loop_config_t config; // immutable
@@ -83,16 +115,37 @@ typedef struct async_loop {
     _Atomic async_loop_state_t state;
     atomic_uint active_threads; // number of active dispatch threads
 
-    mtx_t lock; // guards the lists and the dispatching tasks flag
-    bool dispatching_tasks; // true while the loop is busy dispatching tasks
-    list_node_t wait_list; // most recently added first
-    list_node_t task_list; // pending tasks, earliest deadline first
-    list_node_t due_list; // due tasks, earliest deadline first
+    mtx_t lock; // guards the thread and exception lists and the packet batch
     list_node_t thread_list; // earliest created thread first
     list_node_t exception_list; // most recently added first
+
+    wait_shard_t wait_shards[WAIT_SHARD_COUNT]; // pending waits
+
+    mtx_t task_lock; // guards the task heap, the due list and the dispatching tasks flag
+    bool dispatching_tasks; // true while the loop is busy dispatching tasks
+    task_entry_t* task_heap; // pending tasks, a min-heap by deadline
+    size_t task_heap_count; // number of valid entries in |task_heap|
+    size_t task_heap_canceled; // number of those whose task was canceled
+    size_t task_heap_capacity; // number of entries allocated for |task_heap|
+    uint64_t task_sequence; // sequence number of the next posted task
+    list_node_t due_list; // due tasks, earliest deadline first
+
+    // Packets read from the port in one batch but not yet dispatched.
+    // |batch| is written without the lock while |batch_reading| is set.
+    zx_port_packet_t batch[PACKET_BATCH_SIZE];
+    size_t batch_next; // index of the next packet to dispatch
+    size_t batch_count; // number of valid entries in |batch|
+    bool batch_reading; // true while a thread is refilling |batch|
+    // Whether |batch| holds packets or is being refilled, so that threads
+    // can skip the lock when it doesn't.  Written with the lock held.
+    atomic_bool batch_pending;
 } async_loop_t;
 
 static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_read_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* packet);
+static bool async_loop_drop_batched_packet_locked(async_loop_t* loop, uint64_t key);
+static void async_loop_update_batch_pending_locked(async_loop_t* loop);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
@@ -109,7 +162,9 @@ static zx_status_t async_loop_dispatch_exception(async_loop_t* loop,
                                                  zx_status_t status,
                                                  const zx_port_packet_t* report);
 static void async_loop_wake_threads(async_loop_t* loop);
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static zx_status_t async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task);
+static async_task_t* async_loop_pop_task_locked(async_loop_t* loop);
+static void async_loop_cancel_task_locked(async_loop_t* loop, size_t index);
 static void async_loop_restart_timer_locked(async_loop_t* loop);
 static void async_loop_invoke_prologue(async_loop_t* loop);
 static void async_loop_invoke_epilogue(async_loop_t* loop);
@@ -144,6 +199,24 @@ static inline async_exception_t* node_to_exception(list_node_t* node) {
     return FROM_NODE(async_exception_t, node);
 }
 
+static inline wait_shard_t* wait_to_shard(async_loop_t* loop, async_wait_t* wait) {
+    uintptr_t key = (uintptr_t)wait;
+    return &loop->wait_shards[((key >> 4) ^ (key >> 12)) % WAIT_SHARD_COUNT];
+}
+
+// A task in the task heap records its index there in its state, in place of
+// the list node's |prev| pointer, and the address of the heap in place of
+// |next|, which no list node can point to.  So |list_in_list()| still tells
+// whether a task is pending, wherever it is, and a task can be found in the
+// heap without searching it.
+static inline bool task_in_heap(async_loop_t* loop, async_task_t* task) {
+    return task->state.reserved[1] == (uintptr_t)&loop->task_heap;
+}
+
+static inline size_t task_heap_index(async_task_t* task) {
+    return (size_t)task->state.reserved[0];
+}
+
 zx_status_t async_loop_create(const async_loop_config_t* config, async_loop_t** out_loop) {
     ZX_DEBUG_ASSERT(out_loop);
     ZX_DEBUG_ASSERT(config != NULL);
@@ -154,16 +227,28 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_loop_t**
     atomic_init(&loop->state, ASYNC_LOOP_RUNNABLE);
     atomic_init(&loop->active_threads, 0u);
 
+    atomic_init(&loop->batch_pending, false);
+
     loop->dispatcher.ops = &async_loop_ops;
     loop->config = *config;
     mtx_init(&loop->lock, mtx_plain);
-    list_initialize(&loop->wait_list);
-    list_initialize(&loop->task_list);
+    mtx_init(&loop->task_lock, mtx_plain);
+    for (size_t i = 0u; i < WAIT_SHARD_COUNT; i++) {
+        mtx_init(&loop->wait_shards[i].lock, mtx_plain);
+        list_initialize(&loop->wait_shards[i].list);
+    }
     list_initialize(&loop->due_list);
     list_initialize(&loop->thread_list);
     list_initialize(&loop->exception_list);
 
-    zx_status_t status = zx_port_create(0u, &loop->port);
+    zx_status_t status = ZX_OK;
+    loop->task_heap = malloc(TASK_HEAP_INITIAL_CAPACITY * sizeof(task_entry_t));
+    if (loop->task_heap)
+        loop->task_heap_capacity = TASK_HEAP_INITIAL_CAPACITY;
+    else
+        status = ZX_ERR_NO_MEMORY;
+    if (status == ZX_OK)
+        status = zx_port_create(ZX_PORT_WAKE_NEWEST, &loop->port);
     if (status == ZX_OK)
         status = zx_timer_create(0u, ZX_CLOCK_MONOTONIC, &loop->timer);
     if (status == ZX_OK) {
@@ -192,6 +277,10 @@ void async_loop_destroy(async_loop_t* loop) {
     zx_handle_close(loop->port);
     zx_handle_close(loop->timer);
     mtx_destroy(&loop->lock);
+    mtx_destroy(&loop->task_lock);
+    for (size_t i = 0u; i < WAIT_SHARD_COUNT; i++)
+        mtx_destroy(&loop->wait_shards[i].lock);
+    free(loop->task_heap);
     free(loop);
 }
 
@@ -208,16 +297,18 @@ void async_loop_shutdown(async_loop_t* loop) {
     async_loop_join_threads(loop);
 
     list_node_t* node;
-    while ((node = list_remove_head(&loop->wait_list))) {
-        async_wait_t* wait = node_to_wait(node);
-        async_loop_dispatch_wait(loop, wait, ZX_ERR_CANCELED, NULL);
+    for (size_t i = 0u; i < WAIT_SHARD_COUNT; i++) {
+        while ((node = list_remove_head(&loop->wait_shards[i].list))) {
+            async_wait_t* wait = node_to_wait(node);
+            async_loop_dispatch_wait(loop, wait, ZX_ERR_CANCELED, NULL);
+        }
     }
     while ((node = list_remove_head(&loop->due_list))) {
         async_task_t* task = node_to_task(node);
         async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
     }
-    while ((node = list_remove_head(&loop->task_list))) {
-        async_task_t* task = node_to_task(node);
+    while (loop->task_heap_count) {
+        async_task_t* task = async_loop_pop_task_locked(loop);
         async_loop_dispatch_task(loop, task, ZX_ERR_CANCELED);
     }
     while ((node = list_remove_head(&loop->exception_list))) {
@@ -259,7 +350,7 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
         return ZX_ERR_CANCELED;
 
     zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet);
+    zx_status_t status = async_loop_read_packet(loop, deadline, &packet);
     if (status != ZX_OK)
         return status;
 
@@ -277,9 +368,10 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
         // Handle wait completion packets.
         if (packet.type == ZX_PKT_TYPE_SIGNAL_ONE) {
             async_wait_t* wait = (void*)(uintptr_t)packet.key;
-            mtx_lock(&loop->lock);
+            wait_shard_t* shard = wait_to_shard(loop, wait);
+            mtx_lock(&shard->lock);
             list_delete(wait_to_node(wait));
-            mtx_unlock(&loop->lock);
+            mtx_unlock(&shard->lock);
             return async_loop_dispatch_wait(loop, wait, packet.status, &packet.signal);
         }
 
@@ -308,6 +400,78 @@ static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
     return ZX_ERR_INTERNAL;
 }
 
+// Reads the next packet to dispatch.  While only one thread is running the
+// loop, packets are read from the port several at a time and handed out from
+// |loop->batch| so that a busy loop makes fewer syscalls.  With more threads,
+// each one waits on the port itself so that packets spread across them.
+static zx_status_t async_loop_read_packet(async_loop_t* loop, zx_time_t deadline,
+                                          zx_port_packet_t* packet) {
+    // With several threads and no batch to drain, which is the usual state of
+    // a multi-threaded loop, go straight to the port.  A thread can only start
+    // a batch while it is alone, and this thread is already counted as active.
+    if (!atomic_load_explicit(&loop->batch_pending, memory_order_acquire) &&
+        atomic_load_explicit(&loop->active_threads, memory_order_acquire) > 1u)
+        return zx_port_wait(loop->port, deadline, packet);
+
+    mtx_lock(&loop->lock);
+    if (loop->batch_next < loop->batch_count) {
+        *packet = loop->batch[loop->batch_next++];
+        async_loop_update_batch_pending_locked(loop);
+        mtx_unlock(&loop->lock);
+        return ZX_OK;
+    }
+    bool batch = !loop->batch_reading &&
+                 atomic_load_explicit(&loop->active_threads, memory_order_acquire) == 1u;
+    if (batch) {
+        loop->batch_reading = true;
+        loop->batch_next = 0u;
+        loop->batch_count = 0u;
+        async_loop_update_batch_pending_locked(loop);
+    }
+    mtx_unlock(&loop->lock);
+
+    if (!batch)
+        return zx_port_wait(loop->port, deadline, packet);
+
+    size_t count = 0u;
+    zx_status_t status = zx_port_wait_many(loop->port, deadline, loop->batch,
+                                           PACKET_BATCH_SIZE, &count);
+
+    mtx_lock(&loop->lock);
+    loop->batch_reading = false;
+    if (status == ZX_OK) {
+        *packet = loop->batch[0];
+        loop->batch_next = 1u;
+        loop->batch_count = count;
+    }
+    async_loop_update_batch_pending_locked(loop);
+    mtx_unlock(&loop->lock);
+    return status;
+}
+
+static void async_loop_update_batch_pending_locked(async_loop_t* loop) {
+    atomic_store_explicit(&loop->batch_pending,
+                          loop->batch_reading || loop->batch_next < loop->batch_count,
+                          memory_order_release);
+}
+
+// Removes a packet with |key| which was read from the port but not yet
+// dispatched, so cancelation behaves as if it had still been on the port.
+static bool async_loop_drop_batched_packet_locked(async_loop_t* loop, uint64_t key) {
+    bool dropped = false;
+    size_t count = loop->batch_next;
+    for (size_t i = loop->batch_next; i < loop->batch_count; i++) {
+        if (loop->batch[i].key == key) {
+            dropped = true;
+            continue;
+        }
+        loop->batch[count++] = loop->batch[i];
+    }
+    loop->batch_count = count;
+    async_loop_update_batch_pending_locked(loop);
+    return dropped;
+}
+
 async_dispatcher_t* async_loop_get_dispatcher(async_loop_t* loop) {
     // Note: The loop's implementation inherits from async_t so we can upcast to it.
     return (async_dispatcher_t*)loop;
@@ -340,45 +504,44 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
     // to cancel a later task which has also come due.  At most one thread
     // can dispatch tasks at any given moment (to preserve serial ordering).
     // Timer restarts are suppressed until we run out of tasks to dispatch.
-    mtx_lock(&loop->lock);
+    mtx_lock(&loop->task_lock);
     if (!loop->dispatching_tasks) {
         loop->dispatching_tasks = true;
 
-        // Extract all of the tasks that are due into |due_list| for dispatch
-        // unless we already have some waiting from a previous iteration which
-        // we would like to process in order.
-        list_node_t* node;
-        if (list_is_empty(&loop->due_list)) {
-            zx_time_t due_time = async_loop_now((async_dispatcher_t*)loop);
-            list_node_t* tail = NULL;
-            list_for_every(&loop->task_list, node) {
-                if (node_to_task(node)->deadline > due_time)
-                    break;
-                tail = node;
+        // Tasks posted while we're dispatching don't restart the timer, so
+        // ones that come due by the time we're done are dispatched here too,
+        // without a trip through the timer and the port to wake a thread.
+        for (uint32_t round = 0u; round < TASK_DISPATCH_ROUNDS; round++) {
+            // Extract all of the tasks that are due into |due_list| for dispatch
+            // unless we already have some waiting from a previous iteration which
+            // we would like to process in order.
+            if (list_is_empty(&loop->due_list)) {
+                zx_time_t due_time = async_loop_now((async_dispatcher_t*)loop);
+                while (loop->task_heap_count && loop->task_heap[0].deadline <= due_time) {
+                    async_task_t* task = async_loop_pop_task_locked(loop);
+                    list_add_tail(&loop->due_list, task_to_node(task));
+                }
             }
-            if (tail) {
-                list_node_t* head = loop->task_list.next;
-                loop->task_list.next = tail->next;
-                tail->next->prev = &loop->task_list;
-                loop->due_list.next = head;
-                head->prev = &loop->due_list;
-                loop->due_list.prev = tail;
-                tail->next = &loop->due_list;
-            }
-        }
-
-        // Dispatch all due tasks.  Note that they might be canceled concurrently
-        // so we need to grab the lock during each iteration to fetch the next
-        // item from the list.
-        while ((node = list_remove_head(&loop->due_list))) {
-            mtx_unlock(&loop->lock);
-
-            // Invoke the handler.  Note that it might destroy itself.
-            async_task_t* task = node_to_task(node);
-            async_loop_dispatch_task(loop, task, ZX_OK);
+            if (list_is_empty(&loop->due_list))
+                break;
 
-            mtx_lock(&loop->lock);
-            async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
+            // Dispatch all due tasks.  Note that they might be canceled concurrently
+            // so we need to grab the lock during each iteration to fetch the next
+            // item from the list.
+            list_node_t* node;
+            async_loop_state_t state = ASYNC_LOOP_RUNNABLE;
+            while ((node = list_remove_head(&loop->due_list))) {
+                mtx_unlock(&loop->task_lock);
+
+                // Invoke the handler.  Note that it might destroy itself.
+                async_task_t* task = node_to_task(node);
+                async_loop_dispatch_task(loop, task, ZX_OK);
+
+                mtx_lock(&loop->task_lock);
+                state = atomic_load_explicit(&loop->state, memory_order_acquire);
+                if (state != ASYNC_LOOP_RUNNABLE)
+                    break;
+            }
             if (state != ASYNC_LOOP_RUNNABLE)
                 break;
         }
@@ -386,7 +549,7 @@ static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop) {
         loop->dispatching_tasks = false;
         async_loop_restart_timer_locked(loop);
     }
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -490,18 +653,19 @@ static zx_status_t async_loop_begin_wait(async_dispatcher_t* async, async_wait_t
     if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
 
-    mtx_lock(&loop->lock);
+    wait_shard_t* shard = wait_to_shard(loop, wait);
+    mtx_lock(&shard->lock);
 
     zx_status_t status = zx_object_wait_async(
         wait->object, loop->port, (uintptr_t)wait, wait->trigger, ZX_WAIT_ASYNC_ONCE);
     if (status == ZX_OK) {
-        list_add_head(&loop->wait_list, wait_to_node(wait));
+        list_add_head(&shard->list, wait_to_node(wait));
     } else {
         ZX_ASSERT_MSG(status == ZX_ERR_ACCESS_DENIED,
                       "zx_object_wait_async: status=%d", status);
     }
 
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&shard->lock);
     return status;
 }
 
@@ -514,12 +678,13 @@ static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_
     // destroyed in case the client is counting on the handler not being
     // invoked again past this point.
 
-    mtx_lock(&loop->lock);
+    wait_shard_t* shard = wait_to_shard(loop, wait);
+    mtx_lock(&shard->lock);
 
     // First, confirm that the wait is actually pending.
     list_node_t* node = wait_to_node(wait);
     if (!list_in_list(node)) {
-        mtx_unlock(&loop->lock);
+        mtx_unlock(&shard->lock);
         return ZX_ERR_NOT_FOUND;
     }
 
@@ -528,6 +693,12 @@ static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_
     // to cancel then we assume we lost the race.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
+    if (status == ZX_ERR_NOT_FOUND) {
+        mtx_lock(&loop->lock);
+        if (async_loop_drop_batched_packet_locked(loop, (uintptr_t)wait))
+            status = ZX_OK;
+        mtx_unlock(&loop->lock);
+    }
     if (status == ZX_OK) {
         list_delete(node);
     } else {
@@ -535,7 +706,7 @@ static zx_status_t async_loop_cancel_wait(async_dispatcher_t* async, async_wait_
                       "zx_port_cancel: status=%d", status);
     }
 
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&shard->lock);
     return status;
 }
 
@@ -547,17 +718,16 @@ static zx_status_t async_loop_post_task(async_dispatcher_t* async, async_task_t*
     if (atomic_load_explicit(&loop->state, memory_order_acquire) == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
 
-    mtx_lock(&loop->lock);
+    mtx_lock(&loop->task_lock);
 
-    async_loop_insert_task_locked(loop, task);
-    if (!loop->dispatching_tasks &&
-        task_to_node(task)->prev == &loop->task_list) {
+    zx_status_t status = async_loop_insert_task_locked(loop, task);
+    if (status == ZX_OK && !loop->dispatching_tasks && task_heap_index(task) == 0u) {
         // Task inserted at head.  Earliest deadline changed.
         async_loop_restart_timer_locked(loop);
     }
 
-    mtx_unlock(&loop->lock);
-    return ZX_OK;
+    mtx_unlock(&loop->task_lock);
+    return status;
 }
 
 static zx_status_t async_loop_cancel_task(async_dispatcher_t* async, async_task_t* task) {
@@ -569,27 +739,32 @@ static zx_status_t async_loop_cancel_task(async_dispatcher_t* async, async_task_
     // destroyed in case the client is counting on the handler not being
     // invoked again past this point.  Also, the task we're removing here
     // might be present in the dispatcher's |due_list| if it is pending
-    // dispatch instead of in the loop's |task_list| as usual.  The same
-    // logic works in both cases.
+    // dispatch instead of in the loop's task heap as usual.
 
-    mtx_lock(&loop->lock);
+    mtx_lock(&loop->task_lock);
     list_node_t* node = task_to_node(task);
     if (!list_in_list(node)) {
-        mtx_unlock(&loop->lock);
+        mtx_unlock(&loop->task_lock);
         return ZX_ERR_NOT_FOUND;
     }
+    if (!task_in_heap(loop, task)) {
+        list_delete(node);
+        mtx_unlock(&loop->task_lock);
+        return ZX_OK;
+    }
 
     // Determine whether the head task was canceled and following task has
     // a later deadline.  If so, we will bump the timer along to that deadline.
+    size_t index = task_heap_index(task);
+    async_loop_cancel_task_locked(loop, index);
     bool must_restart = !loop->dispatching_tasks &&
-                        node->prev == &loop->task_list &&
-                        node->next != &loop->task_list &&
-                        node_to_task(node->next)->deadline > task->deadline;
-    list_delete(node);
+                        index == 0u &&
+                        loop->task_heap_count &&
+                        loop->task_heap[0].deadline > task->deadline;
     if (must_restart)
         async_loop_restart_timer_locked(loop);
 
-    mtx_unlock(&loop->lock);
+    mtx_unlock(&loop->task_lock);
     return ZX_OK;
 }
 
@@ -680,6 +855,7 @@ static zx_status_t async_loop_unbind_exception_port(async_dispatcher_t* async,
                                                      ZX_HANDLE_INVALID, key, 0);
 
     if (status == ZX_OK) {
+        async_loop_drop_batched_packet_locked(loop, key);
         list_delete(node);
     }
 
@@ -701,27 +877,139 @@ static zx_status_t async_loop_resume_from_exception(async_dispatcher_t* async,
     return zx_task_resume_from_exception(task, loop->port, options);
 }
 
-static void async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
-    // TODO(ZX-976): We assume that tasks are inserted in quasi-monotonic order and
-    // that insertion into the task queue will typically take no more than a few steps.
-    // If this assumption proves false and the cost of insertion becomes a problem, we
-    // should consider using a more efficient representation for maintaining order.
-    list_node_t* node;
-    for (node = loop->task_list.prev; node != &loop->task_list; node = node->prev) {
-        if (task->deadline >= node_to_task(node)->deadline)
+static bool task_entry_before(const task_entry_t* a, const task_entry_t* b) {
+    return a->deadline < b->deadline ||
+           (a->deadline == b->deadline && a->sequence < b->sequence);
+}
+
+// Entries whose task was canceled are left in the heap, with no task, until
+// they reach its head or outnumber the other entries.  Servers which cancel
+// and repost a timeout on every request would otherwise pay to restore the
+// heap's order for each cancelation.
+static void async_loop_set_task_entry_locked(async_loop_t* loop, size_t index,
+                                             const task_entry_t* entry) {
+    loop->task_heap[index] = *entry;
+    if (entry->task) {
+        entry->task->state.reserved[0] = (uintptr_t)index;
+        entry->task->state.reserved[1] = (uintptr_t)&loop->task_heap;
+    }
+}
+
+// Moves |entry| from |index| towards the root, or the leaves, of the heap
+// until it is in order.
+static void async_loop_sift_task_locked(async_loop_t* loop, size_t index,
+                                        const task_entry_t* entry) {
+    task_entry_t* heap = loop->task_heap;
+    while (index > 0u && task_entry_before(entry, &heap[(index - 1u) / TASK_HEAP_ARITY])) {
+        size_t parent = (index - 1u) / TASK_HEAP_ARITY;
+        async_loop_set_task_entry_locked(loop, index, &heap[parent]);
+        index = parent;
+    }
+    for (;;) {
+        size_t first = TASK_HEAP_ARITY * index + 1u;
+        if (first >= loop->task_heap_count)
+            break;
+        size_t end = first + TASK_HEAP_ARITY;
+        if (end > loop->task_heap_count)
+            end = loop->task_heap_count;
+        size_t child = first;
+        for (size_t i = first + 1u; i < end; i++) {
+            if (task_entry_before(&heap[i], &heap[child]))
+                child = i;
+        }
+        if (!task_entry_before(&heap[child], entry))
             break;
+        async_loop_set_task_entry_locked(loop, index, &heap[child]);
+        index = child;
+    }
+    async_loop_set_task_entry_locked(loop, index, entry);
+}
+
+static zx_status_t async_loop_insert_task_locked(async_loop_t* loop, async_task_t* task) {
+    if (loop->task_heap_count == loop->task_heap_capacity) {
+        size_t capacity = loop->task_heap_capacity * 2u;
+        task_entry_t* heap = realloc(loop->task_heap, capacity * sizeof(task_entry_t));
+        if (!heap)
+            return ZX_ERR_NO_MEMORY;
+        loop->task_heap = heap;
+        loop->task_heap_capacity = capacity;
+    }
+    task_entry_t entry = {
+        .deadline = task->deadline,
+        .sequence = loop->task_sequence++,
+        .task = task};
+    async_loop_sift_task_locked(loop, loop->task_heap_count++, &entry);
+    return ZX_OK;
+}
+
+static void async_loop_remove_task_entry_locked(async_loop_t* loop, size_t index) {
+    ZX_DEBUG_ASSERT(index < loop->task_heap_count);
+    async_task_t* task = loop->task_heap[index].task;
+    if (task) {
+        task->state.reserved[0] = 0u;
+        task->state.reserved[1] = 0u;
+    } else {
+        loop->task_heap_canceled--;
+    }
+
+    // Fill the hole with the last entry.
+    size_t last = --loop->task_heap_count;
+    if (index != last) {
+        task_entry_t entry = loop->task_heap[last];
+        async_loop_sift_task_locked(loop, index, &entry);
+    }
+}
+
+// Drops the entries of canceled tasks from the head of the heap, so that the
+// head is always a pending task.
+static void async_loop_prune_tasks_locked(async_loop_t* loop) {
+    while (loop->task_heap_count && !loop->task_heap[0].task)
+        async_loop_remove_task_entry_locked(loop, 0u);
+}
+
+// Removes and returns the task with the earliest deadline.
+static async_task_t* async_loop_pop_task_locked(async_loop_t* loop) {
+    async_task_t* task = loop->task_heap[0].task;
+    ZX_DEBUG_ASSERT(task);
+    async_loop_remove_task_entry_locked(loop, 0u);
+    async_loop_prune_tasks_locked(loop);
+    return task;
+}
+
+static void async_loop_cancel_task_locked(async_loop_t* loop, size_t index) {
+    if (index == 0u) {
+        async_loop_pop_task_locked(loop);
+        return;
+    }
+
+    async_task_t* task = loop->task_heap[index].task;
+    task->state.reserved[0] = 0u;
+    task->state.reserved[1] = 0u;
+    loop->task_heap[index].task = NULL;
+    loop->task_heap_canceled++;
+    if (loop->task_heap_canceled <= loop->task_heap_count / 2u)
+        return;
+
+    // Most of the heap is canceled tasks, so rebuild it without them.
+    size_t count = 0u;
+    for (size_t i = 0u; i < loop->task_heap_count; i++) {
+        if (loop->task_heap[i].task)
+            loop->task_heap[count++] = loop->task_heap[i];
+    }
+    loop->task_heap_count = 0u;
+    loop->task_heap_canceled = 0u;
+    for (size_t i = 0u; i < count; i++) {
+        task_entry_t entry = loop->task_heap[i];
+        async_loop_sift_task_locked(loop, loop->task_heap_count++, &entry);
     }
-    list_add_after(node, task_to_node(task));
 }
 
 static void async_loop_restart_timer_locked(async_loop_t* loop) {
     zx_time_t deadline;
     if (list_is_empty(&loop->due_list)) {
-        list_node_t* head = list_peek_head(&loop->task_list);
-        if (!head)
+        if (!loop->task_heap_count)
             return;
-        async_task_t* task = node_to_task(head);
-        deadline = task->deadline;
+        deadline = loop->task_heap[0].deadline;
         if (deadline == ZX_TIME_INFINITE)
             return;
     } else {
@@ -46,6 +46,7 @@ struct async_task {
 //
 // Returns |ZX_OK| if the task was successfully posted.
 // Returns |ZX_ERR_BAD_STATE| if the dispatcher is shutting down.
+// Returns |ZX_ERR_NO_MEMORY| if the dispatcher has no room for the task.
 // Returns |ZX_ERR_NOT_SUPPORTED| if not supported by the dispatcher.
 //
 // This operation is thread-safe.
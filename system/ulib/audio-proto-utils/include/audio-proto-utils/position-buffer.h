@@ -0,0 +1,51 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <fbl/macros.h>
+#include <lib/zx/vmo.h>
+#include <zircon/device/audio.h>
+#include <zircon/types.h>
+
+namespace audio {
+namespace utils {
+
+// PositionBuffer is the driver side of AUDIO_RB_CMD_GET_POSITION_BUFFER.  It
+// owns the shared audio_rb_position_buffer_t and publishes position updates to
+// it.  PositionBuffer does no locking of its own; users must serialize calls
+// to it, typically with the lock which already protects their position
+// notifications.
+class PositionBuffer {
+public:
+    PositionBuffer() { }
+    ~PositionBuffer() { Release(); }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PositionBuffer);
+
+    // Fetch a read-only handle to the buffer suitable for sending to a client,
+    // creating the buffer if needed.  A newly created buffer reports that the
+    // ring buffer is not running.
+    zx_status_t GetClientVmo(zx::vmo* out_vmo);
+
+    // Publish the ring buffer position |pos| as of |timestamp|.  Does nothing
+    // if no client has asked for the buffer.  Passing a |timestamp| of 0
+    // reports that the ring buffer has stopped.
+    void Update(uint32_t pos, zx_time_t timestamp);
+
+    // Drop the buffer.  Clients holding the old VMO see no further updates.
+    void Release();
+
+    // Client side: take a consistent snapshot of |buf|.  Returns false if the
+    // ring buffer is not running.
+    static bool Read(const audio_rb_position_buffer_t* buf,
+                     uint32_t* out_pos, zx_time_t* out_timestamp);
+
+private:
+    zx::vmo vmo_;
+    audio_rb_position_buffer_t* buf_ = nullptr;
+};
+
+}  // namespace utils
+}  // namespace audio
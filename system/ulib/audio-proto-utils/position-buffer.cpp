@@ -0,0 +1,80 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <audio-proto-utils/position-buffer.h>
+#include <fbl/type_support.h>
+#include <lib/zx/vmar.h>
+#include <limits.h>
+
+namespace audio {
+namespace utils {
+
+zx_status_t PositionBuffer::GetClientVmo(zx::vmo* out_vmo) {
+    if (buf_ == nullptr) {
+        static_assert(sizeof(audio_rb_position_buffer_t) <= PAGE_SIZE,
+                      "Position buffer must fit in a single page");
+        zx::vmo vmo;
+        zx_status_t res = zx::vmo::create(PAGE_SIZE, 0, &vmo);
+        if (res != ZX_OK) {
+            return res;
+        }
+
+        uintptr_t addr;
+        res = zx::vmar::root_self()->map(0, vmo, 0, PAGE_SIZE,
+                                         ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, &addr);
+        if (res != ZX_OK) {
+            return res;
+        }
+
+        vmo_ = fbl::move(vmo);
+        buf_ = reinterpret_cast<audio_rb_position_buffer_t*>(addr);
+    }
+
+    return vmo_.duplicate(ZX_RIGHT_TRANSFER | ZX_RIGHT_MAP | ZX_RIGHT_READ, out_vmo);
+}
+
+void PositionBuffer::Update(uint32_t pos, zx_time_t timestamp) {
+    if (buf_ == nullptr) {
+        return;
+    }
+
+    // We are the only writer, so |seq| can be read without synchronization.
+    // The fence orders the odd |seq| before the field updates; the release
+    // store of the even |seq| orders them before it.
+    uint32_t seq = buf_->seq;
+    __atomic_store_n(&buf_->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&buf_->ring_buffer_pos, pos, __ATOMIC_RELAXED);
+    __atomic_store_n(&buf_->timestamp, timestamp, __ATOMIC_RELAXED);
+    __atomic_store_n(&buf_->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void PositionBuffer::Release() {
+    if (buf_ != nullptr) {
+        zx::vmar::root_self()->unmap(reinterpret_cast<uintptr_t>(buf_), PAGE_SIZE);
+        buf_ = nullptr;
+    }
+    vmo_.reset();
+}
+
+bool PositionBuffer::Read(const audio_rb_position_buffer_t* buf,
+                          uint32_t* out_pos, zx_time_t* out_timestamp) {
+    uint32_t seq;
+    uint32_t pos;
+    zx_time_t timestamp;
+
+    do {
+        seq = __atomic_load_n(&buf->seq, __ATOMIC_ACQUIRE);
+        pos = __atomic_load_n(&buf->ring_buffer_pos, __ATOMIC_RELAXED);
+        timestamp = __atomic_load_n(&buf->timestamp, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || (__atomic_load_n(&buf->seq, __ATOMIC_RELAXED) != seq));
+
+    *out_pos = pos;
+    *out_timestamp = timestamp;
+    return timestamp != 0;
+}
+
+}  // namespace utils
+}  // namespace audio
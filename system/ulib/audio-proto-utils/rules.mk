@@ -11,10 +11,12 @@ MODULE_TYPE := userlib
 MODULE_COMPILEFLAGS += -fvisibility=hidden
 
 MODULE_SRCS += \
-    $(LOCAL_DIR)/format-utils.cpp
+    $(LOCAL_DIR)/format-utils.cpp \
+    $(LOCAL_DIR)/position-buffer.cpp \
 
 MODULE_STATIC_LIBS := \
-    system/ulib/fbl
+    system/ulib/fbl \
+    system/ulib/zx \
 
 MODULE_PACKAGE := src
 
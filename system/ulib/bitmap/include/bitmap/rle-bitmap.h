@@ -10,6 +10,7 @@
 
 #include <zircon/types.h>
 #include <fbl/intrusive_double_list.h>
+#include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
 
@@ -21,15 +22,15 @@ struct RleBitmapElement;
 class RleBitmap final : public Bitmap {
 private:
     // Private forward-declaration to share the type between the iterator type
-    // and the internal list.
-    using ListType = fbl::DoublyLinkedList<fbl::unique_ptr<RleBitmapElement>>;
+    // and the internal tree.
+    using TreeType = fbl::WAVLTree<size_t, fbl::unique_ptr<RleBitmapElement>>;
 
 public:
-    using const_iterator = ListType::const_iterator;
-    using FreeList = ListType;
+    using const_iterator = TreeType::const_iterator;
+    using FreeList = fbl::DoublyLinkedList<fbl::unique_ptr<RleBitmapElement>>;
 
     constexpr RleBitmap()
-        : num_elems_(0), num_bits_(0) {}
+        : num_bits_(0) {}
     virtual ~RleBitmap() = default;
 
     RleBitmap(RleBitmap&& rhs) = default;
@@ -38,7 +39,7 @@ public:
     DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(RleBitmap);
 
     // Returns the current number of ranges.
-    size_t num_ranges() const { return num_elems_; }
+    size_t num_ranges() const { return elems_.size(); }
 
     // Returns the current number of bits.
     size_t num_bits() const { return num_bits_; }
@@ -93,20 +94,25 @@ private:
     zx_status_t SetInternal(size_t bitoff, size_t bitmax, FreeList* free_list);
     zx_status_t ClearInternal(size_t bitoff, size_t bitmax, FreeList* free_list);
 
-    // The ranges of the bitmap. Ranges are ordered by ascending |bitoff| value.
-    // When no "Set" operation is in progress, there should not be any overlapping ranges.
-    ListType elems_;
+    // Returns the first range which ends at or after *bitoff*, or, if
+    // *touching* is false, strictly after it.
+    TreeType::iterator FirstEndingAfter(size_t bitoff, bool touching);
+    TreeType::const_iterator FirstEndingAfter(size_t bitoff, bool touching) const;
 
-    // The number of ranges in elems_.
-    size_t num_elems_;
+    // The ranges of the bitmap, keyed by their |bitoff| value. Ranges never
+    // overlap or touch, so the order of their ends matches that of their
+    // starts.
+    TreeType elems_;
 
     // The number of total bits in elems_; i.e. the sum of the bitlen field of all stored
     // RleBitmapElements.
     size_t num_bits_;
 };
 
-// Elements of the bitmap list
-struct RleBitmapElement : public fbl::DoublyLinkedListable<fbl::unique_ptr<RleBitmapElement>> {
+// Elements of the bitmap.  Elements held by the bitmap are in its tree, and
+// spare elements may be kept in a FreeList.
+struct RleBitmapElement : public fbl::DoublyLinkedListable<fbl::unique_ptr<RleBitmapElement>>,
+                          public fbl::WAVLTreeContainable<fbl::unique_ptr<RleBitmapElement>> {
     // The start of this run of 1-bits.
     size_t bitoff;
     // The number of 1-bits in this run.
@@ -114,6 +120,9 @@ struct RleBitmapElement : public fbl::DoublyLinkedListable<fbl::unique_ptr<RleBi
 
     // The (exclusive) end of this run of 1-bits.
     size_t end() const { return bitoff + bitlen; }
+
+    // Elements are keyed by their start.
+    size_t GetKey() const { return bitoff; }
 };
 
 } // namespace bitmap
@@ -41,21 +41,14 @@ size_t GetMask(bool first, bool last, size_t off, size_t max) {
     return mask;
 }
 
-// Applies a bitmask to the given data value. The result value has bits set
-// which fall within the mask but do not match is_set.
-size_t MaskBits(size_t data, size_t idx, size_t bitoff, size_t bitmax,
-                bool is_set) {
-    size_t mask = GetMask(idx == FirstIdx(bitoff), idx == LastIdx(bitmax),
-                          bitoff, bitmax);
-    if (is_set) {
-        // If is_set=true, invert the mask, OR it with the value, and invert
-        // it again to hopefully get all zeros.
-        return ~(~mask | data);
-    } else {
-        // If is_set=false, just AND the mask with the value to hopefully
-        // get all zeros.
-        return mask & data;
-    }
+// The number of whole words Scan and ReverseScan check at once, while skipping
+// over long runs of matching bits.
+constexpr size_t kScanWords = 4;
+
+// Returns a word which, XOR'd with a word of the bitmap, has bits set where
+// the bitmap's bits do not match is_set.
+constexpr size_t FlipFor(bool is_set) {
+    return is_set ? ~size_t(0) : size_t(0);
 }
 
 // Counts the number of zeros.  It assumes everything in the array up to
@@ -89,20 +82,37 @@ bool RawBitmapBase::Scan(size_t bitoff, size_t bitmax, bool is_set,
     if (bitoff >= bitmax) {
         return true;
     }
-    size_t i = FirstIdx(bitoff);
-    while (true) {
-        size_t masked = MaskBits(data_[i], i, bitoff, bitmax, is_set);
-        if (masked != 0) {
-            if (out) {
-                *out = i * bitmap::kBits + CTZ(masked);
+    const size_t flip = FlipFor(is_set);
+    const size_t first_idx = FirstIdx(bitoff);
+    const size_t last_idx = LastIdx(bitmax);
+    size_t i = first_idx;
+    size_t masked = (data_[i] ^ flip) & GetMask(true, i == last_idx, bitoff, bitmax);
+    if (masked == 0 && i != last_idx) {
+        // Every word between the first and the last is compared whole, and
+        // several at a time, until one with a mismatch is found.
+        ++i;
+        while (i + kScanWords <= last_idx) {
+            size_t mismatch = 0;
+            for (size_t j = 0; j < kScanWords; ++j) {
+                mismatch |= data_[i + j] ^ flip;
             }
-            return false;
+            if (mismatch != 0) {
+                break;
+            }
+            i += kScanWords;
         }
-        if (i == LastIdx(bitmax)) {
-            return true;
+        while (i != last_idx && (data_[i] ^ flip) == 0) {
+            ++i;
         }
-        ++i;
+        masked = (data_[i] ^ flip) & GetMask(false, i == last_idx, bitoff, bitmax);
     }
+    if (masked != 0) {
+        if (out) {
+            *out = i * bitmap::kBits + CTZ(masked);
+        }
+        return false;
+    }
+    return true;
 }
 
 bool RawBitmapBase::ReverseScan(size_t bitoff, size_t bitmax, bool is_set,
@@ -111,20 +121,35 @@ bool RawBitmapBase::ReverseScan(size_t bitoff, size_t bitmax, bool is_set,
     if (bitoff >= bitmax) {
         return true;
     }
-    size_t i = LastIdx(bitmax);
-    while (true) {
-        size_t masked = MaskBits(data_[i], i, bitoff, bitmax, is_set);
-        if (masked != 0) {
-            if (out) {
-                *out = (i + 1) * bitmap::kBits - (CLZ(masked) + 1);
+    const size_t flip = FlipFor(is_set);
+    const size_t first_idx = FirstIdx(bitoff);
+    const size_t last_idx = LastIdx(bitmax);
+    size_t i = last_idx;
+    size_t masked = (data_[i] ^ flip) & GetMask(i == first_idx, true, bitoff, bitmax);
+    if (masked == 0 && i != first_idx) {
+        --i;
+        while (i >= first_idx + kScanWords) {
+            size_t mismatch = 0;
+            for (size_t j = 0; j < kScanWords; ++j) {
+                mismatch |= data_[i - j] ^ flip;
             }
-            return false;
+            if (mismatch != 0) {
+                break;
+            }
+            i -= kScanWords;
         }
-        if (i == FirstIdx(bitoff)) {
-            return true;
+        while (i != first_idx && (data_[i] ^ flip) == 0) {
+            --i;
         }
-        --i;
+        masked = (data_[i] ^ flip) & GetMask(i == first_idx, false, bitoff, bitmax);
     }
+    if (masked != 0) {
+        if (out) {
+            *out = (i + 1) * bitmap::kBits - (CLZ(masked) + 1);
+        }
+        return false;
+    }
+    return true;
 }
 
 zx_status_t RawBitmapBase::Find(bool is_set, size_t bitoff, size_t bitmax,
@@ -184,9 +209,15 @@ zx_status_t RawBitmapBase::Set(size_t bitoff, size_t bitmax) {
     }
     size_t first_idx = FirstIdx(bitoff);
     size_t last_idx = LastIdx(bitmax);
-    for (size_t i = first_idx; i <= last_idx; ++i) {
-        data_[i] |= GetMask(i == first_idx, i == last_idx, bitoff, bitmax);
+    if (first_idx == last_idx) {
+        data_[first_idx] |= GetMask(true, true, bitoff, bitmax);
+        return ZX_OK;
     }
+    data_[first_idx] |= GetMask(true, false, bitoff, bitmax);
+    for (size_t i = first_idx + 1; i < last_idx; ++i) {
+        data_[i] = ~size_t(0);
+    }
+    data_[last_idx] |= GetMask(false, true, bitoff, bitmax);
     return ZX_OK;
 }
 
@@ -199,9 +230,15 @@ zx_status_t RawBitmapBase::Clear(size_t bitoff, size_t bitmax) {
     }
     size_t first_idx = FirstIdx(bitoff);
     size_t last_idx = LastIdx(bitmax);
-    for (size_t i = first_idx; i <= last_idx; ++i) {
-        data_[i] &= ~(GetMask(i == first_idx, i == last_idx, bitoff, bitmax));
+    if (first_idx == last_idx) {
+        data_[first_idx] &= ~GetMask(true, true, bitoff, bitmax);
+        return ZX_OK;
+    }
+    data_[first_idx] &= ~GetMask(true, false, bitoff, bitmax);
+    for (size_t i = first_idx + 1; i < last_idx; ++i) {
+        data_[i] = 0;
     }
+    data_[last_idx] &= ~GetMask(false, true, bitoff, bitmax);
     return ZX_OK;
 }
 
@@ -40,19 +40,46 @@ void ReleaseElement(RleBitmap::FreeList* free_list, fbl::unique_ptr<RleBitmapEle
 
 } // namespace
 
+RleBitmap::TreeType::iterator RleBitmap::FirstEndingAfter(size_t bitoff, bool touching) {
+    // Only the last range starting at or before |bitoff| may contain it; any
+    // range after that one ends after |bitoff|.
+    auto itr = elems_.upper_bound(bitoff);
+    if (itr != elems_.begin()) {
+        auto prev = itr;
+        --prev;
+        if (prev->end() > bitoff || (touching && prev->end() == bitoff)) {
+            return prev;
+        }
+    }
+    return itr;
+}
+
+RleBitmap::TreeType::const_iterator RleBitmap::FirstEndingAfter(size_t bitoff,
+                                                              bool touching) const {
+    auto itr = elems_.upper_bound(bitoff);
+    if (itr != elems_.begin()) {
+        auto prev = itr;
+        --prev;
+        if (prev->end() > bitoff || (touching && prev->end() == bitoff)) {
+            return prev;
+        }
+    }
+    return itr;
+}
+
 zx_status_t RleBitmap::Find(bool is_set, size_t bitoff, size_t bitmax, size_t run_len, size_t* out)
             const {
     *out = bitmax;
 
-    // Loop through all existing elems to try to find a |run_len| length range of |is_set| bits.
+    // Loop through the elems which end after |bitoff| to try to find a |run_len| length range of
+    // |is_set| bits.
     // On each loop, |bitoff| is guaranteed to be either within the current elem, or in the range
     // of unset bits leading up to it.
     // Therefore, we can check whether |run_len| bits between |bitmax| and |bitoff| exist before
     // the start of the elem (for unset runs), or within the current elem (for set runs).
-    for (const auto& elem : elems_) {
-        if (bitoff >= elem.end()) {
-            continue;
-        } else if (bitmax - bitoff < run_len) {
+    for (auto itr = FirstEndingAfter(bitoff, false); itr != elems_.end(); ++itr) {
+        const RleBitmapElement& elem = *itr;
+        if (bitmax - bitoff < run_len) {
             return ZX_ERR_NO_RESOURCES;
         }
 
@@ -95,14 +122,9 @@ zx_status_t RleBitmap::Find(bool is_set, size_t bitoff, size_t bitmax, size_t ru
 
 
 bool RleBitmap::Get(size_t bitoff, size_t bitmax, size_t* first_unset) const {
-    for (const auto& elem : elems_) {
-        if (bitoff < elem.bitoff) {
-            break;
-        }
-        if (bitoff < elem.bitoff + elem.bitlen) {
-            bitoff = elem.bitoff + elem.bitlen;
-            break;
-        }
+    auto itr = FirstEndingAfter(bitoff, false);
+    if (itr != elems_.end() && itr->bitoff <= bitoff) {
+        bitoff = itr->end();
     }
     if (bitoff > bitmax) {
         bitoff = bitmax;
@@ -116,7 +138,6 @@ bool RleBitmap::Get(size_t bitoff, size_t bitmax, size_t* first_unset) const {
 
 void RleBitmap::ClearAll() {
     elems_.clear();
-    num_elems_ = 0;
     num_bits_ = 0;
 }
 
@@ -154,55 +175,44 @@ zx_status_t RleBitmap::SetInternal(size_t bitoff, size_t bitmax, FreeList* free_
         return ZX_OK;
     }
 
-    fbl::unique_ptr<RleBitmapElement> new_elem = AllocateElement(free_list);
-    if (!new_elem) {
-        return ZX_ERR_NO_MEMORY;
-    }
-    ++num_elems_;
-    new_elem->bitoff = bitoff;
-    new_elem->bitlen = bitlen;
-
-    auto ends_after = elems_.find_if([bitoff](const RleBitmapElement& elem) -> bool {
-        return elem.bitoff + elem.bitlen >= bitoff;
-    });
-
-    // Insert the new element before the first node that ends at a point >=
-    // when we begin.
-    elems_.insert(ends_after, fbl::move(new_elem));
-    num_bits_ += bitlen;
-
-    // If ends_after was the end of the list, there is no merging to do.
-    if (ends_after == elems_.end()) {
+    // The first node that ends at a point >= when we begin is the only one
+    // which could be extended to hold the new range.
+    auto itr = FirstEndingAfter(bitoff, true);
+    if (itr == elems_.end() || itr->bitoff > bitmax) {
+        // Nothing overlaps or touches the new range.
+        fbl::unique_ptr<RleBitmapElement> new_elem = AllocateElement(free_list);
+        if (!new_elem) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        new_elem->bitoff = bitoff;
+        new_elem->bitlen = bitlen;
+        elems_.insert(fbl::move(new_elem));
+        num_bits_ += bitlen;
         return ZX_OK;
     }
 
-    auto itr = ends_after;
-    RleBitmapElement& elem = *--ends_after;
-
-    if (elem.bitoff >= itr->bitoff) {
-        // Our range either starts before or in the middle/end of *elem*.
-        // Adjust it so it starts at the same place as *elem*, to allow
-        // the merge logic to not consider this overlap case.
-        elem.bitlen += elem.bitoff - itr->bitoff;
-        num_bits_ += elem.bitoff - itr->bitoff;
-        elem.bitoff = itr->bitoff;
-    }
+    // Extend *elem* to cover our range.  Its start may move back, but not past
+    // the end of the range before it, so it keeps its place in the tree.
+    RleBitmapElement& elem = *itr;
+    num_bits_ -= elem.bitlen;
+    size_t max = fbl::max(elem.end(), bitmax);
+    elem.bitoff = fbl::min(elem.bitoff, bitoff);
 
     // Walk forwards and remove/merge any overlaps
-    size_t max = elem.bitoff + elem.bitlen;
+    ++itr;
     while (itr != elems_.end()) {
         if (itr->bitoff > max) {
             break;
         }
 
-        max = fbl::max(max, itr->bitoff + itr->bitlen);
-        num_bits_ += max - elem.bitoff - itr->bitlen - elem.bitlen;
-        elem.bitlen = max - elem.bitoff;
+        max = fbl::max(max, itr->end());
+        num_bits_ -= itr->bitlen;
         auto to_erase = itr;
         ++itr;
         ReleaseElement(free_list, elems_.erase(to_erase));
-        --num_elems_;
     }
+    elem.bitlen = max - elem.bitoff;
+    num_bits_ += elem.bitlen;
 
     return ZX_OK;
 }
@@ -216,17 +226,13 @@ zx_status_t RleBitmap::ClearInternal(size_t bitoff, size_t bitmax, FreeList* fre
         return ZX_OK;
     }
 
-    auto itr = elems_.begin();
+    auto itr = FirstEndingAfter(bitoff, false);
     while (itr != elems_.end()) {
-        if (itr->bitoff + itr->bitlen < bitoff) {
-            ++itr;
-            continue;
-        }
-        if (bitmax < itr->bitoff) {
+        if (bitmax <= itr->bitoff) {
             break;
         }
         if (itr->bitoff < bitoff) {
-            if (itr->bitoff + itr->bitlen <= bitmax) {
+            if (itr->end() <= bitmax) {
                 // '*itr' contains 'bitoff'.
                 num_bits_ -= (itr->bitlen - (bitoff - itr->bitoff));
                 itr->bitlen = bitoff - itr->bitoff;
@@ -238,20 +244,20 @@ zx_status_t RleBitmap::ClearInternal(size_t bitoff, size_t bitmax, FreeList* fre
                 if (!new_elem) {
                     return ZX_ERR_NO_MEMORY;
                 }
-                ++num_elems_;
                 new_elem->bitoff = bitmax;
-                new_elem->bitlen = itr->bitoff + itr->bitlen - bitmax;
+                new_elem->bitlen = itr->end() - bitmax;
 
-                elems_.insert_after(itr, fbl::move(new_elem));
                 itr->bitlen = bitoff - itr->bitoff;
+                elems_.insert(fbl::move(new_elem));
                 num_bits_ -= (bitmax - bitoff);
                 break;
             }
         } else {
-            if (bitmax < itr->bitoff + itr->bitlen) {
-                // 'elem' contains 'bitmax'
+            if (bitmax < itr->end()) {
+                // 'elem' contains 'bitmax'.  Its start moves forward, but not
+                // past its own end, so it keeps its place in the tree.
                 num_bits_ -= (bitmax - itr->bitoff);
-                itr->bitlen = itr->bitoff + itr->bitlen - bitmax;
+                itr->bitlen = itr->end() - bitmax;
                 itr->bitoff = bitmax;
                 break;
             } else {
@@ -259,7 +265,6 @@ zx_status_t RleBitmap::ClearInternal(size_t bitoff, size_t bitmax, FreeList* fre
                 num_bits_ -= itr->bitlen;
                 auto to_erase = itr++;
                 ReleaseElement(free_list, elems_.erase(to_erase));
-                --num_elems_;
             }
         }
     }
@@ -4,6 +4,7 @@
 
 #include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -136,6 +137,7 @@ zx_status_t EnqueuePaginated(fbl::unique_ptr<WritebackWork>* work, Blobfs* blobf
             if (status != ZX_OK) {
                 return status;
             }
+            tmp->SetDataOnly();
             if ((status = blobfs->EnqueueWork(fbl::move(*work), EnqueueType::kData)) != ZX_OK) {
                 return status;
             }
@@ -152,27 +154,29 @@ Inode* Blobfs::GetNode(size_t index) const {
 }
 
 zx_status_t VnodeBlob::Verify() const {
-    TRACE_DURATION("blobfs", "Blobfs::Verify");
+    return VerifyRange(0, inode_.blob_size);
+}
+
+zx_status_t VnodeBlob::VerifyRange(uint64_t offset, uint64_t length) const {
+    TRACE_DURATION("blobfs", "Blobfs::Verify", "offset", offset, "length", length);
     fs::Ticker ticker(blobfs_->CollectingMetrics());
 
     const void* data = inode_.blob_size ? GetData() : nullptr;
     const void* tree = inode_.blob_size ? GetMerkle() : nullptr;
     const uint64_t data_size = inode_.blob_size;
     const uint64_t merkle_size = MerkleTree::GetTreeLength(data_size);
-    // TODO(smklein): We could lazily verify more of the VMO if
-    // we could fault in pages on-demand.
-    //
-    // For now, we aggressively verify the entire VMO up front.
     Digest digest;
     digest = reinterpret_cast<const uint8_t*>(&digest_[0]);
-    zx_status_t status = MerkleTree::Verify(data, data_size, tree,
-                                            merkle_size, 0, data_size, digest);
-    blobfs_->UpdateMerkleVerifyMetrics(data_size, merkle_size, ticker.End());
+    zx_status_t status = MerkleTree::VerifyParallel(data, data_size, tree, merkle_size, offset,
+                                                    length, digest,
+                                                    zx_system_get_num_cpus());
+    blobfs_->UpdateMerkleVerifyMetrics(length, merkle_size, ticker.End());
 
     if (status != ZX_OK) {
         char name[Digest::kLength * 2 + 1];
         ZX_ASSERT(digest.ToString(name, sizeof(name)) == ZX_OK);
-        FS_TRACE_ERROR("blobfs verify(%s) Failure: %s\n", name, zx_status_get_string(status));
+        FS_TRACE_ERROR("blobfs verify(%s) [%" PRIu64 ", +%" PRIu64 ") Failure: %s\n", name,
+                       offset, length, zx_status_get_string(status));
     }
 
     return status;
@@ -213,16 +217,19 @@ zx_status_t VnodeBlob::InitVmos() {
         return status;
     }
 
-    if ((inode_.flags & kBlobFlagLZ4Compressed) != 0) {
+    if ((inode_.flags & kBlobFlagChunkCompressed) != 0) {
+        // Each chunk is verified as it is loaded.
+        if ((status = InitChunked()) != ZX_OK) {
+            return status;
+        }
+    } else if ((inode_.flags & kBlobFlagLZ4Compressed) != 0) {
         if ((status = InitCompressed()) != ZX_OK) {
             return status;
         }
-    } else {
-        if ((status = InitUncompressed()) != ZX_OK) {
+        if ((status = Verify()) != ZX_OK) {
             return status;
         }
-    }
-    if ((status = Verify()) != ZX_OK) {
+    } else if ((status = InitUncompressed()) != ZX_OK) {
         return status;
     }
 
@@ -298,13 +305,222 @@ zx_status_t VnodeBlob::InitUncompressed() {
     fs::Ticker ticker(blobfs_->CollectingMetrics());
     fs::ReadTxn txn(blobfs_);
     uint64_t start = inode_.start_block + DataStartBlock(blobfs_->info_);
+    const uint64_t chunk_count = ChunkCount(inode_.blob_size);
+
+    // A blob of a single chunk is read and verified in one go. Otherwise,
+    // only the merkle tree is read for now.
+    uint64_t length = MerkleTreeBlocks(inode_);
+    if (chunk_count == 1) {
+        length += BlobDataBlocks(inode_);
+    }
+    zx_status_t status = ZX_OK;
+    if (length > 0) {
+        txn.Enqueue(vmoid_, 0, start, length);
+        status = txn.Transact();
+        blobfs_->UpdateMerkleDiskReadMetrics(length * kBlobfsBlockSize, ticker.End());
+    }
+    if (status != ZX_OK) {
+        return status;
+    } else if (chunk_count == 1) {
+        return Verify();
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<ChunkInfo> info(new (&ac) ChunkInfo);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    info->remaining = static_cast<uint32_t>(chunk_count);
+    info->loaded.reset(new (&ac) bool[info->remaining]());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    chunk_info_ = fbl::move(info);
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::InitChunked() {
+    TRACE_DURATION("blobfs", "Blobfs::InitChunked", "size", inode_.blob_size,
+                   "blocks", inode_.num_blocks);
+    fs::Ticker ticker(blobfs_->CollectingMetrics());
+    uint64_t start = inode_.start_block + DataStartBlock(blobfs_->info_);
+    uint64_t merkle_blocks = MerkleTreeBlocks(inode_);
+    if (inode_.num_blocks <= merkle_blocks) {
+        FS_TRACE_ERROR("Chunk compressed blob has no data blocks\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    uint64_t compressed_blocks = inode_.num_blocks - merkle_blocks;
+    size_t compressed_size;
+    if (mul_overflow(compressed_blocks, kBlobfsBlockSize, &compressed_size)) {
+        FS_TRACE_ERROR("Multiplication overflow\n");
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+
+    // Read the uncompressed merkle tree.
+    zx_status_t status;
+    if (merkle_blocks > 0) {
+        fs::ReadTxn txn(blobfs_);
+        txn.Enqueue(vmoid_, 0, start, merkle_blocks);
+        if ((status = txn.Transact()) != ZX_OK) {
+            FS_TRACE_ERROR("Failed to read merkle tree: %d\n", status);
+            return status;
+        }
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<ChunkInfo> info(new (&ac) ChunkInfo);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    // Read the chunk table, which usually fits in its first block.
+    fbl::AutoLock lock(&blobfs_->chunk_lock_);
+    if ((status = blobfs_->ReadChunkBlocks(start + merkle_blocks, 1)) != ZX_OK) {
+        return status;
+    }
+    size_t table_size = kBlobfsBlockSize;
+    status = info->decompressor.Initialize(blobfs_->chunk_buffer_.start(), &table_size,
+                                           inode_.blob_size, compressed_size);
+    if (status == ZX_ERR_BUFFER_TOO_SMALL) {
+        const uint64_t table_blocks = fbl::round_up(table_size, kBlobfsBlockSize) /
+                                      kBlobfsBlockSize;
+        fbl::unique_ptr<uint8_t[]> table(new (&ac) uint8_t[table_blocks * kBlobfsBlockSize]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        const uint64_t buffer_blocks = blobfs_->chunk_buffer_.size() / kBlobfsBlockSize;
+        for (uint64_t n = 0; n < table_blocks; n += buffer_blocks) {
+            uint64_t count = fbl::min(buffer_blocks, table_blocks - n);
+            if ((status = blobfs_->ReadChunkBlocks(start + merkle_blocks + n, count)) != ZX_OK) {
+                return status;
+            }
+            memcpy(table.get() + n * kBlobfsBlockSize, blobfs_->chunk_buffer_.start(),
+                   count * kBlobfsBlockSize);
+        }
+        status = info->decompressor.Initialize(table.get(), &table_size, inode_.blob_size,
+                                               compressed_size);
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    info->compressed = true;
+    info->remaining = info->decompressor.ChunkCount();
+    info->loaded.reset(new (&ac) bool[info->remaining]());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    chunk_info_ = fbl::move(info);
+    blobfs_->UpdateMerkleDiskReadMetrics((merkle_blocks + 1) * kBlobfsBlockSize, ticker.End());
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadChunks(uint64_t offset, uint64_t length) {
+    if (chunk_info_ == nullptr || length == 0) {
+        return ZX_OK;
+    }
+    ZX_DEBUG_ASSERT(offset + length <= inode_.blob_size);
+    const uint32_t first = static_cast<uint32_t>(offset / kCompressionChunkSize);
+    const uint32_t last = static_cast<uint32_t>((offset + length - 1) / kCompressionChunkSize);
+    for (uint32_t chunk = first; chunk <= last;) {
+        if (chunk_info_->loaded[chunk]) {
+            chunk++;
+            continue;
+        }
+        uint32_t end = chunk + 1;
+        zx_status_t status;
+        if (chunk_info_->compressed) {
+            status = LoadChunk(chunk);
+        } else {
+            // Neighbouring chunks are read and verified together.
+            while (end <= last && !chunk_info_->loaded[end]) {
+                end++;
+            }
+            status = LoadUncompressedChunks(chunk, end);
+        }
+        if (status != ZX_OK) {
+            return status;
+        }
+        chunk = end;
+    }
+
+    // Once everything is in memory, there is nothing left to load.
+    if (chunk_info_->remaining == 0) {
+        chunk_info_.reset();
+    }
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadChunk(uint32_t chunk) {
+    TRACE_DURATION("blobfs", "Blobfs::LoadChunk", "chunk", chunk);
+    fs::Ticker ticker(blobfs_->CollectingMetrics());
+    const ChunkedDecompressor& decompressor = chunk_info_->decompressor;
+    const uint64_t begin = decompressor.CompressedStart(chunk);
+    const uint64_t length = decompressor.CompressedLength(chunk);
+    const uint64_t first_block = begin / kBlobfsBlockSize;
+    const uint64_t end_block = fbl::round_up(begin + length, kBlobfsBlockSize) / kBlobfsBlockSize;
+    const uint64_t start = inode_.start_block + DataStartBlock(blobfs_->info_) +
+                           MerkleTreeBlocks(inode_);
+
+    fbl::AutoLock lock(&blobfs_->chunk_lock_);
+    zx_status_t status;
+    if ((status = blobfs_->ReadChunkBlocks(start + first_block, end_block - first_block)) != ZX_OK) {
+        return status;
+    }
+    fs::Duration read_time = ticker.End();
+    ticker.Reset();
+
+    const void* src = reinterpret_cast<const uint8_t*>(blobfs_->chunk_buffer_.start()) +
+                      (begin - first_block * kBlobfsBlockSize);
+    uint8_t* target = static_cast<uint8_t*>(GetData()) + decompressor.ChunkStart(chunk);
+    if ((status = decompressor.DecompressChunk(chunk, src, target)) != ZX_OK) {
+        FS_TRACE_ERROR("Failed to decompress chunk %u: %d\n", chunk, status);
+        return status;
+    }
+    blobfs_->UpdateMerkleDecompressMetrics(length, decompressor.ChunkLength(chunk), read_time,
+                                           ticker.End());
+
+    // Chunks cover whole merkle tree nodes, so those may be checked right away.
+    if ((status = VerifyRange(decompressor.ChunkStart(chunk),
+                              decompressor.ChunkLength(chunk))) != ZX_OK) {
+        return status;
+    }
 
-    // Read both the uncompressed merkle tree and data.
-    uint64_t length = BlobDataBlocks(inode_) + MerkleTreeBlocks(inode_);
-    txn.Enqueue(vmoid_, 0, start, length);
+    chunk_info_->loaded[chunk] = true;
+    chunk_info_->remaining--;
+    return ZX_OK;
+}
+
+zx_status_t VnodeBlob::LoadUncompressedChunks(uint32_t first, uint32_t end) {
+    TRACE_DURATION("blobfs", "Blobfs::LoadUncompressedChunks", "first", first, "end", end);
+    fs::Ticker ticker(blobfs_->CollectingMetrics());
+    const uint64_t offset = static_cast<uint64_t>(first) * kCompressionChunkSize;
+    const uint64_t length = fbl::min(static_cast<uint64_t>(end) * kCompressionChunkSize,
+                                     inode_.blob_size) - offset;
+    const uint64_t first_block = offset / kBlobfsBlockSize;
+    const uint64_t block_count = fbl::round_up(offset + length, kBlobfsBlockSize) /
+                                 kBlobfsBlockSize - first_block;
+    const uint64_t merkle_blocks = MerkleTreeBlocks(inode_);
+    const uint64_t start = inode_.start_block + DataStartBlock(blobfs_->info_) + merkle_blocks;
+
+    // The blob is laid out in |mapping_| just as it is on disk.
+    fs::ReadTxn txn(blobfs_);
+    txn.Enqueue(vmoid_, merkle_blocks + first_block, start + first_block, block_count);
     zx_status_t status = txn.Transact();
-    blobfs_->UpdateMerkleDiskReadMetrics(length * kBlobfsBlockSize, ticker.End());
-    return status;
+    blobfs_->UpdateMerkleDiskReadMetrics(block_count * kBlobfsBlockSize, ticker.End());
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    if ((status = VerifyRange(offset, length)) != ZX_OK) {
+        return status;
+    }
+
+    for (uint32_t chunk = first; chunk < end; chunk++) {
+        chunk_info_->loaded[chunk] = true;
+    }
+    chunk_info_->remaining -= end - first;
+    return ZX_OK;
 }
 
 void VnodeBlob::PopulateInode(size_t node_index) {
@@ -336,6 +552,7 @@ VnodeBlob::VnodeBlob(Blobfs* bs)
 
 void VnodeBlob::BlobCloseHandles() {
     mapping_.Reset();
+    chunk_info_.reset();
     readable_event_.reset();
 }
 
@@ -396,7 +613,8 @@ zx_status_t VnodeBlob::SpaceAllocate(uint64_t size_data) {
             return status;
         }
         status = write_info_->compressor.Initialize(write_info_->compressed_blob.start(),
-                                                    write_info_->compressed_blob.size());
+                                                    write_info_->compressed_blob.size(),
+                                                    inode_.blob_size);
         if (status != ZX_OK) {
             fprintf(stderr, "blobfs: Failed to initialize compressor: %d\n", status);
             return status;
@@ -501,6 +719,7 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
         if ((status = blobfs_->CreateWork(&wb, this)) != ZX_OK) {
             return status;
         }
+        wb->SetDataOnly();
 
         // In case the operation fails, forcibly reset the WritebackWork
         // to avoid asserting that no write requests exist on destruction.
@@ -533,7 +752,7 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             blobfs_->UnreserveBlocks(inode_.num_blocks - blocks,
                                      inode_.start_block + blocks);
             inode_.num_blocks = blocks;
-            inode_.flags |= kBlobFlagLZ4Compressed;
+            inode_.flags |= kBlobFlagChunkCompressed;
         } else {
             uint64_t blocks = fbl::round_up(inode_.blob_size, kBlobfsBlockSize) / kBlobfsBlockSize;
             if ((status = EnqueuePaginated(&wb, blobfs_, this, mapping_.vmo().get(),
@@ -553,8 +772,9 @@ zx_status_t VnodeBlob::WriteInternal(const void* data, size_t len, size_t* actua
             const void* blob_data = GetData();
             fs::Ticker ticker(blobfs_->CollectingMetrics()); // Tracking generation time.
 
-            if ((status = MerkleTree::Create(blob_data, inode_.blob_size, merkle_data,
-                                             merkle_size, &digest)) != ZX_OK) {
+            if ((status = MerkleTree::CreateParallel(blob_data, inode_.blob_size, merkle_data,
+                                                     merkle_size, &digest,
+                                                     zx_system_get_num_cpus())) != ZX_OK) {
                 return status;
             } else if (digest != digest_) {
                 // Downloaded blob did not match provided digest.
@@ -626,9 +846,16 @@ zx_status_t VnodeBlob::CloneVmo(zx_rights_t rights, zx_handle_t* out) {
     if (inode_.blob_size == 0) {
         return ZX_ERR_BAD_STATE;
     }
-    zx_status_t status = InitVmos();
-    if (status != ZX_OK) {
-        return status;
+    zx_status_t status;
+    {
+        fbl::AutoLock lock(&load_lock_);
+        if ((status = InitVmos()) != ZX_OK) {
+            return status;
+        }
+        // Clients may touch any of it, so all of the blob must be verified.
+        if ((status = LoadChunks(0, inode_.blob_size)) != ZX_OK) {
+            return status;
+        }
     }
 
     // TODO(smklein): Only clone / verify the part of the vmo that
@@ -671,6 +898,9 @@ void VnodeBlob::HandleNoClones(async_dispatcher_t* dispatcher, async::WaitBase*
     ZX_DEBUG_ASSERT(status == ZX_OK);
     ZX_DEBUG_ASSERT((signal->observed & ZX_VMO_ZERO_CHILDREN) != 0);
     ZX_DEBUG_ASSERT(clone_watcher_.object() != ZX_HANDLE_INVALID);
+    // Releasing the last reference may close the blob, which must not race
+    // with connections on other dispatcher threads.
+    fbl::AutoLock lock(blobfs_->dispatch_lock());
     clone_watcher_.set_object(ZX_HANDLE_INVALID);
     clone_ref_ = nullptr;
 }
@@ -687,14 +917,6 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         return ZX_OK;
     }
 
-    zx_status_t status = InitVmos();
-    if (status != ZX_OK) {
-        return status;
-    }
-
-    Digest d;
-    d = reinterpret_cast<const uint8_t*>(&digest_[0]);
-
     if (off >= inode_.blob_size) {
         *actual = 0;
         return ZX_OK;
@@ -703,6 +925,17 @@ zx_status_t VnodeBlob::ReadInternal(void* data, size_t len, size_t off, size_t*
         len = inode_.blob_size - off;
     }
 
+    zx_status_t status;
+    {
+        fbl::AutoLock lock(&load_lock_);
+        if ((status = InitVmos()) != ZX_OK) {
+            return status;
+        }
+        if ((status = LoadChunks(off, len)) != ZX_OK) {
+            return status;
+        }
+    }
+
     const size_t merkle_bytes = MerkleTreeBlocks(inode_) * kBlobfsBlockSize;
     status = mapping_.vmo().read(data, merkle_bytes + off, len);
     if (status == ZX_OK) {
@@ -734,14 +967,42 @@ zx_status_t VnodeBlob::VerifyBlob(Blobfs* bs, size_t node_index) {
     vn->SetState(kBlobStatePurged);
 
     // If we are unable to read in the blob from disk, this should also be a VerifyBlob error.
-    // Since InitVmos calls Verify as its final step, we can just return its result here.
-    return vn->InitVmos();
+    // InitVmos verifies the blob as its final step, except for blobs which
+    // are loaded a chunk at a time, whose chunks are verified as they are
+    // loaded.
+    zx_status_t status = vn->InitVmos();
+    if (status != ZX_OK) {
+        return status;
+    }
+    return vn->LoadChunks(0, vn->inode_.blob_size);
 }
 
 zx_status_t Blobfs::VerifyBlob(size_t node_index) {
     return VnodeBlob::VerifyBlob(this, node_index);
 }
 
+zx_status_t Blobfs::ReadChunkBlocks(uint64_t dev_offset, uint64_t nblocks) {
+    zx_status_t status;
+    if (!chunk_buffer_.vmo()) {
+        // Room for the largest chunk, which may straddle a block boundary on
+        // either side.
+        size_t size = fbl::round_up(ChunkedDecompressor::MaxCompressedChunk(), kBlobfsBlockSize) +
+                      kBlobfsBlockSize;
+        if ((status = chunk_buffer_.CreateAndMap(size, "blob-chunk")) != ZX_OK) {
+            return status;
+        }
+        if ((status = AttachVmo(chunk_buffer_.vmo().get(), &chunk_buffer_vmoid_)) != ZX_OK) {
+            chunk_buffer_.Reset();
+            return status;
+        }
+    }
+    ZX_DEBUG_ASSERT(nblocks * kBlobfsBlockSize <= chunk_buffer_.size());
+
+    fs::ReadTxn txn(this);
+    txn.Enqueue(chunk_buffer_vmoid_, 0, dev_offset, nblocks);
+    return txn.Transact();
+}
+
 zx_status_t Blobfs::FindBlocks(size_t start, size_t num_blocks, size_t* blkno_out) {
     while (true) {
         // Search for a range of nblocks in block_map_.
@@ -1384,6 +1645,7 @@ void Blobfs::Sync(SyncCallback closure) {
 
 void Blobfs::UpdateAllocationMetrics(uint64_t size_data, const fs::Duration& duration) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.blobs_created++;
         metrics_.blobs_created_total_size += size_data;
         metrics_.total_allocation_time_ticks += duration;
@@ -1392,6 +1654,7 @@ void Blobfs::UpdateAllocationMetrics(uint64_t size_data, const fs::Duration& dur
 
 void Blobfs::UpdateLookupMetrics(uint64_t size) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.blobs_opened++;
         metrics_.blobs_opened_total_size += size;
     }
@@ -1401,6 +1664,7 @@ void Blobfs::UpdateClientWriteMetrics(uint64_t data_size, uint64_t merkle_size,
                                       const fs::Duration& enqueue_duration,
                                       const fs::Duration& generate_duration) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.data_bytes_written += data_size;
         metrics_.merkle_bytes_written += merkle_size;
         metrics_.total_write_enqueue_time_ticks += enqueue_duration;
@@ -1410,6 +1674,7 @@ void Blobfs::UpdateClientWriteMetrics(uint64_t data_size, uint64_t merkle_size,
 
 void Blobfs::UpdateWritebackMetrics(uint64_t size, const fs::Duration& duration) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.total_writeback_time_ticks += duration;
         metrics_.total_writeback_bytes_written += size;
     }
@@ -1417,6 +1682,7 @@ void Blobfs::UpdateWritebackMetrics(uint64_t size, const fs::Duration& duration)
 
 void Blobfs::UpdateMerkleDiskReadMetrics(uint64_t size, const fs::Duration& duration) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.total_read_from_disk_time_ticks += duration;
         metrics_.bytes_read_from_disk += size;
     }
@@ -1427,6 +1693,7 @@ void Blobfs::UpdateMerkleDecompressMetrics(uint64_t size_compressed,
                                            const fs::Duration& read_duration,
                                            const fs::Duration& decompress_duration) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.bytes_compressed_read_from_disk += size_compressed;
         metrics_.bytes_decompressed_from_disk += size_uncompressed;
         metrics_.total_read_compressed_time_ticks += read_duration;
@@ -1437,6 +1704,7 @@ void Blobfs::UpdateMerkleDecompressMetrics(uint64_t size_compressed,
 void Blobfs::UpdateMerkleVerifyMetrics(uint64_t size_data, uint64_t size_merkle,
                                        const fs::Duration& duration) {
     if (CollectingMetrics()) {
+        fbl::AutoLock lock(&metrics_lock_);
         metrics_.blobs_verified++;
         metrics_.blobs_verified_total_size_data += size_data;
         metrics_.blobs_verified_total_size_merkle += size_merkle;
@@ -1456,6 +1724,7 @@ Blobfs::~Blobfs() {
     writeback_.reset();
 
     ZX_ASSERT(open_hash_.is_empty());
+    closed_lru_.clear();
     closed_hash_.clear();
 
     if (blockfd_) {
@@ -1475,7 +1744,7 @@ zx_status_t Blobfs::Create(fbl::unique_fd fd, const MountOptions& options,
     fbl::AllocChecker ac;
     auto fs = fbl::unique_ptr<Blobfs>(new Blobfs(fbl::move(fd), info));
     fs->SetReadonly(options.readonly);
-    fs->SetCachePolicy(options.cache_policy);
+    fs->SetCachePolicy(options.cache_policy, options.cache_budget);
     if (options.metrics) {
         fs->CollectMetrics();
     }
@@ -1546,6 +1815,8 @@ zx_status_t Blobfs::Create(fbl::unique_fd fd, const MountOptions& options,
 
 zx_status_t Blobfs::InitializeVnodes() {
     fbl::AutoLock lock(&hash_lock_);
+    closed_lru_.clear();
+    closed_lru_bytes_ = 0;
     closed_hash_.clear();
     for (size_t i = 0; i < info_.inode_count; ++i) {
         const Inode* inode = GetNode(i);
@@ -1670,6 +1941,13 @@ zx_status_t Blobfs::VnodeInsertClosedLocked(fbl::RefPtr<VnodeBlob> vn) {
         break;
     case CachePolicy::NeverEvict:
         break;
+    case CachePolicy::EvictLeastRecentlyUsed:
+        if (vn->CachedBytes() > 0) {
+            closed_lru_.push_back(vn.get());
+            closed_lru_bytes_ += vn->CachedBytes();
+            EvictClosedLocked(cache_budget_);
+        }
+        break;
     default:
         ZX_ASSERT_MSG(false, "Unexpected cache policy");
     }
@@ -1684,12 +1962,71 @@ fbl::RefPtr<VnodeBlob> Blobfs::VnodeUpgradeLocked(const uint8_t* key) {
     if (raw_vn == nullptr) {
         return nullptr;
     }
+    if (VnodeBlob::TypeLruTraits::node_state(*raw_vn).InContainer()) {
+        closed_lru_.erase(*raw_vn);
+        closed_lru_bytes_ -= raw_vn->CachedBytes();
+    }
     open_hash_.insert(raw_vn);
     // To have existed in the closed_hash_, this RefPtr must have
     // been leaked.
     return fbl::internal::MakeRefPtrNoAdopt(raw_vn);
 }
 
+void Blobfs::EvictClosedLocked(size_t budget) {
+    while (closed_lru_bytes_ > budget) {
+        VnodeBlob* vn = closed_lru_.pop_front();
+        closed_lru_bytes_ -= vn->CachedBytes();
+        vn->TearDown();
+    }
+}
+
+zx_status_t Blobfs::WatchMemoryPressure() {
+    if (cache_policy_ != CachePolicy::EvictLeastRecentlyUsed) {
+        return ZX_OK;
+    }
+    // There is no memory pressure event for userspace to observe. Instead,
+    // blobfs holds a discardable page for the evictor to reclaim: it only does
+    // so once free memory is running low.
+    zx_status_t status;
+    if ((status = zx::vmo::create(PAGE_SIZE, ZX_VMO_DISCARDABLE, &pressure_canary_)) != ZX_OK) {
+        return status;
+    }
+    pressure_canary_.set_property(ZX_PROP_NAME, "blobfs-pressure", strlen("blobfs-pressure"));
+    if ((status = ArmPressureCanary()) != ZX_OK) {
+        return status;
+    }
+    pressure_watcher_.set_object(pressure_canary_.get());
+    pressure_watcher_.set_trigger(ZX_VMO_DISCARDED);
+    return pressure_watcher_.Begin(dispatcher());
+}
+
+zx_status_t Blobfs::ArmPressureCanary() {
+    zx_status_t status;
+    if ((status = pressure_canary_.op_range(ZX_VMO_OP_COMMIT, 0, PAGE_SIZE, nullptr, 0)) != ZX_OK) {
+        return status;
+    }
+    return pressure_canary_.op_range(ZX_VMO_OP_UNLOCK, 0, PAGE_SIZE, nullptr, 0);
+}
+
+void Blobfs::HandleMemoryPressure(async_dispatcher_t* dispatcher, async::WaitBase* wait,
+                                  zx_status_t status, const zx_packet_signal_t* signal) {
+    if (status != ZX_OK) {
+        return;
+    }
+    TRACE_DURATION("blobfs", "Blobfs::HandleMemoryPressure");
+    {
+        fbl::AutoLock lock(&hash_lock_);
+        EvictClosedLocked(0);
+    }
+
+    // Locking the canary deasserts ZX_VMO_DISCARDED.
+    if ((status = pressure_canary_.op_range(ZX_VMO_OP_LOCK, 0, PAGE_SIZE, nullptr, 0)) != ZX_OK ||
+        (status = ArmPressureCanary()) != ZX_OK ||
+        (status = wait->Begin(dispatcher)) != ZX_OK) {
+        fprintf(stderr, "blobfs: Failed to keep watching memory pressure: %d\n", status);
+    }
+}
+
 zx_status_t Blobfs::OpenRootNode(fbl::RefPtr<VnodeBlob>* out) {
     fbl::AllocChecker ac;
     fbl::RefPtr<VnodeBlob> vn =
@@ -1772,6 +2109,11 @@ zx_status_t Mount(async_dispatcher_t* dispatcher, fbl::unique_fd blockfd,
     fs->SetDispatcher(dispatcher);
     fs->SetUnmountCallback(fbl::move(on_unmount));
 
+    if ((status = fs->WatchMemoryPressure()) != ZX_OK) {
+        fprintf(stderr, "blobfs: mount failed; could not watch memory pressure\n");
+        return status;
+    }
+
     fbl::RefPtr<VnodeBlob> vn;
     if ((status = fs->OpenRootNode(&vn)) != ZX_OK) {
         fprintf(stderr, "blobfs: mount failed; could not get root blob\n");
@@ -3,11 +3,18 @@
 // found in the LICENSE file.
 
 #include <blobfs/fsck.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/vector.h>
 #include <fs/trace.h>
 #include <inttypes.h>
 
 #ifdef __Fuchsia__
+#include <threads.h>
+
 #include <blobfs/blobfs.h>
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <zircon/syscalls.h>
 #else
 #include <blobfs/host.h>
 #endif
@@ -16,8 +23,89 @@
 // TODO(planders): Potentially check the state of the journal.
 namespace blobfs {
 
+#ifdef __Fuchsia__
+namespace {
+
+// Blobs shared out between the threads verifying them.
+struct VerifyQueue {
+    Blobfs* blobfs;
+    const uint32_t* nodes;
+    size_t count;
+    fbl::atomic_size_t next;
+    fbl::atomic_uint32_t errors;
+};
+
+} // namespace
+#endif
+
+bool BlobfsChecker::VerifyNode(Blobfs* blobfs, uint32_t n) {
+    if (blobfs->VerifyBlob(n) != ZX_OK) {
+        FS_TRACE_ERROR("check: detected inode %u with bad state\n", n);
+        return false;
+    }
+    return true;
+}
+
+#ifdef __Fuchsia__
+
+int BlobfsChecker::VerifyThread(void* arg) {
+    VerifyQueue* queue = static_cast<VerifyQueue*>(arg);
+    for (size_t i = queue->next.fetch_add(1); i < queue->count; i = queue->next.fetch_add(1)) {
+        if (!VerifyNode(queue->blobfs, queue->nodes[i])) {
+            queue->errors.fetch_add(1);
+        }
+    }
+    return 0;
+}
+
+// Blobs are verified on up to one thread per CPU, calling thread included, so
+// that reading one blob from disk overlaps with verifying others.
+uint32_t BlobfsChecker::VerifyNodes(const uint32_t* nodes, size_t count) {
+    VerifyQueue queue;
+    queue.blobfs = blobfs_.get();
+    queue.nodes = nodes;
+    queue.count = count;
+    queue.next.store(0);
+    queue.errors.store(0);
+
+    const size_t num_threads = fbl::min(fbl::min(static_cast<size_t>(zx_system_get_num_cpus()),
+                                                 static_cast<size_t>(kMaxDispatchThreads)),
+                                        count);
+    thrd_t threads[kMaxDispatchThreads];
+    size_t started = 0;
+    for (; started + 1 < num_threads; started++) {
+        if (thrd_create_with_name(&threads[started], VerifyThread, &queue, "blobfs-fsck") !=
+            thrd_success) {
+            // The threads which did start, and this one, verify the rest.
+            break;
+        }
+    }
+    VerifyThread(&queue);
+    for (size_t i = 0; i < started; i++) {
+        thrd_join(threads[i], nullptr);
+    }
+    return queue.errors.load();
+}
+
+#else
+
+uint32_t BlobfsChecker::VerifyNodes(const uint32_t* nodes, size_t count) {
+    uint32_t errors = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!VerifyNode(blobfs_.get(), nodes[i])) {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+#endif
+
 void BlobfsChecker::TraverseInodeBitmap() {
-    for (unsigned n = 0; n < blobfs_->info_.inode_count; n++) {
+    // The inode table is checked against the block bitmap first, and then the
+    // blobs which passed are read and verified all at once.
+    fbl::Vector<uint32_t> nodes;
+    for (uint32_t n = 0; n < blobfs_->info_.inode_count; n++) {
         Inode* inode = blobfs_->GetNode(n);
         if (inode->start_block >= kStartBlockMinimum) {
             alloc_inodes_++;
@@ -25,32 +113,39 @@ void BlobfsChecker::TraverseInodeBitmap() {
 
             size_t start_block = inode->start_block;
             size_t end_block = inode->start_block + inode->num_blocks;
-            bool valid = true;
 
             size_t first_unset = 0;
             if (!blobfs_->block_map_.Get(start_block, end_block, &first_unset)) {
                 FS_TRACE_ERROR("check: ino %u using blocks [%zu, %zu). "
                                "Not fully allocated in block bitmap; first unset @%zu\n",
                                n, start_block, end_block, first_unset);
-                valid = false;
+                error_blobs_++;
+                continue;
             }
 
-            if (blobfs_->VerifyBlob(n) != ZX_OK) {
-                FS_TRACE_ERROR("check: detected inode %u with bad state\n", n);
-                valid = false;
-            }
-            if (!valid) {
-                error_blobs_++;
+            fbl::AllocChecker ac;
+            nodes.push_back(n, &ac);
+            if (!ac.check()) {
+                // Verify it now instead.
+                if (!VerifyNode(blobfs_.get(), n)) {
+                    error_blobs_++;
+                }
             }
         }
     }
+    error_blobs_ += VerifyNodes(nodes.get(), nodes.size());
 }
 
 void BlobfsChecker::TraverseBlockBitmap() {
-    for (uint64_t n = 0; n < blobfs_->info_.data_block_count; n++) {
-        if (blobfs_->block_map_.Get(n, n + 1)) {
-            alloc_blocks_++;
-        }
+    // Count the allocated blocks a run at a time.
+    const size_t block_count = blobfs_->info_.data_block_count;
+    size_t start;
+    for (size_t n = 0;
+         n < block_count && blobfs_->block_map_.Find(true, n, block_count, 1, &start) == ZX_OK; ) {
+        size_t end = block_count;
+        blobfs_->block_map_.Scan(start, block_count, true, &end);
+        alloc_blocks_ += static_cast<uint32_t>(end - start);
+        n = end;
     }
 }
 
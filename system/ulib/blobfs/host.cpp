@@ -79,6 +79,36 @@ zx_status_t buffer_create_merkle(const FileMapping& mapping, MerkleInfo* out_inf
     return ZX_OK;
 }
 
+// Compresses |mapping| at |level| into the |max| bytes at |out|, and sets
+// |*out_size| to the compressed size.
+zx_status_t compress_mapping(const FileMapping& mapping, CompressionLevel level, void* out,
+                             size_t max, size_t* out_size) {
+    Compressor compressor;
+    zx_status_t status;
+    if ((status = compressor.Initialize(out, max, mapping.length(), level)) != ZX_OK) {
+        fprintf(stderr, "Failed to initialize blobfs compressor: %d\n", status);
+        return status;
+    }
+
+    if ((status = compressor.Update(mapping.data(), mapping.length())) != ZX_OK) {
+        fprintf(stderr, "Failed to update blobfs compressor: %d\n", status);
+        return status;
+    }
+
+    if ((status = compressor.End()) != ZX_OK) {
+        fprintf(stderr, "Failed to complete blobfs compressor: %d\n", status);
+        return status;
+    }
+
+    *out_size = compressor.Size();
+    return ZX_OK;
+}
+
+// Compresses |mapping| at whichever level stores it in fewer blocks.
+//
+// Both levels decompress at the same speed, so the slower LZ4 HC costs
+// nothing once the image is built, and is kept whenever it saves a block.
+// The choice only depends on the data, so images stay reproducible.
 zx_status_t buffer_compress(const FileMapping& mapping, MerkleInfo* out_info) {
     Compressor compressor;
     size_t max = compressor.BufferMax(mapping.length());
@@ -90,23 +120,25 @@ zx_status_t buffer_compress(const FileMapping& mapping, MerkleInfo* out_info) {
     }
 
     zx_status_t status;
-    if ((status = compressor.Initialize(out_info->compressed_data.get(), max)) != ZX_OK) {
-        fprintf(stderr, "Failed to initialize blobfs compressor: %d\n", status);
+    size_t size;
+    if ((status = compress_mapping(mapping, CompressionLevel::kFast,
+                                   out_info->compressed_data.get(), max, &size)) != ZX_OK) {
         return status;
     }
 
-    if ((status = compressor.Update(mapping.data(), mapping.length())) != ZX_OK) {
-        fprintf(stderr, "Failed to update blobfs compressor: %d\n", status);
+    fbl::unique_ptr<uint8_t[]> high_data(new uint8_t[max]);
+    size_t high_size;
+    if ((status = compress_mapping(mapping, CompressionLevel::kHigh, high_data.get(), max,
+                                   &high_size)) != ZX_OK) {
         return status;
     }
-
-    if ((status = compressor.End()) != ZX_OK) {
-        fprintf(stderr, "Failed to complete blobfs compressor: %d\n", status);
-        return status;
+    if (fbl::round_up(high_size, kBlobfsBlockSize) < fbl::round_up(size, kBlobfsBlockSize)) {
+        out_info->compressed_data = fbl::move(high_data);
+        size = high_size;
     }
 
-    if (mapping.length() > compressor.Size() + kCompressionMinBytesSaved) {
-        out_info->compressed_length = compressor.Size();
+    if (mapping.length() > size + kCompressionMinBytesSaved) {
+        out_info->compressed_length = size;
         out_info->compressed = true;
     }
 
@@ -143,7 +175,7 @@ zx_status_t blobfs_add_mapped_blob_with_merkle(Blobfs* bs, const FileMapping& ma
     Inode* inode = inode_block->GetInode();
     inode->blob_size = mapping.length();
     inode->num_blocks = MerkleTreeBlocks(*inode) + info.GetDataBlocks();
-    inode->flags |= (info.compressed ? kBlobFlagLZ4Compressed : 0);
+    inode->flags |= (info.compressed ? kBlobFlagChunkCompressed : 0);
 
     if ((status = bs->AllocateBlocks(inode->num_blocks,
                                      reinterpret_cast<size_t*>(&inode->start_block))) != ZX_OK) {
@@ -269,6 +301,29 @@ zx_status_t blobfs_preprocess(int data_fd, bool compress, MerkleInfo* out_info)
     return status;
 }
 
+zx_status_t blobfs_create_merkle(int data_fd, MerkleInfo* out_info) {
+    FileMapping mapping;
+    zx_status_t status = mapping.Map(data_fd);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    return buffer_create_merkle(mapping, out_info);
+}
+
+zx_status_t blobfs_compress(int data_fd, MerkleInfo* info) {
+    FileMapping mapping;
+    zx_status_t status = mapping.Map(data_fd);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (mapping.length() != info->length) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    return buffer_compress(mapping, info);
+}
+
 zx_status_t blobfs_add_blob(Blobfs* bs, int data_fd) {
     FileMapping mapping;
     zx_status_t status = mapping.Map(data_fd);
@@ -567,7 +622,7 @@ zx_status_t Blobfs::VerifyBlob(size_t node_index) {
 
     // Create data buffer.
     fbl::unique_ptr<uint8_t[]> data(new uint8_t[target_size]);
-    if (inode.flags & kBlobFlagLZ4Compressed) {
+    if (inode.flags & (kBlobFlagLZ4Compressed | kBlobFlagChunkCompressed)) {
         // Read in uncompressed merkle blocks.
         for (unsigned i = 0; i < merkle_blocks; i++) {
             ReadBlock(data_start_block_ + inode.start_block + i);
@@ -595,8 +650,23 @@ zx_status_t Blobfs::VerifyBlob(size_t node_index) {
         zx_status_t status;
         target_size = inode.blob_size;
         uint8_t* data_ptr = data.get() + (merkle_blocks * kBlobfsBlockSize);
-        if ((status = Decompressor::Decompress(data_ptr, &target_size, compressed_data.get(),
-                                               &compressed_size)) != ZX_OK) {
+        if (inode.flags & kBlobFlagChunkCompressed) {
+            ChunkedDecompressor decompressor;
+            size_t table_size = compressed_size;
+            if ((status = decompressor.Initialize(compressed_data.get(), &table_size,
+                                                  inode.blob_size, compressed_size)) != ZX_OK) {
+                return status;
+            }
+            for (uint32_t i = 0; i < decompressor.ChunkCount(); i++) {
+                const uint8_t* src = compressed_data.get() + decompressor.CompressedStart(i);
+                if ((status = decompressor.DecompressChunk(i, src, data_ptr +
+                                                           decompressor.ChunkStart(i))) != ZX_OK) {
+                    return status;
+                }
+            }
+        } else if ((status = Decompressor::Decompress(data_ptr, &target_size,
+                                                      compressed_data.get(),
+                                                      &compressed_size)) != ZX_OK) {
             return status;
         }
         if (target_size != inode.blob_size) {
@@ -18,9 +18,11 @@
 #include <block-client/cpp/client.h>
 #include <digest/digest.h>
 #include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/intrusive_wavl_tree.h>
 #include <fbl/macros.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_counted.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_fd.h>
@@ -92,6 +94,10 @@ public:
     struct TypeWavlTraits {
         static WAVLTreeNodeState& node_state(VnodeBlob& b) { return b.type_wavl_state_; }
     };
+    using LruNodeState = fbl::DoublyLinkedListNodeState<VnodeBlob*>;
+    struct TypeLruTraits {
+        static LruNodeState& node_state(VnodeBlob& b) { return b.type_lru_state_; }
+    };
     const uint8_t* GetKey() const {
         return &digest_[0];
     };
@@ -122,6 +128,11 @@ public:
 
     uint64_t SizeData() const;
 
+    // The number of bytes of memory held by the blob's data and merkle tree.
+    size_t CachedBytes() const {
+        return mapping_.size();
+    }
+
     const Inode& GetNode() const {
         return inode_;
     }
@@ -157,6 +168,7 @@ public:
 
 private:
     friend struct TypeWavlTraits;
+    friend struct TypeLruTraits;
 
     DISALLOW_COPY_ASSIGN_AND_MOVE(VnodeBlob);
 
@@ -217,6 +229,8 @@ private:
     zx_status_t Readdir(fs::vdircookie_t* cookie, void* dirents, size_t len,
                         size_t* out_actual) final;
     zx_status_t Read(void* data, size_t len, size_t off, size_t* out_actual) final;
+    // Readable blobs are immutable, and |load_lock_| serializes loading them.
+    bool SupportsConcurrentReads() const final { return true; }
     zx_status_t Write(const void* data, size_t len, size_t offset,
                       size_t* out_actual) final;
     zx_status_t Append(const void* data, size_t len, size_t* out_end,
@@ -232,7 +246,10 @@ private:
     zx_status_t GetVmo(int flags, zx_handle_t* out) final;
     void Sync(SyncCallback closure) final;
 
-    // Read both VMOs into memory, if we haven't already.
+    // Read both VMOs into memory, if we haven't already. Blobs of more than
+    // one chunk, unless stored as a single LZ4 frame, only have their merkle
+    // tree read here, and their data is read as it is needed by
+    // |LoadChunks()|.
     //
     // TODO(ZX-1481): When we have can register the Blob Store as a pager
     // service, and it can properly handle pages faults on a vnode's contents,
@@ -245,14 +262,36 @@ private:
     // Does not verify the blob.
     zx_status_t InitCompressed();
 
-    // Initialize a decompressed blob by reading it from disk.
-    // Does not verify the blob.
+    // Initialize an uncompressed blob. A blob of a single chunk is read from
+    // disk and verified. Larger blobs only have their merkle tree read, and
+    // have their data left on disk until |LoadChunks()|.
     zx_status_t InitUncompressed();
 
+    // Initialize a blob stored in compressed chunks, by reading its merkle
+    // tree and chunk table from disk. The chunks themselves are left on disk
+    // until |LoadChunks()|.
+    zx_status_t InitChunked();
+
+    // Ensures that the data in [offset, offset + length) of a blob which was
+    // left on disk by |InitChunked()| or |InitUncompressed()| has been read
+    // in, decompressed if need be, and verified. Does nothing for other
+    // blobs, since |InitVmos()| verifies them in full.
+    zx_status_t LoadChunks(uint64_t offset, uint64_t length);
+
+    // Reads in, decompresses and verifies a single compressed chunk.
+    zx_status_t LoadChunk(uint32_t chunk);
+
+    // Reads in and verifies the uncompressed chunks [first, end).
+    zx_status_t LoadUncompressedChunks(uint32_t first, uint32_t end);
+
     // Verify the integrity of the in-memory Blob.
     // InitVmos() must have already been called for this blob.
     zx_status_t Verify() const;
 
+    // Verify the integrity of [offset, offset + length) of the in-memory
+    // blob, which must be in memory along with the merkle tree.
+    zx_status_t VerifyRange(uint64_t offset, uint64_t length) const;
+
     // Called by the Vnode once the last write has completed, updating the
     // on-disk metadata.
     zx_status_t WriteMetadata();
@@ -262,6 +301,7 @@ private:
     void* GetMerkle() const;
 
     WAVLTreeNodeState type_wavl_state_ = {};
+    LruNodeState type_lru_state_ = {};
 
     Blobfs* const blobfs_;
     BlobFlags flags_ = {};
@@ -273,6 +313,10 @@ private:
     fzl::OwnedVmoMapper mapping_;
     vmoid_t vmoid_ = {};
 
+    // Held by readers around |InitVmos()| and |LoadChunks()|, which may run
+    // on several dispatcher threads at once.
+    fbl::Mutex load_lock_;
+
     // Watches any clones of "vmo_" provided to clients.
     // Observes the ZX_VMO_ZERO_CHILDREN signal.
     async::WaitMethod<VnodeBlob, &VnodeBlob::HandleNoClones> clone_watcher_;
@@ -298,6 +342,20 @@ private:
     };
 
     fbl::unique_ptr<WritebackInfo> write_info_ = {};
+
+    // Data used to load a blob a chunk at a time, until all of its chunks are
+    // in |mapping_|. Uncompressed blobs are split into chunks of the same size
+    // as compressed ones, and the chunks verified so far are those marked
+    // |loaded|.
+    struct ChunkInfo {
+        // Only used for blobs stored in compressed chunks.
+        ChunkedDecompressor decompressor;
+        bool compressed = false;
+        fbl::unique_ptr<bool[]> loaded;
+        uint32_t remaining = 0;
+    };
+
+    fbl::unique_ptr<ChunkInfo> chunk_info_ = {};
 };
 
 // We need to define this structure to allow the Blob to be indexable by a key
@@ -330,14 +388,36 @@ enum class CachePolicy {
     // This option costs a significant amount of memory, but it results in high
     // performance.
     NeverEvict,
+
+    // Closed blobs keep their verified data and merkle tree in memory, up to
+    // a total of |MountOptions::cache_budget| bytes. Beyond that, the least
+    // recently closed blobs are evicted first. All of them are evicted when
+    // the system runs low on memory.
+    //
+    // This option bounds the memory used, while keeping frequently reopened
+    // blobs ready to be served.
+    EvictLeastRecentlyUsed,
 };
 
+// Every thread which talks to the block device takes one of its transaction
+// groups, and the writeback and journal threads already hold two.
+constexpr uint32_t kMaxDispatchThreads = MAX_TXN_GROUP_COUNT - 2;
+
+// The default |MountOptions::cache_budget|.
+constexpr size_t kDefaultCacheBudget = 64 * (1 << 20);
+
 // Toggles that may be set on blobfs during initialization.
 struct MountOptions {
     bool readonly = false;
     bool metrics = false;
     bool journal = false;
     CachePolicy cache_policy = CachePolicy::EvictImmediately;
+    // The number of bytes closed blobs may keep in memory, with
+    // |CachePolicy::EvictLeastRecentlyUsed|.
+    size_t cache_budget = kDefaultCacheBudget;
+    // The number of threads serving connections, up to |kMaxDispatchThreads|.
+    // Reads of blobs run concurrently; all other operations are serialized.
+    uint32_t dispatch_threads = 1;
 };
 
 class Blobfs : public fs::ManagedVfs, public fbl::RefCounted<Blobfs>,
@@ -379,12 +459,16 @@ public:
     static zx_status_t Create(fbl::unique_fd blockfd, const MountOptions& options,
                               const Superblock* info, fbl::unique_ptr<Blobfs>* out);
 
-    void SetCachePolicy(CachePolicy policy) { cache_policy_ = policy; }
+    void SetCachePolicy(CachePolicy policy, size_t budget) {
+        cache_policy_ = policy;
+        cache_budget_ = budget;
+    }
     void CollectMetrics() { collecting_metrics_ = true; }
     bool CollectingMetrics() const { return collecting_metrics_; }
     void DisableMetrics() { collecting_metrics_ = false; }
     void DumpMetrics() const {
         if (collecting_metrics_) {
+            fbl::AutoLock lock(&metrics_lock_);
             metrics_.Dump();
         }
     }
@@ -400,6 +484,11 @@ public:
     // Returns the capacity of the writeback buffer in blocks.
     size_t WritebackCapacity() const;
 
+    // With |CachePolicy::EvictLeastRecentlyUsed|, starts evicting every closed
+    // blob whenever the kernel reports that memory is low. Requires the
+    // dispatcher to be set.
+    zx_status_t WatchMemoryPressure();
+
     virtual ~Blobfs();
 
     // Invokes "open" on the root directory.
@@ -543,6 +632,19 @@ private:
     // Precondition: The Vnode must not exist in |open_hash_|.
     fbl::RefPtr<VnodeBlob> VnodeUpgradeLocked(const uint8_t* key) __TA_REQUIRES(hash_lock_);
 
+    // Tears down the least recently closed blobs of |closed_lru_| until they
+    // hold no more than |budget| bytes between them.
+    void EvictClosedLocked(size_t budget) __TA_REQUIRES(hash_lock_);
+
+    // The kernel drops the pages of |pressure_canary_| once memory runs low.
+    // Evicts every closed blob, and starts watching again.
+    void HandleMemoryPressure(async_dispatcher_t* dispatcher, async::WaitBase* wait,
+                              zx_status_t status, const zx_packet_signal_t* signal);
+
+    // Commits the pages of |pressure_canary_| and unlocks it, leaving the
+    // kernel free to drop them.
+    zx_status_t ArmPressureCanary();
+
     // Searches for |nblocks| free blocks between the block_map_ and reserved_blocks_ bitmaps.
     zx_status_t FindBlocks(size_t start, size_t nblocks, size_t* blkno_out);
 
@@ -601,12 +703,18 @@ private:
     // Verifies that the contents of a blob are valid.
     zx_status_t VerifyBlob(size_t node_index);
 
+    // Reads |nblocks| blocks, starting at |dev_offset|, into |chunk_buffer_|.
+    // No more than one compressed chunk's worth of blocks may be read at once.
+    zx_status_t ReadChunkBlocks(uint64_t dev_offset, uint64_t nblocks)
+        __TA_REQUIRES(chunk_lock_);
+
     // VnodeBlobs exist in the WAVLTree as long as one or more reference exists;
     // when the Vnode is deleted, it is immediately removed from the WAVL tree.
     using WAVLTreeByMerkle = fbl::WAVLTree<const uint8_t*,
                                            VnodeBlob*,
                                            MerkleRootTraits,
                                            VnodeBlob::TypeWavlTraits>;
+    using LruList = fbl::DoublyLinkedList<VnodeBlob*, VnodeBlob::TypeLruTraits>;
     fbl::unique_ptr<WritebackQueue> writeback_;
     fbl::unique_ptr<Journal> journal_;
     Superblock info_;
@@ -614,6 +722,10 @@ private:
     fbl::Mutex hash_lock_;
     WAVLTreeByMerkle open_hash_ __TA_GUARDED(hash_lock_){};   // All 'in use' blobs.
     WAVLTreeByMerkle closed_hash_ __TA_GUARDED(hash_lock_){}; // All 'closed' blobs.
+    // The closed blobs which still hold memory, least recently closed first.
+    // Only used with |CachePolicy::EvictLeastRecentlyUsed|.
+    LruList closed_lru_ __TA_GUARDED(hash_lock_){};
+    size_t closed_lru_bytes_ __TA_GUARDED(hash_lock_) = 0;
 
     fbl::unique_fd blockfd_;
     block_info_t block_info_ = {};
@@ -627,6 +739,12 @@ private:
     fzl::ResizeableVmoMapper info_mapping_;
     vmoid_t info_vmoid_ = {};
 
+    // Holds the compressed chunk being loaded into a blob, which is read
+    // through it one chunk at a time. Created on first use.
+    fbl::Mutex chunk_lock_;
+    fzl::OwnedVmoMapper chunk_buffer_ __TA_GUARDED(chunk_lock_);
+    vmoid_t chunk_buffer_vmoid_ __TA_GUARDED(chunk_lock_) = {};
+
     // The reserved_blocks_ and reserved_nodes_ bitmaps only hold in-flight reservations.
     // At a steady state they will be empty.
     bitmap::RleBitmap reserved_blocks_ = {};
@@ -640,9 +758,15 @@ private:
     size_t free_node_lower_bound_ = 0;
 
     bool collecting_metrics_ = false;
-    BlobfsMetrics metrics_ = {};
+    // Updated by the writeback thread and by concurrent reads.
+    fbl::Mutex metrics_lock_;
+    BlobfsMetrics metrics_ __TA_GUARDED(metrics_lock_) = {};
 
     CachePolicy cache_policy_;
+    size_t cache_budget_ = 0;
+    // A discardable page, whose loss signals memory pressure.
+    zx::vmo pressure_canary_;
+    async::WaitMethod<Blobfs, &Blobfs::HandleMemoryPressure> pressure_watcher_{this};
     fbl::Closure on_unmount_ = {};
 };
 
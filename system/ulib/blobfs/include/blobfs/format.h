@@ -26,7 +26,8 @@
 namespace blobfs {
 constexpr uint64_t kBlobfsMagic0  = (0xac2153479e694d21ULL);
 constexpr uint64_t kBlobfsMagic1  = (0x985000d4d4d3d314ULL);
-constexpr uint32_t kBlobfsVersion = 0x00000006;
+// Version 7 added kBlobFlagChunkCompressed, which older drivers can't read.
+constexpr uint32_t kBlobfsVersion = 0x00000007;
 
 constexpr uint32_t kBlobFlagClean        = 1;
 constexpr uint32_t kBlobFlagDirty        = 2;
@@ -197,6 +198,9 @@ constexpr uint64_t kStartBlockMinimum  = 1; // Smallest 'data' block possible.
 
 // Identifies that the on-disk storage of the blob is LZ4 compressed.
 constexpr uint32_t kBlobFlagLZ4Compressed = 0x00000001;
+// Identifies that the on-disk storage of the blob is a ChunkTable, followed by
+// chunks which are LZ4 compressed independently of each other.
+constexpr uint32_t kBlobFlagChunkCompressed = 0x00000002;
 
 using digest::Digest;
 
@@ -214,6 +218,38 @@ static_assert(sizeof(Inode) == kBlobfsInodeSize,
 static_assert(kBlobfsBlockSize % kBlobfsInodeSize == 0,
               "Blobfs Inodes should fit cleanly within a blobfs block");
 
+// Chunked compression splits the data of a blob into chunks of
+// kCompressionChunkSize bytes (the last one may be shorter), each stored as an
+// LZ4 frame of its own. Any chunk can be decompressed without the others, and
+// since chunks cover whole merkle tree nodes, verified on its own too.
+constexpr uint64_t kChunkTableMagic = (0x4b4e484342424f4cULL); // "LOBBCHNK"
+constexpr uint32_t kCompressionChunkSize = 65536;
+static_assert(kCompressionChunkSize % digest::MerkleTree::kNodeSize == 0,
+              "Compressed chunks must cover whole merkle tree nodes");
+
+// The head of the on-disk storage of a blob with |kBlobFlagChunkCompressed|.
+//
+// The header is followed by |chunk_count| + 1 offsets, each a uint64_t: chunk
+// |i| is stored in bytes [offset[i], offset[i + 1]) from the start of the
+// table, so the last offset is the length of the compressed blob.
+struct ChunkTable {
+    uint64_t magic;
+    uint32_t chunk_size;
+    uint32_t chunk_count;
+};
+
+static_assert(sizeof(ChunkTable) == 16, "Blobfs ChunkTable size is wrong");
+
+// The number of chunks a blob of |blob_size| bytes is split into.
+constexpr uint64_t ChunkCount(uint64_t blob_size) {
+    return fbl::round_up(blob_size, kCompressionChunkSize) / kCompressionChunkSize;
+}
+
+// The size of the table of a blob split into |chunk_count| chunks.
+constexpr uint64_t ChunkTableSize(uint64_t chunk_count) {
+    return sizeof(ChunkTable) + (chunk_count + 1) * sizeof(uint64_t);
+}
+
 // Number of blocks reserved for the blob itself
 constexpr uint64_t BlobDataBlocks(const Inode& blobNode) {
     return fbl::round_up(blobNode.blob_size, kBlobfsBlockSize) / kBlobfsBlockSize;
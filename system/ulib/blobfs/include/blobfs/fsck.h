@@ -25,6 +25,16 @@ public:
 
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(BlobfsChecker);
+
+    // Verifies the blob stored in inode |n|, logging if it is bad.
+    static bool VerifyNode(Blobfs* blobfs, uint32_t n);
+#ifdef __Fuchsia__
+    static int VerifyThread(void* arg);
+#endif
+    // Verifies the |count| blobs stored in the inodes |nodes|, returning how
+    // many are bad.
+    uint32_t VerifyNodes(const uint32_t* nodes, size_t count);
+
     fbl::unique_ptr<Blobfs> blobfs_;
     uint32_t alloc_inodes_;
     uint32_t alloc_blocks_;
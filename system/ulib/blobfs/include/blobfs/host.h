@@ -214,6 +214,13 @@ zx_status_t blobfs_create(fbl::unique_ptr<Blobfs>* out, fbl::unique_fd blockfd);
 // the compressed length and data are returned.
 zx_status_t blobfs_preprocess(int data_fd, bool compress, MerkleInfo* out_info);
 
+// The two halves of blobfs_preprocess, so that duplicate blobs can be found
+// by their merkle roots before any time is spent compressing them.
+// blobfs_compress compresses the blob, whose merkle tree is already in
+// |info|, if doing so saves space.
+zx_status_t blobfs_create_merkle(int data_fd, MerkleInfo* out_info);
+zx_status_t blobfs_compress(int data_fd, MerkleInfo* info);
+
 // blobfs_add_blob may be called by multiple threads to gain concurrent
 // merkle tree generation. No other methods are thread safe.
 zx_status_t blobfs_add_blob(Blobfs* bs, int data_fd);
@@ -5,13 +5,31 @@
 #pragma once
 
 #include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
 #include <lz4/lz4frame.h>
 #include <zircon/types.h>
 
+#include <blobfs/format.h>
+
 namespace blobfs {
 
+// How hard a Compressor works at shrinking a blob. Every level produces the
+// same LZ4 bitstream, which decompresses at the same speed, so the level a
+// blob was written with needs no record on disk.
+enum class CompressionLevel {
+    // Fast compression, suited to blobs written on the device.
+    kFast,
+    // LZ4 HC: several times slower to compress, for a better ratio. Suited to
+    // images built ahead of time.
+    kHigh,
+};
+
 // A Compressor is used to compress a blob transparently before it is written
 // back to disk.
+//
+// The blob is compressed in the chunked format of |kBlobFlagChunkCompressed|:
+// the chunk table comes first, and the data is streamed into one LZ4 frame
+// per chunk.
 class Compressor {
 public:
     Compressor();
@@ -30,11 +48,13 @@ public:
     size_t Size() const;
 
     // Initializes the compression object with a provided
-    // buffer of a specified size.
+    // buffer of a specified size, to compress a blob of |blob_size| bytes
+    // at |level|.
     //
     // Although Compressor uses this buffer, it does not own the buffer,
     // assuming that a parent object is responsible for the lifetime.
-    zx_status_t Initialize(void* buf, size_t buf_max);
+    zx_status_t Initialize(void* buf, size_t buf_max, size_t blob_size,
+                           CompressionLevel level = CompressionLevel::kFast);
 
     // Returns the maximum possible size a buffer would need to be
     // in order to compress a blob of size |blob_size|.
@@ -42,7 +62,8 @@ public:
     // Typically used in conjunction with |Initialize()|.
     size_t BufferMax(size_t blob_size) const;
 
-    // Continues the compression after initialization.
+    // Continues the compression after initialization. No more than the
+    // |blob_size| given to |Initialize()| may be compressed in total.
     zx_status_t Update(const void* data, size_t length);
 
     // Finishes the compression process. Must be called
@@ -52,6 +73,17 @@ public:
 private:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Compressor);
 
+    // Starts the frame of the chunk which begins at |compressed_|.
+    zx_status_t BeginChunk();
+
+    // Completes the frame of the current chunk.
+    zx_status_t EndChunk();
+
+    uint64_t* Offsets() const {
+        return reinterpret_cast<uint64_t*>(reinterpret_cast<uintptr_t>(buf_) +
+                                           sizeof(ChunkTable));
+    }
+
     void* Buffer() const {
         return reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(buf_) + buf_used_);
     }
@@ -59,9 +91,14 @@ private:
     size_t buf_remaining() const { return buf_max_ - buf_used_; }
 
     LZ4F_compressionContext_t ctx_;
+    LZ4F_preferences_t prefs_;
     void* buf_;
     size_t buf_max_;
     size_t buf_used_;
+    size_t blob_size_;
+    // The number of bytes of the blob compressed so far.
+    size_t compressed_;
+    bool in_chunk_;
 };
 
 // A Decompressor is used to decompress a blob transparently before it is
@@ -75,4 +112,50 @@ public:
                                   const void* src_buf, size_t* src_size);
 };
 
+// A ChunkedDecompressor holds the chunk table of a blob stored with
+// |kBlobFlagChunkCompressed|, and decompresses its chunks one at a time.
+class ChunkedDecompressor {
+public:
+    ChunkedDecompressor() = default;
+
+    // Validates and copies the table at the start of |table|, which holds the
+    // first |table_size| bytes of the compressed storage of a blob of
+    // |blob_size| bytes. The compressed blob must fit in |compressed_size|
+    // bytes.
+    //
+    // If |table_size| is too short to hold the whole table, ZX_ERR_BUFFER_TOO_SMALL
+    // is returned, and |*table_size| is set to the size the table needs.
+    zx_status_t Initialize(const void* table, size_t* table_size, uint64_t blob_size,
+                           uint64_t compressed_size);
+
+    uint32_t ChunkCount() const { return chunk_count_; }
+
+    // The range of the uncompressed blob held by |chunk|.
+    uint64_t ChunkStart(uint32_t chunk) const {
+        return static_cast<uint64_t>(chunk) * kCompressionChunkSize;
+    }
+    uint64_t ChunkLength(uint32_t chunk) const;
+
+    // The range of the compressed storage of |chunk|, relative to the start
+    // of the table.
+    uint64_t CompressedStart(uint32_t chunk) const { return offsets_[chunk]; }
+    uint64_t CompressedLength(uint32_t chunk) const {
+        return offsets_[chunk + 1] - offsets_[chunk];
+    }
+
+    // Decompresses |chunk| from the CompressedLength(chunk) bytes at |src|
+    // into |target|, which holds ChunkLength(chunk) bytes.
+    zx_status_t DecompressChunk(uint32_t chunk, const void* src, void* target) const;
+
+    // The largest CompressedLength() of any valid chunk.
+    static size_t MaxCompressedChunk();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ChunkedDecompressor);
+
+    uint64_t blob_size_ = 0;
+    uint32_t chunk_count_ = 0;
+    fbl::unique_ptr<uint64_t[]> offsets_;
+};
+
 } // namespace blobfs
@@ -21,6 +21,7 @@
 #include <fs/block-txn.h>
 #include <fs/queue.h>
 #include <fs/vfs.h>
+#include <fs/writeback.h>
 
 #include <lib/sync/completion.h>
 
@@ -35,12 +36,7 @@ namespace blobfs {
 class Blobfs;
 class VnodeBlob;
 
-struct WriteRequest {
-    zx_handle_t vmo;
-    size_t vmo_offset;
-    size_t dev_offset;
-    size_t length;
-};
+using WriteRequest = fs::WriteRequest;
 
 enum class WritebackState {
     kInit,     // Initial state of a writeback queue.
@@ -55,7 +51,7 @@ class WriteTxn {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(WriteTxn);
 
-    explicit WriteTxn(Blobfs* bs) : bs_(bs), vmoid_(VMOID_INVALID), block_count_(0) {}
+    explicit WriteTxn(Blobfs*) : vmoid_(VMOID_INVALID), block_count_(0) {}
 
     virtual ~WriteTxn();
 
@@ -79,6 +75,11 @@ public:
         return vmoid_ != VMOID_INVALID;
     }
 
+    // Returns the buffer the WriteTxn has been copied to, if any.
+    vmoid_t BufferId() const {
+        return vmoid_;
+    }
+
     // Sets the source buffer for the WriteTxn to |vmoid|.
     void SetBuffer(vmoid_t vmoid);
 
@@ -91,14 +92,10 @@ public:
     void Reset() {
         requests_.reset();
         vmoid_ = VMOID_INVALID;
+        block_count_ = 0;
     }
 
-protected:
-    // Activates the transaction.
-    zx_status_t Flush();
-
 private:
-    Blobfs* bs_;
     vmoid_t vmoid_;
     fbl::Vector<WriteRequest> requests_;
     size_t block_count_;
@@ -147,9 +144,17 @@ public:
     // Tells work to remove sync flag once the txn has successfully completed.
     void SetSyncComplete();
 
-    // Persists the enqueued work to disk,
-    // and resets the WritebackWork to its initial state.
-    zx_status_t Complete();
+    // Marks the work as holding nothing but blob data, which no other work
+    // depends on being written first. Such works may be written alongside
+    // each other, rather than strictly in the order they were enqueued.
+    void SetDataOnly() { data_only_ = true; }
+
+    bool IsDataOnly() const { return data_only_; }
+
+    // Called by the writeback queue once the enqueued work has been written out
+    // with |status|. Signals completion, and resets the WritebackWork to its
+    // initial state.
+    void Complete(zx_status_t status);
 
 private:
     // If a sync callback exists, call it with |status|.
@@ -163,6 +168,7 @@ private:
     SyncCallback sync_cb_; // Call after work has been completely flushed.
 
     bool sync_;
+    bool data_only_ = false;
     fbl::RefPtr<VnodeBlob> vn_;
 };
 
@@ -199,9 +205,10 @@ public:
     // starting at block |disk_start| on disk.
     void AddTransaction(size_t start, size_t disk_start, size_t length, WritebackWork* work);
 
-    // Returns true if |txn| belongs to this buffer, and if so verifies
-    // that it owns the next valid set of blocks within the buffer.
-    bool VerifyTransaction(WriteTxn* txn) const;
+    // Returns true if |txn| belongs to this buffer, and if so verifies that it
+    // owns the next valid set of blocks within the buffer, after the first
+    // |pending| blocks which other transactions already own.
+    bool VerifyTransaction(WriteTxn* txn, size_t pending) const;
 
     // Given a transaction |txn|, verifies that all requests belong to this buffer
     // and then sets the transaction's buffer accordingly (if it is not already set).
@@ -270,13 +277,19 @@ private:
     struct Waiter : public fbl::SinglyLinkedListable<Waiter*> {};
     using ProducerQueue = fs::Queue<Waiter*>;
     using WorkQueue = fs::Queue<fbl::unique_ptr<WritebackWork>>;
+    using WorkBatch = fbl::Vector<fbl::unique_ptr<WritebackWork>>;
 
-    WritebackQueue(fbl::unique_ptr<Buffer> buffer) : buffer_(fbl::move(buffer)) {}
+    WritebackQueue(Blobfs* bs, fbl::unique_ptr<Buffer> buffer)
+        : bs_(bs), buffer_(fbl::move(buffer)) {}
 
     // Blocks until |blocks| blocks of data are free for the caller.
     // Doesn't actually allocate any space.
     void EnsureSpaceLocked(size_t blocks) __TA_REQUIRES(lock_);
 
+    // Writes out every work in |batch| as a single transaction, and completes
+    // them. Returns the status of the transaction.
+    zx_status_t CompleteBatch(WorkBatch* batch) __TA_EXCLUDES(lock_);
+
     // Thread which asynchronously processes transactions.
     static int WritebackThread(void* arg);
 
@@ -293,6 +306,8 @@ private:
     // Use to lock resources that may be accessed asynchronously.
     fbl::Mutex lock_;
 
+    Blobfs* bs_;
+
     // Buffer which stores transactions to be written out to disk.
     fbl::unique_ptr<Buffer> buffer_;
 
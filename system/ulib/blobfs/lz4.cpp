@@ -2,11 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <inttypes.h>
 #include <lz4/lz4frame.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
@@ -19,6 +22,16 @@ namespace blobfs {
 
 constexpr size_t kLz4HeaderSize = 15;
 
+// Each chunk fits in a single LZ4 block, and integrity is left to the merkle
+// tree.
+constexpr LZ4F_preferences_t kChunkPreferences = {
+    {LZ4F_max64KB, LZ4F_blockIndependent, LZ4F_noContentChecksum, LZ4F_frame, 0, {0, 0}},
+    0, 0, {0, 0, 0, 0},
+};
+
+// The level lz4hc.h recommends for LZ4 HC.
+constexpr int kHighCompressionLevel = 9;
+
 Compressor::Compressor() : buf_(nullptr) {}
 
 Compressor::~Compressor() {
@@ -32,44 +45,101 @@ void Compressor::Reset() {
     buf_ = nullptr;
 }
 
-zx_status_t Compressor::Initialize(void* buf, size_t buf_max) {
+zx_status_t Compressor::Initialize(void* buf, size_t buf_max, size_t blob_size,
+                                  CompressionLevel level) {
     ZX_DEBUG_ASSERT(!Compressing());
+    const uint64_t chunk_count = ChunkCount(blob_size);
+    const size_t table_size = ChunkTableSize(chunk_count);
+    if (chunk_count > UINT32_MAX) {
+        return ZX_ERR_OUT_OF_RANGE;
+    } else if (buf_max < table_size) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
     LZ4F_errorCode_t errc = LZ4F_createCompressionContext(&ctx_, LZ4F_VERSION);
     if (LZ4F_isError(errc)) {
         return ZX_ERR_NO_MEMORY;
     }
 
+    prefs_ = kChunkPreferences;
+    if (level == CompressionLevel::kHigh) {
+        prefs_.compressionLevel = kHighCompressionLevel;
+    }
     buf_ = buf;
     buf_max_ = buf_max;
-    buf_used_ = 0;
+    blob_size_ = blob_size;
+    compressed_ = 0;
+    in_chunk_ = false;
 
-    size_t r = LZ4F_compressBegin(ctx_, Buffer(), buf_remaining(), nullptr);
-    if (LZ4F_isError(r)) {
-        return ZX_ERR_BUFFER_TOO_SMALL;
-    }
-    buf_used_ += r;
+    ChunkTable* table = reinterpret_cast<ChunkTable*>(buf_);
+    table->magic = kChunkTableMagic;
+    table->chunk_size = kCompressionChunkSize;
+    table->chunk_count = static_cast<uint32_t>(chunk_count);
+    buf_used_ = table_size;
     return ZX_OK;
 }
 
 size_t Compressor::BufferMax(size_t blob_size) const {
-    return kLz4HeaderSize + LZ4F_compressBound(blob_size, nullptr);
+    const uint64_t chunk_count = ChunkCount(blob_size);
+    return ChunkTableSize(chunk_count) + chunk_count * ChunkedDecompressor::MaxCompressedChunk();
 }
 
 zx_status_t Compressor::Update(const void* data, size_t length) {
-    size_t r = LZ4F_compressUpdate(ctx_, Buffer(), buf_remaining(), data, length, nullptr);
+    if (length > blob_size_ - compressed_) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        zx_status_t status;
+        if (!in_chunk_ && (status = BeginChunk()) != ZX_OK) {
+            return status;
+        }
+        size_t chunk_remaining = kCompressionChunkSize - compressed_ % kCompressionChunkSize;
+        size_t n = fbl::min(length, chunk_remaining);
+        size_t r = LZ4F_compressUpdate(ctx_, Buffer(), buf_remaining(), src, n, nullptr);
+        if (LZ4F_isError(r)) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        buf_used_ += r;
+        compressed_ += n;
+        src += n;
+        length -= n;
+
+        if (n == chunk_remaining || compressed_ == blob_size_) {
+            if ((status = EndChunk()) != ZX_OK) {
+                return status;
+            }
+        }
+    }
+    return ZX_OK;
+}
+
+zx_status_t Compressor::End() {
+    if (compressed_ != blob_size_) {
+        return ZX_ERR_BAD_STATE;
+    }
+    Offsets()[ChunkCount(blob_size_)] = buf_used_;
+    return ZX_OK;
+}
+
+zx_status_t Compressor::BeginChunk() {
+    Offsets()[compressed_ / kCompressionChunkSize] = buf_used_;
+    size_t r = LZ4F_compressBegin(ctx_, Buffer(), buf_remaining(), &prefs_);
     if (LZ4F_isError(r)) {
-        return ZX_ERR_IO_DATA_INTEGRITY;
+        return ZX_ERR_BUFFER_TOO_SMALL;
     }
     buf_used_ += r;
+    in_chunk_ = true;
     return ZX_OK;
 }
 
-zx_status_t Compressor::End() {
+zx_status_t Compressor::EndChunk() {
     size_t r = LZ4F_compressEnd(ctx_, Buffer(), buf_remaining(), nullptr);
     if (LZ4F_isError(r)) {
         return ZX_ERR_IO_DATA_INTEGRITY;
     }
     buf_used_ += r;
+    in_chunk_ = false;
     return ZX_OK;
 }
 
@@ -119,9 +189,12 @@ zx_status_t Decompressor::Decompress(void* target_buf_, size_t* target_size,
             break;
         }
 
+        // Never read past the end of the source.
+        if (src_drained == *src_size) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
         dst_sz_next = *target_size - target_drained;
-        src_sz_next = r;
-
+        src_sz_next = fbl::min(r, *src_size - src_drained);
     }
 
     *target_size = target_drained;
@@ -129,4 +202,78 @@ zx_status_t Decompressor::Decompress(void* target_buf_, size_t* target_size,
     return ZX_OK;
 }
 
+zx_status_t ChunkedDecompressor::Initialize(const void* table, size_t* table_size,
+                                            uint64_t blob_size, uint64_t compressed_size) {
+    if (*table_size < sizeof(ChunkTable)) {
+        *table_size = sizeof(ChunkTable);
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    const ChunkTable* header = static_cast<const ChunkTable*>(table);
+    if (header->magic != kChunkTableMagic || header->chunk_size != kCompressionChunkSize ||
+        header->chunk_count != blobfs::ChunkCount(blob_size)) {
+        FS_TRACE_ERROR("blobfs: Invalid chunk table\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const uint32_t chunk_count = header->chunk_count;
+    const size_t needed = ChunkTableSize(chunk_count);
+    if (needed > compressed_size) {
+        FS_TRACE_ERROR("blobfs: Chunk table does not fit in the blob\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    } else if (*table_size < needed) {
+        *table_size = needed;
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint64_t[]> offsets(new (&ac) uint64_t[chunk_count + 1]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    memcpy(offsets.get(), static_cast<const uint8_t*>(table) + sizeof(ChunkTable),
+           (chunk_count + 1) * sizeof(uint64_t));
+
+    // Chunks must follow the table and each other, without outgrowing the blob.
+    if (offsets[0] < needed || offsets[chunk_count] > compressed_size) {
+        FS_TRACE_ERROR("blobfs: Chunk table is out of range\n");
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    for (uint32_t i = 0; i < chunk_count; i++) {
+        if (offsets[i + 1] <= offsets[i] || offsets[i + 1] - offsets[i] > MaxCompressedChunk()) {
+            FS_TRACE_ERROR("blobfs: Chunk %u has an invalid length\n", i);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+
+    blob_size_ = blob_size;
+    chunk_count_ = chunk_count;
+    offsets_ = fbl::move(offsets);
+    *table_size = needed;
+    return ZX_OK;
+}
+
+uint64_t ChunkedDecompressor::ChunkLength(uint32_t chunk) const {
+    ZX_DEBUG_ASSERT(chunk < chunk_count_);
+    return fbl::min(blob_size_ - ChunkStart(chunk), static_cast<uint64_t>(kCompressionChunkSize));
+}
+
+zx_status_t ChunkedDecompressor::DecompressChunk(uint32_t chunk, const void* src,
+                                                 void* target) const {
+    ZX_DEBUG_ASSERT(chunk < chunk_count_);
+    size_t target_size = ChunkLength(chunk);
+    size_t src_size = CompressedLength(chunk);
+    zx_status_t status = Decompressor::Decompress(target, &target_size, src, &src_size);
+    if (status != ZX_OK) {
+        return status;
+    } else if (target_size != ChunkLength(chunk) || src_size != CompressedLength(chunk)) {
+        FS_TRACE_ERROR("blobfs: Chunk %u decompressed to %zu of %" PRIu64 " bytes\n", chunk,
+                       target_size, ChunkLength(chunk));
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    return ZX_OK;
+}
+
+size_t ChunkedDecompressor::MaxCompressedChunk() {
+    return kLz4HeaderSize + LZ4F_compressBound(kCompressionChunkSize, &kChunkPreferences);
+}
+
 } // namespace blobfs
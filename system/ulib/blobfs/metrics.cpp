@@ -17,6 +17,16 @@ size_t TicksToMs(const zx::ticks& ticks) {
     return fzl::TicksToNs(ticks) / zx::msec(1);
 }
 
+// Returns the rate, in MB/s, of handling |bytes| in |ticks|.
+size_t Throughput(uint64_t bytes, const zx::ticks& ticks) {
+    const zx::duration duration = fzl::TicksToNs(ticks);
+    if (duration <= zx::duration(0)) {
+        return 0;
+    }
+    return static_cast<size_t>(static_cast<double>(bytes) * zx::sec(1).get() /
+                               duration.get() / (1 << 20));
+}
+
 } // namespace
 
 void BlobfsMetrics::Dump() const {
@@ -45,6 +55,12 @@ void BlobfsMetrics::Dump() const {
            TicksToMs(total_read_from_disk_time_ticks),
            bytes_read_from_disk / mb,
            TicksToMs(total_verification_time_ticks));
+    printf("  Spent %zu ms reading %zu MB of compressed data from disk\n",
+           TicksToMs(total_read_compressed_time_ticks),
+           bytes_compressed_read_from_disk / mb);
+    printf("  Spent %zu ms decompressing %zu MB (%zu MB/s)\n",
+           TicksToMs(total_decompress_time_ticks), bytes_decompressed_from_disk / mb,
+           Throughput(bytes_decompressed_from_disk, total_decompress_time_ticks));
 }
 
 } // namespace blobfs
@@ -46,6 +46,7 @@ void VnodeBlob::TearDown() {
         blobfs_->DetachVmo(vmoid_);
     }
     mapping_.Reset();
+    chunk_info_.reset();
 }
 
 VnodeBlob::~VnodeBlob() {
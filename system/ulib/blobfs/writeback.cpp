@@ -16,34 +16,8 @@ void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t relative_block, uint64_t absolu
     ZX_DEBUG_ASSERT(vmo != ZX_HANDLE_INVALID);
     ZX_DEBUG_ASSERT(!IsBuffered());
 
-    for (auto& request : requests_) {
-        if (request.vmo != vmo) {
-            continue;
-        }
-
-        if (request.vmo_offset == relative_block) {
-            // Take the longer of the operations (if operating on the same blocks).
-            if (nblocks > request.length) {
-                block_count_ += (nblocks - request.length);
-                request.length = nblocks;
-            }
-            return;
-        } else if ((request.vmo_offset + request.length == relative_block) &&
-                   (request.dev_offset + request.length == absolute_block)) {
-            // Combine with the previous request, if immediately following.
-            request.length += nblocks;
-            block_count_ += nblocks;
-            return;
-        }
-    }
-
-    WriteRequest request;
-    request.vmo = vmo;
-    request.vmo_offset = relative_block;
-    request.dev_offset = absolute_block;
-    request.length = nblocks;
-    requests_.push_back(fbl::move(request));
-    block_count_ += request.length;
+    block_count_ += fs::EnqueueWriteRequest(&requests_, vmo, relative_block, absolute_block,
+                                            nblocks);
 }
 
 size_t WriteTxn::BlkStart() const {
@@ -62,43 +36,6 @@ void WriteTxn::SetBuffer(vmoid_t vmoid) {
     vmoid_ = vmoid;
 }
 
-zx_status_t WriteTxn::Flush() {
-    ZX_ASSERT(IsBuffered());
-    fs::Ticker ticker(bs_->CollectingMetrics());
-
-    // Update all the outgoing transactions to be in disk blocks
-    block_fifo_request_t blk_reqs[requests_.size()];
-    const uint32_t kDiskBlocksPerBlobfsBlock = kBlobfsBlockSize / bs_->DeviceBlockSize();
-    for (size_t i = 0; i < requests_.size(); i++) {
-        blk_reqs[i].group = bs_->BlockGroupID();
-        blk_reqs[i].vmoid = vmoid_;
-        blk_reqs[i].opcode = BLOCKIO_WRITE;
-        blk_reqs[i].vmo_offset = requests_[i].vmo_offset * kDiskBlocksPerBlobfsBlock;
-        blk_reqs[i].dev_offset = requests_[i].dev_offset * kDiskBlocksPerBlobfsBlock;
-        uint64_t length = requests_[i].length * kDiskBlocksPerBlobfsBlock;
-        // TODO(ZX-2253): Requests this long, although unlikely, should be
-        // handled more gracefully.
-        ZX_ASSERT_MSG(length < UINT32_MAX, "Request size too large");
-        blk_reqs[i].length = static_cast<uint32_t>(length);
-    }
-
-    // Actually send the operations to the underlying block device.
-    zx_status_t status = bs_->Transaction(blk_reqs, requests_.size());
-
-    if (bs_->CollectingMetrics()) {
-        uint64_t sum = 0;
-        for (const auto& blk_req : blk_reqs) {
-            sum += blk_req.length * kBlobfsBlockSize;
-        }
-        bs_->UpdateWritebackMetrics(sum, ticker.End());
-    }
-
-    requests_.reset();
-    vmoid_ = VMOID_INVALID;
-    block_count_ = 0;
-    return status;
-}
-
 void WritebackWork::Reset(zx_status_t reason) {
     WriteTxn::Reset();
     InvokeSyncCallback(reason);
@@ -133,9 +70,8 @@ void WritebackWork::SetSyncComplete() {
     sync_ = true;
 }
 
-// Returns the number of blocks of the writeback buffer that have been consumed
-zx_status_t WritebackWork::Complete() {
-    zx_status_t status = Flush();
+void WritebackWork::Complete(zx_status_t status) {
+    WriteTxn::Reset();
 
     if (status == ZX_OK && sync_) {
         vn_->CompleteSync();
@@ -143,7 +79,6 @@ zx_status_t WritebackWork::Complete() {
 
     InvokeSyncCallback(status);
     ResetInternal();
-    return status;
 }
 
 WritebackWork::WritebackWork(Blobfs* bs, fbl::RefPtr<VnodeBlob> vn) :
@@ -158,6 +93,7 @@ void WritebackWork::InvokeSyncCallback(zx_status_t status) {
 void WritebackWork::ResetInternal() {
     sync_cb_ = nullptr;
     ready_cb_ = nullptr;
+    data_only_ = false;
     vn_ = nullptr;
 }
 
@@ -293,13 +229,13 @@ void Buffer::AddTransaction(size_t start, size_t disk_start, size_t length, Writ
     work->Enqueue(mapper_.vmo().get(), start, disk_start, length);
 }
 
-bool Buffer::VerifyTransaction(WriteTxn* txn) const {
+bool Buffer::VerifyTransaction(WriteTxn* txn, size_t pending) const {
     if (txn->CheckBuffer(vmoid_)) {
         if (txn->BlkCount() > 0) {
             // If the work belongs to the WritebackQueue, verify that it matches up with the
             // buffer's start/len.
-            ZX_ASSERT(txn->BlkStart() == start_);
-            ZX_ASSERT(txn->BlkCount() <= length_);
+            ZX_ASSERT(txn->BlkStart() == (start_ + pending) % capacity_);
+            ZX_ASSERT(pending + txn->BlkCount() <= length_);
         }
 
         return true;
@@ -361,7 +297,7 @@ zx_status_t WritebackQueue::Create(Blobfs* blobfs, const size_t buffer_blocks,
         return status;
     }
 
-    fbl::unique_ptr<WritebackQueue> wb(new WritebackQueue(fbl::move(buffer)));
+    fbl::unique_ptr<WritebackQueue> wb(new WritebackQueue(blobfs, fbl::move(buffer)));
 
     if (cnd_init(&wb->work_completed_) != thrd_success) {
         return ZX_ERR_NO_RESOURCES;
@@ -425,36 +361,70 @@ void WritebackQueue::EnsureSpaceLocked(size_t blocks) {
     }
 }
 
+zx_status_t WritebackQueue::CompleteBatch(WorkBatch* batch) {
+    TRACE_DURATION("blobfs", "WritebackQueue::CompleteBatch", "works", batch->size());
+    fs::Ticker ticker(bs_->CollectingMetrics());
+
+    // Consecutive data works may be written in any order relative to each other. Anything else
+    // is ordered after the works before it, and before the works after it.
+    fs::WriteBatch writes(bs_);
+    uint64_t blocks = 0;
+    for (size_t i = 0; i < batch->size(); i++) {
+        WritebackWork* work = (*batch)[i].get();
+        ZX_DEBUG_ASSERT(work->IsBuffered());
+        auto& reqs = work->Requests();
+        writes.Add(work->BufferId(), reqs.get(), reqs.size(), !work->IsDataOnly());
+        blocks += work->BlkCount();
+    }
+    zx_status_t status = writes.Transact();
+
+    if (bs_->CollectingMetrics()) {
+        bs_->UpdateWritebackMetrics(blocks * kBlobfsBlockSize, ticker.End());
+    }
+
+    for (size_t i = 0; i < batch->size(); i++) {
+        (*batch)[i]->Complete(status);
+    }
+    batch->reset();
+    return status;
+}
+
 int WritebackQueue::WritebackThread(void* arg) {
     WritebackQueue* b = reinterpret_cast<WritebackQueue*>(arg);
+    WorkBatch batch;
 
     b->lock_.Acquire();
     while (true) {
         bool error = b->IsReadOnly();
         while (!b->work_queue_.is_empty()) {
-            if (!error && !b->work_queue_.front().IsReady()) {
+            // Every work which is ready goes out together. The works which belong to our
+            // buffer follow each other within it.
+            size_t our_blocks = 0;
+            while (!b->work_queue_.is_empty() && (error || b->work_queue_.front().IsReady())) {
+                auto work = b->work_queue_.pop();
+                if (b->buffer_->VerifyTransaction(work.get(), our_blocks)) {
+                    our_blocks += work->BlkCount();
+                }
+                batch.push_back(fbl::move(work));
+            }
+            if (batch.is_empty()) {
                 // If the work is not yet ready, break and wait until we receive another signal.
                 break;
             }
+            TRACE_DURATION("blobfs", "WritebackQueue::WritebackThread", "works", batch.size());
 
-            auto work = b->work_queue_.pop();
-            TRACE_DURATION("blobfs", "WritebackQueue::WritebackThread", "work ptr", work.get());
-
-            bool our_buffer = b->buffer_->VerifyTransaction(work.get());
-            size_t blk_count = work->BlkCount();
-
-            // Stay unlocked while processing a unit of work.
+            // Stay unlocked while processing the batch.
             b->lock_.Release();
 
             if (error) {
-                // If we are in a read only state, reset the work without completing it.
-                work->Reset(ZX_ERR_BAD_STATE);
+                // If we are in a read only state, reset the works without completing them.
+                for (size_t i = 0; i < batch.size(); i++) {
+                    batch[i]->Reset(ZX_ERR_BAD_STATE);
+                }
+                batch.reset();
             } else {
-                // If we should complete the work, make sure it has been buffered.
-                // (This is not necessary if we are currently in an error state).
-                ZX_DEBUG_ASSERT(work->IsBuffered());
                 zx_status_t status;
-                if ((status = work->Complete()) != ZX_OK) {
+                if ((status = b->CompleteBatch(&batch)) != ZX_OK) {
                     fprintf(stderr, "Work failed with status %d - "
                                     "converting writeback to read only state.\n", status);
                     // If work completion failed, set the buffer to an error state.
@@ -462,7 +432,6 @@ int WritebackQueue::WritebackThread(void* arg) {
                 }
             }
 
-            work = nullptr;
             b->lock_.Acquire();
 
             if (error) {
@@ -470,11 +439,8 @@ int WritebackQueue::WritebackThread(void* arg) {
                 b->state_ = WritebackState::kReadOnly;
             }
 
-            if (our_buffer) {
-                // If the last work we processed belonged to our buffer,
-                // update the buffer's start/len accordingly.
-                b->buffer_->FreeSpace(blk_count);
-            }
+            // Release the space of the works which belonged to our buffer.
+            b->buffer_->FreeSpace(our_blocks);
 
             // We may have opened up space (or entered a read only state),
             // so signal the producer queue.
@@ -3,12 +3,14 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <unistd.h>
 
 #include <block-client/client.h>
 #include <zircon/compiler.h>
 #include <zircon/device/block.h>
 #include <zircon/syscalls.h>
+#include <zircon/time.h>
 #include <lib/sync/completion.h>
 
 // Writes on a FIFO, repeating the write later if the FIFO is full.
@@ -39,11 +41,17 @@ static zx_status_t do_write(zx_handle_t fifo, block_fifo_request_t* request, siz
     }
 }
 
-static zx_status_t do_read(zx_handle_t fifo, block_fifo_response_t* response) {
+// Reads a response from a FIFO, repeating the read until |spin_deadline|
+// before waiting for one to arrive.
+static zx_status_t do_read(zx_handle_t fifo, zx_time_t spin_deadline,
+                           block_fifo_response_t* response) {
     zx_status_t status;
     while (true) {
         status = zx_fifo_read(fifo, sizeof(*response), response, 1, NULL);
         if (status == ZX_ERR_SHOULD_WAIT) {
+            if (zx_clock_get_monotonic() < spin_deadline) {
+                continue;
+            }
             zx_signals_t signals;
             if ((status = zx_object_wait_one(fifo,
                                              ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED,
@@ -66,6 +74,10 @@ typedef struct block_completion {
 
 typedef struct fifo_client {
     zx_handle_t fifo;
+    // The longest a transaction spins on the fifo, or zero if it never does.
+    atomic_int_fast64_t max_spin;
+    // A moving average of how long responses take to arrive.
+    atomic_int_fast64_t latency;
     block_sync_completion_t groups[MAX_TXN_GROUP_COUNT];
 } fifo_client_t;
 
@@ -76,10 +88,17 @@ zx_status_t block_fifo_create_client(zx_handle_t fifo, fifo_client_t** out) {
         return ZX_ERR_NO_MEMORY;
     }
     client->fifo = fifo;
+    atomic_init(&client->max_spin, 0);
+    atomic_init(&client->latency, 0);
     *out = client;
     return ZX_OK;
 }
 
+void block_fifo_set_polling(fifo_client_t* client, zx_duration_t max_spin) {
+    atomic_store(&client->latency, max_spin / 2);
+    atomic_store(&client->max_spin, max_spin);
+}
+
 void block_fifo_release_client(fifo_client_t* client) {
     if (client == NULL) {
         return;
@@ -102,7 +121,9 @@ zx_status_t block_fifo_txn(fifo_client_t* client, block_fifo_request_t* requests
     zx_status_t status;
     for (size_t i = 0; i < count; i++) {
         assert(requests[i].group == group);
-        requests[i].opcode = (requests[i].opcode & BLOCKIO_OP_MASK) | BLOCKIO_GROUP_ITEM;
+        requests[i].opcode = (requests[i].opcode & (BLOCKIO_OP_MASK | BLOCKIO_BARRIER_BEFORE |
+                                                    BLOCKIO_BARRIER_AFTER)) |
+                             BLOCKIO_GROUP_ITEM;
     }
 
     requests[0].opcode |= BLOCKIO_BARRIER_BEFORE;
@@ -112,12 +133,28 @@ zx_status_t block_fifo_txn(fifo_client_t* client, block_fifo_request_t* requests
         return status;
     }
 
+    // Responses which usually arrive within |max_spin| are worth spinning for,
+    // for up to twice as long as they usually take.
+    const zx_time_t start = zx_clock_get_monotonic();
+    const zx_duration_t max_spin = atomic_load_explicit(&client->max_spin, memory_order_relaxed);
+    const zx_duration_t latency = atomic_load_explicit(&client->latency, memory_order_relaxed);
+    zx_time_t spin_deadline = 0;
+    if (max_spin > 0 && latency <= max_spin) {
+        spin_deadline = zx_time_add_duration(start, 2 * latency < max_spin ? 2 * latency
+                                                                            : max_spin);
+    }
+
     // As expected by the protocol, when we send one "BLOCKIO_GROUP_LAST" message, we
     // must read a reply message.
     block_fifo_response_t response;
-    if ((status = do_read(client->fifo, &response)) != ZX_OK) {
+    if ((status = do_read(client->fifo, spin_deadline, &response)) != ZX_OK) {
         return status;
     }
+    if (max_spin > 0) {
+        const zx_duration_t sample = zx_clock_get_monotonic() - start;
+        atomic_store_explicit(&client->latency, latency + (sample - latency) / 8,
+                              memory_order_relaxed);
+    }
 
     // Wake up someone who is waiting (it might be ourselves)
     groupid_t response_group = response.group;
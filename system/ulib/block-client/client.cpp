@@ -38,6 +38,11 @@ zx_status_t Client::Create(zx::fifo fifo, Client* out) {
     return ZX_OK;
 }
 
+void Client::SetPolling(zx::duration max_spin) {
+    ZX_DEBUG_ASSERT(client_ != nullptr);
+    block_fifo_set_polling(client_, max_spin.get());
+}
+
 zx_status_t Client::Transaction(block_fifo_request_t* requests, size_t count) const {
     ZX_DEBUG_ASSERT(client_ != nullptr);
     return block_fifo_txn(client_, requests, count);
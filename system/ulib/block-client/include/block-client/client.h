@@ -24,6 +24,12 @@ zx_status_t block_fifo_create_client(zx_handle_t fifo, fifo_client_t** out);
 // Frees a block fifo client.
 void block_fifo_release_client(fifo_client_t* client);
 
+// Lets transactions spin on the fifo, rather than sleep, while waiting for
+// their response, if responses usually arrive within |max_spin|. This trades
+// CPU time for latency on fast devices. A |max_spin| of zero, the default,
+// disables spinning.
+void block_fifo_set_polling(fifo_client_t* client, zx_duration_t max_spin);
+
 // Sends 'count' block device requests and waits for a response.
 // The current implementation is thread-safe, but may only be called from a
 // single process, as it differentiates callers by stack addresses (in an
@@ -34,10 +40,15 @@ void block_fifo_release_client(fifo_client_t* client);
 // --------------------------------------   -----------------
 // group                                    All  (must be the same for all requests)
 // vmoid                                    All
-// opcode (BLOCKIO_OP_MASK bits only)       All
+// opcode (BLOCKIO_OP_MASK bits, and
+//         optionally barrier flags)        All
 // length                                   read, write
 // vmo_offset                               read, write
 // dev_offset                               read, write
+//
+// The transaction as a whole is always ordered after the operations sent
+// before it, and before those sent after it. Within it, requests run in any
+// order, unless barrier flags say otherwise.
 zx_status_t block_fifo_txn(fifo_client_t* client, block_fifo_request_t* requests, size_t count);
 
 __END_CDECLS
@@ -14,6 +14,7 @@
 #include <fbl/macros.h>
 #include <fbl/type_support.h>
 #include <lib/zx/fifo.h>
+#include <lib/zx/time.h>
 #include <zircon/types.h>
 
 namespace block_client {
@@ -41,6 +42,10 @@ public:
 
     // BLOCK CLIENT OPERATIONS.
 
+    // Lets transactions spin on the fifo while waiting for their response.
+    // See block_fifo_set_polling.
+    void SetPolling(zx::duration max_spin);
+
     // Issues a group of block requests over the underlying fifo,
     // and waits for a response.
     zx_status_t Transaction(block_fifo_request_t* requests, size_t count) const;
@@ -85,6 +85,12 @@ static zx_status_t check_lz4_frame(const lz4_frame_desc* fd,
     return ZX_OK;
 }
 
+// The whole image is decompressed up front.  The independent 64kB blocks would
+// let a pager fill pages on demand, but a pager-backed VMO needs a thread to
+// serve its page requests for as long as the VMO lives.  userboot is the first
+// caller; it is single threaded and exits once devmgr is running, while the
+// bootfs VMO it returns is handed on and outlives it.  There is no process left
+// to serve the pager at that point.
 static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
                                          size_t _outsize, zx_handle_t* out,
                                          const char** err) {
@@ -178,6 +184,39 @@ static zx_status_t decompress_bootfs_vmo(zx_handle_t vmar, const uint8_t* data,
     return ZX_OK;
 }
 
+// An uncompressed item needs no decompression.  When its payload starts on
+// a page boundary, it's handed out as a copy-on-write clone of the bootdata
+// VMO, so none of it is copied.  Otherwise, it's copied into a new VMO.
+static zx_status_t extract_uncompressed_vmo(zx_handle_t vmo, size_t offset,
+                                            const uint8_t* data,
+                                            size_t size, zx_handle_t* out,
+                                            const char** err) {
+    zx_handle_t dst_vmo;
+    zx_status_t status;
+    if ((offset & (PAGE_SIZE - 1)) == 0) {
+        status = zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, offset, size, &dst_vmo);
+        if (status < 0) {
+            *err = "zx_vmo_clone failed on bootfs vmo";
+            return status;
+        }
+    } else {
+        status = zx_vmo_create((uint64_t)size, 0, &dst_vmo);
+        if (status < 0) {
+            *err = "zx_vmo_create failed for extracting bootfs";
+            return status;
+        }
+        status = zx_vmo_write(dst_vmo, data, 0, size);
+        if (status < 0) {
+            zx_handle_close(dst_vmo);
+            *err = "zx_vmo_write failed on bootfs vmo during extraction";
+            return status;
+        }
+    }
+    zx_object_set_property(dst_vmo, ZX_PROP_NAME, "bootfs", 6);
+    *out = dst_vmo;
+    return ZX_OK;
+}
+
 zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
                                 size_t offset, size_t length,
                                 zx_handle_t* out, const char** err) {
@@ -208,6 +247,13 @@ zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
     case BOOTDATA_RAMDISK:
         if (hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED) {
             status = decompress_bootfs_vmo(vmar, (const uint8_t*)bootdata_addr, hdr->extra, out, err);
+        } else if (hdr->length > length - align_shift - sizeof(bootdata_t)) {
+            *err = "bootdata item length exceeds its container";
+            status = ZX_ERR_OUT_OF_RANGE;
+        } else {
+            status = extract_uncompressed_vmo(vmo, offset + sizeof(bootdata_t),
+                                              (const uint8_t*)bootdata_addr, hdr->length,
+                                              out, err);
         }
         break;
     default:
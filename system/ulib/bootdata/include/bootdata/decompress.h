@@ -11,7 +11,9 @@
 
 __BEGIN_CDECLS
 
-// Decompress bootdata at offset of total size length into a new VMO
+// Decompress bootdata at offset of total size length into a new VMO.
+// An uncompressed item whose payload is page aligned is instead returned
+// as a copy-on-write clone of vmo.
 // On failure, errmsg is a human readable error description to provide
 // more precise debug information.
 zx_status_t decompress_bootdata(zx_handle_t vmar, zx_handle_t vmo,
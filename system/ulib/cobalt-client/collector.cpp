@@ -87,12 +87,17 @@ Histogram Collector::AddHistogram(const HistogramOptions& options) {
     ZX_DEBUG_ASSERT_MSG(remote_histograms_.size() < remote_histograms_.capacity(),
                         "Exceeded pre-allocated histogram capacity.");
     RemoteHistogram::EventBuffer buffer;
-    // RemoteMetricInfo metric_info
-    remote_histograms_.push_back(RemoteHistogram(
-        options.bucket_count + 2, internal::RemoteMetricInfo::From(options), fbl::move(buffer)));
+    fbl::AllocChecker ac;
+    RemoteHistogram histogram(options.bucket_count + 2, internal::RemoteMetricInfo::From(options),
+                              fbl::move(buffer), &ac);
     histogram_options_.push_back(options);
-    size_t index = remote_histograms_.size() - 1;
-    return Histogram(&histogram_options_[index], &remote_histograms_[index]);
+    size_t index = histogram_options_.size() - 1;
+    if (!ac.check()) {
+        return Histogram(&histogram_options_[index], nullptr);
+    }
+    remote_histograms_.push_back(fbl::move(histogram));
+    RemoteHistogram* remote_histogram = &remote_histograms_[remote_histograms_.size() - 1];
+    return Histogram(&histogram_options_[index], remote_histogram);
 }
 
 Counter Collector::AddCounter(const MetricOptions& options) {
@@ -6,20 +6,59 @@
 
 #include <cobalt-client/cpp/counter-internal.h>
 #include <cobalt-client/cpp/counter.h>
+#include <fbl/atomic.h>
 #include <zircon/assert.h>
 
 namespace cobalt_client {
 namespace internal {
+namespace {
+
+// Next shard to hand out to a thread.
+fbl::atomic<uint32_t> next_shard(0);
+
+// Shard of the calling thread, or |kShardCount| if not yet assigned.
+thread_local uint32_t tls_shard = kShardCount;
+
+} // namespace
+
+uint32_t GetShard() {
+    if (unlikely(tls_shard == kShardCount)) {
+        tls_shard = next_shard.fetch_add(1, fbl::memory_order_relaxed) % kShardCount;
+    }
+    return tls_shard;
+}
 
 BaseCounter::BaseCounter(BaseCounter&& other) : counter_(other.Exchange(0)) {}
 
+ShardedCounter::ShardedCounter(ShardedCounter&& other) {
+    for (uint32_t shard = 0; shard < kShardCount; ++shard) {
+        shards_[shard].counter.Exchange(other.shards_[shard].counter.Exchange(0));
+    }
+}
+
+ShardedCounter::Type ShardedCounter::Exchange(Type val) {
+    Type sum = shards_[0].counter.Exchange(val);
+    for (uint32_t shard = 1; shard < kShardCount; ++shard) {
+        sum += shards_[shard].counter.Exchange(0);
+    }
+    return sum;
+}
+
+ShardedCounter::Type ShardedCounter::Load() const {
+    Type sum = 0;
+    for (uint32_t shard = 0; shard < kShardCount; ++shard) {
+        sum += shards_[shard].counter.Load();
+    }
+    return sum;
+}
+
 RemoteCounter::RemoteCounter(const RemoteMetricInfo& metric_info, EventBuffer buffer)
-    : BaseCounter(), buffer_(fbl::move(buffer)), metric_info_(metric_info) {
+    : ShardedCounter(), buffer_(fbl::move(buffer)), metric_info_(metric_info) {
     *buffer_.mutable_event_data() = 0;
 }
 
 RemoteCounter::RemoteCounter(RemoteCounter&& other)
-    : BaseCounter(fbl::move(other)), buffer_(fbl::move(other.buffer_)),
+    : ShardedCounter(fbl::move(other)), buffer_(fbl::move(other.buffer_)),
       metric_info_(other.metric_info_) {}
 
 bool RemoteCounter::Flush(const RemoteCounter::FlushFn& flush_handler) {
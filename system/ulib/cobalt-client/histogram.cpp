@@ -10,7 +10,10 @@
 
 #include <cobalt-client/cpp/histogram-internal.h>
 #include <cobalt-client/cpp/metric-options.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/limits.h>
+#include <fbl/new.h>
 #include <fuchsia/cobalt/c/fidl.h>
 
 namespace cobalt_client {
@@ -87,19 +90,57 @@ void LoadLinear(HistogramOptions* options) {
 
 } // namespace
 
-BaseHistogram::BaseHistogram(uint32_t num_buckets) {
-    buckets_.reserve(num_buckets);
-    for (uint32_t i = 0; i < num_buckets; ++i) {
-        buckets_.push_back(BaseCounter());
+BaseHistogram::BaseHistogram(uint32_t num_buckets, fbl::AllocChecker* ac)
+    : num_buckets_(num_buckets),
+      lines_per_row_(fbl::round_up(num_buckets, kCountersPerCacheLine) / kCountersPerCacheLine),
+      lines_(nullptr) {
+    size_t line_count = kShardCount * lines_per_row_;
+    void* lines = CacheLineAllocatorTraits::Allocate(line_count * sizeof(CounterLine));
+    ac->arm(line_count * sizeof(CounterLine), lines != nullptr);
+    if (lines == nullptr) {
+        num_buckets_ = 0;
+        lines_per_row_ = 0;
+        return;
+    }
+    lines_ = static_cast<CounterLine*>(lines);
+    for (size_t line = 0; line < line_count; ++line) {
+        new (&lines_[line]) CounterLine();
     }
 }
 
-BaseHistogram::BaseHistogram(BaseHistogram&& other) = default;
+BaseHistogram::BaseHistogram(BaseHistogram&& other)
+    : num_buckets_(other.num_buckets_), lines_per_row_(other.lines_per_row_),
+      lines_(other.lines_) {
+    other.num_buckets_ = 0;
+    other.lines_per_row_ = 0;
+    other.lines_ = nullptr;
+}
+
+BaseHistogram::~BaseHistogram() {
+    if (lines_ == nullptr) {
+        return;
+    }
+    for (size_t line = 0; line < kShardCount * lines_per_row_; ++line) {
+        lines_[line].~CounterLine();
+    }
+    CacheLineAllocatorTraits::Deallocate(lines_);
+}
 
 RemoteHistogram::RemoteHistogram(uint32_t num_buckets, const RemoteMetricInfo& metric_info,
-                                 RemoteHistogram::EventBuffer buffer)
-    : BaseHistogram(num_buckets), buffer_(fbl::move(buffer)), metric_info_(metric_info) {
-    bucket_buffer_.reserve(num_buckets);
+                                 RemoteHistogram::EventBuffer buffer, fbl::AllocChecker* ac)
+    : BaseHistogram(num_buckets, ac), buffer_(fbl::move(buffer)), metric_info_(metric_info) {
+    // |ac| was armed by |BaseHistogram|; fold the flush buffer into the same result.
+    bool allocated = ac->check();
+    if (allocated) {
+        fbl::AllocChecker buffer_ac;
+        bucket_buffer_.reserve(num_buckets, &buffer_ac);
+        allocated = buffer_ac.check();
+    }
+    ac->arm(num_buckets * sizeof(HistogramBucket), allocated);
+    if (!allocated) {
+        return;
+    }
+
     for (uint32_t i = 0; i < num_buckets; ++i) {
         HistogramBucket bucket;
         bucket.count = 0;
@@ -123,7 +164,7 @@ bool RemoteHistogram::Flush(const RemoteHistogram::FlushFn& flush_handler) {
     // Sets every bucket back to 0, not all buckets will be at the same instant, but
     // eventual consistency in the backend is good enough.
     for (uint32_t bucket_index = 0; bucket_index < bucket_buffer_.size(); ++bucket_index) {
-        bucket_buffer_[bucket_index].count = buckets_[bucket_index].Exchange();
+        bucket_buffer_[bucket_index].count = ExchangeCount(bucket_index);
     }
 
     flush_handler(metric_info_, buffer_, fbl::BindMember(&buffer_, &EventBuffer::CompleteFlush));
@@ -166,6 +207,9 @@ Histogram::~Histogram() = default;
 
 template <typename ValueType>
 void Histogram::Add(ValueType value, Histogram::Count times) {
+    if (remote_histogram_ == nullptr) {
+        return;
+    }
     double dbl_value = static_cast<double>(value);
     uint32_t bucket = options_->map_fn(dbl_value, *options_);
     remote_histogram_->IncrementCount(bucket, times);
@@ -173,6 +217,9 @@ void Histogram::Add(ValueType value, Histogram::Count times) {
 
 template <typename ValueType>
 Histogram::Count Histogram::GetRemoteCount(ValueType value) const {
+    if (remote_histogram_ == nullptr) {
+        return 0;
+    }
     double dbl_value = static_cast<double>(value);
     uint32_t bucket = options_->map_fn(dbl_value, *options_);
     return remote_histogram_->GetCount(bucket);
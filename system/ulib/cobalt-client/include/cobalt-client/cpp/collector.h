@@ -24,6 +24,7 @@ namespace internal {
 // Forward Declarations.
 class RemoteHistogram;
 class RemoteCounter;
+struct CacheLineAllocatorTraits;
 struct Metadata;
 class Logger;
 } // namespace internal
@@ -95,6 +96,7 @@ public:
     // Preconditions:
     //     |metric_id| must be greater than 0.
     //     |event_type_index| must be greater than 0.
+    // If the histogram's buckets cannot be allocated, the returned histogram drops every sample.
     Histogram AddHistogram(const HistogramOptions& histogram_options);
 
     // Returns a counter to log events for a given |metric_id|, |event_type_index| and |component|
@@ -115,7 +117,7 @@ private:
 
     fbl::Vector<HistogramOptions> histogram_options_;
     fbl::Vector<internal::RemoteHistogram> remote_histograms_;
-    fbl::Vector<internal::RemoteCounter> remote_counters_;
+    fbl::Vector<internal::RemoteCounter, internal::CacheLineAllocatorTraits> remote_counters_;
 
     fbl::unique_ptr<internal::Logger> logger_;
     fbl::atomic<bool> flushing_;
@@ -5,10 +5,12 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include <cobalt-client/cpp/metric-options.h>
 #include <cobalt-client/cpp/types-internal.h>
+#include <fbl/algorithm.h>
 #include <fbl/atomic.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
@@ -52,13 +54,76 @@ protected:
     fbl::atomic<Type> counter_;
 };
 
+// Metrics recorded from many threads spread their counts over |kShardCount| shards, so that
+// threads recording at once rarely write to the same cache line. Shards are summed when the
+// metric is read or flushed.
+constexpr uint32_t kShardCount = 8;
+
+// Size of a cache line on every architecture we run on. Shards are aligned to it.
+constexpr size_t kCacheLineSize = 64;
+
+// Number of |BaseCounter| that fit in a cache line.
+constexpr uint32_t kCountersPerCacheLine = kCacheLineSize / sizeof(BaseCounter);
+static_assert(kCacheLineSize % sizeof(BaseCounter) == 0, "BaseCounter must tile a cache line.");
+
+// Allocator for storage holding cache line aligned types, e.g. a |fbl::Vector| of
+// |RemoteCounter|. The default allocator only guarantees the alignment of |max_align_t|.
+struct CacheLineAllocatorTraits {
+    static void* Allocate(size_t size) {
+        return aligned_alloc(kCacheLineSize, fbl::round_up(size, kCacheLineSize));
+    }
+
+    static void Deallocate(void* object) { free(object); }
+};
+
+// Returns the shard the calling thread records into. Threads are assigned shards round robin
+// the first time they record.
+uint32_t GetShard();
+
+// Counter whose count is spread over |kShardCount| shards, each on its own cache line.
+// Provides the same API as |BaseCounter|, but |Increment| only touches the calling thread's
+// shard, while |Load| and |Exchange| visit all of them. Instances are cache line aligned, so
+// heap storage for them must come from |CacheLineAllocatorTraits|.
+//
+// This class is moveable but not copyable or assignable.
+// This class is thread-safe.
+class ShardedCounter {
+public:
+    using Type = BaseCounter::Type;
+
+    ShardedCounter() = default;
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter(ShardedCounter&&);
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(ShardedCounter&&) = delete;
+    ~ShardedCounter() = default;
+
+    // Increments the calling thread's shard by |val|.
+    void Increment(Type val = 1) { shards_[GetShard()].counter.Increment(val); }
+
+    // Returns the sum of all shards and resets the counter to |val|. Increments that race
+    // with this call are counted either in the returned value or in the next one.
+    Type Exchange(Type val = 0);
+
+    // Returns the sum of all shards.
+    Type Load() const;
+
+private:
+    struct alignas(kCacheLineSize) Shard {
+        BaseCounter counter;
+    };
+    static_assert(sizeof(Shard) == kCacheLineSize, "Each shard must own one cache line.");
+
+    Shard shards_[kShardCount];
+};
+
 // Counter which represents a standalone cobalt metric. Provides API for converting
 // to cobalt FIDL types.
 //
 // This class is moveable and move-assignable.
 // This class is not copy or copy-assignable.
 // This class is thread-safe.
-class RemoteCounter : public BaseCounter {
+class RemoteCounter : public ShardedCounter {
 public:
     // Callback to notify that Flush has been completed, and that the observation buffer is
     // writeable again(this is buffer where the counter and its metadata are flushed).
@@ -9,9 +9,11 @@
 
 #include <cobalt-client/cpp/counter-internal.h>
 #include <cobalt-client/cpp/types-internal.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/atomic.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
+#include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <lib/fidl/cpp/vector_view.h>
 
@@ -22,7 +24,12 @@ namespace internal {
 
 // Base class for histogram, that provides a thin layer over a collection of buckets
 // that represent a histogram. Once constructed, unless moved, the class is thread-safe.
-// All allocations happen when constructed.
+// All allocations happen when constructed, and are reported through the |fbl::AllocChecker|
+// passed to the constructor. A histogram whose allocation failed has no buckets.
+//
+// Buckets are kept once per shard, in rows a whole number of cache lines long, so that each
+// thread increments its own copy of a bucket. Shards are summed when a bucket is read or
+// exchanged.
 //
 // This class is moveable but not copyable or assignable.
 // This class is thread-compatible.
@@ -32,30 +39,62 @@ public:
     using Count = BaseCounter::Type;
 
     BaseHistogram() = delete;
-    explicit BaseHistogram(uint32_t num_buckets);
+    BaseHistogram(uint32_t num_buckets, fbl::AllocChecker* ac);
     BaseHistogram(const BaseHistogram&) = delete;
     BaseHistogram(BaseHistogram&&);
     BaseHistogram& operator=(const BaseHistogram&) = delete;
     BaseHistogram& operator=(BaseHistogram&&) = delete;
-    ~BaseHistogram() = default;
+    ~BaseHistogram();
 
     // Increases the count of the |bucket| bucket by 1.
     void IncrementCount(uint32_t bucket, Count val = 1) {
-        ZX_DEBUG_ASSERT_MSG(bucket < buckets_.size(),
-                            "IncrementCount bucket(%u) out of range(%lu).", bucket,
-                            buckets_.size());
-        buckets_[bucket].Increment(val);
+        ZX_DEBUG_ASSERT_MSG(bucket < num_buckets_,
+                            "IncrementCount bucket(%u) out of range(%u).", bucket,
+                            num_buckets_);
+        Bucket(GetShard(), bucket).Increment(val);
     }
 
     // Returns the count of the |bucket| bucket.
     Count GetCount(uint32_t bucket) const {
-        ZX_DEBUG_ASSERT_MSG(bucket < buckets_.size(), "GetCount bucket out of range.");
-        return buckets_[bucket].Load();
+        ZX_DEBUG_ASSERT_MSG(bucket < num_buckets_, "GetCount bucket out of range.");
+        Count count = 0;
+        for (uint32_t shard = 0; shard < kShardCount; ++shard) {
+            count += Bucket(shard, bucket).Load();
+        }
+        return count;
+    }
+
+    // Returns the count of the |bucket| bucket, and resets it to 0.
+    Count ExchangeCount(uint32_t bucket) {
+        ZX_DEBUG_ASSERT_MSG(bucket < num_buckets_, "ExchangeCount bucket out of range.");
+        Count count = 0;
+        for (uint32_t shard = 0; shard < kShardCount; ++shard) {
+            count += Bucket(shard, bucket).Exchange();
+        }
+        return count;
     }
 
 protected:
-    // Counter for the abs frequency of every histogram bucket.
-    fbl::Vector<BaseCounter> buckets_;
+    // A cache line worth of buckets. Each shard's row is a whole number of these.
+    struct alignas(kCacheLineSize) CounterLine {
+        BaseCounter counters[kCountersPerCacheLine];
+    };
+    static_assert(sizeof(CounterLine) == kCacheLineSize, "CounterLine must fill a cache line.");
+
+    BaseCounter& Bucket(uint32_t shard, uint32_t bucket) const {
+        return lines_[shard * lines_per_row_ + bucket / kCountersPerCacheLine]
+            .counters[bucket % kCountersPerCacheLine];
+    }
+
+    // Number of buckets in the histogram.
+    uint32_t num_buckets_;
+
+    // Number of cache lines in each shard's row of buckets.
+    uint32_t lines_per_row_;
+
+    // Counter for the abs frequency of every histogram bucket, for every shard. Allocated
+    // with |CacheLineAllocatorTraits|.
+    CounterLine* lines_;
 };
 
 // This class provides a histogram which represents a full fledged cobalt metric. The histogram
@@ -77,7 +116,9 @@ public:
                                        FlushCompleteFn complete)>;
 
     RemoteHistogram() = delete;
-    RemoteHistogram(uint32_t num_buckets, const RemoteMetricInfo& metric_info, EventBuffer buffer);
+    // |ac| reports whether the buckets and the flush buffer could be allocated.
+    RemoteHistogram(uint32_t num_buckets, const RemoteMetricInfo& metric_info, EventBuffer buffer,
+                    fbl::AllocChecker* ac);
     RemoteHistogram(const RemoteHistogram&) = delete;
     RemoteHistogram(RemoteHistogram&&);
     RemoteHistogram& operator=(const RemoteHistogram&) = delete;
@@ -14,6 +14,7 @@ class RemoteHistogram;
 } // namespace internal
 
 // Thin wrapper for a histogram. This class does not own the data, but acts as a proxy.
+// A histogram without a |remote_histogram| drops every sample.
 //
 // This class is copyable, moveable and assignable.
 // This class is thread-safe.
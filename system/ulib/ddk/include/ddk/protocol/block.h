@@ -61,6 +61,8 @@ struct block_read_write {
 // and later operations will not start until it is done.
 #define BLOCK_OP_FLUSH UINT32_C(0x00000003)
 
+// Tell the device that the blocks in the range need not be preserved.
+// Their contents are undefined until they are written again.
 #define BLOCK_OP_TRIM UINT32_C(0x00000004)
 
 // Read and Write ops use rw for parameters.
@@ -81,7 +83,8 @@ struct block_trim {
 union block_op {
     // All Commands
     uint32_t command;
-    // `BLOCK_OP_READ`, `BLOCK_OP_WRITE`
+    // `BLOCK_OP_READ`, `BLOCK_OP_WRITE`, `BLOCK_OP_TRIM`
+    // Trim ops ignore rw.vmo and rw.offset_vmo.
     block_read_write_t rw;
     // `BLOCK_OP_TRIM`
     block_trim_t trim;
@@ -28,28 +28,75 @@ __BEGIN_CDECLS;
 //
 // The FEATURE_DMA flag indicates that the device can copy the buffer data using DMA and will ensure
 // that physical addresses are provided in netbufs.
+//
+// A device may have several rx/tx queue pairs, which it reports in info->queue_count. Packets are
+// sent on the queue in netbuf->queue, and a device with more than one queue reports the queue each
+// packet arrived on through ifc->recv_queue(). How received packets are spread across the queues
+// is configured with ETHMAC_SETPARAM_RSS.
+//
+// The FEATURE_TX_CSUM_IPV4 and FEATURE_TX_CSUM_L4 flags indicate that the device can fill in the
+// IPv4 header checksum, and the TCP or UDP checksum, of the packets whose netbuf->offload asks for
+// it. The generic ethernet driver has already written the checksum of the pseudo-header into the
+// TCP or UDP checksum field, so a device may either sum the packet from offload.l4_offset onwards
+// or ignore the field.
+//
+// The FEATURE_TSO flag indicates that the device can split a TCP packet whose netbuf->offload has
+// ETHMAC_TX_OFFLOAD_TSO set into packets of at most offload.mss payload bytes, and fill in all of
+// their checksums. The checksum field of such a packet holds the checksum of the pseudo-header
+// without its length.
+//
+// The FEATURE_RX_CSUM flag indicates that the device verifies the checksums of received packets,
+// and reports the ones it found valid with the ETHMAC_RX_CSUM_* flags of ifc->recv().
+//
+// A device is only asked for the offloads it has the features for. The generic ethernet driver
+// does the rest in software.
 
-#define ETHMAC_FEATURE_WLAN     (1u)
-#define ETHMAC_FEATURE_SYNTH    (2u)
-#define ETHMAC_FEATURE_DMA      (4u)
+#define ETHMAC_FEATURE_WLAN         (1u)
+#define ETHMAC_FEATURE_SYNTH        (2u)
+#define ETHMAC_FEATURE_DMA          (4u)
+#define ETHMAC_FEATURE_TX_CSUM_IPV4 (8u)
+#define ETHMAC_FEATURE_TX_CSUM_L4   (16u)
+#define ETHMAC_FEATURE_TSO          (32u)
+#define ETHMAC_FEATURE_RX_CSUM      (64u)
 
 #define ETHMAC_STATUS_ONLINE    (1u)
 
+// The most rx/tx queue pairs a device may report.
+#define ETHMAC_MAX_QUEUES       (8u)
+
 typedef struct ethmac_info {
     uint32_t features;
     uint32_t mtu;
     uint8_t mac[ETH_MAC_SIZE];
     uint8_t reserved0[2];
-    uint32_t reserved1[4];
+    // The number of rx/tx queue pairs, at most ETHMAC_MAX_QUEUES. 0 means 1.
+    uint32_t queue_count;
+    uint32_t reserved1[3];
 } ethmac_info_t;
 
+// ethmac_tx_offload_t.flags values
+#define ETHMAC_TX_OFFLOAD_IPV4_CSUM (1u) // Fill in the IPv4 header checksum
+#define ETHMAC_TX_OFFLOAD_TCP_CSUM  (2u) // Fill in the TCP checksum
+#define ETHMAC_TX_OFFLOAD_UDP_CSUM  (4u) // Fill in the UDP checksum
+#define ETHMAC_TX_OFFLOAD_TSO       (8u) // Segment the TCP payload, implies TCP_CSUM
+
+// What the device is asked to do to a packet before sending it. The offsets are from the start
+// of the frame.
+typedef struct ethmac_tx_offload {
+    uint16_t flags;
+    uint16_t l3_offset; // Of the IPv4 or IPv6 header
+    uint16_t l4_offset; // Of the TCP or UDP header
+    uint16_t mss;       // The most payload bytes in each segment, with ETHMAC_TX_OFFLOAD_TSO
+} ethmac_tx_offload_t;
+
 typedef struct ethmac_netbuf {
     // Provided by the generic ethernet driver
     void* data;
     zx_paddr_t phys;  // Only used if ETHMAC_FEATURE_DMA is available
     uint16_t len;
-    uint16_t reserved;
+    uint16_t queue;   // The tx queue to send on, below info->queue_count
     uint32_t flags;
+    ethmac_tx_offload_t offload;
 
     // Shared between the generic ethernet and ethmac drivers
     list_node_t node;
@@ -61,10 +108,15 @@ typedef struct ethmac_netbuf {
     };
 } ethmac_netbuf_t;
 
+// recv() flags, which devices with ETHMAC_FEATURE_RX_CSUM set for the checksums they verified
+#define ETHMAC_RX_CSUM_IPV4_OK (1u) // The IPv4 header checksum is valid
+#define ETHMAC_RX_CSUM_L4_OK   (2u) // The TCP or UDP checksum is valid
+
 typedef struct ethmac_ifc_virt {
     // Value with bits set from the ETHMAC_STATUS_* flags
     void (*status)(void* cookie, uint32_t status);
 
+    // |flags| has bits set from the ETHMAC_RX_* flags
     void (*recv)(void* cookie, void* data, size_t length, uint32_t flags);
 
     // complete_tx() is called to return ownership of a netbuf to the generic ethernet driver.
@@ -74,6 +126,10 @@ typedef struct ethmac_ifc_virt {
     // Upon a return of ZX_OK, the packet has been enqueued, but no information is returned as to
     // the completion state of the transmission itself.
     void (*complete_tx)(void* cookie, ethmac_netbuf_t* netbuf, zx_status_t status);
+
+    // recv_queue() is recv() for a packet which arrived on rx |queue|. It may be NULL, in which
+    // case a device with several queues reports all of its packets through recv().
+    void (*recv_queue)(void* cookie, uint32_t queue, void* data, size_t length, uint32_t flags);
 } ethmac_ifc_t;
 
 typedef struct eth_dev_metadata {
@@ -105,6 +161,33 @@ typedef struct eth_dev_metadata {
 
 #define ETHMAC_SETPARAM_DUMP_REGS (4u)
 
+// |value| is unused. |data| is an ethmac_rss_config_t. Caller retains ownership.
+#define ETHMAC_SETPARAM_RSS (5u)
+
+// |value| is a queue. |data| is a uint32_t holding the cpu to steer the queue's interrupt to, next
+// to the thread which sends on the queue. Caller retains ownership.
+#define ETHMAC_SETPARAM_QUEUE_AFFINITY (6u)
+
+// The headers hashed by RSS. Other packets are received on queue 0.
+#define ETHMAC_RSS_HASH_IPV4        (1u << 0)
+#define ETHMAC_RSS_HASH_TCP_IPV4    (1u << 1)
+#define ETHMAC_RSS_HASH_UDP_IPV4    (1u << 2)
+#define ETHMAC_RSS_HASH_IPV6        (1u << 3)
+#define ETHMAC_RSS_HASH_TCP_IPV6    (1u << 4)
+#define ETHMAC_RSS_HASH_UDP_IPV6    (1u << 5)
+
+#define ETHMAC_RSS_KEY_SIZE   (40)
+#define ETHMAC_RSS_TABLE_SIZE (128)
+
+// The Toeplitz hash of a received packet's addresses and ports, keyed by |key|, selects an entry
+// of |table|, which holds the queue the packet is received on. Packets of one flow thus always
+// arrive on the same queue. A |hash_types| of 0 receives every packet on queue 0.
+typedef struct ethmac_rss_config {
+    uint32_t hash_types;
+    uint8_t key[ETHMAC_RSS_KEY_SIZE];
+    uint8_t table[ETHMAC_RSS_TABLE_SIZE];
+} ethmac_rss_config_t;
+
 // The ethernet midlayer will never call ethermac_protocol
 // methods from multiple threads simultaneously, but it
 // can call send() methods at the same time as non-send
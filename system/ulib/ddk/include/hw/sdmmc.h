@@ -80,6 +80,9 @@ __BEGIN_CDECLS;
                                             SDMMC_CMD_READ
 #define MMC_SEND_TUNING_BLOCK_FLAGS         SDMMC_RESP_R1 | SDMMC_RESP_DATA_PRESENT | \
                                             SDMMC_CMD_READ
+#define MMC_ERASE_GROUP_START_FLAGS         SDMMC_RESP_R1
+#define MMC_ERASE_GROUP_END_FLAGS           SDMMC_RESP_R1
+#define MMC_ERASE_FLAGS                     SDMMC_RESP_R1b
 // Common SD/MMC commands
 #define SDMMC_GO_IDLE_STATE           0
 #define SDMMC_ALL_SEND_CID            2
@@ -110,6 +113,12 @@ __BEGIN_CDECLS;
 #define MMC_SELECT_CARD               7
 #define MMC_SEND_EXT_CSD              8
 #define MMC_SEND_TUNING_BLOCK         21
+#define MMC_ERASE_GROUP_START         35
+#define MMC_ERASE_GROUP_END           36
+#define MMC_ERASE                     38
+
+// MMC_ERASE arguments
+#define MMC_ERASE_TRIM_ARG            0x00000001
 
 // CID fields (SD/MMC)
 #define MMC_CID_SPEC_VRSN_40    3
@@ -125,6 +134,9 @@ __BEGIN_CDECLS;
 #define MMC_OCR_BUSY            (1 << 31)
 
 // EXT_CSD fields (MMC)
+#define MMC_EXT_CSD_FLUSH_CACHE 32
+#define MMC_EXT_CSD_CACHE_CTRL  33
+
 #define MMC_EXT_CSD_BUS_WIDTH   183
 #define MMC_EXT_CSD_BUS_WIDTH_8_DDR 6
 #define MMC_EXT_CSD_BUS_WIDTH_4_DDR 5
@@ -140,6 +152,12 @@ __BEGIN_CDECLS;
 
 #define MMC_EXT_CSD_DEVICE_TYPE 196
 
+#define MMC_EXT_CSD_SEC_FEATURE_SUPPORT 231
+#define MMC_EXT_CSD_SEC_GB_CL_EN        (1 << 4)
+
+#define MMC_EXT_CSD_CACHE_SIZE_LSB  249
+#define MMC_EXT_CSD_CACHE_SIZE_MSB  252
+
 // Device register (CMD13 response) fields (SD/MMC)
 #define MMC_STATUS_ADDR_OUT_OF_RANGE    (1 << 31)
 #define MMC_STATUS_ADDR_MISALIGN        (1 << 30)
@@ -67,6 +67,18 @@ public:
                               const void* tree, size_t tree_len, size_t offset,
                               size_t length, const Digest& digest);
 
+    // Like Create(), but hashes the data nodes on up to |threads| threads,
+    // including the caller's. The tree and digest are the same as those
+    // written by Create().
+    static zx_status_t CreateParallel(const void* data, size_t data_len, void* tree,
+                                      size_t tree_len, Digest* digest, uint32_t threads);
+
+    // Like Verify(), but checks the data nodes on up to |threads| threads,
+    // including the caller's.
+    static zx_status_t VerifyParallel(const void* data, size_t data_len,
+                                      const void* tree, size_t tree_len, size_t offset,
+                                      size_t length, const Digest& digest, uint32_t threads);
+
     // The stateful instance methods below are only needed when creating a
     // Merkle tree using the Init/Update/Final methods.
     MerkleTree();
@@ -4,6 +4,7 @@
 
 #include <digest/merkle-tree.h>
 
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -94,6 +95,121 @@ size_t NextAligned(size_t length) {
     return fbl::round_up(NextLength(length), MerkleTree::kNodeSize);
 }
 
+////////
+// Helper functions for hashing the data nodes on several threads.
+
+// The fewest data nodes worth starting a thread for.
+constexpr size_t kMinNodesPerThread = 64;
+
+// The data nodes [first, last) of |data|. When creating a tree, their digests
+// are written to |out|; when verifying one, they are checked against
+// |expected|. In both cases, the bottom level of the tree holds the digests.
+struct NodeRange {
+    const uint8_t* data;
+    size_t data_len;
+    uint8_t* out;
+    const uint8_t* expected;
+    size_t first;
+    size_t last;
+    zx_status_t rc;
+};
+
+zx_status_t HashNodes(const NodeRange& range) {
+    zx_status_t rc;
+    Digest digest;
+    for (size_t node = range.first; node < range.last; ++node) {
+        size_t offset = node * MerkleTree::kNodeSize;
+        if ((rc = DigestInit(&digest, offset, range.data_len - offset)) != ZX_OK) {
+            return rc;
+        }
+        size_t chunk = DigestUpdate(&digest, range.data + offset, offset, range.data_len - offset);
+        DigestFinal(&digest, offset + chunk);
+        if (range.out) {
+            digest.CopyTo(range.out + node * Digest::kLength, Digest::kLength);
+        } else if (digest != range.expected + node * Digest::kLength) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return ZX_OK;
+}
+
+void* HashNodesThread(void* arg) {
+    NodeRange* range = static_cast<NodeRange*>(arg);
+    range->rc = HashNodes(*range);
+    return nullptr;
+}
+
+// Hashes the nodes of |range|, split evenly between up to |threads| threads,
+// one of which is the caller's.
+zx_status_t HashNodesParallel(const NodeRange& range, uint32_t threads) {
+    const size_t nodes = range.last - range.first;
+    const size_t count = fbl::min(static_cast<size_t>(threads), nodes / kMinNodesPerThread);
+    if (count <= 1) {
+        return HashNodes(range);
+    }
+
+    struct Worker {
+        NodeRange range;
+        pthread_t thread;
+        bool started;
+    };
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Worker[]> workers(new (&ac) Worker[count]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    size_t first = range.first;
+    for (size_t i = 0; i < count; ++i) {
+        workers[i].range = range;
+        workers[i].range.first = first;
+        first += nodes / count + (i < nodes % count ? 1 : 0);
+        workers[i].range.last = first;
+    }
+    ZX_DEBUG_ASSERT(first == range.last);
+
+    for (size_t i = 1; i < count; ++i) {
+        workers[i].started = pthread_create(&workers[i].thread, nullptr, HashNodesThread,
+                                            &workers[i].range) == 0;
+    }
+    zx_status_t rc = HashNodes(workers[0].range);
+    for (size_t i = 1; i < count; ++i) {
+        // The caller takes over the nodes of any thread which couldn't start.
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, nullptr);
+        } else {
+            workers[i].range.rc = HashNodes(workers[i].range);
+        }
+        if (rc == ZX_OK) {
+            rc = workers[i].range.rc;
+        }
+    }
+    return rc;
+}
+
+// Like MerkleTree::VerifyLevel, for the bottom level of the tree, on up to
+// |threads| threads.
+zx_status_t VerifyDataParallel(const void* data, size_t data_len, const void* tree,
+                               size_t offset, size_t length, uint32_t threads) {
+    // Must have more than one node of data and digests to check against.
+    if (!data || data_len <= MerkleTree::kNodeSize || !tree) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    // Must not overrun expected length.
+    if (offset + length > data_len) {
+        return ZX_ERR_OUT_OF_RANGE;
+    }
+    NodeRange range = {};
+    range.data = static_cast<const uint8_t*>(data);
+    range.data_len = data_len;
+    range.expected = static_cast<const uint8_t*>(tree);
+    // Align the range to node boundaries, but don't exceed data_len.
+    range.first = offset / MerkleTree::kNodeSize;
+    range.last = fbl::min(fbl::round_up(offset + length, MerkleTree::kNodeSize),
+                          fbl::round_up(data_len, MerkleTree::kNodeSize)) /
+                 MerkleTree::kNodeSize;
+    return HashNodesParallel(range, threads);
+}
+
 } // namespace
 
 ////////
@@ -116,6 +232,45 @@ zx_status_t MerkleTree::Create(const void* data, size_t data_len, void* tree, si
     return ZX_OK;
 }
 
+zx_status_t MerkleTree::CreateParallel(const void* data, size_t data_len, void* tree,
+                                       size_t tree_len, Digest* digest, uint32_t threads) {
+    if (data_len <= kNodeSize || threads <= 1) {
+        return Create(data, data_len, tree, tree_len, digest);
+    }
+    const size_t digests_len = NextAligned(data_len);
+    if (tree_len < digests_len) {
+        return ZX_ERR_BUFFER_TOO_SMALL;
+    }
+    if (!data || !tree || !digest) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    zx_status_t rc;
+    NodeRange range = {};
+    range.data = static_cast<const uint8_t*>(data);
+    range.data_len = data_len;
+    range.out = static_cast<uint8_t*>(tree);
+    range.last = fbl::round_up(data_len, kNodeSize) / kNodeSize;
+    if ((rc = HashNodesParallel(range, threads)) != ZX_OK) {
+        return rc;
+    }
+    // Pad the last node of digests, as CreateUpdate does.
+    const size_t used = range.last * Digest::kLength;
+    memset(range.out + used, 0, digests_len - used);
+
+    // The levels above are a small fraction of the work, and are built as
+    // usual.
+    MerkleTree mt;
+    mt.level_ = 1;
+    uint8_t* next = range.out + digests_len;
+    if ((rc = mt.CreateInit(digests_len, tree_len - digests_len)) != ZX_OK ||
+        (rc = mt.CreateUpdate(tree, digests_len, next)) != ZX_OK ||
+        (rc = mt.CreateFinal(next, digest)) != ZX_OK) {
+        return rc;
+    }
+    return ZX_OK;
+}
+
 MerkleTree::MerkleTree() : initialized_(false), next_(nullptr), level_(0), offset_(0), length_(0) {}
 
 MerkleTree::~MerkleTree() {}
@@ -246,12 +401,24 @@ zx_status_t MerkleTree::CreateFinalInternal(const void* data, void* tree, Digest
 
 zx_status_t MerkleTree::Verify(const void* data, size_t data_len, const void* tree, size_t tree_len,
                                size_t offset, size_t length, const Digest& root) {
+    return VerifyParallel(data, data_len, tree, tree_len, offset, length, root, 1);
+}
+
+zx_status_t MerkleTree::VerifyParallel(const void* data, size_t data_len, const void* tree,
+                                       size_t tree_len, size_t offset, size_t length,
+                                       const Digest& root, uint32_t threads) {
     uint64_t level = 0;
     size_t root_len = data_len;
     while (data_len > kNodeSize) {
         zx_status_t rc;
-        // Verify the data in this level.
-        if ((rc = VerifyLevel(data, data_len, tree, offset, length, level)) != ZX_OK) {
+        // Verify the data in this level. The bottom level is almost all of
+        // the work, so only it is split between threads.
+        if (level == 0 && threads > 1) {
+            rc = VerifyDataParallel(data, data_len, tree, offset, length, threads);
+        } else {
+            rc = VerifyLevel(data, data_len, tree, offset, length, level);
+        }
+        if (rc != ZX_OK) {
             return rc;
         }
         // Ascend to the next level up.
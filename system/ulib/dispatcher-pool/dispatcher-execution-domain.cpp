@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <zircon/syscalls.h>
 #include <lib/zx/event.h>
 
 #include <dispatcher-pool/dispatcher-execution-domain.h>
@@ -11,6 +12,20 @@ namespace dispatcher {
 
 // static
 fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(uint32_t priority) {
+    fbl::RefPtr<ThreadPool> thread_pool;
+    zx_status_t res = ThreadPool::Get(&thread_pool, priority);
+    if (res != ZX_OK)
+        return nullptr;
+    ZX_DEBUG_ASSERT(thread_pool != nullptr);
+
+    return Create(fbl::move(thread_pool));
+}
+
+// static
+fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(fbl::RefPtr<ThreadPool> thread_pool) {
+    if (thread_pool == nullptr)
+        return nullptr;
+
     zx::event evt;
     if (zx::event::create(0, &evt) != ZX_OK)
         return nullptr;
@@ -18,18 +33,12 @@ fbl::RefPtr<ExecutionDomain> ExecutionDomain::Create(uint32_t priority) {
     if (evt.signal(0u, ZX_USER_SIGNAL_0) != ZX_OK)
         return nullptr;
 
-    fbl::RefPtr<ThreadPool> thread_pool;
-    zx_status_t res = ThreadPool::Get(&thread_pool, priority);
-    if (res != ZX_OK)
-        return nullptr;
-    ZX_DEBUG_ASSERT(thread_pool != nullptr);
-
     fbl::AllocChecker ac;
     auto new_domain = fbl::AdoptRef(new (&ac) ExecutionDomain(thread_pool, fbl::move(evt)));
     if (!ac.check())
         return nullptr;
 
-    res = thread_pool->AddDomainToPool(new_domain);
+    zx_status_t res = thread_pool->AddDomainToPool(new_domain);
     if (res != ZX_OK)
         return nullptr;
 
@@ -114,6 +123,11 @@ void ExecutionDomain::Deactivate(bool sync_dispatch) {
         pool->RemoveDomainFromPool(this);
 }
 
+ExecutionDomain::DispatchStats ExecutionDomain::GetDispatchStats() {
+    fbl::AutoLock sources_lock(&sources_lock_);
+    return stats_;
+}
+
 fbl::RefPtr<ThreadPool> ExecutionDomain::GetThreadPool() {
     fbl::AutoLock sources_lock(&sources_lock_);
     return fbl::RefPtr<ThreadPool>(thread_pool_);
@@ -186,6 +200,7 @@ bool ExecutionDomain::AddPendingWork(EventSource* event_source) {
     }
 
     event_source->dispatch_state_ = DispatchState::DispatchPending;
+    event_source->pending_since_ = zx_clock_get_monotonic();
     pending_work_.push_back(fbl::WrapRefPtr(event_source));
 
     return ret;
@@ -216,6 +231,8 @@ void ExecutionDomain::DispatchPendingWork() {
         // pending queue.  If the pending work queue is empty, or we have been
         // deactivated, we are finished.
         fbl::RefPtr<EventSource> source;
+        zx_time_t dispatch_start;
+        zx_duration_t queue_latency;
         {
             fbl::AutoLock sources_lock(&sources_lock_);
             ZX_DEBUG_ASSERT(dispatch_in_progress_);
@@ -235,6 +252,9 @@ void ExecutionDomain::DispatchPendingWork() {
             }
 
             source = pending_work_.begin().CopyPointer();
+
+            dispatch_start = zx_clock_get_monotonic();
+            queue_latency = dispatch_start - source->pending_since_;
         }
 
         // Attempt to transition to the Dispatching state.  If this fails, it
@@ -243,8 +263,20 @@ void ExecutionDomain::DispatchPendingWork() {
         // the execution domain's sources lock.  If this is the case, just move
         // on to the next pending source.
         ZX_DEBUG_ASSERT(source != nullptr);
-        if (source->BeginDispatching())
-            source->Dispatch(this);
+        if (!source->BeginDispatching())
+            continue;
+
+        source->Dispatch(this);
+
+        zx_duration_t dispatch_time = zx_clock_get_monotonic() - dispatch_start;
+        fbl::AutoLock sources_lock(&sources_lock_);
+        stats_.dispatch_count++;
+        stats_.total_queue_latency += queue_latency;
+        if (queue_latency > stats_.max_queue_latency)
+            stats_.max_queue_latency = queue_latency;
+        stats_.total_dispatch_time += dispatch_time;
+        if (dispatch_time > stats_.max_dispatch_time)
+            stats_.max_dispatch_time = dispatch_time;
     }
 }
 
@@ -4,6 +4,7 @@
 
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/port.h>
+#include <zircon/threads.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -15,8 +16,9 @@
 namespace dispatcher {
 
 fbl::Mutex ThreadPool::active_pools_lock_;
-fbl::WAVLTree<uint32_t, fbl::RefPtr<ThreadPool>> ThreadPool::active_pools_;
+fbl::WAVLTree<uint64_t, fbl::RefPtr<ThreadPool>> ThreadPool::active_pools_;
 bool ThreadPool::system_shutdown_ = false;
+uint32_t ThreadPool::last_dedicated_id_ = 0;
 
 static constexpr uint32_t MAX_THREAD_PRIORITY = 31;
 
@@ -43,8 +45,32 @@ zx_status_t ThreadPool::Get(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority
 
     // Looks like we don't have an appropriate pool just yet.  Try to create one
     // and add it to the active set of pools.
+    return Create(pool_out, priority, 0);
+}
+
+// static
+zx_status_t ThreadPool::GetDedicated(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority) {
+    if ((pool_out == nullptr) || (priority > MAX_THREAD_PRIORITY))
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock lock(&active_pools_lock_);
+
+    if (system_shutdown_)
+        return ZX_ERR_BAD_STATE;
+
+    // Id 0 belongs to the shared pools.
+    if (last_dedicated_id_ == UINT32_MAX)
+        return ZX_ERR_NO_RESOURCES;
+
+    return Create(pool_out, priority, ++last_dedicated_id_);
+}
+
+// static
+zx_status_t ThreadPool::Create(fbl::RefPtr<ThreadPool>* pool_out,
+                               uint32_t priority,
+                               uint32_t dedicated_id) {
     fbl::AllocChecker ac;
-    auto new_pool = fbl::AdoptRef(new (&ac) ThreadPool(priority));
+    auto new_pool = fbl::AdoptRef(new (&ac) ThreadPool(priority, dedicated_id));
     if (!ac.check()) {
         printf("Failed to allocate new thread pool (prio %u)\n", priority);
         return ZX_ERR_NO_MEMORY;
@@ -63,7 +89,7 @@ zx_status_t ThreadPool::Get(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority
 
 // static
 void ThreadPool::ShutdownAll() {
-    fbl::WAVLTree<uint32_t, fbl::RefPtr<ThreadPool>> shutdown_targets;
+    fbl::WAVLTree<uint64_t, fbl::RefPtr<ThreadPool>> shutdown_targets;
 
     {
         fbl::AutoLock lock(&active_pools_lock_);
@@ -119,12 +145,40 @@ zx_status_t ThreadPool::AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain) {
             break;
         }
 
+        if (profile_.is_valid()) {
+            zx_status_t res = active_threads_.front().SetProfile(profile_);
+            if (res != ZX_OK) {
+                LOG("Failed to apply profile to new thread (res %d)\n", res);
+            }
+        }
+
         active_thread_count_++;
     }
 
     return ZX_OK;
 }
 
+zx_status_t ThreadPool::SetProfile(zx::handle profile) {
+    if (!profile.is_valid())
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::AutoLock pool_lock(&pool_lock_);
+
+    if (pool_shutting_down_)
+        return ZX_ERR_BAD_STATE;
+
+    for (auto& thread : active_threads_) {
+        zx_status_t res = thread.SetProfile(profile);
+        if (res != ZX_OK) {
+            LOG("Failed to apply profile (res %d)\n", res);
+            return res;
+        }
+    }
+
+    profile_ = fbl::move(profile);
+    return ZX_OK;
+}
+
 void ThreadPool::RemoveDomainFromPool(ExecutionDomain* domain) {
     ZX_DEBUG_ASSERT(domain != nullptr);
     fbl::AutoLock pool_lock(&pool_lock_);
@@ -171,13 +225,13 @@ zx_status_t ThreadPool::BindIrqToPort(const zx::handle& irq_handle, uint64_t key
 }
 
 void ThreadPool::PrintDebugPrefix() {
-    printf("[ThreadPool %02u] ", priority_);
+    printf("[ThreadPool %02u-%u] ", priority_, dedicated_id_);
 }
 
 zx_status_t ThreadPool::Init() {
     ZX_DEBUG_ASSERT(!port_.is_valid());
 
-    zx_status_t res = zx::port::create(ZX_PORT_BIND_TO_INTERRUPT, &port_);
+    zx_status_t res = zx::port::create(ZX_PORT_BIND_TO_INTERRUPT | ZX_PORT_WAKE_NEWEST, &port_);
     if (res != ZX_OK) {
         LOG("Failed to create thread pool port (res %d)!\n", res);
         return res;
@@ -275,6 +329,10 @@ zx_status_t ThreadPool::Thread::Start() {
     return ZX_OK;
 }
 
+zx_status_t ThreadPool::Thread::SetProfile(const zx::handle& profile) {
+    return zx_object_set_profile(thrd_get_zx_handle(thread_handle_), profile.get(), 0u);
+}
+
 void ThreadPool::Thread::Join() {
     // TODO(johngro) : Switch to native zircon threads so we can supply a
     // timeout to the join event.
@@ -132,6 +132,10 @@ private:
 
     // Node state for existing on the domain's pending_work_ list.
     fbl::DoublyLinkedListNodeState<fbl::RefPtr<EventSource>> pending_work_node_state_;
+
+    // When we were last added to the domain's pending_work_ list.  Protected
+    // by the domain's sources_lock_.
+    zx_time_t pending_since_ = 0;
 };
 
 }  // namespace dispatcher
@@ -95,9 +95,25 @@ public:
         ~ScopedToken() __TA_RELEASE() { }
     };
 
+    // Dispatch statistics, gathered over the life of a domain.  Queue latency
+    // is the time an event source spent in the domain's pending work queue
+    // before its handler started, and dispatch time is the time its handler
+    // ran for.
+    struct DispatchStats {
+        uint64_t dispatch_count;
+        zx_duration_t total_queue_latency;
+        zx_duration_t max_queue_latency;
+        zx_duration_t total_dispatch_time;
+        zx_duration_t max_dispatch_time;
+    };
+
     static constexpr uint32_t DEFAULT_PRIORITY = 16;
     static fbl::RefPtr<ExecutionDomain> Create(uint32_t priority = DEFAULT_PRIORITY);
 
+    // Create a domain which is served by a specific thread pool, such as one
+    // obtained from ThreadPool::GetDedicated.
+    static fbl::RefPtr<ExecutionDomain> Create(fbl::RefPtr<ThreadPool> thread_pool);
+
     void Deactivate() __TA_EXCLUDES(domain_token_) { Deactivate(true); }
     void DeactivateFromWithinDomain() __TA_REQUIRES(domain_token_) { Deactivate(false); }
 
@@ -107,6 +123,8 @@ public:
 
     const Token& token() __TA_RETURN_CAPABILITY(domain_token_) { return domain_token_; }
 
+    DispatchStats GetDispatchStats() __TA_EXCLUDES(sources_lock_);
+
 private:
     friend class fbl::RefPtr<ExecutionDomain>;
     friend class Channel;
@@ -158,6 +176,7 @@ private:
     bool dispatch_sync_in_progress_ __TA_GUARDED(sources_lock_) = false;
     fbl::RefPtr<ThreadPool> thread_pool_ __TA_GUARDED(sources_lock_);
     zx::event dispatch_idle_evt_;
+    DispatchStats stats_ __TA_GUARDED(sources_lock_) = { };
 
     // The list of all sources bound to us, as well as the sources which are
     // currently waiting to be dispatched.
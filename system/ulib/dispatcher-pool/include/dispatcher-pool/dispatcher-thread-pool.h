@@ -6,6 +6,7 @@
 
 #include <zircon/compiler.h>
 #include <zircon/types.h>
+#include <lib/zx/handle.h>
 #include <lib/zx/port.h>
 #include <fbl/auto_lock.h>
 #include <fbl/intrusive_double_list.h>
@@ -25,9 +26,20 @@ class ThreadPool : public fbl::RefCounted<ThreadPool>,
                    public fbl::WAVLTreeContainable<fbl::RefPtr<ThreadPool>> {
 public:
     static zx_status_t Get(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority);
+
+    // Create a new pool which is not shared with the domains of any other
+    // caller of Get or GetDedicated, so that handlers in its domains are never
+    // queued behind those of unrelated domains.  Dedicated pools live until
+    // they are explicitly shut down, or until ShutdownAll.
+    static zx_status_t GetDedicated(fbl::RefPtr<ThreadPool>* pool_out, uint32_t priority);
     static void ShutdownAll();
 
     void Shutdown();
+
+    // Apply a profile, such as a deadline or cpu affinity profile, to every
+    // thread in the pool, now and as threads are added to it.
+    zx_status_t SetProfile(zx::handle profile);
+
     zx_status_t AddDomainToPool(fbl::RefPtr<ExecutionDomain> domain);
     void RemoveDomainFromPool(ExecutionDomain* domain);
 
@@ -38,7 +50,9 @@ public:
     zx_status_t CancelWaitOnPort(const zx::handle& handle, uint64_t key);
     zx_status_t BindIrqToPort(const zx::handle& irq_handle, uint64_t key);
 
-    uint32_t GetKey() const { return priority_; }
+    // Shared pools are keyed by their priority alone, so that they may be
+    // found by it.  Dedicated pools also have a unique id in the upper bits.
+    uint64_t GetKey() const { return (static_cast<uint64_t>(dedicated_id_) << 32) | priority_; }
 
 private:
     friend class fbl::RefPtr<ThreadPool>;
@@ -48,6 +62,7 @@ private:
         static fbl::unique_ptr<Thread> Create(fbl::RefPtr<ThreadPool> pool, uint32_t id);
         zx_status_t Start();
         void Join();
+        zx_status_t SetProfile(const zx::handle& profile);
 
     private:
         Thread(fbl::RefPtr<ThreadPool> pool, uint32_t id);
@@ -65,25 +80,32 @@ private:
         const uint32_t id_;
     };
 
-    explicit ThreadPool(uint32_t priority) : priority_(priority) { }
+    ThreadPool(uint32_t priority, uint32_t dedicated_id)
+        : priority_(priority), dedicated_id_(dedicated_id) { }
     ~ThreadPool() { }
 
     uint32_t priority() const { return priority_; }
     const zx::port& port() const { return port_; }
 
     void PrintDebugPrefix();
+    static zx_status_t Create(fbl::RefPtr<ThreadPool>* pool_out,
+                              uint32_t priority,
+                              uint32_t dedicated_id) __TA_REQUIRES(active_pools_lock_);
     zx_status_t Init();
     void InternalShutdown();
 
     static fbl::Mutex active_pools_lock_;
-    static fbl::WAVLTree<uint32_t, fbl::RefPtr<ThreadPool>> active_pools_
+    static fbl::WAVLTree<uint64_t, fbl::RefPtr<ThreadPool>> active_pools_
         __TA_GUARDED(active_pools_lock_);
     static bool system_shutdown_ __TA_GUARDED(active_pools_lock_);
+    static uint32_t last_dedicated_id_ __TA_GUARDED(active_pools_lock_);
 
     const uint32_t priority_;
+    const uint32_t dedicated_id_;
 
     fbl::Mutex pool_lock_ __TA_ACQUIRED_AFTER(active_pools_lock_);
     zx::port port_;
+    zx::handle profile_ __TA_GUARDED(pool_lock_);
     uint32_t active_domain_count_ __TA_GUARDED(pool_lock_) = 0;
     uint32_t active_thread_count_ __TA_GUARDED(pool_lock_) = 0;
     bool pool_shutting_down_ __TA_GUARDED(pool_lock_) = false;
@@ -0,0 +1,320 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zircon/assert.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/intrusive_container_utils.h>
+#include <fbl/macros.h>
+#include <fbl/new.h>
+#include <fbl/type_support.h>
+
+namespace fbl {
+
+// DefaultFlatHashTraits defines the default hash function of a FlatHashTable.
+// Users only need to implement a static method of ObjType named GetHash which
+// takes a const reference to a KeyType and returns an integer.  Unlike the hash
+// of an intrusive HashTable, it need not be reduced to any range; the table
+// mixes all of its bits itself.
+template <typename KeyType, typename ObjType>
+struct DefaultFlatHashTraits {
+    static uint64_t GetHash(const KeyType& key) { return ObjType::GetHash(key); }
+};
+
+// FlatHashTable<> is an open addressing hash table of unmanaged pointers to
+// objects, which are looked up by key.  KeyTraits are the same as those of
+// fbl::HashTable, and keys must be unique.
+//
+// Unlike fbl::HashTable, objects need no node state, and the table grows as
+// objects are inserted.  Pointers are held in a single array, and lookups
+// probe it eight slots at a time.  Each slot has a control byte which holds 7
+// bits of the hash of its object's key, and only slots whose control byte
+// matches are compared.  The control bytes of a group of slots are matched at
+// once in a 64-bit word, so no vector instructions are needed, and the table
+// may be used in the kernel.
+//
+// Inserting an object may allocate, and reports failure through an
+// AllocChecker.  FlatHashTable<> does no locking of its own.
+template <typename  _KeyType,
+          typename  _PtrType,
+          typename  _KeyTraits  = DefaultKeyedObjectTraits<
+                                    _KeyType,
+                                    typename remove_pointer<_PtrType>::type>,
+          typename  _HashTraits = DefaultFlatHashTraits<
+                                    _KeyType,
+                                    typename remove_pointer<_PtrType>::type>>
+class FlatHashTable {
+public:
+    using KeyType    = _KeyType;
+    using PtrType    = _PtrType;
+    using ObjType    = typename remove_pointer<PtrType>::type;
+    using KeyTraits  = _KeyTraits;
+    using HashTraits = _HashTraits;
+
+    static_assert(is_pointer<PtrType>::value,
+                  "FlatHashTable only holds unmanaged pointers");
+    static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+                  "FlatHashTable assumes a little endian machine");
+
+    constexpr FlatHashTable() { }
+    ~FlatHashTable() { Free(); }
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(FlatHashTable);
+
+    size_t size() const { return size_; }
+    bool is_empty() const { return size_ == 0; }
+    size_t capacity() const { return capacity_; }
+
+    // Returns the object with |key|, or nullptr if there is none.
+    PtrType find(const KeyType& key) const {
+        size_t slot;
+        return FindSlot(key, &slot) ? slots_[slot] : nullptr;
+    }
+
+    // Inserts |ptr|, whose key must not already be in the table.  On
+    // allocation failure, the table is unchanged.
+    void insert(PtrType ptr, AllocChecker* ac) {
+        ZX_DEBUG_ASSERT(ptr != nullptr);
+        ZX_DEBUG_ASSERT(find(KeyTraits::GetKey(*ptr)) == nullptr);
+        if (growth_left_ == 0) {
+            // If most of the slots in use are tombstones, rehashing in place is
+            // enough to make room.
+            size_t capacity = kMinCapacity;
+            if (capacity_ != 0) {
+                capacity = (size_ * 2 < MaxLoad(capacity_)) ? capacity_ : capacity_ * 2;
+            }
+            if (!Rehash(capacity, ac)) {
+                return;
+            }
+        } else {
+            ac->arm(0u, true);
+        }
+        InsertNoGrow(ptr);
+    }
+
+#ifndef _KERNEL
+    void insert(PtrType ptr) {
+        AllocChecker ac;
+        insert(ptr, &ac);
+        ZX_ASSERT(ac.check());
+    }
+#endif // _KERNEL
+
+    // Removes the object with |key|, returning it, or nullptr if there is none.
+    PtrType erase(const KeyType& key) {
+        size_t slot;
+        if (!FindSlot(key, &slot)) {
+            return nullptr;
+        }
+        return EraseSlot(slot);
+    }
+
+    // Removes |obj| itself.  An object with the same key which is not |obj| is
+    // left alone.
+    PtrType erase(const ObjType& obj) {
+        size_t slot;
+        if (!FindSlot(KeyTraits::GetKey(obj), &slot) || (slots_[slot] != &obj)) {
+            return nullptr;
+        }
+        return EraseSlot(slot);
+    }
+
+    // Makes room for at least |count| objects, so that inserting up to that
+    // many will not allocate.
+    void reserve(size_t count, AllocChecker* ac) {
+        if (count <= size_ + growth_left_) {
+            ac->arm(0u, true);
+            return;
+        }
+        size_t capacity = kMinCapacity;
+        while (MaxLoad(capacity) < count) {
+            capacity *= 2;
+        }
+        Rehash(capacity, ac);
+    }
+
+    // Removes every object, and releases the table's storage.
+    void clear() {
+        Free();
+    }
+
+    // Calls |fn| with each object in the table, in no particular order.  The
+    // table must not be modified by |fn|.
+    template <typename Callable>
+    void ForEach(Callable fn) const {
+        for (size_t i = 0; i < capacity_; i++) {
+            if (IsFull(ctrl_[i])) {
+                fn(slots_[i]);
+            }
+        }
+    }
+
+private:
+    // Control bytes.  A full slot holds the top 7 bits of its mixed hash.
+    static constexpr uint8_t kEmpty   = 0x80;
+    static constexpr uint8_t kDeleted = 0xFE;
+
+    static constexpr size_t kGroupSize = 8;
+    static constexpr size_t kMinCapacity = kGroupSize;
+    static constexpr uint64_t kLsbs = 0x0101010101010101ull;
+    static constexpr uint64_t kMsbs = 0x8080808080808080ull;
+
+    static bool IsFull(uint8_t ctrl) { return (ctrl & 0x80) == 0; }
+
+    // Tables are kept at most 7/8 full, so that probes stay short and every
+    // probe sequence reaches an empty slot.
+    static size_t MaxLoad(size_t capacity) { return capacity - (capacity / 8); }
+
+    // The hash is mixed so that both the group, which is taken from its low
+    // bits, and the control byte, which is taken from its high bits, depend on
+    // every bit of the key's hash.
+    static uint64_t Hash(const KeyType& key) {
+        return static_cast<uint64_t>(HashTraits::GetHash(key)) * 0x9E3779B97F4A7C15ull;
+    }
+    static size_t H1(uint64_t hash) { return static_cast<size_t>(hash ^ (hash >> 32)); }
+    static uint8_t H2(uint64_t hash) { return static_cast<uint8_t>(hash >> 57); }
+
+    // Bit 7 of each byte of the result is set for each matching control byte
+    // of |group|.  MatchByte may have false positives, which are weeded out by
+    // comparing keys.
+    static uint64_t MatchByte(uint64_t group, uint8_t h2) {
+        uint64_t x = group ^ (kLsbs * h2);
+        return (x - kLsbs) & ~x & kMsbs;
+    }
+    static uint64_t MatchEmpty(uint64_t group) {
+        return group & ~(group << 6) & kMsbs;
+    }
+    static uint64_t MatchEmptyOrDeleted(uint64_t group) {
+        return group & ~(group << 7) & kMsbs;
+    }
+    static size_t FirstMatch(uint64_t match) {
+        return static_cast<size_t>(__builtin_ctzll(match)) / 8;
+    }
+
+    uint64_t LoadGroup(size_t group) const {
+        uint64_t word;
+        memcpy(&word, ctrl_ + (group * kGroupSize), sizeof(word));
+        return word;
+    }
+
+    // Groups are probed quadratically, which visits every group of a table
+    // with a power of two number of them.
+    bool FindSlot(const KeyType& key, size_t* out_slot) const {
+        if (size_ == 0) {
+            return false;
+        }
+        uint64_t hash = Hash(key);
+        uint8_t h2 = H2(hash);
+        size_t group_mask = (capacity_ / kGroupSize) - 1;
+        size_t group = H1(hash) & group_mask;
+        for (size_t stride = 1; ; stride++) {
+            uint64_t ctrl = LoadGroup(group);
+            for (uint64_t match = MatchByte(ctrl, h2); match != 0; match &= match - 1) {
+                size_t slot = (group * kGroupSize) + FirstMatch(match);
+                if (KeyTraits::EqualTo(KeyTraits::GetKey(*slots_[slot]), key)) {
+                    *out_slot = slot;
+                    return true;
+                }
+            }
+            // No object whose probe reached a group with an empty slot was
+            // placed past it.
+            if (MatchEmpty(ctrl) != 0) {
+                return false;
+            }
+            group = (group + stride) & group_mask;
+        }
+    }
+
+    void InsertNoGrow(PtrType ptr) {
+        ZX_DEBUG_ASSERT(growth_left_ > 0);
+        uint64_t hash = Hash(KeyTraits::GetKey(*ptr));
+        size_t group_mask = (capacity_ / kGroupSize) - 1;
+        size_t group = H1(hash) & group_mask;
+        for (size_t stride = 1; ; stride++) {
+            uint64_t match = MatchEmptyOrDeleted(LoadGroup(group));
+            if (match != 0) {
+                size_t slot = (group * kGroupSize) + FirstMatch(match);
+                if (ctrl_[slot] == kEmpty) {
+                    growth_left_--;
+                }
+                ctrl_[slot] = H2(hash);
+                slots_[slot] = ptr;
+                size_++;
+                return;
+            }
+            group = (group + stride) & group_mask;
+        }
+    }
+
+    PtrType EraseSlot(size_t slot) {
+        // A slot may only become empty again if its group already has an empty
+        // slot, since otherwise some other object may have been placed past
+        // the group by a probe which found it full.  Otherwise it becomes a
+        // tombstone, which is only reclaimed by an insertion or a rehash.
+        PtrType ptr = slots_[slot];
+        if (MatchEmpty(LoadGroup(slot / kGroupSize)) != 0) {
+            ctrl_[slot] = kEmpty;
+            growth_left_++;
+        } else {
+            ctrl_[slot] = kDeleted;
+        }
+        slots_[slot] = nullptr;
+        size_--;
+        return ptr;
+    }
+
+    bool Rehash(size_t capacity, AllocChecker* ac) {
+        ZX_DEBUG_ASSERT(MaxLoad(capacity) > size_);
+        AllocChecker storage_ac;
+        uint8_t* storage = new (&storage_ac) uint8_t[capacity * (sizeof(PtrType) + 1)];
+        if (!storage_ac.check()) {
+            ac->arm(1u, false);
+            return false;
+        }
+        ac->arm(0u, true);
+
+        PtrType* old_slots = slots_;
+        uint8_t* old_ctrl = ctrl_;
+        size_t old_capacity = capacity_;
+
+        slots_ = reinterpret_cast<PtrType*>(storage);
+        ctrl_ = storage + (capacity * sizeof(PtrType));
+        memset(ctrl_, kEmpty, capacity);
+        capacity_ = capacity;
+        growth_left_ = MaxLoad(capacity);
+        size_ = 0;
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (IsFull(old_ctrl[i])) {
+                InsertNoGrow(old_slots[i]);
+            }
+        }
+        delete[] reinterpret_cast<uint8_t*>(old_slots);
+        return true;
+    }
+
+    void Free() {
+        delete[] reinterpret_cast<uint8_t*>(slots_);
+        slots_ = nullptr;
+        ctrl_ = nullptr;
+        capacity_ = 0;
+        size_ = 0;
+        growth_left_ = 0;
+    }
+
+    PtrType* slots_ = nullptr;
+    uint8_t* ctrl_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    // The number of empty slots which may be filled before the table must be
+    // rehashed.
+    size_t growth_left_ = 0;
+};
+
+}  // namespace fbl
@@ -6,6 +6,7 @@
 
 #include <zircon/compiler.h>
 #include <fbl/algorithm.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <fbl/deleter.h>
 #include <fbl/intrusive_single_list.h>
@@ -82,6 +83,15 @@
 // UnlockedInstancedSlabAllocatorTraits or UnlockedStaticSlabAllocatorTraits may
 // be used as a shorthand for this.
 //
+// When a real lock is in use and the object counter is disabled, free
+// operations do not take the lock at all.  Objects are pushed onto a lock-free
+// stack, which allocations move to the locked free list, all at once, only
+// when the latter runs dry.  Threads which only free objects never contend
+// with threads which allocate them, and the lock is taken once per batch of
+// frees instead of once per free.  Because only a lock holder ever takes
+// anything off of the stack, and it always takes the whole stack, the stack
+// is not subject to the ABA problem.
+//
 // ** Example **
 //
 // using MyAllocatorTraits =
@@ -390,6 +400,11 @@ class SlabAllocatorBase {
 protected:
     struct FreeListEntry : public SinglyLinkedListable<FreeListEntry*> { };
 
+    // An object on the lock-free stack of objects returned without the lock.
+    struct RemoteFreeEntry {
+        RemoteFreeEntry* next;
+    };
+
     struct Slab {
         explicit Slab(size_t initial_bytes_used) : bytes_used_(initial_bytes_used) { }
 
@@ -439,6 +454,8 @@ public:
     }
 
     ~SlabAllocatorBase() {
+        // Objects returned without the lock count as free too.
+        ReclaimRemoteFreeListLocked();
 #if ZX_DEBUG_ASSERT_IMPLEMENTED
         size_t allocated_count = 0;
         size_t free_list_size = this->free_list_.size_slow();
@@ -470,7 +487,11 @@ public:
 
 protected:
     void* AllocateLocked() {
-        // If we can alloc from the free list, do so.
+        // If we can alloc from the free list, do so.  If it is empty, refill
+        // it with anything which has been returned without the lock.
+        if (free_list_.is_empty()) {
+            ReclaimRemoteFreeListLocked();
+        }
         if (!free_list_.is_empty()) {
             return free_list_.pop_front();
         }
@@ -505,6 +526,30 @@ protected:
         free_list_.push_front(free_obj);
     }
 
+    // May be called without holding the lock.
+    void ReturnToRemoteFreeList(void* ptr) {
+        RemoteFreeEntry* free_obj = new (ptr) RemoteFreeEntry;
+        RemoteFreeEntry* head = remote_free_list_.load(memory_order_relaxed);
+        do {
+            free_obj->next = head;
+        } while (!remote_free_list_.compare_exchange_weak(&head, free_obj,
+                                                          memory_order_release,
+                                                          memory_order_relaxed));
+    }
+
+    void ReclaimRemoteFreeListLocked() {
+        if (remote_free_list_.load(memory_order_relaxed) == nullptr) {
+            return;
+        }
+
+        RemoteFreeEntry* obj = remote_free_list_.exchange(nullptr, memory_order_acquire);
+        while (obj != nullptr) {
+            RemoteFreeEntry* next = obj->next;
+            ReturnToFreeListLocked(obj);
+            obj = next;
+        }
+    }
+
 private:
     // Constant properties of the allocator passed to us by our templated
     // wrapper during construction.
@@ -518,6 +563,7 @@ private:
     SinglyLinkedList<FreeListEntry*> free_list_;
     SinglyLinkedList<Slab*>          slab_list_;
     size_t                           slab_count_ = 0;
+    atomic<RemoteFreeEntry*>         remote_free_list_{nullptr};
 };
 
 template <typename SATraits>
@@ -529,8 +575,16 @@ public:
 
 protected:
     static constexpr size_t SLAB_SIZE  = SATraits::SLAB_SIZE;
-    static constexpr size_t AllocSize  = max(sizeof(FreeListEntry), sizeof(ObjType));
-    static constexpr size_t AllocAlign = max(alignof(FreeListEntry), alignof(ObjType));
+    static constexpr size_t AllocSize  = max(max(sizeof(FreeListEntry), sizeof(RemoteFreeEntry)),
+                                             sizeof(ObjType));
+    static constexpr size_t AllocAlign = max(max(alignof(FreeListEntry), alignof(RemoteFreeEntry)),
+                                             alignof(ObjType));
+
+    // Objects are returned without taking the lock unless there is no lock to
+    // avoid, or the object counter needs it.
+    static constexpr bool LockFreeReturn =
+        !SATraits::ENABLE_OBJ_COUNT &&
+        !is_same<typename SATraits::LockType, ::fbl::NullLock>::value;
 
     static_assert(AllocAlign > 0, "Alignment requirements cannot be zero!");
     static_assert(!(AllocSize % AllocAlign),
@@ -624,6 +678,11 @@ protected:
     }
 
     void ReturnToFreeList(void* ptr) {
+        if (LockFreeReturn) {
+            ReturnToRemoteFreeList(ptr);
+            return;
+        }
+
         FreeListEntry* free_obj = new (ptr) FreeListEntry;
         {
             AutoLock alloc_lock(&alloc_lock_);
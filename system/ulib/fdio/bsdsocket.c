@@ -495,3 +495,75 @@ int setsockopt(int fd, int level, int optname, const void* optval,
     fdio_release(io);
     return STATUS(status);
 }
+
+// Checks that the messages of a batch can be sent on the socket |io|, the way
+// its sendmsg op checks a single message.
+static zx_status_t check_send_batch(fdio_t* io, const zxs_socket_t* socket,
+                                    const struct mmsghdr* msgvec, unsigned int vlen) {
+    if (!(io->ioflag & IOFLAG_SOCKET_CONNECTED)) {
+        return (socket->flags & ZXS_FLAG_DATAGRAM) ? ZX_OK : ZX_ERR_BAD_STATE;
+    }
+    // If connected, can't specify an address.
+    for (unsigned int i = 0; i < vlen; i++) {
+        if (msgvec[i].msg_hdr.msg_name != NULL || msgvec[i].msg_hdr.msg_namelen != 0) {
+            return ZX_ERR_ALREADY_EXISTS;
+        }
+    }
+    return ZX_OK;
+}
+
+// Fails with the error for an |fd| which fd_to_socket rejected.
+static int not_a_socket(int fd) {
+    fdio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    fdio_release(io);
+    return ERRNO(ENOTSOCK);
+}
+
+// The batch calls find the socket once, and go straight to zxs for each of
+// its messages rather than through the ops of the fdio_t.
+
+__EXPORT
+int sendmmsg(int fd, struct mmsghdr* msgvec, unsigned int vlen, unsigned int flags) {
+    const zxs_socket_t* socket = NULL;
+    fdio_t* io = fd_to_socket(fd, &socket);
+    if (io == NULL) {
+        return not_a_socket(fd);
+    }
+
+    size_t count = 0u;
+    zx_status_t status = check_send_batch(io, socket, msgvec, vlen);
+    if (status == ZX_OK) {
+        status = zxs_sendmmsg(socket, msgvec, vlen, flags, &count);
+    }
+    fdio_release(io);
+    return status == ZX_OK ? (int)count : STATUS(status);
+}
+
+__EXPORT
+int recvmmsg(int fd, struct mmsghdr* msgvec, unsigned int vlen, unsigned int flags,
+             struct timespec* timeout) {
+    zx_time_t deadline = ZX_TIME_INFINITE;
+    if (timeout != NULL) {
+        if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000) {
+            return ERRNO(EINVAL);
+        }
+        deadline = zx_deadline_after(ZX_SEC(timeout->tv_sec) + timeout->tv_nsec);
+    }
+
+    const zxs_socket_t* socket = NULL;
+    fdio_t* io = fd_to_socket(fd, &socket);
+    if (io == NULL) {
+        return not_a_socket(fd);
+    }
+
+    size_t count = 0u;
+    zx_status_t status = ZX_ERR_BAD_STATE;
+    if ((socket->flags & ZXS_FLAG_DATAGRAM) || (io->ioflag & IOFLAG_SOCKET_CONNECTED)) {
+        status = zxs_recvmmsg(socket, msgvec, vlen, flags, deadline, &count);
+    }
+    fdio_release(io);
+    return status == ZX_OK ? (int)count : STATUS(status);
+}
@@ -0,0 +1,428 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <assert.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <threads.h>
+
+#include <lib/fdio/limits.h>
+#include <lib/fdio/util.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include "private.h"
+#include "unistd.h"
+
+static_assert(EPOLLIN == POLLIN, "");
+static_assert(EPOLLPRI == POLLPRI, "");
+static_assert(EPOLLOUT == POLLOUT, "");
+static_assert(EPOLLERR == POLLERR, "");
+static_assert(EPOLLHUP == POLLHUP, "");
+static_assert(EPOLLRDHUP == POLLRDHUP, "");
+
+// The events that are always reported, whether or not they were asked for.
+#define EPOLL_ALWAYS (EPOLLERR | EPOLLHUP)
+// The flags which are not events.
+#define EPOLL_FLAGS (EPOLLET | EPOLLONESHOT)
+
+// The most packets handled by one epoll_wait(), which bounds the descriptors
+// it re-arms.
+#define EPOLL_MAX_PACKETS 64
+
+// A descriptor registered with an epoll instance.
+//
+// Each registration keeps a wait pending on the port of the instance while it
+// is armed. A level-triggered registration is re-armed after each wait that
+// reports it. An edge-triggered one waits with ZX_WAIT_ASYNC_REPEATING, and so
+// stays armed.
+typedef struct epoll_reg {
+    // The object of the descriptor, which the registration holds a reference to.
+    fdio_t* io;
+    struct epoll_event event;
+    zx_handle_t handle;
+    zx_signals_t signals;
+    // Packed from a generation and the descriptor, so that packets for an
+    // earlier registration of the descriptor can be told apart.
+    uint64_t key;
+    bool armed;
+    // Set once reported with EPOLLONESHOT, until the next EPOLL_CTL_MOD.
+    bool disabled;
+} epoll_reg_t;
+
+typedef struct fdio_epoll {
+    fdio_t io;
+    zx_handle_t port;
+
+    mtx_t lock;
+    uint32_t generation;
+    // Indexed by descriptor.
+    epoll_reg_t* regs[FDIO_MAX_FD];
+} fdio_epoll_t;
+
+static inline int epoll_key_fd(uint64_t key) {
+    return (int)(uint32_t)key;
+}
+
+// Called with |ep->lock| held.
+static zx_status_t epoll_arm(fdio_epoll_t* ep, epoll_reg_t* reg) {
+    uint32_t options = (reg->event.events & EPOLLET) ? ZX_WAIT_ASYNC_REPEATING
+                                                     : ZX_WAIT_ASYNC_ONCE;
+    zx_status_t status = zx_object_wait_async(reg->handle, ep->port, reg->key, reg->signals,
+                                              options);
+    if (status == ZX_OK) {
+        reg->armed = true;
+    }
+    return status;
+}
+
+// Cancels the wait of |reg|, and drops any of its packets already queued.
+// Called with |ep->lock| held.
+static void epoll_disarm(fdio_epoll_t* ep, epoll_reg_t* reg) {
+    if (reg->armed) {
+        zx_port_cancel(ep->port, reg->handle, reg->key);
+        reg->armed = false;
+    }
+}
+
+// Asks the object of |reg| what to wait on for its events, and waits on it
+// under a new key. Called with |ep->lock| held.
+static zx_status_t epoll_begin(fdio_epoll_t* ep, epoll_reg_t* reg, int fd) {
+    zx_handle_t handle = ZX_HANDLE_INVALID;
+    zx_signals_t signals = 0;
+    uint32_t events = reg->event.events & ~EPOLL_FLAGS;
+    reg->io->ops->wait_begin(reg->io, events, &handle, &signals);
+    if (handle == ZX_HANDLE_INVALID) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    reg->handle = handle;
+    reg->signals = signals;
+    reg->key = ((uint64_t)++ep->generation << 32) | (uint32_t)fd;
+    reg->disabled = false;
+    return epoll_arm(ep, reg);
+}
+
+// Called with |ep->lock| held.
+static void epoll_remove(fdio_epoll_t* ep, int fd) {
+    epoll_reg_t* reg = ep->regs[fd];
+    epoll_disarm(ep, reg);
+    ep->regs[fd] = NULL;
+    fdio_release(reg->io);
+    free(reg);
+}
+
+static zx_status_t fdio_epoll_close(fdio_t* io) {
+    fdio_epoll_t* ep = (fdio_epoll_t*)io;
+    mtx_lock(&ep->lock);
+    for (int fd = 0; fd < FDIO_MAX_FD; fd++) {
+        if (ep->regs[fd] != NULL) {
+            epoll_remove(ep, fd);
+        }
+    }
+    zx_handle_t port = ep->port;
+    ep->port = ZX_HANDLE_INVALID;
+    mtx_unlock(&ep->lock);
+    zx_handle_close(port);
+    return ZX_OK;
+}
+
+static ssize_t fdio_epoll_read(fdio_t* io, void* data, size_t len) {
+    return ZX_ERR_WRONG_TYPE;
+}
+
+static ssize_t fdio_epoll_write(fdio_t* io, const void* data, size_t len) {
+    return ZX_ERR_WRONG_TYPE;
+}
+
+static fdio_ops_t fdio_epoll_ops = {
+    .read = fdio_epoll_read,
+    .read_at = fdio_default_read_at,
+    .write = fdio_epoll_write,
+    .write_at = fdio_default_write_at,
+    .seek = fdio_default_seek,
+    .misc = fdio_default_misc,
+    .close = fdio_epoll_close,
+    .open = fdio_default_open,
+    .clone = fdio_default_clone,
+    .ioctl = fdio_default_ioctl,
+    .unwrap = fdio_default_unwrap,
+    .wait_begin = fdio_default_wait_begin,
+    .wait_end = fdio_default_wait_end,
+    .posix_ioctl = fdio_default_posix_ioctl,
+    .get_vmo = fdio_default_get_vmo,
+    .get_token = fdio_default_get_token,
+    .get_attr = fdio_default_get_attr,
+    .set_attr = fdio_default_set_attr,
+    .sync = fdio_default_sync,
+    .readdir = fdio_default_readdir,
+    .rewind = fdio_default_rewind,
+    .unlink = fdio_default_unlink,
+    .truncate = fdio_default_truncate,
+    .rename = fdio_default_rename,
+    .link = fdio_default_link,
+    .get_flags = fdio_default_get_flags,
+    .set_flags = fdio_default_set_flags,
+    .recvfrom = fdio_default_recvfrom,
+    .sendto = fdio_default_sendto,
+    .recvmsg = fdio_default_recvmsg,
+    .sendmsg = fdio_default_sendmsg,
+    .shutdown = fdio_default_shutdown,
+};
+
+// Returns the epoll instance of |epfd|, with a reference held.
+static fdio_epoll_t* fd_to_epoll(int epfd) {
+    fdio_t* io = fd_to_io(epfd);
+    if (io == NULL) {
+        return NULL;
+    }
+    if (io->ops != &fdio_epoll_ops) {
+        fdio_release(io);
+        return NULL;
+    }
+    return (fdio_epoll_t*)io;
+}
+
+__EXPORT
+int epoll_create1(int flags) {
+    if (flags & ~EPOLL_CLOEXEC) {
+        return ERRNO(EINVAL);
+    }
+    fdio_epoll_t* ep = fdio_alloc(sizeof(fdio_epoll_t));
+    if (ep == NULL) {
+        return ERRNO(ENOMEM);
+    }
+    ep->io.ops = &fdio_epoll_ops;
+    ep->io.magic = FDIO_MAGIC;
+    atomic_init(&ep->io.refcount, 1);
+    ep->io.ioflag = IOFLAG_EPOLL | ((flags & EPOLL_CLOEXEC) ? IOFLAG_CLOEXEC : 0);
+    mtx_init(&ep->lock, mtx_plain);
+    zx_status_t status = zx_port_create(0, &ep->port);
+    if (status != ZX_OK) {
+        fdio_release(&ep->io);
+        return ERROR(status);
+    }
+
+    int fd = fdio_bind_to_fd(&ep->io, -1, 0);
+    if (fd < 0) {
+        fdio_close(&ep->io);
+        fdio_release(&ep->io);
+        return ERRNO(EMFILE);
+    }
+    return fd;
+}
+
+__EXPORT
+int epoll_create(int size) {
+    if (size <= 0) {
+        return ERRNO(EINVAL);
+    }
+    return epoll_create1(0);
+}
+
+__EXPORT
+int epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+    if (fd == epfd) {
+        return ERRNO(EINVAL);
+    }
+    if (op != EPOLL_CTL_DEL && event == NULL) {
+        return ERRNO(EFAULT);
+    }
+    fdio_epoll_t* ep = fd_to_epoll(epfd);
+    if (ep == NULL) {
+        return ERRNO(EBADF);
+    }
+    fdio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        fdio_release(&ep->io);
+        return ERRNO(EBADF);
+    }
+
+    zx_status_t status = ZX_OK;
+    int e = 0;
+    mtx_lock(&ep->lock);
+    epoll_reg_t* reg = ep->regs[fd];
+    if (reg != NULL && reg->io != io) {
+        // The descriptor was closed since it was registered, which ended the
+        // registration; |fd| now names something else.
+        epoll_remove(ep, fd);
+        reg = NULL;
+    }
+    switch (op) {
+    case EPOLL_CTL_ADD:
+        if (reg != NULL) {
+            e = EEXIST;
+            break;
+        }
+        if ((reg = calloc(1, sizeof(*reg))) == NULL) {
+            e = ENOMEM;
+            break;
+        }
+        reg->io = io;
+        reg->event = *event;
+        if ((status = epoll_begin(ep, reg, fd)) != ZX_OK) {
+            free(reg);
+            break;
+        }
+        ep->regs[fd] = reg;
+        // The registration keeps the reference.
+        io = NULL;
+        break;
+    case EPOLL_CTL_MOD:
+        if (reg == NULL) {
+            e = ENOENT;
+            break;
+        }
+        epoll_disarm(ep, reg);
+        reg->event = *event;
+        if ((status = epoll_begin(ep, reg, fd)) != ZX_OK) {
+            epoll_remove(ep, fd);
+        }
+        break;
+    case EPOLL_CTL_DEL:
+        if (reg == NULL) {
+            e = ENOENT;
+            break;
+        }
+        epoll_remove(ep, fd);
+        break;
+    default:
+        e = EINVAL;
+        break;
+    }
+    mtx_unlock(&ep->lock);
+
+    if (io != NULL) {
+        fdio_release(io);
+    }
+    fdio_release(&ep->io);
+    if (e != 0) {
+        return ERRNO(e);
+    }
+    if (status == ZX_ERR_NOT_SUPPORTED) {
+        return ERRNO(EPERM);
+    }
+    return STATUS(status);
+}
+
+// Turns the packet for the registration of |fd| under |key| into an event,
+// and reports whether the registration must be re-armed. Called with
+// |ep->lock| held.
+static bool epoll_handle_packet(fdio_epoll_t* ep, int fd, uint64_t key, fdio_t* io,
+                                zx_signals_t observed, struct epoll_event* events,
+                                uint64_t* keys, int* count) {
+    epoll_reg_t* reg = ep->regs[fd];
+    if (reg != NULL && reg->io != io) {
+        // The descriptor was closed, which ends its registration.
+        epoll_remove(ep, fd);
+        return false;
+    }
+    if (reg == NULL || reg->key != key || reg->disabled) {
+        // Left over from a registration which has since been changed.
+        return false;
+    }
+    bool edge = (reg->event.events & EPOLLET) != 0;
+    if (!edge) {
+        reg->armed = false;
+    }
+
+    uint32_t revents = 0;
+    reg->io->ops->wait_end(reg->io, observed, &revents);
+    revents &= (reg->event.events & ~EPOLL_FLAGS) | EPOLL_ALWAYS;
+    if (revents == 0) {
+        return !edge;
+    }
+    // An edge-triggered descriptor may have several packets queued.
+    for (int i = 0; edge && i < *count; i++) {
+        if (keys[i] == key) {
+            events[i].events |= revents;
+            return false;
+        }
+    }
+    events[*count].events = revents;
+    events[*count].data = reg->event.data;
+    keys[*count] = key;
+    (*count)++;
+    if (reg->event.events & EPOLLONESHOT) {
+        reg->disabled = true;
+        epoll_disarm(ep, reg);
+        return false;
+    }
+    return !edge;
+}
+
+__EXPORT
+int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout,
+                const sigset_t* sigmask) {
+    if (sigmask) {
+        return ERRNO(ENOSYS);
+    }
+    if (maxevents <= 0) {
+        return ERRNO(EINVAL);
+    }
+    fdio_epoll_t* ep = fd_to_epoll(epfd);
+    if (ep == NULL) {
+        return ERRNO(EBADF);
+    }
+    if (maxevents > EPOLL_MAX_PACKETS) {
+        maxevents = EPOLL_MAX_PACKETS;
+    }
+
+    zx_time_t deadline = timeout < 0 ? ZX_TIME_INFINITE : zx_deadline_after(ZX_MSEC(timeout));
+    uint64_t keys[EPOLL_MAX_PACKETS];
+    uint64_t rearm[EPOLL_MAX_PACKETS];
+    int rearm_count = 0;
+    int count = 0;
+    zx_status_t status = ZX_OK;
+    for (int packets = 0; packets < maxevents && count < maxevents; packets++) {
+        zx_port_packet_t packet;
+        // Once anything is to be reported, only take what is already queued.
+        status = zx_port_wait(ep->port, count == 0 ? deadline : 0, &packet);
+        if (status != ZX_OK) {
+            break;
+        }
+        int fd = epoll_key_fd(packet.key);
+        if (fd < 0 || fd >= FDIO_MAX_FD) {
+            continue;
+        }
+        // Looked up before taking the lock, which close() may hold the
+        // descriptor table lock while waiting for.
+        fdio_t* io = fd_to_io(fd);
+        mtx_lock(&ep->lock);
+        if (epoll_handle_packet(ep, fd, packet.key, io, packet.signal.observed, events, keys,
+                                &count)) {
+            rearm[rearm_count++] = packet.key;
+        }
+        mtx_unlock(&ep->lock);
+        if (io != NULL) {
+            fdio_release(io);
+        }
+    }
+
+    // Re-armed only once every packet has been taken, so that a descriptor
+    // which is still ready is not seen twice.
+    mtx_lock(&ep->lock);
+    for (int i = 0; i < rearm_count; i++) {
+        epoll_reg_t* reg = ep->regs[epoll_key_fd(rearm[i])];
+        if (reg != NULL && reg->key == rearm[i] && !reg->armed && !reg->disabled &&
+            epoll_arm(ep, reg) != ZX_OK) {
+            epoll_remove(ep, epoll_key_fd(rearm[i]));
+        }
+    }
+    mtx_unlock(&ep->lock);
+    fdio_release(&ep->io);
+
+    if (count > 0 || status == ZX_OK || status == ZX_ERR_TIMED_OUT) {
+        return count;
+    }
+    return ERROR(status);
+}
+
+__EXPORT
+int epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout) {
+    return epoll_pwait(epfd, events, maxevents, timeout, NULL);
+}
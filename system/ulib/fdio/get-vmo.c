@@ -5,6 +5,8 @@
 #include "private.h"
 #include "unistd.h"
 
+#include <fcntl.h>
+
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
 
@@ -161,3 +163,20 @@ zx_status_t fdio_get_vmo_exact(int fd, zx_handle_t* out_vmo) {
 
     return status;
 }
+
+__EXPORT
+zx_status_t fdio_open_vmo_at(int dirfd, const char* path, zx_handle_t* out_vmo) {
+    // The open is pipelined, so its reply is not waited for: the request for
+    // the vmo follows it on the same channel, and is answered once the open
+    // has been served.
+    fdio_t* io;
+    zx_status_t status = __fdio_open_at(&io, dirfd, path, O_RDONLY | O_PIPELINE, 0);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = get_file_vmo(io, out_vmo);
+    fdio_close(io);
+    fdio_release(io);
+    // A pipelined open which fails closes the channel without saying why.
+    return status == ZX_ERR_PEER_CLOSED ? ZX_ERR_NOT_FOUND : status;
+}
@@ -61,6 +61,14 @@ zx_status_t fdio_get_vmo_clone(int fd, zx_handle_t* out_vmo);
 // or clone data into a new VMO).
 zx_status_t fdio_get_vmo_exact(int fd, zx_handle_t* out_vmo);
 
+// Opens |path|, relative to |dirfd|, and gets a read-only VMO containing a
+// clone of its underlying VMO, as fdio_get_vmo_clone would. The open is
+// pipelined with the request for the VMO, so this takes a single round trip
+// to the file system server. No file descriptor is created.
+//
+// Returns ZX_ERR_NOT_FOUND if |path| cannot be opened.
+zx_status_t fdio_open_vmo_at(int dirfd, const char* path, zx_handle_t* out_vmo);
+
 // create a fd that is backed by the given range of the vmo.
 // This function takes ownership of the vmo and will close the vmo when the fd
 // is closed.
@@ -81,4 +81,20 @@ typedef struct vdirent {
     char name[0];
 } __PACKED vdirent_t;
 
+// An entry returned by ReadDirentsPlus: a vdirent_t followed by the
+// attributes of the entry's node, ahead of its name. The attributes are zeroed,
+// except for |mode|, if the node could not be queried.
+typedef struct vdirent_plus {
+    uint64_t ino;
+    uint8_t size;
+    uint8_t type;
+    uint32_t mode;
+    uint64_t content_size;
+    uint64_t storage_size;
+    uint64_t link_count;
+    uint64_t creation_time;
+    uint64_t modification_time;
+    char name[0];
+} __PACKED vdirent_plus_t;
+
 __END_CDECLS
@@ -217,7 +217,11 @@ typedef struct {
     mode_t umask;
     fdio_t* root;
     fdio_t* cwd;
-    fdio_t* fdtab[FDIO_MAX_FD];
+    // Entries are only changed with |lock| held, but are looked up without
+    // it. See fdio_fdtab_quiesce.
+    fdio_t* _Atomic fdtab[FDIO_MAX_FD];
+    // The number of lookups of each entry in progress.
+    atomic_uint fdtab_lookups[FDIO_MAX_FD];
     fdio_ns_t* ns;
     char cwd_path[PATH_MAX];
 } fdio_state_t;
@@ -230,9 +234,17 @@ extern fdio_state_t __fdio_global_state;
 #define fdio_cwd_lock (__fdio_global_state.cwd_lock)
 #define fdio_cwd_path (__fdio_global_state.cwd_path)
 #define fdio_fdtab (__fdio_global_state.fdtab)
+#define fdio_fdtab_lookups (__fdio_global_state.fdtab_lookups)
 #define fdio_root_init (__fdio_global_state.init)
 #define fdio_root_ns (__fdio_global_state.ns)
 
+// Waits for any lookup of |fd| which might have seen its previous entry to
+// finish. This must be called after an entry is removed from the fdtab and
+// before the reference the fdtab held on it is released, so that a lookup
+// never takes a reference on an fdio_t that has been freed. Callers drop
+// fdio_lock first so that other fd operations don't wait on it too.
+void fdio_fdtab_quiesce(int fd);
+
 
 // Enable low level debug chatter, which requires a kernel that
 // doesn't check the resource argument to zx_debuglog_create()
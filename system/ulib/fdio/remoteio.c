@@ -366,10 +366,10 @@ static zx_status_t fdio_from_handles(zx_handle_t handle, zxrio_node_info_t* info
         return ZX_OK;
     case fuchsia_io_NodeInfoTag_file:
         if (info->file.e == ZX_HANDLE_INVALID) {
-            io = fdio_remote_create(handle, 0);
+            io = fdio_zxio_create_file(handle, 0);
             xprintf("rio (%x,%x) -> %p\n", handle, 0, io);
         } else {
-            io = fdio_remote_create(handle, info->file.e);
+            io = fdio_zxio_create_file(handle, info->file.e);
             xprintf("rio (%x,%x) -> %p\n", handle, info->file.e, io);
         }
         if (io == NULL) {
@@ -89,10 +89,12 @@ zx_status_t fdio_get_service_handle(int fd, zx_handle_t* out) {
         // still alive in other fdtab slots
         // this fd goes away but we can't give away the handle
         mtx_unlock(&fdio_lock);
+        fdio_fdtab_quiesce(fd);
         fdio_release(io);
         return ZX_ERR_UNAVAILABLE;
     } else {
         mtx_unlock(&fdio_lock);
+        fdio_fdtab_quiesce(fd);
         zx_status_t r;
         if (io->ops == &zx_svc_ops) {
             // is an unknown service, extract handle
@@ -62,7 +62,8 @@ fdio_state_t __fdio_global_state = {
 // fdtab prior to binding.
 __EXPORT
 int fdio_bind_to_fd(fdio_t* io, int fd, int starting_fd) {
-    fdio_t* io_to_close = NULL;
+    fdio_t* io_to_release = NULL;
+    bool close_released = false;
 
     mtx_lock(&fdio_lock);
     LOG(1, "fdio: bind_to_fd(%p, %d, %d)\n", io, fd, starting_fd);
@@ -89,16 +90,13 @@ int fdio_bind_to_fd(fdio_t* io, int fd, int starting_fd) {
         mtx_unlock(&fdio_lock);
         return -1;
     } else {
-        io_to_close = fdio_fdtab[fd];
-        if (io_to_close) {
-            io_to_close->dupcount--;
+        io_to_release = fdio_fdtab[fd];
+        if (io_to_release) {
+            io_to_release->dupcount--;
             LOG(1, "fdio: bind_to_fd: closed fd=%d, io=%p, dupcount=%d\n",
-                fd, io_to_close, io_to_close->dupcount);
-            if (io_to_close->dupcount > 0) {
-                // still alive in another fdtab slot
-                fdio_release(io_to_close);
-                io_to_close = NULL;
-            }
+                fd, io_to_release, io_to_release->dupcount);
+            // Only close it if it is not still alive in another fdtab slot.
+            close_released = io_to_release->dupcount == 0;
         }
     }
 
@@ -108,9 +106,12 @@ free_fd_found:
     fdio_fdtab[fd] = io;
     mtx_unlock(&fdio_lock);
 
-    if (io_to_close) {
-        io_to_close->ops->close(io_to_close);
-        fdio_release(io_to_close);
+    if (io_to_release) {
+        fdio_fdtab_quiesce(fd);
+        if (close_released) {
+            io_to_release->ops->close(io_to_release);
+        }
+        fdio_release(io_to_release);
     }
     return fd;
 }
@@ -137,33 +138,70 @@ zx_status_t fdio_unbind_from_fd(int fd, fdio_t** out) {
         status = ZX_ERR_UNAVAILABLE;
         goto done;
     }
-    if (atomic_load(&io->refcount) > 1) {
+    // Take over the fdtab's reference, which only works if nobody else holds
+    // one. Lookups which see the entry from here on fail to take a reference,
+    // so the fd is unbound as of this exchange and the entry never has to be
+    // put back.
+    int_fast32_t expected = 1;
+    if (!atomic_compare_exchange_strong(&io->refcount, &expected, 0)) {
         status = ZX_ERR_UNAVAILABLE;
         goto done;
     }
-    io->dupcount = 0;
     fdio_fdtab[fd] = NULL;
+    io->dupcount = 0;
+    mtx_unlock(&fdio_lock);
+
+    // A lookup which saw the entry would take a reference as soon as the
+    // count is restored, so wait for those to finish first.
+    fdio_fdtab_quiesce(fd);
+    atomic_store(&io->refcount, 1);
     *out = io;
-    status = ZX_OK;
+    return ZX_OK;
 done:
     mtx_unlock(&fdio_lock);
     return status;
 }
 
+// Takes a reference on |io| unless fdio_unbind_from_fd() has taken over
+// the fdtab's reference, leaving none.
+static bool fdio_fdtab_acquire(fdio_t* io) {
+    int_fast32_t count = atomic_load(&io->refcount);
+    do {
+        if (count == 0) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&io->refcount, &count, count + 1));
+    LOG(6, "fdio: acquire: %p\n", io);
+    return true;
+}
+
+// Every read and write looks up its fd, so lookups take no lock. A lookup
+// counts itself in fdio_fdtab_lookups before it loads the entry, and a
+// thread removing the entry waits for that count to drain before dropping
+// the fdtab's reference. Either the lookup is counted by the time the
+// remover checks, or it starts after the entry is gone.
 __EXPORT
 fdio_t* fdio_unsafe_fd_to_io(int fd) {
     if ((fd < 0) || (fd >= FDIO_MAX_FD)) {
         return NULL;
     }
-    fdio_t* io = NULL;
-    mtx_lock(&fdio_lock);
-    if ((io = fdio_fdtab[fd]) != NULL) {
-        fdio_acquire(io);
+    atomic_fetch_add(&fdio_fdtab_lookups[fd], 1);
+    fdio_t* io = fdio_fdtab[fd];
+    if ((io != NULL) && !fdio_fdtab_acquire(io)) {
+        io = NULL;
     }
-    mtx_unlock(&fdio_lock);
+    atomic_fetch_sub(&fdio_fdtab_lookups[fd], 1);
     return io;
 }
 
+void fdio_fdtab_quiesce(int fd) {
+    // A lookup only loads an entry and takes a reference, so this rarely
+    // waits, and then only while the thread doing it is preempted.
+    while (atomic_load(&fdio_fdtab_lookups[fd]) != 0) {
+        zx_nanosleep(0);
+    }
+}
+
 zx_status_t fdio_close(fdio_t* io) {
     if (io->dupcount > 0) {
         LOG(1, "fdio: close(%p): nonzero dupcount!\n", io);
@@ -695,6 +733,7 @@ void __libc_extensions_fini(void) __TA_ACQUIRE(&fdio_lock) {
         fdio_t* io = fdio_fdtab[fd];
         if (io) {
             fdio_fdtab[fd] = NULL;
+            fdio_fdtab_quiesce(fd);
             io->dupcount--;
             if (io->dupcount == 0) {
                 io->ops->close(io);
@@ -1125,10 +1164,12 @@ int close(int fd) {
     if (io->dupcount > 0) {
         // still alive in other fdtab slots
         mtx_unlock(&fdio_lock);
+        fdio_fdtab_quiesce(fd);
         fdio_release(io);
         return ZX_OK;
     } else {
         mtx_unlock(&fdio_lock);
+        fdio_fdtab_quiesce(fd);
         int r = io->ops->close(io);
         fdio_release(io);
         return STATUS(r);
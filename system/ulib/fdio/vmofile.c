@@ -145,7 +145,18 @@ static zx_status_t vmofile_get_vmo(fdio_t* io, int flags, zx_handle_t* out) {
                 ZX_RIGHT_MAP;
         rights |= (flags & FDIO_MMAP_FLAG_READ) ? ZX_RIGHT_READ : 0;
         rights |= (flags & FDIO_MMAP_FLAG_WRITE) ? ZX_RIGHT_WRITE : 0;
-        rights |= (flags & FDIO_MMAP_FLAG_EXEC) ? ZX_RIGHT_EXECUTE : 0;
+        if (flags & FDIO_MMAP_FLAG_EXEC) {
+            // Exact requests ask for execute in case the file is code, but
+            // data files are served without it, so only pass it on if the
+            // file has it.
+            zx_info_handle_basic_t info;
+            zx_status_t status = zx_object_get_info(vf->vmo, ZX_INFO_HANDLE_BASIC,
+                                                    &info, sizeof(info), NULL, NULL);
+            if (status != ZX_OK) {
+                return status;
+            }
+            rights |= info.rights & ZX_RIGHT_EXECUTE;
+        }
         return zx_handle_duplicate(vf->vmo, rights, out);
     }
 }
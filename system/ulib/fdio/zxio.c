@@ -7,8 +7,10 @@
 #include <poll.h>
 #include <stdatomic.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <threads.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
 
@@ -385,6 +387,542 @@ fdio_t* fdio_zxio_create_remote(zx_handle_t control, zx_handle_t event) {
     return &fv->io;
 }
 
+// File ------------------------------------------------------------------------
+
+// A remote file which, once it is being read, asks the server for a buffer:
+// a vmo shared with the server, which holds the contents of the file. Reads
+// are then copied straight out of the vmo, without sending any message.
+//
+// Reads through the buffer move a seek offset kept here, which is handed back
+// to the server before anything that uses the server's own.
+//
+// Small writes are combined, and sent to the server in one message once they
+// fill FDIO_CHUNK_SIZE bytes, before any other operation on the file, or by
+// the flusher thread no more than FILE_WRITE_DELAY after the first of them.
+// A write which is combined always succeeds. If sending it fails, the error
+// is reported by the next write, sync or close of the file.
+typedef struct fdio_zxio_file fdio_zxio_file_t;
+struct fdio_zxio_file {
+    fdio_t io;
+    zxio_remote_t remote;
+
+    mtx_t lock;
+    // The reads seen before the server was asked for a buffer.
+    uint32_t reads;
+    // Whether the server has been asked for a buffer, and if so, whether it
+    // had one to give.
+    enum {
+        FILE_BUFFER_UNTRIED,
+        FILE_BUFFER_NONE,
+        FILE_BUFFER_READY,
+    } buffer;
+    zx_handle_t vmo;
+    // Signalled with ZX_USER_SIGNAL_0 by the server when |size| is stale.
+    zx_handle_t size_changed;
+    uint64_t size;
+    // Only tracked with a buffer. While |offset_valid|, |offset| is the seek
+    // offset, and the server's lags behind it while |offset_dirty|.
+    bool offset_valid;
+    bool offset_dirty;
+    uint64_t offset;
+    // The combined writes, allocated by the first of them.
+    uint8_t* write_buffer;
+    size_t write_len;
+    // The first error from sending combined writes, not yet reported.
+    zx_status_t write_status;
+    // Whether the file is queued on the flusher thread, which holds a
+    // reference to it while it is.
+    bool flush_queued;
+    // Guarded by |flusher.lock|.
+    zx_time_t flush_deadline;
+    fdio_zxio_file_t* flush_next;
+};
+
+static_assert(offsetof(fdio_zxio_t, zio) == offsetof(fdio_zxio_file_t, remote.io),
+              "fdio_zxio_file_t layout must match fdio_zxio_t");
+
+// Asks the server for a buffer once the file is read enough for it to pay
+// for the extra round trip: by a read of several messages' worth, or by a
+// second read. Called with |file->lock| held.
+static void file_get_buffer(fdio_zxio_file_t* file, size_t len) {
+    if (file->buffer != FILE_BUFFER_UNTRIED) {
+        return;
+    }
+    if (len <= FDIO_CHUNK_SIZE && ++file->reads < 2) {
+        return;
+    }
+    zx_handle_t vmo = ZX_HANDLE_INVALID;
+    zx_handle_t size_changed = ZX_HANDLE_INVALID;
+    uint64_t size = 0;
+    zx_status_t io_status, status;
+    io_status = fuchsia_io_FileGetBuffer(file->remote.control, &status, &vmo, &size,
+                                         &size_changed);
+    if (io_status != ZX_OK || status != ZX_OK || vmo == ZX_HANDLE_INVALID ||
+        size_changed == ZX_HANDLE_INVALID) {
+        zx_handle_close(vmo);
+        zx_handle_close(size_changed);
+        file->buffer = FILE_BUFFER_NONE;
+        return;
+    }
+    file->vmo = vmo;
+    file->size_changed = size_changed;
+    file->size = size;
+    file->buffer = FILE_BUFFER_READY;
+}
+
+// Copies up to |len| bytes at |off| out of the buffer, refreshing the size of
+// the file first if the server says it changed. Called with |file->lock| held.
+static zx_status_t file_buffer_read(fdio_zxio_file_t* file, void* data, size_t len,
+                                    uint64_t off, size_t* out_actual) {
+    zx_signals_t pending = 0;
+    if (zx_object_wait_one(file->size_changed, ZX_USER_SIGNAL_0, 0, &pending) == ZX_OK) {
+        // Cleared before asking, so that a change racing with the question
+        // is noticed by the next read.
+        zx_status_t status = zx_object_signal(file->size_changed, ZX_USER_SIGNAL_0, 0);
+        if (status != ZX_OK) {
+            return status;
+        }
+        fuchsia_io_NodeAttributes attr;
+        zx_status_t io_status = fuchsia_io_NodeGetAttr(file->remote.control, &status, &attr);
+        if (io_status != ZX_OK) {
+            return io_status;
+        }
+        if (status != ZX_OK) {
+            return status;
+        }
+        file->size = attr.content_size;
+    }
+    if (off >= file->size) {
+        *out_actual = 0;
+        return ZX_OK;
+    }
+    if (len > file->size - off) {
+        len = file->size - off;
+    }
+    zx_status_t status = zx_vmo_read(file->vmo, data, off, len);
+    if (status != ZX_OK) {
+        return status;
+    }
+    *out_actual = len;
+    return ZX_OK;
+}
+
+// Hands the seek offset moved by reads through the buffer back to the
+// server. Called with |file->lock| held.
+static zx_status_t file_sync_offset(fdio_zxio_file_t* file) {
+    if (!file->offset_dirty) {
+        return ZX_OK;
+    }
+    size_t result = 0u;
+    zx_status_t status = zxio_seek(&file->remote.io, file->offset, SEEK_SET, &result);
+    if (status != ZX_OK) {
+        return status;
+    }
+    file->offset_dirty = false;
+    return ZX_OK;
+}
+
+// Combined writes are sent no later than this after the first of them.
+#define FILE_WRITE_DELAY ZX_MSEC(10)
+
+// The thread which sends combined writes whose deadline has passed. Files
+// are queued in the order of their deadlines, which are all the same delay
+// after they were queued.
+static struct {
+    once_flag once;
+    bool started;
+    mtx_t lock;
+    cnd_t queued;
+    fdio_zxio_file_t* head;
+    fdio_zxio_file_t* tail;
+} flusher = {
+    .once = ONCE_FLAG_INIT,
+};
+
+// Sends the combined writes to the server. A failure is kept, to be reported
+// by the next write, sync or close. Called with |file->lock| held.
+static void file_write_back(fdio_zxio_file_t* file) {
+    zx_status_t status = ZX_OK;
+    for (size_t done = 0; done < file->write_len;) {
+        size_t actual = 0;
+        status = zxio_write(&file->remote.io, file->write_buffer + done,
+                            file->write_len - done, &actual);
+        if (status == ZX_OK && actual == 0) {
+            status = ZX_ERR_IO;
+        }
+        if (status != ZX_OK) {
+            break;
+        }
+        done += actual;
+    }
+    // On failure, the rest of the data is dropped, as it would have been by
+    // the write that failed.
+    file->write_len = 0;
+    if (file->write_status == ZX_OK) {
+        file->write_status = status;
+    }
+}
+
+// Sends the combined writes, and returns any error from sending them or
+// earlier ones. Called with |file->lock| held.
+static zx_status_t file_write_status(fdio_zxio_file_t* file) {
+    file_write_back(file);
+    zx_status_t status = file->write_status;
+    file->write_status = ZX_OK;
+    return status;
+}
+
+static int file_flusher(void* arg) {
+    mtx_lock(&flusher.lock);
+    for (;;) {
+        while (flusher.head == NULL) {
+            cnd_wait(&flusher.queued, &flusher.lock);
+        }
+        // Only this thread takes files off the queue, and any queued behind
+        // this one have later deadlines.
+        fdio_zxio_file_t* file = flusher.head;
+        zx_time_t deadline = file->flush_deadline;
+        mtx_unlock(&flusher.lock);
+        zx_nanosleep(deadline);
+
+        mtx_lock(&flusher.lock);
+        flusher.head = file->flush_next;
+        if (flusher.head == NULL) {
+            flusher.tail = NULL;
+        }
+        mtx_unlock(&flusher.lock);
+
+        mtx_lock(&file->lock);
+        file_write_back(file);
+        file->flush_queued = false;
+        mtx_unlock(&file->lock);
+        fdio_release(&file->io);
+        mtx_lock(&flusher.lock);
+    }
+    return 0;
+}
+
+static void file_flusher_start(void) {
+    if (mtx_init(&flusher.lock, mtx_plain) != thrd_success) {
+        return;
+    }
+    if (cnd_init(&flusher.queued) != thrd_success) {
+        mtx_destroy(&flusher.lock);
+        return;
+    }
+    thrd_t thread;
+    if (thrd_create_with_name(&thread, file_flusher, NULL, "fdio-flusher") != thrd_success) {
+        cnd_destroy(&flusher.queued);
+        mtx_destroy(&flusher.lock);
+        return;
+    }
+    thrd_detach(thread);
+    flusher.started = true;
+}
+
+// Queues |file| on the flusher thread, unless it already is. Returns false if
+// there is no flusher thread. Called with |file->lock| held.
+static bool file_queue_flush(fdio_zxio_file_t* file) {
+    if (file->flush_queued) {
+        return true;
+    }
+    call_once(&flusher.once, file_flusher_start);
+    if (!flusher.started) {
+        return false;
+    }
+    file->flush_queued = true;
+    fdio_acquire(&file->io);
+    mtx_lock(&flusher.lock);
+    file->flush_deadline = zx_deadline_after(FILE_WRITE_DELAY);
+    file->flush_next = NULL;
+    if (flusher.tail == NULL) {
+        flusher.head = file;
+        cnd_signal(&flusher.queued);
+    } else {
+        flusher.tail->flush_next = file;
+    }
+    flusher.tail = file;
+    mtx_unlock(&flusher.lock);
+    return true;
+}
+
+// Adds a write of |len| bytes to the combined writes, if there is room for
+// it. Called with |file->lock| held.
+static bool file_combine_write(fdio_zxio_file_t* file, const void* data, size_t len) {
+    if (len == 0 || len >= FDIO_CHUNK_SIZE || len > FDIO_CHUNK_SIZE - file->write_len) {
+        return false;
+    }
+    if (file->write_len == 0) {
+        if (file->write_buffer == NULL &&
+            (file->write_buffer = malloc(FDIO_CHUNK_SIZE)) == NULL) {
+            return false;
+        }
+        if (file_sync_offset(file) != ZX_OK || !file_queue_flush(file)) {
+            return false;
+        }
+    }
+    memcpy(file->write_buffer + file->write_len, data, len);
+    file->write_len += len;
+    return true;
+}
+
+static void file_release_buffer(fdio_zxio_file_t* file) {
+    zx_handle_close(file->vmo);
+    zx_handle_close(file->size_changed);
+    file->vmo = ZX_HANDLE_INVALID;
+    file->size_changed = ZX_HANDLE_INVALID;
+    file->buffer = FILE_BUFFER_NONE;
+    file->offset_valid = false;
+}
+
+static zx_status_t fdio_zxio_file_close(fdio_t* io) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    zx_status_t write_status = file_write_status(file);
+    file_release_buffer(file);
+    free(file->write_buffer);
+    file->write_buffer = NULL;
+    mtx_unlock(&file->lock);
+    zx_status_t status = fdio_zxio_close(io);
+    return write_status != ZX_OK ? write_status : status;
+}
+
+static ssize_t fdio_zxio_file_read(fdio_t* io, void* data, size_t len) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    file_write_back(file);
+    file_get_buffer(file, len);
+    if (file->buffer != FILE_BUFFER_READY) {
+        mtx_unlock(&file->lock);
+        return fdio_zxio_read(io, data, len);
+    }
+    zx_status_t status = ZX_OK;
+    if (!file->offset_valid) {
+        size_t result = 0u;
+        if ((status = zxio_seek(&file->remote.io, 0, SEEK_CUR, &result)) == ZX_OK) {
+            file->offset = result;
+            file->offset_valid = true;
+        }
+    }
+    size_t actual = 0;
+    if (status == ZX_OK &&
+        (status = file_buffer_read(file, data, len, file->offset, &actual)) == ZX_OK &&
+        actual != 0) {
+        file->offset += actual;
+        file->offset_dirty = true;
+    }
+    mtx_unlock(&file->lock);
+    return status != ZX_OK ? status : (ssize_t)actual;
+}
+
+static ssize_t fdio_zxio_file_read_at(fdio_t* io, void* data, size_t len, off_t at) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    if (at < 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    mtx_lock(&file->lock);
+    file_write_back(file);
+    file_get_buffer(file, len);
+    if (file->buffer != FILE_BUFFER_READY) {
+        mtx_unlock(&file->lock);
+        return fdio_zxio_read_at(io, data, len, at);
+    }
+    size_t actual = 0;
+    zx_status_t status = file_buffer_read(file, data, len, at, &actual);
+    mtx_unlock(&file->lock);
+    return status != ZX_OK ? status : (ssize_t)actual;
+}
+
+static ssize_t fdio_zxio_file_write(fdio_t* io, const void* data, size_t len) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    // How far the server moves the offset depends on whether the file is in
+    // append mode, so it is asked again by the next read.
+    file->offset_valid = false;
+    ssize_t r;
+    zx_status_t status;
+    if (len > FDIO_CHUNK_SIZE - file->write_len) {
+        status = file_write_status(file);
+    } else {
+        status = file->write_status;
+        file->write_status = ZX_OK;
+    }
+    if (status != ZX_OK) {
+        r = status;
+    } else if (file_combine_write(file, data, len)) {
+        r = (ssize_t)len;
+    } else if ((status = file_write_status(file)) != ZX_OK ||
+               (status = file_sync_offset(file)) != ZX_OK) {
+        r = status;
+    } else {
+        r = fdio_zxio_write(io, data, len);
+    }
+    mtx_unlock(&file->lock);
+    return r;
+}
+
+static ssize_t fdio_zxio_file_write_at(fdio_t* io, const void* data, size_t len, off_t at) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    zx_status_t status = file_write_status(file);
+    mtx_unlock(&file->lock);
+    return status != ZX_OK ? status : fdio_zxio_write_at(io, data, len, at);
+}
+
+static off_t fdio_zxio_file_seek(fdio_t* io, off_t offset, int whence) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    off_t r;
+    if (file->offset_valid && (whence == SEEK_SET || whence == SEEK_CUR)) {
+        // Checked as the server would.
+        uint64_t base = (whence == SEEK_SET) ? 0 : file->offset;
+        uint64_t n = base + offset;
+        if ((offset < 0 && n > base) || (offset >= 0 && n < base) || n > INT64_MAX) {
+            r = ZX_ERR_INVALID_ARGS;
+        } else {
+            file->offset = n;
+            file->offset_dirty = true;
+            r = (off_t)n;
+        }
+    } else {
+        file_write_back(file);
+        zx_status_t status = file_sync_offset(file);
+        r = status != ZX_OK ? status : fdio_zxio_seek(io, offset, whence);
+        if (r >= 0 && file->buffer == FILE_BUFFER_READY) {
+            file->offset = r;
+            file->offset_valid = true;
+        }
+    }
+    mtx_unlock(&file->lock);
+    return r;
+}
+
+static zx_status_t fdio_zxio_file_unwrap(fdio_t* io, zx_handle_t* handles, uint32_t* types) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    // The seek offset travels with the channel, and so must the writes.
+    mtx_lock(&file->lock);
+    zx_status_t status = file_write_status(file);
+    if (status == ZX_OK) {
+        status = file_sync_offset(file);
+    }
+    if (status == ZX_OK) {
+        file_release_buffer(file);
+    }
+    mtx_unlock(&file->lock);
+    if (status != ZX_OK) {
+        return status;
+    }
+    return fdio_zxio_remote_unwrap(io, handles, types);
+}
+
+// Sends the combined writes before an operation which could see them.
+static void file_write_back_locked(fdio_t* io) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    file_write_back(file);
+    mtx_unlock(&file->lock);
+}
+
+static zx_status_t fdio_zxio_file_clone(fdio_t* io, zx_handle_t* handles, uint32_t* types) {
+    file_write_back_locked(io);
+    return fdio_zxio_remote_clone(io, handles, types);
+}
+
+static ssize_t fdio_zxio_file_ioctl(fdio_t* io, uint32_t op, const void* in_buf,
+                                    size_t in_len, void* out_buf, size_t out_len) {
+    file_write_back_locked(io);
+    return fdio_zxio_remote_ioctl(io, op, in_buf, in_len, out_buf, out_len);
+}
+
+static zx_status_t fdio_zxio_file_get_vmo(fdio_t* io, int flags, zx_handle_t* out_vmo) {
+    file_write_back_locked(io);
+    return fdio_zxio_remote_get_vmo(io, flags, out_vmo);
+}
+
+static zx_status_t fdio_zxio_file_get_attr(fdio_t* io, vnattr_t* out) {
+    file_write_back_locked(io);
+    return fdio_zxio_get_attr(io, out);
+}
+
+static zx_status_t fdio_zxio_file_set_attr(fdio_t* io, const vnattr_t* vnattr) {
+    file_write_back_locked(io);
+    return fdio_zxio_set_attr(io, vnattr);
+}
+
+static zx_status_t fdio_zxio_file_sync(fdio_t* io) {
+    fdio_zxio_file_t* file = (fdio_zxio_file_t*)io;
+    mtx_lock(&file->lock);
+    zx_status_t status = file_write_status(file);
+    mtx_unlock(&file->lock);
+    return status != ZX_OK ? status : fdio_zxio_sync(io);
+}
+
+static zx_status_t fdio_zxio_file_truncate(fdio_t* io, off_t off) {
+    file_write_back_locked(io);
+    return fdio_zxio_truncate(io, off);
+}
+
+static zx_status_t fdio_zxio_file_set_flags(fdio_t* io, uint32_t flags) {
+    file_write_back_locked(io);
+    return fdio_zxio_set_flags(io, flags);
+}
+
+static fdio_ops_t fdio_zxio_file_ops = {
+    .read = fdio_zxio_file_read,
+    .read_at = fdio_zxio_file_read_at,
+    .write = fdio_zxio_file_write,
+    .write_at = fdio_zxio_file_write_at,
+    .seek = fdio_zxio_file_seek,
+    .misc = fdio_default_misc,
+    .close = fdio_zxio_file_close,
+    .open = fdio_zxio_remote_open,
+    .clone = fdio_zxio_file_clone,
+    .ioctl = fdio_zxio_file_ioctl,
+    .wait_begin = fdio_zxio_remote_wait_begin,
+    .wait_end = fdio_zxio_remote_wait_end,
+    .unwrap = fdio_zxio_file_unwrap,
+    .posix_ioctl = fdio_default_posix_ioctl,
+    .get_vmo = fdio_zxio_file_get_vmo,
+    .get_token = fdio_zxio_remote_get_token,
+    .get_attr = fdio_zxio_file_get_attr,
+    .set_attr = fdio_zxio_file_set_attr,
+    .sync = fdio_zxio_file_sync,
+    .readdir = fdio_zxio_remote_readdir,
+    .rewind = fdio_zxio_remote_rewind,
+    .unlink = fdio_zxio_remote_unlink,
+    .truncate = fdio_zxio_file_truncate,
+    .rename = fdio_zxio_remote_rename,
+    .link = fdio_zxio_remote_link,
+    .get_flags = fdio_zxio_get_flags,
+    .set_flags = fdio_zxio_file_set_flags,
+    .recvfrom = fdio_default_recvfrom,
+    .sendto = fdio_default_sendto,
+    .recvmsg = fdio_default_recvmsg,
+    .sendmsg = fdio_default_sendmsg,
+    .shutdown = fdio_default_shutdown,
+};
+
+fdio_t* fdio_zxio_create_file(zx_handle_t control, zx_handle_t event) {
+    fdio_zxio_file_t* file = fdio_alloc(sizeof(fdio_zxio_file_t));
+    if (file == NULL) {
+        zx_handle_close(control);
+        zx_handle_close(event);
+        return NULL;
+    }
+    file->io.ops = &fdio_zxio_file_ops;
+    file->io.magic = FDIO_MAGIC;
+    atomic_init(&file->io.refcount, 1);
+    mtx_init(&file->lock, mtx_plain);
+    file->buffer = FILE_BUFFER_UNTRIED;
+    file->vmo = ZX_HANDLE_INVALID;
+    file->size_changed = ZX_HANDLE_INVALID;
+    zx_status_t status = zxio_remote_init(&file->remote, control, event);
+    if (status != ZX_OK) {
+        return NULL;
+    }
+    return &file->io;
+}
+
 // Pipe ------------------------------------------------------------------------
 
 // Implements the |fdio_t| contract using |zxio_pipe_t|.
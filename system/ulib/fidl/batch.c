@@ -0,0 +1,55 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <lib/fidl/batch.h>
+
+bool fidl_is_batch(const fidl_msg_t* msg) {
+    if (msg->num_bytes < sizeof(fidl_message_header_t)) {
+        return false;
+    }
+    const fidl_message_header_t* hdr = (const fidl_message_header_t*)msg->bytes;
+    return hdr->ordinal == FIDL_BATCH_ORDINAL;
+}
+
+void fidl_batch_iterator_init(fidl_batch_iterator_t* iter, const fidl_msg_t* batch) {
+    iter->batch = batch;
+    iter->byte_offset = sizeof(fidl_message_header_t);
+    iter->handle_offset = 0u;
+}
+
+zx_status_t fidl_batch_next(fidl_batch_iterator_t* iter, fidl_msg_t* out) {
+    const fidl_msg_t* batch = iter->batch;
+    uint32_t remaining = batch->num_bytes - iter->byte_offset;
+    if (remaining == 0u) {
+        // Every handle must belong to one of the messages.
+        return iter->handle_offset == batch->num_handles ? ZX_ERR_STOP : ZX_ERR_INVALID_ARGS;
+    }
+    if (remaining < sizeof(fidl_batch_record_t)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fidl_batch_record_t record;
+    uint8_t* bytes = (uint8_t*)batch->bytes + iter->byte_offset;
+    memcpy(&record, bytes, sizeof(record));
+    remaining -= sizeof(record);
+    if (record.num_bytes < sizeof(fidl_message_header_t) || record.num_bytes > remaining ||
+        record.num_handles > batch->num_handles - iter->handle_offset) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    // The last message need not be padded.
+    uint32_t padded = (uint32_t)FIDL_ALIGN((uint64_t)record.num_bytes);
+    if (padded > remaining) {
+        padded = remaining;
+    }
+
+    out->bytes = bytes + sizeof(record);
+    out->num_bytes = record.num_bytes;
+    out->handles = batch->handles + iter->handle_offset;
+    out->num_handles = record.num_handles;
+    iter->byte_offset += (uint32_t)sizeof(record) + padded;
+    iter->handle_offset += record.num_handles;
+    return ZX_OK;
+}
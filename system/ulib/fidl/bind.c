@@ -3,17 +3,32 @@
 // found in the LICENSE file.
 
 #include <lib/async/wait.h>
+#include <lib/fidl/batch.h>
 #include <lib/fidl/bind.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 #include <zircon/syscalls.h>
 
+// A batch whose messages are still being dispatched. It outlives the read
+// which produced it when one of its messages is handled asynchronously, in
+// which case |fidl_async_txn_complete| dispatches the rest.
+typedef struct fidl_pending_batch {
+    // One for the binding, and one for each dispatch call still reading the
+    // bytes of the batch.
+    atomic_int ref_count;
+    fidl_batch_iterator_t iter;
+    fidl_msg_t msg;
+    // Followed by the bytes and then the handles of |msg|.
+} fidl_pending_batch_t;
+
 typedef struct fidl_binding {
     async_wait_t wait;
     fidl_dispatch_t* dispatch;
     async_dispatcher_t* dispatcher;
     void* ctx;
     const void* ops;
+    fidl_pending_batch_t* batch;
 } fidl_binding_t;
 
 typedef struct fidl_connection {
@@ -36,11 +51,92 @@ static zx_status_t fidl_reply(fidl_txn_t* txn, const fidl_msg_t* msg) {
                             msg->handles, msg->num_handles);
 }
 
+static fidl_pending_batch_t* fidl_pending_batch_create(const fidl_msg_t* msg) {
+    size_t bytes_offset = FIDL_ALIGN(sizeof(fidl_pending_batch_t));
+    size_t handles_offset = bytes_offset + FIDL_ALIGN(msg->num_bytes);
+    fidl_pending_batch_t* batch =
+        malloc(handles_offset + msg->num_handles * sizeof(zx_handle_t));
+    if (batch == NULL) {
+        return NULL;
+    }
+    atomic_init(&batch->ref_count, 1);
+    batch->msg.bytes = (char*)batch + bytes_offset;
+    batch->msg.handles = (zx_handle_t*)((char*)batch + handles_offset);
+    batch->msg.num_bytes = msg->num_bytes;
+    batch->msg.num_handles = msg->num_handles;
+    memcpy(batch->msg.bytes, msg->bytes, msg->num_bytes);
+    memcpy(batch->msg.handles, msg->handles, msg->num_handles * sizeof(zx_handle_t));
+    fidl_batch_iterator_init(&batch->iter, &batch->msg);
+    return batch;
+}
+
+static void fidl_pending_batch_release(fidl_pending_batch_t* batch) {
+    if (atomic_fetch_sub(&batch->ref_count, 1) == 1) {
+        free(batch);
+    }
+}
+
+// Detaches the batch from |binding|, dropping the handles of any messages
+// which were not dispatched.
+static void fidl_binding_end_batch(fidl_binding_t* binding) {
+    fidl_pending_batch_t* batch = binding->batch;
+    binding->batch = NULL;
+    zx_handle_close_many(batch->msg.handles + batch->iter.handle_offset,
+                         batch->msg.num_handles - batch->iter.handle_offset);
+    fidl_pending_batch_release(batch);
+}
+
 static void fidl_binding_destroy(fidl_binding_t* binding) {
+    if (binding->batch != NULL) {
+        fidl_binding_end_batch(binding);
+    }
     zx_handle_close(binding->wait.object);
     free(binding);
 }
 
+static zx_status_t fidl_dispatch_message(fidl_binding_t* binding, zx_handle_t channel,
+                                         fidl_msg_t* msg) {
+    fidl_message_header_t* hdr = (fidl_message_header_t*)msg->bytes;
+    fidl_connection_t conn = {
+        .txn.reply = fidl_reply,
+        .channel = channel,
+        .txid = hdr->txid,
+        .binding = binding,
+    };
+    return binding->dispatch(binding->ctx, &conn.txn, msg, binding->ops);
+}
+
+// Dispatches the remaining one-way messages of the batch of |binding|.
+//
+// Returns ZX_ERR_ASYNC if one of them is handled asynchronously. The batch
+// then stays with the binding, and completing that txn with |rebind| set
+// calls this again to carry on with the next message.
+static zx_status_t fidl_dispatch_batch(fidl_binding_t* binding) {
+    fidl_pending_batch_t* batch = binding->batch;
+    zx_status_t status;
+    fidl_msg_t msg;
+    while ((status = fidl_batch_next(&batch->iter, &msg)) == ZX_OK) {
+        if (((fidl_message_header_t*)msg.bytes)->txid != FIDL_TXID_NO_RESPONSE) {
+            status = ZX_ERR_INVALID_ARGS;
+            break;
+        }
+        // The txn may be completed before |dispatch| returns, which can finish
+        // the batch from under |msg|, so hold on to its bytes until then.
+        atomic_fetch_add(&batch->ref_count, 1);
+        status = fidl_dispatch_message(binding, binding->wait.object, &msg);
+        fidl_pending_batch_release(batch);
+        if (status == ZX_ERR_ASYNC) {
+            // |binding| belongs to the async txn now.
+            return status;
+        }
+        if (status != ZX_OK) {
+            break;
+        }
+    }
+    fidl_binding_end_batch(binding);
+    return status == ZX_ERR_STOP ? ZX_OK : status;
+}
+
 static void fidl_message_handler(async_dispatcher_t* dispatcher,
                                  async_wait_t* wait,
                                  zx_status_t status,
@@ -51,7 +147,7 @@ static void fidl_message_handler(async_dispatcher_t* dispatcher,
     }
 
     if (signal->observed & ZX_CHANNEL_READABLE) {
-        char bytes[ZX_CHANNEL_MAX_MSG_BYTES];
+        char bytes[ZX_CHANNEL_MAX_MSG_BYTES] __ALIGNED(FIDL_ALIGNMENT);
         zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
         for (uint64_t i = 0; i < signal->count; i++) {
             fidl_msg_t msg = {
@@ -70,14 +166,16 @@ static void fidl_message_handler(async_dispatcher_t* dispatcher,
             if (status != ZX_OK || msg.num_bytes < sizeof(fidl_message_header_t)) {
                 goto shutdown;
             }
-            fidl_message_header_t* hdr = (fidl_message_header_t*)msg.bytes;
-            fidl_connection_t conn = {
-                .txn.reply = fidl_reply,
-                .channel = wait->object,
-                .txid = hdr->txid,
-                .binding = binding,
-            };
-            status = binding->dispatch(binding->ctx, &conn.txn, &msg, binding->ops);
+            if (fidl_is_batch(&msg)) {
+                binding->batch = fidl_pending_batch_create(&msg);
+                if (binding->batch == NULL) {
+                    zx_handle_close_many(handles, msg.num_handles);
+                    goto shutdown;
+                }
+                status = fidl_dispatch_batch(binding);
+            } else {
+                status = fidl_dispatch_message(binding, wait->object, &msg);
+            }
             switch (status) {
             case ZX_OK:
                 status = async_begin_wait(dispatcher, wait);
@@ -132,16 +230,25 @@ fidl_txn_t* fidl_async_txn_borrow(fidl_async_txn_t* async_txn) {
 }
 
 zx_status_t fidl_async_txn_complete(fidl_async_txn_t* async_txn, bool rebind) {
+    fidl_binding_t* binding = async_txn->connection.binding;
+    free(async_txn);
+
     zx_status_t status = ZX_OK;
     if (rebind) {
-        status = async_begin_wait(async_txn->connection.binding->dispatcher,
-                                  &async_txn->connection.binding->wait);
+        if (binding->batch != NULL) {
+            status = fidl_dispatch_batch(binding);
+            if (status == ZX_ERR_ASYNC) {
+                return ZX_OK;
+            }
+        }
         if (status == ZX_OK) {
-            return ZX_OK;
+            status = async_begin_wait(binding->dispatcher, &binding->wait);
+            if (status == ZX_OK) {
+                return ZX_OK;
+            }
         }
     }
 
-    fidl_binding_destroy(async_txn->connection.binding);
-    free(async_txn);
+    fidl_binding_destroy(binding);
     return status;
 }
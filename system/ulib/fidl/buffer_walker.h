@@ -91,6 +91,14 @@ public:
             return;
         }
 
+        // Most messages without out-of-line data are structs whose coded
+        // fields, if any, are all handles. They are walked directly, without
+        // the frame stack below.
+        if (type_->type_tag == fidl::kFidlTypeStruct && IsFlatStruct(type_->coded_struct)) {
+            WalkFlatStruct(type_->coded_struct);
+            return;
+        }
+
         Push(Frame::DoneSentinel());
         Push(Frame(type_, 0u));
 
@@ -359,29 +367,11 @@ public:
                 continue;
             }
             case Frame::kStateHandle: {
-                auto handle_ptr = TypedAt<zx_handle_t>(frame->offset);
-                // The handle storage may be Absent for nullable handles and must
-                // otherwise be Present. No other values are allowed.
-                switch (GetHandleState(*handle_ptr)) {
-                case HandleState::ABSENT:
-                    if (frame->handle_state.nullable) {
-                        Pop();
-                        continue;
-                    }
-                    SetError("message tried to decode a non-present handle");
-                    FIDL_POP_AND_CONTINUE_OR_RETURN;
-                case HandleState::PRESENT:
-                    if (!ClaimHandle(handle_ptr)) {
-                        SetError("message decoded too many handles");
-                        FIDL_POP_AND_CONTINUE_OR_RETURN;
-                    }
-                    Pop();
-                    continue;
-                default:
-                    // The value at the handle was garbage.
-                    SetError("message tried to decode a garbage handle");
+                if (!WalkHandle(frame->offset, frame->handle_state.nullable)) {
                     FIDL_POP_AND_CONTINUE_OR_RETURN;
                 }
+                Pop();
+                continue;
             }
             case Frame::kStateVector: {
                 auto vector_ptr = TypedAt<fidl_vector_t>(frame->offset);
@@ -448,6 +438,54 @@ protected:
         derived()->SetError(error_msg);
     }
 
+    static bool IsFlatStruct(const fidl::FidlCodedStruct& coded_struct) {
+        for (uint32_t i = 0; i < coded_struct.field_count; i++) {
+            if (coded_struct.fields[i].type->type_tag != fidl::kFidlTypeHandle) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void WalkFlatStruct(const fidl::FidlCodedStruct& coded_struct) {
+        for (uint32_t i = 0; i < coded_struct.field_count; i++) {
+            const fidl::FidlField& field = coded_struct.fields[i];
+            if (!WalkHandle(field.offset, field.type->coded_handle.nullable) &&
+                !kContinueAfterErrors) {
+                return;
+            }
+        }
+        if (out_of_line_offset_ != num_bytes()) {
+            SetError("message did not decode all provided bytes");
+        }
+    }
+
+    // Returns false, having set the error, if the handle at |offset| is not
+    // valid.
+    bool WalkHandle(uint32_t offset, bool nullable) {
+        auto handle_ptr = TypedAt<zx_handle_t>(offset);
+        // The handle storage may be Absent for nullable handles and must
+        // otherwise be Present. No other values are allowed.
+        switch (GetHandleState(*handle_ptr)) {
+        case HandleState::ABSENT:
+            if (nullable) {
+                return true;
+            }
+            SetError("message tried to decode a non-present handle");
+            return false;
+        case HandleState::PRESENT:
+            if (!ClaimHandle(handle_ptr)) {
+                SetError("message decoded too many handles");
+                return false;
+            }
+            return true;
+        default:
+            // The value at the handle was garbage.
+            SetError("message tried to decode a garbage handle");
+            return false;
+        }
+    }
+
     template <typename T>
     typename SetPtrConst<!kMutating, T>::type TypedAt(uint32_t offset) const {
         return reinterpret_cast<typename SetPtrConst<!kMutating, T>::type>(bytes() + offset);
@@ -0,0 +1,40 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_BATCH_H_
+#define LIB_FIDL_BATCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zircon/compiler.h>
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// Iterates over the messages packed into a batch (see FIDL_BATCH_ORDINAL).
+typedef struct fidl_batch_iterator {
+    const fidl_msg_t* batch;
+    uint32_t byte_offset;
+    uint32_t handle_offset;
+} fidl_batch_iterator_t;
+
+// Whether the encoded message |msg| is a batch.
+bool fidl_is_batch(const fidl_msg_t* msg);
+
+// Starts iterating over the messages in |batch|, which must outlive |iter|.
+void fidl_batch_iterator_init(fidl_batch_iterator_t* iter, const fidl_msg_t* batch);
+
+// Points |out| at the bytes and handles of the next message in the batch.
+//
+// Returns ZX_ERR_STOP once every message has been returned, or
+// ZX_ERR_INVALID_ARGS if the batch is malformed. The handles of the messages
+// not yet returned, which the caller must close on error, start at the
+// |handle_offset| of the iterator.
+zx_status_t fidl_batch_next(fidl_batch_iterator_t* iter, fidl_msg_t* out);
+
+__END_CDECLS
+
+#endif // LIB_FIDL_BATCH_H_
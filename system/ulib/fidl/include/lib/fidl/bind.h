@@ -46,6 +46,12 @@ typedef zx_status_t(fidl_dispatch_t)(void* ctx, fidl_txn_t* txn,
 // If a client wishes to reply to the message asynchronously, |fidl_async_txn_create|
 // must be invoked on |fidl_txn_t|, and ZX_ERR_ASYNC must be returned.
 //
+// Batches of messages (see FIDL_BATCH_ORDINAL) are unpacked, and |dispatch| is
+// called for each of their messages in turn, which must all be one-way. If
+// |dispatch| returns ZX_ERR_ASYNC for one of them, the rest of the batch is
+// dispatched when its txn is completed with |rebind| set, before any further
+// messages are read from |channel|.
+//
 // Returns whether |fidl_bind| was able to begin waiting on the given |channel|.
 // Upon any error, |channel| is closed and the binding is terminated. Shutting down
 // the |dispatcher| also results in |channel| being closed.
@@ -80,7 +86,9 @@ fidl_txn_t* fidl_async_txn_borrow(fidl_async_txn_t* async_txn);
 
 // Destroys an asynchronous transaction created with |fidl_async_txn_create|.
 //
-// If requested, rebinds the underlying txn against the binding.
+// If requested, rebinds the underlying txn against the binding. If the txn
+// belongs to a message of a batch, the rest of the batch is dispatched first,
+// on the calling thread.
 // Returns an error if |rebind| is true and the transaction could not be
 // re-bound.
 //
@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_FIDL_CPP_MESSAGE_BATCHER_H_
+#define LIB_FIDL_CPP_MESSAGE_BATCHER_H_
+
+#include <stdint.h>
+
+#include <lib/async/dispatcher.h>
+#include <lib/async/task.h>
+#include <lib/fidl/cpp/message.h>
+#include <lib/fidl/cpp/message_buffer.h>
+#include <zircon/fidl.h>
+#include <zircon/types.h>
+
+namespace fidl {
+
+// Packs small one-way messages written to a channel into batches (see
+// FIDL_BATCH_ORDINAL), which |fidl_bind| unpacks on the other end.
+//
+// Only servers bound with |fidl_bind| can decode batches. Other peers, such
+// as a |fidl::Binding|, see FIDL_BATCH_ORDINAL as an unknown ordinal and close
+// the channel, so only use a batcher on channels served by |fidl_bind|.
+//
+// A batch is written to the channel once the next message does not fit in it,
+// when |Flush| is called, and, if there is a |dispatcher|, no later than
+// |max_delay| after its first message was added.
+//
+// This class is not thread-safe. If there is a |dispatcher|, it must only be
+// used on the thread which runs it.
+class MessageBatcher {
+public:
+    // Creates a |MessageBatcher| which writes to |channel|, which it does not
+    // own, in batches of up to the given capacities.
+    explicit MessageBatcher(
+        zx_handle_t channel,
+        async_dispatcher_t* dispatcher = nullptr,
+        zx_duration_t max_delay = ZX_MSEC(1),
+        uint32_t bytes_capacity = ZX_CHANNEL_MAX_MSG_BYTES,
+        uint32_t handles_capacity = ZX_CHANNEL_MAX_MSG_HANDLES);
+
+    // Flushes the current batch.
+    ~MessageBatcher();
+
+    MessageBatcher(const MessageBatcher& other) = delete;
+    MessageBatcher& operator=(const MessageBatcher& other) = delete;
+
+    // Adds the encoded one-way |message| to the current batch.
+    //
+    // A message which is too large to be batched is written to the channel
+    // on its own, after the current batch. Returns an error from writing any
+    // of them, or ZX_ERR_INVALID_ARGS if |message| expects a response, in
+    // which case it is left as it was.
+    //
+    // Unless this method returns ZX_ERR_INVALID_ARGS, the handles of
+    // |message| are consumed.
+    zx_status_t Write(Message* message);
+
+    // Writes the current batch to the channel, if it has any messages.
+    //
+    // A batch of one message is written as that message.
+    zx_status_t Flush();
+
+    // The number of messages in the current batch.
+    uint32_t pending() const { return count_; }
+
+private:
+    static void HandleDeadline(async_dispatcher_t* dispatcher, async_task_t* task,
+                               zx_status_t status);
+
+    void Reset();
+
+    // Must be the first member, so that HandleDeadline can find the batcher.
+    async_task_t task_;
+    const zx_handle_t channel_;
+    async_dispatcher_t* const dispatcher_;
+    const zx_duration_t max_delay_;
+    MessageBuffer buffer_;
+    uint32_t actual_bytes_;
+    uint32_t actual_handles_;
+    uint32_t count_;
+};
+
+} // namespace fidl
+
+#endif // LIB_FIDL_CPP_MESSAGE_BATCHER_H_
@@ -0,0 +1,120 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fidl/cpp/message_batcher.h>
+
+#include <string.h>
+
+#include <lib/async/time.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace fidl {
+
+MessageBatcher::MessageBatcher(zx_handle_t channel,
+                               async_dispatcher_t* dispatcher,
+                               zx_duration_t max_delay,
+                               uint32_t bytes_capacity,
+                               uint32_t handles_capacity)
+    : task_{{ASYNC_STATE_INIT}, &MessageBatcher::HandleDeadline, ZX_TIME_INFINITE},
+      channel_(channel),
+      dispatcher_(dispatcher),
+      max_delay_(max_delay),
+      buffer_(bytes_capacity, handles_capacity) {
+    ZX_DEBUG_ASSERT(bytes_capacity >= sizeof(fidl_message_header_t));
+    Reset();
+}
+
+MessageBatcher::~MessageBatcher() {
+    Flush();
+}
+
+zx_status_t MessageBatcher::Write(Message* message) {
+    const uint32_t num_bytes = message->bytes().actual();
+    const uint32_t num_handles = message->handles().actual();
+    if (!message->has_header() || message->txid() != FIDL_TXID_NO_RESPONSE) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    const uint64_t record_size = sizeof(fidl_batch_record_t) + FIDL_ALIGN(uint64_t{num_bytes});
+    if (record_size > buffer_.bytes_capacity() - sizeof(fidl_message_header_t) ||
+        num_handles > buffer_.handles_capacity()) {
+        zx_status_t status = Flush();
+        zx_status_t write_status = message->Write(channel_, 0u);
+        return status != ZX_OK ? status : write_status;
+    }
+
+    zx_status_t status = ZX_OK;
+    if (record_size > buffer_.bytes_capacity() - actual_bytes_ ||
+        num_handles > buffer_.handles_capacity() - actual_handles_) {
+        status = Flush();
+    }
+
+    fidl_batch_record_t record = {num_bytes, num_handles};
+    uint8_t* bytes = buffer_.bytes() + actual_bytes_;
+    memcpy(bytes, &record, sizeof(record));
+    memcpy(bytes + sizeof(record), message->bytes().data(), num_bytes);
+    memset(bytes + sizeof(record) + num_bytes, 0, record_size - sizeof(record) - num_bytes);
+    memcpy(buffer_.handles() + actual_handles_, message->handles().data(),
+           num_handles * sizeof(zx_handle_t));
+    message->ClearHandlesUnsafe();
+    actual_bytes_ += static_cast<uint32_t>(record_size);
+    actual_handles_ += num_handles;
+
+    if (count_++ == 0u && dispatcher_ != nullptr) {
+        task_.deadline = async_now(dispatcher_) + max_delay_;
+        zx_status_t post_status = async_post_task(dispatcher_, &task_);
+        if (post_status != ZX_OK) {
+            // Without a deadline, the batch must not be held back.
+            post_status = Flush();
+        }
+        if (status == ZX_OK) {
+            status = post_status;
+        }
+    }
+    return status;
+}
+
+zx_status_t MessageBatcher::Flush() {
+    if (count_ == 0u) {
+        return ZX_OK;
+    }
+    if (dispatcher_ != nullptr) {
+        async_cancel_task(dispatcher_, &task_);
+    }
+
+    zx_status_t status;
+    uint8_t* bytes = buffer_.bytes();
+    if (count_ == 1u) {
+        fidl_batch_record_t record;
+        memcpy(&record, bytes + sizeof(fidl_message_header_t), sizeof(record));
+        status = zx_channel_write(channel_, 0u,
+                                  bytes + sizeof(fidl_message_header_t) + sizeof(record),
+                                  record.num_bytes, buffer_.handles(), actual_handles_);
+    } else {
+        status = zx_channel_write(channel_, 0u, bytes, actual_bytes_, buffer_.handles(),
+                                  actual_handles_);
+    }
+    Reset();
+    return status;
+}
+
+void MessageBatcher::HandleDeadline(async_dispatcher_t* dispatcher, async_task_t* task,
+                                    zx_status_t status) {
+    MessageBatcher* batcher = reinterpret_cast<MessageBatcher*>(task);
+    if (status == ZX_OK) {
+        batcher->Flush();
+    }
+}
+
+void MessageBatcher::Reset() {
+    fidl_message_header_t* header = reinterpret_cast<fidl_message_header_t*>(buffer_.bytes());
+    memset(header, 0, sizeof(*header));
+    header->ordinal = FIDL_BATCH_ORDINAL;
+    actual_bytes_ = sizeof(fidl_message_header_t);
+    actual_handles_ = 0u;
+    count_ = 0u;
+}
+
+} // namespace fidl
@@ -9,12 +9,14 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := userlib
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/batch.c \
     $(LOCAL_DIR)/bind.c \
     $(LOCAL_DIR)/builder.cpp \
     $(LOCAL_DIR)/decoding.cpp \
     $(LOCAL_DIR)/encoding.cpp \
     $(LOCAL_DIR)/epitaph.c \
     $(LOCAL_DIR)/formatting.cpp \
+    $(LOCAL_DIR)/message_batcher.cpp \
     $(LOCAL_DIR)/message_buffer.cpp \
     $(LOCAL_DIR)/message_builder.cpp \
     $(LOCAL_DIR)/message.cpp \
@@ -41,6 +41,9 @@ zx_status_t sleep_ramdisk(const char* ramdisk_path, uint64_t blk_count);
 // Wake the ramdisk at |ramdisk_path| from a sleep state.
 zx_status_t wake_ramdisk(const char* ramdisk_path);
 
+// Makes the ramdisk at |ramdisk_path| emulate the device described by |perf|.
+zx_status_t set_ramdisk_performance(const char* ramdisk_path, const ramdisk_perf_t* perf);
+
 // Returns the ramdisk's current failed, successful, and total block counts as |counts|.
 zx_status_t get_ramdisk_blocks(const char* ramdisk_path, ramdisk_blk_counts_t* counts);
 
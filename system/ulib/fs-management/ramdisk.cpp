@@ -208,6 +208,20 @@ zx_status_t wake_ramdisk(const char* ramdisk_path) {
     return ZX_OK;
 }
 
+zx_status_t set_ramdisk_performance(const char* ramdisk_path, const ramdisk_perf_t* perf) {
+    fbl::unique_fd fd(open(ramdisk_path, O_RDWR));
+    if (fd.get() < 0) {
+        fprintf(stderr, "Could not open ramdisk\n");
+        return ZX_ERR_BAD_STATE;
+    }
+    ssize_t r = ioctl_ramdisk_set_performance(fd.get(), perf);
+    if (r != ZX_OK) {
+        fprintf(stderr, "Could not set ramdisk performance\n");
+        return static_cast<zx_status_t>(r);
+    }
+    return ZX_OK;
+}
+
 zx_status_t get_ramdisk_blocks(const char* ramdisk_path, ramdisk_blk_counts_t* counts) {
     fbl::unique_fd fd(open(ramdisk_path, O_RDWR));
     if (fd.get() < 0) {
@@ -80,6 +80,15 @@ zx_status_t MakeRamdisk(const FixtureOptions& options, fbl::String* block_device
             return result;
         }
         *block_device_path = buffer;
+
+        const ramdisk_perf_t& perf = options.ramdisk_perf;
+        if (perf.latency != 0 || perf.bytes_per_sec != 0 || perf.queue_depth != 0) {
+            result = set_ramdisk_performance(buffer, &perf);
+            if (result != ZX_OK) {
+                LOG_ERROR(result, "Failed to set ramdisk performance.\n");
+                return result;
+            }
+        }
     }
 
     return ZX_OK;
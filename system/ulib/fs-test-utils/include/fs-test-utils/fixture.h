@@ -14,6 +14,7 @@
 #include <fs-management/mount.h>
 #include <fvm/fvm.h>
 #include <lib/zx/time.h>
+#include <zircon/device/ramdisk.h>
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
 #include <zircon/types.h>
@@ -75,6 +76,9 @@ struct FixtureOptions {
     // Size of the blocks the ramdisk will have.
     size_t ramdisk_block_size = 0;
 
+    // The device the ramdisk emulates; all zeroes for the ramdisk's own speed.
+    ramdisk_perf_t ramdisk_perf = {};
+
     // If true an fvm will be mounted on the device, and the filesystem will be
     // mounted on top of a fresh partition.
     bool use_fvm = false;
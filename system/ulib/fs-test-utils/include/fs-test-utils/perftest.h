@@ -10,6 +10,7 @@
 
 #include <fbl/function.h>
 #include <fbl/string.h>
+#include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <fs-test-utils/fixture.h>
 #include <perftest/perftest.h>
@@ -88,6 +89,11 @@ struct TestCaseInfo {
     // if set and will be ignored if in unittest mode.
     // This is optional.
     uint32_t sample_count = 0;
+
+    // Fixture options to run this test case with, instead of the ones passed to |RunTestCases|.
+    // This allows a single run to cover several filesystems or block device stacks.
+    // This is optional.
+    fbl::unique_ptr<FixtureOptions> fixture_options;
 };
 
 // Returns true if the parsed args should trigger a test run. The usage information is
@@ -42,6 +42,13 @@ Usage:
 
         --ramdisk_block_count COUNT    Number of blocks in the ramdisk.
 
+        --ramdisk_latency_us US        Microseconds the ramdisk adds to each
+                                       operation.
+
+        --ramdisk_bytes_per_sec RATE   Bandwidth the ramdisk's transfers share.
+
+        --ramdisk_queue_depth DEPTH    Operations the ramdisk works on at once.
+
         --use_fvm                      A FVM will be created on the block 
                                        device.
 
@@ -264,7 +271,10 @@ bool RunTestCases(const FixtureOptions& fixture_options,
     bool error = false;
     zx::ticks start = zx::ticks::now();
     for (auto& test_case : test_cases) {
-        RunTestCase(fixture_options, performance_test_options, test_case, &result_set, &stats, out);
+        const FixtureOptions& test_case_fixture_options =
+            test_case.fixture_options ? *test_case.fixture_options : fixture_options;
+        RunTestCase(test_case_fixture_options, performance_test_options, test_case, &result_set,
+                    &stats, out);
     }
     PrintTestsCasesSummary(test_cases.size(), stats, start, out);
     if (performance_test_options.print_statistics) {
@@ -312,6 +322,9 @@ bool ParseCommandLineArgs(int argc, const char* const* argv, FixtureOptions* fix
         {"print_statistics", no_argument, nullptr, 0},
         {"runs", required_argument, nullptr, 0},
         {"seed", required_argument, nullptr, 0},
+        {"ramdisk_latency_us", required_argument, nullptr, 0},
+        {"ramdisk_bytes_per_sec", required_argument, nullptr, 0},
+        {"ramdisk_queue_depth", required_argument, nullptr, 0},
         {0, 0, 0, 0},
     };
     // Resets the internal state of getopt*, making this function idempotent.
@@ -379,6 +392,16 @@ bool ParseCommandLineArgs(int argc, const char* const* argv, FixtureOptions* fix
             case 12:
                 fixture_options->seed = static_cast<unsigned int>(strtoul(optarg, NULL, 0));
                 break;
+            case 13:
+                fixture_options->ramdisk_perf.latency = ZX_USEC(strtoull(optarg, NULL, 0));
+                break;
+            case 14:
+                fixture_options->ramdisk_perf.bytes_per_sec = strtoull(optarg, NULL, 0);
+                break;
+            case 15:
+                fixture_options->ramdisk_perf.queue_depth =
+                    static_cast<uint32_t>(strtoul(optarg, NULL, 0));
+                break;
             default:
                 break;
             }
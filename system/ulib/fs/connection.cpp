@@ -11,6 +11,7 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#include <fbl/auto_lock.h>
 #include <fs/trace.h>
 #include <fs/vnode.h>
 #include <fuchsia/io/c/fidl.h>
@@ -26,6 +27,11 @@
 namespace fs {
 namespace {
 
+// The Vfs whose dispatch lock this thread holds, if any. Messages synthesized
+// while dispatching, such as the close sent by an unmounting connection, are
+// dispatched without taking the lock again.
+thread_local Vfs* t_dispatching_vfs = nullptr;
+
 void WriteDescribeError(zx::channel channel, zx_status_t status) {
     zxrio_describe_t msg;
     memset(&msg, 0, sizeof(msg));
@@ -174,6 +180,7 @@ ZXFIDL_OPERATION(FileTruncate)
 ZXFIDL_OPERATION(FileGetFlags)
 ZXFIDL_OPERATION(FileSetFlags)
 ZXFIDL_OPERATION(FileGetVmo)
+ZXFIDL_OPERATION(FileGetBuffer)
 
 const fuchsia_io_File_ops kFileOps = {
     .Clone = NodeCloneOp,
@@ -192,6 +199,7 @@ const fuchsia_io_File_ops kFileOps = {
     .GetFlags = FileGetFlagsOp,
     .SetFlags = FileSetFlagsOp,
     .GetVmo = FileGetVmoOp,
+    .GetBuffer = FileGetBufferOp,
 };
 
 ZXFIDL_OPERATION(DirectoryOpen)
@@ -202,6 +210,7 @@ ZXFIDL_OPERATION(DirectoryGetToken)
 ZXFIDL_OPERATION(DirectoryRename)
 ZXFIDL_OPERATION(DirectoryLink)
 ZXFIDL_OPERATION(DirectoryWatch)
+ZXFIDL_OPERATION(DirectoryReadDirentsPlus)
 
 const fuchsia_io_Directory_ops kDirectoryOps {
     .Clone = NodeCloneOp,
@@ -219,6 +228,7 @@ const fuchsia_io_Directory_ops kDirectoryOps {
     .Rename = DirectoryRenameOp,
     .Link = DirectoryLinkOp,
     .Watch = DirectoryWatchOp,
+    .ReadDirentsPlus = DirectoryReadDirentsPlusOp,
 };
 
 ZXFIDL_OPERATION(DirectoryAdminMount)
@@ -244,6 +254,7 @@ const fuchsia_io_DirectoryAdmin_ops kDirectoryAdminOps {
     .Rename = DirectoryRenameOp,
     .Link = DirectoryLinkOp,
     .Watch = DirectoryWatchOp,
+    .ReadDirentsPlus = DirectoryReadDirentsPlusOp,
     .Mount = DirectoryAdminMountOp,
     .MountAndCreate = DirectoryAdminMountAndCreateOp,
     .Unmount = DirectoryAdminUnmountOp,
@@ -659,6 +670,27 @@ zx_status_t Connection::FileGetVmo(uint32_t flags, fidl_txn_t* txn) {
     return fuchsia_io_FileGetVmo_reply(txn, status, handle);
 }
 
+zx_status_t Connection::FileGetBuffer(fidl_txn_t* txn) {
+    if (IsPathOnly(flags_)) {
+        return fuchsia_io_FileGetBuffer_reply(txn, ZX_ERR_BAD_HANDLE, ZX_HANDLE_INVALID, 0,
+                                              ZX_HANDLE_INVALID);
+    } else if (!IsReadable(flags_)) {
+        return fuchsia_io_FileGetBuffer_reply(txn, ZX_ERR_ACCESS_DENIED, ZX_HANDLE_INVALID, 0,
+                                              ZX_HANDLE_INVALID);
+    }
+
+    zx::vmo vmo;
+    size_t size = 0;
+    zx::eventpair size_changed;
+    zx_status_t status = vnode_->GetBuffer(&vmo, &size, &size_changed);
+    if (status != ZX_OK) {
+        return fuchsia_io_FileGetBuffer_reply(txn, status, ZX_HANDLE_INVALID, 0,
+                                              ZX_HANDLE_INVALID);
+    }
+    return fuchsia_io_FileGetBuffer_reply(txn, ZX_OK, vmo.release(), size,
+                                          size_changed.release());
+}
+
 zx_status_t Connection::DirectoryOpen(uint32_t flags, uint32_t mode, const char* path_data,
                                       size_t path_size, zx_handle_t object) {
     zx::channel channel(object);
@@ -747,6 +779,19 @@ zx_status_t Connection::DirectoryWatch(uint32_t mask, uint32_t options, zx_handl
     return fuchsia_io_DirectoryWatch_reply(txn, status);
 }
 
+zx_status_t Connection::DirectoryReadDirentsPlus(uint64_t max_out, fidl_txn_t* txn) {
+    if (IsPathOnly(flags_)) {
+        return fuchsia_io_DirectoryReadDirentsPlus_reply(txn, ZX_ERR_BAD_HANDLE, nullptr, 0);
+    }
+    if (max_out > ZXFIDL_MAX_MSG_BYTES) {
+        return fuchsia_io_DirectoryReadDirentsPlus_reply(txn, ZX_ERR_INVALID_ARGS, nullptr, 0);
+    }
+    uint8_t data[max_out];
+    size_t actual = 0;
+    zx_status_t status = vfs_->ReaddirPlus(vnode_.get(), &dircookie_, data, max_out, &actual);
+    return fuchsia_io_DirectoryReadDirentsPlus_reply(txn, status, data, actual);
+}
+
 zx_status_t Connection::DirectoryAdminMount(zx_handle_t remote, fidl_txn_t* txn) {
     if (!(flags_ & ZX_FS_RIGHT_ADMIN)) {
         vfs_unmount_handle(remote, 0);
@@ -820,15 +865,32 @@ zx_status_t Connection::HandleFsSpecificMessage(fidl_msg_t* msg, fidl_txn_t* txn
 }
 
 zx_status_t Connection::HandleMessage(fidl_msg_t* msg, fidl_txn_t* txn) {
+    fidl_message_header_t* hdr = reinterpret_cast<fidl_message_header_t*>(msg->bytes);
+    if (t_dispatching_vfs == vfs_ ||
+        ((hdr->ordinal == fuchsia_io_FileReadOrdinal ||
+          hdr->ordinal == fuchsia_io_FileReadAtOrdinal) &&
+         vnode_->SupportsConcurrentReads())) {
+        return DispatchMessage(msg, txn);
+    }
+    // Dispatching may destroy this connection.
+    Vfs* vfs = vfs_;
+    fbl::AutoLock lock(vfs->dispatch_lock());
+    t_dispatching_vfs = vfs;
+    zx_status_t status = DispatchMessage(msg, txn);
+    t_dispatching_vfs = nullptr;
+    return status;
+}
+
+zx_status_t Connection::DispatchMessage(fidl_msg_t* msg, fidl_txn_t* txn) {
     fidl_message_header_t* hdr = reinterpret_cast<fidl_message_header_t*>(msg->bytes);
     if (hdr->ordinal >= fuchsia_io_NodeCloneOrdinal &&
         hdr->ordinal <= fuchsia_io_NodeIoctlOrdinal) {
         return fuchsia_io_Node_dispatch(this, txn, msg, &kNodeOps);
     } else if (hdr->ordinal >= fuchsia_io_FileReadOrdinal &&
-               hdr->ordinal <= fuchsia_io_FileGetVmoOrdinal) {
+               hdr->ordinal <= fuchsia_io_FileGetBufferOrdinal) {
         return fuchsia_io_File_dispatch(this, txn, msg, &kFileOps);
     } else if (hdr->ordinal >= fuchsia_io_DirectoryOpenOrdinal &&
-               hdr->ordinal <= fuchsia_io_DirectoryWatchOrdinal) {
+               hdr->ordinal <= fuchsia_io_DirectoryReadDirentsPlusOrdinal) {
         return fuchsia_io_Directory_dispatch(this, txn, msg, &kDirectoryOps);
     } else if (hdr->ordinal >= fuchsia_io_DirectoryAdminMountOrdinal &&
                hdr->ordinal <= fuchsia_io_DirectoryAdminGetDevicePathOrdinal) {
@@ -88,6 +88,7 @@ public:
     zx_status_t FileGetFlags(fidl_txn_t* txn);
     zx_status_t FileSetFlags(uint32_t flags, fidl_txn_t* txn);
     zx_status_t FileGetVmo(uint32_t flags, fidl_txn_t* txn);
+    zx_status_t FileGetBuffer(fidl_txn_t* txn);
 
     // Directory Operations.
     zx_status_t DirectoryOpen(uint32_t flags, uint32_t mode, const char* path_data,
@@ -102,6 +103,7 @@ public:
                               const char* dst_data, size_t dst_size, fidl_txn_t* txn);
     zx_status_t DirectoryWatch(uint32_t mask, uint32_t options, zx_handle_t watcher,
                                fidl_txn_t* txn);
+    zx_status_t DirectoryReadDirentsPlus(uint64_t max_out, fidl_txn_t* txn);
 
     // DirectoryAdmin Operations.
     zx_status_t DirectoryAdminMount(zx_handle_t remote, fidl_txn_t* txn);
@@ -146,8 +148,12 @@ private:
     //
     // By default, handles the Node, File, Directory and DirectoryAdmin
     // protocols, dispatching to |HandleFsSpecificMessage| if the ordinal is not recognized.
+    //
+    // Messages are dispatched under the Vfs's |dispatch_lock|, unless they are
+    // reads of a vnode which supports concurrent reads.
     static zx_status_t HandleMessageThunk(fidl_msg_t* msg, fidl_txn_t* txn, void* cookie);
     zx_status_t HandleMessage(fidl_msg_t* msg, fidl_txn_t* txn);
+    zx_status_t DispatchMessage(fidl_msg_t* msg, fidl_txn_t* txn);
 
     bool is_open() const { return wait_.object() != ZX_HANDLE_INVALID; }
     void set_closed() { wait_.set_object(ZX_HANDLE_INVALID); }
@@ -11,6 +11,7 @@
 #include <lib/async/cpp/task.h>
 #include <fbl/intrusive_double_list.h>
 #include <fbl/function.h>
+#include <fbl/mutex.h>
 #include <fbl/unique_ptr.h>
 #include <fs/connection.h>
 #include <fs/vfs.h>
@@ -20,10 +21,14 @@ namespace fs {
 // A specialization of |Vfs| which provides a mechanism to tear down
 // all active connections before it is destroyed.
 //
-// This class is NOT thread-safe and it must be used with a
-// single-threaded asynchronous dispatcher. However, after an operation
-// has been dispatched to a connection, it is safe to defer completion
-// of that operation, returning "ERR_DISPATCHER_ASYNC".
+// This class is thread-safe, and may be served by a multi-threaded
+// asynchronous dispatcher. Each connection still handles one message at a
+// time, and the operations of different connections are serialized by the
+// |dispatch_lock| of |Vfs|, so vnodes need not be thread-safe unless they
+// opt into concurrent reads. After an operation has been dispatched to a
+// connection, it is safe to defer completion of that operation, returning
+// "ERR_DISPATCHER_ASYNC"; the deferred completion runs without the
+// dispatch lock.
 //
 // It is unsafe to shutdown the dispatch loop before shutting down the
 // ManagedVfs object.
@@ -49,11 +54,11 @@ public:
 
 private:
     // Posts the task for OnShutdownComplete if it is safe to do so.
-    void CheckForShutdownComplete();
+    void CheckForShutdownComplete() FS_TA_REQUIRES(lock_);
 
     // Identifies if the filesystem has fully terminated, and is
     // ready for "OnShutdownComplete" to execute.
-    bool IsTerminated() const;
+    bool IsTerminated() const FS_TA_REQUIRES(lock_);
 
     // Invokes the handler from |Shutdown| once all connections have been
     // released. Additionally, unmounts all sub-mounted filesystems, if any
@@ -64,11 +69,12 @@ private:
     void UnregisterConnection(Connection* connection) final;
     bool IsTerminating() const final;
 
-    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_;
+    mutable fbl::Mutex lock_;
+    fbl::DoublyLinkedList<fbl::unique_ptr<Connection>> connections_ FS_TA_GUARDED(lock_);
 
-    bool is_shutting_down_;
+    bool is_shutting_down_ FS_TA_GUARDED(lock_);
     async::TaskMethod<ManagedVfs, &ManagedVfs::OnShutdownComplete> shutdown_task_{this};
-    ShutdownCallback shutdown_handler_;
+    ShutdownCallback shutdown_handler_ FS_TA_GUARDED(lock_);
 };
 
 } // namespace fs
@@ -0,0 +1,92 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes a cache for the blocks which block-backed filesystems
+// read one at a time, which reads ahead of sequential scans.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error Fuchsia-only Header
+#endif
+
+#include <lib/fzl/owned-vmo-mapper.h>
+#include <zircon/device/block.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/unique_ptr.h>
+
+#include <fs/block-txn.h>
+
+namespace fs {
+
+// Caches clean filesystem blocks in a vmo of a fixed size, and reads them
+// from the device through the block fifo.
+//
+// A read which continues the previous one is part of a sequential stream.
+// Each time such a read misses the cache, the number of blocks read ahead of
+// it doubles, up to half of the cache. Any other read resets the stream,
+// and only reads the requested block.
+//
+// Blocks are looked up by their position on disk, so the cache must be told
+// of every write to the device, by Invalidate or InvalidateWrites.
+//
+// This class is thread-safe.
+class ReadAheadCache {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ReadAheadCache);
+
+    // Creates a cache of |capacity| blocks, read through |handler|, for a
+    // device of |block_count| filesystem blocks. Nothing is read ahead past
+    // the end of the device.
+    //
+    // The vmo() of the cache must be attached to the device, and its vmoid
+    // passed to SetVmoid, before the first Read.
+    static zx_status_t Create(TransactionHandler* handler, size_t capacity, uint64_t block_count,
+                              fbl::unique_ptr<ReadAheadCache>* out);
+    ~ReadAheadCache();
+
+    const zx::vmo& vmo() const { return mapper_.vmo(); }
+    void SetVmoid(vmoid_t vmoid) { vmoid_ = vmoid; }
+
+    // Reads filesystem block |bno| into |data|.
+    zx_status_t Read(uint64_t bno, void* data) TA_EXCL(lock_);
+
+    // Drops the |count| blocks starting at |bno| from the cache. This must
+    // be called once a write to them has completed.
+    void Invalidate(uint64_t bno, uint64_t count) TA_EXCL(lock_);
+
+    // Drops the blocks written or trimmed by any of the |count| |requests|,
+    // whose units are device blocks.
+    void InvalidateWrites(const block_fifo_request_t* requests, size_t count) TA_EXCL(lock_);
+
+private:
+    ReadAheadCache(TransactionHandler* handler, size_t capacity, uint64_t block_count,
+                   fbl::unique_ptr<uint64_t[]> tags, fzl::OwnedVmoMapper mapper);
+
+    // Reads the |count| blocks starting at |bno| into the cache.
+    zx_status_t FillLocked(uint64_t bno, uint64_t count) TA_REQ(lock_);
+
+    void InvalidateLocked(uint64_t bno, uint64_t count) TA_REQ(lock_);
+
+    TransactionHandler* handler_;
+    const size_t capacity_;
+    const uint64_t block_count_;
+    vmoid_t vmoid_ = VMOID_INVALID;
+
+    fbl::Mutex lock_;
+    // The block held in each slot of the cache. Block |bno| may only be held
+    // in slot |bno % capacity_|.
+    fbl::unique_ptr<uint64_t[]> tags_ TA_GUARDED(lock_);
+    // Its contents are guarded by |lock_|.
+    fzl::OwnedVmoMapper mapper_;
+    // The block which would continue the current stream, and the number of
+    // blocks to read when it misses the cache.
+    uint64_t next_ TA_GUARDED(lock_) = 0;
+    uint64_t window_ TA_GUARDED(lock_) = 1;
+};
+
+} // namespace fs
@@ -0,0 +1,40 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error "Fuchsia-only header"
+#endif
+
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/vector.h>
+#include <lib/zx/eventpair.h>
+#include <zircon/types.h>
+
+namespace fs {
+
+// Tells the clients which read a file through a shared buffer when the size
+// of the file changes, holding one eventpair for each of them.
+class SizeWatcherContainer {
+public:
+    SizeWatcherContainer();
+    ~SizeWatcherContainer();
+
+    // Creates a new watcher, returning the client's end of its eventpair.
+    zx_status_t Watch(zx::eventpair* out);
+
+    // Signals ZX_USER_SIGNAL_0 on the client end of every watcher, and
+    // forgets the watchers whose client has gone away.
+    void Notify();
+
+private:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SizeWatcherContainer);
+
+    fbl::Mutex lock_;
+    fbl::Vector<zx::eventpair> watchers_ __TA_GUARDED(lock_);
+};
+
+} // namespace fs
@@ -150,12 +150,28 @@ public:
     // modification operations for the duration of the operation.
     zx_status_t Readdir(Vnode* vn, vdircookie_t* cookie,
                         void* dirents, size_t len, size_t* out_actual) FS_TA_EXCLUDES(vfs_lock_);
+    // Like |Readdir|, but fills |dirents| with vdirent_plus_t records, which
+    // also carry the attributes of each entry, as |Getattr| reports them.
+    // Returns ZX_ERR_BUFFER_TOO_SMALL if not even one record fits in |len|.
+    zx_status_t ReaddirPlus(Vnode* vn, vdircookie_t* cookie,
+                            void* dirents, size_t len, size_t* out_actual) FS_TA_EXCLUDES(vfs_lock_);
 
     Vfs(async_dispatcher_t* dispatcher);
 
     async_dispatcher_t* dispatcher() { return dispatcher_; }
     void SetDispatcher(async_dispatcher_t* dispatcher) { dispatcher_ = dispatcher; }
 
+    // Serializes the operations which connections dispatch into the
+    // filesystem, except for the reads of vnodes which support concurrent
+    // reads (see |Vnode::SupportsConcurrentReads|). This is what lets a
+    // filesystem be served by a multi-threaded dispatcher without
+    // being made thread-safe all at once.
+    //
+    // Filesystems may also take it in their own asynchronous handlers, to
+    // serialize them with connection traffic. It is acquired before
+    // |vfs_lock_|.
+    mtx_t* dispatch_lock() { return &dispatch_lock_; }
+
     // Begins serving VFS messages over the specified connection.
     zx_status_t ServeConnection(fbl::unique_ptr<Connection> connection) FS_TA_EXCLUDES(vfs_lock_);
 
@@ -237,6 +253,7 @@ private:
     MountNode::ListType remote_list_ FS_TA_GUARDED(vfs_lock_){};
 
     async_dispatcher_t* dispatcher_{};
+    mtx_t dispatch_lock_{};
 
 protected:
     // A lock which should be used to protect lookup and walk operations
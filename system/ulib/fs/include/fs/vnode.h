@@ -27,6 +27,8 @@
 #ifdef __Fuchsia__
 #include <fuchsia/io/c/fidl.h>
 #include <lib/zx/channel.h>
+#include <lib/zx/eventpair.h>
+#include <lib/zx/vmo.h>
 #endif // __Fuchsia__
 
 namespace fs {
@@ -116,6 +118,17 @@ public:
     // less than or equal to |len|.
     virtual zx_status_t Read(void* data, size_t len, size_t off, size_t* out_actual);
 
+#ifdef __Fuchsia__
+    // Returns true if |Read| may be called while other operations on this
+    // vnode, or on the rest of the filesystem, are in progress on other
+    // threads. Reads of other vnodes are dispatched under the Vfs's
+    // |dispatch_lock|, along with every other operation.
+    //
+    // Filesystems served by a multi-threaded dispatcher opt in one vnode
+    // type at a time, once its read path does its own locking.
+    virtual bool SupportsConcurrentReads() const;
+#endif
+
     // Write |len| bytes of |data| to the file, starting at |offset|.
     //
     // If successful, returns the number of bytes written in |out_actual|. This must be
@@ -144,6 +157,16 @@ public:
     // 2) The mapping by writing to the underlying file.
     virtual zx_status_t GetVmo(int flags, zx_handle_t* out);
 
+#ifdef __Fuchsia__
+    // Acquire a read-only vmo which holds the contents of the file, and which
+    // the vnode keeps up to date, so that clients may read from it directly.
+    // Bytes past |*out_size| do not belong to the file.
+    //
+    // |*out_size_changed| is signalled whenever the size of the file changes.
+    virtual zx_status_t GetBuffer(zx::vmo* out_vmo, size_t* out_size,
+                                  zx::eventpair* out_size_changed);
+#endif
+
     // Syncs the vnode with its underlying storage.
     //
     // Returns the result status through a closure.
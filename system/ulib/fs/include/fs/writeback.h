@@ -0,0 +1,95 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file contains the pieces of writeback shared by the block-backed
+// filesystems: the buffered write request, and a batch which sends the
+// writes of many units of writeback work to the device at once.
+
+#pragma once
+
+#ifndef __Fuchsia__
+#error Fuchsia-only Header
+#endif
+
+#include <zircon/device/block.h>
+#include <zircon/types.h>
+#include <fbl/macros.h>
+#include <fbl/vector.h>
+
+#include <fs/block-txn.h>
+
+namespace fs {
+
+// A write of |length| blocks from |vmo|, starting |vmo_offset| blocks into it,
+// to block |dev_offset| of the device. All units are filesystem blocks.
+struct WriteRequest {
+    zx_handle_t vmo;
+    size_t vmo_offset;
+    size_t dev_offset;
+    size_t length;
+};
+
+// Adds a write to |requests|, folding it into an existing request if it
+// rewrites the same part of |vmo|, or immediately follows it both in |vmo|
+// and on disk.
+//
+// Returns the number of blocks by which |requests| grew.
+size_t EnqueueWriteRequest(fbl::Vector<WriteRequest>* requests, zx_handle_t vmo,
+                           uint64_t vmo_offset, uint64_t dev_offset, uint64_t nblocks);
+
+// Gathers the writes of many units of writeback work, so that they reach the
+// device as a single block fifo transaction rather than one per unit.
+//
+// The writes are split into stages. All writes of a stage are in flight at
+// once, and those which are contiguous both on disk and in their buffer are
+// merged, whichever unit of work they came from. A stage only begins once the
+// previous one has completed.
+//
+// This class is thread-compatible.
+class WriteBatch {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(WriteBatch);
+    explicit WriteBatch(TransactionHandler* handler) : handler_(handler) {}
+    ~WriteBatch() {
+        ZX_DEBUG_ASSERT_MSG(requests_.is_empty(), "WriteBatch still has pending requests");
+    }
+
+    // Adds one unit of work: the |count| writes in |requests|, whose data is in
+    // the vmo attached as |vmoid|. The |vmo| of each request is ignored.
+    //
+    // If |ordered|, the unit gets a stage of its own, so it is written after
+    // everything added before it, and before everything added after it.
+    // Otherwise it joins the current stage, unless that stage is ordered or
+    // already writes one of its blocks.
+    void Add(vmoid_t vmoid, const WriteRequest* requests, size_t count, bool ordered);
+
+    bool IsEmpty() const { return requests_.is_empty(); }
+
+    // Sends everything added to the device, and waits for it to complete.
+    // The batch is left empty, whatever the outcome.
+    zx_status_t Transact();
+
+private:
+    // The number of device blocks in a filesystem block.
+    uint64_t BlockFactor() const {
+        return handler_->FsBlockSize() / handler_->DeviceBlockSize();
+    }
+
+    // Returns true if any of the |count| |requests| writes a block which the
+    // current stage writes too.
+    bool OverlapsStage(const WriteRequest* requests, size_t count) const;
+
+    // Sorts and merges the requests of the current stage, and starts a new,
+    // empty one.
+    void EndStage();
+
+    TransactionHandler* handler_;
+    // In filesystem blocks until Transact().
+    fbl::Vector<block_fifo_request_t> requests_;
+    // The index in |requests_| of the first request of the current stage.
+    size_t stage_start_ = 0;
+    bool stage_ordered_ = false;
+};
+
+} // namespace fs
@@ -6,6 +6,7 @@
 
 #include <lib/async/cpp/task.h>
 #include <fbl/atomic.h>
+#include <fbl/auto_lock.h>
 #include <fbl/unique_ptr.h>
 #include <lib/sync/completion.h>
 
@@ -27,12 +28,16 @@ bool ManagedVfs::IsTerminated() const {
 void ManagedVfs::Shutdown(ShutdownCallback handler) {
     ZX_DEBUG_ASSERT(handler);
     zx_status_t status = async::PostTask(dispatcher(), [this, closure = fbl::move(handler)]() mutable {
-        ZX_DEBUG_ASSERT(!shutdown_handler_);
-        shutdown_handler_ = fbl::move(closure);
-        is_shutting_down_ = true;
+        {
+            fbl::AutoLock lock(&lock_);
+            ZX_DEBUG_ASSERT(!shutdown_handler_);
+            shutdown_handler_ = fbl::move(closure);
+            is_shutting_down_ = true;
+        }
 
         UninstallAll(ZX_TIME_INFINITE);
 
+        fbl::AutoLock lock(&lock_);
         // Signal the teardown on channels in a way that doesn't potentially
         // pull them out from underneath async callbacks.
         for (auto& c : connections_) {
@@ -52,28 +57,35 @@ void ManagedVfs::CheckForShutdownComplete() {
 }
 
 void ManagedVfs::OnShutdownComplete(async_dispatcher_t*, async::TaskBase*, zx_status_t status) {
+    fbl::AutoLock lock(&lock_);
     ZX_ASSERT_MSG(IsTerminated(),
                   "Failed to complete VFS shutdown: dispatcher status = %d\n", status);
     ZX_DEBUG_ASSERT(shutdown_handler_);
 
     auto handler = fbl::move(shutdown_handler_);
+    // The handler may destroy this object, lock included.
+    lock.release();
     handler(status);
 }
 
 void ManagedVfs::RegisterConnection(fbl::unique_ptr<Connection> connection) {
+    fbl::AutoLock lock(&lock_);
     ZX_DEBUG_ASSERT(!is_shutting_down_);
     connections_.push_back(fbl::move(connection));
 }
 
 void ManagedVfs::UnregisterConnection(Connection* connection) {
-    // We drop the result of |erase| on the floor, effectively destroying the
-    // connection when all other references (like async callbacks) have
-    // completed.
-    connections_.erase(*connection);
+    // The result of |erase| is destroyed once the lock has been dropped,
+    // effectively destroying the connection when all other references (like
+    // async callbacks) have completed.
+    fbl::unique_ptr<Connection> closed;
+    fbl::AutoLock lock(&lock_);
+    closed = connections_.erase(*connection);
     CheckForShutdownComplete();
 }
 
 bool ManagedVfs::IsTerminating() const {
+    fbl::AutoLock lock(&lock_);
     return is_shutting_down_;
 }
 
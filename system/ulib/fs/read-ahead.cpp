@@ -0,0 +1,170 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <zircon/assert.h>
+#include <zircon/device/block.h>
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+
+#include <fs/block-txn.h>
+#include <fs/read-ahead.h>
+
+namespace fs {
+namespace {
+
+// The tag of a slot holding no block.
+constexpr uint64_t kNoBlock = UINT64_MAX;
+
+} // namespace
+
+zx_status_t ReadAheadCache::Create(TransactionHandler* handler, size_t capacity,
+                                   uint64_t block_count, fbl::unique_ptr<ReadAheadCache>* out) {
+    ZX_DEBUG_ASSERT(capacity > 0);
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint64_t[]> tags(new (&ac) uint64_t[capacity]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        tags[i] = kNoBlock;
+    }
+
+    fzl::OwnedVmoMapper mapper;
+    zx_status_t status;
+    if ((status = mapper.CreateAndMap(capacity * handler->FsBlockSize(), "fs-read-ahead")) !=
+        ZX_OK) {
+        return status;
+    }
+
+    fbl::unique_ptr<ReadAheadCache> cache(new (&ac) ReadAheadCache(handler, capacity, block_count,
+                                                                   fbl::move(tags),
+                                                                   fbl::move(mapper)));
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    *out = fbl::move(cache);
+    return ZX_OK;
+}
+
+ReadAheadCache::ReadAheadCache(TransactionHandler* handler, size_t capacity, uint64_t block_count,
+                               fbl::unique_ptr<uint64_t[]> tags, fzl::OwnedVmoMapper mapper)
+    : handler_(handler), capacity_(capacity), block_count_(block_count), tags_(fbl::move(tags)),
+      mapper_(fbl::move(mapper)) {}
+
+ReadAheadCache::~ReadAheadCache() {
+    if (vmoid_ != VMOID_INVALID) {
+        block_fifo_request_t request;
+        request.group = handler_->BlockGroupID();
+        request.vmoid = vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        handler_->Transaction(&request, 1);
+    }
+}
+
+zx_status_t ReadAheadCache::Read(uint64_t bno, void* data) {
+    ZX_DEBUG_ASSERT(vmoid_ != VMOID_INVALID);
+    fbl::AutoLock lock(&lock_);
+    const bool sequential = (bno == next_);
+    next_ = bno + 1;
+    if (!sequential) {
+        window_ = 1;
+    }
+
+    const size_t slot = bno % capacity_;
+    if (tags_[slot] != bno) {
+        zx_status_t status;
+        if (sequential) {
+            window_ = fbl::min(window_ * 2, fbl::max(capacity_ / 2, static_cast<size_t>(1)));
+        }
+        // The device may have grown since the cache was created, as a
+        // partition does when slices are added to it, so blocks past the end
+        // are still read, but only one at a time.
+        const uint64_t count = bno < block_count_ ? fbl::min(window_, block_count_ - bno) : 1;
+        // The blocks read ahead may not be readable, such as those of an
+        // unallocated slice, so that is only a reason to give up on them.
+        if ((status = FillLocked(bno, count)) != ZX_OK &&
+            (count == 1 || (status = FillLocked(bno, 1)) != ZX_OK)) {
+            return status;
+        }
+    }
+
+    const uint32_t block_size = handler_->FsBlockSize();
+    memcpy(data, static_cast<const uint8_t*>(mapper_.start()) + slot * block_size, block_size);
+    return ZX_OK;
+}
+
+void ReadAheadCache::Invalidate(uint64_t bno, uint64_t count) {
+    fbl::AutoLock lock(&lock_);
+    InvalidateLocked(bno, count);
+}
+
+void ReadAheadCache::InvalidateWrites(const block_fifo_request_t* requests, size_t count) {
+    const uint64_t factor = handler_->FsBlockSize() / handler_->DeviceBlockSize();
+    fbl::AutoLock lock(&lock_);
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t op = requests[i].opcode & BLOCKIO_OP_MASK;
+        if (op != BLOCKIO_WRITE && op != BLOCKIO_TRIM) {
+            continue;
+        }
+        const uint64_t start = requests[i].dev_offset / factor;
+        const uint64_t end = fbl::round_up(requests[i].dev_offset + requests[i].length, factor) /
+                             factor;
+        InvalidateLocked(start, end - start);
+    }
+}
+
+zx_status_t ReadAheadCache::FillLocked(uint64_t bno, uint64_t count) {
+    ZX_DEBUG_ASSERT(count > 0 && count <= capacity_);
+    InvalidateLocked(bno, count);
+
+    // The blocks wrap around the end of the cache at most once.
+    const uint64_t factor = handler_->FsBlockSize() / handler_->DeviceBlockSize();
+    const groupid_t group = handler_->BlockGroupID();
+    block_fifo_request_t requests[2];
+    size_t request_count = 0;
+    for (uint64_t done = 0; done < count;) {
+        const size_t slot = (bno + done) % capacity_;
+        const uint64_t length = fbl::min(count - done, capacity_ - slot);
+        block_fifo_request_t& request = requests[request_count++];
+        request = {};
+        request.opcode = BLOCKIO_READ;
+        request.group = group;
+        request.vmoid = vmoid_;
+        request.vmo_offset = slot * factor;
+        request.dev_offset = (bno + done) * factor;
+        request.length = static_cast<uint32_t>(length * factor);
+        done += length;
+    }
+
+    zx_status_t status;
+    if ((status = handler_->Transaction(requests, request_count)) != ZX_OK) {
+        return status;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        tags_[(bno + i) % capacity_] = bno + i;
+    }
+    return ZX_OK;
+}
+
+void ReadAheadCache::InvalidateLocked(uint64_t bno, uint64_t count) {
+    if (count >= capacity_) {
+        for (size_t slot = 0; slot < capacity_; slot++) {
+            if (tags_[slot] >= bno && tags_[slot] - bno < count) {
+                tags_[slot] = kNoBlock;
+            }
+        }
+        return;
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        const size_t slot = (bno + i) % capacity_;
+        if (tags_[slot] == bno + i) {
+            tags_[slot] = kNoBlock;
+        }
+    }
+}
+
+} // namespace fs
@@ -24,12 +24,15 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/mount.cpp \
     $(LOCAL_DIR)/pseudo-dir.cpp \
     $(LOCAL_DIR)/pseudo-file.cpp \
+    $(LOCAL_DIR)/read-ahead.cpp \
     $(LOCAL_DIR)/remote-dir.cpp \
     $(LOCAL_DIR)/service.cpp \
+    $(LOCAL_DIR)/size-watcher.cpp \
     $(LOCAL_DIR)/synchronous-vfs.cpp \
     $(LOCAL_DIR)/unmount.cpp \
     $(LOCAL_DIR)/vmo-file.cpp \
     $(LOCAL_DIR)/watcher.cpp \
+    $(LOCAL_DIR)/writeback.cpp \
 
 MODULE_FIDL_LIBS := \
     system/fidl/fuchsia-io
@@ -38,6 +41,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/async \
     system/ulib/async.cpp \
     system/ulib/fbl \
+    system/ulib/fzl \
     system/ulib/sync \
     system/ulib/trace \
     system/ulib/zx \
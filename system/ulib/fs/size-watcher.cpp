@@ -0,0 +1,53 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <fs/size-watcher.h>
+#include <zircon/syscalls.h>
+
+namespace fs {
+
+SizeWatcherContainer::SizeWatcherContainer() = default;
+SizeWatcherContainer::~SizeWatcherContainer() = default;
+
+zx_status_t SizeWatcherContainer::Watch(zx::eventpair* out) {
+    zx::eventpair local, remote;
+    zx_status_t status = zx::eventpair::create(0, &local, &remote);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::AutoLock lock(&lock_);
+    // Drop the watchers of clients which have closed their end, so that a
+    // file which is opened often, but never resized, doesn't collect them.
+    for (size_t i = 0; i < watchers_.size();) {
+        zx_signals_t observed;
+        if (watchers_[i].wait_one(ZX_EVENTPAIR_PEER_CLOSED, zx::time(), &observed) == ZX_OK) {
+            watchers_.erase(i);
+        } else {
+            i++;
+        }
+    }
+    fbl::AllocChecker ac;
+    watchers_.push_back(fbl::move(local), &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    *out = fbl::move(remote);
+    return ZX_OK;
+}
+
+void SizeWatcherContainer::Notify() {
+    fbl::AutoLock lock(&lock_);
+    for (size_t i = 0; i < watchers_.size();) {
+        if (watchers_[i].signal_peer(0, ZX_USER_SIGNAL_0) == ZX_ERR_PEER_CLOSED) {
+            watchers_.erase(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+} // namespace fs
@@ -11,8 +11,10 @@
 #include <unistd.h>
 
 #ifdef __Fuchsia__
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/ref_ptr.h>
+#include <fbl/unique_ptr.h>
 #include <fs/connection.h>
 #include <fs/remote.h>
 #include <threads.h>
@@ -84,6 +86,35 @@ zx_status_t vfs_prevalidate_flags(uint32_t flags) {
     return ZX_OK;
 }
 
+#ifdef __Fuchsia__
+// Fills |out| with the attributes of |entry|, one of the entries of |vn|,
+// followed by its name.
+void FillDirentPlus(fbl::RefPtr<Vnode> vn, const vdirent_t* entry, vdirent_plus_t* out) {
+    memset(out, 0, sizeof(vdirent_plus_t));
+    out->ino = entry->ino;
+    out->size = entry->size;
+    out->type = entry->type;
+    out->mode = DTYPE_TO_VTYPE(entry->type);
+    memcpy(out->name, entry->name, entry->size);
+
+    fbl::RefPtr<Vnode> child;
+    vnattr_t attr;
+    if (vfs_lookup(fbl::move(vn), &child, fbl::StringPiece(entry->name, entry->size)) != ZX_OK ||
+        child->Getattr(&attr) != ZX_OK) {
+        return;
+    }
+    if (out->ino == fuchsia_io_INO_UNKNOWN) {
+        out->ino = attr.inode;
+    }
+    out->mode = attr.mode;
+    out->content_size = attr.size;
+    out->storage_size = VNATTR_BLKSIZE * attr.blkcount;
+    out->link_count = attr.nlink;
+    out->creation_time = attr.create_time;
+    out->modification_time = attr.modify_time;
+}
+#endif
+
 } // namespace
 
 #ifdef __Fuchsia__
@@ -357,6 +388,56 @@ zx_status_t Vfs::Readdir(Vnode* vn, vdircookie_t* cookie,
     return vn->Readdir(cookie, dirents, len, out_actual);
 }
 
+zx_status_t Vfs::ReaddirPlus(Vnode* vn, vdircookie_t* cookie,
+                             void* dirents, size_t len, size_t* out_actual) {
+    // Plain dirents are smaller than their records, so |len| bytes of them
+    // hold at least as many entries as the records which fit.
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> plain(new (&ac) uint8_t[len]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    fbl::AutoLock lock(&vfs_lock_);
+    const vdircookie_t start = *cookie;
+    size_t plain_len;
+    zx_status_t status = vn->Readdir(cookie, plain.get(), len, &plain_len);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    fbl::RefPtr<Vnode> dir(vn);
+    uint8_t* out = static_cast<uint8_t*>(dirents);
+    size_t consumed = 0;
+    size_t filled = 0;
+    while (consumed < plain_len) {
+        const vdirent_t* entry = reinterpret_cast<const vdirent_t*>(plain.get() + consumed);
+        const size_t record_len = sizeof(vdirent_plus_t) + entry->size;
+        if (record_len > len - filled) {
+            break;
+        }
+        FillDirentPlus(dir, entry, reinterpret_cast<vdirent_plus_t*>(out + filled));
+        consumed += sizeof(vdirent_t) + entry->size;
+        filled += record_len;
+    }
+
+    if (consumed < plain_len) {
+        if (consumed == 0) {
+            *cookie = start;
+            return ZX_ERR_BUFFER_TOO_SMALL;
+        }
+        // Read the entries again, this time only as far as the records
+        // returned, so that the rest are returned by the next call.
+        *cookie = start;
+        if ((status = vn->Readdir(cookie, plain.get(), consumed, &plain_len)) != ZX_OK) {
+            return status;
+        }
+        ZX_DEBUG_ASSERT(plain_len == consumed);
+    }
+    *out_actual = filled;
+    return ZX_OK;
+}
+
 zx_status_t Vfs::Link(zx::event token, fbl::RefPtr<Vnode> oldparent,
                       fbl::StringPiece oldStr, fbl::StringPiece newStr) {
     fbl::AutoLock lock(&vfs_lock_);
@@ -49,6 +49,12 @@ zx_status_t Vnode::Read(void* data, size_t len, size_t off, size_t* out_actual)
     return ZX_ERR_NOT_SUPPORTED;
 }
 
+#ifdef __Fuchsia__
+bool Vnode::SupportsConcurrentReads() const {
+    return false;
+}
+#endif
+
 zx_status_t Vnode::Write(const void* data, size_t len, size_t offset, size_t* out_actual) {
     return ZX_ERR_NOT_SUPPORTED;
 }
@@ -99,6 +105,13 @@ zx_status_t Vnode::GetVmo(int flags, zx_handle_t* out) {
     return ZX_ERR_NOT_SUPPORTED;
 }
 
+#ifdef __Fuchsia__
+zx_status_t Vnode::GetBuffer(zx::vmo* out_vmo, size_t* out_size,
+                             zx::eventpair* out_size_changed) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+#endif
+
 void Vnode::Sync(SyncCallback closure) {
     closure(ZX_ERR_NOT_SUPPORTED);
 }
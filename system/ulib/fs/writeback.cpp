@@ -0,0 +1,154 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+
+#include <zircon/assert.h>
+#include <zircon/device/block.h>
+#include <fbl/vector.h>
+
+#include <fs/block-txn.h>
+#include <fs/writeback.h>
+
+namespace fs {
+namespace {
+
+// Orders requests by buffer, and then by their position on disk, so that
+// mergeable requests end up next to each other.
+int CompareRequests(const void* a, const void* b) {
+    auto lhs = static_cast<const block_fifo_request_t*>(a);
+    auto rhs = static_cast<const block_fifo_request_t*>(b);
+    if (lhs->vmoid != rhs->vmoid) {
+        return lhs->vmoid < rhs->vmoid ? -1 : 1;
+    }
+    if (lhs->dev_offset != rhs->dev_offset) {
+        return lhs->dev_offset < rhs->dev_offset ? -1 : 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+size_t EnqueueWriteRequest(fbl::Vector<WriteRequest>* requests, zx_handle_t vmo,
+                           uint64_t vmo_offset, uint64_t dev_offset, uint64_t nblocks) {
+    for (auto& request : *requests) {
+        if (request.vmo != vmo) {
+            continue;
+        }
+
+        if (request.vmo_offset == vmo_offset) {
+            // Take the longer of the operations (if operating on the same blocks).
+            if (nblocks <= request.length) {
+                return 0;
+            }
+            size_t added = nblocks - request.length;
+            request.length = nblocks;
+            return added;
+        } else if ((request.vmo_offset + request.length == vmo_offset) &&
+                   (request.dev_offset + request.length == dev_offset)) {
+            // Combine with the previous request, if immediately following.
+            request.length += nblocks;
+            return nblocks;
+        }
+    }
+
+    WriteRequest request;
+    request.vmo = vmo;
+    request.vmo_offset = vmo_offset;
+    request.dev_offset = dev_offset;
+    request.length = nblocks;
+    requests->push_back(request);
+    return nblocks;
+}
+
+void WriteBatch::Add(vmoid_t vmoid, const WriteRequest* requests, size_t count, bool ordered) {
+    if (count == 0) {
+        return;
+    }
+    if (requests_.size() > stage_start_ &&
+        (ordered || stage_ordered_ || OverlapsStage(requests, count))) {
+        EndStage();
+    }
+    stage_ordered_ = ordered;
+
+    const uint64_t factor = BlockFactor();
+    for (size_t i = 0; i < count; i++) {
+        // TODO(ZX-2253): Remove this assertion.
+        ZX_ASSERT_MSG(requests[i].length * factor < UINT32_MAX, "Too many blocks");
+        block_fifo_request_t request = {};
+        request.opcode = BLOCKIO_WRITE;
+        request.vmoid = vmoid;
+        request.length = static_cast<uint32_t>(requests[i].length);
+        request.vmo_offset = requests[i].vmo_offset;
+        request.dev_offset = requests[i].dev_offset;
+        requests_.push_back(request);
+    }
+}
+
+zx_status_t WriteBatch::Transact() {
+    EndStage();
+    zx_status_t status = ZX_OK;
+    if (!requests_.is_empty()) {
+        // Convert 'filesystem block' units to 'disk block' units.
+        const uint64_t factor = BlockFactor();
+        const groupid_t group = handler_->BlockGroupID();
+        for (auto& request : requests_) {
+            request.group = group;
+            request.vmo_offset *= factor;
+            request.dev_offset *= factor;
+            request.length = static_cast<uint32_t>(request.length * factor);
+        }
+        status = handler_->Transaction(requests_.get(), requests_.size());
+    }
+    requests_.reset();
+    stage_start_ = 0;
+    stage_ordered_ = false;
+    return status;
+}
+
+bool WriteBatch::OverlapsStage(const WriteRequest* requests, size_t count) const {
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = stage_start_; j < requests_.size(); j++) {
+            if (requests[i].dev_offset < requests_[j].dev_offset + requests_[j].length &&
+                requests_[j].dev_offset < requests[i].dev_offset + requests[i].length) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void WriteBatch::EndStage() {
+    const size_t count = requests_.size() - stage_start_;
+    if (count > 0) {
+        block_fifo_request_t* stage = &requests_[stage_start_];
+        qsort(stage, count, sizeof(block_fifo_request_t), CompareRequests);
+
+        const uint64_t max_length = (UINT32_MAX - 1) / BlockFactor();
+        size_t last = 0;
+        for (size_t i = 1; i < count; i++) {
+            if (stage[i].vmoid == stage[last].vmoid &&
+                stage[last].vmo_offset + stage[last].length == stage[i].vmo_offset &&
+                stage[last].dev_offset + stage[last].length == stage[i].dev_offset &&
+                stage[last].length + stage[i].length <= max_length) {
+                stage[last].length += stage[i].length;
+            } else {
+                stage[++last] = stage[i];
+            }
+        }
+        while (requests_.size() > stage_start_ + last + 1) {
+            requests_.pop_back();
+        }
+
+        // Requests within a transaction may run in any order, so the stage
+        // explicitly waits for the one before it.
+        if (stage_start_ > 0) {
+            requests_[stage_start_].opcode |= BLOCKIO_BARRIER_BEFORE;
+        }
+    }
+    stage_start_ = requests_.size();
+    stage_ordered_ = false;
+}
+
+} // namespace fs
@@ -71,37 +71,15 @@ zx_status_t SparseReader::ReadMetadata() {
             return ZX_ERR_INTERNAL;
         }
 
-        size_t src_sz = 4;
-        size_t dst_sz = 0;
-        fbl::unique_ptr<uint8_t[]> inbufptr(new (&ac) uint8_t[src_sz]);
-        if (!ac.check()) {
-            return ZX_ERR_NO_MEMORY;
-        }
-
-        uint8_t* inbuf = inbufptr.get();
-
-        // Read first 4 bytes to let LZ4 tell us how much it expects in the first pass.
-        ssize_t nr = read(fd_.get(), inbuf, src_sz);
-        if (nr < static_cast<ssize_t>(src_sz)) {
+        zx_status_t status;
+        if ((status = NextFrame()) != ZX_OK) {
+            return status;
+        } else if (to_read_ == 0) {
             fprintf(stderr, "SparseReader: could not read from input\n");
             return ZX_ERR_IO;
         }
 
-        // Run decompress once to find out how much data we should read for the next decompress run
-        // Since we are not yet decompressing any actual data, the dst_buffer is null
-        to_read_ = LZ4F_decompress(dctx_, nullptr, &dst_sz, inbuf, &src_sz, NULL);
-        if (LZ4F_isError(to_read_)) {
-            fprintf(stderr, "SparseReader: could not decompress header: %s\n",
-                    LZ4F_getErrorName(to_read_));
-            return ZX_ERR_INTERNAL;
-        }
-
-        if (to_read_ > LZ4_MAX_BLOCK_SIZE) {
-            to_read_ = LZ4_MAX_BLOCK_SIZE;
-        }
-
         // Initialize data buffers
-        zx_status_t status;
         if ((status = InitializeBuffer(LZ4_MAX_BLOCK_SIZE, &out_buf_)) != ZX_OK) {
             return status;
         } else if ((status = InitializeBuffer(LZ4_MAX_BLOCK_SIZE, &in_buf_)) != ZX_OK) {
@@ -112,6 +90,41 @@ zx_status_t SparseReader::ReadMetadata() {
     return ZX_OK;
 }
 
+zx_status_t SparseReader::NextFrame() {
+    size_t src_sz = 4;
+    size_t dst_sz = 0;
+    uint8_t inbuf[4];
+
+    // Read first 4 bytes to let LZ4 tell us how much it expects in the first pass.
+    size_t actual;
+    zx_status_t status;
+    if ((status = ReadRaw(inbuf, src_sz, &actual)) != ZX_OK) {
+        return status;
+    } else if (actual == 0) {
+        // There are no more frames.
+        to_read_ = 0;
+        return ZX_OK;
+    } else if (actual < src_sz) {
+        fprintf(stderr, "SparseReader: could not read from input\n");
+        return ZX_ERR_IO;
+    }
+
+    // Run decompress once to find out how much data we should read for the next decompress run
+    // Since we are not yet decompressing any actual data, the dst_buffer is null
+    to_read_ = LZ4F_decompress(dctx_, nullptr, &dst_sz, inbuf, &src_sz, NULL);
+    if (LZ4F_isError(to_read_)) {
+        fprintf(stderr, "SparseReader: could not decompress header: %s\n",
+                LZ4F_getErrorName(to_read_));
+        return ZX_ERR_INTERNAL;
+    }
+
+    if (to_read_ > LZ4_MAX_BLOCK_SIZE) {
+        to_read_ = LZ4_MAX_BLOCK_SIZE;
+    }
+
+    return ZX_OK;
+}
+
 zx_status_t SparseReader::InitializeBuffer(size_t size, buffer_t* out_buf) {
     if (size < LZ4_MAX_BLOCK_SIZE) {
         fprintf(stderr, "Buffer size must be >= %d\n", LZ4_MAX_BLOCK_SIZE);
@@ -211,6 +224,12 @@ zx_status_t SparseReader::ReadData(uint8_t* data, size_t length, size_t* actual)
             if (to_read_ > LZ4_MAX_BLOCK_SIZE) {
                 to_read_ = LZ4_MAX_BLOCK_SIZE;
             }
+
+            // The end of a frame is only the end of the data if each extent is
+            // not a frame of its own.
+            if (to_read_ == 0 && (status = NextFrame()) != ZX_OK) {
+                return status;
+            }
         }
     } else {
         zx_status_t status = ReadRaw(data, length, &total_size);
@@ -262,7 +281,7 @@ zx_status_t SparseReader::WriteDecompressed(fbl::unique_fd outfd) {
 
     // Update metadata and write to new file.
     fvm::sparse_image_t* image = Image();
-    image->flags &= ~fvm::kSparseFlagLz4;
+    image->flags &= ~(fvm::kSparseFlagLz4 | fvm::kSparseFlagLz4Extents);
 
     if (write(outfd.get(), metadata_.get(), image->header_length)
         != static_cast<ssize_t>(image->header_length)) {
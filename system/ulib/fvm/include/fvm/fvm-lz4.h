@@ -88,6 +88,9 @@ private:
     SparseReader(fbl::unique_fd fd);
     // Read in header data, prepare buffers and decompression context if necessary
     zx_status_t ReadMetadata();
+    // Read the start of the next LZ4 frame, if there is one, setting |to_read_| to the size of
+    // what follows it (or 0 at the end of the file).
+    zx_status_t NextFrame();
     // Initialize buffer with a given |size|
     static zx_status_t InitializeBuffer(size_t size, buffer_t* out_buf);
     // Read |length| bytes of raw data from file directly into |data|. Return |actual| bytes read.
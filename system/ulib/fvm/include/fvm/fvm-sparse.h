@@ -48,8 +48,13 @@ constexpr uint64_t kSparseFormatVersion = 0x2;
 typedef enum sparse_flags {
     kSparseFlagLz4 = 0x1,
     kSparseFlagZxcrypt = 0x2,
+    // Set along with kSparseFlagLz4 when each extent is compressed as an LZ4
+    // frame of its own, which records the extent's length. Extents may then be
+    // found by walking the frames' block headers, and decompressed
+    // independently of each other.
+    kSparseFlagLz4Extents = 0x4,
     // The final value is the bitwise-OR of all other flags
-    kSparseFlagAllValid = kSparseFlagLz4 | kSparseFlagZxcrypt,
+    kSparseFlagAllValid = kSparseFlagLz4 | kSparseFlagZxcrypt | kSparseFlagLz4Extents,
 } sparse_flags_t;
 
 typedef struct sparse_image {
@@ -8,12 +8,30 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/ref_counted.h>
 #include <lib/fzl/vmar-manager.h>
+#include <lib/zx/bti.h>
 #include <lib/zx/vmo.h>
 
 namespace fzl {
 
 class VmoMapper {
 public:
+    // Properties of a VMO created by CreateAndMap, beyond its size.
+    struct BufferOptions {
+        // When non-zero, the cache policy to apply to the created VMO.
+        uint32_t cache_policy = 0;
+
+        // When non-null, the VMO is allocated from physically contiguous
+        // memory for the device behind this BTI, aligned to
+        // (1 << alignment_log2) bytes.  Contiguous VMOs are always committed,
+        // so the kernel will not change their cache policy.
+        const zx::bti* contiguous_bti = nullptr;
+        uint32_t alignment_log2 = 0;
+
+        // When true, every page of the VMO is committed and mapped up front,
+        // so that the first touch of the buffer does not fault.
+        bool prefault = false;
+    };
+
     VmoMapper() = default;
     ~VmoMapper() { Unmap(); }
     DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(VmoMapper);
@@ -52,6 +70,15 @@ public:
                              zx_rights_t vmo_rights = ZX_RIGHT_SAME_RIGHTS,
                              uint32_t cache_policy = 0);
 
+    // Create a new VMO with the properties described by |options| and map it,
+    // as above.
+    zx_status_t CreateAndMap(uint64_t size,
+                             zx_vm_option_t map_flags,
+                             const BufferOptions& options,
+                             fbl::RefPtr<VmarManager> vmar_manager = nullptr,
+                             zx::vmo* vmo_out = nullptr,
+                             zx_rights_t vmo_rights = ZX_RIGHT_SAME_RIGHTS);
+
     // Map an existing VMO our address space using the provided map
     // flags and optional target VMAR.
     //
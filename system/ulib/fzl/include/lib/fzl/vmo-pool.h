@@ -9,7 +9,9 @@
 #include <fbl/limits.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
+#include <lib/fzl/pinned-vmo.h>
 #include <lib/fzl/vmo-mapper.h>
+#include <lib/zx/bti.h>
 #include <lib/zx/vmo.h>
 #include <zircon/types.h>
 
@@ -28,11 +30,27 @@ namespace fzl {
 class VmoPool {
 
 public:
+    // How the buffers of a pool are set up when it is initialized.  Buffers
+    // stay mapped, and pinned if requested, for as long as they are in the
+    // pool, so recycling a buffer costs nothing.
+    struct Options {
+        // When non-null, every buffer is pinned for the device behind this BTI
+        // with |pin_rights| (ZX_BTI_PERM_*).
+        const zx::bti* bti = nullptr;
+        uint32_t pin_rights = ZX_BTI_PERM_READ | ZX_BTI_PERM_WRITE;
+
+        // When true, every page of every buffer is committed and mapped up
+        // front, so that producers never fault on a buffer's first use.
+        bool prefault = false;
+    };
+
     // Initializes a VmoPool with a set of vmos. You can pass a vector of vmos,
     // or a vmo pointer and the number of vmos it should grab.
     // If successful, returns ZX_OK.
     zx_status_t Init(const fbl::Vector<zx::vmo>& vmos);
     zx_status_t Init(const zx::vmo* vmos, size_t num_vmos);
+    zx_status_t Init(const fbl::Vector<zx::vmo>& vmos, const Options& options);
+    zx_status_t Init(const zx::vmo* vmos, size_t num_vmos, const Options& options);
 
     // Resets the buffer locks and the 'in process' indicator.
     void Reset();
@@ -73,13 +91,21 @@ public:
     // Returns nullptr if no current buffer.
     void* CurrentBufferAddress() const;
 
+    // Return the pinned memory of the current buffer.
+    // Returns nullptr if no current buffer, or if the pool was not pinned.
+    const PinnedVmo* CurrentBufferPinnedVmo() const;
+
     ~VmoPool();
 
 private:
     struct ListableBuffer : public fbl::SinglyLinkedListable<ListableBuffer*> {
         VmoMapper buffer;
+        PinnedVmo pinned;
     };
 
+    zx_status_t InitBuffer(ListableBuffer* buf, const zx::vmo& vmo,
+                           const Options& options, zx_vm_option_t map_flags);
+
     // The sentinel value for no in-progress buffer:
     static constexpr uint32_t kInvalidCurBuffer = fbl::numeric_limits<uint32_t>::max();
     // The buffer to which we are currently writing.
@@ -88,6 +114,8 @@ private:
     fbl::Array<ListableBuffer> buffers_;
     // The list of free buffers.
     fbl::SinglyLinkedList<ListableBuffer*> free_buffers_;
+    // Whether the buffers are pinned.
+    bool pinned_ = false;
 };
 
 } // namespace fzl
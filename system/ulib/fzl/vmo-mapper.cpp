@@ -14,28 +14,61 @@ zx_status_t VmoMapper::CreateAndMap(uint64_t size,
                                     zx::vmo* vmo_out,
                                     zx_rights_t vmo_rights,
                                     uint32_t cache_policy) {
+    BufferOptions options;
+    options.cache_policy = cache_policy;
+    return CreateAndMap(size, map_flags, options, fbl::move(vmar_manager), vmo_out, vmo_rights);
+}
+
+zx_status_t VmoMapper::CreateAndMap(uint64_t size,
+                                    zx_vm_option_t map_flags,
+                                    const BufferOptions& options,
+                                    fbl::RefPtr<VmarManager> vmar_manager,
+                                    zx::vmo* vmo_out,
+                                    zx_rights_t vmo_rights) {
     if (size == 0) {
         return ZX_ERR_INVALID_ARGS;
     }
 
+    if ((options.contiguous_bti != nullptr) && (options.cache_policy != 0)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     zx_status_t res = CheckReadyToMap(vmar_manager);
     if (res != ZX_OK) {
         return res;
     }
 
     zx::vmo vmo;
-    zx_status_t ret = zx::vmo::create(size, 0, &vmo);
+    zx_status_t ret;
+    if (options.contiguous_bti != nullptr) {
+        ret = zx_vmo_create_contiguous(options.contiguous_bti->get(), size,
+                                       options.alignment_log2, vmo.reset_and_get_address());
+    } else {
+        ret = zx::vmo::create(size, 0, &vmo);
+    }
     if (ret != ZX_OK) {
         return ret;
     }
 
-    if (cache_policy != 0) {
-        ret = vmo.set_cache_policy(cache_policy);
+    if (options.cache_policy != 0) {
+        ret = vmo.set_cache_policy(options.cache_policy);
         if (ret != ZX_OK) {
             return ret;
         }
     }
 
+    if (options.prefault) {
+        // ZX_VM_MAP_RANGE only maps pages which are already committed, so
+        // commit them all first.  Contiguous VMOs start out committed.
+        if (options.contiguous_bti == nullptr) {
+            ret = vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0);
+            if (ret != ZX_OK) {
+                return ret;
+            }
+        }
+        map_flags |= ZX_VM_MAP_RANGE;
+    }
+
     ret = InternalMap(vmo, 0, size, map_flags, fbl::move(vmar_manager));
     if (ret != ZX_OK) {
         return ret;
@@ -16,10 +16,18 @@ VmoPool::~VmoPool() {
 }
 
 zx_status_t VmoPool::Init(const fbl::Vector<zx::vmo>& vmos) {
-    return Init(vmos.begin(), vmos.size());
+    return Init(vmos.begin(), vmos.size(), Options());
 }
 
 zx_status_t VmoPool::Init(const zx::vmo* vmos, size_t num_vmos) {
+    return Init(vmos, num_vmos, Options());
+}
+
+zx_status_t VmoPool::Init(const fbl::Vector<zx::vmo>& vmos, const Options& options) {
+    return Init(vmos.begin(), vmos.size(), options);
+}
+
+zx_status_t VmoPool::Init(const zx::vmo* vmos, size_t num_vmos, const Options& options) {
     fbl::AllocChecker ac;
     fbl::Array<ListableBuffer> buffers(new (&ac) ListableBuffer[num_vmos], num_vmos);
     if (!ac.check()) {
@@ -27,21 +35,54 @@ zx_status_t VmoPool::Init(const zx::vmo* vmos, size_t num_vmos) {
     }
     buffers_ = fbl::move(buffers);
     free_buffers_.clear_unsafe();
+    pinned_ = false;
+
+    zx_vm_option_t map_flags = ZX_VM_PERM_READ | ZX_VM_PERM_WRITE;
+    if (options.prefault) {
+        map_flags |= ZX_VM_MAP_RANGE;
+    }
 
     zx_status_t status;
     for (size_t i = 0; i < num_vmos; ++i) {
         free_buffers_.push_front(&buffers_[i]);
-        status = buffers_[i].buffer.Map(vmos[i], 0, 0, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE);
+        status = InitBuffer(&buffers_[i], vmos[i], options, map_flags);
         if (status != ZX_OK) {
             free_buffers_.clear_unsafe();
             buffers_.reset();
             return status;
         }
     }
+    pinned_ = (options.bti != nullptr);
     current_buffer_ = kInvalidCurBuffer;
     return ZX_OK;
 }
 
+zx_status_t VmoPool::InitBuffer(ListableBuffer* buf, const zx::vmo& vmo,
+                                const Options& options, zx_vm_option_t map_flags) {
+    zx_status_t status;
+
+    // Pinning commits every page, so only buffers which are not pinned need
+    // to be committed before ZX_VM_MAP_RANGE will map all of them.
+    if (options.bti != nullptr) {
+        status = buf->pinned.Pin(vmo, *options.bti, options.pin_rights);
+        if (status != ZX_OK) {
+            return status;
+        }
+    } else if (options.prefault) {
+        uint64_t size;
+        status = vmo.get_size(&size);
+        if (status != ZX_OK) {
+            return status;
+        }
+        status = vmo.op_range(ZX_VMO_OP_COMMIT, 0, size, nullptr, 0);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    return buf->buffer.Map(vmo, 0, 0, map_flags);
+}
+
 void VmoPool::Reset() {
     current_buffer_ = kInvalidCurBuffer;
     for (size_t i = 0; i < buffers_.size(); ++i) {
@@ -108,4 +149,11 @@ void* VmoPool::CurrentBufferAddress() const {
     }
     return nullptr;
 }
+
+const PinnedVmo* VmoPool::CurrentBufferPinnedVmo() const {
+    if (HasBufferInProgress() && pinned_) {
+        return &buffers_[current_buffer_].pinned;
+    }
+    return nullptr;
+}
 } // namespace fzl
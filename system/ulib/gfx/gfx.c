@@ -215,156 +215,72 @@ void gfx_putchar(gfx_surface* surface, const gfx_font* font, unsigned ch, unsign
     surface->putchar(surface, font, ch, x, y, fg, bg);
 }
 
-static void copyrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint8_t* src = &((const uint8_t*)surface->ptr)[x + y * surface->stride];
-    uint8_t* dest = &((uint8_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
-        }
-    } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
-    }
-}
-
-static void fillrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
-    uint8_t* dest = &((uint8_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    uint8_t color8 = (uint8_t)(surface->translate_color(color));
-
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color8;
-            dest++;
-        }
-        dest += stride_diff;
-    }
-}
-
-static void copyrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint16_t* src = &((const uint16_t*)surface->ptr)[x + y * surface->stride];
-    uint16_t* dest = &((uint16_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+// Wide stores used to fill rows; aliases the pixel types it overwrites.
+typedef uint64_t __attribute__((__may_alias__)) gfx_word_t;
+
+static void copyrect(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
+    size_t pitch = surface->stride * surface->pixelsize;
+    size_t rowlen = width * surface->pixelsize;
+    const uint8_t* src = (const uint8_t*)surface->ptr + y * pitch + x * surface->pixelsize;
+    uint8_t* dest = (uint8_t*)surface->ptr + y2 * pitch + x2 * surface->pixelsize;
+
+    if (rowlen == pitch) {
+        // full width rows are contiguous, so the rect is one block
+        memmove(dest, src, rowlen * height);
+    } else if (dest < src) {
+        // memmove copes with overlap within a row, the row order copes
+        // with overlap between rows
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, rowlen);
+            dest += pitch;
+            src += pitch;
         }
     } else {
         // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
-    }
-}
-
-static void fillrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
-    uint16_t* dest = &((uint16_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    uint16_t color16 = (uint16_t)(surface->translate_color(color));
-
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color16;
-            dest++;
+        src += (height - 1) * pitch;
+        dest += (height - 1) * pitch;
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, rowlen);
+            dest -= pitch;
+            src -= pitch;
         }
-        dest += stride_diff;
     }
 }
 
-static void copyrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint32_t* src = &((const uint32_t*)surface->ptr)[x + y * surface->stride];
-    uint32_t* dest = &((uint32_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
-        }
-    } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
-    }
+// Fills each row a pixel at a time up to 8 byte alignment, then with 64 bit
+// stores of the color replicated across the word, then finishes the tail.
+#define MKFILLRECT(FUNC,TYPE) \
+static void FUNC(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) { \
+    TYPE* dest = &((TYPE*)surface->ptr)[x + y * surface->stride]; \
+    TYPE pixel = (sizeof(TYPE) == sizeof(uint32_t)) ? (TYPE)color : (TYPE)(surface->translate_color(color)); \
+    const unsigned per_word = sizeof(gfx_word_t) / sizeof(TYPE); \
+    gfx_word_t pattern = pixel; \
+    for (unsigned shift = sizeof(TYPE) * 8; shift < 64; shift *= 2) { \
+        pattern |= pattern << shift; \
+    } \
+    for (unsigned i = 0; i < height; i++) { \
+        TYPE* p = dest; \
+        unsigned n = width; \
+        while (n > 0 && ((uintptr_t)p & (sizeof(gfx_word_t) - 1))) { \
+            *p++ = pixel; \
+            n--; \
+        } \
+        gfx_word_t* w = (gfx_word_t*)p; \
+        for (; n >= per_word; n -= per_word) { \
+            *w++ = pattern; \
+        } \
+        p = (TYPE*)w; \
+        while (n > 0) { \
+            *p++ = pixel; \
+            n--; \
+        } \
+        dest += surface->stride; \
+    } \
 }
 
-static void fillrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
-    uint32_t* dest = &((uint32_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color;
-            dest++;
-        }
-        dest += stride_diff;
-    }
-}
+MKFILLRECT(fillrect8, uint8_t)
+MKFILLRECT(fillrect16, uint16_t)
+MKFILLRECT(fillrect32, uint32_t)
 
 void gfx_line(gfx_surface* surface, unsigned x1, unsigned y1, unsigned x2, unsigned y2, unsigned color) {
     if (unlikely(x1 >= surface->width))
@@ -453,6 +369,28 @@ uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src) {
     return (srca << 24) | (cres[0] << 16) | (cres[1] << 8) | (cres[2]);
 }
 
+// Copies a block between two surfaces of the same format a row at a time,
+// or in one go when both surfaces' rows are contiguous.
+static void copyrows(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned srcy, unsigned width, unsigned height, unsigned destx, unsigned desty) {
+    size_t src_pitch = source->stride * source->pixelsize;
+    size_t dest_pitch = target->stride * target->pixelsize;
+    size_t rowlen = width * source->pixelsize;
+    const uint8_t* src = (const uint8_t*)source->ptr + srcy * src_pitch + srcx * source->pixelsize;
+    uint8_t* dest = (uint8_t*)target->ptr + desty * dest_pitch + destx * target->pixelsize;
+
+    xprintf("w %u h %u dpitch %zu spitch %zu\n", width, height, dest_pitch, src_pitch);
+
+    if (rowlen == src_pitch && rowlen == dest_pitch) {
+        memcpy(dest, src, rowlen * height);
+        return;
+    }
+    for (unsigned i = 0; i < height; i++) {
+        memcpy(dest, src, rowlen);
+        dest += dest_pitch;
+        src += src_pitch;
+    }
+}
+
 /**
  * @brief  Copy pixels from source to dest.
  *
@@ -493,23 +431,7 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
     // XXX total hack to deal with various blends
     if (source->format == ZX_PIXEL_FORMAT_RGB_565 && target->format == ZX_PIXEL_FORMAT_RGB_565) {
         // 16 bit to 16 bit
-        const uint16_t* src = &((const uint16_t*)source->ptr)[srcx + srcy * source->stride];
-        uint16_t* dest = &((uint16_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
+        copyrows(target, source, srcx, srcy, width, height, destx, desty);
     } else if (source->format == ZX_PIXEL_FORMAT_ARGB_8888 && target->format == ZX_PIXEL_FORMAT_ARGB_8888) {
         // both are 32 bit modes, both alpha
         const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
@@ -532,42 +454,10 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
         }
     } else if (source->format == ZX_PIXEL_FORMAT_RGB_x888 && target->format == ZX_PIXEL_FORMAT_RGB_x888) {
         // both are 32 bit modes, no alpha
-        const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
-        uint32_t* dest = &((uint32_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
+        copyrows(target, source, srcx, srcy, width, height, destx, desty);
     } else if (source->format == ZX_PIXEL_FORMAT_MONO_8 && target->format == ZX_PIXEL_FORMAT_MONO_8) {
         // both are 8 bit modes, no alpha
-        const uint8_t* src = &((const uint8_t*)source->ptr)[srcx + srcy * source->stride];
-        uint8_t* dest = &((uint8_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
+        copyrows(target, source, srcx, srcy, width, height, destx, desty);
     } else {
         xprintf("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
         assert(0);
@@ -642,7 +532,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     switch (format) {
     case ZX_PIXEL_FORMAT_RGB_565:
         surface->translate_color = &ARGB8888_to_RGB565;
-        surface->copyrect = &copyrect16;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect16;
         surface->putpixel = &putpixel16;
         surface->putchar = &putchar16;
@@ -652,7 +542,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     case ZX_PIXEL_FORMAT_RGB_x888:
     case ZX_PIXEL_FORMAT_ARGB_8888:
         surface->translate_color = NULL;
-        surface->copyrect = &copyrect32;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect32;
         surface->putpixel = &putpixel32;
         surface->putchar = &putchar32;
@@ -661,7 +551,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case ZX_PIXEL_FORMAT_MONO_8:
         surface->translate_color = &ARGB8888_to_Luma;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -670,7 +560,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case ZX_PIXEL_FORMAT_RGB_332:
         surface->translate_color = &ARGB8888_to_RGB332;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -679,7 +569,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case ZX_PIXEL_FORMAT_RGB_2220:
         surface->translate_color = &ARGB8888_to_RGB2220;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -0,0 +1,95 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <hid-parser/parser.h>
+
+namespace hid {
+
+// The DeviceDescriptor returned by ParseReportDescriptor() describes each
+// field but not where it lives in a report; finding that out means walking
+// every field that precedes it. CompileInputReports() does that walk once
+// and produces an InputReportTable: for every report id that has input
+// fields, a flat array with the bit offset and size of each input field,
+// plus a lookup from report id to its entry.
+//
+// Decoding a report is then a table lookup on the first byte followed by
+// one shift-and-mask per field, and does not touch the DeviceDescriptor,
+// which can be freed once the table is compiled.
+//
+// Using the mouse in the parser.h example, the table for report id 1 is:
+//
+//    fields[0]   bit_offset  8   bit_sz  1   button,1
+//    fields[1]   bit_offset  9   bit_sz  1   button,2
+//    fields[2]   bit_offset  10  bit_sz  6   button,none
+//
+// where the offsets count the report id byte.
+
+struct InputField {
+    // Offset of the field from the start of the report, including the
+    // report id byte when the device uses report ids.
+    uint32_t bit_offset;
+    uint8_t bit_sz;
+    uint32_t flags;
+    Usage usage;
+    MinMax logc_mm;
+};
+
+struct InputReport {
+    uint8_t report_id;
+    // Length of the report, including the report id byte if any.
+    size_t byte_sz;
+    size_t count;
+    InputField* fields;
+};
+
+struct InputReportTable {
+    // Whether each report starts with a report id byte.
+    bool has_report_id;
+    // Index into |report| for each report id, or kNoInputReport.
+    uint16_t index[256];
+    size_t rep_count;
+    InputReport report[];
+};
+
+constexpr uint16_t kNoInputReport = UINT16_MAX;
+
+// Builds the InputReportTable for |dev_desc|. The table is a single heap
+// allocation that does not refer to |dev_desc| and is freed with
+// FreeInputReportTable().
+ParseResult CompileInputReports(const DeviceDescriptor* dev_desc,
+                                InputReportTable** table);
+
+void FreeInputReportTable(InputReportTable* table);
+
+// Returns the layout of the report at the start of |buf|, or null if its
+// report id is unknown or |len| is too short to hold it.
+const InputReport* FindInputReport(const InputReportTable* table,
+                                   const uint8_t* buf, size_t len);
+
+// Extracts the value of |field| from |report|. Fields wider than 32 bits
+// yield their low 32 bits. Returns false if the field doesn't fit in |len|.
+bool ExtractUint(const uint8_t* report, size_t len, const InputField& field,
+                 uint32_t* value);
+
+// Like ExtractUint() but sign-extends the value when the field's logical
+// minimum is negative.
+bool ExtractInt(const uint8_t* report, size_t len, const InputField& field,
+                int32_t* value);
+
+// Decodes every field of the report at the start of |buf| into |values|,
+// in the order of |(*layout)->fields|, sign-extending as ExtractInt()
+// does. Returns the length of the report so that a buffer holding several
+// reports back to back can be decoded in a loop, or 0 if |buf| doesn't
+// start with a complete known report or |max_values| is too small.
+size_t DecodeInputReport(const InputReportTable* table,
+                         const uint8_t* buf, size_t len,
+                         const InputReport** layout,
+                         int32_t* values, size_t max_values);
+
+}  // namespace hid
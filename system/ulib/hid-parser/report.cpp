@@ -0,0 +1,198 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <hid-parser/report.h>
+
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/new.h>
+
+namespace {
+
+constexpr size_t kMaxReportIds = 256u;
+
+// Reads |bit_sz| bits (at most 32) starting |bit_offset| bits into
+// |report|. The caller checks that they are in bounds.
+uint32_t ExtractBits(const uint8_t* report, uint32_t bit_offset, uint32_t bit_sz) {
+    const uint8_t* src = report + bit_offset / 8u;
+    const uint32_t shift = bit_offset % 8u;
+    const uint32_t byte_count = (shift + bit_sz + 7u) / 8u;
+
+    uint64_t raw = 0u;
+    for (uint32_t ix = 0; ix != byte_count; ++ix)
+        raw |= static_cast<uint64_t>(src[ix]) << (8u * ix);
+    raw >>= shift;
+
+    return (bit_sz == 32u) ? static_cast<uint32_t>(raw)
+                           : static_cast<uint32_t>(raw & ((1ull << bit_sz) - 1u));
+}
+
+int32_t SignExtend(uint32_t value, uint32_t bit_sz) {
+    if (bit_sz == 0u || bit_sz >= 32u)
+        return static_cast<int32_t>(value);
+    const uint32_t sign = 1u << (bit_sz - 1u);
+    return static_cast<int32_t>((value ^ sign) - sign);
+}
+
+uint32_t ClampedSize(const hid::InputField& field) {
+    return (field.bit_sz > 32u) ? 32u : field.bit_sz;
+}
+
+}  // namespace
+
+namespace hid {
+
+ParseResult CompileInputReports(const DeviceDescriptor* dev_desc,
+                                InputReportTable** table) {
+    // Reports with the same id are not necessarily contiguous in
+    // |dev_desc|, so the first pass counts the input fields of each id and
+    // assigns ids to table entries in order of appearance; the second pass
+    // lays the fields out with their running bit offsets.
+    const bool has_report_id =
+        (dev_desc->rep_count > 1) || (dev_desc->report[0].report_id != 0);
+
+    uint32_t field_count[kMaxReportIds] = {};
+    uint16_t index[kMaxReportIds];
+    for (size_t id = 0; id != kMaxReportIds; ++id)
+        index[id] = kNoInputReport;
+
+    size_t rep_count = 0u;
+    size_t total_fields = 0u;
+
+    for (size_t ix = 0; ix != dev_desc->rep_count; ++ix) {
+        const ReportDescriptor& report = dev_desc->report[ix];
+        for (size_t jx = 0; jx != report.count; ++jx) {
+            const ReportField& field = report.first_field[jx];
+            if (field.type != kInput)
+                continue;
+            if (index[field.report_id] == kNoInputReport)
+                index[field.report_id] = static_cast<uint16_t>(rep_count++);
+            ++field_count[field.report_id];
+            ++total_fields;
+        }
+    }
+
+    // A single heap allocation holds the table followed by all the fields,
+    // as ParseReportDescriptor() does for the DeviceDescriptor.
+    const size_t table_sz = sizeof(InputReportTable) + rep_count * sizeof(InputReport);
+    const size_t fields_sz = total_fields * sizeof(InputField);
+
+    fbl::AllocChecker ac;
+    auto mem = new (&ac) char[table_sz + fields_sz];
+    if (!ac.check())
+        return kParseNoMemory;
+
+    auto tbl = new (mem) InputReportTable;
+    tbl->has_report_id = has_report_id;
+    memcpy(tbl->index, index, sizeof(index));
+    tbl->rep_count = rep_count;
+    auto dest_fields = reinterpret_cast<InputField*>(mem + table_sz);
+
+    uint32_t bit_offset[kMaxReportIds];
+    size_t next = 0u;
+    for (size_t id = 0; id != kMaxReportIds; ++id) {
+        bit_offset[id] = has_report_id ? 8u : 0u;
+        if (index[id] == kNoInputReport)
+            continue;
+        // The entries are filled in order of appearance, not id.
+        tbl->report[index[id]] = InputReport {
+            static_cast<uint8_t>(id), 0u, 0u, nullptr };
+    }
+    for (size_t ix = 0; ix != rep_count; ++ix) {
+        InputReport& report = tbl->report[ix];
+        report.fields = &dest_fields[next];
+        next += field_count[report.report_id];
+    }
+
+    for (size_t ix = 0; ix != dev_desc->rep_count; ++ix) {
+        const ReportDescriptor& report = dev_desc->report[ix];
+        for (size_t jx = 0; jx != report.count; ++jx) {
+            const ReportField& field = report.first_field[jx];
+            if (field.type != kInput)
+                continue;
+            InputReport& dest = tbl->report[index[field.report_id]];
+            dest.fields[dest.count++] = InputField {
+                bit_offset[field.report_id],
+                field.attr.bit_sz,
+                field.flags,
+                field.attr.usage,
+                field.attr.logc_mm
+            };
+            bit_offset[field.report_id] += field.attr.bit_sz;
+        }
+    }
+
+    for (size_t ix = 0; ix != rep_count; ++ix) {
+        InputReport& report = tbl->report[ix];
+        report.byte_sz = (bit_offset[report.report_id] + 7u) / 8u;
+    }
+
+    *table = tbl;
+    return kParseOk;
+}
+
+void FreeInputReportTable(InputReportTable* table) {
+    delete[] reinterpret_cast<char*>(table);
+}
+
+const InputReport* FindInputReport(const InputReportTable* table,
+                                   const uint8_t* buf, size_t len) {
+    size_t ix;
+    if (table->has_report_id) {
+        if (len == 0u)
+            return nullptr;
+        ix = table->index[buf[0]];
+    } else {
+        ix = table->index[0];
+    }
+    if (ix == kNoInputReport)
+        return nullptr;
+
+    const InputReport* report = &table->report[ix];
+    return (len < report->byte_sz) ? nullptr : report;
+}
+
+bool ExtractUint(const uint8_t* report, size_t len, const InputField& field,
+                 uint32_t* value) {
+    const uint32_t bit_sz = ClampedSize(field);
+    if (field.bit_offset + bit_sz > len * 8u)
+        return false;
+    *value = ExtractBits(report, field.bit_offset, bit_sz);
+    return true;
+}
+
+bool ExtractInt(const uint8_t* report, size_t len, const InputField& field,
+                int32_t* value) {
+    uint32_t raw;
+    if (!ExtractUint(report, len, field, &raw))
+        return false;
+    *value = (field.logc_mm.min < 0) ? SignExtend(raw, ClampedSize(field))
+                                     : static_cast<int32_t>(raw);
+    return true;
+}
+
+size_t DecodeInputReport(const InputReportTable* table,
+                         const uint8_t* buf, size_t len,
+                         const InputReport** layout,
+                         int32_t* values, size_t max_values) {
+    const InputReport* report = FindInputReport(table, buf, len);
+    if (report == nullptr || report->count > max_values)
+        return 0u;
+
+    // FindInputReport() checked that the whole report is in |buf|, and every
+    // field lies within the report, so no per-field bounds checks are needed.
+    for (size_t ix = 0; ix != report->count; ++ix) {
+        const InputField& field = report->fields[ix];
+        const uint32_t bit_sz = ClampedSize(field);
+        const uint32_t raw = ExtractBits(buf, field.bit_offset, bit_sz);
+        values[ix] = (field.logc_mm.min < 0) ? SignExtend(raw, bit_sz)
+                                             : static_cast<int32_t>(raw);
+    }
+
+    *layout = report;
+    return report->byte_sz;
+}
+
+}  // namespace hid
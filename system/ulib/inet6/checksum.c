@@ -2,34 +2,159 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #include <inet6/inet6.h>
 
+// The one's complement sum is taken over 16-bit words in host order, which
+// gives the same result as summing them in network order and swapping it.
+// Words are accumulated in 64 bits and only folded down to 16 at the end.
+
+// The number of 16-byte vectors summed before the 32-bit lanes of the SSE2
+// accumulators, which each gain a word per vector, could overflow.
+#define CSUM_SSE2_BLOCK 4096
+
+static inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t load32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint16_t load16(const uint8_t* p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint16_t fold(uint64_t sum) {
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)sum;
+}
 
-static uint16_t checksum(const void* _data, size_t len, uint16_t _sum) {
-    uint32_t sum = _sum;
-    const uint16_t* data = _data;
-    while (len > 1) {
-        sum += *data++;
+// Adds the |len| bytes at |src| to |sum|, and copies them to |dst| if |copy|.
+// Always inlined so that each caller gets a loop without the test.
+static inline __attribute__((always_inline))
+uint64_t csum_partial(uint8_t* dst, const uint8_t* src, size_t len, uint64_t sum, bool copy) {
+#if defined(__x86_64__)
+    const __m128i zero = _mm_setzero_si128();
+    while (len >= 16) {
+        __m128i lo = zero;
+        __m128i hi = zero;
+        for (size_t n = 0; len >= 16 && n < CSUM_SSE2_BLOCK; n++) {
+            __m128i v = _mm_loadu_si128((const __m128i*)src);
+            if (copy) {
+                _mm_storeu_si128((__m128i*)dst, v);
+                dst += 16;
+            }
+            lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+            hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+            src += 16;
+            len -= 16;
+        }
+        // Widen the lanes to 64 bits before summing them.
+        __m128i acc = _mm_add_epi64(_mm_add_epi64(_mm_unpacklo_epi32(lo, zero),
+                                                  _mm_unpackhi_epi32(lo, zero)),
+                                    _mm_add_epi64(_mm_unpacklo_epi32(hi, zero),
+                                                  _mm_unpackhi_epi32(hi, zero)));
+        uint64_t lanes[2];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+        sum += lanes[0] + lanes[1];
+    }
+#elif defined(__aarch64__)
+    if (len >= 16) {
+        uint64x2_t acc = vdupq_n_u64(0);
+        while (len >= 16) {
+            uint16x8_t v = vld1q_u16((const uint16_t*)src);
+            if (copy) {
+                vst1q_u16((uint16_t*)dst, v);
+                dst += 16;
+            }
+            // Pairs of words, then pairs of those, are added into 64 bits.
+            acc = vpadalq_u32(acc, vpaddlq_u16(v));
+            src += 16;
+            len -= 16;
+        }
+        sum += vgetq_lane_u64(acc, 0) + vgetq_lane_u64(acc, 1);
+    }
+#endif
+    // Each 32-bit half is added separately, so a 64-bit sum can't overflow
+    // short of 2^32 iterations.
+    while (len >= 8) {
+        uint64_t v = load64(src);
+        if (copy) {
+            memcpy(dst, &v, sizeof(v));
+            dst += 8;
+        }
+        sum += (v & 0xFFFFFFFF) + (v >> 32);
+        src += 8;
+        len -= 8;
+    }
+    if (len >= 4) {
+        uint32_t v = load32(src);
+        if (copy) {
+            memcpy(dst, &v, sizeof(v));
+            dst += 4;
+        }
+        sum += v;
+        src += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        uint16_t v = load16(src);
+        if (copy) {
+            memcpy(dst, &v, sizeof(v));
+            dst += 2;
+        }
+        sum += v;
+        src += 2;
         len -= 2;
     }
     if (len) {
-        sum += (*data & 0xFF);
-    }
-    while (sum > 0xFFFF) {
-        sum = (sum & 0xFFFF) + (sum >> 16);
+        if (copy) {
+            *dst = *src;
+        }
+        // A trailing byte is the first of a word padded with zero.
+        uint8_t last[2] = {*src, 0};
+        sum += load16(last);
     }
     return sum;
 }
 
-unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
+static uint16_t checksum(const void* data, size_t len, uint16_t sum) {
+    return fold(csum_partial(NULL, data, len, sum, false));
+}
+
+uint16_t ip6_checksum_copy(void* dst, const void* src, size_t len, uint16_t sum) {
+    return fold(csum_partial(dst, src, len, sum, true));
+}
+
+unsigned ip6_checksum_hdr(ip6_hdr_t* ip, unsigned type, size_t hdr_len, uint16_t payload_sum) {
     uint16_t sum;
 
     // length and protocol field for pseudo-header
     sum = checksum(&ip->length, 2, htons(type));
-    // src/dst for pseudo-header + payload
-    sum = checksum(&ip->src, 32 + length, sum);
+    // src/dst for pseudo-header + header
+    sum = checksum(&ip->src, 32 + hdr_len, sum);
+    // the rest of the payload
+    sum = fold((uint64_t)sum + payload_sum);
 
     // 0 is illegal, so 0xffff remains 0xffff
     if (sum != 0xffff) {
@@ -38,3 +163,7 @@ unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
         return sum;
     }
 }
+
+unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length) {
+    return ip6_checksum_hdr(ip, type, length, 0);
+}
@@ -158,6 +158,15 @@ void udp6_recv(void* data, size_t len,
 
 unsigned ip6_checksum(ip6_hdr_t* ip, unsigned type, size_t length);
 
+// Like ip6_checksum, for a packet whose |hdr_len| bytes after the ip header
+// are followed by a payload already summed into |payload_sum|, such as by
+// ip6_checksum_copy. |hdr_len| must be even.
+unsigned ip6_checksum_hdr(ip6_hdr_t* ip, unsigned type, size_t hdr_len, uint16_t payload_sum);
+
+// Copies |len| bytes from |src| to |dst|, and returns their one's complement
+// sum added to |sum|, in one pass.
+uint16_t ip6_checksum_copy(void* dst, const void* src, size_t len, uint16_t sum);
+
 // NOTES
 //
 // This is an extremely minimal IPv6 stack, supporting just enough
@@ -249,8 +249,8 @@ zx_status_t udp6_send(const void* data, size_t dlen, const ip6_addr_t* daddr, ui
     p->udp.length = htons(length);
     p->udp.checksum = 0;
 
-    memcpy(p->data, data, dlen);
-    p->udp.checksum = ip6_checksum(&p->ip6, HDR_UDP, length);
+    uint16_t sum = ip6_checksum_copy(p->data, data, dlen, 0);
+    p->udp.checksum = ip6_checksum_hdr(&p->ip6, HDR_UDP, UDP_HDR_LEN, sum);
     return eth_send(ethbuf, 2, ETH_HDR_LEN + IP6_HDR_LEN + length);
 }
 
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 
 #include <backtrace/backtrace.h>
 
@@ -20,8 +21,10 @@
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/object.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
+#include <fbl/atomic.h>
 
 #include "inspector/inspector.h"
 #include "dso-list-impl.h"
@@ -32,6 +35,9 @@ namespace inspector {
 // Keep open debug info for this many files.
 constexpr size_t kDebugInfoCacheNumWays = 2;
 
+// Most threads to unwind at once in inspector_print_backtraces.
+constexpr size_t kMaxBacktraceWorkers = 8;
+
 // Error callback for libbacktrace.
 
 static void
@@ -399,4 +405,72 @@ void inspector_print_backtrace(FILE* f,
                                   use_libunwind, false);
 }
 
+namespace {
+
+struct BacktraceWork {
+    FILE** out_files;
+    zx_handle_t process;
+    const zx_handle_t* threads;
+    size_t num_threads;
+    inspector_dsoinfo_t* dso_list;
+    bool use_libunwind;
+    // Index of the next thread to unwind.
+    fbl::atomic<size_t> next;
+};
+
+int backtrace_worker(void* arg) {
+    auto work = static_cast<BacktraceWork*>(arg);
+    size_t i;
+    while ((i = work->next.fetch_add(1)) < work->num_threads) {
+        zx_thread_state_general_regs_t regs;
+        if (inspector_read_general_regs(work->threads[i], &regs) != ZX_OK) {
+            // Error message has already been printed.
+            continue;
+        }
+#if defined(__x86_64__)
+        uintptr_t pc = regs.rip, sp = regs.rsp, fp = regs.rbp;
+#elif defined(__aarch64__)
+        uintptr_t pc = regs.pc, sp = regs.sp, fp = regs.r[29];
+#else
+        uintptr_t pc = 0, sp = 0, fp = 0;
+        continue;
+#endif
+        inspector_print_backtrace_impl(work->out_files[i], work->process, work->threads[i],
+                                       work->dso_list, pc, sp, fp,
+                                       work->use_libunwind, false);
+    }
+    return 0;
+}
+
+} // namespace
+
+extern "C"
+void inspector_print_backtraces(FILE** out_files, zx_handle_t process,
+                                const zx_handle_t* threads, size_t num_threads,
+                                inspector_dsoinfo_t* dso_list,
+                                bool use_libunwind) {
+    BacktraceWork work{out_files, process, threads, num_threads, dso_list,
+                       use_libunwind, {0}};
+
+    // The calling thread is one of the workers. If we can't start any
+    // more it simply unwinds everything itself.
+    size_t num_workers = fbl::min(num_threads, kMaxBacktraceWorkers);
+    thrd_t workers[kMaxBacktraceWorkers];
+    size_t started = 0;
+    while (started + 1 < num_workers) {
+        if (thrd_create_with_name(&workers[started], backtrace_worker, &work,
+                                  "inspector-backtrace") != thrd_success) {
+            debugf(1, "unable to start backtrace worker thread\n");
+            break;
+        }
+        ++started;
+    }
+
+    backtrace_worker(&work);
+
+    for (size_t i = 0; i < started; ++i) {
+        thrd_join(workers[i], nullptr);
+    }
+}
+
 }  // namespace inspector
@@ -12,6 +12,8 @@
 #include <unistd.h>
 
 #include <elf-search.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <zircon/assert.h>
 #include <zircon/syscalls.h>
 #include <zircon/types.h>
@@ -33,6 +35,70 @@ using inspector::fetch_build_id;
 const char kDebugDirectory[] = "/boot/debug";
 const char kDebugSuffix[] = ".debug";
 
+namespace {
+
+// Results of looking for debug files, keyed by build ID and shared by every
+// dso list in this process. A long-lived client such as crashanalyzer sees
+// the same few DSOs over and over, e.g. when a service is stuck in a crash
+// loop, and this saves it probing the filesystem for each one every time.
+constexpr size_t kDebugFileCacheSize = 64;
+
+struct DebugFileCacheEntry {
+    char buildid[MAX_BUILDID_SIZE * 2 + 1];
+    zx_status_t status;
+    // Owned by the cache, nullptr unless |status| is ZX_OK.
+    char* debug_file;
+};
+
+fbl::Mutex debug_file_cache_lock;
+DebugFileCacheEntry debug_file_cache[kDebugFileCacheSize] __TA_GUARDED(debug_file_cache_lock);
+size_t debug_file_cache_next __TA_GUARDED(debug_file_cache_lock);
+
+// Build IDs we couldn't read are left as all 'x's; those can't be cached.
+bool have_buildid(const inspector_dsoinfo_t* dso) {
+    return dso->buildid[0] != 'x';
+}
+
+// Fills in |dso|'s debug file from the cache. Returns false on a miss.
+bool debug_file_cache_lookup(inspector_dsoinfo_t* dso) {
+    fbl::AutoLock lock(&debug_file_cache_lock);
+    for (const auto& entry : debug_file_cache) {
+        if (strcmp(entry.buildid, dso->buildid) != 0) {
+            continue;
+        }
+        if (entry.status == ZX_OK) {
+            dso->debug_file = strdup(entry.debug_file);
+            if (dso->debug_file == nullptr) {
+                return false;
+            }
+        }
+        dso->debug_file_status = entry.status;
+        return true;
+    }
+    return false;
+}
+
+void debug_file_cache_insert(const inspector_dsoinfo_t* dso) {
+    char* debug_file = nullptr;
+    if (dso->debug_file_status == ZX_OK) {
+        debug_file = strdup(dso->debug_file);
+        if (debug_file == nullptr) {
+            return;
+        }
+    }
+
+    fbl::AutoLock lock(&debug_file_cache_lock);
+    // Replace entries round-robin; the working set is expected to fit.
+    DebugFileCacheEntry& entry = debug_file_cache[debug_file_cache_next];
+    debug_file_cache_next = (debug_file_cache_next + 1) % kDebugFileCacheSize;
+    free(entry.debug_file);
+    strlcpy(entry.buildid, dso->buildid, sizeof(entry.buildid));
+    entry.status = dso->debug_file_status;
+    entry.debug_file = debug_file;
+}
+
+} // namespace
+
 static inspector_dsoinfo_t* dsolist_add(inspector_dsoinfo_t** list,
                                         const char* name, uintptr_t base) {
     if (!strncmp(name, "app:devhost:", 12)) {
@@ -206,6 +272,14 @@ zx_status_t inspector_dso_find_debug_file(inspector_dsoinfo_t* dso,
 
     dso->debug_file_tried = true;
 
+    if (have_buildid(dso) && debug_file_cache_lookup(dso)) {
+        debugf(2, "using cached debug file lookup for %s\n", dso->name);
+        if (dso->debug_file_status == ZX_OK) {
+            *out_debug_file = dso->debug_file;
+        }
+        return dso->debug_file_status;
+    }
+
     char* path;
     if (asprintf(&path, "%s/%s%s", kDebugDirectory, dso->buildid, kDebugSuffix) < 0) {
         debugf(1, "OOM building debug file path for dso %s\n", dso->name);
@@ -228,5 +302,9 @@ zx_status_t inspector_dso_find_debug_file(inspector_dsoinfo_t* dso,
         dso->debug_file_status = ZX_OK;
     }
 
+    if (have_buildid(dso)) {
+        debug_file_cache_insert(dso);
+    }
+
     return dso->debug_file_status;
 }
@@ -53,6 +53,16 @@ extern void inspector_print_backtrace(FILE* f,
                                       uintptr_t pc, uintptr_t sp, uintptr_t fp,
                                       bool use_libunwind);
 
+// Print backtraces of the |num_threads| |threads| of |process|, the
+// backtrace of |threads[i]| going to |out_files[i]|, in the format of
+// inspector_print_backtrace(). The threads must all currently be stopped.
+// They are unwound in parallel, so the files must all be distinct.
+extern void inspector_print_backtraces(FILE** out_files, zx_handle_t process,
+                                       const zx_handle_t* threads,
+                                       size_t num_threads,
+                                       inspector_dsoinfo_t* dso_list,
+                                       bool use_libunwind);
+
 // Fetch the list of the DSOs of |process|.
 // |name| is the name of the application binary.
 extern inspector_dsoinfo_t* inspector_dso_fetch_list(zx_handle_t process);
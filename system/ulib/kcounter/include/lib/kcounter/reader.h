@@ -0,0 +1,105 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fbl/array.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <lib/fzl/vmo-mapper.h>
+#include <lib/zircon-internal/kcounter-vmo.h>
+#include <lib/zx/time.h>
+#include <lib/zx/vmo.h>
+
+namespace kcounter {
+
+// A copy of every per-cpu counter value, taken at one point in time.
+class Snapshot {
+public:
+    Snapshot() = default;
+    DISALLOW_COPY_AND_ASSIGN_ALLOW_MOVE(Snapshot);
+
+    // The monotonic time at which the snapshot was taken.
+    zx::time time() const { return time_; }
+    size_t num_counters() const { return num_counters_; }
+    size_t max_cpus() const { return max_cpus_; }
+
+    // The value of counter |index| on |cpu|.
+    int64_t Get(size_t index, size_t cpu) const {
+        return values_[cpu * num_counters_ + index];
+    }
+
+    // The value of counter |index| summed over all cpus.
+    int64_t Sum(size_t index) const;
+
+    // Sets |out| to the change in every value from |earlier| to this
+    // snapshot, with this snapshot's time.  Both snapshots must come from
+    // the same Reader.
+    zx_status_t Diff(const Snapshot& earlier, Snapshot* out) const;
+
+private:
+    friend class Reader;
+
+    // Makes room for |max_cpus| * |num_counters| values, reusing the
+    // current storage when it is already the right size.
+    zx_status_t Reset(size_t num_counters, size_t max_cpus);
+
+    zx::time time_;
+    size_t num_counters_ = 0;
+    size_t max_cpus_ = 0;
+    fbl::Array<int64_t> values_;
+};
+
+// Reads the kernel counters from the VMOs the kernel publishes them in
+// (see <lib/zircon-internal/kcounter-vmo.h>).  Both VMOs stay mapped for
+// the life of the Reader, so reading the counters makes no syscalls.
+class Reader {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Reader);
+
+    // Maps the counters published at /boot/kernel/counters.
+    static zx_status_t Create(fbl::unique_ptr<Reader>* out);
+
+    // Maps the given descriptor and arena VMOs.
+    static zx_status_t Create(zx::vmo desc_vmo, zx::vmo arena_vmo,
+                              fbl::unique_ptr<Reader>* out);
+
+    size_t num_counters() const { return num_counters_; }
+    size_t max_cpus() const { return max_cpus_; }
+
+    // The name of counter |index|.  Counters are sorted by name.
+    const char* name(size_t index) const { return header()->descs[index].name; }
+
+    // Sets |out_index| to the index of the counter called |name|, or returns
+    // ZX_ERR_NOT_FOUND.
+    zx_status_t Find(const char* name, size_t* out_index) const;
+
+    // The current value of counter |index| summed over all cpus.
+    int64_t Read(size_t index) const;
+
+    // Copies the current value of every counter on every cpu into |out|.
+    // Each value is read with a single load, so no value is torn, but the
+    // cpus keep counting while the copy is made.
+    zx_status_t TakeSnapshot(Snapshot* out) const;
+
+private:
+    Reader() = default;
+
+    const kcounter_vmo_header_t* header() const {
+        return static_cast<const kcounter_vmo_header_t*>(desc_mapping_.start());
+    }
+    const int64_t* arena() const {
+        return static_cast<const int64_t*>(arena_mapping_.start());
+    }
+
+    fzl::VmoMapper desc_mapping_;
+    fzl::VmoMapper arena_mapping_;
+    size_t num_counters_ = 0;
+    size_t max_cpus_ = 0;
+};
+
+} // namespace kcounter
@@ -0,0 +1,185 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/kcounter/reader.h>
+
+#include <fcntl.h>
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_fd.h>
+#include <lib/fdio/io.h>
+
+namespace kcounter {
+namespace {
+
+constexpr char kDescPath[] = "/boot/kernel/" KCOUNTER_DESC_VMO_NAME;
+constexpr char kArenaPath[] = "/boot/kernel/" KCOUNTER_ARENA_VMO_NAME;
+
+zx_status_t OpenVmo(const char* path, zx::vmo* out) {
+    fbl::unique_fd fd(open(path, O_RDONLY));
+    if (!fd) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    return fdio_get_vmo_exact(fd.get(), out->reset_and_get_address());
+}
+
+zx_status_t GetSize(const zx::vmo& vmo, size_t* out) {
+    uint64_t size;
+    zx_status_t status = vmo.get_size(&size);
+    if (status == ZX_OK) {
+        *out = static_cast<size_t>(size);
+    }
+    return status;
+}
+
+} // namespace
+
+int64_t Snapshot::Sum(size_t index) const {
+    int64_t sum = 0;
+    for (size_t cpu = 0; cpu < max_cpus_; ++cpu) {
+        sum += Get(index, cpu);
+    }
+    return sum;
+}
+
+zx_status_t Snapshot::Diff(const Snapshot& earlier, Snapshot* out) const {
+    if (earlier.num_counters_ != num_counters_ || earlier.max_cpus_ != max_cpus_) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    zx_status_t status = out->Reset(num_counters_, max_cpus_);
+    if (status != ZX_OK) {
+        return status;
+    }
+    for (size_t i = 0; i < values_.size(); ++i) {
+        out->values_[i] = values_[i] - earlier.values_[i];
+    }
+    out->time_ = time_;
+    return ZX_OK;
+}
+
+zx_status_t Snapshot::Reset(size_t num_counters, size_t max_cpus) {
+    size_t count = num_counters * max_cpus;
+    if (values_.size() != count) {
+        fbl::AllocChecker ac;
+        int64_t* values = new (&ac) int64_t[count];
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        values_.reset(values, count);
+    }
+    num_counters_ = num_counters;
+    max_cpus_ = max_cpus;
+    return ZX_OK;
+}
+
+zx_status_t Reader::Create(fbl::unique_ptr<Reader>* out) {
+    zx::vmo desc_vmo;
+    zx_status_t status = OpenVmo(kDescPath, &desc_vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    zx::vmo arena_vmo;
+    status = OpenVmo(kArenaPath, &arena_vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    return Create(fbl::move(desc_vmo), fbl::move(arena_vmo), out);
+}
+
+zx_status_t Reader::Create(zx::vmo desc_vmo, zx::vmo arena_vmo,
+                           fbl::unique_ptr<Reader>* out) {
+    size_t desc_size, arena_size;
+    zx_status_t status = GetSize(desc_vmo, &desc_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = GetSize(arena_vmo, &arena_size);
+    if (status != ZX_OK) {
+        return status;
+    }
+    if (desc_size < sizeof(kcounter_vmo_header_t)) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Reader> reader(new (&ac) Reader());
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    status = reader->desc_mapping_.Map(desc_vmo, 0, desc_size, ZX_VM_PERM_READ);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = reader->arena_mapping_.Map(arena_vmo, 0, arena_size, ZX_VM_PERM_READ);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Check that the layout the descriptor table describes fits in the VMOs.
+    const kcounter_vmo_header_t* header = reader->header();
+    if (header->magic != KCOUNTER_VMO_MAGIC) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    size_t num_counters = header->num_counters;
+    size_t max_cpus = header->max_cpus;
+    if (max_cpus == 0 ||
+        (desc_size - sizeof(*header)) / sizeof(header->descs[0]) < num_counters ||
+        arena_size / sizeof(int64_t) / max_cpus < num_counters) {
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    for (size_t i = 0; i < num_counters; ++i) {
+        if (memchr(header->descs[i].name, '\0', KCOUNTER_MAX_NAME) == nullptr) {
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+
+    reader->num_counters_ = num_counters;
+    reader->max_cpus_ = max_cpus;
+    *out = fbl::move(reader);
+    return ZX_OK;
+}
+
+zx_status_t Reader::Find(const char* name, size_t* out_index) const {
+    // Binary search the descriptors, which the kernel sorts by name.
+    size_t first = 0;
+    size_t count = num_counters_;
+    while (count > 0) {
+        size_t step = count / 2;
+        if (strcmp(this->name(first + step), name) < 0) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    if (first == num_counters_ || strcmp(this->name(first), name) != 0) {
+        return ZX_ERR_NOT_FOUND;
+    }
+    *out_index = first;
+    return ZX_OK;
+}
+
+int64_t Reader::Read(size_t index) const {
+    int64_t sum = 0;
+    for (size_t cpu = 0; cpu < max_cpus_; ++cpu) {
+        sum += __atomic_load_n(&arena()[cpu * num_counters_ + index], __ATOMIC_RELAXED);
+    }
+    return sum;
+}
+
+zx_status_t Reader::TakeSnapshot(Snapshot* out) const {
+    zx_status_t status = out->Reset(num_counters_, max_cpus_);
+    if (status != ZX_OK) {
+        return status;
+    }
+    out->time_ = zx::clock::get_monotonic();
+    const int64_t* arena = this->arena();
+    for (size_t i = 0; i < out->values_.size(); ++i) {
+        out->values_[i] = __atomic_load_n(&arena[i], __ATOMIC_RELAXED);
+    }
+    return ZX_OK;
+}
+
+} // namespace kcounter
@@ -23,6 +23,7 @@ __BEGIN_CDECLS
 #define LDMSG_OP_CLONE                   5u
 #define LDMSG_OP_DEBUG_PUBLISH_DATA_SINK 7u
 #define LDMSG_OP_DEBUG_LOAD_CONFIG       8u
+#define LDMSG_OP_LOAD_OBJECTS            9u
 
 // The payload format used for all the requests other than LDMSG_OP_CLONE.
 typedef struct ldmsg_common ldmsg_common_t;
@@ -74,6 +75,23 @@ struct ldmsg_rsp {
     zx_handle_t object;
 };
 
+// The most objects a LDMSG_OP_LOAD_OBJECTS request can name.
+#define LDMSG_MAX_OBJECTS 16u
+
+// The message format used for responses to LDMSG_OP_LOAD_OBJECTS, whose
+// request names the objects each followed by a newline. There is a handle
+// for each name, which is absent if that object could not be loaded.
+//
+// Consider using |ldmsg_rsp_objects_get_size| to determine how much of this
+// structure is used for a given number of objects.
+typedef struct ldmsg_rsp_objects ldmsg_rsp_objects_t;
+struct ldmsg_rsp_objects {
+    fidl_message_header_t header;
+    zx_status_t rv;
+    alignas(FIDL_ALIGNMENT) fidl_vector_t objects;
+    alignas(FIDL_ALIGNMENT) zx_handle_t handles[LDMSG_MAX_OBJECTS];
+};
+
 // Encode the message in |req|.
 //
 // The format of the message will be determined by the ordinal in the message's
@@ -112,4 +130,8 @@ zx_status_t ldmsg_req_decode(ldmsg_req_t* req, size_t req_len,
 // header. If the ordinal is invalid, this function will return 0.
 size_t ldmsg_rsp_get_size(ldmsg_rsp_t* rsp);
 
+// The appropriate size message to send for the given |rsp|, which holds
+// |rsp->objects.count| handles.
+size_t ldmsg_rsp_objects_get_size(const ldmsg_rsp_objects_t* rsp);
+
 __END_CDECLS
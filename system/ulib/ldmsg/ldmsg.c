@@ -4,6 +4,7 @@
 
 #include <ldmsg/ldmsg.h>
 
+#include <stddef.h>
 #include <string.h>
 
 static_assert(sizeof(ldmsg_req_t) == 1024,
@@ -29,6 +30,7 @@ zx_status_t ldmsg_req_encode(ldmsg_req_t* req, size_t* req_len_out,
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_CONFIG:
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
+    case LDMSG_OP_LOAD_OBJECTS:
         offset = sizeof(fidl_string_t);
         break;
     case LDMSG_OP_DEBUG_PUBLISH_DATA_SINK:
@@ -72,6 +74,7 @@ zx_status_t ldmsg_req_decode(ldmsg_req_t* req, size_t req_len,
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_CONFIG:
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
+    case LDMSG_OP_LOAD_OBJECTS:
         if ((uintptr_t)req->common.string.data != FIDL_ALLOC_PRESENT)
             return ZX_ERR_INVALID_ARGS;
         offset = sizeof(fidl_string_t);
@@ -116,3 +119,8 @@ size_t ldmsg_rsp_get_size(ldmsg_rsp_t* rsp) {
         return 0;
     }
 }
+
+size_t ldmsg_rsp_objects_get_size(const ldmsg_rsp_objects_t* rsp) {
+    return offsetof(ldmsg_rsp_objects_t, handles) +
+        FidlAlign((uint32_t)(rsp->objects.count * sizeof(zx_handle_t)));
+}
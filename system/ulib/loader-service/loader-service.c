@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <threads.h>
 #include <unistd.h>
 #include <zircon/compiler.h>
 #include <zircon/device/vfs.h>
@@ -26,6 +27,21 @@
 
 #define PREFIX_MAX 32
 
+#define VMO_CACHE_BUCKETS 64
+#define VMO_CACHE_MAX 256
+
+// The VMO of a library which has been loaded, keyed by its path. The
+// libraries of the fd and fs loader services come from bootfs and from
+// package storage, where the file at a path never changes once it is there,
+// so every load of the path gets a copy-on-write clone of the same VMO.
+typedef struct vmo_cache_entry vmo_cache_entry_t;
+struct vmo_cache_entry {
+    vmo_cache_entry_t* next;
+    zx_handle_t vmo;
+    uint64_t size;
+    char path[];
+};
+
 // State of a loader service instance.
 typedef struct instance_state instance_state_t;
 struct instance_state {
@@ -33,6 +49,10 @@ struct instance_state {
   int data_sink_dir_fd;
   // NULL-terminated list of paths from which objects will loaded.
   const char* const* lib_paths;
+
+  mtx_t cache_lock;
+  vmo_cache_entry_t* cache[VMO_CACHE_BUCKETS];
+  size_t cache_count;
 };
 
 // This represents an instance of the loader service. Each session in an
@@ -67,47 +87,117 @@ static void loader_service_deref(loader_service_t* svc) {
     }
 }
 
-// When loading a library object, search in the locations provided in
-// |lib_paths|, which is required to be NULL-terminated.
-static int open_from_lib_paths(int root_dir_fd, const char* const* lib_paths,
-                               const char* fn) {
-    int fd = -1;
-    for (size_t n = 0; fd < 0 && lib_paths[n]; ++n) {
-        char path[PATH_MAX];
-        if (snprintf(path, sizeof(path), "%s/%s", lib_paths[n], fn) < 0) {
-            return -1;
-        }
-        fd = openat(root_dir_fd, path, O_RDONLY);
+// Opens |path| and gets its VMO in a single round trip, naming the VMO |fn|.
+static zx_status_t vmo_from_path(int root_dir_fd, const char* path, const char* fn,
+                                 zx_handle_t* out) {
+    zx_status_t status = fdio_open_vmo_at(root_dir_fd, path, out);
+    if (status == ZX_OK) {
+        zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
     }
-    return fd;
+    return status;
 }
 
-// Always consumes the |fd|.
-static zx_handle_t vmo_from_fd(int fd, const char* fn, zx_handle_t* out) {
-    zx_status_t status = fdio_get_vmo_clone(fd, out);
-    close(fd);
+static vmo_cache_entry_t** vmo_cache_bucket(instance_state_t* state, const char* path) {
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (const char* p = path; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return &state->cache[hash % VMO_CACHE_BUCKETS];
+}
+
+// Gives |out| a clone of the cached VMO of |path|, named |fn|.
+static zx_status_t vmo_cache_clone(instance_state_t* state, const char* path, const char* fn,
+                                   zx_handle_t* out) {
+    zx_status_t status = ZX_ERR_NOT_FOUND;
+    mtx_lock(&state->cache_lock);
+    for (vmo_cache_entry_t* entry = *vmo_cache_bucket(state, path); entry; entry = entry->next) {
+        if (!strcmp(entry->path, path)) {
+            status = zx_vmo_clone(entry->vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, entry->size, out);
+            break;
+        }
+    }
+    mtx_unlock(&state->cache_lock);
     if (status == ZX_OK) {
         zx_object_set_property(*out, ZX_PROP_NAME, fn, strlen(fn));
     }
     return status;
 }
 
+// Takes |vmo|, just loaded from |path|, into the cache, and gives |out| a
+// clone of it to hand out. If it can't be cached, |out| gets |vmo| itself.
+static void vmo_cache_insert(instance_state_t* state, const char* path, zx_handle_t vmo,
+                             zx_handle_t* out) {
+    *out = vmo;
+    uint64_t size;
+    if (zx_vmo_get_size(vmo, &size) != ZX_OK) {
+        return;
+    }
+    size_t len = strlen(path) + 1;
+    vmo_cache_entry_t* entry = malloc(sizeof(*entry) + len);
+    if (entry == NULL) {
+        return;
+    }
+    if (zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, out) != ZX_OK) {
+        *out = vmo;
+        free(entry);
+        return;
+    }
+    char name[ZX_MAX_NAME_LEN];
+    if (zx_object_get_property(vmo, ZX_PROP_NAME, name, sizeof(name)) == ZX_OK) {
+        zx_object_set_property(*out, ZX_PROP_NAME, name, strlen(name));
+    }
+    entry->vmo = vmo;
+    entry->size = size;
+    memcpy(entry->path, path, len);
+
+    mtx_lock(&state->cache_lock);
+    vmo_cache_entry_t** bucket = vmo_cache_bucket(state, path);
+    // Another request may have cached the same path in the meantime.
+    bool cached = state->cache_count >= VMO_CACHE_MAX;
+    for (vmo_cache_entry_t* other = *bucket; !cached && other; other = other->next) {
+        cached = !strcmp(other->path, path);
+    }
+    if (!cached) {
+        entry->next = *bucket;
+        *bucket = entry;
+        state->cache_count++;
+    }
+    mtx_unlock(&state->cache_lock);
+    if (cached) {
+        zx_handle_close(vmo);
+        free(entry);
+    }
+}
+
+// When loading a library object, search in the locations provided in
+// |lib_paths|, which is required to be NULL-terminated.
 static zx_status_t fd_load_object(void* ctx, const char* name, zx_handle_t* out) {
-    int root_dir_fd = ((instance_state_t*)ctx)->root_dir_fd;
-    const char* const* lib_paths = ((instance_state_t*)ctx)->lib_paths;
+    instance_state_t* state = (instance_state_t*)ctx;
+    int root_dir_fd = state->root_dir_fd;
+    const char* const* lib_paths = state->lib_paths;
 
-    int fd = open_from_lib_paths(root_dir_fd, lib_paths, name);
-    if (fd >= 0) {
-        return vmo_from_fd(fd, name, out);
+    for (size_t n = 0; lib_paths[n]; ++n) {
+        char path[PATH_MAX];
+        if (snprintf(path, sizeof(path), "%s/%s", lib_paths[n], name) < 0) {
+            break;
+        }
+        if (vmo_cache_clone(state, path, name, out) == ZX_OK) {
+            return ZX_OK;
+        }
+        zx_handle_t vmo;
+        if (vmo_from_path(root_dir_fd, path, name, &vmo) == ZX_OK) {
+            vmo_cache_insert(state, path, vmo, out);
+            return ZX_OK;
+        }
     }
     return ZX_ERR_NOT_FOUND;
 }
 
 static zx_status_t fd_load_abspath(void* ctx, const char* path, zx_handle_t* out) {
     int root_dir_fd = ((instance_state_t*)ctx)->root_dir_fd;
-    int fd = openat(root_dir_fd, path, O_RDONLY);
-    if (fd >= 0) {
-        return vmo_from_fd(fd, path, out);
+    if (vmo_from_path(root_dir_fd, path, path, out) == ZX_OK) {
+        return ZX_OK;
     }
     return ZX_ERR_NOT_FOUND;
 }
@@ -123,6 +213,15 @@ void fd_finalizer(void* ctx) {
     int data_sink_dir_fd = instance_state->data_sink_dir_fd;
     close(root_dir_fd);
     close(data_sink_dir_fd);
+    for (size_t i = 0; i < VMO_CACHE_BUCKETS; i++) {
+        vmo_cache_entry_t* entry = instance_state->cache[i];
+        while (entry) {
+            vmo_cache_entry_t* next = entry->next;
+            zx_handle_close(entry->vmo);
+            free(entry);
+            entry = next;
+        }
+    }
     free(instance_state);
 }
 
@@ -133,6 +232,72 @@ static const loader_service_ops_t fd_ops = {
     .finalizer = fd_finalizer,
 };
 
+static zx_status_t load_object(session_state_t* session_state, const char* name,
+                               zx_handle_t* out) {
+    loader_service_t* svc = session_state->svc;
+    // If a prefix is configured, try loading with that prefix first
+    if (session_state->config_prefix[0] != '\0') {
+        size_t maxlen = PREFIX_MAX + strlen(name) + 1;
+        char prefixed_name[maxlen];
+        snprintf(prefixed_name, maxlen, "%s%s", session_state->config_prefix, name);
+        zx_status_t status = svc->ops->load_object(svc->ctx, prefixed_name, out);
+        if (status == ZX_OK || session_state->config_exclusive) {
+            // if loading with prefix succeeds, or loading
+            // with prefix is configured to be exclusive of
+            // non-prefix loading, stop here
+            return status;
+        }
+        // otherwise, if non-exclusive, try loading without the prefix
+    }
+    return svc->ops->load_object(svc->ctx, name, out);
+}
+
+// Loads each of the newline-terminated |names|, and replies with a handle
+// for each, which is absent for those not found.
+static zx_status_t load_objects_rpc(zx_handle_t h, session_state_t* session_state,
+                                    const fidl_message_header_t* req_header, char* names) {
+    ldmsg_rsp_objects_t rsp;
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.header.txid = req_header->txid;
+    rsp.header.ordinal = req_header->ordinal;
+    rsp.objects.data = (void*)FIDL_ALLOC_PRESENT;
+
+    zx_handle_t handles[LDMSG_MAX_OBJECTS];
+    uint32_t handle_count = 0;
+    rsp.rv = ZX_OK;
+    for (char* name = names; *name != '\0';) {
+        char* end = strchr(name, '\n');
+        if (end == NULL || end == name || rsp.objects.count == LDMSG_MAX_OBJECTS) {
+            rsp.rv = ZX_ERR_INVALID_ARGS;
+            break;
+        }
+        *end = '\0';
+        zx_handle_t vmo = ZX_HANDLE_INVALID;
+        if (load_object(session_state, name, &vmo) == ZX_OK) {
+            handles[handle_count++] = vmo;
+        } else {
+            fprintf(stderr, "dlsvc: could not open '%s'\n", name);
+        }
+        rsp.handles[rsp.objects.count++] =
+            vmo == ZX_HANDLE_INVALID ? FIDL_HANDLE_ABSENT : FIDL_HANDLE_PRESENT;
+        name = end + 1;
+    }
+    if (rsp.rv != ZX_OK) {
+        zx_handle_close_many(handles, handle_count);
+        handle_count = 0;
+        rsp.objects.count = 0;
+        rsp.objects.data = NULL;
+    }
+
+    zx_status_t status = zx_channel_write(h, 0, &rsp, ldmsg_rsp_objects_get_size(&rsp),
+                                          handles, handle_count);
+    if (status < 0) {
+        fprintf(stderr, "dlsvc: msg write error: %d: %s\n", status, zx_status_get_string(status));
+        return status;
+    }
+    return ZX_OK;
+}
+
 static zx_status_t loader_service_rpc(zx_handle_t h, session_state_t* session_state) {
     loader_service_t* svc = session_state->svc;
     ldmsg_req_t req;
@@ -179,22 +344,12 @@ static zx_status_t loader_service_rpc(zx_handle_t h, session_state_t* session_st
         break;
     }
     case LDMSG_OP_LOAD_OBJECT:
-        // If a prefix is configured, try loading with that prefix first
-        if (session_state->config_prefix[0] != '\0') {
-            size_t maxlen = PREFIX_MAX + strlen(data) + 1;
-            char prefixed_name[maxlen];
-            snprintf(prefixed_name, maxlen, "%s%s", session_state->config_prefix, data);
-            if (((status = svc->ops->load_object(svc->ctx, prefixed_name, &rsp_handle)) == ZX_OK) ||
-                session_state->config_exclusive) {
-                // if loading with prefix succeeds, or loading
-                // with prefix is configured to be exclusive of
-                // non-prefix loading, stop here
-                break;
-            }
-            // otherwise, if non-exclusive, try loading without the prefix
-        }
-        status = svc->ops->load_object(svc->ctx, data, &rsp_handle);
+        status = load_object(session_state, data, &rsp_handle);
         break;
+    case LDMSG_OP_LOAD_OBJECTS:
+        zx_handle_close(req_handle);
+        // The string is in |req|, which is ours to modify.
+        return load_objects_rpc(h, session_state, &req.header, (char*)data);
     case LDMSG_OP_LOAD_SCRIPT_INTERPRETER:
     case LDMSG_OP_DEBUG_LOAD_CONFIG:
         // When loading a script interpreter or debug configuration file,
@@ -307,13 +462,14 @@ zx_status_t loader_service_create_default(async_dispatcher_t* dispatcher,
                                           int data_sink_dir_fd,
                                           const char* const* lib_paths,
                                           loader_service_t** out) {
-    instance_state_t* instance_state = calloc(1, sizeof(loader_service_t));
+    instance_state_t* instance_state = calloc(1, sizeof(instance_state_t));
     if (instance_state == NULL) {
         return ZX_ERR_NO_MEMORY;
     }
     instance_state->root_dir_fd = root_dir_fd;
     instance_state->data_sink_dir_fd = data_sink_dir_fd;
     instance_state->lib_paths = lib_paths? lib_paths : fd_lib_paths;
+    mtx_init(&instance_state->cache_lock, mtx_plain);
 
     loader_service_t* svc;
     zx_status_t status = loader_service_create(dispatcher, &fd_ops, NULL, &svc);
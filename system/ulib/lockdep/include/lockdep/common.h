@@ -31,6 +31,21 @@ namespace lockdep {
 #define LOCK_DEP_ENABLE_VALIDATION 0
 #endif
 
+// Configures whether lock contention profiling is enabled or not. Defaults to
+// disabled. When enabled every lock class keeps counts of acquisitions and
+// contended acquisitions together with wait and hold times. Profiling uses the
+// lock class ids that are only tracked when validation is enabled.
+#ifndef LOCK_DEP_ENABLE_PROFILING
+#define LOCK_DEP_ENABLE_PROFILING 0
+#endif
+
+// Configures how long, in nanoseconds, a profiled acquisition may wait for its
+// lock before it counts as contended. Taking an uncontended lock costs well
+// under this, whatever the lock type.
+#ifndef LOCK_DEP_CONTENTION_THRESHOLD_NS
+#define LOCK_DEP_CONTENTION_THRESHOLD_NS 1000
+#endif
+
 // Id type used to identify each lock class.
 using LockClassId = uintptr_t;
 
@@ -82,6 +97,21 @@ using IfLockValidationEnabled = typename fbl::conditional<kLockValidationEnabled
                                                           EnabledType,
                                                           DisabledType>::type;
 
+// Whether or not lock contention profiling is globally enabled.
+constexpr bool kLockProfilingEnabled = static_cast<bool>(LOCK_DEP_ENABLE_PROFILING);
+static_assert(!kLockProfilingEnabled || kLockValidationEnabled,
+              "LOCK_DEP_ENABLE_PROFILING requires LOCK_DEP_ENABLE_VALIDATION!");
+
+// The wait beyond which a profiled acquisition counts as contended.
+constexpr uint64_t kLockContentionThresholdNs = LOCK_DEP_CONTENTION_THRESHOLD_NS;
+
+// Utility template alias to simplify selecting different types based whether
+// lock profiling is enabled or disabled.
+template <typename EnabledType, typename DisabledType>
+using IfLockProfilingEnabled = typename fbl::conditional<kLockProfilingEnabled,
+                                                          EnabledType,
+                                                          DisabledType>::type;
+
 // Result type that represents whether a lock attempt was successful, or if not
 // which check failed.
 enum class LockResult : uint8_t {
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <zircon/assert.h>
 #include <zircon/compiler.h>
 
@@ -11,6 +12,7 @@
 
 #include <lockdep/common.h>
 #include <lockdep/lock_class.h>
+#include <lockdep/lock_class_state.h>
 #include <lockdep/lock_policy.h>
 #include <lockdep/lock_traits.h>
 
@@ -82,7 +84,7 @@ public:
               typename = internal::EnableIfNotNestable<Lockable, LockType>>
     Guard(Lockable* lock, Args&&... state_args)
         __TA_ACQUIRE(lock) __TA_ACQUIRE(lock->capability())
-        : validator_{lock->id()}, lock_{&lock->lock()},
+        : validator_{lock->id()}, profiler_{lock->id()}, lock_{&lock->lock()},
           state_{fbl::forward<Args>(state_args)...} { ValidateAndAcquire(); }
 
     // Acquires the given lock. This constructor participates in overload
@@ -102,6 +104,7 @@ public:
     template <typename... Args>
     void Release(Args&&... args) __TA_RELEASE() {
         if (lock_ != nullptr) {
+            profiler_.Release();
             LockPolicy<LockType, Option>::Release(lock_, &state_,
                                                   fbl::forward<Args>(args)...);
             validator_.ValidateRelease();
@@ -139,7 +142,8 @@ public:
     //  Guard<fbl::Mutex> guard{AdoptLock, fbl::move(rvalue_arugment)};
     //
     Guard(AdoptLockTag, Guard&& other) __TA_ACQUIRE(other.lock_)
-        : validator_{fbl::move(other.validator_)}, lock_{other.lock_},
+        : validator_{fbl::move(other.validator_)},
+          profiler_{fbl::move(other.profiler_)}, lock_{other.lock_},
           state_{fbl::move(other.state_)} { other.lock_ = nullptr; }
 
     // Temporarily releases and un-tracks the guarded lock before executing the
@@ -162,6 +166,7 @@ public:
         __TA_NO_THREAD_SAFETY_ANALYSIS {
         ZX_DEBUG_ASSERT(lock_ != nullptr);
 
+        profiler_.Release();
         LockPolicy<LockType, Option>::Release(
             lock_, &state_, fbl::forward<ReleaseArgs>(release_args)...);
         validator_.ValidateRelease();
@@ -183,7 +188,10 @@ private:
     // body.
     void ValidateAndAcquire() __TA_NO_THREAD_SAFETY_ANALYSIS {
         validator_.ValidateAcquire();
-        if (!LockPolicy<LockType, Option>::Acquire(lock_, &state_)) {
+        profiler_.BeginAcquire();
+        if (LockPolicy<LockType, Option>::Acquire(lock_, &state_)) {
+            profiler_.EndAcquire();
+        } else {
             lock_ = nullptr;
             validator_.ValidateRelease();
         }
@@ -195,7 +203,7 @@ private:
     Guard(OrderedLockTag, Lockable* lock,
           uintptr_t order, Args&&... state_args)
         __TA_ACQUIRE(lock) __TA_ACQUIRE(lock->capability())
-        : validator_{lock->id(), order}, lock_{&lock->lock()},
+        : validator_{lock->id(), order}, profiler_{lock->id()}, lock_{&lock->lock()},
           state_{fbl::forward<Args>(state_args)...} { ValidateAndAcquire(); }
 
     // Validator type used when lock validation is enabled. Provides the
@@ -225,9 +233,43 @@ private:
     // Alias of the configured validator.
     using Validator = IfLockValidationEnabled<LockValidator, DummyValidator>;
 
+    // Profiler type used when lock profiling is enabled. Times the wait for
+    // the lock and how long it is held, and records both in the lock class.
+    struct LockProfiler {
+        LockProfiler(LockClassId id)
+            : id{id} {}
+
+        void BeginAcquire() { timestamp = SystemGetTimestamp(); }
+        void EndAcquire() {
+            const uint64_t now = SystemGetTimestamp();
+            LockClassState::RecordAcquire(id, now - timestamp);
+            timestamp = now;
+        }
+        void Release() {
+            LockClassState::RecordRelease(id, SystemGetTimestamp() - timestamp);
+        }
+
+        LockClassId id;
+        uint64_t timestamp{0};
+    };
+
+    // Profiler type used when lock profiling is disabled.
+    struct DummyProfiler {
+        DummyProfiler(LockClassId) {}
+        void BeginAcquire() {}
+        void EndAcquire() {}
+        void Release() {}
+    };
+
+    // Alias of the configured profiler.
+    using Profiler = IfLockProfilingEnabled<LockProfiler, DummyProfiler>;
+
     // The validator to use when acquiring and releasing the lock.
     Validator validator_;
 
+    // The profiler to use when acquiring and releasing the lock.
+    Profiler profiler_;
+
     // Pointer to the acquired lock.
     LockType* lock_;
 
@@ -89,6 +89,47 @@ public:
       return !!(Get(id)->flags_ & LockFlagsTrackingDisabled);
     }
 
+    // Contention statistics of a lock class, gathered when profiling is
+    // enabled. Times are in nanoseconds.
+    struct Profile {
+        fbl::atomic<uint64_t> acquisitions{0};
+        fbl::atomic<uint64_t> contended{0};
+        fbl::atomic<uint64_t> total_wait{0};
+        fbl::atomic<uint64_t> max_wait{0};
+        fbl::atomic<uint64_t> total_hold{0};
+        fbl::atomic<uint64_t> max_hold{0};
+
+        void Reset() {
+            acquisitions.store(0, fbl::memory_order_relaxed);
+            contended.store(0, fbl::memory_order_relaxed);
+            total_wait.store(0, fbl::memory_order_relaxed);
+            max_wait.store(0, fbl::memory_order_relaxed);
+            total_hold.store(0, fbl::memory_order_relaxed);
+            max_hold.store(0, fbl::memory_order_relaxed);
+        }
+    };
+
+    // Records an acquisition of the given lock class that waited |wait_ns|
+    // for the lock.
+    static void RecordAcquire(LockClassId id, uint64_t wait_ns) {
+        LockClassState* state = Get(id);
+        Profile* profile = &state->profile_;
+        profile->acquisitions.fetch_add(1, fbl::memory_order_relaxed);
+        profile->total_wait.fetch_add(wait_ns, fbl::memory_order_relaxed);
+        UpdateMax(&profile->max_wait, wait_ns);
+        if (wait_ns > kLockContentionThresholdNs) {
+            profile->contended.fetch_add(1, fbl::memory_order_relaxed);
+            SystemLockContended(state, wait_ns);
+        }
+    }
+
+    // Records a release of the given lock class after holding it |hold_ns|.
+    static void RecordRelease(LockClassId id, uint64_t hold_ns) {
+        Profile* profile = &Get(id)->profile_;
+        profile->total_hold.fetch_add(hold_ns, fbl::memory_order_relaxed);
+        UpdateMax(&profile->max_hold, hold_ns);
+    }
+
     // Iterator type to traverse the set of LockClassState instances.
     class Iterator {
     public:
@@ -130,6 +171,20 @@ public:
     // Returns the dependency set for this lock class.
     const LockDependencySet& dependency_set() const { return *dependency_set_; }
 
+    // Returns the contention statistics for this lock class. These stay zero
+    // unless profiling is enabled.
+    const Profile& profile() const { return profile_; }
+
+    // Clears the contention statistics for this lock class.
+    void ResetProfile() { profile_.Reset(); }
+
+    // Returns the contention statistics for this lock class. These stay zero
+    // unless profiling is enabled.
+    const Profile& profile() const { return profile_; }
+
+    // Clears the contention statistics for this lock class.
+    void ResetProfile() { profile_.Reset(); }
+
     LockClassState* connected_set() { return LoopDetector::FindSet(&loop_node_)->ToState(); }
 
     // Runs a loop detection pass on the set of lock classes to find possible
@@ -147,6 +202,7 @@ public:
     void Reset() {
         dependency_set_->clear();
         loop_node_.Reset();
+        profile_.Reset();
     }
 
 private:
@@ -181,6 +237,20 @@ private:
         return head;
     }
 
+    // Raises |value| to at least |sample|. Relaxed order suffices, the
+    // statistics are only read by diagnostics.
+    static void UpdateMax(fbl::atomic<uint64_t>* value, uint64_t sample) {
+        uint64_t current = value->load(fbl::memory_order_relaxed);
+        while (sample > current &&
+               !value->compare_exchange_weak(&current, sample,
+                                             fbl::memory_order_relaxed,
+                                             fbl::memory_order_relaxed)) {
+        }
+    }
+
+    // Contention statistics, updated by Guard when profiling is enabled.
+    Profile profile_;
+
     // Per-lock class state used by the loop detection algorithm.
     struct LoopNode {
         // The parent of the disjoint sets this node belongs to. Nodes start out
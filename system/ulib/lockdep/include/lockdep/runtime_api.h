@@ -54,4 +54,13 @@ extern void SystemInitThreadLockState(ThreadLockState* state);
 // given time interval.
 extern void SystemTriggerLoopDetection();
 
+// System-defined hook that returns the current monotonic time in nanoseconds.
+// Only used when lock profiling is enabled.
+extern uint64_t SystemGetTimestamp();
+
+// System-defined hook called when lock profiling sees an acquisition of the
+// given lock class wait |wait_ns| nanoseconds, more than the contention
+// threshold. This is called with the lock held and must not acquire locks.
+extern void SystemLockContended(LockClassState* state, uint64_t wait_ns);
+
 } // namespace lockdep
@@ -0,0 +1,40 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <lib/sync/mutex.h>
+
+#include <lockdep/lock_policy.h>
+
+namespace lockdep {
+
+// Lock policy for acquiring a libsync mutex. Users of this header must link
+// against libsync.
+struct SyncMutexPolicy {
+    // No extra state required for sync mutexes.
+    struct State {};
+
+    static bool Acquire(sync_mutex_t* lock, State*) __TA_ACQUIRE(lock) {
+        sync_mutex_lock(lock);
+        return true;
+    }
+    static void Release(sync_mutex_t* lock, State*) __TA_RELEASE(lock) {
+        sync_mutex_unlock(lock);
+    }
+};
+
+} // namespace lockdep
+
+// Configure Guard<sync_mutex_t> to use the policy above. This must be done in
+// the same namespace as the mutex type. With this a sync_mutex_t can be
+// instrumented for validation and profiling like any other lock:
+//
+//  struct MyType {
+//      LOCK_DEP_INSTRUMENT(MyType, sync_mutex_t) lock;
+//  };
+//
+//  lockdep::Guard<sync_mutex_t> guard{&my_type.lock};
+//
+LOCK_DEP_POLICY(sync_mutex_t, ::lockdep::SyncMutexPolicy);
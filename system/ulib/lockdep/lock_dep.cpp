@@ -9,6 +9,7 @@
 //
 
 #include <zircon/compiler.h>
+#include <zircon/syscalls.h>
 
 #include <lockdep/lockdep.h>
 
@@ -25,4 +26,13 @@ __WEAK ThreadLockState* SystemGetThreadLockState() {
 
 __WEAK void SystemInitThreadLockState(ThreadLockState* state) {}
 
+// Default implementation of the runtime functions supporting lock profiling.
+// Contended acquisitions are only accounted in the lock class statistics.
+
+__WEAK uint64_t SystemGetTimestamp() {
+    return zx_clock_get_monotonic();
+}
+
+__WEAK void SystemLockContended(LockClassState* state, uint64_t wait_ns) {}
+
 } // namespace fbl
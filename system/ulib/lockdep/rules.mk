@@ -19,6 +19,7 @@ MODULE_SRCS += \
 
 MODULE_LIBS := \
     system/ulib/fbl \
+    system/ulib/zircon \
     system/ulib/zx
 
 MODULE_PACKAGE := src
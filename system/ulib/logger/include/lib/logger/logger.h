@@ -44,6 +44,9 @@ private:
 
     zx_status_t PrintLogMessage(const fx_log_packet_t* packet);
 
+    // Records formats and prints records sent by structured loggers.
+    zx_status_t HandleStructured(const uint8_t* data, size_t size);
+
     void NotifyError(zx_status_t error);
 
     zx::channel channel_;
@@ -52,6 +55,9 @@ private:
     async::WaitMethod<LoggerImpl, &LoggerImpl::OnHandleReady> wait_;
     async::WaitMethod<LoggerImpl, &LoggerImpl::OnLogMessage> socket_wait_;
     ErrorCallback error_handler_;
+
+    // Structured formats registered on |socket_|, by id.
+    fbl::Vector<fbl::String> formats_;
 };
 
 } // namespace logger
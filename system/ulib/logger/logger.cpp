@@ -4,6 +4,8 @@
 
 #include <lib/logger/logger.h>
 
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/string_buffer.h>
 #include <fuchsia/logger/c/fidl.h>
 #include <lib/fidl/cpp/message_buffer.h>
@@ -36,61 +38,159 @@ zx_status_t LoggerImpl::Begin(async_dispatcher_t* dispatcher) {
     return wait_.Begin(dispatcher);
 }
 
-zx_status_t LoggerImpl::PrintLogMessage(const fx_log_packet_t* packet) {
-    fbl::StringBuffer<sizeof(fx_log_packet_t) + 100> buf; // should be enough to log message
-    buf.AppendPrintf("[%05ld.%06ld]", packet->metadata.time / 1000000000UL, (packet->metadata.time / 1000UL) % 1000000UL);
-    buf.AppendPrintf("[%ld]", packet->metadata.pid);
-    buf.AppendPrintf("[%ld]", packet->metadata.tid);
+namespace {
+
+using LogLine = fbl::StringBuffer<sizeof(fx_log_packet_t) + 100>; // should be enough to log message
+
+// Appends everything but the message of a log line.  |tags| holds the tags of
+// the message, and on return |*tags_size| is the number of bytes they took.
+zx_status_t AppendPrefix(LogLine* buf, zx_time_t time, zx_koid_t pid, zx_koid_t tid,
+                         fx_log_severity_t severity, const char* tags, size_t tags_max,
+                         size_t* tags_size) {
+    buf->AppendPrintf("[%05ld.%06ld]", time / 1000000000UL, (time / 1000UL) % 1000000UL);
+    buf->AppendPrintf("[%ld]", pid);
+    buf->AppendPrintf("[%ld]", tid);
 
     // print tags
     size_t pos = 0;
-    buf.Append("[");
-    unsigned int tag_len = packet->data[pos];
+    buf->Append("[");
+    if (tags_max == 0) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    unsigned int tag_len = tags[pos];
     int i = 1;
     while (tag_len > 0) {
-        if (i > FX_LOG_MAX_TAGS || tag_len > FX_LOG_MAX_TAG_LEN) {
+        if (i > FX_LOG_MAX_TAGS || tag_len > FX_LOG_MAX_TAG_LEN ||
+            pos + 1 + tag_len >= tags_max) {
             return ZX_ERR_INVALID_ARGS;
         }
         if (i > 1) {
-            buf.Append(", ");
+            buf->Append(", ");
         }
         pos = pos + 1;
-        buf.Append(packet->data + pos, tag_len);
+        buf->Append(tags + pos, tag_len);
         pos = pos + tag_len;
-        tag_len = packet->data[pos];
+        tag_len = tags[pos];
         i++;
     }
-    buf.Append("]");
+    buf->Append("]");
+    *tags_size = pos + 1;
 
-    auto severity = packet->metadata.severity;
     switch (severity) {
     case FX_LOG_INFO:
-        buf.Append(" INFO");
+        buf->Append(" INFO");
         break;
     case FX_LOG_WARNING:
-        buf.Append(" WARNING");
+        buf->Append(" WARNING");
         break;
     case FX_LOG_ERROR:
-        buf.Append(" ERROR");
+        buf->Append(" ERROR");
         break;
     case FX_LOG_FATAL:
-        buf.Append(" FATAL");
+        buf->Append(" FATAL");
         break;
     default:
-        buf.AppendPrintf(" VLOG(%d)", -severity);
+        buf->AppendPrintf(" VLOG(%d)", -severity);
+    }
+    buf->Append(": ");
+    return ZX_OK;
+}
+
+} // namespace
+
+zx_status_t LoggerImpl::PrintLogMessage(const fx_log_packet_t* packet) {
+    LogLine buf;
+    size_t pos;
+    zx_status_t status = AppendPrefix(&buf, packet->metadata.time, packet->metadata.pid,
+                                      packet->metadata.tid, packet->metadata.severity,
+                                      packet->data, sizeof(packet->data), &pos);
+    if (status != ZX_OK) {
+        return status;
     }
-    buf.Append(": ");
-    pos++; //point to log msg
     buf.Append(packet->data + pos);
     buf.Append("\n");
 
-    ssize_t status = write(fd_, buf.data(), buf.size());
-    if (status < 0) {
+    ssize_t n = write(fd_, buf.data(), buf.size());
+    if (n < 0) {
         return ZX_ERR_IO;
     }
     return ZX_OK;
 }
 
+zx_status_t LoggerImpl::HandleStructured(const uint8_t* data, size_t size) {
+    fx_log_structured_header_t header;
+    if (size < sizeof(header)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    memcpy(&header, data, sizeof(header));
+    data += sizeof(header);
+    size -= sizeof(header);
+
+    if (header.type == FX_LOG_STRUCTURED_FORMAT) {
+        uint32_t id;
+        if (size < sizeof(id) + 1 || data[size - 1] != 0) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        memcpy(&id, data, sizeof(id));
+        // Ids are assigned in order, so any other id is a format we already
+        // have or one whose predecessors were lost.
+        if (id != formats_.size()) {
+            return ZX_OK;
+        }
+        fbl::AllocChecker ac;
+        formats_.push_back(fbl::String(reinterpret_cast<const char*>(data + sizeof(id))), &ac);
+        return ac.check() ? ZX_OK : ZX_ERR_NO_MEMORY;
+    }
+    if (header.type != FX_LOG_STRUCTURED_RECORDS) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    const char* tags = reinterpret_cast<const char*>(data);
+    size_t tags_size = 0;
+    // Find where the records start, checking the tags on the way.
+    {
+        LogLine buf;
+        zx_status_t status = AppendPrefix(&buf, 0, 0, 0, FX_LOG_INFO, tags, size, &tags_size);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    size_t offset = fbl::round_up(tags_size, 8u);
+
+    while (offset < size) {
+        fx_log_structured_record_t record;
+        if (size - offset < sizeof(record)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        memcpy(&record, data + offset, sizeof(record));
+        offset += sizeof(record);
+        if (record.args_size > size - offset) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+
+        LogLine buf;
+        size_t unused;
+        AppendPrefix(&buf, record.time, header.pid, header.tid, record.severity, tags,
+                     tags_size, &unused);
+        char msg[sizeof(fx_log_packet_t)];
+        if (record.format_id >= formats_.size() ||
+            fx_log_format_structured(formats_[record.format_id].c_str(), data + offset,
+                                     record.args_size, msg, sizeof(msg)) < 0) {
+            buf.AppendPrintf("<unformattable message, format %u>", record.format_id);
+        } else {
+            buf.Append(msg);
+        }
+        buf.Append("\n");
+        offset += fbl::round_up(record.args_size, 8u);
+
+        ssize_t n = write(fd_, buf.data(), buf.size());
+        if (n < 0) {
+            return ZX_ERR_IO;
+        }
+    }
+    return ZX_OK;
+}
+
 void LoggerImpl::OnLogMessage(async_dispatcher_t* dispatcher, async::WaitBase* wait, zx_status_t status,
                               const zx_packet_signal_t* signal) {
     if (status != ZX_OK) {
@@ -100,12 +200,19 @@ void LoggerImpl::OnLogMessage(async_dispatcher_t* dispatcher, async::WaitBase* w
 
     if (signal->observed & ZX_SOCKET_READABLE) {
         memset(&packet, 0, sizeof(packet));
-        status = socket_.read(0, &packet, sizeof(packet), nullptr);
+        size_t actual;
+        status = socket_.read(0, &packet, sizeof(packet), &actual);
         if (status != ZX_OK) {
             NotifyError(status);
             return;
         }
-        if (status != ZX_ERR_SHOULD_WAIT) {
+        if (packet.metadata.pid == ZX_KOID_INVALID) {
+            status = HandleStructured(reinterpret_cast<const uint8_t*>(&packet), actual);
+            if (status == ZX_ERR_INVALID_ARGS) {
+                NotifyError(status);
+                return;
+            }
+        } else if (status != ZX_ERR_SHOULD_WAIT) {
             // set last byte of packet to zero so that we don't overflow buffer while
             // reading message.
             packet.data[sizeof(packet.data) - 1] = 0;
@@ -18,6 +18,7 @@
 #include <fs/vfs.h>
 #include <lib/memfs/cpp/vnode.h>
 #include <zircon/device/vfs.h>
+#include <zircon/syscalls/object.h>
 
 #include "dnode.h"
 
@@ -63,10 +64,9 @@ zx_status_t VnodeFile::Write(const void* data, size_t len, size_t offset,
     if ((status = vfs()->GrowVMO(vmo_, vmo_size_, newlen, &vmo_size_)) != ZX_OK) {
         return status;
     }
-    // Accessing beyond the end of the file? Extend it.
-    if (offset > length_) {
-        // Zero-extending the tail of the file by writing to
-        // an offset beyond the end of the file.
+    // Accessing beyond the end of the file? The gap already reads as zero,
+    // and stays uncommitted, unless a mapping may have dirtied it.
+    if (offset > length_ && tail_may_be_dirty_) {
         ZeroTail(length_, offset);
     }
     size_t writelen = newlen - offset;
@@ -76,7 +76,7 @@ zx_status_t VnodeFile::Write(const void* data, size_t len, size_t offset,
     *out_actual = writelen;
 
     if (newlen > length_) {
-        length_ = newlen;
+        SetLength(newlen);
     }
     if (writelen < len) {
         // short write because we're beyond the end of the permissible length
@@ -124,17 +124,50 @@ zx_status_t VnodeFile::GetVmo(int flags, zx_handle_t* out) {
     if ((status = vmo_.duplicate(rights, &out_vmo)) != ZX_OK) {
         return status;
     }
+    if (flags & FDIO_MMAP_FLAG_WRITE) {
+        // The client may write past the end of the file, in its last pages.
+        tail_may_be_dirty_ = true;
+    }
     *out = out_vmo.release();
     return ZX_OK;
 }
 
+zx_status_t VnodeFile::GetBuffer(zx::vmo* out_vmo, size_t* out_size,
+                                 zx::eventpair* out_size_changed) {
+    zx_status_t status;
+    if (!vmo_.is_valid()) {
+        if ((status = zx::vmo::create(0, 0, &vmo_)) != ZX_OK) {
+            return status;
+        }
+    }
+    // Writes and truncation only resize |vmo_|, so the buffer stays valid for
+    // the lifetime of the file.
+    zx::eventpair size_changed;
+    if ((status = size_watchers_.Watch(&size_changed)) != ZX_OK) {
+        return status;
+    }
+    if ((status = vmo_.duplicate(ZX_RIGHTS_BASIC | ZX_RIGHT_READ | ZX_RIGHT_MAP,
+                                 out_vmo)) != ZX_OK) {
+        return status;
+    }
+    *out_size = length_;
+    *out_size_changed = fbl::move(size_changed);
+    return ZX_OK;
+}
+
 zx_status_t VnodeFile::Getattr(vnattr_t* attr) {
     memset(attr, 0, sizeof(vnattr_t));
     attr->inode = ino_;
     attr->mode = V_TYPE_FILE | V_IRUSR | V_IWUSR | V_IRGRP | V_IROTH;
     attr->size = length_;
     attr->blksize = kMemfsBlksize;
-    attr->blkcount = fbl::round_up(attr->size, kMemfsBlksize) / VNATTR_BLKSIZE;
+    // Holes, and pages past the end of the file, are never committed, so the
+    // file only takes up the pages its vmo has committed.
+    zx_info_vmo_t info;
+    if (vmo_.is_valid() &&
+        vmo_.get_info(ZX_INFO_VMO, &info, sizeof(info), nullptr, nullptr) == ZX_OK) {
+        attr->blkcount = info.committed_bytes / VNATTR_BLKSIZE;
+    }
     attr->nlink = link_count_;
     attr->create_time = create_time_;
     attr->modify_time = modify_time_;
@@ -156,19 +189,26 @@ zx_status_t VnodeFile::Truncate(size_t len) {
         return status;
     }
     if (len < length_) {
-        // Shrink the logical file length.
-        // Zeroing the tail here is optional, but it saves memory.
+        // Shrink the logical file length, zeroing and decommitting what falls
+        // off the end so that a later extension reads as zero.
         ZeroTail(len, length_);
-    } else if (len > length_) {
+    } else if (len > length_ && tail_may_be_dirty_) {
         // Extend the logical file length.
         ZeroTail(length_, len);
     }
 
-    length_ = len;
+    SetLength(len);
     UpdateModified();
     return ZX_OK;
 }
 
+void VnodeFile::SetLength(zx_off_t length) {
+    if (length != length_) {
+        length_ = length;
+        size_watchers_.Notify();
+    }
+}
+
 void VnodeFile::ZeroTail(size_t start, size_t end) {
     constexpr size_t kPageSize = static_cast<size_t>(PAGE_SIZE);
     if (start % kPageSize != 0) {
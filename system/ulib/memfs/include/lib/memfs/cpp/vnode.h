@@ -22,6 +22,7 @@
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
 #include <fs/remote.h>
+#include <fs/size-watcher.h>
 #include <fs/watcher.h>
 #include <lib/zx/vmo.h>
 
@@ -90,6 +91,12 @@ private:
     zx_status_t GetHandles(uint32_t flags, zx_handle_t* hnd, uint32_t* type,
                            zxrio_node_info_t* extra) final;
     zx_status_t GetVmo(int flags, zx_handle_t* out) final;
+    zx_status_t GetBuffer(zx::vmo* out_vmo, size_t* out_size,
+                          zx::eventpair* out_size_changed) final;
+
+    // Updates the logical length of the file, telling the clients reading
+    // through a buffer if it changed.
+    void SetLength(zx_off_t length);
 
     // Ensure the underlying vmo is filled with zero from:
     // [start, round_up(end, PAGE_SIZE)).
@@ -98,8 +105,12 @@ private:
     zx::vmo vmo_;
     // Cached length of the vmo.
     uint64_t vmo_size_;
-    // Logical length of the underlying file.
+    // Logical length of the underlying file. The vmo past it reads as zero,
+    // unless |tail_may_be_dirty_|.
     zx_off_t length_;
+    // Set once a writable mapping of the vmo has been handed out.
+    bool tail_may_be_dirty_ = false;
+    fs::SizeWatcherContainer size_watchers_;
 };
 
 class VnodeDir final : public VnodeMemfs {
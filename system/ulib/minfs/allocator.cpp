@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include <bitmap/raw-bitmap.h>
+#include <fbl/algorithm.h>
 
 #include <minfs/allocator.h>
 #include <minfs/block-txn.h>
@@ -28,11 +29,17 @@ AllocatorPromise::~AllocatorPromise() {
     }
 }
 
-size_t AllocatorPromise::Allocate(WriteTxn* txn) {
+size_t AllocatorPromise::Allocate(WriteTxn* txn, size_t goal) {
     ZX_DEBUG_ASSERT(allocator_ != nullptr);
     ZX_DEBUG_ASSERT(reserved_ > 0);
     reserved_--;
-    return allocator_->Allocate(txn);
+    return allocator_->Allocate(txn, goal);
+}
+
+void AllocatorPromise::Merge(fbl::unique_ptr<AllocatorPromise> other) {
+    ZX_DEBUG_ASSERT(allocator_ == other->allocator_);
+    reserved_ += other->reserved_;
+    other->reserved_ = 0;
 }
 
 AllocatorFvmMetadata::AllocatorFvmMetadata() = default;
@@ -131,11 +138,21 @@ void Allocator::Unreserve(size_t count) {
     reserved_ -= count;
 }
 
-size_t Allocator::Allocate(WriteTxn* txn) {
+size_t Allocator::Allocate(WriteTxn* txn, size_t goal) {
     ZX_DEBUG_ASSERT(reserved_ > 0);
     size_t bitoff_start;
-    if (map_.Find(false, hint_, map_.size(), 1, &bitoff_start) != ZX_OK) {
-        ZX_ASSERT(map_.Find(false, 0, hint_, 1, &bitoff_start) == ZX_OK);
+    if ((goal != 0) && (goal < map_.size()) && !map_.Get(goal, goal + 1)) {
+        bitoff_start = goal;
+        if (bitoff_start >= hint_) {
+            hint_ = bitoff_start + 1;
+        }
+    } else if ((goal != 0) && FindFreeRun(kContiguousRun, &bitoff_start)) {
+        hint_ = fbl::min(bitoff_start + kContiguousRun, map_.size());
+    } else {
+        if (map_.Find(false, hint_, map_.size(), 1, &bitoff_start) != ZX_OK) {
+            ZX_ASSERT(map_.Find(false, 0, hint_, 1, &bitoff_start) == ZX_OK);
+        }
+        hint_ = bitoff_start + 1;
     }
 
     ZX_ASSERT(map_.Set(bitoff_start, bitoff_start + 1) == ZX_OK);
@@ -144,10 +161,14 @@ size_t Allocator::Allocate(WriteTxn* txn) {
     metadata_.PoolAllocate(1);
     reserved_ -= 1;
     sb_->Write(txn);
-    hint_ = bitoff_start + 1;
     return bitoff_start;
 }
 
+bool Allocator::FindFreeRun(size_t count, size_t* out_start) const {
+    return (map_.Find(false, hint_, map_.size(), count, out_start) == ZX_OK) ||
+           (map_.Find(false, 0, hint_, count, out_start) == ZX_OK);
+}
+
 void Allocator::Free(WriteTxn* txn, size_t index) {
     ZX_DEBUG_ASSERT(map_.Get(index, index + 1));
     map_.Clear(index, index + 1);
@@ -160,6 +181,23 @@ void Allocator::Free(WriteTxn* txn, size_t index) {
     }
 }
 
+void Allocator::ForEachFreeRun(fbl::Function<void(size_t start, size_t count)> func) const {
+    const size_t total = metadata_.PoolTotal();
+    size_t start = 0;
+    while (start < total) {
+        size_t end;
+        if (map_.Find(true, start, total, 1, &end) != ZX_OK) {
+            end = total;
+        }
+        if (end > start) {
+            func(start, end - start);
+        }
+        if (end == total || map_.Get(end, total, &start)) {
+            break;
+        }
+    }
+}
+
 zx_status_t Allocator::Extend(WriteTxn* txn) {
 #ifdef __Fuchsia__
     TRACE_DURATION("minfs", "Minfs::Allocator::Extend");
@@ -19,12 +19,26 @@
 
 namespace minfs {
 
+#ifdef __Fuchsia__
+namespace {
+
+// The number of blocks cached by Readblk.
+constexpr size_t kReadAheadBlocks = 128;
+
+} // namespace
+#endif
+
 zx_status_t Bcache::Readblk(blk_t bno, void* data) {
+#ifdef __Fuchsia__
+    zx_status_t status = read_ahead_->Read(bno, data);
+    if (status != ZX_OK) {
+        FS_TRACE_ERROR("minfs: cannot read block %u: %d\n", bno, status);
+    }
+    return status;
+#else
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
-#ifndef __Fuchsia__
     off += offset_;
-#endif
     if (lseek(fd_.get(), off, SEEK_SET) < 0) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return ZX_ERR_IO;
@@ -34,9 +48,14 @@ zx_status_t Bcache::Readblk(blk_t bno, void* data) {
         return ZX_ERR_IO;
     }
     return ZX_OK;
+#endif
 }
 
 zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
+    return Writeblks(bno, data, 1);
+}
+
+zx_status_t Bcache::Writeblks(blk_t bno, const void* data, blk_t count) {
     off_t off = static_cast<off_t>(bno) * kMinfsBlockSize;
     assert(off / kMinfsBlockSize == bno); // Overflow
 #ifndef __Fuchsia__
@@ -46,8 +65,18 @@ zx_status_t Bcache::Writeblk(blk_t bno, const void* data) {
         FS_TRACE_ERROR("minfs: cannot seek to block %u\n", bno);
         return ZX_ERR_IO;
     }
-    if (write(fd_.get(), data, kMinfsBlockSize) != kMinfsBlockSize) {
-        FS_TRACE_ERROR("minfs: cannot write block %u\n", bno);
+    const uint8_t* buf = static_cast<const uint8_t*>(data);
+    size_t len = static_cast<size_t>(count) * kMinfsBlockSize;
+    ssize_t r = 0;
+    while (len > 0 && (r = write(fd_.get(), buf, len)) > 0) {
+        buf += r;
+        len -= r;
+    }
+#ifdef __Fuchsia__
+    read_ahead_->Invalidate(bno, count);
+#endif
+    if (len != 0) {
+        FS_TRACE_ERROR("minfs: cannot write %u blocks at block %u\n", count, bno);
         return ZX_ERR_IO;
     }
     return ZX_OK;
@@ -83,6 +112,15 @@ zx_status_t Bcache::Create(fbl::unique_ptr<Bcache>* out, fbl::unique_fd fd, uint
     if ((status = block_client::Client::Create(fbl::move(fifo), &bc->fifo_client_)) != ZX_OK) {
         return status;
     }
+    if ((status = fs::ReadAheadCache::Create(bc.get(), kReadAheadBlocks, blockmax,
+                                             &bc->read_ahead_)) != ZX_OK) {
+        return status;
+    }
+    vmoid_t vmoid;
+    if ((status = bc->AttachVmo(bc->read_ahead_->vmo().get(), &vmoid)) != ZX_OK) {
+        return status;
+    }
+    bc->read_ahead_->SetVmoid(vmoid);
 #endif
 
     *out = fbl::move(bc);
@@ -120,6 +158,8 @@ Bcache::Bcache(fbl::unique_fd fd, uint32_t blockmax) :
 
 Bcache::~Bcache() {
 #ifdef __Fuchsia__
+    // The cache detaches its vmo through the fifo.
+    read_ahead_.reset();
     if (fd_) {
         ioctl_block_fifo_close(fd_.get());
     }
@@ -7,8 +7,12 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
 #include <minfs/format.h>
 #include <minfs/fsck.h>
+#include <minfs/journal.h>
 #include "minfs-private.h"
 
 // #define DEBUG_PRINTF
@@ -19,6 +23,28 @@
 #endif
 
 namespace minfs {
+namespace {
+
+// Returns the number of the first |count| bits which are set in |allocated|
+// but not in |checked|. Both bitmaps are walked a run of bits at a time.
+size_t CountUnchecked(const RawBitmap& allocated, const RawBitmap& checked, size_t count) {
+    size_t missing = 0;
+    size_t start;
+    for (size_t n = 0; n < count && allocated.Find(true, n, count, 1, &start) == ZX_OK; ) {
+        size_t end = count;
+        allocated.Scan(start, count, true, &end);
+        for (size_t unchecked = start; !checked.Scan(unchecked, end, true, &unchecked); ) {
+            size_t next = end;
+            checked.Scan(unchecked, end, false, &next);
+            missing += next - unchecked;
+            unchecked = next;
+        }
+        n = end;
+    }
+    return missing;
+}
+
+} // namespace
 
 class MinfsChecker {
 public:
@@ -50,6 +76,8 @@ private:
                                blk_t* bno_out);
     zx_status_t CheckDirectory(Inode* inode, ino_t ino,
                                ino_t parent, uint32_t flags);
+    // Checks the hash block of a hashed directory of |size| bytes.
+    zx_status_t CheckDirHash(const DirHashBlock* hash_block, ino_t ino, size_t size);
     const char* CheckDataBlock(blk_t bno);
     zx_status_t CheckFile(Inode* inode, ino_t ino);
 
@@ -181,7 +209,39 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
         return status;
     }
 
-    size_t off = 0;
+    if (inode->dir_flags & ~kMinfsDirFlagHashed) {
+        FS_TRACE_ERROR("check: ino#%u: unknown directory flags %#x\n", ino, inode->dir_flags);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    // A hashed directory is checked bucket by bucket, after its hash block.
+    const bool hashed = inode->dir_flags & kMinfsDirFlagHashed;
+    fbl::unique_ptr<uint8_t[]> hash_data;
+    const DirHashBlock* hash_block = nullptr;
+    if (hashed) {
+        if (fs_->Info().version < kMinfsDirHashVersion) {
+            FS_TRACE_ERROR("check: ino#%u: hashed directory on a version %u volume\n",
+                           ino, fs_->Info().version);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        fbl::AllocChecker ac;
+        hash_data.reset(new (&ac) uint8_t[kMinfsBlockSize]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        size_t actual;
+        status = vn->ReadInternal(hash_data.get(), kMinfsBlockSize, 0, &actual);
+        if (status != ZX_OK || actual != kMinfsBlockSize) {
+            FS_TRACE_ERROR("check: ino#%u: Could not read hash block\n", ino);
+            return status != ZX_OK ? status : ZX_ERR_IO;
+        }
+        hash_block = reinterpret_cast<const DirHashBlock*>(hash_data.get());
+        if ((status = CheckDirHash(hash_block, ino, inode->size)) != ZX_OK) {
+            return status;
+        }
+    }
+
+    size_t off = hashed ? kMinfsBlockSize : 0;
     while (true) {
         uint32_t data[MINFS_DIRENT_SIZE];
         size_t actual;
@@ -205,6 +265,11 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
             FS_TRACE_ERROR("check: ino#%u: de[%u]: bad dirent reclen (%u)\n", ino, eno, rlen);
             return ZX_ERR_IO_DATA_INTEGRITY;
         }
+        const size_t bucket_end = fbl::round_down(off, kMinfsBlockSize) + kMinfsBlockSize;
+        if (hashed && (is_last || (off + rlen > bucket_end))) {
+            FS_TRACE_ERROR("check: ino#%u: de[%u]: dirent crosses its bucket\n", ino, eno);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
         if (de->ino == 0) {
             if (flags & CD_DUMP) {
                 xprintf("ino#%u: de[%u]: <empty> reclen=%u\n", ino, eno, rlen);
@@ -244,6 +309,16 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
                     FS_TRACE_ERROR("check: ino#%u: de[%u]: '..' ino=%u (not parent!)\n", ino, eno, de->ino);
                 }
             }
+            if (hashed) {
+                uint32_t hash = MinfsDirHash(de->name, de->namelen);
+                uint32_t bucket = hash_block->table[hash &
+                                                    ((1u << hash_block->header.global_depth) - 1)];
+                if (MinfsDirHashSize(bucket) != fbl::round_down(off, kMinfsBlockSize)) {
+                    FS_TRACE_ERROR("check: ino#%u: de[%u]: '%.*s' in the wrong bucket\n",
+                                   ino, eno, de->namelen, de->name);
+                    return ZX_ERR_IO_DATA_INTEGRITY;
+                }
+            }
             //TODO: check for cycles (non-dot/dotdot dir ref already in checked bitmap)
             if (flags & CD_DUMP) {
                 xprintf("ino#%u: de[%u]: ino=%u type=%u '%.*s' %s\n", ino, eno, de->ino, de->type,
@@ -262,6 +337,9 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
         } else {
             off += rlen;
         }
+        if (hashed && off == inode->size) {
+            break;
+        }
         eno++;
     }
     if (dirent_count != inode->dirent_count) {
@@ -277,6 +355,49 @@ zx_status_t MinfsChecker::CheckDirectory(Inode* inode, ino_t ino,
     return ZX_OK;
 }
 
+zx_status_t MinfsChecker::CheckDirHash(const DirHashBlock* hash_block, ino_t ino, size_t size) {
+    const DirHashHeader& header = hash_block->header;
+    if ((header.magic != kMinfsDirHashMagic) ||
+        (header.global_depth > kMinfsDirHashMaxDepth) ||
+        (header.bucket_count == 0) ||
+        (header.bucket_count > (1u << header.global_depth)) ||
+        (size != MinfsDirHashSize(header.bucket_count))) {
+        FS_TRACE_ERROR("check: ino#%u: bad hash header (depth %u, %u buckets, size %zu)\n",
+                       ino, header.global_depth, header.bucket_count, size);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+
+    // Bucket b has local depth d: the 1 << (global_depth - d) table entries which agree
+    // with b's low d bits all point at it.
+    uint32_t refs[kMinfsDirHashMaxBuckets] = {};
+    const uint32_t entries = 1u << header.global_depth;
+    for (uint32_t i = 0; i < entries; i++) {
+        uint32_t bucket = hash_block->table[i];
+        if (bucket >= header.bucket_count) {
+            FS_TRACE_ERROR("check: ino#%u: hash entry %u points at bucket %u of %u\n",
+                           ino, i, bucket, header.bucket_count);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        uint32_t depth = hash_block->local_depth[bucket];
+        if ((depth > header.global_depth) ||
+            (hash_block->table[i & ((1u << depth) - 1)] != bucket)) {
+            FS_TRACE_ERROR("check: ino#%u: hash entry %u disagrees with bucket %u (depth %u)\n",
+                           ino, i, bucket, depth);
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+        refs[bucket]++;
+    }
+    for (uint32_t b = 0; b < header.bucket_count; b++) {
+        uint32_t depth = hash_block->local_depth[b];
+        if (refs[b] != (1u << (header.global_depth - depth))) {
+            FS_TRACE_ERROR("check: ino#%u: bucket %u has %u hash entries, not %u\n",
+                           ino, b, refs[b], 1u << (header.global_depth - depth));
+            return ZX_ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return ZX_OK;
+}
+
 const char* MinfsChecker::CheckDataBlock(blk_t bno) {
     if (bno == 0) {
         return "reserved bno";
@@ -413,6 +534,26 @@ void MinfsChecker::CheckReserved() {
         FS_TRACE_WARN("check: reserved block#0: not marked in-use\n");
         conforming_ = false;
     }
+
+    // Check the journal's blocks.
+    const blk_t journal_end = fs_->Info().journal_block + fs_->Info().journal_block_count;
+    if (journal_end > fs_->Info().block_count) {
+        FS_TRACE_WARN("check: journal ends past the last block\n");
+        conforming_ = false;
+        return;
+    }
+    for (blk_t n = fs_->Info().journal_block; n < journal_end; n++) {
+        if (!fs_->block_allocator_->map_.Get(n, n + 1)) {
+            FS_TRACE_WARN("check: journal block#%u: not marked in-use\n", n);
+            conforming_ = false;
+        } else if (checked_blocks_.Get(n, n + 1)) {
+            FS_TRACE_WARN("check: journal block#%u: also reserved\n", n);
+            conforming_ = false;
+        } else {
+            checked_blocks_.Set(n, n + 1);
+            alloc_blocks_++;
+        }
+    }
 }
 
 zx_status_t MinfsChecker::CheckInode(ino_t ino, ino_t parent, bool dot_or_dotdot) {
@@ -517,17 +658,10 @@ zx_status_t MinfsChecker::CheckUnlinkedInodes() {
 }
 
 zx_status_t MinfsChecker::CheckForUnusedBlocks() const {
-    unsigned missing = 0;
-
-    for (unsigned n = 0; n < fs_->Info().block_count; n++) {
-        if (fs_->block_allocator_->map_.Get(n, n + 1)) {
-            if (!checked_blocks_.Get(n, n + 1)) {
-                missing++;
-            }
-        }
-    }
+    size_t missing = CountUnchecked(fs_->block_allocator_->map_, checked_blocks_,
+                                    fs_->Info().block_count);
     if (missing) {
-        FS_TRACE_ERROR("check: %u allocated block%s not in use\n",
+        FS_TRACE_ERROR("check: %zu allocated block%s not in use\n",
               missing, missing > 1 ? "s" : "");
         return ZX_ERR_BAD_STATE;
     }
@@ -535,16 +669,10 @@ zx_status_t MinfsChecker::CheckForUnusedBlocks() const {
 }
 
 zx_status_t MinfsChecker::CheckForUnusedInodes() const {
-    unsigned missing = 0;
-    for (unsigned n = 0; n < fs_->Info().inode_count; n++) {
-        if (fs_->inodes_->inode_allocator_->map_.Get(n, n + 1)) {
-            if (!checked_inodes_.Get(n, n + 1)) {
-                missing++;
-            }
-        }
-    }
+    size_t missing = CountUnchecked(fs_->inodes_->inode_allocator_->map_, checked_inodes_,
+                                    fs_->Info().inode_count);
     if (missing) {
-        FS_TRACE_ERROR("check: %u allocated inode%s not in use\n",
+        FS_TRACE_ERROR("check: %zu allocated inode%s not in use\n",
               missing, missing > 1 ? "s" : "");
         return ZX_ERR_BAD_STATE;
     }
@@ -622,7 +750,11 @@ zx_status_t Fsck(fbl::unique_ptr<Bcache> bc) {
         FS_TRACE_ERROR("minfs: could not read info block\n");
         return ZX_ERR_IO;
     }
-    const Superblock* info = reinterpret_cast<const Superblock*>(data);
+    Superblock* info = reinterpret_cast<Superblock*>(data);
+    if ((status = ReplayJournal(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("Fsck: could not replay journal: %d\n", status);
+        return status;
+    }
     DumpInfo(info);
     if ((status = CheckSuperblock(info, bc.get())) != ZX_OK) {
         FS_TRACE_ERROR("Fsck: check_info failure: %d\n", status);
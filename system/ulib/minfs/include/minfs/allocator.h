@@ -39,7 +39,11 @@ public:
     ~AllocatorPromise();
 
     // Allocate a new item in allocator_. Return the index of the newly allocated item.
-    size_t Allocate(WriteTxn* txn);
+    // See Allocator::Allocate for |goal|.
+    size_t Allocate(WriteTxn* txn, size_t goal);
+
+    // Take over the reservation held by |other|, which must come from the same allocator.
+    void Merge(fbl::unique_ptr<AllocatorPromise> other);
 private:
     friend class Allocator;
 
@@ -202,6 +206,10 @@ public:
     // Free an item from the allocator.
     void Free(WriteTxn* txn, size_t index);
 
+    // Calls |func| with the first element and length of each run of free
+    // elements.
+    void ForEachFreeRun(fbl::Function<void(size_t start, size_t count)> func) const;
+
 private:
     friend class MinfsChecker;
     friend class AllocatorPromise;
@@ -213,7 +221,16 @@ private:
     zx_status_t Extend(WriteTxn* txn);
 
     // Allocate an element and return the newly allocated index.
-    size_t Allocate(WriteTxn* txn);
+    //
+    // |goal| is the index the caller would like, typically the one following its
+    // previous allocation, or zero (which no minfs pool hands out) for none. If the
+    // goal has been taken by someone else, the caller is moved to the start of a free
+    // run of kContiguousRun elements, and allocations without a goal are kept out of
+    // that run, so that interleaved streams of allocations stay in long runs each.
+    size_t Allocate(WriteTxn* txn, size_t goal);
+
+    // Find the first run of |count| free elements at or after hint_, wrapping around.
+    bool FindFreeRun(size_t count, size_t* out_start) const;
 
     // Write back the allocation of the following items to disk.
     void Persist(WriteTxn* txn, size_t index, size_t count);
@@ -235,6 +252,9 @@ private:
     AllocatorMetadata metadata_;
     RawBitmap map_;
 
+    // How many elements are set aside for a caller which has lost its goal.
+    static constexpr size_t kContiguousRun = 32;
+
     size_t reserved_;
     size_t hint_;
 };
@@ -12,6 +12,7 @@
 #ifdef __Fuchsia__
 #include <block-client/cpp/client.h>
 #include <fs/fvm.h>
+#include <fs/read-ahead.h>
 #include <lib/zx/vmo.h>
 #else
 #include <fbl/vector.h>
@@ -55,16 +56,27 @@ public:
         return info_.block_size;
     }
 
+    // Returns true if the device accepts BLOCKIO_TRIM.
+    bool SupportsTrim() const {
+        return (info_.flags & BLOCK_FLAG_TRIM_SUPPORT) != 0;
+    }
+
     zx_status_t Transaction(block_fifo_request_t* requests, size_t count) final {
-        return fifo_client_.Transaction(requests, count);
+        zx_status_t status = fifo_client_.Transaction(requests, count);
+        read_ahead_->InvalidateWrites(requests, count);
+        return status;
     }
 #endif // __Fuchsia__
     // Raw block read functions.
     // These do not track blocks (or attempt to access the block cache)
+    // On Fuchsia, reads go through the read-ahead cache.
     // NOTE: Not marked as final, since these are overridden methods on host,
     // but not on __Fuchsia__.
     zx_status_t Readblk(blk_t bno, void* data);
     zx_status_t Writeblk(blk_t bno, const void* data);
+    // Writes |count| consecutive blocks, starting at |bno|, from |data|, with as few
+    // writes to the device as it takes.
+    zx_status_t Writeblks(blk_t bno, const void* data, blk_t count);
 
     ////////////////
     // Other methods.
@@ -137,6 +149,7 @@ private:
 #ifdef __Fuchsia__
     block_client::Client fifo_client_{}; // Fast path to interact with block device
     block_info_t info_{};
+    fbl::unique_ptr<fs::ReadAheadCache> read_ahead_;
     fbl::atomic<groupid_t> next_group_ = {};
 #else
     off_t offset_{};
@@ -6,8 +6,13 @@
 
 #include <fbl/algorithm.h>
 #include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 
 #include <fs/block-txn.h>
+#ifdef __Fuchsia__
+#include <fs/writeback.h>
+#endif
 
 #include <minfs/bcache.h>
 #include <minfs/format.h>
@@ -16,12 +21,7 @@ namespace minfs {
 
 #ifdef __Fuchsia__
 
-struct WriteRequest {
-    zx_handle_t vmo;
-    size_t vmo_offset;
-    size_t dev_offset;
-    size_t length;
-};
+using WriteRequest = fs::WriteRequest;
 
 // A transaction consisting of enqueued VMOs to be written
 // out to disk at specified locations.
@@ -32,7 +32,8 @@ struct WriteRequest {
 class WriteTxn {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(WriteTxn);
-    explicit WriteTxn(Bcache* bc) : bc_(bc) {}
+    // Takes a Bcache, like the host-side WriteTxn, which writes through it.
+    explicit WriteTxn(Bcache*) {}
     ~WriteTxn() {
         ZX_DEBUG_ASSERT_MSG(requests_.size() == 0, "WriteTxn still has pending requests");
     }
@@ -45,20 +46,48 @@ public:
     size_t BlkCount() const;
 
 protected:
-    // Activate the transaction, writing it out to disk.
-    //
-    // Each transaction uses the |vmo| / |vmoid| pair supplied, since the
-    // transactions should be all reading from a single in-memory buffer.
-    zx_status_t Flush(zx_handle_t vmo, vmoid_t vmoid);
+    // Drops the enqueued requests, once they have been written out by the
+    // writeback thread (or will never be).
+    void ClearRequests() { requests_.reset(); }
 
 private:
-    Bcache* bc_;
     fbl::Vector<WriteRequest> requests_;
 };
 
 #else
 
-using WriteTxn = fs::WriteTxn;
+// On the host, writes are held until the transaction is completed, rather than
+// written through as they are enqueued. A block enqueued many times by one
+// transaction, such as the bitmap block updated for each block a large write
+// allocates, then reaches the disk once.
+//
+// The data of each block is copied when it is enqueued, so the disk ends up as
+// it would have had each write gone straight through. Blocks are not read back
+// from these writes, so they must not be read from the disk before the
+// transaction is completed.
+class WriteTxn {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(WriteTxn);
+    explicit WriteTxn(Bcache* bc) : bc_(bc) {}
+    // Writes out anything still enqueued.
+    ~WriteTxn();
+
+    // Identify that |nblocks| blocks of |data|, starting at block |data_offset|, should be
+    // written to disk at |dev_offset| at a later point in time.
+    void Enqueue(const void* data, uint64_t data_offset, uint64_t dev_offset, uint64_t nblocks);
+
+    // Writes every enqueued block to disk.
+    zx_status_t Transact();
+
+private:
+    struct PendingBlock {
+        blk_t bno;
+        fbl::unique_ptr<uint8_t[]> data;
+    };
+
+    Bcache* bc_;
+    fbl::Vector<PendingBlock> blocks_;
+};
 
 #endif
 
@@ -33,7 +33,11 @@ typedef uint32_t ino_t;
 
 constexpr uint64_t kMinfsMagic0         = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1         = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion        = 0x00000006;
+constexpr uint32_t kMinfsVersion        = 0x00000008;
+// The oldest format still mounted. Version 6 has no hashed directories, and
+// versions before 8 have no journal; an older volume becomes the current
+// version when its first directory is hashed, and never gets a journal.
+constexpr uint32_t kMinfsMinVersion     = 0x00000006;
 
 constexpr ino_t    kMinfsRootIno        = 1;
 constexpr uint32_t kMinfsFlagClean      = 0x00000001; // Currently unused
@@ -104,6 +108,10 @@ struct Superblock {
 
     ino_t unlinked_head;    // Index to the first unlinked (but open) inode.
     ino_t unlinked_tail;    // Index to the last unlinked (but open) inode.
+
+    // The following are zero on volumes without a journal:
+    blk_t journal_block;        // first data block of the journal
+    uint32_t journal_block_count; // blocks in the journal, all marked in use
 };
 
 static_assert(sizeof(Superblock) <= kMinfsBlockSize,
@@ -134,7 +142,8 @@ struct Inode {
     uint32_t dirent_count;          // for directories
     ino_t last_inode;               // index to the previous unlinked inode
     ino_t next_inode;               // index to the next unlinked inode
-    uint32_t rsvd[3];
+    uint32_t dir_flags;             // for directories, kMinfsDirFlag*
+    uint32_t rsvd[2];
     blk_t dnum[kMinfsDirect];    // direct blocks
     blk_t inum[kMinfsIndirect];  // indirect blocks
     blk_t dinum[kMinfsDoublyIndirect]; // doubly indirect blocks
@@ -180,6 +189,113 @@ constexpr uint32_t MinfsReclen(Dirent* de, size_t off) {
 static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
               "MinFS directory size must be smaller than reclen mask");
 
+// Hashed directories (version 7)
+//
+// A directory which would grow past kMinfsDirLinearMaxSize is rewritten as
+// an extendible hash table, and kMinfsDirFlagHashed is set in its inode:
+// - block 0 holds a DirHashBlock
+// - blocks 1 to bucket_count hold the buckets
+// - a bucket is a run of dirents which covers exactly one block; no dirent
+//   in a hashed directory has kMinfsReclenLast set
+// - a name lives in bucket table[MinfsDirHash(name) & ((1 << global_depth) - 1)],
+//   "." and ".." included
+// - all names in bucket b agree on their low local_depth[b] hash bits, and
+//   every table entry with those low bits points at b
+//
+// A lookup reads the header and one bucket. A full bucket is split in two,
+// doubling the table first if needed, which touches three blocks.
+constexpr uint32_t kMinfsDirFlagHashed     = 0x00000001;
+// The first version which may have hashed directories.
+constexpr uint32_t kMinfsDirHashVersion    = 0x00000007;
+
+constexpr uint32_t kMinfsDirLinearMaxSize  = 4 * kMinfsBlockSize;
+constexpr uint32_t kMinfsDirHashMagic      = 0x48446e4d; // "MnDH"
+constexpr uint32_t kMinfsDirHashMaxDepth   = 11;
+constexpr uint32_t kMinfsDirHashTableSize  = 1 << kMinfsDirHashMaxDepth;
+constexpr uint32_t kMinfsDirHashMaxBuckets = kMinfsDirHashTableSize;
+
+struct DirHashHeader {
+    uint32_t magic;                 // kMinfsDirHashMagic
+    uint32_t global_depth;          // the table has (1 << global_depth) entries
+    uint32_t bucket_count;
+    uint32_t reserved;
+};
+
+struct DirHashBlock {
+    DirHashHeader header;
+    uint16_t table[kMinfsDirHashTableSize];         // bucket for each hash
+    uint8_t local_depth[kMinfsDirHashMaxBuckets];   // for each bucket
+};
+
+static_assert(sizeof(DirHashBlock) <= kMinfsBlockSize,
+              "minfs directory hash block size is wrong");
+static_assert(kMinfsDirHashMaxBuckets - 1 <= fbl::numeric_limits<uint16_t>::max(),
+              "minfs directory hash table entries are too small");
+
+// The size of a hashed directory with |bucket_count| buckets.
+constexpr size_t MinfsDirHashSize(uint32_t bucket_count) {
+    return (static_cast<size_t>(bucket_count) + 1) * kMinfsBlockSize;
+}
+
+// FNV-1a; part of the on-disk format.
+inline uint32_t MinfsDirHash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Journal (version 8)
+//
+// The journal is a run of allocated data blocks, split into kMinfsJournalSlots
+// equal slots which are used in turn. A slot holds at most one entry:
+// - a JournalHeader block
+// - the entry blocks, each a copy of the block header.targets[i]
+// - a JournalCommit block, whose checksum covers the header and entry blocks
+//
+// An entry is written along with the writeback work it covers, and the device
+// is flushed before that work is written in place. Each slot is reused only
+// after the entry which follows it has been flushed, so the in-place writes of
+// the slot's old entry are already durable. On mount, the valid entries are
+// replayed oldest first, then the headers are cleared.
+constexpr uint64_t kMinfsJournalMagic        = 0x6c6e726a53466e4dULL; // "MnFSjrnl"
+constexpr uint64_t kMinfsJournalCommitMagic  = 0x74696d6d6f63724aULL; // "Jrcommit"
+// The first version which may have a journal.
+constexpr uint32_t kMinfsJournalVersion      = 0x00000008;
+constexpr uint32_t kMinfsJournalSlots        = 2;
+constexpr uint32_t kMinfsDefaultJournalBlocks = 256;
+// Volumes with fewer data blocks than this get a proportionally smaller
+// journal, or none at all.
+constexpr uint32_t kMinfsJournalMinSlotBlocks = 16;
+
+struct JournalHeader {
+    uint64_t magic;                 // kMinfsJournalMagic
+    uint64_t sequence;              // one more than the previous entry's
+    uint32_t block_count;           // entry blocks, not counting header and commit
+    uint32_t reserved;
+    blk_t targets[];                // absolute block number of each entry block
+};
+
+constexpr uint32_t kMinfsJournalMaxTargets =
+    (kMinfsBlockSize - sizeof(JournalHeader)) / sizeof(blk_t);
+
+struct JournalCommit {
+    uint64_t magic;                 // kMinfsJournalCommitMagic
+    uint64_t sequence;              // matches the header
+    uint32_t checksum;              // crc32 of the header and entry blocks
+};
+
+static_assert(sizeof(JournalCommit) <= kMinfsBlockSize,
+              "minfs journal commit size is wrong");
+
+// The number of entry blocks a slot of a |journal_blocks| block journal holds.
+constexpr uint32_t MinfsJournalSlotCapacity(uint32_t journal_blocks) {
+    return journal_blocks / kMinfsJournalSlots - 2 < kMinfsJournalMaxTargets ?
+           journal_blocks / kMinfsJournalSlots - 2 : kMinfsJournalMaxTargets;
+}
+
 // Notes:
 // - dirents with ino of 0 are free, and skipped over on lookup
 // - reclen must be a multiple of 4
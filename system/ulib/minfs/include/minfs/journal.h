@@ -0,0 +1,87 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// This file describes the journal which makes minfs metadata updates atomic.
+
+#pragma once
+
+#ifdef __Fuchsia__
+#include <lib/fzl/owned-vmo-mapper.h>
+#include <zircon/device/block.h>
+#endif
+
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+
+#include <minfs/bcache.h>
+#include <minfs/format.h>
+
+namespace minfs {
+
+// Replays the valid entries left in the journal of the volume described by
+// |info|, oldest first, and then clears the journal. If the superblock was
+// among the replayed blocks, it is read back into |info|.
+//
+// Volumes without a journal are left alone.
+zx_status_t ReplayJournal(Bcache* bc, Superblock* info);
+
+#ifdef __Fuchsia__
+
+class WritebackWork;
+
+// Writes journal entries on behalf of the writeback thread, which is its only
+// user.
+class Journal {
+public:
+    DISALLOW_COPY_ASSIGN_AND_MOVE(Journal);
+
+    // Creates the journal of the volume described by |info|. |*out| is left
+    // null if the volume has no journal.
+    static zx_status_t Create(Bcache* bc, const Superblock& info, fbl::unique_ptr<Journal>* out);
+    ~Journal();
+
+    // The number of blocks one entry can hold.
+    size_t Capacity() const { return capacity_; }
+
+    // Writes a single entry holding every block of the |count| |works|, and
+    // flushes the device. The requests of the works must already point into
+    // the writeback buffer, which is mapped at |buffer| and attached as
+    // |buffer_vmoid|, and hold no more than Capacity() blocks between them.
+    //
+    // Once this returns ZX_OK, the works may be written in place.
+    zx_status_t Commit(const fbl::unique_ptr<WritebackWork>* works, size_t count,
+                       const void* buffer, vmoid_t buffer_vmoid);
+
+    // Flushes the device and clears every slot, so that no entry is replayed
+    // over writes which bypass the journal.
+    zx_status_t Invalidate();
+
+private:
+    Journal(Bcache* bc, blk_t start, blk_t slot_blocks, size_t capacity,
+            fzl::OwnedVmoMapper mapper);
+
+    // Adds a write of |length| blocks from |vmoid| to |requests_|, merging it
+    // with the previous one if they are contiguous.
+    void AddRequest(vmoid_t vmoid, uint64_t vmo_offset, uint64_t dev_offset, uint64_t length);
+
+    // Sends |requests_| to the device.
+    zx_status_t Transact();
+
+    Bcache* bc_;
+    // Absolute block number of the first slot.
+    const blk_t start_;
+    const blk_t slot_blocks_;
+    const size_t capacity_;
+    // Holds the header and commit blocks of the entry being written.
+    fzl::OwnedVmoMapper mapper_;
+    vmoid_t vmoid_ = VMOID_INVALID;
+    uint64_t sequence_ = 1;
+    // In minfs blocks until Transact().
+    fbl::Vector<block_fifo_request_t> requests_;
+};
+
+#endif  // __Fuchsia__
+
+} // namespace minfs
@@ -26,6 +26,8 @@ struct MountOptions {
     bool readonly;
     bool metrics;
     bool verbose;
+    // Trim every free block once mounted.
+    bool trim = false;
 
     // Number of slices to preallocate for data when the filesystem is created.
     uint32_t fvm_data_slices = 1;
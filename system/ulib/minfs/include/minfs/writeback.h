@@ -5,8 +5,10 @@
 #pragma once
 
 #ifdef __Fuchsia__
+#include <bitmap/rle-bitmap.h>
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
+#include <fbl/vector.h>
 #include <lib/fzl/owned-vmo-mapper.h>
 #include <lib/zx/vmo.h>
 #endif
@@ -28,8 +30,19 @@
 
 namespace minfs {
 
+class Journal;
 class VnodeMinfs;
 
+#ifdef __Fuchsia__
+// A run of blocks freed by the WritebackWork numbered |seq|, or by work
+// which is already durable if |seq| is zero.
+struct PendingTrim {
+    blk_t start;
+    blk_t count;
+    uint64_t seq;
+};
+#endif
+
 // A wrapper around a WriteTxn, holding references to the underlying Vnodes
 // corresponding to the txn, so their Vnodes (and VMOs) are not released
 // while being written out to disk.
@@ -46,12 +59,17 @@ public:
     void Reset();
 
 #ifdef __Fuchsia__
-    // Actually transacts the enqueued work, and resets the WritebackWork to
-    // its initial state.
-    //
-    // Returns the number of blocks of the writeback buffer that have been
-    // consumed.
-    size_t Complete(zx_handle_t vmo, vmoid_t vmoid);
+    // Called by the writeback thread once the enqueued work has been written
+    // out. Signals the closure, if any, with |status| and resets the
+    // WritebackWork to its initial state.
+    void Finish(zx_status_t status);
+
+    bool HasClosure() const { return static_cast<bool>(closure_); }
+
+    // Identifies the blocks freed by this work to the WritebackBuffer; zero
+    // if it frees none.
+    uint64_t TrimSeq() const { return trim_seq_; }
+    void SetTrimSeq(uint64_t seq) { trim_seq_ = seq; }
 
     // Adds a closure to the WritebackWork, such that it will be signalled
     // when the WritebackWork is flushed to disk.
@@ -72,6 +90,7 @@ public:
 private:
 #ifdef __Fuchsia__
     SyncCallback closure_; // Optional.
+    uint64_t trim_seq_ = 0;
 #endif
     size_t node_count_;
     // May be empty. Currently '4' is the maximum number of vnodes within a
@@ -93,12 +112,13 @@ public:
 
     size_t AllocateInode() {
         ZX_DEBUG_ASSERT(inode_promise_ != nullptr);
-        return inode_promise_->Allocate(work_.get());
+        return inode_promise_->Allocate(work_.get(), 0);
     }
 
-    size_t AllocateBlock() {
+    // |goal| is the block the caller would like; see Allocator::Allocate.
+    size_t AllocateBlock(blk_t goal) {
         ZX_DEBUG_ASSERT(block_promise_ != nullptr);
-        return block_promise_->Allocate(work_.get());
+        return block_promise_->Allocate(work_.get(), goal);
     }
 
     void SetWork(fbl::unique_ptr<WritebackWork> work) {
@@ -110,6 +130,18 @@ public:
         return work_.get();
     }
 
+    // Hands the transaction blocks which were reserved earlier, for it to allocate from.
+    // Must only be called on a transaction which reserved no blocks of its own.
+    void GiveBlockPromise(fbl::unique_ptr<AllocatorPromise> promise) {
+        ZX_DEBUG_ASSERT(block_promise_ == nullptr);
+        block_promise_ = fbl::move(promise);
+    }
+
+    // Takes back whatever is left of the transaction's block reservation.
+    fbl::unique_ptr<AllocatorPromise> TakeBlockPromise() {
+        return fbl::move(block_promise_);
+    }
+
     fbl::unique_ptr<WritebackWork> RemoveWork() {
         ZX_DEBUG_ASSERT(work_ != nullptr);
         return fbl::move(work_);
@@ -128,7 +160,9 @@ private:
 class WritebackBuffer {
 public:
     // Calls constructor, return an error if anything goes wrong.
+    // |journal| may be null, if the volume has none.
     static zx_status_t Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                              fbl::unique_ptr<Journal> journal,
                               fbl::unique_ptr<WritebackBuffer>* out);
     ~WritebackBuffer();
 
@@ -142,8 +176,20 @@ public:
     // enqueued, preventing them from closing while the writeback is pending.
     void Enqueue(fbl::unique_ptr<WritebackWork> work) __TA_EXCLUDES(writeback_lock_);
 
+    // Records that |work| frees the |count| blocks starting at |start|. Once
+    // the work is durable, they are trimmed, unless they have been allocated
+    // again since. Blocks which are already waiting to be trimmed are left to
+    // the work which freed them first. Does nothing if the device doesn't
+    // support trim.
+    void FreeBlocks(WritebackWork* work, blk_t start, blk_t count) __TA_EXCLUDES(trim_lock_);
+
+    // Must be called when |bno| is allocated, before anything is written to it.
+    void AllocateBlock(blk_t bno) __TA_EXCLUDES(trim_lock_);
+
 private:
-    WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper);
+    using WorkBatch = fbl::Vector<fbl::unique_ptr<WritebackWork>>;
+
+    WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper, fbl::unique_ptr<Journal> journal);
 
     // Blocks until |blocks| blocks of data are free for the caller.
     // Returns |ZX_OK| with the lock still held in this case.
@@ -162,6 +208,23 @@ private:
     // safely guarantee that space exists within the buffer.
     void CopyToBufferLocked(WriteTxn* txn) __TA_REQUIRES(writeback_lock_);
 
+    // Writes out |batch|, which holds |blocks| blocks, and completes it.
+    // The works commit as a group: one journal entry and one device flush
+    // cover all of them.
+    void CompleteBatch(WorkBatch* batch, size_t blocks) __TA_EXCLUDES(writeback_lock_);
+
+    // Marks the blocks freed by |batch| as durable, or forgets them if it
+    // failed with |status|. Returns the number of durable runs of blocks
+    // waiting to be trimmed.
+    size_t CompleteTrims(const WorkBatch& batch, zx_status_t status) __TA_EXCLUDES(trim_lock_);
+
+    // Trims the blocks freed by durable work which are still free.
+    void TrimFreedBlocks() __TA_EXCLUDES(trim_lock_);
+
+    // Stops trimming; used when it fails, or when the freed blocks can no
+    // longer be tracked.
+    void DisableTrimLocked() __TA_REQUIRES(trim_lock_);
+
     static int WritebackThread(void* arg);
 
     // The waiter struct may be used as a stack-allocated queue for producers.
@@ -183,6 +246,21 @@ private:
     thrd_t writeback_thrd_;
     Bcache* bc_;
     fbl::Mutex writeback_lock_;
+    // Only used by the writeback thread.
+    fbl::unique_ptr<Journal> journal_;
+    // True if blocks have been written in place since the last device flush,
+    // and no journal entry covers them.
+    bool unflushed_ = false;
+
+    fbl::Mutex trim_lock_;
+    bool trim_enabled_ __TA_GUARDED(trim_lock_) = false;
+    // The number given to the last work to free blocks.
+    uint64_t trim_seq_ __TA_GUARDED(trim_lock_) = 0;
+    // The blocks which have been freed, and neither trimmed nor allocated
+    // since. No two runs overlap, and |trim_pending_| holds their union, so
+    // that an allocation only searches them when it hits one.
+    fbl::Vector<PendingTrim> pending_trims_ __TA_GUARDED(trim_lock_);
+    bitmap::RleBitmap trim_pending_ __TA_GUARDED(trim_lock_);
 
     // Ensures that if multiple producers are waiting for space to write their
     // txns into the writeback buffer, they can each write in-order.
@@ -0,0 +1,295 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <fs/trace.h>
+#include <lib/cksum.h>
+
+#ifdef __Fuchsia__
+#include <minfs/writeback.h>
+#endif
+
+#include <minfs/journal.h>
+
+namespace minfs {
+
+namespace {
+
+// A slot's entry, as found on disk by ReplayJournal.
+struct SlotEntry {
+    blk_t start;
+    const JournalHeader* header;
+};
+
+// Reads the entry in the slot starting at |start| into |header_data|,
+// followed by its blocks, one at a time through |block_data|. Returns true if
+// the entry is complete and intact.
+bool ReadSlot(Bcache* bc, blk_t start, uint32_t capacity, uint8_t* header_data,
+              uint8_t* block_data) {
+    if (bc->Readblk(start, header_data) != ZX_OK) {
+        return false;
+    }
+    const JournalHeader* header = reinterpret_cast<const JournalHeader*>(header_data);
+    if (header->magic != kMinfsJournalMagic || header->block_count > capacity) {
+        return false;
+    }
+
+    uint32_t checksum = crc32(0, header_data, kMinfsBlockSize);
+    for (uint32_t i = 0; i < header->block_count; i++) {
+        if (bc->Readblk(start + 1 + i, block_data) != ZX_OK) {
+            return false;
+        }
+        checksum = crc32(checksum, block_data, kMinfsBlockSize);
+    }
+    if (bc->Readblk(start + 1 + header->block_count, block_data) != ZX_OK) {
+        return false;
+    }
+    const JournalCommit* commit = reinterpret_cast<const JournalCommit*>(block_data);
+    return commit->magic == kMinfsJournalCommitMagic && commit->sequence == header->sequence &&
+           commit->checksum == checksum;
+}
+
+} // namespace
+
+zx_status_t ReplayJournal(Bcache* bc, Superblock* info) {
+    if (info->version < kMinfsJournalVersion || info->journal_block_count == 0) {
+        return ZX_OK;
+    }
+#ifndef __Fuchsia__
+    // Sparse images are only ever read, so they are never left with a journal
+    // to replay. Their absolute block numbers don't match the image either.
+    if (bc->extent_lengths_.size() != 0) {
+        return ZX_OK;
+    }
+#endif
+    const uint32_t slot_blocks = info->journal_block_count / kMinfsJournalSlots;
+    if (info->journal_block == 0 || slot_blocks < kMinfsJournalMinSlotBlocks ||
+        info->journal_block + info->journal_block_count > info->block_count) {
+        FS_TRACE_ERROR("minfs: journal [%u, +%u) is invalid\n", info->journal_block,
+                       info->journal_block_count);
+        return ZX_ERR_IO_DATA_INTEGRITY;
+    }
+    const blk_t start = info->dat_block + info->journal_block;
+    const uint32_t capacity = MinfsJournalSlotCapacity(info->journal_block_count);
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[(kMinfsJournalSlots + 1) *
+                                                       kMinfsBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint8_t* block_data = data.get() + kMinfsJournalSlots * kMinfsBlockSize;
+
+    // Find the intact entries, and whether anything has to be cleared.
+    SlotEntry entries[kMinfsJournalSlots];
+    size_t entry_count = 0;
+    bool used = false;
+    for (uint32_t slot = 0; slot < kMinfsJournalSlots; slot++) {
+        uint8_t* header_data = data.get() + slot * kMinfsBlockSize;
+        const blk_t slot_start = start + slot * slot_blocks;
+        if (ReadSlot(bc, slot_start, capacity, header_data, block_data)) {
+            SlotEntry entry = {slot_start, reinterpret_cast<const JournalHeader*>(header_data)};
+            size_t i = entry_count++;
+            for (; i > 0 && entries[i - 1].header->sequence > entry.header->sequence; i--) {
+                entries[i] = entries[i - 1];
+            }
+            entries[i] = entry;
+        }
+        used |= reinterpret_cast<const JournalHeader*>(header_data)->magic == kMinfsJournalMagic;
+    }
+    if (!used) {
+        return ZX_OK;
+    }
+
+    zx_status_t status;
+    bool superblock_replayed = false;
+    for (size_t i = 0; i < entry_count; i++) {
+        const JournalHeader* header = entries[i].header;
+        for (uint32_t n = 0; n < header->block_count; n++) {
+            const blk_t target = header->targets[n];
+            if (target >= start && target < start + info->journal_block_count) {
+                FS_TRACE_ERROR("minfs: journal entry targets the journal\n");
+                return ZX_ERR_IO_DATA_INTEGRITY;
+            }
+            if ((status = bc->Readblk(entries[i].start + 1 + n, block_data)) != ZX_OK ||
+                (status = bc->Writeblk(target, block_data)) != ZX_OK) {
+                return status;
+            }
+            superblock_replayed |= (target == 0);
+        }
+        FS_TRACE_WARN("minfs: replayed journal entry %" PRIu64 " (%u blocks)\n",
+                      header->sequence, header->block_count);
+    }
+    if ((status = bc->Sync()) != ZX_OK) {
+        return status;
+    }
+
+    // Clear the headers only once the replayed blocks are durable.
+    memset(block_data, 0, kMinfsBlockSize);
+    for (uint32_t slot = 0; slot < kMinfsJournalSlots; slot++) {
+        if ((status = bc->Writeblk(start + slot * slot_blocks, block_data)) != ZX_OK) {
+            return status;
+        }
+    }
+    if ((status = bc->Sync()) != ZX_OK) {
+        return status;
+    }
+
+    if (superblock_replayed) {
+        if ((status = bc->Readblk(0, block_data)) != ZX_OK) {
+            return status;
+        }
+        memcpy(info, block_data, sizeof(*info));
+    }
+    return ZX_OK;
+}
+
+#ifdef __Fuchsia__
+
+zx_status_t Journal::Create(Bcache* bc, const Superblock& info, fbl::unique_ptr<Journal>* out) {
+    if (info.version < kMinfsJournalVersion || info.journal_block_count == 0) {
+        out->reset();
+        return ZX_OK;
+    }
+
+    fzl::OwnedVmoMapper mapper;
+    zx_status_t status;
+    if ((status = mapper.CreateAndMap(2 * kMinfsBlockSize, "minfs-journal")) != ZX_OK) {
+        return status;
+    }
+    const blk_t slot_blocks = info.journal_block_count / kMinfsJournalSlots;
+    fbl::unique_ptr<Journal> journal(new Journal(bc, info.dat_block + info.journal_block,
+                                                 slot_blocks,
+                                                 MinfsJournalSlotCapacity(info.journal_block_count),
+                                                 fbl::move(mapper)));
+    if ((status = bc->AttachVmo(journal->mapper_.vmo().get(), &journal->vmoid_)) != ZX_OK) {
+        return status;
+    }
+    *out = fbl::move(journal);
+    return ZX_OK;
+}
+
+Journal::Journal(Bcache* bc, blk_t start, blk_t slot_blocks, size_t capacity,
+                 fzl::OwnedVmoMapper mapper)
+    : bc_(bc), start_(start), slot_blocks_(slot_blocks), capacity_(capacity),
+      mapper_(fbl::move(mapper)) {}
+
+Journal::~Journal() {
+    if (vmoid_ != VMOID_INVALID) {
+        block_fifo_request_t request;
+        request.group = bc_->BlockGroupID();
+        request.vmoid = vmoid_;
+        request.opcode = BLOCKIO_CLOSE_VMO;
+        bc_->Transaction(&request, 1);
+    }
+}
+
+zx_status_t Journal::Commit(const fbl::unique_ptr<WritebackWork>* works, size_t count,
+                            const void* buffer, vmoid_t buffer_vmoid) {
+    TRACE_DURATION("minfs", "Journal::Commit");
+    memset(mapper_.start(), 0, 2 * kMinfsBlockSize);
+    JournalHeader* header = reinterpret_cast<JournalHeader*>(mapper_.start());
+    JournalCommit* commit = reinterpret_cast<JournalCommit*>(
+        reinterpret_cast<uintptr_t>(mapper_.start()) + kMinfsBlockSize);
+    const blk_t slot = start_ + static_cast<blk_t>(sequence_ % kMinfsJournalSlots) * slot_blocks_;
+
+    header->magic = kMinfsJournalMagic;
+    header->sequence = sequence_;
+    requests_.reset();
+    AddRequest(vmoid_, 0, slot, 1);
+    uint32_t block_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        auto& reqs = works[i]->Requests();
+        for (size_t j = 0; j < reqs.size(); j++) {
+            ZX_DEBUG_ASSERT(block_count + reqs[j].length <= capacity_);
+            for (uint64_t n = 0; n < reqs[j].length; n++) {
+                header->targets[block_count + n] = static_cast<blk_t>(reqs[j].dev_offset + n);
+            }
+            AddRequest(buffer_vmoid, reqs[j].vmo_offset, slot + 1 + block_count, reqs[j].length);
+            block_count += static_cast<uint32_t>(reqs[j].length);
+        }
+    }
+    header->block_count = block_count;
+
+    // Every request but the header's reads the writeback buffer.
+    uint32_t checksum = crc32(0, static_cast<const uint8_t*>(mapper_.start()), kMinfsBlockSize);
+    for (size_t i = 1; i < requests_.size(); i++) {
+        const uint8_t* data = static_cast<const uint8_t*>(buffer) +
+                              requests_[i].vmo_offset * kMinfsBlockSize;
+        checksum = crc32(checksum, data, requests_[i].length * kMinfsBlockSize);
+    }
+    commit->magic = kMinfsJournalCommitMagic;
+    commit->sequence = sequence_;
+    commit->checksum = checksum;
+    AddRequest(vmoid_, 1, slot + 1 + block_count, 1);
+
+    zx_status_t status;
+    if ((status = Transact()) != ZX_OK) {
+        return status;
+    }
+    if ((status = bc_->Sync()) != ZX_OK) {
+        return status;
+    }
+    sequence_++;
+    return ZX_OK;
+}
+
+zx_status_t Journal::Invalidate() {
+    TRACE_DURATION("minfs", "Journal::Invalidate");
+    // The newest entry may cover in-place writes which are not durable yet.
+    zx_status_t status;
+    if ((status = bc_->Sync()) != ZX_OK) {
+        return status;
+    }
+    memset(mapper_.start(), 0, kMinfsBlockSize);
+    requests_.reset();
+    for (blk_t slot = 0; slot < kMinfsJournalSlots; slot++) {
+        AddRequest(vmoid_, 0, start_ + slot * slot_blocks_, 1);
+    }
+    if ((status = Transact()) != ZX_OK) {
+        return status;
+    }
+    return bc_->Sync();
+}
+
+void Journal::AddRequest(vmoid_t vmoid, uint64_t vmo_offset, uint64_t dev_offset,
+                         uint64_t length) {
+    if (!requests_.is_empty()) {
+        block_fifo_request_t& last = requests_[requests_.size() - 1];
+        if (last.vmoid == vmoid && last.vmo_offset + last.length == vmo_offset &&
+            last.dev_offset + last.length == dev_offset) {
+            last.length += static_cast<uint32_t>(length);
+            return;
+        }
+    }
+    block_fifo_request_t request = {};
+    request.opcode = BLOCKIO_WRITE;
+    request.vmoid = vmoid;
+    request.vmo_offset = vmo_offset;
+    request.dev_offset = dev_offset;
+    request.length = static_cast<uint32_t>(length);
+    requests_.push_back(request);
+}
+
+zx_status_t Journal::Transact() {
+    const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / bc_->DeviceBlockSize();
+    const groupid_t group = bc_->BlockGroupID();
+    for (size_t i = 0; i < requests_.size(); i++) {
+        requests_[i].group = group;
+        requests_[i].vmo_offset *= kDiskBlocksPerMinfsBlock;
+        requests_[i].dev_offset *= kDiskBlocksPerMinfsBlock;
+        requests_[i].length *= kDiskBlocksPerMinfsBlock;
+    }
+    zx_status_t status = bc_->Transaction(requests_.get(), requests_.size());
+    requests_.reset();
+    return status;
+}
+
+#endif  // __Fuchsia__
+
+} // namespace minfs
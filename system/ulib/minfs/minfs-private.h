@@ -13,9 +13,11 @@
 #include <fbl/auto_lock.h>
 #include <fs/managed-vfs.h>
 #include <fs/remote.h>
+#include <fs/size-watcher.h>
 #include <fs/watcher.h>
 #include <fuchsia/io/c/fidl.h>
 #include <fuchsia/minfs/c/fidl.h>
+#include <lib/async/cpp/task.h>
 #include <lib/fzl/resizeable-vmo-mapper.h>
 #include <lib/sync/completion.h>
 #include <lib/zx/vmo.h>
@@ -23,18 +25,18 @@
 
 #include <fbl/algorithm.h>
 #include <fbl/function.h>
-#include <fbl/intrusive_hash_table.h>
+#include <fbl/flat_hash_table.h>
 #include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
 #include <fbl/ref_ptr.h>
 #include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
 #include <fs/block-txn.h>
 #include <fs/locking.h>
 #include <fs/ticker.h>
 #include <fs/trace.h>
 #include <fs/vfs.h>
 #include <fs/vnode.h>
-#include <lib/zircon-internal/fnv1hash.h>
 #include <minfs/allocator.h>
 #include <minfs/format.h>
 #include <minfs/inode-manager.h>
@@ -118,6 +120,19 @@ private:
 };
 #endif
 
+#ifdef __Fuchsia__
+// Writes to a file of at most this many bytes are delayed: the data only goes
+// to the vnode's VMO, and blocks are allocated for it when it is flushed, in
+// one transaction for each run of delayed blocks.
+constexpr size_t kMinfsDelayedWriteMaxSize = 8 * kMinfsBlockSize;
+
+// Delayed data is flushed once this many blocks of it are waiting...
+constexpr size_t kMinfsMaxDelayedBlocks = 64;
+
+// ... or this long after the first of them were written.
+constexpr zx_duration_t kMinfsDelayedWriteTimeout = ZX_SEC(1);
+#endif
+
 class Minfs :
 #ifdef __Fuchsia__
     public fs::ManagedVfs,
@@ -145,11 +160,11 @@ public:
     fbl::RefPtr<VnodeMinfs> VnodeLookup(uint32_t ino) FS_TA_EXCLUDES(hash_lock_);
     void VnodeRelease(VnodeMinfs* vn) FS_TA_EXCLUDES(hash_lock_);
 
-    // Allocate a new data block.
-    void BlockNew(Transaction* state, blk_t* out_bno);
+    // Allocate a new data block, at |goal| if it is free; see Allocator::Allocate.
+    void BlockNew(Transaction* state, blk_t goal, blk_t* out_bno);
 
     // Free a data block.
-    void BlockFree(WriteTxn* txn, blk_t bno);
+    void BlockFree(WritebackWork* wb, blk_t bno);
 
     // Queries the underlying FVM, if it exists.
     zx_status_t FVMQuery(fvm_info_t* info) const;
@@ -166,6 +181,9 @@ public:
     // Free resources of all vnodes marked unlinked.
     zx_status_t PurgeUnlinked();
 
+    // Bring the superblock up to kMinfsVersion, before anything which needs it is written.
+    void UpgradeVersion(WritebackWork* wb);
+
     // Writes back an inode into the inode table on persistent storage.
     // Does not modify inode bitmap.
     void InodeUpdate(WriteTxn* txn, ino_t ino, const Inode* inode) {
@@ -205,6 +223,37 @@ public:
     // (1) A sync probe has entered and exited the writeback queue, and
     // (2) The block cache has sync'd with the underlying block device.
     void Sync(SyncCallback closure);
+
+    // Trims every free data block, as a volume written while the device
+    // didn't accept trims still holds the data of its freed blocks.
+    void TrimFreeBlocks();
+
+    // Reserves |count| more blocks into |*promise|, creating it if needed.
+    zx_status_t ReserveBlocks(size_t count, fbl::unique_ptr<AllocatorPromise>* promise);
+
+    // Tracks |blocks| new blocks of delayed data in |vn|, flushing it
+    // (and everything else) if too much is waiting.
+    zx_status_t AddDelayedWrite(VnodeMinfs* vn, size_t blocks);
+
+    // Forgets |blocks| blocks of delayed data of |vn|, and |vn| itself once it
+    // has none left.
+    void RemoveDelayedWrite(VnodeMinfs* vn, size_t blocks);
+
+    // Allocates and writes back the delayed data of every vnode. Data which
+    // can't be flushed stays delayed, and is tried again after a timeout.
+    zx_status_t FlushDelayedWrites();
+
+    // See fuchsia.minfs.Minfs/FailDelayedFlushes.
+    void FailDelayedFlushes(uint32_t count) { delayed_flush_failures_ = count; }
+
+    // Consumes one of the failures requested by FailDelayedFlushes, if any.
+    bool TakeDelayedFlushFailure() {
+        if (delayed_flush_failures_ == 0) {
+            return false;
+        }
+        delayed_flush_failures_--;
+        return true;
+    }
 #endif
 
     // The following methods are used to read one block from the specified extent,
@@ -260,7 +309,7 @@ public:
 private:
     // Fsck can introspect Minfs
     friend class MinfsChecker;
-    using HashTable = fbl::HashTable<ino_t, VnodeMinfs*>;
+    using HashTable = fbl::FlatHashTable<ino_t, VnodeMinfs*>;
 
 #ifdef __Fuchsia__
     Minfs(fbl::unique_ptr<Bcache> bc, fbl::unique_ptr<SuperblockManager> sb,
@@ -309,6 +358,13 @@ private:
     fuchsia_minfs_Metrics metrics_ = {};
     fbl::unique_ptr<WritebackBuffer> writeback_;
     uint64_t fs_id_ = 0;
+
+    // Vnodes with delayed data, which stay alive until it has been flushed.
+    fbl::Vector<fbl::RefPtr<VnodeMinfs>> delayed_vnodes_;
+    size_t delayed_blocks_ = 0;
+    uint32_t delayed_flush_failures_ = 0;
+    void DelayedFlushTimeout() { FlushDelayedWrites(); }
+    async::TaskClosureMethod<Minfs, &Minfs::DelayedFlushTimeout> delayed_flush_task_{this};
 #else
     // Store start block + length for all extents. These may differ from info block for
     // sparse files.
@@ -331,7 +387,6 @@ struct DirArgs {
 };
 
 class VnodeMinfs final : public fs::Vnode,
-                         public fbl::SinglyLinkedListable<VnodeMinfs*>,
                          public fbl::Recyclable<VnodeMinfs> {
 public:
     ~VnodeMinfs();
@@ -351,6 +406,7 @@ public:
     static zx_status_t Recreate(Minfs* fs, ino_t ino, fbl::RefPtr<VnodeMinfs>* out);
 
     bool IsDirectory() const { return inode_.magic == kMinfsMagicDir; }
+    bool IsHashedDirectory() const { return inode_.dir_flags & kMinfsDirFlagHashed; }
     bool IsUnlinked() const { return inode_.link_count == 0; }
     zx_status_t CanUnlink() const;
 
@@ -359,7 +415,7 @@ public:
     ino_t GetKey() const { return ino_; }
     // Should only be called once for the VnodeMinfs lifecycle.
     void SetIno(ino_t ino);
-    static size_t GetHash(ino_t key) { return fnv1a_tiny(key, kMinfsHashBits); }
+    static size_t GetHash(ino_t key) { return key; }
 
     // fs::Vnode interface (invoked publicly).
 #ifdef __Fuchsia__
@@ -375,6 +431,7 @@ public:
     // Minfs FIDL interface.
     zx_status_t GetMetrics(fidl_txn_t* txn);
     zx_status_t ToggleMetrics(bool enabled, fidl_txn_t* txn);
+    zx_status_t FailDelayedFlushes(uint32_t count, fidl_txn_t* txn);
 #endif
 
     // TODO(rvargas): Make private.
@@ -386,6 +443,11 @@ private:
     friend zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb);
     friend void Minfs::AddUnlinked(WritebackWork* wb, VnodeMinfs* vn);
     friend void Minfs::RemoveUnlinked(WritebackWork* wb, VnodeMinfs* vn);
+#ifdef __Fuchsia__
+    friend zx_status_t Minfs::AddDelayedWrite(VnodeMinfs* vn, size_t blocks);
+    friend void Minfs::RemoveDelayedWrite(VnodeMinfs* vn, size_t blocks);
+    friend zx_status_t Minfs::FlushDelayedWrites();
+#endif
 
     VnodeMinfs(Minfs* fs);
 
@@ -454,6 +516,25 @@ private:
     // the same |args| that were passed into DirentCallbackFindSpace.
     zx_status_t AppendDirent(DirArgs* args);
 
+    // Finds room for a dirent of |args->reclen| bytes named |args->name|, for a following
+    // AppendDirent. A linear directory which would grow past kMinfsDirLinearMaxSize is hashed
+    // first, and a full bucket of a hashed directory is split; each of those commits a
+    // transaction of its own.
+    zx_status_t FindSpace(DirArgs* args);
+
+    // The end of the run of dirents that the one at |off| belongs to: the end of its bucket in
+    // a hashed directory, kMinfsMaxDirectorySize in a linear one.
+    size_t DirentLimit(size_t off) const;
+
+    // Finds the offset of the bucket which would hold |name| in a hashed directory.
+    zx_status_t HashedBucketOffset(fbl::StringPiece name, size_t* out_off);
+
+    // Rewrites a linear directory as a hashed one.
+    zx_status_t ConvertToHashed();
+
+    // Splits the bucket which would hold |name| in a hashed directory in two.
+    zx_status_t SplitBucket(fbl::StringPiece name);
+
     zx_status_t UnlinkChild(Transaction* state, fbl::RefPtr<VnodeMinfs> child,
                             Dirent* de, DirectoryOffset* offs);
     // Remove the link to a vnode (referring to inodes exclusively).
@@ -631,6 +712,8 @@ private:
                            zxrio_node_info_t* extra) final;
     void Sync(SyncCallback closure) final;
     zx_status_t AttachRemote(fs::MountChannel h) final;
+    zx_status_t GetBuffer(zx::vmo* out_vmo, size_t* out_size,
+                          zx::eventpair* out_size_changed) final;
     zx_status_t InitVmo();
     zx_status_t InitIndirectVmo();
 
@@ -642,6 +725,17 @@ private:
     zx_status_t LoadIndirectBlocks(blk_t* iarray, uint32_t count, uint32_t offset,
                                    uint64_t size);
 
+    // Writes |len| bytes at |off| into the VMO only, leaving the blocks to be
+    // allocated by FlushDelayedWrite.
+    zx_status_t DelayedWrite(const void* data, size_t len, size_t off);
+
+    // Allocates blocks for the delayed data, if any, and writes it back. On
+    // failure, whatever couldn't be allocated stays delayed.
+    zx_status_t FlushDelayedWrite();
+
+    // Drops the delayed data of a vnode which is about to be purged.
+    void DiscardDelayedWrite();
+
     // Reads the block at |offset| in memory.
     // Assumes that vmo_indirect_ has already been initialized
     void ReadIndirectVmoBlock(uint32_t offset, uint32_t** entry);
@@ -685,13 +779,30 @@ private:
     vmoid_t vmoid_{};
     vmoid_t vmoid_indirect_{};
 
+    // The blocks [delayed_start_, delayed_end_) of vmo_ hold data which has not
+    // been written back yet, and delayed_promise_ holds enough blocks for it.
+    // Until it has been, the inode on disk keeps the size it had when the run
+    // began, delayed_base_size_, or that of the data in front of the run.
+    blk_t delayed_start_{};
+    blk_t delayed_end_{};
+    uint32_t delayed_base_size_{};
+    fbl::unique_ptr<AllocatorPromise> delayed_promise_;
+
     fs::RemoteContainer remoter_{};
     fs::WatcherContainer watcher_{};
+    // Told whenever a write or truncation changes the size of the file.
+    fs::SizeWatcherContainer size_watchers_{};
 #endif
 
     ino_t ino_{};
     Inode inode_{};
 
+    // Where this vnode would like its next block: right after the last one it
+    // allocated, so that sequential writes land on contiguous blocks and reach
+    // the device as a few long block operations. Zero until the first
+    // allocation.
+    blk_t alloc_goal_{};
+
     // This field tracks the current number of file descriptors with
     // an open reference to this Vnode. Notably, this is distinct from the
     // VnodeMinfs's own refcount, since there may still be filesystem
@@ -27,6 +27,7 @@
 #endif
 
 #include <minfs/fsck.h>
+#include <minfs/journal.h>
 #include <minfs/minfs.h>
 
 #include "minfs-private.h"
@@ -83,6 +84,8 @@ void DumpInfo(const Superblock* info) {
     xprintf("minfs: alloc bitmap @ %10u\n", info->abm_block);
     xprintf("minfs: inode table  @ %10u\n", info->ino_block);
     xprintf("minfs: data blocks  @ %10u\n", info->dat_block);
+    xprintf("minfs: journal      @ %10u (%u blocks)\n", info->journal_block,
+            info->journal_block_count);
     xprintf("minfs: FVM-aware: %s\n", (info->flags & kMinfsFlagFVM) ? "YES" : "NO");
 }
 
@@ -101,7 +104,7 @@ zx_status_t CheckSuperblock(const Superblock* info, Bcache* bc) {
         FS_TRACE_ERROR("minfs: bad magic\n");
         return ZX_ERR_INVALID_ARGS;
     }
-    if (info->version != kMinfsVersion) {
+    if ((info->version < kMinfsMinVersion) || (info->version > kMinfsVersion)) {
         FS_TRACE_ERROR("minfs: FS Version: %08x. Driver version: %08x\n", info->version,
                        kMinfsVersion);
         return ZX_ERR_INVALID_ARGS;
@@ -280,11 +283,115 @@ zx_status_t Minfs::BeginTransaction(size_t reserve_inodes, size_t reserve_blocks
 
 #ifdef __Fuchsia__
 void Minfs::Sync(SyncCallback closure) {
+    zx_status_t status;
+    if ((status = FlushDelayedWrites()) != ZX_OK) {
+        closure(status);
+        return;
+    }
+
     fbl::unique_ptr<Transaction> state;
     ZX_ASSERT(BeginTransaction(0, 0, &state) == ZX_OK);
     state->GetWork()->SetClosure(fbl::move(closure));
     CommitTransaction(fbl::move(state));
 }
+
+void Minfs::TrimFreeBlocks() {
+    TRACE_DURATION("minfs", "Minfs::TrimFreeBlocks");
+    fbl::unique_ptr<Transaction> state;
+    ZX_ASSERT(BeginTransaction(0, 0, &state) == ZX_OK);
+    WritebackWork* wb = state->GetWork();
+    block_allocator_->ForEachFreeRun([this, wb](size_t start, size_t count) {
+        writeback_->FreeBlocks(wb, static_cast<blk_t>(Info().dat_block + start),
+                               static_cast<blk_t>(count));
+    });
+    // The closure has the device flushed behind the work, so that the
+    // trims aren't held back by earlier writes.
+    wb->SetClosure([](zx_status_t status) {});
+    CommitTransaction(fbl::move(state));
+}
+
+zx_status_t Minfs::ReserveBlocks(size_t count, fbl::unique_ptr<AllocatorPromise>* promise) {
+    fbl::unique_ptr<WritebackWork> work(new WritebackWork(bc_.get()));
+    fbl::unique_ptr<AllocatorPromise> reserved;
+    zx_status_t status = block_allocator_->Reserve(work.get(), count, &reserved);
+    // Reserving may have grown the allocator, which has to reach the disk.
+    writeback_->Enqueue(fbl::move(work));
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    if (*promise == nullptr) {
+        *promise = fbl::move(reserved);
+    } else {
+        (*promise)->Merge(fbl::move(reserved));
+    }
+    return ZX_OK;
+}
+
+zx_status_t Minfs::AddDelayedWrite(VnodeMinfs* vn, size_t blocks) {
+    bool found = false;
+    for (const auto& delayed : delayed_vnodes_) {
+        if (delayed.get() == vn) {
+            found = true;
+            break;
+        }
+    }
+    if (!found) {
+        fbl::AllocChecker ac;
+        delayed_vnodes_.push_back(fbl::WrapRefPtr(vn), &ac);
+        if (!ac.check()) {
+            // Without a reference to keep it alive, |vn| has to go out now.
+            // Whatever doesn't stays delayed until the vnode is closed.
+            return vn->FlushDelayedWrite();
+        }
+    }
+    delayed_blocks_ += blocks;
+
+    if (delayed_blocks_ > kMinfsMaxDelayedBlocks) {
+        FlushDelayedWrites();
+    } else if (!delayed_flush_task_.is_pending() && dispatcher() != nullptr) {
+        delayed_flush_task_.PostDelayed(dispatcher(), zx::duration(kMinfsDelayedWriteTimeout));
+    }
+    return ZX_OK;
+}
+
+void Minfs::RemoveDelayedWrite(VnodeMinfs* vn, size_t blocks) {
+    for (size_t i = 0; i < delayed_vnodes_.size(); i++) {
+        if (delayed_vnodes_[i].get() == vn) {
+            ZX_DEBUG_ASSERT(delayed_blocks_ >= blocks);
+            delayed_blocks_ -= blocks;
+            if (vn->delayed_end_ == 0) {
+                // The caller keeps |vn| alive, so the reference can be dropped here.
+                delayed_vnodes_.erase(i);
+            }
+            break;
+        }
+    }
+    if (delayed_vnodes_.is_empty()) {
+        delayed_flush_task_.Cancel();
+    }
+}
+
+zx_status_t Minfs::FlushDelayedWrites() {
+    delayed_flush_task_.Cancel();
+    zx_status_t result = ZX_OK;
+    // A vnode leaves the list once all of its data is flushed, which doesn't
+    // move the ones in front of it.
+    for (size_t i = delayed_vnodes_.size(); i > 0; i--) {
+        fbl::RefPtr<VnodeMinfs> vn = delayed_vnodes_[i - 1];
+        zx_status_t status = vn->FlushDelayedWrite();
+        if (status != ZX_OK) {
+            FS_TRACE_ERROR("minfs: Failed to flush delayed data of ino %u: %d\n", vn->ino_,
+                           status);
+            result = status;
+        }
+    }
+    // Whatever is left stays in the VMOs and is tried again later.
+    if (!delayed_vnodes_.is_empty() && dispatcher() != nullptr) {
+        delayed_flush_task_.PostDelayed(dispatcher(), zx::duration(kMinfsDelayedWriteTimeout));
+    }
+    return result;
+}
 #endif
 
 #ifdef __Fuchsia__
@@ -329,7 +436,7 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb) {
         }
         ValidateBno(vn->inode_.dnum[n]);
         block_count--;
-        block_allocator_->Free(wb, vn->inode_.dnum[n]);
+        BlockFree(wb, vn->inode_.dnum[n]);
     }
 
     // release all indirect blocks
@@ -357,11 +464,11 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb) {
                 continue;
             }
             block_count--;
-            block_allocator_->Free(wb, entry[m]);
+            BlockFree(wb, entry[m]);
         }
         // release the direct block itself
         block_count--;
-        block_allocator_->Free(wb, vn->inode_.inum[n]);
+        BlockFree(wb, vn->inode_.inum[n]);
     }
 
     // release doubly indirect blocks
@@ -407,16 +514,16 @@ zx_status_t Minfs::InoFree(VnodeMinfs* vn, WritebackWork* wb) {
                 }
 
                 block_count--;
-                block_allocator_->Free(wb, entry[k]);
+                BlockFree(wb, entry[k]);
             }
 
             block_count--;
-            block_allocator_->Free(wb, dentry[m]);
+            BlockFree(wb, dentry[m]);
         }
 
         // release the doubly indirect block itself
         block_count--;
-        block_allocator_->Free(wb, vn->inode_.dinum[n]);
+        BlockFree(wb, vn->inode_.dinum[n]);
     }
 
     ZX_DEBUG_ASSERT(block_count == 0);
@@ -453,6 +560,14 @@ void Minfs::AddUnlinked(WritebackWork* wb, VnodeMinfs* vn) {
     sb_->Write(wb);
 }
 
+void Minfs::UpgradeVersion(WritebackWork* wb) {
+    if (Info().version == kMinfsVersion) {
+        return;
+    }
+    sb_->MutableInfo()->version = kMinfsVersion;
+    sb_->Write(wb);
+}
+
 void Minfs::RemoveUnlinked(WritebackWork* wb, VnodeMinfs* vn) {
     if (vn->inode_.last_inode == 0) {
         // If |vn| is the first unlinked inode, we just need to update the list head
@@ -556,12 +671,12 @@ fbl::RefPtr<VnodeMinfs> Minfs::VnodeLookupInternal(uint32_t ino) {
     {
         // Avoid releasing a reference to |vn| while holding |hash_lock_|.
         fbl::AutoLock lock(&hash_lock_);
-        auto rawVn = vnode_hash_.find(ino);
-        if (!rawVn.IsValid()) {
+        VnodeMinfs* rawVn = vnode_hash_.find(ino);
+        if (rawVn == nullptr) {
             // Nothing exists in the lookup table
             return nullptr;
         }
-        vn = fbl::MakeRefPtrUpgradeFromRaw(rawVn.CopyPointer(), hash_lock_);
+        vn = fbl::MakeRefPtrUpgradeFromRaw(rawVn, hash_lock_);
         if (vn == nullptr) {
             // The vn 'exists' in the map, but it is being deleted.
             // Remove it (by key) so the next person doesn't trip on it,
@@ -575,7 +690,7 @@ fbl::RefPtr<VnodeMinfs> Minfs::VnodeLookupInternal(uint32_t ino) {
     }
     return vn;
 #else
-    return fbl::WrapRefPtr(vnode_hash_.find(ino).CopyPointer());
+    return fbl::WrapRefPtr(vnode_hash_.find(ino));
 #endif
 }
 
@@ -610,7 +725,7 @@ void Minfs::VnodeInsert(VnodeMinfs* vn) {
 #ifdef __Fuchsia__
     fbl::AutoLock lock(&hash_lock_);
 #endif
-    ZX_DEBUG_ASSERT_MSG(!vnode_hash_.find(vn->GetKey()).IsValid(), "ino %u already in map\n",
+    ZX_DEBUG_ASSERT_MSG(vnode_hash_.find(vn->GetKey()) == nullptr, "ino %u already in map\n",
                         vn->GetKey());
     vnode_hash_.insert(vn);
 }
@@ -660,13 +775,19 @@ zx_status_t Minfs::VnodeGet(fbl::RefPtr<VnodeMinfs>* out, ino_t ino) {
 }
 
 // Allocate a new data block from the block bitmap.
-void Minfs::BlockNew(Transaction* state, blk_t* out_bno) {
-    size_t allocated_bno = state->AllocateBlock();
+void Minfs::BlockNew(Transaction* state, blk_t goal, blk_t* out_bno) {
+    size_t allocated_bno = state->AllocateBlock(goal);
     *out_bno = static_cast<blk_t>(allocated_bno);
+#ifdef __Fuchsia__
+    writeback_->AllocateBlock(Info().dat_block + *out_bno);
+#endif
 }
 
-void Minfs::BlockFree(WriteTxn* txn, blk_t bno) {
-    block_allocator_->Free(txn, bno);
+void Minfs::BlockFree(WritebackWork* wb, blk_t bno) {
+    block_allocator_->Free(wb, bno);
+#ifdef __Fuchsia__
+    writeback_->FreeBlocks(wb, Info().dat_block + bno, 1);
+#endif
 }
 
 void InitializeDirectory(void* bdata, ino_t ino_self, ino_t ino_parent) {
@@ -770,8 +891,15 @@ zx_status_t Minfs::Create(fbl::unique_ptr<Bcache> bc, const Superblock* info,
         return status;
     }
 
+    fbl::unique_ptr<Journal> journal;
+    if ((status = Journal::Create(bc.get(), sb->Info(), &journal)) != ZX_OK) {
+        FS_TRACE_ERROR("Minfs::Create failed to initialize journal: %d\n", status);
+        return status;
+    }
+
     fbl::unique_ptr<WritebackBuffer> writeback;
-    status = WritebackBuffer::Create(bc.get(), fbl::move(mapper), &writeback);
+    status = WritebackBuffer::Create(bc.get(), fbl::move(mapper), fbl::move(journal),
+                                     &writeback);
     if (status != ZX_OK) {
         return status;
     }
@@ -853,7 +981,11 @@ zx_status_t Mount(fbl::unique_ptr<minfs::Bcache> bc, fbl::RefPtr<VnodeMinfs>* ro
         FS_TRACE_ERROR("minfs: could not read info block\n");
         return status;
     }
-    const Superblock* info = reinterpret_cast<Superblock*>(blk);
+    Superblock* info = reinterpret_cast<Superblock*>(blk);
+    if ((status = ReplayJournal(bc.get(), info)) != ZX_OK) {
+        FS_TRACE_ERROR("minfs: could not replay journal: %d\n", status);
+        return status;
+    }
 
     fbl::unique_ptr<Minfs> fs;
     if ((status = Minfs::Create(fbl::move(bc), info, &fs)) != ZX_OK) {
@@ -887,6 +1019,9 @@ zx_status_t MountAndServe(const MountOptions* options, async_dispatcher_t* dispa
 
     Minfs* vfs = vn->fs_;
     vfs->SetReadonly(options->readonly);
+    if (options->trim && !options->readonly) {
+        vfs->TrimFreeBlocks();
+    }
     vfs->SetMetrics(options->metrics);
     vfs->SetUnmountCallback(fbl::move(on_unmount));
     vfs->SetDispatcher(dispatcher);
@@ -1027,6 +1162,15 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
         info.dat_block = kFVMBlockDataStart;
     }
 
+    // The journal follows the root directory's block, if the volume has room
+    // for it.
+    uint32_t journal_blocks = fbl::min(kMinfsDefaultJournalBlocks, info.block_count / 8);
+    journal_blocks -= journal_blocks % kMinfsJournalSlots;
+    if (journal_blocks / kMinfsJournalSlots >= kMinfsJournalMinSlotBlocks) {
+        info.journal_block = 2;
+        info.journal_block_count = journal_blocks;
+    }
+
     DumpInfo(&info);
 
     RawBitmap abm;
@@ -1072,6 +1216,20 @@ zx_status_t Mkfs(const MountOptions& options, fbl::unique_ptr<Bcache> bc) {
     abm.Set(0, 2);
     info.alloc_block_count += 2;
 
+    // Reserve the journal, and leave it empty.
+    if (info.journal_block_count > 0) {
+        abm.Set(info.journal_block, info.journal_block + info.journal_block_count);
+        info.alloc_block_count += info.journal_block_count;
+        memset(blk, 0, sizeof(blk));
+        for (uint32_t n = 0; n < kMinfsJournalSlots; n++) {
+            blk_t slot = info.journal_block + n * (info.journal_block_count / kMinfsJournalSlots);
+            if ((status = bc->Writeblk(info.dat_block + slot, blk)) != ZX_OK) {
+                FS_TRACE_ERROR("mkfs: Failed to clear journal\n");
+                return status;
+            }
+        }
+    }
+
     // write allocation bitmap
     for (uint32_t n = 0; n < abmblks; n++) {
         void* bmdata = fs::GetBlock(kMinfsBlockSize, abm.StorageUnsafe()->GetData(), n);
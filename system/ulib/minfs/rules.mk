@@ -15,6 +15,7 @@ COMMON_SRCS := \
     $(LOCAL_DIR)/bcache.cpp \
     $(LOCAL_DIR)/fsck.cpp \
     $(LOCAL_DIR)/inode-manager.cpp \
+    $(LOCAL_DIR)/journal.cpp \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/superblock.cpp \
     $(LOCAL_DIR)/vnode.cpp \
@@ -41,6 +42,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/zircon-internal \
     system/ulib/zx \
     system/ulib/zxcpp \
+    third_party/ulib/cksum \
 
 MODULE_LIBS := \
     system/ulib/async.default \
@@ -69,6 +71,7 @@ MODULE_HOST_COMPILEFLAGS := \
     -Isystem/ulib/fs/include \
     -Isystem/ulib/fzl/include \
     -Isystem/ulib/zxcpp/include \
+    -Ithird_party/ulib/cksum/include \
 
 # host minfs lib
 
@@ -85,5 +88,6 @@ MODULE_HEADER_DEPS += system/ulib/zircon-internal
 MODULE_HOST_LIBS := \
     system/ulib/fbl.hostlib \
     system/ulib/fs.hostlib \
+    third_party/ulib/cksum.hostlib \
 
 include make/module.mk
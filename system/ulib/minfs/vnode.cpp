@@ -50,13 +50,15 @@ zx_time_t GetTimeUTC() {
     return time;
 }
 
-zx_status_t ValidateDirent(Dirent* de, size_t bytes_read, size_t off) {
+// |limit| is the offset the dirent may not extend past; see VnodeMinfs::DirentLimit.
+zx_status_t ValidateDirent(Dirent* de, size_t bytes_read, size_t off,
+                           size_t limit = kMinfsMaxDirectorySize) {
     uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, off));
     if ((bytes_read < MINFS_DIRENT_SIZE) || (reclen < MINFS_DIRENT_SIZE)) {
         FS_TRACE_ERROR("vn_dir: Could not read dirent at offset: %zd\n", off);
         return ZX_ERR_IO;
-    } else if ((off + reclen > kMinfsMaxDirectorySize) || (reclen & 3)) {
-        FS_TRACE_ERROR("vn_dir: bad reclen %u > %u\n", reclen, kMinfsMaxDirectorySize);
+    } else if ((off + reclen > limit) || (reclen & 3)) {
+        FS_TRACE_ERROR("vn_dir: bad reclen %u at %zd > %zd\n", reclen, off, limit);
         return ZX_ERR_IO;
     } else if (de->ino != 0) {
         if ((de->namelen == 0) ||
@@ -75,6 +77,91 @@ zx_status_t NextDirent(Dirent* de, DirectoryOffset* offs) {
     return kDirIteratorNext;
 }
 
+// Calls |func| on each live dirent in the |size| bytes at |data|, which hold a linear directory
+// from its start (with |limit| of kMinfsMaxDirectorySize) or one bucket of a hashed directory
+// (with |limit| of kMinfsBlockSize).
+template <typename Func>
+zx_status_t ForEachBufferedDirent(uint8_t* data, size_t size, size_t limit, Func func) {
+    size_t off = 0;
+    while (off + MINFS_DIRENT_SIZE <= size) {
+        Dirent* de = reinterpret_cast<Dirent*>(data + off);
+        zx_status_t status = ValidateDirent(de, size - off, off, limit);
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (de->ino != 0) {
+            if (DirentSize(de->namelen) > size - off) {
+                FS_TRACE_ERROR("vn_dir: dirent at %zd runs past the end\n", off);
+                return ZX_ERR_IO;
+            }
+            if ((status = func(de)) != ZX_OK) {
+                return status;
+            }
+        }
+        if (de->reclen & kMinfsReclenLast) {
+            break;
+        }
+        off += MinfsReclen(de, off);
+    }
+    return ZX_OK;
+}
+
+uint32_t DirentHash(const Dirent* de) {
+    return MinfsDirHash(de->name, de->namelen);
+}
+
+zx_status_t ValidateDirHashHeader(const DirHashHeader& header, size_t size) {
+    if ((header.magic != kMinfsDirHashMagic) ||
+        (header.global_depth > kMinfsDirHashMaxDepth) ||
+        (header.bucket_count == 0) ||
+        (header.bucket_count > (1u << header.global_depth)) ||
+        (size != MinfsDirHashSize(header.bucket_count))) {
+        FS_TRACE_ERROR("vn_dir: bad hash header (depth %u, %u buckets, size %zu)\n",
+                       header.global_depth, header.bucket_count, size);
+        return ZX_ERR_IO;
+    }
+    return ZX_OK;
+}
+
+// Packs dirents into one bucket of a hashed directory, in memory.
+class BucketBuilder {
+public:
+    // Starts |block| off as an empty bucket.
+    void Reset(uint8_t* block) {
+        block_ = block;
+        used_ = 0;
+        last_ = nullptr;
+        memset(block_, 0, kMinfsBlockSize);
+        reinterpret_cast<Dirent*>(block_)->reclen = kMinfsBlockSize;
+    }
+
+    // Adds a copy of |de|, returning false if the bucket has no room left for it.
+    bool Append(const Dirent* de) {
+        uint32_t size = DirentSize(de->namelen);
+        if (used_ + size > kMinfsBlockSize) {
+            return false;
+        }
+        if (last_ != nullptr) {
+            last_->reclen = DirentSize(last_->namelen);
+        }
+        Dirent* next = reinterpret_cast<Dirent*>(block_ + used_);
+        next->ino = de->ino;
+        // the last dirent takes up the rest of the block
+        next->reclen = kMinfsBlockSize - used_;
+        next->namelen = de->namelen;
+        next->type = de->type;
+        memcpy(next->name, de->name, de->namelen);
+        last_ = next;
+        used_ += size;
+        return true;
+    }
+
+private:
+    uint8_t* block_ = nullptr;
+    uint32_t used_ = 0;
+    Dirent* last_ = nullptr;
+};
+
 #ifdef __Fuchsia__
 
 // MinfsConnection overrides the base Connection class to allow Minfs to
@@ -100,10 +187,16 @@ private:
         return GetVnodeMinfs().ToggleMetrics(enable, txn);
     }
 
+    zx_status_t FailDelayedFlushes(uint32_t count, fidl_txn_t* txn) {
+        return GetVnodeMinfs().FailDelayedFlushes(count, txn);
+    }
+
     static const fuchsia_minfs_Minfs_ops* Ops() {
         static const fuchsia_minfs_Minfs_ops kMinfsOps = {
             .GetMetrics = MinfsConnectionBinder::BindMember<&MinfsConnection::GetMetrics>,
             .ToggleMetrics = MinfsConnectionBinder::BindMember<&MinfsConnection::ToggleMetrics>,
+            .FailDelayedFlushes =
+                MinfsConnectionBinder::BindMember<&MinfsConnection::FailDelayedFlushes>,
         };
         return &kMinfsOps;
     }
@@ -111,7 +204,7 @@ private:
     zx_status_t HandleFsSpecificMessage(fidl_msg_t* msg, fidl_txn_t* txn) final {
         fidl_message_header_t* hdr = reinterpret_cast<fidl_message_header_t*>(msg->bytes);
         if (hdr->ordinal >= fuchsia_minfs_MinfsGetMetricsOrdinal &&
-            hdr->ordinal <= fuchsia_minfs_MinfsToggleMetricsOrdinal) {
+            hdr->ordinal <= fuchsia_minfs_MinfsFailDelayedFlushesOrdinal) {
             return fuchsia_minfs_Minfs_dispatch(this, txn, msg, Ops());
         }
         zx_handle_close_many(msg->handles, msg->num_handles);
@@ -141,6 +234,17 @@ void VnodeMinfs::InodeSync(WritebackWork* wb, uint32_t flags) {
         }
     }
 
+#ifdef __Fuchsia__
+    if (delayed_end_ != 0) {
+        // The size on disk must not cover delayed data which isn't there yet.
+        Inode inode = inode_;
+        uint32_t flushed_size = fbl::max(delayed_base_size_,
+                                         static_cast<uint32_t>(delayed_start_ * kMinfsBlockSize));
+        inode.size = fbl::min(inode_.size, flushed_size);
+        fs_->InodeUpdate(wb, ino_, &inode);
+        return;
+    }
+#endif
     fs_->InodeUpdate(wb, ino_, &inode_);
 }
 
@@ -384,7 +488,8 @@ void VnodeMinfs::AllocateIndirect(Transaction* state, blk_t index, IndirectArgs*
 
     // allocate new indirect block
     blk_t bno;
-    fs_->BlockNew(state, &bno);
+    fs_->BlockNew(state, alloc_goal_, &bno);
+    alloc_goal_ = bno + 1;
 
 #ifdef __Fuchsia__
     ClearIndirectVmoBlock(args->GetOffset() + index);
@@ -413,7 +518,8 @@ zx_status_t VnodeMinfs::BlockOpDirect(Transaction* state, DirectArgs* params) {
             case BlockOp::kWrite: {
                 ZX_DEBUG_ASSERT(state != nullptr);
                 if (bno == 0) {
-                    fs_->BlockNew(state, &bno);
+                    fs_->BlockNew(state, alloc_goal_, &bno);
+                    alloc_goal_ = bno + 1;
                     inode_.block_count++;
                 }
 
@@ -787,13 +893,15 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
     // Verify they are free and small enough to merge.
     size_t coalesced_size = MinfsReclen(de, off);
     // Coalesce with "next" first, so the kMinfsReclenLast bit can easily flow
-    // back to "de" and "de_prev".
-    if (!(de->reclen & kMinfsReclenLast)) {
+    // back to "de" and "de_prev". The dirent after the last one of a bucket
+    // belongs to the next bucket.
+    if (!(de->reclen & kMinfsReclenLast) && (off_next < DirentLimit(off))) {
         size_t len = MINFS_DIRENT_SIZE;
         if ((status = ReadExactInternal(&de_next, len, off_next)) != ZX_OK) {
             FS_TRACE_ERROR("unlink: Failed to read next dirent\n");
             return status;
-        } else if ((status = ValidateDirent(&de_next, len, off_next)) != ZX_OK) {
+        } else if ((status = ValidateDirent(&de_next, len, off_next,
+                                            DirentLimit(off_next))) != ZX_OK) {
             FS_TRACE_ERROR("unlink: Read invalid dirent\n");
             return status;
         }
@@ -808,7 +916,8 @@ zx_status_t VnodeMinfs::UnlinkChild(Transaction* state,
         if ((status = ReadExactInternal(&de_prev, len, off_prev)) != ZX_OK) {
             FS_TRACE_ERROR("unlink: Failed to read previous dirent\n");
             return status;
-        } else if ((status = ValidateDirent(&de_prev, len, off_prev)) != ZX_OK) {
+        } else if ((status = ValidateDirent(&de_prev, len, off_prev,
+                                            DirentLimit(off_prev))) != ZX_OK) {
             FS_TRACE_ERROR("unlink: Read invalid dirent\n");
             return status;
         }
@@ -1006,7 +1115,8 @@ zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
     zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, args->offs.off, &r);
     if (status != ZX_OK) {
         return status;
-    } else if ((status = ValidateDirent(de, r, args->offs.off)) != ZX_OK) {
+    } else if ((status = ValidateDirent(de, r, args->offs.off,
+                                        DirentLimit(args->offs.off))) != ZX_OK) {
         return status;
     }
 
@@ -1074,18 +1184,29 @@ zx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
 //  'offs': Offset info about where in the directory this direntry is located.
 //          Since 'func' may create / remove surrounding dirents, it is responsible for
 //          updating the offset information to access the next dirent.
+//
+// In a hashed directory only the bucket that |args->name| hashes to is walked, so every
+// callback must be looking for (or making room for) that name.
 zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func) {
     char data[kMinfsMaxDirentSize];
     Dirent* de = (Dirent*) data;
-    args->offs.off = 0;
-    args->offs.off_prev = 0;
-    while (args->offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+    size_t start = 0;
+    if (IsHashedDirectory()) {
+        zx_status_t status = HashedBucketOffset(args->name, &start);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+    const size_t limit = DirentLimit(start);
+    args->offs.off = start;
+    args->offs.off_prev = start;
+    while (args->offs.off + MINFS_DIRENT_SIZE < limit) {
         xprintf("Reading dirent at offset %zd\n", args->offs.off);
         size_t r;
         zx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, args->offs.off, &r);
         if (status != ZX_OK) {
             return status;
-        } else if ((status = ValidateDirent(de, r, args->offs.off)) != ZX_OK) {
+        } else if ((status = ValidateDirent(de, r, args->offs.off, limit)) != ZX_OK) {
             return status;
         }
 
@@ -1106,6 +1227,262 @@ zx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, const DirentCallback func)
     return ZX_ERR_NOT_FOUND;
 }
 
+size_t VnodeMinfs::DirentLimit(size_t off) const {
+    if (!IsHashedDirectory()) {
+        return kMinfsMaxDirectorySize;
+    }
+    return fbl::round_down(off, kMinfsBlockSize) + kMinfsBlockSize;
+}
+
+zx_status_t VnodeMinfs::HashedBucketOffset(fbl::StringPiece name, size_t* out_off) {
+    DirHashHeader header;
+    zx_status_t status;
+    if ((status = ReadExactInternal(&header, sizeof(header), 0)) != ZX_OK) {
+        return status;
+    } else if ((status = ValidateDirHashHeader(header, inode_.size)) != ZX_OK) {
+        return status;
+    }
+
+    uint32_t index = MinfsDirHash(name.data(), name.length()) &
+                     ((1u << header.global_depth) - 1);
+    uint16_t bucket;
+    if ((status = ReadExactInternal(&bucket, sizeof(bucket),
+                                    offsetof(DirHashBlock, table) +
+                                    index * sizeof(bucket))) != ZX_OK) {
+        return status;
+    } else if (bucket >= header.bucket_count) {
+        FS_TRACE_ERROR("vn_dir: hash table entry %u points at bucket %u of %u\n",
+                       index, bucket, header.bucket_count);
+        return ZX_ERR_IO;
+    }
+    *out_off = MinfsDirHashSize(bucket);
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::FindSpace(DirArgs* args) {
+    zx_status_t status;
+    if (!IsHashedDirectory()) {
+        status = ForEachDirent(args, DirentCallbackFindSpace);
+        if (status == ZX_ERR_NOT_FOUND) {
+            return ZX_ERR_NO_SPACE;
+        } else if (status != ZX_OK) {
+            return status;
+        }
+
+        // Work out where AppendDirent will put the new dirent.
+        Dirent de;
+        if ((status = ReadExactInternal(&de, MINFS_DIRENT_SIZE, args->offs.off)) != ZX_OK) {
+            return status;
+        }
+        size_t end = args->offs.off + args->reclen;
+        if (de.ino != 0) {
+            end += DirentSize(de.namelen);
+        }
+        if (end <= kMinfsDirLinearMaxSize) {
+            return ZX_OK;
+        }
+        if ((status = ConvertToHashed()) != ZX_OK) {
+            return status;
+        }
+    }
+
+    while ((status = ForEachDirent(args, DirentCallbackFindSpace)) == ZX_ERR_NOT_FOUND) {
+        if ((status = SplitBucket(args->name)) != ZX_OK) {
+            return status;
+        }
+    }
+    return status;
+}
+
+zx_status_t VnodeMinfs::ConvertToHashed() {
+    const size_t old_size = inode_.size;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> linear(new (&ac) uint8_t[old_size]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    zx_status_t status;
+    if ((status = ReadExactInternal(linear.get(), old_size, 0)) != ZX_OK) {
+        return status;
+    }
+
+    size_t used = 0;
+    status = ForEachBufferedDirent(linear.get(), old_size, kMinfsMaxDirectorySize,
+                                   [&used](Dirent* de) {
+        used += DirentSize(de->namelen);
+        return ZX_OK;
+    });
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // Start with the buckets half full, and use more of them if the names don't spread out
+    // evenly enough to fit.
+    uint32_t depth = 0;
+    while ((static_cast<size_t>(kMinfsBlockSize) << depth) < 2 * used) {
+        depth++;
+    }
+    fbl::unique_ptr<uint8_t[]> hashed;
+    size_t new_size;
+    for (;; depth++) {
+        if (depth > kMinfsDirHashMaxDepth) {
+            return ZX_ERR_NO_SPACE;
+        }
+        const uint32_t bucket_count = 1u << depth;
+        new_size = MinfsDirHashSize(bucket_count);
+        hashed.reset(new (&ac) uint8_t[new_size]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+        fbl::unique_ptr<BucketBuilder[]> buckets(new (&ac) BucketBuilder[bucket_count]);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+
+        memset(hashed.get(), 0, kMinfsBlockSize);
+        DirHashBlock* hash_block = reinterpret_cast<DirHashBlock*>(hashed.get());
+        hash_block->header.magic = kMinfsDirHashMagic;
+        hash_block->header.global_depth = depth;
+        hash_block->header.bucket_count = bucket_count;
+        for (uint32_t i = 0; i < bucket_count; i++) {
+            hash_block->table[i] = static_cast<uint16_t>(i);
+            hash_block->local_depth[i] = static_cast<uint8_t>(depth);
+            buckets[i].Reset(hashed.get() + MinfsDirHashSize(i));
+        }
+
+        status = ForEachBufferedDirent(linear.get(), old_size, kMinfsMaxDirectorySize,
+                                       [&buckets, bucket_count](Dirent* de) {
+            BucketBuilder* bucket = &buckets[DirentHash(de) & (bucket_count - 1)];
+            return bucket->Append(de) ? ZX_OK : ZX_ERR_NO_SPACE;
+        });
+        if (status == ZX_OK) {
+            break;
+        } else if (status != ZX_ERR_NO_SPACE) {
+            return status;
+        }
+    }
+
+    blk_t reserve_blocks = 0;
+    if ((new_size > old_size) &&
+        (status = GetRequiredBlockCount(old_size, new_size - old_size,
+                                        &reserve_blocks)) != ZX_OK) {
+        return status;
+    }
+    fbl::unique_ptr<Transaction> state;
+    if ((status = fs_->BeginTransaction(0, reserve_blocks, &state)) != ZX_OK) {
+        return status;
+    }
+    if ((new_size < old_size) &&
+        (status = TruncateInternal(state.get(), new_size)) != ZX_OK) {
+        return status;
+    }
+    if ((status = WriteExactInternal(state.get(), hashed.get(), new_size, 0)) != ZX_OK) {
+        return status;
+    }
+
+    inode_.dir_flags |= kMinfsDirFlagHashed;
+    inode_.seq_num++;
+    fs_->UpgradeVersion(state->GetWork());
+    InodeSync(state->GetWork(), kMxFsSyncMtime);
+    state->GetWork()->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+    fs_->CommitTransaction(fbl::move(state));
+    return ZX_OK;
+}
+
+zx_status_t VnodeMinfs::SplitBucket(fbl::StringPiece name) {
+    // The hash block, the bucket as it is, and the two buckets it becomes.
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[4 * kMinfsBlockSize]);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    uint8_t* old_data = data.get() + kMinfsBlockSize;
+    uint8_t* low_data = data.get() + 2 * kMinfsBlockSize;
+    uint8_t* high_data = data.get() + 3 * kMinfsBlockSize;
+
+    zx_status_t status;
+    if ((status = ReadExactInternal(data.get(), kMinfsBlockSize, 0)) != ZX_OK) {
+        return status;
+    }
+    DirHashBlock* hash_block = reinterpret_cast<DirHashBlock*>(data.get());
+    DirHashHeader* header = &hash_block->header;
+    if ((status = ValidateDirHashHeader(*header, inode_.size)) != ZX_OK) {
+        return status;
+    }
+    uint32_t hash = MinfsDirHash(name.data(), name.length());
+    uint32_t bucket = hash_block->table[hash & ((1u << header->global_depth) - 1)];
+    if ((bucket >= header->bucket_count) ||
+        (hash_block->local_depth[bucket] > header->global_depth)) {
+        FS_TRACE_ERROR("vn_dir: bad hash table entry for bucket %u\n", bucket);
+        return ZX_ERR_IO;
+    }
+
+    const uint32_t depth = hash_block->local_depth[bucket];
+    if (depth == header->global_depth) {
+        if (depth == kMinfsDirHashMaxDepth) {
+            return ZX_ERR_NO_SPACE;
+        }
+        // Double the table; the new half points at the same buckets as the old one.
+        const uint32_t entries = 1u << depth;
+        memcpy(&hash_block->table[entries], &hash_block->table[0],
+               entries * sizeof(hash_block->table[0]));
+        header->global_depth++;
+    }
+
+    // Names with hash bit |depth| set move to a new bucket at the end of the directory.
+    const uint32_t sibling = header->bucket_count++;
+    hash_block->local_depth[bucket] = static_cast<uint8_t>(depth + 1);
+    hash_block->local_depth[sibling] = static_cast<uint8_t>(depth + 1);
+    for (uint32_t i = 0; i < (1u << header->global_depth); i++) {
+        if ((hash_block->table[i] == bucket) && (i & (1u << depth))) {
+            hash_block->table[i] = static_cast<uint16_t>(sibling);
+        }
+    }
+
+    if ((status = ReadExactInternal(old_data, kMinfsBlockSize,
+                                    MinfsDirHashSize(bucket))) != ZX_OK) {
+        return status;
+    }
+    BucketBuilder low;
+    BucketBuilder high;
+    low.Reset(low_data);
+    high.Reset(high_data);
+    status = ForEachBufferedDirent(old_data, kMinfsBlockSize, kMinfsBlockSize,
+                                   [&low, &high, depth](Dirent* de) {
+        BucketBuilder* half = (DirentHash(de) & (1u << depth)) ? &high : &low;
+        // Both halves hold less than the bucket did.
+        return half->Append(de) ? ZX_OK : ZX_ERR_IO;
+    });
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    blk_t reserve_blocks;
+    if ((status = GetRequiredBlockCount(inode_.size, kMinfsBlockSize,
+                                        &reserve_blocks)) != ZX_OK) {
+        return status;
+    }
+    fbl::unique_ptr<Transaction> state;
+    if ((status = fs_->BeginTransaction(0, reserve_blocks, &state)) != ZX_OK) {
+        return status;
+    }
+    if ((status = WriteExactInternal(state.get(), data.get(), kMinfsBlockSize, 0)) != ZX_OK) {
+        return status;
+    } else if ((status = WriteExactInternal(state.get(), low_data, kMinfsBlockSize,
+                                            MinfsDirHashSize(bucket))) != ZX_OK) {
+        return status;
+    } else if ((status = WriteExactInternal(state.get(), high_data, kMinfsBlockSize,
+                                            MinfsDirHashSize(sibling))) != ZX_OK) {
+        return status;
+    }
+
+    inode_.seq_num++;
+    InodeSync(state->GetWork(), kMxFsSyncMtime);
+    state->GetWork()->PinVnode(fbl::move(fbl::WrapRefPtr(this)));
+    fs_->CommitTransaction(fbl::move(state));
+    return ZX_OK;
+}
+
 void VnodeMinfs::fbl_recycle() {
     ZX_DEBUG_ASSERT(fd_count_ == 0);
     if (!IsUnlinked()) {
@@ -1187,12 +1564,20 @@ zx_status_t VnodeMinfs::Close() {
     fd_count_--;
 
     if (fd_count_ == 0 && IsUnlinked()) {
+#ifdef __Fuchsia__
+        DiscardDelayedWrite();
+#endif
         fbl::unique_ptr<Transaction> state;
         ZX_ASSERT(fs_->BeginTransaction(0, 0, &state) == ZX_OK);
         fs_->RemoveUnlinked(state->GetWork(), this);
         Purge(state->GetWork());
         fs_->CommitTransaction(fbl::move(state));
     }
+#ifdef __Fuchsia__
+    if (fd_count_ == 0) {
+        return FlushDelayedWrite();
+    }
+#endif
     return ZX_OK;
 }
 
@@ -1290,10 +1675,30 @@ zx_status_t VnodeMinfs::Write(const void* data, size_t len, size_t offset,
         fs_->UpdateWriteMetrics(*out_actual, ticker.End());
     });
 
+    zx_status_t status;
+#ifdef __Fuchsia__
+    auto notify_size = fbl::MakeAutoCall([this, size = inode_.size]() {
+        if (inode_.size != size) {
+            size_watchers_.Notify();
+        }
+    });
+    if (len != 0 && len <= kMinfsDelayedWriteMaxSize) {
+        if ((status = DelayedWrite(data, len, offset)) == ZX_OK) {
+            *out_actual = len;
+            return ZX_OK;
+        } else if (status != ZX_ERR_NOT_SUPPORTED) {
+            return status;
+        }
+    }
+    // Large writes go straight out, after anything delayed that they may overlap.
+    if ((status = FlushDelayedWrite()) != ZX_OK) {
+        return status;
+    }
+#endif
+
     blk_t reserve_blocks;
     // Calculate maximum number of blocks to reserve for this write operation.
-    zx_status_t status = GetRequiredBlockCount(offset, len, &reserve_blocks);
-    if (status != ZX_OK) {
+    if ((status = GetRequiredBlockCount(offset, len, &reserve_blocks)) != ZX_OK) {
         return status;
     }
     fbl::unique_ptr<Transaction> state;
@@ -1320,6 +1725,143 @@ zx_status_t VnodeMinfs::Append(const void* data, size_t len, size_t* out_end,
     return status;
 }
 
+#ifdef __Fuchsia__
+zx_status_t VnodeMinfs::DelayedWrite(const void* data, size_t len, size_t off) {
+    if (off + len > kMinfsMaxFileSize) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    blk_t start = static_cast<blk_t>(off / kMinfsBlockSize);
+    blk_t end = static_cast<blk_t>(fbl::round_up(off + len, kMinfsBlockSize) / kMinfsBlockSize);
+
+    // Only one run of blocks is delayed per vnode, so that it can be allocated in one piece.
+    zx_status_t status;
+    if (delayed_end_ != 0) {
+        bool adjacent = start <= delayed_end_ && end >= delayed_start_;
+        if (!adjacent || fbl::max(end, delayed_end_) - fbl::min(start, delayed_start_) >
+                         kMinfsMaxDelayedBlocks) {
+            if ((status = FlushDelayedWrite()) != ZX_OK) {
+                return status;
+            }
+        }
+    }
+    blk_t new_start = (delayed_end_ == 0) ? start : fbl::min(start, delayed_start_);
+    blk_t new_end = fbl::max(end, delayed_end_);
+
+    // Reserve whatever the grown run may need beyond what the old one did.
+    blk_t required;
+    if ((status = GetRequiredBlockCount(new_start * kMinfsBlockSize,
+                                        (new_end - new_start) * kMinfsBlockSize,
+                                        &required)) != ZX_OK) {
+        return status;
+    }
+    blk_t reserved = 0;
+    if (delayed_end_ != 0 &&
+        (status = GetRequiredBlockCount(delayed_start_ * kMinfsBlockSize,
+                                        (delayed_end_ - delayed_start_) * kMinfsBlockSize,
+                                        &reserved)) != ZX_OK) {
+        return status;
+    }
+    if (required > reserved) {
+        status = fs_->ReserveBlocks(required - reserved, &delayed_promise_);
+        if (status == ZX_ERR_NO_SPACE) {
+            // Delayed writes elsewhere may be holding reservations they don't need.
+            fs_->FlushDelayedWrites();
+            return ZX_ERR_NOT_SUPPORTED;
+        } else if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    if ((status = InitVmo()) != ZX_OK) {
+        return status;
+    }
+    if (off + len > vmo_size_) {
+        size_t new_size = fbl::round_up(off + len, kMinfsBlockSize);
+        ZX_DEBUG_ASSERT(new_size >= inode_.size); // Overflow.
+        if ((status = vmo_.set_size(new_size)) != ZX_OK) {
+            return status;
+        }
+        vmo_size_ = new_size;
+    }
+    if ((status = vmo_.write(data, off, len)) != ZX_OK) {
+        return status;
+    }
+
+    size_t added = (new_end - new_start) - (delayed_end_ - delayed_start_);
+    if (delayed_end_ == 0) {
+        delayed_base_size_ = inode_.size;
+    }
+    delayed_start_ = new_start;
+    delayed_end_ = new_end;
+    if (off + len > inode_.size) {
+        inode_.size = static_cast<uint32_t>(off + len);
+    }
+    inode_.modify_time = GetTimeUTC();
+    ValidateVmoTail();
+
+    return fs_->AddDelayedWrite(this, added);
+}
+
+zx_status_t VnodeMinfs::FlushDelayedWrite() {
+    if (delayed_end_ == 0) {
+        // A failed DelayedWrite may have left a reservation behind.
+        delayed_promise_.reset();
+        return ZX_OK;
+    }
+    // Removing the vnode from the delayed list may drop the last reference to it.
+    fbl::RefPtr<VnodeMinfs> vn = fbl::WrapRefPtr(this);
+
+    fbl::unique_ptr<Transaction> state;
+    zx_status_t status;
+    if ((status = fs_->BeginTransaction(0, 0, &state)) != ZX_OK) {
+        // Nothing has been touched; the run stays delayed.
+        return status;
+    }
+    state->GiveBlockPromise(fbl::move(delayed_promise_));
+
+    // Consecutive blocks are merged into a single request by the WriteTxn.
+    blk_t n;
+    for (n = delayed_start_; n < delayed_end_; n++) {
+        if (n + 1 == delayed_end_ && fs_->TakeDelayedFlushFailure()) {
+            status = ZX_ERR_IO;
+            break;
+        }
+        blk_t bno;
+        if ((status = BlockGet(state.get(), n, &bno)) != ZX_OK) {
+            break;
+        }
+        ZX_DEBUG_ASSERT(bno != 0);
+        state->GetWork()->Enqueue(vmo_.get(), n, bno + fs_->Info().dat_block, 1);
+    }
+
+    // The blocks allocated so far are committed even if the rest failed, since
+    // the block map already points at them. The rest of the run stays delayed,
+    // with what is left of its reservation, and the size written by InodeSync
+    // only covers the part which is on disk.
+    blk_t flushed = n - delayed_start_;
+    if (n == delayed_end_) {
+        delayed_start_ = 0;
+        delayed_end_ = 0;
+    } else {
+        delayed_start_ = n;
+        delayed_promise_ = state->TakeBlockPromise();
+    }
+    fs_->RemoveDelayedWrite(this, flushed);
+    InodeSync(state->GetWork(), kMxFsSyncDefault);
+    state->GetWork()->PinVnode(fbl::move(vn));
+    fs_->CommitTransaction(fbl::move(state));
+    return status;
+}
+
+void VnodeMinfs::DiscardDelayedWrite() {
+    blk_t blocks = delayed_end_ - delayed_start_;
+    delayed_start_ = 0;
+    delayed_end_ = 0;
+    fs_->RemoveDelayedWrite(this, blocks);
+    delayed_promise_.reset();
+}
+#endif
+
 // Internal write. Usable on directories.
 zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
                                       size_t len, size_t off, size_t* actual) {
@@ -1335,6 +1877,20 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
     }
 #else
     size_t max_size = off + len;
+    // Whole blocks are written in runs which are contiguous on disk, with one
+    // write to the device for each run.
+    const void* run_data = nullptr;
+    blk_t run_start = 0;
+    blk_t run_count = 0;
+    auto write_run = [this, &run_data, &run_start, &run_count]() -> zx_status_t {
+        zx_status_t write_status = ZX_OK;
+        if (run_count != 0) {
+            write_status = fs_->bc_->Writeblks(run_start + fs_->Info().dat_block, run_data,
+                                               run_count);
+        }
+        run_count = 0;
+        return write_status;
+    };
 #endif
     const void* const start = data;
     uint32_t n = static_cast<uint32_t>(off / kMinfsBlockSize);
@@ -1377,16 +1933,34 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
             goto done;
         }
         ZX_DEBUG_ASSERT(bno != 0);
-        char wdata[kMinfsBlockSize];
-        if (fs_->bc_->Readblk(bno + fs_->Info().dat_block, wdata)) {
-            goto done;
-        }
-        memcpy(wdata + adjust, data, xfer);
-        if (len < kMinfsBlockSize && max_size >= inode_.size) {
-            memset(wdata + adjust + xfer, 0, kMinfsBlockSize - (adjust + xfer));
-        }
-        if (fs_->bc_->Writeblk(bno + fs_->Info().dat_block, wdata)) {
-            goto done;
+        if (xfer == kMinfsBlockSize) {
+            // A whole block replaces what was there, so it need not be read.
+            if (run_count == 0 || bno != run_start + run_count) {
+                const void* next_run_data = data;
+                if (write_run() != ZX_OK) {
+                    data = run_data;
+                    goto done;
+                }
+                run_data = next_run_data;
+                run_start = bno;
+            }
+            run_count++;
+        } else {
+            if (write_run() != ZX_OK) {
+                data = run_data;
+                goto done;
+            }
+            char wdata[kMinfsBlockSize];
+            if (fs_->bc_->Readblk(bno + fs_->Info().dat_block, wdata)) {
+                goto done;
+            }
+            memcpy(wdata + adjust, data, xfer);
+            if (len < kMinfsBlockSize && max_size >= inode_.size) {
+                memset(wdata + adjust + xfer, 0, kMinfsBlockSize - (adjust + xfer));
+            }
+            if (fs_->bc_->Writeblk(bno + fs_->Info().dat_block, wdata)) {
+                goto done;
+            }
         }
 #endif
 
@@ -1397,6 +1971,12 @@ zx_status_t VnodeMinfs::WriteInternal(Transaction* state, const void* data,
     }
 
 done:
+#ifndef __Fuchsia__
+    // None of a run which cannot be written counts as written.
+    if (run_count != 0 && write_run() != ZX_OK) {
+        data = run_data;
+    }
+#endif
     len = (uintptr_t)data - (uintptr_t)start;
     if (len == 0) {
         // If more than zero bytes were requested, but zero bytes were written,
@@ -1509,7 +2089,10 @@ zx_status_t VnodeMinfs::Readdir(fs::vdircookie_t* cookie, void* dirents, size_t
         return ZX_ERR_NOT_SUPPORTED;
     }
 
-    size_t off = dc->off;
+    // A hashed directory is read bucket by bucket, skipping the hash block.
+    const bool hashed = IsHashedDirectory();
+    const size_t dir_end = hashed ? static_cast<size_t>(inode_.size) : kMinfsMaxDirectorySize;
+    size_t off = hashed ? fbl::min(dc->off, dir_end) : dc->off;
     size_t r;
     char data[kMinfsMaxDirentSize];
     Dirent* de = (Dirent*) data;
@@ -1519,14 +2102,15 @@ zx_status_t VnodeMinfs::Readdir(fs::vdircookie_t* cookie, void* dirents, size_t
         // has been modified. In this case, we need to re-read the directory
         // until we get to the direntry at or after the previously identified offset.
 
-        size_t off_recovered = 0;
+        size_t off_recovered = hashed ? fbl::round_down(off, kMinfsBlockSize) : 0;
         while (off_recovered < off) {
-            if (off_recovered + MINFS_DIRENT_SIZE >= kMinfsMaxDirectorySize) {
+            if (off_recovered + MINFS_DIRENT_SIZE >= dir_end) {
                 FS_TRACE_ERROR("minfs: Readdir: Corrupt dirent; dirent reclen too large\n");
                 goto fail;
             }
             zx_status_t status = ReadInternal(de, kMinfsMaxDirentSize, off_recovered, &r);
-            if ((status != ZX_OK) || (ValidateDirent(de, r, off_recovered) != ZX_OK)) {
+            if ((status != ZX_OK) ||
+                (ValidateDirent(de, r, off_recovered, DirentLimit(off_recovered)) != ZX_OK)) {
                 FS_TRACE_ERROR("minfs: Readdir: Corrupt dirent unreadable/failed validation\n");
                 goto fail;
             }
@@ -1534,13 +2118,16 @@ zx_status_t VnodeMinfs::Readdir(fs::vdircookie_t* cookie, void* dirents, size_t
         }
         off = off_recovered;
     }
+    if (hashed && off < kMinfsBlockSize) {
+        off = kMinfsBlockSize;
+    }
 
-    while (off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
+    while (off + MINFS_DIRENT_SIZE < dir_end) {
         zx_status_t status = ReadInternal(de, kMinfsMaxDirentSize, off, &r);
         if (status != ZX_OK) {
             FS_TRACE_ERROR("minfs: Readdir: Unreadable dirent\n");
             goto fail;
-        } else if (ValidateDirent(de, r, off) != ZX_OK) {
+        } else if (ValidateDirent(de, r, off, DirentLimit(off)) != ZX_OK) {
             FS_TRACE_ERROR("minfs: Readdir: Corrupt dirent failed validation\n");
             goto fail;
         }
@@ -1638,10 +2225,7 @@ zx_status_t VnodeMinfs::Create(fbl::RefPtr<fs::Vnode>* out, fbl::StringPiece nam
     // before updating any other metadata.
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
-    if (status == ZX_ERR_NOT_FOUND) {
-        return ZX_ERR_NO_SPACE;
-    } else if (status != ZX_OK) {
+    if ((status = FindSpace(&args)) != ZX_OK) {
         return status;
     }
 
@@ -1704,6 +2288,9 @@ constexpr const char kFsName[] = "minfs";
 zx_status_t VnodeMinfs::QueryFilesystem(fuchsia_io_FilesystemInfo* info) {
     static_assert(fbl::constexpr_strlen(kFsName) + 1 < fuchsia_io_MAX_FS_NAME_BUFFER,
                   "Minfs name too long");
+    // Allocate any delayed data, so that the block counts are exact.
+    fs_->FlushDelayedWrites();
+
     memset(info, 0, sizeof(*info));
     info->block_size = kMinfsBlockSize;
     info->max_filename_size = kMinfsMaxNameSize;
@@ -1739,6 +2326,11 @@ zx_status_t VnodeMinfs::ToggleMetrics(bool enable, fidl_txn_t* txn) {
     return fuchsia_minfs_MinfsToggleMetrics_reply(txn, ZX_OK);
 }
 
+zx_status_t VnodeMinfs::FailDelayedFlushes(uint32_t count, fidl_txn_t* txn) {
+    fs_->FailDelayedFlushes(count);
+    return fuchsia_minfs_MinfsFailDelayedFlushes_reply(txn, ZX_OK);
+}
+
 #endif
 
 zx_status_t VnodeMinfs::Unlink(fbl::StringPiece name, bool must_be_dir) {
@@ -1780,10 +2372,21 @@ zx_status_t VnodeMinfs::Truncate(size_t len) {
         fs_->UpdateTruncateMetrics(ticker.End());
     });
 
+    zx_status_t status;
+#ifdef __Fuchsia__
+    if ((status = FlushDelayedWrite()) != ZX_OK) {
+        return status;
+    }
+    auto notify_size = fbl::MakeAutoCall([this, size = inode_.size]() {
+        if (inode_.size != size) {
+            size_watchers_.Notify();
+        }
+    });
+#endif
     fbl::unique_ptr<Transaction> state;
     // Since we will only edit existing blocks, no new blocks are required.
     ZX_ASSERT(fs_->BeginTransaction(0, 0, &state) == ZX_OK);
-    zx_status_t status = TruncateInternal(state.get(), len);
+    status = TruncateInternal(state.get(), len);
     if (status == ZX_OK) {
         // Successful truncates update inode
         InodeSync(state->GetWork(), kMxFsSyncMtime);
@@ -1950,11 +2553,9 @@ zx_status_t VnodeMinfs::Rename(fbl::RefPtr<fs::Vnode> _newdir, fbl::StringPiece
     // before updating any other metadata.
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newname.length())));
-
-    status = newdir->ForEachDirent(&args, DirentCallbackFindSpace);
-    if (status == ZX_ERR_NOT_FOUND) {
-        return ZX_ERR_NO_SPACE;
-    } else if (status != ZX_OK) {
+    // A hashed directory looks for room in the bucket of the name being added.
+    args.name = newname;
+    if ((status = newdir->FindSpace(&args)) != ZX_OK) {
         return status;
     }
 
@@ -2047,10 +2648,7 @@ zx_status_t VnodeMinfs::Link(fbl::StringPiece name, fbl::RefPtr<fs::Vnode> _targ
     // before updating any other metadata.
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(name.length())));
-    status = ForEachDirent(&args, DirentCallbackFindSpace);
-    if (status == ZX_ERR_NOT_FOUND) {
-        return ZX_ERR_NO_SPACE;
-    } else if (status != ZX_OK) {
+    if ((status = FindSpace(&args)) != ZX_OK) {
         return status;
     }
 
@@ -2092,17 +2690,35 @@ zx_status_t VnodeMinfs::GetHandles(uint32_t flags, zx_handle_t* hnd, uint32_t* t
     return ZX_OK;
 }
 
+zx_status_t VnodeMinfs::GetBuffer(zx::vmo* out_vmo, size_t* out_size,
+                                  zx::eventpair* out_size_changed) {
+    if (IsDirectory()) {
+        return ZX_ERR_NOT_FILE;
+    }
+    // Writes land in |vmo_| before they are written back, and truncation
+    // only resizes it, so once loaded it always holds the file's contents.
+    zx_status_t status;
+    if ((status = InitVmo()) != ZX_OK) {
+        return status;
+    }
+    zx::eventpair size_changed;
+    if ((status = size_watchers_.Watch(&size_changed)) != ZX_OK) {
+        return status;
+    }
+    if ((status = vmo_.duplicate(ZX_RIGHTS_BASIC | ZX_RIGHT_READ | ZX_RIGHT_MAP,
+                                 out_vmo)) != ZX_OK) {
+        return status;
+    }
+    *out_size = inode_.size;
+    *out_size_changed = fbl::move(size_changed);
+    return ZX_OK;
+}
+
 void VnodeMinfs::Sync(SyncCallback closure) {
     TRACE_DURATION("minfs", "VnodeMinfs::Sync");
-    fs_->Sync([this, cb = fbl::move(closure)](zx_status_t status) {
-        if (status != ZX_OK) {
-            cb(status);
-            return;
-        }
-        status = fs_->bc_->Sync();
-        cb(status);
-    });
-    return;
+    // The writeback thread flushes the device before signalling |closure|,
+    // once for all the syncs it finds queued together.
+    fs_->Sync(fbl::move(closure));
 }
 
 zx_status_t VnodeMinfs::AttachRemote(fs::MountChannel h) {
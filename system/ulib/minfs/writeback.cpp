@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <inttypes.h>
+#include <stdlib.h>
 
 #ifdef __Fuchsia__
 #include <fbl/auto_lock.h>
@@ -20,71 +21,38 @@
 #include <fbl/unique_ptr.h>
 #include <fs/block-txn.h>
 #include <fs/vfs.h>
+#ifdef __Fuchsia__
+#include <fs/writeback.h>
+#endif
 
 #include "minfs-private.h"
+#include <minfs/journal.h>
 #include <minfs/writeback.h>
 
 namespace minfs {
 
 #ifdef __Fuchsia__
+namespace {
 
-void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
-                       uint64_t nblocks) {
-    ValidateVmoSize(vmo, static_cast<blk_t>(vmo_offset));
-    for (size_t i = 0; i < requests_.size(); i++) {
-        if (requests_[i].vmo != vmo) {
-            continue;
-        }
+// Once this many runs of freed blocks are waiting for earlier writes to be
+// flushed, the device is flushed so that they can be trimmed.
+constexpr size_t kMaxUnflushedTrims = 1024;
 
-        if (requests_[i].vmo_offset == vmo_offset) {
-            // Take the longer of the operations (if operating on the same
-            // blocks).
-            requests_[i].length = (requests_[i].length > nblocks) ? requests_[i].length : nblocks;
-            return;
-        } else if ((requests_[i].vmo_offset + requests_[i].length == vmo_offset) &&
-                   (requests_[i].dev_offset + requests_[i].length == dev_offset)) {
-            // Combine with the previous request, if immediately following.
-            requests_[i].length += nblocks;
-            return;
-        }
+int ComparePendingTrims(const void* a, const void* b) {
+    auto lhs = static_cast<const PendingTrim*>(a);
+    auto rhs = static_cast<const PendingTrim*>(b);
+    if (lhs->start != rhs->start) {
+        return lhs->start < rhs->start ? -1 : 1;
     }
-
-    WriteRequest request;
-    request.vmo = vmo;
-    // NOTE: It's easier to compare everything when dealing
-    // with blocks (not offsets!) so the following are described in
-    // terms of blocks until we Flush().
-    request.vmo_offset = vmo_offset;
-    request.dev_offset = dev_offset;
-    request.length = nblocks;
-    requests_.push_back(fbl::move(request));
+    return 0;
 }
 
-zx_status_t WriteTxn::Flush(zx_handle_t vmo, vmoid_t vmoid) {
-    ZX_DEBUG_ASSERT(vmo != ZX_HANDLE_INVALID);
-    ZX_DEBUG_ASSERT(vmoid != VMOID_INVALID);
-
-    // Update all the outgoing transactions to be in "disk blocks",
-    // not "Minfs blocks".
-    block_fifo_request_t blk_reqs[requests_.size()];
-    const uint32_t kDiskBlocksPerMinfsBlock = kMinfsBlockSize / bc_->DeviceBlockSize();
-    for (size_t i = 0; i < requests_.size(); i++) {
-        blk_reqs[i].group = bc_->BlockGroupID();
-        blk_reqs[i].vmoid = vmoid;
-        blk_reqs[i].opcode = BLOCKIO_WRITE;
-        blk_reqs[i].vmo_offset = requests_[i].vmo_offset * kDiskBlocksPerMinfsBlock;
-        blk_reqs[i].dev_offset = requests_[i].dev_offset * kDiskBlocksPerMinfsBlock;
-        // TODO(ZX-2253): Remove this assertion.
-        uint64_t length = requests_[i].length * kDiskBlocksPerMinfsBlock;
-        ZX_ASSERT_MSG(length < UINT32_MAX, "Too many blocks");
-        blk_reqs[i].length = static_cast<uint32_t>(length);
-    }
+} // namespace
 
-    // Actually send the operations to the underlying block device.
-    zx_status_t status = bc_->Transaction(blk_reqs, requests_.size());
-
-    requests_.reset();
-    return status;
+void WriteTxn::Enqueue(zx_handle_t vmo, uint64_t vmo_offset, uint64_t dev_offset,
+                       uint64_t nblocks) {
+    ValidateVmoSize(vmo, static_cast<blk_t>(vmo_offset));
+    fs::EnqueueWriteRequest(&requests_, vmo, vmo_offset, dev_offset, nblocks);
 }
 
 size_t WriteTxn::BlkCount() const {
@@ -95,6 +63,46 @@ size_t WriteTxn::BlkCount() const {
     return blocks_needed;
 }
 
+#else
+
+WriteTxn::~WriteTxn() {
+    Transact();
+}
+
+void WriteTxn::Enqueue(const void* data, uint64_t data_offset, uint64_t dev_offset,
+                       uint64_t nblocks) {
+    for (uint64_t b = 0; b < nblocks; b++) {
+        const void* block = fs::GetBlock(kMinfsBlockSize, data, data_offset + b);
+        blk_t bno = static_cast<blk_t>(dev_offset + b);
+
+        // Blocks rewritten by a transaction are most often the ones it wrote last.
+        PendingBlock* pending = nullptr;
+        for (size_t i = blocks_.size(); i > 0; i--) {
+            if (blocks_[i - 1].bno == bno) {
+                pending = &blocks_[i - 1];
+                break;
+            }
+        }
+        if (pending == nullptr) {
+            blocks_.push_back({bno, fbl::unique_ptr<uint8_t[]>(new uint8_t[kMinfsBlockSize])});
+            pending = &blocks_[blocks_.size() - 1];
+        }
+        memcpy(pending->data.get(), block, kMinfsBlockSize);
+    }
+}
+
+zx_status_t WriteTxn::Transact() {
+    zx_status_t status = ZX_OK;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        zx_status_t write_status = bc_->Writeblk(blocks_[i].bno, blocks_[i].data.get());
+        if (write_status != ZX_OK) {
+            status = write_status;
+        }
+    }
+    blocks_.reset();
+    return status;
+}
+
 #endif  // __Fuchsia__
 
 WritebackWork::WritebackWork(Bcache* bc) : WriteTxn(bc),
@@ -107,6 +115,7 @@ void WritebackWork::Reset() {
 #ifdef __Fuchsia__
     ZX_DEBUG_ASSERT(Requests().size() == 0);
     closure_ = nullptr;
+    trim_seq_ = 0;
 #endif
     while (0 < node_count_) {
         vn_[--node_count_] = nullptr;
@@ -114,22 +123,19 @@ void WritebackWork::Reset() {
 }
 
 #ifdef __Fuchsia__
-// Returns the number of blocks of the writeback buffer that have been
-// consumed
-size_t WritebackWork::Complete(zx_handle_t vmo, vmoid_t vmoid) {
-    size_t blk_count = BlkCount();
-    zx_status_t status = Flush(vmo, vmoid);
+void WritebackWork::Finish(zx_status_t status) {
+    ClearRequests();
     if (closure_) {
         closure_(status);
     }
     Reset();
-    return blk_count;
 }
 
 void WritebackWork::SetClosure(SyncCallback closure) {
     ZX_DEBUG_ASSERT(!closure_);
     closure_ = fbl::move(closure);
 }
+
 #else
 void WritebackWork::Complete() {
     Transact();
@@ -153,8 +159,10 @@ void WritebackWork::PinVnode(fbl::RefPtr<VnodeMinfs> vn) {
 #ifdef __Fuchsia__
 
 zx_status_t WritebackBuffer::Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                                    fbl::unique_ptr<Journal> journal,
                                     fbl::unique_ptr<WritebackBuffer>* out) {
-    fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, fbl::move(mapper)));
+    fbl::unique_ptr<WritebackBuffer> wb(new WritebackBuffer(bc, fbl::move(mapper),
+                                                            fbl::move(journal)));
     if (wb->mapper_.size() % kMinfsBlockSize != 0) {
         return ZX_ERR_INVALID_ARGS;
     } else if (cnd_init(&wb->consumer_cvar_) != thrd_success) {
@@ -170,13 +178,18 @@ zx_status_t WritebackBuffer::Create(Bcache* bc, fzl::OwnedVmoMapper mapper,
     if (status != ZX_OK) {
         return status;
     }
+    {
+        fbl::AutoLock lock(&wb->trim_lock_);
+        wb->trim_enabled_ = wb->bc_->SupportsTrim();
+    }
 
     *out = fbl::move(wb);
     return ZX_OK;
 }
 
-WritebackBuffer::WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper) :
-    bc_(bc), unmounting_(false), mapper_(fbl::move(mapper)),
+WritebackBuffer::WritebackBuffer(Bcache* bc, fzl::OwnedVmoMapper mapper,
+                                 fbl::unique_ptr<Journal> journal) :
+    bc_(bc), journal_(fbl::move(journal)), unmounting_(false), mapper_(fbl::move(mapper)),
     cap_(mapper_.size() / kMinfsBlockSize) {}
 
 WritebackBuffer::~WritebackBuffer() {
@@ -189,6 +202,12 @@ WritebackBuffer::~WritebackBuffer() {
     int r;
     thrd_join(writeback_thrd_, &r);
 
+    // Leave nothing to replay over whatever is written next, perhaps by a
+    // host tool which doesn't journal.
+    if (journal_ != nullptr) {
+        journal_->Invalidate();
+    }
+
     if (buffer_vmoid_ != VMOID_INVALID) {
         block_fifo_request_t request;
         request.group = bc_->BlockGroupID();
@@ -310,29 +329,267 @@ void WritebackBuffer::Enqueue(fbl::unique_ptr<WritebackWork> work) {
     cnd_signal(&consumer_cvar_);
 }
 
+void WritebackBuffer::FreeBlocks(WritebackWork* work, blk_t start, blk_t count) {
+    fbl::AutoLock lock(&trim_lock_);
+    if (!trim_enabled_) {
+        return;
+    }
+    if (work->TrimSeq() == 0) {
+        work->SetTrimSeq(++trim_seq_);
+    }
+
+    // Only the gaps between the blocks already waiting to be trimmed are
+    // added, so that the runs never overlap.
+    fbl::Vector<PendingTrim> gaps;
+    const size_t end = start + count;
+    size_t next = start;
+    for (const auto& elem : trim_pending_) {
+        if (elem.bitoff >= end) {
+            break;
+        }
+        if (elem.bitoff > next) {
+            gaps.push_back({static_cast<blk_t>(next), static_cast<blk_t>(elem.bitoff - next),
+                            work->TrimSeq()});
+        }
+        next = fbl::max(next, elem.end());
+    }
+    if (next < end) {
+        gaps.push_back({static_cast<blk_t>(next), static_cast<blk_t>(end - next),
+                        work->TrimSeq()});
+    }
+    for (const PendingTrim& gap : gaps) {
+        if (trim_pending_.Set(gap.start, gap.start + gap.count) != ZX_OK) {
+            DisableTrimLocked();
+            return;
+        }
+        pending_trims_.push_back(gap);
+    }
+}
+
+void WritebackBuffer::AllocateBlock(blk_t bno) {
+    fbl::AutoLock lock(&trim_lock_);
+    if (!trim_enabled_ || !trim_pending_.Get(bno, bno + 1)) {
+        return;
+    }
+
+    // Cut the block out of the run holding it, so that only a later free of
+    // it can have it trimmed.
+    for (size_t i = 0; i < pending_trims_.size(); i++) {
+        PendingTrim& trim = pending_trims_[i];
+        if (bno < trim.start || bno - trim.start >= trim.count) {
+            continue;
+        }
+        const PendingTrim tail = {bno + 1, trim.start + trim.count - bno - 1, trim.seq};
+        trim.count = bno - trim.start;
+        if (trim.count == 0) {
+            pending_trims_.erase(i);
+        }
+        if (tail.count > 0) {
+            pending_trims_.push_back(tail);
+        }
+        break;
+    }
+    if (trim_pending_.Clear(bno, bno + 1) != ZX_OK) {
+        // A block which may still be trimmed must not be written.
+        DisableTrimLocked();
+    }
+}
+
+void WritebackBuffer::DisableTrimLocked() {
+    FS_TRACE_WARN("minfs: no longer trimming freed blocks\n");
+    trim_enabled_ = false;
+    pending_trims_.reset();
+    trim_pending_.ClearAll();
+}
+
+size_t WritebackBuffer::CompleteTrims(const WorkBatch& batch, zx_status_t status) {
+    fbl::AutoLock lock(&trim_lock_);
+    size_t durable = 0;
+    for (size_t i = 0; i < pending_trims_.size();) {
+        PendingTrim& trim = pending_trims_[i];
+        bool completed = false;
+        for (size_t j = 0; trim.seq != 0 && j < batch.size(); j++) {
+            completed |= (batch[j]->TrimSeq() == trim.seq);
+        }
+        if (completed && status != ZX_OK) {
+            // The frees may not have reached the disk, so their blocks are
+            // left alone.
+            if (trim_pending_.Clear(trim.start, trim.start + trim.count) != ZX_OK) {
+                DisableTrimLocked();
+                return 0;
+            }
+            pending_trims_.erase(i);
+            continue;
+        }
+        if (completed) {
+            trim.seq = 0;
+        }
+        if (trim.seq == 0) {
+            durable++;
+        }
+        i++;
+    }
+    return durable;
+}
+
+void WritebackBuffer::TrimFreedBlocks() {
+    TRACE_DURATION("minfs", "WritebackBuffer::TrimFreedBlocks");
+    fbl::Vector<PendingTrim> trims;
+    {
+        fbl::AutoLock lock(&trim_lock_);
+        for (size_t i = 0; i < pending_trims_.size();) {
+            if (pending_trims_[i].seq != 0) {
+                i++;
+                continue;
+            }
+            PendingTrim trim = pending_trims_.erase(i);
+            if (trim_pending_.Clear(trim.start, trim.start + trim.count) != ZX_OK) {
+                DisableTrimLocked();
+                return;
+            }
+            trims.push_back(trim);
+        }
+    }
+    if (trims.is_empty()) {
+        return;
+    }
+    qsort(trims.get(), trims.size(), sizeof(PendingTrim), ComparePendingTrims);
+
+    // Blocks allocated from here on are written after the trims complete.
+    const uint64_t factor = kMinfsBlockSize / bc_->DeviceBlockSize();
+    const uint64_t max_length = UINT32_MAX / factor;
+    const groupid_t group = bc_->BlockGroupID();
+    fbl::Vector<block_fifo_request_t> requests;
+    for (const PendingTrim& trim : trims) {
+        if (!requests.is_empty()) {
+            block_fifo_request_t& last = requests[requests.size() - 1];
+            if (last.dev_offset + last.length == trim.start &&
+                last.length + trim.count <= max_length) {
+                last.length += trim.count;
+                continue;
+            }
+        }
+        for (uint64_t done = 0; done < trim.count;) {
+            const uint64_t length = fbl::min(trim.count - done, max_length);
+            block_fifo_request_t request = {};
+            request.opcode = BLOCKIO_TRIM;
+            request.group = group;
+            request.dev_offset = trim.start + done;
+            request.length = static_cast<uint32_t>(length);
+            requests.push_back(request);
+            done += length;
+        }
+    }
+    // Convert 'filesystem block' units to 'disk block' units.
+    for (auto& request : requests) {
+        request.dev_offset *= factor;
+        request.length = static_cast<uint32_t>(request.length * factor);
+    }
+    zx_status_t status = bc_->Transaction(requests.get(), requests.size());
+    if (status != ZX_OK) {
+        // Trimming is only advice to the device, so failing to is harmless.
+        FS_TRACE_WARN("minfs: failed to trim freed blocks: %d\n", status);
+        if (status == ZX_ERR_NOT_SUPPORTED) {
+            fbl::AutoLock lock(&trim_lock_);
+            DisableTrimLocked();
+        }
+    }
+}
+
+void WritebackBuffer::CompleteBatch(WorkBatch* batch, size_t blocks) {
+    zx_status_t status = ZX_OK;
+    bool journaled = false;
+    if (journal_ != nullptr && blocks > 0) {
+        if (blocks <= journal_->Capacity()) {
+            status = journal_->Commit(batch->get(), batch->size(), mapper_.start(),
+                                      buffer_vmoid_);
+            journaled = (status == ZX_OK);
+        } else {
+            // Too large for an entry: write it in place, as without a journal.
+            status = journal_->Invalidate();
+        }
+    }
+
+    // The journal entry makes the in-place writes replayable together, so
+    // they may reach the disk in any order. Without it, keep each work
+    // ordered after the one before it.
+    fs::WriteBatch writes(bc_);
+    bool has_closure = false;
+    for (size_t i = 0; i < batch->size(); i++) {
+        // TODO(smklein): We could add additional validation that the blocks
+        // in "work" are contiguous and in the range of [start_, len_) (including
+        // wraparound).
+        auto& reqs = (*batch)[i]->Requests();
+        writes.Add(buffer_vmoid_, reqs.get(), reqs.size(), !journaled);
+        has_closure |= (*batch)[i]->HasClosure();
+    }
+    zx_status_t write_status = writes.Transact();
+    if (status == ZX_OK) {
+        status = write_status;
+    }
+
+    // A journal entry makes the batch durable, and its flush covers anything
+    // written in place before it.
+    if (journaled) {
+        unflushed_ = false;
+    } else if (blocks > 0) {
+        unflushed_ = true;
+    }
+    if (has_closure && unflushed_) {
+        zx_status_t flush_status = bc_->Sync();
+        if (status == ZX_OK) {
+            status = flush_status;
+        }
+        unflushed_ = false;
+    }
+
+    // The blocks freed by the batch may be trimmed once nothing which still
+    // refers to them could reappear, that is, once the batch is durable.
+    const size_t durable_trims = CompleteTrims(*batch, status);
+    if (durable_trims >= kMaxUnflushedTrims && unflushed_ && bc_->Sync() == ZX_OK) {
+        unflushed_ = false;
+    }
+    if (durable_trims > 0 && !unflushed_) {
+        TrimFreedBlocks();
+    }
+
+    for (size_t i = 0; i < batch->size(); i++) {
+        (*batch)[i]->Finish(status);
+        TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>((*batch)[i].get()));
+    }
+    batch->reset();
+}
+
 int WritebackBuffer::WritebackThread(void* arg) {
     WritebackBuffer* b = reinterpret_cast<WritebackBuffer*>(arg);
+    WorkBatch batch;
 
     b->writeback_lock_.Acquire();
     while (true) {
         while (!b->work_queue_.is_empty()) {
-            auto work = b->work_queue_.pop();
             TRACE_DURATION("minfs", "WritebackBuffer::WritebackThread");
 
-            // Stay unlocked while processing a unit of work
+            // Everything queued while the previous batch was being written
+            // goes out together, as far as the journal has room for it.
+            size_t blocks = 0;
+            while (!b->work_queue_.is_empty()) {
+                size_t work_blocks = b->work_queue_.front().BlkCount();
+                if (!batch.is_empty() && b->journal_ != nullptr &&
+                    blocks + work_blocks > b->journal_->Capacity()) {
+                    break;
+                }
+                blocks += work_blocks;
+                batch.push_back(b->work_queue_.pop());
+            }
+
+            // Stay unlocked while processing the batch
             b->writeback_lock_.Release();
-
-            // TODO(smklein): We could add additional validation that the blocks
-            // in "work" are contiguous and in the range of [start_, len_) (including
-            // wraparound).
-            size_t blks_consumed = work->Complete(b->mapper_.vmo().get(), b->buffer_vmoid_);
-            TRACE_FLOW_END("minfs", "writeback", reinterpret_cast<trace_flow_id_t>(work.get()));
-            work = nullptr;
+            b->CompleteBatch(&batch, blocks);
 
             // Relock before checking the state of the queue
             b->writeback_lock_.Acquire();
-            b->start_ = (b->start_ + blks_consumed) % b->cap_;
-            b->len_ -= blks_consumed;
+            b->start_ = (b->start_ + blocks) % b->cap_;
+            b->len_ -= blocks;
             cnd_signal(&b->producer_cvar_);
         }
 
@@ -0,0 +1,66 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+
+#include <fcntl.h>
+
+#include <fuchsia/sysinfo/c/fidl.h>
+#include <lib/fdio/util.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/resource.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/profile.h>
+
+namespace perftest {
+namespace {
+
+// Returns the root resource, or an invalid handle if it can't be had.
+const zx::resource& RootResource() {
+    static zx::resource root_resource = [] {
+        zx::resource resource;
+        int fd = open("/dev/misc/sysinfo", O_RDWR);
+        if (fd < 0) {
+            return resource;
+        }
+        zx::channel channel;
+        if (fdio_get_service_handle(fd, channel.reset_and_get_address()) != ZX_OK) {
+            return resource;
+        }
+        zx_status_t status;
+        zx_handle_t handle;
+        if (fuchsia_sysinfo_DeviceGetRootResource(channel.get(), &status,
+                                                  &handle) == ZX_OK &&
+            status == ZX_OK) {
+            resource.reset(handle);
+        }
+        return resource;
+    }();
+    return root_resource;
+}
+
+} // namespace
+
+bool CanSetCpuAffinity() {
+    return RootResource().is_valid();
+}
+
+zx_status_t SetThreadCpuMask(zx_handle_t thread, uint32_t cpu_mask) {
+    if (!CanSetCpuAffinity()) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    zx_profile_info_t info = {};
+    info.type = ZX_PROFILE_INFO_CPU_AFFINITY;
+    info.cpu_affinity.cpu_mask = cpu_mask;
+    zx::handle profile;
+    zx_status_t status = zx_profile_create(RootResource().get(), &info,
+                                           profile.reset_and_get_address());
+    if (status != ZX_OK) {
+        return status;
+    }
+    return zx_object_set_profile(thread, profile.get(), 0);
+}
+
+} // namespace perftest
@@ -9,12 +9,13 @@
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <perftest/results.h>
+#include <zircon/types.h>
 
 // This is a library for writing performance tests.  It supports
 // performance tests that involve running an operation repeatedly,
 // sequentially, and recording the times taken by each run of the
-// operation.  (It does not yet support other types of performance test,
-// such as where we run an operation concurrently in multiple threads.)
+// operation.  It also supports running such a loop concurrently on several
+// threads (see "Multi-threaded tests" below).
 //
 // There are two ways to implement a test:
 //
@@ -88,6 +89,38 @@
 // state->NextStep() between each step.
 //
 //
+// ## Multi-threaded tests
+//
+// A test that measures scalability or cross-CPU effects can run its loop
+// on several threads at once using RegisterMultiThreadTest().  The test
+// function is called on each thread with that thread's own RepeatState
+// and the thread's index:
+//
+//   // Measure the time taken to lock and unlock a mutex shared by
+//   // several threads.
+//   bool ContendedMutexTest(perftest::RepeatState* state,
+//                           uint32_t thread_index, mtx_t* mutex) {
+//       while (state->KeepRunning()) {
+//           mtx_lock(mutex);
+//           mtx_unlock(mutex);
+//       }
+//       return true;
+//   }
+//   void RegisterTests() {
+//       static mtx_t mutex = MTX_INIT;
+//       perftest::MultiThreadOptions options;
+//       options.thread_count = 4;
+//       perftest::RegisterMultiThreadTest("ContendedMutex", options,
+//                                         ContendedMutexTest, &mutex);
+//   }
+//
+// The first call to KeepRunning() on each thread waits until every thread
+// has made it, so that setup done before the loop is not timed against
+// other threads' runs.  Each thread records its own run and step times
+// (so multi-step tests work as above), and the results for a test combine
+// the times from all threads.
+//
+//
 // ## Test coding style
 //
 // ### Comments
@@ -181,6 +214,44 @@ void RegisterSimpleTest(const char* test_name) {
     RegisterTest(test_name, fbl::move(wrapper_func));
 }
 
+typedef bool MultiThreadTestFunc(RepeatState* state, uint32_t thread_index);
+
+// Where the runner places the threads of a multi-threaded test.  Pinning
+// threads needs the root resource (see CanSetCpuAffinity()).
+enum class CpuAffinity {
+    kAny,         // Wherever the scheduler puts them.
+    kSameCpu,     // All on CPU 0.
+    kSpreadCpus,  // Thread N on CPU (N % number of CPUs).
+};
+
+struct MultiThreadOptions {
+    uint32_t thread_count = 2;
+    CpuAffinity affinity = CpuAffinity::kAny;
+};
+
+void RegisterMultiThreadTest(const char* name, const MultiThreadOptions& options,
+                             fbl::Function<MultiThreadTestFunc> test_func);
+
+// Convenience routine for registering parameterized multi-threaded perf
+// tests.
+template <typename Func, typename Arg, typename... Args>
+void RegisterMultiThreadTest(const char* name, const MultiThreadOptions& options,
+                             Func test_func, Arg arg, Args... args) {
+    auto wrapper_func = [=](RepeatState* state, uint32_t thread_index) {
+        return test_func(state, thread_index, arg, args...);
+    };
+    RegisterMultiThreadTest(name, options, wrapper_func);
+}
+
+// Returns whether threads can be pinned to CPUs, i.e. whether the root
+// resource could be had from sysinfo.  Tests should check this before
+// registering variants that need a CpuAffinity other than kAny.
+bool CanSetCpuAffinity();
+
+// Restricts |thread| to running on the CPUs in |cpu_mask|.  Returns
+// ZX_ERR_NOT_SUPPORTED if CanSetCpuAffinity() is false.
+zx_status_t SetThreadCpuMask(zx_handle_t thread, uint32_t cpu_mask);
+
 // Entry point for the perf test runner that a test executable should call
 // from main().  This will run the registered perf tests and/or unit tests,
 // based on the command line arguments.  (See the "--help" output for more
@@ -201,6 +272,13 @@ bool RunTest(const char* test_suite, const char* test_name,
              uint32_t run_count, ResultsSet* results_set,
              fbl::String* error_out);
 
+// Like RunTest(), but for a multi-threaded test.
+bool RunMultiThreadTest(const char* test_suite, const char* test_name,
+                        const MultiThreadOptions& options,
+                        const fbl::Function<MultiThreadTestFunc>& test_func,
+                        uint32_t run_count, ResultsSet* results_set,
+                        fbl::String* error_out);
+
 // DoNotOptimize() can be used to prevent the computation of |value| from
 // being optimized away by the compiler.  It also prevents the compiler
 // from optimizing away reads or writes to memory that |value| points to
@@ -31,6 +31,10 @@ struct SummaryStatistics {
     double mean;
     double std_dev;
     double median;
+    // 90th and 99th percentiles, which show the tail of the distribution
+    // that the mean and median hide.
+    double p90;
+    double p99;
 };
 
 // This represents the results for a particular test case.  It contains a
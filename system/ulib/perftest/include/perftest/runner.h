@@ -14,8 +14,18 @@ namespace internal {
 // that the perf test runner can be tested by unit tests.
 
 struct NamedTest {
+    NamedTest(const char* name, fbl::Function<TestFunc> test_func)
+        : name(name), test_func(fbl::move(test_func)) {}
+    NamedTest(const char* name, const MultiThreadOptions& options,
+              fbl::Function<MultiThreadTestFunc> test_func)
+        : name(name), multi_thread_func(fbl::move(test_func)),
+          multi_thread_options(options) {}
+
     fbl::String name;
     fbl::Function<TestFunc> test_func;
+    // Set instead of |test_func| for a multi-threaded test.
+    fbl::Function<MultiThreadTestFunc> multi_thread_func;
+    MultiThreadOptions multi_thread_options;
 };
 
 typedef fbl::Vector<NamedTest> TestList;
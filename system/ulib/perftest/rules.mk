@@ -11,6 +11,7 @@ MODULE_TYPE := userlib
 MODULE_COMPILEFLAGS += -fvisibility=hidden
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/affinity.cpp \
     $(LOCAL_DIR)/results.cpp \
     $(LOCAL_DIR)/runner.cpp \
 
@@ -20,6 +21,7 @@ MODULE_LIBS := \
     system/ulib/async-loop.cpp \
     system/ulib/c \
     system/ulib/fbl \
+    system/ulib/fdio \
     system/ulib/trace \
     system/ulib/trace-engine \
     system/ulib/trace-provider \
@@ -27,6 +29,9 @@ MODULE_LIBS := \
     system/ulib/zircon \
     system/ulib/zx \
 
+MODULE_FIDL_LIBS := \
+    system/fidl/fuchsia-sysinfo \
+
 MODULE_PACKAGE := src
 
 include make/module.mk
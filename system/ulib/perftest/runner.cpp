@@ -7,10 +7,13 @@
 #include <getopt.h>
 #include <pthread.h>
 #include <regex.h>
+#include <threads.h>
 
+#include <fbl/algorithm.h>
 #include <fbl/function.h>
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <lib/async-loop/cpp/loop.h>
 #include <trace-engine/context.h>
@@ -19,6 +22,7 @@
 #include <trace/event.h>
 #include <unittest/unittest.h>
 #include <zircon/assert.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
 
 namespace perftest {
@@ -29,10 +33,54 @@ namespace {
 // items have been added to the list, because that would clobber the list.
 internal::TestList* g_tests;
 
+// Holds back the threads of a multi-threaded test until all of them are
+// ready to start their timed runs.
+class StartBarrier {
+public:
+    explicit StartBarrier(uint32_t thread_count)
+        : remaining_(thread_count) {
+        ZX_ASSERT(mtx_init(&mutex_, mtx_plain) == thrd_success);
+        ZX_ASSERT(cnd_init(&cond_) == thrd_success);
+    }
+    ~StartBarrier() {
+        cnd_destroy(&cond_);
+        mtx_destroy(&mutex_);
+    }
+
+    // Waits until every thread has either called Arrive() or Leave().
+    void Arrive() {
+        mtx_lock(&mutex_);
+        if (--remaining_ == 0) {
+            cnd_broadcast(&cond_);
+        }
+        while (remaining_ != 0) {
+            cnd_wait(&cond_, &mutex_);
+        }
+        mtx_unlock(&mutex_);
+    }
+
+    // Called instead of Arrive() by a thread that finished without
+    // starting its runs (e.g. on error), so the others do not wait for it.
+    void Leave() {
+        mtx_lock(&mutex_);
+        if (--remaining_ == 0) {
+            cnd_broadcast(&cond_);
+        }
+        mtx_unlock(&mutex_);
+    }
+
+private:
+    mtx_t mutex_;
+    cnd_t cond_;
+    uint32_t remaining_;
+};
+
 class RepeatStateImpl : public RepeatState {
 public:
-    RepeatStateImpl(uint32_t run_count)
-        : run_count_(run_count) {}
+    // If |start_barrier| is non-null, the first call to KeepRunning()
+    // waits on it before the first run starts.
+    RepeatStateImpl(uint32_t run_count, StartBarrier* start_barrier = nullptr)
+        : run_count_(run_count), start_barrier_(start_barrier) {}
 
     void SetBytesProcessedPerRun(uint64_t bytes) override {
         if (started_) {
@@ -98,6 +146,9 @@ public:
             next_idx_ = 1;
             end_of_run_idx_ = step_count_;
             started_ = true;
+            if (start_barrier_) {
+                start_barrier_->Arrive();
+            }
             timestamps_[0] = zx_ticks_get();
             return run_count_ != 0;
         }
@@ -124,6 +175,9 @@ public:
         overall_start_time_ = zx_ticks_get();
         bool result = test_func(this);
         overall_end_time_ = zx_ticks_get();
+        if (start_barrier_ && !started_) {
+            start_barrier_->Leave();
+        }
         if (error_) {
             return error_;
         }
@@ -252,6 +306,8 @@ private:
 
     // Number of test runs that we intend to do.
     uint32_t run_count_;
+    // Shared with the other threads of a multi-threaded test, or null.
+    StartBarrier* start_barrier_;
     // Number of steps per test run.  Once initialized, this is >= 1.
     uint32_t step_count_;
     // Names for steps.  May be empty if the test has only one step.
@@ -280,6 +336,56 @@ private:
     uint64_t bytes_processed_per_run_ = 0;
 };
 
+// Returns the CPUs that thread |thread_index| of a multi-threaded test
+// should run on, or 0 if it should not be pinned.
+uint32_t CpuMaskForThread(CpuAffinity affinity, uint32_t thread_index) {
+    switch (affinity) {
+    case CpuAffinity::kSameCpu:
+        return 1u;
+    case CpuAffinity::kSpreadCpus:
+        return 1u << (thread_index % fbl::min(zx_system_get_num_cpus(), 32u));
+    default:
+        return 0u;
+    }
+}
+
+// State for one thread of a multi-threaded test.
+struct TestThread {
+    TestThread(uint32_t run_count, StartBarrier* start_barrier)
+        : state(run_count, start_barrier) {}
+
+    RepeatStateImpl state;
+    const char* test_name;
+    const MultiThreadOptions* options;
+    const fbl::Function<MultiThreadTestFunc>* test_func;
+    uint32_t thread_index;
+    // Set to non-null if the thread's test function failed.
+    const char* error = nullptr;
+    thrd_t thread;
+
+    static int Run(void* arg) {
+        auto* self = static_cast<TestThread*>(arg);
+        uint32_t cpu_mask = CpuMaskForThread(self->options->affinity,
+                                             self->thread_index);
+        if (cpu_mask && SetThreadCpuMask(zx_thread_self(), cpu_mask) != ZX_OK) {
+            self->error = "Failed to set CPU affinity";
+            // Run the test function anyway, so that the other threads,
+            // which may be waiting on this one, can finish.
+        }
+        const char* error = self->state.RunTestFunc(
+            self->test_name, [self](RepeatState* state) {
+                return (*self->test_func)(state, self->thread_index);
+            });
+        if (!self->error) {
+            self->error = error;
+        }
+        if (!self->error) {
+            self->state.WriteTraceEvents();
+        }
+        return 0;
+    }
+};
+
 } // namespace
 
 void RegisterTest(const char* name, fbl::Function<TestFunc> test_func) {
@@ -308,6 +414,84 @@ bool RunTest(const char* test_suite, const char* test_name,
     return true;
 }
 
+void RegisterMultiThreadTest(const char* name, const MultiThreadOptions& options,
+                             fbl::Function<MultiThreadTestFunc> test_func) {
+    if (!g_tests) {
+        g_tests = new internal::TestList;
+    }
+    internal::NamedTest new_test{name, options, fbl::move(test_func)};
+    g_tests->push_back(fbl::move(new_test));
+}
+
+bool RunMultiThreadTest(const char* test_suite, const char* test_name,
+                        const MultiThreadOptions& options,
+                        const fbl::Function<MultiThreadTestFunc>& test_func,
+                        uint32_t run_count, ResultsSet* results_set,
+                        fbl::String* error_out) {
+    auto SetError = [error_out](const fbl::String& error) {
+        if (error_out) {
+            *error_out = error;
+        }
+        return false;
+    };
+    if (options.thread_count == 0) {
+        return SetError("Multi-threaded test has zero threads");
+    }
+    if (options.affinity != CpuAffinity::kAny && !CanSetCpuAffinity()) {
+        return SetError("CPU affinity was requested but cannot be set");
+    }
+
+    StartBarrier start_barrier(options.thread_count);
+    fbl::Vector<fbl::unique_ptr<TestThread>> threads;
+    threads.reserve(options.thread_count);
+    for (uint32_t i = 0; i < options.thread_count; ++i) {
+        fbl::unique_ptr<TestThread> thread(new TestThread(run_count, &start_barrier));
+        thread->test_name = test_name;
+        thread->options = &options;
+        thread->test_func = &test_func;
+        thread->thread_index = i;
+        threads.push_back(fbl::move(thread));
+    }
+    // Start all the threads before joining any, since each waits for the
+    // others before its first run.
+    for (auto& thread : threads) {
+        ZX_ASSERT(thrd_create(&thread->thread, TestThread::Run, thread.get()) ==
+                  thrd_success);
+    }
+    for (auto& thread : threads) {
+        ZX_ASSERT(thrd_join(thread->thread, nullptr) == thrd_success);
+    }
+    for (auto& thread : threads) {
+        if (thread->error) {
+            return SetError(fbl::StringPrintf("Thread %u: %s",
+                                              thread->thread_index,
+                                              thread->error));
+        }
+    }
+
+    // Combine the threads' times into one set of test cases, so that each
+    // test case has |thread_count| * |run_count| values.
+    ResultsSet combined;
+    threads[0]->state.CopyTimeResults(test_suite, test_name, &combined);
+    for (uint32_t i = 1; i < options.thread_count; ++i) {
+        ResultsSet thread_results;
+        threads[i]->state.CopyTimeResults(test_suite, test_name, &thread_results);
+        if (thread_results.results()->size() != combined.results()->size()) {
+            return SetError("Threads declared different numbers of steps");
+        }
+        for (size_t j = 0; j < combined.results()->size(); ++j) {
+            TestCaseResults* dest = &(*combined.results())[j];
+            for (double value : (*thread_results.results())[j].values) {
+                dest->AppendValue(value);
+            }
+        }
+    }
+    for (auto& test_case : *combined.results()) {
+        results_set->results()->push_back(fbl::move(test_case));
+    }
+    return true;
+}
+
 namespace internal {
 
 bool RunTests(const char* test_suite, TestList* test_list, uint32_t run_count,
@@ -342,8 +526,17 @@ bool RunTests(const char* test_suite, TestList* test_list, uint32_t run_count,
         fprintf(log_stream, "[ RUN      ] %s\n", test_name);
 
         fbl::String error_string;
-        if (!RunTest(test_suite, test_name, test_case.test_func, run_count,
-                     results_set, &error_string)) {
+        bool passed;
+        if (test_case.multi_thread_func) {
+            passed = RunMultiThreadTest(test_suite, test_name,
+                                        test_case.multi_thread_options,
+                                        test_case.multi_thread_func,
+                                        run_count, results_set, &error_string);
+        } else {
+            passed = RunTest(test_suite, test_name, test_case.test_func,
+                             run_count, results_set, &error_string);
+        }
+        if (!passed) {
             fprintf(log_stream, "Error: %s\n", error_string.c_str());
             fprintf(log_stream, "[  FAILED  ] %s\n", test_name);
             ok = false;
@@ -418,6 +418,10 @@ public:
     // specified size and alignment.  Note; the alignment must be a power of
     // two.  Pass 1 if alignment does not matter.
     //
+    // The smallest region which can satisfy the request is used, unless many
+    // regions just too small to satisfy the alignment stand in the way, in
+    // which case the smallest region certain to fit is used instead.
+    //
     // Possible return values
     // ++ ZX_ERR_BAD_STATE : Allocator has no RegionPool assigned.
     // ++ ZX_ERR_NO_MEMORY : not enough bookkeeping memory available in our
@@ -512,11 +516,23 @@ private:
     bool IntersectsLocked(const Region::WAVLTreeSortByBase& tree,
                                  const ralloc_region_t& region) __TA_REQUIRES(alloc_lock_);
 
+    // Bookkeeping is obtained from, and returned to, a small cache of nodes
+    // before falling back on the RegionPool, so that most splits and merges
+    // do not need to take the pool's lock.
+    Region* NewRegionLocked() __TA_REQUIRES(alloc_lock_);
+    void DeleteRegionLocked(Region* region) __TA_REQUIRES(alloc_lock_);
+    void DrainNodeCacheLocked() __TA_REQUIRES(alloc_lock_);
+
+    // The number of near misses an aligned allocation will consider before
+    // settling for the smallest region which is certain to fit.
+    static constexpr size_t kMaxAlignedCandidates = 16;
+    static constexpr size_t kNodeCacheSize = 8;
+
     /* Locking notes:
      *
      * alloc_lock_ protects all of the bookkeeping members of the
      * RegionAllocator.  This includes the allocated index, the available
-     * indicies (by base and by size) and the region pool.
+     * indicies (by base and by size), the node cache and the region pool.
      *
      * The alloc_lock_ may be held while calling into a RegionAllocator's
      * assigned RegionPool, but code from the RegionPool will never call into
@@ -527,6 +543,8 @@ private:
     Region::WAVLTreeSortByBase avail_regions_by_base_       __TA_GUARDED(alloc_lock_);
     Region::WAVLTreeSortBySize avail_regions_by_size_       __TA_GUARDED(alloc_lock_);
     RegionPool::RefPtr region_pool_                         __TA_GUARDED(alloc_lock_);
+    Region* node_cache_[kNodeCacheSize]                     __TA_GUARDED(alloc_lock_);
+    size_t node_cache_count_                                __TA_GUARDED(alloc_lock_) = 0;
 };
 
 // If this is C++, clear out this pre-processor constant.  People can get to the
@@ -40,8 +40,9 @@ RegionAllocator::~RegionAllocator() {
     // Return all of our bookkeeping to our region pool.
     avail_regions_by_base_.clear();
     while (!avail_regions_by_size_.is_empty()) {
-        region_pool_->Delete(avail_regions_by_size_.pop_front());
+        DeleteRegionLocked(avail_regions_by_size_.pop_front());
     }
+    DrainNodeCacheLocked();
 }
 
 void RegionAllocator::Reset() {
@@ -52,9 +53,11 @@ void RegionAllocator::Reset() {
     Region* removed;
     while ((removed = avail_regions_by_base_.pop_front()) != nullptr) {
         avail_regions_by_size_.erase(*removed);
-        region_pool_->Delete(removed);
+        DeleteRegionLocked(removed);
     }
 
+    DrainNodeCacheLocked();
+
     ZX_DEBUG_ASSERT(avail_regions_by_base_.is_empty());
     ZX_DEBUG_ASSERT(avail_regions_by_size_.is_empty());
 }
@@ -65,6 +68,8 @@ zx_status_t RegionAllocator::SetRegionPool(const RegionPool::RefPtr& region_pool
     if (!allocated_regions_by_base_.is_empty() || !avail_regions_by_base_.is_empty())
         return ZX_ERR_BAD_STATE;
 
+    // Cached bookkeeping belongs to the old pool and must go back to it.
+    DrainNodeCacheLocked();
     region_pool_ = region_pool;
     return ZX_OK;
 }
@@ -85,7 +90,7 @@ zx_status_t RegionAllocator::AddRegion(const ralloc_region_t& region, bool allow
     // All sanity checks passed.  Grab a piece of free bookeeping from our pool,
     // fill it out, then add it to the sets of available regions (indexed by
     // base address as well as size)
-    Region* to_add = region_pool_->New(this);
+    Region* to_add = NewRegionLocked();
     if (to_add == nullptr)
         return ZX_ERR_NO_MEMORY;
 
@@ -134,7 +139,7 @@ zx_status_t RegionAllocator::SubtractRegion(const ralloc_region_t& to_subtract,
                 avail_regions_by_size_.erase(*removed);
 
                 ZX_DEBUG_ASSERT(region_pool_ != nullptr);
-                region_pool_->Delete(removed);
+                DeleteRegionLocked(removed);
 
                 return ZX_OK;
             }
@@ -143,7 +148,7 @@ zx_status_t RegionAllocator::SubtractRegion(const ralloc_region_t& to_subtract,
             // to be split into two regions.  If we are out of bookkeeping space, we
             // are out of luck.
             if ((region.base != before->base) && (region_end != before_end)) {
-                Region* second = region_pool_->New(this);
+                Region* second = NewRegionLocked();
                 if (second == nullptr)
                     return ZX_ERR_NO_MEMORY;
 
@@ -217,7 +222,7 @@ zx_status_t RegionAllocator::SubtractRegion(const ralloc_region_t& to_subtract,
                 avail_regions_by_base_.erase(*bptr);
 
                 ZX_DEBUG_ASSERT(region_pool_ != nullptr);
-                region_pool_->Delete(bptr);
+                DeleteRegionLocked(bptr);
             } else {
                 bptr->size = region.base - bptr->base;
                 avail_regions_by_size_.insert(bptr);
@@ -269,7 +274,7 @@ zx_status_t RegionAllocator::SubtractRegion(const ralloc_region_t& to_subtract,
         region.size = region_end - region.base;
 
         ZX_DEBUG_ASSERT(region_pool_ != nullptr);
-        region_pool_->Delete(trim);
+        DeleteRegionLocked(trim);
 
         if (!region.size)
             break;
@@ -308,6 +313,7 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size,
     // allocation.  Stop as soon as we find one which can satisfy the alignment
     // restrictions.
     uint64_t aligned_base = 0;
+    size_t candidates = 0;
     while (iter.IsValid()) {
         ZX_DEBUG_ASSERT(iter->size >= size);
         aligned_base = (iter->base + mask) & inv_mask;
@@ -321,7 +327,18 @@ zx_status_t RegionAllocator::GetRegion(uint64_t size,
         if ((aligned_base >= iter->base) && (overhead <= leftover))
             break;
 
-        ++iter;
+        // Any region at least (size + mask) long can satisfy the alignment on
+        // its own, short of wrapping the address space.  Rather than walk an
+        // arbitrarily long run of near misses below that size, give up on a
+        // strict best fit after a few and jump straight to the smallest such
+        // region.
+        uint64_t fits_any = size + mask;
+        if ((++candidates == kMaxAlignedCandidates) &&
+            (fits_any >= size) && (iter->size < fits_any)) {
+            iter = avail_regions_by_size_.lower_bound({ .base = 0, .size = fits_any });
+        } else {
+            ++iter;
+        }
     }
 
     if (!iter.IsValid())
@@ -415,6 +432,39 @@ void RegionAllocator::ReleaseRegion(Region* region) {
     AddRegionToAvailLocked(region);
 }
 
+RegionAllocator::Region* RegionAllocator::NewRegionLocked() {
+    ZX_DEBUG_ASSERT(region_pool_ != nullptr);
+
+    // Nodes in the cache were left out of every tree when they were deleted,
+    // so they may be handed out again as they are.
+    if (node_cache_count_ > 0)
+        return node_cache_[--node_cache_count_];
+
+    return region_pool_->New(this);
+}
+
+void RegionAllocator::DeleteRegionLocked(Region* region) {
+    ZX_DEBUG_ASSERT(region != nullptr);
+    ZX_DEBUG_ASSERT(region->owner_ == this);
+    ZX_DEBUG_ASSERT(!region->ns_tree_sort_by_base_.InContainer());
+    ZX_DEBUG_ASSERT(!region->ns_tree_sort_by_size_.InContainer());
+
+    if (node_cache_count_ < fbl::count_of(node_cache_)) {
+        node_cache_[node_cache_count_++] = region;
+        return;
+    }
+
+    ZX_DEBUG_ASSERT(region_pool_ != nullptr);
+    region_pool_->Delete(region);
+}
+
+void RegionAllocator::DrainNodeCacheLocked() {
+    ZX_DEBUG_ASSERT((region_pool_ != nullptr) || (node_cache_count_ == 0));
+
+    while (node_cache_count_ > 0)
+        region_pool_->Delete(node_cache_[--node_cache_count_]);
+}
+
 zx_status_t RegionAllocator::AllocFromAvailLocked(Region::WAVLTreeSortBySize::iterator source,
                                                   Region::UPtr& out_region,
                                                   uint64_t base,
@@ -449,7 +499,7 @@ zx_status_t RegionAllocator::AllocFromAvailLocked(Region::WAVLTreeSortBySize::it
         // If we only have to split after, then this region is aligned with what
         // we want to allocate, but we will not use all of it.  Break it into
         // two pieces and return the one which comes first.
-        Region* before_region = region_pool_->New(this);
+        Region* before_region = NewRegionLocked();
         if (before_region == nullptr)
             return ZX_ERR_NO_MEMORY;
 
@@ -469,7 +519,7 @@ zx_status_t RegionAllocator::AllocFromAvailLocked(Region::WAVLTreeSortBySize::it
         // properly with what we want to allocate, but we will use the entire
         // region (after aligning).  Break it into two pieces and return the one
         // which comes after.
-        Region* after_region = region_pool_->New(this);
+        Region* after_region = NewRegionLocked();
         if (after_region == nullptr)
             return ZX_ERR_NO_MEMORY;
 
@@ -486,14 +536,14 @@ zx_status_t RegionAllocator::AllocFromAvailLocked(Region::WAVLTreeSortBySize::it
     } else {
         // Looks like we need to break our region into 3 chunk and return the
         // middle chunk.  Start by grabbing the bookkeeping we require first.
-        Region* region = region_pool_->New(this);
+        Region* region = NewRegionLocked();
         if (region == nullptr)
             return ZX_ERR_NO_MEMORY;
 
-        Region* after_region = region_pool_->New(this);
+        Region* after_region = NewRegionLocked();
         if (after_region == nullptr) {
             ZX_DEBUG_ASSERT(region_pool_ != nullptr);
-            region_pool_->Delete(region);
+            DeleteRegionLocked(region);
             return ZX_ERR_NO_MEMORY;
         }
 
@@ -541,7 +591,7 @@ void RegionAllocator::AddRegionToAvailLocked(Region* region, bool allow_overlap)
             auto removed = avail_regions_by_base_.erase(before);
             avail_regions_by_size_.erase(*removed);
             ZX_DEBUG_ASSERT(region_pool_ != nullptr);
-            region_pool_->Delete(removed);
+            DeleteRegionLocked(removed);
         }
     }
 
@@ -560,7 +610,7 @@ void RegionAllocator::AddRegionToAvailLocked(Region* region, bool allow_overlap)
         auto removed  = avail_regions_by_base_.erase(remove_me);
         avail_regions_by_size_.erase(*removed);
         ZX_DEBUG_ASSERT(region_pool_ != nullptr);
-        region_pool_->Delete(removed);
+        DeleteRegionLocked(removed);
 
         if (!allow_overlap)
             break;
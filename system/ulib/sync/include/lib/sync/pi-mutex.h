@@ -0,0 +1,61 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIB_SYNC_PI_MUTEX_H_
+#define LIB_SYNC_PI_MUTEX_H_
+
+#include <zircon/compiler.h>
+#include <zircon/types.h>
+
+__BEGIN_CDECLS
+
+// A non-recursive mutex whose waiters lend their priority to its owner.
+//
+// Unlike |sync_mutex|, a thread blocked on a |sync_pi_mutex| names the thread
+// holding it to the kernel, which runs that thread at no less than the
+// priority of its highest priority waiter. A low priority thread holding the
+// mutex therefore can't keep a high priority thread waiting on it from
+// running. See |zx_futex_wait_pi()| for the limits of the inheritance.
+//
+// The futex holds the handle of the owning thread, so a thread must not close
+// its own handle while it holds the mutex.
+typedef struct __TA_CAPABILITY("mutex") sync_pi_mutex {
+    zx_futex_t futex;
+
+#ifdef __cplusplus
+    sync_pi_mutex()
+        : futex(0) {}
+#endif
+} sync_pi_mutex_t;
+
+#if !defined(__cplusplus)
+#define SYNC_PI_MUTEX_INIT ((sync_pi_mutex_t){0})
+#endif
+
+// Locks the mutex.
+//
+// The current thread will block until the mutex is acquired. Attempting to
+// lock a mutex that is already held by this thread will deadlock.
+void sync_pi_mutex_lock(sync_pi_mutex_t* mutex) __TA_ACQUIRE(mutex);
+
+// Attempt to lock the mutex until |deadline|.
+//
+// |deadline| is expressed as an absolute time in the ZX_CLOCK_MONOTONIC
+// timebase.
+//
+// Returns |ZX_OK| if the lock is acquired, and |ZX_ERR_TIMED_OUT| if the
+// deadline passes.
+zx_status_t sync_pi_mutex_timedlock(sync_pi_mutex_t* mutex, zx_time_t deadline);
+
+// Attempts to lock the mutex without blocking.
+//
+// Returns |ZX_OK| if the lock is obtained, and |ZX_ERR_BAD_STATE| if not.
+zx_status_t sync_pi_mutex_trylock(sync_pi_mutex_t* mutex);
+
+// Unlocks the mutex, handing it to the highest priority waiter if any.
+void sync_pi_mutex_unlock(sync_pi_mutex_t* mutex) __TA_RELEASE(mutex);
+
+__END_CDECLS
+
+#endif // LIB_SYNC_PI_MUTEX_H_
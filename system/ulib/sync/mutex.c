@@ -6,6 +6,7 @@
 
 #include <zircon/syscalls.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 
 // This mutex implementation is based on Ulrich Drepper's paper "Futexes
 // Are Tricky" (dated November 5, 2011; see
@@ -21,6 +22,40 @@ enum {
     LOCKED_WITH_WAITERS = 2
 };
 
+// The number of times a mutex held without waiters is checked before waiting
+// on it.  Critical sections are usually short, so this often avoids both the
+// futex wait and the wake when the mutex is released.
+#define SPIN_LIMIT 100
+
+static inline void spin_pause(void) {
+#if defined(__x86_64__)
+    __asm__ volatile("pause" ::: "memory");
+#elif defined(__aarch64__)
+    __asm__ volatile("yield" ::: "memory");
+#else
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+}
+
+// Spins briefly while the mutex is held without waiters, trying to claim it
+// if it is released.  Once there are waiters, a spinning thread would only
+// get in the way of the one being woken, so it gives up.  Updates
+// |*old_state| to the state last seen.
+static bool spin_trylock(sync_mutex_t* mutex, int* old_state) {
+    for (int i = 0; i < SPIN_LIMIT && *old_state != LOCKED_WITH_WAITERS; i++) {
+        if (*old_state == UNLOCKED) {
+            if (atomic_compare_exchange_strong(&mutex->futex, old_state,
+                                               LOCKED_WITHOUT_WAITERS)) {
+                return true;
+            }
+            continue;
+        }
+        spin_pause();
+        *old_state = atomic_load_explicit(&mutex->futex, memory_order_relaxed);
+    }
+    return false;
+}
+
 // On success, this will leave the mutex in the LOCKED_WITH_WAITERS state.
 static zx_status_t lock_slow_path(sync_mutex_t* mutex, zx_time_t deadline,
                                   int old_state) {
@@ -66,6 +101,9 @@ zx_status_t sync_mutex_timedlock(sync_mutex_t* mutex, zx_time_t deadline) {
                                        LOCKED_WITHOUT_WAITERS)) {
         return ZX_OK;
     }
+    if (spin_trylock(mutex, &old_state)) {
+        return ZX_OK;
+    }
     return lock_slow_path(mutex, deadline, old_state);
 }
 
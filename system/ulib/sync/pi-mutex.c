@@ -0,0 +1,110 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/sync/pi-mutex.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <stdatomic.h>
+
+// The futex is 0 when the mutex is unlocked, and otherwise holds the handle
+// of the thread which owns it, which the waiters pass to the kernel.  Handle
+// values always have their lowest bit set, so that bit is cleared to record
+// that there may be waiters, in which case unlocking must wake one.
+enum {
+    UNLOCKED = 0,
+    NO_WAITERS_BIT = 1
+};
+
+static inline int owner_of(int state) {
+    return state | NO_WAITERS_BIT;
+}
+
+zx_status_t sync_pi_mutex_trylock(sync_pi_mutex_t* mutex) {
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                       (int)_zx_thread_self())) {
+        return ZX_OK;
+    }
+    return ZX_ERR_BAD_STATE;
+}
+
+zx_status_t sync_pi_mutex_timedlock(sync_pi_mutex_t* mutex, zx_time_t deadline) {
+    const int self = (int)_zx_thread_self();
+
+    // Try to claim the mutex.  This compare-and-swap executes the full
+    // memory barrier that locking a mutex is required to execute.
+    int old_state = UNLOCKED;
+    if (atomic_compare_exchange_strong(&mutex->futex, &old_state, self)) {
+        return ZX_OK;
+    }
+
+    for (;;) {
+        if (old_state == UNLOCKED) {
+            // As in sync_mutex, a thread which has waited must assume that
+            // others are still waiting, so it claims the mutex with waiters.
+            if (atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                               self & ~NO_WAITERS_BIT)) {
+                return ZX_OK;
+            }
+            continue;
+        }
+
+        // Record that there are waiters, unless that is already known.
+        int waiting_state = old_state & ~NO_WAITERS_BIT;
+        if (old_state != waiting_state &&
+            !atomic_compare_exchange_strong(&mutex->futex, &old_state,
+                                            waiting_state)) {
+            continue;
+        }
+
+        zx_status_t status = _zx_futex_wait_pi(
+                &mutex->futex, waiting_state, (zx_handle_t)owner_of(old_state),
+                deadline);
+        switch (status) {
+        case ZX_ERR_TIMED_OUT:
+            return ZX_ERR_TIMED_OUT;
+        case ZX_ERR_BAD_HANDLE:
+        case ZX_ERR_WRONG_TYPE:
+        case ZX_ERR_INVALID_ARGS:
+            // The owner's handle was closed, possibly to be reused, before
+            // the futex changed.  Wait without inheritance instead.
+            status = _zx_futex_wait(&mutex->futex, waiting_state, deadline);
+            if (status == ZX_ERR_TIMED_OUT)
+                return ZX_ERR_TIMED_OUT;
+            break;
+        default:
+            break;
+        }
+
+        old_state = atomic_load(&mutex->futex);
+    }
+}
+
+void sync_pi_mutex_lock(sync_pi_mutex_t* mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    zx_status_t status = sync_pi_mutex_timedlock(mutex, ZX_TIME_INFINITE);
+    if (status != ZX_OK) {
+        __builtin_trap();
+    }
+}
+
+void sync_pi_mutex_unlock(sync_pi_mutex_t* mutex) __TA_NO_THREAD_SAFETY_ANALYSIS {
+    // Attempt to release the mutex.  This atomic swap executes the full
+    // memory barrier that unlocking a mutex is required to execute.
+    int old_state = atomic_exchange(&mutex->futex, UNLOCKED);
+
+    if (old_state == UNLOCKED) {
+        // The unlock call was invalid.
+        __builtin_trap();
+    }
+
+    // As with sync_mutex, the memory could already have been reused, so this
+    // could cause a spurious wakeup for an unrelated user of it.
+    if (!(old_state & NO_WAITERS_BIT)) {
+        zx_status_t status = _zx_futex_wake_pi(&mutex->futex);
+        if (status != ZX_OK) {
+            __builtin_trap();
+        }
+    }
+}
@@ -13,6 +13,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/completion.c \
     $(LOCAL_DIR)/condition.cpp \
     $(LOCAL_DIR)/mutex.c \
+    $(LOCAL_DIR)/pi-mutex.c \
 
 MODULE_LIBS := \
     system/ulib/zircon \
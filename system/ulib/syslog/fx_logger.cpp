@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_lock.h>
 #include <fbl/string_buffer.h>
 #include <zircon/assert.h>
@@ -26,8 +27,42 @@ zx_koid_t GetCurrentThreadKoid() {
     return tls_thread_koid;
 }
 
+// Structured records are sent at the latest when a message is written this
+// long after the first in its batch.
+constexpr zx_duration_t kBatchDelay = ZX_MSEC(100);
+
+// Guards moving batches between loggers, and sending a batch from a thread
+// other than the one which owns it.
+fbl::Mutex g_batch_lock;
+
+// This thread's batch of structured records.
+// Allocated on first use.
+thread_local fbl::unique_ptr<syslog::LogBatch> tls_batch;
+
 } // namespace
 
+namespace syslog {
+
+LogBatch::~LogBatch() {
+    fbl::AutoLock lock(&g_batch_lock);
+    fx_logger* owner = logger.load(fbl::memory_order_relaxed);
+    if (owner != nullptr) {
+        owner->SendBatchLocked(this);
+        owner->DetachBatchLocked(this);
+    }
+}
+
+} // namespace syslog
+
+fx_logger::~fx_logger() {
+    fbl::AutoLock lock(&g_batch_lock);
+    while (!batches_.is_empty()) {
+        syslog::LogBatch* batch = &batches_.front();
+        SendBatchLocked(batch);
+        DetachBatchLocked(batch);
+    }
+}
+
 void fx_logger::ActivateFallback(int fallback_fd) {
     fbl::AutoLock lock(&fallback_mutex_);
     if (logger_fd_.load(fbl::memory_order_relaxed) != -1) {
@@ -213,6 +248,298 @@ zx_status_t fx_logger::VLogWrite(fx_log_severity_t severity, const char* tag,
     return status;
 }
 
+zx_status_t fx_logger::RegisterFormat(const char* format, fx_log_format_id_t* out_id) {
+    using syslog::ArgKind;
+
+    if (format == nullptr || out_id == nullptr) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<syslog::StructuredFormat> structured(new (&ac) syslog::StructuredFormat);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+    structured->max_args_size = 0;
+    const char* next = format;
+    const char* conversion;
+    ArgKind kind;
+    while ((next = syslog::NextConversion(next, &conversion, &kind)) != nullptr) {
+        if (kind == ArgKind::kInvalid) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        if (kind == ArgKind::kNone) {
+            continue;
+        }
+        structured->max_args_size += (kind == ArgKind::kString)
+                                         ? syslog::StringArgSize(FX_LOG_MAX_STRUCTURED_STRING)
+                                         : sizeof(uint64_t);
+        if (structured->max_args_size > FX_LOG_MAX_STRUCTURED_ARGS) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        structured->arg_kinds.push_back(kind, &ac);
+        if (!ac.check()) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+    size_t len = strlen(format);
+    structured->format = fbl::String(format, len, &ac);
+    if (!ac.check()) {
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    fbl::AutoLock lock(&formats_mutex_);
+    uint32_t id = num_formats_.load(fbl::memory_order_relaxed);
+    if (id >= FX_LOG_MAX_FORMATS) {
+        return ZX_ERR_NO_RESOURCES;
+    }
+
+    // The log service must learn the format before any record which uses it.
+    if (logger_fd_.load(fbl::memory_order_relaxed) == -1 && socket_.is_valid()) {
+        struct {
+            fx_log_structured_header_t header;
+            uint32_t id;
+            char format[FX_LOG_MAX_DATAGRAM_LEN - sizeof(fx_log_structured_header_t) -
+                        sizeof(uint32_t)];
+        } packet;
+        if (len >= sizeof(packet.format)) {
+            return ZX_ERR_INVALID_ARGS;
+        }
+        memset(&packet.header, 0, sizeof(packet.header));
+        packet.header.marker = ZX_KOID_INVALID;
+        packet.header.pid = pid_;
+        packet.header.tid = GetCurrentThreadKoid();
+        packet.header.type = FX_LOG_STRUCTURED_FORMAT;
+        packet.header.dropped_logs = dropped_logs_.load();
+        packet.id = id;
+        memcpy(packet.format, format, len + 1);
+        size_t size = offsetof(decltype(packet), format) + len + 1;
+        zx_status_t status = socket_.write(0, &packet, size, nullptr);
+        if (status == ZX_ERR_BAD_STATE || status == ZX_ERR_PEER_CLOSED) {
+            ActivateFallback(-1);
+        } else if (status != ZX_OK) {
+            return status;
+        }
+    }
+
+    formats_[id] = fbl::move(structured);
+    num_formats_.store(id + 1, fbl::memory_order_release);
+    *out_id = id;
+    return ZX_OK;
+}
+
+zx_status_t fx_logger::VLogWriteStructured(fx_log_severity_t severity,
+                                           fx_log_format_id_t format_id, va_list args) {
+    if (severity > FX_LOG_FATAL) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    if (GetSeverity() > severity) {
+        return ZX_OK;
+    }
+    if (format_id >= num_formats_.load(fbl::memory_order_acquire)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    const syslog::StructuredFormat& format = *formats_[format_id];
+
+    zx_status_t status;
+    int fd = logger_fd_.load(fbl::memory_order_relaxed);
+    if (fd != -1) {
+        status = VLogWriteToFd(fd, severity, nullptr, format.format.c_str(), args, true);
+    } else if (socket_.is_valid()) {
+        status = AppendStructured(severity, format_id, format, args);
+    } else {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (severity == FX_LOG_FATAL) {
+        abort();
+    }
+    return status;
+}
+
+syslog::LogBatch* fx_logger::GetBatch() {
+    syslog::LogBatch* batch = tls_batch.get();
+    if (unlikely(batch == nullptr)) {
+        fbl::AllocChecker ac;
+        tls_batch.reset(new (&ac) syslog::LogBatch);
+        if (!ac.check()) {
+            return nullptr;
+        }
+        batch = tls_batch.get();
+        batch->tid = GetCurrentThreadKoid();
+    }
+    if (unlikely(batch->logger.load(fbl::memory_order_relaxed) != this)) {
+        fbl::AutoLock lock(&g_batch_lock);
+        fx_logger* owner = batch->logger.load(fbl::memory_order_relaxed);
+        if (owner != nullptr) {
+            owner->SendBatchLocked(batch);
+            owner->DetachBatchLocked(batch);
+        }
+        batch->logger.store(this, fbl::memory_order_relaxed);
+        batches_.push_back(batch);
+    }
+    return batch;
+}
+
+zx_status_t fx_logger::AppendStructured(fx_log_severity_t severity, fx_log_format_id_t format_id,
+                                        const syslog::StructuredFormat& format, va_list args) {
+    using syslog::ArgKind;
+
+    syslog::LogBatch* batch = GetBatch();
+    if (batch == nullptr) {
+        dropped_logs_.fetch_add(1);
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    zx_time_t time = zx_clock_get_monotonic();
+    if (batch->size + syslog::RecordSize(format.max_args_size) > syslog::kBatchCapacity) {
+        Flush();
+    }
+    if (batch->size == 0) {
+        batch->start = time;
+    }
+
+    uint8_t* record = batch->data + batch->size;
+    uint8_t* arg = record + sizeof(fx_log_structured_record_t);
+    for (ArgKind kind : format.arg_kinds) {
+        uint64_t value;
+        switch (kind) {
+        case ArgKind::kInt:
+            value = static_cast<int64_t>(va_arg(args, int));
+            break;
+        case ArgKind::kUnsigned:
+            value = va_arg(args, unsigned int);
+            break;
+        case ArgKind::kLong:
+            value = static_cast<int64_t>(va_arg(args, long long));
+            break;
+        case ArgKind::kUnsignedLong:
+            value = va_arg(args, unsigned long long);
+            break;
+        case ArgKind::kPointer:
+            value = reinterpret_cast<uintptr_t>(va_arg(args, void*));
+            break;
+        case ArgKind::kDouble: {
+            double d = va_arg(args, double);
+            memcpy(&value, &d, sizeof(value));
+            break;
+        }
+        case ArgKind::kString: {
+            const char* str = va_arg(args, const char*);
+            if (str == nullptr) {
+                str = "(null)";
+            }
+            uint32_t len = static_cast<uint32_t>(strnlen(str, FX_LOG_MAX_STRUCTURED_STRING));
+            size_t size = syslog::StringArgSize(len);
+            memset(arg, 0, size);
+            memcpy(arg, &len, sizeof(len));
+            memcpy(arg + sizeof(len), str, len);
+            arg += size;
+            continue;
+        }
+        default:
+            ZX_DEBUG_ASSERT(false);
+            value = 0;
+            break;
+        }
+        memcpy(arg, &value, sizeof(value));
+        arg += sizeof(value);
+    }
+
+    fx_log_structured_record_t header;
+    header.time = time;
+    header.severity = severity;
+    header.format_id = format_id;
+    header.args_size = static_cast<uint32_t>(arg - record - sizeof(header));
+    header.reserved = 0;
+    memcpy(record, &header, sizeof(header));
+    batch->size += syslog::RecordSize(header.args_size);
+    batch->count++;
+
+    if (severity >= FX_LOG_WARNING || time - batch->start >= kBatchDelay) {
+        return Flush();
+    }
+    return ZX_OK;
+}
+
+zx_status_t fx_logger::Flush() {
+    syslog::LogBatch* batch = tls_batch.get();
+    if (batch == nullptr || batch->logger.load(fbl::memory_order_relaxed) != this ||
+        batch->size == 0) {
+        return ZX_OK;
+    }
+    fbl::AutoLock lock(&g_batch_lock);
+    return SendBatchLocked(batch);
+}
+
+zx_status_t fx_logger::SendBatchLocked(syslog::LogBatch* batch) {
+    if (batch->size == 0) {
+        return ZX_OK;
+    }
+
+    struct {
+        fx_log_structured_header_t header;
+        uint8_t data[syslog::kMaxTagsSize + syslog::kBatchCapacity];
+    } packet;
+    memset(&packet.header, 0, sizeof(packet.header));
+    packet.header.marker = ZX_KOID_INVALID;
+    packet.header.pid = pid_;
+    packet.header.tid = batch->tid;
+    packet.header.type = FX_LOG_STRUCTURED_RECORDS;
+    packet.header.dropped_logs = dropped_logs_.load();
+
+    // Write tags
+    size_t pos = 0;
+    for (size_t i = 0; i < tags_.size(); i++) {
+        size_t len = tags_[i].length();
+        ZX_DEBUG_ASSERT(len < 128);
+        packet.data[pos++] = static_cast<uint8_t>(len);
+        memcpy(packet.data + pos, tags_[i].c_str(), len);
+        pos += len;
+    }
+    packet.data[pos++] = 0;
+    while (pos % 8 != 0) {
+        packet.data[pos++] = 0;
+    }
+    ZX_DEBUG_ASSERT(pos <= syslog::kMaxTagsSize);
+    memcpy(packet.data + pos, batch->data, batch->size);
+    pos += batch->size;
+
+    zx_status_t status = ZX_ERR_BAD_STATE;
+    if (socket_.is_valid()) {
+        status = socket_.write(0, &packet, sizeof(packet.header) + pos, nullptr);
+    }
+    if (status == ZX_ERR_BAD_STATE || status == ZX_ERR_PEER_CLOSED) {
+        // Format the records here instead.
+        ActivateFallback(-1);
+        int fd = logger_fd_.load(fbl::memory_order_relaxed);
+        uint32_t num_formats = num_formats_.load(fbl::memory_order_acquire);
+        va_list empty_args;
+        for (size_t offset = 0; offset < batch->size;) {
+            fx_log_structured_record_t record;
+            memcpy(&record, batch->data + offset, sizeof(record));
+            if (record.format_id < num_formats) {
+                char msg[FX_LOG_MAX_DATAGRAM_LEN];
+                if (fx_log_format_structured(formats_[record.format_id]->format.c_str(),
+                                             batch->data + offset + sizeof(record),
+                                             record.args_size, msg, sizeof(msg)) >= 0) {
+                    status = VLogWriteToFd(fd, record.severity, nullptr, msg, empty_args, false);
+                }
+            }
+            offset += syslog::RecordSize(record.args_size);
+        }
+    } else if (status != ZX_OK) {
+        dropped_logs_.fetch_add(batch->count);
+    }
+    batch->size = 0;
+    batch->count = 0;
+    return status;
+}
+
+void fx_logger::DetachBatchLocked(syslog::LogBatch* batch) {
+    batches_.erase(*batch);
+    batch->logger.store(nullptr, fbl::memory_order_relaxed);
+}
+
 // This function is not thread safe
 zx_status_t fx_logger::AddTags(const char** tags, size_t ntags) {
     if (ntags > FX_LOG_MAX_TAGS) {
@@ -6,15 +6,21 @@
 #define ZIRCON_SYSTEM_ULIB_SYSLOG_FX_LOGGER_H_
 
 #include <lib/syslog/logger.h>
+#include <lib/syslog/wire_format.h>
 
+#include <fbl/atomic.h>
+#include <fbl/intrusive_double_list.h>
 #include <fbl/mutex.h>
 #include <fbl/string.h>
 #include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <lib/zx/process.h>
 #include <lib/zx/socket.h>
 #include <lib/zx/thread.h>
 
+#include "structured.h"
+
 namespace {
 
 zx_koid_t GetKoid(zx_handle_t handle) {
@@ -32,6 +38,42 @@ zx_koid_t GetCurrentProcessKoid() {
 
 } // namespace
 
+namespace syslog {
+
+// A format string registered for structured logging.
+struct StructuredFormat {
+    fbl::String format;
+    // The most bytes the arguments of one message can take on the wire.
+    size_t max_args_size;
+    fbl::Vector<ArgKind> arg_kinds;
+};
+
+// The bytes of records which fit in a datagram after its header and the most
+// tags a logger can have.
+constexpr size_t kMaxTagsSize =
+    (FX_LOG_MAX_TAGS * FX_LOG_MAX_TAG_LEN + 1 + 7) & ~static_cast<size_t>(7);
+constexpr size_t kBatchCapacity =
+    FX_LOG_MAX_DATAGRAM_LEN - sizeof(fx_log_structured_header_t) - kMaxTagsSize;
+
+// A thread's batch of structured records written to one logger.  Each thread
+// has one batch, which is moved to whichever logger the thread last wrote a
+// structured message to.
+struct LogBatch : public fbl::DoublyLinkedListable<LogBatch*> {
+    // Sends any records left in the batch.
+    ~LogBatch();
+
+    // The logger the records were written to, or nullptr.  Only changed with
+    // the batch lock held.
+    fbl::atomic<fx_logger*> logger{nullptr};
+    zx_koid_t tid = ZX_KOID_INVALID;
+    zx_time_t start = 0;
+    size_t size = 0;
+    uint32_t count = 0;
+    alignas(8) uint8_t data[kBatchCapacity];
+};
+
+} // namespace syslog
+
 struct fx_logger {
 public:
     // If tags or ntags are out of bound, this constructor will not fail but it
@@ -48,7 +90,8 @@ public:
         dropped_logs_.store(0, fbl::memory_order_relaxed);
     }
 
-    ~fx_logger() = default;
+    // Sends the batches of structured records written by every thread.
+    ~fx_logger();
 
     zx_status_t VLogWrite(fx_log_severity_t severity, const char* tag,
                           const char* format, va_list args) {
@@ -71,6 +114,20 @@ public:
 
     void ActivateFallback(int fallback_fd);
 
+    zx_status_t RegisterFormat(const char* format, fx_log_format_id_t* out_id);
+
+    zx_status_t VLogWriteStructured(fx_log_severity_t severity, fx_log_format_id_t format_id,
+                                    va_list args);
+
+    // Sends the calling thread's batch of structured records.
+    zx_status_t Flush();
+
+    // Sends |batch| and empties it.  The batch lock must be held.
+    zx_status_t SendBatchLocked(syslog::LogBatch* batch);
+
+    // Stops sending |batch| to this logger.  The batch lock must be held.
+    void DetachBatchLocked(syslog::LogBatch* batch);
+
 private:
     zx_status_t VLogWrite(fx_log_severity_t severity, const char* tag,
                           const char* format, va_list args, bool perform_format);
@@ -83,6 +140,12 @@ private:
 
     zx_status_t AddTags(const char** tags, size_t ntags);
 
+    zx_status_t AppendStructured(fx_log_severity_t severity, fx_log_format_id_t format_id,
+                                 const syslog::StructuredFormat& format, va_list args);
+
+    // Returns the calling thread's batch, moving it to this logger.
+    syslog::LogBatch* GetBatch();
+
     zx_koid_t pid_;
     fbl::atomic<fx_log_severity_t> severity_;
     fbl::atomic<uint32_t> dropped_logs_;
@@ -98,6 +161,15 @@ private:
     fbl::String tagstr_;
 
     fbl::Mutex fallback_mutex_;
+
+    // Formats are only added, with |formats_mutex_| held, and formats below
+    // |num_formats_| may be used without it.
+    fbl::Mutex formats_mutex_;
+    fbl::atomic<uint32_t> num_formats_{0};
+    fbl::unique_ptr<syslog::StructuredFormat> formats_[FX_LOG_MAX_FORMATS];
+
+    // Guarded by the batch lock.
+    fbl::DoublyLinkedList<syslog::LogBatch*> batches_;
 };
 
 #endif // ZIRCON_SYSTEM_ULIB_SYSLOG_FX_LOGGER_H_
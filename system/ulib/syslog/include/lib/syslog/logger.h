@@ -121,6 +121,45 @@ zx_status_t fx_logger_logvf(fx_logger_t* logger, fx_log_severity_t severity,
 zx_status_t fx_logger_log(fx_logger_t* logger, fx_log_severity_t severity,
                           const char* tag, const char* msg);
 
+// Identifies a format string registered with a logger for structured logging.
+typedef uint32_t fx_log_format_id_t;
+
+// Max no of format strings which may be registered with a logger.
+#define FX_LOG_MAX_FORMATS (1024)
+
+// Registers |format| with a logger for structured logging, and returns its id
+// in |out_id|.  |format| need not outlive this call.
+//
+// Structured formats may use the d, i, u, o, x, X, c, p, s, f, F, e, E, g, G,
+// a and A conversions with any flags, field width, precision and length
+// modifier, except that widths and precisions may not be '*' and long doubles
+// are not supported; ZX_ERR_INVALID_ARGS is returned otherwise, and if the
+// arguments of one message could take more than FX_LOG_MAX_STRUCTURED_ARGS
+// bytes on the wire.  ZX_ERR_NO_RESOURCES is returned once
+// |FX_LOG_MAX_FORMATS| formats have been registered.
+zx_status_t fx_logger_register_format(fx_logger_t* logger, const char* format,
+                                      fx_log_format_id_t* out_id);
+
+// Writes a structured message to a logger, with the arguments of the format
+// registered as |format_id|.
+// The message will be discarded if |severity| is less than the logger's
+// minimum log severity.
+//
+// When a logger writes to the log service, the message is not formatted by the
+// caller.  Its arguments are copied into a batch kept for the calling thread,
+// which is sent in one datagram once it is full, when a message of
+// |FX_LOG_WARNING| or more severe is written, when a message is written more
+// than 100ms after the first in the batch, when the thread exits, or by
+// fx_logger_flush().  The log service formats the messages.
+//
+// When a logger writes to a file descriptor, the message is formatted and
+// written immediately, as with fx_logger_logf().
+zx_status_t fx_logger_log_structured(fx_logger_t* logger, fx_log_severity_t severity,
+                                     fx_log_format_id_t format_id, ...);
+
+// Sends the calling thread's batch of structured messages written to a logger.
+zx_status_t fx_logger_flush(fx_logger_t* logger);
+
 __END_CDECLS
 
 #endif // LIB_SYSLOG_LOGGER_H_
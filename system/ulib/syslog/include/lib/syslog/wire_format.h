@@ -35,4 +35,60 @@ typedef struct fx_log_packet {
     char data[FX_LOG_MAX_DATAGRAM_LEN - sizeof(fx_log_metadata_t)];
 } fx_log_packet_t;
 
+// Structured logging.
+//
+// Rather than formatting each message itself, a writer may register a format
+// string once and then send only its id and raw arguments with each message,
+// leaving formatting to the reader.  Registrations and batches of records are
+// sent in their own datagrams, which begin with an
+// fx_log_structured_header_t.  Its |marker| is where an fx_log_packet_t has
+// its pid, and is always ZX_KOID_INVALID, which no process has.
+#define FX_LOG_STRUCTURED_FORMAT (1)
+#define FX_LOG_STRUCTURED_RECORDS (2)
+
+typedef struct fx_log_structured_header {
+    zx_koid_t marker;
+    zx_koid_t pid;
+    zx_koid_t tid;
+    uint32_t type;
+    uint32_t dropped_logs;
+} fx_log_structured_header_t;
+
+// FX_LOG_STRUCTURED_FORMAT datagrams follow the header with a uint32_t id,
+// and then the format string and a null terminating character.  Ids are
+// assigned in order, starting at 0, for each socket.
+//
+// FX_LOG_STRUCTURED_RECORDS datagrams follow the header with the logger's
+// tags, encoded as in an fx_log_packet_t and padded to a multiple of 8 bytes,
+// and then with records written by the thread |tid|.  Each record is an
+// fx_log_structured_record_t followed by |args_size| bytes of arguments,
+// padded to a multiple of 8 bytes.
+typedef struct fx_log_structured_record {
+    zx_time_t time;
+    fx_log_severity_t severity;
+    uint32_t format_id;
+    uint32_t args_size;
+    uint32_t reserved;
+} fx_log_structured_record_t;
+
+// Arguments are encoded in the order of the format's conversions.  Integers,
+// characters and pointers are sent as 64-bit integers, and floating point
+// numbers as doubles.  Strings are sent as a uint32_t length followed by that
+// many bytes, padded to a multiple of 8 bytes, and are truncated to
+// FX_LOG_MAX_STRUCTURED_STRING bytes.  The arguments of one message never
+// take more than FX_LOG_MAX_STRUCTURED_ARGS bytes.
+#define FX_LOG_MAX_STRUCTURED_STRING (256)
+#define FX_LOG_MAX_STRUCTURED_ARGS (1024)
+
+__BEGIN_CDECLS
+
+// Formats the |args_size| bytes of arguments at |args| with |format| into
+// |out|, which is always null terminated and is truncated if the message
+// doesn't fit.  Returns the length written, or -1 if the arguments are not
+// those of |format|.
+int fx_log_format_structured(const char* format, const void* args,
+                             size_t args_size, char* out, size_t out_size);
+
+__END_CDECLS
+
 #endif // LIB_SYSLOG_WIRE_FORMAT_H_
@@ -69,6 +69,33 @@ zx_status_t fx_vlogf(fx_logger_t* logger, fx_log_severity_t severity,
     return logger->VLogWrite(severity, tag, format, args);
 }
 
+zx_status_t fx_logger_register_format(fx_logger_t* logger, const char* format,
+                                      fx_log_format_id_t* out_id) {
+    if (logger == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    return logger->RegisterFormat(format, out_id);
+}
+
+zx_status_t fx_logger_log_structured(fx_logger_t* logger, fx_log_severity_t severity,
+                                     fx_log_format_id_t format_id, ...) {
+    if (logger == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    va_list args;
+    va_start(args, format_id);
+    zx_status_t s = logger->VLogWriteStructured(severity, format_id, args);
+    va_end(args);
+    return s;
+}
+
+zx_status_t fx_logger_flush(fx_logger_t* logger) {
+    if (logger == nullptr) {
+        return ZX_ERR_BAD_STATE;
+    }
+    return logger->Flush();
+}
+
 fx_log_severity_t fx_logger_get_min_severity(fx_logger_t* logger) {
     if (logger == nullptr) {
         return FX_LOG_FATAL;
@@ -13,6 +13,8 @@ MODULE_SRCS = \
     $(LOCAL_DIR)/fx_logger.cpp \
     $(LOCAL_DIR)/global.cpp \
     $(LOCAL_DIR)/logger.cpp \
+    $(LOCAL_DIR)/structured.h \
+    $(LOCAL_DIR)/structured.cpp \
 
 MODULE_EXPORT := so
 MODULE_SO_NAME := syslog
@@ -0,0 +1,220 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <lib/syslog/wire_format.h>
+
+#include "structured.h"
+
+namespace syslog {
+
+const char* NextConversion(const char* format, const char** conversion, ArgKind* kind) {
+    format = strchr(format, '%');
+    if (format == nullptr) {
+        return nullptr;
+    }
+    *conversion = format++;
+
+    // Flags, field width and precision.
+    while (*format != '\0' && strchr("-+ #0123456789.", *format) != nullptr) {
+        format++;
+    }
+
+    // Length modifiers.  size_t, intmax_t and ptrdiff_t are all as wide as
+    // long on the platforms we run on.
+    bool is_long = false;
+    bool is_long_double = false;
+    while (*format != '\0' && strchr("hlLqjzt", *format) != nullptr) {
+        is_long |= (*format != 'h');
+        is_long_double |= (*format == 'L');
+        format++;
+    }
+
+    switch (*format) {
+    case 'd':
+    case 'i':
+        *kind = is_long ? ArgKind::kLong : ArgKind::kInt;
+        break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+        *kind = is_long ? ArgKind::kUnsignedLong : ArgKind::kUnsigned;
+        break;
+    case 'c':
+        *kind = is_long ? ArgKind::kInvalid : ArgKind::kInt;
+        break;
+    case 'p':
+        *kind = ArgKind::kPointer;
+        break;
+    case 's':
+        *kind = is_long ? ArgKind::kInvalid : ArgKind::kString;
+        break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+        *kind = is_long_double ? ArgKind::kInvalid : ArgKind::kDouble;
+        break;
+    case '%':
+        *kind = (format == *conversion + 1) ? ArgKind::kNone : ArgKind::kInvalid;
+        break;
+    case '\0':
+        *kind = ArgKind::kInvalid;
+        return format;
+    default:
+        *kind = ArgKind::kInvalid;
+        break;
+    }
+    format++;
+    if (static_cast<size_t>(format - *conversion) > kMaxConversionLen) {
+        *kind = ArgKind::kInvalid;
+    }
+    return format;
+}
+
+} // namespace syslog
+
+namespace {
+
+// Appends to a fixed buffer, truncating what doesn't fit.
+class Output {
+public:
+    Output(char* out, size_t size)
+        : out_(out), size_(size) {
+        out_[0] = '\0';
+    }
+
+    size_t length() const { return pos_; }
+
+    void Append(const char* str, size_t len) {
+        len = fbl::min(len, size_ - 1 - pos_);
+        memcpy(out_ + pos_, str, len);
+        pos_ += len;
+        out_[pos_] = '\0';
+    }
+
+    template <typename T>
+    void AppendPrintf(const char* conversion, T value) {
+        int n = snprintf(out_ + pos_, size_ - pos_, conversion, value);
+        if (n > 0) {
+            pos_ += fbl::min(static_cast<size_t>(n), size_ - 1 - pos_);
+        }
+    }
+
+private:
+    char* const out_;
+    const size_t size_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+int fx_log_format_structured(const char* format, const void* args,
+                             size_t args_size, char* out, size_t out_size) {
+    using syslog::ArgKind;
+
+    if (out_size == 0) {
+        return -1;
+    }
+    Output output(out, out_size);
+    const uint8_t* arg = static_cast<const uint8_t*>(args);
+    const uint8_t* args_end = arg + args_size;
+
+    const char* conversion;
+    ArgKind kind;
+    const char* next;
+    while ((next = syslog::NextConversion(format, &conversion, &kind)) != nullptr) {
+        output.Append(format, conversion - format);
+        format = next;
+        if (kind == ArgKind::kNone) {
+            output.Append("%", 1);
+            continue;
+        }
+        if (kind == ArgKind::kInvalid) {
+            return -1;
+        }
+
+        // Every argument is formatted as the widest of its kind, so the
+        // conversion is rebuilt without its length modifiers.
+        char spec[syslog::kMaxConversionLen + 3];
+        size_t spec_len = 0;
+        for (const char* c = conversion; c < next - 1; c++) {
+            if (strchr("hlLqjzt", *c) == nullptr) {
+                spec[spec_len++] = *c;
+            }
+        }
+        bool is_integer = (kind == ArgKind::kInt || kind == ArgKind::kUnsigned ||
+                           kind == ArgKind::kLong || kind == ArgKind::kUnsignedLong);
+        if (is_integer && next[-1] != 'c') {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+        }
+        spec[spec_len++] = next[-1];
+        spec[spec_len] = '\0';
+
+        if (kind == ArgKind::kString) {
+            uint32_t len;
+            if (args_end - arg < static_cast<ptrdiff_t>(sizeof(len))) {
+                return -1;
+            }
+            memcpy(&len, arg, sizeof(len));
+            size_t size = syslog::StringArgSize(len);
+            if (len > FX_LOG_MAX_STRUCTURED_STRING ||
+                args_end - arg < static_cast<ptrdiff_t>(size)) {
+                return -1;
+            }
+            char str[FX_LOG_MAX_STRUCTURED_STRING + 1];
+            memcpy(str, arg + sizeof(len), len);
+            str[len] = '\0';
+            output.AppendPrintf(spec, str);
+            arg += size;
+            continue;
+        }
+
+        uint64_t value;
+        if (args_end - arg < static_cast<ptrdiff_t>(sizeof(value))) {
+            return -1;
+        }
+        memcpy(&value, arg, sizeof(value));
+        arg += sizeof(value);
+        switch (kind) {
+        case ArgKind::kInt:
+        case ArgKind::kLong:
+            if (next[-1] == 'c') {
+                output.AppendPrintf(spec, static_cast<int>(value));
+            } else {
+                output.AppendPrintf(spec, static_cast<long long>(value));
+            }
+            break;
+        case ArgKind::kUnsigned:
+        case ArgKind::kUnsignedLong:
+            output.AppendPrintf(spec, static_cast<unsigned long long>(value));
+            break;
+        case ArgKind::kPointer:
+            output.AppendPrintf(spec, reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+            break;
+        case ArgKind::kDouble: {
+            double d;
+            memcpy(&d, &value, sizeof(d));
+            output.AppendPrintf(spec, d);
+            break;
+        }
+        default:
+            return -1;
+        }
+    }
+    output.Append(format, strlen(format));
+    if (arg != args_end) {
+        return -1;
+    }
+    return static_cast<int>(output.length());
+}
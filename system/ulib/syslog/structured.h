@@ -0,0 +1,50 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ZIRCON_SYSTEM_ULIB_SYSLOG_STRUCTURED_H_
+#define ZIRCON_SYSTEM_ULIB_SYSLOG_STRUCTURED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <lib/syslog/wire_format.h>
+
+namespace syslog {
+
+// The kind of argument taken by a conversion of a structured format.
+enum class ArgKind : uint8_t {
+    kNone,      // "%%", which takes no argument
+    kInvalid,   // a conversion structured logging can't carry
+    kInt,
+    kUnsigned,
+    kLong,
+    kUnsignedLong,
+    kPointer,
+    kDouble,
+    kString,
+};
+
+// The longest conversion, from its '%' to its conversion character, in a
+// structured format.
+constexpr size_t kMaxConversionLen = 32;
+
+// Finds the next conversion in |format|.  On return, |*conversion| points at
+// its '%' and |*kind| is the argument it takes, and the conversion ends just
+// before the returned pointer.  Returns nullptr if there are none left.
+const char* NextConversion(const char* format, const char** conversion, ArgKind* kind);
+
+// The size, including padding, of a string of |len| bytes as an argument.
+constexpr size_t StringArgSize(size_t len) {
+    return (sizeof(uint32_t) + len + 7) & ~static_cast<size_t>(7);
+}
+
+// The size, including padding, of a record with |args_size| bytes of
+// arguments.
+constexpr size_t RecordSize(size_t args_size) {
+    return sizeof(fx_log_structured_record_t) + ((args_size + 7) & ~static_cast<size_t>(7));
+}
+
+} // namespace syslog
+
+#endif // ZIRCON_SYSTEM_ULIB_SYSLOG_STRUCTURED_H_
@@ -21,6 +21,7 @@ MODULE_HEADER_DEPS := \
 
 MODULE_STATIC_LIBS := \
     system/ulib/async \
+    system/ulib/async.cpp \
     system/ulib/fidl \
     system/ulib/fbl \
     system/ulib/zx \
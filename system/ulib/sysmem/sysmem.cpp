@@ -5,8 +5,13 @@
 #include <lib/sysmem/sysmem.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/unique_ptr.h>
 #include <fuchsia/sysmem/c/fidl.h>
+#include <lib/async/cpp/wait.h>
 #include <lib/fidl/bind.h>
+#include <lib/zx/eventpair.h>
 #include <lib/zx/vmo.h>
 #include <string.h>
 #include <lib/syslog/global.h>
@@ -112,6 +117,186 @@ zx_status_t PickImageFormat(const fuchsia_sysmem_BufferSpec& spec,
     return ZX_OK;
 }
 
+constexpr uint32_t kMaxBufferCount = 64;
+static_assert(sizeof(fuchsia_sysmem_BufferCollectionInfo::vmos) ==
+              kMaxBufferCount * sizeof(zx_handle_t), "");
+
+// The rights given to the VMOs of a participant in a shared collection.  Only
+// participants whose usage may write to the buffers may write to them.
+zx_rights_t VmoRightsForUsage(const fuchsia_sysmem_BufferUsage& usage) {
+    zx_rights_t rights = ZX_RIGHTS_BASIC | ZX_RIGHTS_PROPERTY | ZX_RIGHT_READ | ZX_RIGHT_MAP;
+    constexpr uint32_t kVulkanWriteUsages =
+        fuchsia_sysmem_vulkanUsageTransferDst | fuchsia_sysmem_vulkanUsageStorage |
+        fuchsia_sysmem_vulkanUsageColorAttachment | fuchsia_sysmem_vulkanUsageStencilAttachment |
+        fuchsia_sysmem_vulkanUsageTransientAttachment;
+    if ((usage.cpu & (fuchsia_sysmem_cpuUsageWrite | fuchsia_sysmem_cpuUsageWriteOften)) ||
+        (usage.vulkan & kVulkanWriteUsages) ||
+        (usage.video & fuchsia_sysmem_videoUsageHwDecoder)) {
+        rights |= ZX_RIGHT_WRITE;
+    }
+    return rights;
+}
+
+// Returns the koid of the token end of an eventpair, given either end.
+zx_koid_t GetTokenKoid(const zx::eventpair& handle, bool is_peer) {
+    zx_info_handle_basic_t info;
+    if (handle.get_info(ZX_INFO_HANDLE_BASIC, &info, sizeof(info), nullptr, nullptr) != ZX_OK) {
+        return ZX_KOID_INVALID;
+    }
+    return is_peer ? info.related_koid : info.koid;
+}
+
+// A BindSharedCollection() call, which is answered once its collection has
+// been allocated.
+class Participant : public fbl::DoublyLinkedListable<fbl::unique_ptr<Participant>> {
+public:
+    Participant(const fuchsia_sysmem_BufferUsage& usage, zx::eventpair token,
+                zx_koid_t token_koid)
+        : usage_(usage), token_(fbl::move(token)), token_koid_(token_koid) {}
+    ~Participant() { ZX_DEBUG_ASSERT(txn_ == nullptr); }
+
+    void set_txn(fidl_async_txn_t* txn) { txn_ = txn; }
+    zx_koid_t token_koid() const { return token_koid_; }
+    const fuchsia_sysmem_BufferUsage& usage() const { return usage_; }
+
+    // Waits for the collection's coordinator to go away before it ever
+    // called AllocateSharedCollection().
+    zx_status_t WaitForCoordinator(async_dispatcher_t* dispatcher) {
+        wait_.set_object(token_.get());
+        wait_.set_trigger(ZX_EVENTPAIR_PEER_CLOSED);
+        return wait_.Begin(dispatcher);
+    }
+
+    // Once matched with its collection, the participant's token is closed,
+    // so that the collection sees when the last of them is gone.
+    void OnMatched() {
+        wait_.Cancel();
+        token_.reset();
+    }
+
+    void Reply(zx_status_t status, fuchsia_sysmem_BufferCollectionInfo* info) {
+        fuchsia_sysmem_AllocatorBindSharedCollection_reply(fidl_async_txn_borrow(txn_),
+                                                           status, info);
+        fidl_async_txn_complete(txn_, true);
+        txn_ = nullptr;
+    }
+
+private:
+    void OnCoordinatorGone(async_dispatcher_t* dispatcher, async::WaitBase* wait,
+                           zx_status_t status, const zx_packet_signal_t* signal);
+
+    const fuchsia_sysmem_BufferUsage usage_;
+    zx::eventpair token_;
+    const zx_koid_t token_koid_;
+    fidl_async_txn_t* txn_ = nullptr;
+    async::WaitMethod<Participant, &Participant::OnCoordinatorGone> wait_{this};
+};
+
+// An AllocateSharedCollection() call, with the participants matched with it
+// so far.  The buffers are allocated once every token has been closed.
+class SharedCollection : public fbl::DoublyLinkedListable<fbl::unique_ptr<SharedCollection>> {
+public:
+    SharedCollection(uint32_t buffer_count, const fuchsia_sysmem_BufferSpec& spec,
+                     zx::eventpair token_peer, zx_koid_t token_koid)
+        : buffer_count_(buffer_count), spec_(spec), token_peer_(fbl::move(token_peer)),
+          token_koid_(token_koid) {}
+    ~SharedCollection() { ZX_DEBUG_ASSERT(txn_ == nullptr); }
+
+    void set_txn(fidl_async_txn_t* txn) { txn_ = txn; }
+    zx_koid_t token_koid() const { return token_koid_; }
+
+    void AddParticipant(fbl::unique_ptr<Participant> participant) {
+        participant->OnMatched();
+        participants_.push_back(fbl::move(participant));
+    }
+
+    zx_status_t WaitForTokens(async_dispatcher_t* dispatcher) {
+        wait_.set_object(token_peer_.get());
+        wait_.set_trigger(ZX_EVENTPAIR_PEER_CLOSED);
+        return wait_.Begin(dispatcher);
+    }
+
+    // Allocates the buffers unless |status| is already an error, and answers
+    // the coordinator and every participant.
+    void Complete(zx_status_t status);
+
+private:
+    void OnTokensClosed(async_dispatcher_t* dispatcher, async::WaitBase* wait,
+                        zx_status_t status, const zx_packet_signal_t* signal);
+
+    const uint32_t buffer_count_;
+    const fuchsia_sysmem_BufferSpec spec_;
+    zx::eventpair token_peer_;
+    const zx_koid_t token_koid_;
+    fidl_async_txn_t* txn_ = nullptr;
+    fbl::DoublyLinkedList<fbl::unique_ptr<Participant>> participants_;
+    async::WaitMethod<SharedCollection, &SharedCollection::OnTokensClosed> wait_{this};
+};
+
+// Shared collections waiting for their tokens to be closed, and participants
+// whose collections have not been allocated yet.  Both are only touched from
+// the service's dispatcher.
+fbl::DoublyLinkedList<fbl::unique_ptr<SharedCollection>> pending_collections;
+fbl::DoublyLinkedList<fbl::unique_ptr<Participant>> unmatched_participants;
+
+void Participant::OnCoordinatorGone(async_dispatcher_t* dispatcher, async::WaitBase* wait,
+                                    zx_status_t status, const zx_packet_signal_t* signal) {
+    fbl::unique_ptr<Participant> self = unmatched_participants.erase(*this);
+    fuchsia_sysmem_BufferCollectionInfo info;
+    memset(&info, 0, sizeof(info));
+    self->Reply(ZX_ERR_PEER_CLOSED, &info);
+}
+
+void SharedCollection::OnTokensClosed(async_dispatcher_t* dispatcher, async::WaitBase* wait,
+                                      zx_status_t status, const zx_packet_signal_t* signal) {
+    fbl::unique_ptr<SharedCollection> self = pending_collections.erase(*this);
+    self->Complete(status);
+}
+
+void SharedCollection::Complete(zx_status_t status) {
+    fuchsia_sysmem_BufferCollectionInfo info;
+    memset(&info, 0, sizeof(info));
+
+    // Every participant shares the same buffers, so the format and size
+    // come from the coordinator's spec alone.
+    if (status == ZX_OK) {
+        status = PickImageFormat(spec_, &info.format.image, &info.vmo_size);
+    }
+    zx::vmo vmos[kMaxBufferCount];
+    for (uint32_t i = 0; (status == ZX_OK) && (i < buffer_count_); ++i) {
+        if (zx::vmo::create(info.vmo_size, 0, &vmos[i]) != ZX_OK) {
+            FX_LOG(ERROR, kTag, "Failed to allocate shared Buffer Collection\n");
+            status = ZX_ERR_NO_MEMORY;
+        }
+    }
+    if (status == ZX_OK) {
+        info.buffer_count = buffer_count_;
+    }
+
+    while (!participants_.is_empty()) {
+        fbl::unique_ptr<Participant> participant = participants_.pop_front();
+        fuchsia_sysmem_BufferCollectionInfo participant_info = info;
+        zx_status_t participant_status = status;
+        zx_rights_t rights = VmoRightsForUsage(participant->usage());
+        for (uint32_t i = 0; (participant_status == ZX_OK) && (i < info.buffer_count); ++i) {
+            zx::vmo vmo;
+            participant_status = vmos[i].duplicate(rights, &vmo);
+            participant_info.vmos[i] = vmo.release();
+        }
+        if (participant_status != ZX_OK) {
+            for (uint32_t i = 0; i < info.buffer_count; ++i) {
+                zx_handle_close(participant_info.vmos[i]);
+            }
+            memset(&participant_info, 0, sizeof(participant_info));
+        }
+        participant->Reply(participant_status, &participant_info);
+    }
+
+    fuchsia_sysmem_AllocatorAllocateSharedCollection_reply(fidl_async_txn_borrow(txn_), status);
+    fidl_async_txn_complete(txn_, true);
+    txn_ = nullptr;
+}
+
 } // namespace
 
 static zx_status_t Allocator_AllocateCollection(void* ctx,
@@ -152,21 +337,84 @@ static zx_status_t Allocator_AllocateCollection(void* ctx,
     return fuchsia_sysmem_AllocatorAllocateCollection_reply(txn, ZX_OK, &info);
 }
 
+// Shared collections are matched with their participants by the koid of
+// the token end of the eventpair, which every duplicate of the token shares.
+// Participants may bind before or after their coordinator's call arrives.
 static zx_status_t Allocator_AllocateSharedCollection(void* ctx,
                                                       uint32_t buffer_count,
                                                       const fuchsia_sysmem_BufferSpec* spec,
-                                                      zx_handle_t token_peer,
+                                                      zx_handle_t token_peer_handle,
                                                       fidl_txn_t* txn) {
-    return fuchsia_sysmem_AllocatorAllocateSharedCollection_reply(txn, ZX_ERR_NOT_SUPPORTED);
+    auto dispatcher = static_cast<async_dispatcher_t*>(ctx);
+    zx::eventpair token_peer(token_peer_handle);
+    zx_koid_t token_koid = GetTokenKoid(token_peer, true);
+    if ((buffer_count == 0) || (buffer_count > kMaxBufferCount) ||
+        (token_koid == ZX_KOID_INVALID)) {
+        return fuchsia_sysmem_AllocatorAllocateSharedCollection_reply(txn, ZX_ERR_INVALID_ARGS);
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<SharedCollection> collection(new (&ac) SharedCollection(
+        buffer_count, *spec, fbl::move(token_peer), token_koid));
+    if (!ac.check()) {
+        return fuchsia_sysmem_AllocatorAllocateSharedCollection_reply(txn, ZX_ERR_NO_MEMORY);
+    }
+    collection->set_txn(fidl_async_txn_create(txn));
+
+    for (auto iter = unmatched_participants.begin(); iter != unmatched_participants.end();) {
+        auto participant = iter++;
+        if (participant->token_koid() == token_koid) {
+            collection->AddParticipant(unmatched_participants.erase(participant));
+        }
+    }
+
+    zx_status_t status = collection->WaitForTokens(dispatcher);
+    if (status != ZX_OK) {
+        collection->Complete(status);
+        return ZX_ERR_ASYNC;
+    }
+    pending_collections.push_back(fbl::move(collection));
+    return ZX_ERR_ASYNC;
 }
 
 static zx_status_t Allocator_BindSharedCollection(void* ctx,
                                                   const fuchsia_sysmem_BufferUsage* usage,
-                                                  zx_handle_t token,
+                                                  zx_handle_t token_handle,
                                                   fidl_txn_t* txn) {
-    fuchsia_sysmem_BufferCollectionInfo info;
-    memset(&info, 0, sizeof(info));
-    return fuchsia_sysmem_AllocatorBindSharedCollection_reply(txn, ZX_ERR_NOT_SUPPORTED, &info);
+    auto dispatcher = static_cast<async_dispatcher_t*>(ctx);
+    zx::eventpair token(token_handle);
+    zx_koid_t token_koid = GetTokenKoid(token, false);
+    if (token_koid == ZX_KOID_INVALID) {
+        fuchsia_sysmem_BufferCollectionInfo info;
+        memset(&info, 0, sizeof(info));
+        return fuchsia_sysmem_AllocatorBindSharedCollection_reply(txn, ZX_ERR_INVALID_ARGS, &info);
+    }
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<Participant> participant(new (&ac) Participant(
+        *usage, fbl::move(token), token_koid));
+    if (!ac.check()) {
+        fuchsia_sysmem_BufferCollectionInfo info;
+        memset(&info, 0, sizeof(info));
+        return fuchsia_sysmem_AllocatorBindSharedCollection_reply(txn, ZX_ERR_NO_MEMORY, &info);
+    }
+    participant->set_txn(fidl_async_txn_create(txn));
+
+    for (auto& collection : pending_collections) {
+        if (collection.token_koid() == token_koid) {
+            collection.AddParticipant(fbl::move(participant));
+            return ZX_ERR_ASYNC;
+        }
+    }
+
+    if (participant->WaitForCoordinator(dispatcher) != ZX_OK) {
+        fuchsia_sysmem_BufferCollectionInfo info;
+        memset(&info, 0, sizeof(info));
+        participant->Reply(ZX_ERR_BAD_STATE, &info);
+        return ZX_ERR_ASYNC;
+    }
+    unmatched_participants.push_back(fbl::move(participant));
+    return ZX_ERR_ASYNC;
 }
 
 static constexpr const fuchsia_sysmem_Allocator_ops_t allocator_ops = {
@@ -180,7 +428,7 @@ static zx_status_t connect(void* ctx, async_dispatcher_t* dispatcher,
     if (!strcmp(service_name, fuchsia_sysmem_Allocator_Name)) {
         return fidl_bind(dispatcher, request,
                          (fidl_dispatch_t*)fuchsia_sysmem_Allocator_dispatch,
-                         ctx, &allocator_ops);
+                         dispatcher, &allocator_ops);
     }
 
     zx_handle_close(request);
@@ -235,6 +235,14 @@ void tftp_session_set_max_timeouts(tftp_session* session,
 void tftp_session_set_opcode_prefix_use(tftp_session* session,
                                         bool enable);
 
+// Gives a receiving session |size| bytes at |buffer| in which to hold DATA
+// blocks that arrive after one which was lost. Once the lost block is sent
+// again, they are written in order, and acknowledged at once, so that the
+// sender only retransmits what was lost rather than the rest of its window.
+// Blocks are still written to the file interface in order. The buffer must
+// outlive the session, and may be reused by the next one.
+void tftp_session_set_reorder_buffer(tftp_session* session, void* buffer, size_t size);
+
 // When acting as a server, the options that will be overridden when a
 // value is requested by the client. Note that if the client does not
 // specify a setting, the default will be used regardless of server
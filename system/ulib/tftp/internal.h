@@ -49,6 +49,14 @@ typedef struct tftp_data_msg_t {
 #define DEFAULT_MAX_TIMEOUTS 5
 #define DEFAULT_USE_OPCODE_PREFIX true
 
+// A slot of the reorder buffer, holding DATA block |block| (or none, if 0)
+// until the blocks before it have been written.
+typedef struct tftp_reorder_slot_t {
+    uint64_t block;
+    size_t len;
+    uint8_t data[0];
+} tftp_reorder_slot;
+
 typedef struct tftp_options_t {
     // A bitmask of the options that have been set
     uint8_t mask;
@@ -172,6 +180,14 @@ struct tftp_session_t {
     // no-no in IPv6). This modification is not RFC-compatible.
     bool use_opcode_prefix;
 
+    // Blocks received ahead of a lost one; see tftp_session_set_reorder_buffer().
+    // While a gap is being filled, |gap_acked| is the block whose ACK reported
+    // it, so that the rest of the window doesn't each send it again.
+    uint8_t* reorder_buf;
+    size_t reorder_buf_sz;
+    bool gap_reported;
+    uint64_t gap_acked;
+
     // "Negotiated" values
     size_t file_size;
     uint16_t window_size;
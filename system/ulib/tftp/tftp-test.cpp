@@ -1362,6 +1362,84 @@ static bool test_tftp_receive_data_windowsize_skipped_block(void) {
     END_TEST;
 }
 
+static bool test_tftp_receive_data_reorder(void) {
+    BEGIN_TEST;
+
+    test_state ts;
+    ts.reset(1024, 2048, 1500);
+    uint8_t reorder_buf[4096];
+    tftp_session_set_reorder_buffer(ts.session, reorder_buf, sizeof(reorder_buf));
+    tftp_file_interface ifc = {NULL,
+            [](const char* filename, size_t size, void* cookie) -> tftp_status {
+                EXPECT_STR_EQ(filename, kRemoteFilename, "bad filename");
+                EXPECT_EQ(size, 2048, "bad file size");
+                return 0;
+            }, NULL, NULL, NULL};
+    tftp_session_set_file_interface(ts.session, &ifc);
+
+    char req_buf[256];
+    req_buf[0] = 0x00;
+    req_buf[1] = OPCODE_WRQ;
+    size_t req_buf_sz = 2 + snprintf(&req_buf[2], sizeof(req_buf) - 2,
+                                     "%s%cOCTET%cTSIZE%c%d%cWINDOWSIZE%c%d",
+                                     kRemoteFilename, '\0', '\0', '\0', 2048, '\0', '\0', 4)
+                          + 1;
+
+    ASSERT_LT(req_buf_sz, (int)sizeof(req_buf), "insufficient space for WRQ message");
+    auto status = tftp_process_msg(ts.session, req_buf, req_buf_sz, ts.out, &ts.outlen,
+                                   &ts.timeout, nullptr);
+    ASSERT_EQ(TFTP_NO_ERROR, status, "receive write request failed");
+    ASSERT_TRUE(verify_response_opcode(ts, OPCODE_OACK), "bad response");
+
+    // The first byte of each block is its number.
+    uint8_t data_buf[516] = {
+        0x00, 0x03,  // Opcode (DATA)
+        0x00, 0x01,  // Block
+        0x01,
+    };
+
+    ifc.write = mock_write;
+    tftp_session_set_file_interface(ts.session, &ifc);
+
+    tx_test_data td;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    EXPECT_EQ(0, ts.outlen, "no response expected");
+    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+
+    // Block 2 is lost. Block 3 is held, and reports the gap.
+    data_buf[3] = data_buf[4] = 3u;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    ASSERT_TRUE(verify_response_opcode(ts, OPCODE_ACK), "bad response");
+    auto msg = reinterpret_cast<tftp_data_msg*>(ts.out);
+    EXPECT_EQ(ntohs(msg->block), 1, "bad block number");
+    EXPECT_EQ(0, td.actual.data[1024], "block 3 should not be written yet");
+
+    // Block 4 is held without acknowledging the gap again.
+    data_buf[3] = data_buf[4] = 4u;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    EXPECT_EQ(0, ts.outlen, "no response expected");
+    EXPECT_EQ(1, ts.session->block_number, "tftp session block number mismatch");
+
+    // Once block 2 is sent again, the held blocks follow it, and all of them
+    // are acknowledged at once.
+    data_buf[3] = data_buf[4] = 2u;
+    status = tftp_process_msg(ts.session, data_buf, sizeof(data_buf), ts.out, &ts.outlen, &ts.timeout, &td);
+    EXPECT_EQ(TFTP_NO_ERROR, status, "receive data failed");
+    ASSERT_TRUE(verify_response_opcode(ts, OPCODE_ACK), "bad response");
+    msg = reinterpret_cast<tftp_data_msg*>(ts.out);
+    EXPECT_EQ(ntohs(msg->block), 4, "bad block number");
+    EXPECT_EQ(4, ts.session->block_number, "tftp session block number mismatch");
+    EXPECT_EQ(0, ts.session->window_index, "tftp session window index mismatch");
+    EXPECT_EQ(2, td.actual.data[512], "bad write data");
+    EXPECT_EQ(3, td.actual.data[1024], "bad write data");
+    EXPECT_EQ(4, td.actual.data[1536], "bad write data");
+
+    END_TEST;
+}
+
 namespace {
 
 constexpr const unsigned long kWrapAt = 0x3ffff;
@@ -2044,6 +2122,7 @@ RUN_TEST(test_tftp_receive_data_blocksize)
 RUN_TEST(test_tftp_receive_data_windowsize)
 RUN_TEST(test_tftp_receive_data_skipped_block)
 RUN_TEST(test_tftp_receive_data_windowsize_skipped_block)
+RUN_TEST(test_tftp_receive_data_reorder)
 RUN_TEST(test_tftp_receive_data_block_wrapping)
 END_TEST_CASE(tftp_receive_data)
 
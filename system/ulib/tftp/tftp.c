@@ -179,6 +179,14 @@ static void set_error(tftp_session* session, uint16_t err_code, void* resp_buf,
     session->state = ERROR;
 }
 
+// Forgets the blocks held by any earlier session which shared the buffer.
+static void reset_reorder_buffer(tftp_session* session) {
+    if (session->reorder_buf) {
+        memset(session->reorder_buf, 0, session->reorder_buf_sz);
+    }
+    session->gap_reported = false;
+}
+
 tftp_status tx_data(tftp_session* session, tftp_data_msg* resp, size_t* outlen, void* cookie) {
     session->offset = (session->block_number + session->window_index) * session->block_size;
     *outlen = 0;
@@ -310,6 +318,9 @@ tftp_status tftp_generate_request(tftp_session* session,
     session->block_size = DEFAULT_BLOCKSIZE;
     session->timeout = DEFAULT_TIMEOUT;
     session->window_size = DEFAULT_WINDOWSIZE;
+    if (direction == RECV_FILE) {
+        reset_reorder_buffer(session);
+    }
 
     tftp_msg* ack = outgoing;
     OPCODE(session, ack, (direction == SEND_FILE) ? OPCODE_WRQ : OPCODE_RRQ);
@@ -558,6 +569,7 @@ tftp_status tftp_handle_request(tftp_session* session,
     // Open file, if we haven't already
     if (session->state == NONE) {
         if (direction == RECV_FILE) {
+            reset_reorder_buffer(session);
             if (!session->file_interface.open_write) {
                 xprintf("Unable to service write request: no open_write implementation\n");
                 set_error(session, TFTP_ERR_CODE_UNDEF, resp, resp_len, "internal error");
@@ -688,6 +700,40 @@ static void tftp_prepare_ack(tftp_session* session,
     *msg_len = sizeof(*ack_data);
 }
 
+// The slot of the reorder buffer which may hold |block|, or NULL if there is
+// no room for blocks of the session's size.
+static tftp_reorder_slot* reorder_slot(tftp_session* session, uint64_t block, size_t* count) {
+    size_t stride = (sizeof(tftp_reorder_slot) + session->block_size + sizeof(uint64_t) - 1) &
+                    ~(sizeof(uint64_t) - 1);
+    *count = session->reorder_buf_sz / stride;
+    if (*count == 0) {
+        return NULL;
+    }
+    return (tftp_reorder_slot*)(session->reorder_buf + (block % *count) * stride);
+}
+
+// Writes the next block of the file, and moves past it.
+static tftp_status write_block(tftp_session* session, const uint8_t* buf, size_t len,
+                               void* cookie) {
+    size_t off = session->block_number * session->block_size;
+    while (len > 0) {
+        tftp_status ret;
+        // TODO(tkilbourn): assert that these function pointers are set
+        size_t wr = len;
+        ret = session->file_interface.write(buf, &wr, off, cookie);
+        if (ret < 0) {
+            xprintf("Error writing: %d\n", ret);
+            return ret;
+        }
+        buf += wr;
+        off += wr;
+        len -= wr;
+    }
+    session->block_number++;
+    session->window_index++;
+    return TFTP_NO_ERROR;
+}
+
 tftp_status tftp_handle_data(tftp_session* session,
                              tftp_msg* msg,
                              size_t msg_len,
@@ -718,26 +764,49 @@ tftp_status tftp_handle_data(tftp_session* session,
             session->block_number + block_delta, session->block_number,
             session->block_number * session->block_size, session->file_size,
             session->file_size - session->block_number * session->block_size);
+    size_t slots;
+    tftp_reorder_slot* slot;
     if (block_delta == 1) {
         xprintf("Advancing normally + 1\n");
-        void* buf = data->data;
-        size_t len = msg_len - sizeof(tftp_data_msg);
-        size_t off = session->block_number * session->block_size;
-        while (len > 0) {
-            tftp_status ret;
-            // TODO(tkilbourn): assert that these function pointers are set
-            size_t wr = len;
-            ret = session->file_interface.write(buf, &wr, off, cookie);
-            if (ret < 0) {
-                xprintf("Error writing: %d\n", ret);
+        tftp_status ret = write_block(session, data->data, msg_len - sizeof(tftp_data_msg),
+                                      cookie);
+        if (ret < 0) {
+            return ret;
+        }
+        // Follow with any blocks that arrived while this one was missing, and
+        // acknowledge them right away so the sender moves on past them.
+        while ((slot = reorder_slot(session, session->block_number + 1, &slots)) != NULL &&
+               slot->block == session->block_number + 1) {
+            xprintf("Writing held block %" PRIu64 "\n", slot->block);
+            slot->block = 0;
+            if ((ret = write_block(session, slot->data, slot->len, cookie)) < 0) {
                 return ret;
             }
-            buf += wr;
-            off += wr;
-            len -= wr;
+            session->window_index = session->window_size;
+        }
+        session->gap_reported = false;
+    } else if (block_delta > 1 &&
+               (slot = reorder_slot(session, session->block_number + block_delta, &slots)) !=
+                   NULL &&
+               (size_t)block_delta <= slots &&
+               msg_len - sizeof(tftp_data_msg) <= session->block_size) {
+        // Hold the block until the ones before it arrive. The gap is only
+        // reported by the first block after it.
+        slot->block = session->block_number + block_delta;
+        slot->len = msg_len - sizeof(tftp_data_msg);
+        memcpy(slot->data, data->data, slot->len);
+        if (session->gap_reported && session->gap_acked == session->block_number) {
+            *resp_len = 0;
+            return TFTP_NO_ERROR;
+        }
+        xprintf("Holding block %" PRIu64 ", expected %" PRIu64 "\n",
+                session->block_number + block_delta, session->block_number + 1);
+        session->gap_reported = true;
+        session->gap_acked = session->block_number;
+        session->window_index = session->window_size;
+        if (session->use_opcode_prefix) {
+            session->opcode_prefix++;
         }
-        session->block_number++;
-        session->window_index++;
     } else if (block_delta > 1) {
         // Force sending a ACK with the last block_number we received
         xprintf("Skipped: got %" PRIu64 ", expected %" PRIu64 "\n",
@@ -1027,6 +1096,11 @@ void tftp_session_set_opcode_prefix_use(tftp_session* session,
     session->use_opcode_prefix = enable;
 }
 
+void tftp_session_set_reorder_buffer(tftp_session* session, void* buffer, size_t size) {
+    session->reorder_buf = buffer;
+    session->reorder_buf_sz = buffer ? size : 0;
+}
+
 tftp_status tftp_timeout(tftp_session* session,
                          void* msg_buf,
                          size_t* msg_len,
@@ -69,7 +69,9 @@
 //    succeed.
 // Note that the handler is free to save buffers at whatever rate it can
 // manage. The protocol allows for records to be dropped if buffers can't be
-// saved fast enough.
+// saved fast enough. The number dropped so far is written to the buffer
+// header before each notification, so the handler can report drops as they
+// happen in long running traces.
 
 #include "context_impl.h"
 
@@ -524,6 +526,11 @@ void trace_context::SwitchRollingBufferLocked(uint32_t prev_wrapped_count,
     rolling_buffer_full_mark_[next_buffer].store(0, fbl::memory_order_relaxed);
     header_->rolling_data_end[next_buffer] = 0;
 
+    // Publish the drop count with the buffer being switched from, so that in
+    // streaming mode the count is seen each time a buffer is saved, rather
+    // than only once tracing stops.
+    header_->num_records_dropped = num_records_dropped();
+
     // Do this last: After this tracing resumes in the new buffer.
     uint64_t new_offset_plus_counter = MakeOffsetPlusCounter(0, new_wrapped_count);
     rolling_buffer_current_.store(new_offset_plus_counter,
@@ -49,7 +49,8 @@ struct trace_context {
     trace_buffering_mode_t buffering_mode() const { return buffering_mode_; }
 
     uint64_t num_records_dropped() const {
-        return num_records_dropped_.load(fbl::memory_order_relaxed);
+        return num_records_dropped_.load(fbl::memory_order_relaxed) +
+            num_records_dropped_after_buffer_switch_.load(fbl::memory_order_relaxed);
     }
 
     bool UsingDurableBuffer() const {
@@ -301,7 +302,8 @@ private:
     // A count of the number of records that have been dropped.
     fbl::atomic<uint64_t> num_records_dropped_{0};
 
-    // A count of the number of records that have been dropped.
+    // A count of the number of records that have been dropped because the
+    // buffer switched to filled too, before they could be written.
     fbl::atomic<uint64_t> num_records_dropped_after_buffer_switch_{0};
 
     // Set to true if the engine needs to stop tracing for some reason.
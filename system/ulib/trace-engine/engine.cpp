@@ -111,6 +111,14 @@ constexpr uint32_t kBufferCounterMask = 0xffffff00;
 //   - can be accessed outside the lock while holding a context reference
 trace_context_t* g_context{nullptr};
 
+// The generation of |g_context|, or 0 when there is none.
+// Rules:
+//   - can only be modified while holding g_engine_mutex
+//   - is set before |g_context_refs| becomes non-zero, so a thread which
+//     sees a non-zero count with acquire semantics sees this generation or
+//     a later one
+fbl::atomic<uint32_t> g_generation{0u};
+
 // Event for tracking:
 // - when all observers has started
 //   (SIGNAL_ALL_OBSERVERS_STARTED)
@@ -223,6 +231,8 @@ zx_status_t trace_start_engine(async_dispatcher_t* dispatcher,
     g_context = new trace_context(buffer, buffer_num_bytes, buffering_mode, handler);
     g_event = fbl::move(event);
 
+    g_generation.store(g_context->generation(), fbl::memory_order_relaxed);
+
     g_context->InitBufferHeader();
 
     // Write the trace initialization record first before allowing clients to
@@ -368,6 +378,7 @@ void handle_context_released(async_dispatcher_t* dispatcher) {
         g_event.reset();
         delete g_context;
         g_context = nullptr;
+        g_generation.store(0u, fbl::memory_order_relaxed);
 
         // After this point, it's possible for the engine to be restarted.
         g_state.store(TRACE_STOPPED, fbl::memory_order_relaxed);
@@ -497,6 +508,54 @@ trace_context_t* trace_acquire_context_for_category(const char* category_literal
     return context;
 }
 
+namespace {
+
+// Returns the generation of the current trace session, or 0 if there is none
+// or |site| records that its category is disabled in it.
+inline uint32_t get_site_generation(trace_site_t* site) {
+    // Pairs with the release of the first context reference when the engine
+    // starts, so that the generation of that session is seen.
+    if (likely(g_context_refs.load(fbl::memory_order_acquire) == 0u))
+        return 0u;
+    uint32_t generation = g_generation.load(fbl::memory_order_relaxed);
+    if (__atomic_load_n(&site->disabled_generation, __ATOMIC_RELAXED) == generation)
+        return 0u;
+    return generation;
+}
+
+// Records in |site| that its category is disabled in |generation|.
+// If tracing restarted in the meantime, this only records that it was
+// disabled in a session which has ended, which is harmless.
+inline void mark_site_disabled(trace_site_t* site, uint32_t generation) {
+    __atomic_store_n(&site->disabled_generation, generation, __ATOMIC_RELAXED);
+}
+
+} // namespace
+
+// thread-safe
+bool trace_is_category_enabled_cached(const char* category_literal,
+                                      trace_site_t* site) {
+    uint32_t generation = get_site_generation(site);
+    if (likely(generation == 0u))
+        return false;
+    bool result = trace_is_category_enabled(category_literal);
+    if (!result)
+        mark_site_disabled(site, generation);
+    return result;
+}
+
+trace_context_t* trace_acquire_context_for_category_cached(const char* category_literal,
+                                                           trace_site_t* site,
+                                                           trace_string_ref_t* out_ref) {
+    uint32_t generation = get_site_generation(site);
+    if (likely(generation == 0u))
+        return nullptr;
+    trace_context_t* context = trace_acquire_context_for_category(category_literal, out_ref);
+    if (!context)
+        mark_site_disabled(site, generation);
+    return context;
+}
+
 // thread-safe, never-fail, lock-free
 void trace_release_context(trace_context_t* context) {
     ZX_DEBUG_ASSERT(context == g_context);
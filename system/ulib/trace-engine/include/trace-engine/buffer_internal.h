@@ -112,6 +112,9 @@ struct trace_buffer_header {
     uint64_t rolling_data_end[2];
 
     // Total number of records dropped thus far.
+    // In circular and streaming modes this is written each time writing
+    // switches to the other rolling buffer, and in all modes when tracing
+    // is stopped.
     uint64_t num_records_dropped;
 
     // The header is padded out to a size of 128 to provide room for growth,
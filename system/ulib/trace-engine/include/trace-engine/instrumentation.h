@@ -127,9 +127,41 @@ __EXPORT trace_context_t* trace_acquire_context(void);
 __EXPORT trace_context_t* trace_acquire_context_for_category(const char* category_literal,
                                                     trace_string_ref_t* out_ref);
 
+// Remembers, for a single call site, that its category is disabled in the
+// current trace session, so that the call site need not acquire the context
+// to find that out again.
+//
+// Must be zero-initialized, and is usually a static variable at the call site.
+typedef struct trace_site {
+    // The generation of the last trace context in which the category was
+    // found to be disabled, or 0 if none.
+    uint32_t disabled_generation;
+} trace_site_t;
+
+// Same as |trace_is_category_enabled()|, but returns false without touching
+// the engine's context if |site| records that the category is disabled in
+// the current trace session.
+//
+// |site| must be used with only one |category_literal|.
+//
+// This function is thread-safe.
+__EXPORT bool trace_is_category_enabled_cached(const char* category_literal,
+                                               trace_site_t* site);
+
+// Same as |trace_acquire_context_for_category()|, but returns NULL without
+// touching the engine's context if |site| records that the category is
+// disabled in the current trace session.
+//
+// |site| must be used with only one |category_literal|.
+//
+// This function is thread-safe.
+__EXPORT trace_context_t* trace_acquire_context_for_category_cached(
+    const char* category_literal, trace_site_t* site, trace_string_ref_t* out_ref);
+
 // Releases a reference to the trace engine's context.
-// Must balance a prior successful call to |trace_acquire_context()|
-// or |trace_acquire_context_for_category()|.
+// Must balance a prior successful call to |trace_acquire_context()|,
+// |trace_acquire_context_for_category()| or
+// |trace_acquire_context_for_category_cached()|.
 //
 // |context| must be a valid trace context reference.
 //
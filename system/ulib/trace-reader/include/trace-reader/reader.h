@@ -186,4 +186,46 @@ private:
     const uint64_t* end_;
 };
 
+// Finds the runs of records written by each provider in a trace, reading only
+// the record headers and not decoding the records themselves.
+//
+// String and thread refs are only resolved against the tables of the provider
+// which wrote them, so the runs of different providers can be decoded
+// independently of each other, for example concurrently, with one
+// |TraceReader| per provider which is given that provider's runs in order.
+class ProviderSectionScanner {
+public:
+    // Called once for each run of records found by |ScanSections|.
+    // |section| begins with the metadata record which switched to provider |id|,
+    // if there was one, so that a |TraceReader| reading it registers or switches
+    // to the provider itself.
+    using SectionConsumer = fbl::Function<void(ProviderId id, Chunk section)>;
+
+    using ErrorHandler = TraceReader::ErrorHandler;
+
+    explicit ProviderSectionScanner(SectionConsumer section_consumer,
+                                    ErrorHandler error_handler);
+
+    // Splits |chunk| into runs of records, invoking the section consumer for
+    // each one. A record cut short by the end of the chunk is left at the end
+    // of the last run. Returns false if the trace stream is unrecoverably
+    // corrupt, after passing on the records before the corruption. May be
+    // called repeatedly with the chunks of a trace in order.
+    bool ScanSections(const Chunk& chunk);
+
+    // Gets the id of the provider which wrote the last run found.
+    // Returns 0 if no providers have been seen yet.
+    ProviderId current_provider_id() const { return current_provider_id_; }
+
+private:
+    void ReportError(fbl::String error) const;
+
+    SectionConsumer const section_consumer_;
+    ErrorHandler const error_handler_;
+
+    ProviderId current_provider_id_ = 0u;
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(ProviderSectionScanner);
+};
+
 } // namespace trace
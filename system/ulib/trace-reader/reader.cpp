@@ -694,4 +694,64 @@ bool Chunk::ReadInPlace(size_t num_words, const void** out_ptr) {
     return true;
 }
 
+ProviderSectionScanner::ProviderSectionScanner(SectionConsumer section_consumer,
+                                               ErrorHandler error_handler)
+    : section_consumer_(fbl::move(section_consumer)),
+      error_handler_(fbl::move(error_handler)) {}
+
+bool ProviderSectionScanner::ScanSections(const Chunk& chunk) {
+    Chunk cursor(chunk);
+    Chunk sections(chunk);
+    size_t section_words = 0u;
+    auto flush = [this, &sections, &section_words] {
+        if (section_words == 0u)
+            return;
+        Chunk section;
+        sections.ReadChunk(section_words, &section);
+        section_consumer_(current_provider_id_, section);
+        section_words = 0u;
+    };
+
+    RecordHeader header;
+    while (cursor.ReadUint64(&header)) {
+        auto size = RecordFields::RecordSize::Get<size_t>(header);
+        if (size == 0) {
+            flush();
+            ReportError("Unexpected record of size 0");
+            return false; // fatal error
+        }
+
+        if (RecordFields::Type::Get<RecordType>(header) == RecordType::kMetadata) {
+            auto type = MetadataRecordFields::MetadataType::Get<MetadataType>(header);
+            // Both of these make |id| the current provider.
+            static_assert(fbl::is_same<ProviderInfoMetadataRecordFields::Id,
+                                       ProviderSectionMetadataRecordFields::Id>::value,
+                          "provider ids must be in the same place");
+            if (type == MetadataType::kProviderInfo ||
+                type == MetadataType::kProviderSection) {
+                auto id = ProviderSectionMetadataRecordFields::Id::Get<ProviderId>(header);
+                if (id != current_provider_id_) {
+                    flush();
+                    current_provider_id_ = id;
+                }
+            }
+        }
+
+        Chunk record;
+        if (!cursor.ReadChunk(size - 1, &record)) {
+            section_words += 1 + cursor.remaining_words();
+            break;
+        }
+        section_words += size;
+    }
+
+    flush();
+    return true;
+}
+
+void ProviderSectionScanner::ReportError(fbl::String error) const {
+    if (error_handler_)
+        error_handler_(fbl::move(error));
+}
+
 } // namespace trace
@@ -92,6 +92,12 @@ const char* ObjectTypeToString(zx_obj_type_t type) {
         return "pmt";
     case ZX_OBJ_TYPE_SUSPEND_TOKEN:
         return "suspend-token";
+    case ZX_OBJ_TYPE_PAGER:
+        return "pager";
+    case ZX_OBJ_TYPE_WAITSET:
+        return "waitset";
+    case ZX_OBJ_TYPE_ASPACE_TEMPLATE:
+        return "aspace-template";
     default:
         return "???";
     }
@@ -25,6 +25,9 @@ __BEGIN_CDECLS
 // Variable used to refer to the current trace category's string ref.
 #define TRACE_INTERNAL_CATEGORY_REF __trace_category_ref
 
+// Variable used to remember whether the category of a call site is disabled.
+#define TRACE_INTERNAL_SITE __trace_site
+
 // Makes a string literal string ref.
 #define TRACE_INTERNAL_MAKE_LITERAL_STRING_REF(string_literal_value) \
     (trace_context_make_registered_string_literal(                   \
@@ -91,10 +94,11 @@ __BEGIN_CDECLS
 #ifndef NTRACE
 #define TRACE_INTERNAL_EVENT_RECORD(category_literal, stmt, args...) \
     do {                                                             \
+        static trace_site_t TRACE_INTERNAL_SITE;                     \
         trace_string_ref_t TRACE_INTERNAL_CATEGORY_REF;              \
         trace_context_t* TRACE_INTERNAL_CONTEXT =                    \
-            trace_acquire_context_for_category(                      \
-                (category_literal),                                  \
+            trace_acquire_context_for_category_cached(               \
+                (category_literal), &TRACE_INTERNAL_SITE,            \
                 &TRACE_INTERNAL_CATEGORY_REF);                       \
         if (unlikely(TRACE_INTERNAL_CONTEXT)) {                      \
             TRACE_INTERNAL_DECLARE_ARGS(args);                       \
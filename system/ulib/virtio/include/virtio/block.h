@@ -18,11 +18,18 @@
 #define VIRTIO_BLK_F_FLUSH      (1u << 9)
 #define VIRTIO_BLK_F_TOPOLOGY   (1u << 10)
 #define VIRTIO_BLK_F_CONFIG_WCE (1u << 11)
+#define VIRTIO_BLK_F_MQ         (1u << 12)
+#define VIRTIO_BLK_F_DISCARD    (1u << 13)
+#define VIRTIO_BLK_F_WRITE_ZEROES (1u << 14)
 
 #define VIRTIO_BLK_T_IN         0
 #define VIRTIO_BLK_T_OUT        1
 #define VIRTIO_BLK_T_FLUSH      4
 #define VIRTIO_BLK_T_GET_ID     8
+#define VIRTIO_BLK_T_DISCARD    11
+#define VIRTIO_BLK_T_WRITE_ZEROES 13
+
+#define VIRTIO_BLK_WRITE_ZEROES_F_UNMAP (1u << 0)
 
 #define VIRTIO_BLK_S_OK         0
 #define VIRTIO_BLK_S_IOERR      1
@@ -39,12 +46,33 @@ typedef struct virtio_blk_geometry {
     uint8_t sectors;
 } __PACKED virtio_blk_geometry_t;
 
+typedef struct virtio_blk_topology {
+    uint8_t physical_block_exp;
+    uint8_t alignment_offset;
+    uint16_t min_io_size;
+    uint32_t opt_io_size;
+} __PACKED virtio_blk_topology_t;
+
 typedef struct virtio_blk_config {
     uint64_t capacity;
     uint32_t size_max;
     uint32_t seg_max;
     virtio_blk_geometry_t geometry;
     uint32_t blk_size;
+    virtio_blk_topology_t topology;
+    uint8_t writeback;
+    uint8_t unused0;
+    // Only if |VIRTIO_BLK_F_MQ|.
+    uint16_t num_queues;
+    // Only if |VIRTIO_BLK_F_DISCARD|.
+    uint32_t max_discard_sectors;
+    uint32_t max_discard_seg;
+    uint32_t discard_sector_alignment;
+    // Only if |VIRTIO_BLK_F_WRITE_ZEROES|.
+    uint32_t max_write_zeroes_sectors;
+    uint32_t max_write_zeroes_seg;
+    uint8_t write_zeroes_may_unmap;
+    uint8_t unused1[3];
 } __PACKED virtio_blk_config_t;
 
 typedef struct virtio_blk_req {
@@ -53,4 +81,12 @@ typedef struct virtio_blk_req {
     uint64_t sector;
 } __PACKED virtio_blk_req_t;
 
+// The data of a VIRTIO_BLK_T_DISCARD or VIRTIO_BLK_T_WRITE_ZEROES request is
+// a list of these.
+typedef struct virtio_blk_discard_write_zeroes {
+    uint64_t sector;
+    uint32_t num_sectors;
+    uint32_t flags;
+} __PACKED virtio_blk_discard_write_zeroes_t;
+
 __END_CDECLS
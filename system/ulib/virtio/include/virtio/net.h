@@ -32,6 +32,7 @@
 #define VIRTIO_NET_F_CTRL_MAC_ADDR          (1u << 23)
 
 #define VIRTIO_NET_HDR_F_NEEDS_CSUM 1u
+#define VIRTIO_NET_HDR_F_DATA_VALID 2u
 
 #define VIRTIO_NET_HDR_GSO_NONE     0u
 #define VIRTIO_NET_HDR_GSO_TCPV4    1u
@@ -42,6 +43,14 @@
 #define VIRTIO_NET_S_LINK_UP        1u
 #define VIRTIO_NET_S_ANNOUNCE       2u
 
+#define VIRTIO_NET_OK               0u
+#define VIRTIO_NET_ERR              1u
+
+#define VIRTIO_NET_CTRL_MQ                  4u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET     0u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN     1u
+#define VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MAX     0x8000u
+
 // clang-format on
 
 __BEGIN_CDECLS
@@ -65,4 +74,16 @@ typedef struct virtio_net_hdr {
     uint16_t num_buffers;
 } __PACKED virtio_net_hdr_t;
 
+// The header of a command on the control virtqueue, which is followed by the
+// command's data and then an ack byte written by the device.
+typedef struct virtio_net_ctrl_hdr {
+    uint8_t class_id;
+    uint8_t command;
+} __PACKED virtio_net_ctrl_hdr_t;
+
+// The data of VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET.
+typedef struct virtio_net_ctrl_mq {
+    uint16_t virtqueue_pairs;
+} __PACKED virtio_net_ctrl_mq_t;
+
 __END_CDECLS
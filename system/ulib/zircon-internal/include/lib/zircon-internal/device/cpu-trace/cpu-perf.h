@@ -72,6 +72,8 @@ typedef enum {
   CPUPERF_RECORD_PC = 5,
   // The record is a |cpuperf_last_branch_record_t|.
   CPUPERF_RECORD_LAST_BRANCH = 6,
+  // The record is a |cpuperf_callstack_record_t|.
+  CPUPERF_RECORD_CALLSTACK = 7,
 } cpuperf_record_type_t;
 
 // Trace buffer space is expensive, we want to keep records small.
@@ -251,6 +253,36 @@ typedef struct {
     (sizeof(cpuperf_last_branch_record_t) - \
      (CPUPERF_MAX_NUM_LAST_BRANCH - (lbr)->num_branches) * sizeof((lbr)->branches[0]))
 
+// Record the userspace call stack of a sample.
+// It is expected that this record follows a TIME record, which in turn follows
+// the PC record of the same sample: the stack is collected on the way back to
+// userspace from the sampling interrupt, so other records may come between the
+// PC record and this one.
+// Note that this record is variable-length.
+// The stack is unwound by following frame pointers, so it is only complete
+// for code built with frame pointers. Only samples taken in userspace have a
+// call stack.
+typedef struct {
+    cpuperf_record_header_t header;
+    // Number of entries in |frames|.
+    uint32_t num_frames;
+    // The aspace id at the time data was collected.
+    // The meaning of the value is architecture-specific.
+    // In the case of x86 this is the cr3 value.
+    uint64_t aspace;
+    // The pc of the sample followed by the return addresses of its callers,
+    // innermost first.
+    // Note that the emitted record may be smaller than this, as indicated by
+    // |num_frames|.
+#define CPUPERF_MAX_NUM_CALLSTACK_FRAMES (64u)
+    uint64_t frames[CPUPERF_MAX_NUM_CALLSTACK_FRAMES];
+} CPUPERF_ALIGN_RECORD cpuperf_callstack_record_t;
+
+// Return the size of valid call stack record |cs|.
+#define CPUPERF_CALLSTACK_RECORD_SIZE(cs) \
+    (sizeof(cpuperf_callstack_record_t) - \
+     (CPUPERF_MAX_NUM_CALLSTACK_FRAMES - (cs)->num_frames) * sizeof((cs)->frames[0]))
+
 // The properties of this system.
 typedef struct {
     // S/W API version = CPUPERF_API_VERSION.
@@ -301,7 +333,7 @@ typedef struct {
     // TODO(dje): hypervisor, host/guest os/user
     uint32_t flags[CPUPERF_MAX_EVENTS];
 // Valid bits in |flags|.
-#define CPUPERF_CONFIG_FLAG_MASK      0x1f
+#define CPUPERF_CONFIG_FLAG_MASK      0x3f
 // Collect os data.
 #define CPUPERF_CONFIG_FLAG_OS        (1u << 0)
 // Collect userspace data.
@@ -319,6 +351,11 @@ typedef struct {
 // This is only available when the underlying system supports it.
 // TODO(dje): Provide knob to specify how many branches.
 #define CPUPERF_CONFIG_FLAG_LAST_BRANCH (1u << 4)
+// Collect the userspace call stack along with aspace+pc values.
+// Stacks are emitted as CPUPERF_RECORD_CALLSTACK records.
+// Like CPUPERF_CONFIG_FLAG_LAST_BRANCH this requires the event to be its own
+// timebase.
+#define CPUPERF_CONFIG_FLAG_CALLSTACK (1u << 5)
 } cpuperf_config_t;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,54 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// The kernel publishes its counters (see kernel/include/lib/counters.h) to
+// userspace as two read-only VMOs, which devmgr makes available as files:
+//
+//   /boot/kernel/counters/desc
+//     A kcounter_vmo_header_t followed by |num_counters| descriptors, in
+//     the order of the counter slots.
+//
+//   /boot/kernel/counters/arena
+//     The live counter arena itself.  It holds |max_cpus| arrays of
+//     |num_counters| int64_t values, so the value of counter |index| on
+//     cpu |cpu| is at arena[cpu * num_counters + index].  Each value is
+//     updated by its cpu without atomic read-modify-write operations, so
+//     readers should load each one with a single 64-bit load and treat
+//     the sum across cpus as approximate.
+
+// clang-format off
+
+#define KCOUNTER_DESC_VMO_NAME      "counters/desc"
+#define KCOUNTER_ARENA_VMO_NAME     "counters/arena"
+
+#define KCOUNTER_VMO_MAGIC          (0x31544e434b4f4d56ull) // "VMOKCNT1"
+
+// Maximum length of a counter name, including the terminating NUL.
+#define KCOUNTER_MAX_NAME           (56u)
+
+// The per-cpu values are added together to get the counter's value.
+#define KCOUNTER_TYPE_SUM           (1u)
+
+// clang-format on
+
+typedef struct kcounter_vmo_desc {
+    char name[KCOUNTER_MAX_NAME];
+    uint64_t type;
+} kcounter_vmo_desc_t;
+
+typedef struct kcounter_vmo_header {
+    uint64_t magic;
+    uint32_t max_cpus;
+    uint32_t num_counters;
+    kcounter_vmo_desc_t descs[];
+} kcounter_vmo_header_t;
+
+__END_CDECLS
@@ -31,6 +31,9 @@ KTRACE_DEF(0x035,32B,PAGE_FAULT_EXIT,IRQ) // virtual_address_hi, virtual_address
 // to-tid, (new_thread_prioriy<<24) | (old_thread_priority<<16) | (old_thread_state<<8) | cpu), from-kt, to-kt
 KTRACE_DEF(0x040,32B,CONTEXT_SWITCH,SCHEDULER)
 
+// to-tid, run queue wait ns (saturated), quantum used by from-thread ns (saturated), cpu
+KTRACE_DEF(0x041,32B,SCHED_LATENCY,SCHEDULER)
+
 // events from 0x100 on all share the tag/tid/ts common header
 
 KTRACE_DEF(0x100,32B,OBJECT_DELETE,LIFECYCLE) // id
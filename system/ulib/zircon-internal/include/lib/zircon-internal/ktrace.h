@@ -88,5 +88,6 @@ enum {
 #define KTRACE_ACTION_STOP      2 // options ignored
 #define KTRACE_ACTION_REWIND    3 // options ignored
 #define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
+#define KTRACE_ACTION_START_STREAMING 5 // options = grpmask, 0 = all; reads drain
 
 __END_CDECLS
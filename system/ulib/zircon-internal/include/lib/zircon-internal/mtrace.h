@@ -34,6 +34,13 @@ __BEGIN_CDECLS
 #define MTRACE_INSNTRACE_START 4
 #define MTRACE_INSNTRACE_STOP 5
 
+// Assign the buffer descriptor in |options| to the thread whose handle is
+// passed as the argument. IPT_MODE_THREADS only.
+#define MTRACE_INSNTRACE_ASSIGN_THREAD_BUFFER 6
+
+// Undo MTRACE_INSNTRACE_ASSIGN_THREAD_BUFFER.
+#define MTRACE_INSNTRACE_RELEASE_THREAD_BUFFER 7
+
 // Actions for CPU Performance Counters/Statistics control
 
 // Get performonce monitoring system properties
@@ -11,6 +11,7 @@
 #include <lib/vdso-constants.h>
 
 extern __LOCAL const struct vdso_constants DATA_CONSTANTS;
+extern __LOCAL const struct vdso_clock_data DATA_CLOCK;
 
 extern "C" {
 
@@ -0,0 +1,63 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/syscalls.h>
+
+#include <lib/fixed_point.h>
+
+#include "private.h"
+
+// When the kernel's monotonic clock is driven by the same counter that
+// zx_ticks_get reads, this computes it exactly the way the kernel does.
+// Otherwise, e.g. when the kernel keeps time with the HPET, it asks the
+// kernel.
+zx_time_t _zx_clock_get_monotonic(void) {
+    if (unlikely(!DATA_CONSTANTS.clock_from_ticks))
+        return SYSCALL_zx_clock_get_monotonic_via_kernel();
+
+    const struct fp_32_64 ns_per_tick = {
+        DATA_CONSTANTS.ns_per_tick.l0,
+        DATA_CONSTANTS.ns_per_tick.l32,
+        DATA_CONSTANTS.ns_per_tick.l64,
+    };
+    return u64_mul_u64_fp32_64(VDSO_zx_ticks_get(), ns_per_tick);
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_get_monotonic);
+
+static zx_time_t get_utc(void) {
+    int64_t offset = __atomic_load_n(&DATA_CLOCK.utc_offset, __ATOMIC_RELAXED);
+    return VDSO_zx_clock_get_monotonic() + offset;
+}
+
+zx_time_t _zx_clock_get(zx_clock_t clock_id) {
+    switch (clock_id) {
+    case ZX_CLOCK_MONOTONIC:
+        return VDSO_zx_clock_get_monotonic();
+    case ZX_CLOCK_UTC:
+        return get_utc();
+    default:
+        return SYSCALL_zx_clock_get_via_kernel(clock_id);
+    }
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_get);
+
+zx_status_t _zx_clock_get_new(zx_clock_t clock_id, zx_time_t* out_time) {
+    switch (clock_id) {
+    case ZX_CLOCK_MONOTONIC:
+        *out_time = VDSO_zx_clock_get_monotonic();
+        return ZX_OK;
+    case ZX_CLOCK_UTC:
+        *out_time = get_utc();
+        return ZX_OK;
+    case ZX_CLOCK_THREAD:
+        *out_time = SYSCALL_zx_clock_get_via_kernel(clock_id);
+        return ZX_OK;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_get_new);
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <lib/zx/event.h>
 #include <lib/zx/handle.h>
 #include <lib/zx/object.h>
 #include <lib/zx/port.h>
@@ -36,6 +37,11 @@ public:
                          const port& port, uint64_t key) {
         return zx_guest_set_trap(get(), kind, addr, len, port.get(), key);
     }
+
+    zx_status_t set_trap(uint32_t kind, zx_gpaddr_t addr, size_t len,
+                         const event& event, uint64_t key) {
+        return zx_guest_set_trap(get(), kind, addr, len, event.get(), key);
+    }
 };
 
 using unowned_guest = unowned<guest>;
@@ -13,6 +13,8 @@
 
 __BEGIN_CDECLS
 
+struct mmsghdr;
+
 // Flags that describe how the |zxs| library will interact with the kernel
 // socket object.
 typedef uint32_t zxs_flags_t;
@@ -134,6 +136,8 @@ zx_status_t zxs_send(const zxs_socket_t* socket, const void* buffer,
                      size_t capacity, size_t* out_actual);
 
 // Receive data from |socket| into the given |buffer|.
+//
+// The only |flag| supported is MSG_DONTWAIT.
 zx_status_t zxs_recv(const zxs_socket_t* socket, int flag, void* buffer,
                      size_t capacity, size_t* out_actual);
 
@@ -164,6 +168,30 @@ zx_status_t zxs_sendmsg(const zxs_socket_t* socket, const struct msghdr* msg,
 zx_status_t zxs_recvmsg(const zxs_socket_t* socket, struct msghdr* msg,
                         size_t* out_actual);
 
+// Send each of the |count| messages in |msgvec| over |socket|, in order.
+//
+// The |msg_len| of each message sent is set to the amount of data sent from
+// it. The |out_count| parameter is the number of messages sent, which is less
+// than |count| if an error stopped the batch after the first message.
+//
+// The only flag supported is MSG_DONTWAIT.
+zx_status_t zxs_sendmmsg(const zxs_socket_t* socket, struct mmsghdr* msgvec,
+                         size_t count, int flags, size_t* out_count);
+
+// Receive up to |count| messages from |socket| into |msgvec|.
+//
+// The |msg_len| of each message received is set to the amount of data
+// received into it. The |out_count| parameter is the number of messages
+// received. No wait lasts past |deadline|, and once at least one message has
+// been received, running out of time or of messages ends the batch rather than
+// failing it.
+//
+// The flags supported are MSG_DONTWAIT and MSG_WAITFORONE, which stops waiting
+// once a message has been received.
+zx_status_t zxs_recvmmsg(const zxs_socket_t* socket, struct mmsghdr* msgvec,
+                         size_t count, int flags, zx_time_t deadline,
+                         size_t* out_count);
+
 __END_CDECLS
 
 #endif // LIB_ZXS_ZXS_H_
@@ -6,6 +6,7 @@
 #include <lib/zxs/inception.h>
 #include <lib/zxs/protocol.h>
 #include <lib/zxs/zxs.h>
+#include <stdlib.h>
 #include <string.h>
 #include <zircon/syscalls.h>
 
@@ -330,34 +331,385 @@ zx_status_t zxs_setsockopts(const zxs_socket_t* socket,
     return ZX_OK;
 }
 
+// Returns the deadline for an operation on |socket| which waits for it.
+static zx_time_t zxs_deadline(const zxs_socket_t* socket, int flags) {
+    if ((socket->flags & ZXS_FLAG_BLOCKING) && !(flags & MSG_DONTWAIT)) {
+        return ZX_TIME_INFINITE;
+    }
+    return 0;
+}
+
+// Writes |capacity| bytes from |buffer| to the data plane of |socket|,
+// waiting until |deadline| for room to do so.
+static zx_status_t zxs_write(zx_handle_t socket, const void* buffer,
+                             size_t capacity, zx_time_t deadline,
+                             size_t* out_actual) {
+    for (;;) {
+        zx_status_t status = zx_socket_write(socket, 0, buffer, capacity,
+                                             out_actual);
+        if (status != ZX_ERR_SHOULD_WAIT || deadline == 0) {
+            return status;
+        }
+        zx_signals_t observed = ZX_SIGNAL_NONE;
+        status = zx_object_wait_one(socket,
+                                    ZX_SOCKET_WRITABLE | ZX_SOCKET_WRITE_DISABLED | ZX_SOCKET_PEER_CLOSED,
+                                    deadline, &observed);
+        if (status == ZX_ERR_TIMED_OUT) {
+            return ZX_ERR_SHOULD_WAIT;
+        }
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (observed & (ZX_SOCKET_WRITE_DISABLED | ZX_SOCKET_PEER_CLOSED)) {
+            return ZX_ERR_PEER_CLOSED;
+        }
+    }
+}
+
+// Reads up to |capacity| bytes from the data plane of |socket| into |buffer|,
+// waiting until |deadline| for there to be some. Once the peer can write no
+// more, this reads zero bytes.
+static zx_status_t zxs_read(zx_handle_t socket, void* buffer, size_t capacity,
+                            zx_time_t deadline, size_t* out_actual) {
+    for (;;) {
+        zx_status_t status = zx_socket_read(socket, 0, buffer, capacity,
+                                            out_actual);
+        if (status == ZX_OK) {
+            // zx_socket_read() sets *actual to the number of bytes in the
+            // buffer when data is NULL and len is 0.
+            if (capacity == 0) {
+                *out_actual = 0;
+            }
+            return ZX_OK;
+        }
+        if (status == ZX_ERR_PEER_CLOSED || status == ZX_ERR_BAD_STATE) {
+            *out_actual = 0;
+            return ZX_OK;
+        }
+        if (status != ZX_ERR_SHOULD_WAIT || deadline == 0) {
+            return status;
+        }
+        zx_signals_t observed = ZX_SIGNAL_NONE;
+        status = zx_object_wait_one(socket,
+                                    ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED | ZX_SOCKET_PEER_WRITE_DISABLED,
+                                    deadline, &observed);
+        if (status == ZX_ERR_TIMED_OUT) {
+            return ZX_ERR_SHOULD_WAIT;
+        }
+        if (status != ZX_OK) {
+            return status;
+        }
+        if (!(observed & ZX_SOCKET_READABLE)) {
+            *out_actual = 0;
+            return ZX_OK;
+        }
+    }
+}
+
+// Datagrams up to this size, headers included, are assembled and taken apart
+// on the stack rather than in an allocation.
+#define ZXS_DGRAM_STACK_SIZE 2048
+
+static zx_status_t zxs_sendmsg_stream(const zxs_socket_t* socket,
+                                      const struct msghdr* msg,
+                                      zx_time_t deadline, size_t* out_actual) {
+    size_t total = 0u;
+    for (int i = 0; i < msg->msg_iovlen; ++i) {
+        const struct iovec* iov = &msg->msg_iov[i];
+        if (iov->iov_len == 0) {
+            continue;
+        }
+        size_t actual = 0u;
+        zx_status_t status = zxs_write(socket->socket, iov->iov_base,
+                                       iov->iov_len, deadline, &actual);
+        if (status != ZX_OK) {
+            if (total > 0) {
+                break;
+            }
+            return status;
+        }
+        total += actual;
+        if (actual != iov->iov_len) {
+            break;
+        }
+    }
+    *out_actual = total;
+    return ZX_OK;
+}
+
+static zx_status_t zxs_sendmsg_dgram(const zxs_socket_t* socket,
+                                     const struct msghdr* msg,
+                                     zx_time_t deadline, size_t* out_actual) {
+    if (msg->msg_namelen > sizeof(struct sockaddr_storage)) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+    size_t length = 0u;
+    for (int i = 0; i < msg->msg_iovlen; ++i) {
+        length += msg->msg_iov[i].iov_len;
+    }
+
+    size_t mlen = FDIO_SOCKET_MSG_HEADER_SIZE + length;
+    alignas(fdio_socket_msg_t) uint8_t stack_buffer[ZXS_DGRAM_STACK_SIZE];
+    fdio_socket_msg_t* m = reinterpret_cast<fdio_socket_msg_t*>(stack_buffer);
+    if (mlen > sizeof(stack_buffer)) {
+        m = static_cast<fdio_socket_msg_t*>(malloc(mlen));
+        if (m == nullptr) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+    memset(m, 0, FDIO_SOCKET_MSG_HEADER_SIZE);
+    if (msg->msg_name != nullptr) {
+        memcpy(&m->addr, msg->msg_name, msg->msg_namelen);
+    }
+    m->addrlen = msg->msg_namelen;
+    char* data = m->data;
+    for (int i = 0; i < msg->msg_iovlen; ++i) {
+        const struct iovec* iov = &msg->msg_iov[i];
+        memcpy(data, iov->iov_base, iov->iov_len);
+        data += iov->iov_len;
+    }
+
+    size_t actual = 0u;
+    zx_status_t status = zxs_write(socket->socket, m, mlen, deadline, &actual);
+    if (m != reinterpret_cast<fdio_socket_msg_t*>(stack_buffer)) {
+        free(m);
+    }
+    if (status != ZX_OK) {
+        return status;
+    }
+    *out_actual = length;
+    return ZX_OK;
+}
+
+static zx_status_t zxs_recvmsg_stream(const zxs_socket_t* socket,
+                                      struct msghdr* msg, zx_time_t deadline,
+                                      size_t* out_actual) {
+    // The peer address is not reported for a stream, as for TCP on other
+    // systems.
+    msg->msg_namelen = 0;
+    msg->msg_flags = 0;
+    size_t total = 0u;
+    for (int i = 0; i < msg->msg_iovlen; ++i) {
+        struct iovec* iov = &msg->msg_iov[i];
+        if (iov->iov_len == 0) {
+            continue;
+        }
+        // Once some data has been read, only what is already there is added
+        // to it.
+        size_t actual = 0u;
+        zx_status_t status = zxs_read(socket->socket, iov->iov_base,
+                                      iov->iov_len, total > 0 ? 0 : deadline,
+                                      &actual);
+        if (status != ZX_OK) {
+            if (total > 0) {
+                break;
+            }
+            return status;
+        }
+        total += actual;
+        if (actual != iov->iov_len) {
+            break;
+        }
+    }
+    *out_actual = total;
+    return ZX_OK;
+}
+
+static zx_status_t zxs_recvmsg_dgram(const zxs_socket_t* socket,
+                                     struct msghdr* msg, zx_time_t deadline,
+                                     size_t* out_actual) {
+    size_t capacity = 0u;
+    for (int i = 0; i < msg->msg_iovlen; ++i) {
+        capacity += msg->msg_iov[i].iov_len;
+    }
+
+    // Read 1 extra byte to detect if the buffer is too small to fit the whole
+    // datagram, so we can set MSG_TRUNC flag if necessary.
+    size_t mlen = FDIO_SOCKET_MSG_HEADER_SIZE + capacity + 1;
+    alignas(fdio_socket_msg_t) uint8_t stack_buffer[ZXS_DGRAM_STACK_SIZE];
+    fdio_socket_msg_t* m = reinterpret_cast<fdio_socket_msg_t*>(stack_buffer);
+    if (mlen > sizeof(stack_buffer)) {
+        m = static_cast<fdio_socket_msg_t*>(malloc(mlen));
+        if (m == nullptr) {
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+
+    size_t n = 0u;
+    zx_status_t status = zxs_read(socket->socket, m, mlen, deadline, &n);
+    if (status == ZX_OK && n < FDIO_SOCKET_MSG_HEADER_SIZE) {
+        status = ZX_ERR_INTERNAL;
+    }
+    if (status == ZX_OK) {
+        n -= FDIO_SOCKET_MSG_HEADER_SIZE;
+        if (msg->msg_name != nullptr) {
+            memcpy(msg->msg_name, &m->addr,
+                   (msg->msg_namelen < m->addrlen) ? msg->msg_namelen : m->addrlen);
+        }
+        msg->msg_namelen = m->addrlen;
+        msg->msg_flags = m->flags;
+        if (n > capacity) {
+            msg->msg_flags |= MSG_TRUNC;
+            n = capacity;
+        }
+        const char* data = m->data;
+        size_t resid = n;
+        for (int i = 0; i < msg->msg_iovlen && resid > 0; ++i) {
+            struct iovec* iov = &msg->msg_iov[i];
+            size_t length = (resid < iov->iov_len) ? resid : iov->iov_len;
+            memcpy(iov->iov_base, data, length);
+            data += length;
+            resid -= length;
+        }
+        *out_actual = n;
+    }
+
+    if (m != reinterpret_cast<fdio_socket_msg_t*>(stack_buffer)) {
+        free(m);
+    }
+    return status;
+}
+
+static zx_status_t zxs_sendmsg_internal(const zxs_socket_t* socket,
+                                        const struct msghdr* msg,
+                                        zx_time_t deadline,
+                                        size_t* out_actual) {
+    if (socket->flags & ZXS_FLAG_DATAGRAM) {
+        return zxs_sendmsg_dgram(socket, msg, deadline, out_actual);
+    }
+    return zxs_sendmsg_stream(socket, msg, deadline, out_actual);
+}
+
+static zx_status_t zxs_recvmsg_internal(const zxs_socket_t* socket,
+                                        struct msghdr* msg, zx_time_t deadline,
+                                        size_t* out_actual) {
+    if (socket->flags & ZXS_FLAG_DATAGRAM) {
+        return zxs_recvmsg_dgram(socket, msg, deadline, out_actual);
+    }
+    return zxs_recvmsg_stream(socket, msg, deadline, out_actual);
+}
+
 zx_status_t zxs_send(const zxs_socket_t* socket, const void* buffer,
                      size_t capacity, size_t* out_actual) {
-    return ZX_ERR_NOT_SUPPORTED;
+    return zxs_sendto(socket, nullptr, 0u, buffer, capacity, out_actual);
 }
 
 zx_status_t zxs_recv(const zxs_socket_t* socket, int flag, void* buffer,
                      size_t capacity, size_t* out_actual) {
-    return ZX_ERR_NOT_SUPPORTED;
+    if (flag & ~MSG_DONTWAIT) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    struct iovec iov = {
+        .iov_base = buffer,
+        .iov_len = capacity,
+    };
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    return zxs_recvmsg_internal(socket, &msg, zxs_deadline(socket, flag),
+                                out_actual);
 }
 
 zx_status_t zxs_sendto(const zxs_socket_t* socket, const struct sockaddr* addr,
                        size_t addr_length, const void* buffer, size_t capacity,
                        size_t* out_actual) {
-    return ZX_ERR_NOT_SUPPORTED;
+    struct iovec iov = {
+        .iov_base = const_cast<void*>(buffer),
+        .iov_len = capacity,
+    };
+    struct msghdr msg = {};
+    msg.msg_name = const_cast<struct sockaddr*>(addr);
+    msg.msg_namelen = static_cast<socklen_t>(addr_length);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    return zxs_sendmsg(socket, &msg, out_actual);
 }
 
 zx_status_t zxs_recvfrom(const zxs_socket_t* socket, struct sockaddr* addr,
                         size_t addr_capacity, size_t* out_addr_actual,
                         void* buffer, size_t capacity, size_t* out_actual) {
-    return ZX_ERR_NOT_SUPPORTED;
+    struct iovec iov = {
+        .iov_base = buffer,
+        .iov_len = capacity,
+    };
+    struct msghdr msg = {};
+    msg.msg_name = addr;
+    msg.msg_namelen = static_cast<socklen_t>(addr_capacity);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    zx_status_t status = zxs_recvmsg(socket, &msg, out_actual);
+    if (status == ZX_OK) {
+        *out_addr_actual = msg.msg_namelen;
+    }
+    return status;
 }
 
 zx_status_t zxs_sendmsg(const zxs_socket_t* socket, const struct msghdr* msg,
                         size_t* out_actual) {
-    return ZX_ERR_NOT_SUPPORTED;
+    return zxs_sendmsg_internal(socket, msg, zxs_deadline(socket, 0),
+                                out_actual);
 }
 
 zx_status_t zxs_recvmsg(const zxs_socket_t* socket, struct msghdr* msg,
                         size_t* out_actual) {
-    return ZX_ERR_NOT_SUPPORTED;
+    return zxs_recvmsg_internal(socket, msg, zxs_deadline(socket, 0),
+                                out_actual);
+}
+
+zx_status_t zxs_sendmmsg(const zxs_socket_t* socket, struct mmsghdr* msgvec,
+                         size_t count, int flags, size_t* out_count) {
+    if (flags & ~MSG_DONTWAIT) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    const zx_time_t deadline = zxs_deadline(socket, flags);
+    size_t sent = 0u;
+    for (; sent < count; ++sent) {
+        size_t actual = 0u;
+        zx_status_t status = zxs_sendmsg_internal(socket, &msgvec[sent].msg_hdr,
+                                                  deadline, &actual);
+        if (status != ZX_OK) {
+            if (sent > 0) {
+                break;
+            }
+            return status;
+        }
+        msgvec[sent].msg_len = static_cast<unsigned int>(actual);
+    }
+    *out_count = sent;
+    return ZX_OK;
+}
+
+zx_status_t zxs_recvmmsg(const zxs_socket_t* socket, struct mmsghdr* msgvec,
+                         size_t count, int flags, zx_time_t deadline,
+                         size_t* out_count) {
+    if (flags & ~(MSG_DONTWAIT | MSG_WAITFORONE)) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    if (zxs_deadline(socket, flags) == 0) {
+        deadline = 0;
+    }
+    size_t received = 0u;
+    for (; received < count; ++received) {
+        size_t actual = 0u;
+        zx_status_t status = zxs_recvmsg_internal(socket,
+                                                  &msgvec[received].msg_hdr,
+                                                  deadline, &actual);
+        if (status != ZX_OK) {
+            if (received > 0) {
+                break;
+            }
+            return status;
+        }
+        msgvec[received].msg_len = static_cast<unsigned int>(actual);
+        // The end of a stream ends the batch.
+        if (actual == 0 && !(socket->flags & ZXS_FLAG_DATAGRAM)) {
+            ++received;
+            break;
+        }
+        if (flags & MSG_WAITFORONE) {
+            deadline = 0;
+        }
+    }
+    *out_count = received;
+    return ZX_OK;
 }
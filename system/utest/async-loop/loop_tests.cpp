@@ -20,6 +20,7 @@
 #include <fbl/auto_lock.h>
 #include <fbl/function.h>
 #include <fbl/mutex.h>
+#include <fbl/vector.h>
 #include <lib/zx/event.h>
 #include <unittest/unittest.h>
 #include <zircon/status.h>
@@ -169,6 +170,22 @@ protected:
     }
 };
 
+class OrderedTask : public TestTask {
+public:
+    OrderedTask() = default;
+
+    void set_order(fbl::Vector<OrderedTask*>* order) { order_ = order; }
+
+protected:
+    void Handle(async_dispatcher_t* dispatcher, zx_status_t status) override {
+        TestTask::Handle(dispatcher, status);
+        order_->push_back(this);
+    }
+
+private:
+    fbl::Vector<OrderedTask*>* order_ = nullptr;
+};
+
 class RepeatingTask : public TestTask {
 public:
     RepeatingTask(zx::duration interval, uint32_t repeat_count)
@@ -751,6 +768,82 @@ bool task_test() {
     END_TEST;
 }
 
+bool task_order_test() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+
+    // Post more tasks than the loop initially has room for, out of order,
+    // with several sharing each deadline.
+    constexpr size_t kTaskCount = 64u;
+    zx::time start_time = async::Now(loop.dispatcher());
+    fbl::Vector<OrderedTask*> order;
+    OrderedTask tasks[kTaskCount];
+    for (size_t i = 0; i < kTaskCount; i++) {
+        tasks[i].set_order(&order);
+        zx::time deadline = start_time - zx::msec((i * 7u) % 10u);
+        EXPECT_EQ(ZX_OK, tasks[i].PostForTime(loop.dispatcher(), deadline), "post");
+    }
+    for (size_t i = 0; i < kTaskCount; i += 5u) {
+        EXPECT_EQ(ZX_OK, tasks[i].Cancel(loop.dispatcher()), "cancel");
+    }
+
+    // The tasks run earliest deadline first, and in the order they were
+    // posted when their deadlines are equal.
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    ASSERT_EQ(kTaskCount - (kTaskCount + 4u) / 5u, order.size(), "run count");
+    for (size_t i = 1; i < order.size(); i++) {
+        EXPECT_TRUE(order[i - 1]->deadline < order[i]->deadline ||
+                        (order[i - 1]->deadline == order[i]->deadline &&
+                         order[i - 1] < order[i]),
+                    "order");
+    }
+    for (size_t i = 0; i < kTaskCount; i++) {
+        EXPECT_EQ(i % 5u ? 1u : 0u, tasks[i].run_count, "run count");
+    }
+
+    END_TEST;
+}
+
+bool task_cancel_many_test() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+
+    // Cancel most of the tasks, as a server resetting timeouts would, and
+    // post some of them again.
+    constexpr size_t kTaskCount = 256u;
+    zx::time start_time = async::Now(loop.dispatcher());
+    fbl::Vector<OrderedTask*> order;
+    OrderedTask tasks[kTaskCount];
+    for (size_t i = 0; i < kTaskCount; i++) {
+        tasks[i].set_order(&order);
+        zx::time deadline = start_time - zx::msec((i * 13u) % 32u);
+        EXPECT_EQ(ZX_OK, tasks[i].PostForTime(loop.dispatcher(), deadline), "post");
+    }
+    for (size_t i = 0; i < kTaskCount; i++) {
+        if (i % 4u) {
+            EXPECT_EQ(ZX_OK, tasks[i].Cancel(loop.dispatcher()), "cancel");
+        }
+    }
+    for (size_t i = 0; i < kTaskCount; i += 8u) {
+        EXPECT_EQ(ZX_ERR_NOT_FOUND, tasks[i + 1u].Cancel(loop.dispatcher()), "cancel again");
+        EXPECT_EQ(ZX_OK, tasks[i + 1u].PostForTime(loop.dispatcher(), start_time), "repost");
+    }
+
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    ASSERT_EQ(kTaskCount / 4u + kTaskCount / 8u, order.size(), "run count");
+    for (size_t i = 1; i < order.size(); i++) {
+        EXPECT_LE(order[i - 1]->deadline, order[i]->deadline, "order");
+    }
+    for (size_t i = 0; i < kTaskCount; i++) {
+        uint32_t expected = (i % 4u == 0u || i % 8u == 1u) ? 1u : 0u;
+        EXPECT_EQ(expected, tasks[i].run_count, "run count");
+    }
+
+    END_TEST;
+}
+
 bool task_shutdown_test() {
     BEGIN_TEST;
 
@@ -1379,6 +1472,8 @@ RUN_TEST(wait_test)
 RUN_TEST(wait_unwaitable_handle_test)
 RUN_TEST(wait_shutdown_test)
 RUN_TEST(task_test)
+RUN_TEST(task_order_test)
+RUN_TEST(task_cancel_many_test)
 RUN_TEST(task_shutdown_test)
 RUN_TEST(receiver_test)
 RUN_TEST(receiver_shutdown_test)
@@ -518,6 +518,87 @@ template <typename RawBitmap> static bool GrowFailure(void) {
     END_TEST;
 }
 
+// Checks Scan, ReverseScan, Find and ReverseFind against bit by bit versions,
+// over long runs which span many words.
+template <typename RawBitmap> static bool ScanLongRuns(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 64 * kBits + 17;
+    RawBitmap bitmap;
+    ASSERT_EQ(bitmap.Reset(kSize), ZX_OK);
+
+    // A few long runs of set bits, between long runs of cleared ones.
+    const size_t runs[][2] = { { 3, 700 }, { 1100, 1101 }, { 1900, 3000 }, { 4000, kSize } };
+    for (const auto& run : runs) {
+        ASSERT_EQ(bitmap.Set(run[0], run[1]), ZX_OK);
+    }
+
+    const size_t offsets[] = { 0, 1, 64, 65, 699, 700, 1100, 1500, 2999, 3500, kSize - 1 };
+    const size_t run_lens[] = { 1, 100, 400, 800 };
+    const bool values[] = { false, true };
+    for (size_t bitoff : offsets) {
+        for (size_t bitmax : offsets) {
+            for (bool is_set : values) {
+                size_t first = bitmax;
+                for (size_t i = bitoff; i < bitmax; i++) {
+                    if (bitmap.GetOne(i) != is_set) {
+                        first = i;
+                        break;
+                    }
+                }
+                size_t out = bitmax;
+                EXPECT_EQ(bitmap.Scan(bitoff, bitmax, is_set, &out), first == bitmax);
+                EXPECT_EQ(out, first);
+
+                size_t last = bitmax;
+                for (size_t i = bitmax; i > bitoff; i--) {
+                    if (bitmap.GetOne(i - 1) != is_set) {
+                        last = i - 1;
+                        break;
+                    }
+                }
+                out = bitmax;
+                EXPECT_EQ(bitmap.ReverseScan(bitoff, bitmax, is_set, &out), last == bitmax);
+                EXPECT_EQ(out, last);
+
+                if (bitoff >= bitmax) {
+                    continue;
+                }
+                for (size_t run_len : run_lens) {
+                    size_t expected = bitmax;
+                    for (size_t start = bitoff; start + run_len <= bitmax; start++) {
+                        if (bitmap.Scan(start, start + run_len, is_set)) {
+                            expected = start;
+                            break;
+                        }
+                    }
+                    size_t found;
+                    zx_status_t status = bitmap.Find(is_set, bitoff, bitmax, run_len, &found);
+                    EXPECT_EQ(status, expected == bitmax ? ZX_ERR_NO_RESOURCES : ZX_OK);
+                    if (status == ZX_OK) {
+                        EXPECT_EQ(found, expected);
+                    }
+
+                    expected = bitmax;
+                    for (size_t end = bitmax; end >= bitoff + run_len; end--) {
+                        if (bitmap.Scan(end - run_len, end, is_set)) {
+                            expected = end - run_len;
+                            break;
+                        }
+                    }
+                    status = bitmap.ReverseFind(is_set, bitoff, bitmax, run_len, &found);
+                    EXPECT_EQ(status, expected == bitmax ? ZX_ERR_NO_RESOURCES : ZX_OK);
+                    if (status == ZX_OK) {
+                        EXPECT_EQ(found, expected);
+                    }
+                }
+            }
+        }
+    }
+
+    END_TEST;
+}
+
 #define RUN_TEMPLATIZED_TEST(test, specialization) RUN_TEST(test<specialization>)
 #define ALL_TESTS(specialization)                                                                  \
     RUN_TEMPLATIZED_TEST(InitializedEmpty, specialization)                                         \
@@ -527,6 +608,7 @@ template <typename RawBitmap> static bool GrowFailure(void) {
     RUN_TEMPLATIZED_TEST(GetReturnArg, specialization)                                             \
     RUN_TEMPLATIZED_TEST(SetRange, specialization)                                                 \
     RUN_TEMPLATIZED_TEST(FindSimple, specialization)                                               \
+    RUN_TEMPLATIZED_TEST(ScanLongRuns, specialization)                                             \
     RUN_TEMPLATIZED_TEST(ClearSubrange, specialization)                                            \
     RUN_TEMPLATIZED_TEST(BoundaryArguments, specialization)                                        \
     RUN_TEMPLATIZED_TEST(ClearAll, specialization)                                                 \
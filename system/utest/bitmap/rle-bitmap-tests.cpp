@@ -506,6 +506,65 @@ static bool FindRange(void) {
     END_TEST;
 }
 
+// Applies many pseudo-random Sets and Clears, and checks the bitmap against a
+// plain array of bits after each one.
+static bool RandomOperations(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kMaxVal = 1024;
+    bool bits[kMaxVal] = {};
+    RleBitmap bitmap;
+
+    uint32_t seed = 1;
+    for (size_t op = 0; op < 2000; op++) {
+        seed = seed * 1103515245 + 12345;
+        size_t bitoff = (seed >> 8) % kMaxVal;
+        seed = seed * 1103515245 + 12345;
+        size_t bitmax = fbl::min(kMaxVal, bitoff + (seed >> 8) % 64);
+        bool set = (op % 3) != 0;
+        if (set) {
+            ASSERT_EQ(bitmap.Set(bitoff, bitmax), ZX_OK);
+        } else {
+            ASSERT_EQ(bitmap.Clear(bitoff, bitmax), ZX_OK);
+        }
+        for (size_t i = bitoff; i < bitmax; i++) {
+            bits[i] = set;
+        }
+
+        // Ranges must be ordered, and neither overlap nor touch.
+        size_t num_bits = 0;
+        size_t prev_end = 0;
+        bool first = true;
+        for (const auto& range : bitmap) {
+            ASSERT_GT(range.bitlen, 0U);
+            ASSERT_TRUE(first || range.bitoff > prev_end);
+            for (size_t i = prev_end; i < range.bitoff; i++) {
+                ASSERT_FALSE(bits[i]);
+            }
+            for (size_t i = range.bitoff; i < range.end(); i++) {
+                ASSERT_TRUE(bits[i]);
+            }
+            num_bits += range.bitlen;
+            prev_end = range.end();
+            first = false;
+        }
+        for (size_t i = prev_end; i < kMaxVal; i++) {
+            ASSERT_FALSE(bits[i]);
+        }
+        ASSERT_EQ(num_bits, bitmap.num_bits());
+
+        size_t first_unset;
+        bitmap.Get(bitoff, kMaxVal, &first_unset);
+        size_t expected = bitoff;
+        while (expected < kMaxVal && bits[expected]) {
+            expected++;
+        }
+        ASSERT_EQ(first_unset, expected);
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(rle_bitmap_tests)
 RUN_TEST(InitializedEmpty)
 RUN_TEST(SingleBit)
@@ -522,6 +581,7 @@ RUN_TEST(ClearAll)
 RUN_TEST(SetOutOfOrder)
 RUN_TEST(SetOverlap)
 RUN_TEST(FindRange)
+RUN_TEST(RandomOperations)
 END_TEST_CASE(rle_bitmap_tests);
 
 } // namespace tests
@@ -30,6 +30,7 @@
 #include <fvm/fvm.h>
 #include <lib/async-loop/cpp/loop.h>
 #include <lib/fdio/io.h>
+#include <lib/fdio/vfs.h>
 #include <lib/fzl/fdio.h>
 #include <lib/memfs/memfs.h>
 #include <unittest/unittest.h>
@@ -920,6 +921,52 @@ static bool TestReaddir(BlobfsTest* blobfsTest) {
     END_HELPER;
 }
 
+static bool TestReaddirPlus(BlobfsTest* blobfsTest) {
+    BEGIN_HELPER;
+    constexpr size_t kEntries = 10;
+
+    fbl::unique_ptr<blob_info_t> info[kEntries];
+    for (size_t i = 0; i < kEntries; i++) {
+        ASSERT_TRUE(GenerateRandomBlob((i + 1) * 1000, &info[i]));
+        fbl::unique_fd fd;
+        ASSERT_TRUE(MakeBlob(info[i].get(), &fd));
+    }
+
+    fbl::unique_fd dirfd(open(MOUNT_PATH, O_RDONLY | O_DIRECTORY));
+    ASSERT_TRUE(dirfd);
+    fzl::FdioCaller caller(fbl::move(dirfd));
+    uint8_t buf[fuchsia_io_MAX_BUF];
+    size_t actual;
+    size_t entries_seen = 0;
+    do {
+        zx_status_t status;
+        ASSERT_EQ(fuchsia_io_DirectoryReadDirentsPlus(caller.borrow_channel(), sizeof(buf),
+                                                      &status, buf, sizeof(buf), &actual),
+                  ZX_OK);
+        ASSERT_EQ(status, ZX_OK);
+        for (size_t off = 0; off < actual; entries_seen++) {
+            const vdirent_plus_t* entry = reinterpret_cast<const vdirent_plus_t*>(buf + off);
+            off += sizeof(vdirent_plus_t) + entry->size;
+            size_t i = 0;
+            for (; i < kEntries; i++) {
+                const char* name = strrchr(info[i]->path, '/') + 1;
+                if (strlen(name) == entry->size && !memcmp(name, entry->name, entry->size)) {
+                    break;
+                }
+            }
+            ASSERT_LT(i, kEntries, "Blobfs ReadDirentsPlus found an unexpected entry");
+            EXPECT_EQ(entry->content_size, info[i]->size_data);
+            EXPECT_TRUE(S_ISREG(entry->mode));
+        }
+    } while (actual != 0);
+    ASSERT_EQ(entries_seen, kEntries);
+
+    for (size_t i = 0; i < kEntries; i++) {
+        ASSERT_EQ(unlink(info[i]->path), 0);
+    }
+    END_HELPER;
+}
+
 static bool TestDiskTooSmall(BlobfsTest* blobfsTest) {
     BEGIN_TEST;
 
@@ -1325,6 +1372,33 @@ static bool CreateUmountRemountSmall(BlobfsTest* blobfsTest) {
     END_HELPER;
 }
 
+// Reads a large blob out of order after a remount, so that its chunks are
+// loaded and verified a few at a time.
+static bool ReadRangesAfterRemount(BlobfsTest* blobfsTest) {
+    BEGIN_HELPER;
+    fbl::unique_ptr<blob_info_t> info;
+    ASSERT_TRUE(GenerateRandomBlob((1 << 20) + 12345, &info));
+
+    fbl::unique_fd fd;
+    ASSERT_TRUE(MakeBlob(info.get(), &fd));
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_TRUE(blobfsTest->Remount(), "Could not re-mount blobfs");
+
+    fd.reset(open(info->path, O_RDONLY));
+    ASSERT_TRUE(fd, "Failed to open blob");
+    constexpr size_t kReadSize = 1000;
+    char buf[kReadSize];
+    const size_t offsets[] = {info->size_data - kReadSize, 0, (1 << 16) - 10, 300000};
+    for (size_t off : offsets) {
+        ASSERT_EQ(pread(fd.get(), buf, kReadSize, off), static_cast<ssize_t>(kReadSize));
+        ASSERT_EQ(memcmp(buf, &info->data[off], kReadSize), 0);
+    }
+    ASSERT_TRUE(VerifyContents(fd.get(), info->data.get(), info->size_data));
+    ASSERT_EQ(close(fd.release()), 0, "Could not close blob");
+    ASSERT_EQ(unlink(info->path), 0);
+    END_HELPER;
+}
+
 static bool check_not_readable(int fd) {
     BEGIN_HELPER;
     struct pollfd fds;
@@ -2348,12 +2422,12 @@ static bool TestCompressorBufferTooSmall(void) {
     fbl::AllocChecker ac;
     fbl::unique_ptr<char[]> buf(new (&ac) char[buf_size]);
     EXPECT_EQ(ac.check(), true);
-    ASSERT_EQ(c.Initialize(buf.get(), buf_size), ZX_OK);
 
     // Create data that is just too big to fit within this buffer size.
     size_t data_size = 0;
     while (c.BufferMax(++data_size) <= buf_size) {}
     ASSERT_GT(data_size, 0);
+    ASSERT_EQ(c.Initialize(buf.get(), buf_size, data_size), ZX_OK);
 
     unsigned int seed = 0;
     fbl::unique_ptr<char[]> data(new (&ac) char[data_size]);
@@ -2363,7 +2437,61 @@ static bool TestCompressorBufferTooSmall(void) {
         data[i] = static_cast<char>(rand_r(&seed));
     }
 
-    ASSERT_EQ(c.Update(&data, data_size), ZX_ERR_IO_DATA_INTEGRITY);
+    ASSERT_EQ(c.Update(data.get(), data_size), ZX_ERR_IO_DATA_INTEGRITY);
+    END_TEST;
+}
+
+// Ensure chunks of a compressed blob can be decompressed independently, in any order.
+static bool TestChunkedDecompression(void) {
+    BEGIN_TEST;
+    blobfs::Compressor c;
+
+    // A few chunks of compressible data, the last of them partial.
+    const size_t data_size = 3 * blobfs::kCompressionChunkSize + 1000;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<uint8_t[]> data(new (&ac) uint8_t[data_size]);
+    ASSERT_EQ(ac.check(), true);
+    unsigned int seed = 0;
+    for (size_t i = 0; i < data_size; i++) {
+        data[i] = static_cast<uint8_t>(rand_r(&seed) % 4);
+    }
+
+    const size_t buf_size = c.BufferMax(data_size);
+    fbl::unique_ptr<uint8_t[]> buf(new (&ac) uint8_t[buf_size]);
+    ASSERT_EQ(ac.check(), true);
+    ASSERT_EQ(c.Initialize(buf.get(), buf_size, data_size), ZX_OK);
+    ASSERT_EQ(c.Update(data.get(), 10), ZX_OK);
+    ASSERT_EQ(c.Update(data.get() + 10, data_size - 10), ZX_OK);
+    ASSERT_EQ(c.Update(data.get(), 1), ZX_ERR_OUT_OF_RANGE);
+    ASSERT_EQ(c.End(), ZX_OK);
+    ASSERT_LT(c.Size(), data_size);
+
+    // The table must be read in full before any chunk.
+    blobfs::ChunkedDecompressor d;
+    size_t table_size = sizeof(blobfs::ChunkTable);
+    ASSERT_EQ(d.Initialize(buf.get(), &table_size, data_size, c.Size()), ZX_ERR_BUFFER_TOO_SMALL);
+    ASSERT_EQ(table_size, blobfs::ChunkTableSize(4));
+    ASSERT_EQ(d.Initialize(buf.get(), &table_size, data_size, c.Size()), ZX_OK);
+    ASSERT_EQ(d.ChunkCount(), 4);
+    ASSERT_EQ(d.ChunkLength(3), 1000);
+
+    fbl::unique_ptr<uint8_t[]> out(new (&ac) uint8_t[data_size]);
+    ASSERT_EQ(ac.check(), true);
+    const uint32_t order[] = {2, 0, 3, 1};
+    for (uint32_t chunk : order) {
+        const uint8_t* src = buf.get() + d.CompressedStart(chunk);
+        ASSERT_EQ(d.DecompressChunk(chunk, src, out.get() + d.ChunkStart(chunk)), ZX_OK);
+    }
+    ASSERT_EQ(memcmp(out.get(), data.get(), data_size), 0);
+
+    // Tables which don't describe the blob are rejected.
+    blobfs::ChunkedDecompressor bad;
+    table_size = c.Size();
+    ASSERT_EQ(bad.Initialize(buf.get(), &table_size, data_size * 2, c.Size()),
+              ZX_ERR_IO_DATA_INTEGRITY);
+    table_size = c.Size();
+    ASSERT_EQ(bad.Initialize(buf.get(), &table_size, data_size, c.Size() - 1),
+              ZX_ERR_IO_DATA_INTEGRITY);
     END_TEST;
 }
 
@@ -2605,6 +2733,7 @@ RUN_TESTS(MEDIUM, TestCompressibleBlob)
 RUN_TESTS(MEDIUM, TestMmap)
 RUN_TESTS(MEDIUM, TestMmapUseAfterClose)
 RUN_TESTS(MEDIUM, TestReaddir)
+RUN_TESTS(MEDIUM, TestReaddirPlus)
 RUN_TESTS(MEDIUM, TestDiskTooSmall)
 RUN_TEST_FVM(MEDIUM, TestQueryInfo)
 RUN_TESTS(MEDIUM, UseAfterUnlink)
@@ -2619,6 +2748,7 @@ RUN_TESTS(MEDIUM, UmountWithOpenFile)
 RUN_TESTS(MEDIUM, UmountWithMappedFile)
 RUN_TESTS(MEDIUM, UmountWithOpenMappedFile)
 RUN_TESTS(MEDIUM, CreateUmountRemountSmall)
+RUN_TESTS(MEDIUM, ReadRangesAfterRemount)
 RUN_TESTS(MEDIUM, EarlyRead)
 RUN_TESTS(MEDIUM, WaitForRead)
 RUN_TESTS(MEDIUM, WriteSeekIgnored)
@@ -2639,6 +2769,7 @@ RUN_TEST_FVM(MEDIUM, ResizePartition)
 RUN_TEST_FVM(MEDIUM, CorruptAtMount)
 RUN_TESTS(LARGE, CreateWriteReopen)
 RUN_TEST(TestCompressorBufferTooSmall)
+RUN_TEST(TestChunkedDecompression)
 RUN_TEST_MEDIUM(TestCreateFailure)
 RUN_TEST_MEDIUM(TestExtendFailure)
 RUN_TEST_LARGE(TestLargeBlob)
@@ -9,10 +9,12 @@
 
 #include <cobalt-client/cpp/collector-internal.h>
 #include <cobalt-client/cpp/collector.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/unique_ptr.h>
 #include <fbl/vector.h>
 #include <lib/sync/completion.h>
 #include <unittest/unittest.h>
+#include <zircon/assert.h>
 
 namespace cobalt_client {
 namespace internal {
@@ -94,8 +96,10 @@ public:
             histograms_->InsertOrUpdateEntry(
                 metric_info, [&histogram](fbl::unique_ptr<BaseHistogram>* persisted) {
                     if (*persisted == nullptr) {
+                        fbl::AllocChecker ac;
                         persisted->reset(new BaseHistogram(
-                            static_cast<uint32_t>(histogram.event_data().count())));
+                            static_cast<uint32_t>(histogram.event_data().count()), &ac));
+                        ZX_ASSERT(ac.check());
                     }
                     for (auto& bucket : histogram.event_data()) {
                         (*persisted)->IncrementCount(bucket.index, bucket.count);
@@ -105,9 +105,10 @@ bool TestExchangeByVal() {
     END_TEST;
 }
 
+template <typename CounterType>
 struct IncrementArgs {
     // Counter to be operated on.
-    BaseCounter* counter;
+    CounterType* counter;
 
     // Wait for main thread to signal before we start.
     sync_completion_t* start;
@@ -116,8 +117,9 @@ struct IncrementArgs {
     BaseCounter::Type value;
 };
 
+template <typename CounterType>
 int IncrementFn(void* args) {
-    IncrementArgs* increment_args = static_cast<IncrementArgs*>(args);
+    IncrementArgs<CounterType>* increment_args = static_cast<IncrementArgs<CounterType>*>(args);
     sync_completion_wait(increment_args->start, zx::sec(20).get());
     for (uint64_t i = 0; i < increment_args->value; ++i) {
         increment_args->counter->Increment(increment_args->value);
@@ -125,12 +127,13 @@ int IncrementFn(void* args) {
     return thrd_success;
 }
 
+template <typename CounterType>
 bool TestIncrementMultiThread() {
     BEGIN_TEST;
     sync_completion_t start;
-    BaseCounter counter;
+    CounterType counter;
     fbl::Vector<thrd_t> thread_ids;
-    IncrementArgs args[kThreads];
+    IncrementArgs<CounterType> args[kThreads];
 
     thread_ids.reserve(kThreads);
     for (uint64_t i = 0; i < kThreads; ++i) {
@@ -142,7 +145,7 @@ bool TestIncrementMultiThread() {
         args[i].counter = &counter;
         args[i].value = static_cast<BaseCounter::Type>(i + 1);
         args[i].start = &start;
-        ASSERT_EQ(thrd_create(&thread_id, IncrementFn, &args[i]), thrd_success);
+        ASSERT_EQ(thrd_create(&thread_id, IncrementFn<CounterType>, &args[i]), thrd_success);
     }
 
     // Notify threads to start incrementing the count.
@@ -342,15 +345,46 @@ bool TestFlushMultithread() {
     END_TEST;
 }
 
+// Verify that exchanging a sharded counter returns the increments of every shard.
+bool TestShardedExchange() {
+    BEGIN_TEST;
+    ShardedCounter counter;
+    sync_completion_t start;
+    IncrementArgs<ShardedCounter> args[kShardCount];
+    thrd_t threads[kShardCount];
+    for (uint32_t i = 0; i < kShardCount; ++i) {
+        args[i].counter = &counter;
+        args[i].value = 2;
+        args[i].start = &start;
+        ASSERT_EQ(thrd_create(&threads[i], IncrementFn<ShardedCounter>, &args[i]), thrd_success);
+    }
+    sync_completion_signal(&start);
+    for (auto& thread : threads) {
+        thrd_join(thread, nullptr);
+    }
+    counter.Increment(3);
+
+    EXPECT_EQ(counter.Exchange(5), kShardCount * 4 + 3);
+    EXPECT_EQ(counter.Load(), 5);
+    EXPECT_EQ(counter.Exchange(), 5);
+    EXPECT_EQ(counter.Load(), 0);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(BaseCounterTest)
 RUN_TEST(TestIncrement)
 RUN_TEST(TestIncrementByVal)
 RUN_TEST(TestExchange)
 RUN_TEST(TestExchangeByVal)
-RUN_TEST(TestIncrementMultiThread)
+RUN_TEST(TestIncrementMultiThread<BaseCounter>)
 RUN_TEST(TestExchangeMultiThread)
 END_TEST_CASE(BaseCounterTest)
 
+BEGIN_TEST_CASE(ShardedCounterTest)
+RUN_TEST(TestIncrementMultiThread<ShardedCounter>)
+RUN_TEST(TestShardedExchange)
+END_TEST_CASE(ShardedCounterTest)
+
 BEGIN_TEST_CASE(RemoteCounterTest)
 RUN_TEST(TestFlush)
 RUN_TEST(TestFlushMultithread)
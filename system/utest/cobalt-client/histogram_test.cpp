@@ -13,6 +13,7 @@
 #include <cobalt-client/cpp/histogram-internal.h>
 #include <cobalt-client/cpp/histogram.h>
 #include <cobalt-client/cpp/metric-options.h>
+#include <fbl/alloc_checker.h>
 #include <fbl/auto_call.h>
 #include <fbl/string.h>
 #include <fbl/string_printf.h>
@@ -20,6 +21,7 @@
 #include <lib/sync/completion.h>
 #include <lib/zx/time.h>
 #include <unittest/unittest.h>
+#include <zircon/assert.h>
 
 namespace cobalt_client {
 namespace internal {
@@ -52,7 +54,10 @@ RemoteMetricInfo MakeRemoteMetricInfo() {
 }
 
 RemoteHistogram MakeRemoteHistogram() {
-    return RemoteHistogram(kBuckets, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram histogram(kBuckets, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ZX_ASSERT(ac.check());
+    return histogram;
 }
 
 bool HistEventValuesEq(fidl::VectorView<HistogramBucket> actual,
@@ -79,7 +84,9 @@ bool HistEventValuesEq(fidl::VectorView<HistogramBucket> actual,
 // Verify the count of the appropiate bucket is updated on increment.
 bool TestIncrement() {
     BEGIN_TEST;
-    BaseHistogram histogram(kBuckets);
+    fbl::AllocChecker ac;
+    BaseHistogram histogram(kBuckets, &ac);
+    ASSERT_TRUE(ac.check());
 
     // Increase the count of each bucket bucket_index times.
     for (uint32_t bucket_index = 0; bucket_index < kBuckets; ++bucket_index) {
@@ -101,7 +108,9 @@ bool TestIncrement() {
 // verifies the behaviour for weighted histograms, where the weight is limited to an integer.
 bool TestIncrementByVal() {
     BEGIN_TEST;
-    BaseHistogram histogram(kBuckets);
+    fbl::AllocChecker ac;
+    BaseHistogram histogram(kBuckets, &ac);
+    ASSERT_TRUE(ac.check());
 
     // Increase the count of each bucket bucket_index times.
     for (uint32_t bucket_index = 0; bucket_index < kBuckets; ++bucket_index) {
@@ -149,7 +158,9 @@ int IncrementFn(void* args) {
 bool TestIncrementMultiThread() {
     BEGIN_TEST;
     sync_completion_t start;
-    BaseHistogram histogram(kBuckets);
+    fbl::AllocChecker ac;
+    BaseHistogram histogram(kBuckets, &ac);
+    ASSERT_TRUE(ac.check());
     fbl::Vector<thrd_t> thread_ids;
     IncrementArgs args[kThreads];
 
@@ -297,7 +308,9 @@ int FlushFn(void* args) {
 bool TestFlushMultithread() {
     BEGIN_TEST;
     sync_completion_t start;
-    BaseHistogram accumulated(kBuckets);
+    fbl::AllocChecker ac;
+    BaseHistogram accumulated(kBuckets, &ac);
+    ASSERT_TRUE(ac.check());
     RemoteHistogram histogram = MakeRemoteHistogram();
     fbl::Vector<thrd_t> thread_ids;
     FlushArgs args[kThreads];
@@ -340,7 +353,9 @@ bool TestAdd() {
     // Buckets 2^i + offset.
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/-10);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
 
@@ -355,6 +370,20 @@ bool TestAdd() {
     END_TEST;
 }
 
+// Verify that a histogram whose storage could not be allocated drops its samples.
+bool TestAddWithoutRemoteHistogram() {
+    BEGIN_TEST;
+    HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
+                                                             /*scalar=*/1, /*offset=*/-10);
+    ASSERT_TRUE(options.IsValid());
+    Histogram histogram(&options, nullptr);
+
+    histogram.Add(25, 4);
+    ASSERT_EQ(histogram.GetRemoteCount(25), 0);
+
+    END_TEST;
+}
+
 // Verify that from the public point of view, changes are reflected accurately, while internally
 // the buckets are accessed correctly.
 // Note: The two extra buckets, are for underflow and overflow buckets.
@@ -363,8 +392,11 @@ bool TestAddMultiple() {
     // Buckets 2^i + offset.
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/-10);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
-    BaseHistogram expected_hist(kBuckets + 2);
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
+    BaseHistogram expected_hist(kBuckets + 2, &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
 
@@ -415,8 +447,11 @@ bool TestAddAfterFlush() {
     // Buckets 2^i + offset.
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/-10);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
-    BaseHistogram expected_hist(kBuckets + 2);
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
+    BaseHistogram expected_hist(kBuckets + 2, &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
 
@@ -491,8 +526,11 @@ bool TestAddMultiThread() {
     // Buckets 2^i + offset.
     HistogramOptions options = HistogramOptions::Linear(/*bucket_count=*/kBuckets,
                                                         /*scalar=*/2, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
-    BaseHistogram expected_hist(kBuckets + 2);
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
+    BaseHistogram expected_hist(kBuckets + 2, &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     fbl::Vector<Observation> observations;
@@ -554,9 +592,13 @@ bool TestAddAndFlushMultiThread() {
     // Buckets 2^i + offset.
     HistogramOptions options = HistogramOptions::Linear(/*bucket_count=*/kBuckets,
                                                         /*scalar=*/2, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
-    BaseHistogram expected_hist(kBuckets + 2);
-    BaseHistogram flushed_hist(kBuckets + 2);
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
+    BaseHistogram expected_hist(kBuckets + 2, &ac);
+    ASSERT_TRUE(ac.check());
+    BaseHistogram flushed_hist(kBuckets + 2, &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     fbl::Vector<Observation> observations;
@@ -635,6 +677,7 @@ END_TEST_CASE(RemoteHistogramTest)
 
 BEGIN_TEST_CASE(HistogramTest)
 RUN_TEST(TestAdd)
+RUN_TEST(TestAddWithoutRemoteHistogram)
 RUN_TEST(TestAddAfterFlush)
 RUN_TEST(TestAddMultiple)
 RUN_TEST(TestAddMultiThread)
@@ -5,9 +5,11 @@
 #include <cobalt-client/cpp/histogram-internal.h>
 #include <cobalt-client/cpp/histogram.h>
 #include <cobalt-client/cpp/timer.h>
+#include <fbl/alloc_checker.h>
 #include <lib/zx/time.h>
 
 #include <unittest/unittest.h>
+#include <zircon/assert.h>
 
 namespace cobalt_client {
 namespace internal {
@@ -36,7 +38,10 @@ RemoteMetricInfo MakeRemoteMetricInfo() {
 }
 
 RemoteHistogram MakeRemoteHistogram() {
-    return RemoteHistogram(kBuckets, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram histogram(kBuckets, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ZX_ASSERT(ac.check());
+    return histogram;
 }
 
 template <int64_t return_val>
@@ -48,7 +53,9 @@ bool TestCollectOnDestruction() {
     BEGIN_TEST;
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     { auto timer = Timer(histogram, /*is_collecting=*/true, TicksToUnitStub<1>); }
@@ -67,7 +74,9 @@ bool TestCancel() {
     BEGIN_TEST;
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     {
@@ -87,7 +96,9 @@ bool TestNotIsCollecting() {
     BEGIN_TEST;
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     { auto timer = Timer(histogram, /*is_collecting=*/false, TicksToUnitStub<1>); }
@@ -104,7 +115,9 @@ bool TestEnd() {
     BEGIN_TEST;
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     {
@@ -126,7 +139,9 @@ bool TestMoveConstruct() {
     BEGIN_TEST;
     HistogramOptions options = HistogramOptions::Exponential(/*bucket_count=*/kBuckets, /*base=*/2,
                                                              /*scalar=*/1, /*offset=*/0);
-    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer());
+    fbl::AllocChecker ac;
+    RemoteHistogram remote_histogram(kBuckets + 2, MakeRemoteMetricInfo(), MakeEventBuffer(), &ac);
+    ASSERT_TRUE(ac.check());
     ASSERT_TRUE(options.IsValid());
     Histogram histogram(&options, &remote_histogram);
     {
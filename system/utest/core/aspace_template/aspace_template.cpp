@@ -0,0 +1,184 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <zircon/process.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+static const size_t kPageSize = ZX_PAGE_SIZE;
+
+static bool add_errors_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t tmpl;
+    ASSERT_EQ(zx_aspace_template_create(0u, &tmpl), ZX_OK);
+    EXPECT_EQ(zx_aspace_template_create(1u, &tmpl), ZX_ERR_INVALID_ARGS);
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(2 * kPageSize, 0u, &vmo), ZX_OK);
+
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ, 0u, vmo, 0u, kPageSize), ZX_OK);
+    // overlaps the first entry
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ, 0u, vmo, kPageSize, kPageSize),
+              ZX_ERR_ALREADY_EXISTS);
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ, 1u, vmo, 0u, kPageSize),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ, kPageSize, vmo, 0u, 0u),
+              ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_SPECIFIC, kPageSize, vmo, 0u, kPageSize),
+              ZX_ERR_INVALID_ARGS);
+
+    // without ZX_RIGHT_WRITE the VMO can only be mapped writable as a clone
+    zx_handle_t ro_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo, ZX_DEFAULT_VMO_RIGHTS & ~ZX_RIGHT_WRITE, &ro_vmo), ZX_OK);
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, kPageSize,
+                                     ro_vmo, 0u, kPageSize),
+              ZX_ERR_ACCESS_DENIED);
+    EXPECT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE |
+                                               ZX_ASPACE_TEMPLATE_COW,
+                                     kPageSize, ro_vmo, 0u, kPageSize),
+              ZX_OK);
+
+    EXPECT_EQ(zx_handle_close(ro_vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_EQ(zx_handle_close(tmpl), ZX_OK);
+
+    END_TEST;
+}
+
+static bool apply_empty_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t tmpl;
+    ASSERT_EQ(zx_aspace_template_create(0u, &tmpl), ZX_OK);
+
+    zx_handle_t vmar;
+    zx_vaddr_t addr;
+    EXPECT_EQ(zx_aspace_template_apply(tmpl, zx_vmar_root_self(), 0u, 0u, &vmar, &addr),
+              ZX_ERR_BAD_STATE);
+
+    EXPECT_EQ(zx_handle_close(tmpl), ZX_OK);
+
+    END_TEST;
+}
+
+static bool apply_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(2 * kPageSize, 0u, &vmo), ZX_OK);
+    const char text[] = "text";
+    const char data[] = "data";
+    ASSERT_EQ(zx_vmo_write(vmo, text, 0u, sizeof(text)), ZX_OK);
+    ASSERT_EQ(zx_vmo_write(vmo, data, kPageSize, sizeof(data)), ZX_OK);
+
+    // a shared read-only page, then a page of private data with a gap between
+    zx_handle_t tmpl;
+    ASSERT_EQ(zx_aspace_template_create(0u, &tmpl), ZX_OK);
+    ASSERT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ, 0u, vmo, 0u, kPageSize), ZX_OK);
+    ASSERT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE |
+                                               ZX_ASPACE_TEMPLATE_COW,
+                                     2 * kPageSize, vmo, kPageSize, kPageSize),
+              ZX_OK);
+
+    zx_handle_t vmar[2];
+    zx_vaddr_t addr[2];
+    for (int i = 0; i < 2; ++i) {
+        ASSERT_EQ(zx_aspace_template_apply(tmpl, zx_vmar_root_self(), 0u, 0u,
+                                           &vmar[i], &addr[i]),
+                  ZX_OK);
+        EXPECT_EQ(memcmp(reinterpret_cast<void*>(addr[i]), text, sizeof(text)), 0);
+        EXPECT_EQ(memcmp(reinterpret_cast<void*>(addr[i] + 2 * kPageSize), data, sizeof(data)),
+                  0);
+    }
+    EXPECT_NE(addr[0], addr[1]);
+
+    // the gap is left unmapped, but the child VMAR can map into it
+    zx_vaddr_t mapped;
+    EXPECT_EQ(zx_vmar_map(vmar[0], ZX_VM_PERM_READ | ZX_VM_SPECIFIC, kPageSize, vmo, 0u,
+                          kPageSize, &mapped),
+              ZX_OK);
+    EXPECT_EQ(mapped, addr[0] + kPageSize);
+
+    // each application has a clone of its own
+    char* private_data = reinterpret_cast<char*>(addr[0] + 2 * kPageSize);
+    private_data[0] = 'D';
+    EXPECT_EQ(reinterpret_cast<char*>(addr[1] + 2 * kPageSize)[0], 'd');
+    char buf[sizeof(data)];
+    ASSERT_EQ(zx_vmo_read(vmo, buf, kPageSize, sizeof(buf)), ZX_OK);
+    EXPECT_EQ(memcmp(buf, data, sizeof(data)), 0);
+
+    // the template keeps working once the VMO handle is gone
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+    zx_handle_t third;
+    zx_vaddr_t third_addr;
+    ASSERT_EQ(zx_aspace_template_apply(tmpl, zx_vmar_root_self(), 0u, 0u, &third, &third_addr),
+              ZX_OK);
+    EXPECT_EQ(memcmp(reinterpret_cast<void*>(third_addr), text, sizeof(text)), 0);
+    EXPECT_EQ(zx_vmar_destroy(third), ZX_OK);
+    EXPECT_EQ(zx_handle_close(third), ZX_OK);
+
+    for (auto v : vmar) {
+        EXPECT_EQ(zx_vmar_destroy(v), ZX_OK);
+        EXPECT_EQ(zx_handle_close(v), ZX_OK);
+    }
+    EXPECT_EQ(zx_handle_close(tmpl), ZX_OK);
+
+    END_TEST;
+}
+
+static bool apply_rights_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(kPageSize, 0u, &vmo), ZX_OK);
+    zx_handle_t tmpl;
+    ASSERT_EQ(zx_aspace_template_create(0u, &tmpl), ZX_OK);
+    ASSERT_EQ(zx_aspace_template_add(tmpl, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0u, vmo, 0u,
+                                     kPageSize),
+              ZX_OK);
+
+    // a VMAR that can't map writable can't take the template
+    zx_handle_t ro_vmar;
+    zx_vaddr_t ro_addr;
+    ASSERT_EQ(zx_vmar_allocate(zx_vmar_root_self(),
+                               ZX_VM_CAN_MAP_READ | ZX_VM_CAN_MAP_SPECIFIC, 0u,
+                               4 * kPageSize, &ro_vmar, &ro_addr),
+              ZX_OK);
+    zx_handle_t vmar;
+    zx_vaddr_t addr;
+    EXPECT_EQ(zx_aspace_template_apply(tmpl, ro_vmar, 0u, 0u, &vmar, &addr),
+              ZX_ERR_ACCESS_DENIED);
+
+    // nor can a template handle without ZX_RIGHT_READ be applied
+    zx_handle_t wo_tmpl;
+    ASSERT_EQ(zx_handle_duplicate(tmpl, ZX_RIGHT_WRITE, &wo_tmpl), ZX_OK);
+    EXPECT_EQ(zx_aspace_template_apply(wo_tmpl, zx_vmar_root_self(), 0u, 0u, &vmar, &addr),
+              ZX_ERR_ACCESS_DENIED);
+
+    EXPECT_EQ(zx_handle_close(wo_tmpl), ZX_OK);
+    EXPECT_EQ(zx_vmar_destroy(ro_vmar), ZX_OK);
+    EXPECT_EQ(zx_handle_close(ro_vmar), ZX_OK);
+    EXPECT_EQ(zx_handle_close(tmpl), ZX_OK);
+    EXPECT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(aspace_template_tests)
+RUN_TEST(add_errors_test)
+RUN_TEST(apply_empty_test)
+RUN_TEST(apply_test)
+RUN_TEST(apply_rights_test)
+END_TEST_CASE(aspace_template_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
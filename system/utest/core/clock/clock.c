@@ -32,8 +32,38 @@ static bool clock_monotonic_test(void) {
     END_TEST;
 }
 
+static bool clock_get_agrees_test(void) {
+    BEGIN_TEST;
+
+    // However the vDSO computes the clocks, they agree with each other.
+    for (int idx = 0; idx < 100; ++idx) {
+        zx_time_t before = zx_clock_get_monotonic();
+        zx_time_t mono = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        zx_time_t mono_new;
+        ASSERT_EQ(zx_clock_get_new(ZX_CLOCK_MONOTONIC, &mono_new), ZX_OK, "");
+        zx_time_t after = zx_clock_get_monotonic();
+
+        ASSERT_GE(mono, before, "");
+        ASSERT_GE(mono_new, mono, "");
+        ASSERT_GE(after, mono_new, "");
+    }
+
+    zx_time_t utc;
+    ASSERT_EQ(zx_clock_get_new(ZX_CLOCK_UTC, &utc), ZX_OK, "");
+    zx_time_t thread;
+    ASSERT_EQ(zx_clock_get_new(ZX_CLOCK_THREAD, &thread), ZX_OK, "");
+    EXPECT_GT(thread, 0, "");
+
+    zx_time_t bogus;
+    EXPECT_EQ(zx_clock_get_new(12345u, &bogus), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_clock_get(12345u), 0, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(clock_tests)
 RUN_TEST(clock_monotonic_test)
+RUN_TEST(clock_get_agrees_test)
 END_TEST_CASE(clock_tests)
 
 #ifndef BUILD_COMBINED_TESTS
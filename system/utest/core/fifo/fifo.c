@@ -161,10 +161,76 @@ static bool options_test(void) {
     END_TEST;
 }
 
+static bool shared_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t a, b;
+    enum { COUNT = 4, ELEM_SZ = sizeof(uint64_t) };
+    EXPECT_EQ(zx_fifo_create(COUNT, ELEM_SZ, 2, &a, &b), ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_fifo_create(COUNT, ELEM_SZ, ZX_FIFO_SHARED, &a, &b), ZX_OK, "");
+
+    zx_handle_t ring;
+    ASSERT_EQ(zx_fifo_get_ring(a, ZX_FIFO_RING_TX, &ring), ZX_OK, "");
+    uint64_t ring_size;
+    ASSERT_EQ(zx_vmo_get_size(ring, &ring_size), ZX_OK, "");
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+                          0, ring, 0, ring_size, &addr), ZX_OK, "");
+    zx_fifo_ring_header_t* header = (zx_fifo_ring_header_t*)addr;
+    uint64_t* entries = (uint64_t*)(addr + ZX_FIFO_RING_DATA_OFFSET);
+    EXPECT_EQ(header->elem_count, (uint32_t)COUNT, "");
+    EXPECT_EQ(header->elem_size, (uint32_t)ELEM_SZ, "");
+
+    // produce through the mapping; nothing is signaled until we say so
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        entries[i] = 100u + i;
+    }
+    __atomic_store_n(&header->head, COUNT, __ATOMIC_RELEASE);
+    EXPECT_SIGNALS(b, ZX_FIFO_WRITABLE);
+    EXPECT_EQ(zx_fifo_write(a, ELEM_SZ, NULL, 0, NULL), ZX_OK, "");
+    EXPECT_SIGNALS(a, 0u);
+    EXPECT_SIGNALS(b, ZX_FIFO_READABLE | ZX_FIFO_WRITABLE);
+
+    uint64_t v = 0;
+    EXPECT_EQ(zx_fifo_write(a, ELEM_SZ, &v, 1, NULL), ZX_ERR_SHOULD_WAIT, "");
+
+    // consume one with the system call; the writer is woken
+    size_t actual;
+    ASSERT_EQ(zx_fifo_read(b, ELEM_SZ, &v, 1, &actual), ZX_OK, "");
+    EXPECT_EQ(v, 100u, "");
+    EXPECT_EQ(__atomic_load_n(&header->tail, __ATOMIC_ACQUIRE), 1u, "");
+    EXPECT_SIGNALS(a, ZX_FIFO_WRITABLE);
+
+    // and one through the mapping behind the kernel's back
+    __atomic_store_n(&header->tail, 2u, __ATOMIC_RELEASE);
+    EXPECT_EQ(zx_fifo_read(b, ELEM_SZ, NULL, 0, NULL), ZX_OK, "");
+    ASSERT_EQ(zx_fifo_read(b, ELEM_SZ, &v, 1, &actual), ZX_OK, "");
+    EXPECT_EQ(v, 102u, "");
+
+    // garbage indexes are only ever read as a full ring
+    __atomic_store_n(&header->head, 1000u, __ATOMIC_RELEASE);
+    EXPECT_EQ(zx_fifo_write(a, ELEM_SZ, &v, 1, NULL), ZX_ERR_SHOULD_WAIT, "");
+
+    zx_handle_t plain[2];
+    ASSERT_EQ(zx_fifo_create(COUNT, ELEM_SZ, 0, &plain[0], &plain[1]), ZX_OK, "");
+    EXPECT_EQ(zx_fifo_get_ring(plain[0], ZX_FIFO_RING_RX, &ring), ZX_ERR_NOT_SUPPORTED, "");
+    EXPECT_EQ(zx_fifo_write(plain[0], ELEM_SZ, NULL, 0, NULL), ZX_ERR_OUT_OF_RANGE, "");
+    zx_handle_close(plain[0]);
+    zx_handle_close(plain[1]);
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, ring_size), ZX_OK, "");
+    zx_handle_close(ring);
+    zx_handle_close(a);
+    zx_handle_close(b);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(fifo_tests)
 RUN_TEST(basic_test)
 RUN_TEST(peer_closed_test)
 RUN_TEST(options_test)
+RUN_TEST(shared_test)
 END_TEST_CASE(fifo_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -465,6 +465,65 @@ static bool TestFutexMisaligned() {
     END_TEST;
 }
 
+// Test that futex_wait_pi() only accepts another thread of this process as the owner.
+static bool TestFutexWaitPiBadOwner() {
+    BEGIN_TEST;
+
+    zx_futex_t futex = 0;
+    ASSERT_EQ(zx_futex_wait_pi(&futex, 0, zx_thread_self(), ZX_TIME_INFINITE),
+              ZX_ERR_INVALID_ARGS);
+    ASSERT_EQ(zx_futex_wait_pi(&futex, 0, ZX_HANDLE_INVALID, ZX_TIME_INFINITE),
+              ZX_ERR_BAD_HANDLE);
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0, &event), ZX_OK);
+    ASSERT_EQ(zx_futex_wait_pi(&futex, 0, event, ZX_TIME_INFINITE), ZX_ERR_WRONG_TYPE);
+    ASSERT_EQ(zx_handle_close(event), ZX_OK);
+
+    END_TEST;
+}
+
+struct PiWaiter {
+    volatile int32_t* futex_addr;
+    zx_handle_t owner;
+    zx_status_t status;
+};
+
+static int pi_waiter_thread(void* arg) {
+    auto waiter = static_cast<PiWaiter*>(arg);
+    waiter->status = zx_futex_wait_pi(const_cast<int32_t*>(waiter->futex_addr),
+                                      *waiter->futex_addr, waiter->owner, ZX_TIME_INFINITE);
+    return 0;
+}
+
+// Test that futex_wake_pi() hands a priority inheritance futex to its
+// waiters one at a time.
+static bool TestFutexWakePi() {
+    BEGIN_TEST;
+
+    volatile int32_t futex_value = 1;
+    PiWaiter waiters[2];
+    thrd_t threads[2];
+    for (int i = 0; i < 2; i++) {
+        waiters[i] = {&futex_value, zx_thread_self(), ZX_ERR_INTERNAL};
+        ASSERT_EQ(thrd_create_with_name(&threads[i], pi_waiter_thread, &waiters[i],
+                                        "pi_waiter"), thrd_success);
+        ASSERT_TRUE(wait_until_blocked_on_some_futex(thrd_get_zx_handle(threads[i])));
+    }
+
+    ASSERT_EQ(zx_futex_wake_pi(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    ASSERT_EQ(zx_futex_wake_pi(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(thrd_join(threads[i], NULL), thrd_success);
+        EXPECT_EQ(waiters[i].status, ZX_OK);
+    }
+
+    // nothing is left waiting
+    ASSERT_EQ(zx_futex_wake_pi(const_cast<int32_t*>(&futex_value)), ZX_OK);
+
+    END_TEST;
+}
+
 static void log(const char* str) {
     zx_time_t now = zx_clock_get_monotonic();
     unittest_printf("[%08" PRIu64 ".%08" PRIu64 "]: %s",
@@ -557,6 +616,8 @@ RUN_TEST(TestFutexRequeueUnqueuedOnTimeout);
 RUN_TEST(TestFutexThreadKilled);
 RUN_TEST(TestFutexThreadSuspended);
 RUN_TEST(TestFutexMisaligned);
+RUN_TEST(TestFutexWaitPiBadOwner);
+RUN_TEST(TestFutexWakePi);
 RUN_TEST(TestEventSignaling);
 END_TEST_CASE(futex_tests)
 
@@ -115,6 +115,114 @@ static bool interrupt_port_bound_test(void) {
     END_TEST;
 }
 
+// Tests coalescing the packets of a bound interrupt
+static bool interrupt_moderation_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vinth;
+    zx_handle_t port;
+    zx_time_t signaled_timestamp_1 = 12345;
+    zx_time_t signaled_timestamp_2 = 67890;
+    zx_port_packet_t out;
+    zx_handle_t rsrc = get_root_resource();
+
+    ASSERT_EQ(zx_interrupt_create(rsrc, 0, ZX_INTERRUPT_VIRTUAL, &vinth), ZX_OK, "");
+    ASSERT_EQ(zx_port_create(ZX_PORT_BIND_TO_INTERRUPT, &port), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_bind(vinth, port, 0, 0), ZX_OK, "");
+
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 1, 0, 0), ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, -1, 0), ZX_ERR_INVALID_ARGS, "");
+
+    // held back until the count is reached
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, ZX_SEC(60), 3), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_trigger(vinth, 0, signaled_timestamp_1), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_trigger(vinth, 0, signaled_timestamp_2), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, zx_deadline_after(ZX_MSEC(1)), &out), ZX_ERR_TIMED_OUT, "");
+    ASSERT_EQ(zx_interrupt_trigger(vinth, 0, signaled_timestamp_2), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK, "");
+    ASSERT_EQ(out.type, ZX_PKT_TYPE_INTERRUPT, "");
+    ASSERT_EQ(out.interrupt.timestamp, signaled_timestamp_1, "");
+    ASSERT_EQ(out.interrupt.count, 3u, "");
+    ASSERT_EQ(zx_interrupt_ack(vinth), ZX_OK, "");
+
+    // or until the interval has passed
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, ZX_MSEC(1), 0), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_trigger(vinth, 0, signaled_timestamp_1), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK, "");
+    ASSERT_EQ(out.interrupt.timestamp, signaled_timestamp_1, "");
+    ASSERT_EQ(out.interrupt.count, 1u, "");
+
+    // turning moderation off delivers what is held back
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, ZX_SEC(60), 0), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_ack(vinth), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_trigger(vinth, 0, signaled_timestamp_2), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, zx_deadline_after(ZX_MSEC(1)), &out), ZX_ERR_TIMED_OUT, "");
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, 0, 0), ZX_OK, "");
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK, "");
+    ASSERT_EQ(out.interrupt.timestamp, signaled_timestamp_2, "");
+
+    // destroying with a packet held back
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, ZX_SEC(60), 0), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_ack(vinth), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_trigger(vinth, 0, signaled_timestamp_1), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_destroy(vinth), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_set_moderation(vinth, 0, 0, 0), ZX_ERR_CANCELED, "");
+
+    ASSERT_EQ(zx_handle_close(vinth), ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
+// Tests acking several interrupts at once
+static bool interrupt_ack_many_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vinth[2];
+    zx_handle_t port;
+    zx_port_packet_t out;
+    zx_handle_t rsrc = get_root_resource();
+
+    ASSERT_EQ(zx_port_create(ZX_PORT_BIND_TO_INTERRUPT, &port), ZX_OK, "");
+    for (uint64_t i = 0; i < 2; i++) {
+        ASSERT_EQ(zx_interrupt_create(rsrc, 0, ZX_INTERRUPT_VIRTUAL, &vinth[i]), ZX_OK, "");
+        ASSERT_EQ(zx_interrupt_bind(vinth[i], port, i, 0), ZX_OK, "");
+        ASSERT_EQ(zx_interrupt_trigger(vinth[i], 0, 1), ZX_OK, "");
+    }
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK, "");
+    }
+
+    // triggered again before being acked, each is delivered on the ack
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(zx_interrupt_trigger(vinth[i], 0, 2), ZX_OK, "");
+    }
+    ASSERT_EQ(zx_interrupt_ack_many(vinth, 2), ZX_OK, "");
+    uint64_t keys = 0;
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK, "");
+        ASSERT_EQ(out.interrupt.timestamp, 2, "");
+        keys |= 1u << out.key;
+    }
+    ASSERT_EQ(keys, 3u, "");
+
+    // a bad handle doesn't keep the others from being acked
+    zx_handle_t handles[3] = { ZX_HANDLE_INVALID, vinth[0], vinth[1] };
+    ASSERT_EQ(zx_interrupt_trigger(vinth[1], 0, 3), ZX_OK, "");
+    ASSERT_EQ(zx_interrupt_ack_many(handles, 3), ZX_ERR_BAD_HANDLE, "");
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &out), ZX_OK, "");
+    ASSERT_EQ(out.key, 1u, "");
+
+    ASSERT_EQ(zx_interrupt_ack_many(NULL, 0), ZX_OK, "");
+
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(zx_handle_close(vinth[i]), ZX_OK, "");
+    }
+    ASSERT_EQ(zx_handle_close(port), ZX_OK, "");
+
+    END_TEST;
+}
+
 // Tests support for virtual interrupts
 static bool interrupt_test(void) {
     BEGIN_TEST;
@@ -192,6 +300,8 @@ static bool interrupt_suspend_test(void) {
 BEGIN_TEST_CASE(interrupt_tests)
 RUN_TEST(interrupt_test)
 RUN_TEST(interrupt_port_bound_test)
+RUN_TEST(interrupt_moderation_test)
+RUN_TEST(interrupt_ack_many_test)
 RUN_TEST(interrupt_port_non_bindable_test)
 RUN_TEST(interrupt_suspend_test)
 END_TEST_CASE(interrupt_tests)
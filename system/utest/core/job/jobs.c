@@ -170,6 +170,49 @@ static bool kill_job_no_child_test(void) {
     END_TEST;
 }
 
+static bool kill_tree_test(void) {
+    BEGIN_TEST;
+
+    enum { kDepth = 4, kProcsPerJob = 8 };
+
+    zx_handle_t jobs[kDepth];
+    zx_handle_t procs[kDepth * kProcsPerJob];
+    zx_handle_t parent = zx_job_default();
+    for (int i = 0; i < kDepth; i++) {
+        ASSERT_EQ(zx_job_create(parent, 0u, &jobs[i]), ZX_OK, "");
+        parent = jobs[i];
+        for (int j = 0; j < kProcsPerJob; j++) {
+            zx_handle_t vmar;
+            ASSERT_EQ(zx_process_create(jobs[i], process_name, sizeof(process_name), 0u,
+                                        &procs[i * kProcsPerJob + j], &vmar), ZX_OK, "");
+            ASSERT_EQ(zx_handle_close(vmar), ZX_OK, "");
+        }
+    }
+
+    ASSERT_EQ(zx_task_kill(jobs[0]), ZX_OK, "");
+
+    // The whole subtree refuses new children as soon as the kill returns,
+    // even though the processes may still be being torn down.
+    zx_handle_t job;
+    ASSERT_EQ(zx_job_create(jobs[kDepth - 1], 0u, &job), ZX_ERR_BAD_STATE, "");
+
+    for (int i = 0; i < kDepth * kProcsPerJob; i++) {
+        ASSERT_EQ(zx_object_wait_one(
+            procs[i], ZX_TASK_TERMINATED, ZX_TIME_INFINITE, NULL), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(procs[i]), ZX_OK, "");
+    }
+
+    for (int i = kDepth - 1; i >= 0; i--) {
+        zx_signals_t signals;
+        ASSERT_EQ(zx_object_wait_one(
+            jobs[i], ZX_JOB_NO_PROCESSES, ZX_TIME_INFINITE, &signals), ZX_OK, "");
+        ASSERT_EQ(signals & ZX_JOB_NO_PROCESSES, ZX_JOB_NO_PROCESSES, "");
+        ASSERT_EQ(zx_handle_close(jobs[i]), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
 static bool set_job_oom_kill_bit(void) {
     BEGIN_TEST;
     // TODO(cpu): Other than trivial set/reset of the property this can't be
@@ -295,6 +338,7 @@ RUN_TEST(policy_basic_test)
 RUN_TEST(create_test)
 RUN_TEST(kill_test)
 RUN_TEST(kill_job_no_child_test)
+RUN_TEST(kill_tree_test)
 RUN_TEST(set_job_oom_kill_bit)
 RUN_TEST(wait_test)
 RUN_TEST(info_task_stats_fails)
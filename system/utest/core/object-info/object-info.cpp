@@ -898,6 +898,79 @@ bool job_children_smoke() {
     return jobch_helper_smoke(ZX_INFO_JOB_CHILDREN, kTestJobChildJobs);
 }
 
+// ZX_INFO_JOB_PROCESS_STATS tests
+
+bool job_process_stats_smoke() {
+    BEGIN_TEST;
+    zx_handle_t job = get_test_job();
+    zx_koid_t job_koid;
+    ASSERT_EQ(get_koid(job, &job_koid), ZX_OK);
+
+    // The whole tree is reported: the direct children and the grandchildren.
+    const size_t kExpectedProcs = kTestJobChildProcs + kTestJobChildJobs;
+    zx_info_process_stats_t stats[16];
+    size_t actual;
+    size_t avail;
+    ASSERT_EQ(zx_object_get_info(job, ZX_INFO_JOB_PROCESS_STATS,
+                                 stats, sizeof(stats), &actual, &avail),
+              ZX_OK);
+    EXPECT_EQ(kExpectedProcs, actual);
+    EXPECT_EQ(kExpectedProcs, avail);
+
+    size_t direct_children = 0;
+    for (size_t i = 0; i < actual; i++) {
+        char msg[32];
+        snprintf(msg, sizeof(msg), "koid %" PRIu64, stats[i].koid);
+        EXPECT_NE(stats[i].koid, ZX_KOID_INVALID, msg);
+        if (stats[i].job_koid == job_koid) {
+            direct_children++;
+        }
+        // None of the processes were started.
+        EXPECT_EQ(stats[i].thread_count, 0u, msg);
+        EXPECT_EQ(stats[i].cpu_runtime, 0, msg);
+        EXPECT_EQ(stats[i].task_stats.mem_private_bytes, 0u, msg);
+    }
+    EXPECT_EQ(kTestJobChildProcs, direct_children);
+    END_TEST;
+}
+
+// The record for this process should agree with ZX_INFO_TASK_STATS.
+bool job_process_stats_self() {
+    BEGIN_TEST;
+    zx_koid_t self_koid;
+    ASSERT_EQ(get_koid(zx_process_self(), &self_koid), ZX_OK);
+
+    size_t avail;
+    ASSERT_EQ(zx_object_get_info(zx_job_default(), ZX_INFO_JOB_PROCESS_STATS,
+                                 nullptr, 0, nullptr, &avail),
+              ZX_OK);
+    ASSERT_GT(avail, 0u);
+    // Leave room for processes that start while we're looking.
+    const size_t count = avail + 8;
+    zx_info_process_stats_t* stats =
+        static_cast<zx_info_process_stats_t*>(malloc(count * sizeof(*stats)));
+    ASSERT_NONNULL(stats);
+    size_t actual;
+    ASSERT_EQ(zx_object_get_info(zx_job_default(), ZX_INFO_JOB_PROCESS_STATS,
+                                 stats, count * sizeof(*stats), &actual, nullptr),
+              ZX_OK);
+
+    const zx_info_process_stats_t* self = nullptr;
+    for (size_t i = 0; i < actual; i++) {
+        if (stats[i].koid == self_koid) {
+            self = &stats[i];
+        }
+    }
+    ASSERT_NONNULL(self);
+    EXPECT_GE(self->thread_count, 1u);
+    EXPECT_GT(self->cpu_runtime, 0);
+    EXPECT_GT(self->task_stats.mem_mapped_bytes, 0u);
+    EXPECT_GT(self->task_stats.mem_private_bytes, 0u);
+
+    free(stats);
+    END_TEST;
+}
+
 uint32_t handle_count_or_zero(zx_handle_t handle) {
     zx_info_handle_count_t info;
     if (ZX_OK != zx_object_get_info(
@@ -1020,6 +1093,16 @@ RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_PROCESSES, zx_koid_t, zx_thread_se
 RUN_TEST((missing_rights_fails<ZX_INFO_JOB_PROCESSES, zx_koid_t, get_test_job,
                                ZX_RIGHT_ENUMERATE>));
 
+RUN_TEST(job_process_stats_smoke);
+RUN_TEST(job_process_stats_self);
+RUN_MULTI_ENTRY_TESTS(ZX_INFO_JOB_PROCESS_STATS, zx_info_process_stats_t, get_test_job);
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_PROCESS_STATS, zx_info_process_stats_t,
+                                  get_test_process>));
+RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_PROCESS_STATS, zx_info_process_stats_t,
+                                  zx_thread_self>));
+RUN_TEST((missing_rights_fails<ZX_INFO_JOB_PROCESS_STATS, zx_info_process_stats_t, get_test_job,
+                               ZX_RIGHT_ENUMERATE>));
+
 RUN_TEST(job_children_smoke);
 RUN_MULTI_ENTRY_TESTS(ZX_INFO_JOB_CHILDREN, zx_koid_t, get_test_job);
 RUN_TEST((wrong_handle_type_fails<ZX_INFO_JOB_CHILDREN, zx_koid_t, get_test_process>));
@@ -6,7 +6,9 @@
 #include <threads.h>
 
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 #include <zircon/syscalls/port.h>
+#include <zircon/threads.h>
 #include <fbl/algorithm.h>
 
 #include <unittest/unittest.h>
@@ -49,6 +51,55 @@ static bool basic_test(void) {
     END_TEST;
 }
 
+static bool wait_many_test(void) {
+    BEGIN_TEST;
+    zx_status_t status;
+
+    zx_handle_t port;
+    status = zx_port_create(0, &port);
+    EXPECT_EQ(status, ZX_OK, "could not create port");
+
+    zx_port_packet_t out[12] = {};
+    size_t actual = 0u;
+
+    status = zx_port_wait_many(port, 0, out, 0u, &actual);
+    EXPECT_EQ(status, ZX_ERR_INVALID_ARGS);
+
+    status = zx_port_wait_many(port, 0, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    for (uint64_t key = 0u; key < 10u; ++key) {
+        zx_port_packet_t in = {key, ZX_PKT_TYPE_USER, 0, {{}}};
+        status = zx_port_queue(port, &in);
+        EXPECT_EQ(status, ZX_OK);
+    }
+
+    // A short buffer only takes the oldest packets.
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out, 3u, &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 3u);
+    for (size_t i = 0u; i < actual; ++i) {
+        EXPECT_EQ(out[i].key, i);
+        EXPECT_EQ(out[i].type, ZX_PKT_TYPE_USER);
+    }
+
+    // A long one returns what is left without waiting for more.
+    status = zx_port_wait_many(port, ZX_TIME_INFINITE, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_OK);
+    EXPECT_EQ(actual, 7u);
+    for (size_t i = 0u; i < actual; ++i) {
+        EXPECT_EQ(out[i].key, i + 3u);
+    }
+
+    status = zx_port_wait_many(port, 0, out, fbl::count_of(out), &actual);
+    EXPECT_EQ(status, ZX_ERR_TIMED_OUT);
+
+    status = zx_handle_close(port);
+    EXPECT_EQ(status, ZX_OK);
+
+    END_TEST;
+}
+
 static bool queue_and_close_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -583,6 +634,74 @@ static bool threads_event(uint32_t wait_mode) {
     END_TEST;
 }
 
+static void wait_blocked_on_port(thrd_t thread) {
+    for (;;) {
+        zx_info_thread_t info;
+        zx_status_t status = zx_object_get_info(thrd_get_zx_handle(thread), ZX_INFO_THREAD,
+                                                &info, sizeof(info), nullptr, nullptr);
+        if (status != ZX_OK || info.state == ZX_THREAD_STATE_BLOCKED_PORT)
+            return;
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    }
+}
+
+struct wake_order_context {
+    zx_handle_t port;
+    uint64_t id;
+    uint64_t* first;
+};
+
+static int port_first_reader_thread(void* arg) {
+    auto ctx = reinterpret_cast<wake_order_context*>(arg);
+    zx_port_packet_t out = {};
+    auto st = zx_port_wait(ctx->port, ZX_TIME_INFINITE, &out);
+    if (st < 0)
+        return st;
+    uint64_t none = 0u;
+    __atomic_compare_exchange_n(ctx->first, &none, ctx->id, false,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static bool wake_newest_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    EXPECT_EQ(zx_port_create(ZX_PORT_WAKE_NEWEST, &port), ZX_OK);
+    zx_handle_t bad_port;
+    EXPECT_EQ(zx_port_create(ZX_PORT_WAKE_NEWEST << 1, &bad_port), ZX_ERR_INVALID_ARGS);
+
+    // Start the readers one at a time so that they block in a known order.
+    uint64_t first = 0u;
+    thrd_t threads[3];
+    wake_order_context ctx[3];
+    for (size_t ix = 0; ix != fbl::count_of(threads); ++ix) {
+        ctx[ix] = { port, ix + 1u, &first };
+        EXPECT_EQ(thrd_create(&threads[ix], port_first_reader_thread, &ctx[ix]),
+                  thrd_success);
+        wait_blocked_on_port(threads[ix]);
+    }
+
+    // The reader that blocked last gets the first packet.
+    const zx_port_packet_t in = { 1ull, ZX_PKT_TYPE_USER, 0, { {} } };
+    EXPECT_EQ(zx_port_queue(port, &in), ZX_OK);
+    while (__atomic_load_n(&first, __ATOMIC_SEQ_CST) == 0u)
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    EXPECT_EQ(first, fbl::count_of(threads));
+
+    for (size_t ix = 1; ix != fbl::count_of(threads); ++ix)
+        EXPECT_EQ(zx_port_queue(port, &in), ZX_OK);
+    for (size_t ix = 0; ix != fbl::count_of(threads); ++ix) {
+        int res;
+        EXPECT_EQ(thrd_join(threads[ix], &res), thrd_success);
+        EXPECT_EQ(res, 0);
+    }
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
 static bool threads_event_once() {
     return threads_event(ZX_WAIT_ASYNC_ONCE);
 }
@@ -679,6 +798,7 @@ static bool cancel_stress() {
 
 BEGIN_TEST_CASE(port_tests)
 RUN_TEST(basic_test)
+RUN_TEST(wait_many_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(queue_too_many)
 RUN_TEST(async_wait_channel_test)
@@ -699,6 +819,7 @@ RUN_TEST(cancel_event_key_once_after)
 RUN_TEST(cancel_event_key_repeat_after)
 RUN_TEST(threads_event_once)
 RUN_TEST(threads_event_repeat)
+RUN_TEST(wake_newest_test)
 RUN_TEST_LARGE(cancel_stress)
 END_TEST_CASE(port_tests)
 
@@ -2,9 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdlib.h>
+#include <threads.h>
+
 #include <unittest/unittest.h>
 #include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/threads.h>
 
 extern zx_handle_t get_root_resource(void);
 
@@ -27,6 +31,7 @@ static bool make_profile_fails(void) {
         profile_info.type = ZX_PROFILE_INFO_SCHEDULER;
         profile_info.scheduler.priority = ZX_PRIORITY_HIGHEST + 1;
         ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
     }
 
     END_TEST;
@@ -61,7 +66,192 @@ static bool change_priority_via_profile(void) {
     END_TEST;
 }
 
+static bool deadline_profile(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_profile_info_t invalid_info = { 0 };
+        invalid_info.type = ZX_PROFILE_INFO_DEADLINE;
+        zx_handle_t invalid;
+        ASSERT_EQ(zx_profile_create(rrh, &invalid_info, &invalid), ZX_ERR_INVALID_ARGS, "");
+
+        // capacity must fit within the relative deadline
+        invalid_info.deadline.capacity = ZX_MSEC(2);
+        invalid_info.deadline.relative_deadline = ZX_MSEC(1);
+        invalid_info.deadline.period = ZX_MSEC(10);
+        ASSERT_EQ(zx_profile_create(rrh, &invalid_info, &invalid), ZX_ERR_INVALID_ARGS, "");
+
+        // the relative deadline must fit within the period
+        invalid_info.deadline.capacity = ZX_MSEC(1);
+        invalid_info.deadline.relative_deadline = ZX_MSEC(20);
+        ASSERT_EQ(zx_profile_create(rrh, &invalid_info, &invalid), ZX_ERR_INVALID_ARGS, "");
+
+        // and so must the capacity
+        invalid_info.deadline.capacity = ZX_MSEC(20);
+        ASSERT_EQ(zx_profile_create(rrh, &invalid_info, &invalid), ZX_ERR_INVALID_ARGS, "");
+
+        zx_profile_info_t profile_info = { 0 };
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+        profile_info.deadline.capacity = ZX_USEC(500);
+        profile_info.deadline.relative_deadline = ZX_MSEC(5);
+        profile_info.deadline.period = ZX_MSEC(10);
+
+        zx_handle_t deadline;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &deadline), ZX_OK, "");
+
+        zx_profile_info_t fair_info = { 0 };
+        fair_info.type = ZX_PROFILE_INFO_SCHEDULER;
+        fair_info.scheduler.priority = ZX_PRIORITY_DEFAULT;
+        zx_handle_t fair;
+        ASSERT_EQ(zx_profile_create(rrh, &fair_info, &fair), ZX_OK, "");
+
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), deadline, 0), ZX_OK, "");
+        for (int i = 0; i < 10; i++) {
+            zx_nanosleep(zx_deadline_after(ZX_USEC(100)));
+        }
+
+        // going back to a priority profile gives the bandwidth back
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), fair, 0), ZX_OK, "");
+
+        ASSERT_EQ(zx_handle_close(deadline), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(fair), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
+typedef struct deadline_worker {
+    thrd_t thread;
+    zx_handle_t exit_event;
+} deadline_worker_t;
+
+static int deadline_worker_fn(void* arg) {
+    deadline_worker_t* worker = arg;
+    return zx_object_wait_one(worker->exit_event, ZX_USER_SIGNAL_0, ZX_TIME_INFINITE, NULL);
+}
+
+// Waits for the kernel thread to be gone, not only for the C11 thread to return, since the
+// bandwidth is given back by the kernel thread exiting.
+static bool deadline_worker_stop(deadline_worker_t* worker) {
+    BEGIN_HELPER;
+    ASSERT_EQ(zx_object_signal(worker->exit_event, 0, ZX_USER_SIGNAL_0), ZX_OK, "");
+    ASSERT_EQ(zx_object_wait_one(thrd_get_zx_handle(worker->thread), ZX_THREAD_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL), ZX_OK, "");
+    int result;
+    ASSERT_EQ(thrd_join(worker->thread, &result), thrd_success, "");
+    ASSERT_EQ(result, ZX_OK, "");
+    ASSERT_EQ(zx_handle_close(worker->exit_event), ZX_OK, "");
+    END_HELPER;
+}
+
+static bool deadline_admission(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        // half a cpu each, so that admission control, which keeps deadline threads under 80% of
+        // the cpus, has to reject one of 2 * num_cpus + 1 of them
+        zx_profile_info_t profile_info = { 0 };
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+        profile_info.deadline.capacity = ZX_MSEC(5);
+        profile_info.deadline.relative_deadline = ZX_MSEC(10);
+        profile_info.deadline.period = ZX_MSEC(10);
+        zx_handle_t half;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &half), ZX_OK, "");
+
+        zx_profile_info_t fair_info = { 0 };
+        fair_info.type = ZX_PROFILE_INFO_SCHEDULER;
+        fair_info.scheduler.priority = ZX_PRIORITY_DEFAULT;
+        zx_handle_t fair;
+        ASSERT_EQ(zx_profile_create(rrh, &fair_info, &fair), ZX_OK, "");
+
+        const size_t count = 2 * zx_system_get_num_cpus() + 1;
+        deadline_worker_t* workers = calloc(count, sizeof(deadline_worker_t));
+        ASSERT_NONNULL(workers, "");
+        for (size_t i = 0; i < count; i++) {
+            ASSERT_EQ(zx_event_create(0, &workers[i].exit_event), ZX_OK, "");
+            ASSERT_EQ(thrd_create(&workers[i].thread, deadline_worker_fn, &workers[i]),
+                      thrd_success, "");
+        }
+
+        size_t rejected = 0;
+        zx_status_t status = ZX_OK;
+        while (rejected < count &&
+               (status = zx_object_set_profile(thrd_get_zx_handle(workers[rejected].thread),
+                                               half, 0)) == ZX_OK) {
+            rejected++;
+        }
+        ASSERT_LT(rejected, count, "");
+        ASSERT_GT(rejected, 0u, "");
+        ASSERT_EQ(status, ZX_ERR_NO_RESOURCES, "");
+
+        // replacing a deadline profile gives its bandwidth back
+        zx_handle_t first = thrd_get_zx_handle(workers[0].thread);
+        ASSERT_EQ(zx_object_set_profile(first, fair, 0), ZX_OK, "");
+        ASSERT_EQ(zx_object_set_profile(thrd_get_zx_handle(workers[rejected].thread), half, 0),
+                  ZX_OK, "");
+        ASSERT_EQ(zx_object_set_profile(first, half, 0), ZX_ERR_NO_RESOURCES, "");
+
+        // and so does exiting
+        ASSERT_TRUE(deadline_worker_stop(&workers[rejected]), "");
+        ASSERT_EQ(zx_object_set_profile(first, half, 0), ZX_OK, "");
+
+        for (size_t i = 0; i < count; i++) {
+            if (i != rejected) {
+                ASSERT_TRUE(deadline_worker_stop(&workers[i]), "");
+            }
+        }
+        free(workers);
+
+        ASSERT_EQ(zx_handle_close(half), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(fair), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
+static bool cpu_affinity_profile(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_profile_info_t profile_info = { 0 };
+        profile_info.type = ZX_PROFILE_INFO_CPU_AFFINITY;
+
+        zx_handle_t profile;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        // cpu 0 is always online
+        profile_info.cpu_affinity.cpu_mask = 1u;
+        zx_handle_t pinned;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &pinned), ZX_OK, "");
+
+        profile_info.cpu_affinity.cpu_mask = UINT32_MAX;
+        zx_handle_t unpinned;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &unpinned), ZX_OK, "");
+
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), pinned, 0), ZX_OK, "");
+        zx_nanosleep(zx_deadline_after(ZX_USEC(100)));
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), unpinned, 0), ZX_OK, "");
+
+        ASSERT_EQ(zx_handle_close(pinned), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(unpinned), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(profile_tests)
 RUN_TEST(make_profile_fails)
 RUN_TEST(change_priority_via_profile)
+RUN_TEST(deadline_profile)
+RUN_TEST(deadline_admission)
+RUN_TEST(cpu_affinity_profile)
 END_TEST_CASE(profile_tests)
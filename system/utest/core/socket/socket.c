@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static zx_signals_t get_satisfied_signals(zx_handle_t handle) {
@@ -1153,6 +1154,134 @@ bool socket_share_consumes_on_failure(void) {
     END_TEST;
 }
 
+static bool socket_ring(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h[2];
+    ASSERT_EQ(zx_socket_create(ZX_SOCKET_RING | ZX_SOCKET_DATAGRAM, h, h + 1),
+              ZX_ERR_INVALID_ARGS, "");
+    ASSERT_EQ(zx_socket_create(ZX_SOCKET_RING, h, h + 1), ZX_OK, "");
+
+    zx_handle_t tx, rx;
+    ASSERT_EQ(zx_socket_get_ring(h[0], ZX_SOCKET_RING_TX, &tx), ZX_OK, "");
+    ASSERT_EQ(zx_socket_get_ring(h[1], ZX_SOCKET_RING_RX, &rx), ZX_OK, "");
+
+    zx_info_handle_basic_t tx_info, rx_info;
+    ASSERT_EQ(zx_object_get_info(tx, ZX_INFO_HANDLE_BASIC, &tx_info, sizeof(tx_info), NULL, NULL),
+              ZX_OK, "");
+    ASSERT_EQ(zx_object_get_info(rx, ZX_INFO_HANDLE_BASIC, &rx_info, sizeof(rx_info), NULL, NULL),
+              ZX_OK, "");
+    EXPECT_EQ(tx_info.koid, rx_info.koid, "both ends should see the same ring");
+
+    uint64_t vmo_size;
+    ASSERT_EQ(zx_vmo_get_size(tx, &vmo_size), ZX_OK, "");
+
+    uintptr_t tx_addr, rx_addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+                          0, tx, 0, vmo_size, &tx_addr), ZX_OK, "");
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+                          0, rx, 0, vmo_size, &rx_addr), ZX_OK, "");
+    volatile zx_socket_ring_header_t* header = (volatile zx_socket_ring_header_t*)rx_addr;
+    uint8_t* tx_data = (uint8_t*)(tx_addr + ZX_SOCKET_RING_DATA_OFFSET);
+    uint8_t* rx_data = (uint8_t*)(rx_addr + ZX_SOCKET_RING_DATA_OFFSET);
+    const uint64_t ring_size = header->size;
+    ASSERT_EQ(vmo_size, ZX_SOCKET_RING_DATA_OFFSET + ring_size, "");
+
+    // a plain write lands in the ring
+    size_t count;
+    const char hello[] = "hello";
+    ASSERT_EQ(zx_socket_write(h[0], 0u, hello, sizeof(hello), &count), ZX_OK, "");
+    EXPECT_EQ(count, sizeof(hello), "");
+    EXPECT_EQ(header->head, sizeof(hello), "");
+    EXPECT_EQ(header->tail, 0u, "");
+    EXPECT_EQ(memcmp(rx_data, hello, sizeof(hello)), 0, "");
+    EXPECT_EQ(get_satisfied_signals(h[1]) & ZX_SOCKET_READABLE, ZX_SOCKET_READABLE, "");
+
+    // consume it through the mapping
+    ASSERT_EQ(zx_socket_read(h[1], ZX_SOCKET_RING_ADVANCE, NULL, sizeof(hello), &count),
+              ZX_OK, "");
+    EXPECT_EQ(count, sizeof(hello), "");
+    EXPECT_EQ(header->tail, sizeof(hello), "");
+    EXPECT_EQ(get_satisfied_signals(h[1]) & ZX_SOCKET_READABLE, 0u, "");
+    EXPECT_EQ(zx_socket_read(h[1], ZX_SOCKET_RING_ADVANCE, NULL, 1u, &count),
+              ZX_ERR_SHOULD_WAIT, "");
+
+    // produce through the mapping, across the end of the ring
+    const uint64_t head = sizeof(hello);
+    const size_t len = ring_size - 2u;
+    for (size_t i = 0; i < len; ++i) {
+        tx_data[(head + i) % ring_size] = (uint8_t)i;
+    }
+    EXPECT_EQ(zx_socket_write(h[0], ZX_SOCKET_RING_ADVANCE, NULL, ring_size + 1u, &count),
+              ZX_ERR_OUT_OF_RANGE, "");
+    ASSERT_EQ(zx_socket_write(h[0], ZX_SOCKET_RING_ADVANCE, NULL, len, &count), ZX_OK, "");
+    EXPECT_EQ(count, len, "");
+    EXPECT_EQ(header->head, head + len, "");
+
+    // and read back with a copy
+    uint8_t* buf = malloc(len);
+    ASSERT_NONNULL(buf, "");
+    ASSERT_EQ(zx_socket_read(h[1], 0u, buf, len, &count), ZX_OK, "");
+    EXPECT_EQ(count, len, "");
+    bool match = true;
+    for (size_t i = 0; i < len; ++i) {
+        match &= buf[i] == (uint8_t)i;
+    }
+    EXPECT_TRUE(match, "data read back differs from what was stored in the ring");
+    free(buf);
+
+    // the header belongs to the kernel
+    header->head = 0u;
+    ASSERT_EQ(zx_socket_write(h[0], 0u, hello, 1u, &count), ZX_OK, "");
+    EXPECT_EQ(header->head, head + len + 1u, "");
+
+    zx_handle_t vmo;
+    zx_handle_t plain[2];
+    ASSERT_EQ(zx_socket_create(0, plain, plain + 1), ZX_OK, "");
+    EXPECT_EQ(zx_socket_get_ring(plain[0], ZX_SOCKET_RING_RX, &vmo), ZX_ERR_NOT_SUPPORTED, "");
+    EXPECT_EQ(zx_socket_write(plain[0], ZX_SOCKET_RING_ADVANCE, NULL, 1u, &count),
+              ZX_ERR_INVALID_ARGS, "");
+
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), tx_addr, vmo_size), ZX_OK, "");
+    EXPECT_EQ(zx_vmar_unmap(zx_vmar_root_self(), rx_addr, vmo_size), ZX_OK, "");
+    zx_handle_close(tx);
+    zx_handle_close(rx);
+    zx_handle_close_many(plain, 2);
+    zx_handle_close_many(h, 2);
+
+    END_TEST;
+}
+
+// The ring vmo is handed out writable and mappable, but its pages stay put:
+// nothing done through it can stop the kernel from updating the header.
+static bool socket_ring_pinned(void) {
+    BEGIN_TEST;
+
+    zx_handle_t h[2];
+    ASSERT_EQ(zx_socket_create(ZX_SOCKET_RING, h, h + 1), ZX_OK, "");
+    zx_handle_t rx;
+    ASSERT_EQ(zx_socket_get_ring(h[1], ZX_SOCKET_RING_RX, &rx), ZX_OK, "");
+
+    uint64_t vmo_size;
+    ASSERT_EQ(zx_vmo_get_size(rx, &vmo_size), ZX_OK, "");
+    EXPECT_EQ(zx_vmo_op_range(rx, ZX_VMO_OP_DECOMMIT, 0u, vmo_size, NULL, 0u),
+              ZX_ERR_BAD_STATE, "");
+    EXPECT_EQ(zx_vmo_set_cache_policy(rx, ZX_CACHE_POLICY_UNCACHED), ZX_ERR_BAD_STATE, "");
+
+    size_t count;
+    ASSERT_EQ(zx_socket_write(h[0], 0u, "a", 1u, &count), ZX_OK, "");
+    ASSERT_EQ(zx_socket_read(h[1], ZX_SOCKET_RING_ADVANCE, NULL, 1u, &count), ZX_OK, "");
+    zx_socket_ring_header_t header;
+    ASSERT_EQ(zx_vmo_read(rx, &header, 0u, sizeof(header)), ZX_OK, "");
+    EXPECT_EQ(header.head, 1u, "");
+    EXPECT_EQ(header.tail, 1u, "");
+
+    zx_handle_close(rx);
+    zx_handle_close_many(h, 2);
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
 RUN_TEST(socket_signals)
@@ -1173,6 +1302,8 @@ RUN_TEST(socket_accept)
 RUN_TEST(socket_share_invalid_handle)
 RUN_TEST(socket_share_consumes_on_failure)
 RUN_TEST(socket_signals2)
+RUN_TEST(socket_ring)
+RUN_TEST(socket_ring_pinned)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
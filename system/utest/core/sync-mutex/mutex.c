@@ -4,6 +4,7 @@
 
 #include <inttypes.h>
 #include <lib/sync/mutex.h>
+#include <lib/sync/pi-mutex.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -204,10 +205,99 @@ static bool test_timeout_elapsed(void) {
     END_TEST;
 }
 
+static sync_pi_mutex_t g_pi_mutex = SYNC_PI_MUTEX_INIT;
+static int g_pi_counter = 0;
+
+static int pi_mutex_thread(void* arg) {
+    for (int times = 0; times < 1000; times++) {
+        sync_pi_mutex_lock(&g_pi_mutex);
+        int counter = g_pi_counter;
+        if (times % 100 == 0) {
+            zx_nanosleep(zx_deadline_after(ZX_USEC(1)));
+        }
+        g_pi_counter = counter + 1;
+        sync_pi_mutex_unlock(&g_pi_mutex);
+    }
+    return 0;
+}
+
+static bool test_pi_mutexes(void) {
+    BEGIN_TEST;
+    thrd_t threads[3];
+
+    for (size_t i = 0; i < countof(threads); i++) {
+        ASSERT_EQ(thrd_create_with_name(&threads[i], pi_mutex_thread, NULL, "pi thread"),
+                  thrd_success, "");
+    }
+    for (size_t i = 0; i < countof(threads); i++) {
+        ASSERT_EQ(thrd_join(threads[i], NULL), thrd_success, "");
+    }
+    EXPECT_EQ(g_pi_counter, 3000, "lost an update");
+
+    END_TEST;
+}
+
+typedef struct {
+    sync_pi_mutex_t mutex;
+    zx_handle_t start_event;
+    zx_handle_t done_event;
+} pi_timeout_args;
+
+static int test_pi_timeout_helper(void* ctx) TA_NO_THREAD_SAFETY_ANALYSIS {
+    pi_timeout_args* args = ctx;
+    sync_pi_mutex_lock(&args->mutex);
+    ASSERT_EQ(zx_object_signal(args->start_event, 0, ZX_EVENT_SIGNALED), ZX_OK,
+              "failed to signal");
+    ASSERT_EQ(zx_object_wait_one(args->done_event, ZX_EVENT_SIGNALED, ZX_TIME_INFINITE, NULL),
+              ZX_OK, "failed to wait");
+    sync_pi_mutex_unlock(&args->mutex);
+    return 0;
+}
+
+// Waiters on a held PI mutex time out, and get it once it's released.
+static bool test_pi_timeout_elapsed(void) TA_NO_THREAD_SAFETY_ANALYSIS {
+    BEGIN_TEST;
+
+    const zx_duration_t kRelativeDeadline = ZX_MSEC(50);
+
+    pi_timeout_args args;
+    args.mutex = SYNC_PI_MUTEX_INIT;
+    ASSERT_EQ(zx_event_create(0, &args.start_event), ZX_OK, "could not create event");
+    ASSERT_EQ(zx_event_create(0, &args.done_event), ZX_OK, "could not create event");
+
+    thrd_t helper;
+    ASSERT_EQ(thrd_create(&helper, test_pi_timeout_helper, &args), thrd_success, "");
+    ASSERT_EQ(zx_object_wait_one(args.start_event, ZX_EVENT_SIGNALED, ZX_TIME_INFINITE, NULL),
+              ZX_OK, "failed to wait");
+
+    EXPECT_EQ(sync_pi_mutex_trylock(&args.mutex), ZX_ERR_BAD_STATE, "lock is held");
+    for (int i = 0; i < 3; ++i) {
+        zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        zx_status_t status = sync_pi_mutex_timedlock(&args.mutex, now + kRelativeDeadline);
+        ASSERT_EQ(status, ZX_ERR_TIMED_OUT, "wait should time out");
+        zx_duration_t elapsed = zx_time_sub_time(zx_clock_get(ZX_CLOCK_MONOTONIC), now);
+        EXPECT_GE(elapsed, kRelativeDeadline, "wait returned early");
+    }
+
+    ASSERT_EQ(zx_object_signal(args.done_event, 0, ZX_EVENT_SIGNALED),
+              ZX_OK, "failed to signal");
+    ASSERT_EQ(sync_pi_mutex_timedlock(&args.mutex, ZX_TIME_INFINITE), ZX_OK,
+              "failed to lock");
+    sync_pi_mutex_unlock(&args.mutex);
+    ASSERT_EQ(thrd_join(helper, NULL), thrd_success, "failed to join");
+
+    ASSERT_EQ(zx_handle_close(args.start_event), ZX_OK, "failed to close event");
+    ASSERT_EQ(zx_handle_close(args.done_event), ZX_OK, "failed to close event");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(sync_mutex_tests)
 RUN_TEST(test_mutexes)
 RUN_TEST(test_try_mutexes)
 RUN_TEST(test_timeout_elapsed)
+RUN_TEST(test_pi_mutexes)
+RUN_TEST(test_pi_timeout_elapsed)
 END_TEST_CASE(sync_mutex_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -0,0 +1,212 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <zircon/syscalls.h>
+
+#include <unittest/unittest.h>
+
+static bool basic_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t waitset;
+    ASSERT_EQ(zx_waitset_create(0, &waitset), ZX_OK);
+
+    zx_handle_t ev[2];
+    for (auto& e : ev) {
+        ASSERT_EQ(zx_event_create(0u, &e), ZX_OK);
+    }
+    EXPECT_EQ(zx_waitset_add(waitset, 1u, ev[0], ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    EXPECT_EQ(zx_waitset_add(waitset, 2u, ev[1], ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    EXPECT_EQ(zx_waitset_add(waitset, 2u, ev[1], ZX_USER_SIGNAL_1, 0u), ZX_ERR_ALREADY_EXISTS);
+    EXPECT_EQ(zx_waitset_add(waitset, 3u, ev[1], ZX_USER_SIGNAL_1, 1u << 5), ZX_ERR_INVALID_ARGS);
+
+    zx_waitset_result_t results[4];
+    size_t actual;
+    EXPECT_EQ(zx_waitset_wait(waitset, 0u, results, 4u, &actual), ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_object_signal(ev[1], 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    ASSERT_EQ(zx_waitset_wait(waitset, ZX_TIME_INFINITE, results, 4u, &actual), ZX_OK);
+    ASSERT_EQ(actual, 1u);
+    EXPECT_EQ(results[0].key, 2u);
+    EXPECT_EQ(results[0].status, ZX_OK);
+    EXPECT_EQ(results[0].observed & ZX_USER_SIGNAL_0, ZX_USER_SIGNAL_0);
+
+    // level triggered: reported for as long as the signal stays up
+    ASSERT_EQ(zx_waitset_wait(waitset, 0u, results, 4u, &actual), ZX_OK);
+    EXPECT_EQ(actual, 1u);
+
+    EXPECT_EQ(zx_object_signal(ev[1], ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    EXPECT_EQ(zx_waitset_wait(waitset, 0u, results, 4u, &actual), ZX_ERR_TIMED_OUT);
+
+    // removal drops a ready entry
+    EXPECT_EQ(zx_object_signal(ev[0], 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    EXPECT_EQ(zx_waitset_remove(waitset, 1u), ZX_OK);
+    EXPECT_EQ(zx_waitset_remove(waitset, 1u), ZX_ERR_NOT_FOUND);
+    EXPECT_EQ(zx_waitset_wait(waitset, 0u, results, 4u, &actual), ZX_ERR_TIMED_OUT);
+
+    for (auto e : ev) {
+        EXPECT_EQ(zx_handle_close(e), ZX_OK);
+    }
+    EXPECT_EQ(zx_handle_close(waitset), ZX_OK);
+
+    END_TEST;
+}
+
+static bool edge_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t waitset;
+    ASSERT_EQ(zx_waitset_create(0, &waitset), ZX_OK);
+    zx_handle_t ev;
+    ASSERT_EQ(zx_event_create(0u, &ev), ZX_OK);
+    ASSERT_EQ(zx_waitset_add(waitset, 7u, ev, ZX_USER_SIGNAL_0, ZX_WAITSET_EDGE), ZX_OK);
+
+    zx_waitset_result_t result;
+    size_t actual;
+    EXPECT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    ASSERT_EQ(zx_waitset_wait(waitset, 0u, &result, 1u, &actual), ZX_OK);
+    EXPECT_EQ(result.key, 7u);
+
+    // still asserted, but there has been no new edge
+    EXPECT_EQ(zx_waitset_wait(waitset, 0u, &result, 1u, &actual), ZX_ERR_TIMED_OUT);
+
+    // a pulse that is over by the time of the wait is still reported
+    EXPECT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    EXPECT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_0), ZX_OK);
+    EXPECT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    ASSERT_EQ(zx_waitset_wait(waitset, 0u, &result, 1u, &actual), ZX_OK);
+    EXPECT_EQ(result.key, 7u);
+
+    EXPECT_EQ(zx_handle_close(ev), ZX_OK);
+    EXPECT_EQ(zx_handle_close(waitset), ZX_OK);
+
+    END_TEST;
+}
+
+static bool rotate_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t waitset;
+    ASSERT_EQ(zx_waitset_create(0, &waitset), ZX_OK);
+
+    zx_handle_t ev[3];
+    for (uint64_t i = 0; i < 3; i++) {
+        ASSERT_EQ(zx_event_create(0u, &ev[i]), ZX_OK);
+        ASSERT_EQ(zx_object_signal(ev[i], 0u, ZX_USER_SIGNAL_0), ZX_OK);
+        ASSERT_EQ(zx_waitset_add(waitset, i, ev[i], ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    }
+
+    // with room for one result at a time, every ready entry gets its turn
+    uint32_t seen = 0u;
+    for (int i = 0; i < 3; i++) {
+        zx_waitset_result_t result;
+        size_t actual;
+        ASSERT_EQ(zx_waitset_wait(waitset, 0u, &result, 1u, &actual), ZX_OK);
+        ASSERT_EQ(actual, 1u);
+        seen |= 1u << result.key;
+    }
+    EXPECT_EQ(seen, 7u);
+
+    for (auto e : ev) {
+        EXPECT_EQ(zx_handle_close(e), ZX_OK);
+    }
+    EXPECT_EQ(zx_handle_close(waitset), ZX_OK);
+
+    END_TEST;
+}
+
+static bool handle_close_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t waitset;
+    ASSERT_EQ(zx_waitset_create(0, &waitset), ZX_OK);
+    zx_handle_t ev;
+    ASSERT_EQ(zx_event_create(0u, &ev), ZX_OK);
+    ASSERT_EQ(zx_waitset_add(waitset, 9u, ev, ZX_USER_SIGNAL_0, 0u), ZX_OK);
+
+    EXPECT_EQ(zx_handle_close(ev), ZX_OK);
+
+    zx_waitset_result_t result;
+    size_t actual;
+    ASSERT_EQ(zx_waitset_wait(waitset, 0u, &result, 1u, &actual), ZX_OK);
+    EXPECT_EQ(result.key, 9u);
+    EXPECT_EQ(result.status, ZX_ERR_CANCELED);
+    EXPECT_EQ(result.observed & ZX_SIGNAL_HANDLE_CLOSED, ZX_SIGNAL_HANDLE_CLOSED);
+
+    // reported once, then gone
+    EXPECT_EQ(zx_waitset_wait(waitset, 0u, &result, 1u, &actual), ZX_ERR_TIMED_OUT);
+    EXPECT_EQ(zx_waitset_remove(waitset, 9u), ZX_ERR_NOT_FOUND);
+
+    EXPECT_EQ(zx_handle_close(waitset), ZX_OK);
+
+    END_TEST;
+}
+
+static bool close_with_entries_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t waitset;
+    ASSERT_EQ(zx_waitset_create(0, &waitset), ZX_OK);
+    zx_handle_t ev;
+    ASSERT_EQ(zx_event_create(0u, &ev), ZX_OK);
+    ASSERT_EQ(zx_waitset_add(waitset, 1u, ev, ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    ASSERT_EQ(zx_object_signal(ev, 0u, ZX_USER_SIGNAL_0), ZX_OK);
+
+    // the wait set goes first; the event mustn't notice
+    EXPECT_EQ(zx_handle_close(waitset), ZX_OK);
+    EXPECT_EQ(zx_object_signal(ev, ZX_USER_SIGNAL_0, 0u), ZX_OK);
+    EXPECT_EQ(zx_handle_close(ev), ZX_OK);
+
+    END_TEST;
+}
+
+static constexpr size_t kRaceEvents = 16u;
+
+static int close_events(void* arg) {
+    auto ev = static_cast<zx_handle_t*>(arg);
+    for (size_t i = 0; i < kRaceEvents; i++) {
+        zx_handle_close(ev[i]);
+    }
+    return 0;
+}
+
+// Entries come off an object's observer list after its lock is dropped, so
+// closing the observed handles races with the wait set's own teardown.
+static bool close_race_test(void) {
+    BEGIN_TEST;
+
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        zx_handle_t waitset;
+        ASSERT_EQ(zx_waitset_create(0, &waitset), ZX_OK);
+        zx_handle_t ev[kRaceEvents];
+        for (size_t i = 0; i < kRaceEvents; i++) {
+            ASSERT_EQ(zx_event_create(0u, &ev[i]), ZX_OK);
+            ASSERT_EQ(zx_waitset_add(waitset, i, ev[i], ZX_USER_SIGNAL_0, 0u), ZX_OK);
+        }
+
+        thrd_t thread;
+        ASSERT_EQ(thrd_create(&thread, close_events, ev), thrd_success);
+        EXPECT_EQ(zx_handle_close(waitset), ZX_OK);
+        ASSERT_EQ(thrd_join(thread, nullptr), thrd_success);
+    }
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(waitset_tests)
+RUN_TEST(basic_test)
+RUN_TEST(edge_test)
+RUN_TEST(rotate_test)
+RUN_TEST(handle_close_test)
+RUN_TEST(close_with_entries_test)
+RUN_TEST(close_race_test)
+END_TEST_CASE(waitset_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
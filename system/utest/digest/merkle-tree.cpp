@@ -5,6 +5,7 @@
 #include <digest/merkle-tree.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include <digest/digest.h>
 #include <zircon/assert.h>
@@ -626,6 +627,66 @@ bool VerifyBadLeaves(void) {
     END_TEST;
 }
 
+bool CreateParallelAll(void) {
+    BEGIN_TEST_WITH_RC;
+    uint8_t tree[sizeof(gTree)];
+    for (size_t i = 0; i < kNumCases; ++i) {
+        size_t data_len = kCases[i].data_len;
+        size_t tree_len = kCases[i].tree_len;
+        for (uint64_t j = 0; j < data_len; ++j) {
+            gData[j] = static_cast<uint8_t>(rand());
+        }
+        Digest expected;
+        ASSERT_OK(MerkleTree::Create(gData, data_len, gTree, tree_len, &expected));
+        Digest actual;
+        memset(tree, 0xff, sizeof(tree));
+        ASSERT_OK(MerkleTree::CreateParallel(gData, data_len, tree, tree_len, &actual, 4));
+        ASSERT_TRUE(actual == expected, "Incorrect root digest");
+        ASSERT_EQ(memcmp(tree, gTree, tree_len), 0, "Incorrect tree");
+    }
+    END_TEST;
+}
+
+bool CreateParallelTreeTooSmall(void) {
+    BEGIN_TEST_WITH_RC;
+    size_t tree_len = MerkleTree::GetTreeLength(kLarge);
+    Digest digest;
+    ASSERT_ERR(ZX_ERR_BUFFER_TOO_SMALL,
+               MerkleTree::CreateParallel(gData, kLarge, gTree, tree_len - 1, &digest, 4));
+    END_TEST;
+}
+
+bool VerifyParallelAll(void) {
+    BEGIN_TEST_WITH_RC;
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    Digest digest;
+    ASSERT_OK(MerkleTree::Create(gData, kUnalignedLarge, gTree, tree_len, &digest));
+    ASSERT_OK(MerkleTree::VerifyParallel(gData, kUnalignedLarge, gTree, tree_len, 0,
+                                         kUnalignedLarge, digest, 4));
+    ASSERT_OK(MerkleTree::VerifyParallel(gData, kUnalignedLarge, gTree, tree_len, 1,
+                                         kLarge, digest, 4));
+    ASSERT_ERR(ZX_ERR_OUT_OF_RANGE,
+               MerkleTree::VerifyParallel(gData, kUnalignedLarge, gTree, tree_len, 1,
+                                          kUnalignedLarge, digest, 4));
+    END_TEST;
+}
+
+bool VerifyParallelBadLeaves(void) {
+    BEGIN_TEST_WITH_RC;
+    size_t tree_len = MerkleTree::GetTreeLength(kUnalignedLarge);
+    Digest digest;
+    ASSERT_OK(MerkleTree::Create(gData, kUnalignedLarge, gTree, tree_len, &digest));
+    // Corrupt a node which doesn't belong to the caller's share of the work.
+    gData[kUnalignedLarge - 1] ^= 1;
+    ASSERT_ERR(ZX_ERR_IO_DATA_INTEGRITY,
+               MerkleTree::VerifyParallel(gData, kUnalignedLarge, gTree, tree_len, 0,
+                                          kUnalignedLarge, digest, 4));
+    // Data outside of the range isn't checked.
+    ASSERT_OK(MerkleTree::VerifyParallel(gData, kUnalignedLarge, gTree, tree_len, 0,
+                                         kLarge, digest, 4));
+    END_TEST;
+}
+
 bool CreateAndVerifyHugePRNGData(void) {
     BEGIN_TEST_WITH_RC;
     Digest digest;
@@ -739,5 +800,9 @@ RUN_TEST(VerifyGoodPartOfBadTree)
 RUN_TEST(VerifyBadTree)
 RUN_TEST(VerifyGoodPartOfBadLeaves)
 RUN_TEST(VerifyBadLeaves)
+RUN_TEST(CreateParallelAll)
+RUN_TEST(CreateParallelTreeTooSmall)
+RUN_TEST(VerifyParallelAll)
+RUN_TEST(VerifyParallelBadLeaves)
 RUN_TEST(CreateAndVerifyHugePRNGData)
 END_TEST_CASE(MerkleTreeTests)
@@ -10,6 +10,7 @@
 #include <zircon/dlfcn.h>
 #include <zircon/processargs.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
 
 #include <stdatomic.h>
 #include <stdio.h>
@@ -19,10 +20,11 @@
 #include <unittest/unittest.h>
 
 #if __has_feature(address_sanitizer)
-# define LIBPREFIX "/boot/lib/asan/"
+# define LIBSUBDIR "asan/"
 #else
-# define LIBPREFIX "/boot/lib/"
+# define LIBSUBDIR ""
 #endif
+#define LIBPREFIX "/boot/lib/" LIBSUBDIR
 
 bool dlopen_vmo_test(void) {
     BEGIN_TEST;
@@ -154,6 +156,66 @@ bool loader_service_test(void) {
     END_TEST;
 }
 
+bool load_objects_test(void) {
+    BEGIN_TEST;
+
+    int root_dir_fd = open("/boot", O_RDONLY | O_DIRECTORY);
+    ASSERT_GE(root_dir_fd, 0, "open /boot");
+    loader_service_t* svc = NULL;
+    zx_status_t status = loader_service_create_fd(NULL, root_dir_fd, -1, &svc);
+    ASSERT_EQ(status, ZX_OK, "loader_service_create_fd");
+    zx_handle_t h = ZX_HANDLE_INVALID;
+    status = loader_service_connect(svc, &h);
+    ASSERT_EQ(status, ZX_OK, "loader_service_connect");
+
+    static const char names[] =
+        LIBSUBDIR TEST_SONAME "\n" "libnosuchlibrary.so\n" LIBSUBDIR TEST_SONAME "\n";
+    ldmsg_req_t req;
+    memset(&req.header, 0, sizeof(req.header));
+    req.header.ordinal = LDMSG_OP_LOAD_OBJECTS;
+    size_t req_len;
+    status = ldmsg_req_encode(&req, &req_len, names, strlen(names));
+    ASSERT_EQ(status, ZX_OK, "ldmsg_req_encode");
+
+    ldmsg_rsp_objects_t rsp;
+    zx_handle_t handles[LDMSG_MAX_OBJECTS];
+    zx_channel_call_args_t call = {
+        .wr_bytes = &req,
+        .wr_num_bytes = req_len,
+        .rd_bytes = &rsp,
+        .rd_num_bytes = sizeof(rsp),
+        .rd_handles = handles,
+        .rd_num_handles = LDMSG_MAX_OBJECTS,
+    };
+    uint32_t actual_bytes, actual_handles;
+    status = zx_channel_call(h, 0, ZX_TIME_INFINITE, &call, &actual_bytes, &actual_handles);
+    ASSERT_EQ(status, ZX_OK, "zx_channel_call");
+    EXPECT_EQ(rsp.rv, ZX_OK, "LoadObjects");
+    ASSERT_EQ(rsp.objects.count, 3u, "one handle per name");
+    EXPECT_EQ(actual_bytes, ldmsg_rsp_objects_get_size(&rsp), "reply size");
+    EXPECT_EQ(rsp.handles[0], FIDL_HANDLE_PRESENT, "");
+    EXPECT_EQ(rsp.handles[1], FIDL_HANDLE_ABSENT, "missing library");
+    EXPECT_EQ(rsp.handles[2], FIDL_HANDLE_PRESENT, "");
+    ASSERT_EQ(actual_handles, 2u, "");
+
+    // Both loads of the library are clones of the one VMO in the cache.
+    zx_info_vmo_t info[2];
+    for (int i = 0; i < 2; ++i) {
+        status = zx_object_get_info(handles[i], ZX_INFO_VMO, &info[i], sizeof(info[i]),
+                                    NULL, NULL);
+        EXPECT_EQ(status, ZX_OK, "ZX_INFO_VMO");
+        zx_handle_close(handles[i]);
+    }
+    EXPECT_NE(info[0].koid, info[1].koid, "each load gets its own VMO");
+    EXPECT_NE(info[0].parent_koid, 0u, "not a clone");
+    EXPECT_EQ(info[0].parent_koid, info[1].parent_koid, "not cloned from the same VMO");
+
+    zx_handle_close(h);
+    loader_service_release(svc);
+
+    END_TEST;
+}
+
 bool clone_test(void) {
     BEGIN_TEST;
 
@@ -186,6 +248,7 @@ static bool dladdr_main_test(void) {
 BEGIN_TEST_CASE(dlfcn_tests)
 RUN_TEST(dlopen_vmo_test);
 RUN_TEST(loader_service_test);
+RUN_TEST(load_objects_test);
 RUN_TEST(clone_test);
 RUN_TEST(dladdr_main_test);
 END_TEST_CASE(dlfcn_tests)
@@ -891,6 +891,124 @@ static bool EthernetDataTest_Recv() {
     END_TEST;
 }
 
+// Fills |buf| with a pattern distinguishing frame |n| of a batch.
+static void FillFrame(uint8_t* buf, size_t length, int n) {
+    for (size_t i = 0; i < length; i++) {
+        buf[i] = static_cast<uint8_t>((i + n * 16) & 0xff);
+    }
+}
+
+static bool EthernetDataTest_BatchSend() {
+    BEGIN_TEST;
+    zx::socket sock;
+    EthernetClient client;
+    EthernetOpenInfo info(__func__);
+    info.options = ETHERTAP_OPT_BATCH;
+    ASSERT_TRUE(OpenFirstClientHelper(&sock, &client, info));
+
+    // Write several frames of different lengths to the TX fifo
+    constexpr int kFrames = 3;
+    zircon_ethernet_FifoEntry entries[kFrames];
+    for (int n = 0; n < kFrames; n++) {
+        auto entry = client.GetTxBuffer();
+        ASSERT_TRUE(entry != nullptr);
+        entry->length = static_cast<uint16_t>(32 + n);
+        FillFrame(reinterpret_cast<uint8_t*>(entry->cookie), entry->length, n);
+        entries[n] = *entry;
+    }
+    size_t written = 0;
+    ASSERT_EQ(ZX_OK, client.tx_fifo()->write(entries, kFrames, &written));
+    ASSERT_EQ(kFrames, written);
+
+    // They arrive in order, in one or more batches
+    fbl::unique_ptr<uint8_t[]> read_buf(new uint8_t[ETHERTAP_MAX_BATCH_SIZE]);
+    int received = 0;
+    while (received < kFrames) {
+        zx_signals_t obs;
+        ASSERT_EQ(ZX_OK, sock.wait_one(ZX_SOCKET_READABLE, FAIL_TIMEOUT, &obs));
+        size_t actual = 0;
+        ASSERT_EQ(ZX_OK, sock.read(0u, read_buf.get(), ETHERTAP_MAX_BATCH_SIZE, &actual));
+        ASSERT_GE(actual, HEADER_SIZE);
+        auto header = reinterpret_cast<ethertap_socket_header_t*>(read_buf.get());
+        ASSERT_EQ(ETHERTAP_MSG_PACKET_BATCH, header->type);
+        ASSERT_GT(header->info, 0);
+        ASSERT_LE(received + header->info, kFrames);
+
+        size_t offset = HEADER_SIZE;
+        for (int32_t i = 0; i < header->info; i++, received++) {
+            ethertap_batch_frame_t frame;
+            ASSERT_LE(offset + sizeof(frame), actual);
+            memcpy(&frame, read_buf.get() + offset, sizeof(frame));
+            offset += sizeof(frame);
+            ASSERT_EQ(entries[received].length, frame.length);
+            ASSERT_LE(offset + frame.length, actual);
+            EXPECT_BYTES_EQ(reinterpret_cast<uint8_t*>(entries[received].cookie),
+                            read_buf.get() + offset, frame.length, "");
+            offset += frame.length;
+        }
+        EXPECT_EQ(actual, offset);
+    }
+
+    // Every TX completes
+    for (int n = 0; n < kFrames; n++) {
+        zx_signals_t obs;
+        ASSERT_EQ(ZX_OK, client.tx_fifo()->wait_one(ZX_FIFO_READABLE, FAIL_TIMEOUT, &obs));
+        zircon_ethernet_FifoEntry return_entry;
+        ASSERT_EQ(ZX_OK, client.tx_fifo()->read_one(&return_entry));
+        EXPECT_TRUE(return_entry.flags & zircon_ethernet_FIFO_TX_OK);
+        client.ReturnTxBuffer(&return_entry);
+    }
+
+    ASSERT_TRUE(EthernetCleanupHelper(&sock, &client));
+    END_TEST;
+}
+
+static bool EthernetDataTest_BatchRecv() {
+    BEGIN_TEST;
+    zx::socket sock;
+    EthernetClient client;
+    EthernetOpenInfo info(__func__);
+    info.options = ETHERTAP_OPT_BATCH;
+    ASSERT_TRUE(OpenFirstClientHelper(&sock, &client, info));
+
+    // Send several frames through the socket in a single batch
+    constexpr int kFrames = 3;
+    uint8_t buf[HEADER_SIZE + kFrames * (sizeof(ethertap_batch_frame_t) + 64)];
+    auto header = reinterpret_cast<ethertap_socket_header_t*>(buf);
+    header->type = ETHERTAP_MSG_PACKET_BATCH;
+    header->info = kFrames;
+    size_t length = HEADER_SIZE;
+    for (int n = 0; n < kFrames; n++) {
+        ethertap_batch_frame_t frame = { static_cast<uint32_t>(32 + n) };
+        memcpy(buf + length, &frame, sizeof(frame));
+        length += sizeof(frame);
+        FillFrame(buf + length, frame.length, n);
+        length += frame.length;
+    }
+    size_t actual = 0;
+    EXPECT_EQ(ZX_OK, sock.write(0, buf, length, &actual));
+    EXPECT_EQ(length, actual);
+
+    // Each frame arrives, in order, in an RX buffer of its own
+    for (int n = 0; n < kFrames; n++) {
+        zx_signals_t obs;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->wait_one(ZX_FIFO_READABLE, FAIL_TIMEOUT, &obs));
+        zircon_ethernet_FifoEntry entry;
+        ASSERT_EQ(ZX_OK, client.rx_fifo()->read_one(&entry));
+
+        uint8_t expected[64];
+        ASSERT_EQ(32 + n, entry.length);
+        FillFrame(expected, entry.length, n);
+        EXPECT_BYTES_EQ(expected, client.GetRxBuffer(entry.offset), entry.length, "");
+
+        entry.length = 2048;
+        EXPECT_EQ(ZX_OK, client.rx_fifo()->write_one(entry));
+    }
+
+    ASSERT_TRUE(EthernetCleanupHelper(&sock, &client));
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(EthernetSetupTests)
 RUN_TEST_MEDIUM(EthernetStartTest)
 RUN_TEST_MEDIUM(EthernetLinkStatusTest)
@@ -910,6 +1028,8 @@ END_TEST_CASE(EthernetConfigTests)
 BEGIN_TEST_CASE(EthernetDataTests)
 RUN_TEST_MEDIUM(EthernetDataTest_Send)
 RUN_TEST_MEDIUM(EthernetDataTest_Recv)
+RUN_TEST_MEDIUM(EthernetDataTest_BatchSend)
+RUN_TEST_MEDIUM(EthernetDataTest_BatchRecv)
 END_TEST_CASE(EthernetDataTests)
 
 int main(int argc, char* argv[]) {
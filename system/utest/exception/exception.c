@@ -1801,6 +1801,68 @@ static bool exit_closing_excp_handle_test(void)
     END_TEST;
 }
 
+static atomic_uint in_process_handler_type;
+static atomic_uintptr_t in_process_handler_frame;
+
+static void __NO_RETURN in_process_handler(zx_exception_frame_t* frame)
+{
+    atomic_store(&in_process_handler_frame, (uintptr_t)frame);
+    atomic_store(&in_process_handler_type, frame->report.header.type);
+    zx_thread_exit();
+}
+
+static int in_process_fault_thread_func(void* arg)
+{
+    *(volatile int*) 0 = 42;
+    return 0;
+}
+
+static bool in_process_handler_test(void)
+{
+    BEGIN_TEST;
+
+    zx_handle_t self = zx_process_self();
+
+    // Synthetic exceptions can't be redirected.
+    zx_exception_handler_t handler = {
+        .entry = (uintptr_t)in_process_handler,
+        .type_mask = ZX_EXCP_HANDLER_TYPE(ZX_EXCP_POLICY_ERROR),
+    };
+    EXPECT_EQ(zx_object_set_property(self, ZX_PROP_PROCESS_EXCEPTION_HANDLER,
+                                     &handler, sizeof(handler)),
+              ZX_ERR_INVALID_ARGS, "");
+
+    handler.type_mask = ZX_EXCP_HANDLER_TYPE(ZX_EXCP_FATAL_PAGE_FAULT);
+    ASSERT_EQ(zx_object_set_property(self, ZX_PROP_PROCESS_EXCEPTION_HANDLER,
+                                     &handler, sizeof(handler)), ZX_OK, "");
+
+    zx_exception_handler_t current;
+    ASSERT_EQ(zx_object_get_property(self, ZX_PROP_PROCESS_EXCEPTION_HANDLER,
+                                     &current, sizeof(current)), ZX_OK, "");
+    EXPECT_EQ(current.entry, handler.entry, "");
+    EXPECT_EQ(current.type_mask, handler.type_mask, "");
+
+    // The handler exits the faulting thread without involving any
+    // exception port, so the thread is never joined.
+    thrd_t cthread;
+    tu_thread_create_c11(&cthread, in_process_fault_thread_func, NULL,
+                         "in-process-fault");
+    zx_handle_t thread = tu_handle_duplicate(thrd_get_zx_handle(cthread));
+    ASSERT_EQ(zx_object_wait_one(thread, ZX_THREAD_TERMINATED,
+                                 ZX_TIME_INFINITE, NULL), ZX_OK, "");
+    tu_handle_close(thread);
+
+    EXPECT_EQ(atomic_load(&in_process_handler_type), ZX_EXCP_FATAL_PAGE_FAULT, "");
+    EXPECT_NE(atomic_load(&in_process_handler_frame), 0u, "");
+
+    handler.entry = 0;
+    handler.type_mask = 0;
+    EXPECT_EQ(zx_object_set_property(self, ZX_PROP_PROCESS_EXCEPTION_HANDLER,
+                                     &handler, sizeof(handler)), ZX_OK, "");
+
+    END_TEST;
+}
+
 static bool full_queue_sending_exception_packet_test(void)
 {
     BEGIN_TEST;
@@ -1918,6 +1980,7 @@ RUN_TEST_ENABLE_CRASH_HANDLER(self_death_test);
 RUN_TEST_ENABLE_CRASH_HANDLER(multiple_threads_registered_death_test);
 RUN_TEST(exit_closing_excp_handle_test);
 RUN_TEST(full_queue_sending_exception_packet_test);
+RUN_TEST(in_process_handler_test);
 END_TEST_CASE(exceptions_tests)
 
 static void scan_argv(int argc, char** argv)
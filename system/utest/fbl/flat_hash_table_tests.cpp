@@ -0,0 +1,173 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/alloc_checker.h>
+#include <fbl/flat_hash_table.h>
+#include <fbl/tests/lfsr.h>
+#include <fbl/unique_ptr.h>
+#include <unittest/unittest.h>
+
+namespace fbl {
+namespace tests {
+namespace {
+
+constexpr size_t kObjCount = 1000;
+
+struct TestObj {
+    size_t key;
+    size_t GetKey() const { return key; }
+    static size_t GetHash(size_t key) { return key; }
+};
+
+// Hashes every key to the same value, so that every probe collides.
+struct CollidingHashTraits {
+    static uint64_t GetHash(size_t) { return 0; }
+};
+
+using Table = FlatHashTable<size_t, TestObj*>;
+using CollidingTable = FlatHashTable<size_t, TestObj*,
+                                     DefaultKeyedObjectTraits<size_t, TestObj>,
+                                     CollidingHashTraits>;
+
+bool MakeObjs(unique_ptr<TestObj[]>* out) {
+    BEGIN_HELPER;
+    AllocChecker ac;
+    out->reset(new (&ac) TestObj[kObjCount]);
+    ASSERT_TRUE(ac.check());
+    // Keys are spread out, and not in order.
+    Lfsr<uint32_t> lfsr(0x12345678u);
+    for (size_t i = 0; i < kObjCount; i++) {
+        (*out)[i].key = (static_cast<size_t>(lfsr.GetNext()) << 10) | i;
+    }
+    END_HELPER;
+}
+
+template <typename TableType>
+bool insert_find_erase() {
+    BEGIN_TEST;
+
+    unique_ptr<TestObj[]> objs;
+    ASSERT_TRUE(MakeObjs(&objs));
+    TableType table;
+    EXPECT_TRUE(table.is_empty());
+    EXPECT_NULL(table.find(objs[0].key));
+    EXPECT_NULL(table.erase(objs[0].key));
+
+    for (size_t i = 0; i < kObjCount; i++) {
+        AllocChecker ac;
+        table.insert(&objs[i], &ac);
+        ASSERT_TRUE(ac.check());
+        ASSERT_EQ(i + 1, table.size());
+    }
+    EXPECT_LE(kObjCount, table.capacity());
+
+    for (size_t i = 0; i < kObjCount; i++) {
+        EXPECT_EQ(&objs[i], table.find(objs[i].key));
+    }
+    EXPECT_NULL(table.find(1));
+
+    // Erase every other object, by key and then by object.
+    for (size_t i = 0; i < kObjCount; i += 2) {
+        EXPECT_EQ(&objs[i], (i % 4) ? table.erase(objs[i].key) : table.erase(objs[i]));
+    }
+    EXPECT_EQ(kObjCount / 2, table.size());
+    for (size_t i = 0; i < kObjCount; i++) {
+        EXPECT_EQ((i % 2) ? &objs[i] : nullptr, table.find(objs[i].key));
+    }
+
+    size_t count = 0;
+    size_t odd_count = 0;
+    const TestObj* first = &objs[0];
+    table.ForEach([&count, &odd_count, first](TestObj* obj) {
+        count++;
+        odd_count += static_cast<size_t>(obj - first) % 2;
+    });
+    EXPECT_EQ(kObjCount / 2, count);
+    EXPECT_EQ(kObjCount / 2, odd_count);
+
+    table.clear();
+    EXPECT_TRUE(table.is_empty());
+    EXPECT_EQ(0u, table.capacity());
+    EXPECT_NULL(table.find(objs[1].key));
+
+    END_TEST;
+}
+
+bool erase_by_object() {
+    BEGIN_TEST;
+
+    TestObj old_obj = { 5 };
+    TestObj new_obj = { 5 };
+    Table table;
+    table.insert(&old_obj);
+
+    // Erasing one object leaves another with the same key alone.
+    EXPECT_NULL(table.erase(new_obj));
+    EXPECT_EQ(&old_obj, table.find(5));
+    EXPECT_EQ(&old_obj, table.erase(old_obj));
+    table.insert(&new_obj);
+    EXPECT_NULL(table.erase(old_obj));
+    EXPECT_EQ(&new_obj, table.find(5));
+
+    END_TEST;
+}
+
+bool churn_does_not_grow() {
+    BEGIN_TEST;
+
+    unique_ptr<TestObj[]> objs;
+    ASSERT_TRUE(MakeObjs(&objs));
+    Table table;
+    for (size_t i = 0; i < 16; i++) {
+        table.insert(&objs[i]);
+    }
+    size_t capacity = table.capacity();
+
+    // Tombstones left by erasing objects are reclaimed rather than growing
+    // the table without bound.
+    for (size_t i = 16; i < kObjCount; i++) {
+        EXPECT_EQ(&objs[i - 16], table.erase(objs[i - 16].key));
+        table.insert(&objs[i]);
+        ASSERT_EQ(16u, table.size());
+    }
+    EXPECT_LE(table.capacity(), capacity * 2);
+    for (size_t i = kObjCount - 16; i < kObjCount; i++) {
+        EXPECT_EQ(&objs[i], table.find(objs[i].key));
+    }
+
+    END_TEST;
+}
+
+bool reserve() {
+    BEGIN_TEST;
+
+    unique_ptr<TestObj[]> objs;
+    ASSERT_TRUE(MakeObjs(&objs));
+    Table table;
+    AllocChecker ac;
+    table.reserve(kObjCount, &ac);
+    ASSERT_TRUE(ac.check());
+    size_t capacity = table.capacity();
+    EXPECT_LE(kObjCount, capacity);
+
+    for (size_t i = 0; i < kObjCount; i++) {
+        table.insert(&objs[i]);
+    }
+    EXPECT_EQ(capacity, table.capacity());
+
+    END_TEST;
+}
+
+}  // namespace
+}  // namespace tests
+}  // namespace fbl
+
+BEGIN_TEST_CASE(flat_hash_table_tests)
+RUN_NAMED_TEST("Insert, find and erase", fbl::tests::insert_find_erase<fbl::tests::Table>)
+RUN_NAMED_TEST("Insert, find and erase (colliding)",
+               fbl::tests::insert_find_erase<fbl::tests::CollidingTable>)
+RUN_NAMED_TEST("Erase by object", fbl::tests::erase_by_object)
+RUN_NAMED_TEST("Churn does not grow", fbl::tests::churn_does_not_grow)
+RUN_NAMED_TEST("Reserve", fbl::tests::reserve)
+END_TEST_CASE(flat_hash_table_tests)
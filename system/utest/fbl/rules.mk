@@ -13,6 +13,7 @@ fbl_common_tests := \
     $(LOCAL_DIR)/array_tests.cpp \
     $(LOCAL_DIR)/atomic_tests.cpp \
     $(LOCAL_DIR)/auto_call_tests.cpp \
+    $(LOCAL_DIR)/flat_hash_table_tests.cpp \
     $(LOCAL_DIR)/forward_tests.cpp \
     $(LOCAL_DIR)/function_tests.cpp \
     $(LOCAL_DIR)/initializer_list_tests.cpp \
@@ -10,6 +10,8 @@
 #include <fbl/unique_ptr.h>
 #include <unittest/unittest.h>
 
+#include <threads.h>
+
 namespace {
 
 enum class ConstructType {
@@ -582,6 +584,73 @@ bool static_slab_test() {
 
     END_TEST;
 }
+
+// Objects for the concurrent free test.  These do not derive from TestBase, as
+// its object count is not thread safe.
+struct ConcurrentTestObj;
+using ConcurrentAllocTraits = fbl::ManualDeleteSlabAllocatorTraits<ConcurrentTestObj*, 1024>;
+using ConcurrentAllocator = fbl::SlabAllocator<ConcurrentAllocTraits>;
+
+struct ConcurrentTestObj : public fbl::SlabAllocated<ConcurrentAllocTraits> {
+    uint64_t payload[2];
+};
+
+constexpr size_t kConcurrentSlabs = 4;
+constexpr size_t kConcurrentThreads = 4;
+constexpr size_t kConcurrentAllocs = ConcurrentAllocator::AllocsPerSlab * kConcurrentSlabs;
+
+struct ConcurrentFreeArgs {
+    ConcurrentAllocator* allocator;
+    ConcurrentTestObj** objs;
+    size_t count;
+};
+
+int ConcurrentFreeThread(void* ctx) {
+    auto args = static_cast<ConcurrentFreeArgs*>(ctx);
+    for (size_t i = 0; i < args->count; ++i) {
+        args->allocator->Delete(args->objs[i]);
+    }
+    return 0;
+}
+
+// Objects freed by several threads at once, which skip the lock, must all make
+// their way back to the allocator.
+bool concurrent_free_test() {
+    BEGIN_TEST;
+
+    ConcurrentAllocator allocator(kConcurrentSlabs);
+    ConcurrentTestObj* objs[kConcurrentAllocs];
+
+    for (size_t pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < kConcurrentAllocs; ++i) {
+            objs[i] = allocator.New();
+            ASSERT_NONNULL(objs[i]);
+        }
+        EXPECT_NULL(allocator.New());
+        EXPECT_EQ(kConcurrentSlabs, allocator.slab_count());
+
+        ConcurrentFreeArgs args[kConcurrentThreads];
+        thrd_t threads[kConcurrentThreads];
+        size_t per_thread = kConcurrentAllocs / kConcurrentThreads;
+        for (size_t i = 0; i < kConcurrentThreads; ++i) {
+            args[i].allocator = &allocator;
+            args[i].objs = objs + (i * per_thread);
+            args[i].count = (i == kConcurrentThreads - 1)
+                          ? kConcurrentAllocs - (i * per_thread)
+                          : per_thread;
+            ASSERT_EQ(thrd_success, thrd_create(&threads[i], ConcurrentFreeThread, &args[i]));
+        }
+        for (size_t i = 0; i < kConcurrentThreads; ++i) {
+            ASSERT_EQ(thrd_success, thrd_join(threads[i], nullptr));
+        }
+    }
+
+    // The second pass must have been satisfied by the objects freed in the
+    // first, without allocating any more slabs.
+    EXPECT_EQ(kConcurrentSlabs, allocator.slab_count());
+
+    END_TEST;
+}
 }  // anon namespace
 
 using MutexLock = ::fbl::Mutex;
@@ -686,4 +755,6 @@ RUN_NAMED_TEST("Counted Static UniquePtr (unlock)", (static_slab_test
     <StaticUniquePtrTestTraits<NullLock, true>>))
 RUN_NAMED_TEST("Counted Static RefPtr    (unlock)", (static_slab_test
     <StaticRefPtrTestTraits<NullLock, true>>))
+
+RUN_NAMED_TEST("Concurrent Free (mutex)", concurrent_free_test)
 END_TEST_CASE(slab_allocator_tests);
@@ -0,0 +1,196 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <lib/fdio/io.h>
+#include <unittest/unittest.h>
+#include <zircon/syscalls.h>
+
+// Wraps a new event in a descriptor which is readable while ZX_USER_SIGNAL_0
+// is asserted on it, and writable while ZX_USER_SIGNAL_1 is.
+static bool create_event_fd(zx_handle_t* event, int* fd) {
+    BEGIN_HELPER;
+    ASSERT_EQ(ZX_OK, zx_event_create(0u, event), "");
+    *fd = fdio_handle_fd(*event, ZX_USER_SIGNAL_0, ZX_USER_SIGNAL_1, true);
+    ASSERT_GE(*fd, 0, "fdio_handle_fd() failed");
+    END_HELPER;
+}
+
+static bool epoll_level_test(void) {
+    BEGIN_TEST;
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+
+    zx_handle_t events[2];
+    int fds[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT_TRUE(create_event_fd(&events[i], &fds[i]), "");
+        struct epoll_event ev = {.events = EPOLLIN, .data.u32 = (uint32_t)i};
+        ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev), "");
+    }
+    struct epoll_event ev = {.events = EPOLLIN};
+    EXPECT_EQ(-1, epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev), "");
+    EXPECT_EQ(EEXIST, errno, "");
+
+    struct epoll_event out[4];
+    EXPECT_EQ(0, epoll_wait(epfd, out, 4, 0), "nothing should be ready");
+
+    // A ready descriptor is reported by every wait until it is not.
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[1], 0u, ZX_USER_SIGNAL_0), "");
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(1, epoll_wait(epfd, out, 4, -1), "");
+        EXPECT_EQ(1u, out[0].data.u32, "");
+        EXPECT_EQ((uint32_t)EPOLLIN, out[0].events, "");
+    }
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[1], ZX_USER_SIGNAL_0, 0u), "");
+    EXPECT_EQ(0, epoll_wait(epfd, out, 4, 0), "");
+
+    // Changing the events asked for takes effect straight away.
+    ASSERT_EQ(ZX_OK, zx_object_signal(events[0], 0u, ZX_USER_SIGNAL_1), "");
+    EXPECT_EQ(0, epoll_wait(epfd, out, 4, 0), "");
+    ev.events = EPOLLOUT;
+    ev.data.u32 = 7u;
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_MOD, fds[0], &ev), "");
+    ASSERT_EQ(1, epoll_wait(epfd, out, 4, 0), "");
+    EXPECT_EQ(7u, out[0].data.u32, "");
+    EXPECT_EQ((uint32_t)EPOLLOUT, out[0].events, "");
+
+    // A removed descriptor is no longer reported.
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_DEL, fds[0], NULL), "");
+    EXPECT_EQ(0, epoll_wait(epfd, out, 4, 0), "");
+    EXPECT_EQ(-1, epoll_ctl(epfd, EPOLL_CTL_DEL, fds[0], NULL), "");
+    EXPECT_EQ(ENOENT, errno, "");
+
+    for (int i = 0; i < 2; i++) {
+        close(fds[i]);
+        zx_handle_close(events[i]);
+    }
+    EXPECT_EQ(0, close(epfd), "");
+
+    END_TEST;
+}
+
+static bool epoll_edge_oneshot_test(void) {
+    BEGIN_TEST;
+
+    int epfd = epoll_create(1);
+    ASSERT_GE(epfd, 0, "epoll_create() failed");
+
+    zx_handle_t edge_event, oneshot_event;
+    int edge_fd, oneshot_fd;
+    ASSERT_TRUE(create_event_fd(&edge_event, &edge_fd), "");
+    ASSERT_TRUE(create_event_fd(&oneshot_event, &oneshot_fd), "");
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLET, .data.fd = edge_fd};
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, edge_fd, &ev), "");
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = oneshot_fd;
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, oneshot_fd, &ev), "");
+
+    // Each is reported once, though both stay ready.
+    ASSERT_EQ(ZX_OK, zx_object_signal(edge_event, 0u, ZX_USER_SIGNAL_0), "");
+    ASSERT_EQ(ZX_OK, zx_object_signal(oneshot_event, 0u, ZX_USER_SIGNAL_0), "");
+    struct epoll_event out[4];
+    ASSERT_EQ(2, epoll_wait(epfd, out, 4, -1), "");
+    EXPECT_NE(out[0].data.fd, out[1].data.fd, "");
+    EXPECT_EQ(0, epoll_wait(epfd, out, 4, 0), "");
+
+    // The edge-triggered descriptor is reported again once it becomes ready
+    // again, and the one-shot descriptor once it is re-enabled.
+    ASSERT_EQ(ZX_OK, zx_object_signal(edge_event, ZX_USER_SIGNAL_0, 0u), "");
+    ASSERT_EQ(ZX_OK, zx_object_signal(edge_event, 0u, ZX_USER_SIGNAL_0), "");
+    ASSERT_EQ(1, epoll_wait(epfd, out, 4, -1), "");
+    EXPECT_EQ(edge_fd, out[0].data.fd, "");
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_MOD, oneshot_fd, &ev), "");
+    ASSERT_EQ(1, epoll_wait(epfd, out, 4, -1), "");
+    EXPECT_EQ(oneshot_fd, out[0].data.fd, "");
+
+    close(edge_fd);
+    close(oneshot_fd);
+    zx_handle_close(edge_event);
+    zx_handle_close(oneshot_event);
+    EXPECT_EQ(0, close(epfd), "");
+
+    END_TEST;
+}
+
+static bool epoll_invalid_test(void) {
+    BEGIN_TEST;
+
+    EXPECT_EQ(-1, epoll_create(0), "");
+    EXPECT_EQ(EINVAL, errno, "");
+    EXPECT_EQ(-1, epoll_create1(~EPOLL_CLOEXEC), "");
+    EXPECT_EQ(EINVAL, errno, "");
+
+    int epfd = epoll_create1(0);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+    struct epoll_event ev = {.events = EPOLLIN};
+    EXPECT_EQ(-1, epoll_ctl(epfd, EPOLL_CTL_ADD, epfd, &ev), "");
+    EXPECT_EQ(EINVAL, errno, "");
+    EXPECT_EQ(-1, epoll_ctl(epfd, EPOLL_CTL_ADD, -1, &ev), "");
+    EXPECT_EQ(EBADF, errno, "");
+    struct epoll_event out[1];
+    EXPECT_EQ(-1, epoll_wait(epfd, out, 0, 0), "");
+    EXPECT_EQ(EINVAL, errno, "");
+
+    // Only an epoll instance can be waited on.
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds), "");
+    EXPECT_EQ(-1, epoll_wait(fds[0], out, 1, 0), "");
+    EXPECT_EQ(EBADF, errno, "");
+    close(fds[0]);
+    close(fds[1]);
+    EXPECT_EQ(0, close(epfd), "");
+
+    END_TEST;
+}
+
+// Closing a descriptor ends its registration, so that the number can be
+// registered again once it is reused.
+static bool epoll_reuse_fd_test(void) {
+    BEGIN_TEST;
+
+    int epfd = epoll_create1(0);
+    ASSERT_GE(epfd, 0, "epoll_create1() failed");
+
+    zx_handle_t event;
+    int fd;
+    ASSERT_TRUE(create_event_fd(&event, &fd), "");
+    struct epoll_event ev = {.events = EPOLLIN, .data.u32 = 1u};
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev), "");
+    ASSERT_EQ(0, close(fd), "");
+    zx_handle_close(event);
+
+    int old_fd = fd;
+    ASSERT_TRUE(create_event_fd(&event, &fd), "");
+    ASSERT_EQ(old_fd, fd, "the descriptor number should have been reused");
+    EXPECT_EQ(-1, epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev), "");
+    EXPECT_EQ(ENOENT, errno, "");
+    ev.data.u32 = 2u;
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev), "");
+
+    struct epoll_event out[2];
+    EXPECT_EQ(0, epoll_wait(epfd, out, 2, 0), "");
+    ASSERT_EQ(ZX_OK, zx_object_signal(event, 0u, ZX_USER_SIGNAL_0), "");
+    ASSERT_EQ(1, epoll_wait(epfd, out, 2, 0), "");
+    EXPECT_EQ(2u, out[0].data.u32, "");
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL), "");
+
+    close(fd);
+    zx_handle_close(event);
+    EXPECT_EQ(0, close(epfd), "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(fdio_epoll_test)
+RUN_TEST(epoll_level_test);
+RUN_TEST(epoll_edge_oneshot_test);
+RUN_TEST(epoll_invalid_test);
+RUN_TEST(epoll_reuse_fd_test);
+END_TEST_CASE(fdio_epoll_test)
@@ -5,8 +5,11 @@
 #include <fbl/type_support.h>
 #include <fidl/test/spaceship/c/fidl.h>
 #include <lib/async-loop/loop.h>
+#include <lib/fidl/bind.h>
+#include <lib/fidl/cpp/message_batcher.h>
 #include <lib/fidl-utils/bind.h>
 #include <lib/zx/channel.h>
+#include <lib/zx/event.h>
 #include <string.h>
 #include <zircon/fidl.h>
 #include <zircon/syscalls.h>
@@ -186,6 +189,167 @@ static bool spaceship_test(void) {
     END_TEST;
 }
 
+static bool spaceship_batch_test(void) {
+    BEGIN_TEST;
+
+    zx::channel client, server;
+    zx_status_t status = zx::channel::create(0, &client, &server);
+    ASSERT_EQ(ZX_OK, status, "");
+
+    async_loop_t* loop = NULL;
+    ASSERT_EQ(ZX_OK, async_loop_create(&kAsyncLoopConfigNoAttachToThread, &loop), "");
+    ASSERT_EQ(ZX_OK, async_loop_start_thread(loop, "spaceship-dispatcher", NULL), "");
+
+    async_dispatcher_t* dispatcher = async_loop_get_dispatcher(loop);
+    SpaceShip ship;
+    ASSERT_EQ(ZX_OK, ship.Bind(dispatcher, fbl::move(server)));
+
+    zx::channel listener_client, listener_server;
+    status = zx::channel::create(0, &listener_client, &listener_server);
+    ASSERT_EQ(ZX_OK, status, "");
+
+    {
+        fidl::MessageBatcher batcher(client.get());
+
+        fidl_test_spaceship_SpaceShipSetDefenseConditionRequest condition;
+        memset(&condition, 0, sizeof(condition));
+        condition.hdr.ordinal = fidl_test_spaceship_SpaceShipSetDefenseConditionOrdinal;
+        condition.alert = fidl_test_spaceship_Alert_RED;
+        for (int i = 0; i < 3; i++) {
+            fidl::Message message(fidl::BytePart(reinterpret_cast<uint8_t*>(&condition),
+                                                 sizeof(condition), sizeof(condition)),
+                                  fidl::HandlePart());
+            ASSERT_EQ(ZX_OK, batcher.Write(&message));
+        }
+
+        fidl_test_spaceship_SpaceShipSetAstrometricsListenerRequest listener;
+        memset(&listener, 0, sizeof(listener));
+        listener.hdr.ordinal = fidl_test_spaceship_SpaceShipSetAstrometricsListenerOrdinal;
+        listener.listener = FIDL_HANDLE_PRESENT;
+        zx_handle_t handle = listener_client.release();
+        fidl::Message message(fidl::BytePart(reinterpret_cast<uint8_t*>(&listener),
+                                             sizeof(listener), sizeof(listener)),
+                              fidl::HandlePart(&handle, 1, 1));
+        ASSERT_EQ(ZX_OK, batcher.Write(&message));
+        EXPECT_EQ(0u, message.handles().actual());
+
+        // Only one-way messages can be batched.
+        condition.hdr.txid = 1u;
+        fidl::Message call(fidl::BytePart(reinterpret_cast<uint8_t*>(&condition),
+                                          sizeof(condition), sizeof(condition)),
+                           fidl::HandlePart());
+        EXPECT_EQ(ZX_ERR_INVALID_ARGS, batcher.Write(&call));
+
+        EXPECT_EQ(4u, batcher.pending());
+        ASSERT_EQ(ZX_OK, batcher.Flush());
+        EXPECT_EQ(0u, batcher.pending());
+    }
+
+    ASSERT_EQ(ZX_OK, listener_server.wait_one(ZX_CHANNEL_READABLE, zx::time::infinite(), NULL));
+
+    // The connection is still open after the batch.
+    {
+        const uint32_t stars[3] = {11u, 0u, UINT32_MAX};
+        int8_t result = 0;
+        ASSERT_EQ(ZX_OK,
+                  fidl_test_spaceship_SpaceShipAdjustHeading(client.get(), stars, 3, &result));
+        ASSERT_EQ(-12, result, "");
+    }
+
+    ASSERT_EQ(ZX_OK, zx_handle_close(client.release()));
+
+    async_loop_destroy(loop);
+
+    END_TEST;
+}
+
+// Dispatches one-way messages, handling the first asynchronously. Signals
+// ZX_USER_SIGNAL_0 after each message, and ZX_USER_SIGNAL_1 after the last
+// one expected by the test.
+struct BatchAsyncState {
+    zx_handle_t event;
+    uint32_t dispatched;
+    uint32_t expected;
+    fidl_async_txn_t* async_txn;
+};
+
+static zx_status_t batch_async_dispatch(void* ctx, fidl_txn_t* txn, fidl_msg_t* msg,
+                                        const void* ops) {
+    auto state = static_cast<BatchAsyncState*>(ctx);
+    auto hdr = static_cast<fidl_message_header_t*>(msg->bytes);
+    EXPECT_EQ(fidl_test_spaceship_SpaceShipSetDefenseConditionOrdinal, hdr->ordinal, "");
+    zx_status_t status = ZX_OK;
+    if (state->dispatched++ == 0u) {
+        state->async_txn = fidl_async_txn_create(txn);
+        status = ZX_ERR_ASYNC;
+    }
+    zx_signals_t signals = ZX_USER_SIGNAL_0;
+    if (state->dispatched == state->expected) {
+        signals |= ZX_USER_SIGNAL_1;
+    }
+    EXPECT_EQ(ZX_OK, zx_object_signal(state->event, 0u, signals), "");
+    return status;
+}
+
+static bool spaceship_batch_async_test(void) {
+    BEGIN_TEST;
+
+    zx::channel client, server;
+    zx_status_t status = zx::channel::create(0, &client, &server);
+    ASSERT_EQ(ZX_OK, status, "");
+
+    zx::event event;
+    ASSERT_EQ(ZX_OK, zx::event::create(0, &event), "");
+
+    async_loop_t* loop = NULL;
+    ASSERT_EQ(ZX_OK, async_loop_create(&kAsyncLoopConfigNoAttachToThread, &loop), "");
+    ASSERT_EQ(ZX_OK, async_loop_start_thread(loop, "spaceship-dispatcher", NULL), "");
+
+    BatchAsyncState state = {
+        .event = event.get(),
+        .dispatched = 0u,
+        .expected = 4u,
+        .async_txn = NULL,
+    };
+    ASSERT_EQ(ZX_OK, fidl_bind(async_loop_get_dispatcher(loop), server.release(),
+                               batch_async_dispatch, &state, NULL), "");
+
+    fidl_test_spaceship_SpaceShipSetDefenseConditionRequest condition;
+    memset(&condition, 0, sizeof(condition));
+    condition.hdr.ordinal = fidl_test_spaceship_SpaceShipSetDefenseConditionOrdinal;
+    condition.alert = fidl_test_spaceship_Alert_RED;
+    {
+        fidl::MessageBatcher batcher(client.get());
+        for (int i = 0; i < 3; i++) {
+            fidl::Message message(fidl::BytePart(reinterpret_cast<uint8_t*>(&condition),
+                                                 sizeof(condition), sizeof(condition)),
+                                  fidl::HandlePart());
+            ASSERT_EQ(ZX_OK, batcher.Write(&message));
+        }
+        ASSERT_EQ(ZX_OK, batcher.Flush());
+    }
+
+    // The rest of the batch waits for the first message to complete.
+    ASSERT_EQ(ZX_OK, event.wait_one(ZX_USER_SIGNAL_0, zx::time::infinite(), NULL), "");
+    EXPECT_EQ(1u, state.dispatched, "");
+    ASSERT_NONNULL(state.async_txn, "");
+
+    // Completing it dispatches the rest of the batch before waiting on the
+    // channel again.
+    ASSERT_EQ(ZX_OK, fidl_async_txn_complete(state.async_txn, true), "");
+    EXPECT_EQ(3u, state.dispatched, "");
+
+    ASSERT_EQ(ZX_OK, client.write(0u, &condition, sizeof(condition), NULL, 0u), "");
+    ASSERT_EQ(ZX_OK, event.wait_one(ZX_USER_SIGNAL_1, zx::time::infinite(), NULL), "");
+    EXPECT_EQ(4u, state.dispatched, "");
+
+    ASSERT_EQ(ZX_OK, zx_handle_close(client.release()));
+
+    async_loop_destroy(loop);
+
+    END_TEST;
+}
+
 // A variant of spaceship which responds to requests asynchronously.
 class AsyncSpaceShip : public SpaceShip {
 public:
@@ -377,4 +541,6 @@ public:
 BEGIN_TEST_CASE(spaceship_tests_cpp)
 RUN_NAMED_TEST("fidl.test.spaceship.SpaceShip test", spaceship_test)
 RUN_NAMED_TEST("fidl.test.spaceship.SpaceShip async test", spaceship_async_test)
+RUN_NAMED_TEST("fidl.test.spaceship.SpaceShip batch test", spaceship_batch_test)
+RUN_NAMED_TEST("fidl.test.spaceship.SpaceShip batch async test", spaceship_batch_async_test)
 END_TEST_CASE(spaceship_tests_cpp);
@@ -124,6 +124,12 @@ bool OptionsAreOverwritten() {
         "1024",
         "--ramdisk_block_count",
         "500",
+        "--ramdisk_latency_us",
+        "250",
+        "--ramdisk_bytes_per_sec",
+        "1000000",
+        "--ramdisk_queue_depth",
+        "8",
         "--runs",
         "4",
         "--out",
@@ -161,6 +167,9 @@ bool OptionsAreOverwritten() {
     ASSERT_TRUE(f_options.use_ramdisk);
     ASSERT_EQ(f_options.ramdisk_block_size, 1024);
     ASSERT_EQ(f_options.ramdisk_block_count, 500);
+    ASSERT_EQ(f_options.ramdisk_perf.latency, ZX_USEC(250));
+    ASSERT_EQ(f_options.ramdisk_perf.bytes_per_sec, 1000000u);
+    ASSERT_EQ(f_options.ramdisk_perf.queue_depth, 8u);
     ASSERT_TRUE(f_options.use_fvm);
     ASSERT_EQ(f_options.fvm_slice_size, 8192);
     ASSERT_EQ(f_options.fs_type, DISK_FORMAT_BLOBFS);
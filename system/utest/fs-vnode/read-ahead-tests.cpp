@@ -0,0 +1,177 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fs/block-txn.h>
+#include <fs/read-ahead.h>
+#include <unittest/unittest.h>
+#include <zircon/device/block.h>
+
+namespace {
+
+constexpr uint32_t kFsBlockSize = 8192;
+constexpr uint32_t kDeviceBlockSize = 512;
+constexpr uint64_t kFactor = kFsBlockSize / kDeviceBlockSize;
+constexpr vmoid_t kVmoid = 5;
+constexpr size_t kCapacity = 16;
+constexpr uint64_t kBlockCount = 100;
+
+// A device whose block |bno| is filled with the byte |bno|, and which
+// records how many blocks each transaction reads.
+class FakeDevice : public fs::TransactionHandler {
+public:
+    uint32_t FsBlockSize() const final { return kFsBlockSize; }
+    groupid_t BlockGroupID() final { return 1; }
+    uint32_t DeviceBlockSize() const final { return kDeviceBlockSize; }
+
+    zx_status_t Transaction(block_fifo_request_t* requests, size_t count) final {
+        uint64_t blocks = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (requests[i].opcode != BLOCKIO_READ) {
+                continue;
+            }
+            uint8_t data[kDeviceBlockSize];
+            for (uint32_t n = 0; n < requests[i].length; n++) {
+                memset(data, static_cast<int>((requests[i].dev_offset + n) / kFactor),
+                       sizeof(data));
+                zx_status_t status = vmo->write(data, (requests[i].vmo_offset + n) *
+                                                kDeviceBlockSize, sizeof(data));
+                if (status != ZX_OK) {
+                    return status;
+                }
+            }
+            blocks += requests[i].length / kFactor;
+        }
+        reads.push_back(blocks);
+        return ZX_OK;
+    }
+
+    const zx::vmo* vmo = nullptr;
+    fbl::Vector<uint64_t> reads;
+};
+
+bool CreateCache(FakeDevice* device, fbl::unique_ptr<fs::ReadAheadCache>* out) {
+    BEGIN_HELPER;
+    ASSERT_EQ(ZX_OK, fs::ReadAheadCache::Create(device, kCapacity, kBlockCount, out));
+    (*out)->SetVmoid(kVmoid);
+    device->vmo = &(*out)->vmo();
+    END_HELPER;
+}
+
+bool ExpectRead(fs::ReadAheadCache* cache, uint64_t bno) {
+    BEGIN_HELPER;
+    uint8_t data[kFsBlockSize];
+    uint8_t expected[kFsBlockSize];
+    memset(expected, static_cast<int>(bno), sizeof(expected));
+    ASSERT_EQ(ZX_OK, cache->Read(bno, data));
+    EXPECT_EQ(0, memcmp(expected, data, sizeof(data)));
+    END_HELPER;
+}
+
+bool TestReadAheadGrowsWithSequentialReads() {
+    BEGIN_TEST;
+
+    FakeDevice device;
+    fbl::unique_ptr<fs::ReadAheadCache> cache;
+    ASSERT_TRUE(CreateCache(&device, &cache));
+    for (uint64_t bno = 10; bno < 40; bno++) {
+        ASSERT_TRUE(ExpectRead(cache.get(), bno));
+    }
+
+    // Each miss reads twice as far ahead, up to half of the cache.
+    const uint64_t expected[] = { 1, 2, 4, 8, 8, 8 };
+    ASSERT_EQ(fbl::count_of(expected), device.reads.size());
+    for (size_t i = 0; i < fbl::count_of(expected); i++) {
+        EXPECT_EQ(expected[i], device.reads[i]);
+    }
+
+    END_TEST;
+}
+
+bool TestReadAheadRandomReads() {
+    BEGIN_TEST;
+
+    FakeDevice device;
+    fbl::unique_ptr<fs::ReadAheadCache> cache;
+    ASSERT_TRUE(CreateCache(&device, &cache));
+    const uint64_t blocks[] = { 50, 3, 77, 20, 3 };
+    for (uint64_t bno : blocks) {
+        ASSERT_TRUE(ExpectRead(cache.get(), bno));
+    }
+
+    // Nothing is read ahead, and the repeated block is cached.
+    ASSERT_EQ(4u, device.reads.size());
+    for (uint64_t read : device.reads) {
+        EXPECT_EQ(1u, read);
+    }
+
+    END_TEST;
+}
+
+bool TestReadAheadStopsAtEnd() {
+    BEGIN_TEST;
+
+    FakeDevice device;
+    fbl::unique_ptr<fs::ReadAheadCache> cache;
+    ASSERT_TRUE(CreateCache(&device, &cache));
+    for (uint64_t bno = 94; bno < kBlockCount; bno++) {
+        ASSERT_TRUE(ExpectRead(cache.get(), bno));
+    }
+    ASSERT_EQ(3u, device.reads.size());
+    EXPECT_EQ(3u, device.reads[2]);
+
+    // A block past the end, as on a device which has grown, is read alone.
+    ASSERT_TRUE(ExpectRead(cache.get(), kBlockCount));
+    ASSERT_EQ(4u, device.reads.size());
+    EXPECT_EQ(1u, device.reads[3]);
+
+    END_TEST;
+}
+
+bool TestReadAheadInvalidate() {
+    BEGIN_TEST;
+
+    FakeDevice device;
+    fbl::unique_ptr<fs::ReadAheadCache> cache;
+    ASSERT_TRUE(CreateCache(&device, &cache));
+    ASSERT_TRUE(ExpectRead(cache.get(), 5));
+    ASSERT_TRUE(ExpectRead(cache.get(), 30));
+    ASSERT_EQ(2u, device.reads.size());
+
+    cache->Invalidate(5, 1);
+    block_fifo_request_t write = {};
+    write.opcode = BLOCKIO_WRITE;
+    write.dev_offset = 30 * kFactor + 1;
+    write.length = 1;
+    cache->InvalidateWrites(&write, 1);
+
+    // Both blocks are read from the device again.
+    ASSERT_TRUE(ExpectRead(cache.get(), 5));
+    ASSERT_TRUE(ExpectRead(cache.get(), 30));
+    EXPECT_EQ(4u, device.reads.size());
+
+    // So is a trimmed block.
+    block_fifo_request_t trim = {};
+    trim.opcode = BLOCKIO_TRIM;
+    trim.dev_offset = 5 * kFactor;
+    trim.length = kFactor;
+    cache->InvalidateWrites(&trim, 1);
+    ASSERT_TRUE(ExpectRead(cache.get(), 5));
+    EXPECT_EQ(5u, device.reads.size());
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(read_ahead_tests)
+RUN_TEST(TestReadAheadGrowsWithSequentialReads)
+RUN_TEST(TestReadAheadRandomReads)
+RUN_TEST(TestReadAheadStopsAtEnd)
+RUN_TEST(TestReadAheadInvalidate)
+END_TEST_CASE(read_ahead_tests)
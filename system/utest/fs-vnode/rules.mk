@@ -12,10 +12,12 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/lazy-dir-tests.cpp \
     $(LOCAL_DIR)/pseudo-dir-tests.cpp \
     $(LOCAL_DIR)/pseudo-file-tests.cpp \
+    $(LOCAL_DIR)/read-ahead-tests.cpp \
     $(LOCAL_DIR)/remote-dir-tests.cpp \
     $(LOCAL_DIR)/service-tests.cpp \
     $(LOCAL_DIR)/teardown-tests.cpp \
     $(LOCAL_DIR)/vmo-file-tests.cpp \
+    $(LOCAL_DIR)/writeback-tests.cpp \
     $(LOCAL_DIR)/main.c
 
 MODULE_NAME := fs-vnode-test
@@ -23,6 +25,7 @@ MODULE_NAME := fs-vnode-test
 MODULE_STATIC_LIBS := \
     system/ulib/fidl \
     system/ulib/fs \
+    system/ulib/fzl \
     system/ulib/async.cpp \
     system/ulib/async \
     system/ulib/async-loop.cpp \
@@ -0,0 +1,165 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/vector.h>
+#include <fs/block-txn.h>
+#include <fs/writeback.h>
+#include <unittest/unittest.h>
+#include <zircon/device/block.h>
+
+namespace {
+
+constexpr uint32_t kFsBlockSize = 8192;
+constexpr uint32_t kDeviceBlockSize = 512;
+constexpr uint64_t kFactor = kFsBlockSize / kDeviceBlockSize;
+constexpr vmoid_t kVmoid = 3;
+
+// Records the transactions it is asked to issue.
+class RecordingHandler : public fs::TransactionHandler {
+public:
+    uint32_t FsBlockSize() const final { return kFsBlockSize; }
+    groupid_t BlockGroupID() final { return 1; }
+    uint32_t DeviceBlockSize() const final { return kDeviceBlockSize; }
+
+    zx_status_t Transaction(block_fifo_request_t* requests, size_t count) final {
+        transactions++;
+        for (size_t i = 0; i < count; i++) {
+            this->requests.push_back(requests[i]);
+        }
+        return ZX_OK;
+    }
+
+    size_t transactions = 0;
+    fbl::Vector<block_fifo_request_t> requests;
+};
+
+fs::WriteRequest MakeRequest(size_t vmo_offset, size_t dev_offset, size_t length) {
+    fs::WriteRequest request;
+    request.vmo = ZX_HANDLE_INVALID;
+    request.vmo_offset = vmo_offset;
+    request.dev_offset = dev_offset;
+    request.length = length;
+    return request;
+}
+
+bool ExpectRequest(const block_fifo_request_t& request, uint64_t vmo_offset,
+                   uint64_t dev_offset, uint32_t length, bool barrier) {
+    BEGIN_HELPER;
+    EXPECT_EQ(static_cast<uint32_t>(BLOCKIO_WRITE), request.opcode & BLOCKIO_OP_MASK);
+    EXPECT_EQ(barrier, (request.opcode & BLOCKIO_BARRIER_BEFORE) != 0);
+    EXPECT_EQ(kVmoid, request.vmoid);
+    EXPECT_EQ(1u, request.group);
+    EXPECT_EQ(vmo_offset * kFactor, request.vmo_offset);
+    EXPECT_EQ(dev_offset * kFactor, request.dev_offset);
+    EXPECT_EQ(length * kFactor, request.length);
+    END_HELPER;
+}
+
+bool TestEnqueueWriteRequest() {
+    BEGIN_TEST;
+
+    fbl::Vector<fs::WriteRequest> requests;
+    EXPECT_EQ(2u, fs::EnqueueWriteRequest(&requests, 1, 0, 10, 2));
+    // Following on from the first request, both in the vmo and on disk.
+    EXPECT_EQ(3u, fs::EnqueueWriteRequest(&requests, 1, 2, 12, 3));
+    // Rewriting part of it.
+    EXPECT_EQ(0u, fs::EnqueueWriteRequest(&requests, 1, 0, 10, 4));
+    ASSERT_EQ(1u, requests.size());
+    EXPECT_EQ(5u, requests[0].length);
+
+    // Another vmo, or a gap on disk, needs a request of its own.
+    EXPECT_EQ(1u, fs::EnqueueWriteRequest(&requests, 2, 5, 15, 1));
+    EXPECT_EQ(1u, fs::EnqueueWriteRequest(&requests, 1, 5, 16, 1));
+    EXPECT_EQ(3u, requests.size());
+
+    END_TEST;
+}
+
+bool TestWriteBatchMergesUnits() {
+    BEGIN_TEST;
+
+    RecordingHandler handler;
+    fs::WriteBatch batch(&handler);
+    fs::WriteRequest first[] = { MakeRequest(4, 104, 2), MakeRequest(0, 50, 1) };
+    fs::WriteRequest second[] = { MakeRequest(6, 106, 1), MakeRequest(1, 60, 1) };
+    batch.Add(kVmoid, first, fbl::count_of(first), false);
+    batch.Add(kVmoid, second, fbl::count_of(second), false);
+    EXPECT_FALSE(batch.IsEmpty());
+    ASSERT_EQ(ZX_OK, batch.Transact());
+    EXPECT_TRUE(batch.IsEmpty());
+
+    // A single stage, sorted by disk offset, with the contiguous writes merged.
+    EXPECT_EQ(1u, handler.transactions);
+    ASSERT_EQ(3u, handler.requests.size());
+    EXPECT_TRUE(ExpectRequest(handler.requests[0], 0, 50, 1, false));
+    EXPECT_TRUE(ExpectRequest(handler.requests[1], 1, 60, 1, false));
+    EXPECT_TRUE(ExpectRequest(handler.requests[2], 4, 104, 3, false));
+
+    END_TEST;
+}
+
+bool TestWriteBatchOrdersUnits() {
+    BEGIN_TEST;
+
+    RecordingHandler handler;
+    fs::WriteBatch batch(&handler);
+    fs::WriteRequest data[] = { MakeRequest(0, 100, 1) };
+    fs::WriteRequest metadata[] = { MakeRequest(1, 101, 1) };
+    fs::WriteRequest more_data[] = { MakeRequest(2, 102, 1) };
+    batch.Add(kVmoid, data, fbl::count_of(data), false);
+    batch.Add(kVmoid, metadata, fbl::count_of(metadata), true);
+    batch.Add(kVmoid, more_data, fbl::count_of(more_data), false);
+    ASSERT_EQ(ZX_OK, batch.Transact());
+
+    // The ordered unit isn't merged with its neighbours, and is fenced off from them.
+    EXPECT_EQ(1u, handler.transactions);
+    ASSERT_EQ(3u, handler.requests.size());
+    EXPECT_TRUE(ExpectRequest(handler.requests[0], 0, 100, 1, false));
+    EXPECT_TRUE(ExpectRequest(handler.requests[1], 1, 101, 1, true));
+    EXPECT_TRUE(ExpectRequest(handler.requests[2], 2, 102, 1, true));
+
+    END_TEST;
+}
+
+bool TestWriteBatchOrdersOverwrites() {
+    BEGIN_TEST;
+
+    RecordingHandler handler;
+    fs::WriteBatch batch(&handler);
+    fs::WriteRequest first[] = { MakeRequest(0, 100, 2) };
+    fs::WriteRequest second[] = { MakeRequest(2, 101, 1) };
+    batch.Add(kVmoid, first, fbl::count_of(first), false);
+    batch.Add(kVmoid, second, fbl::count_of(second), false);
+    ASSERT_EQ(ZX_OK, batch.Transact());
+
+    // The newer copy of block 101 is written last.
+    ASSERT_EQ(2u, handler.requests.size());
+    EXPECT_TRUE(ExpectRequest(handler.requests[0], 0, 100, 2, false));
+    EXPECT_TRUE(ExpectRequest(handler.requests[1], 2, 101, 1, true));
+
+    END_TEST;
+}
+
+bool TestWriteBatchEmpty() {
+    BEGIN_TEST;
+
+    RecordingHandler handler;
+    fs::WriteBatch batch(&handler);
+    batch.Add(kVmoid, nullptr, 0, true);
+    EXPECT_TRUE(batch.IsEmpty());
+    ASSERT_EQ(ZX_OK, batch.Transact());
+    EXPECT_EQ(0u, handler.transactions);
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(writeback_tests)
+RUN_TEST(TestEnqueueWriteRequest)
+RUN_TEST(TestWriteBatchMergesUnits)
+RUN_TEST(TestWriteBatchOrdersUnits)
+RUN_TEST(TestWriteBatchOrdersOverwrites)
+RUN_TEST(TestWriteBatchEmpty)
+END_TEST_CASE(writeback_tests)
@@ -17,6 +17,10 @@
 #include <zircon/compiler.h>
 
 #include <fbl/algorithm.h>
+#include <fbl/unique_fd.h>
+#include <fuchsia/io/c/fidl.h>
+#include <lib/fdio/vfs.h>
+#include <lib/fzl/fdio.h>
 
 #include "filesystems.h"
 #include "misc.h"
@@ -308,6 +312,73 @@ bool TestDirectoryReaddir(void) {
     END_TEST;
 }
 
+bool TestDirectoryReaddirPlus(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(mkdir("::dir", 0755), 0);
+    ASSERT_EQ(mkdir("::dir/subdir", 0755), 0);
+    const char* const kFiles[] = {"::dir/empty", "::dir/small", "::dir/large"};
+    const off_t kSizes[] = {0, 10, 20000};
+    for (size_t i = 0; i < fbl::count_of(kFiles); i++) {
+        int fd = open(kFiles[i], O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0);
+        ASSERT_EQ(ftruncate(fd, kSizes[i]), 0);
+        ASSERT_EQ(close(fd), 0);
+    }
+
+    DIR* dir = opendir("::dir");
+    ASSERT_NONNULL(dir);
+    fzl::FdioCaller caller(fbl::unique_fd(dirfd(dir)));
+
+    // Not even one record fits.
+    zx_status_t status;
+    uint8_t buf[fuchsia_io_MAX_BUF];
+    size_t actual;
+    ASSERT_EQ(fuchsia_io_DirectoryReadDirentsPlus(caller.borrow_channel(),
+                                                  sizeof(vdirent_plus_t), &status,
+                                                  buf, sizeof(buf), &actual), ZX_OK);
+    ASSERT_EQ(status, ZX_ERR_BUFFER_TOO_SMALL);
+
+    // Room for two records at a time, so later calls pick up where the
+    // previous ones stopped.
+    const size_t max_bytes = 2 * (sizeof(vdirent_plus_t) + NAME_MAX);
+    size_t entries = 0;
+    do {
+        ASSERT_EQ(fuchsia_io_DirectoryReadDirentsPlus(caller.borrow_channel(), max_bytes,
+                                                      &status, buf, sizeof(buf), &actual),
+                  ZX_OK);
+        ASSERT_EQ(status, ZX_OK);
+        size_t off = 0;
+        while (off < actual) {
+            ASSERT_LE(off + sizeof(vdirent_plus_t), actual);
+            const vdirent_plus_t* entry = reinterpret_cast<const vdirent_plus_t*>(buf + off);
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "::dir/%.*s", entry->size, entry->name);
+            struct stat st;
+            ASSERT_EQ(stat(path, &st), 0);
+            EXPECT_EQ(entry->mode, st.st_mode, path);
+            EXPECT_EQ(entry->ino, st.st_ino, path);
+            EXPECT_EQ(entry->content_size, static_cast<uint64_t>(st.st_size), path);
+            EXPECT_EQ(entry->link_count, static_cast<uint64_t>(st.st_nlink), path);
+            off += sizeof(vdirent_plus_t) + entry->size;
+            entries++;
+        }
+    } while (actual != 0);
+    // ".", "subdir", and the files.
+    ASSERT_EQ(entries, 2 + fbl::count_of(kFiles));
+
+    // The fd is still owned by "dir".
+    caller.release().release();
+    ASSERT_EQ(closedir(dir), 0);
+    for (size_t i = 0; i < fbl::count_of(kFiles); i++) {
+        ASSERT_EQ(unlink(kFiles[i]), 0);
+    }
+    ASSERT_EQ(rmdir("::dir/subdir"), 0);
+    ASSERT_EQ(rmdir("::dir"), 0);
+
+    END_TEST;
+}
+
 // Create a directory named "::dir" with entries "00000", "00001" ... up to
 // num_entries.
 bool large_dir_setup(size_t num_entries) {
@@ -465,6 +536,7 @@ RUN_FOR_ALL_FILESYSTEMS(directory_tests,
     RUN_TEST_LARGE(TestDirectoryLarge)
     RUN_TEST_MEDIUM(TestDirectoryTrailingSlash)
     RUN_TEST_MEDIUM(TestDirectoryReaddir)
+    RUN_TEST_MEDIUM(TestDirectoryReaddirPlus)
     RUN_TEST_LARGE(TestDirectoryReaddirRmAll)
     RUN_TEST_MEDIUM(TestDirectoryRewind)
     RUN_TEST_MEDIUM(TestDirectoryAfterRmdir)
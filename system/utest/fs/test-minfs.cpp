@@ -4,11 +4,15 @@
 
 // Tests for MinFS-specific behavior.
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
+#include <threads.h>
 #include <unistd.h>
 
 #include <fbl/algorithm.h>
@@ -126,6 +130,18 @@ bool ToggleMetrics(bool enabled) {
     END_HELPER;
 }
 
+bool FailDelayedFlushes(uint32_t count) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd(open(kMountPath, O_RDONLY | O_DIRECTORY));
+    ASSERT_TRUE(fd);
+    fzl::FdioCaller caller(fbl::move(fd));
+    zx_status_t status;
+    ASSERT_EQ(fuchsia_minfs_MinfsFailDelayedFlushes(caller.borrow_channel(), count, &status),
+              ZX_OK);
+    ASSERT_EQ(status, ZX_OK);
+    END_HELPER;
+}
+
 bool GetMetricsUnavailable() {
     BEGIN_HELPER;
     fbl::unique_fd fd(open(kMountPath, O_RDONLY | O_DIRECTORY));
@@ -502,6 +518,159 @@ bool TestUnlinkFail(void) {
 
     END_TEST;
 }
+
+// Counts the entries of |path| other than "." and "..".
+bool CountDirents(const char* path, uint32_t* out_count) {
+    DIR* dir = opendir(path);
+    ASSERT_NONNULL(dir);
+    uint32_t count = 0;
+    struct dirent* de;
+    while ((de = readdir(dir)) != nullptr) {
+        if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+            count++;
+        }
+    }
+    ASSERT_EQ(closedir(dir), 0);
+    *out_count = count;
+    return true;
+}
+
+// Enough files to turn the directory into a hash table and split its buckets.
+bool TestLargeDirectory(void) {
+    BEGIN_TEST;
+
+    constexpr uint32_t kFileCount = 5000;
+    const char* dirname = "::bigdir";
+    ASSERT_EQ(mkdir(dirname, 0755), 0);
+
+    char path[PATH_MAX];
+    for (uint32_t i = 0; i < kFileCount; i++) {
+        snprintf(path, sizeof(path), "%s/file_%05u", dirname, i);
+        fbl::unique_fd fd(open(path, O_CREAT | O_RDWR | O_EXCL, 0644));
+        ASSERT_TRUE(fd, path);
+    }
+
+    struct stat s;
+    ASSERT_EQ(stat(dirname, &s), 0);
+    ASSERT_GT(s.st_size, minfs::kMinfsDirLinearMaxSize);
+
+    // Remove every other file, then make sure the rest survive a remount (and fsck).
+    for (uint32_t i = 0; i < kFileCount; i += 2) {
+        snprintf(path, sizeof(path), "%s/file_%05u", dirname, i);
+        ASSERT_EQ(unlink(path), 0, path);
+    }
+    uint32_t count;
+    ASSERT_TRUE(CountDirents(dirname, &count));
+    ASSERT_EQ(count, kFileCount / 2);
+
+    ASSERT_TRUE(check_remount());
+
+    for (uint32_t i = 0; i < kFileCount; i++) {
+        snprintf(path, sizeof(path), "%s/file_%05u", dirname, i);
+        ASSERT_EQ(stat(path, &s), (i % 2) ? 0 : -1, path);
+    }
+    ASSERT_TRUE(CountDirents(dirname, &count));
+    ASSERT_EQ(count, kFileCount / 2);
+
+    // "." and ".." live in the hash table too.
+    snprintf(path, sizeof(path), "%s/..", dirname);
+    ASSERT_EQ(stat(path, &s), 0);
+    ASSERT_TRUE(S_ISDIR(s.st_mode));
+
+    for (uint32_t i = 1; i < kFileCount; i += 2) {
+        snprintf(path, sizeof(path), "%s/file_%05u", dirname, i);
+        ASSERT_EQ(unlink(path), 0, path);
+    }
+    ASSERT_EQ(rmdir(dirname), 0);
+    END_TEST;
+}
+
+// A small write only reaches the disk when its blocks are allocated later on.
+// If that fails, the data must stay around for the next flush.
+bool TestDelayedFlushFailure(void) {
+    BEGIN_TEST;
+
+    const char* filename = "::delayed";
+    fbl::unique_fd fd(open(filename, O_CREAT | O_RDWR | O_EXCL, 0644));
+    ASSERT_TRUE(fd);
+    char data[minfs::kMinfsBlockSize * 3];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<char>(i / minfs::kMinfsBlockSize + 1);
+    }
+    ASSERT_EQ(write(fd.get(), data, sizeof(data)), sizeof(data));
+
+    // The last block fails to be allocated, so the sync fails...
+    ASSERT_TRUE(FailDelayedFlushes(1));
+    ASSERT_NE(syncfs(fd.get()), 0);
+    struct stat s;
+    ASSERT_EQ(fstat(fd.get(), &s), 0);
+    ASSERT_EQ(s.st_size, sizeof(data));
+
+    // ...but the next one writes it out.
+    ASSERT_EQ(syncfs(fd.get()), 0);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_TRUE(check_remount());
+
+    fd.reset(open(filename, O_RDONLY));
+    ASSERT_TRUE(fd);
+    ASSERT_EQ(fstat(fd.get(), &s), 0);
+    ASSERT_EQ(s.st_size, sizeof(data));
+    char buf[sizeof(data)];
+    ASSERT_EQ(read(fd.get(), buf, sizeof(buf)), sizeof(buf));
+    ASSERT_EQ(memcmp(buf, data, sizeof(data)), 0);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(filename), 0);
+    END_TEST;
+}
+
+// Several threads creating and syncing files at once, so that their syncs are
+// committed to the journal together.
+bool TestConcurrentSync(void) {
+    BEGIN_TEST;
+
+    constexpr size_t kNumThreads = 4;
+    constexpr size_t kNumFiles = 32;
+    thrd_t threads[kNumThreads];
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ASSERT_EQ(thrd_create(&threads[i], [](void* arg) {
+            size_t i = reinterpret_cast<size_t>(arg);
+            char path[PATH_MAX];
+            char buf[minfs::kMinfsBlockSize];
+            memset(buf, static_cast<int>(i), sizeof(buf));
+            for (size_t j = 0; j < kNumFiles; j++) {
+                snprintf(path, sizeof(path), "::sync_%zu_%zu", i, j);
+                fbl::unique_fd fd(open(path, O_CREAT | O_RDWR | O_EXCL, 0644));
+                if (!fd || write(fd.get(), buf, sizeof(buf)) != sizeof(buf) ||
+                    fsync(fd.get()) != 0) {
+                    return -1;
+                }
+            }
+            return 0;
+        }, reinterpret_cast<void*>(i)), thrd_success);
+    }
+    for (size_t i = 0; i < kNumThreads; i++) {
+        int rc;
+        ASSERT_EQ(thrd_join(threads[i], &rc), thrd_success);
+        ASSERT_EQ(rc, 0);
+    }
+
+    ASSERT_TRUE(check_remount());
+
+    char path[PATH_MAX];
+    char buf[minfs::kMinfsBlockSize];
+    for (size_t i = 0; i < kNumThreads; i++) {
+        for (size_t j = 0; j < kNumFiles; j++) {
+            snprintf(path, sizeof(path), "::sync_%zu_%zu", i, j);
+            fbl::unique_fd fd(open(path, O_RDONLY));
+            ASSERT_TRUE(fd, path);
+            ASSERT_EQ(read(fd.get(), buf, sizeof(buf)), sizeof(buf));
+            ASSERT_EQ(buf[0], static_cast<char>(i));
+            ASSERT_EQ(buf[sizeof(buf) - 1], static_cast<char>(i));
+            ASSERT_EQ(unlink(path), 0);
+        }
+    }
+    END_TEST;
+}
 }  // namespace
 
 #define RUN_MINFS_TESTS_NORMAL(name, CASE_TESTS) \
@@ -513,6 +682,9 @@ bool TestUnlinkFail(void) {
 RUN_MINFS_TESTS_NORMAL(FsMinfsTests,
     RUN_TEST_LARGE(TestFullOperations)
     RUN_TEST_MEDIUM(TestUnlinkFail)
+    RUN_TEST_LARGE(TestLargeDirectory)
+    RUN_TEST_MEDIUM(TestConcurrentSync)
+    RUN_TEST_MEDIUM(TestDelayedFlushFailure)
 )
 
 RUN_MINFS_TESTS_FVM(FsMinfsFvmTests,
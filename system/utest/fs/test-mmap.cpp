@@ -13,6 +13,7 @@
 #include <unistd.h>
 
 #include <fbl/unique_fd.h>
+#include <lib/fdio/io.h>
 #include <zircon/compiler.h>
 #include <zircon/syscalls.h>
 #include <unittest/unittest.h>
@@ -506,6 +507,35 @@ bool TestMmapTruncateWriteExtend(void) {
     END_TEST;
 }
 
+// Test that a file's vmo can be fetched together with its open, and that
+// a missing file is reported as such.
+bool TestOpenVmo(void) {
+    BEGIN_TEST;
+    if (!test_info->supports_mmap) {
+        return true;
+    }
+
+    constexpr char kFilename[] = "::mmap_open_vmo";
+    fbl::unique_fd fd(open(kFilename, O_RDWR | O_CREAT | O_EXCL));
+    ASSERT_TRUE(fd);
+    char tmp[] = "this is a temporary buffer";
+    ASSERT_EQ(write(fd.get(), tmp, sizeof(tmp)), sizeof(tmp));
+    fd.reset();
+
+    fbl::unique_fd dirfd(open("::.", O_RDONLY | O_DIRECTORY));
+    ASSERT_TRUE(dirfd);
+    zx_handle_t vmo;
+    ASSERT_EQ(fdio_open_vmo_at(dirfd.get(), "mmap_open_vmo", &vmo), ZX_OK);
+    char buf[sizeof(tmp)];
+    ASSERT_EQ(zx_vmo_read(vmo, buf, 0, sizeof(buf)), ZX_OK);
+    ASSERT_EQ(memcmp(buf, tmp, sizeof(tmp)), 0);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+
+    ASSERT_EQ(fdio_open_vmo_at(dirfd.get(), "mmap_no_such_file", &vmo), ZX_ERR_NOT_FOUND);
+    ASSERT_EQ(unlink(kFilename), 0);
+    END_TEST;
+}
+
 enum RW {
     Read,
     Write,
@@ -594,5 +624,6 @@ RUN_FOR_ALL_FILESYSTEMS(fs_mmap_tests,
     RUN_TEST_MEDIUM(TestMmapTruncateAccess)
     RUN_TEST_MEDIUM(TestMmapTruncateExtend)
     RUN_TEST_MEDIUM(TestMmapTruncateWriteExtend)
+    RUN_TEST_MEDIUM(TestOpenVmo)
     RUN_TEST_ENABLE_CRASH_HANDLER(TestMmapDeath)
 )
@@ -15,6 +15,7 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/unique_fd.h>
 #include <fbl/unique_ptr.h>
+#include <lib/fdio/limits.h>
 #include <zircon/syscalls.h>
 
 #include "filesystems.h"
@@ -112,9 +113,117 @@ bool TestOffsetOperations(void) {
     END_TEST;
 }
 
+// Test that reads which may be served from a buffer shared with the server
+// see writes, seeks and size changes made through the file and through others.
+bool TestRepeatedReads(void) {
+    BEGIN_TEST;
+
+    const char* filename = "::repeated_reads";
+    fbl::unique_fd fd(open(filename, O_RDWR | O_CREAT, 0644));
+    ASSERT_TRUE(fd);
+    fbl::unique_fd other(open(filename, O_RDWR));
+    ASSERT_TRUE(other);
+
+    uint8_t data[3 * FDIO_CHUNK_SIZE];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = static_cast<uint8_t>(i * 7);
+    }
+    ASSERT_EQ(write(fd.get(), data, sizeof(data)), sizeof(data));
+    ASSERT_EQ(lseek(fd.get(), 0, SEEK_SET), 0);
+
+    // Large reads follow on from one another, and stop at the end of the file.
+    uint8_t buf[sizeof(data)];
+    ASSERT_EQ(read(fd.get(), buf, 2 * FDIO_CHUNK_SIZE), 2 * FDIO_CHUNK_SIZE);
+    ASSERT_EQ(read(fd.get(), buf + 2 * FDIO_CHUNK_SIZE, sizeof(buf)), FDIO_CHUNK_SIZE);
+    ASSERT_EQ(memcmp(buf, data, sizeof(data)), 0);
+    ASSERT_EQ(read(fd.get(), buf, sizeof(buf)), 0);
+    ASSERT_EQ(lseek(fd.get(), 0, SEEK_CUR), static_cast<off_t>(sizeof(data)));
+
+    // Writes land where the reads left off.
+    ASSERT_EQ(lseek(fd.get(), 10, SEEK_SET), 10);
+    ASSERT_EQ(read(fd.get(), buf, 10), 10);
+    ASSERT_EQ(memcmp(buf, data + 10, 10), 0);
+    const uint8_t marker[] = {1, 2, 3, 4};
+    ASSERT_EQ(write(fd.get(), marker, sizeof(marker)), sizeof(marker));
+    ASSERT_EQ(read(fd.get(), buf, 4), 4);
+    ASSERT_EQ(memcmp(buf, data + 24, 4), 0);
+    ASSERT_EQ(pread(fd.get(), buf, sizeof(marker), 20), sizeof(marker));
+    ASSERT_EQ(memcmp(buf, marker, sizeof(marker)), 0);
+
+    // Growing and shrinking the file through another descriptor is seen.
+    ASSERT_EQ(pwrite(other.get(), marker, sizeof(marker), sizeof(data)), sizeof(marker));
+    ASSERT_EQ(pread(fd.get(), buf, sizeof(buf), sizeof(data)), sizeof(marker));
+    ASSERT_EQ(memcmp(buf, marker, sizeof(marker)), 0);
+    ASSERT_EQ(ftruncate(other.get(), 100), 0);
+    ASSERT_EQ(pread(fd.get(), buf, sizeof(buf), 50), 50);
+    ASSERT_EQ(lseek(fd.get(), 0, SEEK_END), 100);
+
+    ASSERT_EQ(close(other.release()), 0);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(filename), 0);
+
+    END_TEST;
+}
+
+// Test that small writes, which may be combined before they are sent to the
+// server, are seen in order through the file and, eventually, through others.
+bool TestCombinedWrites(void) {
+    BEGIN_TEST;
+
+    const char* filename = "::combined_writes";
+    fbl::unique_fd fd(open(filename, O_RDWR | O_CREAT, 0644));
+    ASSERT_TRUE(fd);
+    fbl::unique_fd other(open(filename, O_RDWR));
+    ASSERT_TRUE(other);
+
+    constexpr size_t kLineSize = 100;
+    constexpr size_t kLineCount = 3 * FDIO_CHUNK_SIZE / kLineSize;
+    uint8_t line[kLineSize];
+    for (size_t i = 0; i < kLineCount; i++) {
+        memset(line, static_cast<int>(i), sizeof(line));
+        ASSERT_EQ(write(fd.get(), line, sizeof(line)), sizeof(line));
+    }
+
+    // Anything which asks the server about the file sees every write.
+    struct stat st;
+    ASSERT_EQ(fstat(fd.get(), &st), 0);
+    ASSERT_EQ(st.st_size, static_cast<off_t>(kLineCount * kLineSize));
+    ASSERT_EQ(lseek(fd.get(), 0, SEEK_CUR), static_cast<off_t>(kLineCount * kLineSize));
+    for (size_t i = 0; i < kLineCount; i++) {
+        ASSERT_EQ(pread(other.get(), line, sizeof(line), i * kLineSize), sizeof(line));
+        for (size_t j = 0; j < sizeof(line); j++) {
+            ASSERT_EQ(line[j], static_cast<uint8_t>(i));
+        }
+    }
+
+    // Another descriptor sees a write after a sync, or before long without one.
+    const uint8_t marker[] = {1, 2, 3, 4};
+    ASSERT_EQ(write(fd.get(), marker, sizeof(marker)), sizeof(marker));
+    ASSERT_EQ(fsync(fd.get()), 0);
+    ASSERT_EQ(fstat(other.get(), &st), 0);
+    ASSERT_EQ(st.st_size, static_cast<off_t>(kLineCount * kLineSize + sizeof(marker)));
+    ASSERT_EQ(write(fd.get(), marker, sizeof(marker)), sizeof(marker));
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(fstat(other.get(), &st), 0);
+        if (st.st_size == static_cast<off_t>(kLineCount * kLineSize + 2 * sizeof(marker))) {
+            break;
+        }
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+    }
+    ASSERT_EQ(st.st_size, static_cast<off_t>(kLineCount * kLineSize + 2 * sizeof(marker)));
+
+    ASSERT_EQ(close(other.release()), 0);
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(unlink(filename), 0);
+
+    END_TEST;
+}
+
 }  // namespace
 
 RUN_FOR_ALL_FILESYSTEMS(rw_tests,
     RUN_TEST_MEDIUM(TestZeroLengthOperations)
     RUN_TEST_MEDIUM(TestOffsetOperations)
+    RUN_TEST_MEDIUM(TestRepeatedReads)
+    RUN_TEST_MEDIUM(TestCombinedWrites)
 )
@@ -40,6 +40,7 @@ typedef enum {
 typedef enum {
     SPARSE,         // Sparse container
     SPARSE_LZ4,     // Sparse container compressed with LZ4
+    SPARSE_LZ4HC,   // Sparse container compressed with LZ4 HC
     SPARSE_ZXCRYPT, // Sparse,container to be stored on a zxcrypt volume
     FVM,            // Explicitly created FVM container
     FVM_NEW,        // FVM container created on FvmContainer::Create
@@ -156,13 +157,14 @@ bool AddPartitions(Container* container) {
     END_HELPER;
 }
 
-bool CreateSparse(uint32_t flags, size_t slice_size) {
+bool CreateSparse(uint32_t flags, size_t slice_size, bool high_compression = false) {
     BEGIN_HELPER;
     const char* path = ((flags & fvm::kSparseFlagLz4) != 0) ? sparse_lz4_path : sparse_path;
     unittest_printf("Creating sparse container: %s\n", path);
     fbl::unique_ptr<SparseContainer> sparseContainer;
     ASSERT_EQ(SparseContainer::Create(path, slice_size, flags, &sparseContainer), ZX_OK,
               "Failed to initialize sparse container");
+    sparseContainer->SetHighCompression(high_compression);
     ASSERT_TRUE(AddPartitions(sparseContainer.get()));
     ASSERT_EQ(sparseContainer->Commit(), ZX_OK, "Failed to write to sparse file");
     END_HELPER;
@@ -436,6 +438,12 @@ bool CreateReportDestroy(container_t type, size_t slice_size) {
         ASSERT_TRUE(DestroySparse(fvm::kSparseFlagLz4));
         break;
     }
+    case SPARSE_LZ4HC: {
+        ASSERT_TRUE(CreateSparse(fvm::kSparseFlagLz4, slice_size, true));
+        ASSERT_TRUE(ReportSparse(fvm::kSparseFlagLz4));
+        ASSERT_TRUE(DestroySparse(fvm::kSparseFlagLz4));
+        break;
+    }
     case SPARSE_ZXCRYPT: {
         ASSERT_TRUE(CreateSparse(fvm::kSparseFlagZxcrypt, slice_size));
         ASSERT_TRUE(ReportSparse(fvm::kSparseFlagZxcrypt));
@@ -513,6 +521,7 @@ bool TestCompressorBufferTooSmall() {
     END_TEST;
 }
 
+template <blobfs::CompressionLevel Level>
 bool TestBlobfsCompressor() {
     BEGIN_TEST;
     blobfs::Compressor compressor;
@@ -520,7 +529,6 @@ bool TestBlobfsCompressor() {
     // Pretend we're going to compress only one byte of data.
     const size_t buf_size = compressor.BufferMax(1);
     fbl::unique_ptr<char[]> buf(new char[buf_size]);
-    ASSERT_EQ(compressor.Initialize(buf.get(), buf_size), ZX_OK);
 
     // Create data as large as possible that will fit still within this buffer.
     size_t data_size = 0;
@@ -531,6 +539,7 @@ bool TestBlobfsCompressor() {
     ASSERT_GT(data_size, 0);
     ASSERT_EQ(compressor.BufferMax(data_size), buf_size);
     ASSERT_GT(compressor.BufferMax(data_size+1), buf_size);
+    ASSERT_EQ(compressor.Initialize(buf.get(), buf_size, data_size, Level), ZX_OK);
 
     unsigned int seed = 0;
     for (size_t i = 0; i < data_size; i++) {
@@ -615,6 +624,7 @@ bool Cleanup() {
 #define RUN_FOR_ALL_TYPES_EMPTY(slice_size) \
     RUN_TEST_MEDIUM((TestEmptyPartitions<SPARSE, slice_size>)) \
     RUN_TEST_MEDIUM((TestEmptyPartitions<SPARSE_LZ4, slice_size>)) \
+    RUN_TEST_MEDIUM((TestEmptyPartitions<SPARSE_LZ4HC, slice_size>)) \
     RUN_TEST_MEDIUM((TestEmptyPartitions<SPARSE_ZXCRYPT, slice_size>)) \
     RUN_TEST_MEDIUM((TestEmptyPartitions<FVM, slice_size>)) \
     RUN_TEST_MEDIUM((TestEmptyPartitions<FVM_NEW, slice_size>)) \
@@ -623,6 +633,7 @@ bool Cleanup() {
 #define RUN_FOR_ALL_TYPES(num_dirs, num_files, max_size, slice_size) \
     RUN_TEST_MEDIUM((TestPartitions<SPARSE, num_dirs, num_files, max_size, slice_size>)) \
     RUN_TEST_MEDIUM((TestPartitions<SPARSE_LZ4, num_dirs, num_files, max_size, slice_size>)) \
+    RUN_TEST_MEDIUM((TestPartitions<SPARSE_LZ4HC, num_dirs, num_files, max_size, slice_size>)) \
     RUN_TEST_MEDIUM((TestPartitions<SPARSE_ZXCRYPT, num_dirs, num_files, max_size, slice_size>)) \
     RUN_TEST_MEDIUM((TestPartitions<FVM, num_dirs, num_files, max_size, slice_size>)) \
     RUN_TEST_MEDIUM((TestPartitions<FVM_NEW, num_dirs, num_files, max_size, slice_size>)) \
@@ -637,7 +648,8 @@ RUN_FOR_ALL_TYPES(10, 100, (1 << 20), 8192)
 RUN_FOR_ALL_TYPES(10, 100, (1 << 20), 32768)
 RUN_FOR_ALL_TYPES(10, 100, (1 << 20), DEFAULT_SLICE_SIZE)
 RUN_TEST_MEDIUM(TestCompressorBufferTooSmall)
-RUN_TEST_MEDIUM(TestBlobfsCompressor)
+RUN_TEST_MEDIUM((TestBlobfsCompressor<blobfs::CompressionLevel::kFast>))
+RUN_TEST_MEDIUM((TestBlobfsCompressor<blobfs::CompressionLevel::kHigh>))
 END_TEST_CASE(fvm_host_tests)
 
 int main(int argc, char** argv) {
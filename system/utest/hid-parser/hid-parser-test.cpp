@@ -7,6 +7,7 @@
 
 #include <hid-parser/item.h>
 #include <hid-parser/parser.h>
+#include <hid-parser/report.h>
 #include <hid-parser/usages.h>
 
 #include <unistd.h>
@@ -658,6 +659,125 @@ static bool parse_asus_touch() {
    END_TEST;
 }
 
+static bool decode_boot_mouse() {
+    BEGIN_TEST;
+
+    hid::DeviceDescriptor* dev = nullptr;
+    auto res = hid::ParseReportDescriptor(
+        boot_mouse_r_desc, sizeof(boot_mouse_r_desc), &dev);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    hid::InputReportTable* table = nullptr;
+    res = hid::CompileInputReports(dev, &table);
+    hid::FreeDeviceDescriptor(dev);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    // No report id, so the fields start at bit 0 of a 3 byte report.
+    EXPECT_FALSE(table->has_report_id);
+    ASSERT_EQ(table->rep_count, 1u);
+    const hid::InputReport& report = table->report[0];
+    EXPECT_EQ(report.byte_sz, 3u);
+    ASSERT_EQ(report.count, 6u);
+    EXPECT_EQ(report.fields[3].bit_offset, 3u);
+    EXPECT_EQ(report.fields[3].bit_sz, 5u);
+    EXPECT_EQ(report.fields[4].bit_offset, 8u);
+    EXPECT_EQ(report.fields[4].usage.usage, hid::usage::GenericDesktop::kX);
+    EXPECT_EQ(report.fields[5].bit_offset, 16u);
+
+    // Buttons 1 and 3, X = -2, Y = 5, followed by a second report.
+    const uint8_t buf[] = { 0x05, 0xfe, 0x05, 0x02, 0x7f, 0x81 };
+    const hid::InputReport* layout = nullptr;
+    int32_t values[6];
+
+    EXPECT_EQ(hid::DecodeInputReport(table, buf, sizeof(buf), &layout, values, 6), 3u);
+    EXPECT_EQ(layout, &report);
+    EXPECT_EQ(values[0], 1);
+    EXPECT_EQ(values[1], 0);
+    EXPECT_EQ(values[2], 1);
+    EXPECT_EQ(values[3], 0);
+    EXPECT_EQ(values[4], -2);
+    EXPECT_EQ(values[5], 5);
+
+    EXPECT_EQ(hid::DecodeInputReport(table, buf + 3, 3, &layout, values, 6), 3u);
+    EXPECT_EQ(values[1], 1);
+    EXPECT_EQ(values[4], 127);
+    EXPECT_EQ(values[5], -127);
+
+    // Truncated reports and too few values are rejected.
+    EXPECT_EQ(hid::DecodeInputReport(table, buf, 2, &layout, values, 6), 0u);
+    EXPECT_EQ(hid::DecodeInputReport(table, buf, sizeof(buf), &layout, values, 5), 0u);
+
+    // The single field helpers agree.
+    uint32_t raw = 0;
+    int32_t value = 0;
+    EXPECT_TRUE(hid::ExtractUint(buf, 3, report.fields[4], &raw));
+    EXPECT_EQ(raw, 0xfeu);
+    EXPECT_TRUE(hid::ExtractInt(buf, 3, report.fields[4], &value));
+    EXPECT_EQ(value, -2);
+    EXPECT_FALSE(hid::ExtractUint(buf, 2, report.fields[5], &raw));
+
+    hid::FreeInputReportTable(table);
+    END_TEST;
+}
+
+static bool decode_adaf_trinket() {
+    BEGIN_TEST;
+
+    hid::DeviceDescriptor* dev = nullptr;
+    auto res = hid::ParseReportDescriptor(
+        trinket_r_desc, sizeof(trinket_r_desc), &dev);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    hid::InputReportTable* table = nullptr;
+    res = hid::CompileInputReports(dev, &table);
+    hid::FreeDeviceDescriptor(dev);
+    ASSERT_EQ(res, hid::ParseResult::kParseOk);
+
+    EXPECT_TRUE(table->has_report_id);
+    ASSERT_EQ(table->rep_count, 4u);
+    EXPECT_EQ(table->index[0], hid::kNoInputReport);
+
+    // The keyboard report skips the LED output fields: 8 modifier bits,
+    // a padding byte and 5 key bytes after the report id byte.
+    const hid::InputReport& keyboard = table->report[table->index[2]];
+    EXPECT_EQ(keyboard.report_id, 2u);
+    EXPECT_EQ(keyboard.byte_sz, 8u);
+    ASSERT_EQ(keyboard.count, 14u);
+    EXPECT_EQ(keyboard.fields[8].bit_offset, 16u);
+    EXPECT_EQ(keyboard.fields[9].bit_offset, 24u);
+    EXPECT_EQ(keyboard.fields[13].bit_offset, 56u);
+
+    // A mouse report then a keyboard report, back to back.
+    const uint8_t buf[] = {
+        0x01, 0x02, 0x10, 0xf0,
+        0x02, 0x81, 0x00, 0x04, 0x05, 0x00, 0x00, 0x00,
+    };
+    const hid::InputReport* layout = nullptr;
+    int32_t values[14];
+
+    size_t consumed = hid::DecodeInputReport(table, buf, sizeof(buf), &layout, values, 14);
+    ASSERT_EQ(consumed, 4u);
+    EXPECT_EQ(layout->report_id, 1u);
+    EXPECT_EQ(values[1], 1);
+    EXPECT_EQ(values[4], 16);
+    EXPECT_EQ(values[5], -16);
+
+    ASSERT_EQ(hid::DecodeInputReport(table, buf + consumed, sizeof(buf) - consumed,
+                                     &layout, values, 14), 8u);
+    EXPECT_EQ(layout->report_id, 2u);
+    EXPECT_EQ(values[0], 1);
+    EXPECT_EQ(values[7], 1);
+    EXPECT_EQ(values[9], 4);
+    EXPECT_EQ(values[10], 5);
+
+    // Unknown report ids don't decode.
+    const uint8_t unknown[] = { 0x09, 0x00, 0x00, 0x00 };
+    EXPECT_EQ(hid::DecodeInputReport(table, unknown, sizeof(unknown), &layout, values, 14), 0u);
+
+    hid::FreeInputReportTable(table);
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(hidparser_tests)
 RUN_TEST(itemize_acer12_rpt1)
 RUN_TEST(itemize_eve_tablet_rpt)
@@ -667,6 +787,8 @@ RUN_TEST(parse_ps3_controller)
 RUN_TEST(parse_acer12_touch)
 RUN_TEST(parse_eve_tablet)
 RUN_TEST(parse_asus_touch)
+RUN_TEST(decode_boot_mouse)
+RUN_TEST(decode_adaf_trinket)
 END_TEST_CASE(hidparser_tests)
 
 int main(int argc, char** argv) {
@@ -10,6 +10,7 @@
 #include <fuchsia/sysinfo/c/fidl.h>
 #include <lib/fdio/util.h>
 #include <lib/zx/channel.h>
+#include <lib/zx/event.h>
 #include <lib/zx/guest.h>
 #include <lib/zx/port.h>
 #include <lib/zx/resource.h>
@@ -657,6 +658,38 @@ static bool guest_set_trap_with_bell() {
     END_TEST;
 }
 
+static bool guest_set_trap_with_bell_event() {
+    BEGIN_TEST;
+
+    test_t test;
+    ASSERT_TRUE(setup(&test, guest_set_trap_start, guest_set_trap_end));
+    if (!test.supported) {
+        // The hypervisor isn't supported, so don't run the test.
+        return true;
+    }
+
+    zx::event event;
+    ASSERT_EQ(zx::event::create(0, &event), ZX_OK);
+
+    // Trap on access of TRAP_ADDR.
+    ASSERT_EQ(test.guest.set_trap(ZX_GUEST_TRAP_BELL, TRAP_ADDR, PAGE_SIZE, event, kTrapKey),
+              ZX_OK);
+
+    // The bell signals the event without stopping the VCPU.
+    zx_port_packet_t packet = {};
+    ASSERT_EQ(test.vcpu.resume(&packet), ZX_OK);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_GUEST_MEM);
+    EXPECT_EQ(packet.guest_mem.addr, EXIT_TEST_ADDR);
+
+    zx_signals_t observed;
+    ASSERT_EQ(event.wait_one(ZX_EVENT_SIGNALED, zx::time::infinite_past(), &observed), ZX_OK);
+    EXPECT_TRUE(observed & ZX_EVENT_SIGNALED);
+
+    ASSERT_TRUE(teardown(&test));
+
+    END_TEST;
+}
+
 static bool guest_set_trap_with_io() {
     BEGIN_TEST;
 
@@ -689,6 +722,7 @@ RUN_TEST(vcpu_read_write_state)
 RUN_TEST(vcpu_interrupt)
 RUN_TEST(guest_set_trap_with_mem)
 RUN_TEST(guest_set_trap_with_bell)
+RUN_TEST(guest_set_trap_with_bell_event)
 #if __aarch64__
 RUN_TEST(vcpu_wfi)
 RUN_TEST(vcpu_wfi_aarch32)
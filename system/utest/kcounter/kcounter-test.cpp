@@ -0,0 +1,76 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <fbl/unique_ptr.h>
+#include <lib/kcounter/reader.h>
+#include <lib/zx/event.h>
+#include <unittest/unittest.h>
+
+namespace {
+
+bool reader_test() {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<kcounter::Reader> reader;
+    ASSERT_EQ(kcounter::Reader::Create(&reader), ZX_OK);
+    ASSERT_GT(reader->num_counters(), 0u);
+    ASSERT_GT(reader->max_cpus(), 0u);
+
+    // The counters are sorted by name, which Find() relies on.
+    for (size_t i = 1; i < reader->num_counters(); ++i) {
+        EXPECT_LT(strcmp(reader->name(i - 1), reader->name(i)), 0, reader->name(i));
+    }
+    for (size_t i = 0; i < reader->num_counters(); ++i) {
+        size_t index;
+        ASSERT_EQ(reader->Find(reader->name(i), &index), ZX_OK, reader->name(i));
+        EXPECT_EQ(index, i);
+    }
+    size_t index;
+    EXPECT_EQ(reader->Find("kernel.no.such.counter", &index), ZX_ERR_NOT_FOUND);
+
+    END_TEST;
+}
+
+bool snapshot_diff_test() {
+    BEGIN_TEST;
+
+    fbl::unique_ptr<kcounter::Reader> reader;
+    ASSERT_EQ(kcounter::Reader::Create(&reader), ZX_OK);
+    size_t handles_new;
+    ASSERT_EQ(reader->Find("kernel.handles.new", &handles_new), ZX_OK);
+
+    kcounter::Snapshot before;
+    ASSERT_EQ(reader->TakeSnapshot(&before), ZX_OK);
+    constexpr int64_t kEvents = 10;
+    for (int64_t i = 0; i < kEvents; ++i) {
+        zx::event event;
+        ASSERT_EQ(zx::event::create(0, &event), ZX_OK);
+    }
+    kcounter::Snapshot after;
+    ASSERT_EQ(reader->TakeSnapshot(&after), ZX_OK);
+    EXPECT_GE(after.time().get(), before.time().get());
+
+    // Other threads may make handles too, so the counter can only be
+    // checked against a lower bound.
+    kcounter::Snapshot delta;
+    ASSERT_EQ(after.Diff(before, &delta), ZX_OK);
+    EXPECT_GE(delta.Sum(handles_new), kEvents);
+    EXPECT_EQ(delta.Sum(handles_new), after.Sum(handles_new) - before.Sum(handles_new));
+    EXPECT_GE(reader->Read(handles_new), after.Sum(handles_new));
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(kcounter_tests)
+RUN_TEST(reader_test)
+RUN_TEST(snapshot_diff_test)
+END_TEST_CASE(kcounter_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
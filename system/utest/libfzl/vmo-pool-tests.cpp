@@ -293,6 +293,31 @@ bool vmo_pool_reinit() {
     END_TEST;
 }
 
+// Checks that a prefaulted pool hands out buffers which are committed up
+// front, and which are not pinned.
+bool vmo_pool_prefault_test() {
+    BEGIN_TEST;
+    VmoPoolTester tester;
+    ASSERT_TRUE(AssignVmos(kNumVmos, kVmoTestSize, tester.vmo_handles_));
+    fzl::VmoPool::Options options;
+    options.prefault = true;
+    ASSERT_EQ(tester.pool_.Init(tester.vmo_handles_, kNumVmos, options), ZX_OK);
+
+    for (size_t i = 0; i < kNumVmos; ++i) {
+        zx_info_vmo_t info;
+        ASSERT_EQ(tester.vmo_handles_[i].get_info(ZX_INFO_VMO, &info, sizeof(info),
+                                                  nullptr, nullptr), ZX_OK);
+        ASSERT_EQ(info.committed_bytes, kVmoTestSize);
+    }
+
+    ASSERT_EQ(tester.pool_.GetNewBuffer(), ZX_OK);
+    ASSERT_NULL(tester.pool_.CurrentBufferPinnedVmo());
+    ASSERT_EQ(tester.pool_.BufferCompleted(), ZX_OK);
+    tester.pool_.Reset();
+    ASSERT_TRUE(tester.CheckAccounting(false, 0));
+    END_TEST;
+}
+
 } // namespace
 
 BEGIN_TEST_CASE(vmo_pool_tests)
@@ -304,4 +329,5 @@ RUN_NAMED_TEST("vmo_pool_release_before_complete", vmo_pool_release_before_compl
 RUN_NAMED_TEST("vmo_pool_fill_and_empty_pool", vmo_pool_fill_and_empty_pool_test)
 RUN_NAMED_TEST("vmo_pool_out_of_order", vmo_pool_out_of_order_test)
 RUN_NAMED_TEST("vmo_pool_reinit", vmo_pool_reinit)
+RUN_NAMED_TEST("vmo_pool_prefault", vmo_pool_prefault_test)
 END_TEST_CASE(vmo_pool_tests)
@@ -196,6 +196,33 @@ bool TestLogSeverity(void) {
     END_TEST;
 }
 
+bool TestLogStructured(void) {
+    BEGIN_TEST;
+    Fixture fixture;
+    ASSERT_TRUE(fixture.CreateLogger());
+    ASSERT_TRUE(fixture.ConnectToLogger());
+    const char* gtags[] = {"gtag1"};
+    ASSERT_TRUE(fixture.InitSyslog(gtags, 1));
+    fx_logger_t* logger = fx_log_get_logger();
+    fx_log_format_id_t id;
+    ASSERT_EQ(ZX_OK, fx_logger_register_format(logger, "%d, %s, %.1f", &id));
+    ASSERT_EQ(ZX_OK, fx_logger_log_structured(logger, FX_LOG_INFO, id, 10, "str", 1.5));
+    ASSERT_EQ(ZX_OK, fx_logger_flush(logger));
+    fixture.RunLoop();
+    const char* out = fixture.read_buffer();
+    ASSERT_TRUE(ends_with(out, "[gtag1] INFO: 10, str, 1.5\n"), out);
+
+    // Warnings are sent without waiting for a flush.
+    ASSERT_EQ(ZX_OK, fx_logger_log_structured(logger, FX_LOG_INFO, id, 11, "a", 2.0));
+    ASSERT_EQ(ZX_OK, fx_logger_log_structured(logger, FX_LOG_WARNING, id, 12, "b", 3.0));
+    fixture.RunLoop();
+    out = fixture.read_buffer();
+    ASSERT_TRUE(ends_with(out, "[gtag1] INFO: 11, a, 2.0\n"
+                               "[gtag1] WARNING: 12, b, 3.0\n"), out);
+    ASSERT_EQ(ZX_OK, fixture.error_status());
+    END_TEST;
+}
+
 bool TestLogWhenLoggerHandleDies(void) {
     BEGIN_TEST;
     Fixture fixture;
@@ -241,6 +268,7 @@ RUN_TEST(TestLogSeverity)
 RUN_TEST(TestLogMultipleMsgs)
 RUN_TEST(TestLogWithTag)
 RUN_TEST(TestLogWithMultipleTags)
+RUN_TEST(TestLogStructured)
 RUN_TEST(TestLogWhenLoggerHandleDies)
 RUN_TEST(TestLoggerDiesWithSocket)
 RUN_TEST(TestLoggerDiesWithChannelWhenNoConnectCalled)
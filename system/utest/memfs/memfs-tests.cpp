@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <threads.h>
@@ -15,6 +16,7 @@
 #include <fbl/unique_fd.h>
 #include <fbl/vector.h>
 #include <lib/fdio/util.h>
+#include <lib/fdio/vfs.h>
 #include <lib/async-loop/cpp/loop.h>
 #include <lib/memfs/memfs.h>
 #include <unittest/unittest.h>
@@ -168,6 +170,54 @@ bool TestMemfsLimitPages() {
     END_TEST;
 }
 
+// Test that holes, and extensions of the file, take up no memory.
+bool TestMemfsSparse() {
+    BEGIN_TEST;
+
+    async::Loop loop(&kAsyncLoopConfigNoAttachToThread);
+    ASSERT_EQ(loop.StartThread(), ZX_OK);
+
+    memfs_filesystem_t* vfs;
+    zx_handle_t root;
+    ASSERT_EQ(memfs_create_filesystem(loop.dispatcher(), &vfs, &root), ZX_OK);
+    uint32_t type = PA_FDIO_REMOTE;
+    int raw_root_fd;
+    ASSERT_EQ(fdio_create_fd(&root, &type, 1, &raw_root_fd), ZX_OK);
+    fbl::unique_fd root_fd(raw_root_fd);
+
+    fbl::unique_fd fd(openat(root_fd.get(), "sparse", O_CREAT | O_RDWR));
+    ASSERT_TRUE(fd);
+    constexpr off_t kOffset = 16 * (1 << 20);
+    const char data = 'a';
+    ASSERT_EQ(pwrite(fd.get(), &data, 1, kOffset), 1);
+    struct stat st;
+    ASSERT_EQ(fstat(fd.get(), &st), 0);
+    ASSERT_EQ(st.st_size, kOffset + 1);
+    ASSERT_EQ(st.st_blocks, PAGE_SIZE / VNATTR_BLKSIZE);
+
+    char buf[PAGE_SIZE];
+    char zeroes[PAGE_SIZE];
+    memset(zeroes, 0, sizeof(zeroes));
+    ASSERT_EQ(pread(fd.get(), buf, sizeof(buf), kOffset / 2), static_cast<ssize_t>(sizeof(buf)));
+    ASSERT_EQ(memcmp(buf, zeroes, sizeof(buf)), 0);
+
+    // What is truncated away is released, and reads as zero once extended.
+    ASSERT_EQ(ftruncate(fd.get(), 1), 0);
+    ASSERT_EQ(fstat(fd.get(), &st), 0);
+    ASSERT_LE(st.st_blocks, PAGE_SIZE / VNATTR_BLKSIZE);
+    ASSERT_EQ(ftruncate(fd.get(), kOffset + 1), 0);
+    ASSERT_EQ(pread(fd.get(), buf, 1, kOffset), 1);
+    ASSERT_EQ(buf[0], 0);
+
+    ASSERT_EQ(close(fd.release()), 0);
+    ASSERT_EQ(close(root_fd.release()), 0);
+    sync_completion_t unmounted;
+    memfs_free_filesystem(vfs, &unmounted);
+    ASSERT_EQ(sync_completion_wait(&unmounted, ZX_SEC(3)), ZX_OK);
+
+    END_TEST;
+}
+
 bool TestMemfsInstall() {
     BEGIN_TEST;
 
@@ -282,6 +332,7 @@ BEGIN_TEST_CASE(memfs_tests)
 RUN_TEST(TestMemfsNull)
 RUN_TEST(TestMemfsBasic)
 RUN_TEST(TestMemfsLimitPages)
+RUN_TEST(TestMemfsSparse)
 RUN_TEST(TestMemfsInstall)
 RUN_TEST(TestMemfsCloseDuringAccess)
 END_TEST_CASE(memfs_tests)
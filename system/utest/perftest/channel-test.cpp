@@ -0,0 +1,150 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/channel.h>
+#include <lib/zx/event.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+#include "peer-thread.h"
+
+namespace {
+
+using perftest_ipc::CpuPlacement;
+
+constexpr uint32_t kMessageSizes[] = {64, 1024, 32 * 1024, 64 * 1024};
+constexpr uint32_t kHandleCounts[] = {1, 8, 64};
+
+// Holds |count| event handles for sending in a message.  The handles are
+// moved into each message written and replaced by those read back.
+class Handles {
+public:
+    explicit Handles(uint32_t count) : count_(count) {
+        for (uint32_t i = 0; i < count_; i++) {
+            zx::event event;
+            ZX_ASSERT(zx::event::create(0, &event) == ZX_OK);
+            handles_[i] = event.release();
+        }
+    }
+    ~Handles() {
+        ZX_ASSERT(zx_handle_close_many(handles_, count_) == ZX_OK);
+    }
+
+    zx_handle_t* get() { return handles_; }
+    uint32_t count() const { return count_; }
+
+private:
+    const uint32_t count_;
+    zx_handle_t handles_[ZX_CHANNEL_MAX_MSG_HANDLES];
+};
+
+// Measure the times taken to write a message to a channel and to read it
+// back, on the same thread.
+bool ChannelWriteReadTest(perftest::RepeatState* state, uint32_t message_size,
+                          uint32_t handle_count) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(message_size);
+
+    zx::channel channel1;
+    zx::channel channel2;
+    ZX_ASSERT(zx::channel::create(0, &channel1, &channel2) == ZX_OK);
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[message_size]());
+    Handles handles(handle_count);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(channel1.write(0, buffer.get(), message_size,
+                                 handles.get(), handles.count()) == ZX_OK);
+        state->NextStep();
+        uint32_t actual_bytes;
+        uint32_t actual_handles;
+        ZX_ASSERT(channel2.read(0, buffer.get(), message_size, &actual_bytes,
+                                handles.get(), handles.count(),
+                                &actual_handles) == ZX_OK);
+        ZX_ASSERT(actual_bytes == message_size);
+        ZX_ASSERT(actual_handles == handles.count());
+    }
+    return true;
+}
+
+// Replies to every message on |channel| with the same bytes and handles,
+// until the other end of |channel| is closed.
+void EchoServer(const zx::channel& channel) {
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[ZX_CHANNEL_MAX_MSG_BYTES]);
+    zx_handle_t handles[ZX_CHANNEL_MAX_MSG_HANDLES];
+    for (;;) {
+        zx_signals_t observed;
+        ZX_ASSERT(channel.wait_one(ZX_CHANNEL_READABLE | ZX_CHANNEL_PEER_CLOSED,
+                                   zx::time::infinite(), &observed) == ZX_OK);
+        if (!(observed & ZX_CHANNEL_READABLE)) {
+            return;
+        }
+        uint32_t actual_bytes;
+        uint32_t actual_handles;
+        ZX_ASSERT(channel.read(0, buffer.get(), ZX_CHANNEL_MAX_MSG_BYTES,
+                               &actual_bytes, handles, ZX_CHANNEL_MAX_MSG_HANDLES,
+                               &actual_handles) == ZX_OK);
+        ZX_ASSERT(channel.write(0, buffer.get(), actual_bytes,
+                                handles, actual_handles) == ZX_OK);
+    }
+}
+
+// Measure the time taken for an IPC round trip between threads, using
+// zx_channel_call() against a thread which echoes each message back.
+bool ChannelCallTest(perftest::RepeatState* state, CpuPlacement placement,
+                     uint32_t message_size, uint32_t handle_count) {
+    zx::channel client;
+    zx::channel server;
+    ZX_ASSERT(zx::channel::create(0, &client, &server) == ZX_OK);
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[message_size]());
+    Handles handles(handle_count);
+
+    perftest_ipc::PeerThread peer(placement, [&server] { EchoServer(server); });
+
+    zx_channel_call_args_t args = {};
+    args.wr_bytes = buffer.get();
+    args.wr_handles = handles.get();
+    args.rd_bytes = buffer.get();
+    args.rd_handles = handles.get();
+    args.wr_num_bytes = message_size;
+    args.wr_num_handles = handles.count();
+    args.rd_num_bytes = message_size;
+    args.rd_num_handles = handles.count();
+    while (state->KeepRunning()) {
+        uint32_t actual_bytes;
+        uint32_t actual_handles;
+        ZX_ASSERT(client.call(0, zx::time::infinite(), &args, &actual_bytes,
+                              &actual_handles) == ZX_OK);
+        ZX_ASSERT(actual_bytes == message_size);
+    }
+
+    // Closing the client lets the server return before |peer| joins it.
+    client.reset();
+    return true;
+}
+
+void RegisterTests() {
+    for (uint32_t message_size : kMessageSizes) {
+        auto name = fbl::StringPrintf("Channel/WriteRead/%ubytes/0handles", message_size);
+        perftest::RegisterTest(name.c_str(), ChannelWriteReadTest, message_size, 0u);
+    }
+    for (uint32_t handle_count : kHandleCounts) {
+        auto name = fbl::StringPrintf("Channel/WriteRead/64bytes/%uhandles", handle_count);
+        perftest::RegisterTest(name.c_str(), ChannelWriteReadTest, 64u, handle_count);
+    }
+
+    for (uint32_t message_size : kMessageSizes) {
+        auto name = fbl::StringPrintf("Channel/Call/%ubytes/0handles", message_size);
+        perftest_ipc::RegisterPlacedTest(name.c_str(), ChannelCallTest, message_size, 0u);
+    }
+    for (uint32_t handle_count : kHandleCounts) {
+        auto name = fbl::StringPrintf("Channel/Call/64bytes/%uhandles", handle_count);
+        perftest_ipc::RegisterPlacedTest(name.c_str(), ChannelCallTest, 64u, handle_count);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -0,0 +1,114 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <lib/zx/fifo.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+#include "peer-thread.h"
+
+namespace {
+
+using perftest_ipc::CpuPlacement;
+
+// The kernel limits a FIFO to one page, which is kFifoElems elements of
+// this size.
+constexpr uint32_t kElemSize = 16;
+constexpr uint32_t kFifoElems = 4096 / kElemSize;
+constexpr uint32_t kBatchSizes[] = {1, 16, kFifoElems};
+
+struct Elem {
+    uint8_t data[kElemSize];
+};
+
+// Measure the times taken to write a batch of elements to a FIFO and to
+// read them back, on the same thread.
+bool FifoWriteReadTest(perftest::RepeatState* state, uint32_t batch_size) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(batch_size * kElemSize);
+
+    zx::fifo fifo1;
+    zx::fifo fifo2;
+    ZX_ASSERT(zx::fifo::create(kFifoElems, kElemSize, 0, &fifo1, &fifo2) == ZX_OK);
+    Elem elems[kFifoElems] = {};
+
+    while (state->KeepRunning()) {
+        size_t actual;
+        ZX_ASSERT(fifo1.write(kElemSize, elems, batch_size, &actual) == ZX_OK);
+        ZX_ASSERT(actual == batch_size);
+        state->NextStep();
+        ZX_ASSERT(fifo2.read(kElemSize, elems, batch_size, &actual) == ZX_OK);
+        ZX_ASSERT(actual == batch_size);
+    }
+    return true;
+}
+
+// Reads and discards everything written to |fifo| until the other end of
+// |fifo| is closed.
+void DrainFifo(const zx::fifo& fifo) {
+    Elem elems[kFifoElems];
+    for (;;) {
+        size_t actual;
+        zx_status_t status = fifo.read(kElemSize, elems, kFifoElems, &actual);
+        if (status == ZX_OK) {
+            continue;
+        }
+        if (status == ZX_ERR_PEER_CLOSED) {
+            return;
+        }
+        ZX_ASSERT(status == ZX_ERR_SHOULD_WAIT);
+        ZX_ASSERT(fifo.wait_one(ZX_FIFO_READABLE | ZX_FIFO_PEER_CLOSED,
+                                zx::time::infinite(), nullptr) == ZX_OK);
+    }
+}
+
+// Measure the throughput of streaming elements through a FIFO to a
+// thread which reads them as fast as it can.
+bool FifoStreamTest(perftest::RepeatState* state, CpuPlacement placement,
+                    uint32_t batch_size) {
+    state->SetBytesProcessedPerRun(batch_size * kElemSize);
+
+    zx::fifo writer;
+    zx::fifo reader;
+    ZX_ASSERT(zx::fifo::create(kFifoElems, kElemSize, 0, &writer, &reader) == ZX_OK);
+    Elem elems[kFifoElems] = {};
+
+    perftest_ipc::PeerThread peer(placement, [&reader] { DrainFifo(reader); });
+
+    while (state->KeepRunning()) {
+        uint32_t written = 0;
+        while (written < batch_size) {
+            size_t actual;
+            zx_status_t status = writer.write(kElemSize, elems,
+                                              batch_size - written, &actual);
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                ZX_ASSERT(writer.wait_one(ZX_FIFO_WRITABLE, zx::time::infinite(),
+                                          nullptr) == ZX_OK);
+                continue;
+            }
+            ZX_ASSERT(status == ZX_OK);
+            written += static_cast<uint32_t>(actual);
+        }
+    }
+
+    // Closing the writer lets the reader return before |peer| joins it.
+    writer.reset();
+    return true;
+}
+
+void RegisterTests() {
+    for (uint32_t batch_size : kBatchSizes) {
+        auto name = fbl::StringPrintf("Fifo/WriteRead/%uelems", batch_size);
+        perftest::RegisterTest(name.c_str(), FifoWriteReadTest, batch_size);
+    }
+    for (uint32_t batch_size : kBatchSizes) {
+        auto name = fbl::StringPrintf("Fifo/Stream/%uelems", batch_size);
+        perftest_ipc::RegisterPlacedTest(name.c_str(), FifoStreamTest, batch_size);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -0,0 +1,80 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+#include "peer-thread.h"
+
+namespace {
+
+using perftest_ipc::CpuPlacement;
+
+// Measure the time taken by zx_futex_wake() when there is no thread
+// waiting on the futex, which is the cost of an uncontended unlock that
+// had to enter the kernel.
+bool FutexWakeNoWaitersTest(perftest::RepeatState* state) {
+    zx_futex_t futex = 0;
+    while (state->KeepRunning()) {
+        ZX_ASSERT(zx_futex_wake(&futex, 1) == ZX_OK);
+    }
+    return true;
+}
+
+// Values of the futex shared by the two threads of FutexPingPongTest.
+enum : int {
+    kPeerTurn = 1,
+    kSelfTurn = 2,
+    kQuit = 3,
+};
+
+int Load(const zx_futex_t* futex) {
+    return __atomic_load_n(futex, __ATOMIC_ACQUIRE);
+}
+
+void StoreAndWake(zx_futex_t* futex, int value) {
+    __atomic_store_n(futex, value, __ATOMIC_RELEASE);
+    ZX_ASSERT(zx_futex_wake(futex, 1) == ZX_OK);
+}
+
+// Waits until |futex| no longer holds |value|, and returns what it holds.
+int WaitWhile(const zx_futex_t* futex, int value) {
+    int current;
+    while ((current = Load(futex)) == value) {
+        zx_status_t status = zx_futex_wait(futex, value, ZX_TIME_INFINITE);
+        ZX_ASSERT(status == ZX_OK || status == ZX_ERR_BAD_STATE);
+    }
+    return current;
+}
+
+// Measure the time taken for a round trip between threads, where each
+// side wakes the other through a futex and then waits on it.  This is
+// the wake latency of a blocked thread, twice.
+bool FutexPingPongTest(perftest::RepeatState* state, CpuPlacement placement) {
+    zx_futex_t futex = kSelfTurn;
+
+    {
+        perftest_ipc::PeerThread peer(placement, [&futex] {
+            while (WaitWhile(&futex, kSelfTurn) != kQuit) {
+                StoreAndWake(&futex, kSelfTurn);
+            }
+        });
+
+        while (state->KeepRunning()) {
+            StoreAndWake(&futex, kPeerTurn);
+            WaitWhile(&futex, kPeerTurn);
+        }
+        StoreAndWake(&futex, kQuit);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("Futex/WakeNoWaiters", FutexWakeNoWaitersTest);
+    perftest_ipc::RegisterPlacedTest("Futex/PingPong", FutexPingPongTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -4,19 +4,20 @@
 
 #include <stdlib.h>
 
+#include <fbl/string_printf.h>
 #include <perftest/perftest.h>
 
 namespace {
 
-// Measure the time taken to malloc() and free() a 100-byte block.
+// Measure the time taken to malloc() and free() a block of |size| bytes.
 //
 // This serves an example of a multi-step perf test.  It is also useful for
 // getting a rough idea of the cost of malloc() and free().
-bool MallocFreeTest(perftest::RepeatState* state) {
+bool MallocFreeTest(perftest::RepeatState* state, size_t size) {
     state->DeclareStep("malloc");
     state->DeclareStep("free");
     while (state->KeepRunning()) {
-        void* block = malloc(100);
+        void* block = malloc(size);
         // Clang can optimize away pairs of malloc() and free() calls;
         // prevent it from doing that.
         perftest::DoNotOptimize(block);
@@ -29,8 +30,39 @@ bool MallocFreeTest(perftest::RepeatState* state) {
     return true;
 }
 
+// Measure the time taken to malloc() and then free() a batch of blocks of
+// |size| bytes, which is more than an allocator keeps cached per thread.
+bool MallocFreeBatchTest(perftest::RepeatState* state, size_t size) {
+    constexpr size_t kBatch = 256;
+    void* blocks[kBatch];
+    state->DeclareStep("malloc");
+    state->DeclareStep("free");
+    while (state->KeepRunning()) {
+        for (size_t i = 0; i < kBatch; i++) {
+            blocks[i] = malloc(size);
+            perftest::DoNotOptimize(blocks[i]);
+            if (!blocks[i]) {
+                return false;
+            }
+        }
+        state->NextStep();
+        for (size_t i = 0; i < kBatch; i++) {
+            free(blocks[i]);
+        }
+    }
+    return true;
+}
+
 void RegisterTests() {
-    perftest::RegisterTest("MallocFree/100bytes", MallocFreeTest);
+    static const size_t kSizes[] = {
+        16, 100, 1024, 16 * 1024, 1024 * 1024,
+    };
+    for (size_t size : kSizes) {
+        auto name = fbl::StringPrintf("MallocFree/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), MallocFreeTest, size);
+        name = fbl::StringPrintf("MallocFreeBatch/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), MallocFreeBatchTest, size);
+    }
 }
 PERFTEST_CTOR(RegisterTests);
 
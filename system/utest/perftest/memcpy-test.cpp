@@ -28,6 +28,71 @@ bool MemcpyTest(perftest::RepeatState* state, size_t size) {
     return true;
 }
 
+// Test performance of memcmp() on two equal blocks of the given size,
+// which it has to compare all of.
+bool MemcmpTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> buf1(new char[size]);
+    fbl::unique_ptr<char[]> buf2(new char[size]);
+    memset(buf1.get(), 0, size);
+    memset(buf2.get(), 0, size);
+
+    while (state->KeepRunning()) {
+        int result = memcmp(buf1.get(), buf2.get(), size);
+        perftest::DoNotOptimize(result);
+    }
+    return true;
+}
+
+// Test performance of memchr() on a block of the given size which does
+// not contain the byte.
+bool MemchrTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> buf(new char[size]);
+    memset(buf.get(), 'a', size);
+
+    while (state->KeepRunning()) {
+        const void* result = memchr(buf.get(), 'b', size);
+        perftest::DoNotOptimize(result);
+    }
+    return true;
+}
+
+// Test performance of strlen() on a string of the given size.
+bool StrlenTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> str(new char[size + 1]);
+    memset(str.get(), 'a', size);
+    str[size] = '\0';
+
+    while (state->KeepRunning()) {
+        size_t result = strlen(str.get());
+        perftest::DoNotOptimize(result);
+    }
+    return true;
+}
+
+// Test performance of strcmp() on two equal strings of the given size.
+bool StrcmpTest(perftest::RepeatState* state, size_t size) {
+    state->SetBytesProcessedPerRun(size);
+
+    fbl::unique_ptr<char[]> str1(new char[size + 1]);
+    fbl::unique_ptr<char[]> str2(new char[size + 1]);
+    memset(str1.get(), 'a', size);
+    memset(str2.get(), 'a', size);
+    str1[size] = '\0';
+    str2[size] = '\0';
+
+    while (state->KeepRunning()) {
+        int result = strcmp(str1.get(), str2.get());
+        perftest::DoNotOptimize(result);
+    }
+    return true;
+}
+
 void RegisterTests() {
     static const size_t kSizesBytes[] = {
         1000,
@@ -36,6 +101,14 @@ void RegisterTests() {
     for (auto size : kSizesBytes) {
         auto name = fbl::StringPrintf("Memcpy/%zubytes", size);
         perftest::RegisterTest(name.c_str(), MemcpyTest, size);
+        name = fbl::StringPrintf("Memcmp/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), MemcmpTest, size);
+        name = fbl::StringPrintf("Memchr/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), MemchrTest, size);
+        name = fbl::StringPrintf("Strlen/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), StrlenTest, size);
+        name = fbl::StringPrintf("Strcmp/%zubytes", size);
+        perftest::RegisterTest(name.c_str(), StrcmpTest, size);
     }
 }
 PERFTEST_CTOR(RegisterTests);
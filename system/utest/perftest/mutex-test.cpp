@@ -4,6 +4,9 @@
 
 #include <threads.h>
 
+#include <fbl/atomic.h>
+#include <lib/sync/mutex.h>
+#include <lib/sync/pi-mutex.h>
 #include <perftest/perftest.h>
 
 namespace {
@@ -24,8 +27,78 @@ bool MutexLockUnlockTest(perftest::RepeatState* state) {
     return true;
 }
 
+// Wrappers which give each kind of mutex the same interface.
+struct SyncMutex {
+    void Lock() { sync_mutex_lock(&mutex); }
+    void Unlock() { sync_mutex_unlock(&mutex); }
+    sync_mutex_t mutex;
+};
+
+struct SyncPiMutex {
+    void Lock() { sync_pi_mutex_lock(&mutex); }
+    void Unlock() { sync_pi_mutex_unlock(&mutex); }
+    sync_pi_mutex_t mutex;
+};
+
+// Measure the times taken to lock and unlock a mutex in the uncontended
+// case.
+template <typename Mutex>
+bool LockUnlockTest(perftest::RepeatState* state) {
+    state->DeclareStep("lock");
+    state->DeclareStep("unlock");
+    Mutex mutex;
+    while (state->KeepRunning()) {
+        mutex.Lock();
+        state->NextStep();
+        mutex.Unlock();
+    }
+    return true;
+}
+
+template <typename Mutex>
+struct ContendedState {
+    Mutex mutex;
+    fbl::atomic<bool> done{false};
+};
+
+// Repeatedly holds the mutex for a short critical section.
+template <typename Mutex>
+int ContendingThread(void* arg) {
+    auto contended = static_cast<ContendedState<Mutex>*>(arg);
+    while (!contended->done.load()) {
+        contended->mutex.Lock();
+        for (volatile int i = 0; i < 100; i++) {
+        }
+        contended->mutex.Unlock();
+    }
+    return 0;
+}
+
+// Measure the time taken to lock and unlock a mutex which another thread
+// keeps locking for short critical sections. This is where spinning before
+// waiting on the futex makes a difference.
+template <typename Mutex>
+bool ContendedLockUnlockTest(perftest::RepeatState* state) {
+    ContendedState<Mutex> contended;
+    thrd_t thread;
+    ZX_ASSERT(thrd_create(&thread, ContendingThread<Mutex>, &contended) == thrd_success);
+    while (state->KeepRunning()) {
+        contended.mutex.Lock();
+        contended.mutex.Unlock();
+    }
+    contended.done.store(true);
+    ZX_ASSERT(thrd_join(thread, nullptr) == thrd_success);
+    return true;
+}
+
 void RegisterTests() {
     perftest::RegisterTest("MutexLockUnlock", MutexLockUnlockTest);
+    perftest::RegisterTest("SyncMutexLockUnlock", LockUnlockTest<SyncMutex>);
+    perftest::RegisterTest("SyncPiMutexLockUnlock", LockUnlockTest<SyncPiMutex>);
+    perftest::RegisterTest("SyncMutexContendedLockUnlock",
+                           ContendedLockUnlockTest<SyncMutex>);
+    perftest::RegisterTest("SyncPiMutexContendedLockUnlock",
+                           ContendedLockUnlockTest<SyncPiMutex>);
 }
 PERFTEST_CTOR(RegisterTests);
 
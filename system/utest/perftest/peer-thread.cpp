@@ -0,0 +1,89 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "peer-thread.h"
+
+#include <zircon/assert.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+namespace perftest_ipc {
+namespace {
+
+void SetCpuMask(zx_handle_t thread, uint32_t cpu_mask) {
+    ZX_ASSERT(perftest::SetThreadCpuMask(thread, cpu_mask) == ZX_OK);
+}
+
+uint32_t AllCpusMask() {
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    return (num_cpus >= 32) ? ~0u : (1u << num_cpus) - 1;
+}
+
+// The CPUs of the calling thread and of the peer thread.
+uint32_t SelfCpuMask(CpuPlacement placement) {
+    return (placement == CpuPlacement::kAny) ? 0u : 1u << 0;
+}
+
+uint32_t PeerCpuMask(CpuPlacement placement) {
+    switch (placement) {
+    case CpuPlacement::kSameCpu:
+        return 1u << 0;
+    case CpuPlacement::kCrossCpu:
+        return 1u << 1;
+    default:
+        return 0u;
+    }
+}
+
+}  // namespace
+
+bool CanPlaceThreads(CpuPlacement placement) {
+    switch (placement) {
+    case CpuPlacement::kAny:
+        return true;
+    case CpuPlacement::kSameCpu:
+        return perftest::CanSetCpuAffinity();
+    case CpuPlacement::kCrossCpu:
+        return perftest::CanSetCpuAffinity() && zx_system_get_num_cpus() >= 2;
+    }
+    return false;
+}
+
+const char* PlacementSuffix(CpuPlacement placement) {
+    switch (placement) {
+    case CpuPlacement::kAny:
+        return "";
+    case CpuPlacement::kSameCpu:
+        return "/SameCpu";
+    case CpuPlacement::kCrossCpu:
+        return "/CrossCpu";
+    }
+    return "";
+}
+
+PeerThread::PeerThread(CpuPlacement placement, fbl::Function<void()> fn)
+    : placement_(placement), fn_(fbl::move(fn)) {
+    if (uint32_t mask = SelfCpuMask(placement_)) {
+        SetCpuMask(zx_thread_self(), mask);
+    }
+    ZX_ASSERT(thrd_create(&thread_, Run, this) == thrd_success);
+}
+
+PeerThread::~PeerThread() {
+    ZX_ASSERT(thrd_join(thread_, nullptr) == thrd_success);
+    if (SelfCpuMask(placement_)) {
+        SetCpuMask(zx_thread_self(), AllCpusMask());
+    }
+}
+
+int PeerThread::Run(void* arg) {
+    auto peer = static_cast<PeerThread*>(arg);
+    if (uint32_t mask = PeerCpuMask(peer->placement_)) {
+        SetCpuMask(zx_thread_self(), mask);
+    }
+    peer->fn_();
+    return 0;
+}
+
+}  // namespace perftest_ipc
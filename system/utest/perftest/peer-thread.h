@@ -0,0 +1,66 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <threads.h>
+
+#include <fbl/function.h>
+#include <fbl/macros.h>
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+
+namespace perftest_ipc {
+
+// Where the two threads of a cross-thread IPC test run.
+enum class CpuPlacement {
+    kAny,       // Wherever the scheduler puts them.
+    kSameCpu,   // Both pinned to one CPU.
+    kCrossCpu,  // Pinned to two different CPUs.
+};
+
+constexpr CpuPlacement kAllPlacements[] = {
+    CpuPlacement::kAny, CpuPlacement::kSameCpu, CpuPlacement::kCrossCpu,
+};
+
+// Returns whether threads can be placed as |placement| asks.  The pinned
+// placements need perftest::CanSetCpuAffinity().
+bool CanPlaceThreads(CpuPlacement placement);
+
+// Returns the suffix naming |placement| in a test name.
+const char* PlacementSuffix(CpuPlacement placement);
+
+// Runs |fn| on a new thread, which is joined when the PeerThread is
+// destroyed, so |fn| must return once the test is done with it (typically
+// on seeing its end of the test's channel or socket closed).  Until then,
+// the calling thread and the new thread are pinned as |placement| asks.
+class PeerThread {
+public:
+    PeerThread(CpuPlacement placement, fbl::Function<void()> fn);
+    ~PeerThread();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PeerThread);
+
+private:
+    static int Run(void* arg);
+
+    const CpuPlacement placement_;
+    fbl::Function<void()> fn_;
+    thrd_t thread_;
+};
+
+// Registers |test_func| for each placement this system supports, with the
+// placement passed as the first argument after the RepeatState.
+template <typename Func, typename... Args>
+void RegisterPlacedTest(const char* name, Func test_func, Args... args) {
+    for (CpuPlacement placement : kAllPlacements) {
+        if (CanPlaceThreads(placement)) {
+            fbl::String full_name = fbl::StringPrintf("%s%s", name,
+                                                      PlacementSuffix(placement));
+            perftest::RegisterTest(full_name.c_str(), test_func, placement, args...);
+        }
+    }
+}
+
+}  // namespace perftest_ipc
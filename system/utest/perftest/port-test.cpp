@@ -0,0 +1,93 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <lib/zx/port.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls/port.h>
+
+#include "peer-thread.h"
+
+namespace {
+
+using perftest_ipc::CpuPlacement;
+
+constexpr uint32_t kBatchSizes[] = {1, 16, 256};
+
+// Packet key which tells the peer thread of a round trip test to return.
+constexpr uint64_t kQuitKey = 1;
+
+zx_port_packet_t UserPacket(uint64_t key) {
+    zx_port_packet_t packet = {};
+    packet.key = key;
+    packet.type = ZX_PKT_TYPE_USER;
+    return packet;
+}
+
+// Measure the times taken to queue |batch_size| user packets on a port
+// and then to dequeue them all, on the same thread.
+bool PortQueueWaitTest(perftest::RepeatState* state, uint32_t batch_size) {
+    state->DeclareStep("queue");
+    state->DeclareStep("wait");
+
+    zx::port port;
+    ZX_ASSERT(zx::port::create(0, &port) == ZX_OK);
+    zx_port_packet_t packet = UserPacket(0);
+
+    while (state->KeepRunning()) {
+        for (uint32_t i = 0; i < batch_size; i++) {
+            ZX_ASSERT(port.queue(&packet) == ZX_OK);
+        }
+        state->NextStep();
+        for (uint32_t i = 0; i < batch_size; i++) {
+            ZX_ASSERT(port.wait(zx::time::infinite(), &packet) == ZX_OK);
+        }
+    }
+    return true;
+}
+
+// Measure the time taken for a round trip between threads, where each
+// side queues a user packet on the other side's port and then waits on
+// its own.
+bool PortPingPongTest(perftest::RepeatState* state, CpuPlacement placement) {
+    zx::port ping;
+    zx::port pong;
+    ZX_ASSERT(zx::port::create(0, &ping) == ZX_OK);
+    ZX_ASSERT(zx::port::create(0, &pong) == ZX_OK);
+
+    {
+        perftest_ipc::PeerThread peer(placement, [&ping, &pong] {
+            zx_port_packet_t packet;
+            for (;;) {
+                ZX_ASSERT(ping.wait(zx::time::infinite(), &packet) == ZX_OK);
+                if (packet.key == kQuitKey) {
+                    return;
+                }
+                ZX_ASSERT(pong.queue(&packet) == ZX_OK);
+            }
+        });
+
+        zx_port_packet_t packet = UserPacket(0);
+        while (state->KeepRunning()) {
+            ZX_ASSERT(ping.queue(&packet) == ZX_OK);
+            ZX_ASSERT(pong.wait(zx::time::infinite(), &packet) == ZX_OK);
+        }
+
+        zx_port_packet_t quit = UserPacket(kQuitKey);
+        ZX_ASSERT(ping.queue(&quit) == ZX_OK);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    for (uint32_t batch_size : kBatchSizes) {
+        auto name = fbl::StringPrintf("Port/QueueWait/%upackets", batch_size);
+        perftest::RegisterTest(name.c_str(), PortQueueWaitTest, batch_size);
+    }
+    perftest_ipc::RegisterPlacedTest("Port/PingPong", PortPingPongTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
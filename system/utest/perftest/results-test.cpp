@@ -70,6 +70,35 @@ static bool TestSummaryStatistics() {
     END_TEST;
 }
 
+static bool TestPercentiles() {
+    BEGIN_TEST;
+
+    perftest::ResultsSet results;
+    perftest::TestCaseResults* test_case =
+        results.AddTestCase("results_test", "ExampleNullSyscall", "nanoseconds");
+    // Fill out the values 1000 down to 0, so that each percentile falls
+    // on a value.
+    for (int val = 1000; val >= 0; --val) {
+        test_case->AppendValue(val);
+    }
+
+    perftest::SummaryStatistics stats = test_case->GetSummaryStatistics();
+    EXPECT_EQ(stats.median, 500);
+    EXPECT_EQ(stats.p90, 900);
+    EXPECT_EQ(stats.p99, 990);
+
+    // With two values, the percentiles are interpolated between them.
+    perftest::TestCaseResults* pair =
+        results.AddTestCase("results_test", "ExamplePair", "nanoseconds");
+    pair->AppendValue(100);
+    pair->AppendValue(200);
+    stats = pair->GetSummaryStatistics();
+    EXPECT_EQ(stats.p90, 190);
+    EXPECT_EQ(stats.p99, 199);
+
+    END_TEST;
+}
+
 // Test escaping special characters in strings in JSON output.
 static bool TestJsonStringEscaping() {
     BEGIN_TEST;
@@ -89,5 +118,6 @@ static bool TestJsonStringEscaping() {
 BEGIN_TEST_CASE(perf_results_output_tests)
 RUN_TEST(TestJsonOutput)
 RUN_TEST(TestSummaryStatistics)
+RUN_TEST(TestPercentiles)
 RUN_TEST(TestJsonStringEscaping)
 END_TEST_CASE(perf_results_output_tests)
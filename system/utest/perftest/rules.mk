@@ -9,16 +9,22 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := usertest
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/channel-test.cpp \
     $(LOCAL_DIR)/clock-test.cpp \
+    $(LOCAL_DIR)/fifo-test.cpp \
+    $(LOCAL_DIR)/futex-test.cpp \
     $(LOCAL_DIR)/handle-creation-test.cpp \
     $(LOCAL_DIR)/malloc-test.cpp \
     $(LOCAL_DIR)/memcpy-test.cpp \
     $(LOCAL_DIR)/mutex-test.cpp \
     $(LOCAL_DIR)/null-test.cpp \
+    $(LOCAL_DIR)/peer-thread.cpp \
+    $(LOCAL_DIR)/port-test.cpp \
     $(LOCAL_DIR)/process-test.cpp \
     $(LOCAL_DIR)/results-test.cpp \
     $(LOCAL_DIR)/runner-test.cpp \
     $(LOCAL_DIR)/sleep-test.cpp \
+    $(LOCAL_DIR)/socket-test.cpp \
     $(LOCAL_DIR)/syscalls-test.cpp \
 
 MODULE_NAME := perf-test
@@ -30,6 +36,7 @@ MODULE_STATIC_LIBS := \
     system/ulib/async.cpp \
     system/ulib/fbl \
     system/ulib/perftest \
+    system/ulib/sync \
     system/ulib/trace \
     system/ulib/trace-provider \
     system/ulib/zx \
@@ -44,4 +51,7 @@ MODULE_LIBS := \
     system/ulib/unittest \
     system/ulib/zircon \
 
+MODULE_FIDL_LIBS := \
+    system/fidl/fuchsia-sysinfo \
+
 include make/module.mk
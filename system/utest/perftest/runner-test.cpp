@@ -172,6 +172,70 @@ static bool TestMultistepTest() {
     END_TEST;
 }
 
+static bool MultiThreadMultistepTest(perftest::RepeatState* state,
+                                     uint32_t thread_index) {
+    return MultistepTest(state);
+}
+
+// Test that a multi-threaded test combines the times from all of its
+// threads, for each step.
+static bool TestMultiThreadTest() {
+    BEGIN_TEST;
+
+    const uint32_t kThreadCount = 3;
+    perftest::MultiThreadOptions options;
+    options.thread_count = kThreadCount;
+    perftest::internal::TestList test_list;
+    perftest::internal::NamedTest test{"example_test", options,
+                                       MultiThreadMultistepTest};
+    test_list.push_back(fbl::move(test));
+
+    const uint32_t kRunCount = 7;
+    perftest::ResultsSet results;
+    DummyOutputStream out;
+    EXPECT_TRUE(perftest::internal::RunTests(
+                    "test-suite", &test_list, kRunCount, "", out.fp(),
+                    &results));
+    ASSERT_EQ(results.results()->size(), 3);
+    EXPECT_STR_EQ((*results.results())[0].label.c_str(), "example_test.step1");
+    for (auto& test_case : *results.results()) {
+        EXPECT_EQ(test_case.values.size(), kRunCount * kThreadCount);
+        EXPECT_TRUE(check_times(&test_case));
+    }
+
+    END_TEST;
+}
+
+// Example of a multi-threaded test in which one thread fails before
+// starting its runs.
+static bool FailingThreadTest(perftest::RepeatState* state,
+                              uint32_t thread_index) {
+    if (thread_index == 1) {
+        return false;
+    }
+    while (state->KeepRunning()) {}
+    return true;
+}
+
+// Test that a multi-threaded test fails if any one of its threads fails,
+// and that the other threads are not left waiting for the failed one.
+static bool TestMultiThreadFailingThread() {
+    BEGIN_TEST;
+
+    perftest::MultiThreadOptions options;
+    options.thread_count = 3;
+
+    perftest::ResultsSet results;
+    fbl::String error;
+    EXPECT_FALSE(perftest::RunMultiThreadTest(
+                     "test-suite", "example_test", options, FailingThreadTest, 5,
+                     &results, &error));
+    EXPECT_STR_EQ(error.c_str(), "Thread 1: Too few calls to KeepRunning()");
+    EXPECT_EQ(results.results()->size(), 0);
+
+    END_TEST;
+}
+
 // Test that we report a test as failed if it calls NextStep() before
 // KeepRunning(), which is invalid.
 static bool TestNextStepCalledBeforeKeepRunning() {
@@ -326,6 +390,8 @@ RUN_TEST(TestResults)
 RUN_TEST(TestFailingTest)
 RUN_TEST(TestBadKeepRunningCalls)
 RUN_TEST(TestMultistepTest)
+RUN_TEST(TestMultiThreadTest)
+RUN_TEST(TestMultiThreadFailingThread)
 RUN_TEST(TestNextStepCalledBeforeKeepRunning)
 RUN_TEST(TestBadNextStepCalls)
 RUN_TEST(TestBytesProcessedParameter)
@@ -0,0 +1,108 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/socket.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+
+#include "peer-thread.h"
+
+namespace {
+
+using perftest_ipc::CpuPlacement;
+
+constexpr uint32_t kWriteSizes[] = {64, 1024, 32 * 1024, 64 * 1024};
+
+// Measure the times taken to write a block of data to a stream socket
+// and to read it back, on the same thread.
+bool SocketWriteReadTest(perftest::RepeatState* state, uint32_t write_size) {
+    state->DeclareStep("write");
+    state->DeclareStep("read");
+    state->SetBytesProcessedPerRun(write_size);
+
+    zx::socket socket1;
+    zx::socket socket2;
+    ZX_ASSERT(zx::socket::create(0, &socket1, &socket2) == ZX_OK);
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[write_size]());
+
+    while (state->KeepRunning()) {
+        size_t actual;
+        ZX_ASSERT(socket1.write(0, buffer.get(), write_size, &actual) == ZX_OK);
+        ZX_ASSERT(actual == write_size);
+        state->NextStep();
+        ZX_ASSERT(socket2.read(0, buffer.get(), write_size, &actual) == ZX_OK);
+        ZX_ASSERT(actual == write_size);
+    }
+    return true;
+}
+
+// Reads and discards everything written to |socket| until the other end
+// of |socket| is closed.
+void DrainSocket(const zx::socket& socket) {
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[64 * 1024]);
+    for (;;) {
+        size_t actual;
+        zx_status_t status = socket.read(0, buffer.get(), 64 * 1024, &actual);
+        if (status == ZX_OK) {
+            continue;
+        }
+        if (status == ZX_ERR_PEER_CLOSED) {
+            return;
+        }
+        ZX_ASSERT(status == ZX_ERR_SHOULD_WAIT);
+        ZX_ASSERT(socket.wait_one(ZX_SOCKET_READABLE | ZX_SOCKET_PEER_CLOSED,
+                                  zx::time::infinite(), nullptr) == ZX_OK);
+    }
+}
+
+// Measure the throughput of streaming data through a socket to a thread
+// which reads it as fast as it can.  Writes block when the socket's
+// buffer is full, so this is bounded by the slower of the two sides.
+bool SocketStreamTest(perftest::RepeatState* state, CpuPlacement placement,
+                      uint32_t write_size) {
+    state->SetBytesProcessedPerRun(write_size);
+
+    zx::socket writer;
+    zx::socket reader;
+    ZX_ASSERT(zx::socket::create(0, &writer, &reader) == ZX_OK);
+    fbl::unique_ptr<uint8_t[]> buffer(new uint8_t[write_size]());
+
+    perftest_ipc::PeerThread peer(placement, [&reader] { DrainSocket(reader); });
+
+    while (state->KeepRunning()) {
+        size_t offset = 0;
+        while (offset < write_size) {
+            size_t actual;
+            zx_status_t status = writer.write(0, buffer.get() + offset,
+                                              write_size - offset, &actual);
+            if (status == ZX_ERR_SHOULD_WAIT) {
+                ZX_ASSERT(writer.wait_one(ZX_SOCKET_WRITABLE, zx::time::infinite(),
+                                          nullptr) == ZX_OK);
+                continue;
+            }
+            ZX_ASSERT(status == ZX_OK);
+            offset += actual;
+        }
+    }
+
+    // Closing the writer lets the reader return before |peer| joins it.
+    writer.reset();
+    return true;
+}
+
+void RegisterTests() {
+    for (uint32_t write_size : kWriteSizes) {
+        auto name = fbl::StringPrintf("Socket/WriteRead/%ubytes", write_size);
+        perftest::RegisterTest(name.c_str(), SocketWriteReadTest, write_size);
+    }
+    for (uint32_t write_size : kWriteSizes) {
+        auto name = fbl::StringPrintf("Socket/Stream/%ubytes", write_size);
+        perftest_ipc::RegisterPlacedTest(name.c_str(), SocketStreamTest, write_size);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
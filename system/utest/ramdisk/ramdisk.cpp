@@ -576,6 +576,62 @@ bool RamdiskTestFifoBasic(void) {
     END_TEST;
 }
 
+bool RamdiskTestFifoPolling(void) {
+    BEGIN_TEST;
+    fbl::unique_ptr<RamdiskTest> ramdisk;
+    ASSERT_TRUE(RamdiskTest::Create(PAGE_SIZE, 512, &ramdisk));
+
+    zx::fifo fifo;
+    ssize_t expected = sizeof(fifo);
+    ASSERT_EQ(ioctl_block_get_fifos(ramdisk->fd(), fifo.reset_and_get_address()),
+              expected, "Failed to get FIFO");
+
+    zx::vmo vmo;
+    ASSERT_EQ(zx::vmo::create(PAGE_SIZE, 0, &vmo), ZX_OK, "Failed to create VMO");
+    uint8_t buf[PAGE_SIZE];
+    fill_random(buf, sizeof(buf));
+    ASSERT_EQ(vmo.write(buf, 0, sizeof(buf)), ZX_OK);
+
+    vmoid_t vmoid;
+    expected = sizeof(vmoid_t);
+    zx_handle_t xfer_vmo;
+    ASSERT_EQ(zx_handle_duplicate(vmo.get(), ZX_RIGHT_SAME_RIGHTS, &xfer_vmo), ZX_OK);
+    ASSERT_EQ(ioctl_block_attach_vmo(ramdisk->fd(), &xfer_vmo, &vmoid), expected,
+              "Failed to attach vmo");
+
+    block_client::Client client;
+    ASSERT_EQ(block_client::Client::Create(fbl::move(fifo), &client), ZX_OK);
+    client.SetPolling(zx::usec(50));
+
+    // Transactions behave the same whether or not their responses are
+    // spun for.
+    block_fifo_request_t request;
+    request.group      = 0;
+    request.vmoid      = vmoid;
+    request.length     = 1;
+    request.vmo_offset = 0;
+    uint8_t out[PAGE_SIZE];
+    for (uint64_t i = 0; i < 100; i++) {
+        request.dev_offset = i;
+        request.opcode = BLOCKIO_WRITE;
+        ASSERT_EQ(client.Transaction(&request, 1), ZX_OK);
+    }
+    for (uint64_t i = 0; i < 100; i++) {
+        ASSERT_EQ(vmo.write(out, 0, sizeof(out)), ZX_OK);
+        request.dev_offset = i;
+        request.opcode = BLOCKIO_READ;
+        ASSERT_EQ(client.Transaction(&request, 1), ZX_OK);
+        ASSERT_EQ(vmo.read(out, 0, sizeof(out)), ZX_OK);
+        ASSERT_EQ(memcmp(buf, out, sizeof(out)), 0, "Read data not equal to written data");
+    }
+
+    client.SetPolling(zx::duration(0));
+    request.opcode = BLOCKIO_CLOSE_VMO;
+    ASSERT_EQ(client.Transaction(&request, 1), ZX_OK);
+
+    END_TEST;
+}
+
 bool RamdiskTestFifoNoGroup(void) {
     BEGIN_TEST;
     // Set up the initial handshake connection with the ramdisk
@@ -1590,6 +1646,7 @@ RUN_TEST_SMALL(RamdiskTestReleaseDuringFifoAccess)
 RUN_TEST_SMALL(RamdiskTestMultiple)
 RUN_TEST_SMALL(RamdiskTestFifoNoOp)
 RUN_TEST_SMALL(RamdiskTestFifoBasic)
+RUN_TEST_SMALL(RamdiskTestFifoPolling)
 RUN_TEST_SMALL(RamdiskTestFifoNoGroup)
 RUN_TEST_SMALL(RamdiskTestFifoMultipleVmo)
 RUN_TEST_SMALL(RamdiskTestFifoMultipleVmoMultithreaded)
@@ -158,6 +158,42 @@ static bool ralloc_by_size_test() {
     END_TEST;
 }
 
+static bool ralloc_by_size_near_miss_test() {
+    BEGIN_TEST;
+
+    RegionAllocator alloc(RegionAllocator::RegionPool::Create(REGION_POOL_MAX_SIZE));
+
+    // Add a long run of regions which are large enough for a 4KB allocation,
+    // but which are misaligned such that none of them can hold a page aligned
+    // one, followed by a misaligned region which is just large enough to.
+    constexpr uint64_t kNearMissCount = 64;
+    for (uint64_t i = 0; i < kNearMissCount; ++i) {
+        ASSERT_EQ(ZX_OK, alloc.AddRegion({ .base = (i << 20) + 0x800, .size = 0x1100 }));
+    }
+    const ralloc_region_t fit = { .base = 0x10000800, .size = 0x2000 };
+    ASSERT_EQ(ZX_OK, alloc.AddRegion(fit));
+    ASSERT_EQ(ZX_OK, alloc.AddRegion({ .base = 0x20000000, .size = 0x100000 }));
+
+    // The allocation should skip the near misses, but still come from the
+    // smallest region which can hold it.
+    RegionAllocator::Region::UPtr region;
+    ASSERT_EQ(ZX_OK, alloc.GetRegion(0x1000, 0x1000, region));
+    ASSERT_NONNULL(region);
+    EXPECT_TRUE(region_contains_region(&fit, region.get()));
+    EXPECT_EQ(0x10001000u, region->base);
+
+    // Splitting and releasing the region churns through bookkeeping.  Once
+    // everything has been returned, the allocator must be able to switch
+    // pools.
+    region.reset();
+    alloc.Reset();
+    EXPECT_EQ(0u, alloc.AvailableRegionCount());
+    EXPECT_EQ(ZX_OK, alloc.SetRegionPool(
+            RegionAllocator::RegionPool::Create(REGION_POOL_MAX_SIZE)));
+
+    END_TEST;
+}
+
 static bool ralloc_specific_test() {
     BEGIN_TEST;
 
@@ -299,6 +335,7 @@ static bool ralloc_alloc_walk_test() {
 BEGIN_TEST_CASE(ralloc_tests)
 RUN_NAMED_TEST("Region Pools",   ralloc_region_pools_test)
 RUN_NAMED_TEST("Alloc by size",  ralloc_by_size_test)
+RUN_NAMED_TEST("Alloc by size (near misses)", ralloc_by_size_near_miss_test)
 RUN_NAMED_TEST("Alloc specific", ralloc_specific_test)
 RUN_NAMED_TEST("Add/Overlap",    ralloc_add_overlap_test)
 RUN_NAMED_TEST("Subtract",       ralloc_subtract_test)
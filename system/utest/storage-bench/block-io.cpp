@@ -0,0 +1,224 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <block-client/client.h>
+#include <crypto/secret.h>
+#include <fbl/string_printf.h>
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <lib/zx/time.h>
+#include <lib/zx/vmo.h>
+#include <perftest/perftest.h>
+#include <unittest/unittest.h>
+#include <zircon/device/block.h>
+#include <zxcrypt/volume.h>
+
+#include "storage-bench.h"
+
+namespace storage_bench {
+namespace {
+
+using fs_test_utils::Fixture;
+using fs_test_utils::FixtureOptions;
+using fs_test_utils::TestCaseInfo;
+using fs_test_utils::TestInfo;
+
+// The block FIFO holds 128 requests, and each transaction needs room for all of its requests.
+constexpr uint32_t kQueueDepths[] = {1, 8, 32};
+constexpr uint32_t kMaxQueueDepth = 32;
+constexpr uint32_t kTransferSizes[] = {4 * 1024, 64 * 1024};
+
+// The stacks of block devices that the tests run on.
+enum class Layering {
+    kNone,
+    kFvm,
+    kFvmZxcrypt,
+};
+
+constexpr Layering kLayerings[] = {Layering::kNone, Layering::kFvm, Layering::kFvmZxcrypt};
+
+const char* GetNameForLayering(Layering layering) {
+    switch (layering) {
+    case Layering::kNone:
+        return "Raw";
+    case Layering::kFvm:
+        return "Fvm";
+    case Layering::kFvmZxcrypt:
+        return "FvmZxcrypt";
+    }
+    return "";
+}
+
+struct BlockIoParams {
+    bool write;
+    bool random;
+    uint32_t queue_depth;
+    uint32_t transfer_size;
+    bool zxcrypt;
+};
+
+// A block device with a VMO attached and a FIFO client for issuing transactions on it.
+class BlockDevice {
+public:
+    BlockDevice() = default;
+    BlockDevice(const BlockDevice&) = delete;
+    BlockDevice(BlockDevice&&) = delete;
+    BlockDevice& operator=(const BlockDevice&) = delete;
+    BlockDevice& operator=(BlockDevice&&) = delete;
+    ~BlockDevice() {
+        if (client_ != nullptr) {
+            block_fifo_request_t request = {};
+            request.vmoid = vmoid_;
+            request.opcode = BLOCKIO_CLOSE_VMO;
+            block_fifo_txn(client_, &request, 1);
+            block_fifo_release_client(client_);
+        }
+    }
+
+    bool Open(fbl::unique_fd fd, size_t buffer_size) {
+        BEGIN_HELPER;
+        fd_ = fbl::move(fd);
+        ASSERT_EQ(ioctl_block_get_info(fd_.get(), &info_), sizeof(info_));
+
+        zx_handle_t fifo;
+        ASSERT_EQ(ioctl_block_get_fifos(fd_.get(), &fifo), sizeof(fifo));
+        ASSERT_EQ(block_fifo_create_client(fifo, &client_), ZX_OK);
+
+        ASSERT_EQ(zx::vmo::create(buffer_size, 0, &vmo_), ZX_OK);
+        zx::vmo dup;
+        ASSERT_EQ(vmo_.duplicate(ZX_RIGHT_SAME_RIGHTS, &dup), ZX_OK);
+        zx_handle_t raw_dup = dup.release();
+        ASSERT_EQ(ioctl_block_attach_vmo(fd_.get(), &raw_dup, &vmoid_), sizeof(vmoid_));
+        END_HELPER;
+    }
+
+    const block_info_t& info() const { return info_; }
+    fifo_client_t* client() const { return client_; }
+    vmoid_t vmoid() const { return vmoid_; }
+
+private:
+    fbl::unique_fd fd_;
+    block_info_t info_ = {};
+    fifo_client_t* client_ = nullptr;
+    zx::vmo vmo_;
+    vmoid_t vmoid_ = 0;
+};
+
+// Opens the device the test runs on: the fixture's block device, or a new zxcrypt volume on
+// top of it. |volume| keeps the zxcrypt volume open for as long as the test uses it.
+bool OpenTestDevice(Fixture* fixture, bool zxcrypt, fbl::unique_fd* out,
+                    fbl::unique_ptr<zxcrypt::Volume>* volume) {
+    BEGIN_HELPER;
+    const char* path = fixture->GetFsBlockDevice().c_str();
+    fbl::unique_fd fd(open(path, O_RDWR));
+    ASSERT_TRUE(fd, path);
+    if (!zxcrypt) {
+        *out = fbl::move(fd);
+        return true;
+    }
+
+    crypto::Secret key;
+    ASSERT_EQ(key.Generate(zxcrypt::kZx1130KeyLen), ZX_OK);
+    ASSERT_EQ(zxcrypt::Volume::Create(fbl::move(fd), key), ZX_OK);
+    fd.reset(open(path, O_RDWR));
+    ASSERT_TRUE(fd, path);
+    ASSERT_EQ(zxcrypt::Volume::Unlock(fbl::move(fd), key, 0, volume), ZX_OK);
+    ASSERT_EQ((*volume)->Open(zx::sec(3), out), ZX_OK);
+    END_HELPER;
+}
+
+// Measure the throughput of reading or writing the block device, with |queue_depth| transfers
+// of |transfer_size| bytes sent together in each transaction.
+bool BlockIoTest(const BlockIoParams& params, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd;
+    fbl::unique_ptr<zxcrypt::Volume> volume;
+    ASSERT_TRUE(OpenTestDevice(fixture, params.zxcrypt, &fd, &volume));
+    BlockDevice device;
+    ASSERT_TRUE(device.Open(fbl::move(fd), params.queue_depth * params.transfer_size));
+
+    const block_info_t& info = device.info();
+    ASSERT_EQ(params.transfer_size % info.block_size, 0);
+    uint32_t blocks_per_transfer = params.transfer_size / info.block_size;
+    // Number of transfer-sized ranges on the device, which the transfers are spread over.
+    uint64_t transfer_count = info.block_count / blocks_per_transfer;
+    ASSERT_GE(transfer_count, params.queue_depth);
+
+    state->SetBytesProcessedPerRun(params.queue_depth * params.transfer_size);
+    block_fifo_request_t requests[kMaxQueueDepth];
+    uint64_t next_transfer = 0;
+    while (state->KeepRunning()) {
+        for (uint32_t i = 0; i < params.queue_depth; ++i) {
+            uint64_t transfer;
+            if (params.random) {
+                transfer = static_cast<uint64_t>(rand_r(fixture->mutable_seed())) %
+                           transfer_count;
+            } else {
+                transfer = next_transfer;
+                next_transfer = (next_transfer + 1) % transfer_count;
+            }
+            // block_fifo_txn() adds flags to the requests, so fill them in afresh each time.
+            requests[i] = {};
+            requests[i].opcode = params.write ? BLOCKIO_WRITE : BLOCKIO_READ;
+            requests[i].vmoid = device.vmoid();
+            requests[i].length = blocks_per_transfer;
+            requests[i].vmo_offset = i * blocks_per_transfer;
+            requests[i].dev_offset = transfer * blocks_per_transfer;
+        }
+        ASSERT_EQ(block_fifo_txn(device.client(), requests, params.queue_depth), ZX_OK);
+    }
+    END_HELPER;
+}
+
+} // namespace
+
+void AddBlockIoTestCases(const FixtureOptions& base_options, bool is_unittest,
+                         fbl::Vector<TestCaseInfo>* test_cases) {
+    for (Layering layering : kLayerings) {
+        TestCaseInfo testcase;
+        testcase.name = fbl::StringPrintf("Block/%s", GetNameForLayering(layering));
+        // Each test gets a fresh FVM, so that zxcrypt volumes do not outlive their test.
+        testcase.teardown = true;
+        testcase.fixture_options.reset(new FixtureOptions(base_options));
+        testcase.fixture_options->use_fvm = (layering != Layering::kNone);
+        testcase.fixture_options->fs_format = false;
+        testcase.fixture_options->fs_mount = false;
+
+        for (uint32_t transfer_size : kTransferSizes) {
+            for (uint32_t queue_depth : kQueueDepths) {
+                for (bool write : {false, true}) {
+                    for (bool random : {false, true}) {
+                        BlockIoParams params = {
+                            .write = write,
+                            .random = random,
+                            .queue_depth = queue_depth,
+                            .transfer_size = transfer_size,
+                            .zxcrypt = (layering == Layering::kFvmZxcrypt),
+                        };
+                        TestInfo test;
+                        test.name = fbl::StringPrintf(
+                            "%s/%s%s/%uKbytes/QueueDepth%u", testcase.name.c_str(),
+                            random ? "Random" : "Sequential", write ? "Write" : "Read",
+                            transfer_size / 1024, queue_depth);
+                        test.test_fn = [params](perftest::RepeatState* state, Fixture* fixture) {
+                            return BlockIoTest(params, state, fixture);
+                        };
+                        testcase.tests.push_back(fbl::move(test));
+                    }
+                }
+            }
+            // One transfer size is enough to check the workflow in unittest mode.
+            if (is_unittest) {
+                break;
+            }
+        }
+        test_cases->push_back(fbl::move(testcase));
+    }
+}
+
+} // namespace storage_bench
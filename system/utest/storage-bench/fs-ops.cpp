@@ -0,0 +1,370 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <digest/digest.h>
+#include <digest/merkle-tree.h>
+#include <fbl/function.h>
+#include <fbl/string.h>
+#include <fbl/string_buffer.h>
+#include <fbl/string_printf.h>
+#include <fbl/unique_fd.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <fs-management/mount.h>
+#include <perftest/perftest.h>
+#include <unittest/unittest.h>
+
+#include "storage-bench.h"
+
+namespace storage_bench {
+namespace {
+
+using digest::Digest;
+using digest::MerkleTree;
+using fs_test_utils::Fixture;
+using fs_test_utils::FixtureOptions;
+using fs_test_utils::TestCaseInfo;
+using fs_test_utils::TestInfo;
+
+using PathBuffer = fbl::StringBuffer<fs_test_utils::kPathSize>;
+using TestFn = fbl::Function<bool(perftest::RepeatState*, Fixture*)>;
+
+constexpr size_t kFsyncWriteSize = 8 * 1024;
+constexpr size_t kLargeWriteSize = 1024 * 1024;
+// Large writes wrap around to the start of the file at this size, so that the file's size
+// does not depend on the number of runs.
+constexpr size_t kLargeFileSize = 64 * 1024 * 1024;
+constexpr size_t kSmallBlobSize = 8 * 1024;
+
+// Returns the directory the test works in, creating it if needed. memfs has nothing mounted
+// at the fixture's path, so its tests create that path within memfs itself.
+bool MakeTestDir(Fixture* fixture, const char* name, fbl::String* out) {
+    BEGIN_HELPER;
+    if (mkdir(fixture->fs_path().c_str(), 0755) != 0) {
+        ASSERT_EQ(errno, EEXIST, strerror(errno));
+    }
+    *out = fbl::StringPrintf("%s/%s", fixture->fs_path().c_str(), name);
+    ASSERT_EQ(mkdir(out->c_str(), 0755), 0, strerror(errno));
+    END_HELPER;
+}
+
+void GetFilePath(const fbl::String& dir, uint32_t index, PathBuffer* path) {
+    path->Clear();
+    path->AppendPrintf("%s/%u", dir.c_str(), index);
+}
+
+bool CreateFiles(const fbl::String& dir, uint32_t count) {
+    BEGIN_HELPER;
+    PathBuffer path;
+    for (uint32_t i = 0; i < count; ++i) {
+        GetFilePath(dir, i, &path);
+        fbl::unique_fd fd(open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644));
+        ASSERT_TRUE(fd, strerror(errno));
+    }
+    END_HELPER;
+}
+
+// Removes the test's files, so that memfs, which is not reformatted between tests, does not
+// keep them.
+bool RemoveFiles(const fbl::String& dir, uint32_t count) {
+    BEGIN_HELPER;
+    PathBuffer path;
+    for (uint32_t i = 0; i < count; ++i) {
+        GetFilePath(dir, i, &path);
+        ASSERT_EQ(unlink(path.c_str()), 0, strerror(errno));
+    }
+    ASSERT_EQ(rmdir(dir.c_str()), 0, strerror(errno));
+    END_HELPER;
+}
+
+// Measure the time taken to create an empty file.
+bool CreateTest(perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::String dir;
+    ASSERT_TRUE(MakeTestDir(fixture, "create", &dir));
+    PathBuffer path;
+    uint32_t count = 0;
+    while (state->KeepRunning()) {
+        GetFilePath(dir, count++, &path);
+        fbl::unique_fd fd(open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644));
+        ASSERT_TRUE(fd, strerror(errno));
+    }
+    ASSERT_TRUE(RemoveFiles(dir, count));
+    END_HELPER;
+}
+
+// Measure the time taken to look up a file in a directory of |file_count| files.
+bool LookupTest(uint32_t file_count, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::String dir;
+    ASSERT_TRUE(MakeTestDir(fixture, "lookup", &dir));
+    ASSERT_TRUE(CreateFiles(dir, file_count));
+    PathBuffer path;
+    while (state->KeepRunning()) {
+        GetFilePath(dir, static_cast<uint32_t>(rand_r(fixture->mutable_seed())) % file_count,
+                    &path);
+        struct stat st;
+        ASSERT_EQ(stat(path.c_str(), &st), 0, strerror(errno));
+    }
+    ASSERT_TRUE(RemoveFiles(dir, file_count));
+    END_HELPER;
+}
+
+// Measure the time taken to list a directory of |file_count| files.
+bool ReaddirTest(uint32_t file_count, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::String dir;
+    ASSERT_TRUE(MakeTestDir(fixture, "readdir", &dir));
+    ASSERT_TRUE(CreateFiles(dir, file_count));
+    while (state->KeepRunning()) {
+        DIR* dirp = opendir(dir.c_str());
+        ASSERT_NONNULL(dirp, strerror(errno));
+        uint32_t entries = 0;
+        while (readdir(dirp) != nullptr) {
+            ++entries;
+        }
+        ASSERT_EQ(closedir(dirp), 0);
+        ASSERT_GE(entries, file_count);
+    }
+    ASSERT_TRUE(RemoveFiles(dir, file_count));
+    END_HELPER;
+}
+
+// Measure the times taken to overwrite a small file and to fsync it.
+bool FsyncTest(perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::String dir;
+    ASSERT_TRUE(MakeTestDir(fixture, "fsync", &dir));
+    ASSERT_TRUE(CreateFiles(dir, 1));
+    PathBuffer path;
+    GetFilePath(dir, 0, &path);
+    fbl::unique_fd fd(open(path.c_str(), O_RDWR));
+    ASSERT_TRUE(fd, strerror(errno));
+    fbl::unique_ptr<uint8_t[]> data(new uint8_t[kFsyncWriteSize]);
+    memset(data.get(), static_cast<uint8_t>(rand_r(fixture->mutable_seed())), kFsyncWriteSize);
+
+    state->DeclareStep("write");
+    state->DeclareStep("fsync");
+    while (state->KeepRunning()) {
+        ASSERT_EQ(pwrite(fd.get(), data.get(), kFsyncWriteSize, 0),
+                  static_cast<ssize_t>(kFsyncWriteSize));
+        state->NextStep();
+        ASSERT_EQ(fsync(fd.get()), 0, strerror(errno));
+    }
+    fd.reset();
+    ASSERT_TRUE(RemoveFiles(dir, 1));
+    END_HELPER;
+}
+
+// Measure the throughput of writing a large file sequentially.
+bool LargeWriteTest(perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::String dir;
+    ASSERT_TRUE(MakeTestDir(fixture, "large-write", &dir));
+    ASSERT_TRUE(CreateFiles(dir, 1));
+    PathBuffer path;
+    GetFilePath(dir, 0, &path);
+    fbl::unique_fd fd(open(path.c_str(), O_RDWR));
+    ASSERT_TRUE(fd, strerror(errno));
+    fbl::unique_ptr<uint8_t[]> data(new uint8_t[kLargeWriteSize]);
+    memset(data.get(), static_cast<uint8_t>(rand_r(fixture->mutable_seed())), kLargeWriteSize);
+
+    state->SetBytesProcessedPerRun(kLargeWriteSize);
+    off_t offset = 0;
+    while (state->KeepRunning()) {
+        ASSERT_EQ(pwrite(fd.get(), data.get(), kLargeWriteSize, offset),
+                  static_cast<ssize_t>(kLargeWriteSize));
+        offset = (offset + kLargeWriteSize) % kLargeFileSize;
+    }
+    fd.reset();
+    ASSERT_TRUE(RemoveFiles(dir, 1));
+    END_HELPER;
+}
+
+// The contents of a blob, and the path blobfs stores it under, which is named after its
+// merkle root.
+struct Blob {
+    PathBuffer path;
+    fbl::unique_ptr<uint8_t[]> data;
+    size_t size;
+};
+
+bool MakeBlob(const fbl::String& fs_path, size_t size, unsigned int* seed, Blob* out) {
+    BEGIN_HELPER;
+    out->data.reset(new uint8_t[size]);
+    out->size = size;
+    // As in blobfs-bench, draw one value from |seed| and generate the data from a copy of it,
+    // so that consecutive blobs do not walk through the same cyclic sequence.
+    unsigned int data_seed = rand_r(seed);
+    for (size_t i = 0; i < size; ++i) {
+        out->data[i] = static_cast<uint8_t>(rand_r(&data_seed));
+    }
+
+    size_t merkle_size = MerkleTree::GetTreeLength(size);
+    fbl::unique_ptr<uint8_t[]> merkle(new uint8_t[merkle_size > 0 ? merkle_size : 1]);
+    Digest digest;
+    ASSERT_EQ(MerkleTree::Create(out->data.get(), size, merkle.get(), merkle_size, &digest),
+              ZX_OK);
+    char name[2 * Digest::kLength + 1];
+    ASSERT_EQ(digest.ToString(name, sizeof(name)), ZX_OK);
+    out->path.Clear();
+    out->path.AppendPrintf("%s/%s", fs_path.c_str(), name);
+    END_HELPER;
+}
+
+bool WriteBlob(const Blob& blob) {
+    BEGIN_HELPER;
+    fbl::unique_fd fd(open(blob.path.c_str(), O_CREAT | O_RDWR));
+    ASSERT_TRUE(fd, strerror(errno));
+    ASSERT_EQ(ftruncate(fd.get(), blob.size), 0, strerror(errno));
+    size_t written = 0;
+    while (written < blob.size) {
+        ssize_t result = write(fd.get(), blob.data.get() + written, blob.size - written);
+        ASSERT_GT(result, 0, strerror(errno));
+        written += result;
+    }
+    END_HELPER;
+}
+
+bool MakeBlobs(uint32_t count, Fixture* fixture, fbl::Vector<fbl::String>* paths) {
+    BEGIN_HELPER;
+    for (uint32_t i = 0; i < count; ++i) {
+        Blob blob;
+        ASSERT_TRUE(MakeBlob(fixture->fs_path(), kSmallBlobSize, fixture->mutable_seed(), &blob));
+        ASSERT_TRUE(WriteBlob(blob));
+        paths->push_back(fbl::String(blob.path.c_str()));
+    }
+    END_HELPER;
+}
+
+// Measure the times taken to generate a blob of |blob_size| bytes and its merkle tree, to
+// write it to blobfs, and to unlink it again.
+bool BlobCreateTest(size_t blob_size, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    state->DeclareStep("generate");
+    state->DeclareStep("write");
+    state->DeclareStep("unlink");
+    state->SetBytesProcessedPerRun(blob_size);
+    Blob blob;
+    while (state->KeepRunning()) {
+        ASSERT_TRUE(MakeBlob(fixture->fs_path(), blob_size, fixture->mutable_seed(), &blob));
+        state->NextStep();
+        ASSERT_TRUE(WriteBlob(blob));
+        state->NextStep();
+        ASSERT_EQ(unlink(blob.path.c_str()), 0, strerror(errno));
+    }
+    END_HELPER;
+}
+
+// Measure the time taken to look up a blob among |blob_count| blobs.
+bool BlobLookupTest(uint32_t blob_count, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::Vector<fbl::String> paths;
+    ASSERT_TRUE(MakeBlobs(blob_count, fixture, &paths));
+    while (state->KeepRunning()) {
+        const fbl::String& path =
+            paths[static_cast<uint32_t>(rand_r(fixture->mutable_seed())) % blob_count];
+        struct stat st;
+        ASSERT_EQ(stat(path.c_str(), &st), 0, strerror(errno));
+    }
+    END_HELPER;
+}
+
+// Measure the time taken to list the root of a blobfs holding |blob_count| blobs.
+bool BlobReaddirTest(uint32_t blob_count, perftest::RepeatState* state, Fixture* fixture) {
+    BEGIN_HELPER;
+    fbl::Vector<fbl::String> paths;
+    ASSERT_TRUE(MakeBlobs(blob_count, fixture, &paths));
+    while (state->KeepRunning()) {
+        DIR* dirp = opendir(fixture->fs_path().c_str());
+        ASSERT_NONNULL(dirp, strerror(errno));
+        uint32_t entries = 0;
+        while (readdir(dirp) != nullptr) {
+            ++entries;
+        }
+        ASSERT_EQ(closedir(dirp), 0);
+        ASSERT_GE(entries, blob_count);
+    }
+    END_HELPER;
+}
+
+void AddTest(const char* name, size_t required_disk_space, TestFn test_fn,
+             TestCaseInfo* testcase) {
+    TestInfo test;
+    test.name = fbl::StringPrintf("%s/%s", testcase->name.c_str(), name);
+    test.required_disk_space = required_disk_space;
+    test.test_fn = fbl::move(test_fn);
+    testcase->tests.push_back(fbl::move(test));
+}
+
+} // namespace
+
+void AddFsOpsTestCases(const FixtureOptions& base_options, bool is_unittest,
+                       fbl::Vector<TestCaseInfo>* test_cases) {
+    const uint32_t file_count = is_unittest ? 10 : 1000;
+
+    // minfs and memfs run the same tests; memfs needs no device, so the fixture neither formats
+    // nor mounts one.
+    for (bool memfs : {false, true}) {
+        TestCaseInfo testcase;
+        testcase.name = memfs ? "memfs" : disk_format_string_[DISK_FORMAT_MINFS];
+        testcase.teardown = true;
+        testcase.fixture_options.reset(new FixtureOptions(base_options));
+        testcase.fixture_options->fs_type = DISK_FORMAT_MINFS;
+        testcase.fixture_options->fs_format = !memfs;
+        testcase.fixture_options->fs_mount = !memfs;
+
+        AddTest("Create", 0, CreateTest, &testcase);
+        AddTest("Lookup", 0,
+                [file_count](perftest::RepeatState* state, Fixture* fixture) {
+                    return LookupTest(file_count, state, fixture);
+                },
+                &testcase);
+        AddTest("Readdir", 0,
+                [file_count](perftest::RepeatState* state, Fixture* fixture) {
+                    return ReaddirTest(file_count, state, fixture);
+                },
+                &testcase);
+        AddTest("Fsync", 0, FsyncTest, &testcase);
+        AddTest("LargeWrite/1Mbytes", kLargeFileSize, LargeWriteTest, &testcase);
+        test_cases->push_back(fbl::move(testcase));
+    }
+
+    TestCaseInfo testcase;
+    testcase.name = disk_format_string_[DISK_FORMAT_BLOBFS];
+    testcase.teardown = true;
+    testcase.fixture_options.reset(new FixtureOptions(base_options));
+    testcase.fixture_options->fs_type = DISK_FORMAT_BLOBFS;
+    AddTest("Create/8Kbytes", 0,
+            [](perftest::RepeatState* state, Fixture* fixture) {
+                return BlobCreateTest(kSmallBlobSize, state, fixture);
+            },
+            &testcase);
+    AddTest("Create/1Mbytes", 0,
+            [](perftest::RepeatState* state, Fixture* fixture) {
+                return BlobCreateTest(kLargeWriteSize, state, fixture);
+            },
+            &testcase);
+    AddTest("Lookup", 0,
+            [file_count](perftest::RepeatState* state, Fixture* fixture) {
+                return BlobLookupTest(file_count, state, fixture);
+            },
+            &testcase);
+    AddTest("Readdir", 0,
+            [file_count](perftest::RepeatState* state, Fixture* fixture) {
+                return BlobReaddirTest(file_count, state, fixture);
+            },
+            &testcase);
+    test_cases->push_back(fbl::move(testcase));
+}
+
+} // namespace storage_bench
@@ -0,0 +1,40 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/vector.h>
+#include <fs-management/mount.h>
+#include <fs-test-utils/fixture.h>
+#include <fs-test-utils/perftest.h>
+
+#include "storage-bench.h"
+
+namespace storage_bench {
+namespace {
+
+using fs_test_utils::FixtureOptions;
+using fs_test_utils::PerformanceTestOptions;
+using fs_test_utils::TestCaseInfo;
+
+bool RunBenchmark(int argc, char** argv) {
+    // The block device options (ramdisk or real device, and its size) come from the command line;
+    // each test case picks its own filesystem and layering on top of that device.
+    FixtureOptions f_opts = FixtureOptions::Default(DISK_FORMAT_MINFS);
+    PerformanceTestOptions p_opts;
+    if (!fs_test_utils::ParseCommandLineArgs(argc, argv, &f_opts, &p_opts)) {
+        return false;
+    }
+
+    fbl::Vector<TestCaseInfo> testcases;
+    AddBlockIoTestCases(f_opts, p_opts.is_unittest, &testcases);
+    AddFsOpsTestCases(f_opts, p_opts.is_unittest, &testcases);
+    return fs_test_utils::RunTestCases(f_opts, p_opts, testcases);
+}
+
+} // namespace
+} // namespace storage_bench
+
+int main(int argc, char** argv) {
+    return fs_test_utils::RunWithMemFs(
+        [argc, argv]() { return storage_bench::RunBenchmark(argc, argv) ? 0 : -1; });
+}
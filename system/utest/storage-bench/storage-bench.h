@@ -0,0 +1,24 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <fbl/vector.h>
+#include <fs-test-utils/fixture.h>
+#include <fs-test-utils/perftest.h>
+
+namespace storage_bench {
+
+// Adds test cases measuring sequential and random block I/O through the block FIFO at several
+// queue depths, on the bare block device, on an FVM partition, and on zxcrypt on top of an FVM
+// partition. Comparing the three shows the cost of each layer.
+void AddBlockIoTestCases(const fs_test_utils::FixtureOptions& base_options, bool is_unittest,
+                         fbl::Vector<fs_test_utils::TestCaseInfo>* test_cases);
+
+// Adds test cases measuring filesystem operations (create, lookup, readdir, fsync and large
+// writes) on minfs and memfs, and their blob equivalents on blobfs.
+void AddFsOpsTestCases(const fs_test_utils::FixtureOptions& base_options, bool is_unittest,
+                       fbl::Vector<fs_test_utils::TestCaseInfo>* test_cases);
+
+} // namespace storage_bench
@@ -0,0 +1,337 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Checks the string routines against byte-wise reference implementations.
+// On x86-64 memchr, memcmp, strchrnul, strcmp and strlen scan 16 bytes at a
+// time, so every alignment of the start of a buffer is covered, as is a
+// match, difference or NUL at each position of the short lengths and a
+// sample of the positions of the long ones. The guard page tests end a
+// buffer on the last byte before an unmapped page, which catches a load
+// that runs past the end of the buffer into the next page.
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <unittest/unittest.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+#define MAX_ALIGN 16u
+#define MAX_SHORT_LENGTH 64u
+
+static const size_t kLongLengths[] = {100u, 255u, 256u, 1000u, 4095u};
+
+#define NUM_LENGTHS (MAX_SHORT_LENGTH + 1u + countof(kLongLengths))
+#define MAX_LENGTH 4095u
+
+// Never produced by fill(), so it can be searched for.
+#define TARGET 0xffu
+
+static char buf_a[MAX_ALIGN + MAX_LENGTH + 1u] __ALIGNED(MAX_ALIGN);
+static char buf_b[MAX_ALIGN + MAX_LENGTH + 1u] __ALIGNED(MAX_ALIGN);
+
+static size_t test_length(size_t i) {
+    return i <= MAX_SHORT_LENGTH ? i : kLongLengths[i - MAX_SHORT_LENGTH - 1u];
+}
+
+// Every position within 64 bytes of either end of a buffer, and a sample of
+// the middle of long ones.
+static size_t next_position(size_t pos, size_t len) {
+    if (pos < 64u || pos + 64u >= len) {
+        return pos + 1u;
+    }
+    return pos + 61u < len - 64u ? pos + 61u : len - 64u;
+}
+
+// Fills |s| with non-NUL bytes other than TARGET, half of them >= 0x80.
+static void fill(char* s, size_t len, size_t seed) {
+    for (size_t i = 0; i < len; i++) {
+        s[i] = (char)(1u + (i * 37u + seed) % 254u);
+    }
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+static const void* ref_memchr(const void* s, int c, size_t n) {
+    const unsigned char* p = s;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] == (unsigned char)c) {
+            return p + i;
+        }
+    }
+    return NULL;
+}
+
+static int ref_memcmp(const void* a, const void* b, size_t n) {
+    const unsigned char* l = a;
+    const unsigned char* r = b;
+    for (size_t i = 0; i < n; i++) {
+        if (l[i] != r[i]) {
+            return l[i] - r[i];
+        }
+    }
+    return 0;
+}
+
+static const char* ref_strchrnul(const char* s, int c) {
+    while (*s && *(const unsigned char*)s != (unsigned char)c) {
+        s++;
+    }
+    return s;
+}
+
+static int ref_strcmp(const char* a, const char* b) {
+    const unsigned char* l = (const unsigned char*)a;
+    const unsigned char* r = (const unsigned char*)b;
+    while (*l && *l == *r) {
+        l++;
+        r++;
+    }
+    return *l - *r;
+}
+
+static size_t ref_strlen(const char* s) {
+    size_t n = 0;
+    while (s[n]) {
+        n++;
+    }
+    return n;
+}
+
+static bool memchr_test(void) {
+    BEGIN_TEST;
+
+    const int targets[] = {TARGET, 0};
+    for (size_t align = 0; align < MAX_ALIGN; align++) {
+        for (size_t i = 0; i < NUM_LENGTHS; i++) {
+            size_t len = test_length(i);
+            char* s = buf_a + align;
+            fill(s, len, align);
+            for (size_t t = 0; t < countof(targets); t++) {
+                int c = targets[t];
+                // A match just past the end must not be found.
+                s[len] = (char)c;
+                ASSERT_EQ(ref_memchr(s, c, len), memchr(s, c, len), "");
+                for (size_t pos = 0; pos < len; pos = next_position(pos, len)) {
+                    char saved = s[pos];
+                    s[pos] = (char)c;
+                    ASSERT_EQ(ref_memchr(s, c, len), memchr(s, c, len), "");
+                    s[pos] = saved;
+                }
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool memcmp_test(void) {
+    BEGIN_TEST;
+
+    for (size_t align_a = 0; align_a < MAX_ALIGN; align_a++) {
+        for (size_t align_b = 0; align_b < MAX_ALIGN; align_b++) {
+            for (size_t i = 0; i < NUM_LENGTHS; i++) {
+                size_t len = test_length(i);
+                char* a = buf_a + align_a;
+                char* b = buf_b + align_b;
+                fill(a, len, 0u);
+                fill(b, len, 0u);
+                // Differences just past the end must not count.
+                a[len] = 1;
+                b[len] = 2;
+                ASSERT_EQ(0, memcmp(a, b, len), "");
+                for (size_t pos = 0; pos < len; pos = next_position(pos, len)) {
+                    // Flipping the top bit makes one of the two bytes >= 0x80.
+                    b[pos] = (char)(b[pos] ^ 0x80);
+                    ASSERT_EQ(sign(ref_memcmp(a, b, len)), sign(memcmp(a, b, len)), "");
+                    ASSERT_EQ(sign(ref_memcmp(b, a, len)), sign(memcmp(b, a, len)), "");
+                    b[pos] = a[pos];
+                }
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool strchrnul_test(void) {
+    BEGIN_TEST;
+
+    for (size_t align = 0; align < MAX_ALIGN; align++) {
+        for (size_t i = 0; i < NUM_LENGTHS; i++) {
+            size_t len = test_length(i);
+            char* s = buf_a + align;
+            fill(s, len, align);
+            s[len] = '\0';
+            ASSERT_EQ(ref_strchrnul(s, TARGET), strchrnul(s, TARGET), "");
+            ASSERT_EQ(ref_strchrnul(s, '\0'), strchrnul(s, '\0'), "");
+            for (size_t pos = 0; pos < len; pos = next_position(pos, len)) {
+                char saved = s[pos];
+                s[pos] = (char)TARGET;
+                ASSERT_EQ(ref_strchrnul(s, TARGET), strchrnul(s, TARGET), "");
+                s[pos] = saved;
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool strcmp_test(void) {
+    BEGIN_TEST;
+
+    for (size_t align_a = 0; align_a < MAX_ALIGN; align_a++) {
+        for (size_t align_b = 0; align_b < MAX_ALIGN; align_b++) {
+            for (size_t i = 0; i < NUM_LENGTHS; i++) {
+                size_t len = test_length(i);
+                char* a = buf_a + align_a;
+                char* b = buf_b + align_b;
+                fill(a, len, 0u);
+                fill(b, len, 0u);
+                a[len] = '\0';
+                b[len] = '\0';
+                ASSERT_EQ(0, strcmp(a, b), "");
+                for (size_t pos = 0; pos < len; pos = next_position(pos, len)) {
+                    char saved = b[pos];
+                    // A difference with a byte >= 0x80 on one side.
+                    b[pos] = (char)(saved ^ 0x80);
+                    ASSERT_EQ(sign(ref_strcmp(a, b)), sign(strcmp(a, b)), "");
+                    ASSERT_EQ(sign(ref_strcmp(b, a)), sign(strcmp(b, a)), "");
+                    // One string ending early.
+                    b[pos] = '\0';
+                    ASSERT_EQ(sign(ref_strcmp(a, b)), sign(strcmp(a, b)), "");
+                    ASSERT_EQ(sign(ref_strcmp(b, a)), sign(strcmp(b, a)), "");
+                    b[pos] = saved;
+                }
+            }
+        }
+    }
+
+    END_TEST;
+}
+
+static bool strlen_test(void) {
+    BEGIN_TEST;
+
+    for (size_t align = 0; align < MAX_ALIGN; align++) {
+        for (size_t i = 0; i < NUM_LENGTHS; i++) {
+            size_t len = test_length(i);
+            char* s = buf_a + align;
+            fill(s, len, align);
+            s[len] = '\0';
+            ASSERT_EQ(ref_strlen(s), strlen(s), "");
+            ASSERT_EQ(len, strlen(s), "");
+        }
+    }
+
+    END_TEST;
+}
+
+// Maps a page in its own two page vmar, leaving the second page unmapped.
+static zx_status_t map_guarded_page(zx_handle_t* vmar, char** page) {
+    zx_vaddr_t addr;
+    zx_status_t status = zx_vmar_allocate(zx_vmar_root_self(),
+                                          ZX_VM_CAN_MAP_READ | ZX_VM_CAN_MAP_WRITE |
+                                              ZX_VM_CAN_MAP_SPECIFIC,
+                                          0u, 2u * PAGE_SIZE, vmar, &addr);
+    if (status != ZX_OK) {
+        return status;
+    }
+    zx_handle_t vmo;
+    status = zx_vmo_create(PAGE_SIZE, 0u, &vmo);
+    if (status != ZX_OK) {
+        zx_vmar_destroy(*vmar);
+        zx_handle_close(*vmar);
+        return status;
+    }
+    status = zx_vmar_map(*vmar, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE | ZX_VM_SPECIFIC,
+                         0u, vmo, 0u, PAGE_SIZE, &addr);
+    zx_handle_close(vmo);
+    if (status != ZX_OK) {
+        zx_vmar_destroy(*vmar);
+        zx_handle_close(*vmar);
+        return status;
+    }
+    *page = (char*)addr;
+    return ZX_OK;
+}
+
+static void unmap_guarded_page(zx_handle_t vmar) {
+    zx_vmar_destroy(vmar);
+    zx_handle_close(vmar);
+}
+
+static bool guard_page_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t vmar_a, vmar_b;
+    char* page_a;
+    char* page_b;
+    ASSERT_EQ(ZX_OK, map_guarded_page(&vmar_a, &page_a), "");
+    ASSERT_EQ(ZX_OK, map_guarded_page(&vmar_b, &page_b), "");
+    char* end_a = page_a + PAGE_SIZE;
+    char* end_b = page_b + PAGE_SIZE;
+
+    // Every start alignment of a buffer whose last byte is the last byte of
+    // the page.
+    for (size_t len = 0; len <= MAX_SHORT_LENGTH + MAX_ALIGN; len++) {
+        char* a = end_a - len;
+        char* b = end_b - len;
+        fill(a, len, 0u);
+        fill(b, len, 0u);
+
+        EXPECT_NULL(memchr(a, TARGET, len), "");
+        EXPECT_EQ(0, memcmp(a, b, len), "");
+        if (len > 0u) {
+            a[len - 1u] = (char)TARGET;
+            EXPECT_EQ(end_a - 1, memchr(a, TARGET, len), "");
+            EXPECT_LT(0, memcmp(a, b, len), "");
+            EXPECT_GT(0, memcmp(b, a, len), "");
+        }
+    }
+
+    // Every start alignment of a string whose NUL is the last byte of the
+    // page.
+    for (size_t len = 0; len < MAX_SHORT_LENGTH + MAX_ALIGN; len++) {
+        char* a = end_a - len - 1u;
+        char* b = end_b - len - 1u;
+        fill(a, len, 0u);
+        fill(b, len, 0u);
+        a[len] = '\0';
+        b[len] = '\0';
+
+        EXPECT_EQ(len, strlen(a), "");
+        EXPECT_EQ(end_a - 1, strchrnul(a, TARGET), "");
+        EXPECT_EQ(end_a - 1, strchrnul(a, '\0'), "");
+        EXPECT_EQ(0, strcmp(a, b), "");
+        if (len > 0u) {
+            a[len - 1u] = (char)TARGET;
+            EXPECT_EQ(end_a - 2, strchrnul(a, TARGET), "");
+            EXPECT_LT(0, strcmp(a, b), "");
+            EXPECT_GT(0, strcmp(b, a), "");
+        }
+    }
+
+    unmap_guarded_page(vmar_a);
+    unmap_guarded_page(vmar_b);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(string_tests)
+RUN_TEST(memchr_test)
+RUN_TEST(memcmp_test)
+RUN_TEST(strchrnul_test)
+RUN_TEST(strcmp_test)
+RUN_TEST(strlen_test)
+RUN_TEST(guard_page_test)
+END_TEST_CASE(string_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -337,6 +337,76 @@ bool TestLogVerbosity(void) {
     END_TEST;
 }
 
+bool TestLogStructured(void) {
+    BEGIN_TEST;
+    Cleanup cleanup;
+    zx::socket local, remote;
+    EXPECT_EQ(ZX_OK, zx::socket::create(ZX_SOCKET_DATAGRAM, &local, &remote));
+    const char* gtags[] = {"gtag"};
+    ASSERT_EQ(ZX_OK, init_helper(remote.release(), gtags, 1));
+    fx_logger_t* logger = fx_log_get_logger();
+
+    fx_log_format_id_t id;
+    ASSERT_EQ(ZX_OK, fx_logger_register_format(logger, "%d, %s", &id));
+    EXPECT_EQ(0u, id);
+    struct {
+        fx_log_structured_header_t header;
+        uint8_t data[FX_LOG_MAX_DATAGRAM_LEN];
+    } packet;
+    size_t actual;
+    ASSERT_EQ(ZX_OK, local.read(0, &packet, sizeof(packet), &actual));
+    EXPECT_EQ(ZX_KOID_INVALID, packet.header.marker);
+    EXPECT_EQ(FX_LOG_STRUCTURED_FORMAT, packet.header.type);
+    EXPECT_EQ(sizeof(packet.header) + sizeof(uint32_t) + 7, actual);
+    EXPECT_STR_EQ("%d, %s", reinterpret_cast<char*>(packet.data + sizeof(uint32_t)), "");
+
+    EXPECT_EQ(ZX_OK, fx_logger_log_structured(logger, FX_LOG_INFO, id, 10, "just some number"));
+    EXPECT_EQ(ZX_OK, fx_logger_log_structured(logger, FX_LOG_INFO, id, 11, "another number"));
+    EXPECT_EQ(ZX_OK, fx_logger_flush(logger));
+
+    // Both records arrive in one datagram, after the tags.
+    ASSERT_EQ(ZX_OK, local.read(0, &packet, sizeof(packet), &actual));
+    EXPECT_EQ(FX_LOG_STRUCTURED_RECORDS, packet.header.type);
+    ASSERT_EQ(4, packet.data[0]);
+    ASSERT_BYTES_EQ(reinterpret_cast<const uint8_t*>("gtag"), packet.data + 1, 4, "");
+    ASSERT_EQ(0, packet.data[5]);
+    const char* expected[] = {"10, just some number", "11, another number"};
+    size_t offset = 8;
+    for (const char* msg : expected) {
+        fx_log_structured_record_t record;
+        ASSERT_LE(offset + sizeof(record), actual - sizeof(packet.header));
+        memcpy(&record, packet.data + offset, sizeof(record));
+        offset += sizeof(record);
+        EXPECT_EQ(FX_LOG_INFO, record.severity);
+        EXPECT_EQ(id, record.format_id);
+        char out[64];
+        EXPECT_EQ(static_cast<int>(strlen(msg)),
+                  fx_log_format_structured("%d, %s", packet.data + offset, record.args_size,
+                                           out, sizeof(out)));
+        EXPECT_STR_EQ(msg, out, "");
+        offset += record.args_size;
+    }
+    EXPECT_EQ(actual - sizeof(packet.header), offset);
+    END_TEST;
+}
+
+bool TestLogStructuredInvalidFormat(void) {
+    BEGIN_TEST;
+    Cleanup cleanup;
+    zx::socket local, remote;
+    EXPECT_EQ(ZX_OK, zx::socket::create(ZX_SOCKET_DATAGRAM, &local, &remote));
+    ASSERT_EQ(ZX_OK, init_helper(remote.release(), nullptr, 0));
+    fx_logger_t* logger = fx_log_get_logger();
+
+    fx_log_format_id_t id;
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, fx_logger_register_format(logger, "%*d", &id));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, fx_logger_register_format(logger, "%Lf", &id));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, fx_logger_register_format(logger, "%n", &id));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, fx_logger_register_format(logger, "%s%s%s%s", &id));
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, fx_logger_log_structured(logger, FX_LOG_INFO, 0, 10));
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(syslog_socket_tests)
 RUN_TEST(TestLogSimpleWrite)
 RUN_TEST(TestLogWrite)
@@ -350,6 +420,8 @@ RUN_TEST(TestVlogSimpleWrite)
 RUN_TEST(TestVlogWrite)
 RUN_TEST(TestVlogWriteWithTag)
 RUN_TEST(TestLogVerbosity)
+RUN_TEST(TestLogStructured)
+RUN_TEST(TestLogStructuredInvalidFormat)
 END_TEST_CASE(syslog_socket_tests)
 
 BEGIN_TEST_CASE(syslog_socket_tests_edge_cases)
@@ -8,6 +8,7 @@
 
 #include <fbl/algorithm.h>
 #include <fbl/vector.h>
+#include <trace-engine/fields.h>
 #include <unittest/unittest.h>
 
 namespace {
@@ -178,6 +179,93 @@ bool empty_buffer_test() {
     END_TEST;
 }
 
+uint64_t MakeProviderRecord(trace::MetadataType type, trace::ProviderId id,
+                            size_t size, size_t name_length) {
+    return trace::RecordFields::Type::Make(
+               trace::ToUnderlyingType(trace::RecordType::kMetadata)) |
+           trace::RecordFields::RecordSize::Make(size) |
+           trace::MetadataRecordFields::MetadataType::Make(trace::ToUnderlyingType(type)) |
+           trace::ProviderInfoMetadataRecordFields::Id::Make(id) |
+           trace::ProviderInfoMetadataRecordFields::NameLength::Make(name_length);
+}
+
+uint64_t MakeInitializationRecord() {
+    return trace::RecordFields::Type::Make(
+               trace::ToUnderlyingType(trace::RecordType::kInitialization)) |
+           trace::RecordFields::RecordSize::Make(2);
+}
+
+bool provider_section_scanner_test() {
+    BEGIN_TEST;
+
+    const uint64_t kTicksPerSecond = 1000;
+    const uint64_t data[] = {
+        MakeProviderRecord(trace::MetadataType::kProviderInfo, 1, 2, 3),
+        ToWord("one\0\0\0\0"),
+        MakeInitializationRecord(),
+        kTicksPerSecond,
+        MakeProviderRecord(trace::MetadataType::kProviderSection, 2, 1, 0),
+        MakeInitializationRecord(),
+        kTicksPerSecond,
+        MakeProviderRecord(trace::MetadataType::kProviderSection, 1, 1, 0),
+        MakeProviderRecord(trace::MetadataType::kProviderSection, 1, 1, 0),
+        MakeInitializationRecord(),
+        kTicksPerSecond,
+        // Cut short by the end of the chunk.
+        MakeInitializationRecord(),
+    };
+
+    struct Section {
+        trace::ProviderId id;
+        trace::Chunk chunk;
+    };
+    fbl::Vector<Section> sections;
+    fbl::String error;
+    trace::ProviderSectionScanner scanner(
+        [&sections](trace::ProviderId id, trace::Chunk chunk) {
+            sections.push_back(Section{id, chunk});
+        },
+        MakeErrorHandler(&error));
+
+    trace::Chunk chunk(data, fbl::count_of(data));
+    EXPECT_TRUE(scanner.ScanSections(chunk));
+    EXPECT_TRUE(error.empty());
+    EXPECT_EQ(1, scanner.current_provider_id());
+    ASSERT_EQ(3, sections.size());
+    EXPECT_EQ(1, sections[0].id);
+    EXPECT_EQ(4, sections[0].chunk.remaining_words());
+    EXPECT_EQ(2, sections[1].id);
+    EXPECT_EQ(3, sections[1].chunk.remaining_words());
+    EXPECT_EQ(1, sections[2].id);
+    EXPECT_EQ(5, sections[2].chunk.remaining_words());
+
+    // Provider 1's sections decode on their own.
+    fbl::Vector<trace::Record> records;
+    trace::TraceReader reader(MakeRecordConsumer(&records), MakeErrorHandler(&error));
+    EXPECT_TRUE(reader.ReadRecords(sections[0].chunk));
+    EXPECT_TRUE(reader.ReadRecords(sections[2].chunk));
+    EXPECT_TRUE(error.empty());
+    EXPECT_EQ(5, records.size());
+    EXPECT_EQ(1, reader.current_provider_id());
+    EXPECT_TRUE(reader.current_provider_name() == "one");
+
+    // A record of size 0 can't be skipped.
+    const uint64_t corrupt[] = {
+        MakeInitializationRecord(),
+        kTicksPerSecond,
+        0u,
+    };
+    sections.reset();
+    trace::Chunk corrupt_chunk(corrupt, fbl::count_of(corrupt));
+    EXPECT_FALSE(scanner.ScanSections(corrupt_chunk));
+    EXPECT_FALSE(error.empty());
+    ASSERT_EQ(1, sections.size());
+    EXPECT_EQ(1, sections[0].id);
+    EXPECT_EQ(2, sections[0].chunk.remaining_words());
+
+    END_TEST;
+}
+
 // NOTE: Most of the reader is covered by the libtrace tests.
 
 } // namespace
@@ -187,4 +275,5 @@ RUN_TEST(empty_chunk_test)
 RUN_TEST(non_empty_chunk_test)
 RUN_TEST(initial_state_test)
 RUN_TEST(empty_buffer_test)
+RUN_TEST(provider_section_scanner_test)
 END_TEST_CASE(reader_tests)
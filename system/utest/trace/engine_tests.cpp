@@ -100,6 +100,45 @@ bool TestIsCategoryEnabled() {
     END_TRACE_TEST;
 }
 
+bool TestCategorySiteCache() {
+    BEGIN_TRACE_TEST;
+
+    trace_site_t enabled_site = {};
+    trace_site_t disabled_site = {};
+    trace_string_ref_t category_ref;
+    EXPECT_FALSE(trace_is_category_enabled_cached("+enabled", &enabled_site));
+    EXPECT_NULL(trace_acquire_context_for_category_cached("-disabled", &disabled_site,
+                                                          &category_ref));
+    EXPECT_EQ(0u, enabled_site.disabled_generation);
+    EXPECT_EQ(0u, disabled_site.disabled_generation);
+
+    fixture_start_tracing();
+    EXPECT_TRUE(trace_is_category_enabled_cached("+enabled", &enabled_site));
+    trace_context_t* context = trace_acquire_context_for_category_cached(
+        "+enabled", &enabled_site, &category_ref);
+    EXPECT_NONNULL(context);
+    if (context)
+        trace_release_context(context);
+    EXPECT_EQ(0u, enabled_site.disabled_generation);
+
+    EXPECT_NULL(trace_acquire_context_for_category_cached("-disabled", &disabled_site,
+                                                          &category_ref));
+    uint32_t generation = disabled_site.disabled_generation;
+    EXPECT_NE(0u, generation);
+    EXPECT_FALSE(trace_is_category_enabled_cached("-disabled", &disabled_site));
+    EXPECT_EQ(generation, disabled_site.disabled_generation);
+    fixture_stop_tracing();
+
+    // The site is checked again in the next session.
+    fixture_start_tracing();
+    EXPECT_FALSE(trace_is_category_enabled_cached("-disabled", &disabled_site));
+    EXPECT_NE(generation, disabled_site.disabled_generation);
+    EXPECT_NE(0u, disabled_site.disabled_generation);
+    fixture_stop_tracing();
+
+    END_TRACE_TEST;
+}
+
 bool TestGenerateNonce() {
     BEGIN_TRACE_TEST;
 
@@ -556,6 +595,9 @@ bool TestStreamingMode() {
 
     EXPECT_TRUE(fixture_wait_buffer_full_notification());
     EXPECT_EQ(fixture_get_buffer_full_wrapped_count(), 1);
+    // The records dropped while neither buffer was free are reported with
+    // the buffer, without waiting for tracing to stop.
+    EXPECT_GE(fixture_get_buffer_full_records_dropped(), kBufferSize / 8);
 
     {
         auto context = trace::TraceProlongedContext::Acquire();
@@ -685,6 +727,7 @@ RUN_TEST(TestNormalShutdown)
 RUN_TEST(TestHardShutdown)
 RUN_TEST(TestIsEnabled)
 RUN_TEST(TestIsCategoryEnabled)
+RUN_TEST(TestCategorySiteCache)
 RUN_TEST(TestGenerateNonce)
 RUN_TEST(TestObserver)
 RUN_TEST(TestObserverErrors)
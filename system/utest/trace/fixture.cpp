@@ -135,10 +135,15 @@ public:
         return observed_buffer_full_durable_data_end_;
     }
 
+    uint64_t observed_buffer_full_records_dropped() const {
+        return observed_buffer_full_records_dropped_;
+    }
+
     void ResetBufferFullNotification() {
         observed_notify_buffer_full_callback_ = false;
         observed_buffer_full_wrapped_count_ = 0;
         observed_buffer_full_durable_data_end_ = 0;
+        observed_buffer_full_records_dropped_ = 0;
     }
 
     bool ReadRecords(fbl::Vector<trace::Record>* out_records,
@@ -188,6 +193,9 @@ private:
         observed_notify_buffer_full_callback_ = true;
         observed_buffer_full_wrapped_count_ = wrapped_count;
         observed_buffer_full_durable_data_end_ = durable_data_end;
+        // Read the header as the trace manager would when saving the buffer.
+        auto header = reinterpret_cast<const trace_buffer_header*>(buffer_.get());
+        observed_buffer_full_records_dropped_ = header->num_records_dropped;
         buffer_full_.signal(0u, ZX_EVENT_SIGNALED);
     }
 
@@ -204,6 +212,7 @@ private:
     bool observed_notify_buffer_full_callback_ = false;
     uint32_t observed_buffer_full_wrapped_count_ = 0;
     uint64_t observed_buffer_full_durable_data_end_ = 0;
+    uint64_t observed_buffer_full_records_dropped_ = 0;
 };
 
 Fixture* g_fixture{nullptr};
@@ -272,6 +281,11 @@ uint32_t fixture_get_buffer_full_wrapped_count() {
     return g_fixture->observed_buffer_full_wrapped_count();
 }
 
+uint64_t fixture_get_buffer_full_records_dropped() {
+    ZX_DEBUG_ASSERT(g_fixture);
+    return g_fixture->observed_buffer_full_records_dropped();
+}
+
 void fixture_reset_buffer_full_notification() {
     ZX_DEBUG_ASSERT(g_fixture);
     g_fixture->ResetBufferFullNotification();
@@ -94,6 +94,7 @@ async_loop_t* fixture_async_loop(void);
 zx_status_t fixture_get_disposition(void);
 bool fixture_wait_buffer_full_notification(void);
 uint32_t fixture_get_buffer_full_wrapped_count(void);
+uint64_t fixture_get_buffer_full_records_dropped(void);
 void fixture_reset_buffer_full_notification(void);
 bool fixture_compare_records(const char* expected);
 
@@ -1413,6 +1413,93 @@ bool vmo_cache_flush_test() {
     END_TEST;
 }
 
+bool vmo_discardable_lock_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE * 4;
+    zx_handle_t vmo;
+    ASSERT_EQ(ZX_OK, zx_vmo_create(size, ZX_VMO_DISCARDABLE, &vmo), "vm_object_create");
+
+    // created locked, so the first unlock succeeds and the second doesn't
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, 0, size, nullptr, 0), "unlock");
+    EXPECT_EQ(ZX_ERR_BAD_STATE, zx_vmo_op_range(vmo, ZX_VMO_OP_UNLOCK, 0, size, nullptr, 0),
+              "unlock twice");
+
+    // locking covers the whole vmo
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS,
+              zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, PAGE_SIZE, nullptr, 0), "partial lock");
+
+    uint32_t discarded = 2;
+    EXPECT_EQ(ZX_OK, zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, size, &discarded, sizeof(discarded)),
+              "lock");
+    EXPECT_EQ(0u, discarded, "nothing discarded");
+
+    zx_signals_t observed;
+    EXPECT_EQ(ZX_ERR_TIMED_OUT, zx_object_wait_one(vmo, ZX_VMO_DISCARDED, 0, &observed),
+              "not signaled");
+
+    zx_handle_t clone;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED,
+              zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, size, &clone), "clone");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+
+    // ordinary vmos can't be locked
+    ASSERT_EQ(ZX_OK, zx_vmo_create(size, 0, &vmo), "vm_object_create");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, zx_vmo_op_range(vmo, ZX_VMO_OP_LOCK, 0, size, nullptr, 0),
+              "lock");
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+
+    END_TEST;
+}
+
+bool vmo_op_range_batch_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE * 4;
+    zx_handle_t vmo;
+    ASSERT_EQ(ZX_OK, zx_vmo_create(size, 0, &vmo), "vm_object_create");
+
+    zx_vmo_op_range_entry_t ops[] = {
+        {ZX_VMO_OP_COMMIT, ZX_ERR_INTERNAL, 0, size},
+        {ZX_VMO_OP_DECOMMIT, ZX_ERR_INTERNAL, PAGE_SIZE, PAGE_SIZE},
+        {ZX_VMO_OP_COMMIT, ZX_ERR_INTERNAL, size + PAGE_SIZE, PAGE_SIZE},
+        {ZX_VMO_OP_LOCK, ZX_ERR_INTERNAL, 0, size},
+        {ZX_VMO_OP_CACHE_CLEAN, ZX_ERR_INTERNAL, 0, size},
+        {5, ZX_ERR_INTERNAL, 0, size},
+    };
+    ASSERT_EQ(ZX_OK, zx_vmo_op_range_batch(vmo, ops, fbl::count_of(ops)), "batch");
+
+    // every entry gets its own status, and one failing doesn't stop the rest
+    EXPECT_EQ(ZX_OK, ops[0].status, "commit");
+    EXPECT_EQ(ZX_OK, ops[1].status, "decommit");
+    EXPECT_EQ(ZX_ERR_OUT_OF_RANGE, ops[2].status, "commit past the end");
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED, ops[3].status, "lock of an ordinary vmo");
+    EXPECT_EQ(ZX_OK, ops[4].status, "cache clean");
+    EXPECT_EQ(ZX_ERR_INVALID_ARGS, ops[5].status, "unknown op");
+
+    zx_info_vmo_t info;
+    ASSERT_EQ(ZX_OK, zx_object_get_info(vmo, ZX_INFO_VMO, &info, sizeof(info), nullptr, nullptr),
+              "info_vmo");
+    EXPECT_EQ(size - PAGE_SIZE, info.committed_bytes, "committed bytes");
+
+    // the rights are checked per entry
+    zx_handle_t ro;
+    ASSERT_EQ(ZX_OK, zx_handle_duplicate(vmo, ZX_RIGHT_READ, &ro), "duplicate");
+    zx_vmo_op_range_entry_t ro_ops[] = {
+        {ZX_VMO_OP_DECOMMIT, ZX_ERR_INTERNAL, 0, size},
+        {ZX_VMO_OP_CACHE_SYNC, ZX_ERR_INTERNAL, 0, size},
+    };
+    ASSERT_EQ(ZX_OK, zx_vmo_op_range_batch(ro, ro_ops, fbl::count_of(ro_ops)), "batch");
+    EXPECT_EQ(ZX_ERR_ACCESS_DENIED, ro_ops[0].status, "decommit needs write");
+    EXPECT_EQ(ZX_OK, ro_ops[1].status, "cache sync");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(ro), "handle_close");
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "handle_close");
+
+    END_TEST;
+}
+
 bool vmo_decommit_misaligned_test() {
     BEGIN_TEST;
 
@@ -1674,6 +1761,57 @@ bool vmo_clone_resize_parent_ok() {
     END_TEST;
 }
 
+// writes through a mapping of the original made before and after the snapshot
+// don't show up in it
+bool vmo_clone_snapshot_test() {
+    BEGIN_TEST;
+
+    const size_t size = PAGE_SIZE * 4;
+    zx_handle_t vmo;
+    ASSERT_EQ(zx_vmo_create(size, 0, &vmo), ZX_OK);
+
+    uintptr_t ptr_rw;
+    EXPECT_EQ(ZX_OK, zx_vmar_map(
+            zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE, 0,
+            vmo, 0, size, &ptr_rw), "map");
+    auto arr = reinterpret_cast<size_t*>(ptr_rw);
+    for (size_t i = 0; i < size / sizeof(size_t); i++) {
+        arr[i] = i;
+    }
+
+    zx_handle_t snapshot;
+    EXPECT_EQ(ZX_OK, zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE | ZX_VMO_CLONE_SNAPSHOT,
+                                  0, size, &snapshot), "vm_clone");
+
+    // snapshots only come from the original
+    zx_handle_t nested;
+    EXPECT_EQ(ZX_ERR_NOT_SUPPORTED,
+              zx_vmo_clone(snapshot, ZX_VMO_CLONE_COPY_ON_WRITE | ZX_VMO_CLONE_SNAPSHOT,
+                           0, size, &nested), "vm_clone");
+
+    // the mapping was writable before the snapshot was taken
+    for (size_t i = 0; i < size / sizeof(size_t); i++) {
+        arr[i] = ~i;
+    }
+    size_t val = 99;
+    EXPECT_EQ(ZX_OK, zx_vmo_write(vmo, &val, 0, sizeof(val)), "writing to original");
+
+    for (size_t off = 0; off < size; off += sizeof(off)) {
+        EXPECT_EQ(ZX_OK, zx_vmo_read(snapshot, &val, off, sizeof(val)), "reading snapshot");
+        if (val != off / sizeof(off)) {
+            EXPECT_EQ(val, off / sizeof(off), "snapshot read back");
+            break;
+        }
+    }
+    EXPECT_EQ(ZX_OK, zx_vmo_read(vmo, &val, 0, sizeof(val)), "reading original");
+    EXPECT_EQ(99u, val, "original keeps its writes");
+
+    EXPECT_EQ(ZX_OK, zx_vmar_unmap(zx_vmar_root_self(), ptr_rw, size), "unmap");
+    EXPECT_EQ(ZX_OK, zx_handle_close(snapshot));
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo));
+    END_TEST;
+}
+
 bool vmo_unmap_coherency() {
     BEGIN_TEST;
 
@@ -1785,6 +1923,8 @@ RUN_TEST(vmo_clone_size_align_test);
 RUN_TEST(vmo_rights_test);
 RUN_TEST(vmo_commit_test);
 RUN_TEST(vmo_decommit_misaligned_test);
+RUN_TEST(vmo_discardable_lock_test);
+RUN_TEST(vmo_op_range_batch_test);
 RUN_TEST(vmo_cache_test);
 RUN_TEST_PERFORMANCE(vmo_cache_map_test);
 RUN_TEST(vmo_cache_op_test);
@@ -1800,6 +1940,7 @@ RUN_TEST(vmo_clone_rights_test);
 RUN_TEST(vmo_resize_hazard);
 RUN_TEST(vmo_clone_resize_clone_hazard);
 RUN_TEST(vmo_clone_resize_parent_ok);
+RUN_TEST(vmo_clone_snapshot_test);
 RUN_TEST(vmo_info_test);
 RUN_TEST_LARGE(vmo_unmap_coherency);
 END_TEST_CASE(vmo_tests)
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <fbl/algorithm.h>
 #include <fbl/type_support.h>
 #include <lib/async-loop/loop.h>
 #include <lib/async/cpp/wait.h>
@@ -367,6 +368,134 @@ static bool listen_accept_test(void) {
     END_TEST;
 }
 
+static bool stream_sendmsg_recvmsg_test(void) {
+    BEGIN_TEST;
+
+    zx::socket local, remote;
+    ASSERT_EQ(ZX_OK, zx::socket::create(0u, &local, &remote));
+    zxs_socket_t sender = {
+        .socket = local.get(),
+        .flags = ZXS_FLAG_BLOCKING,
+    };
+    zxs_socket_t receiver = {
+        .socket = remote.get(),
+        .flags = 0u,
+    };
+
+    char hello[] = "hello, ";
+    char world[] = "world";
+    struct iovec out_iov[] = {
+        {.iov_base = hello, .iov_len = strlen(hello)},
+        {.iov_base = nullptr, .iov_len = 0u},
+        {.iov_base = world, .iov_len = strlen(world)},
+    };
+    struct msghdr out_msg = {};
+    out_msg.msg_iov = out_iov;
+    out_msg.msg_iovlen = fbl::count_of(out_iov);
+    size_t actual = 0u;
+    ASSERT_EQ(ZX_OK, zxs_sendmsg(&sender, &out_msg, &actual));
+    ASSERT_EQ(strlen(hello) + strlen(world), actual);
+
+    // What is there is scattered across the buffers, without waiting to fill
+    // them.
+    char first[4] = {};
+    char second[32] = {};
+    struct iovec in_iov[] = {
+        {.iov_base = first, .iov_len = sizeof(first)},
+        {.iov_base = second, .iov_len = sizeof(second)},
+    };
+    struct msghdr in_msg = {};
+    in_msg.msg_iov = in_iov;
+    in_msg.msg_iovlen = fbl::count_of(in_iov);
+    receiver.flags = ZXS_FLAG_BLOCKING;
+    ASSERT_EQ(ZX_OK, zxs_recvmsg(&receiver, &in_msg, &actual));
+    ASSERT_EQ(strlen(hello) + strlen(world), actual);
+    ASSERT_EQ(0, memcmp("hell", first, sizeof(first)));
+    ASSERT_EQ(0, memcmp("o, world", second, actual - sizeof(first)));
+
+    receiver.flags = 0u;
+    ASSERT_EQ(ZX_ERR_SHOULD_WAIT, zxs_recv(&receiver, 0, second, sizeof(second), &actual));
+
+    // The end of the stream reads as no data.
+    local.reset();
+    ASSERT_EQ(ZX_OK, zxs_recv(&receiver, 0, second, sizeof(second), &actual));
+    ASSERT_EQ(0u, actual);
+
+    END_TEST;
+}
+
+static bool datagram_mmsg_test(void) {
+    BEGIN_TEST;
+
+    zx::socket local, remote;
+    ASSERT_EQ(ZX_OK, zx::socket::create(ZX_SOCKET_DATAGRAM, &local, &remote));
+    zxs_socket_t sender = {
+        .socket = local.get(),
+        .flags = ZXS_FLAG_DATAGRAM | ZXS_FLAG_BLOCKING,
+    };
+    zxs_socket_t receiver = {
+        .socket = remote.get(),
+        .flags = ZXS_FLAG_DATAGRAM | ZXS_FLAG_BLOCKING,
+    };
+
+    char payloads[3][8] = {"one", "two", "three!!"};
+    struct sockaddr addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sa_family = AF_IPX;
+    struct iovec out_iov[3];
+    struct mmsghdr out_msgs[3];
+    memset(out_msgs, 0, sizeof(out_msgs));
+    for (size_t i = 0; i < 3; ++i) {
+        out_iov[i].iov_base = payloads[i];
+        out_iov[i].iov_len = strlen(payloads[i]);
+        out_msgs[i].msg_hdr.msg_name = &addr;
+        out_msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+        out_msgs[i].msg_hdr.msg_iov = &out_iov[i];
+        out_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    size_t count = 0u;
+    ASSERT_EQ(ZX_OK, zxs_sendmmsg(&sender, out_msgs, 3u, 0, &count));
+    ASSERT_EQ(3u, count);
+    for (size_t i = 0; i < 3; ++i) {
+        ASSERT_EQ(strlen(payloads[i]), out_msgs[i].msg_len);
+    }
+
+    // Only the datagrams already there are received, and the last is
+    // truncated.
+    char buffers[4][4];
+    struct sockaddr names[4];
+    struct iovec in_iov[4];
+    struct mmsghdr in_msgs[4];
+    memset(in_msgs, 0, sizeof(in_msgs));
+    for (size_t i = 0; i < 4; ++i) {
+        in_iov[i].iov_base = buffers[i];
+        in_iov[i].iov_len = sizeof(buffers[i]);
+        in_msgs[i].msg_hdr.msg_name = &names[i];
+        in_msgs[i].msg_hdr.msg_namelen = sizeof(names[i]);
+        in_msgs[i].msg_hdr.msg_iov = &in_iov[i];
+        in_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    ASSERT_EQ(ZX_OK, zxs_recvmmsg(&receiver, in_msgs, 4u, MSG_WAITFORONE,
+                                  ZX_TIME_INFINITE, &count));
+    ASSERT_EQ(3u, count);
+    for (size_t i = 0; i < 3; ++i) {
+        size_t length = fbl::min(strlen(payloads[i]), sizeof(buffers[i]));
+        ASSERT_EQ(length, in_msgs[i].msg_len);
+        ASSERT_EQ(0, memcmp(payloads[i], buffers[i], length));
+        ASSERT_EQ(sizeof(addr), in_msgs[i].msg_hdr.msg_namelen);
+        ASSERT_EQ(AF_IPX, names[i].sa_family);
+    }
+    ASSERT_EQ(0, in_msgs[1].msg_hdr.msg_flags);
+    ASSERT_EQ(MSG_TRUNC, in_msgs[2].msg_hdr.msg_flags);
+
+    ASSERT_EQ(ZX_ERR_SHOULD_WAIT, zxs_recvmmsg(&receiver, in_msgs, 4u, MSG_DONTWAIT,
+                                               ZX_TIME_INFINITE, &count));
+    ASSERT_EQ(ZX_ERR_SHOULD_WAIT, zxs_recvmmsg(&receiver, in_msgs, 4u, 0,
+                                               zx_deadline_after(ZX_MSEC(1)), &count));
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(zxs_test)
 RUN_TEST(connect_test);
 RUN_TEST(bind_test);
@@ -374,4 +503,6 @@ RUN_TEST(getsockname_test);
 RUN_TEST(getpeername_test);
 RUN_TEST(sockopts_test);
 RUN_TEST(listen_accept_test);
+RUN_TEST(stream_sendmsg_recvmsg_test);
+RUN_TEST(datagram_mmsg_test);
 END_TEST_CASE(zxs_test)
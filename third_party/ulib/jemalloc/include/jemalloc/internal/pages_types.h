@@ -36,8 +36,13 @@
  * propagate the "poisoned" memory state.  Since we typically decommit as the
  * next step after purging on Windows anyway, there's no point in adding such
  * complexity.
+ *
+ * On Fuchsia the heap is mapped from one vmo, and decommitting a range of it
+ * leaves the mapping in place and reading it back as zeroes, as
+ * MADV_DONTNEED does.
  */
-#if !defined(_WIN32) && defined(JEMALLOC_PURGE_MADVISE_DONTNEED)
+#if !defined(_WIN32) && \
+    (defined(JEMALLOC_PURGE_MADVISE_DONTNEED) || defined(__Fuchsia__))
 #  define PAGES_CAN_PURGE_FORCED
 #endif
 
@@ -214,6 +214,36 @@ static void LZ4_wildCopy(void* dstPtr, const void* srcPtr, void* dstEnd)
     do { LZ4_copy8(d,s); d+=8; s+=8; } while (d<e);
 }
 
+/* 16 byte copy, as a single vector load and store where the target has them.
+ * The kernel builds without vector registers, so it always uses memcpy. */
+#if defined(__SSE2__) && !defined(_KERNEL)
+#  include <emmintrin.h>
+static void LZ4_copy16(void* dstPtr, const void* srcPtr)
+{
+    _mm_storeu_si128((__m128i*)dstPtr, _mm_loadu_si128((const __m128i*)srcPtr));
+}
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(_KERNEL)
+#  include <arm_neon.h>
+static void LZ4_copy16(void* dstPtr, const void* srcPtr)
+{
+    vst1q_u8((uint8_t*)dstPtr, vld1q_u8((const uint8_t*)srcPtr));
+}
+#else
+static void LZ4_copy16(void* dstPtr, const void* srcPtr) { memcpy(dstPtr, srcPtr, 16); }
+#endif
+
+/* wider version of LZ4_wildCopy, which may overwrite up to 15 bytes beyond dstEnd
+ * and read up to 15 bytes beyond srcPtr + (dstEnd - dstPtr); for overlapping
+ * copies, the source must be at least 16 bytes behind the destination */
+static void LZ4_wildCopy16(void* dstPtr, const void* srcPtr, void* dstEnd)
+{
+    BYTE* d = (BYTE*)dstPtr;
+    const BYTE* s = (const BYTE*)srcPtr;
+    BYTE* e = (BYTE*)dstEnd;
+    do { LZ4_copy16(d,s); d+=16; s+=16; } while (d<e);
+}
+#define WILDCOPY16_SLACK 16
+
 
 /**************************************
 *  Common Constants
@@ -1197,7 +1227,12 @@ FORCE_INLINE int LZ4_decompress_generic(
             op += length;
             break;     /* Necessarily EOF, due to parsing restrictions */
         }
-        LZ4_wildCopy(op, ip, cpy);
+        /* the wide copy may read and write 15 bytes past the literals, so it is
+         * only used when both buffers are known to have room for that */
+        if ((endOnInput) && (cpy <= oend-WILDCOPY16_SLACK) && (ip+length <= iend-WILDCOPY16_SLACK))
+            LZ4_wildCopy16(op, ip, cpy);
+        else
+            LZ4_wildCopy(op, ip, cpy);
         ip += length; op = cpy;
 
         /* get offset */
@@ -1277,6 +1312,10 @@ FORCE_INLINE int LZ4_decompress_generic(
             }
             while (op<cpy) *op++ = *match++;
         }
+        else if ((op < cpy) && (op-match >= 16) && (cpy <= oend-WILDCOPY16_SLACK))
+            /* op may already be past cpy for short matches, and the wide copy
+             * always stores at least 16 bytes, so it needs op < cpy */
+            LZ4_wildCopy16(op, match, cpy);
         else
             LZ4_wildCopy(op, match, cpy);
         op=cpy;   /* correction */
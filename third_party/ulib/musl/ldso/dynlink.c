@@ -50,6 +50,7 @@ static void loader_svc_config(const char* config);
 #define ALIGN(x, y) (((x) + (y)-1) & -(y))
 
 #define VMO_NAME_DL_ALLOC "ld.so.1-internal-heap"
+#define VMO_NAME_SYM_CACHE "ld.so.1-symbol-cache"
 #define VMO_NAME_UNKNOWN "<unknown ELF file>"
 #define VMO_NAME_PREFIX_BSS "bss:"
 #define VMO_NAME_PREFIX_DATA "data:"
@@ -427,10 +428,61 @@ static struct symdef find_sym(struct dso* dso, const char* s, int need_def) {
     return def;
 }
 
+// The lookups made while relocating one module, indexed by symbol, so that
+// a symbol used by several relocations is only looked up once.
+struct sym_cache_entry {
+    struct symdef def;
+    // Zero if the symbol has not been looked up yet, or else one more than
+    // the need_def of the lookup.
+    unsigned char state;
+};
+
+// The cache is a mapping of its own, which is kept while modules are being
+// relocated and grown to fit the biggest, and released afterwards.
+static struct sym_cache_entry* sym_cache;
+static size_t sym_cache_len;
+
+__NO_SAFESTACK NO_ASAN static void release_sym_cache(void) {
+    if (sym_cache_len != 0) {
+        _zx_vmar_unmap(_zx_vmar_root_self(), (uintptr_t)sym_cache, sym_cache_len);
+        sym_cache = NULL;
+        sym_cache_len = 0;
+    }
+}
+
+// Returns an empty cache for |nsym| symbols, or NULL if there is no memory
+// for one, in which case every symbol is looked up every time.
+__NO_SAFESTACK NO_ASAN static struct sym_cache_entry* get_sym_cache(size_t nsym) {
+    size_t len = ALIGN(nsym * sizeof(struct sym_cache_entry), PAGE_SIZE);
+    if (len <= sym_cache_len) {
+        memset(sym_cache, 0, nsym * sizeof(struct sym_cache_entry));
+        return sym_cache;
+    }
+
+    release_sym_cache();
+    zx_handle_t vmo;
+    if (_zx_vmo_create(len, 0, &vmo) != ZX_OK)
+        return NULL;
+    _zx_object_set_property(vmo, ZX_PROP_NAME,
+                            VMO_NAME_SYM_CACHE, sizeof(VMO_NAME_SYM_CACHE));
+    uintptr_t addr;
+    zx_status_t status = _zx_vmar_map(_zx_vmar_root_self(),
+                                      ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+                                      0, vmo, 0, len, &addr);
+    _zx_handle_close(vmo);
+    if (status != ZX_OK)
+        return NULL;
+    sym_cache = (void*)addr;
+    sym_cache_len = len;
+    return sym_cache;
+}
+
 __attribute__((__visibility__("hidden"))) ptrdiff_t __tlsdesc_static(void), __tlsdesc_dynamic(void);
 
 __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
-                                             size_t rel_size, size_t stride) {
+                                             size_t rel_size, size_t stride,
+                                             struct sym_cache_entry* cache,
+                                             size_t nsym) {
     ElfW(Addr) base = dso->l_map.l_addr;
     Sym* syms = dso->syms;
     char* strings = dso->strings;
@@ -465,8 +517,22 @@ __NO_SAFESTACK NO_ASAN static void do_relocs(struct dso* dso, size_t* rel,
             sym = syms + sym_index;
             name = strings + sym->st_name;
             ctx = type == REL_COPY ? dso_next(head) : head;
-            def = (sym->st_info & 0xf) == STT_SECTION ? (struct symdef){.dso = dso, .sym = sym}
-                                                      : find_sym(ctx, name, type == REL_PLT);
+            // Only lookups from the head of the chain are cached.
+            struct sym_cache_entry* entry =
+                cache != NULL && type != REL_COPY && (size_t)sym_index < nsym
+                    ? &cache[sym_index] : NULL;
+            unsigned char state = 1 + (type == REL_PLT);
+            if ((sym->st_info & 0xf) == STT_SECTION) {
+                def = (struct symdef){.dso = dso, .sym = sym};
+            } else if (entry != NULL && entry->state == state) {
+                def = entry->def;
+            } else {
+                def = find_sym(ctx, name, type == REL_PLT);
+                if (entry != NULL) {
+                    entry->def = def;
+                    entry->state = state;
+                }
+            }
             if (!def.sym && (sym->st_shndx != SHN_UNDEF || sym->st_info >> 4 != STB_WEAK)) {
                 error("Error relocating %s: %s: symbol not found", dso->l_map.l_name, name);
                 if (runtime)
@@ -1095,7 +1161,7 @@ __NO_SAFESTACK NO_ASAN static void decode_dyn(struct dso* p) {
         p->versym = laddr(p, *dyn);
 }
 
-static size_t count_syms(struct dso* p) {
+__NO_SAFESTACK NO_ASAN static size_t count_syms(struct dso* p) {
     if (p->hashtab)
         return p->hashtab[1];
 
@@ -1455,9 +1521,15 @@ __NO_SAFESTACK NO_ASAN static void reloc_all(struct dso* p) {
             apply_relr(p->l_map.l_addr,
                        laddr(p, dyn[DT_RELR]), dyn[DT_RELRSZ]);
         }
-        do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ], 2 + (dyn[DT_PLTREL] == DT_RELA));
-        do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2);
-        do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3);
+        // Most modules refer to some symbols from more than one relocation,
+        // such as a function which is both called and has its address
+        // taken. ld.so's own few symbolic relocations aren't worth a cache.
+        size_t nsym = p == &ldso ? 0 : count_syms(p);
+        struct sym_cache_entry* cache = nsym != 0 ? get_sym_cache(nsym) : NULL;
+        do_relocs(p, laddr(p, dyn[DT_JMPREL]), dyn[DT_PLTRELSZ], 2 + (dyn[DT_PLTREL] == DT_RELA),
+                  cache, nsym);
+        do_relocs(p, laddr(p, dyn[DT_REL]), dyn[DT_RELSZ], 2, cache, nsym);
+        do_relocs(p, laddr(p, dyn[DT_RELA]), dyn[DT_RELASZ], 3, cache, nsym);
 
         if (head != &ldso && p->relro_start != p->relro_end) {
             zx_status_t status =
@@ -1491,6 +1563,7 @@ __NO_SAFESTACK NO_ASAN static void reloc_all(struct dso* p) {
 
         p->relocated = 1;
     }
+    release_sym_cache();
 }
 
 __NO_SAFESTACK NO_ASAN static void kernel_mapped_dso(struct dso* p) {
@@ -1041,8 +1041,13 @@ endif
 # Include src/string sources
 include $(LOCAL_DIR)/src/string/rules.mk
 
-# Include jemalloc for our malloc implementation
+# Include jemalloc for our malloc implementation, unless the hardened one
+# was asked for. It checks the header of every chunk it is handed back.
+ifeq ($(call TOBOOL,$(USE_HARDENED_MALLOC)),true)
+LOCAL_SRCS += $(LOCAL_DIR)/zircon/hardened_malloc.c
+else
 include $(LOCAL_DIR)/../jemalloc/rules.mk
+endif
 
 
 # shared library (which is also the dynamic linker)
@@ -106,15 +106,30 @@ LOCAL_SRCS += \
 
 else
 
+LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/strchr.c \
+    $(GET_LOCAL_DIR)/strcpy.c \
+    $(GET_LOCAL_DIR)/strncmp.c \
+    $(GET_LOCAL_DIR)/strnlen.c \
+
+# The SSE2 versions read whole aligned blocks, past the ends of strings,
+# which ASan would diagnose. SSE2 is part of x86-64, so needs no check.
+ifeq ($(ARCH):$(call TOBOOL,$(USE_ASAN)),x86:false)
+LOCAL_SRCS += \
+    $(GET_LOCAL_DIR)/x86_64/memchr.c \
+    $(GET_LOCAL_DIR)/x86_64/memcmp.c \
+    $(GET_LOCAL_DIR)/x86_64/strchrnul.c \
+    $(GET_LOCAL_DIR)/x86_64/strcmp.c \
+    $(GET_LOCAL_DIR)/x86_64/strlen.c \
+
+else
 LOCAL_SRCS += \
     $(GET_LOCAL_DIR)/memchr.c \
     $(GET_LOCAL_DIR)/memcmp.c \
-    $(GET_LOCAL_DIR)/strchr.c \
     $(GET_LOCAL_DIR)/strchrnul.c \
     $(GET_LOCAL_DIR)/strcmp.c \
-    $(GET_LOCAL_DIR)/strcpy.c \
     $(GET_LOCAL_DIR)/strlen.c \
-    $(GET_LOCAL_DIR)/strncmp.c \
-    $(GET_LOCAL_DIR)/strnlen.c \
+
+endif
 
 endif
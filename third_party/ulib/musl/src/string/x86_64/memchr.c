@@ -0,0 +1,42 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <emmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// Each load is aligned, so it can't fault on the bytes around the buffer;
+// matches outside of it are masked off.
+void* memchr(const void* src, int c, size_t n) {
+    if (n == 0) {
+        return NULL;
+    }
+    const unsigned char* s = src;
+    const __m128i k = _mm_set1_epi8((char)c);
+    const uintptr_t misalign = (uintptr_t)s & 15;
+    const __m128i* p = (const __m128i*)(s - misalign);
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(p), k));
+    mask >>= misalign;
+    // The bytes left to look at, from the end of the first block.
+    size_t left = n;
+    if (mask) {
+        size_t i = __builtin_ctz(mask);
+        return i < n ? (void*)(s + i) : NULL;
+    }
+    if (left <= 16 - misalign) {
+        return NULL;
+    }
+    left -= 16 - misalign;
+    for (;;) {
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(++p), k));
+        if (mask) {
+            size_t i = __builtin_ctz(mask);
+            return i < left ? (void*)((const unsigned char*)p + i) : NULL;
+        }
+        if (left <= 16) {
+            return NULL;
+        }
+        left -= 16;
+    }
+}
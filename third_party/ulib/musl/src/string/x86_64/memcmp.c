@@ -0,0 +1,23 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <emmintrin.h>
+#include <string.h>
+
+int memcmp(const void* vl, const void* vr, size_t n) {
+    const unsigned char *l = vl, *r = vr;
+    // Only whole blocks within both buffers are loaded.
+    for (; n >= 16; n -= 16, l += 16, r += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)l);
+        __m128i b = _mm_loadu_si128((const __m128i*)r);
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xffff;
+        if (mask) {
+            unsigned i = __builtin_ctz(mask);
+            return l[i] - r[i];
+        }
+    }
+    for (; n && *l == *r; n--, l++, r++)
+        ;
+    return n ? *l - *r : 0;
+}
@@ -0,0 +1,33 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "libc.h"
+#include <emmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// As in strlen, each load is aligned, so it can't fault past the string.
+char* __strchrnul(const char* s, int c) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i k = _mm_set1_epi8((char)c);
+    const uintptr_t misalign = (uintptr_t)s & 15;
+    const __m128i* p = (const __m128i*)(s - misalign);
+    __m128i v = _mm_load_si128(p);
+    unsigned mask = (unsigned)_mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(v, k)));
+    mask >>= misalign;
+    if (mask) {
+        return (char*)s + __builtin_ctz(mask);
+    }
+    for (;;) {
+        v = _mm_load_si128(++p);
+        mask = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(v, k)));
+        if (mask) {
+            return (char*)p + __builtin_ctz(mask);
+        }
+    }
+}
+
+weak_alias(__strchrnul, strchrnul);
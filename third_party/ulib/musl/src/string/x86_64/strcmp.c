@@ -0,0 +1,42 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <emmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PAGE_MASK 4095
+
+// Whether the 16 bytes at |p| are all on the page of |p|, so that they can
+// be loaded even if the string ends before them.
+static inline int block_in_page(const char* p) {
+    return ((uintptr_t)p & PAGE_MASK) <= PAGE_MASK + 1 - 16;
+}
+
+int strcmp(const char* l, const char* r) {
+    const __m128i zero = _mm_setzero_si128();
+    for (;;) {
+        if (block_in_page(l) && block_in_page(r)) {
+            __m128i a = _mm_loadu_si128((const __m128i*)l);
+            __m128i b = _mm_loadu_si128((const __m128i*)r);
+            // The first byte which differs, or which ends both strings.
+            unsigned mask = (unsigned)_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(a, zero), _mm_xor_si128(_mm_cmpeq_epi8(a, b),
+                                                                    _mm_set1_epi8(-1))));
+            if (mask) {
+                unsigned i = __builtin_ctz(mask);
+                return (unsigned char)l[i] - (unsigned char)r[i];
+            }
+            l += 16;
+            r += 16;
+        } else {
+            // Near the end of a page, the next byte is compared alone.
+            if (*l != *r || !*l) {
+                return *(unsigned char*)l - *(unsigned char*)r;
+            }
+            l++;
+            r++;
+        }
+    }
+}
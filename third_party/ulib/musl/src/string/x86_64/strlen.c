@@ -0,0 +1,27 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <emmintrin.h>
+#include <stdint.h>
+#include <string.h>
+
+// Each 16 byte load is aligned, so it never crosses into a page which
+// might not be mapped, even where it reads past the end of the string.
+size_t strlen(const char* s) {
+    const __m128i zero = _mm_setzero_si128();
+    const uintptr_t misalign = (uintptr_t)s & 15;
+    const __m128i* p = (const __m128i*)(s - misalign);
+    // Bytes before the start of the string are masked off.
+    unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(p), zero));
+    mask >>= misalign;
+    if (mask) {
+        return __builtin_ctz(mask);
+    }
+    for (;;) {
+        mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(++p), zero));
+        if (mask) {
+            return (const char*)p + __builtin_ctz(mask) - s;
+        }
+    }
+}
@@ -1,6 +1,7 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
@@ -454,6 +455,37 @@ static int stub_ppoll(struct pollfd* fds, nfds_t n, const struct timespec* timeo
 }
 weak_alias(stub_ppoll, ppoll);
 
+static int stub_epoll_create(int size) {
+    errno = ENOSYS;
+    return -1;
+}
+weak_alias(stub_epoll_create, epoll_create);
+
+static int stub_epoll_create1(int flags) {
+    errno = ENOSYS;
+    return -1;
+}
+weak_alias(stub_epoll_create1, epoll_create1);
+
+static int stub_epoll_ctl(int epfd, int op, int fd, struct epoll_event* event) {
+    errno = ENOSYS;
+    return -1;
+}
+weak_alias(stub_epoll_ctl, epoll_ctl);
+
+static int stub_epoll_wait(int epfd, struct epoll_event* events, int maxevents, int timeout) {
+    errno = ENOSYS;
+    return -1;
+}
+weak_alias(stub_epoll_wait, epoll_wait);
+
+static int stub_epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout,
+                            const sigset_t* sigmask) {
+    errno = ENOSYS;
+    return -1;
+}
+weak_alias(stub_epoll_pwait, epoll_pwait);
+
 static int stub_ioctl(int fd, int req, ...) {
     errno = ENOSYS;
     return -1;
@@ -0,0 +1,509 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// A malloc which checks every chunk it is handed back, for services which
+// would rather crash than run on with a corrupted heap. It is built into
+// libc in place of jemalloc when USE_HARDENED_MALLOC is set.
+//
+// Small requests are served from size classes. Each class has a region of
+// its own, backed by its own vmo and mapped at a fixed place in a vmar
+// reserved for the heap, so the class of any chunk follows from its address.
+// Each thread caches a few free chunks of each class, so that most calls
+// take no lock. Larger requests get a vmo of their own.
+//
+// Every allocation is preceded by a 16 byte header, whose checksum is keyed
+// by a secret chosen at startup and by the address of the allocation. A
+// header which fails the check, or a chunk which is not allocated, is fatal.
+
+#define _ALL_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+
+#include "zircon_impl.h"
+
+#define HEADER_SIZE 16
+#define MIN_ALIGN 16
+
+// The classes step by 16 bytes up to 256, and then by a quarter of each
+// power of two up to 64KiB. Their sizes include the header.
+#define NUM_LINEAR_CLASSES 15
+#define NUM_CLASSES (NUM_LINEAR_CLASSES + 32)
+#define LARGE_CLASS 0xff
+
+// The address space reserved for the chunks of each class.
+#define REGION_SIZE ((size_t)1 << 32)
+
+// The most chunks of one class a thread holds, and the most bytes.
+#define CACHE_MAX_CHUNKS 32
+#define CACHE_MAX_BYTES (64 * 1024)
+
+#define CHUNK_ALLOCATED 0xa1
+#define CHUNK_FREED 0xf3
+
+// Requests larger than this fail, so that sizes can't overflow.
+#define MAX_REQUEST (PTRDIFF_MAX / 2)
+
+static const char heap_vmo_name[] = "hardened-heap";
+static const char large_vmo_name[] = "hardened-large";
+
+struct header {
+    uint16_t checksum;
+    uint8_t class_id;
+    uint8_t state;
+    // The distance from the start of the chunk, or of the mapping of a
+    // large allocation, to the allocation.
+    uint32_t offset;
+    // The size which was asked for.
+    uint64_t size;
+};
+
+static_assert(sizeof(struct header) == HEADER_SIZE, "");
+
+struct region {
+    mtx_t lock;
+    bool mapped;
+    uintptr_t base;
+    // The first byte which has never been handed out.
+    uintptr_t next;
+    // The most recently returned free chunk. Each free chunk holds the
+    // next, scrambled by the secret, just past its header.
+    uintptr_t free_list;
+};
+
+struct cache_bin {
+    uint32_t count;
+    void* chunks[CACHE_MAX_CHUNKS];
+};
+
+struct cache {
+    struct cache_bin bins[NUM_CLASSES];
+};
+
+static once_flag heap_once = ONCE_FLAG_INIT;
+static bool heap_ready;
+static uint64_t secret;
+static zx_handle_t heap_vmar;
+static uintptr_t heap_base;
+static tss_t cache_key;
+static size_t class_sizes[NUM_CLASSES];
+static size_t bin_limits[NUM_CLASSES];
+static struct region regions[NUM_CLASSES];
+
+static _Noreturn void heap_corrupted(void) {
+    __builtin_trap();
+}
+
+static inline size_t round_up(size_t x, size_t align) {
+    return (x + align - 1) & ~(align - 1);
+}
+
+static size_t size_to_class(size_t needed) {
+    if (needed <= 32) {
+        return 0;
+    }
+    if (needed <= 256) {
+        return (needed + 15) / 16 - 2;
+    }
+    size_t doubling = 63 - __builtin_clzl((needed - 1) >> 8);
+    size_t base = (size_t)256 << doubling;
+    return NUM_LINEAR_CLASSES + doubling * 4 + (needed - 1 - base) / (base / 4);
+}
+
+static uint16_t header_checksum(uintptr_t ptr, const struct header* h) {
+    uint64_t x = secret ^ ptr;
+    x ^= (uint64_t)h->class_id | (uint64_t)h->state << 8 | (uint64_t)h->offset << 32;
+    x *= 0x9e3779b97f4a7c15ull;
+    x ^= h->size;
+    x *= 0x9e3779b97f4a7c15ull;
+    x ^= x >> 32;
+    x ^= x >> 16;
+    return (uint16_t)x;
+}
+
+static void store_header(uintptr_t ptr, struct header* h) {
+    h->checksum = header_checksum(ptr, h);
+    memcpy((void*)(ptr - HEADER_SIZE), h, sizeof(*h));
+}
+
+// Reads the header of the allocation |ptr|, which must be allocated, and
+// must agree with where |ptr| is.
+static void load_header(uintptr_t ptr, struct header* h) {
+    if (ptr & (MIN_ALIGN - 1)) {
+        heap_corrupted();
+    }
+    memcpy(h, (const void*)(ptr - HEADER_SIZE), sizeof(*h));
+    if (h->checksum != header_checksum(ptr, h) || h->state != CHUNK_ALLOCATED) {
+        heap_corrupted();
+    }
+    const bool in_heap = heap_ready && ptr - heap_base < NUM_CLASSES * REGION_SIZE;
+    if (h->class_id == LARGE_CLASS) {
+        if (in_heap || h->offset < HEADER_SIZE || h->offset >= PAGE_SIZE + HEADER_SIZE) {
+            heap_corrupted();
+        }
+    } else if (!in_heap || (ptr - heap_base) / REGION_SIZE != h->class_id ||
+               h->offset < HEADER_SIZE || h->offset + h->size > class_sizes[h->class_id]) {
+        heap_corrupted();
+    }
+}
+
+static void cache_destroy(void* arg);
+
+static void heap_init(void) {
+    _zx_cprng_draw(&secret, sizeof(secret));
+    if (tss_create(&cache_key, cache_destroy) != thrd_success) {
+        return;
+    }
+
+    for (size_t c = 0; c < NUM_CLASSES; c++) {
+        size_t size;
+        if (c < NUM_LINEAR_CLASSES) {
+            size = (c + 2) * 16;
+        } else {
+            size_t step = c - NUM_LINEAR_CLASSES;
+            size_t base = (size_t)256 << (step / 4);
+            size = base + base / 4 * (step % 4 + 1);
+        }
+        size_t limit = CACHE_MAX_BYTES / size;
+        class_sizes[c] = size;
+        bin_limits[c] = limit < 2 ? 2 : limit > CACHE_MAX_CHUNKS ? CACHE_MAX_CHUNKS : limit;
+    }
+
+    zx_vm_option_t options = ZX_VM_CAN_MAP_SPECIFIC | ZX_VM_CAN_MAP_READ | ZX_VM_CAN_MAP_WRITE;
+    if (_zx_vmar_allocate(_zx_vmar_root_self(), options, 0, NUM_CLASSES * REGION_SIZE,
+                          &heap_vmar, &heap_base) != ZX_OK) {
+        return;
+    }
+    heap_ready = true;
+}
+
+static bool heap_start(void) {
+    call_once(&heap_once, heap_init);
+    return heap_ready;
+}
+
+// Maps the vmo behind |r|. Its pages are only committed as chunks are first
+// handed out.
+static zx_status_t region_map(struct region* r, size_t c) {
+    zx_handle_t vmo;
+    zx_status_t status = _zx_vmo_create(REGION_SIZE, 0, &vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    _zx_object_set_property(vmo, ZX_PROP_NAME, heap_vmo_name, strlen(heap_vmo_name));
+    uintptr_t base;
+    status = _zx_vmar_map(heap_vmar, ZX_VM_PERM_READ | ZX_VM_PERM_WRITE | ZX_VM_SPECIFIC,
+                          c * REGION_SIZE, vmo, 0, REGION_SIZE, &base);
+    _zx_handle_close(vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    r->base = base;
+    r->next = base;
+    r->mapped = true;
+    return ZX_OK;
+}
+
+// Takes up to |count| free chunks of class |c| into |chunks|, and returns
+// how many it took.
+static size_t region_take(size_t c, void** chunks, size_t count) {
+    struct region* r = &regions[c];
+    const size_t size = class_sizes[c];
+    size_t n = 0;
+    mtx_lock(&r->lock);
+    if (r->mapped || region_map(r, c) == ZX_OK) {
+        while (n < count && r->free_list != 0) {
+            uintptr_t chunk = r->free_list;
+            uintptr_t next;
+            memcpy(&next, (const void*)(chunk + HEADER_SIZE), sizeof(next));
+            next ^= secret;
+            if (next != 0 && (next < r->base || next >= r->next)) {
+                heap_corrupted();
+            }
+            r->free_list = next;
+            chunks[n++] = (void*)chunk;
+        }
+        while (n < count && r->base + REGION_SIZE - r->next >= size) {
+            chunks[n++] = (void*)r->next;
+            r->next += size;
+        }
+    }
+    mtx_unlock(&r->lock);
+    return n;
+}
+
+static void region_give(size_t c, void* const* chunks, size_t count) {
+    struct region* r = &regions[c];
+    mtx_lock(&r->lock);
+    for (size_t i = 0; i < count; i++) {
+        uintptr_t chunk = (uintptr_t)chunks[i];
+        uintptr_t next = r->free_list ^ secret;
+        memcpy((void*)(chunk + HEADER_SIZE), &next, sizeof(next));
+        r->free_list = chunk;
+    }
+    mtx_unlock(&r->lock);
+}
+
+static void cache_destroy(void* arg) {
+    struct cache* cache = arg;
+    for (size_t c = 0; c < NUM_CLASSES; c++) {
+        region_give(c, cache->bins[c].chunks, cache->bins[c].count);
+    }
+    void* chunk = (void*)((uintptr_t)cache - HEADER_SIZE);
+    region_give(size_to_class(sizeof(*cache) + HEADER_SIZE), &chunk, 1);
+}
+
+// Returns the cache of this thread, or NULL if it has none and can't get
+// one. The cache is itself a chunk, taken straight from its region.
+static struct cache* get_cache(void) {
+    struct cache* cache = tss_get(cache_key);
+    if (cache != NULL) {
+        return cache;
+    }
+    static_assert(sizeof(struct cache) + HEADER_SIZE <= 64 * 1024, "");
+    void* chunk;
+    if (region_take(size_to_class(sizeof(*cache) + HEADER_SIZE), &chunk, 1) == 0) {
+        return NULL;
+    }
+    cache = (struct cache*)((uintptr_t)chunk + HEADER_SIZE);
+    for (size_t c = 0; c < NUM_CLASSES; c++) {
+        cache->bins[c].count = 0;
+    }
+    if (tss_set(cache_key, cache) != thrd_success) {
+        region_give(size_to_class(sizeof(*cache) + HEADER_SIZE), &chunk, 1);
+        return NULL;
+    }
+    return cache;
+}
+
+static void* cache_pop(size_t c) {
+    struct cache* cache = get_cache();
+    if (cache == NULL) {
+        void* chunk;
+        return region_take(c, &chunk, 1) ? chunk : NULL;
+    }
+    struct cache_bin* bin = &cache->bins[c];
+    if (bin->count == 0) {
+        bin->count = region_take(c, bin->chunks, bin_limits[c] / 2);
+        if (bin->count == 0) {
+            return NULL;
+        }
+    }
+    return bin->chunks[--bin->count];
+}
+
+static void cache_push(size_t c, void* chunk) {
+    struct cache* cache = get_cache();
+    if (cache == NULL) {
+        region_give(c, &chunk, 1);
+        return;
+    }
+    struct cache_bin* bin = &cache->bins[c];
+    if (bin->count == bin_limits[c]) {
+        // The oldest half goes back to the region.
+        size_t half = bin->count / 2;
+        region_give(c, bin->chunks, half);
+        memmove(bin->chunks, bin->chunks + half, (bin->count - half) * sizeof(void*));
+        bin->count -= half;
+    }
+    bin->chunks[bin->count++] = chunk;
+}
+
+// A large allocation is a mapping of its own, of just the pages holding it
+// and its header. Fresh pages read as zero, so it never needs clearing.
+static void* large_alloc(size_t size, size_t align) {
+    size_t len = round_up(HEADER_SIZE + align + size, PAGE_SIZE);
+    zx_handle_t vmo;
+    if (_zx_vmo_create(len, 0, &vmo) != ZX_OK) {
+        return NULL;
+    }
+    _zx_object_set_property(vmo, ZX_PROP_NAME, large_vmo_name, strlen(large_vmo_name));
+    uintptr_t base;
+    zx_status_t status = _zx_vmar_map(_zx_vmar_root_self(), ZX_VM_PERM_READ | ZX_VM_PERM_WRITE,
+                                      0, vmo, 0, len, &base);
+    _zx_handle_close(vmo);
+    if (status != ZX_OK) {
+        return NULL;
+    }
+
+    // Only the pages around the allocation are kept.
+    uintptr_t ptr = round_up(base + HEADER_SIZE, align);
+    uintptr_t start = (ptr - HEADER_SIZE) & ~(uintptr_t)(PAGE_SIZE - 1);
+    uintptr_t end = round_up(ptr + size, PAGE_SIZE);
+    if (start > base) {
+        _zx_vmar_unmap(_zx_vmar_root_self(), base, start - base);
+    }
+    if (base + len > end) {
+        _zx_vmar_unmap(_zx_vmar_root_self(), end, base + len - end);
+    }
+
+    struct header h = {
+        .class_id = LARGE_CLASS,
+        .state = CHUNK_ALLOCATED,
+        .offset = (uint32_t)(ptr - start),
+        .size = size,
+    };
+    store_header(ptr, &h);
+    return (void*)ptr;
+}
+
+static size_t usable_size(uintptr_t ptr, const struct header* h) {
+    if (h->class_id == LARGE_CLASS) {
+        return round_up(h->offset + h->size, PAGE_SIZE) - h->offset;
+    }
+    return class_sizes[h->class_id] - h->offset;
+}
+
+static void* allocate(size_t size, size_t align, bool zero) {
+    if (!heap_start() || size > MAX_REQUEST) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (align < MIN_ALIGN) {
+        align = MIN_ALIGN;
+    }
+
+    size_t needed = HEADER_SIZE + size + (align - MIN_ALIGN);
+    if (needed > class_sizes[NUM_CLASSES - 1]) {
+        void* ptr = large_alloc(size, align);
+        if (ptr == NULL) {
+            errno = ENOMEM;
+        }
+        return ptr;
+    }
+
+    size_t c = size_to_class(needed);
+    void* chunk = cache_pop(c);
+    if (chunk == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    uintptr_t ptr = round_up((uintptr_t)chunk + HEADER_SIZE, align);
+    struct header h = {
+        .class_id = (uint8_t)c,
+        .state = CHUNK_ALLOCATED,
+        .offset = (uint32_t)(ptr - (uintptr_t)chunk),
+        .size = size,
+    };
+    store_header(ptr, &h);
+    if (zero) {
+        memset((void*)ptr, 0, size);
+    }
+    return (void*)ptr;
+}
+
+void* malloc(size_t size) {
+    return allocate(size, MIN_ALIGN, false);
+}
+
+void* calloc(size_t count, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(count, size, &total)) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return allocate(total, MIN_ALIGN, true);
+}
+
+void free(void* p) {
+    if (p == NULL) {
+        return;
+    }
+    uintptr_t ptr = (uintptr_t)p;
+    struct header h;
+    load_header(ptr, &h);
+    if (h.class_id == LARGE_CLASS) {
+        uintptr_t start = ptr - h.offset;
+        _zx_vmar_unmap(_zx_vmar_root_self(), start, round_up(h.offset + h.size, PAGE_SIZE));
+        return;
+    }
+    h.state = CHUNK_FREED;
+    store_header(ptr, &h);
+    cache_push(h.class_id, (void*)(ptr - h.offset));
+}
+
+void* realloc(void* p, size_t size) {
+    if (p == NULL) {
+        return malloc(size);
+    }
+    uintptr_t ptr = (uintptr_t)p;
+    struct header h;
+    load_header(ptr, &h);
+
+    // An allocation which still fits, without wasting most of its chunk or
+    // any of its pages, is resized in place.
+    size_t usable = usable_size(ptr, &h);
+    bool in_place;
+    if (h.class_id == LARGE_CLASS) {
+        in_place = size <= MAX_REQUEST && round_up(h.offset + size, PAGE_SIZE) ==
+                                              round_up(h.offset + h.size, PAGE_SIZE);
+    } else {
+        in_place = size <= usable && size > usable / 2;
+    }
+    if (in_place) {
+        h.size = size;
+        store_header(ptr, &h);
+        return p;
+    }
+
+    void* new_p = allocate(size, MIN_ALIGN, false);
+    if (new_p == NULL) {
+        return NULL;
+    }
+    memcpy(new_p, p, size < h.size ? size : h.size);
+    free(p);
+    return new_p;
+}
+
+int posix_memalign(void** res, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+    if (align > MAX_REQUEST) {
+        return ENOMEM;
+    }
+    void* ptr = allocate(size, align, false);
+    if (ptr == NULL) {
+        return ENOMEM;
+    }
+    *res = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    if (align == 0 || (align & (align - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (align > MAX_REQUEST) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return allocate(size, align, false);
+}
+
+void* memalign(size_t align, size_t size) {
+    return aligned_alloc(align, size);
+}
+
+void* valloc(size_t size) {
+    return allocate(size, PAGE_SIZE, false);
+}
+
+size_t malloc_usable_size(void* p) {
+    if (p == NULL) {
+        return 0;
+    }
+    struct header h;
+    load_header((uintptr_t)p, &h);
+    return usable_size((uintptr_t)p, &h);
+}
@@ -26,6 +26,9 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #pragma once
 
+#include <stdbool.h>
+
+#include <zircon/syscalls/debug.h>
 #include <zircon/types.h>
 
 #include <ngunwind/fuchsia.h>
@@ -48,6 +51,11 @@ struct unw_fuchsia_info {
 
     uintptr_t segbase;
     struct as_elf_dyn_info edi;
+
+    // The thread is stopped while we unwind it, so its registers are
+    // read once and served from here afterwards.
+    bool regs_valid;
+    zx_thread_state_general_regs_t regs;
 };
 
 extern const int fuchsia_greg_offset[];
@@ -273,16 +273,20 @@ remote_access_reg (unw_addr_space_t as, unw_regnum_t reg, unw_word_t *val,
     return -UNW_EBADREG;
   }
 
-  zx_thread_state_general_regs_t regs;
-  zx_status_t r =
-      zx_thread_read_state(thread, ZX_THREAD_STATE_GENERAL_REGS, &regs, sizeof(regs));
-  if (r < 0)
+  if (!cxt->regs_valid)
   {
-    Debug (3, "error reading gregs: %d\n", r);
-    return -UNW_EUNSPEC;
+    zx_status_t r =
+        zx_thread_read_state(thread, ZX_THREAD_STATE_GENERAL_REGS,
+                             &cxt->regs, sizeof(cxt->regs));
+    if (r < 0)
+    {
+      Debug (3, "error reading gregs: %d\n", r);
+      return -UNW_EUNSPEC;
+    }
+    cxt->regs_valid = true;
   }
 
-  const char* buf = (const char*)&regs;
+  const char* buf = (const char*)&cxt->regs;
   if (sizeof(*val) == sizeof(uint32_t))
     *val = get_uint32 (buf + fuchsia_greg_offset[reg]);
   else